@@ -0,0 +1,293 @@
+#include "lsl_exporter.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace asio = lslboost::asio;
+using asio::ip::tcp;
+using err_t = const lslboost::system::error_code &;
+
+namespace {
+
+/// A metric of an outlet or inlet.
+template <typename Stats> struct metric {
+	const char *name, *type, *help;
+	double (*value)(const Stats &);
+};
+
+const metric<lsl_outlet_stats> outlet_metrics[] = {
+	{"lsl_outlet_samples_pushed_total", "counter", "Samples pushed into the outlet.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.samples_pushed); }},
+	{"lsl_outlet_samples_sent_total", "counter", "Samples sent, summed over all consumers.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.samples_sent); }},
+	{"lsl_outlet_bytes_sent_total", "counter", "Bytes of sample data sent to the consumers.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.bytes_sent); }},
+	{"lsl_outlet_chunks_sent_total", "counter", "Chunks the samples were sent in.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.chunks_sent); }},
+	{"lsl_outlet_samples_dropped_total", "counter",
+		"Samples dropped because a consumer didn't keep up.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.samples_dropped); }},
+	{"lsl_outlet_consumers", "gauge", "Currently connected consumers.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.consumers); }},
+	{"lsl_outlet_queued_samples_max", "gauge", "Samples waiting in the fullest consumer queue.",
+		[](const lsl_outlet_stats &s) { return static_cast<double>(s.max_queued); }},
+	{"lsl_outlet_cpu_seconds_total", "counter", "CPU time of the threads serving the outlet.",
+		[](const lsl_outlet_stats &s) { return s.cpu_seconds; }},
+};
+
+const metric<lsl_inlet_stats> inlet_metrics[] = {
+	{"lsl_inlet_samples_received_total", "counter", "Samples received from the outlet.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.samples_received); }},
+	{"lsl_inlet_bytes_received_total", "counter", "Bytes received over the data connection.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.bytes_received); }},
+	{"lsl_inlet_chunks_received_total", "counter", "Chunks the samples were received in.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.chunks_received); }},
+	{"lsl_inlet_samples_dropped_total", "counter",
+		"Samples dropped because the inlet's buffer was full.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.samples_dropped); }},
+	{"lsl_inlet_samples_available", "gauge", "Samples waiting to be pulled.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.samples_available); }},
+	{"lsl_inlet_reconnects_total", "counter", "Reconnects of the data connection.",
+		[](const lsl_inlet_stats &s) { return static_cast<double>(s.reconnects); }},
+	{"lsl_inlet_time_correction_rtt_seconds", "gauge",
+		"Round-trip time of the current time correction estimate.",
+		[](const lsl_inlet_stats &s) { return s.time_correction_rtt; }},
+	{"lsl_inlet_cpu_seconds_total", "counter", "CPU time of the inlet's receive thread.",
+		[](const lsl_inlet_stats &s) { return s.cpu_seconds; }},
+};
+
+/// Escape a label value.
+std::string escape(const std::string &value) {
+	std::string result;
+	for (char c : value) {
+		if (c == '\\' || c == '"')
+			result += '\\';
+		else if (c == '\n') {
+			result += "\\n";
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
+
+/// The labels of a stream's series.
+std::string stream_labels(const lsl::stream_info &info) {
+	return "name=\"" + escape(info.name()) + "\",type=\"" + escape(info.type()) +
+		   "\",source_id=\"" + escape(info.source_id()) + "\",hostname=\"" +
+		   escape(info.hostname()) + "\",uid=\"" + escape(info.uid()) + '"';
+}
+
+void write_header(std::ostream &out, const char *name, const char *type, const char *help) {
+	out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+void write_value(std::ostream &out, const std::string &name, const std::string &labels,
+	double value) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.17g", value);
+	out << name << '{' << labels << "} " << buf << '\n';
+}
+
+template <typename Stats>
+void write_metrics(std::ostream &out, const metric<Stats> *begin, const metric<Stats> *end,
+	const std::vector<std::pair<std::string, Stats>> &streams) {
+	if (streams.empty()) return;
+	for (const metric<Stats> *m = begin; m != end; ++m) {
+		write_header(out, m->name, m->type, m->help);
+		for (const auto &stream : streams)
+			write_value(out, m->name, stream.first, m->value(stream.second));
+	}
+}
+
+/// Write the percentiles of a latency histogram as a summary.
+void write_summary(std::ostream &out, const char *name, const char *help,
+	const std::vector<std::pair<std::string, lsl_inlet_stats>> &inlets, bool residence) {
+	bool header = false;
+	for (const auto &inlet : inlets) {
+		const lsl_inlet_stats &s = inlet.second;
+		const uint64_t count = residence ? s.residence_count : s.latency_count;
+		if (!count) continue;
+		if (!header) write_header(out, name, "summary", help);
+		header = true;
+		const double values[] = {residence ? s.residence_p50 : s.latency_p50,
+			residence ? s.residence_p99 : s.latency_p99,
+			residence ? s.residence_p999 : s.latency_p999};
+		const char *quantiles[] = {"0.5", "0.99", "0.999"};
+		for (int i = 0; i < 3; ++i)
+			write_value(out, name, inlet.first + ",quantile=\"" + quantiles[i] + '"', values[i]);
+		write_value(out, std::string(name) + "_count", inlet.first, static_cast<double>(count));
+	}
+}
+
+/// A registered outlet or inlet.
+template <typename Handle> struct entry {
+	std::weak_ptr<Handle> handle;
+	std::string labels;
+};
+
+} // namespace
+
+namespace lsl {
+
+class metrics_exporter_impl {
+public:
+	metrics_exporter_impl(uint16_t port, bool discover, const std::string &address)
+		: acceptor_(io_, tcp::endpoint(asio::ip::make_address(address), port)) {
+		if (discover) resolver_.reset(new continuous_resolver());
+		accept_next();
+		thread_ = std::thread([this]() {
+			while (true) try {
+					io_.run();
+					return;
+				} catch (std::exception &) {
+					// a broken connection mustn't stop the exporter
+				}
+		});
+	}
+
+	~metrics_exporter_impl() {
+		io_.stop();
+		thread_.join();
+	}
+
+	std::string render();
+
+	uint16_t port() const { return acceptor_.local_endpoint().port(); }
+
+	std::mutex mut_;
+	std::vector<entry<lsl_outlet_struct_>> outlets_;
+	std::vector<entry<lsl_inlet_struct_>> inlets_;
+
+private:
+	/// An HTTP connection.
+	struct session {
+		explicit session(asio::io_context &io) : sock(io) {}
+		tcp::socket sock;
+		asio::streambuf request;
+		std::string response;
+	};
+
+	void accept_next();
+	void respond(std::shared_ptr<session> s);
+
+	asio::io_context io_;
+	tcp::acceptor acceptor_;
+	std::unique_ptr<continuous_resolver> resolver_;
+	std::thread thread_;
+};
+
+void metrics_exporter_impl::accept_next() {
+	auto s = std::make_shared<session>(io_);
+	acceptor_.async_accept(s->sock, [this, s](err_t err) {
+		if (err == asio::error::operation_aborted) return;
+		if (!err)
+			asio::async_read_until(s->sock, s->request, "\r\n\r\n",
+				[this, s](err_t err, std::size_t) {
+					if (!err) respond(s);
+				});
+		accept_next();
+	});
+}
+
+void metrics_exporter_impl::respond(std::shared_ptr<session> s) {
+	std::istream request(&s->request);
+	std::string method, path;
+	request >> method >> path;
+	std::string status = "200 OK", body;
+	if (method != "GET")
+		status = "405 Method Not Allowed";
+	else if (path == "/metrics")
+		body = render();
+	else
+		status = "404 Not Found";
+	s->response = "HTTP/1.1 " + status +
+				  "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " +
+				  std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	asio::async_write(s->sock, asio::buffer(s->response), [s](err_t, std::size_t) {
+		lslboost::system::error_code ec;
+		s->sock.shutdown(tcp::socket::shutdown_both, ec);
+	});
+}
+
+std::string metrics_exporter_impl::render() {
+	// take a snapshot of the statistics, dropping the streams that are gone
+	std::vector<std::pair<std::string, lsl_outlet_stats>> outlets;
+	std::vector<std::pair<std::string, lsl_inlet_stats>> inlets;
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		for (auto it = outlets_.begin(); it != outlets_.end();) {
+			lsl_outlet_stats stats{};
+			stats.struct_size = sizeof(stats);
+			if (auto handle = it->handle.lock()) {
+				if (lsl_get_outlet_stats(handle.get(), &stats) == lsl_no_error)
+					outlets.emplace_back(it->labels, stats);
+				++it;
+			} else
+				it = outlets_.erase(it);
+		}
+		for (auto it = inlets_.begin(); it != inlets_.end();) {
+			lsl_inlet_stats stats{};
+			stats.struct_size = sizeof(stats);
+			if (auto handle = it->handle.lock()) {
+				if (lsl_get_inlet_stats(handle.get(), &stats) == lsl_no_error)
+					inlets.emplace_back(it->labels, stats);
+				++it;
+			} else
+				it = inlets_.erase(it);
+		}
+	}
+
+	std::ostringstream out;
+	write_metrics(out, std::begin(outlet_metrics), std::end(outlet_metrics), outlets);
+	write_metrics(out, std::begin(inlet_metrics), std::end(inlet_metrics), inlets);
+	write_summary(out, "lsl_inlet_latency_seconds",
+		"Receive time minus the time-corrected time stamp of the samples.", inlets, false);
+	write_summary(out, "lsl_inlet_buffer_residence_seconds",
+		"Time the samples waited in the inlet's buffer until they were pulled.", inlets, true);
+	if (resolver_) {
+		std::map<std::string, int> hosts;
+		for (const auto &info : resolver_->results()) ++hosts[info.hostname()];
+		write_header(out, "lsl_discovered_streams", "gauge", "Streams visible on the network.");
+		for (const auto &host : hosts)
+			write_value(out, "lsl_discovered_streams", "hostname=\"" + escape(host.first) + '"',
+				host.second);
+	}
+	return out.str();
+}
+
+metrics_exporter::metrics_exporter(uint16_t port, bool discover, const std::string &address) {
+	try {
+		impl_.reset(new metrics_exporter_impl(port, discover, address));
+	} catch (lslboost::system::system_error &e) {
+		throw std::runtime_error("Could not serve the metrics: " + std::string(e.what()));
+	}
+}
+
+metrics_exporter::~metrics_exporter() = default;
+
+void metrics_exporter::add(stream_outlet &outlet) {
+	const std::string labels = stream_labels(outlet.info());
+	std::lock_guard<std::mutex> lock(impl_->mut_);
+	impl_->outlets_.push_back({outlet.handle(), labels});
+}
+
+void metrics_exporter::add(stream_inlet &inlet, double timeout) {
+	const std::string labels = stream_labels(inlet.info(timeout));
+	std::lock_guard<std::mutex> lock(impl_->mut_);
+	impl_->inlets_.push_back({inlet.handle(), labels});
+}
+
+std::string metrics_exporter::render() { return impl_->render(); }
+
+uint16_t metrics_exporter::port() const { return impl_->port(); }
+
+} // namespace lsl
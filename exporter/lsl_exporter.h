@@ -0,0 +1,67 @@
+#pragma once
+
+#include <lsl_cpp.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @file lsl_exporter.h Prometheus exporter for the statistics of outlets and inlets.
+ *
+ * This is a separate library (lslexporter, CMake option LSL_BUILD_EXPORTER) on top of liblsl's
+ * statistics API (lsl_get_outlet_stats(), lsl_get_inlet_stats()).
+ */
+
+namespace lsl {
+
+/**
+ * Serves the statistics of registered outlets and inlets over HTTP, so a monitoring system
+ * (e.g. Prometheus) can scrape them from http://<host>:<port>/metrics.
+ *
+ * The metrics are in the Prometheus text exposition format:
+ * throughput (samples, bytes and chunks), dropped samples, buffer fill levels, reconnects,
+ * time synchronization round-trip times and, for inlets that track them (see
+ * stream_inlet::track_latency()), latency percentiles. Each series is labelled with the stream's
+ * name, type, source_id, hostname and uid. Optionally, the streams visible on the network are
+ * counted, too.
+ *
+ * The exporter only keeps weak references to the outlets and inlets, so they are dropped from
+ * the metrics once the application destroys them.
+ */
+class metrics_exporter {
+public:
+	/**
+	 * Start serving the metrics.
+	 * @param port The TCP port to listen at; 0 to let the OS pick one (see port()).
+	 * @param discover Whether to count the streams visible on the network (per host).
+	 * @param address The address to listen at, e.g. "127.0.0.1" to only serve local scrapers.
+	 * @throws std::runtime_error if the port can't be opened.
+	 */
+	explicit metrics_exporter(
+		uint16_t port = 9664, bool discover = true, const std::string &address = "0.0.0.0");
+
+	/// Stop serving the metrics.
+	~metrics_exporter();
+
+	/// Add the metrics of an outlet.
+	void add(stream_outlet &outlet);
+
+	/**
+	 * Add the metrics of an inlet.
+	 * @param inlet The inlet; its stream info is queried for the labels.
+	 * @param timeout How long to wait for the stream info.
+	 * @throws timeout_error if the stream info wasn't received in time.
+	 */
+	void add(stream_inlet &inlet, double timeout = 5.0);
+
+	/// Render the current metrics, as served over HTTP.
+	std::string render();
+
+	/// The port the metrics are served at.
+	uint16_t port() const;
+
+private:
+	std::unique_ptr<class metrics_exporter_impl> impl_;
+};
+
+} // namespace lsl
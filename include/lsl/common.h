@@ -80,6 +80,16 @@ typedef enum {
 	/** 64 bit integers. Support for this type is not yet exposed in all languages.
 	 * Also, some builds of liblsl will not be able to send or receive data of this type. */
 	cft_int64 = 7,
+	/** For 24-bit ADC values, stored and transmitted in 3 bytes (in the native byte order) but
+	 * pushed and pulled as int32_t (or any other numeric type). Values outside the 24-bit range
+	 * are truncated to their lower 24 bits. Older versions of liblsl can't use streams of this
+	 * type, and recordings store them as int32. */
+	cft_int24 = 8,
+	/** For display or inference streams that can do with IEEE 754 half precision (about 3 decimal
+	 * digits, up to 65504), stored and transmitted in 2 bytes but pushed and pulled as float (or
+	 * any other numeric type). Older versions of liblsl can't use streams of this type, and
+	 * recordings store them as float32. */
+	cft_float16 = 9,
 	/// Can not be transmitted.
 	cft_undefined = 0,
 
@@ -122,6 +132,14 @@ typedef enum {
 	 * uses somewhat more CPU. */
 	proc_threadsafe = 8,
 
+	/** Post-process the time stamps on the inlet's receive thread as the samples arrive instead
+	 * of in the pull calls, so the pulls don't wait for it.
+	 *
+	 * The dejittering then also sees the samples that are dropped because the inlet's buffer is
+	 * full. This only applies to the samples received after the flag is set; it is not part of
+	 * #proc_ALL. */
+	proc_receive_thread = 16,
+
 	/// The combination of all possible post-processing options.
 	proc_ALL = 1 | 2 | 4 | 8,
 
@@ -129,6 +147,73 @@ typedef enum {
 	_proc_maxval = 0x7f000000
 } lsl_processing_options_t;
 
+/// What an outlet does when an inlet's buffer is full, see lsl_set_overflow_policy().
+typedef enum {
+	/// Drop the oldest buffered sample to make room for the new one (the default).
+	ovf_drop_oldest = 0,
+
+	/// Drop the new sample, so the inlet gets the buffered samples without a gap.
+	ovf_drop_newest = 1,
+
+	/** Make the pushing thread wait (up to a timeout) until the inlet has caught up.
+	 *
+	 * This slows down the outlet's push calls for all inlets, so it's only suitable if the data
+	 * can't be dropped and the producer can afford to wait. */
+	ovf_block = 2,
+
+	/// While the inlet is lagging (its buffer is more than half full), keep only every k-th sample.
+	ovf_decimate = 3,
+
+	/** Keep only the newest sample: each new sample replaces the buffered one, so the inlet
+	 * always gets the latest value instead of a backlog, e.g. for a status display.
+	 *
+	 * The outlet only buffers a single sample for the inlet, and the inlet's own buffer holds at
+	 * most one sample, too; the replaced samples are counted as dropped. */
+	ovf_latest = 4,
+
+	// prevent compilers from assuming an instance fits in a single byte
+	_ovf_maxval = 0x7f000000
+} lsl_overflow_policy_t;
+
+/// How urgently an outlet serves an inlet's connection, see lsl_set_inlet_priority().
+typedef enum {
+	/// Throughput matters, latency doesn't, e.g. a recorder: served after the other connections.
+	prio_bulk = 0,
+
+	/// The default.
+	prio_normal = 1,
+
+	/// Latency matters, e.g. a closed-loop feedback consumer: served before the other connections.
+	prio_latency = 2,
+
+	// prevent compilers from assuming an instance fits in a single byte
+	_prio_maxval = 0x7f000000
+} lsl_transfer_priority_t;
+
+/// The roles of the threads liblsl starts, see lsl_set_thread_policy().
+typedef enum {
+	/// The IO threads of the outlets (and the shared IO thread pools) that serve the network.
+	lsl_thread_io = 0,
+
+	/// The threads that send an outlet's samples to its inlets (and play back recordings).
+	lsl_thread_transfer = 1,
+
+	/// The threads that receive the samples of inlets (and recordings).
+	lsl_thread_data = 2,
+
+	/// The threads that retrieve the full stream info of inlets.
+	lsl_thread_info = 3,
+
+	/// The threads that estimate the clock offsets of inlets.
+	lsl_thread_time = 4,
+
+	/// The threads that watch the connections of inlets and recover them.
+	lsl_thread_watchdog = 5,
+
+	// prevent compilers from assuming an instance fits in a single byte
+	_lsl_thread_role_maxval = 0x7f000000
+} lsl_thread_role_t;
+
 /// Possible error codes.
 typedef enum {
 	/// No error occurred
@@ -150,6 +235,182 @@ typedef enum {
 	_lsl_error_code_maxval = 0x7f000000
 } lsl_error_code_t;
 
+/**
+ * Transfer statistics of an outlet, see #lsl_get_outlet_stats.
+ *
+ * Later versions of liblsl may add counters at the end, so the caller sets struct_size to the
+ * size of the structure it knows (`sizeof(lsl_outlet_stats)`) and the library only fills that
+ * many bytes.
+ */
+typedef struct {
+	/// The size of the structure in bytes, set by the caller; the library sets it to the number of
+	/// bytes it filled in (less than the caller's size if the library is older).
+	uint32_t struct_size;
+	/// The number of samples pushed into the outlet.
+	uint64_t samples_pushed;
+	/// The number of samples sent to the consumers, summed over all consumers.
+	uint64_t samples_sent;
+	/// The number of bytes of sample data sent to the consumers.
+	uint64_t bytes_sent;
+	/// The number of chunks the samples were sent in; samples_sent / chunks_sent is the average
+	/// chunk size.
+	uint64_t chunks_sent;
+	/// The number of samples dropped because a consumer didn't keep up (see #lsl_dropped_samples).
+	uint64_t samples_dropped;
+	/// The number of currently connected consumers.
+	uint32_t consumers;
+	/// The number of samples waiting to be sent in the fullest consumer queue.
+	uint32_t max_queued;
+	/// The memory (in bytes) held by the outlet, the sum of the following four.
+	uint64_t memory_bytes;
+	/// The memory of the outlet's sample pool: the preallocated samples and those allocated when
+	/// the pool ran dry. Queued samples are held here, so it grows with the queues' contents.
+	uint64_t memory_samples;
+	/// The memory of the slots of the consumer queues (one per consumer) and the history.
+	uint64_t memory_queues;
+	/// The memory of the network buffers: the feed buffers of the data connections and the
+	/// receive buffers of the outlet's UDP servers.
+	uint64_t memory_network;
+	/// The memory of the cached stream info messages.
+	uint64_t memory_metadata;
+	/// The time (in seconds, summed over the consumers) chunks were held back to keep the
+	/// bandwidth limits (see #lsl_set_inlet_max_bandwidth).
+	double throttled_seconds;
+	/// The CPU time (in seconds) of the threads serving the outlet: the transfer threads of the
+	/// data connections and the outlet's IO threads (unless it uses the shared IO thread pool).
+	double cpu_seconds;
+} lsl_outlet_stats;
+
+/**
+ * Transfer statistics of an inlet, see #lsl_get_inlet_stats.
+ *
+ * Like #lsl_outlet_stats, it starts with its size, which the caller sets to
+ * `sizeof(lsl_inlet_stats)`.
+ */
+typedef struct {
+	/// The size of the structure in bytes, see lsl_outlet_stats.struct_size.
+	uint32_t struct_size;
+	/// The number of samples received from the outlet.
+	uint64_t samples_received;
+	/// The number of bytes received over the data connection.
+	uint64_t bytes_received;
+	/// The number of chunks the samples were received in; samples_received / chunks_received is
+	/// the average chunk size.
+	uint64_t chunks_received;
+	/// The number of samples dropped because the inlet's buffer was full.
+	uint64_t samples_dropped;
+	/// The number of samples currently available for pickup (see #lsl_samples_available).
+	uint32_t samples_available;
+	/// How often the data connection was established again after it had broken off.
+	uint32_t reconnects;
+	/// The round-trip time of the current time correction estimate, 0 if there's none yet.
+	double time_correction_rtt;
+	/// The number of samples whose end-to-end latency was recorded (see #lsl_track_latency).
+	uint64_t latency_count;
+	/// The median, 99th and 99.9th percentile (in seconds) of the end-to-end latency, i.e. the
+	/// time a sample was received minus its time-corrected time stamp.
+	double latency_p50, latency_p99, latency_p999;
+	/// The number of pulled samples whose time in the inlet's buffer was recorded.
+	uint64_t residence_count;
+	/// The median, 99th and 99.9th percentile (in seconds) of the time the samples spent in the
+	/// inlet's buffer until they were pulled.
+	double residence_p50, residence_p99, residence_p999;
+	/// The number of samples that were lost in transit and not repaired (only if the samples are
+	/// received as datagrams, see #lsl_set_inlet_datagrams).
+	uint64_t samples_lost;
+	/// The memory (in bytes) held by the inlet, the sum of the following four.
+	uint64_t memory_bytes;
+	/// The memory of the inlet's sample pools, which hold the buffered samples.
+	uint64_t memory_samples;
+	/// The memory of the slots of the inlet's sample buffer.
+	uint64_t memory_queues;
+	/// The memory of the network buffers: the receive buffers of the data connection and the
+	/// time synchronization.
+	uint64_t memory_network;
+	/// The size of the stream info message the inlet's full info was parsed from.
+	uint64_t memory_metadata;
+	/// The CPU time (in seconds) of the inlet's receive thread, which reads and decodes the
+	/// samples.
+	double cpu_seconds;
+	/// The number of chunks handed to the raw chunk callback straight from the received data,
+	/// i.e. without decoding their samples (see #lsl_set_raw_chunk_callback).
+	uint64_t chunks_passed_through;
+} lsl_inlet_stats;
+
+/// The samples an inlet missed before a pulled chunk, see #lsl_pull_chunk_seq.
+typedef struct {
+	/// The number of samples dropped because the inlet's buffer was full.
+	uint64_t dropped;
+	/// The number of samples that never arrived, e.g. while the connection was broken off or
+	/// because the outlet's buffer overflowed.
+	uint64_t lost;
+} lsl_chunk_gaps;
+
+/// A block of samples received by an inlet, see #lsl_set_raw_chunk_callback.
+typedef struct {
+	/// The channel values of all samples back to back (sample-major), in the byte order given by
+	/// little_endian. The block is only valid during the callback and not necessarily aligned.
+	const void *data;
+	/// The size of the data in bytes.
+	uint64_t num_bytes;
+	/// The number of samples, 0 if the stream has been lost.
+	uint32_t num_samples;
+	/// 1 if the values and time stamps are little endian, 0 if they're big endian.
+	int32_t little_endian;
+	/// The time stamp of the first sample.
+	double first_timestamp;
+	/// The time stamps of all samples (after the inlet's post-processing).
+	const double *timestamps;
+} lsl_raw_chunk;
+
+/// A window of an inlet's most recent samples, see #lsl_borrow_window.
+typedef struct {
+	/// The channel values of all samples back to back (sample-major), converted to the element
+	/// type of the window buffer; a contiguous block even if the ring wraps around.
+	const void *data;
+	/// The time stamps of all samples (after the inlet's post-processing).
+	const double *timestamps;
+	/// The number of samples, 0 if the timeout expired.
+	uint32_t num_samples;
+	/// The index of the first sample, counted since the window buffer was set.
+	uint64_t first;
+} lsl_window;
+
+/// Discovery traffic of the process (over all of its resolvers and outlets), see
+/// #lsl_get_discovery_stats.
+typedef struct {
+	/// The number of query packets sent by the resolvers.
+	uint64_t queries_sent;
+	/// The number of replies to these queries that were received (including duplicates of a
+	/// stream, e.g. over several protocols or multicast groups).
+	uint64_t replies_received;
+	/// The number of queries the outlets received (once per outlet and socket that got it).
+	uint64_t requests_received;
+	/// The number of replies the outlets sent.
+	uint64_t replies_sent;
+	/// The time (in seconds) the outlets spent answering the queries;
+	/// request_seconds / requests_received is the cost of a query.
+	double request_seconds;
+} lsl_discovery_stats;
+
+/// The number of buckets in the wait histogram of #lsl_lock_stats.
+#define LSL_LOCK_WAIT_BUCKETS 16
+
+/// The acquisitions of the liblsl-internal mutexes with a name, see #lsl_get_lock_stats.
+typedef struct {
+	/// The name of the mutexes, e.g. "consumer_queue" for those of all consumer queues.
+	char name[32];
+	/// The number of times the mutexes were acquired.
+	uint64_t acquisitions;
+	/// The number of acquisitions that had to wait for another thread to release the mutex.
+	uint64_t contended;
+	/// The total time (in seconds) the contended acquisitions waited.
+	double wait_seconds;
+	/// wait_histogram[i] counts the waits shorter than 2^i microseconds; the last bucket counts
+	/// the longer ones, too.
+	uint64_t wait_histogram[LSL_LOCK_WAIT_BUCKETS];
+} lsl_lock_stats;
+
 /// Return an explanation for the last error
 extern LIBLSL_C_API const char *lsl_last_error(void);
 
@@ -212,3 +473,125 @@ extern LIBLSL_C_API double lsl_local_clock();
  * no free() method is available (e.g., in some scripting languages).
  */
 extern LIBLSL_C_API void lsl_destroy_string(char *s);
+
+/**
+ * Start recording trace events of the data path.
+ *
+ * The events are recorded when samples are pushed into an outlet, queued in its send buffer,
+ * written to and received from the network, and pulled from an inlet. Each event carries the
+ * stream's UID and the sample's sequence number, so the path of a sample can be followed.
+ * This is only available if liblsl was built with the CMake option LSL_TRACING.
+ * @param max_events The maximum number of events that are kept; once it's reached, the oldest
+ * events are overwritten.
+ * @return An error code: #lsl_internal_error if liblsl was built without tracing support or
+ * tracing has already been started.
+ */
+extern LIBLSL_C_API int32_t lsl_start_tracing(uint32_t max_events);
+
+/**
+ * Stop recording trace events and write them to a file.
+ *
+ * The file is in the Chrome trace event format, which can be viewed with Perfetto
+ * (https://ui.perfetto.dev) or chrome://tracing.
+ * @param filename The name of the file to write (it's overwritten if it exists).
+ * @return The number of events written, or an error code (#lsl_internal_error if tracing wasn't
+ * started or the file couldn't be written).
+ */
+extern LIBLSL_C_API int32_t lsl_stop_tracing(const char *filename);
+
+/**
+ * Get the acquisitions of liblsl's internal mutexes.
+ *
+ * The mutexes whose contention limits the throughput (those of the consumer queues, the send
+ * buffers' consumer lists, the time stamp post-processing and the query caches) count how often
+ * they're acquired and how long the acquisitions wait for other threads. The counters only ever
+ * increase. This is only available if liblsl was built with the CMake option LSL_LOCK_STATS.
+ * @param[out] stats The array to fill with the statistics, one element per name.
+ * @param max_locks The number of elements of the array.
+ * @return The number of elements filled in, or an error code (#lsl_argument_error if stats is
+ * NULL, #lsl_internal_error if liblsl was built without lock statistics).
+ */
+extern LIBLSL_C_API int32_t lsl_get_lock_stats(lsl_lock_stats *stats, int32_t max_locks);
+
+/**
+ * Set the CPU affinity and scheduling priority of the liblsl threads with a role.
+ *
+ * The policy applies to the threads started afterwards, so it should be set before the outlets
+ * and inlets are created. The initial policies are read from the [threads] section of the config
+ * file, e.g. `DataCPUs = {4,5,8-11}` and `DataPriority = 80` (the roles are IO, Transfer, Data,
+ * Info, Time and Watchdog).
+ * @param role The role of the threads.
+ * @param cpus The CPUs (starting at 0) the threads may run on, or NULL to allow all of them.
+ * @param num_cpus The number of elements in cpus.
+ * @param priority The real-time priority (1-99, SCHED_FIFO on Linux; values above 50 request
+ * THREAD_PRIORITY_TIME_CRITICAL on Windows, others THREAD_PRIORITY_HIGHEST), or 0 to keep the
+ * default scheduling.
+ * @return An error code: #lsl_argument_error for an invalid role or priority.
+ */
+extern LIBLSL_C_API int32_t lsl_set_thread_policy(
+	lsl_thread_role_t role, const uint32_t *cpus, uint32_t num_cpus, int32_t priority);
+
+/// The body of a liblsl thread, see lsl_thread_starter.
+typedef void (*lsl_thread_body)(void *arg);
+
+/**
+ * A function that starts a liblsl thread, e.g. by running it on a worker of an application's
+ * thread pool.
+ *
+ * If it accepts the thread, it has to call body(arg) exactly once, on a thread that isn't used
+ * for anything else until body returns: the IO and data threads run as long as their outlet or
+ * inlet exists, and liblsl waits for the body to return when the object is destroyed. The thread
+ * policy of the role (see lsl_set_thread_policy()) isn't applied to accepted threads.
+ * @param role The role of the thread.
+ * @param name The name of the thread (e.g. for debuggers), only valid during the call.
+ * @param body The function to call.
+ * @param arg The argument to pass to body.
+ * @param user_data The value passed to lsl_set_thread_starter().
+ * @return 0 if the thread was accepted, any other value to let liblsl start its own thread.
+ */
+typedef int32_t (*lsl_thread_starter)(
+	lsl_thread_role_t role, const char *name, lsl_thread_body body, void *arg, void *user_data);
+
+/**
+ * Set the function that starts the threads of liblsl.
+ *
+ * It's called for each thread started afterwards, so it should be set before the outlets and
+ * inlets are created (and unset only after the threads it accepted were finished).
+ * @param starter The function, or NULL to let liblsl start its own threads.
+ * @param user_data A value passed to each call of the function.
+ * @return An error code (currently always #lsl_no_error).
+ */
+extern LIBLSL_C_API int32_t lsl_set_thread_starter(lsl_thread_starter starter, void *user_data);
+
+/**
+ * A function that's called when a data path allocates memory in the no-allocation mode, see
+ * lsl_allocation_violations().
+ *
+ * It's called on the thread that allocated, e.g. in the middle of a push or pull, so it should
+ * only count or flag the event.
+ * @param site What allocated the memory, e.g. "sample pool" or "feed buffer".
+ * @param user_data The value passed to lsl_set_allocation_handler().
+ */
+typedef void (*lsl_allocation_handler)(const char *site, void *user_data);
+
+/**
+ * Get the number of allocations of the data paths in the no-allocation mode.
+ *
+ * With `NoAllocation = 1` in the [tuning] section of the config file, the outlets and inlets
+ * preallocate the memory their pushes, pulls and transfers need once they're running (the sample
+ * pools, queues and feed buffers). This counts the allocations that still happen afterwards, e.g.
+ * because an outlet's pool is smaller than the samples its inlets buffer. Not covered are the
+ * strings of string streams, the history of lsl_set_outlet_history(), and the first pull of a
+ * thread (or the first one with a larger chunk), which sizes its buffers.
+ * @return The number of allocations since the library was loaded.
+ */
+extern LIBLSL_C_API uint64_t lsl_allocation_violations(void);
+
+/**
+ * Set a function that's called for each allocation counted by lsl_allocation_violations().
+ * @param handler The function, or NULL for none.
+ * @param user_data A value passed to each call of the function.
+ * @return An error code (currently always #lsl_no_error).
+ */
+extern LIBLSL_C_API int32_t lsl_set_allocation_handler(
+	lsl_allocation_handler handler, void *user_data);
@@ -1,4 +1,5 @@
 #pragma once
+#include "arrow.h"
 #include "common.h"
 #include "types.h"
 
@@ -40,6 +41,26 @@
  */
 extern LIBLSL_C_API lsl_inlet lsl_create_inlet(lsl_streaminfo info, int32_t max_buflen, int32_t max_chunklen, int32_t recover);
 
+/**
+ * Construct a new stream inlet that only receives some channels and/or every k-th sample.
+ *
+ * The outlet only sends the requested data, so e.g. a preview of a few channels of a high-channel
+ * count stream needs only a fraction of the bandwidth. Outlets with older versions of liblsl send
+ * the full stream and the inlet picks the requested data itself.
+ * The pulled samples have the requested channels, in the requested order. The stream info
+ * returned by lsl_get_fullinfo() still describes the full source stream.
+ * @param info A resolved stream info object, see lsl_create_inlet().
+ * @param max_buflen The maximum amount of data to buffer, see lsl_create_inlet().
+ * @param max_chunklen The maximum size, in samples, at which chunks are transmitted.
+ * @param recover Try to silently recover lost streams, see lsl_create_inlet().
+ * @param channels The indices of the channels to receive, or NULL to receive all channels.
+ * @param num_channels The number of elements in channels.
+ * @param decimation Receive only every decimation-th sample (1 to receive all samples).
+ * @return A newly created lsl_inlet handle or NULL in the event that an error occurred, e.g. if
+ * a channel index is out of range or decimation is 0.
+ */
+extern LIBLSL_C_API lsl_inlet lsl_create_inlet_subset(lsl_streaminfo info, int32_t max_buflen, int32_t max_chunklen, int32_t recover, const uint32_t *channels, uint32_t num_channels, uint32_t decimation);
+
 /**
 * Destructor.
 * The inlet will automatically disconnect if destroyed.
@@ -72,6 +93,21 @@ extern LIBLSL_C_API lsl_streaminfo lsl_get_fullinfo(lsl_inlet in, double timeout
  */
 extern LIBLSL_C_API void lsl_open_stream(lsl_inlet in, double timeout, int32_t *ec);
 
+/**
+ * Subscribe to the data streams of several inlets at once.
+ *
+ * All inlets start connecting before any of them is waited for, so their connects and handshakes
+ * overlap and opening many inlets (e.g. all streams of a recording) takes about as long as
+ * opening the slowest of them, instead of the sum of all of them.
+ * @param inlets The inlets to open.
+ * @param count The number of inlets.
+ * @param timeout The time all inlets together may take. Use LSL_FOREVER to effectively disable
+ * it.
+ * @param[out] ec An array of count error codes, one per inlet (see lsl_open_stream()), or NULL.
+ * @return The number of inlets whose stream has been opened.
+ */
+extern LIBLSL_C_API uint32_t lsl_open_streams(lsl_inlet *inlets, uint32_t count, double timeout, int32_t *ec);
+
 /**
 * Drop the current data stream.
 *
@@ -116,6 +152,21 @@ extern LIBLSL_C_API double lsl_time_correction(lsl_inlet in, double timeout, int
  */
 extern LIBLSL_C_API double lsl_time_correction_ex(lsl_inlet in, double *remote_time, double *uncertainty, double timeout, int32_t *ec);
 
+/**
+ * Get the latest time correction estimate for the given stream without waiting for one.
+ *
+ * Unlike #lsl_time_correction_ex, this never blocks, so it can be called as often as needed (e.g.
+ * for every chunk). The first call starts the estimation in the background.
+ * @param in The lsl_inlet object to act on.
+ * @param remote_time The time of the remote computer that was used to generate this time
+ * correction (may be NULL).
+ * @param uncertainty The maximum uncertainty of the given time correction (may be NULL).
+ * @param[out] ec Error code: if nonzero, can be either #lsl_timeout_error (if there's no estimate
+ * yet) or lsl_lost_error (if the stream source has been lost).
+ * @return The time correction estimate.
+ */
+extern LIBLSL_C_API double lsl_latest_time_correction(lsl_inlet in, double *remote_time, double *uncertainty, int32_t *ec);
+
 
 /**
  * Set post-processing flags to use.
@@ -263,6 +314,430 @@ extern LIBLSL_C_API unsigned long lsl_pull_chunk_str(lsl_inlet in, char **data_b
 
 extern LIBLSL_C_API unsigned long lsl_pull_chunk_buf(lsl_inlet in, char **data_buffer, uint32_t *lengths_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
 
+/** @defgroup lsl_pull_chunk_planar Pull a chunk of numeric data in channel-major order
+ *
+ * Like lsl_pull_chunk_f() etc., but the data buffer holds one array of
+ * `data_buffer_elements / channel_count` values per channel instead of one sample after another,
+ * e.g. for filters that process each channel separately.
+ *
+ * The samples are transposed in small blocks inside the library. If fewer samples than fit into
+ * the buffer are available, the end of each channel's array is left unchanged.
+ * @return data_elements_written Number of channel data elements written to the data buffer, i.e.
+ * the number of samples times the channel count.
+ * @{
+ */
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_f(lsl_inlet in, float *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_d(lsl_inlet in, double *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_l(lsl_inlet in, int64_t *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_i(lsl_inlet in, int32_t *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_s(lsl_inlet in, int16_t *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_planar_c(lsl_inlet in, char *data_buffer, double *timestamp_buffer, unsigned long data_buffer_elements, unsigned long timestamp_buffer_elements, double timeout, int32_t *ec);
+/// @}
+
+/**
+ * Pull a chunk of numeric data into a strided buffer of any element type and memory layout,
+ * e.g. a numpy or MATLAB array, without an intermediate multiplexed buffer.
+ *
+ * The value of channel c of the k-th sample is written to
+ * `(char *)data + k * sample_stride + c * channel_stride`, converted to the element type inside
+ * the library. The strides are in bytes and may be negative, so e.g. C-order arrays
+ * (`sample_stride = channel_count * element_size`, `channel_stride = element_size`),
+ * Fortran-order arrays (`sample_stride = element_size`, `channel_stride = max_samples *
+ * element_size`) and slices of larger arrays can be filled directly. The values don't need to
+ * be aligned.
+ * @param in The lsl_inlet object to act on.
+ * @param data The buffer to write the values to.
+ * @param element_type The type of the values in the buffer: #cft_float32, #cft_double64,
+ * #cft_int8, #cft_int16, #cft_int32 or #cft_int64.
+ * @param sample_stride,channel_stride The distance between consecutive samples and channels,
+ * in bytes.
+ * @param timestamp_buffer Room for max_samples time stamps, or NULL.
+ * @param max_samples The maximum number of samples to pull.
+ * @param timeout The timeout for this operation, if any. The default value of 0.0 will retrieve
+ * only data available for immediate pickup.
+ * @param[out] ec Error code: can be either no error, #lsl_lost_error (if the stream source has
+ * been lost) or #lsl_argument_error (for an unsupported element type).
+ * @return The number of samples (not elements) written.
+ */
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_strided(lsl_inlet in, void *data, lsl_channel_format_t element_type, int64_t sample_stride, int64_t channel_stride, double *timestamp_buffer, unsigned long max_samples, double timeout, int32_t *ec);
+
+/**
+ * Pull a multiplexed chunk of numeric data together with the sequence numbers of its samples and
+ * the number of samples that were missed since the previous call.
+ *
+ * The sequence numbers are assigned by the outlet and increase by 1 (or the decimation) from one
+ * sample to the next; a jump shows where samples are missing. Missing samples are counted
+ * separately as dropped by the inlet (its buffer was full, see #lsl_create_inlet) or lost before
+ * they arrived, e.g. in the outlet's buffer or while the connection was broken off (only known
+ * from the sequence numbers), so a recorder can tell data loss from a stall of the stream.
+ * Samples the inlet missed are also accounted for by the time stamp dejittering
+ * (#proc_dejitter), so it stays in sync with the sampling rate.
+ * @param in The lsl_inlet object to act on.
+ * @param data_buffer Room for max_samples multiplexed samples of the given element type.
+ * @param element_type The type of the values in the buffer: #cft_float32, #cft_double64,
+ * #cft_int8, #cft_int16, #cft_int32 or #cft_int64.
+ * @param timestamp_buffer Room for max_samples time stamps, or NULL.
+ * @param seq_buffer Room for max_samples sequence numbers, or NULL. A sequence number is 0 if
+ * the outlet doesn't send them: it only does for protocol 1.10 if it keeps a history or the
+ * inlet's configuration asks for them (`GapDetection` in the `[tuning]` section).
+ * @param max_samples The maximum number of samples to pull.
+ * @param[out] gaps Receives the number of samples missed since the previous call of this
+ * function (or since the inlet was created) up to the last pulled sample, or NULL.
+ * @param timeout The timeout for this operation, if any. The default value of 0.0 will retrieve
+ * only data available for immediate pickup.
+ * @param[out] ec Error code: can be either no error, #lsl_lost_error (if the stream source has
+ * been lost) or #lsl_argument_error (for an unsupported element type).
+ * @return The number of samples (not elements) written.
+ */
+extern LIBLSL_C_API unsigned long lsl_pull_chunk_seq(lsl_inlet in, void *data_buffer, lsl_channel_format_t element_type, double *timestamp_buffer, uint64_t *seq_buffer, unsigned long max_samples, lsl_chunk_gaps *gaps, double timeout, int32_t *ec);
+
+/**
+ * Pull a sample of a numeric stream in a sparse form: its nonzero channels as index/value pairs
+ * in channel order. The lsl_pull_sample_*() functions get the same samples in dense form.
+ * @param in The lsl_inlet object to act on.
+ * @param indices Receives the indices of the nonzero channels.
+ * @param values Receives their values.
+ * @param element_type The type of the values: #cft_float32, #cft_double64, #cft_int8,
+ * #cft_int16, #cft_int32 or #cft_int64.
+ * @param max_count The room for indices and values.
+ * @param[out] count The number of nonzero channels; if it's more than max_count, only the first
+ * max_count channels were retrieved.
+ * @param timeout The timeout for this operation, if any. Use #LSL_FOREVER to wait indefinitely.
+ * @param[out] ec Error code: can be either no error, #lsl_lost_error (if the stream source has
+ * been lost) or #lsl_argument_error (for an unsupported element type).
+ * @return The capture time of the sample on the remote machine, or 0.0 if no new sample was
+ * available (see lsl_pull_sample_f()).
+ */
+extern LIBLSL_C_API double lsl_pull_sample_sparse(lsl_inlet in, uint32_t *indices, void *values, lsl_channel_format_t element_type, uint32_t max_count, uint32_t *count, double timeout, int32_t *ec);
+
+/** @defgroup lsl_borrow_chunk Borrowing samples without copying them
+ * @{
+ */
+
+/**
+ * Borrow a chunk of queued samples without copying their channel data.
+ *
+ * The returned view gives read-only access to the channel data (in the stream's channel format
+ * and native byte order) and time stamps of the samples, which remain valid until the view is
+ * passed to lsl_return_chunk(). All views must be returned before the inlet is destroyed.
+ * String-formatted streams are not supported.
+ * @param in The lsl_inlet object to act on.
+ * @param max_samples The maximum number of samples to borrow.
+ * @param timeout The timeout for this operation, if any. The default value of 0.0 will retrieve
+ * only data available for immediate pickup.
+ * @param[out] ec Error code: can be either no error, #lsl_lost_error (if the stream source has
+ * been lost) or #lsl_argument_error (for string-formatted streams).
+ * @return A view of the borrowed samples (possibly empty), or NULL if an error occurred.
+ */
+extern LIBLSL_C_API lsl_sample_view lsl_borrow_chunk(lsl_inlet in, uint32_t max_samples, double timeout, int32_t *ec);
+
+/// The number of samples in a view.
+extern LIBLSL_C_API uint32_t lsl_view_samples(lsl_sample_view view);
+
+/// The post-processed time stamps of the samples in a view, one per sample.
+extern LIBLSL_C_API const double *lsl_view_timestamps(lsl_sample_view view);
+
+/// The channel data of the sample at position `index` in a view, or NULL if it's out of range.
+extern LIBLSL_C_API const void *lsl_view_data(lsl_sample_view view, uint32_t index);
+
+/// Return the samples of a view to the inlet and destroy the view.
+extern LIBLSL_C_API void lsl_return_chunk(lsl_sample_view view);
+
+/**
+ * Pull a chunk of samples into an Apache Arrow C Data Interface struct array.
+ *
+ * The array has one row per sample and a float64 column `timestamp` with the post-processed time
+ * stamps, followed by one column per channel that is named by the channel index ("0", "1", ...)
+ * and has the stream's channel format: int24 channels are widened to int32, float16 channels
+ * are half floats and string channels are utf8. None of the columns have nulls.
+ *
+ * The samples are copied straight from the inlet's queue into the columns, whose buffers are
+ * owned by the library until the array's and the schema's release callbacks are called (which
+ * may happen after the inlet has been destroyed).
+ * @param in The lsl_inlet object to act on.
+ * @param[out] array,schema Filled with the chunk and its type (unless an error occurred); the
+ * caller has to release them.
+ * @param max_samples The maximum number of samples to pull.
+ * @param timeout The timeout for this operation, if any. The default value of 0.0 will retrieve
+ * only data available for immediate pickup.
+ * @param[out] ec Error code: can be either no error or #lsl_lost_error (if the stream source has
+ * been lost).
+ * @return The number of samples pulled, i.e. the array's length.
+ */
+extern LIBLSL_C_API uint32_t lsl_pull_chunk_arrow(lsl_inlet in, struct ArrowArray *array, struct ArrowSchema *schema, uint32_t max_samples, double timeout, int32_t *ec);
+
+/**
+ * A function that is called once samples are available, see lsl_async_wait_for_samples().
+ * @param in The inlet that was waited on.
+ * @param ec #lsl_no_error if the samples are available, or #lsl_lost_error if the stream has been
+ * lost (or the inlet is being destroyed) before they arrived.
+ * @param user_data The pointer passed to lsl_async_wait_for_samples().
+ */
+typedef void (*lsl_samples_callback)(lsl_inlet in, int32_t ec, void *user_data);
+
+/**
+ * Request a single callback once at least `min_samples` samples are available for pickup.
+ *
+ * This doesn't block: the callback is invoked exactly once, either right away (if the samples are
+ * available already) or from the inlet's data thread as soon as they have been received. It can
+ * then pull them without waiting, or (better) hand this off to an event loop, e.g. by posting to
+ * an io_context that resumes a coroutine. The inlet must only be destroyed once all its callbacks
+ * have been invoked or from a thread that isn't waiting for them, and pending callbacks are
+ * invoked with #lsl_lost_error during its destruction.
+ * This implicitly opens the stream. Samples delivered to a chunk callback (see
+ * lsl_set_chunk_callback()) don't count.
+ * @return #lsl_no_error, or an error code if the request couldn't be registered.
+ */
+extern LIBLSL_C_API int32_t lsl_async_wait_for_samples(lsl_inlet in, uint32_t min_samples, lsl_samples_callback callback, void *user_data);
+
+/**
+ * A function that receives chunks of samples from an inlet, see lsl_set_chunk_callback().
+ * @param in The inlet that received the samples.
+ * @param view A view of the samples, which is only valid during the call and must not be passed
+ * to lsl_return_chunk(). An empty view signals that the stream has been lost.
+ * @param user_data The pointer passed to lsl_set_chunk_callback().
+ */
+typedef void (*lsl_chunk_callback)(lsl_inlet in, lsl_sample_view view, void *user_data);
+
+/**
+ * Deliver received chunks to a callback instead of queueing them for pull calls.
+ *
+ * The callback is invoked from the inlet's data thread as soon as a chunk has been received, so it
+ * should return quickly. This implicitly opens the stream. Samples aren't queued while a callback
+ * is set, so pull calls won't return any. Passing NULL as callback queues the samples again;
+ * once this function returns, the previous callback won't be called anymore. The callback may
+ * replace or remove itself. String-formatted streams are not supported.
+ * @return #lsl_no_error, or #lsl_argument_error for string-formatted streams.
+ */
+extern LIBLSL_C_API int32_t lsl_set_chunk_callback(lsl_inlet in, lsl_chunk_callback callback, void *user_data);
+
+/**
+ * A function that receives blocks of samples from an inlet, see lsl_set_raw_chunk_callback().
+ * @param in The inlet that received the samples.
+ * @param chunk The samples, which are only valid during the call. A chunk without samples
+ * signals that the stream has been lost.
+ * @param user_data The pointer passed to lsl_set_raw_chunk_callback().
+ */
+typedef void (*lsl_raw_chunk_callback)(lsl_inlet in, const lsl_raw_chunk *chunk, void *user_data);
+
+/**
+ * Deliver the received chunks to a callback as blocks of bytes instead of queueing them, e.g. for
+ * recorders that write the samples to disk without looking at them.
+ *
+ * For streams received with sample framing (the default for numeric streams), each frame's values
+ * are handed over straight from the receive buffer, so the samples are neither decoded one by one
+ * nor queued; the inlet only converts the byte order if necessary and fills in the time stamps.
+ * If the inlet has to process the samples itself (e.g. to select channels, or to decimate, filter
+ * or resample them) or tracks their latencies, the processed samples are copied into a block
+ * (#lsl_inlet_stats counts the chunks that were handed over straight as chunks_passed_through).
+ * The callback is invoked from the inlet's data thread, so it should return quickly. This
+ * implicitly opens the stream. Samples aren't queued while a callback is set, so pull calls won't
+ * return any; a chunk callback (see lsl_set_chunk_callback()) takes precedence. Passing NULL as
+ * callback queues the samples again; once this function returns, the previous callback won't be
+ * called anymore. The callback may replace or remove itself. String-formatted streams are not
+ * supported.
+ * @return #lsl_no_error, or #lsl_argument_error for string-formatted streams.
+ */
+extern LIBLSL_C_API int32_t lsl_set_raw_chunk_callback(lsl_inlet in, lsl_raw_chunk_callback callback, void *user_data);
+
+/**
+ * A function that's called once samples have been written into a target buffer, see
+ * lsl_set_target_buffer().
+ * @param in The inlet that received the samples.
+ * @param first The index of the first sample, counted from 0 since the buffer was set; it's in
+ * slot `first % capacity`.
+ * @param count The number of samples, which occupy contiguous slots (a chunk that wraps around
+ * the end of the ring is reported in two calls). 0 signals that the stream has been lost.
+ * @param user_data The pointer passed to lsl_set_target_buffer().
+ */
+typedef void (*lsl_target_callback)(lsl_inlet in, uint64_t first, uint32_t count, void *user_data);
+
+/**
+ * Write the received samples straight into a ring buffer of the application, e.g. pinned memory
+ * that's copied to a GPU, instead of queueing them for pull calls.
+ *
+ * The ring holds `capacity` samples in channel-major (planar) order: the value of channel c of
+ * the sample in slot s is at element `c * capacity + s` of data, its post-processed time stamp in
+ * `timestamps[s]`. The inlet's data thread converts each received chunk into the free slots and
+ * then invokes the callback, which should return quickly. Once the application has consumed the
+ * samples, it gives their slots back with lsl_release_target_samples(); samples that arrive
+ * while the ring is full are dropped (and counted in the inlet's statistics).
+ * This implicitly opens the stream. Pull calls won't return any samples while a buffer is set.
+ * Passing NULL as data queues the samples again; once this function returns, the previous buffer
+ * won't be written anymore. String-formatted streams are not supported.
+ * @param data The ring, with room for capacity * channel_count values of element_type.
+ * @param element_type The type of the values (any numeric format, independent of the stream's).
+ * @param timestamps Room for capacity time stamps, or NULL.
+ * @param capacity The number of samples the ring can hold.
+ * @return #lsl_no_error, or #lsl_argument_error for string-formatted streams or element types or
+ * an empty ring.
+ */
+extern LIBLSL_C_API int32_t lsl_set_target_buffer(lsl_inlet in, void *data, lsl_channel_format_t element_type, double *timestamps, uint32_t capacity, lsl_target_callback callback, void *user_data);
+
+/**
+ * Give the oldest `count` samples of the ring set with lsl_set_target_buffer() back to the inlet,
+ * so it can write new samples into their slots.
+ * @return #lsl_no_error, or #lsl_argument_error if fewer samples haven't been released yet.
+ */
+extern LIBLSL_C_API int32_t lsl_release_target_samples(lsl_inlet in, uint32_t count);
+
+/**
+ * Keep the recent samples in a ring of the library instead of queueing them for pull calls, so
+ * windows of them (e.g. the last 10 seconds for a classifier) can be borrowed without copying.
+ *
+ * The ring holds the samples in sample-major order, converted to element_type. Its memory is
+ * mapped twice back to back, so any window is a single contiguous block, even if it wraps around
+ * the end of the ring (see lsl_borrow_window()). The inlet's data thread overwrites the oldest
+ * samples, except those of a borrowed window: samples that would overwrite it are dropped (and
+ * counted in the inlet's statistics). This implicitly opens the stream. Passing 0 as capacity
+ * queues the samples again. String-formatted streams are not supported.
+ * @param element_type The type of the values (any numeric format, independent of the stream's).
+ * @param min_capacity The number of samples to keep at least; it's rounded up to whole pages.
+ * @param[out] ec Error code: #lsl_argument_error for string-formatted streams or element types,
+ * or while a window is borrowed; #lsl_internal_error if the memory couldn't be mapped.
+ * @return The number of samples the ring holds.
+ */
+extern LIBLSL_C_API uint32_t lsl_set_window_buffer(lsl_inlet in, lsl_channel_format_t element_type, uint32_t min_capacity, int32_t *ec);
+
+/**
+ * Borrow the most recent samples of the ring set with lsl_set_window_buffer().
+ *
+ * Waits until at least num_samples samples have been received and, if a window was borrowed
+ * before, at least one of them is newer than that window. The window stays valid (and its
+ * samples aren't overwritten) until it's given back with lsl_release_window(); only one window
+ * can be borrowed at a time.
+ * @param num_samples The size of the window, at most the capacity of the ring.
+ * @param timeout The timeout for this operation, if any.
+ * @param[out] ec Error code: #lsl_lost_error if the stream source has been lost, or
+ * #lsl_argument_error if there's no ring, the window is too large or the previous one hasn't been
+ * released.
+ * @return The window, without samples if the timeout expired or an error occurred.
+ */
+extern LIBLSL_C_API lsl_window lsl_borrow_window(lsl_inlet in, uint32_t num_samples, double timeout, int32_t *ec);
+
+/**
+ * Give the window borrowed with lsl_borrow_window() back, so its samples can be overwritten.
+ * @return #lsl_no_error, or #lsl_argument_error if no window is borrowed.
+ */
+extern LIBLSL_C_API int32_t lsl_release_window(lsl_inlet in);
+
+/// @}
+
+/** @defgroup lsl_inlet_set Waiting on multiple inlets
+ * @{
+ */
+
+/**
+ * Create an empty inlet set.
+ *
+ * A single thread can wait on an inlet set until any of its inlets has data available, instead
+ * of polling each inlet or dedicating a thread to it. A set must only be used from one thread at
+ * a time.
+ * @return A new inlet set, or NULL in the event that an error occurred.
+ */
+extern LIBLSL_C_API lsl_inlet_set lsl_create_inlet_set(void);
+
+/// Destroy an inlet set. The inlets themselves are not affected.
+extern LIBLSL_C_API void lsl_destroy_inlet_set(lsl_inlet_set set);
+
+/**
+ * Add an inlet to a set.
+ *
+ * An inlet can only be a member of one set at a time and has to be removed before it's destroyed.
+ * This implicitly opens the inlet's stream, without waiting for the connection.
+ * @return #lsl_no_error, or #lsl_argument_error if the inlet is already a member of the set.
+ */
+extern LIBLSL_C_API int32_t lsl_inlet_set_add(lsl_inlet_set set, lsl_inlet in);
+
+/// Remove an inlet from a set. Does nothing if the inlet isn't a member.
+extern LIBLSL_C_API void lsl_inlet_set_remove(lsl_inlet_set set, lsl_inlet in);
+
+/**
+ * Wait until at least one inlet of a set has `min_samples` samples available.
+ *
+ * Inlets whose stream has been lost count as ready, so the next pull reports the loss.
+ * @param set The inlet set to wait on.
+ * @param min_samples The number of samples an inlet needs to have available to be ready.
+ * @param[out] ready_buffer Receives the ready inlets, in the order they were added.
+ * @param ready_buffer_elements The capacity of ready_buffer.
+ * @param timeout The maximum time to wait, in seconds; 0.0 only checks the inlets.
+ * @param[out] ec Error code: can be either no error or #lsl_internal_error.
+ * @return The number of inlets written to ready_buffer, 0 if the timeout expired.
+ */
+extern LIBLSL_C_API uint32_t lsl_inlet_set_wait(lsl_inlet_set set, uint32_t min_samples, lsl_inlet *ready_buffer, uint32_t ready_buffer_elements, double timeout, int32_t *ec);
+
+/// @}
+
+/** @defgroup lsl_pull_chunks Pull the available data of multiple inlets at once
+ *
+ * Like calling lsl_pull_chunk_f() etc. with a timeout of 0.0 for each inlet, but in a single call
+ * (e.g. to save the per-call overhead of language bindings). Only the data available for
+ * immediate pickup is pulled; to wait until any of the inlets has data, use an inlet set
+ * (lsl_inlet_set_wait()).
+ * @param inlets An array of count inlets.
+ * @param count The number of inlets.
+ * @param[out] data_buffers For each inlet, a buffer for the multiplexed channel data.
+ * @param[out] timestamp_buffers For each inlet, a buffer for the time stamps that holds
+ * `data_buffer_elements[k] / channel_count` values, or NULL. If this is NULL, no time stamps are
+ * returned at all.
+ * @param data_buffer_elements For each inlet, the size of its data buffer, in channel data
+ * elements. Must be a multiple of the stream's channel count.
+ * @param[out] samples_written Receives the number of samples pulled from each inlet.
+ * @param[out] ec Receives an error code for each inlet (no error, #lsl_lost_error or
+ * #lsl_argument_error), or NULL.
+ * @return The number of samples pulled from all inlets together.
+ * @{
+ */
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_f(const lsl_inlet *inlets, uint32_t count, float *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_d(const lsl_inlet *inlets, uint32_t count, double *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_l(const lsl_inlet *inlets, uint32_t count, int64_t *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_i(const lsl_inlet *inlets, uint32_t count, int32_t *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_s(const lsl_inlet *inlets, uint32_t count, int16_t *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+extern LIBLSL_C_API unsigned long lsl_pull_chunks_c(const lsl_inlet *inlets, uint32_t count, char *const *data_buffers, double *const *timestamp_buffers, const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec);
+/// @}
+
+/** @defgroup lsl_recording Recording inlets into XDF files
+ * @{
+ */
+
+/**
+ * Create a recording into a new XDF file (see https://github.com/sccn/xdf).
+ *
+ * The samples of the recorded inlets are taken over right after they're received, without
+ * queueing them or copying them into user buffers, and written with their original time stamps
+ * (plus the clock offsets measured by the time synchronization) by a dedicated I/O thread.
+ * @param filename The name of the file; an existing file is overwritten.
+ * @return A new recording, or NULL if the file couldn't be created (see lsl_last_error()).
+ */
+extern LIBLSL_C_API lsl_recording lsl_create_recording(const char *filename);
+
+/// Stop recording all inlets and close the file. The inlets themselves are not affected.
+extern LIBLSL_C_API void lsl_destroy_recording(lsl_recording rec);
+
+/**
+ * Start recording an inlet.
+ *
+ * An inlet can only be recorded by one recording at a time and has to be removed before it's
+ * destroyed. While it's recorded, its samples can't be pulled (and it mustn't have a chunk
+ * callback). This implicitly opens the inlet's stream, without waiting for the connection.
+ * @param rec The recording.
+ * @param in The inlet to record.
+ * @param timeout How long to wait for the inlet's full stream info, which is written as the
+ * stream header.
+ * @return #lsl_no_error, #lsl_timeout_error, #lsl_lost_error, or #lsl_argument_error if the
+ * inlet is already recorded.
+ */
+extern LIBLSL_C_API int32_t lsl_recording_add(lsl_recording rec, lsl_inlet in, double timeout);
+
+/**
+ * Stop recording an inlet and write its stream footer. Does nothing if it isn't recorded.
+ *
+ * Afterwards, newly received samples are queued for pull calls again.
+ */
+extern LIBLSL_C_API void lsl_recording_remove(lsl_recording rec, lsl_inlet in);
+
+/// @}
+
 /**
 * Query whether samples are currently available for immediate pickup.
 *
@@ -273,6 +748,34 @@ extern LIBLSL_C_API unsigned long lsl_pull_chunk_buf(lsl_inlet in, char **data_b
 */
 extern LIBLSL_C_API uint32_t lsl_samples_available(lsl_inlet in);
 
+/**
+* Get the transfer statistics of an inlet.
+*
+* The counters are updated as the data arrives, so this is cheap enough to be polled regularly,
+* e.g. to monitor the health of a stream. This doesn't open the stream or start the time
+* synchronization.
+* @param in The lsl_inlet object to act on.
+* @param[in,out] stats The structure to fill with the statistics; its struct_size has to be set
+* to `sizeof(lsl_inlet_stats)`, and only that many bytes are filled.
+* @return An error code: #lsl_argument_error if struct_size isn't set.
+*/
+extern LIBLSL_C_API int32_t lsl_get_inlet_stats(lsl_inlet in, lsl_inlet_stats *stats);
+
+/**
+* Record the latencies of an inlet's samples in histograms (see #lsl_get_inlet_stats).
+*
+* Two latencies are recorded: the end-to-end latency (the local time a sample is received minus
+* its time stamp, corrected by the current time correction estimate, so this starts the time
+* synchronization) and the time a sample waits in the inlet's buffer until it's pulled. Each
+* costs a clock read per received chunk or pull call and an atomic increment per sample.
+* The values have a resolution of about 3%.
+* @param in The lsl_inlet object to act on.
+* @param enabled Nonzero to start with empty histograms, 0 to stop recording (the recorded values
+* are kept).
+* @return An error code.
+*/
+extern LIBLSL_C_API int32_t lsl_track_latency(lsl_inlet in, int32_t enabled);
+
 /// Drop all queued not-yet pulled samples, return the nr of dropped samples
 extern LIBLSL_C_API uint32_t lsl_inlet_flush(lsl_inlet in);
 
@@ -300,4 +803,301 @@ extern LIBLSL_C_API uint32_t lsl_was_clock_reset(lsl_inlet in);
  */
 extern LIBLSL_C_API int32_t lsl_smoothing_halftime(lsl_inlet in, float value);
 
+/**
+ * Set how long pull calls spin, waiting for new samples, before they block.
+ *
+ * Blocking and waking up a thread adds tens of microseconds to the latency of a pull call.
+ * Spinning avoids this at the cost of keeping a CPU core busy for up to the spin time per call.
+ * The default is 0 (always block) unless a different value is set in the config file
+ * ([tuning] PullSpinTime).
+ * @param in The lsl_inlet object to act on.
+ * @param seconds The maximum spin time per pull call, in seconds (e.g. 0.0005).
+ * @return The error code: if nonzero, can be #lsl_argument_error for a negative spin time.
+ */
+extern LIBLSL_C_API int32_t lsl_set_pull_spin_time(lsl_inlet in, double seconds);
+
+/**
+ * Let pull_chunk calls with a timeout return as soon as a minimum number of samples is available.
+ *
+ * By default, a pull_chunk (or lsl_borrow_chunk) call with a timeout blocks until the whole
+ * buffer is filled. With a minimum set, it waits until at least min_samples samples are
+ * available and then returns them together with any further available samples, up to the buffer
+ * size. The pulling thread is only woken up once the samples are there, so e.g. a consumer
+ * processing windows of 32 samples wakes up once per window instead of once per sample.
+ * @param in The lsl_inlet object to act on.
+ * @param min_samples The number of samples to wait for, 0 to wait for a full buffer.
+ * @return The error code: if nonzero, the setting couldn't be applied.
+ */
+extern LIBLSL_C_API int32_t lsl_set_pull_min_samples(lsl_inlet in, uint32_t min_samples);
+
+/**
+ * Set the socket options of the inlet's data connection.
+ *
+ * Takes effect when the stream is (re-)opened. The defaults are set in the configuration file
+ * ([tuning] SocketSendBufferBytes, SocketReceiveBufferBytes, TCPNoDelay and
+ * SocketBusyPollMicros). The receive buffer limits the TCP window, so links with a large
+ * bandwidth-delay product need one of at least the bandwidth times the round-trip time.
+ * @param in The lsl_inlet object to act on.
+ * @param send_buffer_bytes The socket send buffer size (SO_SNDBUF), 0 for the system default.
+ * @param receive_buffer_bytes The socket receive buffer size (SO_RCVBUF), 0 for the system
+ * default.
+ * @param no_delay 1 to disable Nagle's algorithm (TCP_NODELAY, the default), 0 to enable it.
+ * @param busy_poll_us How long socket reads busy-poll the device in microseconds (SO_BUSY_POLL,
+ * Linux only), 0 to disable it.
+ * Negative values keep the current setting.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_socket_options(lsl_inlet in, int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us);
+
+/**
+ * Ask the outlet to send the samples by multicast (see lsl_set_outlet_multicast()).
+ *
+ * Takes effect when the stream is (re-)opened. Lost datagrams are requested again over the data
+ * connection; if the datagrams stop arriving, the inlet receives the samples over TCP again.
+ * Inlets with a channel subset, decimation or a history request (see lsl_request_history()) and
+ * string streams always use TCP. The default is set in the configuration file
+ * ([tuning] MulticastData).
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to ask for multicast delivery, 0 to use TCP only.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_multicast(lsl_inlet in, int32_t enabled);
+
+/**
+ * Ask the outlet to send the samples as UDP datagrams that aren't retransmitted when lost.
+ *
+ * For real-time consumers that would rather skip a sample than wait for it: a lost packet
+ * doesn't stall the following samples as it does with TCP. The lost samples are counted in the
+ * `samples_lost` field of the inlet's statistics (see lsl_get_inlet_stats()). The data connection
+ * stays open; if the datagrams don't arrive (e.g. because of a firewall), the inlet receives the
+ * samples over TCP again. Takes effect when the stream is (re-)opened and takes precedence over
+ * lsl_set_inlet_multicast(); the same restrictions apply. The default is set in the configuration
+ * file ([tuning] DatagramData).
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to ask for datagrams, 0 to use TCP only.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_datagrams(lsl_inlet in, int32_t enabled);
+
+/**
+ * Take the samples straight from the outlet's send buffer if the outlet is in the same process.
+ *
+ * The inlet then shares the outlet's samples instead of receiving them over a loopback TCP
+ * connection, so they aren't serialized or copied (except for samples whose time stamps the
+ * inlet deduces, e.g. all but the first sample of a chunk pushed with a single time stamp).
+ * Outlets in other processes are still received over TCP. Channel subsets and decimation (see
+ * lsl_create_inlet_subset()) need the outlet's help, so such inlets always use TCP. Takes effect
+ * when the stream is (re-)opened and takes precedence over lsl_set_inlet_multicast() and
+ * lsl_set_inlet_datagrams(). The default is set in the configuration file ([tuning]
+ * InProcessData).
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to take the samples from outlets in this process directly, 0 to use TCP.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_in_process(lsl_inlet in, int32_t enabled);
+
+/**
+ * Receive the samples over a connection that is shared with the other streams of the outlet's
+ * process.
+ *
+ * All bundling inlets of a process that receive streams from the same remote host share one TCP
+ * connection, served by the outlets' process, instead of one connection (and one sender thread)
+ * per stream. Only numeric streams that are received in full can be bundled; others, channel
+ * subsets and decimated streams, and streams whose outlets don't support bundling (or live in
+ * another process on that host than the one of the shared connection) are still received over
+ * a connection of their own. Takes effect when the stream is (re-)opened; in-process outlets (see
+ * lsl_set_inlet_in_process()) take precedence. The default is set in the configuration file
+ * ([tuning] BundleData).
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to share a connection with the outlet's other streams, 0 for a connection of
+ * its own.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_bundling(lsl_inlet in, int32_t enabled);
+
+/**
+ * Receive the samples of an outlet in another process on the same host through shared memory.
+ *
+ * The outlet writes the samples into a ring of shared memory (POSIX only) that the inlet reads
+ * from, so they don't go through the loopback network stack; the data connection only wakes up
+ * the inlet when it's idle. Only numeric streams that are received in full can be passed this
+ * way; others, and outlets on other hosts or without shared memory support, are still received
+ * over TCP (or as datagrams, see lsl_set_inlet_datagrams()). Samples the inlet falls too far
+ * behind on are dropped and counted in lsl_inlet_stats.samples_lost. Takes effect when the stream
+ * is (re-)opened; in-process outlets (see lsl_set_inlet_in_process()) and bundled connections
+ * (see lsl_set_inlet_bundling()) take precedence. The default is set in the configuration file
+ * ([tuning] SharedMemoryData).
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to ask for shared memory, 0 to use the network.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_shared_memory(lsl_inlet in, int32_t enabled);
+
+/**
+ * Resample the stream to a fraction of its rate, e.g. to display a high-rate stream.
+ *
+ * The samples are low-pass filtered and resampled to up/down times the nominal rate by a polyphase
+ * FIR filter in the inlet's receive thread, so the pulled samples (and their time stamps) are
+ * those of the resampled stream. If server_side is set and the outlet supports it, the outlet
+ * resamples the stream instead, so only the resampled samples are transmitted; otherwise (or if
+ * the outlet doesn't) the inlet does. Takes effect when the stream is (re-)opened.
+ * @param in The lsl_inlet object to act on.
+ * @param up, down The rate conversion factors (e.g. 1 and 10 to decimate by 10); equal factors
+ * to receive the samples as they are.
+ * @param server_side 1 to let the outlet resample the stream if it can, 0 to resample it locally.
+ * @return The error code: if nonzero, can be #lsl_argument_error for string streams, streams with
+ * an irregular rate, decimated inlets (see lsl_create_inlet_subset()) and factors that are 0 or
+ * above 1024 (after reducing them by their common divisor), or #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_resampling(lsl_inlet in, uint32_t up, uint32_t down, int32_t server_side);
+
+/**
+ * Receive only the samples whose first channel has one of the given values, e.g. the few event
+ * types of a marker stream a consumer is interested in.
+ *
+ * A sample of a string stream matches if its value equals one of the values or starts with one of
+ * the prefixes, a sample of a numeric stream if its value lies in one of the ranges (with
+ * inclusive bounds). The outlet only sends the matching samples if it supports value filters,
+ * otherwise the inlet drops the others. Takes effect when the stream is (re-)opened.
+ * @param in The lsl_inlet object to act on.
+ * @param values, num_values The values of a string stream to receive.
+ * @param prefixes, num_prefixes The prefixes of the values of a string stream to receive.
+ * @param ranges, num_ranges The ranges of the values of a numeric stream to receive, as pairs of
+ * a lower and an upper bound (2 * num_ranges doubles).
+ * Without any values, prefixes or ranges, all samples are received.
+ * @return The error code: if nonzero, can be #lsl_argument_error for values or prefixes for a
+ * numeric stream, ranges for a string stream or a range whose lower bound is above its upper
+ * bound, or #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_value_filter(lsl_inlet in, const char *const *values, uint32_t num_values, const char *const *prefixes, uint32_t num_prefixes, const double *ranges, uint32_t num_ranges);
+
+/**
+ * Convert the channel values to physical units (e.g. ADC counts to microvolts) while the samples
+ * are pulled into float or double buffers.
+ *
+ * Channel k of a sample is pulled as `value * gains[k] + offsets[k]`. The scaling happens in the
+ * same pass as the conversion of the values, so it costs next to nothing compared to a second
+ * pass over the pulled chunk. It applies to lsl_pull_sample_f() / _d() and lsl_pull_chunk_f() /
+ * _d() (multiplexed and planar); pulls into buffers of other types, chunk callbacks, target
+ * buffers and window buffers get the raw values. Takes effect with the next pull.
+ * @param in The lsl_inlet object to act on.
+ * @param gains The gain of each channel (channel_count values), or NULL for gains of 1.
+ * @param offsets The offset of each channel (channel_count values), or NULL for offsets of 0.
+ * Without gains and offsets, the values aren't calibrated anymore.
+ * @return The error code: if nonzero, can be #lsl_argument_error for string streams or
+ * #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_calibration(lsl_inlet in, const double *gains, const double *offsets);
+
+/**
+ * Calibrate the pulls (see lsl_set_inlet_calibration()) with the gains and offsets in the
+ * stream's description: the `gain` and `offset` child elements of the `channel` entries of its
+ * `channels` element, in the order of the channels. Channels without them get a gain of 1 and an
+ * offset of 0. An inlet that only receives some channels (see lsl_create_inlet_subset()) uses
+ * the entries of these channels.
+ * @param in The lsl_inlet object to act on.
+ * @param timeout The time to wait for the stream's description, see lsl_get_fullinfo().
+ * @return The error code: if nonzero, can be #lsl_timeout_error, #lsl_lost_error,
+ * #lsl_argument_error for string streams or #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_calibration_from_desc(lsl_inlet in, double timeout);
+
+/**
+ * Request the samples the outlet pushed during the last seconds when the stream is opened.
+ *
+ * The outlet has to keep a history (see lsl_set_outlet_history()); the samples are queued before
+ * any newly pushed samples, so e.g. a visualizer can fill its display window right away.
+ * This has to be called before the stream is opened (see lsl_open_stream()).
+ * @param in The lsl_inlet object to act on.
+ * @param seconds The amount of data to request, in seconds; 0 to only receive new samples.
+ * @return The error code: if nonzero, can be #lsl_argument_error for a negative duration.
+ */
+extern LIBLSL_C_API int32_t lsl_request_history(lsl_inlet in, double seconds);
+
+/**
+ * Choose what the outlet does when this inlet's buffer (see max_buflen) is full.
+ *
+ * By default, the oldest samples are dropped. A visualizer may e.g. prefer to get every k-th
+ * sample while it's lagging instead of falling seconds behind, and a status display only the
+ * latest value (#ovf_latest, which also applies to the inlet's own buffer). The policy is sent to
+ * the outlet when the stream is opened (and on reconnects), so it has to be set before opening the
+ * stream. Outlets with older versions of liblsl ignore it.
+ * @param in The lsl_inlet object to act on.
+ * @param policy The overflow policy, see #lsl_overflow_policy_t.
+ * @param parameter For #ovf_block, the maximum time (in seconds) the outlet waits for room in
+ * the buffer. For #ovf_decimate, the decimation factor k (at least 2). Ignored otherwise.
+ * @return The error code: if nonzero, can be #lsl_argument_error for invalid arguments.
+ */
+extern LIBLSL_C_API int32_t lsl_set_overflow_policy(lsl_inlet in, lsl_overflow_policy_t policy, double parameter);
+
+/**
+ * Set how urgently the outlet serves this inlet when it has to serve many inlets at once.
+ *
+ * The outlet hands new samples to latency-sensitive connections first and lets bulk connections
+ * (e.g. recorders) wait behind the others after each chunk they were sent, so a bulk recorder
+ * can't delay a feedback loop on the same outlet. If [tuning] PriorityMarking is enabled on the
+ * outlet's host, the connection's packets are also marked (DSCP and, on Linux, SO_PRIORITY) so
+ * the network can prioritize them. The priority is sent to the outlet when the stream is opened
+ * (and on reconnects), so it has to be set before opening the stream. Outlets with older versions
+ * of liblsl ignore it.
+ * @param in The lsl_inlet object to act on.
+ * @param priority The priority class, see #lsl_transfer_priority_t (the default is #prio_normal).
+ * @return The error code: if nonzero, can be #lsl_argument_error for unknown classes.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_priority(lsl_inlet in, lsl_transfer_priority_t priority);
+
+/**
+ * Limit the bandwidth the outlet sends this inlet's samples with, e.g. for a full-rate recorder
+ * at a remote site that mustn't saturate a shared uplink.
+ *
+ * The outlet holds back chunks that exceed the budget (a token bucket that allows short bursts),
+ * so the samples queue up on its side and the overflow policy (see lsl_set_overflow_policy(),
+ * e.g. #ovf_decimate or #ovf_drop_newest) decides what's dropped if the stream needs more. The
+ * outlet's host may limit its connections to other hosts further ([tuning]
+ * SessionMaxBytesPerSecond per connection and HostMaxBytesPerSecond for all of them); the
+ * lower limit applies. Takes effect when the stream is (re-)opened. Outlets with older versions
+ * of liblsl ignore it.
+ * @param in The lsl_inlet object to act on.
+ * @param bytes_per_second The limit, 0 for none (the default).
+ * @return The error code: if nonzero, can be #lsl_argument_error for a negative limit.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_max_bandwidth(lsl_inlet in, double bytes_per_second);
+
+/**
+ * Change the buffer length and the maximum chunk size of an open inlet without reconnecting.
+ *
+ * The inlet drops the oldest buffered samples beyond the new length right away; a length beyond
+ * the one the inlet was created with buffers no more samples than that. The outlet changes its
+ * queue for this inlet and the chunk size from its next chunk on, so e.g. a recorder can switch
+ * to a fine granularity for a live view without a gap in the stream. Outlets with older versions
+ * of liblsl (and connections that receive the samples as datagrams) use the new values from the
+ * next reconnect on. The postprocessing can be changed at any time with lsl_set_postprocessing().
+ * @param in The lsl_inlet object to act on.
+ * @param max_buflen The maximum amount of data to buffer, in the units of lsl_create_inlet().
+ * @param max_chunklen The maximum size, in samples, at which chunks are transmitted (0 for the
+ * outlet's chunk sizes).
+ * @return The error code: if nonzero, can be #lsl_argument_error for negative values.
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_buffering(
+	lsl_inlet in, int32_t max_buflen, int32_t max_chunklen);
+
+/**
+ * Fail over to another stream with the same source_id (and name, type and format) when the
+ * inlet's stream breaks down, e.g. to a hot-standby outlet on a second machine.
+ *
+ * The inlet keeps resolving the matching streams in the background, so it reconnects to one of
+ * them as soon as it notices that its stream is gone (usually within milliseconds) instead of
+ * searching the network first. Without failover, an inlet only recovers its stream if exactly
+ * one matching stream is left (e.g. the restarted outlet), since it can't tell which of several
+ * is the one the user wants. With failover, any of them will do, and the inlet stays with the
+ * stream it failed over to even if the previous one comes back.
+ * @param in The lsl_inlet object to act on.
+ * @param enabled 1 to enable failover, 0 to disable it (the default).
+ * @return The error code: if nonzero, can be #lsl_argument_error if the stream can't be
+ * recovered at all (the inlet was created from a resolved stream without a source_id or with
+ * recover = 0).
+ */
+extern LIBLSL_C_API int32_t lsl_set_inlet_failover(lsl_inlet in, int32_t enabled);
+
 /// @}
@@ -42,6 +42,21 @@ extern LIBLSL_C_API lsl_outlet lsl_create_outlet(lsl_streaminfo info, int32_t ch
  */
 extern LIBLSL_C_API void lsl_destroy_outlet(lsl_outlet out);
 
+/**
+ * Destroy several outlets at once.
+ * The outlets are torn down in parallel, which is much faster than destroying them one by one.
+ * @param outlets An array of count outlets.
+ */
+extern LIBLSL_C_API void lsl_destroy_outlets(lsl_outlet *outlets, int32_t count);
+
+/**
+ * Destroy an outlet in the background.
+ * The outlet is no longer discoverable and the connected inlets stop receiving data when this
+ * returns, the rest of the teardown (waiting for the outlet's threads) happens on a thread of its
+ * own. The process waits for the teardowns that are still running when it exits.
+ */
+extern LIBLSL_C_API void lsl_destroy_outlet_async(lsl_outlet out);
+
 /** Push a pointer to some values as a sample into the outlet.
  * Handles type checking & conversion.
  * @param out The lsl_outlet object through which to push the data.
@@ -219,6 +234,89 @@ extern LIBLSL_C_API int32_t lsl_push_chunk_buftn(lsl_outlet out, const char **da
  * precedence over the pushthrough flag. */
 extern LIBLSL_C_API int32_t lsl_push_chunk_buftnp(lsl_outlet out, const char **data, const uint32_t *lengths, unsigned long data_elements, const double *timestamps, int32_t pushthrough);
 
+/** @defgroup lsl_push_chunk_planar Push a chunk of numeric data in channel-major order
+ *
+ * Push num_samples samples from one array per channel (e.g. one DMA buffer per ADC), without
+ * interleaving them first. The samples are built from the arrays in small blocks inside the
+ * library.
+ * @param out The lsl_outlet object to act on.
+ * @param channels An array of channel_count pointers to arrays of num_samples values.
+ * @param num_samples The number of samples to push.
+ * @param timestamps A time stamp for each sample, or NULL to use `timestamp`.
+ * @param timestamp The capture time of the most recent sample, in agreement with local_clock(),
+ * or 0.0 to use the current time. The time stamps of the other samples are derived from the
+ * sampling rate of the stream. Ignored if `timestamps` is given.
+ * @param pushthrough Whether to push the chunk through to the receivers instead of buffering it
+ * with subsequent samples. Note that the chunk_size, if specified at outlet construction, takes
+ * precedence over the pushthrough flag.
+ * @return Error code of the operation or lsl_no_error if successful (usually attributed to the
+ * wrong data type).
+ * @{
+ */
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_f(lsl_outlet out, const float *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_d(lsl_outlet out, const double *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_l(lsl_outlet out, const int64_t *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_i(lsl_outlet out, const int32_t *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_s(lsl_outlet out, const int16_t *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_chunk_planar_c(lsl_outlet out, const char *const *channels, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+/// @}
+
+/**
+ * Push a chunk of numeric data from a strided buffer of any element type and memory layout,
+ * e.g. a numpy or MATLAB array, without copying it into a multiplexed buffer first.
+ *
+ * The value of channel c of the k-th sample is read from
+ * `(const char *)data + k * sample_stride + c * channel_stride` and converted to the stream's
+ * channel format inside the library; see lsl_pull_chunk_strided() for the strides of common
+ * layouts. The other parameters are the same as for lsl_push_chunk_planar_f().
+ * @param element_type The type of the values in the buffer: #cft_float32, #cft_double64,
+ * #cft_int8, #cft_int16, #cft_int32 or #cft_int64.
+ * @param sample_stride,channel_stride The distance between consecutive samples and channels,
+ * in bytes (possibly negative).
+ * @return Error code of the operation or lsl_no_error if successful (#lsl_argument_error for an
+ * unsupported element type).
+ */
+extern LIBLSL_C_API int32_t lsl_push_chunk_strided(lsl_outlet out, const void *data, lsl_channel_format_t element_type, int64_t sample_stride, int64_t channel_stride, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+
+/**
+ * Push a chunk of a numeric stream from a block of bytes that's already laid out as on the wire,
+ * e.g. as produced by a hardware driver.
+ *
+ * The block holds the samples back to back, each with the values of all channels in the
+ * stream's channel format, little endian (e.g. the float32 values of a #cft_float32 stream).
+ * Only the size of the block is checked; the values are copied into the outlet's samples as
+ * they are, without converting them per value. The other parameters are the same as for
+ * lsl_push_chunk_planar_f().
+ * @param out The lsl_outlet object through which to push the data.
+ * @param data The samples.
+ * @param num_bytes The size of the block, a multiple of the sample size (the channel count times
+ * the size of a value).
+ * @return Error code of the operation or lsl_no_error if successful (#lsl_argument_error for a
+ * string stream or a size that isn't a multiple of the sample size).
+ */
+extern LIBLSL_C_API int32_t lsl_push_chunk_raw(lsl_outlet out, const void *data, unsigned long num_bytes, const double *timestamps, double timestamp, int32_t pushthrough);
+
+/**
+ * Push a sparse sample of a numeric stream, e.g. an event of a stream with many channels, as
+ * index/value pairs: the channels at the given indices get the values, all others are zero.
+ *
+ * When the inlets negotiate the changed-channels value encoding ([tuning]
+ * ChangedChannelEncoding), such samples only take their indices and values on the wire.
+ * @param out The lsl_outlet object through which to push the data.
+ * @param indices The channel indices, in any order.
+ * @param values The values of these channels.
+ * @param element_type The type of the values: #cft_float32, #cft_double64, #cft_int8,
+ * #cft_int16, #cft_int32 or #cft_int64.
+ * @param count The number of index/value pairs.
+ * @param timestamp Optionally the capture time of the sample, in agreement with
+ * lsl_local_clock(); if omitted (0.0), the current time is used.
+ * @param pushthrough Whether to push the sample through to the receivers instead of buffering it
+ * with subsequent samples.
+ * @return Error code of the operation or lsl_no_error if successful (#lsl_argument_error for an
+ * unsupported element type or an index that isn't a channel of the stream).
+ */
+extern LIBLSL_C_API int32_t lsl_push_sample_sparse(lsl_outlet out, const uint32_t *indices, const void *values, lsl_channel_format_t element_type, uint32_t count, double timestamp, int32_t pushthrough);
+
 /**
 * Check whether consumers are currently registered.
 * While it does not hurt, there is technically no reason to push samples if there is no consumer.
@@ -231,6 +329,154 @@ extern LIBLSL_C_API int32_t lsl_have_consumers(lsl_outlet out);
 */
 extern LIBLSL_C_API int32_t lsl_wait_for_consumers(lsl_outlet out, double timeout);
 
+/**
+ * A function that's told the number of consumers of an outlet, see lsl_set_consumers_callback().
+ * @param out The outlet.
+ * @param consumers The current number of consumers.
+ * @param user_data The pointer passed to lsl_set_consumers_callback().
+ */
+typedef void (*lsl_consumers_callback)(lsl_outlet out, int32_t consumers, void *user_data);
+
+/**
+ * Call a function whenever a consumer connects to or disconnects from an outlet, e.g. to only
+ * compute the samples while someone receives them, without polling lsl_have_consumers().
+ *
+ * The function is called right away with the current number of consumers and then from the
+ * outlet's network threads, so it should return quickly (e.g. signal a condition variable or
+ * write to an eventfd) and must not call lsl_set_consumers_callback(). The calls don't overlap
+ * and the last one reports the current number, but a number may be reported twice in a row.
+ * Passing NULL as callback removes it; once this function returns, the previous callback won't
+ * be called anymore. A consumer's disconnect is noticed when the outlet sends it the next samples.
+ * @return #lsl_no_error, or an error code if the callback couldn't be set.
+ */
+extern LIBLSL_C_API int32_t lsl_set_consumers_callback(lsl_outlet out, lsl_consumers_callback callback, void *user_data);
+
+/**
+* Wait until the outlet can be discovered by resolvers.
+*
+* Outlets set up their multicast responders in the background (unless disabled with
+* `tuning.BackgroundDiscoverySetup`), so creating them returns before they can be found.
+* Resolvers keep querying anyway, so this is only needed if the stream has to be discoverable
+* right away, e.g. before announcing it by other means.
+* @return True if the outlet is ready, false if the timeout expired or an error occurred.
+*/
+extern LIBLSL_C_API int32_t lsl_wait_for_ready(lsl_outlet out, double timeout);
+
+/**
+* Query how many samples were dropped because a consumer didn't keep up with the outlet.
+* Samples are dropped (oldest first) when a consumer's buffer exceeds max_buffered or the memory
+* budgets set in the configuration file; the count includes consumers that have disconnected.
+*/
+extern LIBLSL_C_API uint64_t lsl_dropped_samples(lsl_outlet out);
+
+/**
+* Get the transfer statistics of an outlet.
+*
+* The counters are updated as the data is sent, so this is cheap enough to be polled regularly,
+* e.g. to monitor the health of a stream. All counts start when the outlet is created.
+* @param out The lsl_outlet object to act on.
+* @param[in,out] stats The structure to fill with the statistics; its struct_size has to be set
+* to `sizeof(lsl_outlet_stats)`, and only that many bytes are filled.
+* @return An error code: #lsl_argument_error if struct_size isn't set.
+*/
+extern LIBLSL_C_API int32_t lsl_get_outlet_stats(lsl_outlet out, lsl_outlet_stats *stats);
+
+/**
+* Keep the most recently pushed samples so that inlets can request them when they connect.
+*
+* Inlets that connect later can then fill their display window right away (see
+* lsl_request_history()), and inlets that reconnect after a connection error resume the
+* stream without a gap. The defaults are set in the configuration file ([tuning]
+* OutletHistorySeconds and OutletHistoryLength).
+* @param out The lsl_outlet object to act on.
+* @param seconds How long pushed samples are kept, 0 for no limit.
+* @param max_samples The maximum number of samples that are kept, 0 for no limit.
+* If both limits are 0, no history is kept.
+* @return The error code: if nonzero, can be #lsl_argument_error for negative limits.
+*/
+extern LIBLSL_C_API int32_t lsl_set_outlet_history(lsl_outlet out, double seconds, int32_t max_samples);
+
+/**
+* Set the socket options of the outlet's connections to inlets that connect from now on.
+*
+* The defaults are set in the configuration file ([tuning] SocketSendBufferBytes,
+* SocketReceiveBufferBytes, TCPNoDelay and SocketBusyPollMicros). Links with a large
+* bandwidth-delay product (e.g. between sites) need a send buffer of at least the bandwidth times
+* the round-trip time to reach their full throughput.
+* @param out The lsl_outlet object to act on.
+* @param send_buffer_bytes The socket send buffer size (SO_SNDBUF), 0 for the system default.
+* @param receive_buffer_bytes The socket receive buffer size (SO_RCVBUF), 0 for the system default.
+* @param no_delay 1 to disable Nagle's algorithm (TCP_NODELAY, the default), 0 to enable it.
+* @param busy_poll_us How long socket reads busy-poll the device in microseconds (SO_BUSY_POLL,
+* Linux only), 0 to disable it.
+* Negative values keep the current setting.
+* @return The error code: if nonzero, can be #lsl_internal_error.
+*/
+extern LIBLSL_C_API int32_t lsl_set_outlet_socket_options(lsl_outlet out, int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us);
+
+/**
+* Multicast the samples to the inlets that connect from now on and ask for it.
+*
+* The samples are sent once to an IPv4 multicast group (the configured multicast address with the
+* largest scope, see the `ResolveScope` config setting) instead of once per inlet, so many inlets
+* on the same network don't multiply the outlet's load. The inlets (see lsl_set_inlet_multicast())
+* keep their TCP connection to ask for lost datagrams, which are repaired from the outlet's history
+* (see lsl_set_outlet_history()); inlets fall back to TCP if the datagrams don't reach them.
+* Only inlets that receive all channels at full rate in the outlet's byte order are served that way.
+* The default is set in the configuration file ([tuning] MulticastData).
+* @param out The lsl_outlet object to act on.
+* @param enabled 1 to multicast the samples, 0 to send them over TCP only.
+* @return The error code: if nonzero, can be #lsl_argument_error if the samples can't be
+* multicast (string samples, samples larger than a datagram, or no IPv4 multicast address).
+*/
+extern LIBLSL_C_API int32_t lsl_set_outlet_multicast(lsl_outlet out, int32_t enabled);
+
+/**
+ * Change the preferred chunk size of the outlet (see lsl_create_outlet()).
+ *
+ * The new size applies to the connected inlets from their next sample on, without reconnecting;
+ * inlets that requested their own maximum chunk size keep theirs.
+ * @param out The lsl_outlet object to act on.
+ * @param chunk_size The chunk size in samples, 0 to send the chunks as they are pushed.
+ * @return The error code: if nonzero, can be #lsl_argument_error for a negative size.
+ */
+extern LIBLSL_C_API int32_t lsl_set_outlet_chunk_size(lsl_outlet out, int32_t chunk_size);
+
+/**
+ * Hand the pushed samples to a worker thread of the outlet instead of converting, time stamping
+ * and distributing them in the push call, e.g. for a driver callback that has to return within
+ * microseconds.
+ *
+ * The push_sample, push_chunk (multiplexed) and push_numeric_raw functions then only copy the
+ * values (and time stamps) into a ring of the given size, without locks or allocations, so their
+ * cost doesn't depend on the number of inlets. Samples without a time stamp get the time of the
+ * push. Samples that don't fit into the ring are dropped (and counted in the outlet's statistics).
+ * Other pushes wait until the staged samples are pushed. The pushes must come from one thread at
+ * a time, and this function must not be called while samples are pushed.
+ * @param out The lsl_outlet object to act on.
+ * @param buffer_bytes The size of the ring in bytes (rounded up to whole pages), 0 to push the
+ * samples synchronously again (once the staged samples are pushed).
+ * @return The error code: if nonzero, can be #lsl_argument_error for string streams or a negative
+ * size, or #lsl_internal_error if the ring couldn't be allocated.
+ */
+extern LIBLSL_C_API int32_t lsl_set_outlet_async_push(lsl_outlet out, int32_t buffer_bytes);
+
+/**
+ * Replace the extended description of the outlet's stream.
+ *
+ * The description of the given stream info is copied; all other fields of the outlet's stream
+ * info stay the same. Inlets see the new description the next time they retrieve the full info
+ * after their refresh interval (the `InfoRefreshInterval` config setting, off by default).
+ * Connected inlets that receive the samples as frames (the `SampleFraming` config setting) get
+ * the changed top-level children of the description over the data connection right away
+ * instead.
+ * @param out The outlet.
+ * @param info A stream info whose description (lsl_get_desc()) is copied.
+ * @return The error code: if nonzero, can be #lsl_internal_error.
+ */
+extern LIBLSL_C_API int32_t lsl_update_desc(lsl_outlet out, lsl_streaminfo info);
+
 /**
  * Retrieve a handle to the stream info provided by this outlet.
  * This is what was used to create the stream (and also has the Additional Network Information
@@ -242,3 +488,182 @@ extern LIBLSL_C_API int32_t lsl_wait_for_consumers(lsl_outlet out, double timeou
 extern LIBLSL_C_API lsl_streaminfo lsl_get_info(lsl_outlet out);
 
 ///@}
+
+/** @defgroup lsl_outlet_group Publishing several streams of one device as a single stream
+ *
+ * A device that produces several streams from one clock (e.g. the EEG, accelerometer and trigger
+ * channels of an amplifier) can publish them as one group stream instead of one outlet each:
+ * each sample of the group holds the channels of all members back to back with one time stamp,
+ * so subscribers get the members aligned over one connection. The group's stream info describes
+ * the members in `desc/streams/stream` elements (name, type, channel_count, channel_format,
+ * source_id, offset = the index of the member's first channel, and a copy of its desc).
+ * @{
+ */
+
+/**
+ * Create an outlet group.
+ * @param name The name of the group's stream.
+ * @param members The stream infos of the members. They need the same nominal sampling rate and a
+ * numeric channel format; the group's format is the members' format if they agree and
+ * double otherwise.
+ * @param count The number of members.
+ * @param chunk_size, max_buffered See lsl_create_outlet().
+ * @return A new outlet group, or NULL if the members can't be grouped (see lsl_last_error()).
+ */
+extern LIBLSL_C_API lsl_outlet_group lsl_create_outlet_group(const char *name, const lsl_streaminfo *members, int32_t count, int32_t chunk_size, int32_t max_buffered);
+
+/// Destroy an outlet group, including its outlet.
+extern LIBLSL_C_API void lsl_destroy_outlet_group(lsl_outlet_group group);
+
+/**
+ * Get the outlet of the group's stream, e.g. for lsl_get_info() or lsl_wait_for_consumers().
+ * @note The outlet is owned by the group and must not be destroyed.
+ */
+extern LIBLSL_C_API lsl_outlet lsl_outlet_group_outlet(lsl_outlet_group group);
+
+/** Push a chunk of samples of all members of a group.
+ * @param group The outlet group to act on.
+ * @param members One pointer per member to its multiplexed values of num_samples samples.
+ * @param num_samples The number of samples to push.
+ * @param timestamps A time stamp for each sample, or NULL to use `timestamp`.
+ * @param timestamp The capture time of the most recent sample, in agreement with local_clock(),
+ * or 0.0 to use the current time. The time stamps of the other samples are derived from the
+ * sampling rate of the stream. Ignored if `timestamps` is given.
+ * @param pushthrough Whether to push the chunk through to the receivers instead of buffering it
+ * with subsequent samples.
+ * @return Error code of the operation or lsl_no_error if successful.
+ * @{
+ */
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_f(lsl_outlet_group group, const float *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_d(lsl_outlet_group group, const double *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_l(lsl_outlet_group group, const int64_t *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_i(lsl_outlet_group group, const int32_t *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_s(lsl_outlet_group group, const int16_t *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+extern LIBLSL_C_API int32_t lsl_push_group_chunk_c(lsl_outlet_group group, const char *const *members, unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough);
+/// @}
+
+/// @}
+
+/** @defgroup lsl_replay Playing back XDF files through outlets
+ * @{
+ */
+
+/**
+ * Open an XDF file (e.g. one written by lsl_create_recording()) for playback.
+ *
+ * An outlet is created for each stream in the file right away, so inlets can connect to them
+ * before the playback is started with lsl_replay_start(). The file is memory-mapped and its
+ * samples are pushed into the outlets' buffers in chunks as they fall due, without going through
+ * the push functions. The original timing (with the recorded clock offsets applied) is kept, but
+ * the samples get new time stamps of the local clock.
+ * @param filename The name of the file.
+ * @param speed The playback speed relative to the original timing, e.g. 10 to play the file back
+ * ten times faster.
+ * @return A new replay, or NULL if the file couldn't be opened (see lsl_last_error()).
+ */
+extern LIBLSL_C_API lsl_replay lsl_create_replay(const char *filename, double speed);
+
+/// Stop the playback and destroy the outlets.
+extern LIBLSL_C_API void lsl_destroy_replay(lsl_replay r);
+
+/// The number of streams in the file.
+extern LIBLSL_C_API int32_t lsl_replay_stream_count(lsl_replay r);
+
+/**
+ * Get the stream info of one of the replay's outlets.
+ * @return A copy of the stream info, or NULL if the index is out of range.
+ * @note It is the user's responsibility to destroy it when it is no longer needed.
+ */
+extern LIBLSL_C_API lsl_streaminfo lsl_replay_get_info(lsl_replay r, int32_t index);
+
+/// Start the playback. Does nothing if it was started already.
+extern LIBLSL_C_API void lsl_replay_start(lsl_replay r);
+
+/**
+ * Wait until all samples were pushed.
+ * @param timeout The maximum time to wait, in seconds (LSL_FOREVER to wait indefinitely).
+ * @return 1 if the playback is complete, 0 if the timeout expired before.
+ */
+extern LIBLSL_C_API int32_t lsl_replay_wait(lsl_replay r, double timeout);
+
+/// @}
+
+/** @defgroup lsl_relay Re-publishing the streams of other outlets
+ * @{
+ */
+
+/**
+ * Create a relay that re-publishes streams, e.g. to distribute a lab's streams to many remote
+ * machines without loading the acquisition machine.
+ *
+ * Each stream that is added is received once and re-published by an outlet of the relay with the
+ * same metadata and the same UID, so the source serves one connection per stream no matter how
+ * many inlets connect to the relay. The received samples are pushed into the outlet's buffer as
+ * they are (without conversions) and their time stamps are converted to the relay's clock. A
+ * relayed stream ends with its source, after which it can be added again.
+ * @note The source and the relay publish the same UID, so inlets should only see one of them,
+ * e.g. because the remote machines reach the relay (see the KnownPeers setting), but not the
+ * source.
+ * @return A new relay, or NULL on errors.
+ */
+extern LIBLSL_C_API lsl_relay lsl_create_relay(void);
+
+/// Stop relaying and destroy the relay's outlets.
+extern LIBLSL_C_API void lsl_destroy_relay(lsl_relay r);
+
+/**
+ * Start relaying a stream.
+ * @param r The relay.
+ * @param info The stream info of the source, e.g. from lsl_resolve_all().
+ * @param timeout How long to wait for the source's full stream info and clock offset.
+ * @return #lsl_no_error, #lsl_timeout_error, #lsl_lost_error, or #lsl_argument_error if the
+ * stream is relayed already.
+ */
+extern LIBLSL_C_API int32_t lsl_relay_add(lsl_relay r, lsl_streaminfo info, double timeout);
+
+/// The number of relayed streams, not counting those whose source is gone.
+extern LIBLSL_C_API int32_t lsl_relay_stream_count(lsl_relay r);
+
+/**
+ * Get the stream info of one of the relay's outlets.
+ * @return A copy of the stream info, or NULL if the index is out of range.
+ * @note It is the user's responsibility to destroy it when it is no longer needed.
+ */
+extern LIBLSL_C_API lsl_streaminfo lsl_relay_get_info(lsl_relay r, int32_t index);
+
+/// @}
+
+/** @defgroup lsl_host_daemon Publishing the outlets of all processes on a host
+ * @{
+ */
+
+/**
+ * Create a host daemon that publishes the outlets of the processes on this host, so the host's
+ * network resources (multicast responders, time servers, listening sockets and their threads)
+ * don't grow with the number of processes.
+ *
+ * Processes whose configuration sets `[tuning] HostDaemon` to the daemon's socket path hand the
+ * samples of their outlets to the daemon through shared memory instead of serving them, and the
+ * daemon publishes each stream with the same metadata and UID. A stream ends when its outlet is
+ * destroyed or its process exits. Outlets that can't reach the daemon, and string streams, are
+ * served by their processes as usual.
+ * @param path The path of the daemon's Unix domain socket; a stale socket file is replaced.
+ * @return A new host daemon, or NULL on errors (e.g. another daemon listens on the path, or
+ * this isn't a POSIX system), see lsl_last_error().
+ */
+extern LIBLSL_C_API lsl_host_daemon lsl_create_host_daemon(const char *path);
+
+/// Stop listening and destroy the daemon's outlets.
+extern LIBLSL_C_API void lsl_destroy_host_daemon(lsl_host_daemon d);
+
+/// The number of published streams, not counting those whose process is gone.
+extern LIBLSL_C_API int32_t lsl_host_daemon_stream_count(lsl_host_daemon d);
+
+/**
+ * Get the stream info of one of the daemon's outlets.
+ * @return A copy of the stream info, or NULL if the index is out of range.
+ * @note It is the user's responsibility to destroy it when it is no longer needed.
+ */
+extern LIBLSL_C_API lsl_streaminfo lsl_host_daemon_get_info(lsl_host_daemon d, int32_t index);
+
+/// @}
@@ -69,6 +69,55 @@ extern LIBLSL_C_API lsl_continuous_resolver lsl_create_continuous_resolver_bypre
  */
 extern LIBLSL_C_API int32_t lsl_resolver_results(lsl_continuous_resolver res, lsl_streaminfo *buffer, uint32_t buffer_elements);
 
+/**
+ * Obtain the streams that appeared in or disappeared from the results of a continuous resolver
+ * since a version of them, so polling a large network only copies what changed.
+ *
+ * Calling this with the version from the previous call returns the changes in the meantime,
+ * oldest first; a stream's appearances and disappearances alternate.
+ * @param res A continuous resolver.
+ * @param[in,out] version The version of the results the caller knows, 0 at first (then only the
+ * present streams are returned). It's updated to the version after the returned changes.
+ * @param buffer A user-allocated buffer for the (short) infos of the changed streams, which the
+ * caller has to destroy, see lsl_resolver_results().
+ * @param appeared A user-allocated buffer that's set to 1 for each stream that appeared and to 0
+ * for each stream that disappeared.
+ * @param buffer_elements The length of both buffers. If there are more changes, the next call
+ * returns the rest.
+ * @return The number of changes written into the buffers, or a negative number if an error has
+ * occurred (#lsl_argument_error if the resolver doesn't remember the streams that disappeared
+ * since that version, which are the last 1024; the caller has to start over with 0).
+ */
+extern LIBLSL_C_API int32_t lsl_resolver_results_since(lsl_continuous_resolver res, uint64_t *version, lsl_streaminfo *buffer, int32_t *appeared, uint32_t buffer_elements);
+
+/**
+ * A function that's told about a stream that appeared in or disappeared from the results of a
+ * continuous resolver, see lsl_set_resolver_callback().
+ * @param res The resolver.
+ * @param info The (short) info of the stream; it's only valid during the call, so it has to be
+ * copied with lsl_copy_streaminfo() to be kept.
+ * @param appeared 1 if the stream appeared, 0 if it disappeared.
+ * @param user_data The pointer passed to lsl_set_resolver_callback().
+ */
+typedef void (*lsl_resolver_callback)(lsl_continuous_resolver res, lsl_streaminfo info, int32_t appeared, void *user_data);
+
+/**
+ * Call a function whenever a stream appears in or disappears from the results of a continuous
+ * resolver, e.g. to update a list of streams right away without polling lsl_resolver_results().
+ *
+ * A stream appears as soon as the first reply to the resolver's query or announcement of its
+ * outlet arrives, and disappears when the outlet is destroyed (if it could say goodbye) or after
+ * it hasn't been seen for the resolver's forget_after time.
+ * The function is called right away for the streams found so far and then mostly from the
+ * resolver's network thread, so it should return quickly and must not call
+ * lsl_set_resolver_callback() or destroy the resolver. The calls don't overlap, and a stream's
+ * appearances and disappearances alternate.
+ * Passing NULL as callback removes it; once this function returns, the previous callback won't
+ * be called anymore.
+ * @return #lsl_no_error, or an error code if the callback couldn't be set.
+ */
+extern LIBLSL_C_API int32_t lsl_set_resolver_callback(lsl_continuous_resolver res, lsl_resolver_callback callback, void *user_data);
+
 /// Destructor for the continuous resolver.
 extern LIBLSL_C_API void lsl_destroy_continuous_resolver(lsl_continuous_resolver res);
 
@@ -153,4 +202,37 @@ extern LIBLSL_C_API int32_t lsl_resolve_byprop(lsl_streaminfo *buffer, uint32_t
  */
 extern LIBLSL_C_API int32_t lsl_resolve_bypred(lsl_streaminfo *buffer, uint32_t buffer_elements, const char *pred, int32_t minimum, double timeout);
 
+/**
+ * Get the info of a stream directly from its outlet at a known address, without searching the
+ * network (e.g. in a fixed topology, so a recorder can open all of its streams right away).
+ *
+ * Alternatively, the XML of a resolved stream info (see lsl_get_xml()) can be stored, e.g. on
+ * disk, and an inlet can be created from it after lsl_streaminfo_from_xml() in a later run; it
+ * contains the stream's addresses and UID, so the inlet connects to the outlet right away. In
+ * both cases the inlet checks that the outlet still provides the stream with that UID when it
+ * connects, and if not (e.g. because the outlet was restarted), it recovers the stream as usual
+ * if it has a source_id.
+ * @param host The host name or IP address of the outlet's computer.
+ * @param port The outlet's TCP (data) port, e.g. the first one of the configured port range if
+ * [ports] SharedSockets is enabled.
+ * @param uid The UID of the expected stream, or NULL (or "") for any stream of this session on
+ * that port.
+ * @param timeout The time to wait for the outlet, in seconds.
+ * @param[out] ec Error code: #lsl_lost_error if there's no such stream at the address,
+ * #lsl_timeout_error if the outlet didn't reply in time.
+ * @return A (short) stream info that can be used to open an inlet, or NULL on error. It has to
+ * be destroyed like the results of the other resolve functions.
+ */
+extern LIBLSL_C_API lsl_streaminfo lsl_resolve_address(const char *host, int32_t port, const char *uid, double timeout, int32_t *ec);
+
+/**
+ * Get the discovery traffic of this process so far.
+ *
+ * The counters only ever increase, so the cost of a resolve (e.g., the packets per query wave)
+ * is the difference of the values before and after it.
+ * @param[out] stats The structure to fill with the statistics.
+ * @return #lsl_no_error or an error code (#lsl_argument_error if stats is NULL).
+ */
+extern LIBLSL_C_API int32_t lsl_get_discovery_stats(lsl_discovery_stats *stats);
+
 /// @}
@@ -34,6 +34,51 @@ typedef struct lsl_outlet_struct_ *lsl_outlet;
  */
 typedef struct lsl_inlet_struct_ *lsl_inlet;
 
+/**
+ * @class lsl_sample_view
+ * A handle to samples borrowed from an inlet without copying their data (see lsl_borrow_chunk()).
+ * The samples are owned by the view until it is returned with lsl_return_chunk().
+ */
+typedef struct lsl_sample_view_struct_ *lsl_sample_view;
+
+/**
+ * @class lsl_inlet_set
+ * A set of inlets a single thread can wait on until any of them has data (see
+ * lsl_inlet_set_wait()).
+ */
+typedef struct lsl_inlet_set_struct_ *lsl_inlet_set;
+
+/**
+ * @class lsl_recording
+ * A recording of inlets into an XDF file (see lsl_create_recording()).
+ */
+typedef struct lsl_recording_struct_ *lsl_recording;
+
+/**
+ * @class lsl_outlet_group
+ * An outlet that publishes several streams of one device as a single stream (see
+ * lsl_create_outlet_group()).
+ */
+typedef struct lsl_outlet_group_struct_ *lsl_outlet_group;
+
+/**
+ * @class lsl_relay
+ * Re-publishes the streams of other outlets (see lsl_create_relay()).
+ */
+typedef struct lsl_relay_struct_ *lsl_relay;
+
+/**
+ * @class lsl_host_daemon
+ * Publishes the outlets of the processes on a host (see lsl_create_host_daemon()).
+ */
+typedef struct lsl_host_daemon_struct_ *lsl_host_daemon;
+
+/**
+ * @class lsl_replay
+ * The playback of an XDF file through outlets (see lsl_create_replay()).
+ */
+typedef struct lsl_replay_struct_ *lsl_replay;
+
 /**
  * @class lsl_xml_ptr
  * A lightweight XML element tree handle; models the description of a streaminfo object.
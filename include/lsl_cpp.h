@@ -20,9 +20,18 @@
  * this header. Under Visual Studio the library is linked in automatically.
  */
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <limits>
 #include <memory>
+#include <queue>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 extern "C" {
@@ -77,6 +86,11 @@ enum channel_format_t {
 	/// languages. Also, some builds of liblsl will not be able to send or receive data of this
 	/// type.
 	cf_int64 = 7,
+	/// For 24-bit ADC values, stored and transmitted in 3 bytes but pushed and pulled as int32_t.
+	cf_int24 = 8,
+	/// For IEEE 754 half precision values, stored and transmitted in 2 bytes but pushed and pulled
+	/// as float.
+	cf_float16 = 9,
 	/// Can not be transmitted.
 	cf_undefined = 0
 };
@@ -99,10 +113,39 @@ enum processing_options_t {
 	/// Post-processing is thread-safe (same inlet can be read from by multiple threads); uses
 	/// somewhat more CPU.
 	post_threadsafe = 8,
+	/// Post-process the time stamps on the inlet's receive thread as the samples arrive instead of
+	/// in the pull calls (not part of post_ALL).
+	post_receive_thread = 16,
 	/// The combination of all possible post-processing options.
 	post_ALL = 1 | 2 | 4 | 8
 };
 
+/// What an outlet does when an inlet's buffer is full, see stream_inlet::set_overflow_policy().
+enum overflow_policy_t {
+	/// Drop the oldest buffered sample to make room for the new one (the default).
+	overflow_drop_oldest = ovf_drop_oldest,
+	/// Drop the new sample, so the inlet gets the buffered samples without a gap.
+	overflow_drop_newest = ovf_drop_newest,
+	/// Make the pushing thread wait (up to a timeout) until the inlet has caught up; this slows
+	/// down the outlet's push calls for all inlets.
+	overflow_block = ovf_block,
+	/// While the inlet is lagging (its buffer is more than half full), keep every k-th sample.
+	overflow_decimate = ovf_decimate,
+	/// Keep only the newest sample, so the inlet always gets the latest value (e.g. for a status
+	/// display); see #ovf_latest.
+	overflow_latest = ovf_latest
+};
+
+/// How urgently an outlet serves an inlet's connection, see stream_inlet::set_priority().
+enum transfer_priority_t {
+	/// Throughput matters, latency doesn't (e.g. a recorder).
+	priority_bulk = prio_bulk,
+	/// The default.
+	priority_normal = prio_normal,
+	/// Latency matters (e.g. a closed-loop feedback consumer).
+	priority_latency = prio_latency
+};
+
 /**
  * Protocol version.
  *
@@ -134,6 +177,30 @@ inline const char *library_info() { return lsl_library_info(); }
  */
 inline double local_clock() { return lsl_local_clock(); }
 
+/**
+ * Set the CPU affinity and real-time priority of the liblsl threads with a role.
+ *
+ * See lsl_set_thread_policy() for details; this applies to the threads started afterwards.
+ * @param cpus The CPUs the threads may run on (empty for all).
+ * @param priority The real-time priority (1-99), or 0 for the default scheduling.
+ */
+inline void set_thread_policy(
+	lsl_thread_role_t role, const std::vector<uint32_t> &cpus, int32_t priority = 0) {
+	check_error(lsl_set_thread_policy(role, cpus.empty() ? nullptr : cpus.data(),
+		static_cast<uint32_t>(cpus.size()), priority));
+}
+
+/**
+ * Set the function that starts the threads of liblsl, e.g. to run them in a thread pool.
+ *
+ * See lsl_thread_starter for the contract of the function.
+ * @param starter The function, or nullptr to let liblsl start its own threads.
+ * @param user_data A value passed to each call of the function.
+ */
+inline void set_thread_starter(lsl_thread_starter starter, void *user_data = nullptr) {
+	check_error(lsl_set_thread_starter(starter, user_data));
+}
+
 
 /// @section Stream Declaration
 
@@ -744,6 +811,116 @@ public:
 		}
 	}
 
+	/** Push a chunk of numeric samples from one array per channel (channel-major order).
+	 * The samples are built from the arrays in small blocks inside the library, so data that's
+	 * delivered per channel (e.g. one DMA buffer per ADC) doesn't have to be interleaved first.
+	 * @param channels An array of pointers to the channels' arrays of num_samples values.
+	 * @param num_samples The number of samples to push.
+	 * @param timestamps A time stamp per sample, or nullptr to use `timestamp`.
+	 * @param timestamp Optionally the capture time of the most recent sample, in agreement with
+	 * local_clock(); if omitted, the current time is used. The time stamps of other samples are
+	 * automatically derived according to the sampling rate of the stream.
+	 * @param pushthrough Whether to push the chunk through to the receivers instead of buffering it
+	 * with subsequent samples. Note that the chunk_size, if specified at outlet construction, takes
+	 * precedence over the pushthrough flag.
+	 */
+	void push_chunk_planar(const float *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_f(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk_planar(const double *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_d(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk_planar(const int64_t *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_l(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk_planar(const int32_t *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_i(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk_planar(const int16_t *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_s(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk_planar(const char *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_planar_c(obj.get(), channels,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+
+	/** Push a chunk of numeric samples from a strided buffer of any memory layout, e.g. a numpy
+	 * array or a slice of a larger matrix, see lsl_push_chunk_strided().
+	 * @param data The buffer; the value of channel c of sample k is at
+	 * `(const char *)data + k * sample_stride + c * channel_stride`.
+	 * @param element_type The type of the values (cf_float32, cf_double64 or an integer format
+	 * except cf_int24).
+	 * @param sample_stride,channel_stride The distance between samples and channels in bytes.
+	 * @param num_samples The number of samples to push.
+	 * @param timestamps A time stamp per sample, or nullptr to use `timestamp` as in
+	 * push_chunk_planar().
+	 */
+	void push_chunk_strided(const void *data, channel_format_t element_type,
+		std::ptrdiff_t sample_stride, std::ptrdiff_t channel_stride, std::size_t num_samples,
+		const double *timestamps = nullptr, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_strided(obj.get(), data,
+			static_cast<lsl_channel_format_t>(element_type), sample_stride, channel_stride,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+
+	/** Push a chunk of a numeric stream from a block that's laid out as on the wire (the
+	 * samples back to back, their values in the channel format, little endian), see
+	 * lsl_push_chunk_raw().
+	 * @param data The samples.
+	 * @param num_bytes The size of the block, a multiple of the sample size.
+	 * @param timestamps A time stamp per sample, or nullptr to use `timestamp` as in
+	 * push_chunk_planar().
+	 */
+	void push_chunk_raw(const void *data, std::size_t num_bytes,
+		const double *timestamps = nullptr, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_chunk_raw(obj.get(), data, static_cast<unsigned long>(num_bytes),
+			timestamps, timestamp, pushthrough));
+	}
+
+	/** Push a sparse sample of a numeric stream as index/value pairs, see
+	 * lsl_push_sample_sparse(): the channels at the indices get the values, all others are zero.
+	 * @param indices The channel indices, in any order.
+	 * @param values The values of these channels.
+	 * @param element_type The type of the values (cf_float32, cf_double64 or an integer format
+	 * except cf_int24).
+	 * @param count The number of index/value pairs.
+	 */
+	void push_sample_sparse(const uint32_t *indices, const void *values,
+		channel_format_t element_type, uint32_t count, double timestamp = 0.0,
+		bool pushthrough = true) {
+		check_error(lsl_push_sample_sparse(obj.get(), indices, values,
+			static_cast<lsl_channel_format_t>(element_type), count, timestamp, pushthrough));
+	}
+
+	/** Push a chunk of numeric samples from a vector per channel, see above.
+	 * @throws std::runtime_error if the number of channels doesn't match or the channels have
+	 * different lengths.
+	 */
+	template <typename T>
+	void push_chunk_planar(const std::vector<std::vector<T>> &channels, double timestamp = 0.0,
+		bool pushthrough = true) {
+		check_numchan(channels.size());
+		std::vector<const T *> pointers;
+		pointers.reserve(channels.size());
+		for (const auto &channel : channels) {
+			if (channel.size() != channels[0].size())
+				throw std::runtime_error("All channels must hold the same number of values.");
+			pointers.push_back(channel.data());
+		}
+		if (!channels.empty() && !channels[0].empty())
+			push_chunk_planar(pointers.data(), channels[0].size(), nullptr, timestamp, pushthrough);
+	}
 
 	// ===============================
 	// === Miscellaneous Functions ===
@@ -760,22 +937,136 @@ public:
 	 */
 	bool wait_for_consumers(double timeout) { return lsl_wait_for_consumers(obj.get(), timeout) != 0; }
 
+	/** Call a function with the number of consumers whenever one connects or disconnects.
+	 *
+	 * The function is called right away with the current number and then from the outlet's
+	 * network threads, so it should return quickly and must not set another function; see
+	 * lsl_set_consumers_callback(). Pass an empty function to remove it.
+	 */
+	void set_consumers_callback(std::function<void(int32_t)> callback) {
+		if (!callback) {
+			check_error(lsl_set_consumers_callback(obj.get(), nullptr, nullptr));
+			consumers_callback.reset();
+			return;
+		}
+		auto new_callback = std::make_shared<std::function<void(int32_t)>>(std::move(callback));
+		check_error(
+			lsl_set_consumers_callback(obj.get(), &invoke_consumers_callback, new_callback.get()));
+		// the previous function isn't called anymore, so it can be destroyed now
+		consumers_callback = std::move(new_callback);
+	}
+
+	/** Wait until the outlet can be discovered by resolvers, see lsl_wait_for_ready().
+	 * @return True if the outlet is ready, false if the timeout expired or an error occurred.
+	 */
+	bool wait_for_ready(double timeout = FOREVER) {
+		return lsl_wait_for_ready(obj.get(), timeout) != 0;
+	}
+
+	/** Query how many samples were dropped because a consumer didn't keep up with the outlet.
+	 * The count includes consumers that have disconnected in the meantime.
+	 */
+	uint64_t dropped_samples() { return lsl_dropped_samples(obj.get()); }
+
+	/** Get the transfer statistics of the outlet (sent samples, bytes, chunks, drops etc.).
+	 * See lsl_outlet_stats for the individual counters.
+	 */
+	lsl_outlet_stats stats() {
+		lsl_outlet_stats result{};
+		result.struct_size = sizeof(result);
+		check_error(lsl_get_outlet_stats(obj.get(), &result));
+		return result;
+	}
+
+	/** Keep the most recently pushed samples so inlets can request them when they connect.
+	 * See stream_inlet::request_history().
+	 * @param seconds How long pushed samples are kept, 0 for no limit.
+	 * @param max_samples The maximum number of samples that are kept, 0 for no limit.
+	 * If both limits are 0, no history is kept.
+	 */
+	void set_history(double seconds, int32_t max_samples = 0) {
+		check_error(lsl_set_outlet_history(obj.get(), seconds, max_samples));
+	}
+
+	/** Set the socket options of the connections to inlets that connect from now on.
+	 * See lsl_set_outlet_socket_options(); negative values keep the current setting.
+	 * @param send_buffer_bytes The socket send buffer size, 0 for the system default.
+	 * @param receive_buffer_bytes The socket receive buffer size, 0 for the system default.
+	 * @param no_delay 1 to disable Nagle's algorithm, 0 to enable it.
+	 * @param busy_poll_us The busy-poll time of socket reads in microseconds (Linux only).
+	 */
+	void set_socket_options(int32_t send_buffer_bytes, int32_t receive_buffer_bytes = -1,
+		int32_t no_delay = -1, int32_t busy_poll_us = -1) {
+		check_error(lsl_set_outlet_socket_options(
+			obj.get(), send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us));
+	}
+
+	/** Multicast the samples to the inlets that connect from now on and ask for it.
+	 * See lsl_set_outlet_multicast(); lost datagrams are repaired from the history, so the outlet
+	 * should keep one (see set_history()).
+	 * @throws std::invalid_argument if the samples can't be multicast.
+	 */
+	void set_multicast(bool enabled = true) {
+		check_error(lsl_set_outlet_multicast(obj.get(), enabled));
+	}
+
+	/** Change the preferred chunk size, for the connected inlets from their next sample on, too.
+	 * See lsl_set_outlet_chunk_size().
+	 * @param chunk_size The chunk size in samples, 0 to send the chunks as they are pushed.
+	 */
+	void set_chunk_size(int32_t chunk_size) {
+		check_error(lsl_set_outlet_chunk_size(obj.get(), chunk_size));
+	}
+
+	/** Hand the pushed samples to a worker thread of the outlet through a ring of the given size,
+	 * so pushing only copies them (see lsl_set_outlet_async_push()).
+	 * @param buffer_bytes The size of the ring in bytes, 0 to push synchronously again.
+	 */
+	void set_async_push(int32_t buffer_bytes) {
+		check_error(lsl_set_outlet_async_push(obj.get(), buffer_bytes));
+	}
+
 	/** Retrieve the stream info provided by this outlet.
 	 * This is what was used to create the stream (and also has the Additional Network Information
 	 * fields assigned).
 	 */
 	stream_info info() const { return stream_info(lsl_get_info(obj.get())); }
 
+	/** Replace the extended description of the stream with the one of another stream info.
+	 *
+	 * Inlets see the new description the next time they retrieve the full info after their
+	 * refresh interval (the `InfoRefreshInterval` config setting, off by default). Connected
+	 * inlets that receive the samples as frames (`SampleFraming`) get the changed top-level
+	 * children of the description right away instead.
+	 * @param info A stream info whose desc() is copied; its other fields are ignored.
+	 */
+	void update_desc(const stream_info &info) {
+		check_error(lsl_update_desc(obj.get(), info.handle().get()));
+	}
+
 	/// Return a shared pointer to pass to C-API functions that aren't wrapped yet
 	///
 	/// Example: @code lsl_push_chunk_buft(outlet.handle().get(), data, …); @endcode
 	std::shared_ptr<lsl_outlet_struct_> handle() { return obj; }
 
+	/** Destroy the outlet in the background, see lsl_destroy_outlet_async().
+	 * The outlet can't be used afterwards (copies of handle() keep it alive until they're
+	 * released, it's destroyed in the background then).
+	 */
+	void close_async() {
+		if (obj && consumers_callback) lsl_set_consumers_callback(obj.get(), nullptr, nullptr);
+		if (auto *deleter = std::get_deleter<void (*)(lsl_outlet)>(obj))
+			*deleter = &lsl_destroy_outlet_async;
+		obj.reset();
+	}
+
 	/** Destructor.
 	 * The stream will no longer be discoverable after destruction and all paired inlets will stop
-	 * delivering data.
+	 * delivering data. Removes the consumers callback, if any, so it won't be called anymore.
 	 */
-	~stream_outlet() = default;
+	~stream_outlet() {
+		if (obj && consumers_callback) lsl_set_consumers_callback(obj.get(), nullptr, nullptr);
+	}
 
 	/// stream_outlet move constructor
 	stream_outlet(stream_outlet &&res) noexcept  = default;
@@ -796,9 +1087,14 @@ private:
 									 std::to_string(channel_count) + '.');
 	}
 
+	static void invoke_consumers_callback(lsl_outlet, int32_t consumers, void *user_data) {
+		(*static_cast<std::function<void(int32_t)> *>(user_data))(consumers);
+	}
+
 	int32_t channel_count;
 	double sample_rate;
 	std::shared_ptr<lsl_outlet_struct_> obj;
+	std::shared_ptr<std::function<void(int32_t)>> consumers_callback;
 };
 
 
@@ -868,11 +1164,138 @@ inline std::vector<stream_info> resolve_stream(
 	return std::vector<stream_info>(&buffer[0], &buffer[nres]);
 }
 
+/** Get the info of a stream directly from its outlet at a known address, without searching the
+ * network; see lsl_resolve_address() for details.
+ * @param host The host name or IP address of the outlet's computer.
+ * @param port The outlet's TCP (data) port.
+ * @param uid The UID of the expected stream, empty for any stream of this session on that port.
+ * @param timeout The time to wait for the outlet, in seconds.
+ * @throws lost_error if there's no such stream at the address.
+ * @throws timeout_error if the outlet didn't reply in time.
+ */
+inline stream_info resolve_address(const std::string &host, uint16_t port,
+	const std::string &uid = std::string(), double timeout = 2.0);
+
+/** Get the discovery traffic of this process so far.
+ *
+ * See lsl_discovery_stats for the individual counters.
+ */
+inline lsl_discovery_stats discovery_stats() {
+	lsl_discovery_stats result;
+	check_error(lsl_get_discovery_stats(&result));
+	return result;
+}
+
+/** Get the acquisitions of liblsl's internal mutexes, one element per name.
+ *
+ * See lsl_lock_stats for the individual counters.
+ * @throws std::runtime_error if liblsl was built without the CMake option LSL_LOCK_STATS.
+ */
+inline std::vector<lsl_lock_stats> lock_stats() {
+	std::vector<lsl_lock_stats> result(32);
+	result.resize(static_cast<std::size_t>(
+		check_error(lsl_get_lock_stats(result.data(), static_cast<int32_t>(result.size())))));
+	return result;
+}
+
 
 // ======================
 // ==== Stream Inlet ====
 // ======================
 
+/** A read-only view of samples borrowed from an inlet without copying them.
+ *
+ * The samples are returned to the inlet when the view is destroyed, which has to happen before
+ * the inlet is destroyed. Obtained via stream_inlet::borrow_chunk().
+ */
+class sample_view {
+public:
+	/// Wrap a view; unless `owned` is false, it is returned to the inlet on destruction.
+	explicit sample_view(lsl_sample_view view, bool owned = true)
+		: obj(view, owned ? &lsl_return_chunk : &keep), num_samples(lsl_view_samples(view)),
+		  stamps(lsl_view_timestamps(view)) {}
+
+	/// The number of samples in the view.
+	std::size_t size() const noexcept { return num_samples; }
+	bool empty() const noexcept { return num_samples == 0; }
+
+	/// The post-processed time stamp of the k-th sample.
+	double timestamp(std::size_t k) const noexcept { return stamps[k]; }
+
+	/// The time stamps of all samples in the view.
+	const double *timestamps() const noexcept { return stamps; }
+
+	/**
+	 * The channel data of the k-th sample.
+	 * @tparam T The type of the stream's channel format (e.g. float for cf_float32).
+	 */
+	template <class T> const T *data(std::size_t k) const noexcept {
+		return static_cast<const T *>(lsl_view_data(obj.get(), static_cast<uint32_t>(k)));
+	}
+
+private:
+	static void keep(lsl_sample_view) {}
+
+	std::unique_ptr<lsl_sample_view_struct_, void (*)(lsl_sample_view)> obj;
+	std::size_t num_samples;
+	const double *stamps;
+};
+
+/** A reusable buffer for chunks of multiplexed samples, see stream_inlet::pull_chunk().
+ *
+ * The memory for the samples and time stamps is allocated once, so pulling chunks into the buffer
+ * doesn't allocate.
+ * @tparam T The numeric type to convert the channel data to.
+ */
+template <class T> class chunk_buffer {
+public:
+	/**
+	 * Allocate a buffer for up to max_samples samples.
+	 * @param channel_count The number of channels of the inlet's samples.
+	 * @param with_timestamps Whether to hold the samples' time stamps as well.
+	 */
+	chunk_buffer(std::size_t channel_count, std::size_t max_samples, bool with_timestamps = true)
+		: channels(channel_count), with_stamps(with_timestamps), values(channel_count * max_samples),
+		  stamps(with_timestamps ? max_samples : 0) {}
+
+	/// The number of samples pulled into the buffer.
+	std::size_t size() const noexcept { return num_samples; }
+	bool empty() const noexcept { return num_samples == 0; }
+
+	/// The maximum number of samples the buffer can hold.
+	std::size_t capacity() const noexcept { return channels ? values.size() / channels : 0; }
+
+	std::size_t channel_count() const noexcept { return channels; }
+
+	/// Change the maximum number of samples (this allocates); the buffer is emptied.
+	void reserve(std::size_t max_samples) {
+		values.resize(channels * max_samples);
+		if (with_stamps) stamps.resize(max_samples);
+		num_samples = 0;
+	}
+
+	/// The multiplexed channel data (S1C1, S1C2, ..., S2C1, ...) of all samples.
+	const T *data() const noexcept { return values.data(); }
+
+	/// The channel data of the k-th sample.
+	const T *sample(std::size_t k) const noexcept { return values.data() + k * channels; }
+
+	/// The time stamp of the k-th sample (if the buffer holds time stamps).
+	double timestamp(std::size_t k) const noexcept { return stamps[k]; }
+
+	/// The time stamps of all samples, or nullptr if the buffer doesn't hold any.
+	const double *timestamps() const noexcept { return with_stamps ? stamps.data() : nullptr; }
+
+private:
+	friend class stream_inlet;
+
+	std::size_t channels;
+	bool with_stamps;
+	std::vector<T> values;
+	std::vector<double> stamps;
+	std::size_t num_samples{0};
+};
+
 /** A stream inlet.
  * Inlets are used to receive streaming data (and meta-data) from the lab network.
  */
@@ -904,6 +1327,25 @@ public:
 		: channel_count(info.channel_count()),
 		  obj(lsl_create_inlet(info.handle().get(), max_buflen, max_chunklen, recover), &lsl_destroy_inlet) {}
 
+	/**
+	 * Construct a new stream inlet that only receives some channels and/or every k-th sample.
+	 *
+	 * The outlet only sends the requested data (older outlets send everything and the inlet picks
+	 * the requested data itself). The pulled samples have the requested channels, in the requested
+	 * order, while info() still describes the full source stream.
+	 * @param info A resolved stream info object, see above.
+	 * @param channels The indices of the channels to receive (empty for all channels).
+	 * @param decimation Receive only every decimation-th sample.
+	 * @param max_buflen, max_chunklen, recover See above.
+	 */
+	stream_inlet(const stream_info &info, const std::vector<uint32_t> &channels,
+		uint32_t decimation = 1, int32_t max_buflen = 360, int32_t max_chunklen = 0,
+		bool recover = true)
+		: channel_count(channels.empty() ? info.channel_count() : (int32_t)channels.size()),
+		  obj(lsl_create_inlet_subset(info.handle().get(), max_buflen, max_chunklen, recover,
+				  channels.data(), (uint32_t)channels.size(), decimation),
+			  &lsl_destroy_inlet) {}
+
 	/// Return a shared pointer to pass to C-API functions that aren't wrapped yet
 	///
 	/// Example: @code lsl_pull_sample_buf(inlet.handle().get(), buf, …); @endcode
@@ -913,6 +1355,15 @@ public:
 	stream_inlet(stream_inlet &&rhs) noexcept = default;
 	stream_inlet &operator=(stream_inlet &&rhs) noexcept= default;
 
+	/// Destructor. Removes the chunk callbacks and the target buffer, if any, so they aren't used
+	/// anymore.
+	~stream_inlet() {
+		if (obj && chunk_callback) lsl_set_chunk_callback(obj.get(), nullptr, nullptr);
+		if (obj && raw_chunk_callback) lsl_set_raw_chunk_callback(obj.get(), nullptr, nullptr);
+		if (obj && target_callback)
+			lsl_set_target_buffer(obj.get(), nullptr, cft_float32, nullptr, 0, nullptr, nullptr);
+	}
+
 
 	/** Retrieve the complete information of the given stream, including the extended description.
 	 * Can be invoked at any time of the stream's lifetime.
@@ -992,6 +1443,26 @@ public:
 		return res;
 	}
 
+	/** Get the latest time correction estimate without waiting for one.
+	 *
+	 * Unlike time_correction(), this never blocks. The first call starts the estimation in the
+	 * background.
+	 * @param[out] offset The time correction estimate, if one is available.
+	 * @param remote_time The time of the remote computer that was used to generate this time
+	 * correction (optional).
+	 * @param uncertainty The maximum uncertainty of the given time correction (optional).
+	 * @return Whether an estimate is available.
+	 * @throws #lsl::lost_error (if the stream source has been lost).
+	 */
+	bool latest_time_correction(
+		double &offset, double *remote_time = nullptr, double *uncertainty = nullptr) {
+		int32_t ec = 0;
+		offset = lsl_latest_time_correction(obj.get(), remote_time, uncertainty, &ec);
+		if (ec == lsl_timeout_error) return false;
+		check_error(ec);
+		return true;
+	}
+
 	/** Set post-processing flags to use.
 	 *
 	 * By default, the inlet performs NO post-processing and returns the ground-truth time
@@ -1333,6 +1804,144 @@ public:
 		return 0;
 	}
 
+	/** Pull a chunk of numeric data into a strided buffer of any memory layout, e.g. a numpy
+	 * array or a slice of a larger matrix, see lsl_pull_chunk_strided().
+	 * @param data The buffer; the value of channel c of sample k is written to
+	 * `(char *)data + k * sample_stride + c * channel_stride`.
+	 * @param element_type The type of the values (cf_float32, cf_double64 or an integer format
+	 * except cf_int24).
+	 * @param sample_stride,channel_stride The distance between samples and channels in bytes.
+	 * @param max_samples The maximum number of samples to pull.
+	 * @param timestamp_buffer Room for max_samples time stamps, or nullptr.
+	 * @param timeout The timeout for this operation, if any.
+	 * @return The number of samples written.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	std::size_t pull_chunk_strided(void *data, channel_format_t element_type,
+		std::ptrdiff_t sample_stride, std::ptrdiff_t channel_stride, std::size_t max_samples,
+		double *timestamp_buffer = nullptr, double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_strided(obj.get(), data,
+			static_cast<lsl_channel_format_t>(element_type), sample_stride, channel_stride,
+			timestamp_buffer, static_cast<unsigned long>(max_samples), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+
+	/** Pull a multiplexed chunk of numeric data with the sequence numbers of its samples and the
+	 * number of samples missed since the previous call, see lsl_pull_chunk_seq().
+	 * @param data_buffer Room for max_samples multiplexed samples of the element type.
+	 * @param element_type The type of the values (cf_float32, cf_double64 or an integer format
+	 * except cf_int24).
+	 * @param max_samples The maximum number of samples to pull.
+	 * @param timestamp_buffer Room for max_samples time stamps, or nullptr.
+	 * @param seq_buffer Room for max_samples sequence numbers, or nullptr.
+	 * @param gaps Receives the samples dropped by the inlet and lost before they arrived, or
+	 * nullptr.
+	 * @param timeout The timeout for this operation, if any.
+	 * @return The number of samples written.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	std::size_t pull_chunk_seq(void *data_buffer, channel_format_t element_type,
+		std::size_t max_samples, double *timestamp_buffer = nullptr,
+		uint64_t *seq_buffer = nullptr, lsl_chunk_gaps *gaps = nullptr, double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_seq(obj.get(), data_buffer,
+			static_cast<lsl_channel_format_t>(element_type), timestamp_buffer, seq_buffer,
+			static_cast<unsigned long>(max_samples), gaps, timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+
+	/** Pull a sample of a numeric stream as the index/value pairs of its nonzero channels, see
+	 * lsl_pull_sample_sparse(); pull_sample() gets the same samples in dense form.
+	 * @param indices,values Room for max_count indices and values.
+	 * @param element_type The type of the values (cf_float32, cf_double64 or an integer format
+	 * except cf_int24).
+	 * @param[out] count The number of nonzero channels; only the first max_count are retrieved.
+	 * @param timeout The timeout for this operation, if any.
+	 * @return The capture time of the sample, or 0.0 if no new sample was available.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	double pull_sample_sparse(uint32_t *indices, void *values, channel_format_t element_type,
+		uint32_t max_count, uint32_t &count, double timeout = FOREVER) {
+		int32_t ec = 0;
+		double res = lsl_pull_sample_sparse(obj.get(), indices, values,
+			static_cast<lsl_channel_format_t>(element_type), max_count, &count, timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+
+	/** Pull a chunk of numeric data from the inlet in channel-major (planar) order.
+	 * The data buffer holds one array of `data_buffer_elements / channel_count` values per
+	 * channel, e.g. for filters that process each channel separately; the samples are transposed
+	 * in small cache-friendly blocks inside the library. Otherwise this is the same as
+	 * pull_chunk_multiplexed(). If fewer samples are available, the end of each channel's array
+	 * is left unchanged.
+	 * @return data_elements_written Number of channel data elements written to the data buffer.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	std::size_t pull_chunk_planar(float *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_f(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+	std::size_t pull_chunk_planar(double *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_d(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+	std::size_t pull_chunk_planar(int64_t *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_l(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+	std::size_t pull_chunk_planar(int32_t *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_i(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+	std::size_t pull_chunk_planar(int16_t *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_s(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+	std::size_t pull_chunk_planar(char *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		int32_t ec = 0;
+		std::size_t res = lsl_pull_chunk_planar_c(obj.get(), data_buffer, timestamp_buffer,
+			static_cast<unsigned long>(data_buffer_elements),
+			static_cast<unsigned long>(timestamp_buffer_elements), timeout, &ec);
+		check_error(ec);
+		return res;
+	}
+
 	/**
 	 * Pull a multiplexed chunk of samples and optionally the sample timestamps from the inlet.
 	 *
@@ -1372,6 +1981,30 @@ public:
 		return true;
 	}
 
+	/**
+	 * Pull a chunk of samples into a reusable buffer, without allocating.
+	 *
+	 * The samples are copied straight from the inlet's queue into the buffer, which replaces its
+	 * previous contents.
+	 * @param chunk The buffer; it has to have the inlet's channel count.
+	 * @param timeout The maximum time to wait for the buffer to fill up. The default value of 0.0
+	 * only pulls the samples already received.
+	 * @return The number of samples that were pulled.
+	 * @throws lost_error (if the stream source has been lost), std::invalid_argument if the
+	 * buffer has a different channel count.
+	 */
+	template <class T> std::size_t pull_chunk(chunk_buffer<T> &chunk, double timeout = 0.0) {
+		if (chunk.channels != static_cast<std::size_t>(channel_count))
+			throw std::invalid_argument("The chunk buffer's channel count doesn't match the inlet.");
+		chunk.num_samples = 0;
+		if (chunk.values.empty()) return 0;
+		chunk.num_samples = pull_chunk_multiplexed(chunk.values.data(),
+								chunk.with_stamps ? chunk.stamps.data() : nullptr,
+								chunk.values.size(), chunk.stamps.size(), timeout) /
+							chunk.channels;
+		return chunk.num_samples;
+	}
+
 	/**
 	 * Pull a chunk of samples from the inlet.
 	 *
@@ -1428,53 +2061,1131 @@ public:
 	}
 
 	/**
-	 * Query whether samples are currently available for immediate pickup.
+	 * Borrow up to max_samples samples from the inlet without copying their channel data.
 	 *
-	 * Note that it is not a good idea to use samples_available() to determine whether
-	 * a pull_*() call would block: to be sure, set the pull timeout to 0.0 or an acceptably
-	 * low value. If the underlying implementation supports it, the value will be the number of
-	 * samples available (otherwise it will be 1 or 0).
+	 * @param max_samples The maximum number of samples to borrow.
+	 * @param timeout The timeout for this operation, if any. The default value of 0.0 will
+	 * retrieve only data available for immediate pickup.
+	 * @return A view of the samples that gives read-only access to their channel data and time
+	 * stamps; may be empty.
+	 * @throws lost_error (if the stream source has been lost), std::invalid_argument (for
+	 * string-formatted streams).
 	 */
-	std::size_t samples_available() { return lsl_samples_available(obj.get()); }
+	sample_view borrow_chunk(uint32_t max_samples, double timeout = 0.0) {
+		int32_t ec = 0;
+		lsl_sample_view view = lsl_borrow_chunk(obj.get(), max_samples, timeout, &ec);
+		check_error(ec);
+		return sample_view(view);
+	}
 
-	/// Drop all queued not-yet pulled samples, return the nr of dropped samples
-	uint32_t flush() noexcept { return lsl_inlet_flush(obj.get()); }
+	/**
+	 * Pull a chunk of samples into an Apache Arrow C Data Interface struct array with a time
+	 * stamp column and one column per channel, see lsl_pull_chunk_arrow().
+	 *
+	 * @param[out] array,schema The chunk and its type, to be released by the caller (or the Arrow
+	 * implementation they are imported into).
+	 * @param max_samples The maximum number of samples to pull.
+	 * @param timeout The timeout for this operation, if any. The default value of 0.0 will
+	 * retrieve only data available for immediate pickup.
+	 * @return The number of samples pulled.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	std::size_t pull_chunk_arrow(
+		ArrowArray *array, ArrowSchema *schema, uint32_t max_samples, double timeout = 0.0) {
+		int32_t ec = 0;
+		uint32_t n = lsl_pull_chunk_arrow(obj.get(), array, schema, max_samples, timeout, &ec);
+		check_error(ec);
+		return n;
+	}
 
 	/**
-	 * Query whether the clock was potentially reset since the last call to was_clock_reset().
+	 * Call a function once at least min_samples samples are available for pickup.
 	 *
-	 * This is a rarely-used function that is only useful to applications that combine multiple
-	 * time_correction values to estimate precise clock drift; it allows to tolerate cases where the
-	 * source machine was hot-swapped or restarted in between two measurements.
+	 * This doesn't block: `handler(bool lost)` is called exactly once, either right away or from
+	 * the inlet's data thread. `lost` is true if the stream has been lost (or the inlet is being
+	 * destroyed) before the samples arrived. The handler should pull the samples with a timeout of
+	 * 0.0 or hand off to an event loop, e.g. by posting the completion of an asio operation to
+	 * its executor.
 	 */
-	bool was_clock_reset() { return lsl_was_clock_reset(obj.get()) != 0; }
+	template <class Handler> void async_wait_for_samples(uint32_t min_samples, Handler handler) {
+		auto *fn = new std::function<void(bool)>(std::move(handler));
+		int32_t ec = lsl_async_wait_for_samples(
+			obj.get(), min_samples,
+			[](lsl_inlet, int32_t ec, void *user_data) {
+				std::unique_ptr<std::function<void(bool)>> fn(
+					static_cast<std::function<void(bool)> *>(user_data));
+				(*fn)(ec != lsl_no_error);
+			},
+			fn);
+		if (ec != lsl_no_error) delete fn;
+		check_error(ec);
+	}
 
 	/**
-	 * Override the half-time (forget factor) of the time-stamp smoothing.
+	 * Get a future that becomes ready once at least min_samples samples are available.
 	 *
-	 * The default is 90 seconds unless a different value is set in the config file.
-	 * Using a longer window will yield lower jitter in the time stamps, but longer
-	 * windows will have trouble tracking changes in the clock rate (usually due to
-	 * temperature changes); the default is able to track changes up to 10
-	 * degrees C per minute sufficiently well.
+	 * If the stream has been lost before the samples arrived, the future holds the exception that
+	 * check_error() throws for lost streams.
 	 */
-	void smoothing_halftime(float value) { check_error(lsl_smoothing_halftime(obj.get(), value)); }
+	std::future<void> async_wait_for_samples(uint32_t min_samples) {
+		auto promise = std::make_shared<std::promise<void>>();
+		std::future<void> result = promise->get_future();
+		async_wait_for_samples(min_samples, [promise](bool lost) {
+			try {
+				if (lost) check_error(lsl_lost_error);
+				promise->set_value();
+			} catch (...) { promise->set_exception(std::current_exception()); }
+		});
+		return result;
+	}
 
-	int get_channel_count() const { return channel_count; }
+	/**
+	 * Deliver received chunks to a function instead of queueing them for pull calls.
+	 *
+	 * The function is called from the inlet's data thread as soon as a chunk has been received,
+	 * with a view of the samples that is only valid during the call; an empty view signals that
+	 * the stream has been lost. Pull calls won't return any samples while a function is set.
+	 * Pass an empty function to queue the samples again. The function may replace or remove
+	 * itself.
+	 * @throws std::invalid_argument for string-formatted streams.
+	 */
+	void set_chunk_callback(std::function<void(const sample_view &)> callback) {
+		if (!callback) {
+			check_error(lsl_set_chunk_callback(obj.get(), nullptr, nullptr));
+			retired_chunk_callback = std::move(chunk_callback);
+			return;
+		}
+		auto new_callback = std::make_shared<std::function<void(const sample_view &)>>(
+			std::move(callback));
+		check_error(lsl_set_chunk_callback(obj.get(), &invoke_chunk_callback, new_callback.get()));
+		// the previous function isn't called anymore, but this may have been called from it, so
+		// it's only destroyed with the next change
+		retired_chunk_callback = std::move(chunk_callback);
+		chunk_callback = std::move(new_callback);
+	}
 
-private:
-	// The inlet is a non-copyable object.
-	stream_inlet(const stream_inlet &rhs);
-	stream_inlet &operator=(const stream_inlet &rhs);
+	/**
+	 * Deliver received chunks to a function as blocks of bytes instead of queueing them for pull
+	 * calls, e.g. for recorders that write them to disk as they are (see
+	 * lsl_set_raw_chunk_callback() for when the samples are passed on without decoding them).
+	 *
+	 * The function is called from the inlet's data thread with the chunk, which is only valid
+	 * during the call; a chunk without samples signals that the stream has been lost. Pull calls
+	 * won't return any samples while a function is set. Pass an empty function to queue the
+	 * samples again.
+	 * @throws std::invalid_argument for string-formatted streams.
+	 */
+	void set_raw_chunk_callback(std::function<void(const lsl_raw_chunk &)> callback) {
+		if (!callback) {
+			check_error(lsl_set_raw_chunk_callback(obj.get(), nullptr, nullptr));
+			retired_raw_chunk_callback = std::move(raw_chunk_callback);
+			return;
+		}
+		auto new_callback =
+			std::make_shared<std::function<void(const lsl_raw_chunk &)>>(std::move(callback));
+		check_error(
+			lsl_set_raw_chunk_callback(obj.get(), &invoke_raw_chunk_callback, new_callback.get()));
+		// the previous function isn't called anymore, but this may have been called from it, so
+		// it's only destroyed with the next change
+		retired_raw_chunk_callback = std::move(raw_chunk_callback);
+		raw_chunk_callback = std::move(new_callback);
+	}
 
-	int32_t channel_count;
-	std::shared_ptr<lsl_inlet_struct_> obj;
-};
+	/**
+	 * Write the received samples straight into a ring buffer, e.g. pinned memory that's copied
+	 * to a GPU, instead of queueing them for pull calls (see lsl_set_target_buffer() for the
+	 * layout).
+	 *
+	 * The function is called from the inlet's data thread with the index of the first written
+	 * sample and the number of samples (0 once the stream has been lost); the slots are given
+	 * back with release_target_samples(). Pass a null data pointer to queue the samples again.
+	 * @param element_type The type of the values in the ring (any numeric format).
+	 * @param timestamps Room for capacity time stamps, or nullptr.
+	 * @throws std::invalid_argument for string-formatted streams or element types.
+	 */
+	void set_target_buffer(void *data, channel_format_t element_type, double *timestamps,
+		uint32_t capacity, std::function<void(uint64_t first, uint32_t count)> on_written) {
+		if (!data) {
+			check_error(
+				lsl_set_target_buffer(obj.get(), nullptr, cft_float32, nullptr, 0, nullptr, nullptr));
+			target_callback.reset();
+			return;
+		}
+		auto new_callback =
+			std::make_shared<std::function<void(uint64_t, uint32_t)>>(std::move(on_written));
+		check_error(lsl_set_target_buffer(obj.get(), data,
+			static_cast<lsl_channel_format_t>(element_type), timestamps, capacity,
+			[](lsl_inlet, uint64_t first, uint32_t count, void *user_data) {
+				(*static_cast<std::function<void(uint64_t, uint32_t)> *>(user_data))(first, count);
+			},
+			new_callback.get()));
+		target_callback = std::move(new_callback);
+	}
 
+	/// Give the oldest count samples of the target buffer back to the inlet.
+	void release_target_samples(uint32_t count) {
+		check_error(lsl_release_target_samples(obj.get(), count));
+	}
 
-// =====================
-// ==== XML Element ====
-// =====================
+	/**
+	 * Keep the recent samples in a ring of the library instead of queueing them for pull calls,
+	 * so windows of them can be borrowed as contiguous blocks with borrow_window() (see
+	 * lsl_set_window_buffer()). Pass 0 as capacity to queue the samples again.
+	 * @param element_type The type of the values in the ring (any numeric format).
+	 * @return The number of samples the ring holds, at least min_capacity.
+	 * @throws std::invalid_argument for string-formatted streams or element types.
+	 */
+	uint32_t set_window_buffer(channel_format_t element_type, uint32_t min_capacity) {
+		int32_t ec = 0;
+		uint32_t capacity = lsl_set_window_buffer(
+			obj.get(), static_cast<lsl_channel_format_t>(element_type), min_capacity, &ec);
+		check_error(ec);
+		return capacity;
+	}
+
+	/**
+	 * Borrow the most recent num_samples samples of the window buffer until release_window(),
+	 * see lsl_borrow_window().
+	 * @return The window, without samples if the timeout expired.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	lsl_window borrow_window(uint32_t num_samples, double timeout = FOREVER) {
+		int32_t ec = 0;
+		lsl_window window = lsl_borrow_window(obj.get(), num_samples, timeout, &ec);
+		check_error(ec);
+		return window;
+	}
+
+	/// Give the borrowed window back.
+	void release_window() { check_error(lsl_release_window(obj.get())); }
+
+	/**
+	 * Query whether samples are currently available for immediate pickup.
+	 *
+	 * Note that it is not a good idea to use samples_available() to determine whether
+	 * a pull_*() call would block: to be sure, set the pull timeout to 0.0 or an acceptably
+	 * low value. If the underlying implementation supports it, the value will be the number of
+	 * samples available (otherwise it will be 1 or 0).
+	 */
+	std::size_t samples_available() { return lsl_samples_available(obj.get()); }
+
+	/** Get the transfer statistics of the inlet (received samples, bytes, drops, reconnects etc.).
+	 * See lsl_inlet_stats for the individual counters.
+	 */
+	lsl_inlet_stats stats() {
+		lsl_inlet_stats result{};
+		result.struct_size = sizeof(result);
+		check_error(lsl_get_inlet_stats(obj.get(), &result));
+		return result;
+	}
+
+	/** Record the end-to-end latencies and buffer residence times of the samples.
+	 * The percentiles are reported by stats(); see lsl_track_latency() for details.
+	 * @param enabled True to start with empty histograms, false to stop recording.
+	 */
+	void track_latency(bool enabled = true) { check_error(lsl_track_latency(obj.get(), enabled)); }
+
+	/// Drop all queued not-yet pulled samples, return the nr of dropped samples
+	uint32_t flush() noexcept { return lsl_inlet_flush(obj.get()); }
+
+	/**
+	 * Query whether the clock was potentially reset since the last call to was_clock_reset().
+	 *
+	 * This is a rarely-used function that is only useful to applications that combine multiple
+	 * time_correction values to estimate precise clock drift; it allows to tolerate cases where the
+	 * source machine was hot-swapped or restarted in between two measurements.
+	 */
+	bool was_clock_reset() { return lsl_was_clock_reset(obj.get()) != 0; }
+
+	/**
+	 * Override the half-time (forget factor) of the time-stamp smoothing.
+	 *
+	 * The default is 90 seconds unless a different value is set in the config file.
+	 * Using a longer window will yield lower jitter in the time stamps, but longer
+	 * windows will have trouble tracking changes in the clock rate (usually due to
+	 * temperature changes); the default is able to track changes up to 10
+	 * degrees C per minute sufficiently well.
+	 */
+	void smoothing_halftime(float value) { check_error(lsl_smoothing_halftime(obj.get(), value)); }
+
+	/**
+	 * Set how long pull calls spin, waiting for new samples, before they block.
+	 *
+	 * Spinning avoids the wakeup latency of a blocked thread (tens of microseconds) at the cost
+	 * of keeping a CPU core busy for up to the spin time per pull call.
+	 * @param seconds The maximum spin time per pull call, in seconds; 0 to always block.
+	 */
+	void set_pull_spin_time(double seconds) {
+		check_error(lsl_set_pull_spin_time(obj.get(), seconds));
+	}
+
+	/**
+	 * Let pull_chunk calls with a timeout return once a minimum number of samples is available.
+	 *
+	 * They then return the available samples up to the buffer size instead of waiting for a full
+	 * buffer, and the pulling thread is only woken up once enough samples are there.
+	 * @param min_samples The number of samples to wait for, 0 to wait for a full buffer.
+	 */
+	void set_pull_min_samples(uint32_t min_samples) {
+		check_error(lsl_set_pull_min_samples(obj.get(), min_samples));
+	}
+
+	/**
+	 * Set the socket options of the data connection, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_socket_options(); negative values keep the current setting.
+	 * @param send_buffer_bytes The socket send buffer size, 0 for the system default.
+	 * @param receive_buffer_bytes The socket receive buffer size, 0 for the system default.
+	 * @param no_delay 1 to disable Nagle's algorithm, 0 to enable it.
+	 * @param busy_poll_us The busy-poll time of socket reads in microseconds (Linux only).
+	 */
+	void set_socket_options(int32_t send_buffer_bytes, int32_t receive_buffer_bytes = -1,
+		int32_t no_delay = -1, int32_t busy_poll_us = -1) {
+		check_error(lsl_set_inlet_socket_options(
+			obj.get(), send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us));
+	}
+
+	/**
+	 * Ask the outlet to send the samples by multicast, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_multicast(); the inlet falls back to TCP if the datagrams don't arrive.
+	 */
+	void set_multicast(bool enabled = true) {
+		check_error(lsl_set_inlet_multicast(obj.get(), enabled));
+	}
+
+	/**
+	 * Ask the outlet to send the samples as datagrams that aren't retransmitted when lost, from
+	 * the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_datagrams(); lost samples are counted in stats().samples_lost.
+	 */
+	void set_datagrams(bool enabled = true) {
+		check_error(lsl_set_inlet_datagrams(obj.get(), enabled));
+	}
+
+	/**
+	 * Take the samples straight from the outlet's send buffer if the outlet is in the same
+	 * process, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_in_process(); the samples are shared with the outlet instead of being
+	 * sent over a loopback connection.
+	 */
+	void set_in_process(bool enabled = true) {
+		check_error(lsl_set_inlet_in_process(obj.get(), enabled));
+	}
+
+	/**
+	 * Share a connection with the other streams of the outlet's process, from the next
+	 * (re-)connection on.
+	 *
+	 * See lsl_set_inlet_bundling(); streams that can't be bundled get a connection of their own.
+	 */
+	void set_bundling(bool enabled = true) {
+		check_error(lsl_set_inlet_bundling(obj.get(), enabled));
+	}
+
+	/**
+	 * Receive the samples of an outlet in another process on the same host through shared
+	 * memory, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_shared_memory(); streams that can't be passed this way use the network.
+	 */
+	void set_shared_memory(bool enabled = true) {
+		check_error(lsl_set_inlet_shared_memory(obj.get(), enabled));
+	}
+
+	/**
+	 * Resample the stream to up/down times its rate, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_resampling(); the outlet resamples the stream if server_side is set and
+	 * it supports that, otherwise the inlet does.
+	 * @throws std::invalid_argument if the stream can't be resampled.
+	 */
+	void set_resampling(uint32_t up, uint32_t down, bool server_side = true) {
+		check_error(lsl_set_inlet_resampling(obj.get(), up, down, server_side));
+	}
+
+	/**
+	 * Receive only the samples of a string stream whose first channel equals one of the values
+	 * or starts with one of the prefixes, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_value_filter(); without values and prefixes, all samples are received.
+	 * @throws std::invalid_argument if the stream is numeric.
+	 */
+	void set_value_filter(const std::vector<std::string> &values,
+		const std::vector<std::string> &prefixes = std::vector<std::string>()) {
+		std::vector<const char *> value_ptrs, prefix_ptrs;
+		for (const auto &value : values) value_ptrs.push_back(value.c_str());
+		for (const auto &prefix : prefixes) prefix_ptrs.push_back(prefix.c_str());
+		check_error(lsl_set_inlet_value_filter(obj.get(), value_ptrs.data(),
+			(uint32_t)value_ptrs.size(), prefix_ptrs.data(), (uint32_t)prefix_ptrs.size(), nullptr,
+			0));
+	}
+
+	/**
+	 * Receive only the samples of a numeric stream whose first channel lies in one of the
+	 * (inclusive) ranges, from the next (re-)connection on.
+	 *
+	 * See lsl_set_inlet_value_filter(); without ranges, all samples are received.
+	 * @throws std::invalid_argument if the stream is a string stream or a range is empty.
+	 */
+	void set_range_filter(const std::vector<std::pair<double, double>> &ranges) {
+		std::vector<double> bounds;
+		for (const auto &range : ranges) {
+			bounds.push_back(range.first);
+			bounds.push_back(range.second);
+		}
+		check_error(lsl_set_inlet_value_filter(
+			obj.get(), nullptr, 0, nullptr, 0, bounds.data(), (uint32_t)ranges.size()));
+	}
+
+	/**
+	 * Convert the channel values to physical units while they're pulled into float or double
+	 * buffers: channel k is pulled as `value * gains[k] + offsets[k]`.
+	 *
+	 * See lsl_set_inlet_calibration(); without gains and offsets, the values aren't calibrated.
+	 * @param gains One gain per channel, or none for gains of 1.
+	 * @param offsets One offset per channel, or none for offsets of 0.
+	 * @throws std::invalid_argument for string streams or if a number of values doesn't match
+	 * the channel count.
+	 */
+	void set_calibration(
+		const std::vector<double> &gains, const std::vector<double> &offsets = {}) {
+		if ((!gains.empty() && gains.size() != (std::size_t)channel_count) ||
+			(!offsets.empty() && offsets.size() != (std::size_t)channel_count))
+			throw std::invalid_argument("There must be one gain and offset per channel.");
+		check_error(lsl_set_inlet_calibration(obj.get(), gains.empty() ? nullptr : gains.data(),
+			offsets.empty() ? nullptr : offsets.data()));
+	}
+
+	/**
+	 * Calibrate the pulls with the `gain` and `offset` elements of the channels in the stream's
+	 * description, see lsl_set_inlet_calibration_from_desc().
+	 * @throws timeout_error if the description couldn't be retrieved within the timeout.
+	 */
+	void set_calibration_from_desc(double timeout = FOREVER) {
+		check_error(lsl_set_inlet_calibration_from_desc(obj.get(), timeout));
+	}
+
+	/**
+	 * Request the samples the outlet pushed during the last seconds when the stream is opened.
+	 *
+	 * The outlet has to keep a history (see stream_outlet::set_history()). This has to be called
+	 * before the stream is opened.
+	 * @param seconds The amount of data to request, in seconds; 0 to only receive new samples.
+	 */
+	void request_history(double seconds) { check_error(lsl_request_history(obj.get(), seconds)); }
+
+	/**
+	 * Choose what the outlet does when this inlet's buffer is full.
+	 *
+	 * Has to be set before the stream is opened; see lsl_set_overflow_policy() for details.
+	 * @param policy The overflow policy (the default is overflow_drop_oldest).
+	 * @param parameter For overflow_block, the maximum time (in seconds) the outlet waits for
+	 * room. For overflow_decimate, the decimation factor (at least 2).
+	 */
+	void set_overflow_policy(overflow_policy_t policy, double parameter = 0.0) {
+		check_error(lsl_set_overflow_policy(
+			obj.get(), static_cast<lsl_overflow_policy_t>(policy), parameter));
+	}
+
+	/**
+	 * Set how urgently the outlet serves this inlet when it serves many inlets at once.
+	 *
+	 * Has to be set before the stream is opened; see lsl_set_inlet_priority() for details.
+	 */
+	void set_priority(transfer_priority_t priority) {
+		check_error(
+			lsl_set_inlet_priority(obj.get(), static_cast<lsl_transfer_priority_t>(priority)));
+	}
+
+	/**
+	 * Change the buffer length and the maximum chunk size without reconnecting.
+	 *
+	 * See lsl_set_inlet_buffering(); the values have the units of the constructor.
+	 */
+	void set_buffering(int32_t max_buflen, int32_t max_chunklen = 0) {
+		check_error(lsl_set_inlet_buffering(obj.get(), max_buflen, max_chunklen));
+	}
+
+	/**
+	 * Limit the bandwidth the outlet sends this inlet's samples with (0 for no limit).
+	 *
+	 * Has to be set before the stream is opened; see lsl_set_inlet_max_bandwidth() for details.
+	 */
+	void set_max_bandwidth(double bytes_per_second) {
+		check_error(lsl_set_inlet_max_bandwidth(obj.get(), bytes_per_second));
+	}
+
+	/**
+	 * Fail over to another stream with the same source_id when this one breaks down, e.g. to a
+	 * hot standby; see lsl_set_inlet_failover() for details.
+	 */
+	void set_failover(bool enabled = true) {
+		check_error(lsl_set_inlet_failover(obj.get(), enabled));
+	}
+
+	int get_channel_count() const { return channel_count; }
+
+private:
+	// The inlet is a non-copyable object.
+	stream_inlet(const stream_inlet &rhs);
+	stream_inlet &operator=(const stream_inlet &rhs);
+
+	static void invoke_chunk_callback(lsl_inlet, lsl_sample_view view, void *user_data) {
+		(*static_cast<std::function<void(const sample_view &)> *>(user_data))(
+			sample_view(view, false));
+	}
+
+	static void invoke_raw_chunk_callback(lsl_inlet, const lsl_raw_chunk *chunk, void *user_data) {
+		(*static_cast<std::function<void(const lsl_raw_chunk &)> *>(user_data))(*chunk);
+	}
+
+	int32_t channel_count;
+	std::shared_ptr<lsl_inlet_struct_> obj;
+	std::shared_ptr<std::function<void(const sample_view &)>> chunk_callback;
+	std::shared_ptr<std::function<void(const lsl_raw_chunk &)>> raw_chunk_callback;
+	std::shared_ptr<std::function<void(const sample_view &)>> retired_chunk_callback;
+	std::shared_ptr<std::function<void(const lsl_raw_chunk &)>> retired_raw_chunk_callback;
+	std::shared_ptr<std::function<void(uint64_t, uint32_t)>> target_callback;
+};
+
+/**
+ * Open the data streams of several inlets at once (see lsl_open_streams()): their handshakes
+ * overlap, so this takes about as long as opening the slowest of them.
+ * @param inlets The inlets to open.
+ * @param timeout The time all inlets together may take.
+ * @param errors Receives the error code of each inlet (lsl_no_error if it has been opened), or
+ * nullptr to ignore them.
+ * @return The number of inlets whose stream has been opened.
+ */
+inline uint32_t open_streams(const std::vector<stream_inlet *> &inlets, double timeout = FOREVER,
+	std::vector<int32_t> *errors = nullptr) {
+	std::vector<lsl_inlet> handles;
+	handles.reserve(inlets.size());
+	for (stream_inlet *inlet : inlets) handles.push_back(inlet->handle().get());
+	if (errors) errors->assign(inlets.size(), lsl_no_error);
+	return lsl_open_streams(handles.data(), static_cast<uint32_t>(handles.size()), timeout,
+		errors ? errors->data() : nullptr);
+}
+
+// ====================================
+// ==== Typed Outlets and Inlets ====
+// ====================================
+
+/// The channel format that holds values of type T, for typed_outlet and typed_inlet.
+template <class T> struct channel_format_of;
+template <> struct channel_format_of<float> { static const channel_format_t value = cf_float32; };
+template <> struct channel_format_of<double> { static const channel_format_t value = cf_double64; };
+template <> struct channel_format_of<int64_t> { static const channel_format_t value = cf_int64; };
+template <> struct channel_format_of<int32_t> { static const channel_format_t value = cf_int32; };
+template <> struct channel_format_of<int16_t> { static const channel_format_t value = cf_int16; };
+template <> struct channel_format_of<char> { static const channel_format_t value = cf_int8; };
+
+/// Check that a stream has N channels of type T, throw std::invalid_argument if not.
+template <class T, int32_t N> const stream_info &check_typed_info(const stream_info &info) {
+	if (info.channel_format() != channel_format_of<T>::value || info.channel_count() != N)
+		throw std::invalid_argument("The stream " + info.name() + " has " +
+									std::to_string(info.channel_count()) +
+									" channels of a different type than requested.");
+	return info;
+}
+
+/** An outlet for a stream with a fixed number of channels of type T.
+ *
+ * The channel format and count are checked once at construction, so the samples are pushed as
+ * raw data without per-call checks or conversions, e.g. for high-rate sensors with a few channels.
+ */
+template <class T, int32_t N> class typed_outlet : public stream_outlet {
+	static_assert(sizeof(std::array<T, N>) == N * sizeof(T), "std::array must not be padded");
+
+public:
+	using sample_type = std::array<T, N>;
+
+	/// Create an outlet for a new stream with N channels of type T, see stream_info.
+	typed_outlet(const std::string &name, const std::string &type,
+		double nominal_srate = IRREGULAR_RATE, const std::string &source_id = std::string(),
+		int32_t chunk_size = 0, int32_t max_buffered = 360)
+		: stream_outlet(
+			  stream_info(name, type, N, nominal_srate, channel_format_of<T>::value, source_id),
+			  chunk_size, max_buffered) {}
+
+	/**
+	 * Create an outlet for a stream info that has to describe N channels of type T.
+	 * @throws std::invalid_argument if it doesn't.
+	 */
+	explicit typed_outlet(
+		const stream_info &info, int32_t chunk_size = 0, int32_t max_buffered = 360)
+		: stream_outlet(check_typed_info<T, N>(info), chunk_size, max_buffered) {}
+
+	using stream_outlet::push_sample;
+	using stream_outlet::push_chunk_multiplexed;
+
+	/// Push a sample, see stream_outlet::push_sample().
+	void push_sample(const sample_type &data, double timestamp = 0.0, bool pushthrough = true) {
+		push_numeric_raw(data.data(), timestamp, pushthrough);
+	}
+
+	/// Push a chunk of samples, see stream_outlet::push_chunk_multiplexed().
+	void push_chunk(
+		const std::vector<sample_type> &samples, double timestamp = 0.0, bool pushthrough = true) {
+		if (!samples.empty())
+			push_chunk_multiplexed(
+				samples.front().data(), samples.size() * N, timestamp, pushthrough);
+	}
+
+	/// Push a chunk of samples with one time stamp per sample.
+	void push_chunk(const std::vector<sample_type> &samples, const std::vector<double> &timestamps,
+		bool pushthrough = true) {
+		if (samples.size() != timestamps.size())
+			throw std::invalid_argument("There has to be one time stamp per sample.");
+		if (!samples.empty())
+			push_chunk_multiplexed(
+				samples.front().data(), timestamps.data(), samples.size() * N, pushthrough);
+	}
+};
+
+/** An inlet for a stream with a fixed number of channels of type T.
+ *
+ * The channel format and count are checked once at construction, so the samples are pulled as
+ * raw data without per-call checks or conversions.
+ */
+template <class T, int32_t N> class typed_inlet : public stream_inlet {
+	static_assert(sizeof(std::array<T, N>) == N * sizeof(T), "std::array must not be padded");
+
+public:
+	using sample_type = std::array<T, N>;
+
+	/**
+	 * Create an inlet for a stream that has to have N channels of type T, see stream_inlet.
+	 * @throws std::invalid_argument if it doesn't.
+	 */
+	explicit typed_inlet(const stream_info &info, int32_t max_buflen = 360,
+		int32_t max_chunklen = 0, bool recover = true)
+		: stream_inlet(check_typed_info<T, N>(info), max_buflen, max_chunklen, recover) {}
+
+	using stream_inlet::pull_sample;
+
+	/// Pull a sample, see stream_inlet::pull_sample().
+	double pull_sample(sample_type &sample, double timeout = FOREVER) {
+		return pull_numeric_raw(sample.data(), static_cast<int32_t>(sizeof(sample)), timeout);
+	}
+
+	/**
+	 * Pull up to max_samples samples, see stream_inlet::pull_chunk_multiplexed().
+	 * @param chunk Holds the samples that were pulled (its capacity is reused).
+	 * @param timestamps If not null, holds the time stamps of the samples.
+	 * @return The number of samples that were pulled.
+	 */
+	std::size_t pull_chunk(std::vector<sample_type> &chunk, std::vector<double> *timestamps,
+		std::size_t max_samples, double timeout = 0.0) {
+		chunk.resize(max_samples);
+		if (timestamps) timestamps->resize(max_samples);
+		std::size_t n = 0;
+		if (max_samples)
+			n = pull_chunk_multiplexed(chunk.front().data(),
+					timestamps ? timestamps->data() : nullptr, max_samples * N,
+					timestamps ? max_samples : 0, timeout) /
+				N;
+		chunk.resize(n);
+		if (timestamps) timestamps->resize(n);
+		return n;
+	}
+};
+
+/** Buffers the samples pushed into an outlet on the caller's side and pushes them as a chunk.
+ *
+ * Each push_sample() only copies the values into the session's buffer, and the outlet is called
+ * once every max_samples samples (and on flush() or destruction), so pushing many small samples
+ * doesn't cross the library boundary for each of them. The samples keep their own time stamps
+ * (taken when they're pushed into the session), but reach the inlets up to max_samples samples
+ * later, so this is for throughput rather than latency.
+ *
+ * The outlet has to outlive the session; a session isn't thread-safe. Like std::ofstream, the
+ * destructor pushes the remaining samples but swallows any error, so callers that need to know
+ * whether all samples were pushed must call flush() before the session is destroyed.
+ * @tparam T The numeric type of the pushed values.
+ */
+template <class T> class push_session {
+public:
+	/// Start a session for an outlet that pushes up to max_samples samples at a time.
+	push_session(stream_outlet &outlet, std::size_t max_samples)
+		: outlet(outlet), channels(static_cast<std::size_t>(outlet.info().channel_count())),
+		  max_samples(max_samples ? max_samples : 1) {
+		values.reserve(channels * this->max_samples);
+		stamps.reserve(this->max_samples);
+	}
+
+	/// Push the buffered samples, ignoring errors (call flush() first to see them).
+	~push_session() {
+		try {
+			flush();
+		} catch (...) {}
+	}
+
+	push_session(const push_session &) = delete;
+	push_session &operator=(const push_session &) = delete;
+
+	/**
+	 * Add a sample (one value per channel) to the buffer.
+	 * @param timestamp Optionally the capture time of the sample, in agreement with
+	 * lsl::local_clock(); if omitted, the current time is used.
+	 */
+	void push_sample(const T *data, double timestamp = 0.0) {
+		values.insert(values.end(), data, data + channels);
+		stamps.push_back(timestamp == 0.0 ? local_clock() : timestamp);
+		if (stamps.size() == max_samples) flush();
+	}
+
+	/// Add a sample, see push_sample(const T *, double).
+	void push_sample(const std::vector<T> &data, double timestamp = 0.0) {
+		if (data.size() != channels)
+			throw std::invalid_argument("The sample's size doesn't match the channel count.");
+		push_sample(data.data(), timestamp);
+	}
+
+	/**
+	 * Push the buffered samples into the outlet now.
+	 * @return The number of samples that were pushed.
+	 * @throws std::exception if the outlet can't take them, in which case they stay buffered.
+	 */
+	std::size_t flush() {
+		const std::size_t n = stamps.size();
+		if (n) outlet.push_chunk_multiplexed(values.data(), stamps.data(), values.size(), true);
+		values.clear();
+		stamps.clear();
+		return n;
+	}
+
+	/// The number of buffered samples.
+	std::size_t size() const noexcept { return stamps.size(); }
+
+private:
+	stream_outlet &outlet;
+	std::size_t channels, max_samples;
+	std::vector<T> values;
+	std::vector<double> stamps;
+};
+
+/** Pulls the samples of an inlet in chunks and hands them out one at a time.
+ *
+ * Each pull_sample() is served from a chunk_buffer that is refilled with a single pull of all
+ * samples the inlet has received (up to max_samples), so pulling many small samples doesn't cross
+ * the library boundary for each of them.
+ *
+ * The inlet has to outlive the session; a session isn't thread-safe.
+ * @tparam T The numeric type to convert the channel data to.
+ */
+template <class T> class pull_session {
+public:
+	/// Start a session for an inlet that pulls up to max_samples samples at a time.
+	pull_session(stream_inlet &inlet, std::size_t max_samples)
+		: inlet(inlet), chunk(static_cast<std::size_t>(inlet.get_channel_count()),
+							max_samples ? max_samples : 1) {}
+
+	pull_session(const pull_session &) = delete;
+	pull_session &operator=(const pull_session &) = delete;
+
+	/**
+	 * Pull a sample, see stream_inlet::pull_sample().
+	 * @param data A buffer for the sample's values (one per channel).
+	 * @param timeout The maximum time to wait if no samples are buffered or available.
+	 * @return The capture time of the sample, or 0.0 if none was available within the timeout.
+	 * @throws lost_error (if the stream source has been lost)
+	 */
+	double pull_sample(T *data, double timeout = FOREVER) {
+		if (next == chunk.size()) {
+			next = 0;
+			// only wait (for a single sample) if none were received yet
+			if (!inlet.pull_chunk(chunk))
+				return inlet.pull_sample(
+					data, static_cast<int32_t>(chunk.channel_count()), timeout);
+		}
+		std::copy(chunk.sample(next), chunk.sample(next) + chunk.channel_count(), data);
+		return chunk.timestamp(next++);
+	}
+
+	/// Pull a sample, see pull_sample(T *, double).
+	double pull_sample(std::vector<T> &data, double timeout = FOREVER) {
+		data.resize(chunk.channel_count());
+		return pull_sample(data.data(), timeout);
+	}
+
+	/// The number of samples that were pulled from the inlet but not handed out yet.
+	std::size_t available() const noexcept { return chunk.size() - next; }
+
+private:
+	stream_inlet &inlet;
+	chunk_buffer<T> chunk;
+	std::size_t next{0};
+};
+
+/** A set of inlets that a single thread can wait on until any of them has data available.
+ *
+ * This allows one thread to service many inlets without polling each of them or dedicating a
+ * thread to every inlet. The set keeps its inlets' underlying objects alive, but the stream_inlet
+ * objects themselves must not be moved or destroyed while they're members of the set.
+ */
+class inlet_set {
+public:
+	inlet_set() : obj(lsl_create_inlet_set(), &lsl_destroy_inlet_set) {}
+
+	/// Add an inlet to the set. This implicitly opens its stream without waiting for it.
+	void add(stream_inlet &inlet) {
+		check_error(lsl_inlet_set_add(obj.get(), inlet.handle().get()));
+		inlets.push_back(&inlet);
+		handles.push_back(inlet.handle());
+	}
+
+	/// Remove an inlet from the set.
+	void remove(stream_inlet &inlet) {
+		lsl_inlet_set_remove(obj.get(), inlet.handle().get());
+		for (std::size_t k = 0; k < inlets.size(); ++k)
+			if (inlets[k] == &inlet) {
+				inlets.erase(inlets.begin() + k);
+				handles.erase(handles.begin() + k);
+				break;
+			}
+	}
+
+	/**
+	 * Wait until at least one inlet has min_samples samples available (or its stream was lost).
+	 * @param min_samples The number of samples an inlet needs to have available to be ready.
+	 * @param timeout The maximum time to wait, in seconds; 0.0 only checks the inlets.
+	 * @return The ready inlets, in the order they were added; empty if the timeout expired.
+	 */
+	std::vector<stream_inlet *> wait(uint32_t min_samples = 1, double timeout = FOREVER) {
+		std::vector<lsl_inlet> ready_handles(inlets.size());
+		int32_t ec = 0;
+		uint32_t n = lsl_inlet_set_wait(obj.get(), min_samples, ready_handles.data(),
+			static_cast<uint32_t>(ready_handles.size()), timeout, &ec);
+		check_error(ec);
+		std::vector<stream_inlet *> ready;
+		for (std::size_t k = 0, r = 0; k < inlets.size() && r < n; ++k)
+			if (handles[k].get() == ready_handles[r]) {
+				ready.push_back(inlets[k]);
+				++r;
+			}
+		return ready;
+	}
+
+private:
+	std::vector<stream_inlet *> inlets;
+	std::vector<std::shared_ptr<lsl_inlet_struct_>> handles;
+	// declared last so the set is destroyed before the inlets it refers to
+	std::unique_ptr<lsl_inlet_set_struct_, void (*)(lsl_inlet_set)> obj;
+};
+
+/** Reads the samples of several inlets in the global order of their time stamps.
+ *
+ * Each inlet's samples are pulled in chunks into a buffer of its own, and a heap of the buffers'
+ * first samples merges them, so a time-aligned view of e.g. EEG, eye tracking and markers costs
+ * one pull per chunk instead of one per sample. A sample is handed out once every stream has
+ * received samples up to its time stamp, or once it's older than the maximum delay (so streams
+ * that don't send anything, e.g. markers, don't hold back the others), or once its stream's
+ * buffer is full. The time stamps have to be comparable, i.e. on the local clock, so the inlets of
+ * remote streams should post-process them with proc_clocksync (see
+ * stream_inlet::set_postprocessing()).
+ *
+ * The inlets have to outlive the reader and are members of its inlet_set, so they can't be
+ * members of another set; a reader isn't thread-safe.
+ * @tparam T The type to convert the channel data to.
+ */
+template <class T> class merge_reader {
+public:
+	/// A chunk of merged samples of several streams.
+	struct chunk {
+		/// the index of each sample's inlet
+		std::vector<std::size_t> streams;
+		std::vector<double> timestamps;
+		/// the position of each sample's first value in values
+		std::vector<std::size_t> offsets;
+		/// the values of all samples, back to back
+		std::vector<T> values;
+
+		/// The number of samples.
+		std::size_t size() const noexcept { return timestamps.size(); }
+
+		/// The values of a sample (one per channel of its stream).
+		const T *sample(std::size_t k) const { return values.data() + offsets[k]; }
+
+		void clear() {
+			streams.clear();
+			timestamps.clear();
+			offsets.clear();
+			values.clear();
+		}
+	};
+
+	/**
+	 * Start reading the inlets. This implicitly opens their streams without waiting for them.
+	 * @param inlets The inlets; the samples refer to them by their index in this list.
+	 * @param max_delay The maximum time, in seconds, a sample waits for the other streams.
+	 * @param max_samples The maximum number of samples buffered per inlet.
+	 */
+	merge_reader(const std::vector<stream_inlet *> &inlets, double max_delay = 0.5,
+		std::size_t max_samples = 1024)
+		: max_delay(max_delay), max_samples(max_samples ? max_samples : 1) {
+		for (stream_inlet *inlet : inlets) {
+			source s;
+			s.inlet = inlet;
+			s.channels = static_cast<std::size_t>(inlet->get_channel_count());
+			sources.push_back(std::move(s));
+			set.add(*inlet);
+		}
+	}
+
+	merge_reader(const merge_reader &) = delete;
+	merge_reader &operator=(const merge_reader &) = delete;
+
+	/**
+	 * Pull the samples that are due, in the order of their time stamps.
+	 * @param out Receives the samples (its previous contents are discarded).
+	 * @param timeout The maximum time to wait for samples to become due; 0.0 only takes those
+	 * that are due already.
+	 * @return The number of samples.
+	 * @throws lost_error if the stream of an inlet was lost.
+	 */
+	std::size_t pull_chunk(chunk &out, double timeout = 0.0) {
+		out.clear();
+		const double deadline = local_clock() + timeout;
+		while (true) {
+			for (std::size_t k = 0; k < sources.size(); ++k) refill(k);
+			// the time up to which every stream has delivered its samples (or waited long enough)
+			const double now = local_clock();
+			double due = std::numeric_limits<double>::infinity();
+			for (const source &s : sources) due = std::min(due, std::max(s.last, now - max_delay));
+			// full buffers hand out half of their samples (and the others' samples before them)
+			for (const source &s : sources)
+				if (s.stamps.size() - s.next >= max_samples)
+					due = std::max(due, s.stamps[s.next + (max_samples - 1) / 2]);
+			while (!heads.empty() && heads.top().first <= due) take(out);
+			if (out.size() || now >= deadline) return out.size();
+			// wait for new samples, or until the first held back sample is due
+			double wait = deadline - now;
+			if (!heads.empty()) wait = std::min(wait, heads.top().first + max_delay - now);
+			set.wait(1, std::max(wait, 0.0));
+		}
+	}
+
+private:
+	/// An inlet and its buffered samples.
+	struct source {
+		stream_inlet *inlet;
+		std::size_t channels;
+		std::vector<T> values;
+		std::vector<double> stamps;
+		/// the next sample to hand out
+		std::size_t next{0};
+		/// the time stamp of the last received sample
+		double last{-std::numeric_limits<double>::infinity()};
+	};
+
+	/// Pull the samples an inlet has received into its buffer.
+	void refill(std::size_t k) {
+		source &s = sources[k];
+		if (s.stamps.size() - s.next >= max_samples || !s.inlet->samples_available()) return;
+		const bool empty = s.next == s.stamps.size();
+		// drop the samples that were handed out
+		s.values.erase(s.values.begin(), s.values.begin() + s.next * s.channels);
+		s.stamps.erase(s.stamps.begin(), s.stamps.begin() + s.next);
+		s.next = 0;
+		const std::size_t have = s.stamps.size(), room = max_samples - have;
+		s.values.resize((have + room) * s.channels);
+		s.stamps.resize(have + room);
+		const std::size_t n = s.channels ? s.inlet->pull_chunk_multiplexed(
+											   s.values.data() + have * s.channels,
+											   s.stamps.data() + have, room * s.channels, room) /
+											   s.channels
+										 : 0;
+		s.values.resize((have + n) * s.channels);
+		s.stamps.resize(have + n);
+		if (n) s.last = std::max(s.last, s.stamps.back());
+		if (empty && n) heads.emplace(s.stamps.front(), k);
+	}
+
+	/// Hand out the first sample of the heap.
+	void take(chunk &out) {
+		const std::size_t k = heads.top().second;
+		heads.pop();
+		source &s = sources[k];
+		out.streams.push_back(k);
+		out.timestamps.push_back(s.stamps[s.next]);
+		out.offsets.push_back(out.values.size());
+		out.values.insert(out.values.end(), s.values.begin() + s.next * s.channels,
+			s.values.begin() + (s.next + 1) * s.channels);
+		if (++s.next < s.stamps.size()) heads.emplace(s.stamps[s.next], k);
+	}
+
+	double max_delay;
+	std::size_t max_samples;
+	std::vector<source> sources;
+	/// the time stamp of each non-empty buffer's next sample, earliest first
+	std::priority_queue<std::pair<double, std::size_t>, std::vector<std::pair<double, std::size_t>>,
+		std::greater<std::pair<double, std::size_t>>>
+		heads;
+	inlet_set set;
+};
+
+/** A recording of inlets into an XDF file.
+ *
+ * The samples are written as they're received, with their original time stamps and the clock
+ * offsets of the time synchronization, without being copied into user buffers. The recording
+ * keeps its inlets' underlying objects alive; their samples can't be pulled while they're
+ * recorded. The file is complete once the recording is destroyed.
+ */
+class recording {
+public:
+	/**
+	 * Create a new XDF file (an existing file is overwritten).
+	 * @throws std::runtime_error if the file can't be created.
+	 */
+	explicit recording(const std::string &filename)
+		: obj(lsl_create_recording(filename.c_str()), &lsl_destroy_recording) {
+		if (!obj) throw std::runtime_error(lsl_last_error());
+	}
+
+	/**
+	 * Start recording an inlet. This implicitly opens its stream without waiting for it.
+	 * @param inlet The inlet to record.
+	 * @param timeout How long to wait for the inlet's full stream info.
+	 * @throws timeout_error if the stream info wasn't received in time.
+	 */
+	void add(stream_inlet &inlet, double timeout = 5.0) {
+		check_error(lsl_recording_add(obj.get(), inlet.handle().get(), timeout));
+		handles.push_back(inlet.handle());
+	}
+
+	/// Stop recording an inlet; its samples are queued for pull calls again.
+	void remove(stream_inlet &inlet) {
+		lsl_recording_remove(obj.get(), inlet.handle().get());
+		for (std::size_t k = 0; k < handles.size(); ++k)
+			if (handles[k] == inlet.handle()) {
+				handles.erase(handles.begin() + k);
+				break;
+			}
+	}
+
+private:
+	std::vector<std::shared_ptr<lsl_inlet_struct_>> handles;
+	// declared last so the recording is closed before the inlets it refers to are released
+	std::unique_ptr<lsl_recording_struct_, void (*)(lsl_recording)> obj;
+};
+
+/** The playback of an XDF file (e.g. a recording) through outlets.
+ *
+ * An outlet is created for each stream in the file, so inlets can connect before the playback
+ * is started. The samples are pushed straight from the memory-mapped file into the outlets'
+ * buffers with the original timing (optionally sped up) and new time stamps of the local clock.
+ */
+class replay {
+public:
+	/**
+	 * Open a file for playback and create the outlets.
+	 * @param filename The name of the file.
+	 * @param speed The playback speed relative to the original timing.
+	 * @throws std::runtime_error if the file can't be opened or isn't an XDF file.
+	 */
+	explicit replay(const std::string &filename, double speed = 1.0)
+		: obj(lsl_create_replay(filename.c_str(), speed), &lsl_destroy_replay) {
+		if (!obj) throw std::runtime_error(lsl_last_error());
+	}
+
+	/// The stream infos of the outlets.
+	std::vector<stream_info> infos() const {
+		std::vector<stream_info> result;
+		for (int32_t k = 0, n = lsl_replay_stream_count(obj.get()); k < n; ++k)
+			result.emplace_back(lsl_replay_get_info(obj.get(), k));
+		return result;
+	}
+
+	/// Start the playback. Does nothing if it was started already.
+	void start() { lsl_replay_start(obj.get()); }
+
+	/**
+	 * Wait until all samples were pushed.
+	 * @param timeout The maximum time to wait, in seconds.
+	 * @return false if the timeout expired before.
+	 */
+	bool wait(double timeout = FOREVER) { return lsl_replay_wait(obj.get(), timeout) != 0; }
+
+private:
+	std::unique_ptr<lsl_replay_struct_, void (*)(lsl_replay)> obj;
+};
+
+/** Re-publishes the streams of other outlets.
+ *
+ * Each added stream is received once and re-published by an outlet with the same metadata and
+ * UID, so the source's load doesn't grow with the number of inlets that connect to the relay.
+ * A relayed stream ends with its source. See lsl_create_relay().
+ */
+class relay {
+public:
+	relay() : obj(lsl_create_relay(), &lsl_destroy_relay) {
+		if (!obj) throw std::runtime_error("Could not create a relay.");
+	}
+
+	/**
+	 * Start relaying a stream.
+	 * @param info The stream info of the source, e.g. from resolve_streams().
+	 * @param timeout How long to wait for the source's full stream info and clock offset.
+	 * @throws std::invalid_argument if the stream is relayed already, timeout_error if the
+	 * source didn't answer in time, lost_error if it's gone.
+	 */
+	void add(const stream_info &info, double timeout = 5.0) {
+		check_error(lsl_relay_add(obj.get(), info.handle().get(), timeout));
+	}
+
+	/// The number of relayed streams, not counting those whose source is gone.
+	int32_t size() const { return lsl_relay_stream_count(obj.get()); }
+
+	/// The stream infos of the relay's outlets.
+	std::vector<stream_info> infos() const {
+		std::vector<stream_info> result;
+		for (int32_t k = 0, n = lsl_relay_stream_count(obj.get()); k < n; ++k)
+			if (lsl_streaminfo info = lsl_relay_get_info(obj.get(), k)) result.emplace_back(info);
+		return result;
+	}
+
+private:
+	std::unique_ptr<lsl_relay_struct_, void (*)(lsl_relay)> obj;
+};
+
+/** Publishes the outlets of the processes on this host.
+ *
+ * Processes whose configuration sets `[tuning] HostDaemon` to the daemon's socket path hand
+ * their outlets' samples to the daemon through shared memory instead of serving them. See
+ * lsl_create_host_daemon().
+ */
+class host_daemon {
+public:
+	/// @throws std::runtime_error if the socket can't be bound or this isn't a POSIX system.
+	explicit host_daemon(const std::string &path)
+		: obj(lsl_create_host_daemon(path.c_str()), &lsl_destroy_host_daemon) {
+		if (!obj) throw std::runtime_error(lsl_last_error());
+	}
+
+	/// The number of published streams, not counting those whose process is gone.
+	int32_t size() const { return lsl_host_daemon_stream_count(obj.get()); }
+
+	/// The stream infos of the daemon's outlets.
+	std::vector<stream_info> infos() const {
+		std::vector<stream_info> result;
+		for (int32_t k = 0, n = lsl_host_daemon_stream_count(obj.get()); k < n; ++k)
+			if (lsl_streaminfo info = lsl_host_daemon_get_info(obj.get(), k))
+				result.emplace_back(info);
+		return result;
+	}
+
+private:
+	std::unique_ptr<lsl_host_daemon_struct_, void (*)(lsl_host_daemon)> obj;
+};
+
+
+// =====================
+// ==== XML Element ====
+// =====================
 
 /**
  * A lightweight XML element tree; models the .desc() field of stream_info.
@@ -1608,6 +3319,140 @@ private:
 inline xml_element stream_info::desc() { return lsl_get_desc(obj.get()); }
 
 
+// =======================
+// ==== Outlet Groups ====
+// =======================
+
+/**
+ * An outlet that publishes several streams of one device (and one clock) as a single stream.
+ *
+ * Each sample of the group holds the channels of all members back to back with one time stamp, so
+ * subscribers get the members aligned over one connection; group_members() splits the group's
+ * channels up again. See lsl_create_outlet_group().
+ */
+class outlet_group {
+public:
+	/**
+	 * Create the group's outlet.
+	 * @param name The name of the group's stream.
+	 * @param members The stream infos of the members (numeric, with the same sampling rate).
+	 * @param chunk_size, max_buffered See stream_outlet.
+	 * @throws std::invalid_argument if the members can't be grouped.
+	 */
+	outlet_group(const std::string &name, const std::vector<stream_info> &members,
+		int32_t chunk_size = 0, int32_t max_buffered = 360)
+		: member_count(members.size()),
+		  obj(create(name, members, chunk_size, max_buffered), &lsl_destroy_outlet_group) {}
+
+	/// The stream info of the group's stream, including the description of its members.
+	stream_info info() const { return stream_info(lsl_get_info(outlet())); }
+
+	/// Check whether consumers are currently registered.
+	bool have_consumers() { return lsl_have_consumers(outlet()) != 0; }
+
+	/// Wait until some consumer shows up, see stream_outlet::wait_for_consumers().
+	bool wait_for_consumers(double timeout) {
+		return lsl_wait_for_consumers(outlet(), timeout) != 0;
+	}
+
+	/**
+	 * Push a sample of all members.
+	 * @param members One pointer per member to its values (one per channel).
+	 * @param timestamp Optionally the capture time of the sample; if omitted, the current time is
+	 * used.
+	 */
+	template <class T>
+	void push_sample(const T *const *members, double timestamp = 0.0, bool pushthrough = true) {
+		push_chunk(members, 1, nullptr, timestamp, pushthrough);
+	}
+
+	/// Push a sample of all members, given as one vector per member.
+	template <class T>
+	void push_sample(const std::vector<std::vector<T>> &members, double timestamp = 0.0,
+		bool pushthrough = true) {
+		if (members.size() != member_count)
+			throw std::invalid_argument("There has to be one vector per member.");
+		std::vector<const T *> pointers;
+		for (const auto &member : members) pointers.push_back(member.data());
+		push_sample(pointers.data(), timestamp, pushthrough);
+	}
+
+	/** Push a chunk of samples of all members, see lsl_push_group_chunk_f().
+	 * @param members One pointer per member to its multiplexed values of num_samples samples.
+	 * @param timestamps A time stamp for each sample, or nullptr to use `timestamp`.
+	 */
+	void push_chunk(const float *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_f(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk(const double *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_d(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk(const int64_t *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_l(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk(const int32_t *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_i(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk(const int16_t *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_s(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+	void push_chunk(const char *const *members, std::size_t num_samples,
+		const double *timestamps, double timestamp = 0.0, bool pushthrough = true) {
+		check_error(lsl_push_group_chunk_c(obj.get(), members,
+			static_cast<unsigned long>(num_samples), timestamps, timestamp, pushthrough));
+	}
+
+private:
+	static lsl_outlet_group create(const std::string &name, const std::vector<stream_info> &members,
+		int32_t chunk_size, int32_t max_buffered) {
+		std::vector<lsl_streaminfo> handles;
+		for (const auto &member : members) handles.push_back(member.handle().get());
+		lsl_outlet_group group = lsl_create_outlet_group(name.c_str(), handles.data(),
+			static_cast<int32_t>(handles.size()), chunk_size, max_buffered);
+		if (!group) throw std::invalid_argument(lsl_last_error());
+		return group;
+	}
+
+	lsl_outlet outlet() const { return lsl_outlet_group_outlet(obj.get()); }
+
+	std::size_t member_count;
+	std::unique_ptr<lsl_outlet_group_struct_, void (*)(lsl_outlet_group)> obj;
+};
+
+/// A member of an outlet group, as described in the group's stream info.
+struct group_member {
+	std::string name, type, channel_format, source_id;
+	int32_t channel_count;
+	/// the index of the member's first channel in the group's samples
+	int32_t offset;
+};
+
+/**
+ * Get the members of an outlet group from the group's stream info.
+ * @param info The full stream info of the group (e.g. from stream_inlet::info()).
+ * @return The members, or an empty vector if the stream isn't a group.
+ */
+inline std::vector<group_member> group_members(stream_info &info) {
+	std::vector<group_member> members;
+	for (xml_element e = info.desc().child("streams").child("stream"); !e.empty();
+		 e = e.next_sibling("stream"))
+		members.push_back(group_member{e.child_value("name"), e.child_value("type"),
+			e.child_value("channel_format"), e.child_value("source_id"),
+			std::atoi(e.child_value("channel_count")), std::atoi(e.child_value("offset"))});
+	return members;
+}
+
+
 // =============================
 // ==== Continuous Resolver ====
 // =============================
@@ -1671,11 +3516,59 @@ public:
 			buffer, buffer + lsl_resolver_results(obj.get(), buffer, sizeof(buffer)));
 	}
 
+	/** Obtain the streams that appeared in (true) or disappeared from (false) the results since
+	 * a version of them, see lsl_resolver_results_since().
+	 * @param version The version the caller knows, 0 at first; updated to the current version.
+	 */
+	std::vector<std::pair<stream_info, bool>> results_since(uint64_t &version) {
+		std::vector<std::pair<stream_info, bool>> changes;
+		const uint32_t chunk = 1024;
+		lsl_streaminfo buffer[chunk];
+		int32_t appeared[chunk];
+		uint32_t n;
+		do {
+			n = check_error(
+				lsl_resolver_results_since(obj.get(), &version, buffer, appeared, chunk));
+			for (uint32_t k = 0; k < n; ++k) changes.emplace_back(buffer[k], appeared[k] != 0);
+		} while (n == chunk);
+		return changes;
+	}
+
+	/** Call a function with a stream's info whenever it appears in (true) or disappears from
+	 * (false) the results, see lsl_set_resolver_callback(). Pass an empty function to remove it.
+	 */
+	void set_callback(std::function<void(const stream_info &info, bool appeared)> callback) {
+		if (!callback) {
+			check_error(lsl_set_resolver_callback(obj.get(), nullptr, nullptr));
+			this->callback.reset();
+			return;
+		}
+		auto new_callback = std::make_shared<resolver_function>(std::move(callback));
+		check_error(lsl_set_resolver_callback(obj.get(), &invoke_callback, new_callback.get()));
+		// the previous function isn't called anymore, so it can be destroyed now
+		this->callback = std::move(new_callback);
+	}
+
 	/// Move constructor for stream_inlet
 	continuous_resolver(continuous_resolver &&rhs) noexcept = default;
-	continuous_resolver &operator=(continuous_resolver &&rhs) noexcept = default;
+	continuous_resolver &operator=(continuous_resolver &&rhs) noexcept {
+		// the previous resolver has to be gone before its callback is destroyed
+		obj = std::move(rhs.obj);
+		callback = std::move(rhs.callback);
+		return *this;
+	}
 
 private:
+	using resolver_function = std::function<void(const stream_info &, bool)>;
+
+	static void invoke_callback(
+		lsl_continuous_resolver, lsl_streaminfo info, int32_t appeared, void *user_data) {
+		(*static_cast<resolver_function *>(user_data))(
+			stream_info(lsl_copy_streaminfo(info)), appeared != 0);
+	}
+
+	// declared first, so it's destroyed after the resolver
+	std::shared_ptr<resolver_function> callback;
 	std::unique_ptr<lsl_continuous_resolver_, void(*)(lsl_continuous_resolver_*)> obj;
 };
 
@@ -1714,6 +3607,17 @@ inline int32_t check_error(int32_t ec) {
 	return ec;
 }
 
+// defined here, after lost_error
+inline stream_info resolve_address(
+	const std::string &host, uint16_t port, const std::string &uid, double timeout) {
+	int32_t ec = 0;
+	lsl_streaminfo res = lsl_resolve_address(host.c_str(), port, uid.c_str(), timeout, &ec);
+	// check_error() would report it as a timeout_error
+	if (ec == lsl_lost_error) throw lost_error("There's no such stream at the address.");
+	check_error(ec);
+	return stream_info(res);
+}
+
 } // namespace lsl
 
 #endif // LSL_CPP_H
@@ -0,0 +1,45 @@
+#include "alloc_guard.h"
+#include <atomic>
+#include <loguru.hpp>
+#include <mutex>
+
+using namespace lsl;
+
+namespace {
+std::atomic<uint64_t> violations{0};
+
+/// the handler and its argument, protected by handler_mut()
+lsl_allocation_handler handler = nullptr;
+void *handler_data = nullptr;
+
+std::mutex &handler_mut() {
+	static std::mutex mut;
+	return mut;
+}
+} // namespace
+
+void lsl::report_allocation(const char *site) {
+	// only the first one is logged, as logging allocates itself
+	if (violations.fetch_add(1, std::memory_order_relaxed) == 0)
+		LOG_F(WARNING, "The %s allocated memory in the no-allocation mode", site);
+	std::lock_guard<std::mutex> lock(handler_mut());
+	if (handler) handler(site, handler_data);
+}
+
+uint64_t lsl::allocation_violations() { return violations.load(std::memory_order_relaxed); }
+
+void lsl::set_allocation_handler(lsl_allocation_handler new_handler, void *user_data) {
+	std::lock_guard<std::mutex> lock(handler_mut());
+	handler = new_handler;
+	handler_data = new_handler ? user_data : nullptr;
+}
+
+extern "C" {
+
+LIBLSL_C_API uint64_t lsl_allocation_violations(void) { return allocation_violations(); }
+
+LIBLSL_C_API int32_t lsl_set_allocation_handler(lsl_allocation_handler handler, void *user_data) {
+	set_allocation_handler(handler, user_data);
+	return lsl_no_error;
+}
+}
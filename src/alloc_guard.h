@@ -0,0 +1,25 @@
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include "common.h"
+#include <cstdint>
+
+namespace lsl {
+
+/**
+ * Count an allocation of a data path that should have been preallocated in the no-allocation
+ * mode (see api_config::no_allocation()) and call the handler set with
+ * lsl_set_allocation_handler(), if any.
+ * @param site What allocated the memory (a string literal, e.g. "sample pool").
+ */
+void report_allocation(const char *site);
+
+/// The number of allocations reported so far.
+uint64_t allocation_violations();
+
+/// Set the function that's called for each reported allocation (nullptr for none).
+void set_allocation_handler(lsl_allocation_handler handler, void *user_data);
+
+} // namespace lsl
+
+#endif
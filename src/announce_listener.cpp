@@ -0,0 +1,96 @@
+#include "announce_listener.h"
+#include "api_config.h"
+#include "socket_utils.h"
+#include "stream_info_impl.h"
+#include <boost/asio/post.hpp>
+#include <loguru.hpp>
+#include <sstream>
+
+using namespace lsl;
+
+announce_listener::announce_listener(asio::io_context &io, const udp::endpoint &group,
+	const std::string &query, result_container &results, std::mutex &results_mut,
+	cancellable_registry *registry, result_hook on_change)
+	: io_(io), query_(query), results_(results), results_mut_(results_mut),
+	  on_change_(std::move(on_change)), socket_(io) {
+	const api_config *cfg = api_config::get_instance();
+	open_multicast_socket(
+		socket_, group.address(), group.port(), cfg->multicast_ttl(), cfg->listen_address());
+	if (registry) register_at(registry);
+}
+
+announce_listener::~announce_listener() { unregister_from_all(); }
+
+void announce_listener::begin() { receive_next(); }
+
+void announce_listener::cancel() {
+	post(io_, [shared_this = shared_from_this()]() {
+		try {
+			if (shared_this->socket_.is_open()) shared_this->socket_.close();
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "Error while cancelling an announce_listener: %s", e.what());
+		}
+	});
+}
+
+void announce_listener::receive_next() {
+	socket_.async_receive_from(asio::buffer(buffer_), remote_endpoint_,
+		[shared_this = shared_from_this()](
+			err_t err, std::size_t len) { shared_this->handle_receive_outcome(err, len); });
+}
+
+void announce_listener::handle_receive_outcome(err_t err, std::size_t len) {
+	if (err == asio::error::operation_aborted || err == asio::error::not_connected ||
+		err == asio::error::not_socket || !socket_.is_open())
+		return;
+
+	if (!err) {
+		try {
+			std::istringstream is(std::string(buffer_, len));
+			std::string method, kind;
+			getline(is, method);
+			getline(is, kind);
+			// the multicast group also carries the resolvers' queries
+			if (trim(method) == "LSL:announce") {
+				kind = trim(kind);
+				if (kind == "hello") {
+					std::ostringstream os;
+					os << is.rdbuf();
+					const std::string shortinfo = os.str();
+					bool known;
+					{
+						// the results only hold matching streams
+						std::lock_guard<std::mutex> lock(results_mut_);
+						known = refresh_result(results_, shortinfo, remote_endpoint_.address());
+					}
+					if (!known) {
+						stream_info_impl info;
+						info.from_shortinfo_message(shortinfo);
+						if (info.matches_query(query_)) {
+							bool added;
+							{
+								std::lock_guard<std::mutex> lock(results_mut_);
+								added = store_result(results_, info, remote_endpoint_.address());
+							}
+							if (added && on_change_) on_change_(info.uid());
+						}
+					}
+				} else if (kind == "bye") {
+					std::string uid;
+					getline(is, uid);
+					uid = trim(uid);
+					bool removed;
+					{
+						std::lock_guard<std::mutex> lock(results_mut_);
+						removed = results_.erase(uid) != 0;
+					}
+					if (removed && on_change_) on_change_(uid);
+				}
+			}
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "announce_listener: hiccup while processing an announcement: %s",
+				e.what());
+		}
+	}
+	receive_next();
+}
@@ -0,0 +1,72 @@
+#ifndef ANNOUNCE_LISTENER_H
+#define ANNOUNCE_LISTENER_H
+
+#include "cancellation.h"
+#include "forward.h"
+#include "resolve_attempt_udp.h"
+#include <boost/asio/ip/udp.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using asio::ip::udp;
+using err_t = const lslboost::system::error_code &;
+
+namespace lsl {
+
+/**
+ * Receives the stream announcements of outlets on a multicast group (see udp_server) and keeps
+ * the results of a continuous resolve up to date with them.
+ *
+ * Announced streams that match the query are added to the results (or their receive time is
+ * updated), and streams are removed right away when their outlet says goodbye.
+ */
+class announce_listener : public cancellable_obj,
+						  public std::enable_shared_from_this<announce_listener> {
+public:
+	/**
+	 * Join a multicast group to listen for announcements.
+	 * @param group The multicast (or broadcast) address and port the outlets announce on.
+	 * @param query The query the announced streams have to match.
+	 * @param results The results of the resolver, protected by results_mut.
+	 * @param registry A registry where the listener registers itself so it can be cancelled.
+	 * @param on_change Called when a stream was added to or removed from the results.
+	 */
+	announce_listener(asio::io_context &io, const udp::endpoint &group, const std::string &query,
+		result_container &results, std::mutex &results_mut, cancellable_registry *registry,
+		result_hook on_change = nullptr);
+
+	/// Destructor. Unregisters the listener.
+	~announce_listener() override;
+
+	/// Start listening.
+	void begin();
+
+	/// Stop listening (thread-safe).
+	void cancel() override;
+
+private:
+	/// Wait for the next announcement.
+	void receive_next();
+
+	/// Handler that gets called when an announcement was received (or the op was cancelled).
+	void handle_receive_outcome(err_t err, std::size_t len);
+
+	asio::io_context &io_;
+	/// the query the streams have to match
+	std::string query_;
+	/// the resolver's results and the mutex that protects them
+	result_container &results_;
+	std::mutex &results_mut_;
+	/// called when a stream was added to or removed from the results
+	result_hook on_change_;
+	/// the socket that's joined to the multicast group
+	udp::socket socket_;
+	/// the outlet that sent the last announcement
+	udp::endpoint remote_endpoint_;
+	/// the received announcement
+	char buffer_[65536];
+};
+} // namespace lsl
+
+#endif
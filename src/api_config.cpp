@@ -39,6 +39,23 @@ static std::vector<std::string> parse_set(const std::string &setstr) {
 	return result;
 }
 
+/// Parse a set of CPU numbers and ranges, e.g. {0,2,4-7}
+static std::vector<uint32_t> parse_cpu_set(const std::string &setstr) {
+	std::vector<uint32_t> result;
+	for (const auto &item : parse_set(setstr)) {
+		const auto dash = item.find('-');
+		const auto first = std::stoul(item.substr(0, dash));
+		const auto last = dash == std::string::npos ? first : std::stoul(item.substr(dash + 1));
+		if (last < first || last >= 4096) throw std::runtime_error("Invalid CPU range " + item);
+		for (auto cpu = first; cpu <= last; ++cpu) result.push_back(static_cast<uint32_t>(cpu));
+	}
+	return result;
+}
+
+/// the names of the thread roles in the [threads] section, in the order of lsl_thread_role_t
+static const char *const thread_role_names[] = {
+	"IO", "Transfer", "Data", "Info", "Time", "Watchdog"};
+
 /// Returns true if the file exists and is openable for reading
 bool file_is_readable(const std::string &filename) {
 	std::ifstream f(filename);
@@ -90,6 +107,7 @@ void api_config::load_from_file(const std::string &filename) {
 		base_port_ = pt.get("ports.BasePort", 16572);
 		port_range_ = pt.get("ports.PortRange", 32);
 		allow_random_ports_ = pt.get("ports.AllowRandomPorts", true);
+		shared_sockets_ = pt.get("ports.SharedSockets", false);
 		std::string ipv6_str = pt.get("ports.IPv6",
 #ifdef __APPLE__
 			"disable"); // on Mac OS (10.7) there's a bug in the IPv6 implementation that breaks LSL
@@ -190,6 +208,10 @@ void api_config::load_from_file(const std::string &filename) {
 		// read the [tuning] settings
 		use_protocol_version_ = std::min(
 			LSL_PROTOCOL_VERSION, pt.get("tuning.UseProtocolVersion", LSL_PROTOCOL_VERSION));
+#ifdef LSL_NO_PROTOCOL_100
+		// this build can't fall back to the portable archives of protocol 1.00
+		use_protocol_version_ = std::max(use_protocol_version_, 110);
+#endif
 		watchdog_check_interval_ = pt.get("tuning.WatchdogCheckInterval", 15.0);
 		watchdog_time_threshold_ = pt.get("tuning.WatchdogTimeThreshold", 15.0);
 		multicast_min_rtt_ = pt.get("tuning.MulticastMinRTT", 0.5);
@@ -197,19 +219,101 @@ void api_config::load_from_file(const std::string &filename) {
 		unicast_min_rtt_ = pt.get("tuning.UnicastMinRTT", 0.75);
 		unicast_max_rtt_ = pt.get("tuning.UnicastMaxRTT", 5.0);
 		continuous_resolve_interval_ = pt.get("tuning.ContinuousResolveInterval", 0.5);
-		timer_resolution_ = pt.get("tuning.TimerResolution", 1);
+		timer_resolution_ = pt.get("tuning.TimerResolution", 0);
 		max_cached_queries_ = pt.get("tuning.MaxCachedQueries", 100);
 		time_update_interval_ = pt.get("tuning.TimeUpdateInterval", 2.0);
 		time_update_minprobes_ = pt.get("tuning.TimeUpdateMinProbes", 6);
 		time_probe_count_ = pt.get("tuning.TimeProbeCount", 8);
 		time_probe_interval_ = pt.get("tuning.TimeProbeInterval", 0.064);
 		time_probe_max_rtt_ = pt.get("tuning.TimeProbeMaxRTT", 0.128);
+		time_drift_halftime_ = pt.get("tuning.TimeDriftHalftime", 300.0);
+		shared_time_sync_ = pt.get("tuning.SharedTimeSync", false);
+		kernel_timestamps_ = pt.get("tuning.KernelTimestamps", true);
+		tcp_time_sync_ = pt.get("tuning.TCPTimeSync", false);
+		tcp_fast_open_ = pt.get("tuning.TCPFastOpen", false);
+		tsc_clock_ = pt.get("tuning.TSCClock", false);
 		outlet_buffer_reserve_ms_ = pt.get("tuning.OutletBufferReserveMs", 5000);
 		outlet_buffer_reserve_samples_ = pt.get("tuning.OutletBufferReserveSamples", 128);
 		inlet_buffer_reserve_ms_ = pt.get("tuning.InletBufferReserveMs", 5000);
 		inlet_buffer_reserve_samples_ = pt.get("tuning.InletBufferReserveSamples", 128);
+		shared_sample_pools_ = pt.get("tuning.SharedSamplePools", true);
 		smoothing_halftime_ = pt.get("tuning.SmoothingHalftime", 90.0F);
 		force_default_timestamps_ = pt.get("tuning.ForceDefaultTimestamps", false);
+		async_transfer_ = pt.get("tuning.AsyncTransfer", false);
+		park_idle_seconds_ = std::max(pt.get("tuning.ParkIdleSeconds", 0.0), 0.0);
+		chunk_max_latency_us_ = std::max(pt.get("tuning.ChunkMaxLatencyMicros", 0), 0);
+		chunk_max_bytes_ = static_cast<std::size_t>(
+			std::max<int64_t>(pt.get<int64_t>("tuning.ChunkMaxBytes", 0), 0));
+		adaptive_chunking_ = pt.get("tuning.AdaptiveChunking", false);
+		delta_encoding_ = pt.get("tuning.DeltaEncoding", false);
+		sample_framing_ = pt.get("tuning.SampleFraming", true);
+		changed_channel_encoding_ = pt.get("tuning.ChangedChannelEncoding", false);
+		timestamp_deltas_ = pt.get("tuning.TimestampDeltas", false);
+		gap_detection_ = pt.get("tuning.GapDetection", false);
+		heartbeat_interval_ = std::max(pt.get("tuning.HeartbeatInterval", 0.0), 0.0);
+		foreign_byte_order_ = pt.get("tuning.ForeignByteOrder", false);
+		zerocopy_send_min_bytes_ = static_cast<std::size_t>(
+			std::max<int64_t>(pt.get<int64_t>("tuning.ZeroCopySendMinBytes", 0), 0));
+		multicast_data_ = pt.get("tuning.MulticastData", false);
+		datagram_data_ = pt.get("tuning.DatagramData", false);
+		rdma_data_ = pt.get("tuning.RDMAData", false);
+		shared_memory_data_ = pt.get("tuning.SharedMemoryData", false);
+		in_process_data_ = pt.get("tuning.InProcessData", false);
+		bundle_data_ = pt.get("tuning.BundleData", false);
+		host_daemon_ = pt.get("tuning.HostDaemon", "");
+		deduced_timestamps_max_ = pt.get("tuning.DeducedTimestampsMax", 0);
+		deduced_timestamps_tolerance_ = pt.get("tuning.DeducedTimestampsTolerance", 0.0005);
+		sample_slab_bytes_ = pt.get("tuning.SampleSlabBytes", 65536);
+		sample_slab_huge_pages_ = pt.get("tuning.SampleSlabHugePages", false);
+		// rounded up to a power of two
+		const int sample_alignment = pt.get("tuning.SampleAlignment", 8);
+		for (sample_alignment_ = 8; sample_alignment_ < std::min(sample_alignment, 64);)
+			sample_alignment_ *= 2;
+		lock_memory_ = pt.get("tuning.LockMemory", false);
+		no_allocation_ = pt.get("tuning.NoAllocation", false);
+		numa_aware_ = pt.get("tuning.NumaAware", false);
+		outlet_buffer_max_bytes_ = static_cast<std::size_t>(
+			std::max<int64_t>(pt.get<int64_t>("tuning.OutletBufferMaxBytes", 0), 0));
+		outlet_buffers_total_max_bytes_ = static_cast<std::size_t>(
+			std::max<int64_t>(pt.get<int64_t>("tuning.OutletBuffersTotalMaxBytes", 0), 0));
+		outlet_spill_directory_ = pt.get("tuning.OutletSpillDirectory", "");
+		outlet_spill_max_bytes_ = static_cast<uint64_t>(
+			std::max<int64_t>(pt.get<int64_t>("tuning.OutletSpillMaxBytes", 1LL << 30), 0));
+		outlet_io_threads_ = pt.get("tuning.OutletIOThreads", 0);
+		inlet_io_threads_ = pt.get("tuning.InletIOThreads", 0);
+		inlet_decode_threads_ = pt.get("tuning.InletDecodeThreads", 0);
+		pull_spin_time_ = pt.get("tuning.PullSpinTime", 0.0);
+		inlet_receive_buffer_max_bytes_ = static_cast<std::size_t>(std::max<int64_t>(
+			pt.get<int64_t>("tuning.InletReceiveBufferMaxBytes", 256 << 10), 0));
+		socket_send_buffer_bytes_ = std::max(pt.get("tuning.SocketSendBufferBytes", 0), 0);
+		socket_receive_buffer_bytes_ = std::max(pt.get("tuning.SocketReceiveBufferBytes", 0), 0);
+		tcp_no_delay_ = pt.get("tuning.TCPNoDelay", true);
+		socket_busy_poll_us_ = std::max(pt.get("tuning.SocketBusyPollMicros", 0), 0);
+		priority_marking_ = pt.get("tuning.PriorityMarking", false);
+		session_max_bytes_per_second_ =
+			std::max(pt.get("tuning.SessionMaxBytesPerSecond", 0.0), 0.0);
+		host_max_bytes_per_second_ = std::max(pt.get("tuning.HostMaxBytesPerSecond", 0.0), 0.0);
+		outlet_history_length_ = std::max(pt.get("tuning.OutletHistoryLength", 0), 0);
+		outlet_history_seconds_ = std::max(pt.get("tuning.OutletHistorySeconds", 0.0), 0.0);
+		discovery_cache_time_ = std::max(pt.get("tuning.DiscoveryCacheTime", 0.0), 0.0);
+		announce_interval_ = std::max(pt.get("tuning.AnnounceInterval", 0.0), 0.0);
+		background_discovery_setup_ = pt.get("tuning.BackgroundDiscoverySetup", true);
+		unicast_sweep_interval_ = std::max(pt.get("tuning.UnicastSweepInterval", 10.0), 0.0);
+		lazy_desc_ = pt.get("tuning.LazyDesc", true);
+		desc_subtrees_ = parse_set(pt.get("tuning.DescSubtrees", "{}"));
+		info_refresh_interval_ = std::max(pt.get("tuning.InfoRefreshInterval", 0.0), 0.0);
+
+		// read the [threads] settings
+		thread_cpus_.clear();
+		thread_priorities_.clear();
+		for (const char *role : thread_role_names) {
+			const std::string key = std::string("threads.") + role;
+			thread_cpus_.push_back(parse_cpu_set(pt.get((key + "CPUs").c_str(), "{}")));
+			const int priority = pt.get((key + "Priority").c_str(), 0);
+			if (priority < 0 || priority > 99)
+				throw std::runtime_error("Invalid " + key + "Priority (valid range: 0 to 99)");
+			thread_priorities_.push_back(priority);
+		}
 
 		// read the [log] settings
 		int log_level = pt.get("log.level", (int) loguru::Verbosity_INFO);
@@ -223,6 +327,8 @@ void api_config::load_from_file(const std::string &filename) {
 			loguru::g_stderr_verbosity = -9;
 		} else
 			loguru::g_stderr_verbosity = log_level;
+		log_async_ = pt.get("log.Async", true);
+		log_rate_limit_ = std::max(pt.get("log.RateLimit", 10), 0);
 
 		// log config filename only after setting the verbosity level
 		if (!filename.empty())
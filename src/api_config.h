@@ -55,6 +55,16 @@ public:
 	 */
 	int allow_random_ports() const { return allow_random_ports_; }
 
+	/**
+	 * Whether all outlets of the process share one TCP data port and one UDP service port (per
+	 * IP version), instead of binding their own.
+	 *
+	 * Connections are handed to the requested stream according to its UID. Inlets of older
+	 * versions of liblsl don't send it when they request the full info, so they can only use
+	 * the shared port while the process has a single outlet.
+	 */
+	bool shared_sockets() const { return shared_sockets_; }
+
 	/**
 	 * Port over which multi-cast communication is handled.
 	 * This is the communication medium for the announcement and discovery of streams
@@ -156,7 +166,8 @@ public:
 	/// activities. This is in addition to the assumed RTT's.
 	double continuous_resolve_interval() const { return continuous_resolve_interval_; }
 	/// Desired timer resolution in ms (0 means no change). Currently only affects Windows operating
-	/// systems, where values other than 1 can increase LSL transmission latency.
+	/// systems, where it's raised for the whole process; the library's own sleeps don't need it
+	/// (see sleep_precise()), so the default is 0.
 	int timer_resolution() const { return timer_resolution_; }
 	/// The maximum number of most-recently-used queries that is cached.
 	int max_cached_queries() const { return max_cached_queries_; }
@@ -170,6 +181,51 @@ public:
 	double time_probe_interval() const { return time_probe_interval_; }
 	/// Maximum assumed RTT of a time probe (= extra waiting time).
 	double time_probe_max_rtt() const { return time_probe_max_rtt_; }
+	/**
+	 * Half-time (in seconds) of the probes' weight in the clock offset and drift model that's used
+	 * to synchronize the time stamps of inlets with clock synchronization post-processing.
+	 *
+	 * Every time probe is added to the model, so the time stamps follow a drifting clock smoothly
+	 * instead of in steps. If this is 0, the most recent offset is used as is.
+	 */
+	double time_drift_halftime() const { return time_drift_halftime_; }
+	/**
+	 * Whether the inlets connected to outlets on the same host share their time synchronization.
+	 *
+	 * Only one of them sends time probes to the host then, and all of them get its estimates.
+	 * Off by default.
+	 */
+	bool shared_time_sync() const { return shared_time_sync_; }
+	/**
+	 * Whether the time probes are time stamped by the kernel when they're received (if supported).
+	 *
+	 * This keeps the scheduling latency of the IO threads out of the round-trip times and offsets.
+	 */
+	bool kernel_timestamps() const { return kernel_timestamps_; }
+	/**
+	 * Whether the inlets send their time probes over a TCP connection to the outlet's data port
+	 * instead of as UDP packets to its service port.
+	 *
+	 * This only needs the data port to be reachable (e.g., through a NAT or a firewall that only
+	 * lets the data connections pass), but the round-trip times suffer from lost packets more.
+	 */
+	bool tcp_time_sync() const { return tcp_time_sync_; }
+	/**
+	 * Whether the outlets' data ports accept TCP Fast Open connections and the bundled
+	 * connections (see bundle_client) are opened that way (on Linux, where net.ipv4.tcp_fastopen
+	 * enables it for clients and servers).
+	 *
+	 * A client that connected to a host before sends its requests in the SYN, so reconnecting
+	 * (and resubscribing all streams of a bundled connection) doesn't wait for the handshake.
+	 */
+	bool tcp_fast_open() const { return tcp_fast_open_; }
+	/**
+	 * Whether lsl_local_clock() reads the CPU's time stamp counter (if it's invariant).
+	 *
+	 * This makes timestamping much cheaper. The clock follows the system's steady clock, but it
+	 * can be off by a few microseconds at times.
+	 */
+	bool tsc_clock() const { return tsc_clock_; }
 	/// Default pre-allocated buffer size for the outlet, in ms (regular streams).
 	int outlet_buffer_reserve_ms() const { return outlet_buffer_reserve_ms_; }
 	/// Default pre-allocated buffer size for the outlet, in samples (irregular streams).
@@ -178,10 +234,303 @@ public:
 	int inlet_buffer_reserve_ms() const { return inlet_buffer_reserve_ms_; }
 	/// Default pre-allocated buffer size for the inlet, in samples (irregular streams).
 	int inlet_buffer_reserve_samples() const { return inlet_buffer_reserve_samples_; }
+	/**
+	 * Whether the inlets and outlets of streams with the same channel format and count share one
+	 * sample pool, instead of each holding its own mostly idle slabs (see factory::shared()).
+	 *
+	 * Streams in the no-allocation mode and NUMA-aware outlets keep pools of their own.
+	 */
+	bool shared_sample_pools() const { return shared_sample_pools_; }
 	/// Default halftime of the time-stamp smoothing window (if enabled), in seconds.
 	float smoothing_halftime() const { return smoothing_halftime_; }
 	/// Override timestamps with lsl clock if True
 	bool force_default_timestamps() const { return force_default_timestamps_; }
+	/// Drive the outlet's sample transfers from its IO thread instead of one thread per inlet.
+	bool async_transfer() const { return async_transfer_; }
+	/**
+	 * Park the serving threads of idle streams after this many seconds (0 to never park them).
+	 *
+	 * If set, outlets don't start IO threads of their own but are served by a small pool shared
+	 * by all of them (unless outlet_io_threads() configures one), and the transfer thread of a
+	 * session whose consumer got no samples for this long ends; the IO thread drives the
+	 * session's transfers from then on, as with async_transfer(). This way, mostly idle marker
+	 * or event outlets don't hold any threads.
+	 */
+	double park_idle_seconds() const { return park_idle_seconds_; }
+	/**
+	 * The longest time (in microseconds) the first sample of a chunk waits until the chunk is sent
+	 * to an inlet, or 0 to send the chunks as the samples' pushthrough flags demand.
+	 *
+	 * If set, the outlet ignores the pushthrough flags and its chunk size, and collects the samples
+	 * until this time has passed or the chunk has reached chunk_max_bytes(), so irregular streams
+	 * are sent in batches with a bounded latency. A chunk size requested by the inlet still ends
+	 * chunks, too.
+	 */
+	int32_t chunk_max_latency_us() const { return chunk_max_latency_us_; }
+	/// The size (in bytes) at which a chunk is sent before chunk_max_latency_us() (0 for no limit).
+	std::size_t chunk_max_bytes() const { return chunk_max_bytes_; }
+	/**
+	 * Let each data connection choose its chunk size from its throughput.
+	 *
+	 * The pushthrough flags then only mark where chunks may end. A connection sends what it has
+	 * serialized whenever its queue runs dry, so samples are sent right away while the link keeps
+	 * up (and the chunk size halves). While a chunk is being sent, the next one collects the
+	 * samples that arrive in the meantime and the chunk size grows to match, so fewer and larger
+	 * writes are made under load. A chunk size requested by the inlet or chunk_max_latency_us()
+	 * take precedence.
+	 */
+	bool adaptive_chunking() const { return adaptive_chunking_; }
+	/// Request delta value encoding for numeric data feeds to save bandwidth.
+	bool delta_encoding() const { return delta_encoding_; }
+	/**
+	 * Whether inlets ask for numeric samples in framed chunks (see frame_flags): the values of a
+	 * chunk's samples are sent back to back and the receiver reads and converts them in bulk.
+	 * Delta encoding takes precedence.
+	 */
+	bool sample_framing() const { return sample_framing_; }
+	/**
+	 * Whether inlets ask for framed chunks that only hold the channel values that changed since
+	 * the previous sample (see frame_changed_channels), so mostly constant channels (e.g. trigger
+	 * or status channels) take one bit per sample. Needs SampleFraming, delta encoding takes
+	 * precedence.
+	 */
+	bool changed_channel_encoding() const { return changed_channel_encoding_; }
+	/**
+	 * Whether inlets ask for the time stamps of framed chunks as nanosecond deltas (see
+	 * frame_flags), which takes about one byte per sample of a regular stream. The received time
+	 * stamps are rounded to the nanosecond.
+	 */
+	bool timestamp_deltas() const { return timestamp_deltas_; }
+	/**
+	 * Whether inlets ask for the sequence numbers of the samples even if the outlet can't resume
+	 * the stream from them (i.e. has no history), so samples the outlet dropped or that were lost
+	 * while the connection was broken off are detected (see lsl_pull_chunk_seq()). Costs 8 bytes
+	 * per sample.
+	 */
+	bool gap_detection() const { return gap_detection_; }
+	/**
+	 * The interval (in seconds) of the heartbeat frames inlets ask framed feeds for (see
+	 * control_heartbeat), or 0 to not ask for any. An inlet that receives nothing for a few
+	 * intervals treats the connection as broken and starts to recover it right away, instead of
+	 * waiting for the watchdog (see watchdog_time_threshold()).
+	 */
+	double heartbeat_interval() const { return heartbeat_interval_; }
+	/**
+	 * Whether inlets claim the opposite of the machine's byte order, so the outlets send the
+	 * samples byte-swapped and the inlets swap them back (for benchmarking the conversions on a
+	 * single machine).
+	 */
+	bool foreign_byte_order() const { return foreign_byte_order_; }
+	/**
+	 * The size (in bytes) from which chunks of large numeric samples are sent with MSG_ZEROCOPY,
+	 * so the kernel reads them from the sample memory instead of copying them (Linux only,
+	 * 0 to disable). Pays off for chunks of at least a few dozen KiB to remote hosts.
+	 */
+	std::size_t zerocopy_send_min_bytes() const { return zerocopy_send_min_bytes_; }
+	/**
+	 * Whether outlets offer to multicast their samples and inlets ask for it (see
+	 * lsl_set_outlet_multicast()), so an outlet sends each sample only once to all inlets.
+	 */
+	bool multicast_data() const { return multicast_data_; }
+	/**
+	 * Whether inlets ask the outlets to send them the samples as UDP datagrams that aren't
+	 * retransmitted when lost (see lsl_set_inlet_datagrams()).
+	 */
+	bool datagram_data() const { return datagram_data_; }
+	/**
+	 * Whether inlets ask the outlets to RDMA-write the samples into their memory
+	 * (see rdma_endpoint), if liblsl was built with RDMA support and the host has an RDMA device.
+	 * Takes precedence over DatagramData and MulticastData.
+	 */
+	bool rdma_data() const { return rdma_data_; }
+	/**
+	 * Whether inlets ask outlets in other processes on the same host to pass the samples through
+	 * shared memory (see lsl_set_inlet_shared_memory()).
+	 */
+	bool shared_memory_data() const { return shared_memory_data_; }
+	/**
+	 * Whether inlets take the samples of outlets in the same process straight from their send
+	 * buffers instead of over a loopback connection (see lsl_set_inlet_in_process()).
+	 */
+	bool in_process_data() const { return in_process_data_; }
+	/**
+	 * Whether inlets receive the samples of all streams of a remote process over one shared
+	 * connection (see lsl_set_inlet_bundling()).
+	 */
+	bool bundle_data() const { return bundle_data_; }
+	/**
+	 * The Unix domain socket of the host daemon (see host_daemon) that publishes the outlets of
+	 * this process instead of it, empty if the outlets are served by the process.
+	 */
+	const std::string &host_daemon() const { return host_daemon_; }
+	/**
+	 * Maximum number of samples of a regular-rate outlet whose time stamps are deduced from the
+	 * previous sample's time stamp instead of being transmitted (0 to always transmit them).
+	 */
+	int deduced_timestamps_max() const { return deduced_timestamps_max_; }
+	/// Maximum deviation (in seconds) of a time stamp from the deduced value to omit it.
+	double deduced_timestamps_tolerance() const { return deduced_timestamps_tolerance_; }
+	/// Size of the additional slabs sample factories allocate when their pool is exhausted.
+	int sample_slab_bytes() const { return sample_slab_bytes_; }
+	/// Whether sample slabs should be backed by (transparent) huge pages where supported.
+	bool sample_slab_huge_pages() const { return sample_slab_huge_pages_; }
+	/**
+	 * The alignment of the sample payloads in the slabs, in bytes (a power of two from 8 to 64).
+	 *
+	 * With 32 or 64, the channel data can be read with aligned vector loads and, with 64, the
+	 * payloads of adjacent samples don't share a cache line, so a producer writing one sample
+	 * doesn't contend with a consumer reading the previous one. This costs up to twice the
+	 * alignment in padding per sample, so the default packs the samples tightly.
+	 */
+	int sample_alignment() const { return sample_alignment_; }
+	/**
+	 * Prefault and lock (mlock()) the sample pools, the sample queues and the outlets' feed
+	 * buffers when they are created, for hosts where page faults cause latency spikes.
+	 *
+	 * The pools and queues are sized by the buffer reserve settings (e.g.
+	 * outlet_buffer_reserve_ms()), the feed buffers are preallocated for the largest chunk a
+	 * connection expects.
+	 */
+	bool lock_memory() const { return lock_memory_; }
+	/**
+	 * Preallocate the memory the outlets and inlets use once they're running, for real-time
+	 * applications whose pushes and pulls must not wait for the heap.
+	 *
+	 * An outlet's sample pool holds as many samples as its send buffer (its max_buffered), an
+	 * inlet's the samples of its buffer and of the batches in flight, and the feed buffers are
+	 * preallocated as with lock_memory(). Allocations that happen anyway once a stream is running
+	 * (e.g. because a pool was too small) are counted, see lsl_allocation_violations().
+	 */
+	bool no_allocation() const { return no_allocation_; }
+
+	/**
+	 * Place each outlet's sample pool and queues on the NUMA node of the thread that creates the
+	 * outlet (normally the thread that pushes its samples), and run the outlet's IO and transfer
+	 * threads on that node's CPUs.
+	 *
+	 * Threads whose role has CPUs configured (see thread_cpus()) and outlets served by the shared
+	 * IO threads (see outlet_io_threads()) keep their placement.
+	 */
+	bool numa_aware() const { return numa_aware_; }
+
+	// === thread policies ===
+
+	/// The CPUs the library threads with a role (see lsl_thread_role_t) may run on, set by
+	/// `threads.<Role>CPUs` (empty for all CPUs).
+	const std::vector<uint32_t> &thread_cpus(int role) const { return thread_cpus_.at(role); }
+	/// The real-time priority of the library threads with a role, set by `threads.<Role>Priority`
+	/// (0 for the default scheduling).
+	int32_t thread_priority(int role) const { return thread_priorities_.at(role); }
+	/// The number of thread roles.
+	int num_thread_roles() const { return static_cast<int>(thread_priorities_.size()); }
+	/// Maximum memory (in bytes) the consumer queues of one outlet may hold (0 for no limit).
+	std::size_t outlet_buffer_max_bytes() const { return outlet_buffer_max_bytes_; }
+	/// Maximum memory (in bytes) the consumer queues of all outlets may hold (0 for no limit).
+	std::size_t outlet_buffers_total_max_bytes() const { return outlet_buffers_total_max_bytes_; }
+	/**
+	 * Directory the consumer queues of outlets spill their samples to once they are full, so a
+	 * stalled consumer doesn't lose samples (empty to drop the oldest samples instead).
+	 */
+	const std::string &outlet_spill_directory() const { return outlet_spill_directory_; }
+	/// Maximum disk space (in bytes) each consumer queue may spill to; newer samples are dropped.
+	uint64_t outlet_spill_max_bytes() const { return outlet_spill_max_bytes_; }
+	/**
+	 * Number of IO threads shared by all outlets in the process (0 for two threads per outlet
+	 * and IP stack).
+	 */
+	int outlet_io_threads() const { return outlet_io_threads_; }
+	/**
+	 * Number of IO threads shared by all inlets in the process for time probes (0 for one thread
+	 * each per inlet).
+	 */
+	int inlet_io_threads() const { return inlet_io_threads_; }
+	/**
+	 * Number of threads shared by all inlets in the process that decode the frames of bundled
+	 * connections and deliver their samples (0 to do that on each connection's thread).
+	 */
+	int inlet_decode_threads() const { return inlet_decode_threads_; }
+	/// Default time (in seconds) inlets spin waiting for samples before blocking in pull calls.
+	double pull_spin_time() const { return pull_spin_time_; }
+	/**
+	 * The size (in bytes) up to which an inlet's receive buffer grows while data arrives faster
+	 * than it's decoded, so high-bandwidth streams need fewer socket reads.
+	 */
+	std::size_t inlet_receive_buffer_max_bytes() const { return inlet_receive_buffer_max_bytes_; }
+	/**
+	 * The socket send and receive buffer sizes (in bytes) of the data connections, 0 for the
+	 * system defaults. Links with a large bandwidth-delay product need buffers of at least
+	 * bandwidth times round-trip time to reach their full throughput.
+	 */
+	int32_t socket_send_buffer_bytes() const { return socket_send_buffer_bytes_; }
+	int32_t socket_receive_buffer_bytes() const { return socket_receive_buffer_bytes_; }
+	/// Whether Nagle's algorithm is disabled on the data connections (the default).
+	bool tcp_no_delay() const { return tcp_no_delay_; }
+	/// How long (in microseconds) reads on the data connections busy-poll the device (Linux only).
+	int32_t socket_busy_poll_us() const { return socket_busy_poll_us_; }
+	/// Whether outlets mark the packets of latency-sensitive and bulk connections (DSCP and
+	/// SO_PRIORITY), see lsl_set_inlet_priority().
+	bool priority_marking() const { return priority_marking_; }
+	/**
+	 * The bandwidth limits (in bytes per second, 0 for none) of the outlets' data connections to
+	 * other hosts: of each connection and of all connections of this process together.
+	 *
+	 * Chunks that exceed the budget wait, so the samples queue up and the inlet's overflow policy
+	 * (e.g. decimation) decides what's dropped if a stream needs more than its share.
+	 */
+	double session_max_bytes_per_second() const { return session_max_bytes_per_second_; }
+	double host_max_bytes_per_second() const { return host_max_bytes_per_second_; }
+	/**
+	 * Number of recently pushed samples each outlet keeps, so inlets that reconnect after a
+	 * connection error can resume the stream without a gap and new inlets can request recent
+	 * data (0 for no limit; no history is kept if outlet_history_seconds() is 0, too).
+	 */
+	int outlet_history_length() const { return outlet_history_length_; }
+	/// How long (in seconds) outlets keep pushed samples in their history (0 for no limit).
+	double outlet_history_seconds() const { return outlet_history_seconds_; }
+	/**
+	 * Time (in seconds) after which a stream that stopped responding is dropped from the
+	 * process-wide discovery cache (0 disables the cache, see discovery_cache). Until then,
+	 * resolves may still return a stream of another process that has gone away.
+	 */
+	double discovery_cache_time() const { return discovery_cache_time_; }
+	/**
+	 * Interval (in seconds) at which outlets announce their streams on the multicast groups, so
+	 * continuous resolvers listening for the announcements can query less often (0 to disable).
+	 * Outlets also announce when they start and when they go away.
+	 */
+	double announce_interval() const { return announce_interval_; }
+	/**
+	 * Whether outlets set up their multicast responders (binding the sockets and joining the
+	 * groups) on their IO threads, so creating an outlet returns right away. The outlets can be
+	 * found once they're ready, see lsl_wait_for_ready().
+	 */
+	bool background_discovery_setup() const { return background_discovery_setup_; }
+	/**
+	 * Interval (in seconds) at which unicast resolves query all ports of the known peers.
+	 * In between, only the ports that ever responded and the lowest few other ports (where new
+	 * outlets appear first) are queried (0 to always query all ports).
+	 */
+	double unicast_sweep_interval() const { return unicast_sweep_interval_; }
+	/// Parse the <desc> element of an inlet's stream info only when it's first accessed.
+	bool lazy_desc() const { return lazy_desc_; }
+	/**
+	 * Names of the <desc> children that inlets request from outlets (empty for all of them).
+	 * Outlets that don't support this send their full description.
+	 */
+	const std::vector<std::string> &desc_subtrees() const { return desc_subtrees_; }
+	/**
+	 * Time (in seconds) after which inlets revalidate their stream's full info with the outlet
+	 * when it's requested again (0 to keep the first one, the default). The info is only sent
+	 * again if the outlet's metadata changed.
+	 */
+	double info_refresh_interval() const { return info_refresh_interval_; }
+	/**
+	 * Whether the messages of the data paths are logged by a background thread (see ALOG_F()),
+	 * so the threads that log them don't wait for each other.
+	 */
+	bool log_async() const { return log_async_; }
+	/// Maximum number of messages per second one ALOG_F() call site logs (0 for no limit).
+	int log_rate_limit() const { return log_rate_limit_; }
 
 	/// Deleted copy constructor (noncopyable).
 	api_config(const api_config &rhs) = delete;
@@ -210,6 +559,7 @@ private:
 	uint16_t base_port_;
 	uint16_t port_range_;
 	bool allow_random_ports_;
+	bool shared_sockets_;
 	uint16_t multicast_port_;
 	std::string resolve_scope_;
 	std::vector<std::string> multicast_addresses_;
@@ -233,12 +583,76 @@ private:
 	int time_probe_count_;
 	double time_probe_interval_;
 	double time_probe_max_rtt_;
+	double time_drift_halftime_;
+	bool shared_time_sync_;
+	bool kernel_timestamps_;
+	bool tcp_time_sync_;
+	bool tcp_fast_open_;
+	bool tsc_clock_;
 	int outlet_buffer_reserve_ms_;
 	int outlet_buffer_reserve_samples_;
 	int inlet_buffer_reserve_ms_;
 	int inlet_buffer_reserve_samples_;
+	bool shared_sample_pools_;
 	float smoothing_halftime_;
 	bool force_default_timestamps_;
+	bool async_transfer_;
+	double park_idle_seconds_;
+	int32_t chunk_max_latency_us_;
+	std::size_t chunk_max_bytes_;
+	bool adaptive_chunking_;
+	bool delta_encoding_;
+	bool sample_framing_;
+	bool changed_channel_encoding_;
+	bool timestamp_deltas_;
+	bool gap_detection_;
+	double heartbeat_interval_;
+	bool foreign_byte_order_;
+	std::size_t zerocopy_send_min_bytes_;
+	bool multicast_data_;
+	bool datagram_data_;
+	bool rdma_data_;
+	bool shared_memory_data_;
+	bool in_process_data_;
+	bool bundle_data_;
+	std::string host_daemon_;
+	int deduced_timestamps_max_;
+	double deduced_timestamps_tolerance_;
+	int sample_slab_bytes_;
+	bool sample_slab_huge_pages_;
+	int sample_alignment_;
+	bool lock_memory_;
+	bool no_allocation_;
+	bool numa_aware_;
+	std::vector<std::vector<uint32_t>> thread_cpus_;
+	std::vector<int32_t> thread_priorities_;
+	std::size_t outlet_buffer_max_bytes_;
+	std::size_t outlet_buffers_total_max_bytes_;
+	std::string outlet_spill_directory_;
+	uint64_t outlet_spill_max_bytes_;
+	int outlet_io_threads_;
+	int inlet_io_threads_;
+	int inlet_decode_threads_;
+	double pull_spin_time_;
+	std::size_t inlet_receive_buffer_max_bytes_;
+	int32_t socket_send_buffer_bytes_;
+	int32_t socket_receive_buffer_bytes_;
+	bool tcp_no_delay_;
+	int32_t socket_busy_poll_us_;
+	bool priority_marking_;
+	double session_max_bytes_per_second_;
+	double host_max_bytes_per_second_;
+	int outlet_history_length_;
+	double outlet_history_seconds_;
+	double discovery_cache_time_;
+	double announce_interval_;
+	bool background_discovery_setup_;
+	double unicast_sweep_interval_;
+	bool lazy_desc_;
+	std::vector<std::string> desc_subtrees_;
+	double info_refresh_interval_;
+	bool log_async_;
+	int log_rate_limit_;
 };
 } // namespace lsl
 
@@ -12,7 +12,14 @@
 
 namespace lsl {
 class continuous_resolver_impl;
+class host_daemon;
+class inlet_set;
+class outlet_group;
+class recording;
+class relay;
+class replay;
 class resolver_impl;
+struct sample_view;
 class stream_info_impl;
 class stream_inlet_impl;
 class stream_outlet_impl;
@@ -25,4 +32,11 @@ typedef lsl::resolver_impl *lsl_continuous_resolver;
 typedef lsl::stream_info_impl *lsl_streaminfo;
 typedef lsl::stream_outlet_impl *lsl_outlet;
 typedef lsl::stream_inlet_impl *lsl_inlet;
+typedef lsl::sample_view *lsl_sample_view;
+typedef lsl::inlet_set *lsl_inlet_set;
+typedef lsl::outlet_group *lsl_outlet_group;
+typedef lsl::recording *lsl_recording;
+typedef lsl::relay *lsl_relay;
+typedef lsl::host_daemon *lsl_host_daemon;
+typedef lsl::replay *lsl_replay;
 typedef pugi::xml_node_struct *lsl_xml_ptr;
@@ -0,0 +1,199 @@
+#include "arrow_export.h"
+#include "data_receiver.h"
+#include "sample.h"
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace lsl;
+
+namespace {
+/// The buffers of an exported array (struct or column), owned by its private_data
+struct array_data {
+	/// the offsets of a string column
+	std::unique_ptr<int32_t[]> offsets;
+	/// the values of a column
+	std::unique_ptr<char[]> values;
+	/// the buffer pointers handed out (the validity bitmap is always null)
+	const void *buffers[3]{nullptr, nullptr, nullptr};
+	/// the columns of a struct array
+	std::vector<ArrowArray> child_arrays;
+	std::vector<ArrowArray *> children;
+};
+
+/// The type description of an exported array, owned by its private_data
+struct schema_data {
+	std::string format, name;
+	std::vector<ArrowSchema> child_schemas;
+	std::vector<ArrowSchema *> children;
+};
+
+void release_array(ArrowArray *array) {
+	auto *data = static_cast<array_data *>(array->private_data);
+	// children that were moved out have no release callback anymore
+	for (ArrowArray *child : data->children)
+		if (child->release) child->release(child);
+	delete data;
+	array->release = nullptr;
+}
+
+void release_schema(ArrowSchema *schema) {
+	auto *data = static_cast<schema_data *>(schema->private_data);
+	for (ArrowSchema *child : data->children)
+		if (child->release) child->release(child);
+	delete data;
+	schema->release = nullptr;
+}
+
+/// Hand out an array's buffers; a struct array's children have to be complete
+void fill_array(ArrowArray &array, std::unique_ptr<array_data> data, int64_t length,
+	int64_t n_buffers) noexcept {
+	array.length = length;
+	array.null_count = 0;
+	array.offset = 0;
+	array.n_buffers = n_buffers;
+	array.n_children = static_cast<int64_t>(data->children.size());
+	array.buffers = data->buffers;
+	array.children = data->children.empty() ? nullptr : data->children.data();
+	array.dictionary = nullptr;
+	array.release = &release_array;
+	array.private_data = data.release();
+}
+
+void fill_schema(ArrowSchema &schema, std::unique_ptr<schema_data> data) noexcept {
+	schema.format = data->format.c_str();
+	schema.name = data->name.c_str();
+	schema.metadata = nullptr;
+	schema.flags = 0;
+	schema.n_children = static_cast<int64_t>(data->children.size());
+	schema.children = data->children.empty() ? nullptr : data->children.data();
+	schema.dictionary = nullptr;
+	schema.release = &release_schema;
+	schema.private_data = data.release();
+}
+
+/// The Arrow format of a channel format's columns
+const char *column_format(lsl_channel_format_t format) {
+	switch (format) {
+	case cft_float32: return "f";
+	case cft_double64: return "g";
+	case cft_string: return "u";
+	case cft_int32: return "i";
+	case cft_int16: return "s";
+	case cft_int8: return "c";
+	case cft_int64: return "l";
+	case cft_int24: return "i";
+	case cft_float16: return "e";
+	default: throw std::invalid_argument("Unsupported channel format.");
+	}
+}
+
+/// Scatter the channel values of the samples into the columns
+template <class T>
+void scatter_values(const sample_view &view, std::vector<std::unique_ptr<array_data>> &columns) {
+	const std::size_t n = view.samples.size(), num_chans = columns.size();
+	std::vector<T *> dst(num_chans);
+	for (std::size_t c = 0; c < num_chans; ++c) {
+		columns[c]->values.reset(new char[n * sizeof(T)]);
+		dst[c] = reinterpret_cast<T *>(columns[c]->values.get());
+	}
+	for (std::size_t k = 0; k < n; ++k) {
+		const T *src = reinterpret_cast<const T *>(view.samples[k]->raw_data());
+		for (std::size_t c = 0; c < num_chans; ++c) dst[c][k] = src[c];
+	}
+}
+
+void widen_int24(const sample_view &view, std::vector<std::unique_ptr<array_data>> &columns) {
+	const std::size_t n = view.samples.size(), num_chans = columns.size();
+	std::vector<int32_t> row(num_chans);
+	for (auto &column : columns) column->values.reset(new char[n * sizeof(int32_t)]);
+	for (std::size_t k = 0; k < n; ++k) {
+		view.samples[k]->retrieve_typed(row.data());
+		for (std::size_t c = 0; c < num_chans; ++c)
+			reinterpret_cast<int32_t *>(columns[c]->values.get())[k] = row[c];
+	}
+}
+
+void copy_strings(const sample_view &view, std::vector<std::unique_ptr<array_data>> &columns) {
+	const std::size_t n = view.samples.size();
+	for (std::size_t c = 0; c < columns.size(); ++c) {
+		array_data &column = *columns[c];
+		std::size_t bytes = 0;
+		for (const auto &s : view.samples) bytes += s->string_data()[c].size();
+		if (bytes > static_cast<std::size_t>(std::numeric_limits<int32_t>::max()))
+			throw std::length_error("The strings of a channel exceed the size of an Arrow array.");
+		column.offsets.reset(new int32_t[n + 1]);
+		column.values.reset(new char[bytes]);
+		int32_t offset = 0;
+		for (std::size_t k = 0; k < n; ++k) {
+			const std::string &str = view.samples[k]->string_data()[c];
+			column.offsets[k] = offset;
+			if (!str.empty()) memcpy(column.values.get() + offset, str.data(), str.size());
+			offset += static_cast<int32_t>(str.size());
+		}
+		column.offsets[n] = offset;
+	}
+}
+} // namespace
+
+void lsl::export_arrow_chunk(const sample_view &view, lsl_channel_format_t format,
+	uint32_t num_chans, ArrowArray *array, ArrowSchema *schema) {
+	const std::size_t n = view.samples.size();
+	std::vector<std::unique_ptr<array_data>> columns(num_chans);
+	for (auto &column : columns) column.reset(new array_data());
+	switch (format) {
+	case cft_float32: scatter_values<float>(view, columns); break;
+	case cft_double64: scatter_values<double>(view, columns); break;
+	case cft_string: copy_strings(view, columns); break;
+	case cft_int32: scatter_values<int32_t>(view, columns); break;
+	case cft_int16: scatter_values<int16_t>(view, columns); break;
+	case cft_int8: scatter_values<int8_t>(view, columns); break;
+	case cft_int64: scatter_values<int64_t>(view, columns); break;
+	case cft_int24: widen_int24(view, columns); break;
+	case cft_float16: scatter_values<uint16_t>(view, columns); break;
+	default: throw std::invalid_argument("Unsupported channel format.");
+	}
+	auto timestamps = std::unique_ptr<array_data>(new array_data());
+	timestamps->values.reset(new char[n * sizeof(double)]);
+	if (n) memcpy(timestamps->values.get(), view.timestamps.data(), n * sizeof(double));
+
+	// everything that allocates comes before the arrays and schemas are handed out
+	std::unique_ptr<schema_data> struct_schema(new schema_data());
+	struct_schema->format = "+s";
+	struct_schema->child_schemas.resize(num_chans + 1);
+	for (ArrowSchema &child : struct_schema->child_schemas)
+		struct_schema->children.push_back(&child);
+	std::unique_ptr<schema_data> timestamp_schema(new schema_data());
+	timestamp_schema->format = "g";
+	timestamp_schema->name = "timestamp";
+	std::vector<std::unique_ptr<schema_data>> column_schemas(num_chans);
+	for (uint32_t c = 0; c < num_chans; ++c) {
+		column_schemas[c].reset(new schema_data());
+		column_schemas[c]->format = column_format(format);
+		column_schemas[c]->name = std::to_string(c);
+	}
+	std::unique_ptr<array_data> struct_array(new array_data());
+	struct_array->child_arrays.resize(num_chans + 1);
+	for (ArrowArray &child : struct_array->child_arrays) struct_array->children.push_back(&child);
+
+	// nothing below throws, so the children can't leak
+	fill_schema(struct_schema->child_schemas[0], std::move(timestamp_schema));
+	timestamps->buffers[1] = timestamps->values.get();
+	fill_array(struct_array->child_arrays[0], std::move(timestamps), n, 2);
+	for (uint32_t c = 0; c < num_chans; ++c) {
+		fill_schema(struct_schema->child_schemas[c + 1], std::move(column_schemas[c]));
+		array_data &column = *columns[c];
+		if (format == cft_string) {
+			column.buffers[1] = column.offsets.get();
+			column.buffers[2] = column.values.get();
+		} else
+			column.buffers[1] = column.values.get();
+		fill_array(struct_array->child_arrays[c + 1], std::move(columns[c]), n,
+			format == cft_string ? 3 : 2);
+	}
+	fill_schema(*schema, std::move(struct_schema));
+	fill_array(*array, std::move(struct_array), n, 1);
+}
@@ -0,0 +1,31 @@
+#ifndef ARROW_EXPORT_H
+#define ARROW_EXPORT_H
+
+#include "../include/lsl/arrow.h"
+#include "common.h"
+#include <cstdint>
+
+namespace lsl {
+struct sample_view;
+
+/**
+ * Export samples as an Arrow C Data Interface struct array, one row per sample.
+ *
+ * The first column is a float64 `timestamp` column with the view's time stamps, followed by one
+ * column per channel (named by the channel index) in the channel format: int24 channels are
+ * widened to int32, float16 channels are half floats and string channels are utf8. The columns
+ * don't have nulls.
+ *
+ * The buffers are owned by the library until the release callbacks of the array and the schema
+ * are called; the children can also be moved out and released separately, as the specification
+ * allows. The samples themselves aren't referenced, so the view can be reused right away.
+ * @param view The samples, all of the given format and channel count.
+ * @param[out] array,schema Only written once all buffers have been filled.
+ * @throws std::length_error if the strings of a channel exceed 2 GiB.
+ */
+void export_arrow_chunk(const sample_view &view, lsl_channel_format_t format, uint32_t num_chans,
+	ArrowArray *array, ArrowSchema *schema);
+
+} // namespace lsl
+
+#endif
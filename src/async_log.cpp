@@ -0,0 +1,189 @@
+#include "async_log.h"
+#include "api_config.h"
+#include "common.h"
+#include "thread_policy.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace lsl;
+
+namespace {
+
+/// the number of messages the ring holds (a power of two)
+const std::size_t ring_slots = 1024;
+
+/// the longest message that's logged in full
+const std::size_t message_bytes = 480;
+
+/// how long (in seconds) the log thread sleeps if it isn't woken up by a message
+const double log_poll_interval = 0.05;
+
+/// A slot of the ring.
+struct log_entry {
+	/// the position the slot is written for (while it's free) or was written for + 1
+	std::atomic<std::size_t> seq;
+	loguru::Verbosity verbosity;
+	const char *file;
+	unsigned line;
+	char message[message_bytes];
+};
+
+/**
+ * A bounded ring of messages that any thread can write to without a lock (a bounded MPMC queue
+ * after Dmitry Vyukov, with only the log thread reading).
+ */
+class log_ring {
+public:
+	log_ring() : slots_(new log_entry[ring_slots]) {
+		for (std::size_t k = 0; k < ring_slots; ++k) slots_[k].seq.store(k);
+		thread_ = managed_thread(lsl_thread_watchdog, "W_log", &log_ring::run, this);
+	}
+
+	/// Stop the thread and log the messages it hasn't logged yet.
+	~log_ring() {
+		gone() = true;
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		thread_.join();
+		drain();
+	}
+
+	/// Whether the ring was destroyed (at exit), so messages are logged right away.
+	static std::atomic<bool> &gone() {
+		static std::atomic<bool> flag{false};
+		return flag;
+	}
+
+	/// The ring of the process.
+	static log_ring &instance() {
+		static log_ring ring;
+		return ring;
+	}
+
+	/// Format a message into a free slot, false if the ring is full.
+	bool push(loguru::Verbosity verbosity, const char *file, unsigned line, uint32_t dropped,
+		const char *format, va_list args) {
+		std::size_t pos = head_.load(std::memory_order_relaxed);
+		log_entry *entry;
+		while (true) {
+			entry = &slots_[pos & (ring_slots - 1)];
+			const std::size_t seq = entry->seq.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+			if (diff == 0) {
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0)
+				return false;
+			else
+				pos = head_.load(std::memory_order_relaxed);
+		}
+		entry->verbosity = verbosity;
+		entry->file = file;
+		entry->line = line;
+		format_message(entry->message, true, dropped, format, args);
+		entry->seq.store(pos + 1, std::memory_order_release);
+		cv_.notify_one();
+		return true;
+	}
+
+	/// Wait (up to a second) until the messages pushed before are logged.
+	void flush() {
+		const std::size_t target = head_.load(std::memory_order_acquire);
+		cv_.notify_one();
+		for (int k = 0; k < 1000 && logged_.load(std::memory_order_acquire) < target; ++k)
+			sleep_precise(0.001);
+	}
+
+	/**
+	 * Format a message with the number of messages dropped before it.
+	 * @param with_thread Whether to start with the name of the thread that logged it (as loguru
+	 * only knows the log thread).
+	 */
+	static void format_message(
+		char *out, bool with_thread, uint32_t dropped, const char *format, va_list args) {
+		int n = 0;
+		if (with_thread) {
+			char thread[32];
+			loguru::get_thread_name(thread, sizeof(thread), false);
+			n = snprintf(out, message_bytes, "[%s] ", thread);
+			if (n < 0 || static_cast<std::size_t>(n) >= message_bytes) n = 0;
+		}
+		const int body = vsnprintf(out + n, message_bytes - n, format, args);
+		if (dropped && body >= 0 && static_cast<std::size_t>(n + body) < message_bytes)
+			snprintf(out + n + body, message_bytes - n - body, " (%u more dropped)", dropped);
+	}
+
+private:
+	/// The log thread.
+	void run() {
+		std::unique_lock<std::mutex> lock(mut_);
+		while (!stop_) {
+			lock.unlock();
+			drain();
+			lock.lock();
+			cv_.wait_for(lock, std::chrono::duration<double>(log_poll_interval));
+		}
+	}
+
+	/// Log the messages that were pushed completely.
+	void drain() {
+		std::size_t tail = logged_.load(std::memory_order_relaxed);
+		while (true) {
+			log_entry &entry = slots_[tail & (ring_slots - 1)];
+			if (entry.seq.load(std::memory_order_acquire) != tail + 1) break;
+			loguru::log(entry.verbosity, entry.file, entry.line, "%s", entry.message);
+			entry.seq.store(tail + ring_slots, std::memory_order_release);
+			logged_.store(++tail, std::memory_order_release);
+		}
+	}
+
+	std::unique_ptr<log_entry[]> slots_;
+	/// the position of the next slot to write, and of the next one to log
+	std::atomic<std::size_t> head_{0}, logged_{0};
+	std::mutex mut_;
+	/// wakes up the log thread when a message is pushed or the ring is destroyed
+	std::condition_variable cv_;
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace
+
+bool log_site::admit() {
+	const int limit = api_config::get_instance()->log_rate_limit();
+	if (limit <= 0) return true;
+	const auto now = static_cast<int64_t>(lsl_clock());
+	int64_t current = second.load(std::memory_order_relaxed);
+	if (current != now && second.compare_exchange_strong(current, now))
+		count.store(0, std::memory_order_relaxed);
+	if (count.fetch_add(1, std::memory_order_relaxed) < static_cast<uint32_t>(limit)) return true;
+	dropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void lsl::async_log(loguru::Verbosity verbosity, const char *file, unsigned line,
+	log_site &site, const char *format, ...) {
+	const uint32_t dropped = site.dropped.exchange(0, std::memory_order_relaxed);
+	va_list args;
+	va_start(args, format);
+	if (api_config::get_instance()->log_async() && !log_ring::gone()) {
+		if (!log_ring::instance().push(verbosity, file, line, dropped, format, args))
+			site.dropped.fetch_add(dropped + 1, std::memory_order_relaxed);
+	} else {
+		char message[message_bytes];
+		log_ring::format_message(message, false, dropped, format, args);
+		loguru::log(verbosity, file, line, "%s", message);
+	}
+	va_end(args);
+}
+
+void lsl::flush_async_log() {
+	if (!log_ring::gone()) log_ring::instance().flush();
+}
@@ -0,0 +1,49 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <loguru.hpp>
+
+namespace lsl {
+
+/// The rate limit state of a call site of ALOG_F().
+struct log_site {
+	/// the second the messages are counted in, and their number
+	std::atomic<int64_t> second{-1};
+	std::atomic<uint32_t> count{0};
+	/// the number of messages dropped since the last one that was logged
+	std::atomic<uint32_t> dropped{0};
+
+	/// Count a message, false if it's over the rate limit (see api_config::log_rate_limit()).
+	bool admit();
+};
+
+/// Queue a message for the log thread, see ALOG_F().
+void async_log(loguru::Verbosity verbosity, const char *file, unsigned line, log_site &site,
+	const char *format, ...) LOGURU_PRINTF_LIKE(5, 6);
+
+/// Hand the queued messages to loguru and wait until they're logged.
+void flush_async_log();
+
+} // namespace lsl
+
+/**
+ * Log a message like LOG_F(), but without waiting for loguru's lock, for the paths that log
+ * while samples are transferred (e.g. when many connections break off at once).
+ *
+ * The message is formatted into a slot of a lock-free ring that a background thread hands to
+ * loguru. Each call site logs at most [log] RateLimit messages per second, the next message
+ * after a burst tells how many were dropped. Messages that don't fit into the ring are dropped
+ * as well. With [log] Async = 0, the messages are logged right away (but still rate limited).
+ */
+#define ALOG_F(verbosity_name, ...)                                                                \
+	do {                                                                                           \
+		static lsl::log_site lsl_log_site;                                                         \
+		if (loguru::Verbosity_##verbosity_name <= loguru::current_verbosity_cutoff() &&            \
+			lsl_log_site.admit())                                                                  \
+			lsl::async_log(loguru::Verbosity_##verbosity_name, __FILE__, __LINE__, lsl_log_site,   \
+				__VA_ARGS__);                                                                      \
+	} while (false)
+
+#endif
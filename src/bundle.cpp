@@ -0,0 +1,647 @@
+#include "bundle.h"
+#include "api_config.h"
+#include "consumer_queue.h"
+#include "local_feed.h"
+#include "sample.h"
+#include "sample_frame.h"
+#include "send_buffer.h"
+#include "socket_utils.h"
+#include "timestamp_deduction.h"
+#include "util/cast.hpp"
+#include <algorithm>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstring>
+#include <istream>
+#include <list>
+#include <locale>
+#include <loguru.hpp>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+using namespace lsl;
+using asio::ip::tcp;
+
+/// the maximum number of samples of a stream per frame
+static const std::size_t max_bundle_frame_samples = 1024;
+
+/// the interval (in seconds) of the heartbeats and of the checks for destroyed outlets
+static const double bundle_heartbeat_interval = 0.5;
+
+/// how long (in seconds) a client waits for the reply to a request
+static const double bundle_reply_timeout = 5.0;
+
+/// Append a message header.
+static void put_header(std::vector<char> &out, bundle_message kind, uint32_t id) {
+	out.push_back(static_cast<char>(kind));
+	const uint32_t le_id = lslboost::endian::native_to_little(id);
+	const char *bytes = reinterpret_cast<const char *>(&le_id);
+	out.insert(out.end(), bytes, bytes + sizeof(le_id));
+}
+
+/// Parse a number of a request.
+/// @return false if it's malformed or out of the type's range.
+template <typename T> static bool parse_number(const std::string &str, T &value) {
+	if (str.empty() || (std::is_unsigned<T>::value && str[0] == '-')) return false;
+	std::istringstream is(str);
+	is.imbue(std::locale::classic());
+	is >> value;
+	return !is.fail() && is.eof();
+}
+
+template <typename T> static bool read_le(std::streambuf &sb, T &value) {
+	if (sb.sgetn(reinterpret_cast<char *>(&value), sizeof(value)) !=
+		static_cast<std::streamsize>(sizeof(value)))
+		return false;
+	lslboost::endian::little_to_native_inplace(value);
+	return true;
+}
+
+namespace {
+
+/// Wakes up the writer of a bundle_server; shared with the notifications of the consumer queues,
+/// which may be called (by the pushing threads) while the server goes away.
+struct wakeup {
+	std::mutex mut;
+	std::condition_variable cv;
+	bool signalled{false}, stop{false};
+
+	void signal() {
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			signalled = true;
+		}
+		cv.notify_all();
+	}
+};
+
+/// A stream served by a bundle_server.
+struct served_feed {
+	uint32_t id;
+	std::string uid;
+	std::shared_ptr<consumer_queue> queue;
+	/// decides which time stamps the client can deduce
+	timestamp_deduction deduction;
+	/// whether the client was told that the outlet is gone
+	bool lost{false};
+};
+
+/// The server end of a bundled connection: reads the requests and writes the frames.
+class bundle_server {
+public:
+	explicit bundle_server(tcp::socket &sock) : sock_(sock), wakeup_(std::make_shared<wakeup>()) {}
+
+	/// Read the requests until the connection is closed.
+	void run(asio::streambuf &request) {
+		write(std::string("LSL/110 200 OK\r\nByte-Order: ") + to_string(BOOST_BYTE_ORDER) +
+			  "\r\n\r\n");
+		managed_thread writer(lsl_thread_transfer, "S_bundle", &bundle_server::write_frames, this);
+		std::istream lines(&request);
+		while (true) {
+			lslboost::system::error_code ec;
+			asio::read_until(sock_, request, "\r\n", ec);
+			if (ec) break;
+			std::string line;
+			getline(lines, line);
+			const auto parts = splitandtrim(line, ' ', false);
+			uint32_t id;
+			int max_buflen;
+			uint64_t resume_from;
+			double history_seconds, parameter;
+			try {
+				if (parts.size() >= 8 && parts[0] == "add" && parse_number(parts[1], id) &&
+					parse_number(parts[3], max_buflen) && parse_number(parts[4], resume_from) &&
+					parse_number(parts[5], history_seconds) && parse_number(parts[7], parameter))
+					add(id, parts[2], max_buflen, resume_from, history_seconds,
+						consumer_queue::parse_overflow_policy(parts[6]), parameter);
+				else if (parts.size() >= 2 && parts[0] == "remove" && parse_number(parts[1], id))
+					remove(id);
+				else
+					LOG_F(WARNING, "Ignoring a malformed bundle request: %s", line.c_str());
+			} catch (std::exception &) {
+				// the connection broke
+				break;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(wakeup_->mut);
+			wakeup_->stop = true;
+		}
+		wakeup_->cv.notify_all();
+		writer.join();
+		std::lock_guard<std::mutex> lock(mut_);
+		feeds_.clear();
+	}
+
+private:
+	/// Subscribe to a stream of this process and answer the request.
+	void add(uint32_t id, const std::string &uid, int max_buflen, uint64_t resume_from,
+		double history_seconds, lsl_overflow_policy_t policy, double parameter) {
+		const local_feed feed = local_feed::find(uid);
+		const bool ok = feed.buffer && feed.factory->format() != cft_string;
+		std::vector<char> msg;
+		put_header(msg, bundle_added, id);
+		msg.push_back(ok);
+		msg.push_back(static_cast<char>(ok ? feed.factory->format() : cft_undefined));
+		const uint32_t channels =
+			lslboost::endian::native_to_little(ok ? feed.factory->num_channels() : 0);
+		msg.insert(msg.end(), reinterpret_cast<const char *>(&channels),
+			reinterpret_cast<const char *>(&channels) + sizeof(channels));
+		if (!ok) {
+			write(msg);
+			return;
+		}
+		auto f = std::make_shared<served_feed>();
+		f->id = id;
+		f->uid = uid;
+		f->queue = feed.buffer->new_consumer(consumer_queue::policy_capacity(policy, max_buflen),
+			resume_from, resume_from ? 0.0 : history_seconds);
+		f->queue->set_overflow_policy(policy, parameter);
+		f->deduction = feed.buffer->new_timestamp_deduction();
+		f->queue->set_notification([w = wakeup_]() { w->signal(); });
+		// the reply goes out before the stream's first frame
+		write(msg);
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			feeds_.push_back(std::move(f));
+		}
+		wakeup_->signal();
+	}
+
+	void remove(uint32_t id) {
+		std::lock_guard<std::mutex> lock(mut_);
+		feeds_.erase(std::remove_if(feeds_.begin(), feeds_.end(),
+						 [id](const std::shared_ptr<served_feed> &f) { return f->id == id; }),
+			feeds_.end());
+	}
+
+	template <typename Buffer> void write(const Buffer &msg) {
+		std::lock_guard<std::mutex> lock(write_mut_);
+		asio::write(sock_, asio::buffer(msg));
+	}
+
+	/// The writer thread: sends the queued samples of all streams and the heartbeats.
+	void write_frames() {
+		std::vector<sample_p> popped(max_bundle_frame_samples);
+		std::vector<char> msg;
+		frame_builder frame;
+		double last_heartbeat = lsl_clock();
+		try {
+			while (true) {
+				{
+					std::lock_guard<std::mutex> lock(wakeup_->mut);
+					if (wakeup_->stop) break;
+					wakeup_->signalled = false;
+				}
+				std::vector<std::shared_ptr<served_feed>> feeds;
+				{
+					std::lock_guard<std::mutex> lock(mut_);
+					feeds = feeds_;
+				}
+				bool sent = false;
+				for (const auto &f : feeds) {
+					const std::size_t n = f->queue->pop_samples(popped.data(), popped.size());
+					if (n) sent = send_frame(*f, popped, n, msg, frame) || sent;
+				}
+				// the heartbeats keep the idle streams alive, even while others are busy
+				if (lsl_clock() - last_heartbeat >= bundle_heartbeat_interval) {
+					// the outlets that went away without a sentinel reaching their queue
+					for (const auto &f : feeds)
+						if (!local_feed::find(f->uid).buffer) send_lost(*f, msg);
+					msg.clear();
+					put_header(msg, bundle_heartbeat, 0);
+					write(msg);
+					last_heartbeat = lsl_clock();
+				}
+				if (sent) continue;
+				// wait for the next samples, unless some arrived in the meantime
+				bool ready = false;
+				for (const auto &f : feeds) ready = !f->queue->arm_notification(1) || ready;
+				if (ready) continue;
+				std::unique_lock<std::mutex> lock(wakeup_->mut);
+				wakeup_->cv.wait_for(lock, std::chrono::duration<double>(bundle_heartbeat_interval),
+					[this]() { return wakeup_->signalled || wakeup_->stop; });
+			}
+		} catch (std::exception &e) {
+			LOG_F(INFO, "Bundled connection closed: %s", e.what());
+			// let the reader know
+			lslboost::system::error_code ec;
+			sock_.shutdown(tcp::socket::shutdown_both, ec);
+		}
+	}
+
+	/**
+	 * Send the popped samples of a stream as a frame.
+	 * @return Whether anything was sent.
+	 */
+	bool send_frame(served_feed &f, std::vector<sample_p> &popped, std::size_t n,
+		std::vector<char> &msg, frame_builder &frame) {
+		msg.clear();
+		frame.clear();
+		put_header(msg, bundle_frame, f.id);
+		const std::size_t header_pos = msg.size();
+		msg.resize(header_pos + frame_header_bytes);
+		bool lost = false;
+		for (std::size_t k = 0; k < n; ++k) {
+			sample_p samp(std::move(popped[k]));
+			if (!samp) {
+				// the sentinel of a destroyed outlet
+				lost = true;
+				continue;
+			}
+			msg.insert(msg.end(), samp->raw_data(), samp->raw_data() + samp->datasize());
+			frame.add(f.deduction.wire_timestamp(samp->timestamp, samp->seq), samp->seq);
+		}
+		if (frame.size()) {
+			frame.finish(msg.size() - header_pos - frame_header_bytes, BOOST_BYTE_ORDER);
+			memcpy(&msg[header_pos], frame.header(), frame_header_bytes);
+			msg.insert(msg.end(), frame.trailer().begin(), frame.trailer().end());
+			write(msg);
+		}
+		if (lost) send_lost(f, msg);
+		return frame.size() || lost;
+	}
+
+	/// Tell the client that a stream's outlet is gone and stop serving it.
+	void send_lost(served_feed &f, std::vector<char> &msg) {
+		if (f.lost) return;
+		f.lost = true;
+		msg.clear();
+		put_header(msg, bundle_lost, f.id);
+		write(msg);
+		remove(f.id);
+	}
+
+	tcp::socket &sock_;
+	/// serializes the messages
+	std::mutex write_mut_;
+	/// protects feeds_
+	std::mutex mut_;
+	std::vector<std::shared_ptr<served_feed>> feeds_;
+	/// wakes up the writer when samples are pushed or the connection is closed
+	std::shared_ptr<wakeup> wakeup_;
+};
+
+/// A std::streambuf that reads from a socket, so the frames can be read with read_frame().
+class socket_reader : public std::streambuf {
+public:
+	explicit socket_reader(tcp::socket &sock) : sock_(sock), buf_(64 * 1024) {
+		setg(buf_.data(), buf_.data(), buf_.data());
+	}
+
+protected:
+	int_type underflow() override {
+		lslboost::system::error_code ec;
+		const std::size_t n = sock_.read_some(asio::buffer(buf_), ec);
+		if (ec || !n) return traits_type::eof();
+		setg(buf_.data(), buf_.data(), buf_.data() + n);
+		return traits_type::to_int_type(buf_[0]);
+	}
+
+private:
+	tcp::socket &sock_;
+	std::vector<char> buf_;
+};
+
+/// A std::streambuf over a frame that was read before, so it can be decoded with read_frame().
+class frame_reader : public std::streambuf {
+public:
+	explicit frame_reader(std::vector<char> &frame) {
+		setg(frame.data(), frame.data(), frame.data() + frame.size());
+	}
+};
+
+/// Read a sample frame (its header and body) without decoding it.
+void read_raw_frame(std::streambuf &sb, std::vector<char> &frame) {
+	frame.resize(frame_header_bytes);
+	if (sb.sgetn(frame.data(), frame_header_bytes) !=
+		static_cast<std::streamsize>(frame_header_bytes))
+		throw std::runtime_error("The bundled connection was closed.");
+	uint32_t bytes;
+	memcpy(&bytes, frame.data() + sizeof(uint32_t), sizeof(bytes));
+	lslboost::endian::little_to_native_inplace(bytes);
+	if (bytes > max_frame_bytes) throw std::runtime_error("Received a malformed sample frame.");
+	frame.resize(frame_header_bytes + bytes);
+	if (bytes && sb.sgetn(frame.data() + frame_header_bytes, bytes) !=
+					 static_cast<std::streamsize>(bytes))
+		throw std::runtime_error("The bundled connection was closed.");
+}
+
+/// The bundled connections of this process, each served by a thread of its own.
+class bundle_connections {
+public:
+	static bundle_connections &instance() {
+		static bundle_connections conns;
+		return conns;
+	}
+
+	/// Serve a connection, see serve_bundle().
+	void start(io_context_p io, std::shared_ptr<tcp::socket> sock, asio::streambuf &request) {
+		auto conn = std::make_shared<connection>();
+		conn->io = std::move(io);
+		conn->sock = std::move(sock);
+		std::ostream(&conn->request) << &request;
+		managed_thread thread(lsl_thread_transfer, "S_bundle", [conn]() {
+			try {
+				bundle_server(*conn->sock).run(conn->request);
+			} catch (std::exception &e) {
+				LOG_F(WARNING, "Unexpected error while serving a bundled connection: %s",
+					e.what());
+			}
+			conn->done = true;
+		});
+		std::lock_guard<std::mutex> lock(mut_);
+		// join the threads of the closed connections, so the list doesn't grow
+		for (auto it = conns_.begin(); it != conns_.end();)
+			if (it->first->done) {
+				it->second.join();
+				it = conns_.erase(it);
+			} else
+				++it;
+		conns_.emplace_back(std::move(conn), std::move(thread));
+	}
+
+	/// Close the open connections and wait for their threads.
+	~bundle_connections() {
+		std::lock_guard<std::mutex> lock(mut_);
+		for (auto &conn : conns_) {
+			// like the writer of a bundle_server, this ends the blocking read of its reader
+			lslboost::system::error_code ec;
+			conn.first->sock->shutdown(tcp::socket::shutdown_both, ec);
+			conn.second.join();
+		}
+	}
+
+private:
+	struct connection {
+		/// the io_context of the socket, kept alive after the accepting outlet is gone
+		io_context_p io;
+		std::shared_ptr<tcp::socket> sock;
+		asio::streambuf request;
+		std::atomic<bool> done{false};
+	};
+
+	std::mutex mut_;
+	std::list<std::pair<std::shared_ptr<connection>, managed_thread>> conns_;
+};
+
+} // namespace
+
+void lsl::serve_bundle(
+	io_context_p io, std::shared_ptr<tcp::socket> sock, asio::streambuf &request) {
+	bundle_connections::instance().start(std::move(io), std::move(sock), request);
+}
+
+std::shared_ptr<bundle_client> bundle_client::get(
+	const std::string &host, const tcp::endpoint &endpoint, const std::string &uid) {
+	static std::mutex clients_mut;
+	static std::map<std::string, std::weak_ptr<bundle_client>> clients;
+	std::lock_guard<std::mutex> lock(clients_mut);
+	auto result = clients[host].lock();
+	if (!result || result->broken()) {
+		result = std::make_shared<bundle_client>(endpoint, uid);
+		clients[host] = result;
+	}
+	return result;
+}
+
+bundle_client::bundle_client(const tcp::endpoint &endpoint, const std::string &uid)
+	: sock_(io_), reader_(new socket_reader(sock_)), pool_(task_pool::inlet_pool()) {
+	sock_.open(endpoint.protocol());
+	if (api_config::get_instance()->tcp_fast_open()) enable_fast_open_connect(sock_);
+	sock_.connect(endpoint);
+	sock_.set_option(tcp::no_delay(true));
+	// the subscriptions follow right away, the response header is read by the thread
+	send("LSL:bundle/110 " + uid);
+	thread_ = managed_thread(lsl_thread_data, "R_bundle", &bundle_client::run, this);
+}
+
+bundle_client::~bundle_client() {
+	lslboost::system::error_code ec;
+	sock_.shutdown(tcp::socket::shutdown_both, ec);
+	thread_.join();
+}
+
+uint32_t bundle_client::add(const subscription &sub, handlers h) {
+	auto f = std::make_shared<feed>();
+	f->sub = sub;
+	f->h = std::move(h);
+	if (pool_) f->strand = pool_->make_strand();
+	uint32_t id;
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		if (broken_) return 0;
+		id = next_id_++;
+		feeds_.emplace_back(id, f);
+	}
+	try {
+		send("add " + to_string(id) + ' ' + sub.uid + ' ' + to_string(sub.max_buflen) + ' ' +
+			 to_string(sub.resume_from) + ' ' + to_string(sub.history_seconds) + ' ' +
+			 consumer_queue::overflow_policy_name(sub.overflow_policy) + ' ' +
+			 to_string(sub.overflow_parameter));
+	} catch (std::exception &) {
+		remove(id);
+		return 0;
+	}
+	bool served;
+	{
+		std::unique_lock<std::mutex> lock(mut_);
+		cv_.wait_for(lock, std::chrono::duration<double>(bundle_reply_timeout),
+			[this, &f]() { return f->answered || broken_; });
+		served = f->served && !broken_;
+	}
+	if (!served) {
+		remove(id);
+		return 0;
+	}
+	return id;
+}
+
+void bundle_client::remove(uint32_t id) {
+	std::shared_ptr<feed> f;
+	bool broken;
+	{
+		std::unique_lock<std::mutex> lock(mut_);
+		// a handler that removes its own subscription doesn't wait for itself
+		if (thread_.get_id() != std::this_thread::get_id())
+			cv_.wait(lock, [this, id]() { return running_ != id; });
+		auto it = std::find_if(feeds_.begin(), feeds_.end(),
+			[id](const std::pair<uint32_t, std::shared_ptr<feed>> &f) { return f.first == id; });
+		if (it == feeds_.end()) return;
+		f = it->second;
+		feeds_.erase(it);
+		broken = broken_;
+	}
+	if (f->strand) {
+		// the pending tasks are skipped, and a running one has finished once this returns
+		f->removed = true;
+		pool_->cancel(f->strand);
+	}
+	if (broken) return;
+	try {
+		send("remove " + to_string(id));
+	} catch (std::exception &) {
+		// the connection broke, so the subscription is gone anyway
+	}
+}
+
+bool bundle_client::broken() const {
+	std::lock_guard<std::mutex> lock(mut_);
+	return broken_;
+}
+
+std::size_t bundle_client::size() {
+	std::lock_guard<std::mutex> lock(mut_);
+	return feeds_.size();
+}
+
+void bundle_client::send(const std::string &line) {
+	const std::string msg = line + "\r\n";
+	std::lock_guard<std::mutex> lock(send_mut_);
+	asio::write(sock_, asio::buffer(msg));
+}
+
+void bundle_client::run() {
+	std::vector<char> body;
+	std::vector<sample_p> samples;
+	// call a handler of a feed unless it was removed
+	auto call = [this](uint32_t id, const std::function<void(feed &)> &fn) {
+		std::shared_ptr<feed> f;
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			for (const auto &entry : feeds_)
+				if (entry.first == id) f = entry.second;
+			if (!f) return false;
+			running_ = id;
+		}
+		try {
+			fn(*f);
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unexpected error in a bundled stream's handler: %s", e.what());
+		}
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			running_ = 0;
+		}
+		cv_.notify_all();
+		return true;
+	};
+	auto find = [this](uint32_t id) {
+		std::shared_ptr<feed> f;
+		std::lock_guard<std::mutex> lock(mut_);
+		for (const auto &entry : feeds_)
+			if (entry.first == id) f = entry.second;
+		return f;
+	};
+	// call a handler, or run it in the feed's strand if the frames are decoded by the pool
+	auto dispatch = [this, &call, &find](uint32_t id, const std::function<void(feed &)> &fn) {
+		if (!pool_) {
+			call(id, fn);
+			return;
+		}
+		auto f = find(id);
+		if (!f) return;
+		pool_->post(f->strand, [f, fn]() {
+			if (f->removed) return;
+			try {
+				fn(*f);
+			} catch (std::exception &e) {
+				LOG_F(ERROR, "Unexpected error in a bundled stream's handler: %s", e.what());
+			}
+		});
+	};
+	auto ids = [this]() {
+		std::vector<uint32_t> result;
+		std::lock_guard<std::mutex> lock(mut_);
+		for (const auto &entry : feeds_) result.push_back(entry.first);
+		return result;
+	};
+	try {
+		std::istream response(reader_.get());
+		std::string line;
+		if (!getline(response, line) || trim(line) != "LSL/110 200 OK")
+			throw std::runtime_error("The outlet doesn't support bundled connections.");
+		while (getline(response, line) && !trim(line).empty()) {
+			const std::size_t colon = line.find(':');
+			if (colon != std::string::npos && trim(line.substr(0, colon)) == "Byte-Order")
+				byte_order_ = std::stoi(trim(line.substr(colon + 1)));
+		}
+		if (!response) throw std::runtime_error("The bundled connection was closed.");
+		while (true) {
+			uint8_t kind;
+			uint32_t id;
+			if (!read_le(*reader_, kind) || !read_le(*reader_, id))
+				throw std::runtime_error("The bundled connection was closed.");
+			switch (kind) {
+			case bundle_heartbeat:
+				for (uint32_t each : ids()) dispatch(each, [](feed &f) { f.h.alive(); });
+				break;
+			case bundle_added: {
+				uint8_t ok, format;
+				uint32_t channels;
+				if (!read_le(*reader_, ok) || !read_le(*reader_, format) ||
+					!read_le(*reader_, channels))
+					throw std::runtime_error("The bundled connection was closed.");
+				{
+					std::lock_guard<std::mutex> lock(mut_);
+					for (const auto &entry : feeds_)
+						if (entry.first == id) {
+							entry.second->answered = true;
+							entry.second->served = ok && format == entry.second->sub.format &&
+												   channels == entry.second->sub.channels;
+						}
+				}
+				cv_.notify_all();
+				break;
+			}
+			case bundle_frame: {
+				auto f = find(id);
+				if (!f) {
+					// a frame that was sent before the subscription was removed
+					read_raw_frame(*reader_, body);
+					break;
+				}
+				if (pool_) {
+					std::vector<char> frame;
+					read_raw_frame(*reader_, frame);
+					const int byte_order = byte_order_;
+					pool_->post(f->strand, [f, frame = std::move(frame), byte_order]() mutable {
+						if (f->removed) return;
+						frame_reader sb(frame);
+						std::vector<sample_p> decoded;
+						try {
+							read_frame(sb, *f->sub.factory, f->sub.format, f->sub.channels,
+								byte_order, false, f->body, decoded);
+						} catch (std::exception &e) {
+							LOG_F(ERROR, "Dropped a frame of a bundled stream: %s", e.what());
+							return;
+						}
+						f->h.samples(decoded);
+					});
+					break;
+				}
+				samples.clear();
+				read_frame(*reader_, *f->sub.factory, f->sub.format, f->sub.channels, byte_order_,
+					false, body, samples);
+				call(id, [&samples](feed &f) { f.h.samples(samples); });
+				samples.clear();
+				break;
+			}
+			case bundle_lost: dispatch(id, [](feed &f) { f.h.lost(); }); break;
+			default: throw std::runtime_error("Received a malformed bundle message.");
+			}
+		}
+	} catch (std::exception &e) {
+		LOG_F(INFO, "Bundled connection lost: %s", e.what());
+	}
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		broken_ = true;
+	}
+	cv_.notify_all();
+	for (uint32_t each : ids()) dispatch(each, [](feed &f) { f.h.lost(); });
+}
@@ -0,0 +1,183 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include "common.h"
+#include "forward.h"
+#include "task_pool.h"
+#include "thread_policy.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * The messages a bundle server sends to its client.
+ *
+ * A bundled connection (`LSL:bundle/110 [UID]`) carries the samples of many streams of the
+ * outlets' process over one TCP connection. After the response header (with the server's
+ * `Byte-Order`), the client subscribes to streams with `add [id] [uid] [max_buflen]
+ * [resume_from] [history_seconds] [overflow_policy] [overflow_parameter]` lines and cancels them
+ * with `remove [id]` lines. The server sends binary messages, each starting with the kind (uint8)
+ * and the client's id of the stream (little endian uint32):
+ */
+enum bundle_message : uint8_t {
+	/// nothing else (id 0), sent while the server has nothing to send, so idle streams aren't
+	/// deemed stalled
+	bundle_heartbeat = 0,
+	/// the reply to an add: whether the stream is served (uint8), its channel format (uint8) and
+	/// channel count (little endian uint32)
+	bundle_added = 1,
+	/// a chunk of samples of the stream as a sample frame (with sequence numbers, in the server's
+	/// byte order, see frame_flags)
+	bundle_frame = 2,
+	/// the stream's outlet is gone
+	bundle_lost = 3,
+};
+
+/**
+ * Serve a bundled connection that was accepted by a tcp_server of this process.
+ *
+ * The streams are taken from the outlets' send buffers (see local_feed), so all outlets of the
+ * process can be served. The connection is taken over from the accepting server, which may go
+ * away before it: a thread of its own serves it until the client closes it, or until the library
+ * is unloaded.
+ * @param io The io_context of the socket.
+ * @param sock The connection's socket, after the request line was read. The caller mustn't use
+ * it anymore, and mustn't close it along with its other sockets.
+ * @param request The rest of what was read from the socket; it's moved out.
+ */
+void serve_bundle(
+	io_context_p io, std::shared_ptr<asio::ip::tcp::socket> sock, asio::streambuf &request);
+
+/**
+ * The client end of a bundled connection to the outlets of another host (see bundle_message).
+ *
+ * Inlets with bundling enabled (see data_receiver::set_bundling()) share one connection per
+ * remote host: its thread reads the frames of all streams and hands them to the inlets' handlers,
+ * so the streams cost neither a connection nor a thread of their own at either end.
+ *
+ * With a task_pool::inlet_pool(), the thread only reads the frames, and each stream's frames are
+ * decoded and handed to its handlers by the pool's threads, one after another and in order.
+ */
+class bundle_client {
+public:
+	/// The functions a subscribed stream's frames and events are handed to (from the thread of
+	/// the connection or the pool, one at a time).
+	struct handlers {
+		/// the samples of a frame
+		std::function<void(std::vector<sample_p> &)> samples;
+		/// a heartbeat: the connection is alive
+		std::function<void()> alive;
+		/// the stream's outlet or the connection is gone
+		std::function<void()> lost;
+	};
+
+	/// The parameters of a subscription.
+	struct subscription {
+		std::string uid;
+		/// the format the inlet expects
+		lsl_channel_format_t format;
+		uint32_t channels;
+		/// allocates the received samples
+		factory_p factory;
+		int max_buflen;
+		uint64_t resume_from;
+		double history_seconds;
+		lsl_overflow_policy_t overflow_policy;
+		double overflow_parameter;
+	};
+
+	/**
+	 * Get the connection to a host, connecting to the endpoint of one of its outlets if there's
+	 * none yet.
+	 *
+	 * The request isn't answered before the first subscriptions are sent (with TCP Fast Open,
+	 * even in the SYN), so an outlet that doesn't support bundling only shows by its streams not
+	 * being served.
+	 * @param host The host name of the outlet (see stream_info_impl::hostname()), so the streams
+	 * of a host share the connection even if they were resolved through different interfaces.
+	 * @throws std::runtime_error if the connection fails.
+	 */
+	static std::shared_ptr<bundle_client> get(const std::string &host,
+		const asio::ip::tcp::endpoint &endpoint, const std::string &uid);
+
+	/// Connect to the endpoint of an outlet, see get().
+	bundle_client(const asio::ip::tcp::endpoint &endpoint, const std::string &uid);
+
+	/// Close the connection.
+	~bundle_client();
+
+	bundle_client(const bundle_client &) = delete;
+	bundle_client &operator=(const bundle_client &) = delete;
+
+	/**
+	 * Subscribe to a stream.
+	 * @return The id to remove the subscription with, 0 if the stream isn't served by this
+	 * connection (e.g. its outlet is in another process) or the formats don't match.
+	 */
+	uint32_t add(const subscription &sub, handlers h);
+
+	/// Cancel a subscription, waits for its handlers to finish if they're running.
+	void remove(uint32_t id);
+
+	/// Whether the connection broke off.
+	bool broken() const;
+
+	/// The number of subscriptions.
+	std::size_t size();
+
+private:
+	struct feed {
+		subscription sub;
+		handlers h;
+		/// whether the add was answered, and whether the stream is served
+		bool answered{false}, served{false};
+		/// runs the handlers if the frames are decoded by the pool
+		task_pool::strand_p strand;
+		/// set once the subscription is removed, so its pending tasks are skipped
+		std::atomic<bool> removed{false};
+		/// the frame body buffer of the pooled decoding
+		std::vector<char> body;
+	};
+
+	/// The connection's thread: reads the messages.
+	void run();
+
+	/// Send a request line.
+	void send(const std::string &line);
+
+	asio::io_context io_;
+	asio::ip::tcp::socket sock_;
+	/// reads from the socket
+	std::unique_ptr<std::streambuf> reader_;
+	/// the byte order of the server
+	int byte_order_{0};
+	/// serializes the requests
+	std::mutex send_mut_;
+	/// protects the fields below
+	mutable std::mutex mut_;
+	/// notified when an add is answered or a handler has finished
+	std::condition_variable cv_;
+	std::vector<std::pair<uint32_t, std::shared_ptr<feed>>> feeds_;
+	uint32_t next_id_{1};
+	/// the id of the feed whose handler is running (0 if none)
+	uint32_t running_{0};
+	bool broken_{false};
+	/// decodes the frames and runs the handlers, if set
+	std::shared_ptr<task_pool> pool_;
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,47 @@
+#include "calibration.h"
+#include "stream_info_impl.h"
+#include <stdexcept>
+
+using namespace lsl;
+
+template <class T>
+static calibration::channels<T> convert(lsl_channel_format_t format,
+	const std::vector<double> &gains, const std::vector<double> &offsets) {
+	return calibration::channels<T>{std::vector<T>(gains.begin(), gains.end()),
+		std::vector<T>(offsets.begin(), offsets.end()), scaled_kernel<T>::select(format)};
+}
+
+calibration::calibration(lsl_channel_format_t format, uint32_t channel_count,
+	const std::vector<double> &gains, const std::vector<double> &offsets) {
+	if (format == cft_string)
+		throw std::invalid_argument("Samples of string-formatted streams can't be calibrated.");
+	if ((!gains.empty() && gains.size() != channel_count) ||
+		(!offsets.empty() && offsets.size() != channel_count))
+		throw std::invalid_argument("There must be one gain and offset per channel.");
+	const std::vector<double> all_gains = gains.empty() ? std::vector<double>(channel_count, 1.0)
+														: gains;
+	const std::vector<double> all_offsets =
+		offsets.empty() ? std::vector<double>(channel_count, 0.0) : offsets;
+	floats_ = convert<float>(format, all_gains, all_offsets);
+	doubles_ = convert<double>(format, all_gains, all_offsets);
+}
+
+calibration calibration::from_desc(
+	const stream_info_impl &info, const std::vector<uint32_t> &subset) {
+	const uint32_t source_channels = info.channel_count();
+	std::vector<double> gains(source_channels, 1.0), offsets(source_channels, 0.0);
+	uint32_t k = 0;
+	for (const pugi::xml_node channel : info.desc().child("channels").children("channel")) {
+		if (k == source_channels) break;
+		gains[k] = channel.child("gain").text().as_double(1.0);
+		offsets[k++] = channel.child("offset").text().as_double(0.0);
+	}
+	if (subset.empty()) return calibration(info.channel_format(), source_channels, gains, offsets);
+	std::vector<double> subset_gains, subset_offsets;
+	for (uint32_t channel : subset) {
+		subset_gains.push_back(gains.at(channel));
+		subset_offsets.push_back(offsets.at(channel));
+	}
+	return calibration(info.channel_format(), static_cast<uint32_t>(subset.size()), subset_gains,
+		subset_offsets);
+}
@@ -0,0 +1,61 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "common.h"
+#include "sample.h"
+#include <cstdint>
+#include <vector>
+
+namespace lsl {
+class stream_info_impl;
+
+/**
+ * Per-channel gains and offsets that convert e.g. ADC counts to physical units while an inlet's
+ * pulls into float and double buffers convert the channel values (see scaled_kernel), so the
+ * consumer doesn't need a second pass over the data.
+ *
+ * Channel k of a pulled sample is `value * gain[k] + offset[k]`. Pulls into buffers of other
+ * types get the raw values.
+ */
+class calibration {
+public:
+	/// The gains and offsets in one element type, with the kernel for the stream's format.
+	template <class T> struct channels {
+		std::vector<T> gains, offsets;
+		typename scaled_kernel<T>::retrieve_fn retrieve;
+
+		/// Retrieve the calibrated values of a sample.
+		void apply(sample &s, T *dst) const {
+			s.retrieve_scaled(dst, retrieve, gains.data(), offsets.data());
+		}
+	};
+
+	/**
+	 * @param gains, offsets One value per channel, or none for gains of 1 or offsets of 0.
+	 * @throws std::invalid_argument for string streams or if a number of values doesn't match
+	 * the channel count.
+	 */
+	calibration(lsl_channel_format_t format, uint32_t channel_count,
+		const std::vector<double> &gains, const std::vector<double> &offsets);
+
+	/**
+	 * Read the gains and offsets from the `gain` and `offset` elements of the
+	 * `desc/channels/channel` entries of a stream's full info; missing ones are 1 and 0.
+	 * @param subset The indices of the received channels, or none for all channels.
+	 * @throws std::invalid_argument for string streams.
+	 */
+	static calibration from_desc(const stream_info_impl &info, const std::vector<uint32_t> &subset);
+
+	/// The calibration of pulls into T buffers, nullptr for types other than float and double.
+	const channels<float> *get(float *) const { return &floats_; }
+	const channels<double> *get(double *) const { return &doubles_; }
+	template <class T> const channels<T> *get(T *) const { return nullptr; }
+
+private:
+	channels<float> floats_;
+	channels<double> doubles_;
+};
+
+} // namespace lsl
+
+#endif
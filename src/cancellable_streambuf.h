@@ -15,11 +15,19 @@
 
 #define BOOST_ASIO_NO_DEPRECATED
 #include "cancellation.h"
+#include "socket_utils.h"
 #include <boost/asio/basic_stream_socket.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <exception>
+#include <functional>
+#include <memory>
 #include <streambuf>
+#include <vector>
 
 namespace asio = lslboost::asio;
 using lslboost::system::error_code;
@@ -35,7 +43,10 @@ class cancellable_streambuf : public std::streambuf,
 							  public lsl::cancellable_obj {
 public:
 	/// Construct a cancellable_streambuf without establishing a connection.
-	cancellable_streambuf() : io_context(), Socket(as_context()) { init_buffers(); }
+	cancellable_streambuf()
+		: io_context(), Socket(as_context()), get_buffer_(putback_max + get_buffer_size) {
+		init_buffers();
+	}
 
 	/// Destructor flushes buffered data.
 	virtual ~cancellable_streambuf() override {
@@ -73,12 +84,104 @@ public:
 
 			init_buffers();
 			socket().close(ec_);
+			// the options are set before connecting, since the receive buffer size determines
+			// the window scaling negotiated in the handshake
+			socket().open(endpoint.protocol(), ec_);
+			if (ec_) return nullptr;
+			apply_socket_options(socket(), socket_options_);
 			socket().async_connect(endpoint, [this](const error_code &ec) { this->ec_ = ec; });
 			this->as_context().restart();
 		}
 		ec_ = asio::error::would_block;
 		do as_context().run_one();
 		while (!cancel_issued_ && ec_ == asio::error::would_block);
+		if (ec_) return nullptr;
+		// reads try the socket directly before waiting in the reactor (see receive())
+		socket().non_blocking(true, ec_);
+		return !ec_ ? this : nullptr;
+	}
+
+	/**
+	 * Establish a connection to the first of several endpoints that accepts it, e.g. to the IPv4
+	 * and IPv6 addresses of a dual-stack host (like "Happy Eyeballs", RFC 8305).
+	 *
+	 * The endpoints are tried in order, each one in parallel to the previous ones once they had a
+	 * head start or failed, so an unreachable address doesn't stall the connection until the OS
+	 * gives up on it.
+	 * @return \c this if a connection was successfully established, a null pointer otherwise.
+	 */
+	cancellable_streambuf *connect(
+		const std::vector<Protocol::endpoint> &endpoints, double head_start) {
+		if (endpoints.size() == 1) return connect(endpoints.front());
+		const std::size_t count = endpoints.size();
+		std::vector<std::unique_ptr<Socket>> attempts;
+		std::size_t failed = 0, winner = count;
+		bool finished = false;
+		error_code last_error = asio::error::host_not_found;
+		asio::steady_timer delay(as_context());
+		std::function<void()> start_next = [&]() {
+			if (finished || winner < count || attempts.size() == count) return;
+			const std::size_t k = attempts.size();
+			attempts.emplace_back(new Socket(as_context()));
+			Socket &sock = *attempts.back();
+			error_code ec;
+			sock.open(endpoints[k].protocol(), ec);
+			if (ec) {
+				last_error = ec;
+				++failed;
+				start_next();
+				return;
+			}
+			apply_socket_options(sock, socket_options_);
+			sock.async_connect(endpoints[k], [&, k](const error_code &ec) {
+				if (finished) return;
+				if (!ec) {
+					if (winner == count) winner = k;
+					return;
+				}
+				last_error = ec;
+				++failed;
+				// the newest attempt failed, so the next one needn't wait for its head start
+				if (k + 1 == attempts.size()) start_next();
+			});
+			delay.expires_after(std::chrono::duration_cast<asio::steady_timer::duration>(
+				std::chrono::duration<double>(head_start)));
+			delay.async_wait([&](const error_code &ec) {
+				if (!ec) start_next();
+			});
+		};
+		{
+			std::lock_guard<std::recursive_mutex> lock(cancel_mut_);
+			if (cancel_issued_)
+				throw std::runtime_error(
+					"Attempt to connect() a cancellable_streambuf after it has been cancelled.");
+
+			init_buffers();
+			socket().close(ec_);
+			this->as_context().restart();
+			start_next();
+		}
+		while (!cancel_issued_ && winner == count && failed < count) as_context().run_one();
+		// the remaining attempts are aborted, and their handlers have to run before returning
+		finished = true;
+		delay.cancel();
+		for (std::size_t k = 0; k < attempts.size(); ++k)
+			if (k != winner) attempts[k]->close(ec_);
+		as_context().restart();
+		as_context().poll();
+		as_context().restart();
+		if (winner == count) {
+			ec_ = cancel_issued_ ? error_code(asio::error::operation_aborted) : last_error;
+			return nullptr;
+		}
+		{
+			std::lock_guard<std::recursive_mutex> lock(cancel_mut_);
+			socket() = std::move(*attempts[winner]);
+			// a cancel() may have closed the previous socket in the meantime
+			if (cancel_issued_) close_if_open();
+		}
+		// reads try the socket directly before waiting in the reactor (see receive())
+		socket().non_blocking(true, ec_);
 		return !ec_ ? this : nullptr;
 	}
 
@@ -100,6 +203,37 @@ public:
 	 */
 	const error_code &error() const { return ec_; }
 
+	/// The endpoint of the connected peer (default-constructed if not connected).
+	typename Protocol::endpoint remote_endpoint() {
+		error_code ec;
+		return socket().remote_endpoint(ec);
+	}
+
+	/// The number of bytes received so far.
+	uint64_t bytes_received() const { return bytes_received_; }
+
+	/**
+	 * Set the size up to which the receive buffer grows (at least its initial size).
+	 *
+	 * The buffer doubles whenever a read fills it completely, i.e. while the data arrives faster
+	 * than it's consumed, so high-bandwidth streams need fewer reads.
+	 */
+	void set_max_receive_buffer(std::size_t bytes) {
+		max_get_buffer_ = std::max<std::size_t>(bytes, get_buffer_size);
+	}
+
+	/// The memory of the receive buffer, in bytes.
+	std::size_t receive_buffer_bytes() const { return get_buffer_.size(); }
+
+	/**
+	 * Let reads fail with asio::error::timed_out once nothing has been received for this many
+	 * seconds (0 to wait forever), e.g. if the peer sends heartbeats while it has no data.
+	 */
+	void set_receive_timeout(double seconds) { receive_timeout_ = seconds; }
+
+	/// Set the socket options used for the next connect().
+	void set_socket_options(const socket_options &opts) { socket_options_ = opts; }
+
 protected:
 	/// Close the socket if it's open.
 	void close_if_open() {
@@ -126,21 +260,71 @@ protected:
 		// will be processed by the run_one
 	}
 
-	int_type underflow() override {
-		if (gptr() == egptr()) {
-			std::size_t bytes_transferred_;
-			socket().async_receive(asio::buffer(asio::buffer(get_buffer_) + putback_max),
-				[this, &bytes_transferred_](
-					const error_code &ec, std::size_t bytes_transferred = 0) {
-					this->ec_ = ec;
-					bytes_transferred_ = bytes_transferred;
-				});
+	/**
+	 * Receive up to n bytes into dst; returns 0 (and sets the error) if the receive failed.
+	 *
+	 * While the data arrives faster than it's read, it's fetched with a single non-blocking
+	 * receive; only if none is waiting, the read is handed to the reactor (which can be cancelled).
+	 */
+	std::size_t receive(char *dst, std::size_t n) {
+		if (cancel_issued_) {
+			ec_ = asio::error::operation_aborted;
+			return 0;
+		}
+		if (socket().non_blocking()) {
+			const std::size_t received = socket().receive(asio::buffer(dst, n), 0, ec_);
+			if (ec_ != asio::error::would_block) {
+				if (ec_) return 0;
+				bytes_received_ += received;
+				return received;
+			}
+		}
+		std::size_t bytes_transferred_ = 0;
+		socket().async_receive(asio::buffer(dst, n),
+			[this, &bytes_transferred_](const error_code &ec, std::size_t bytes_transferred = 0) {
+				this->ec_ = ec;
+				bytes_transferred_ = bytes_transferred;
+			});
 
-			ec_ = asio::error::would_block;
-			protected_reset(); // line changed for lsl
+		ec_ = asio::error::would_block;
+		protected_reset(); // line changed for lsl
+		if (receive_timeout_ > 0.0) {
+			const auto deadline = std::chrono::steady_clock::now() +
+								  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+									  std::chrono::duration<double>(receive_timeout_));
+			do as_context().run_one_until(deadline);
+			while (!cancel_issued_ && ec_ == asio::error::would_block &&
+				   std::chrono::steady_clock::now() < deadline);
+			if (!cancel_issued_ && ec_ == asio::error::would_block) {
+				// abort the receive and wait for its handler, which references this frame
+				error_code ignored;
+				socket().cancel(ignored);
+				do as_context().run_one();
+				while (ec_ == asio::error::would_block);
+				// (unless the data arrived in the meantime)
+				if (ec_ == asio::error::operation_aborted) ec_ = asio::error::timed_out;
+			}
+		} else {
 			do as_context().run_one();
 			while (!cancel_issued_ && ec_ == asio::error::would_block);
-			if (ec_) return traits_type::eof();
+		}
+		if (ec_) return 0;
+		bytes_received_ += bytes_transferred_;
+		return bytes_transferred_;
+	}
+
+	/// The capacity of the receive buffer (without the putback area).
+	std::size_t get_capacity() const { return get_buffer_.size() - putback_max; }
+
+	int_type underflow() override {
+		if (gptr() == egptr()) {
+			// the last read filled the buffer, so more data is probably waiting
+			if (last_read_full_ && get_capacity() < max_get_buffer_)
+				get_buffer_.resize(putback_max + std::min(2 * get_capacity(), max_get_buffer_));
+			const std::size_t bytes_transferred_ =
+				receive(&get_buffer_[putback_max], get_capacity());
+			if (!bytes_transferred_) return traits_type::eof();
+			last_read_full_ = bytes_transferred_ == get_capacity();
 
 			setg(&get_buffer_[0], &get_buffer_[0] + putback_max,
 				&get_buffer_[0] + putback_max + bytes_transferred_);
@@ -149,6 +333,27 @@ protected:
 			return traits_type::eof();
 	}
 
+	/// Bulk reads: payloads at least as large as the receive buffer are received straight into
+	/// the caller's memory instead of being copied through the buffer.
+	std::streamsize xsgetn(char_type *s, std::streamsize count) override {
+		std::streamsize done = 0;
+		while (done < count) {
+			const std::streamsize buffered =
+				std::min<std::streamsize>(egptr() - gptr(), count - done);
+			if (buffered > 0) {
+				memcpy(s + done, gptr(), static_cast<std::size_t>(buffered));
+				gbump(static_cast<int>(buffered));
+				done += buffered;
+			} else if (static_cast<std::size_t>(count - done) >= get_capacity()) {
+				const std::size_t n = receive(s + done, static_cast<std::size_t>(count - done));
+				if (!n) break;
+				done += static_cast<std::streamsize>(n);
+			} else if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+				break;
+		}
+		return done;
+	}
+
 	int_type overflow(int_type c) override {
 		// Send all data in the output buffer.
 		asio::const_buffer buffer = asio::buffer(pbase(), pptr() - pbase());
@@ -185,14 +390,26 @@ protected:
 	}
 
 	void init_buffers() {
+		last_read_full_ = false;
 		setg(&get_buffer_[0], &get_buffer_[0] + putback_max, &get_buffer_[0] + putback_max);
 		setp(&put_buffer_[0], &put_buffer_[0] + sizeof(put_buffer_));
 	}
 
 	enum { putback_max = 8 };
 	enum { buffer_size = 512 };
-	char get_buffer_[buffer_size], put_buffer_[buffer_size];
+	/// the receive buffer is larger so that many small samples can be fetched with one read
+	enum { get_buffer_size = 16384 };
+	/// the receive buffer (grows up to max_get_buffer_, see set_max_receive_buffer())
+	std::vector<char> get_buffer_;
+	std::size_t max_get_buffer_{get_buffer_size};
+	/// the options applied to the socket when connecting
+	socket_options socket_options_;
+	bool last_read_full_{false};
+	/// see set_receive_timeout()
+	double receive_timeout_{0.0};
+	char put_buffer_[buffer_size];
 	error_code ec_;
+	uint64_t bytes_received_{0};
 	std::atomic<bool> cancel_issued_{false};
 	bool cancel_started_{false};
 	std::recursive_mutex cancel_mut_;
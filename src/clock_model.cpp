@@ -0,0 +1,51 @@
+#include "clock_model.h"
+#include <cmath>
+
+using namespace lsl;
+
+constexpr double clock_model::max_extrapolation;
+
+/// probes with a shorter round-trip time than this don't get any more weight
+const double min_weighted_rtt = 1e-4;
+
+/// the probes' remote times need a standard deviation of at least this to estimate the drift
+const double min_drift_span = 10.0;
+
+void clock_drift_estimator::add(double remote_time, double offset, double rtt) {
+	if (empty()) {
+		x0_ = remote_time;
+		y0_ = offset;
+		last_x_ = 0.0;
+		sw_ = swx_ = swxx_ = swy_ = swxy_ = 0.0;
+	}
+	const double x = remote_time - x0_, y = offset - y0_;
+	if (x > last_x_) {
+		// let the previous probes decay
+		const double decay = std::exp2(-(x - last_x_) / halftime_);
+		sw_ *= decay;
+		swx_ *= decay;
+		swxx_ *= decay;
+		swy_ *= decay;
+		swxy_ *= decay;
+		last_x_ = x;
+	}
+	const double rtt_bound = rtt > min_weighted_rtt ? rtt : min_weighted_rtt;
+	const double w = 1.0 / (rtt_bound * rtt_bound);
+	sw_ += w;
+	swx_ += w * x;
+	swxx_ += w * x * x;
+	swy_ += w * y;
+	swxy_ += w * x * y;
+}
+
+clock_model clock_drift_estimator::model() const {
+	const double mean_x = swx_ / sw_, mean_y = swy_ / sw_;
+	const double var_x = swxx_ / sw_ - mean_x * mean_x;
+	clock_model result;
+	if (var_x >= min_drift_span * min_drift_span)
+		result.drift = (swxy_ / sw_ - mean_x * mean_y) / var_x;
+	// the model is centered at the latest probe, where the current time stamps are
+	result.t0 = x0_ + last_x_;
+	result.offset = y0_ + mean_y + result.drift * (last_x_ - mean_x);
+	return result;
+}
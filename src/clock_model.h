@@ -0,0 +1,74 @@
+#ifndef CLOCK_MODEL_H
+#define CLOCK_MODEL_H
+
+namespace lsl {
+
+/**
+ * A linear model of the time correction for a remote clock: offset(t) = offset + drift * (t - t0).
+ *
+ * The time t is given in the remote clock's domain, so the model can be evaluated directly for
+ * the time stamps of a stream.
+ */
+struct clock_model {
+	/// the time correction at t0
+	double offset{0.0};
+	/// the change of the time correction per second
+	double drift{0.0};
+	/// the remote time the model is centered at (e.g. the time of the latest measurement)
+	double t0{0.0};
+
+	/// the model isn't extrapolated further than this (in seconds) from t0
+	static constexpr double max_extrapolation = 600.0;
+
+	/// Evaluate the model at a remote time.
+	double at(double t) const {
+		double dt = t - t0;
+		if (dt > max_extrapolation) dt = max_extrapolation;
+		if (dt < -max_extrapolation) dt = -max_extrapolation;
+		return offset + drift * dt;
+	}
+};
+
+/**
+ * Estimates the offset and drift of a remote clock from individual time probes.
+ *
+ * This is a weighted least squares fit of the measured offsets over the remote time with
+ * exponential forgetting. Each probe is weighted by the inverse of its squared round-trip time,
+ * since that bounds the error of its offset. The drift is only estimated once the probes span
+ * enough time; until then, the model has the weighted mean offset and no drift.
+ */
+class clock_drift_estimator {
+public:
+	/// @param halftime The time (in seconds) after which a probe has half of its initial weight.
+	explicit clock_drift_estimator(double halftime) : halftime_(halftime) {}
+
+	/**
+	 * Add a probe.
+	 * @param remote_time The remote time at the probe.
+	 * @param offset The measured time correction (local minus remote time).
+	 * @param rtt The round-trip time of the probe.
+	 */
+	void add(double remote_time, double offset, double rtt);
+
+	/// Discard all probes, e.g. if the remote clock was reset.
+	void reset() { sw_ = 0.0; }
+
+	/// Whether any probes have been added since the last reset.
+	bool empty() const { return sw_ <= 0.0; }
+
+	/// The current model. Must not be called if empty().
+	clock_model model() const;
+
+private:
+	double halftime_;
+	/// the remote time and offset of the first probe, to improve numerics
+	double x0_{0.0}, y0_{0.0};
+	/// the remote time of the most recent probe (relative to x0_)
+	double last_x_{0.0};
+	/// the weighted sums of 1, x, x^2, y and x*y
+	double sw_{0.0}, swx_{0.0}, swxx_{0.0}, swy_{0.0}, swxy_{0.0};
+};
+
+} // namespace lsl
+
+#endif
@@ -1,10 +1,14 @@
 #include "common.h"
 #include "api_config.h"
+#include "tsc_clock.h"
 #include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <cstdlib>
 #include <loguru.hpp>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -14,9 +18,16 @@
 #include <windows.h>
 // include mmsystem.h after windows.h
 #include <mmsystem.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #endif
 
 int64_t lsl::lsl_local_clock_ns() {
+	if (tsc_clock *tsc = tsc_clock::instance()) return tsc->now_ns();
 	return std::chrono::nanoseconds(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
@@ -29,12 +40,13 @@ LIBLSL_C_API int32_t lsl_protocol_version() {
 LIBLSL_C_API int32_t lsl_library_version() { return LSL_LIBRARY_VERSION; }
 
 LIBLSL_C_API double lsl_local_clock() {
-	const auto ns_per_s = 1000000000;
-	const auto seconds_since_epoch = std::lldiv(lsl::lsl_local_clock_ns(), ns_per_s);
+	const int64_t ns_per_s = 1000000000;
+	const int64_t ns = lsl::lsl_local_clock_ns();
 	/* For large timestamps, converting to double and then dividing by 1e9 loses precision
 	   because double has only 53 bits of precision.
-	   So we calculate everything we can as integer and only cast to double at the end */
-	return seconds_since_epoch.quot + static_cast<double>(seconds_since_epoch.rem) / ns_per_s;
+	   So we calculate everything we can as integer and only cast to double at the end.
+	   (The division and the modulo by a constant compile to a multiplication, unlike lldiv) */
+	return static_cast<double>(ns / ns_per_s) + static_cast<double>(ns % ns_per_s) / ns_per_s;
 }
 
 LIBLSL_C_API void lsl_destroy_string(char *s) {
@@ -50,11 +62,8 @@ LIBLSL_C_API const char *lsl_last_error(void) {
 // === implementation of misc functions ===
 
 void lsl::ensure_lsl_initialized() {
-	static bool is_initialized = false;
-
-	if (!is_initialized) {
-		is_initialized = true;
-
+	// initialized exactly once, even if the first outlets and inlets are created concurrently
+	static const bool is_initialized = []() {
 #if LOGURU_DEBUG_LOGGING
 		// Initialize loguru, mainly to print stacktraces on segmentation faults
 		int argc = 1;
@@ -65,7 +74,8 @@ void lsl::ensure_lsl_initialized() {
 		LOG_F(INFO, "%s", lsl_library_info());
 
 #ifdef _WIN32
-		// if a timer resolution other than 0 is requested (0 means don't override)...
+		// the library's own sleeps use high-resolution timers (see sleep_precise()), so the
+		// process-wide timer resolution is only raised if that's configured explicitly
 		if (int desired_timer_resolution = lsl::api_config::get_instance()->timer_resolution()) {
 			// then override it for the lifetime of this program
 			struct override_timer_resolution_until_exit {
@@ -76,7 +86,47 @@ void lsl::ensure_lsl_initialized() {
 			static override_timer_resolution_until_exit overrider(desired_timer_resolution);
 		}
 #endif
+		return true;
+	}();
+	(void)is_initialized;
+}
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace {
+/// A waitable timer of the calling thread, a high-resolution one where it's supported.
+struct thread_timer {
+	HANDLE handle;
+
+	thread_timer() {
+		// Windows versions before 10 1803 don't know the flag, a regular timer still works
+		handle = CreateWaitableTimerExW(
+			nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (!handle) handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}
+	~thread_timer() {
+		if (handle) CloseHandle(handle);
+	}
+};
+} // namespace
+#endif
+
+void lsl::sleep_precise(double seconds) {
+	if (!(seconds > 0.0)) return;
+#ifdef _WIN32
+	thread_local thread_timer timer;
+	LARGE_INTEGER due;
+	// negative due times are relative, in 100 ns ticks
+	due.QuadPart = -static_cast<LONGLONG>(seconds * 1e7);
+	if (timer.handle && SetWaitableTimer(timer.handle, &due, 0, nullptr, nullptr, FALSE)) {
+		WaitForSingleObject(timer.handle, INFINITE);
+		return;
 	}
+#endif
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
 }
 
 std::vector<std::string> lsl::splitandtrim(
@@ -104,6 +154,125 @@ std::vector<std::string> lsl::splitandtrim(
 	return parts;
 }
 
+/// The size of the memory pages.
+static uintptr_t page_bytes() {
+#ifdef _WIN32
+	static const uintptr_t bytes = []() {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<uintptr_t>(info.dwPageSize);
+	}();
+#else
+	static const auto bytes = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+#endif
+	return bytes;
+}
+
+/**
+ * The number of locked buffers on the first and last pages of the locked buffers.
+ *
+ * The memory locks don't nest, so these pages (which other buffers may share) are only unlocked
+ * along with the last buffer on them. The pages in between belong to a single buffer.
+ */
+struct shared_locked_pages {
+	std::mutex mut;
+	std::map<uintptr_t, std::size_t> buffers;
+
+	static shared_locked_pages &instance() {
+		static shared_locked_pages pages;
+		return pages;
+	}
+};
+
+void lsl::lock_memory(void *addr, std::size_t bytes) {
+	if (!bytes || !api_config::get_instance()->lock_memory()) return;
+	const uintptr_t page = page_bytes(), begin = reinterpret_cast<uintptr_t>(addr) & ~(page - 1),
+					last = (reinterpret_cast<uintptr_t>(addr) + bytes - 1) & ~(page - 1);
+	{
+		auto &pages = shared_locked_pages::instance();
+		std::lock_guard<std::mutex> lock(pages.mut);
+		++pages.buffers[begin];
+		if (last != begin) ++pages.buffers[last];
+#ifdef _WIN32
+		if (VirtualLock(reinterpret_cast<void *>(begin), last + page - begin)) return;
+#else
+		// mlock() faults the pages in, too
+		if (mlock(reinterpret_cast<void *>(begin), last + page - begin) == 0) return;
+#endif
+	}
+	static std::once_flag warned;
+	std::call_once(warned, []() {
+		LOG_F(WARNING, "Could not lock the buffer memory (is the locked memory limit too low?)");
+	});
+	auto *p = static_cast<volatile char *>(addr);
+	for (std::size_t offset = 0; offset < bytes; offset += page) p[offset] = p[offset];
+	p[bytes - 1] = p[bytes - 1];
+}
+
+void lsl::unlock_memory(void *addr, std::size_t bytes) {
+	if (!bytes || !api_config::get_instance()->lock_memory()) return;
+	const uintptr_t page = page_bytes(), first = reinterpret_cast<uintptr_t>(addr) & ~(page - 1),
+					last = (reinterpret_cast<uintptr_t>(addr) + bytes - 1) & ~(page - 1);
+	uintptr_t begin = first, end = last + page;
+	auto &pages = shared_locked_pages::instance();
+	std::lock_guard<std::mutex> lock(pages.mut);
+	// the first and last pages stay locked while other buffers on them are
+	auto it = pages.buffers.find(first);
+	if (it != pages.buffers.end() && --it->second) begin += page;
+	if (it != pages.buffers.end() && !it->second) pages.buffers.erase(it);
+	if (last != first) {
+		it = pages.buffers.find(last);
+		if (it != pages.buffers.end() && --it->second) end -= page;
+		if (it != pages.buffers.end() && !it->second) pages.buffers.erase(it);
+	}
+	if (begin >= end) return;
+#ifdef _WIN32
+	VirtualUnlock(reinterpret_cast<void *>(begin), end - begin);
+#else
+	munlock(reinterpret_cast<void *>(begin), end - begin);
+#endif
+}
+
+int lsl::current_numa_node() {
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+	USHORT node;
+	if (GetNumaProcessorNodeEx(&processor, &node)) return node;
+#elif defined(__linux__) && defined(SYS_getcpu)
+	unsigned cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return static_cast<int>(node);
+#endif
+	return -1;
+}
+
+void lsl::bind_memory_to_node(void *addr, std::size_t bytes, int node) {
+	if (node < 0 || !bytes) return;
+#if defined(__linux__) && defined(SYS_mbind)
+	// the flags from <numaif.h>, which is part of libnuma
+	const int mpol_preferred = 1, mpol_mf_move = 1 << 1;
+	const unsigned long bits = sizeof(unsigned long) * 8;
+	unsigned long nodemask[1024 / (sizeof(unsigned long) * 8)] = {0};
+	if (static_cast<unsigned long>(node) >= sizeof(nodemask) * 8) return;
+	nodemask[node / bits] = 1ul << (node % bits);
+	const auto page_bytes = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	const uintptr_t first =
+		(reinterpret_cast<uintptr_t>(addr) + page_bytes - 1) & ~(page_bytes - 1);
+	const uintptr_t last = (reinterpret_cast<uintptr_t>(addr) + bytes) & ~(page_bytes - 1);
+	if (last <= first) return;
+	// the preferred policy falls back to other nodes instead of failing if the node is full
+	if (syscall(SYS_mbind, first, last - first, mpol_preferred, nodemask, sizeof(nodemask) * 8,
+			mpol_mf_move) == 0)
+		return;
+	static std::once_flag warned;
+	std::call_once(warned, [node]() {
+		LOG_F(WARNING, "Could not move the buffer memory to NUMA node %d", node);
+	});
+#else
+	(void)addr;
+#endif
+}
+
 std::string lsl::trim(const std::string &input) {
 	auto first = input.find_first_not_of(" \t\r\n"), last = input.find_last_not_of(" \t\r\n");
 	if (first == std::string::npos || last == std::string::npos) return "";
@@ -7,6 +7,7 @@ extern "C" {
 #include "../include/lsl/common.h"
 }
 #include <boost/version.hpp>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -51,6 +52,9 @@ const double DEDUCED_TIMESTAMP = -1.0;
 /// Constant to indicate that a stream has variable sampling rate.
 const double IRREGULAR_RATE = 0.0;
 
+/// size of a cache line, used to keep frequently written members apart via padding
+constexpr std::size_t CACHELINE_BYTES = 64;
+
 /// Obtain a local system time stamp in nanoseconds.
 int64_t lsl_local_clock_ns();
 
@@ -60,6 +64,16 @@ inline double lsl_clock() { return lsl_local_clock(); }
 /// Ensure that LSL is initialized.
 void ensure_lsl_initialized();
 
+/**
+ * Sleep for a number of seconds as precisely as the OS allows.
+ *
+ * On Windows, the calling thread waits for its own high-resolution waitable timer, so the sleep
+ * isn't rounded up to the system's timer tick (15.6 ms by default) and the process doesn't have
+ * to raise the timer resolution for all of its threads. Elsewhere, it's
+ * std::this_thread::sleep_for().
+ */
+void sleep_precise(double seconds);
+
 /// Exception class that indicates that a stream inlet's source has been irrecoverably lost.
 class LIBLSL_CPP_API lost_error : public std::runtime_error {
 public:
@@ -73,6 +87,56 @@ public:
 	explicit timeout_error(const std::string &msg) : std::runtime_error(msg) {}
 };
 
+/**
+ * Fault in the pages of a buffer and pin them in RAM if api_config::lock_memory() is set, so the
+ * threads using the buffer don't take page faults later. If the memory can't be locked (e.g.
+ * due to RLIMIT_MEMLOCK), the pages are only touched.
+ *
+ * The locks of buffers that share a page nest: the page stays locked until all of them are
+ * unlocked.
+ */
+void lock_memory(void *addr, std::size_t bytes);
+
+/// Unpin a buffer that was passed to lock_memory(), before it is freed.
+void unlock_memory(void *addr, std::size_t bytes);
+
+/// An allocator whose memory is locked (see lock_memory()) as long as it's allocated, e.g. for
+/// the storage of a streambuf that moves when it grows.
+template <class T> struct locked_allocator {
+	using value_type = T;
+
+	locked_allocator() = default;
+	template <class U> locked_allocator(const locked_allocator<U> & /*unused*/) {}
+
+	T *allocate(std::size_t n) {
+		T *p = std::allocator<T>().allocate(n);
+		lock_memory(p, n * sizeof(T));
+		return p;
+	}
+	void deallocate(T *p, std::size_t n) {
+		unlock_memory(p, n * sizeof(T));
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template <class U> bool operator==(const locked_allocator<U> & /*unused*/) const {
+		return true;
+	}
+	template <class U> bool operator!=(const locked_allocator<U> & /*unused*/) const {
+		return false;
+	}
+};
+
+/// The NUMA node the calling thread currently runs on, or -1 if it's unknown.
+int current_numa_node();
+
+/**
+ * Place the pages of a buffer on a NUMA node, moving those that were touched already.
+ *
+ * Only the pages that lie completely within the buffer are moved. Does nothing for node -1 or
+ * where it's not supported (currently everywhere except Linux); errors are logged once.
+ */
+void bind_memory_to_node(void *addr, std::size_t bytes, int node);
+
 std::string trim(const std::string &input);
 std::vector<std::string> splitandtrim(
 	const std::string &input, char separator = ',', bool keepempty = false);
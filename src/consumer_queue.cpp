@@ -2,14 +2,42 @@
 #include "sample.h"
 #include "send_buffer.h"
 #include <chrono>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+#include <limits>
 #include <loguru.hpp>
+#include <thread>
 #include <utility>
 
 using namespace lsl;
 
-consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry)
-	: registry_(std::move(registry)), buffer_(max_capacity) {
-	if (registry_) registry_->register_consumer(this);
+consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry,
+	uint64_t replay_from, std::unique_ptr<spill_file> spill, lsl_transfer_priority_t priority,
+	bool preallocate)
+	: registry_(std::move(registry)), size_(std::max<std::size_t>(max_capacity, min_capacity)),
+	  segment_len_(std::min(size_, segment_slots)),
+	  // a single segment isn't worth releasing
+	  preallocated_(preallocate || size_ <= segment_slots),
+	  segments_(new std::atomic<item_t *>[num_segments()]), priority_(priority),
+	  // largest integer at which we can wrap correctly
+	  wrap_at_(std::numeric_limits<std::size_t>::max() - size_ -
+			   std::numeric_limits<std::size_t>::max() % size_),
+	  limit_(size_), spill_(std::move(spill)) {
+	for (std::size_t k = 0; k < num_segments(); ++k) {
+		item_t *segment = nullptr;
+		if (preallocated_) {
+			segment = allocate_segment();
+			for (std::size_t j = 0; j < segment_len_; ++j)
+				segment[j].seq_state.store(k * segment_slots + j, std::memory_order_relaxed);
+		}
+		segments_[k].store(segment, std::memory_order_release);
+	}
+	if (!preallocated_) {
+		spare_.reserve(num_segments());
+		released_.reserve(num_segments());
+	}
+	if (registry_) registry_->register_consumer(this, replay_from);
 }
 
 consumer_queue::~consumer_queue() {
@@ -20,41 +48,380 @@ consumer_queue::~consumer_queue() {
 			"Unexpected error while trying to unregister a consumer queue from its registry: %s",
 			e.what());
 	}
+	for (std::size_t k = 0; k < num_segments(); ++k)
+		if (item_t *segment = segments_[k].load(std::memory_order_acquire)) free_segment(segment);
+	for (item_t *segment : spare_) free_segment(segment);
 }
 
-void consumer_queue::push_sample(const sample_p &sample) {
-	// push a sample, dropping the oldest sample if the queue ist already full.
-	// During this operation the producer becomes a second consumer, i.e., a case
-	// where the underlying spsc queue isn't thread-safe) so the mutex is locked.
-	std::lock_guard<std::mutex> lk(mut_);
-	while (!buffer_.push(sample)) {
-		buffer_.pop();
-	}
-	cv_.notify_one();
+consumer_queue::item_t *consumer_queue::allocate_segment() {
+	auto *segment = new item_t[segment_len_];
+	if (registry_)
+		bind_memory_to_node(segment, segment_len_ * sizeof(item_t), registry_->numa_node());
+	lock_memory(segment, segment_len_ * sizeof(item_t));
+	segments_allocated_.fetch_add(1, std::memory_order_relaxed);
+	return segment;
 }
 
-sample_p consumer_queue::pop_sample(double timeout) {
-	sample_p result;
-	if (timeout <= 0.0) {
-		std::lock_guard<std::mutex> lk(mut_);
-		buffer_.pop(result);
+void consumer_queue::free_segment(item_t *segment) {
+	unlock_memory(segment, segment_len_ * sizeof(item_t));
+	delete[] segment;
+	segments_allocated_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void consumer_queue::enter_segment(std::size_t write_index) {
+	release_segments(write_index);
+	std::atomic<item_t *> &entered = segments_[(write_index % size_) >> segment_shift];
+	if (entered.load(std::memory_order_relaxed)) return;
+	item_t *segment;
+	if (spare_.empty()) {
+		segment = allocate_segment();
+		spare_idle_ = 0;
 	} else {
-		std::unique_lock<std::mutex> lk(mut_);
-		if (!buffer_.pop(result)) {
-			// wait for a new sample until the thread calling push_sample delivers one and sends a
-			// notification, or until timeout
-			std::chrono::duration<double> sec(timeout);
-			cv_.wait_for(lk, sec, [&]{ return this->buffer_.pop(result); });
+		segment = spare_.back();
+		spare_.pop_back();
+	}
+	// the segment is entered at its first slot, so all its slots are free in this round
+	for (std::size_t j = 0; j < segment_len_; ++j)
+		segment[j].seq_state.store(add_wrap(write_index, j), std::memory_order_relaxed);
+	entered.store(segment, std::memory_order_release);
+	// the consumers have kept up for a while, so the occupancy stays low
+	if (++spare_idle_ >= spare_idle_segments) {
+		while (!spare_.empty()) {
+			free_segment(spare_.back());
+			spare_.pop_back();
+		}
+		spare_idle_ = 0;
+	}
+}
+
+void consumer_queue::release_segments(std::size_t write_index) {
+	// consumers only access the slots from the read index up to the write index; the read index
+	// never passes the write index, which only we move
+	const std::size_t read_index = read_idx_.load(std::memory_order_acquire),
+					  used = write_index >= read_index ? write_index - read_index
+													   : write_index + wrap_at_ - read_index,
+					  first = read_index % size_;
+	if (used >= size_) return;
+	released_.clear();
+	for (std::size_t k = 0; k < num_segments(); ++k) {
+		const std::size_t begin = k * segment_slots, end = std::min(begin + segment_slots, size_);
+		if ((begin + size_ - first) % size_ <= used || (first >= begin && first < end)) continue;
+		if (item_t *segment = segments_[k].load(std::memory_order_relaxed)) {
+			segments_[k].store(nullptr, std::memory_order_relaxed);
+			spare_.push_back(segment);
+			released_.push_back(k);
+		}
+	}
+	if (released_.empty()) return;
+	// pairs with the fence in popping_guard: a consumer that was popping already might still
+	// access a released segment with an outdated read index, so they're published again
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (popping_.load(std::memory_order_relaxed)) {
+		const std::size_t kept = spare_.size() - released_.size();
+		for (std::size_t n = 0; n < released_.size(); ++n)
+			segments_[released_[n]].store(spare_[kept + n], std::memory_order_relaxed);
+		spare_.resize(kept);
+	}
+}
+
+bool consumer_queue::try_push(sample_p &sample) {
+	const std::size_t write_index = write_idx_.load(std::memory_order_relaxed);
+	if (!preallocated_ && ((write_index % size_) & (segment_slots - 1)) == 0)
+		enter_segment(write_index);
+	item_t &item = *slot(write_index);
+	// the slot is still occupied (or being read) -> the queue is full
+	if (item.seq_state.load(std::memory_order_acquire) != write_index) return false;
+	// ... or it holds as many samples as it's currently limited to
+	const std::size_t limit = limit_.load(std::memory_order_relaxed);
+	if (limit < size_ && ring_available() >= limit) return false;
+	const std::size_t next_idx = add_wrap(write_index, 1);
+	item.value = std::move(sample);
+	item.seq_state.store(next_idx, std::memory_order_release);
+	write_idx_.store(next_idx, std::memory_order_release);
+	return true;
+}
+
+bool consumer_queue::try_pop(sample_p &result) {
+	std::size_t read_index = read_idx_.load(std::memory_order_acquire);
+	while (true) {
+		item_t *slot_p = slot(read_index);
+		if (!slot_p) {
+			// the producer released the segment after another consumer read it, or it hasn't
+			// reached the segment yet: the queue is empty
+			const std::size_t current = read_idx_.load(std::memory_order_acquire);
+			if (current == read_index) return false;
+			read_index = current;
+			continue;
 		}
+		item_t &item = *slot_p;
+		const std::size_t seq = item.seq_state.load(std::memory_order_acquire),
+						  next_idx = add_wrap(read_index, 1);
+		if (seq == next_idx) {
+			// the slot holds a sample: try to claim it
+			if (read_idx_.compare_exchange_weak(read_index, next_idx, std::memory_order_acq_rel)) {
+				result = std::move(item.value);
+				// mark the slot as free for the next round of the producer
+				item.seq_state.store(add_wrap(read_index, size_), std::memory_order_release);
+				return true;
+			}
+			// otherwise, read_index was updated by the failed CAS
+		} else if (seq == read_index)
+			// the slot hasn't been written yet: the queue is empty
+			return false;
+		else
+			// another consumer claimed the slot first
+			read_index = read_idx_.load(std::memory_order_acquire);
 	}
+}
+
+/// Tell the CPU we're busy-waiting, so it can save power and yield to a sibling hyperthread.
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+template <typename Pred> bool consumer_queue::spin_for_samples(double &timeout, Pred &pred) {
+	const int64_t spin_ns = spin_ns_.load(std::memory_order_relaxed);
+	if (spin_ns <= 0) return false;
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	const int64_t timeout_ns = static_cast<int64_t>(std::min(timeout, 1.0) * 1e9);
+	const auto spin_until = start + std::chrono::nanoseconds(std::min(spin_ns, timeout_ns));
+	do {
+		for (int i = 0; i < 64; ++i) cpu_relax();
+		if (pred()) return true;
+	} while (clock::now() < spin_until);
+	// the remaining time is spent blocking
+	if (timeout < FOREVER)
+		timeout -= std::chrono::duration<double>(clock::now() - start).count();
+	return false;
+}
+
+template <typename Pred, typename Wanted>
+void consumer_queue::wait_for_samples(double timeout, Pred pred, Wanted wanted) {
+	if (spin_for_samples(timeout, pred) || timeout <= 0.0) return;
+	const auto deadline = std::chrono::steady_clock::now() +
+						  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+							  std::chrono::duration<double>(std::min(timeout, FOREVER)));
+	named_unique_lock lk(mut_);
+	waiting_.fetch_add(1, std::memory_order_relaxed);
+	while (true) {
+		// a single consumer is woken up once its samples are there (or the queue is full),
+		// several ones on every push
+		const std::size_t limit = limit_.load(std::memory_order_relaxed);
+		wake_threshold_.store(
+			waiting_.load(std::memory_order_relaxed) == 1 ? std::min<std::size_t>(wanted(), limit)
+														  : 1,
+			std::memory_order_relaxed);
+		// pairs with the fence in notify_waiting()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (pred()) break;
+		if (timeout >= FOREVER)
+			cv_.wait(lk);
+		else if (cv_.wait_until(lk, deadline) == std::cv_status::timeout) {
+			pred();
+			break;
+		}
+	}
+	waiting_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void consumer_queue::set_overflow_policy(lsl_overflow_policy_t policy, double parameter) {
+	block_ns_.store(
+		static_cast<int64_t>(std::max(parameter, 0.0) * 1e9), std::memory_order_relaxed);
+	decimation_.store(static_cast<uint32_t>(std::max(parameter, 2.0)), std::memory_order_relaxed);
+	policy_.store(policy, std::memory_order_relaxed);
+}
+
+static const char *const overflow_policy_names[] = {
+	"drop-oldest", "drop-newest", "block", "decimate", "latest"};
+
+const char *consumer_queue::overflow_policy_name(lsl_overflow_policy_t policy) {
+	return policy >= ovf_drop_oldest && policy <= ovf_latest ? overflow_policy_names[policy]
+														   : overflow_policy_names[0];
+}
+
+lsl_overflow_policy_t consumer_queue::parse_overflow_policy(const std::string &name) {
+	for (int k = ovf_drop_oldest; k <= ovf_latest; ++k)
+		if (name == overflow_policy_names[k]) return static_cast<lsl_overflow_policy_t>(k);
+	return ovf_drop_oldest;
+}
+
+static const char *const priority_names[] = {"bulk", "normal", "latency"};
+
+const char *consumer_queue::priority_name(lsl_transfer_priority_t priority) {
+	return priority >= prio_bulk && priority <= prio_latency ? priority_names[priority]
+															 : priority_names[prio_normal];
+}
+
+lsl_transfer_priority_t consumer_queue::parse_priority(const std::string &name) {
+	for (int k = prio_bulk; k <= prio_latency; ++k)
+		if (name == priority_names[k]) return static_cast<lsl_transfer_priority_t>(k);
+	return prio_normal;
+}
+
+void consumer_queue::push_with_policy(sample_p &sample) {
+	switch (policy_.load(std::memory_order_relaxed)) {
+	case ovf_drop_newest:
+		if (!try_push(sample)) dropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	case ovf_block: {
+		if (try_push(sample)) return;
+		// the send buffer has waited for room already, it mustn't block the other queues
+		if (registry_) break;
+		// make sure the consumer is awake to make room for us; it doesn't signal the producer,
+		// so we poll for room until the timeout expires
+		notify_waiting(true);
+		const auto deadline = std::chrono::steady_clock::now() +
+							  std::chrono::nanoseconds(block_ns_.load(std::memory_order_relaxed));
+		while (std::chrono::steady_clock::now() < deadline) {
+			sleep_precise(50e-6);
+			if (try_push(sample)) return;
+		}
+		break;
+	}
+	case ovf_decimate:
+		// while the consumer is lagging behind, only every k-th sample is kept
+		if (read_available() >= limit_.load(std::memory_order_relaxed) / 2) {
+			if (lagging_pushes_++ % decimation_.load(std::memory_order_relaxed) != 0) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		} else
+			lagging_pushes_ = 0;
+		break;
+	case ovf_latest: {
+		// the consumer only gets the newest sample; a consumer popping concurrently gets
+		// either the replaced sample or the new one
+		sample_p replaced;
+		while (try_pop(replaced)) dropped_.fetch_add(1, std::memory_order_relaxed);
+		break;
+	}
+	default: break;
+	}
+	push_dropping_oldest(sample);
+}
+
+void consumer_queue::push_spilling(sample_p &sample) {
+	// once samples were spilled, the newer ones have to follow them to keep the order
+	if (!spilling_.load(std::memory_order_acquire) && try_push(sample)) return;
+	std::lock_guard<std::mutex> lock(spill_mut_);
+	// only the producer sets spilling_, so if it's not set, the ring buffer is full
+	const bool spilling = spilling_.load(std::memory_order_relaxed);
+	try {
+		if (spill_->append(sample)) {
+			spilled_.fetch_add(1, std::memory_order_relaxed);
+			if (!spilling) spilling_.store(true, std::memory_order_release);
+			return;
+		}
+	} catch (std::exception &e) {
+		discard_spilled(e);
+		return push_dropping_oldest(sample);
+	}
+	// the file is full: the oldest samples are in it, so the newest one is dropped
+	if (spilling)
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+	else
+		push_dropping_oldest(sample);
+}
+
+bool consumer_queue::pop_spilled(sample_p &result) {
+	std::lock_guard<std::mutex> lock(spill_mut_);
+	// the ring buffer's samples are older than the spilled ones
+	if (try_pop(result)) return true;
+	if (!spilling_.load(std::memory_order_relaxed)) return false;
+	try {
+		result = spill_->read();
+	} catch (std::exception &e) {
+		discard_spilled(e);
+		return false;
+	}
+	spilled_.fetch_sub(1, std::memory_order_relaxed);
+	// the producer may use the ring buffer again
+	if (spill_->empty()) spilling_.store(false, std::memory_order_release);
+	return true;
+}
+
+void consumer_queue::discard_spilled(const std::exception &e) {
+	const std::size_t n = spill_->clear();
+	LOG_F(ERROR, "Spilling samples to disk failed, %zu spilled samples are lost: %s", n, e.what());
+	spilled_.fetch_sub(n, std::memory_order_relaxed);
+	dropped_.fetch_add(n, std::memory_order_relaxed);
+	spilling_.store(false, std::memory_order_release);
+}
+
+void consumer_queue::set_capacity_limit(std::size_t max_capacity) {
+	const std::size_t limit = std::min(std::max(max_capacity, min_capacity), size_);
+	limit_.store(limit, std::memory_order_relaxed);
+	popping_guard guard(*this);
+	sample_p dropped;
+	while (ring_available() > limit && try_pop(dropped))
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void consumer_queue::push_samples(const sample_p *samples, std::size_t n) {
+	bool sentinel = false;
+	for (std::size_t k = 0; k < n; ++k) {
+		sample_p copy(samples[k]);
+		push_without_notify(copy);
+		if (!samples[k]) sentinel = true;
+	}
+	notify_waiting(sentinel);
+}
+
+void consumer_queue::push_samples_adopting(const sample_p *samples, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) {
+		sample_p adopted(samples[k].get(), false);
+		push_without_notify(adopted);
+	}
+	notify_waiting();
+}
+
+sample_p consumer_queue::pop_sample(double timeout) {
+	sample_p result;
+	// wait for a new sample until the thread calling push_sample delivers one and sends a
+	// notification, or until timeout
+	auto pop = [&] {
+		popping_guard guard(*this);
+		return pop_one(result) || take_wakeup();
+	};
+	if (!pop() && timeout > 0.0) wait_for_samples(timeout, pop, [] { return 1; });
 	return result;
 }
 
+std::size_t consumer_queue::pop_samples(
+	sample_p *out, std::size_t max_samples, double timeout, std::size_t min_samples) {
+	std::size_t n = 0;
+	const std::size_t needed = min_samples ? std::min(min_samples, max_samples) : max_samples;
+	// an empty sample is pushed as a sentinel when the stream is lost, so we stop waiting there
+	auto done = [&]() {
+		popping_guard guard(*this);
+		while (n < max_samples && (n == 0 || out[n - 1]) && pop_one(out[n])) n++;
+		return n >= needed || (n && !out[n - 1]) || take_wakeup();
+	};
+	if (!done() && timeout > 0.0) wait_for_samples(timeout, done, [&] { return needed - n; });
+	return n;
+}
+
+bool consumer_queue::arm_notification(std::size_t min_samples) {
+	notify_armed_.store(true, std::memory_order_release);
+	// pairs with the fence in notify_waiting(): either the producer sees the armed flag or we
+	// see its samples
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (read_available() < min_samples && !wakeup_.load(std::memory_order_relaxed))
+		return true;
+	// samples arrived in the meantime; if the producer hasn't taken the notification yet, disarm
+	// it so the caller can handle the samples right away
+	return !notify_armed_.exchange(false, std::memory_order_acq_rel);
+}
+
 uint32_t consumer_queue::flush() noexcept {
-	std::lock_guard<std::mutex> lk(mut_);
 	uint32_t n = 0;
-	while (buffer_.pop()) n++;
+	sample_p dummy;
+	popping_guard guard(*this);
+	while (pop_one(dummy)) n++;
 	return n;
 }
-
-bool consumer_queue::empty() { return buffer_.empty(); }
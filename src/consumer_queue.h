@@ -3,19 +3,40 @@
 
 #include "common.h"
 #include "forward.h"
-#include <boost/lockfree/spsc_queue.hpp>
+#include "lock_stats.h"
+#include "sample.h"
+#include "spill_file.h"
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace lsl {
+
 /**
  * A thread-safe producer-consumer queue of unread samples.
  *
- * Erases the oldest samples if max capacity is exceeded. Implemented as a circular buffer.
+ * Erases the oldest samples if max capacity is exceeded. Implemented as a lock-free circular
+ * buffer of sequence-numbered slots (one producer, any number of consumers). If the buffer is
+ * full, the producer drops the oldest sample by acting as an additional consumer.
+ * The mutex and condition variable are only used when a consumer is blocked waiting for samples.
+ *
+ * The capacity is a bound rather than an allocation: the slots are allocated in segments once
+ * the producer reaches them, and the segments the consumers have read are reused for the next
+ * ones. Spare segments that weren't needed for a while are freed, so a queue whose consumer keeps
+ * up holds a few segments however large its capacity is.
+ *
+ * If the registry spills to disk (see send_buffer::enable_spill()), the drop-oldest policy
+ * appends the samples to a spill_file instead once the buffer is full. All later samples follow
+ * them until the consumers have read the file, and only once the file has reached its size limit
+ * the newest samples are dropped.
+ * @note There must only be a single thread pushing samples at any time.
  */
 class consumer_queue {
-	using buffer_type = lslboost::lockfree::spsc_queue<sample_p>;
-
 public:
 	/**
 	 * Create a new queue with a given capacity.
@@ -23,14 +44,54 @@ public:
 	 * the oldest samples are dropped.
 	 * @param registry Optionally a pointer to a registration facility, for multiple-reader
 	 * arrangements.
+	 * @param replay_from The sequence number of the first sample in the registry's history that
+	 * should be queued (0 for none, see send_buffer::new_consumer()).
+	 * @param spill Optionally a file the samples are spilled to once the queue is full.
+	 * @param priority The queue's priority class; the registry pushes new samples to the queues
+	 * of higher classes first.
+	 * @param preallocate Allocate all slots right away and keep them, so pushing never allocates
+	 * memory (see stream_config::no_allocation).
 	 */
-	consumer_queue(std::size_t max_capacity, send_buffer_p registry = send_buffer_p());
+	consumer_queue(std::size_t max_capacity, send_buffer_p registry = send_buffer_p(),
+		uint64_t replay_from = 0, std::unique_ptr<spill_file> spill = nullptr,
+		lsl_transfer_priority_t priority = prio_normal, bool preallocate = false);
+
+	/// The smallest capacity of a queue; the sequence numbers can't tell a full slot of a
+	/// single-slot ring buffer from a free one
+	static constexpr std::size_t min_capacity = 2;
 
 	/// Destructor. Unregisters from the send buffer, if any.
 	~consumer_queue();
 
 	///  Push a new sample onto the queue.
-	void push_sample(const sample_p &sample);
+	void push_sample(const sample_p &sample) {
+		sample_p copy(sample);
+		push_without_notify(copy);
+		notify_waiting(!sample);
+	}
+
+	/// Push n samples onto the queue with a single wakeup.
+	void push_samples(const sample_p *samples, std::size_t n);
+
+	/**
+	 * Wake up the consumer without pushing anything, e.g. so it sends something else.
+	 *
+	 * The next pop that finds no sample returns an empty one (or pop_samples() returns early), as
+	 * for an empty sample that was pushed, but the overflow policy isn't applied, so no sample is
+	 * dropped or waited for. Wakeups that weren't taken yet are merged.
+	 */
+	void wake() {
+		wakeup_.store(true, std::memory_order_relaxed);
+		notify_waiting(true);
+	}
+
+	/**
+	 * Push n (non-empty) samples, adopting a reference to each one that the caller added for
+	 * this queue beforehand, see sample::add_refs().
+	 *
+	 * This saves the atomic reference count increments when a sample is pushed to many queues.
+	 */
+	void push_samples_adopting(const sample_p *samples, std::size_t n);
 
 	/**
 	 * Pop a sample from the queue.
@@ -39,23 +100,355 @@ public:
 	 */
 	sample_p pop_sample(double timeout = FOREVER);
 
-	/// Number of available samples
-	std::size_t read_available() const { return buffer_.read_available(); }
+	/**
+	 * Pop up to max_samples samples from the queue into a caller-provided array.
+	 *
+	 * @param out Array with room for at least max_samples sample pointers.
+	 * @param max_samples The maximum number of samples to pop.
+	 * @param timeout If greater than zero, block until max_samples samples were popped, an empty
+	 * sentinel sample was received or the timeout (in seconds) has expired. Otherwise, only the
+	 * samples that are immediately available are returned.
+	 * @param min_samples If nonzero, stop blocking once this many samples were popped (and pop
+	 * the others that are available, up to max_samples). The consumer is only woken up once
+	 * enough samples are there, e.g. once per window of a windowed processing.
+	 * @return The number of samples written to out. The last one may be an empty sentinel.
+	 */
+	std::size_t pop_samples(
+		sample_p *out, std::size_t max_samples, double timeout = 0.0, std::size_t min_samples = 0);
+
+	/// Number of available samples, including the spilled ones. This value may be inaccurate.
+	std::size_t read_available() const {
+		return ring_available() + spilled_.load(std::memory_order_relaxed);
+	}
 
 	/// Flush the queue, return the number of dropped samples
 	uint32_t flush() noexcept;
 
-	/// Check whether the buffer is empty.
-	bool empty();
+	/// Check whether the buffer is empty. This value may be inaccurate.
+	bool empty() const { return read_available() == 0; }
+
+	/// The number of slots of the queue, i.e., the most samples it can ever hold.
+	std::size_t capacity() const { return size_; }
+
+	/// The number of samples the queue currently holds at most, see set_capacity_limit().
+	std::size_t capacity_limit() const { return limit_.load(std::memory_order_relaxed); }
+
+	/**
+	 * Change the number of samples the queue holds at most, without reallocating it.
+	 *
+	 * This can be called while samples are pushed and popped, e.g. when a consumer asks for a
+	 * different buffer length on a live connection. The limit is clamped to
+	 * [min_capacity, capacity()]; if the queue currently holds more samples, the oldest ones are
+	 * dropped.
+	 */
+	void set_capacity_limit(std::size_t max_capacity);
+
+	/// The priority class of the queue's consumer.
+	lsl_transfer_priority_t priority() const { return priority_; }
+
+	/// The name of a priority class in the feed parameters (e.g. "latency").
+	static const char *priority_name(lsl_transfer_priority_t priority);
+
+	/// Parse a priority class name, returns prio_normal for unknown names.
+	static lsl_transfer_priority_t parse_priority(const std::string &name);
+
+	/// The memory of the queue's allocated slots, in bytes (the samples are held by their factory).
+	std::size_t memory_bytes() const {
+		return segments_allocated_.load(std::memory_order_relaxed) * segment_len_ *
+				   sizeof(item_t) +
+			   num_segments() * sizeof(std::atomic<item_t *>);
+	}
+
+	/// Number of samples that are currently spilled to disk.
+	std::size_t spilled() const { return spilled_.load(std::memory_order_relaxed); }
+
+	/// Number of samples that were dropped because the queue was full.
+	uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+	/**
+	 * Set how long a consumer spins, waiting for samples, before it blocks.
+	 *
+	 * Spinning avoids the latency of waking up a blocked thread at the cost of a busy CPU core.
+	 * @param seconds The maximum spin time, 0 to block right away.
+	 */
+	void set_spin_time(double seconds) {
+		spin_ns_.store(
+			static_cast<int64_t>(std::max(seconds, 0.0) * 1e9), std::memory_order_relaxed);
+	}
+
+	/**
+	 * Set what the producer does if the queue is full.
+	 * @param policy The overflow policy.
+	 * @param parameter For ovf_block, the maximum time (in seconds) the producer waits for room;
+	 * afterwards the oldest sample is dropped. For ovf_decimate, the decimation factor (at
+	 * least 2). Ignored otherwise.
+	 */
+	void set_overflow_policy(lsl_overflow_policy_t policy, double parameter = 0.0);
+
+	/**
+	 * How long the producer may wait for room for n more samples (in nanoseconds), 0 if they
+	 * fit or the queue doesn't block its producer (see ovf_block).
+	 *
+	 * The consumer of a full queue is woken up, so it makes room. The send buffer waits before it
+	 * pushes, without holding its locks (see send_buffer::wait_for_room()).
+	 */
+	int64_t room_wait_ns(std::size_t n) {
+		if (policy_.load(std::memory_order_relaxed) != ovf_block) return 0;
+		const std::size_t limit = std::min(limit_.load(std::memory_order_relaxed), size_);
+		if (ring_available() + n <= limit) return 0;
+		notify_waiting(true);
+		return block_ns_.load(std::memory_order_relaxed);
+	}
+
+	/// The name of an overflow policy in the feed parameters (e.g. "drop-oldest").
+	static const char *overflow_policy_name(lsl_overflow_policy_t policy);
+
+	/// Parse an overflow policy name, returns ovf_drop_oldest for unknown names.
+	static lsl_overflow_policy_t parse_overflow_policy(const std::string &name);
+
+	/// The buffer length to request for a queue with a policy (see send_buffer::new_consumer()):
+	/// ovf_latest only needs room for the newest sample.
+	static int policy_capacity(lsl_overflow_policy_t policy, int max_buffered) {
+		return policy == ovf_latest ? static_cast<int>(min_capacity) : max_buffered;
+	}
+
+	/**
+	 * Set a function that is called by the pushing thread after arm_notification().
+	 *
+	 * This allows consumers to get notified about new samples without blocking a thread.
+	 * Must not be called while a notification is armed.
+	 */
+	void set_notification(std::function<void()> callback) { on_push_ = std::move(callback); }
+
+	/**
+	 * Request a single call of the notification callback once the next sample(s) are pushed.
+	 * @param min_samples The number of available samples the caller is waiting for.
+	 * @return false if at least min_samples samples were already available, so the caller should
+	 * pop them instead of waiting for the notification (which won't be sent).
+	 */
+	bool arm_notification(std::size_t min_samples = 1);
 
 	consumer_queue(const consumer_queue&) = delete;
 	consumer_queue& operator=(const consumer_queue&) = delete;
 
 private:
+	/// a slot in the ring buffer
+	struct item_t {
+		/// sequence number: equal to the write index when the slot is free and to write index+1
+		/// when the slot holds a sample
+		std::atomic<std::size_t> seq_state;
+		sample_p value;
+	};
+
+	/// The number of slots per segment is 2^segment_shift (fewer if the queue is smaller).
+	static constexpr std::size_t segment_shift = 10,
+								 segment_slots = std::size_t(1) << segment_shift;
+	/// The spare segments are freed once this many segments were entered without allocating one.
+	static constexpr uint32_t spare_idle_segments = 64;
+
+	/// The number of segments the slots are divided into.
+	std::size_t num_segments() const { return (size_ + segment_slots - 1) >> segment_shift; }
+
+	/// The slot of an index, or nullptr if its segment isn't allocated (yet).
+	item_t *slot(std::size_t index) const {
+		const std::size_t i = index % size_;
+		item_t *segment = segments_[i >> segment_shift].load(std::memory_order_acquire);
+		return segment ? segment + (i & (segment_slots - 1)) : nullptr;
+	}
+
+	/// Allocate a segment (on the registry's NUMA node).
+	item_t *allocate_segment();
+
+	/// Free a segment that's no longer published.
+	void free_segment(item_t *segment);
+
+	/// Make sure the segment that starts at the producer's write index is allocated, and reuse
+	/// the segments that were read.
+	void enter_segment(std::size_t write_index);
+
+	/// Unpublish the segments outside the slots from the read index to the write index and add
+	/// them to the spare ones, unless a consumer is popping (it might use an outdated read index).
+	void release_segments(std::size_t write_index);
+
+	/// Marks a consumer's access to the slots, so the producer doesn't release their segments.
+	class popping_guard {
+	public:
+		explicit popping_guard(consumer_queue &q)
+			: popping_(q.preallocated_ ? nullptr : &q.popping_) {
+			if (!popping_) return;
+			popping_->fetch_add(1, std::memory_order_relaxed);
+			// pairs with the fence in release_segments(): either the producer sees this consumer
+			// or the consumer sees the unpublished segments
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+		~popping_guard() {
+			if (popping_) popping_->fetch_sub(1, std::memory_order_release);
+		}
+		popping_guard(const popping_guard &) = delete;
+		popping_guard &operator=(const popping_guard &) = delete;
+
+	private:
+		std::atomic<uint32_t> *popping_;
+	};
+
+	/// Try to push a sample (moving it into the queue), returns false if the queue is full.
+	bool try_push(sample_p &sample);
+
+	/// Push a sample, dropping one if necessary, without waking up consumers.
+	/// The sample is moved into the queue (or released, if it's dropped).
+	void push_without_notify(sample_p &sample) {
+		if (policy_.load(std::memory_order_relaxed) != ovf_drop_oldest)
+			push_with_policy(sample);
+		else if (spill_)
+			push_spilling(sample);
+		else
+			push_dropping_oldest(sample);
+	}
+
+	/// Push a sample, dropping the oldest one if the queue is full.
+	void push_dropping_oldest(sample_p &sample) {
+		while (!try_push(sample)) {
+			sample_p dummy;
+			if (try_pop(dummy)) dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/// Push a sample, handling a full queue according to the overflow policy.
+	void push_with_policy(sample_p &sample);
+
+	/// Push a sample, spilling it to disk if the queue is full or samples are spilled already.
+	void push_spilling(sample_p &sample);
+
+	/// Try to pop a sample from the ring buffer, returns false if it's empty.
+	bool try_pop(sample_p &result);
+
+	/// Try to pop a sample from the ring buffer or else the spill file.
+	bool pop_one(sample_p &result) {
+		return try_pop(result) ||
+			   (spilling_.load(std::memory_order_acquire) && pop_spilled(result));
+	}
+
+	/// Try to pop a sample from the spill file (or the ring buffer, if it has older samples).
+	bool pop_spilled(sample_p &result);
+
+	/// Take a wakeup (see wake()), returns false if there's none.
+	bool take_wakeup() {
+		return wakeup_.load(std::memory_order_relaxed) &&
+			   wakeup_.exchange(false, std::memory_order_acquire);
+	}
+
+	/// Discard the spilled samples after an I/O error; spill_mut_ must be held.
+	void discard_spilled(const std::exception &e);
+
+	/**
+	 * Wake up a blocked consumer, if any, once the samples it waits for are available.
+	 * @param force Wake it up regardless, e.g. for a sentinel or to make room in a full queue.
+	 */
+	void notify_waiting(bool force = false) {
+		// pairs with the fence in wait_for_samples(): either we see the waiting consumer (and its
+		// wake-up threshold) or the consumer sees the new sample
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting_.load(std::memory_order_relaxed) &&
+			(force || read_available() >= wake_threshold_.load(std::memory_order_relaxed))) {
+			std::lock_guard<named_mutex> lk(mut_);
+			cv_.notify_one();
+		}
+		if (notify_armed_.load(std::memory_order_relaxed) &&
+			notify_armed_.exchange(false, std::memory_order_acquire))
+			on_push_();
+	}
+
+	/**
+	 * Block until pred() returns true or the timeout expires.
+	 * @param wanted Returns how many more samples pred() needs, so a single waiting consumer
+	 * isn't woken up before they're available.
+	 */
+	template <typename Pred, typename Wanted>
+	void wait_for_samples(double timeout, Pred pred, Wanted wanted);
+
+	/// Spin until pred() returns true or the spin time / timeout expires, return pred()'s result.
+	template <typename Pred> bool spin_for_samples(double &timeout, Pred &pred);
+
+	/// Number of samples in the ring buffer (without the spilled ones). May be inaccurate.
+	std::size_t ring_available() const {
+		std::size_t write_index = write_idx_.load(std::memory_order_acquire),
+					read_index = read_idx_.load(std::memory_order_acquire);
+		return write_index >= read_index ? write_index - read_index
+										 : write_index + wrap_at_ - read_index;
+	}
+
+	/// Increment an index, wrapping around at a multiple of the queue size.
+	std::size_t add_wrap(std::size_t x, std::size_t delta) const {
+		const std::size_t xp = x + delta;
+		return xp >= wrap_at_ ? xp - wrap_at_ : xp;
+	}
+
 	send_buffer_p registry_; // optional consumer registry
-	buffer_type buffer_;	 // the sample buffer
-	std::mutex mut_;			 // mutex for cond var (also to protect queue at buffer overflow)
-	std::condition_variable cv_; // to allow for blocking wait by consumer
+	/// number of slots in the ring buffer
+	const std::size_t size_;
+	/// number of slots per segment
+	const std::size_t segment_len_;
+	/// whether all segments are allocated up front and never released
+	const bool preallocated_;
+	/// the segments of the ring buffer, null until the producer first reaches them and after
+	/// they were released (see slot())
+	std::unique_ptr<std::atomic<item_t *>[]> segments_;
+	/// the number of allocated segments, including the spare ones
+	std::atomic<std::size_t> segments_allocated_{0};
+	/// released segments, reused for the next ones (only used by the producer)
+	std::vector<item_t *> spare_;
+	/// the indices of the segments released by release_segments() (only used by the producer)
+	std::vector<std::size_t> released_;
+	/// the number of segments entered since a spare one was last needed (only used by the producer)
+	uint32_t spare_idle_{0};
+	/// the priority class of the consumer
+	const lsl_transfer_priority_t priority_;
+	/// indices wrap around at this value (a multiple of size_)
+	const std::size_t wrap_at_;
+	/// index of the next slot to be written (only modified by the producer)
+	std::atomic<std::size_t> write_idx_{0};
+	/// the number of samples the producer fills the ring buffer up to (at most size_)
+	std::atomic<std::size_t> limit_;
+	char pad_write_[CACHELINE_BYTES - 2 * sizeof(std::atomic<std::size_t>)];
+	/// index of the next slot to be read
+	std::atomic<std::size_t> read_idx_{0};
+	/// number of consumers accessing the slots (see popping_guard)
+	std::atomic<uint32_t> popping_{0};
+	char pad_read_[CACHELINE_BYTES - sizeof(std::atomic<std::size_t>) -
+				   sizeof(std::atomic<uint32_t>)];
+	/// number of consumers blocked in pop_sample()/pop_samples()
+	std::atomic<uint32_t> waiting_{0};
+	/// the producer only wakes up the blocked consumers once this many samples are available
+	/// (protected by mut_ for writing)
+	std::atomic<std::size_t> wake_threshold_{1};
+	named_mutex mut_{"consumer_queue"}; // mutex for cond var
+	named_condition_variable cv_; // to allow for blocking wait by consumer
+	/// whether on_push_ should be called by the next push
+	std::atomic<bool> notify_armed_{false};
+	/// whether the consumer was woken up without a sample (see wake())
+	std::atomic<bool> wakeup_{false};
+	/// callback for non-blocking consumers, see arm_notification()
+	std::function<void()> on_push_;
+	/// number of samples dropped by the producer (or lost with the spill file)
+	std::atomic<uint64_t> dropped_{0};
+	/// how long consumers spin before blocking, in nanoseconds
+	std::atomic<int64_t> spin_ns_{0};
+	/// what the producer does if the queue is full
+	std::atomic<lsl_overflow_policy_t> policy_{ovf_drop_oldest};
+	/// how long the producer waits for room with ovf_block, in nanoseconds
+	std::atomic<int64_t> block_ns_{0};
+	/// keep every decimation_-th sample with ovf_decimate
+	std::atomic<uint32_t> decimation_{2};
+	/// number of samples pushed since the queue started lagging (only used by the producer)
+	uint32_t lagging_pushes_{0};
+	/// the samples that didn't fit into the ring buffer, protected by spill_mut_ (optional)
+	std::unique_ptr<spill_file> spill_;
+	std::mutex spill_mut_;
+	/// whether the spill file holds samples, so newer samples go there, too (only set by the
+	/// producer and cleared by the consumer that empties the file, with spill_mut_ held)
+	std::atomic<bool> spilling_{false};
+	/// number of samples in the spill file
+	std::atomic<std::size_t> spilled_{0};
 };
 
 } // namespace lsl
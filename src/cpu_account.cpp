@@ -0,0 +1,91 @@
+#include "cpu_account.h"
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+using namespace lsl;
+
+/// The CPU clock of a thread, readable from other threads.
+struct cpu_account::thread_clock {
+#ifdef _WIN32
+	HANDLE thread{nullptr};
+
+	thread_clock() {
+		DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread,
+			THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0);
+	}
+	~thread_clock() {
+		if (thread) CloseHandle(thread);
+	}
+	double read() const {
+		FILETIME creation, exit, kernel, user;
+		if (!thread || !GetThreadTimes(thread, &creation, &exit, &kernel, &user)) return 0.0;
+		auto ticks = [](const FILETIME &t) {
+			return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+		};
+		// FILETIMEs count 100 ns ticks
+		return static_cast<double>(ticks(kernel) + ticks(user)) * 1e-7;
+	}
+#elif defined(__APPLE__)
+	mach_port_t thread{mach_thread_self()};
+
+	~thread_clock() { mach_port_deallocate(mach_task_self(), thread); }
+	double read() const {
+		thread_basic_info_data_t info;
+		mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+		if (thread_info(thread, THREAD_BASIC_INFO, reinterpret_cast<thread_info_t>(&info),
+				&count) != KERN_SUCCESS)
+			return 0.0;
+		return info.user_time.seconds + info.system_time.seconds +
+			   (info.user_time.microseconds + info.system_time.microseconds) * 1e-6;
+	}
+#else
+	clockid_t clock{CLOCK_THREAD_CPUTIME_ID};
+	bool valid{pthread_getcpuclockid(pthread_self(), &clock) == 0};
+
+	double read() const {
+		timespec ts;
+		if (!valid || clock_gettime(clock, &ts)) return 0.0;
+		return static_cast<double>(ts.tv_sec) + ts.tv_nsec * 1e-9;
+	}
+#endif
+	/// the thread's CPU time when it was attached (a thread starter's pool may reuse threads)
+	double start{read()};
+};
+
+cpu_account::scope::~scope() {
+	if (account_) account_->detach(clock_);
+}
+
+cpu_account::scope cpu_account::attach() {
+	auto clock = std::make_shared<thread_clock>();
+	std::lock_guard<std::mutex> lock(mut_);
+	threads_.push_back(clock);
+	return scope(shared_from_this(), std::move(clock));
+}
+
+void cpu_account::detach(const std::shared_ptr<thread_clock> &clock) {
+	// read by the thread itself, the clock may become invalid once the thread has exited
+	const double used = clock->read() - clock->start;
+	std::lock_guard<std::mutex> lock(mut_);
+	threads_.erase(std::remove(threads_.begin(), threads_.end(), clock), threads_.end());
+	detached_seconds_ += std::max(used, 0.0);
+}
+
+double cpu_account::seconds() {
+	std::lock_guard<std::mutex> lock(mut_);
+	double result = detached_seconds_;
+	for (const auto &clock : threads_) result += std::max(clock->read() - clock->start, 0.0);
+	return result;
+}
+
+double cpu_account::this_thread_seconds() { return thread_clock().read(); }
@@ -0,0 +1,64 @@
+#ifndef CPU_ACCOUNT_H
+#define CPU_ACCOUNT_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * The CPU time of the threads that work for a stream, e.g. an inlet's receive thread or the
+ * transfer threads of an outlet's connections.
+ *
+ * A thread is counted from its attach() until the returned scope is destroyed. The attached
+ * threads' clocks (`CLOCK_THREAD_CPUTIME_ID`, `GetThreadTimes()`) are only read by seconds(),
+ * so the threads themselves don't pay anything for the accounting.
+ */
+class cpu_account : public std::enable_shared_from_this<cpu_account> {
+	struct thread_clock;
+
+public:
+	/// Counts the CPU time of the thread that created it, see attach().
+	class scope {
+	public:
+		scope(scope &&) noexcept = default;
+		scope(const scope &) = delete;
+		scope &operator=(const scope &) = delete;
+		/// Add the thread's CPU time so far to the account's total.
+		~scope();
+
+	private:
+		friend class cpu_account;
+		scope(std::shared_ptr<cpu_account> account, std::shared_ptr<thread_clock> clock)
+			: account_(std::move(account)), clock_(std::move(clock)) {}
+
+		std::shared_ptr<cpu_account> account_;
+		std::shared_ptr<thread_clock> clock_;
+	};
+
+	/// Count the CPU time of the calling thread until the scope is destroyed.
+	scope attach();
+
+	/// The CPU time (in seconds) of the detached threads and the attached threads so far.
+	double seconds();
+
+	/// The CPU time (in seconds) the calling thread has used so far, 0 if it's not available.
+	static double this_thread_seconds();
+
+private:
+	void detach(const std::shared_ptr<thread_clock> &clock);
+
+	/// protects the members below
+	std::mutex mut_;
+	/// the clocks of the attached threads
+	std::vector<std::shared_ptr<thread_clock>> threads_;
+	/// the CPU time of the detached threads
+	double detached_seconds_{0.0};
+};
+
+using cpu_account_p = std::shared_ptr<cpu_account>;
+
+} // namespace lsl
+
+#endif
@@ -1,44 +1,122 @@
 #include "data_receiver.h"
+#include "alloc_guard.h"
 #include "api_config.h"
+#include "async_log.h"
+#include "bundle.h"
+#include "calibration.h"
 #include "cancellable_streambuf.h"
+#include "datagram_sender.h"
 #include "inlet_connection.h"
+#include "local_feed.h"
+#include "rdma_transport.h"
+#include "resampler.h"
 #include "sample.h"
+#include "sample_frame.h"
+#include "send_buffer.h"
+#include "shm_transport.h"
 #include "socket_utils.h"
+#include "thread_policy.h"
+#include "tracing.h"
 #include "util/cast.hpp"
+#include <algorithm>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <loguru.hpp>
 #include <memory>
+#include <numeric>
 #include <sstream>
+#include <vector>
 
 // a convention that applies when including portable_oarchive.h in multiple .cpp files.
 // otherwise, the templates are instantiated in this file and sample.cpp which leads
 // to errors like "multiple definition of `typeinfo name"
+#ifndef LSL_NO_PROTOCOL_100
 #define NO_EXPLICIT_TEMPLATE_INSTANTIATION
 #include "portable_archive/portable_iarchive.hpp"
+#endif
 
 namespace lsl {
 
-data_receiver::data_receiver(inlet_connection &conn, int max_buflen, int max_chunklen)
-	: conn_(conn),
+/// maximum number of already received samples that are decoded and queued at once
+const std::size_t max_batch_samples = 64;
+/// the initial and maximum delay (in seconds) before reconnecting after an error
+const double min_reconnect_delay = 0.005, max_reconnect_delay = 0.5;
+/// the number of samples that are transposed at once by planar chunk pulls
+const std::size_t planar_block_samples = 16;
+/// the multicast datagrams are awaited in slices of this length, so a closed inlet stops waiting
+const std::chrono::milliseconds multicast_poll_interval(100);
+/// the time (in seconds) without datagrams after which the multicast feed is deemed broken
+const double multicast_timeout = 4 * datagram_sender::heartbeat_interval;
+/// how often (in seconds) an idle in-process feed checks whether its outlet still exists
+const double local_poll_interval = 0.1;
+
+/// Read a little endian value, return false at the end of the data.
+template <typename T> static bool read_le(std::streambuf &sb, T &value) {
+	if (sb.sgetn(reinterpret_cast<char *>(&value), sizeof(value)) != sizeof(value)) return false;
+	lslboost::endian::little_to_native_inplace(value);
+	return true;
+}
+
+data_receiver::data_receiver(
+	inlet_connection &conn, int max_buflen, int max_chunklen, stream_config_p config)
+	: conn_(conn), config_(config ? std::move(config) : stream_config::current()),
 	  sample_factory_(
-		  new factory(conn.type_info().channel_format(), conn.type_info().channel_count(),
-			  conn.type_info().nominal_srate()
+		  factory::for_stream(conn.type_info().channel_format(), conn.type_info().channel_count(),
+			  // the pool holds the queued samples and the batches being decoded and pulled
+			  config_->no_allocation
+				  ? std::max(max_buflen, 0) + 2 * static_cast<int>(max_batch_samples)
+			  : conn.type_info().nominal_srate()
 				  ? static_cast<int>(conn.type_info().nominal_srate() *
 									 api_config::get_instance()->inlet_buffer_reserve_ms() / 1000)
-				  : api_config::get_instance()->inlet_buffer_reserve_samples())),
+				  : api_config::get_instance()->inlet_buffer_reserve_samples(),
+			  config_->no_allocation)),
 	  check_thread_start_(true), closing_stream_(false), connected_(false),
-	  sample_queue_(max_buflen), max_buflen_(max_buflen), max_chunklen_(max_chunklen) {
+	  sample_queue_(max_buflen, nullptr, 0, nullptr, prio_normal, config_->no_allocation),
+	  max_buflen_(max_buflen), max_chunklen_(max_chunklen) {
 	if (max_buflen < 0)
 		throw std::invalid_argument("The max_buflen argument must not be smaller than 0.");
 	if (max_chunklen < 0)
 		throw std::invalid_argument("The max_chunklen argument must not be smaller than 0.");
+	if (config_->no_allocation) {
+		sample_factory_->report_growth();
+		if (conn.type_info().channel_format() == cft_string)
+			LOG_F(WARNING, "%s: The strings of string streams are allocated when they're received",
+				conn.type_info().name().c_str());
+	}
 	conn_.register_onlost(this, &connected_upd_);
+	sample_queue_.set_spin_time(api_config::get_instance()->pull_spin_time());
+	multicast_ = api_config::get_instance()->multicast_data();
+	datagrams_ = api_config::get_instance()->datagram_data();
+	rdma_ = api_config::get_instance()->rdma_data();
+	shared_memory_ = api_config::get_instance()->shared_memory_data();
+	in_process_ = api_config::get_instance()->in_process_data();
+	bundling_ = api_config::get_instance()->bundle_data();
+	sample_queue_.set_notification([this]() {
+		{
+			std::lock_guard<std::mutex> lock(notification_mut_);
+			if (notification_) notification_();
+		}
+		check_waits();
+	});
 }
 
 data_receiver::~data_receiver() {
 	try {
 		conn_.unregister_onlost(this);
 		if (data_thread_.joinable()) data_thread_.join();
+		// the remaining handlers' samples will never arrive
+		decltype(waits_) waits;
+		{
+			std::lock_guard<std::mutex> lock(notification_mut_);
+			waits.swap(waits_);
+		}
+		for (auto &wait : waits) wait.second(true);
 	} catch (std::exception &e) {
 		LOG_F(ERROR, "Unexpected error during destruction of a data_receiver: %s", e.what());
 	} catch (...) { LOG_F(ERROR, "Severe error during data receiver shutdown."); }
@@ -54,7 +132,7 @@ void data_receiver::open_stream(double timeout) {
 	if (!connection_completed()) {
 		// start thread if not yet running
 		if (check_thread_start_ && !data_thread_.joinable()) {
-			data_thread_ = std::thread(&data_receiver::data_thread, this);
+			spawn_data_thread();
 			check_thread_start_ = false;
 		}
 		// wait until the connection attempt completes (or we time out)
@@ -69,37 +147,190 @@ void data_receiver::open_stream(double timeout) {
 						 "re-resolve the source and re-create the inlet.");
 }
 
+void data_receiver::begin_open() {
+	closing_stream_ = false;
+	start_thread();
+}
+
+void data_receiver::start_thread() {
+	std::lock_guard<std::mutex> lock(connected_mut_);
+	if (check_thread_start_ && !data_thread_.joinable()) {
+		spawn_data_thread();
+		check_thread_start_ = false;
+	}
+}
+
+void data_receiver::set_notification(std::function<void()> callback) {
+	std::lock_guard<std::mutex> lock(notification_mut_);
+	notification_ = std::move(callback);
+}
+
+void data_receiver::async_wait(std::size_t min_samples, wait_handler handler) {
+	start_thread();
+	{
+		std::lock_guard<std::mutex> lock(notification_mut_);
+		waits_.emplace_back(std::max<std::size_t>(min_samples, 1), std::move(handler));
+	}
+	check_waits();
+}
+
+void data_receiver::check_waits() {
+	std::vector<std::pair<bool, wait_handler>> ready;
+	{
+		std::lock_guard<std::mutex> lock(notification_mut_);
+		if (waits_.empty()) return;
+		while (true) {
+			const std::size_t available = sample_queue_.read_available();
+			const bool lost = conn_.lost();
+			std::size_t min_wanted = std::numeric_limits<std::size_t>::max();
+			for (auto it = waits_.begin(); it != waits_.end();) {
+				if (available >= it->first || lost) {
+					ready.emplace_back(lost && available < it->first, std::move(it->second));
+					it = waits_.erase(it);
+				} else {
+					min_wanted = std::min(min_wanted, it->first);
+					++it;
+				}
+			}
+			// if the samples arrived while arming, check again instead of waiting
+			if (waits_.empty() || sample_queue_.arm_notification(min_wanted)) break;
+		}
+	}
+	for (auto &handler : ready) {
+		try {
+			handler.second(handler.first);
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Uncaught exception in an async_wait() handler: %s", e.what());
+		}
+	}
+}
+
+void data_receiver::set_sample_callback(sample_callback callback) {
+	sample_callback_.set(std::move(callback));
+	if (sample_callback_.is_set()) start_thread();
+}
+
+void data_receiver::set_raw_chunk_callback(raw_chunk_callback callback) {
+	raw_chunk_callback_.set(std::move(callback));
+	if (raw_chunk_callback_.is_set()) start_thread();
+}
+
+void data_receiver::set_timestamp_processor(timestamp_processor processor) {
+	std::lock_guard<std::mutex> lock(timestamp_processor_mut_);
+	has_timestamp_processor_ = static_cast<bool>(processor);
+	timestamp_processor_ = std::move(processor);
+}
+
+void data_receiver::deliver_samples(const sample_p *samples, std::size_t n) {
+	if (sample_callback_.is_set()) {
+		try {
+			if (sample_callback_.call(samples, n)) return;
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Uncaught exception in the sample callback of %s: %s",
+				conn_.type_info().name().c_str(), e.what());
+			return;
+		}
+	}
+	if (raw_chunk_callback_.is_set()) {
+		// copy the values into a block
+		const std::size_t sample_bytes = n ? samples[0]->datasize() : 0;
+		raw_block_.resize(n * sample_bytes);
+		processed_timestamps_.resize(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			samples[k]->retrieve_untyped(raw_block_.data() + k * sample_bytes);
+			processed_timestamps_[k] = samples[k]->timestamp;
+		}
+		if (deliver_raw(raw_block_.data(), raw_block_.size(), n, processed_timestamps_.data()))
+			return;
+	}
+	if (n) {
+		// the samples can't be pulled before their gaps are marked
+		std::lock_guard<std::mutex> lock(gap_mut_);
+		sample_queue_.push_samples(samples, n);
+		mark_gaps(samples, n);
+	} else
+		sample_queue_.push_sample(sample_p());
+}
+
+bool data_receiver::deliver_raw(
+	const char *values, std::size_t num_bytes, std::size_t n, double *timestamps) {
+	try {
+		return raw_chunk_callback_.call(values, num_bytes, n, timestamps);
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Uncaught exception in the raw chunk callback of %s: %s",
+			conn_.type_info().name().c_str(), e.what());
+		return true;
+	}
+}
+
 void data_receiver::close_stream() {
 	check_thread_start_ = true;
 	closing_stream_ = true;
 	cancel_all_registered();
 }
 
-template <class T>
-double data_receiver::pull_sample_typed(T *buffer, uint32_t buffer_elements, double timeout) {
-	if (conn_.lost())
-		throw lost_error("The stream read by this outlet has been lost. To recover, you need to "
+void data_receiver::throw_pull_error(lsl_error_code_t ec, const char *mismatch) {
+	if (ec == lsl_lost_error)
+		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
 						 "re-resolve the source and re-create the inlet.");
+	if (ec == lsl_argument_error) throw std::range_error(mismatch);
+}
+
+template <class T>
+lsl_error_code_t data_receiver::try_pull_sample_typed(
+	T *buffer, uint32_t buffer_elements, double timeout, double &timestamp) {
+	timestamp = 0.0;
+	if (conn_.lost()) return lsl_lost_error;
+	// checked before taking a sample from the queue, so the sample isn't dropped
+	if (buffer_elements != conn_.type_info().channel_count()) return lsl_argument_error;
 	// start data thread implicitly if necessary
 	if (check_thread_start_ && !data_thread_.joinable()) {
-		data_thread_ = std::thread(&data_receiver::data_thread, this);
+		spawn_data_thread();
 		check_thread_start_ = false;
 	}
+	std::shared_ptr<const calibration> calib;
+	{
+		std::lock_guard<std::mutex> lock(calibration_mut_);
+		calib = calibration_;
+	}
 	// get the sample with timeout
 	if (sample_p s = sample_queue_.pop_sample(timeout)) {
-		if (buffer_elements != conn_.type_info().channel_count())
-			throw std::range_error("The number of buffer elements provided does not match the "
-								   "number of channels in the sample.");
-		s->retrieve_typed(buffer);
-		return s->timestamp;
-	} else {
-		if (conn_.lost())
-			throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
-							 "re-resolve the source and re-create the inlet.");
-		return 0.0;
+		record_residence(&s, 1);
+		account_gaps(&s, 1);
+		if (const auto *scaled = calib ? calib->get(buffer) : nullptr)
+			scaled->apply(*s, buffer);
+		else
+			s->retrieve_typed(buffer, sample_factory_->kernels<T>().retrieve);
+		LSL_TRACE("pull_sample", conn_.current_uid(), s->seq);
+		timestamp = s->timestamp;
+		return lsl_no_error;
 	}
+	return conn_.lost() ? lsl_lost_error : lsl_no_error;
+}
+
+template <class T>
+double data_receiver::pull_sample_typed(T *buffer, uint32_t buffer_elements, double timeout) {
+	double timestamp;
+	throw_pull_error(try_pull_sample_typed(buffer, buffer_elements, timeout, timestamp),
+		"The number of buffer elements provided does not match the number of channels in the "
+		"sample.");
+	return timestamp;
 }
 
+template lsl_error_code_t data_receiver::try_pull_sample_typed<char>(
+	char *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<int16_t>(
+	int16_t *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<int32_t>(
+	int32_t *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<int64_t>(
+	int64_t *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<float>(
+	float *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<double>(
+	double *, uint32_t, double, double &);
+template lsl_error_code_t data_receiver::try_pull_sample_typed<std::string>(
+	std::string *, uint32_t, double, double &);
 template double data_receiver::pull_sample_typed<char>(char *, uint32_t, double);
 template double data_receiver::pull_sample_typed<int16_t>(int16_t *, uint32_t, double);
 template double data_receiver::pull_sample_typed<int32_t>(int32_t *, uint32_t, double);
@@ -108,52 +339,796 @@ template double data_receiver::pull_sample_typed<float>(float *, uint32_t, doubl
 template double data_receiver::pull_sample_typed<double>(double *, uint32_t, double);
 template double data_receiver::pull_sample_typed<std::string>(std::string *, uint32_t, double);
 
-double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double timeout) {
-	if (conn_.lost())
-		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
-						 "re-resolve the source and re-create the inlet.");
+/**
+ * Transpose a block of rows (multiplexed samples) into the columns of a channel-major buffer.
+ *
+ * Each channel's values are written contiguously and the block stays in the L1 cache, so the
+ * strided reads are cheap.
+ */
+template <class T>
+void transpose_block(T *block, std::size_t rows, std::size_t cols, T *dst, std::size_t dst_stride) {
+	for (std::size_t c = 0; c < cols; ++c, dst += dst_stride)
+		for (std::size_t r = 0; r < rows; ++r) dst[r] = std::move(block[r * cols + c]);
+}
+
+template <class T>
+lsl_error_code_t data_receiver::try_pull_chunk_typed(T *data_buffer, double *timestamp_buffer,
+	uint32_t max_samples, double timeout, bool planar, uint32_t &samples_written) {
+	samples_written = 0;
+	if (conn_.lost()) return lsl_lost_error;
+	// start data thread implicitly if necessary
+	if (check_thread_start_ && !data_thread_.joinable()) {
+		spawn_data_thread();
+		check_thread_start_ = false;
+	}
+	const uint32_t num_chans = conn_.type_info().channel_count();
+	const auto retrieve = sample_factory_->kernels<T>().retrieve;
+	std::shared_ptr<const calibration> calib;
+	{
+		std::lock_guard<std::mutex> lock(calibration_mut_);
+		calib = calibration_;
+	}
+	const auto *scaled = calib ? calib->get(data_buffer) : nullptr;
+	// converts (and calibrates) a sample in a single pass
+	const auto retrieve_into = [&](sample &s, T *dst) {
+		if (scaled)
+			scaled->apply(s, dst);
+		else
+			s.retrieve_typed(dst, retrieve);
+	};
+	// the queue can't hold more than max_buflen_ samples, so there's no point in popping more
+	const uint32_t batch_size =
+		std::min(max_samples, static_cast<uint32_t>(std::max(max_buflen_.load(), 1)));
+	// the first batch waits for these, later ones only take what's available
+	const uint32_t min_samples = std::min(pull_min_samples_.load(), batch_size);
+	// the buffers are kept per thread, so repeated pulls (e.g. into a chunk_buffer) don't allocate
+	static thread_local std::vector<sample_p> samples;
+	if (samples.size() < batch_size) {
+		// the first pull of a thread sizes its buffers, only growing them later is reported
+		if (!samples.empty() && config_->no_allocation) report_allocation("pull buffer");
+		samples.resize(batch_size);
+	}
+	// planar pulls retrieve the samples into a block that's transposed once it's full
+	static thread_local std::vector<T> block;
+	if (planar && block.size() < planar_block_samples * num_chans)
+		block.resize(planar_block_samples * num_chans);
+	std::size_t block_rows = 0;
+	const auto flush_block = [&](uint32_t samples_written) {
+		transpose_block(block.data(), block_rows, num_chans,
+			data_buffer + (samples_written - block_rows), max_samples);
+		block_rows = 0;
+	};
+	double end_time = timeout > 0.0 ? lsl_clock() + timeout : 0.0;
+	while (samples_written < max_samples) {
+		const uint32_t wanted = std::min(batch_size, max_samples - samples_written);
+		std::size_t n = sample_queue_.pop_samples(samples.data(), wanted,
+			end_time != 0.0 ? end_time - lsl_clock() : 0.0, samples_written ? 0 : min_samples);
+		record_residence(samples.data(), n);
+		account_gaps(samples.data(), n);
+		for (std::size_t k = 0; k < n; k++) {
+			sample_p &s = samples[k];
+			if (!s) {
+				// sentinel: the stream was lost; don't keep any samples after it in the buffer
+				for (std::size_t j = k + 1; j < n; j++) samples[j].reset();
+				if (block_rows) flush_block(samples_written);
+				return samples_written ? lsl_no_error : lsl_lost_error;
+			}
+			if (planar)
+				retrieve_into(*s, block.data() + block_rows++ * num_chans);
+			else
+				retrieve_into(
+					*s, data_buffer + samples_written * static_cast<std::size_t>(num_chans));
+			if (timestamp_buffer) timestamp_buffer[samples_written] = s->timestamp;
+			LSL_TRACE("pull_chunk", conn_.current_uid(), s->seq);
+			s.reset();
+			samples_written++;
+			if (block_rows == planar_block_samples) flush_block(samples_written);
+		}
+		if (n < wanted) break;
+		if (min_samples) end_time = 0.0;
+	}
+	if (block_rows) flush_block(samples_written);
+	return lsl_no_error;
+}
+
+template <class T>
+uint32_t data_receiver::pull_chunk_typed(
+	T *data_buffer, double *timestamp_buffer, uint32_t max_samples, double timeout, bool planar) {
+	uint32_t samples_written;
+	throw_pull_error(try_pull_chunk_typed(
+		data_buffer, timestamp_buffer, max_samples, timeout, planar, samples_written));
+	return samples_written;
+}
+
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<char>(
+	char *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<int16_t>(
+	int16_t *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<int32_t>(
+	int32_t *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<int64_t>(
+	int64_t *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<float>(
+	float *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<double>(
+	double *, double *, uint32_t, double, bool, uint32_t &);
+template lsl_error_code_t data_receiver::try_pull_chunk_typed<std::string>(
+	std::string *, double *, uint32_t, double, bool, uint32_t &);
+template uint32_t data_receiver::pull_chunk_typed<char>(char *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<int16_t>(
+	int16_t *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<int32_t>(
+	int32_t *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<int64_t>(
+	int64_t *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<float>(float *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<double>(
+	double *, double *, uint32_t, double, bool);
+template uint32_t data_receiver::pull_chunk_typed<std::string>(
+	std::string *, double *, uint32_t, double, bool);
+
+lsl_error_code_t data_receiver::try_pull_sample_untyped(
+	void *buffer, int buffer_bytes, double timeout, double &timestamp) {
+	timestamp = 0.0;
+	if (conn_.lost()) return lsl_lost_error;
+	if (buffer_bytes != conn_.type_info().sample_bytes()) return lsl_argument_error;
 	// start data thread implicitly if necessary
 	if (check_thread_start_ && !data_thread_.joinable()) {
-		data_thread_ = std::thread(&data_receiver::data_thread, this);
+		spawn_data_thread();
 		check_thread_start_ = false;
 	}
 	// get the sample with timeout
 	if (sample_p s = sample_queue_.pop_sample(timeout)) {
-		if (buffer_bytes != conn_.type_info().sample_bytes())
-			throw std::range_error("The size of the provided buffer does not match the number of "
-								   "bytes in the sample.");
+		record_residence(&s, 1);
+		account_gaps(&s, 1);
 		s->retrieve_untyped(buffer);
-		return s->timestamp;
-	} else {
-		if (conn_.lost())
-			throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
-							 "re-resolve the source and re-create the inlet.");
-		return 0.0;
+		LSL_TRACE("pull_sample", conn_.current_uid(), s->seq);
+		timestamp = s->timestamp;
+		return lsl_no_error;
 	}
+	return conn_.lost() ? lsl_lost_error : lsl_no_error;
+}
+
+double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double timeout) {
+	double timestamp;
+	throw_pull_error(try_pull_sample_untyped(buffer, buffer_bytes, timeout, timestamp),
+		"The size of the provided buffer does not match the number of bytes in the sample.");
+	return timestamp;
 }
 
+uint32_t data_receiver::borrow_samples(sample_view &view, uint32_t max_samples, double timeout) {
+	if (conn_.lost())
+		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
+						 "re-resolve the source and re-create the inlet.");
+	// start data thread implicitly if necessary
+	if (check_thread_start_ && !data_thread_.joinable()) {
+		spawn_data_thread();
+		check_thread_start_ = false;
+	}
+	view.sample_factory = sample_factory_;
+	view.samples.clear();
+	view.samples.resize(max_samples);
+	std::size_t n =
+		sample_queue_.pop_samples(view.samples.data(), max_samples, timeout, pull_min_samples_);
+	record_residence(view.samples.data(), n);
+	account_gaps(view.samples.data(), n);
+	// an empty sentinel sample signals that the stream was lost
+	if (n && !view.samples[n - 1]) {
+		if (--n == 0)
+			throw lost_error("The stream read by this inlet has been lost. To recover, you need "
+							 "to re-resolve the source and re-create the inlet.");
+	}
+	view.samples.resize(n);
+	view.timestamps.resize(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		view.timestamps[k] = view.samples[k]->timestamp;
+		LSL_TRACE("borrow_chunk", conn_.current_uid(), view.samples[k]->seq);
+	}
+	return static_cast<uint32_t>(n);
+}
 
 // === internal processing ===
 
+void data_receiver::get_stats(lsl_inlet_stats &stats) {
+	stats.samples_received = samples_received_.load(std::memory_order_relaxed);
+	stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+	stats.chunks_received = chunks_received_.load(std::memory_order_relaxed);
+	stats.samples_lost = samples_lost_.load(std::memory_order_relaxed);
+	stats.samples_dropped = sample_queue_.dropped();
+	stats.samples_available = static_cast<uint32_t>(sample_queue_.read_available());
+	const uint32_t connections = connections_.load(std::memory_order_relaxed);
+	stats.reconnects = connections > 1 ? connections - 1 : 0;
+	stats.latency_count = latency_.count();
+	stats.latency_p50 = latency_.percentile(0.5);
+	stats.latency_p99 = latency_.percentile(0.99);
+	stats.latency_p999 = latency_.percentile(0.999);
+	stats.residence_count = residence_.count();
+	stats.residence_p50 = residence_.percentile(0.5);
+	stats.residence_p99 = residence_.percentile(0.99);
+	stats.residence_p999 = residence_.percentile(0.999);
+	stats.memory_samples = sample_factory_->memory_bytes();
+	stats.memory_queues = sample_queue_.memory_bytes();
+	stats.memory_network = receive_buffer_bytes_.load(std::memory_order_relaxed);
+	stats.cpu_seconds = cpu_->seconds();
+	stats.chunks_passed_through = chunks_passed_through_.load(std::memory_order_relaxed);
+}
+
+void data_receiver::track_latency(bool enabled) {
+	if (enabled && !track_latency_) {
+		latency_.reset();
+		residence_.reset();
+	}
+	track_latency_ = enabled;
+}
+
+void data_receiver::set_buffering(int max_buflen, int max_chunklen) {
+	if (max_buflen < 0)
+		throw std::invalid_argument("The max_buflen argument must not be smaller than 0.");
+	if (max_chunklen < 0)
+		throw std::invalid_argument("The max_chunklen argument must not be smaller than 0.");
+	max_buflen_ = max_buflen;
+	max_chunklen_ = max_chunklen;
+	sample_queue_.set_capacity_limit(static_cast<std::size_t>(max_buflen));
+	reconfigure_pending_ = true;
+}
+
+void data_receiver::set_resampling(uint32_t up, uint32_t down, bool server_side) {
+	const bool enabled = up != down || !up;
+	if (enabled) {
+		resampler::validate(conn_.type_info().channel_format(), conn_.type_info().nominal_srate(),
+			up, down);
+		if (conn_.decimation() > 1)
+			throw std::invalid_argument("Decimated streams can't be resampled.");
+	}
+	std::lock_guard<std::mutex> lock(resampling_mut_);
+	resampling_ = enabled ? resampling{up, down, server_side} : resampling();
+	resampling_ratio_ = enabled ? static_cast<double>(up) / down : 1.0;
+}
+
+void data_receiver::set_value_filter(value_filter filter) {
+	filter.validate(conn_.type_info().channel_format());
+	std::lock_guard<std::mutex> lock(value_filter_mut_);
+	value_filter_ = std::move(filter);
+}
+
+void data_receiver::set_calibration(std::shared_ptr<const calibration> calib) {
+	std::lock_guard<std::mutex> lock(calibration_mut_);
+	calibration_ = std::move(calib);
+}
+
+void data_receiver::record_latency(const sample_p *samples, std::size_t n) {
+	if (!track_latency_.load(std::memory_order_relaxed)) return;
+	const double now = lsl_clock();
+	double correction = 0.0;
+	const bool corrected = time_correction_source_ && time_correction_source_(correction);
+	for (std::size_t k = 0; k < n; ++k) {
+		samples[k]->received = now;
+		if (corrected) latency_.record(now - (samples[k]->timestamp + correction));
+	}
+}
+
+void data_receiver::record_residence(const sample_p *samples, std::size_t n) {
+	if (!track_latency_.load(std::memory_order_relaxed)) return;
+	const double now = lsl_clock();
+	for (std::size_t k = 0; k < n; ++k)
+		if (samples[k] && samples[k]->received != 0.0)
+			residence_.record(now - samples[k]->received);
+}
+
+void data_receiver::mark_gaps(const sample_p *samples, std::size_t n) {
+	// the samples dropped while pushing are older than the newest pushed one
+	const uint64_t dropped = samples_dropped(), missing = samples_missing();
+	if (dropped == last_mark_.dropped && missing == last_mark_.missing) return;
+	last_mark_ = {samples[n - 1]->seq, dropped, missing};
+	gap_marks_.push_back(last_mark_);
+}
+
+void data_receiver::account_gaps(const sample_p *samples, std::size_t n) {
+	// (skipping the lost stream's sentinel)
+	while (n && !samples[n - 1]) --n;
+	if (!n) return;
+	const uint64_t seq = samples[n - 1]->seq;
+	std::lock_guard<std::mutex> lock(gap_mut_);
+	// marks of samples still in the buffer stay, unless the samples aren't numbered or the
+	// sequence started over
+	for (; !gap_marks_.empty(); gap_marks_.pop_front()) {
+		const gap_mark &mark = gap_marks_.front();
+		if (seq && mark.seq > seq && seq >= pulled_seq_) break;
+		dropped_pulled_ = mark.dropped;
+		missing_pulled_ = mark.missing;
+	}
+	pulled_seq_ = seq;
+}
+
+void data_receiver::deliver_batch(std::vector<sample_p> &batch, double srate,
+	double &last_timestamp, uint32_t local_decimation) {
+	samples_received_.fetch_add(batch.size(), std::memory_order_relaxed);
+	chunks_received_.fetch_add(1, std::memory_order_relaxed);
+	// deduce timestamps if necessary
+	for (auto &samp : batch) {
+		if (samp->timestamp == DEDUCED_TIMESTAMP) {
+			samp->timestamp = last_timestamp;
+			if (srate != IRREGULAR_RATE) samp->timestamp += 1.0 / srate;
+		}
+		last_timestamp = samp->timestamp;
+	}
+	if (local_decimation > 1)
+		batch.erase(std::remove_if(batch.begin(), batch.end(),
+						[&](const sample_p &) { return decimated_++ % local_decimation != 0; }),
+			batch.end());
+	if (!filter_.empty())
+		batch.erase(std::remove_if(batch.begin(), batch.end(),
+						[this](const sample_p &samp) { return !filter_.matches(*samp); }),
+			batch.end());
+	record_latency(batch.data(), batch.size());
+	if (resampler_) {
+		resampler_->process(batch.data(), batch.size(), resampled_);
+		batch.swap(resampled_);
+		resampled_.clear();
+	}
+	if (has_timestamp_processor_ && !batch.empty()) {
+		std::lock_guard<std::mutex> lock(timestamp_processor_mut_);
+		if (timestamp_processor_) {
+			processed_timestamps_.resize(batch.size());
+			for (std::size_t k = 0; k < batch.size(); ++k)
+				processed_timestamps_[k] = batch[k]->timestamp;
+			timestamp_processor_(processed_timestamps_.data(), batch.size());
+			for (std::size_t k = 0; k < batch.size(); ++k)
+				batch[k]->timestamp = processed_timestamps_[k];
+		}
+	}
+	// push them into the sample queue
+	if (!batch.empty()) deliver_samples(batch.data(), batch.size());
+	batch.clear();
+}
+
+void data_receiver::deliver_frame(
+	frame_view &frame, std::size_t skip, double srate, double &last_timestamp) {
+	const std::size_t n = frame.count - skip;
+	samples_received_.fetch_add(n, std::memory_order_relaxed);
+	chunks_received_.fetch_add(1, std::memory_order_relaxed);
+	if (!n) return;
+	double *timestamps = frame.timestamps.data() + skip;
+	for (std::size_t k = 0; k < n; ++k) {
+		if (timestamps[k] == DEDUCED_TIMESTAMP) {
+			timestamps[k] = last_timestamp;
+			if (srate != IRREGULAR_RATE) timestamps[k] += 1.0 / srate;
+		}
+		last_timestamp = timestamps[k];
+	}
+	if (has_timestamp_processor_) {
+		std::lock_guard<std::mutex> lock(timestamp_processor_mut_);
+		if (timestamp_processor_) timestamp_processor_(timestamps, n);
+	}
+	const std::size_t sample_bytes = frame.value_bytes / frame.count;
+	const char *values = frame.values + skip * sample_bytes;
+	if (deliver_raw(values, n * sample_bytes, n, timestamps)) {
+		chunks_passed_through_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// the callback has been removed in the meantime
+	std::vector<sample_p> samples;
+	samples.reserve(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		samples.emplace_back(sample_factory_->new_sample(timestamps[k], false));
+		samples.back()->assign_untyped(values + k * sample_bytes);
+	}
+	deliver_samples(samples.data(), n);
+}
+
+bool data_receiver::receive_datagrams(cancellable_streambuf &buffer, asio::io_context &io,
+	asio::ip::udp::socket &sock, uint64_t key, bool repair, int use_byte_order,
+	bool suppress_subnormals, double &last_timestamp) {
+	const double srate = conn_.current_srate();
+	std::vector<sample_p> batch;
+	asio::streambuf datagram;
+	bool receiving = false;
+	std::size_t received = 0;
+	uint64_t bytes_counted = buffer.bytes_received();
+	double last_datagram = lsl_clock();
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		if (!receiving) {
+			datagram.consume(datagram.size());
+			sock.async_receive(datagram.prepare(datagram_sender::max_datagram_bytes),
+				[&](const error_code &ec, std::size_t len) {
+					receiving = false;
+					received = ec ? 0 : len;
+				});
+			receiving = true;
+		}
+		// the context stops whenever it runs out of work
+		io.restart();
+		io.run_one_for(multicast_poll_interval);
+		if (receiving || !received) {
+			if (lsl_clock() - last_datagram < multicast_timeout) continue;
+			// no datagrams: either the outlet is gone, or the multicast path doesn't work (find
+			// out by sending an empty repair request)
+			repair_samples(buffer, 1, 0, use_byte_order, suppress_subnormals, batch);
+			return false;
+		}
+		datagram.commit(received);
+		bytes_received_.fetch_add(received, std::memory_order_relaxed);
+		if (!process_datagram(datagram, key, repair, buffer, use_byte_order, suppress_subnormals,
+				batch))
+			continue;
+		last_datagram = lsl_clock();
+		conn_.update_receive_time(last_datagram);
+		bytes_received_.fetch_add(
+			buffer.bytes_received() - bytes_counted, std::memory_order_relaxed);
+		bytes_counted = buffer.bytes_received();
+		if (!batch.empty()) deliver_batch(batch, srate, last_timestamp, 1);
+	}
+	return true;
+}
+
+bool data_receiver::receive_rdma(cancellable_streambuf &buffer, rdma_endpoint &rdma, uint64_t key,
+	int use_byte_order, bool suppress_subnormals, double &last_timestamp) {
+	const double srate = conn_.current_srate();
+	const double poll_interval = std::chrono::duration<double>(multicast_poll_interval).count();
+	std::vector<sample_p> batch;
+	asio::streambuf slot;
+	double last_slot = lsl_clock();
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		slot.consume(slot.size());
+		std::size_t received = 0;
+		try {
+			received = rdma.receive(slot, poll_interval);
+		} catch (std::runtime_error &e) {
+			ALOG_F(WARNING, "%s: %s", conn_.type_info().name().c_str(), e.what());
+			return false;
+		}
+		if (!received) {
+			if (lsl_clock() - last_slot < multicast_timeout) continue;
+			// no heartbeats: find out whether the outlet is gone by sending an empty repair
+			// request
+			repair_samples(buffer, 1, 0, use_byte_order, suppress_subnormals, batch);
+			return false;
+		}
+		bytes_received_.fetch_add(received, std::memory_order_relaxed);
+		if (!process_datagram(
+				slot, key, false, buffer, use_byte_order, suppress_subnormals, batch))
+			continue;
+		last_slot = lsl_clock();
+		conn_.update_receive_time(last_slot);
+		if (!batch.empty()) deliver_batch(batch, srate, last_timestamp, 1);
+	}
+	return true;
+}
+
+namespace {
+/// Reads a slot of a shared memory ring in place.
+class slot_reader : public std::streambuf {
+public:
+	slot_reader(const char *slot, std::size_t len) {
+		char *begin = const_cast<char *>(slot);
+		setg(begin, begin, begin + len);
+	}
+};
+} // namespace
+
+bool data_receiver::receive_shm(cancellable_streambuf &buffer, shm_ring &ring, uint64_t key,
+	bool suppress_subnormals, double &last_timestamp) {
+	const double srate = conn_.current_srate();
+	const double poll_interval = std::chrono::duration<double>(multicast_poll_interval).count();
+	std::vector<sample_p> batch;
+	double last_slot = lsl_clock();
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		std::size_t len = 0;
+		if (const char *data = ring.read_slot(len)) {
+			slot_reader slot(data, len);
+			const bool valid = process_datagram(
+				slot, key, false, buffer, BOOST_BYTE_ORDER, suppress_subnormals, batch);
+			ring.release();
+			bytes_received_.fetch_add(len, std::memory_order_relaxed);
+			if (!valid) continue;
+			last_slot = lsl_clock();
+			conn_.update_receive_time(last_slot);
+			if (!batch.empty()) deliver_batch(batch, srate, last_timestamp, 1);
+			continue;
+		}
+		// no heartbeats: the outlet's sender has stopped, but the connection is still alive
+		if (lsl_clock() - last_slot >= multicast_timeout) return false;
+		if (!ring.prepare_wait()) continue;
+		// the ring is empty, so wait for a wakeup (and check again now and then in case the
+		// inlet is closed)
+		buffer.set_receive_timeout(poll_interval);
+		if (buffer.sgetc() == std::streambuf::traits_type::eof()) {
+			if (buffer.error() != asio::error::timed_out) throw lost_error("Connection lost.");
+			continue;
+		}
+		while (buffer.in_avail() > 0) buffer.sbumpc();
+	}
+	return true;
+}
+
+bool data_receiver::process_datagram(std::streambuf &datagram, uint64_t key, bool repair,
+	cancellable_streambuf &buffer, int use_byte_order, bool suppress_subnormals,
+	std::vector<sample_p> &batch) {
+	// decode the datagram before acting on it, so a malformed one is ignored as a whole
+	uint64_t datagram_key = 0, feed_seq = 0;
+	uint16_t count = 0;
+	std::vector<sample_p> decoded;
+	try {
+		if (!read_le(datagram, datagram_key) || datagram_key != key) return false;
+		if (!read_le(datagram, feed_seq) || !read_le(datagram, count))
+			throw std::runtime_error("The header is truncated.");
+		decoded.reserve(count);
+		for (uint16_t k = 0; k < count; ++k) {
+			uint64_t seq = 0;
+			if (!read_le(datagram, seq)) throw std::runtime_error("A sample is truncated.");
+			sample_p samp(sample_factory_->new_sample(0.0, false));
+			samp->load_streambuf(datagram, 110, use_byte_order, suppress_subnormals);
+			samp->seq = seq;
+			decoded.push_back(std::move(samp));
+		}
+	} catch (std::runtime_error &e) {
+		ALOG_F(WARNING, "%s: ignoring a malformed datagram (%s)", conn_.type_info().name().c_str(),
+			e.what());
+		return false;
+	}
+
+	for (auto &samp : decoded) {
+		// skip samples that were repaired already (or arrived too late)
+		if (samp->seq <= last_seq_) continue;
+		if ((last_seq_ || seq_known_) && samp->seq > last_seq_ + 1) {
+			if (repair)
+				repair_samples(buffer, last_seq_ + 1, samp->seq - 1, use_byte_order,
+					suppress_subnormals, batch);
+			else
+				samples_lost_.fetch_add(samp->seq - last_seq_ - 1, std::memory_order_relaxed);
+		}
+		last_seq_ = samp->seq;
+		LSL_TRACE("decoded", last_seq_uid_, last_seq_);
+		batch.push_back(std::move(samp));
+	}
+	// some of the previous datagrams didn't arrive
+	if ((last_seq_ || seq_known_) && feed_seq > last_seq_) {
+		if (repair)
+			repair_samples(
+				buffer, last_seq_ + 1, feed_seq, use_byte_order, suppress_subnormals, batch);
+		else {
+			samples_lost_.fetch_add(feed_seq - last_seq_, std::memory_order_relaxed);
+			last_seq_ = feed_seq;
+		}
+	}
+	return true;
+}
+
+void data_receiver::receive_local(const local_feed &feed, double &last_timestamp) {
+	// a different outlet (after recovering) has its own sequence numbers
+	if (last_seq_uid_ != conn_.current_uid()) {
+		last_seq_ = 0;
+		last_seq_uid_ = conn_.current_uid();
+		seq_known_ = false;
+	}
+	const uint64_t resume_from = last_seq_ ? last_seq_ + 1 : 0;
+	auto queue = feed.buffer->new_consumer(
+		consumer_queue::policy_capacity(overflow_policy_, max_buflen_), resume_from,
+		resume_from ? 0.0 : history_request_.load(), priority_);
+	queue->set_overflow_policy(overflow_policy_, overflow_parameter_);
+	if (std::find(local_factories_.begin(), local_factories_.end(), feed.factory) ==
+		local_factories_.end())
+		local_factories_.push_back(feed.factory);
+	set_connected();
+
+	const double srate = conn_.current_srate();
+	std::vector<uint32_t> all_channels(conn_.type_info().channel_count());
+	std::iota(all_channels.begin(), all_channels.end(), 0);
+	std::vector<sample_p> popped(max_batch_samples), batch;
+	batch.reserve(max_batch_samples);
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		popped[0] = queue->pop_sample(local_poll_interval);
+		if (!popped[0]) {
+			if (!local_feed::find(last_seq_uid_).buffer)
+				throw lost_error("The outlet has been destroyed.");
+			// the outlet is still there, it just doesn't push anything
+			conn_.update_receive_time(lsl_clock());
+			continue;
+		}
+		const std::size_t n = 1 + queue->pop_samples(&popped[1], max_batch_samples - 1);
+		const bool track_latency = track_latency_.load(std::memory_order_relaxed);
+		for (std::size_t k = 0; k < n; ++k) {
+			sample_p samp(std::move(popped[k]));
+			if (!samp || samp->seq <= last_seq_) continue;
+			last_seq_ = samp->seq;
+			LSL_TRACE("decoded", last_seq_uid_, last_seq_);
+			if (samp->timestamp == DEDUCED_TIMESTAMP || track_latency ||
+				has_timestamp_processor_) {
+				// the inlet fills in the time stamp (or the receive time, or post-processes the
+				// time stamp), so it needs a sample of its own
+				sample_p copy(sample_factory_->new_sample(samp->timestamp, samp->pushthrough));
+				copy->assign_channels(*samp, all_channels.data());
+				copy->seq = samp->seq;
+				samp = std::move(copy);
+			}
+			batch.push_back(std::move(samp));
+		}
+		if (!batch.empty()) deliver_batch(batch, srate, last_timestamp, 1);
+		conn_.update_receive_time(lsl_clock());
+	}
+}
+
+bool data_receiver::receive_bundled(double &last_timestamp) {
+	std::shared_ptr<bundle_client> bundle;
+	try {
+		bundle = bundle_client::get(
+			conn_.type_info().hostname(), conn_.get_tcp_endpoint(), conn_.current_uid());
+	} catch (std::exception &e) {
+		LOG_F(INFO, "%s: no bundled connection (%s), connecting directly",
+			conn_.type_info().name().c_str(), e.what());
+		return false;
+	}
+	// a different outlet (after recovering) has its own sequence numbers
+	if (last_seq_uid_ != conn_.current_uid()) {
+		last_seq_ = 0;
+		last_seq_uid_ = conn_.current_uid();
+		seq_known_ = false;
+	}
+	const double srate = conn_.current_srate();
+	std::mutex lost_mut;
+	std::condition_variable lost_upd;
+	bool lost = false;
+	bundle_client::handlers h;
+	// called from the bundle's thread while this thread waits below
+	h.samples = [&](std::vector<sample_p> &batch) {
+		batch.erase(std::remove_if(batch.begin(), batch.end(),
+						[this](const sample_p &samp) { return samp->seq <= last_seq_; }),
+			batch.end());
+		if (batch.empty()) return;
+		last_seq_ = batch.back()->seq;
+		deliver_batch(batch, srate, last_timestamp, 1);
+		conn_.update_receive_time(lsl_clock());
+	};
+	h.alive = [this]() { conn_.update_receive_time(lsl_clock()); };
+	h.lost = [&]() {
+		{
+			std::lock_guard<std::mutex> lock(lost_mut);
+			lost = true;
+		}
+		lost_upd.notify_all();
+	};
+	bundle_client::subscription sub;
+	sub.uid = last_seq_uid_;
+	sub.format = conn_.type_info().channel_format();
+	sub.channels = static_cast<uint32_t>(conn_.type_info().channel_count());
+	sub.factory = sample_factory_;
+	sub.max_buflen = max_buflen_;
+	sub.resume_from = last_seq_ ? last_seq_ + 1 : 0;
+	sub.history_seconds = sub.resume_from ? 0.0 : history_request_.load();
+	sub.overflow_policy = overflow_policy_;
+	sub.overflow_parameter = overflow_parameter_;
+	const uint32_t id = bundle->add(sub, std::move(h));
+	if (!id) return false;
+	set_connected();
+
+	{
+		std::unique_lock<std::mutex> lock(lost_mut);
+		while (!lost && !conn_.lost() && !conn_.shutdown() && !closing_stream_)
+			lost_upd.wait_for(lock, std::chrono::duration<double>(local_poll_interval));
+	}
+	bundle->remove(id);
+	if (lost && !conn_.lost() && !conn_.shutdown() && !closing_stream_)
+		throw lost_error("The outlet or the bundled connection has gone away.");
+	return true;
+}
+
+void data_receiver::set_connected() {
+	{
+		std::lock_guard<std::mutex> lock(connected_mut_);
+		connected_ = true;
+	}
+	connected_upd_.notify_all();
+	connections_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void data_receiver::repair_samples(cancellable_streambuf &buffer, uint64_t first, uint64_t last,
+	int use_byte_order, bool suppress_subnormals, std::vector<sample_p> &batch) {
+	std::ostream request(&buffer);
+	request << "LSL:repair " << first << " " << last << "\r\n" << std::flush;
+	uint64_t count = 0, repaired = 0;
+	if (!read_le(buffer, count)) throw lost_error("Connection lost.");
+	for (; count; --count) {
+		uint64_t seq = 0;
+		if (!read_le(buffer, seq)) throw lost_error("Connection lost.");
+		sample_p samp(sample_factory_->new_sample(0.0, false));
+		samp->load_streambuf(buffer, 110, use_byte_order, suppress_subnormals);
+		samp->seq = seq;
+		batch.push_back(std::move(samp));
+		++repaired;
+	}
+	if (first > last) return;
+	if (repaired < last - first + 1) {
+		ALOG_F(INFO, "%s: %llu multicast samples were lost and no longer in the outlet's history",
+			conn_.type_info().name().c_str(),
+			static_cast<unsigned long long>(last - first + 1 - repaired));
+		samples_lost_.fetch_add(last - first + 1 - repaired, std::memory_order_relaxed);
+	}
+	last_seq_ = last;
+}
+
+void data_receiver::spawn_data_thread() {
+	data_thread_ = managed_thread(lsl_thread_data, "R_" + conn_.type_info().name().substr(0, 12),
+		&data_receiver::data_thread, this);
+}
+
 void data_receiver::data_thread() {
+	const cpu_account::scope cpu_scope = cpu_->attach();
 	conn_.acquire_watchdog();
-	loguru::set_thread_name((std::string("R_") += conn_.type_info().name().substr(0, 12)).c_str());
 	// ensure that the sample factory persists for the lifetime of this thread
 	factory_p factory(sample_factory_);
+	// the delay doubles with every failed reconnect so we don't spam the provider
+	double reconnect_delay = min_reconnect_delay;
+	// kept across reconnects so a resumed stream's deduced timestamps continue where they left off
+	double last_timestamp = 0.0;
 	try {
 		while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
 			try {
+				// the samples are resampled here unless the outlet does that for us (see below)
+				resampling rs;
+				{
+					std::lock_guard<std::mutex> lock(resampling_mut_);
+					rs = resampling_;
+				}
+				resampler_.reset(rs.up != rs.down
+									 ? new resampler(factory, conn_.current_srate(), rs.up, rs.down)
+									 : nullptr);
+				const std::string resampling_request =
+					std::to_string(rs.up) + "/" + std::to_string(rs.down);
+				// likewise for the value filter
+				{
+					std::lock_guard<std::mutex> lock(value_filter_mut_);
+					filter_ = value_filter_;
+				}
+
+				// --- in-process outlets ---
+
+				if (in_process_ && conn_.channel_subset().empty() && conn_.decimation() <= 1) {
+					const local_feed feed = local_feed::find(conn_.current_uid());
+					if (feed.buffer) {
+						reconnect_delay = min_reconnect_delay;
+						receive_local(feed, last_timestamp);
+						continue;
+					}
+				}
+
+				// --- bundled connections ---
+
+				if (bundling_ && conn_.channel_subset().empty() && conn_.decimation() <= 1 &&
+					conn_.type_info().channel_format() != cft_string &&
+					bundle_failed_uid_ != conn_.current_uid()) {
+					if (receive_bundled(last_timestamp)) {
+						reconnect_delay = min_reconnect_delay;
+						continue;
+					}
+					// don't try again until the stream is recovered from another outlet
+					bundle_failed_uid_ = conn_.current_uid();
+				}
+
 				// --- connection setup ---
 
 				// make a new stream buffer and a stream on top of it
 				cancellable_streambuf buffer;
+				buffer.set_max_receive_buffer(config_->inlet_receive_buffer_max_bytes);
+				{
+					std::lock_guard<std::mutex> lock(socket_options_mut_);
+					buffer.set_socket_options(socket_options_);
+				}
 				buffer.register_at(&conn_);
 				buffer.register_at(this);
+				// the buffer is counted until it goes out of scope
+				struct buffer_accounting {
+					std::atomic<std::size_t> &bytes;
+					~buffer_accounting() { bytes = 0; }
+				} accounting{receive_buffer_bytes_};
+				receive_buffer_bytes_ = buffer.receive_buffer_bytes();
 				std::iostream server_stream(&buffer);
+#ifndef LSL_NO_PROTOCOL_100
 				std::unique_ptr<eos::portable_iarchive> inarch;
+#endif
 				// connect to endpoint
-				buffer.connect(conn_.get_tcp_endpoint());
+				buffer.connect(conn_.get_tcp_endpoints(), inlet_connection::connect_head_start);
 				if (buffer.error()) throw buffer.error();
+				conn_.tcp_connected(buffer.remote_endpoint());
 
 				// --- protocol negotiation ---
 
@@ -161,19 +1136,61 @@ void data_receiver::data_thread() {
 				int data_protocol_version = 100;  // which protocol version we shall use for data
 												  // transmission (100=version 1.00)
 				bool suppress_subnormals = false; // whether we shall suppress subnormal numbers
+				bool delta_encoding = false; // whether the values are delta encoded
+				bool framed = false; // whether the chunks are sent as frames (see frame_flags)
+				// whether the frames only hold the changed values (see frame_changed_channels)
+				bool changed_channels = false;
+				bool sequence_numbers = false; // whether the samples carry sequence numbers
+				bool skip_test_patterns = false; // whether the outlet omits the test patterns
+				double heartbeat_interval = 0.0; // the interval of the outlet's heartbeats, if any
+				// whether the outlet takes new buffering parameters on this connection
+				bool live_reconfiguration = false;
+				// whether the outlet sends only the channel subset / decimates the samples for us
+				bool remote_subset = false;
+				uint32_t remote_decimation = 1;
+				// whether the outlet resamples / filters the samples for us
+				bool remote_resampling = false, remote_filter = false;
+				// the multicast feed of the samples, if the outlet sends them that way
+				std::unique_ptr<multicast_feed> multicast;
+				// the socket the datagrams are received on, and the key of the datagrams if the
+				// outlet sends them to this inlet only
+				asio::io_context datagram_io;
+				asio::ip::udp::socket datagram_socket(datagram_io);
+				uint64_t datagram_key = 0;
+				bool unicast_datagrams = false;
+				// the endpoint the outlet RDMA-writes the samples to, and the address of its own
+				std::unique_ptr<rdma_endpoint> rdma;
+				std::unique_ptr<rdma_address> rdma_remote;
+				// the ring an outlet on this host writes the samples into
+				std::unique_ptr<shm_ring> shm;
+				std::string shm_name;
+				const auto &channels = conn_.channel_subset();
+				// a different outlet (after recovering) has its own sequence numbers
+				if (last_seq_uid_ != conn_.current_uid()) {
+					last_seq_ = 0;
+					last_seq_uid_ = conn_.current_uid();
+					seq_known_ = false;
+				}
 
 				// propose to use the highest protocol version supported by both parties
 				int proposed_protocol_version =
-					std::min(api_config::get_instance()->use_protocol_version(),
+					std::min(config_->use_protocol_version,
 						conn_.type_info().version());
 				if (proposed_protocol_version >= 110) {
 					// request line LSL:streamfeed/[ProtocolVersion] [UID]\r\n
 					server_stream << "LSL:streamfeed/" << proposed_protocol_version << " "
 								  << conn_.current_uid() << "\r\n";
 					// transmit request parameters
-					server_stream << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
-					server_stream << "Endian-Performance: "
-								  << std::floor(measure_endian_performance()) << "\r\n";
+					if (config_->foreign_byte_order) {
+						// the outlet converts to the claimed byte order and we convert back
+						server_stream << "Native-Byte-Order: "
+									  << (BOOST_BYTE_ORDER == 1234 ? 4321 : 1234) << "\r\n";
+						server_stream << "Endian-Performance: 0\r\n";
+					} else {
+						server_stream << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
+						server_stream << "Endian-Performance: "
+									  << std::floor(measure_endian_performance()) << "\r\n";
+					}
 					server_stream << "Has-IEEE754-Floats: "
 								  << (format_ieee754[cft_float32] && format_ieee754[cft_double64])
 								  << "\r\n";
@@ -183,11 +1200,111 @@ void data_receiver::data_thread() {
 								  << "\r\n"; // 0 for strings
 					server_stream << "Data-Protocol-Version: " << proposed_protocol_version
 								  << "\r\n";
+					// this request already has the current buffering parameters
+					reconfigure_pending_ = false;
 					server_stream << "Max-Buffer-Length: " << max_buflen_ << "\r\n";
 					server_stream << "Max-Chunk-Length: " << max_chunklen_ << "\r\n";
+					server_stream << "Live-Reconfiguration: 1\r\n";
 					server_stream << "Hostname: " << conn_.type_info().hostname() << "\r\n";
 					server_stream << "Source-Id: " << conn_.type_info().source_id() << "\r\n";
 					server_stream << "Session-Id: " << conn_.type_info().session_id() << "\r\n";
+					if (config_->delta_encoding &&
+						conn_.type_info().channel_format() != cft_string)
+						server_stream << "Value-Encoding: delta\r\n";
+					else if (config_->changed_channel_encoding &&
+							 config_->sample_framing &&
+							 conn_.type_info().channel_format() != cft_string)
+						server_stream << "Value-Encoding: changed-channels\r\n";
+					if (config_->sample_framing &&
+						conn_.type_info().channel_format() != cft_string) {
+						server_stream << "Sample-Framing: chunks\r\n";
+						if (metadata_handler_) server_stream << "Metadata-Updates: 1\r\n";
+						server_stream << "End-Of-Stream: 1\r\n";
+						if (config_->heartbeat_interval > 0.0)
+							server_stream << "Heartbeat-Interval: " << config_->heartbeat_interval
+										  << "\r\n";
+					}
+					if (config_->sample_framing &&
+						config_->timestamp_deltas &&
+						conn_.type_info().channel_format() != cft_string)
+						server_stream << "Timestamp-Encoding: ns-delta\r\n";
+					server_stream << "Sequence-Numbers: 1\r\n";
+					if (config_->gap_detection) server_stream << "Gap-Detection: 1\r\n";
+					// the format agreement with this outlet was validated before
+					if (validated_.uid == conn_.current_uid())
+						server_stream << "Skip-Test-Patterns: 1\r\n";
+					if (last_seq_ || seq_known_)
+						server_stream << "Resume-From: " << last_seq_ + 1 << "\r\n";
+					else if (history_request_ > 0.0)
+						server_stream << "History-Seconds: " << history_request_ << "\r\n";
+					if (overflow_policy_ != ovf_drop_oldest) {
+						server_stream << "Overflow-Policy: "
+									  << consumer_queue::overflow_policy_name(overflow_policy_)
+									  << "\r\n";
+						server_stream << "Overflow-Parameter: " << overflow_parameter_ << "\r\n";
+					}
+					if (priority_ != prio_normal)
+						server_stream << "Priority: " << consumer_queue::priority_name(priority_)
+									  << "\r\n";
+					if (max_bytes_per_second_ > 0.0)
+						server_stream << "Max-Bytes-Per-Second: " << max_bytes_per_second_
+									  << "\r\n";
+					if (!channels.empty()) {
+						server_stream << "Channel-Subset: ";
+						for (std::size_t i = 0; i < channels.size(); ++i)
+							server_stream << (i ? "," : "") << channels[i];
+						server_stream << "\r\n";
+					}
+					if (conn_.decimation() > 1)
+						server_stream << "Decimation: " << conn_.decimation() << "\r\n";
+					if (resampler_ && rs.server_side)
+						server_stream << "Resampling: " << resampling_request << "\r\n";
+					if (!filter_.empty())
+						server_stream << "Value-Filter: " << filter_.to_string() << "\r\n";
+					// the datagrams carry the samples as they were pushed (and lost multicast
+					// datagrams are repaired from the outlet's history), so they're only possible
+					// for streams the outlet doesn't have to tailor for us
+					const bool datagrams_possible =
+						!datagrams_failed_ && conn_.type_info().channel_format() != cft_string &&
+						channels.empty() && conn_.decimation() <= 1 &&
+						!(resampler_ && rs.server_side) && filter_.empty() &&
+						(last_seq_ || seq_known_ || history_request_ <= 0.0);
+					if (datagrams_possible && rdma_ && !rdma_failed_ && rdma_available()) {
+						// the outlet writes them into this endpoint's ring (or sends them over
+						// TCP if it can't)
+						try {
+							rdma.reset(new rdma_endpoint(
+								rdma_sender::ring_slots, rdma_sender::slot_bytes));
+							rdma->post_receives();
+							server_stream << "RDMA-Endpoint: " << rdma->local().to_string()
+										  << "\r\n";
+						} catch (std::exception &e) {
+							ALOG_F(WARNING, "Could not open an RDMA endpoint: %s", e.what());
+							rdma.reset();
+							rdma_failed_ = true;
+						}
+					}
+					// outlets on this host write them into shared memory instead (and the others
+					// ignore the request)
+					if (datagrams_possible && shared_memory_ && !shared_memory_failed_ &&
+						shm_available())
+						server_stream << "Shared-Memory: 1\r\n";
+					if (!rdma && datagrams_possible && datagrams_) {
+						// the outlet sends them to this socket
+						const auto protocol = conn_.get_tcp_endpoint().address().is_v4()
+												  ? asio::ip::udp::v4()
+												  : asio::ip::udp::v6();
+						error_code ec;
+						datagram_socket.open(protocol, ec);
+						if (!ec) datagram_socket.bind(asio::ip::udp::endpoint(protocol, 0), ec);
+						if (!ec)
+							server_stream << "Datagram-Port: "
+										  << datagram_socket.local_endpoint().port() << "\r\n";
+						else
+							ALOG_F(WARNING, "Could not open a UDP socket for the datagrams: %s",
+								ec.message().c_str());
+					} else if (!rdma && datagrams_possible && multicast_)
+						server_stream << "Multicast-Data: 1\r\n";
 					server_stream << "\r\n" << std::flush;
 
 					// check server response line (LSL/[Version] [StatusCode] [Message])
@@ -198,7 +1315,7 @@ void data_receiver::data_thread() {
 					if (parts.size() < 3 || parts[0].compare(0, 4, "LSL/") != 0)
 						throw std::runtime_error("Received a malformed response.");
 					if (std::stoi(parts[0].substr(4)) / 100 >
-						api_config::get_instance()->use_protocol_version() / 100)
+						config_->use_protocol_version / 100)
 						throw std::runtime_error(
 							"The other party's protocol version is too new for this client; please "
 							"upgrade your LSL library.");
@@ -236,13 +1353,64 @@ void data_receiver::data_thread() {
 							}
 							if (type == "suppress-subnormals")
 								suppress_subnormals = lsl::from_string<bool>(rest);
+							if (type == "value-encoding") {
+								delta_encoding = (rest == "delta");
+								changed_channels = (rest == "changed-channels");
+							}
+							if (type == "sample-framing") framed = (rest == "chunks");
+							if (type == "heartbeat-interval")
+								heartbeat_interval = lsl::from_string<double>(rest);
+							if (type == "sequence-numbers")
+								sequence_numbers = lsl::from_string<bool>(rest);
+							if (type == "skip-test-patterns")
+								skip_test_patterns = lsl::from_string<bool>(rest);
+							if (type == "live-reconfiguration")
+								live_reconfiguration = lsl::from_string<bool>(rest);
+							if (type == "channel-subset") remote_subset = !channels.empty();
+							if (type == "decimation")
+								remote_decimation = static_cast<uint32_t>(std::stoul(rest));
+							if (type == "resampling")
+								remote_resampling = resampler_ && rest == resampling_request;
+							if (type == "value-filter") remote_filter = !filter_.empty();
+							if (type == "multicast-data") {
+								multicast.reset(new multicast_feed());
+								std::istringstream feed(rest);
+								if (!(feed >> multicast->address >> multicast->port >>
+										multicast->key))
+									throw std::runtime_error(
+										"Received a malformed multicast feed: " + rest);
+								// older outlets don't send where the feed started
+								multicast->start_known =
+									static_cast<bool>(feed >> multicast->start_seq);
+							}
+							if (type == "datagram-data") {
+								datagram_key = std::stoull(rest);
+								unicast_datagrams = true;
+							}
+							if (type == "rdma-data" && rdma) {
+								const auto space = rest.find(' ');
+								if (space == std::string::npos)
+									throw std::runtime_error(
+										"Received a malformed RDMA feed: " + rest);
+								datagram_key = std::stoull(rest.substr(0, space));
+								rdma_remote.reset(
+									new rdma_address(rdma_address::parse(rest.substr(space + 1))));
+							}
+							if (type == "shared-memory-data") {
+								const auto space = rest.find(' ');
+								if (space == std::string::npos)
+									throw std::runtime_error(
+										"Received a malformed shared memory feed: " + rest);
+								datagram_key = std::stoull(rest.substr(0, space));
+								shm_name = rest.substr(space + 1);
+							}
 							if (type == "uid" && rest != conn_.current_uid())
 								throw lost_error("The received UID does not match the current "
 												 "connection's UID.");
 							if (type == "data-protocol-version") {
 								data_protocol_version = std::stoi(rest);
 								if (data_protocol_version >
-									api_config::get_instance()->use_protocol_version())
+									config_->use_protocol_version)
 									throw std::runtime_error(
 										"The protocol version requested by the other party is not "
 										"supported by this client.");
@@ -256,6 +1424,11 @@ void data_receiver::data_thread() {
 					server_stream << max_buflen_ << " " << max_chunklen_ << "\r\n" << std::flush;
 				}
 
+#ifdef LSL_NO_PROTOCOL_100
+				if (data_protocol_version < 110)
+					throw std::runtime_error(
+						"Protocol 1.00 isn't supported by this build of liblsl.");
+#else
 				if (data_protocol_version == 100) {
 					// portable binary archive (parse archive header)
 					inarch.reset(new eos::portable_iarchive(server_stream));
@@ -269,60 +1442,281 @@ void data_receiver::data_thread() {
 						throw lost_error(
 							"The received UID does not match the current connection's UID.");
 				}
+#endif
+
+				// an outlet that doesn't know about channel subsets / decimation (e.g. an older
+				// version) sends all samples with all channels, so we pick them ourselves
+				const bool local_subset = !channels.empty() && !remote_subset;
+				const uint32_t local_decimation =
+					remote_decimation == conn_.decimation() ? 1 : conn_.decimation();
+				if (remote_resampling) resampler_.reset();
+				if (remote_filter) filter_ = value_filter();
+				const uint32_t wire_channels = local_subset ? conn_.source_channel_count()
+															: conn_.type_info().channel_count();
+				factory_p wire_factory;
+				if (local_subset)
+					wire_factory = lsl::factory::for_stream(conn_.type_info().channel_format(),
+						wire_channels, 16, config_->no_allocation);
 
 				// --- format validation ---
-				{
+				if (skip_test_patterns) {
+					// the outlet relies on the agreement we validated before, so it has to match
+					if (validated_.uid != conn_.current_uid() ||
+						validated_.data_protocol_version != data_protocol_version ||
+						validated_.use_byte_order != use_byte_order ||
+						validated_.wire_channels != wire_channels) {
+						validated_.uid.clear();
+						throw lost_error("The outlet skipped the test patterns for a format "
+										 "agreement that wasn't validated.");
+					}
+				} else {
 					// receive and parse two subsequent test-pattern samples and check if they are
 					// formatted as expected
-					lsl::factory fac(
-						conn_.type_info().channel_format(), conn_.type_info().channel_count(), 4);
+					lsl::factory fac(conn_.type_info().channel_format(), wire_channels, 4);
 
 					for (int test_pattern : {4, 2}) {
 						lsl::sample_p expected(fac.new_sample(0.0, false)),
 							received(fac.new_sample(0.0, false));
 						expected->assign_test_pattern(test_pattern);
-						if (data_protocol_version >= 110)
+#ifndef LSL_NO_PROTOCOL_100
+						if (data_protocol_version < 110)
+							*inarch >> *received;
+						else
+#endif
 							received->load_streambuf(
 								buffer, data_protocol_version, use_byte_order, suppress_subnormals);
-						else
-							*inarch >> *received;
 
 						if (*expected.get() != *received.get())
 							throw std::runtime_error(
 								"The received test-pattern samples do not match the specification."
 								" The protocol formats are likely incompatible.");
 					}
+					validated_ = {conn_.current_uid(), data_protocol_version, use_byte_order,
+						wire_channels};
+				}
+
+				// join the group before signaling the connection: the samples sent before the first
+				// datagram that arrives aren't repaired
+				if (multicast) {
+					try {
+						const api_config *cfg = api_config::get_instance();
+						if (datagram_socket.is_open()) datagram_socket.close();
+						open_multicast_socket(datagram_socket,
+							asio::ip::make_address(multicast->address), multicast->port,
+							cfg->multicast_ttl(), cfg->listen_address());
+						datagram_key = multicast->key;
+						// the samples pushed since the feed started are repaired if their
+						// datagrams don't arrive, or resumed over TCP if none do
+						if (multicast->start_known && !last_seq_ && !seq_known_) {
+							last_seq_ = multicast->start_seq;
+							seq_known_ = true;
+						}
+					} catch (std::exception &e) {
+						ALOG_F(WARNING, "Could not join the multicast group %s: %s",
+							multicast->address.c_str(), e.what());
+						datagrams_failed_ = true;
+						continue;
+					}
+				}
+
+				if (!shm_name.empty()) {
+					try {
+						shm.reset(new shm_ring(shm_name));
+					} catch (std::exception &e) {
+						ALOG_F(WARNING, "Could not open the shared memory feed: %s", e.what());
+						shared_memory_failed_ = true;
+						continue;
+					}
+				}
+
+				if (rdma_remote) {
+					try {
+						rdma->connect(*rdma_remote);
+					} catch (std::exception &e) {
+						ALOG_F(WARNING, "Could not connect the RDMA endpoint: %s", e.what());
+						rdma_failed_ = true;
+						continue;
+					}
 				}
 
 				// signal to accessor functions on other threads that the protocol negotiation has
 				// been successful, so we're now connected (and remain to be even if we later
 				// recover silently)
-				{
-					std::lock_guard<std::mutex> lock(connected_mut_);
-					connected_ = true;
+				set_connected();
+				reconnect_delay = min_reconnect_delay;
+
+				if (shm) {
+					if (!receive_shm(buffer, *shm, datagram_key, suppress_subnormals,
+							last_timestamp)) {
+						ALOG_F(WARNING,
+							"%s: the shared memory feed stopped; receiving the samples over TCP "
+							"instead",
+							conn_.type_info().name().c_str());
+						shared_memory_failed_ = true;
+					}
+					continue;
+				}
+
+				if (rdma_remote) {
+					if (!receive_rdma(buffer, *rdma, datagram_key, use_byte_order,
+							suppress_subnormals, last_timestamp)) {
+						ALOG_F(WARNING,
+							"%s: the RDMA writes stopped arriving; receiving the samples over TCP "
+							"instead",
+							conn_.type_info().name().c_str());
+						rdma_failed_ = true;
+					}
+					continue;
+				}
+
+				if (multicast || unicast_datagrams) {
+					if (!receive_datagrams(buffer, datagram_io, datagram_socket, datagram_key,
+							multicast != nullptr, use_byte_order, suppress_subnormals,
+							last_timestamp)) {
+						ALOG_F(WARNING,
+							"%s: the datagrams stopped arriving; receiving the samples over TCP "
+							"instead",
+							conn_.type_info().name().c_str());
+						datagrams_failed_ = true;
+					}
+					continue;
 				}
-				connected_upd_.notify_all();
 
 				// --- transmission loop ---
 
-				double last_timestamp = 0.0;
 				double srate = conn_.current_srate();
+				// samples that have already been received are decoded and queued as one batch
+				std::vector<sample_p> batch;
+				batch.reserve(max_batch_samples);
+				// the samples of the frame or the single sample that was just read, and the
+				// buffer for the frame bodies
+				std::vector<sample_p> decoded;
+				std::vector<char> frame_body;
+				// the previously received channel values, for the delta and changed-channels
+				// encodings
+				std::vector<char> delta_prev;
+				// the bytes of this connection that were already counted
+				uint64_t bytes_counted = 0;
+				if (delta_encoding || changed_channels)
+					delta_prev.resize(
+						format_sizes[conn_.type_info().channel_format()] * wire_channels, 0);
+				// checks a sample's sequence number (0 if unknown), false if it's been received
+				const auto fresh = [&](uint64_t seq) {
+					if (!seq) return true;
+					// skip samples we already got before the connection broke off
+					if (seq <= last_seq_) return false;
+					// (the outlet skips the samples its value filter rejects)
+					if (last_seq_ && seq > last_seq_ + remote_decimation && !remote_filter) {
+						ALOG_F(INFO, "%s: %llu samples were dropped by the outlet",
+							conn_.type_info().name().c_str(),
+							static_cast<unsigned long long>(seq - last_seq_ - 1));
+						// (counted in samples of the decimated stream)
+						samples_skipped_.fetch_add((seq - last_seq_ - remote_decimation) /
+													   std::max(conn_.decimation(), 1u),
+							std::memory_order_relaxed);
+					}
+					last_seq_ = seq;
+					return true;
+				};
+				// acts on the control frames (see control_message)
+				const auto handle_control = [&](uint8_t control) {
+					if (control == control_metadata_patch && metadata_handler_)
+						metadata_handler_(std::string(frame_body.begin(), frame_body.end()));
+					// start recovering right away instead of waiting for the watchdog
+					if (control == control_end_of_stream)
+						throw lost_error("The outlet has ended the stream.");
+				};
+				// a connection that stays silent for a few heartbeats is broken
+				buffer.set_receive_timeout(framed && heartbeat_interval > 0.0
+											   ? heartbeat_misses * heartbeat_interval
+											   : 0.0);
+				// whether the frames can be passed on as they are to a raw chunk callback
+				const bool raw_frames = framed && !local_subset && local_decimation == 1 &&
+										filter_.empty() && !resampler_;
+				frame_view raw_frame;
 				for (int k = 0; !conn_.lost() && !conn_.shutdown() && !closing_stream_; k++) {
-					// allocate and fetch a new sample
-					sample_p samp(factory->new_sample(0.0, false));
-					if (data_protocol_version >= 110)
-						samp->load_streambuf(
-							buffer, data_protocol_version, use_byte_order, suppress_subnormals);
-					else
-						*inarch >> *samp;
-					// deduce timestamp if necessary
-					if (samp->timestamp == DEDUCED_TIMESTAMP) {
-						samp->timestamp = last_timestamp;
-						if (srate != IRREGULAR_RATE) samp->timestamp += 1.0 / srate;
+					do {
+						decoded.clear();
+						if (raw_frames) {
+							// the frame is read before it's decided how it's passed on, so a raw
+							// chunk callback that's set while waiting for it gets it as well
+							const uint8_t control = read_frame_view(buffer,
+								conn_.type_info().channel_format(), wire_channels, use_byte_order,
+								suppress_subnormals, frame_body, raw_frame,
+								changed_channels ? delta_prev.data() : nullptr);
+							handle_control(control);
+							if (control || !raw_frame.count) continue;
+							if (raw_chunk_callback_.is_set() && !sample_callback_.is_set() &&
+								!track_latency_ && batch.empty()) {
+								// the values of the whole chunk are handed over as they are
+								// (the samples that were already received come first)
+								std::size_t skip = 0;
+								for (uint64_t seq : raw_frame.seqs)
+									if (!fresh(seq) && skip < raw_frame.count) ++skip;
+								LSL_TRACE("decoded", last_seq_uid_, last_seq_);
+								deliver_frame(raw_frame, skip, srate, last_timestamp);
+							} else
+								append_frame_samples(raw_frame, *factory,
+									conn_.type_info().channel_format(), wire_channels, decoded);
+						} else if (framed) {
+							// a whole chunk at once, or a control message
+							const uint8_t control = read_frame(buffer,
+								local_subset ? *wire_factory : *factory,
+								conn_.type_info().channel_format(), wire_channels, use_byte_order,
+								suppress_subnormals, frame_body, decoded,
+								changed_channels ? delta_prev.data() : nullptr);
+							handle_control(control);
+						} else {
+							uint64_t seq = 0;
+							if (sequence_numbers) {
+								if (buffer.sgetn(reinterpret_cast<char *>(&seq), sizeof(seq)) !=
+									sizeof(seq))
+									throw std::runtime_error("Input stream error.");
+								lslboost::endian::little_to_native_inplace(seq);
+							}
+							// allocate and fetch a new sample
+							sample_p samp(
+								(local_subset ? wire_factory : factory)->new_sample(0.0, false));
+							if (delta_encoding)
+								samp->load_streambuf_delta(
+									buffer, use_byte_order, suppress_subnormals, delta_prev.data());
+							else if (data_protocol_version >= 110)
+								samp->load_streambuf(buffer, data_protocol_version, use_byte_order,
+									suppress_subnormals);
+							else
+								samp->load_portable(buffer);
+							samp->seq = seq;
+							decoded.push_back(std::move(samp));
+						}
+						for (sample_p &samp : decoded) {
+							const uint64_t seq = samp->seq;
+							if (local_subset) {
+								sample_p subset(
+									factory->new_sample(samp->timestamp, samp->pushthrough));
+								subset->assign_channels(*samp, channels.data());
+								subset->seq = seq;
+								samp = std::move(subset);
+							}
+							if (!fresh(seq)) continue;
+							LSL_TRACE("decoded", last_seq_uid_, seq);
+							batch.push_back(std::move(samp));
+						}
+					} while (batch.size() < max_batch_samples && buffer.in_avail() > 0);
+					bytes_received_.fetch_add(
+						buffer.bytes_received() - bytes_counted, std::memory_order_relaxed);
+					bytes_counted = buffer.bytes_received();
+					receive_buffer_bytes_.store(
+						buffer.receive_buffer_bytes(), std::memory_order_relaxed);
+					if (!batch.empty())
+						deliver_batch(batch, srate, last_timestamp, local_decimation);
+					// the outlet changes the chunking and its queue from its next chunk on
+					if (reconfigure_pending_.load(std::memory_order_relaxed) &&
+						live_reconfiguration && reconfigure_pending_.exchange(false)) {
+						std::ostream request(&buffer);
+						request << "LSL:reconfigure " << max_buflen_ << " " << max_chunklen_
+								<< "\r\n"
+								<< std::flush;
 					}
-					last_timestamp = samp->timestamp;
-					// push it into the sample queue
-					sample_queue_.push_sample(samp);
 					// periodically update the last receive time to keep the watchdog happy
 					if (srate <= 16 || (k & 0xF) == 0) conn_.update_receive_time(lsl_clock());
 				}
@@ -339,16 +1733,17 @@ void data_receiver::data_thread() {
 				// some perhaps more serious transmission or parsing error (could be indicative of a
 				// protocol issue)
 				if (!conn_.shutdown())
-					LOG_F(ERROR, "Stream transmission broke off (%s); re-connecting...", e.what());
+					ALOG_F(ERROR, "Stream transmission broke off (%s); re-connecting...", e.what());
 				conn_.try_recover_from_error();
 			}
-			// wait for a few msec so as to not spam the provider with reconnects
-			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			// wait a bit so as to not spam the provider with reconnects
+			sleep_precise(reconnect_delay);
+			reconnect_delay = std::min(reconnect_delay * 2, max_reconnect_delay);
 		}
 	} catch (lost_error &) {
 		// the connection was irrecoverably lost: since the pull_sample() function may
 		// be waiting for the next sample we need to wake it up by passing a sentinel
-		sample_queue_.push_sample(sample_p());
+		deliver_samples(nullptr, 0);
 	}
 	conn_.release_watchdog();
 }
@@ -4,15 +4,100 @@
 #include "cancellation.h"
 #include "common.h"
 #include "consumer_queue.h"
+#include "cpu_account.h"
 #include "forward.h"
+#include "latency_histogram.h"
+#include "socket_utils.h"
+#include "stream_config.h"
+#include "thread_policy.h"
+#include "value_filter.h"
 #include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace lsl {
 
+class calibration;
+
+/**
+ * A function that's set from any thread and called from the data thread without holding a lock,
+ * so the function itself can replace or remove it.
+ */
+template <class F> class callback_slot {
+public:
+	/**
+	 * Replace the function, or remove it with an empty one.
+	 *
+	 * Once this returns, the previous function won't be called anymore; unless it's called from
+	 * the function itself, it waits for a running call to finish.
+	 */
+	void set(F f) {
+		std::unique_lock<std::mutex> lock(mut_);
+		fn_ = f ? std::make_shared<const F>(std::move(f)) : nullptr;
+		set_ = static_cast<bool>(fn_);
+		if (caller_ != std::this_thread::get_id())
+			idle_.wait(lock, [this]() { return caller_ == std::thread::id(); });
+	}
+
+	/// Whether a function is set (a single relaxed load, to skip the lock otherwise).
+	bool is_set() const { return set_.load(std::memory_order_relaxed); }
+
+	/// Call the function with the arguments; returns false if there's none.
+	template <class... Args> bool call(Args &&...args) {
+		std::shared_ptr<const F> fn;
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			if (!fn_) return false;
+			fn = fn_;
+			caller_ = std::this_thread::get_id();
+		}
+		struct end_call {
+			callback_slot &slot;
+			~end_call() {
+				{
+					std::lock_guard<std::mutex> lock(slot.mut_);
+					slot.caller_ = std::thread::id();
+				}
+				slot.idle_.notify_all();
+			}
+		} end{*this};
+		(*fn)(std::forward<Args>(args)...);
+		return true;
+	}
+
+private:
+	std::shared_ptr<const F> fn_;
+	std::atomic<bool> set_{false};
+	/// the thread that's calling the function, if any
+	std::thread::id caller_;
+	std::mutex mut_;
+	/// signaled when a call has ended
+	std::condition_variable idle_;
+};
 class inlet_connection; // Forward declaration
+class cancellable_streambuf;
+class rdma_endpoint;
+class shm_ring;
+class resampler;
+struct local_feed;
+struct frame_view;
+
+/// Samples borrowed from an inlet's queue without copying them (see data_receiver::borrow_samples).
+struct sample_view {
+	/// the factory of the samples, kept alive until the samples are released
+	factory_p sample_factory;
+	/// the borrowed samples
+	std::vector<sample_p> samples;
+	/// the time stamps of the samples (post-processed by the inlet)
+	std::vector<double> timestamps;
+};
 
 /** Internal class of an inlet that's retrieving the data (the samples) of the inlet.
  *
@@ -35,8 +120,10 @@ public:
 	 * (the default corresponds to the chunk sizes used by the sender). Recording applications can
 	 * use a generous size here (leaving it to the network how to pack things), while real-time
 	 * applications may want a finer (perhaps 1-sample) granularity.
+	 * @param config The settings of the stream, by default a snapshot of the configuration file's.
 	 */
-	data_receiver(inlet_connection &conn, int max_buflen = 360, int max_chunklen = 0);
+	data_receiver(inlet_connection &conn, int max_buflen = 360, int max_chunklen = 0,
+		stream_config_p config = nullptr);
 
 	/// Destructor. Stops the background activities.
 	~data_receiver();
@@ -52,6 +139,10 @@ public:
 	 */
 	void open_stream(double timeout = FOREVER);
 
+	/// Start connecting to the outlet without waiting for the connection, so that several
+	/// receivers can connect at the same time; a later open_stream() waits for it.
+	void begin_open();
+
 	/**
 	 * Close the current data stream.
 	 * All samples still buffered or in flight will be dropped and the source will halt its
@@ -61,33 +152,439 @@ public:
 	 */
 	void close_stream();
 
-	/// Retrieve a sample from the sample queue and assign its contents to the given typed buffer.
+	/**
+	 * Retrieve a sample from the sample queue and assign its contents to the given typed buffer.
+	 *
+	 * The outcomes of polling a stream are returned instead of thrown, so frequent pulls with
+	 * short timeouts (and pulls from a lost stream) stay cheap.
+	 * @param[out] timestamp The (unprocessed) time stamp of the sample, 0.0 if none arrived in
+	 * time.
+	 * @return lsl_no_error (also if the timeout expired), lsl_lost_error if the stream has been
+	 * lost, or lsl_argument_error if the buffer doesn't match the number of channels.
+	 */
+	template <class T>
+	lsl_error_code_t try_pull_sample_typed(
+		T *buffer, uint32_t buffer_elements, double timeout, double &timestamp);
+
+	/// Retrieve a sample like try_pull_sample_typed().
+	/// @throws lost_error or std::range_error instead of returning the error codes.
 	template <class T>
 	double pull_sample_typed(T *buffer, uint32_t buffer_elements, double timeout = FOREVER);
 
+	/**
+	 * Retrieve up to max_samples samples from the sample queue in one go.
+	 *
+	 * The sample queue is drained in batches under a single lock per batch, so this is
+	 * considerably cheaper than calling pull_sample_typed() once per sample.
+	 * @param data_buffer A buffer for max_samples * channel_count values, in multiplexed order.
+	 * @param timestamp_buffer A buffer for max_samples (unprocessed) time stamps, or nullptr.
+	 * @param max_samples The maximum number of samples to retrieve.
+	 * @param timeout If greater than 0, wait up to this many seconds for the buffer to fill up.
+	 * @param planar Store the values in channel-major order instead, i.e. channel_count arrays of
+	 * max_samples values.
+	 * @param[out] samples_written The number of samples written to the buffers.
+	 * @return lsl_no_error, or lsl_lost_error if the stream has been lost before any sample was
+	 * written.
+	 */
+	template <class T>
+	lsl_error_code_t try_pull_chunk_typed(T *data_buffer, double *timestamp_buffer,
+		uint32_t max_samples, double timeout, bool planar, uint32_t &samples_written);
+
+	/// Retrieve samples like try_pull_chunk_typed().
+	/// @return The number of samples written to the buffers.
+	/// @throws lost_error instead of returning the error code.
+	template <class T>
+	uint32_t pull_chunk_typed(T *data_buffer, double *timestamp_buffer, uint32_t max_samples,
+		double timeout = 0.0, bool planar = false);
+
+	/// Retrieve a sample into a pointer to raw data, with the results of try_pull_sample_typed().
+	lsl_error_code_t try_pull_sample_untyped(
+		void *buffer, int buffer_bytes, double timeout, double &timestamp);
+
 	/// Read sample from the inlet and read it into a pointer to raw data.
 	double pull_sample_untyped(void *buffer, int buffer_bytes, double timeout = FOREVER);
 
+	/// Throw the exception for an error code of the try_pull functions (if it's an error).
+	/// @param mismatch The message for lsl_argument_error.
+	static void throw_pull_error(lsl_error_code_t ec,
+		const char *mismatch = "The buffer does not match the stream's channels.");
+
+	/**
+	 * Take up to max_samples samples from the sample queue without copying their data.
+	 *
+	 * Samples previously held by the view are released.
+	 * @param view The view to hold the samples and their (unprocessed) time stamps.
+	 * @param max_samples The maximum number of samples to take.
+	 * @param timeout If greater than 0, wait up to this many seconds for max_samples samples.
+	 * @return The number of samples in the view.
+	 * @throws std::invalid_argument for string-formatted streams.
+	 */
+	uint32_t borrow_samples(sample_view &view, uint32_t max_samples, double timeout = 0.0);
+
 	/// Check whether the underlying buffer is empty. This value may be inaccurate.
 	bool empty() { return sample_queue_.empty(); }
 
 	std::size_t samples_available() { return sample_queue_.read_available(); }
 
+	/// Fill in the receive statistics (all but the time correction), see lsl_get_inlet_stats().
+	void get_stats(lsl_inlet_stats &stats);
+
+	/// The number of samples dropped so far because the inlet's buffer was full.
+	uint64_t samples_dropped() const { return sample_queue_.dropped(); }
+
+	/// The number of samples (of the pulled stream) that never arrived so far, e.g. because they
+	/// were lost in transit, while the connection was broken off or dropped by the outlet.
+	uint64_t samples_missing() const {
+		return samples_lost_.load(std::memory_order_relaxed) +
+			   samples_skipped_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * The samples dropped and missing (see samples_dropped(), samples_missing()) before the
+	 * newest sample pulled so far, i.e., without those before samples still in the buffer.
+	 *
+	 * Called from the thread that pulls the samples.
+	 */
+	uint64_t dropped_pulled() const { return dropped_pulled_; }
+	uint64_t missing_pulled() const { return missing_pulled_; }
+
+	/**
+	 * Set the function that gets the current time correction of the stream (local minus remote
+	 * time) for the latency tracking; it returns false if there's no estimate yet.
+	 *
+	 * Must be set before the data thread is started.
+	 */
+	void set_time_correction_source(std::function<bool(double &)> source) {
+		time_correction_source_ = std::move(source);
+	}
+
+	/**
+	 * Set the function that gets the metadata patches (see stream_info_impl::desc_patch()) the
+	 * outlet sends over the data connection; it's called from the data thread.
+	 *
+	 * Must be set before the data thread is started.
+	 */
+	void set_metadata_handler(std::function<void(const std::string &patch)> handler) {
+		metadata_handler_ = std::move(handler);
+	}
+
+	/// Start (with empty histograms) or stop recording the latencies, see lsl_track_latency().
+	void track_latency(bool enabled);
+
 	/// Flush the queue, return the number of dropped samples
 	uint32_t flush() noexcept { return sample_queue_.flush(); }
 
+	/// Set how long pull calls spin before blocking, see consumer_queue::set_spin_time().
+	void set_spin_time(double seconds) { sample_queue_.set_spin_time(seconds); }
+
+	/**
+	 * Let blocking chunk pulls return once min_samples samples are there instead of waiting for
+	 * a full buffer, see consumer_queue::pop_samples(); 0 to wait for a full buffer.
+	 */
+	void set_pull_min_samples(uint32_t min_samples) { pull_min_samples_ = min_samples; }
+
+	/// Ask the outlet for the samples it pushed in the last seconds when first connecting.
+	void request_history(double seconds) { history_request_ = seconds; }
+
+	/// Ask the outlet to handle a full buffer according to a policy (from the next connection on).
+	/// With ovf_latest, the sample queue only keeps the newest sample, too (right away).
+	void set_overflow_policy(lsl_overflow_policy_t policy, double parameter) {
+		overflow_parameter_ = parameter;
+		overflow_policy_ = policy;
+		sample_queue_.set_overflow_policy(policy == ovf_latest ? ovf_latest : ovf_drop_oldest);
+	}
+
+	/**
+	 * Change the buffering parameters of the constructor without reconnecting.
+	 *
+	 * The sample queue drops the oldest samples beyond max_buflen right away; it can't grow
+	 * beyond the max_buflen it was created with. An outlet that supports it changes its queue
+	 * for this inlet and the chunking with its next chunk, otherwise the new values apply from
+	 * the next connection on.
+	 * @throws std::invalid_argument if one of the values is negative.
+	 */
+	void set_buffering(int max_buflen, int max_chunklen);
+
+	/// Ask the outlet to serve the connection with a priority (from the next connection on).
+	void set_priority(lsl_transfer_priority_t priority) { priority_ = priority; }
+
+	/// Ask the outlet to limit the connection's bandwidth (from the next connection on).
+	void set_max_bandwidth(double bytes_per_second) { max_bytes_per_second_ = bytes_per_second; }
+
+	/**
+	 * Set the options of the data connection's socket (from the next connection on).
+	 *
+	 * Negative values keep the current setting, see lsl_set_inlet_socket_options().
+	 */
+	void set_socket_options(int32_t send_buffer_bytes, int32_t receive_buffer_bytes,
+		int32_t no_delay, int32_t busy_poll_us) {
+		std::lock_guard<std::mutex> lock(socket_options_mut_);
+		socket_options_ = socket_options_.updated(
+			send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us);
+	}
+
+	/**
+	 * Ask the outlet to send the samples by multicast (from the next connection on).
+	 *
+	 * The stream falls back to the TCP connection if the multicast datagrams don't arrive.
+	 */
+	void set_multicast(bool enabled) {
+		datagrams_failed_ = false;
+		multicast_ = enabled;
+	}
+
+	/**
+	 * Ask the outlet to send the samples as datagrams that aren't retransmitted when lost (from
+	 * the next connection on), see lsl_set_inlet_datagrams().
+	 *
+	 * The stream falls back to the TCP connection if the datagrams don't arrive.
+	 */
+	void set_datagrams(bool enabled) {
+		datagrams_failed_ = false;
+		datagrams_ = enabled;
+	}
+
+	/**
+	 * Take the samples straight from the outlet's send buffer if the outlet is in the same process
+	 * (from the next connection on), see lsl_set_inlet_in_process().
+	 */
+	void set_in_process(bool enabled) { in_process_ = enabled; }
+
+	/**
+	 * Receive the samples over the connection shared by the streams of the outlet's process (from
+	 * the next connection on), see lsl_set_inlet_bundling().
+	 */
+	void set_bundling(bool enabled) { bundling_ = enabled; }
+
+	/**
+	 * Ask outlets on this host to pass the samples through shared memory (from the next
+	 * connection on), see lsl_set_inlet_shared_memory().
+	 */
+	void set_shared_memory(bool enabled) {
+		shared_memory_failed_ = false;
+		shared_memory_ = enabled;
+	}
+
+	/**
+	 * Resample the stream to up/down times its rate (from the next connection on), see
+	 * lsl_set_inlet_resampling(); 1/1 to receive the samples as they are.
+	 * @param server_side Whether to let the outlet resample the stream if it supports that.
+	 * @throws std::invalid_argument if the stream can't be resampled (see resampler) or is
+	 * decimated.
+	 */
+	void set_resampling(uint32_t up, uint32_t down, bool server_side);
+
+	/// The factor the stream's rate is converted by (see set_resampling()).
+	double resampling_ratio() const { return resampling_ratio_; }
+
+	/**
+	 * Receive only the samples whose first channel matches a filter (from the next connection
+	 * on), see lsl_set_inlet_value_filter(); an empty filter to receive all samples.
+	 * @throws std::invalid_argument if the filter doesn't fit the stream's format.
+	 */
+	void set_value_filter(value_filter filter);
+
+	/// Calibrate the channel values of pulls into float and double buffers (see calibration), or
+	/// stop calibrating them with a null pointer.
+	void set_calibration(std::shared_ptr<const calibration> calib);
+
+	/// Start the data thread if it isn't running yet, without waiting for the connection.
+	void start_thread();
+
+	/**
+	 * Set a function that is called (from the data thread) after arm_notification() once new
+	 * samples have been queued, or remove it with an empty function.
+	 *
+	 * Once this returns, the previous function won't be called anymore.
+	 */
+	void set_notification(std::function<void()> callback);
+
+	/// Request a single notification, see consumer_queue::arm_notification().
+	bool arm_notification(std::size_t min_samples) {
+		return sample_queue_.arm_notification(min_samples);
+	}
+
+	/// A function that is called once the samples it waits for are available (or will never be).
+	using wait_handler = std::function<void(bool lost)>;
+
+	/**
+	 * Call a function once at least min_samples samples are available for pickup.
+	 *
+	 * The function is called exactly once: right away if the samples are available already,
+	 * otherwise from the data thread once they arrive. If the stream gets lost or the receiver is
+	 * destroyed first, it is called with `lost` set to true. This starts the data thread if
+	 * necessary.
+	 */
+	void async_wait(std::size_t min_samples, wait_handler handler);
+
+	/// A function that receives samples directly from the data thread.
+	using sample_callback = std::function<void(const sample_p *samples, std::size_t n)>;
+
+	/**
+	 * Hand received samples to a function (called from the data thread) instead of queueing them,
+	 * or queue them again if the function is empty.
+	 *
+	 * The function gets called with no samples once the stream has been lost. Once this returns,
+	 * the previous function won't be called anymore. This starts the data thread if necessary.
+	 */
+	void set_sample_callback(sample_callback callback);
+
+	/**
+	 * A function that receives blocks of samples directly from the data thread: the channel
+	 * values of n samples back to back (in the machine's byte order) and their time stamps, which
+	 * can be processed in place.
+	 */
+	using raw_chunk_callback =
+		std::function<void(const char *values, std::size_t num_bytes, std::size_t n,
+			double *timestamps)>;
+
+	/**
+	 * Hand the received samples to a function as blocks of values instead of queueing them, or
+	 * queue them again if the function is empty.
+	 *
+	 * The values of framed feeds (see read_frame_view()) are passed on straight from the frame
+	 * body, unless the inlet has to decimate, filter or resample the samples or tracks their
+	 * latencies; otherwise, the decoded samples are copied into a block. The function gets called
+	 * with no samples once the stream has been lost. A sample callback takes precedence. Once
+	 * this returns, the previous function won't be called anymore. This starts the data thread
+	 * if necessary.
+	 */
+	void set_raw_chunk_callback(raw_chunk_callback callback);
+
+	/// A function that post-processes n time stamps in place.
+	using timestamp_processor = std::function<void(double *timestamps, std::size_t n)>;
+
+	/**
+	 * Post-process the time stamps of the received samples on the data thread, before they're
+	 * queued or handed to the sample callback, or stop doing so if the function is empty.
+	 *
+	 * The decoded chunks are processed at once, after the latencies were recorded.
+	 */
+	void set_timestamp_processor(timestamp_processor processor);
+
 private:
+	/// The multicast group, port and key an outlet sends the samples to (see datagram_sender).
+	struct multicast_feed {
+		std::string address;
+		uint16_t port;
+		uint64_t key;
+		/// the sequence number of the last sample pushed before the feed started (if the outlet
+		/// sends it): the samples after it are repaired if their datagrams don't arrive
+		uint64_t start_seq;
+		bool start_known;
+	};
+
+	/// Start the data reader thread.
+	void spawn_data_thread();
+
 	/// The data reader thread.
 	void data_thread();
 
+	/**
+	 * Receive the samples from a datagram feed (see datagram_sender).
+	 * @param repair Whether lost samples are requested again over the data connection (for
+	 * multicast feeds), otherwise they're only counted.
+	 * @return false if the datagrams stopped arriving while the data connection is still alive,
+	 * so the samples should be received over the data connection instead.
+	 */
+	bool receive_datagrams(cancellable_streambuf &buffer, asio::io_context &io,
+		asio::ip::udp::socket &sock, uint64_t key, bool repair, int use_byte_order,
+		bool suppress_subnormals, double &last_timestamp);
+
+	/**
+	 * Receive the samples an outlet RDMA-writes into an endpoint's ring (see rdma_sender).
+	 * @return false if the slots stopped arriving (or the RDMA connection failed) while the data
+	 * connection is still alive, so the samples should be received over the data connection.
+	 */
+	bool receive_rdma(cancellable_streambuf &buffer, rdma_endpoint &rdma, uint64_t key,
+		int use_byte_order, bool suppress_subnormals, double &last_timestamp);
+
+	/**
+	 * Receive the samples an outlet on this host writes into a shared memory ring (see
+	 * shm_sender), waiting for its wakeups on the data connection while the ring is empty.
+	 * @return false if the slots stopped arriving while the data connection is still alive, so
+	 * the samples should be received over the data connection.
+	 */
+	bool receive_shm(cancellable_streambuf &buffer, shm_ring &ring, uint64_t key,
+		bool suppress_subnormals, double &last_timestamp);
+
+	/**
+	 * Decode a datagram (or RDMA slot) and add its new samples to a batch, after repairing or
+	 * counting the samples that were lost before them.
+	 * @return false if the datagram belongs to a different stream or is malformed.
+	 */
+	bool process_datagram(std::streambuf &datagram, uint64_t key, bool repair,
+		cancellable_streambuf &buffer, int use_byte_order, bool suppress_subnormals,
+		std::vector<sample_p> &batch);
+
+	/**
+	 * Receive the samples of an outlet in this process from a queue of its send buffer.
+	 *
+	 * The samples are shared with the outlet. Those with a deduced time stamp (which the inlet
+	 * fills in) and, while latencies are tracked, all of them (for the receive times) are copied.
+	 * @throws lost_error if the outlet goes away.
+	 */
+	void receive_local(const local_feed &feed, double &last_timestamp);
+
+	/**
+	 * Receive the samples over the bundled connection to the outlet's host (see bundle_client).
+	 * @return false if the stream can't be received that way, so it needs a connection of its own.
+	 * @throws lost_error if the outlet or the bundled connection goes away.
+	 */
+	bool receive_bundled(double &last_timestamp);
+
+	/// Signal the threads waiting in open_stream() that the stream is connected.
+	void set_connected();
+
+	/// Request the samples [first, last] from the outlet and append them to the batch.
+	void repair_samples(cancellable_streambuf &buffer, uint64_t first, uint64_t last,
+		int use_byte_order, bool suppress_subnormals, std::vector<sample_p> &batch);
+
+	/// Count a batch of received samples, deduce their time stamps, filter and resample them (if
+	/// the outlet doesn't) and deliver them.
+	void deliver_batch(std::vector<sample_p> &batch, double srate, double &last_timestamp,
+		uint32_t local_decimation);
+
+	/// Queue received samples or hand them to the sample callback.
+	void deliver_samples(const sample_p *samples, std::size_t n);
+
+	/// Count the samples of a frame that are passed on as a block, deduce and process their time
+	/// stamps and hand them to the raw chunk callback, skipping the first `skip` samples.
+	void deliver_frame(frame_view &frame, std::size_t skip, double srate, double &last_timestamp);
+
+	/// Hand a block of values to the raw chunk callback.
+	/// @return false if there is none.
+	bool deliver_raw(const char *values, std::size_t num_bytes, std::size_t n, double *timestamps);
+
+	/// Call the async_wait() handlers whose samples are available and re-arm the notification.
+	void check_waits();
+
+	/// Record the latencies of received samples and note when they were received.
+	void record_latency(const sample_p *samples, std::size_t n);
+
+	/// Record how long pulled samples waited in the sample queue.
+	void record_residence(const sample_p *samples, std::size_t n);
+
+	/// Note the gaps before the newest of n samples just pushed into the sample queue, with
+	/// gap_mut_ held.
+	void mark_gaps(const sample_p *samples, std::size_t n);
+
+	/// Account for the gaps before the newest of n pulled samples, see dropped_pulled().
+	void account_gaps(const sample_p *samples, std::size_t n);
+
 	/// the underlying connection
 	inlet_connection &conn_;
+	/// the stream's settings, as of the receiver's construction
+	const stream_config_p config_;
 
 	// fields related to the data reader thread
 	/// a factory to create samples of appropriate type
 	factory_p sample_factory_;
+	/// the factories of the outlets in this process whose samples were received, they have to
+	/// outlive the sample queue
+	std::vector<factory_p> local_factories_;
 	/// background read thread
-	std::thread data_thread_;
+	managed_thread data_thread_;
 	/// whether we need to check whether the thread has been started
 	bool check_thread_start_;
 	/// indicates to the data thread that it a close has been requested
@@ -100,12 +597,130 @@ private:
 	std::mutex connected_mut_;
 	/// condition variable to indicate that an update for the connected state is available
 	std::condition_variable connected_upd_;
+	/// the function to call when the sample queue's notification fires
+	std::function<void()> notification_;
+	/// pending async_wait() handlers and the number of samples they wait for
+	std::vector<std::pair<std::size_t, wait_handler>> waits_;
+	/// protects the notification function and the pending handlers
+	std::mutex notification_mut_;
+	/// receives the samples instead of the sample queue, if set
+	callback_slot<sample_callback> sample_callback_;
+	/// receives blocks of samples instead of the sample queue, if set
+	callback_slot<raw_chunk_callback> raw_chunk_callback_;
+	/// the decoded samples packed into a block for the raw chunk callback (data thread only)
+	std::vector<char> raw_block_;
+	/// post-processes the received time stamps, if set
+	timestamp_processor timestamp_processor_;
+	/// whether timestamp_processor_ is set, so the data thread can skip the lock otherwise
+	std::atomic<bool> has_timestamp_processor_{false};
+	/// protects the time stamp processor
+	std::mutex timestamp_processor_mut_;
+	/// the time stamps of a chunk while they're post-processed (data thread only)
+	std::vector<double> processed_timestamps_;
 
 	// internal data used by the reader thread
 	/// the maximum number of samples to be buffered for this inlet
-	int max_buflen_;
+	std::atomic<int> max_buflen_;
 	// the desired maximum chunklen for received samples
-	int max_chunklen_;
+	std::atomic<int> max_chunklen_;
+	/// whether set_buffering() changed them since the feed was requested
+	std::atomic<bool> reconfigure_pending_{false};
+	/// the sequence number of the last received sample (0 if unknown), to resume the stream
+	uint64_t last_seq_{0};
+	/// the UID of the outlet last_seq_ belongs to
+	std::string last_seq_uid_;
+	/// whether last_seq_ is known although it's 0 (a multicast feed started before the outlet
+	/// pushed anything), so the samples are repaired and resumed from the first one on
+	bool seq_known_{false};
+	/// the format agreement with the outlet whose test patterns were validated last (empty UID if
+	/// none): reconnects to it skip the test patterns as long as the agreement stays the same
+	struct {
+		std::string uid;
+		int data_protocol_version{0}, use_byte_order{0};
+		uint32_t wire_channels{0};
+	} validated_;
+	/// the number of received samples, if the samples are decimated by the inlet
+	uint32_t decimated_{0};
+	/// receive statistics, see get_stats()
+	std::atomic<uint64_t> samples_received_{0}, bytes_received_{0}, chunks_received_{0},
+		samples_lost_{0};
+	/// the samples missing from the sequence of the outlet's data connection (see
+	/// samples_missing()), as opposed to samples_lost_ of the datagram feeds
+	std::atomic<uint64_t> samples_skipped_{0};
+	/// the chunks handed to the raw chunk callback without decoding them (see deliver_frame())
+	std::atomic<uint64_t> chunks_passed_through_{0};
+	/// the dropped and missing samples before a sample (0 if unnumbered) when it was queued
+	struct gap_mark {
+		uint64_t seq, dropped, missing;
+	};
+	/// the marks whose samples weren't pulled yet (see mark_gaps()) and the newest mark
+	std::deque<gap_mark> gap_marks_;
+	gap_mark last_mark_{0, 0, 0};
+	std::mutex gap_mut_;
+	/// the gaps before the newest pulled sample and its sequence number (see account_gaps())
+	uint64_t dropped_pulled_{0}, missing_pulled_{0}, pulled_seq_{0};
+	/// the capacity of the data connection's receive buffer (0 while there's no connection)
+	std::atomic<std::size_t> receive_buffer_bytes_{0};
+	/// the CPU time of the data thread
+	cpu_account_p cpu_{std::make_shared<cpu_account>()};
+	/// the number of successfully negotiated connections
+	std::atomic<uint32_t> connections_{0};
+	/// whether the latencies are tracked (see track_latency())
+	std::atomic<bool> track_latency_{false};
+	/// the receive time minus the time-corrected time stamp of the received samples
+	latency_histogram latency_;
+	/// the time the samples spent in the sample queue until they were pulled
+	latency_histogram residence_;
+	/// gets the current time correction, see set_time_correction_source()
+	std::function<bool(double &)> time_correction_source_;
+	/// gets the metadata patches, see set_metadata_handler()
+	std::function<void(const std::string &)> metadata_handler_;
+	/// how many seconds of the outlet's history to request (see request_history())
+	std::atomic<double> history_request_{0.0};
+	/// the overflow policy to request (see set_overflow_policy())
+	std::atomic<lsl_overflow_policy_t> overflow_policy_{ovf_drop_oldest};
+	std::atomic<double> overflow_parameter_{0.0};
+	/// the priority to request (see set_priority())
+	std::atomic<lsl_transfer_priority_t> priority_{prio_normal};
+	/// the bandwidth limit to request (see set_max_bandwidth()), 0 for none
+	std::atomic<double> max_bytes_per_second_{0.0};
+	/// the options of the data connection's socket (see set_socket_options())
+	socket_options socket_options_{socket_options::from_config()};
+	std::mutex socket_options_mut_;
+	/// whether to ask the outlet for multicast / datagram delivery (see set_multicast() and
+	/// set_datagrams()), and whether the datagrams didn't reach this inlet so far
+	std::atomic<bool> multicast_{false}, datagrams_{false}, datagrams_failed_{false};
+	/// whether to ask the outlet for RDMA delivery (see api_config::rdma_data()), and whether
+	/// it failed for this inlet so far
+	bool rdma_{false}, rdma_failed_{false};
+	/// whether to ask outlets on this host for a shared memory feed (see set_shared_memory()),
+	/// and whether it failed for this inlet so far
+	std::atomic<bool> shared_memory_{false}, shared_memory_failed_{false};
+	/// whether to take the samples of an outlet in this process from its send buffer
+	std::atomic<bool> in_process_{false};
+	/// whether to share a bundled connection, and the UID of the outlet that couldn't be bundled
+	std::atomic<bool> bundling_{false};
+	std::string bundle_failed_uid_;
+	/// the requested rate conversion (see set_resampling())
+	struct resampling {
+		uint32_t up{1}, down{1};
+		bool server_side{false};
+	} resampling_;
+	std::mutex resampling_mut_;
+	std::atomic<double> resampling_ratio_{1.0};
+	/// resamples the samples of the current connection if the outlet doesn't (data thread only)
+	std::unique_ptr<resampler> resampler_;
+	std::vector<sample_p> resampled_;
+	/// the requested value filter (see set_value_filter())
+	value_filter value_filter_;
+	std::mutex value_filter_mut_;
+	/// filters the samples of the current connection if the outlet doesn't (data thread only)
+	value_filter filter_;
+	/// the calibration of pulls (see set_calibration())
+	std::shared_ptr<const calibration> calibration_;
+	std::mutex calibration_mut_;
+	/// the number of samples after which blocking chunk pulls return (0 for a full buffer)
+	std::atomic<uint32_t> pull_min_samples_{0};
 };
 
 } // namespace lsl
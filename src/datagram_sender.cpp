@@ -0,0 +1,180 @@
+#include "datagram_sender.h"
+#include "api_config.h"
+#include "consumer_queue.h"
+#include "sample.h"
+#include "send_buffer.h"
+#include "socket_utils.h"
+#include "stream_info_impl.h"
+#include "thread_policy.h"
+#include "timestamp_deduction.h"
+#include <array>
+#include <boost/asio/ip/multicast.hpp>
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+#include <functional>
+#include <loguru.hpp>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#endif
+
+using namespace lsl;
+namespace ip = asio::ip;
+
+/// The IPv4 multicast address with the largest scope of the configured addresses.
+static ip::address_v4 multicast_group() {
+	const auto &addresses = api_config::get_instance()->multicast_addresses();
+	// the addresses are sorted by their scope
+	for (auto it = addresses.rbegin(); it != addresses.rend(); ++it) {
+		lslboost::system::error_code ec;
+		const auto address = ip::make_address(*it, ec);
+		if (!ec && address.is_v4() && address.is_multicast()) return address.to_v4();
+	}
+	throw std::invalid_argument("No IPv4 multicast address is configured (see ResolveScope).");
+}
+
+template <typename T> static void put(std::streambuf &sb, T value) {
+	lslboost::endian::native_to_little_inplace(value);
+	sb.sputn(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+datagram_sender::datagram_sender(stream_info_impl_p info, send_buffer_p send_buffer)
+	: info_(std::move(info)), send_buffer_(std::move(send_buffer)), socket_(io_),
+	  key_(std::hash<std::string>()(info_->uid())) {
+	const api_config *cfg = api_config::get_instance();
+	// the port is held by this socket, so the inlets on this host (which share it with
+	// reuse_address) don't collide with the UDP servers of other outlets
+	socket_.open(ip::udp::v4());
+	socket_.set_option(ip::udp::socket::reuse_address(true));
+	group_ = ip::udp::endpoint(multicast_group(), bind_port_in_range(socket_, ip::udp::v4()));
+#if defined(__linux__) && defined(IP_MULTICAST_ALL)
+	// don't receive the datagrams sent to the groups the inlets on this host joined
+	lslboost::system::error_code ec;
+	socket_.set_option(
+		asio::detail::socket_option::boolean<IPPROTO_IP, IP_MULTICAST_ALL>(false), ec);
+#endif
+	socket_.set_option(ip::multicast::hops(cfg->multicast_ttl()));
+	socket_.set_option(ip::multicast::enable_loopback(true));
+	if (!cfg->listen_address().empty()) {
+		const auto listen_address = ip::make_address(cfg->listen_address());
+		if (listen_address.is_v4())
+			socket_.set_option(ip::multicast::outbound_interface(listen_address.to_v4()));
+	}
+	start();
+}
+
+datagram_sender::datagram_sender(
+	stream_info_impl_p info, send_buffer_p send_buffer, ip::udp::endpoint destination)
+	: info_(std::move(info)), send_buffer_(std::move(send_buffer)), socket_(io_),
+	  group_(std::move(destination)), key_(std::hash<std::string>()(info_->uid())) {
+	socket_.open(group_.protocol());
+	start();
+}
+
+void datagram_sender::start() {
+	if (info_->channel_format() == cft_string)
+		throw std::invalid_argument("String samples can't be sent as datagrams.");
+	// the IPv6 header is 20 bytes larger
+	const std::size_t datagram_bytes = max_datagram_bytes - (group_.address().is_v6() ? 20 : 0);
+	// sequence number, tag, time stamp and values
+	const std::size_t sample_bytes = sizeof(uint64_t) + 1 + sizeof(double) +
+									 format_sizes[info_->channel_format()] * info_->channel_count();
+	if (header_bytes + sample_bytes > datagram_bytes)
+		throw std::invalid_argument("The samples are too large to be sent as datagrams.");
+	samples_per_datagram_ = (datagram_bytes - header_bytes) / sample_bytes;
+	scratch_.reset(new char[format_sizes[info_->channel_format()] * info_->channel_count()]);
+	thread_ = managed_thread(lsl_thread_transfer, "D_" + info_->name().substr(0, 12),
+		&datagram_sender::sender_thread, this);
+}
+
+datagram_sender::~datagram_sender() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+		// wake up the thread if it's waiting for a sample
+		if (queue_) queue_->push_sample(sample_p());
+	}
+	wakeup_.notify_all();
+	thread_.join();
+}
+
+void datagram_sender::subscribe(int max_buffered) {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		if (subscribers_++) return;
+		queue_ = send_buffer_->new_consumer(max_buffered);
+	}
+	wakeup_.notify_all();
+}
+
+void datagram_sender::unsubscribe() {
+	std::lock_guard<std::mutex> lock(mut_);
+	if (--subscribers_) return;
+	// the thread stops sending once it gets to the wakeup sample
+	queue_->push_sample(sample_p());
+	queue_.reset();
+}
+
+void datagram_sender::sender_thread() {
+	pin_to_numa_node(send_buffer_->numa_node());
+	timestamp_deduction deduction = send_buffer_->new_timestamp_deduction();
+	while (true) {
+		std::shared_ptr<consumer_queue> queue;
+		{
+			std::unique_lock<std::mutex> lock(mut_);
+			wakeup_.wait(lock, [this]() { return stop_ || queue_; });
+			if (stop_) return;
+			queue = queue_;
+		}
+		try {
+			while (true) {
+				sample_p samp(queue->pop_sample(heartbeat_interval));
+				if (!samp) {
+					// a heartbeat, or the wakeup sample of unsubscribe() or the destructor
+					{
+						std::lock_guard<std::mutex> lock(mut_);
+						if (stop_ || queue_ != queue) break;
+					}
+					send_datagram();
+					continue;
+				}
+				put(datagram_, samp->seq);
+				// any datagram may be lost, so each one starts with a time stamp
+				if (!num_samples_) deduction.restart();
+				const bool deduced =
+					deduction.wire_timestamp(samp->timestamp, samp->seq) != samp->timestamp;
+				samp->save_streambuf(datagram_, 110, BOOST_BYTE_ORDER, scratch_.get(), deduced);
+				last_seq_ = samp->seq;
+				if (++num_samples_ == samples_per_datagram_ || samp->pushthrough) send_datagram();
+			}
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unexpected error while sending the datagrams of %s: %s",
+				info_->name().c_str(), e.what());
+		}
+		// nobody receives the rest of the datagram anymore
+		datagram_.consume(datagram_.size());
+		num_samples_ = 0;
+	}
+}
+
+void datagram_sender::send_datagram() {
+	char header[header_bytes];
+	uint64_t key = lslboost::endian::native_to_little(key_),
+			 last_seq = lslboost::endian::native_to_little(last_seq_);
+	const uint16_t count = lslboost::endian::native_to_little(num_samples_);
+	memcpy(header, &key, sizeof(key));
+	memcpy(header + sizeof(key), &last_seq, sizeof(last_seq));
+	memcpy(header + 2 * sizeof(uint64_t), &count, sizeof(count));
+	const std::array<asio::const_buffer, 2> buffers{
+		{asio::buffer(header, sizeof(header)), datagram_.data()}};
+	lslboost::system::error_code ec;
+	socket_.send_to(buffers, group_, 0, ec);
+	if (ec && !send_error_logged_) {
+		LOG_F(WARNING, "Could not send the samples of %s to %s: %s", info_->name().c_str(),
+			group_.address().to_string().c_str(), ec.message().c_str());
+		send_error_logged_ = true;
+	}
+	datagram_.consume(datagram_.size());
+	num_samples_ = 0;
+}
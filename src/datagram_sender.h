@@ -0,0 +1,127 @@
+#ifndef DATAGRAM_SENDER_H
+#define DATAGRAM_SENDER_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace lsl {
+
+/**
+ * Sends the samples of an outlet as UDP datagrams, either to a multicast group (so the outlet's
+ * CPU and uplink load don't grow with the number of inlets that receive them this way) or to a
+ * single inlet that prefers losing samples over waiting for retransmissions.
+ *
+ * The inlets negotiate the datagram delivery over their TCP data connection (see tcp_server),
+ * which stays open: multicast inlets request the samples they missed by their sequence numbers
+ * and the session sends them from the outlet's history, other inlets only count them as lost.
+ *
+ * Each datagram starts with a header (all values little endian):
+ *  - the stream's key (uint64), so inlets can ignore other streams sent to the same group and port
+ *  - the sequence number of the last sample multicast so far (uint64)
+ *  - the number of samples in the datagram (uint16)
+ *
+ * followed by the samples, each preceded by its sequence number (uint64) and serialized by
+ * sample::save_streambuf() (protocol 1.10, the outlet's byte order). The first sample of a datagram
+ * has its time stamp sent, so an inlet that lost the previous datagram doesn't deduce it. While
+ * the outlet doesn't push anything, empty datagrams are sent as heartbeats so inlets notice lost
+ * trailing datagrams and a multicast path that stopped working.
+ *
+ * The samples are only sent while at least one session subscribed to them.
+ */
+class datagram_sender {
+public:
+	/// the maximum size of a datagram (one Ethernet frame over IPv4, IPv6 needs 20 bytes more)
+	static const std::size_t max_datagram_bytes = 1472;
+	/// the size of the datagram header
+	static const std::size_t header_bytes = 2 * sizeof(uint64_t) + sizeof(uint16_t);
+	/// the interval of the heartbeats (in seconds)
+	static constexpr double heartbeat_interval = 0.5;
+
+	/**
+	 * Create a multicast sender for an outlet's stream and open its socket.
+	 *
+	 * The group is the IPv4 multicast address with the largest scope of the configured
+	 * multicast addresses, the port is a free UDP port of the configured port range.
+	 * @throws std::invalid_argument if the stream's samples can't be multicast (string samples,
+	 * or samples that don't fit into a datagram) or no IPv4 multicast address is configured.
+	 */
+	datagram_sender(stream_info_impl_p info, send_buffer_p send_buffer);
+
+	/**
+	 * Create a sender that sends an outlet's samples to a single inlet.
+	 * @throws std::invalid_argument if the stream's samples can't be sent as datagrams.
+	 */
+	datagram_sender(
+		stream_info_impl_p info, send_buffer_p send_buffer, asio::ip::udp::endpoint destination);
+
+	/// Destructor. Stops the sending thread.
+	~datagram_sender();
+
+	datagram_sender(const datagram_sender &) = delete;
+	datagram_sender &operator=(const datagram_sender &) = delete;
+
+	/// The group (or inlet) the samples are sent to.
+	const asio::ip::udp::endpoint &group() const { return group_; }
+
+	/// The key that identifies the stream's datagrams.
+	uint64_t key() const { return key_; }
+
+	/**
+	 * Register a session; the samples are sent from the first one on.
+	 * @param max_buffered The maximum number of samples that are buffered while the sending is
+	 * behind (0 for the outlet's default).
+	 */
+	void subscribe(int max_buffered = 0);
+
+	/// Unregister a session; the sending stops without subscribers.
+	void unsubscribe();
+
+private:
+	/// Check the format of the samples, open the socket and start the sending thread.
+	void start();
+
+	/// The sending thread.
+	void sender_thread();
+
+	/// Send the samples collected so far (or a heartbeat if there are none).
+	void send_datagram();
+
+	stream_info_impl_p info_;
+	send_buffer_p send_buffer_;
+	asio::io_context io_;
+	asio::ip::udp::socket socket_;
+	asio::ip::udp::endpoint group_;
+	const uint64_t key_;
+	/// the number of samples that fit into a datagram
+	std::size_t samples_per_datagram_{1};
+
+	// used by the sending thread
+	/// the datagram being assembled, the number of samples in it and the last sequence number
+	asio::streambuf datagram_;
+	uint16_t num_samples_{0};
+	uint64_t last_seq_{0};
+	/// scratchpad memory for sample::save_streambuf()
+	std::unique_ptr<char[]> scratch_;
+	/// whether a send error was logged already
+	bool send_error_logged_{false};
+
+	/// protects the following fields
+	std::mutex mut_;
+	std::condition_variable wakeup_;
+	/// the queue the samples are sent from (only while there are subscribers)
+	std::shared_ptr<class consumer_queue> queue_;
+	std::size_t subscribers_{0};
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,37 @@
+#include "discovery_cache.h"
+#include "api_config.h"
+#include <algorithm>
+#include <memory>
+
+using namespace lsl;
+
+std::atomic<discovery_cache *> discovery_cache::instance_{nullptr};
+
+discovery_cache::discovery_cache(double forget_after) : started_(lsl_clock()) {
+	resolver_.resolve_continuous(resolver_impl::build_query(), forget_after);
+}
+
+discovery_cache *discovery_cache::get() {
+	static std::unique_ptr<discovery_cache> cache(
+		api_config::get_instance()->discovery_cache_time() > 0
+			? new discovery_cache(api_config::get_instance()->discovery_cache_time())
+			: nullptr);
+	instance_ = cache.get();
+	return cache.get();
+}
+
+void discovery_cache::forget(const std::string &uid) {
+	if (discovery_cache *cache = instance_) cache->resolver_.forget(uid);
+}
+
+bool discovery_cache::lookup(const std::string &query, int minimum, double timeout,
+	double minimum_time, std::vector<stream_info_impl> &result) {
+	// without a minimum number of results, the resolve searches until the timeout expires
+	const double search_time = minimum > 0 ? minimum_time : std::max(minimum_time, timeout);
+	if (lsl_clock() - started_ < search_time) return false;
+	result = resolver_.results();
+	result.erase(std::remove_if(result.begin(), result.end(),
+					 [&](stream_info_impl &info) { return !info.matches_query(query); }),
+		result.end());
+	return result.size() >= static_cast<std::size_t>(std::max(minimum, 0));
+}
@@ -0,0 +1,62 @@
+#ifndef DISCOVERY_CACHE_H
+#define DISCOVERY_CACHE_H
+
+#include "resolver_impl.h"
+#include "stream_info_impl.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A process-wide list of the streams in our session, kept up to date by a continuous resolver.
+ *
+ * One-shot resolves and stream recoveries look up their query here first, so e.g. a recorder
+ * opening many streams doesn't start a new wave of query packets for each of them.
+ * The cache is only used if api_config::discovery_cache_time() is set.
+ */
+class discovery_cache {
+public:
+	/// Get the cache (started on first use), or nullptr if it's disabled.
+	static discovery_cache *get();
+
+	/// Drop a stream of this process from the cache (if it's running) when its outlet goes away.
+	static void forget(const std::string &uid);
+
+	/**
+	 * Start resolving all streams of our session.
+	 *
+	 * The process-wide cache is created by get(); other instances are independent of it, e.g.
+	 * for tests.
+	 * @param forget_after Streams are dropped if they didn't respond for this many seconds.
+	 */
+	explicit discovery_cache(double forget_after);
+
+	discovery_cache(const discovery_cache &) = delete;
+	discovery_cache &operator=(const discovery_cache &) = delete;
+
+	/**
+	 * Look up the streams matching a query.
+	 *
+	 * The parameters are those of the resolve_oneshot() call the lookup replaces; it fails if
+	 * that call could find more streams than the cache, i.e. if there are fewer than minimum
+	 * matching streams or the cache hasn't been running as long as the call would search.
+	 * @param[out] result The matching streams.
+	 * @return Whether the result is complete.
+	 */
+	bool lookup(const std::string &query, int minimum, double timeout, double minimum_time,
+		std::vector<stream_info_impl> &result);
+
+private:
+	/// the continuous resolver that fills the cache
+	resolver_impl resolver_;
+	/// the time the resolver was started
+	const double started_;
+	/// the running cache, if any
+	static std::atomic<discovery_cache *> instance_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef DISCOVERY_STATS_H
+#define DISCOVERY_STATS_H
+
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+
+namespace lsl {
+
+/**
+ * Process-wide counters of the discovery traffic, i.e. the shortinfo queries sent by the
+ * resolvers and answered by the udp_servers (see lsl_get_discovery_stats()).
+ *
+ * The counters are only ever incremented, so a wave's traffic is the difference of two
+ * snapshots.
+ */
+struct discovery_stats {
+	std::atomic<uint64_t> queries_sent{0};
+	std::atomic<uint64_t> replies_received{0};
+	std::atomic<uint64_t> requests_received{0};
+	std::atomic<uint64_t> replies_sent{0};
+	/// the time spent answering the requests, in ns
+	std::atomic<uint64_t> request_ns{0};
+
+	/// The counters of this process.
+	static discovery_stats &get() {
+		static discovery_stats instance;
+		return instance;
+	}
+
+	/// Count an event (relaxed, they're independent tallies).
+	static void add(std::atomic<uint64_t> &counter, uint64_t n = 1) {
+		counter.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	void fill(lsl_discovery_stats &stats) const {
+		stats.queries_sent = queries_sent.load(std::memory_order_relaxed);
+		stats.replies_received = replies_received.load(std::memory_order_relaxed);
+		stats.requests_received = requests_received.load(std::memory_order_relaxed);
+		stats.replies_sent = replies_sent.load(std::memory_order_relaxed);
+		stats.request_seconds = request_ns.load(std::memory_order_relaxed) / 1e9;
+	}
+};
+
+} // namespace lsl
+
+#endif
@@ -26,6 +26,7 @@ namespace asio = lslboost::asio;
 
 namespace lsl {
 /// shared pointers to various classes
+using datagram_sender_p = std::shared_ptr<class datagram_sender>;
 using factory_p = std::shared_ptr<class factory>;
 using sample_p = lslboost::intrusive_ptr<class sample>;
 using send_buffer_p = std::shared_ptr<class send_buffer>;
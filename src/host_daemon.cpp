@@ -0,0 +1,604 @@
+#include "host_daemon.h"
+#include "common.h"
+#include "consumer_queue.h"
+#include "sample.h"
+#include "send_buffer.h"
+#include "stream_info_impl.h"
+#include "stream_outlet_impl.h"
+#include <algorithm>
+#include <atomic>
+#include <loguru.hpp>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LSL_HOST_DAEMON
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+using namespace lsl;
+
+#ifdef LSL_HOST_DAEMON
+namespace {
+/// the number of slots of a stream's ring
+const uint32_t ring_slots = 4096;
+/// the largest full-info message the daemon accepts
+const std::size_t max_info_bytes = 16 * 1024 * 1024;
+/// how long either side waits for the other during the handshake (in seconds)
+const double handshake_timeout = 5.0;
+/// how often the waiting sides check whether they should stop (in seconds)
+const double poll_interval = 0.5;
+/// the offset of the sample data in a slot, after the time stamp and the pushthrough flag
+const std::size_t slot_header_bytes = 2 * sizeof(double);
+
+#ifdef MSG_NOSIGNAL
+const int send_flags = MSG_NOSIGNAL;
+#else
+const int send_flags = 0;
+#endif
+
+/**
+ * The header of a shared memory ring of samples, followed by its slots.
+ *
+ * The process writes the slots and advances `written`, the daemon reads them and advances `read`.
+ * A daemon that found the ring empty sets `consumer_waiting` (and checks again) before it waits
+ * for the socket, so the process only sends a wakeup byte if the daemon might be sleeping.
+ * The daemon keeps `consumers` at the number of consumers of its outlet, since the process'
+ * send buffer only has the daemon as its consumer.
+ */
+struct ring_header {
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> read;
+	std::atomic<uint32_t> consumer_waiting;
+	std::atomic<uint32_t> consumers;
+	uint32_t slots, slot_bytes;
+};
+
+/// The slot size for the samples of a stream, padded so the time stamps stay aligned.
+uint32_t slot_size(const stream_info_impl &info) {
+	const std::size_t data = format_sizes[info.channel_format()] * info.channel_count();
+	return static_cast<uint32_t>(slot_header_bytes + (data + 7) / 8 * 8);
+}
+
+/// A mapped shared memory ring.
+class shm_ring {
+public:
+	/// Create a ring with a new name (by the daemon).
+	shm_ring(uint32_t slots, uint32_t slot_bytes) {
+		static std::atomic<uint32_t> counter{0};
+		if (!std::atomic<uint64_t>().is_lock_free() || !std::atomic<uint32_t>().is_lock_free())
+			throw std::runtime_error("The rings need lock-free atomics.");
+		name_ = "/lsl-" + std::to_string(getpid()) + '-' + std::to_string(counter++);
+		const int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+		if (fd < 0) throw std::runtime_error("Could not create the ring: " + errno_message());
+		bytes_ = sizeof(ring_header) + static_cast<std::size_t>(slots) * slot_bytes;
+		if (ftruncate(fd, static_cast<off_t>(bytes_)) != 0) {
+			const std::string msg = errno_message();
+			close(fd);
+			shm_unlink(name_.c_str());
+			throw std::runtime_error("Could not size the ring: " + msg);
+		}
+		try {
+			map(fd);
+		} catch (std::exception &) {
+			shm_unlink(name_.c_str());
+			throw;
+		}
+		// the memory is zeroed, so the counters start at 0
+		header().slots = slots;
+		header().slot_bytes = slot_bytes;
+		owner_ = true;
+	}
+
+	/// Map a ring the daemon created (by the process), checking that its slots fit the samples.
+	shm_ring(const std::string &name, uint32_t slot_bytes) : name_(name) {
+		const int fd = shm_open(name_.c_str(), O_RDWR, 0);
+		if (fd < 0) throw std::runtime_error("Could not open the ring: " + errno_message());
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(ring_header)) {
+			close(fd);
+			throw std::runtime_error("The ring is malformed.");
+		}
+		bytes_ = static_cast<std::size_t>(st.st_size);
+		map(fd);
+		if (header().slot_bytes != slot_bytes || !header().slots ||
+			sizeof(ring_header) + static_cast<std::size_t>(header().slots) * slot_bytes > bytes_) {
+			munmap(mem_, bytes_);
+			throw std::runtime_error("The ring doesn't fit the stream's samples.");
+		}
+	}
+
+	~shm_ring() {
+		munmap(mem_, bytes_);
+		if (owner_) unlink();
+	}
+
+	shm_ring(const shm_ring &) = delete;
+	shm_ring &operator=(const shm_ring &) = delete;
+
+	/// Remove the ring's name once the process mapped it, so it's gone when both unmap it.
+	void unlink() {
+		if (!name_.empty()) shm_unlink(name_.c_str());
+		name_.clear();
+	}
+
+	const std::string &name() const { return name_; }
+	ring_header &header() { return *static_cast<ring_header *>(mem_); }
+	char *slot(uint64_t index) {
+		return static_cast<char *>(mem_) + sizeof(ring_header) +
+			   (index % header().slots) * header().slot_bytes;
+	}
+
+	static std::string errno_message() { return std::strerror(errno); }
+
+private:
+	void map(int fd) {
+		mem_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mem_ == MAP_FAILED)
+			throw std::runtime_error("Could not map the ring: " + errno_message());
+	}
+
+	std::string name_;
+	void *mem_{nullptr};
+	std::size_t bytes_{0};
+	bool owner_{false};
+};
+
+/// A connected Unix domain socket.
+class unix_socket {
+public:
+	explicit unix_socket(int fd) : fd_(fd) {}
+	~unix_socket() {
+		if (fd_ >= 0) close(fd_);
+	}
+	unix_socket(const unix_socket &) = delete;
+	unix_socket &operator=(const unix_socket &) = delete;
+
+	int fd() const { return fd_; }
+
+	/// Wait until the socket is readable (or closed), false after the timeout.
+	bool wait_readable(double timeout) const {
+		pollfd pfd{fd_, POLLIN, 0};
+		const int r = poll(&pfd, 1, static_cast<int>(timeout * 1000));
+		if (r < 0 && errno != EINTR) throw std::runtime_error(shm_ring::errno_message());
+		return r > 0;
+	}
+
+	/// Read some bytes; 0 if the other side closed the socket.
+	std::size_t read_some(char *dst, std::size_t n) const {
+		while (true) {
+			const ssize_t r = recv(fd_, dst, n, 0);
+			if (r >= 0) return static_cast<std::size_t>(r);
+			if (errno != EINTR) throw std::runtime_error(shm_ring::errno_message());
+		}
+	}
+
+	/// Read exactly n bytes within a timeout.
+	void read(char *dst, std::size_t n, double timeout) const {
+		const auto deadline =
+			std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+		while (n) {
+			const double left =
+				std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+			if (left <= 0 || !wait_readable(left)) throw std::runtime_error("Timed out.");
+			const std::size_t r = read_some(dst, n);
+			if (!r) throw std::runtime_error("The connection was closed.");
+			dst += r;
+			n -= r;
+		}
+	}
+
+	/// Read a line ending with `\r\n` (without it) within a timeout.
+	std::string read_line(double timeout) const {
+		std::string line;
+		char c;
+		while (line.size() < 1024) {
+			read(&c, 1, timeout);
+			if (c == '\n') {
+				if (!line.empty() && line.back() == '\r') line.pop_back();
+				return line;
+			}
+			line.push_back(c);
+		}
+		throw std::runtime_error("The line is too long.");
+	}
+
+	void write(const char *src, std::size_t n) const {
+		while (n) {
+			const ssize_t r = send(fd_, src, n, send_flags);
+			if (r < 0) {
+				if (errno == EINTR) continue;
+				throw std::runtime_error(shm_ring::errno_message());
+			}
+			src += r;
+			n -= static_cast<std::size_t>(r);
+		}
+	}
+	void write(const std::string &str) const { write(str.data(), str.size()); }
+
+private:
+	int fd_;
+};
+
+/// The address of a socket path.
+sockaddr_un socket_address(const std::string &path) {
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("The socket path '" + path + "' is empty or too long.");
+	memcpy(addr.sun_path, path.c_str(), path.size());
+	return addr;
+}
+
+int new_socket() {
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) throw std::runtime_error(shm_ring::errno_message());
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+	return fd;
+}
+} // namespace
+
+/// A stream published through the daemon (or a process whose handshake is still going on).
+struct host_daemon_stream {
+	std::unique_ptr<unix_socket> socket;
+	std::unique_ptr<shm_ring> ring;
+	/// the daemon's outlet, once the process' stream was accepted (protected by the daemon's mutex)
+	std::unique_ptr<stream_outlet_impl> outlet;
+	/// the UID the process publishes its stream with (protected by the daemon's mutex)
+	std::string uid;
+	managed_thread thread;
+	/// set by the thread once the process closed the socket or its handshake failed
+	std::atomic<bool> ended{false};
+};
+
+struct host_daemon::impl {
+	explicit impl(const std::string &path) : path_(path), listener_(new_socket()) {
+		const sockaddr_un addr = socket_address(path);
+		// a socket file that nobody listens on is left over from a daemon that didn't exit cleanly
+		if (bind(listener_.fd(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+			unix_socket probe(new_socket());
+			if (errno != EADDRINUSE ||
+				connect(probe.fd(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0)
+				throw std::runtime_error("Could not listen on " + path + ": another daemon listens "
+										 "on it, or it can't be created.");
+			::unlink(path.c_str());
+			if (bind(listener_.fd(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0)
+				throw std::runtime_error(
+					"Could not listen on " + path + ": " + shm_ring::errno_message());
+		}
+		if (listen(listener_.fd(), SOMAXCONN) != 0) {
+			::unlink(path.c_str());
+			throw std::runtime_error(
+				"Could not listen on " + path + ": " + shm_ring::errno_message());
+		}
+		accept_thread_ = managed_thread(lsl_thread_io, "hostd", &impl::accept_loop, this);
+	}
+
+	~impl() {
+		stop_ = true;
+		accept_thread_.join();
+		::unlink(path_.c_str());
+		// the threads take the lock to destroy their outlets
+		for (auto &s : streams_) close(*s);
+	}
+
+	/// Accept the processes' connections until the daemon stops.
+	void accept_loop() {
+		while (!stop_) {
+			try {
+				if (!listener_.wait_readable(poll_interval)) continue;
+				const int fd = accept(listener_.fd(), nullptr, nullptr);
+				if (fd < 0) continue;
+				std::unique_ptr<host_daemon_stream> s(new host_daemon_stream());
+				s->socket.reset(new unix_socket(fd));
+#ifdef SO_NOSIGPIPE
+				int on = 1;
+				setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+				// each process gets a thread of its own, so a slow handshake holds up no other
+				host_daemon_stream *raw = s.get();
+				std::lock_guard<std::mutex> lock(mut_);
+				prune();
+				s->thread = managed_thread(lsl_thread_transfer, "H_" + std::to_string(fd),
+					[this, raw]() { serve(*raw); });
+				streams_.push_back(std::move(s));
+			} catch (std::exception &e) {
+				LOG_F(WARNING, "Unexpected error in the host daemon: %s", e.what());
+			}
+		}
+	}
+
+	/// Handle the handshake of a process, then push its stream's samples until it's gone.
+	void serve(host_daemon_stream &s) {
+		if (publish(s)) {
+			forward(s);
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mut_);
+		s.outlet.reset();
+		s.ended = true;
+	}
+
+	/// Handle the handshake of a process; false if its stream wasn't published.
+	bool publish(host_daemon_stream &s) {
+		unix_socket &socket = *s.socket;
+		stream_info_impl info;
+		try {
+			const std::string request = socket.read_line(handshake_timeout);
+			const std::string prefix = "LSL:publish ";
+			if (request.compare(0, prefix.size(), prefix) != 0)
+				throw std::invalid_argument("Unknown request.");
+			const std::size_t bytes = std::stoul(request.substr(prefix.size()));
+			if (bytes > max_info_bytes) throw std::invalid_argument("The stream info is too big.");
+			std::string msg(bytes, '\0');
+			socket.read(&msg[0], bytes, handshake_timeout);
+			info.from_fullinfo_message(msg);
+			if (info.channel_format() == cft_string)
+				throw std::invalid_argument("String streams can't be published.");
+			{
+				// claim the UID, so a concurrent handshake for the same stream fails
+				std::lock_guard<std::mutex> lock(mut_);
+				for (const auto &other : streams_)
+					if (other.get() != &s && !other->ended && other->uid == info.uid())
+						throw std::invalid_argument("The stream is published already.");
+				s.uid = info.uid();
+			}
+			s.ring.reset(new shm_ring(ring_slots, slot_size(info)));
+			std::unique_ptr<stream_outlet_impl> outlet(
+				new stream_outlet_impl(info, 0, 512000, true));
+			shm_ring *ring = s.ring.get();
+			outlet->set_consumers_callback([ring](std::size_t n) {
+				ring->header().consumers.store(static_cast<uint32_t>(n));
+			});
+			std::lock_guard<std::mutex> lock(mut_);
+			s.outlet = std::move(outlet);
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "The host daemon rejected a stream: %s", e.what());
+			try {
+				socket.write(std::string("LSL/110 400 ") + e.what() + "\r\n");
+			} catch (std::exception &) {}
+			return false;
+		}
+		try {
+			socket.write("LSL/110 200 OK " + s.ring->name() + "\r\n");
+			if (socket.read_line(handshake_timeout) != "mapped")
+				throw std::runtime_error("The process didn't map the ring.");
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "Could not publish %s: %s", info.name().c_str(), e.what());
+			return false;
+		}
+		s.ring->unlink();
+		LOG_F(INFO, "Publishing %s (%s) for its process", info.name().c_str(), info.uid().c_str());
+		return true;
+	}
+
+	/// Push the samples from a stream's ring into its outlet until the process closes the socket.
+	void forward(host_daemon_stream &s) {
+		ring_header &h = s.ring->header();
+		const factory_p &fac = s.outlet->sample_factory();
+		std::vector<sample_p> batch;
+		uint64_t read = h.read.load(std::memory_order_relaxed);
+		char wakeups[64];
+		try {
+			while (!stop_) {
+				uint64_t written = h.written.load(std::memory_order_acquire);
+				if (written == read) {
+					h.consumer_waiting.store(1);
+					written = h.written.load();
+					if (written == read) {
+						if (s.socket->wait_readable(poll_interval) &&
+							!s.socket->read_some(wakeups, sizeof(wakeups)))
+							break;
+						continue;
+					}
+				}
+				for (; read != written && batch.size() < ring_slots / 4; ++read) {
+					const char *slot = s.ring->slot(read);
+					double timestamp;
+					memcpy(&timestamp, slot, sizeof(timestamp));
+					sample_p smp(fac->new_sample(timestamp, slot[sizeof(double)] != 0));
+					smp->assign_untyped(slot + slot_header_bytes);
+					batch.push_back(std::move(smp));
+				}
+				h.read.store(read, std::memory_order_release);
+				s.outlet->push_samples(batch.data(), batch.size());
+				batch.clear();
+			}
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "Unexpected error while publishing %s: %s",
+				s.outlet->info().name().c_str(), e.what());
+		}
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			LOG_F(INFO, "The process of %s is gone", s.outlet->info().name().c_str());
+			s.outlet.reset();
+			s.ended = true;
+		}
+		// the process waits for this, so its stream is gone when its outlet is destroyed
+		shutdown(s.socket->fd(), SHUT_RDWR);
+	}
+
+	void close(host_daemon_stream &s) {
+		if (s.thread.joinable()) s.thread.join();
+		s.outlet.reset();
+	}
+
+	/// Remove the streams whose process closed the socket (or failed its handshake).
+	void prune() {
+		for (auto &s : streams_)
+			if (s->ended) close(*s);
+		streams_.erase(
+			std::remove_if(streams_.begin(), streams_.end(),
+				[](const std::unique_ptr<host_daemon_stream> &s) { return s->ended.load(); }),
+			streams_.end());
+	}
+
+	const std::string path_;
+	unix_socket listener_;
+	std::atomic<bool> stop_{false};
+	std::mutex mut_;
+	std::vector<std::unique_ptr<host_daemon_stream>> streams_;
+	managed_thread accept_thread_;
+};
+
+host_daemon::host_daemon(const std::string &path) : impl_(new impl(path)) {}
+
+host_daemon::~host_daemon() = default;
+
+std::size_t host_daemon::num_streams() {
+	std::lock_guard<std::mutex> lock(impl_->mut_);
+	impl_->prune();
+	return static_cast<std::size_t>(std::count_if(impl_->streams_.begin(),
+		impl_->streams_.end(),
+		[](const std::unique_ptr<host_daemon_stream> &s) { return s->outlet != nullptr; }));
+}
+
+std::vector<stream_info_impl> host_daemon::infos() {
+	std::lock_guard<std::mutex> lock(impl_->mut_);
+	impl_->prune();
+	std::vector<stream_info_impl> result;
+	for (const auto &s : impl_->streams_)
+		if (s->outlet) result.push_back(s->outlet->info());
+	return result;
+}
+
+struct host_link::impl {
+	impl(const std::string &path, stream_info_impl &info, send_buffer_p send_buffer)
+		: info_(info), socket_(new_socket()) {
+		const sockaddr_un addr = socket_address(path);
+		if (connect(socket_.fd(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0)
+			throw std::runtime_error(
+				"No host daemon listens on " + path + ": " + shm_ring::errno_message());
+		const std::string msg = info.to_fullinfo_message();
+		socket_.write("LSL:publish " + std::to_string(msg.size()) + "\r\n" + msg);
+		const std::string response = socket_.read_line(handshake_timeout);
+		const std::string ok = "LSL/110 200 OK ";
+		if (response.compare(0, ok.size(), ok) != 0)
+			throw std::runtime_error("The host daemon rejected the stream (" + response + ")");
+		ring_.reset(new shm_ring(response.substr(ok.size()), slot_size(info)));
+		socket_.write("mapped\r\n");
+		send_buffer_ = std::move(send_buffer);
+		queue_ = send_buffer_->new_consumer();
+		thread_ = managed_thread(lsl_thread_transfer, "L_" + info.name().substr(0, 12),
+			&impl::link_thread, this);
+	}
+
+	~impl() {
+		stop_ = true;
+		// wake up the thread if it's waiting for a sample
+		queue_->push_sample(sample_p());
+		thread_.join();
+		// the daemon closes its end once it destroyed its outlet
+		try {
+			shutdown(socket_.fd(), SHUT_WR);
+			char buf[64];
+			while (socket_.wait_readable(handshake_timeout) && socket_.read_some(buf, sizeof(buf)))
+				;
+		} catch (std::exception &) {}
+	}
+
+	/// Write the outlet's samples into the ring until the outlet or the daemon is gone.
+	void link_thread() {
+		pin_to_numa_node(send_buffer_->numa_node());
+		ring_header &h = ring_->header();
+		const uint32_t slots = h.slots;
+		const std::size_t datasize = format_sizes[info_.channel_format()] * info_.channel_count();
+		std::vector<sample_p> batch(std::min<uint32_t>(slots, 256));
+		uint64_t written = h.written.load(std::memory_order_relaxed);
+		try {
+			while (true) {
+				batch[0] = queue_->pop_sample();
+				std::size_t n = 1;
+				if (batch[0]) n += queue_->pop_samples(batch.data() + 1, batch.size() - 1);
+				for (std::size_t k = 0; k < n; ++k) {
+					const sample_p &smp = batch[k];
+					if (!smp) {
+						// the wakeup sample of the destructor
+						if (stop_) return;
+						continue;
+					}
+					// wait for a free slot, unless the daemon is gone
+					while (written - h.read.load(std::memory_order_acquire) >= slots) {
+						if (stop_) return;
+						if (socket_.wait_readable(0.001)) {
+							LOG_F(WARNING, "The host daemon stopped publishing %s",
+								info_.name().c_str());
+							return;
+						}
+					}
+					char *slot = ring_->slot(written);
+					memcpy(slot, &smp->timestamp, sizeof(double));
+					slot[sizeof(double)] = smp->pushthrough ? 1 : 0;
+					memcpy(slot + slot_header_bytes, smp->raw_data(), datasize);
+					++written;
+				}
+				for (std::size_t k = 0; k < n; ++k) batch[k].reset();
+				h.written.store(written);
+				if (h.consumer_waiting.exchange(0)) socket_.write("w", 1);
+			}
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unexpected error while publishing %s through the host daemon: %s",
+				info_.name().c_str(), e.what());
+		}
+	}
+
+	const stream_info_impl &info_;
+	unix_socket socket_;
+	std::unique_ptr<shm_ring> ring_;
+	send_buffer_p send_buffer_;
+	std::shared_ptr<consumer_queue> queue_;
+	std::atomic<bool> stop_{false};
+	managed_thread thread_;
+};
+
+host_link::host_link(const std::string &path, stream_info_impl &info, send_buffer_p send_buffer)
+	: impl_(new impl(path, info, std::move(send_buffer))) {}
+
+host_link::~host_link() = default;
+
+bool host_link::have_consumers() const { return impl_->ring_->header().consumers.load() != 0; }
+
+bool host_link::wait_for_consumers(double timeout) const {
+	const auto deadline =
+		std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+	while (!have_consumers()) {
+		if (std::chrono::steady_clock::now() >= deadline) return false;
+		sleep_precise(0.001);
+	}
+	return true;
+}
+
+#else
+
+struct host_daemon::impl {};
+struct host_link::impl {};
+
+host_daemon::host_daemon(const std::string &) {
+	throw std::runtime_error("The host daemon is only supported on POSIX systems.");
+}
+host_daemon::~host_daemon() = default;
+std::size_t host_daemon::num_streams() { return 0; }
+std::vector<stream_info_impl> host_daemon::infos() { return {}; }
+
+host_link::host_link(const std::string &, stream_info_impl &, send_buffer_p) {
+	throw std::runtime_error("The host daemon is only supported on POSIX systems.");
+}
+host_link::~host_link() = default;
+bool host_link::have_consumers() const { return false; }
+bool host_link::wait_for_consumers(double) const { return false; }
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef HOST_DAEMON_H
+#define HOST_DAEMON_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lsl {
+class stream_info_impl;
+
+/**
+ * Serves the outlets of all processes on a host, so the hosts' network cost (multicast
+ * responders, time servers, TCP acceptors and their threads) doesn't grow with the number of
+ * processes, and short-lived tools don't have to set them up.
+ *
+ * Processes with [tuning] HostDaemon set to the daemon's socket path publish their outlets
+ * through it instead of serving them (see host_link): each outlet is announced over a Unix domain
+ * socket with its full stream info, and the daemon creates an outlet with the same metadata and
+ * identity and maps a shared memory ring the process pushes the samples into. The samples are
+ * pushed into the daemon's outlet as they are, with their time stamps (the processes share the
+ * host's clock). A published stream ends when its process closes the socket, e.g. by destroying
+ * the outlet or exiting. Each process is served by a thread of its own, from the handshake on.
+ *
+ * Only the outlets are published this way: the processes' inlets still resolve and connect to
+ * the streams (including the daemon's outlets) over the network by themselves.
+ *
+ * Protocol, on the socket (all lines end with `\r\n`):
+ *  - the process sends `LSL:publish [bytes]`, followed by its full-info message of that size
+ *  - the daemon answers `LSL/110 200 OK [ring name]` (or `LSL/110 [code] [message]`)
+ *  - the process maps the ring and sends `mapped`, after which the daemon unlinks the ring name
+ *  - from then on, the process only sends wakeup bytes for the daemon (see shm_ring)
+ *
+ * This is only supported on POSIX systems; string streams are always served by their processes.
+ */
+class host_daemon {
+public:
+	/**
+	 * Listen on a Unix domain socket, replacing a stale socket file.
+	 * @throws std::runtime_error if the socket can't be bound (e.g. another daemon listens on it)
+	 * or this isn't supported.
+	 */
+	explicit host_daemon(const std::string &path);
+
+	/// Destructor. Stops listening and destroys the outlets.
+	~host_daemon();
+
+	host_daemon(const host_daemon &) = delete;
+	host_daemon &operator=(const host_daemon &) = delete;
+
+	/// The number of published streams.
+	std::size_t num_streams();
+
+	/// The stream infos of the daemon's outlets.
+	std::vector<stream_info_impl> infos();
+
+private:
+	struct impl;
+	std::unique_ptr<impl> impl_;
+};
+
+/**
+ * The connection of an outlet to the host daemon (see host_daemon): takes the outlet's samples from
+ * its send buffer and pushes them into the shared memory ring.
+ */
+class host_link {
+public:
+	/**
+	 * Publish an outlet through the daemon listening at a path.
+	 * @param info The outlet's complete info, with its identity assigned.
+	 * @throws std::runtime_error if there's no daemon, it rejects the stream, or this isn't
+	 * supported.
+	 */
+	host_link(const std::string &path, stream_info_impl &info, send_buffer_p send_buffer);
+
+	/// Destructor. Stops publishing, which ends the stream at the daemon.
+	~host_link();
+
+	host_link(const host_link &) = delete;
+	host_link &operator=(const host_link &) = delete;
+
+	/// Whether the daemon's outlet has consumers (the outlet's own send buffer only has the link).
+	bool have_consumers() const;
+
+	/// Wait until the daemon's outlet has consumers, false after the timeout.
+	bool wait_for_consumers(double timeout) const;
+
+private:
+	struct impl;
+	std::unique_ptr<impl> impl_;
+};
+
+} // namespace lsl
+
+#endif
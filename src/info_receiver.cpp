@@ -1,6 +1,9 @@
 #include "info_receiver.h"
+#include "api_config.h"
 #include "cancellable_streambuf.h"
 #include "inlet_connection.h"
+#include "stream_info_impl.h"
+#include "thread_policy.h"
 #include <chrono>
 #include <iostream>
 #include <loguru.hpp>
@@ -20,12 +23,15 @@ lsl::info_receiver::~info_receiver() {
 	} catch (...) { LOG_F(ERROR, "Severe error during info receiver shutdown."); }
 }
 
-const lsl::stream_info_impl &lsl::info_receiver::info(double timeout) {
+lsl::stream_info_impl_p lsl::info_receiver::info(double timeout) {
 	std::unique_lock<std::mutex> lock(fullinfo_mut_);
 	auto info_ready = [this]() { return fullinfo_ || conn_.lost(); };
-	if (!info_ready()) {
-		// start thread if not yet running
-		if (!info_thread_.joinable()) info_thread_ = std::thread(&info_receiver::info_thread, this);
+	if (info_ready()) {
+		// revalidate an older info in the background; until then, the current one is returned
+		const double refresh = api_config::get_instance()->info_refresh_interval();
+		if (fullinfo_ && refresh > 0 && lsl_clock() - fetched_at_ >= refresh) start_fetching();
+	} else {
+		start_fetching();
 		// wait until we are ready to return a result (or we time out)
 		if (timeout >= FOREVER)
 			fullinfo_upd_.wait(lock, info_ready);
@@ -35,12 +41,44 @@ const lsl::stream_info_impl &lsl::info_receiver::info(double timeout) {
 	if (conn_.lost())
 		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
 						 "re-resolve the source and re-create the inlet.");
-	return *fullinfo_;
+	return fullinfo_;
+}
+
+void lsl::info_receiver::apply_patch(const std::string &patch) {
+	pugi::xml_document doc;
+	if (!doc.load_buffer(patch.data(), patch.size())) return;
+	const pugi::xml_node node = doc.child("patch");
+	std::lock_guard<std::mutex> lock(fullinfo_mut_);
+	if (!fullinfo_) return;
+	// an info with only some of the <desc> children is refreshed as usual
+	if (!api_config::get_instance()->desc_subtrees().empty()) return;
+	const auto sep = tag_.rfind(':');
+	if (sep != std::string::npos && tag_.compare(sep + 1, std::string::npos,
+										node.attribute("from").value()) == 0) {
+		// the returned infos stay unchanged, so the patch is applied to a copy
+		auto info = std::make_shared<stream_info_impl>(*fullinfo_);
+		if (info->apply_desc_patch(node)) {
+			fullinfo_ = std::move(info);
+			tag_ = tag_.substr(0, sep + 1) + node.attribute("to").value();
+			fetched_at_ = lsl_clock();
+			return;
+		}
+	}
+	start_fetching();
+}
+
+void lsl::info_receiver::start_fetching() {
+	if (fetching_ || conn_.lost()) return;
+	// a previous info thread has finished, but may not have returned yet
+	if (info_thread_.joinable()) info_thread_.join();
+	fetching_ = true;
+	info_thread_ = managed_thread(lsl_thread_info, "I_" + conn_.type_info().name().substr(0, 12),
+		&info_receiver::info_thread, this);
 }
 
 void lsl::info_receiver::info_thread() {
 	conn_.acquire_watchdog();
-	loguru::set_thread_name((std::string("I_") += conn_.type_info().name().substr(0, 12)).c_str());
+	const api_config *cfg = api_config::get_instance();
 	try {
 		while (!conn_.lost() && !conn_.shutdown()) {
 			try {
@@ -49,23 +87,54 @@ void lsl::info_receiver::info_thread() {
 				buffer.register_at(&conn_);
 				std::iostream server_stream(&buffer);
 				// connect...
-				buffer.connect(conn_.get_tcp_endpoint());
-				// send the query
-				server_stream << "LSL:fullinfo\r\n" << std::flush;
+				if (buffer.connect(conn_.get_tcp_endpoints(), inlet_connection::connect_head_start))
+					conn_.tcp_connected(buffer.remote_endpoint());
+				// send the query, with the tag of the info we already have (if any)
+				std::string known_tag;
+				{
+					std::lock_guard<std::mutex> lock(fullinfo_mut_);
+					if (fullinfo_) known_tag = tag_;
+				}
+				server_stream << "LSL:fullinfo";
+				if (request_params_) {
+					// without an info yet, the tag still names the stream (for shared sockets)
+					server_stream << " @"
+								  << (known_tag.empty() ? conn_.current_uid() + ":0" : known_tag);
+					for (const auto &name : cfg->desc_subtrees()) server_stream << ' ' << name;
+				}
+				server_stream << "\r\n" << std::flush;
 				// receive and parse the response
 				std::ostringstream os;
 				os << server_stream.rdbuf();
-				stream_info_impl info;
 				std::string msg = os.str();
-				info.from_fullinfo_message(msg);
+				// outlets of older versions close the connection if the request has parameters,
+				// so we send the plain request next time
+				if (msg.empty()) request_params_ = false;
+				std::string tag;
+				if (msg.compare(0, 12, "LSL:infotag ") == 0) {
+					const auto eol = msg.find("\r\n");
+					if (eol == std::string::npos) continue;
+					tag = msg.substr(12, eol - 12);
+					msg.erase(0, eol + 2);
+					if (msg.empty() && !known_tag.empty() && tag == known_tag) {
+						// the info we have is still up to date
+						std::lock_guard<std::mutex> lock(fullinfo_mut_);
+						fetched_at_ = lsl_clock();
+						break;
+					}
+				}
+				auto info = std::make_shared<stream_info_impl>();
+				info->from_fullinfo_message(msg, cfg->lazy_desc());
 				// if this is not a valid streaminfo we retry
-				if (!info.created_at()) continue;
+				if (!info->created_at()) continue;
 				// store the result for pickup & return
 				{
 					std::lock_guard<std::mutex> lock(fullinfo_mut_);
-					fullinfo_ = std::make_shared<stream_info_impl>(info);
+					fullinfo_ = std::move(info);
+					tag_ = std::move(tag);
+					fetched_at_ = lsl_clock();
+					info_bytes_ = msg.size();
 				}
-				fullinfo_upd_.notify_all();
 				break;
 			} catch (error_code &) {
 				// connection-level error: closed, reset, refused, etc.
@@ -77,5 +146,10 @@ void lsl::info_receiver::info_thread() {
 			}
 		}
 	} catch (lost_error &) {}
+	{
+		std::lock_guard<std::mutex> lock(fullinfo_mut_);
+		fetching_ = false;
+	}
+	fullinfo_upd_.notify_all();
 	conn_.release_watchdog();
 }
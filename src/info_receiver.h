@@ -3,8 +3,11 @@
 
 #include "common.h"
 #include "forward.h"
+#include "thread_policy.h"
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <string>
 #include <thread>
 
 namespace lsl {
@@ -18,6 +21,11 @@ class inlet_connection;
  * continues to do its job (so the next public-function call may succeed within the timeout).
  * The background thread terminates only if the info_receiver is destroyed or the underlying
  * connection is lost or shut down.
+ *
+ * Once the info has been received, it's revalidated in the background when it's requested again
+ * after api_config::info_refresh_interval(). Outlets only send the info again if their metadata
+ * changed in the meantime. Changes that the outlet sends as patches over the data connection
+ * are applied right away.
  */
 class info_receiver {
 public:
@@ -34,9 +42,24 @@ public:
 	 * @throws timeout_error (if the timeout expires), or lost_error (if the stream source has been
 	 * lost).
 	 */
-	const stream_info_impl &info(double timeout = FOREVER);
+	stream_info_impl_p info(double timeout = FOREVER);
+
+	/// The size of the message the full info was parsed from, 0 if it wasn't received yet.
+	std::size_t info_bytes() const { return info_bytes_.load(std::memory_order_relaxed); }
+
+	/**
+	 * Apply a metadata patch that the outlet sent over the data connection (see
+	 * stream_info_impl::desc_patch()) to the full info, if it was received already.
+	 *
+	 * If the patch doesn't apply to the info's version (or is malformed), the info is fetched
+	 * again instead.
+	 */
+	void apply_patch(const std::string &patch);
 
 private:
+	/// Start the info thread unless it's running already. The caller has to hold fullinfo_mut_.
+	void start_fetching();
+
 	/// The info reader thread.
 	void info_thread();
 
@@ -45,13 +68,24 @@ private:
 
 	/// background reader thread and the data generated by it
 	/// pulls the info in the background
-	std::thread info_thread_;
+	managed_thread info_thread_;
 	/// the full stream_info_impl object (retrieved by the info thread)
 	stream_info_impl_p fullinfo_;
 	/// mutex to protect the fullinfo
 	std::mutex fullinfo_mut_;
 	/// condition variable to indicate that an update for the fullinfo is available
 	std::condition_variable fullinfo_upd_;
+	/// whether the info thread is running
+	bool fetching_{false};
+	/// when the fullinfo was last received or revalidated
+	double fetched_at_{0.0};
+	/// the outlet's metadata tag for the fullinfo
+	std::string tag_;
+	/// see info_bytes()
+	std::atomic<std::size_t> info_bytes_{0};
+
+	/// whether the outlet understands the request parameters (only read by the info thread)
+	bool request_params_{true};
 };
 
 } // namespace lsl
@@ -1,5 +1,11 @@
 #include "inlet_connection.h"
 #include "api_config.h"
+#include "async_log.h"
+#include "discovery_cache.h"
+#include "socket_utils.h"
+#include "thread_policy.h"
+#include "watchdog_wheel.h"
+#include <algorithm>
 #include <functional>
 #include <loguru.hpp>
 #include <sstream>
@@ -8,10 +14,26 @@ using namespace lsl;
 namespace ip = asio::ip;
 using lslboost::system::error_code;
 
-inlet_connection::inlet_connection(const stream_info_impl &info, bool recover)
-	: type_info_(info), host_info_(info), tcp_protocol_(tcp::v4()), udp_protocol_(udp::v4()),
-	  recovery_enabled_(recover), lost_(false), shutdown_(false), last_receive_time_(lsl_clock()),
-	  active_transmissions_(0) {
+/// the stream info of the received channels of a stream
+static stream_info_impl subset_info(
+	const stream_info_impl &info, const std::vector<uint32_t> &channels) {
+	stream_info_impl result(info);
+	if (channels.empty()) return result;
+	for (uint32_t channel : channels)
+		if (channel >= info.channel_count())
+			throw std::invalid_argument("The channel index " + std::to_string(channel) +
+										" exceeds the channel count of the stream.");
+	result.channel_count(static_cast<uint32_t>(channels.size()));
+	return result;
+}
+
+inlet_connection::inlet_connection(const stream_info_impl &info, bool recover,
+	std::vector<uint32_t> channels, uint32_t decimation)
+	: type_info_(subset_info(info, channels)), host_info_(info), channels_(std::move(channels)),
+	  source_channels_(info.channel_count()), decimation_(decimation),
+	  tcp_protocol_(tcp::v4()), udp_protocol_(udp::v4()), recovery_enabled_(recover),
+	  lost_(false), shutdown_(false), last_receive_time_(lsl_clock()), active_transmissions_(0) {
+	if (!decimation_) throw std::invalid_argument("The decimation factor must be at least 1.");
 	// if the given stream_info is already fully resolved...
 	if (!host_info_.v4address().empty() || !host_info_.v6address().empty()) {
 		// check LSL protocol version (we strictly forbid incompatible protocols instead of risking
@@ -83,21 +105,27 @@ inlet_connection::inlet_connection(const stream_info_impl &info, bool recover)
 }
 
 void inlet_connection::engage() {
-	if (recovery_enabled_) watchdog_thread_ = std::thread(&inlet_connection::watchdog_thread, this);
+	if (!recovery_enabled_) return;
+	watchdog_wheel_ = watchdog_wheel::shared();
+	watchdog_id_ = watchdog_wheel_->add([this]() { watchdog(); });
 }
 
 void inlet_connection::disengage() {
 	// shut down the connection
-	{
-		std::lock_guard<std::mutex> lock(shutdown_mut_);
-		shutdown_ = true;
-	}
-	shutdown_cond_.notify_all();
+	shutdown_ = true;
 	// cancel all operations (resolver, streams, ...)
 	resolver_.cancel();
+	{
+		std::lock_guard<std::mutex> lock(failover_mut_);
+		if (failover_resolver_) failover_resolver_->cancel();
+	}
 	cancel_and_shutdown();
 	// and wait for the watchdog to finish
-	if (recovery_enabled_) watchdog_thread_.join();
+	if (watchdog_wheel_) {
+		watchdog_wheel_->remove(watchdog_id_);
+		if (recovery_thread_.joinable()) recovery_thread_.join();
+		watchdog_wheel_.reset();
+	}
 }
 
 
@@ -126,6 +154,36 @@ tcp::endpoint inlet_connection::get_tcp_endpoint() {
 		return tcp::endpoint(resolve_v6_addr(host_info_.v6address()), host_info_.v6data_port());
 }
 
+std::vector<tcp::endpoint> inlet_connection::get_tcp_endpoints() {
+	std::vector<tcp::endpoint> endpoints{get_tcp_endpoint()};
+	const api_config *cfg = api_config::get_instance();
+	if (!cfg->allow_ipv4() || !cfg->allow_ipv6()) return endpoints;
+	shared_lock_t lock(host_info_mut_);
+	try {
+		if (endpoints[0].protocol() == tcp::v4()) {
+			if (!host_info_.v6address().empty() && host_info_.v6data_port())
+				endpoints.emplace_back(
+					resolve_v6_addr(host_info_.v6address()), host_info_.v6data_port());
+		} else if (!host_info_.v4address().empty() && host_info_.v4data_port())
+			endpoints.emplace_back(
+				ip::make_address(host_info_.v4address()), host_info_.v4data_port());
+	} catch (std::exception &) {
+		// the other stack's address isn't usable
+	}
+	return endpoints;
+}
+
+void inlet_connection::tcp_connected(const tcp::endpoint &endpoint) {
+	{
+		shared_lock_t lock(host_info_mut_);
+		if (endpoint.protocol() == tcp_protocol_) return;
+	}
+	unique_lock_t lock(host_info_mut_);
+	tcp_protocol_ = endpoint.protocol();
+	LOG_F(INFO, "Connected to stream '%s' via IPv%d", host_info_.name().c_str(),
+		tcp_protocol_ == tcp::v4() ? 4 : 6);
+}
+
 udp::endpoint inlet_connection::get_udp_endpoint() {
 	shared_lock_t lock(host_info_mut_);
 
@@ -140,6 +198,11 @@ std::string inlet_connection::current_uid() {
 	return host_info_.uid();
 }
 
+std::string inlet_connection::current_hostname() {
+	shared_lock_t lock(host_info_mut_);
+	return host_info_.hostname();
+}
+
 double inlet_connection::current_srate() {
 	shared_lock_t lock(host_info_mut_);
 	return host_info_.nominal_srate();
@@ -147,38 +210,107 @@ double inlet_connection::current_srate() {
 
 
 // === connection recovery logic ===
-void inlet_connection::try_recover() {
+
+/// how long the failover resolve lists a stream after it was last seen
+const double failover_forget_after = 5.0;
+
+void inlet_connection::set_failover(bool enabled) {
+	if (enabled && !recovery_enabled_)
+		throw std::invalid_argument("Streams without a source_id can't fail over.");
+	std::shared_ptr<resolver_impl> previous;
+	std::lock_guard<std::mutex> lock(failover_mut_);
+	if (!enabled)
+		previous = std::move(failover_resolver_);
+	else if (!failover_resolver_ && !shutdown_) {
+		failover_resolver_ = std::make_shared<resolver_impl>();
+		failover_resolver_->resolve_continuous(recovery_query(), failover_forget_after);
+	}
+}
+
+std::string inlet_connection::recovery_query() {
+	std::ostringstream query;
+	shared_lock_t lock(host_info_mut_);
+	// construct query according to the fields that are present in the stream_info
+	const char *channel_format_strings[] = {"undefined", "float32", "double64", "string",
+		"int32", "int16", "int8", "int64", "int24", "float16"};
+	query << "channel_count='" << host_info_.channel_count() << "'";
+	if (!host_info_.name().empty()) query << " and name='" << host_info_.name() << "'";
+	if (!host_info_.type().empty()) query << " and type='" << host_info_.type() << "'";
+	// for floating point values, str2double(double2str(fpvalue)) == fpvalue is most
+	// likely wrong and might lead to streams not being resolved.
+	// We accept that a lost stream might be replaced by a stream from the same host
+	// with the same type, channel type and channel count but a different srate
+	/*if (host_info_.nominal_srate() > 0)
+		query << " and nominal_srate='" << host_info_.nominal_srate() << "'";
+		*/
+	if (!host_info_.source_id().empty())
+		query << " and source_id='" << host_info_.source_id() << "'";
+	query << " and channel_format='" << channel_format_strings[host_info_.channel_format()]
+		  << "'";
+	return query.str();
+}
+
+void inlet_connection::recover_to(const stream_info_impl &info) {
+	// update the endpoint
+	host_info_ = info;
+	// cancel all cancellable operations registered with this connection
+	cancel_all_registered();
+	// invoke any callbacks associated with a connection recovery
+	std::lock_guard<std::mutex> lock(onrecover_mut_);
+	for (auto &pair : onrecover_) (pair.second)();
+}
+
+void inlet_connection::try_recover(bool failed) {
 	if (recovery_enabled_) {
 		try {
 			std::lock_guard<std::mutex> lock(recovery_mut_);
 			// first create the query string based on the known stream information
-			std::ostringstream query;
+			const std::string query = recovery_query();
+			std::shared_ptr<resolver_impl> failover;
 			{
-				shared_lock_t lock(host_info_mut_);
-				// construct query according to the fields that are present in the stream_info
-				const char *channel_format_strings[] = {"undefined", "float32", "double64",
-					"string", "int32", "int16", "int8", "int64"};
-				query << "channel_count='" << host_info_.channel_count() << "'";
-				if (!host_info_.name().empty()) query << " and name='" << host_info_.name() << "'";
-				if (!host_info_.type().empty()) query << " and type='" << host_info_.type() << "'";
-				// for floating point values, str2double(double2str(fpvalue)) == fpvalue is most
-				// likely wrong and might lead to streams not being resolved.
-				// We accept that a lost stream might be replaced by a stream from the same host
-				// with the same type, channel type and channel count but a different srate
-				/*if (host_info_.nominal_srate() > 0)
-					query << " and nominal_srate='" << host_info_.nominal_srate() << "'";
-					*/
-				if (!host_info_.source_id().empty())
-					query << " and source_id='" << host_info_.source_id() << "'";
-				query << " and channel_format='"
-					  << channel_format_strings[host_info_.channel_format()] << "'";
+				std::lock_guard<std::mutex> lock(failover_mut_);
+				failover = failover_resolver_;
+			}
+			if (failover) {
+				// the failover resolve knows the candidates already: a stream that was seen
+				// recently is still fine unless its connection broke down
+				unique_lock_t lock(host_info_mut_);
+				const std::string uid = host_info_.uid();
+				if (failed) failover->forget(uid);
+				bool current = false;
+				std::vector<stream_info_impl> candidates;
+				for (auto &info : failover->results()) {
+					if (info.uid() == uid)
+						current = true;
+					else
+						candidates.push_back(std::move(info));
+				}
+				if (current) return;
+				if (!candidates.empty()) {
+					ALOG_F(INFO, "Failing over from stream '%s' to the stream on %s",
+						host_info_.name().c_str(), candidates.front().hostname().c_str());
+					recover_to(candidates.front());
+					return;
+				}
 			}
 			// attempt a recovery
 			for (int attempt = 0;; attempt++) {
-				// issue the resolve (blocks until it is either cancelled or got at least one
-				// matching streaminfo and has waited for a certain timeout)
-				std::vector<stream_info_impl> infos =
-					resolver_.resolve_oneshot(query.str(), 1, FOREVER, attempt == 0 ? 1.0 : 5.0);
+				// a restarted stream is usually in the discovery cache already, unless the cache
+				// still lists our lost stream
+				std::vector<stream_info_impl> infos;
+				discovery_cache *cache = attempt == 0 ? discovery_cache::get() : nullptr;
+				if (cache && cache->lookup(query, 1, FOREVER, 0.0, infos)) {
+					shared_lock_t lock(host_info_mut_);
+					const std::string &uid = host_info_.uid();
+					if (std::any_of(infos.begin(), infos.end(),
+							[&uid](const stream_info_impl &info) { return info.uid() == uid; }))
+						infos.clear();
+				}
+				// otherwise issue the resolve (blocks until it is either cancelled or got at least
+				// one matching streaminfo and has waited for a certain timeout)
+				if (infos.empty())
+					infos = resolver_.resolve_oneshot(
+						query, 1, FOREVER, attempt == 0 ? 1.0 : 5.0, false);
 				if (!infos.empty()) {
 					// got a result
 					unique_lock_t lock(host_info_mut_);
@@ -189,16 +321,10 @@ void inlet_connection::try_recover() {
 							return; // in this case there is no need to recover (we're still fine)
 					// otherwise our stream is gone and we indeed need to recover:
 					// ensure that the query result is unique (since someone might have used a
-					// non-unique stream ID)
-					if (infos.size() == 1) {
-						// update the endpoint
-						host_info_ = infos[0];
-						// cancel all cancellable operations registered with this connection
-						cancel_all_registered();
-						// invoke any callbacks associated with a connection recovery
-						std::lock_guard<std::mutex> lock(onrecover_mut_);
-						for (auto &pair : onrecover_) (pair.second)();
-					} else {
+					// non-unique stream ID), unless any of them will do
+					if (infos.size() == 1 || failover)
+						recover_to(infos[0]);
+					else {
 						// there are multiple possible streams to connect to in a recovery attempt:
 						// we warn and re-try this is because we don't want to randomly connect to
 						// the wrong source without the user knowing about it; the correct action
@@ -206,7 +332,7 @@ void inlet_connection::try_recover() {
 						// user code and make its source_id unique, or remove the source_id
 						// altogether if that's not possible (therefore disabling the ability to
 						// recover)
-						LOG_F(WARNING,
+						ALOG_F(WARNING,
 							"Found multiple streams with name='%s' and source_id='%s'. "
 							"Cannot recover unless all but one are closed.",
 							host_info_.name().c_str(), host_info_.source_id().c_str());
@@ -218,39 +344,30 @@ void inlet_connection::try_recover() {
 				break;
 			}
 		} catch (std::exception &e) {
-			LOG_F(ERROR, "A recovery attempt encountered an unexpected error: %s", e.what());
+			ALOG_F(ERROR, "A recovery attempt encountered an unexpected error: %s", e.what());
 		}
 	}
 }
 
-void inlet_connection::watchdog_thread() {
-	loguru::set_thread_name((std::string("W_") += type_info().name().substr(0, 12)).c_str());
-	while (!lost_ && !shutdown_) {
-		try {
-			// we only try to recover if a) there are active transmissions and b) we haven't seen
-			// new data for some time
-			{
-				std::unique_lock<std::mutex> lock(client_status_mut_);
-				if ((active_transmissions_ > 0) &&
-					(lsl_clock() - last_receive_time_ >
-						api_config::get_instance()->watchdog_time_threshold())) {
-					lock.unlock();
-					try_recover();
-				}
-			}
-			// instead of sleeping we're waiting on a condition variable for the sleep duration
-			// so that the watchdog can be cancelled conveniently
-			{
-				std::unique_lock<std::mutex> lock(shutdown_mut_);
-				shutdown_cond_.wait_for(lock,
-					std::chrono::duration<double>(
-						api_config::get_instance()->watchdog_check_interval()),
-					[this]() { return shutdown(); });
-			}
-		} catch (std::exception &e) {
-			LOG_F(ERROR, "Unexpected hiccup in the watchdog thread: %s", e.what());
-		}
-	}
+bool inlet_connection::watchdog_check() {
+	// we only try to recover if a) there are active transmissions and b) we haven't seen
+	// new data for some time
+	std::lock_guard<std::mutex> lock(client_status_mut_);
+	return (active_transmissions_ > 0) &&
+		   (lsl_clock() - last_receive_time_ >
+			   api_config::get_instance()->watchdog_time_threshold());
+}
+
+void inlet_connection::watchdog() {
+	if (lost_ || shutdown_ || recovering_ || !watchdog_check()) return;
+	// the previous recovery thread (if any) has finished already
+	if (recovery_thread_.joinable()) recovery_thread_.join();
+	recovering_ = true;
+	recovery_thread_ = managed_thread(
+		lsl_thread_watchdog, "R_" + type_info().name().substr(0, 12), [this]() {
+			try_recover();
+			recovering_ = false;
+		});
 }
 
 void inlet_connection::try_recover_from_error() {
@@ -263,14 +380,14 @@ void inlet_connection::try_recover_from_error() {
 				std::lock_guard<std::mutex> lock(client_status_mut_);
 				for (auto &pair : onlost_) pair.second->notify_all();
 			} catch (std::exception &e) {
-				LOG_F(ERROR,
+				ALOG_F(ERROR,
 					"Unexpected problem while trying to issue a connection loss notification: %s",
 					e.what());
 			}
 			throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
 							 "re-resolve the source and re-create the inlet.");
 		} else
-			try_recover();
+			try_recover(true);
 	}
 }
 
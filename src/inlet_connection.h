@@ -2,12 +2,16 @@
 #define INLET_CONNECTION_H
 
 #include "cancellation.h"
+#include "forward.h"
 #include "resolver_impl.h"
+#include "thread_policy.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <condition_variable>
 #include <map>
+#include <memory>
 #include <thread>
+#include <vector>
 
 /* shared_mutex was added in C++17 so we use the boost shared_mutex when
 building for C++11 / C++14 or MSVC <= 2019 */
@@ -40,8 +44,9 @@ namespace lsl {
  * state (possible once the stream is back online).
  *
  * Since in some cases a client might not be able to detect a connection loss and so would stall
- * forever, the inlet_connection maintains a watchdog thread that periodically checks and recovers
- * the connection state.
+ * forever, the inlet_connection has a watchdog that periodically checks and recovers the connection
+ * state. The watchdogs of all connections are checked by a watchdog_wheel shared by the process,
+ * and only the recovery itself runs in a separate thread.
  *
  * Internally the recovery works by using the resolver to find the desired stream on the network
  * again and updating the endpoint information if it has changed.
@@ -55,8 +60,12 @@ public:
 	 * @param recover Try to silently recover lost streams that are recoverable (= those that that
 	 *have a unique source_id set). In all other cases (recover is false or the stream is not
 	 *recoverable) the stream is declared lost in case of a connection breakdown.
+	 * @param channels The indices of the channels to receive (empty for all channels).
+	 * @param decimation Only every decimation-th sample is received.
+	 * @throws std::invalid_argument if a channel index is out of range or decimation is 0.
 	 */
-	inlet_connection(const stream_info_impl &info, bool recover = true);
+	inlet_connection(const stream_info_impl &info, bool recover = true,
+		std::vector<uint32_t> channels = std::vector<uint32_t>(), uint32_t decimation = 1);
 
 	/**
 	 * Prepare the connection and its auto-recovery thread.
@@ -78,6 +87,22 @@ public:
 
 	/// Get the current TCP endpoint from the info (according to our configured protocol).
 	tcp::endpoint get_tcp_endpoint();
+
+	/// How long a connection attempt to the preferred TCP endpoint goes first before the other
+	/// IP stack's is started in parallel (the "Connection Attempt Delay" of RFC 8305).
+	static constexpr double connect_head_start = 0.25;
+
+	/**
+	 * Get the TCP endpoints to connect to, the preferred one first, e.g. for
+	 * cancellable_streambuf::connect(endpoints, connect_head_start).
+	 *
+	 * If both IPv4 and IPv6 are allowed and the stream has addresses for both, the other IP
+	 * stack's endpoint is second, so an unreachable address doesn't stall the connection.
+	 */
+	std::vector<tcp::endpoint> get_tcp_endpoints();
+
+	/// Prefer the IP stack of an endpoint a TCP connection was established to from now on.
+	void tcp_connected(const tcp::endpoint &endpoint);
 	/// Get the current UDP endpoint from the info (according to our configured protocol).
 	udp::endpoint get_udp_endpoint();
 
@@ -104,6 +129,17 @@ public:
 	 */
 	void try_recover_from_error();
 
+	/**
+	 * Fail over to another stream with the same source_id (e.g. a hot standby) if the current one
+	 * breaks down, instead of waiting for it to come back.
+	 *
+	 * A continuous resolve keeps track of the matching streams meanwhile, so the connection is
+	 * recovered as soon as the breakdown is noticed, and the first of several matching streams is
+	 * taken instead of waiting for all but one to close.
+	 * @throws std::invalid_argument if the stream can't be recovered (it has no source_id).
+	 */
+	void set_failover(bool enabled);
+
 
 	// === client status info ===
 
@@ -139,10 +175,23 @@ public:
 	/// This information is constant and will never change over the lifetime of the connection.
 	const stream_info_impl &type_info() const { return type_info_; }
 
+	/// The indices of the source channels that are received (empty for all channels).
+	/// The channel count in type_info() is the number of received channels.
+	const std::vector<uint32_t> &channel_subset() const { return channels_; }
+
+	/// The number of channels of the source stream.
+	uint32_t source_channel_count() const { return source_channels_; }
+
+	/// Only every decimation()-th sample of the source stream is received.
+	uint32_t decimation() const { return decimation_; }
+
 	/// Get the current stream instance UID (which would be different after a crash and restart of
 	/// the data source).
 	std::string current_uid();
 
+	/// Get the hostname of the computer the stream is currently provided by.
+	std::string current_hostname();
+
 	/// Get the nominal srate of the endpoint; we assume that this might possibly change between
 	/// crashes/restarts of the data source under some circumstances (although such behavior would
 	/// be strongly discouraged).
@@ -150,17 +199,34 @@ public:
 
 
 private:
-	/// A thread that periodically checks whether the connection should be recovered.
-	void watchdog_thread();
+	/// Check whether the connection should be recovered, i.e. whether there are active
+	/// transmissions but no new data has been received for some time.
+	bool watchdog_check();
+
+	/// The periodic watchdog check, starts a recovery thread if needed.
+	void watchdog();
 
 	/// A (potentially speculative) resolve-and-recover operation.
-	void try_recover();
+	/// @param failed Whether the connection is known to have broken down.
+	void try_recover(bool failed = false);
+
+	/// The query for the streams the connection can be recovered to.
+	std::string recovery_query();
+
+	/// Connect to another stream; host_info_mut_ has to be held exclusively.
+	void recover_to(const stream_info_impl &info);
 
 	// core connection properties
 	/// static/read-only information of the stream (type & format)
 	const stream_info_impl type_info_;
 	/// the volatile information of the stream (addresses + ports); protected by a read/write mutex
 	stream_info_impl host_info_;
+	/// the received channels, see channel_subset()
+	const std::vector<uint32_t> channels_;
+	/// the number of channels of the source stream
+	const uint32_t source_channels_;
+	/// the decimation factor of the received samples
+	const uint32_t decimation_;
 	/// a mutex to protect the state of the host_info (single-write/multiple-reader)
 	shared_mutex_t host_info_mut_;
 	/// the TCP protocol used (according to api_config)
@@ -172,23 +238,30 @@ private:
 	/// is the stream irrecoverably lost (set by try_recover_from_error if recovery is disabled)
 	std::atomic<bool> lost_;
 
-	/// internal watchdog thread (to detect dead connections), re-resolves the current connection
-	/// speculatively
-	std::thread watchdog_thread_;
+	// things related to the watchdog (to detect dead connections and re-resolve the current
+	// connection speculatively)
+	/// the process-wide wheel that runs the watchdog check
+	std::shared_ptr<class watchdog_wheel> watchdog_wheel_;
+	/// the id of the check in the wheel
+	uint64_t watchdog_id_{0};
+	/// runs a recovery requested by the watchdog so it doesn't block the wheel
+	managed_thread recovery_thread_;
+	/// whether the recovery thread is still running
+	std::atomic<bool> recovering_{false};
 
 	// things related to the shutdown condition
 	/// indicates to threads that we're shutting down
 	std::atomic<bool> shutdown_;
-	/// a mutex to protect the shutdown state
-	std::mutex shutdown_mut_;
-	/// condition variable indicating that we're shutting down
-	std::condition_variable shutdown_cond_;
 
 	// things related to recovery
 	/// our resolver, in case we need it
 	resolver_impl resolver_;
 	/// we allow only one recovery operation at a time
 	std::mutex recovery_mut_;
+	/// the continuous resolve of the streams to fail over to, if failover is enabled
+	std::shared_ptr<resolver_impl> failover_resolver_;
+	/// protects failover_resolver_
+	std::mutex failover_mut_;
 
 	// client status info for recovery & notification purposes
 	/// a group of condition variables that should be notified when the connection is lost
@@ -0,0 +1,69 @@
+#include "inlet_set.h"
+#include "stream_inlet_impl.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using namespace lsl;
+
+inlet_set::~inlet_set() {
+	for (auto *inlet : inlets_) inlet->set_notification(std::function<void()>());
+}
+
+void inlet_set::add(stream_inlet_impl &inlet) {
+	if (std::find(inlets_.begin(), inlets_.end(), &inlet) != inlets_.end())
+		throw std::invalid_argument("The inlet is already a member of the inlet set.");
+	inlets_.push_back(&inlet);
+	inlet.set_notification([this]() { signal(); });
+	inlet.start_stream();
+}
+
+void inlet_set::remove(stream_inlet_impl &inlet) {
+	auto it = std::find(inlets_.begin(), inlets_.end(), &inlet);
+	if (it == inlets_.end()) return;
+	// afterwards, the inlet's data thread won't call signal() anymore
+	inlet.set_notification(std::function<void()>());
+	inlets_.erase(it);
+}
+
+void inlet_set::signal() {
+	{
+		std::lock_guard<std::mutex> lock(signal_mut_);
+		signalled_ = true;
+	}
+	signal_cv_.notify_one();
+}
+
+std::size_t inlet_set::collect_ready(
+	std::vector<stream_inlet_impl *> &ready, std::size_t min_samples) {
+	ready.clear();
+	for (auto *inlet : inlets_)
+		if (inlet->samples_available() >= min_samples || inlet->lost()) ready.push_back(inlet);
+	return ready.size();
+}
+
+std::size_t inlet_set::wait(
+	std::vector<stream_inlet_impl *> &ready, std::size_t min_samples, double timeout) {
+	min_samples = std::max<std::size_t>(min_samples, 1);
+	const auto deadline = std::chrono::steady_clock::now() +
+						  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+							  std::chrono::duration<double>(std::min(timeout, FOREVER)));
+	while (true) {
+		if (collect_ready(ready, min_samples) || timeout <= 0.0) return ready.size();
+
+		{
+			std::lock_guard<std::mutex> lock(signal_mut_);
+			signalled_ = false;
+		}
+		// arm all notifications before waiting; an inlet that filled up in the meantime is
+		// picked up by the next check right away
+		bool any_ready = false;
+		for (auto *inlet : inlets_)
+			if (!inlet->arm_notification(min_samples)) any_ready = true;
+		if (any_ready) continue;
+
+		std::unique_lock<std::mutex> lock(signal_mut_);
+		if (!signal_cv_.wait_until(lock, deadline, [this]() { return signalled_; }))
+			return collect_ready(ready, min_samples);
+	}
+}
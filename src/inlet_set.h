@@ -0,0 +1,74 @@
+#ifndef INLET_SET_H
+#define INLET_SET_H
+
+#include "common.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace lsl {
+class stream_inlet_impl;
+
+/**
+ * A set of inlets that a single thread can wait on until any of them has data available.
+ *
+ * The wait is driven by the notifications of the inlets' sample queues, so no thread is blocked
+ * or polling per inlet. An inlet can only be a member of one set at a time and has to be removed
+ * before it's destroyed. A set must only be used from one thread at a time.
+ */
+class inlet_set {
+public:
+	inlet_set() = default;
+
+	/// Destructor. Removes all inlets.
+	~inlet_set();
+
+	inlet_set(const inlet_set &) = delete;
+	inlet_set &operator=(const inlet_set &) = delete;
+
+	/**
+	 * Add an inlet to the set.
+	 *
+	 * This starts receiving data for the inlet in the background (like an implicit open_stream()
+	 * would, but without waiting for the connection).
+	 * @throws std::invalid_argument if the inlet is already a member of the set.
+	 */
+	void add(stream_inlet_impl &inlet);
+
+	/// Remove an inlet from the set. Does nothing if the inlet isn't a member.
+	void remove(stream_inlet_impl &inlet);
+
+	/// The inlets in the set, in the order they were added.
+	const std::vector<stream_inlet_impl *> &inlets() const { return inlets_; }
+
+	/**
+	 * Wait until at least one inlet has min_samples samples available (or has been lost).
+	 * @param ready Receives the ready inlets, in the order they were added.
+	 * @param min_samples The number of samples an inlet needs to have available to be ready.
+	 * @param timeout The maximum time to wait, in seconds; 0.0 only checks the inlets.
+	 * @return The number of ready inlets, 0 if the timeout expired.
+	 */
+	std::size_t wait(std::vector<stream_inlet_impl *> &ready, std::size_t min_samples = 1,
+		double timeout = FOREVER);
+
+private:
+	/// Collect the inlets that are ready.
+	std::size_t collect_ready(std::vector<stream_inlet_impl *> &ready, std::size_t min_samples);
+
+	/// Called by the inlets' data threads when new samples were queued.
+	void signal();
+
+	/// the member inlets
+	std::vector<stream_inlet_impl *> inlets_;
+	/// whether any inlet's notification fired since the last check
+	bool signalled_{false};
+	/// protects signalled_
+	std::mutex signal_mut_;
+	/// notified when an inlet's notification fires
+	std::condition_variable signal_cv_;
+};
+
+} // namespace lsl
+
+#endif
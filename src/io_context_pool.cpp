@@ -0,0 +1,96 @@
+#include "io_context_pool.h"
+#include "api_config.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <future>
+#include <loguru.hpp>
+#include <mutex>
+#include <thread>
+
+using namespace lsl;
+
+io_context_pool::io_context_pool(std::size_t size, const std::string &name) {
+	using guard_t = asio::executor_work_guard<asio::io_context::executor_type>;
+	for (std::size_t k = 0; k < std::max<std::size_t>(size, 1); ++k) {
+		auto io = std::make_shared<asio::io_context>(1);
+		ios_.push_back(io);
+		work_.push_back(std::make_shared<guard_t>(io->get_executor()));
+		threads_.emplace_back(lsl_thread_io, name + std::to_string(k), [io]() {
+			while (true) {
+				try {
+					io->run();
+					return;
+				} catch (std::exception &e) {
+					LOG_F(ERROR, "Error during io_context processing: %s", e.what());
+				}
+			}
+		});
+	}
+	LOG_F(INFO, "Started %lu shared IO threads", static_cast<unsigned long>(ios_.size()));
+}
+
+io_context_pool::~io_context_pool() {
+	work_.clear();
+	for (auto &io : ios_) io->stop();
+	for (auto &thread : threads_) {
+		// the last user may have been destroyed from within one of the pool's threads
+		if (thread.get_id() == std::this_thread::get_id())
+			thread.detach();
+		else
+			thread.join();
+	}
+}
+
+/// get a process-wide pool, creating it if there's none in use
+static std::shared_ptr<io_context_pool> get_shared_pool(
+	std::weak_ptr<io_context_pool> &pool, int num_threads, const char *name) {
+	if (num_threads <= 0) return nullptr;
+
+	static std::mutex pool_mut;
+	std::lock_guard<std::mutex> lock(pool_mut);
+	auto result = pool.lock();
+	if (!result) {
+		result = std::make_shared<io_context_pool>(static_cast<std::size_t>(num_threads), name);
+		pool = result;
+	}
+	return result;
+}
+
+std::shared_ptr<io_context_pool> io_context_pool::outlet_pool() {
+	static std::weak_ptr<io_context_pool> pool;
+	return get_shared_pool(pool, api_config::get_instance()->outlet_io_threads(), "IO_");
+}
+
+std::shared_ptr<io_context_pool> io_context_pool::parking_pool() {
+	if (auto pool = outlet_pool()) return pool;
+	static std::weak_ptr<io_context_pool> pool;
+	return get_shared_pool(pool,
+		static_cast<int>(std::min(std::max(std::thread::hardware_concurrency(), 1U), 4U)), "IOP_");
+}
+
+std::shared_ptr<io_context_pool> io_context_pool::inlet_pool() {
+	static std::weak_ptr<io_context_pool> pool;
+	return get_shared_pool(pool, api_config::get_instance()->inlet_io_threads(), "IOI_");
+}
+
+io_context_p io_context_pool::next() {
+	std::lock_guard<std::mutex> lock(next_mut_);
+	auto &io = ios_[next_];
+	next_ = (next_ + 1) % ios_.size();
+	return io;
+}
+
+bool io_context_pool::drain(asio::io_context &io, double timeout, std::function<void()> before) {
+	auto done = std::make_shared<std::promise<void>>();
+	auto future = done->get_future();
+	asio::post(io, [&io, done, before = std::move(before)]() {
+		if (before) before();
+		// the handlers of cancelled operations are queued by now, so they run before this one
+		asio::post(io, [done]() { done->set_value(); });
+	});
+	return future.wait_for(std::chrono::duration<double>(timeout)) == std::future_status::ready;
+}
@@ -0,0 +1,90 @@
+#ifndef IO_CONTEXT_POOL_H
+#define IO_CONTEXT_POOL_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A fixed number of io_contexts, each run by its own thread, that can be shared by many objects.
+ *
+ * Users hold a shared pointer to the pool for as long as they have operations running in one of
+ * its io_contexts, so the pool (and its threads) go away once the last user is gone.
+ */
+class io_context_pool {
+public:
+	/**
+	 * Start a pool of io_contexts.
+	 * @param size The number of io_contexts (and threads) in the pool.
+	 * @param name The name of the threads (for logging purposes).
+	 */
+	io_context_pool(std::size_t size, const std::string &name);
+
+	/// Stop all io_contexts and join their threads.
+	~io_context_pool();
+
+	io_context_pool(const io_context_pool &) = delete;
+	io_context_pool &operator=(const io_context_pool &) = delete;
+
+	/**
+	 * Get the pool shared by all outlets in the process.
+	 *
+	 * The pool is created on first use with the number of threads configured in
+	 * api_config::outlet_io_threads(). Returns an empty pointer if outlets should use their own
+	 * threads instead.
+	 */
+	static std::shared_ptr<io_context_pool> outlet_pool();
+
+	/**
+	 * Get the pool that serves the outlets whose idle threads are parked (see
+	 * api_config::park_idle_seconds()).
+	 *
+	 * This is outlet_pool() if it's configured, or else a pool of a few threads.
+	 */
+	static std::shared_ptr<io_context_pool> parking_pool();
+
+	/**
+	 * Get the pool shared by all inlets in the process for their time probes and watchdogs.
+	 *
+	 * Like outlet_pool(), but configured with api_config::inlet_io_threads().
+	 */
+	static std::shared_ptr<io_context_pool> inlet_pool();
+
+	/// Get the next io_context (round-robin).
+	io_context_p next();
+
+	/**
+	 * Wait until all handlers posted to an io_context before this call have been run.
+	 * @param before An optional function that is run in the io_context first, e.g. to cancel
+	 * outstanding operations; the handlers of operations it cancels also run before this returns.
+	 * @return False if the timeout expired before.
+	 */
+	static bool drain(asio::io_context &io, double timeout,
+		std::function<void()> before = std::function<void()>());
+
+	/// The number of io_contexts in the pool.
+	std::size_t size() const { return ios_.size(); }
+
+private:
+	/// a work guard for each io_context, so the threads don't run out of work
+	using work_p = std::shared_ptr<void>;
+
+	std::vector<io_context_p> ios_;
+	std::vector<work_p> work_;
+	std::vector<managed_thread> threads_;
+	/// the io_context to hand out next
+	std::size_t next_{0};
+	std::mutex next_mut_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,47 @@
+#include "latency_histogram.h"
+
+using namespace lsl;
+
+constexpr std::size_t latency_histogram::num_buckets;
+
+std::size_t latency_histogram::bucket(uint64_t ns) {
+	const uint64_t max_value = (uint64_t(1) << max_bits) - 1;
+	uint64_t top = ns < max_value ? ns : max_value;
+	// drop the low bits until sub_bits remain; each dropped bit adds half as many buckets
+	std::size_t shift = 0;
+	while (top >= (uint64_t(1) << sub_bits)) {
+		top >>= 1;
+		++shift;
+	}
+	return (shift << (sub_bits - 1)) + static_cast<std::size_t>(top);
+}
+
+uint64_t latency_histogram::bucket_start(std::size_t index) {
+	if (index < (std::size_t(1) << sub_bits)) return index;
+	const std::size_t half = std::size_t(1) << (sub_bits - 1);
+	const std::size_t shift = index / half - 1;
+	return static_cast<uint64_t>(index % half + half) << shift;
+}
+
+double latency_histogram::percentile(double q) const {
+	uint64_t total = 0;
+	for (const auto &bucket : buckets_) total += bucket.load(std::memory_order_relaxed);
+	if (!total) return 0.0;
+	// the rank of the wanted value, from 1 to total
+	auto rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > total) rank = total;
+	uint64_t seen = 0;
+	std::size_t index = 0;
+	for (; index < num_buckets - 1; ++index) {
+		seen += buckets_[index].load(std::memory_order_relaxed);
+		if (seen >= rank) break;
+	}
+	const uint64_t start = bucket_start(index), end = bucket_start(index + 1);
+	return static_cast<double>(start + end) / 2e9;
+}
+
+void latency_histogram::reset() {
+	for (auto &bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+	count_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lsl {
+
+/**
+ * A histogram of latencies with a constant relative resolution, in the style of HdrHistogram.
+ *
+ * The values are counted in nanoseconds: values below 2^sub_bits ns get a bucket each, and every
+ * further power of two is split into 2^(sub_bits-1) buckets, so the relative error of a bucket is
+ * at most 2^(1-sub_bits) (about 3%). Recording a value is a single relaxed atomic increment, so
+ * any number of threads can record values while others read the percentiles.
+ */
+class latency_histogram {
+public:
+	/// the number of bits of a value that are kept
+	static constexpr int sub_bits = 6;
+	/// values of 2^max_bits ns (about 69 s) or more are counted in the last bucket
+	static constexpr int max_bits = 36;
+	static constexpr std::size_t num_buckets = (max_bits - sub_bits + 2) << (sub_bits - 1);
+
+	/// Count a latency (in seconds); negative values, e.g. from clock errors, are counted as 0.
+	void record(double seconds) {
+		uint64_t ns = 0;
+		if (seconds > 0.0) ns = seconds < 1e9 ? static_cast<uint64_t>(seconds * 1e9) : UINT64_MAX;
+		buckets_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// The number of recorded values.
+	uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+	/**
+	 * The latency (in seconds) below which a fraction q of the recorded values lie.
+	 *
+	 * This is the midpoint of the bucket containing the q-quantile, or 0 if nothing was recorded.
+	 * Values that are recorded concurrently may or may not be included.
+	 */
+	double percentile(double q) const;
+
+	/// Discard all recorded values; values recorded concurrently may be lost or kept.
+	void reset();
+
+	/// The bucket of a value (in ns).
+	static std::size_t bucket(uint64_t ns);
+
+	/// The smallest value (in ns) of a bucket.
+	static uint64_t bucket_start(std::size_t index);
+
+private:
+	std::atomic<uint64_t> buckets_[num_buckets]{};
+	std::atomic<uint64_t> count_{0};
+};
+
+} // namespace lsl
+
+#endif
@@ -125,7 +125,7 @@ bool stream_outlet::wait_for_consumers(double timeout) { return impl_->wait_for_
 // boilerplate code calling the private implementation
 stream_inlet::stream_inlet(const stream_info &info, int max_buflen, int max_chunklen, bool recover): impl_(new stream_inlet_impl(*info.impl(), info.nominal_srate()?(int)(info.nominal_srate()*max_buflen):max_buflen*100, max_chunklen, recover)) { }
 stream_inlet::~stream_inlet() { delete impl_; }
-stream_info stream_inlet::info(double timeout) { return stream_info(&impl_->info(timeout)); }
+stream_info stream_inlet::info(double timeout) { return stream_info(*impl_->info(timeout)); }
 void stream_inlet::open_stream(double timeout) { impl_->open_stream(timeout); }
 void stream_inlet::close_stream() { impl_->close_stream(); }
 double stream_inlet::time_correction(double timeout) { return impl_->time_correction(timeout); }
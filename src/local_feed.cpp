@@ -0,0 +1,55 @@
+#include "local_feed.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace lsl;
+
+namespace {
+
+/// The feeds of the outlets in this process, by UID, in the order they were added.
+struct feed_registry {
+	struct entry {
+		const send_buffer *owner;
+		std::weak_ptr<send_buffer> buffer;
+		std::weak_ptr<lsl::factory> factory;
+	};
+	std::mutex mut;
+	std::multimap<std::string, entry> feeds;
+
+	static feed_registry &instance() {
+		static feed_registry registry;
+		return registry;
+	}
+};
+
+} // namespace
+
+void local_feed::add(
+	const std::string &uid, const send_buffer_p &buffer, const factory_p &factory) {
+	feed_registry &registry = feed_registry::instance();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	registry.feeds.emplace(uid, feed_registry::entry{buffer.get(), buffer, factory});
+}
+
+void local_feed::remove(const std::string &uid, const send_buffer *buffer) {
+	feed_registry &registry = feed_registry::instance();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	const auto range = registry.feeds.equal_range(uid);
+	for (auto it = range.first; it != range.second;)
+		if (it->second.owner == buffer)
+			it = registry.feeds.erase(it);
+		else
+			++it;
+}
+
+local_feed local_feed::find(const std::string &uid) {
+	feed_registry &registry = feed_registry::instance();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	const auto range = registry.feeds.equal_range(uid);
+	for (auto it = range.first; it != range.second; ++it) {
+		local_feed feed{it->second.buffer.lock(), it->second.factory.lock()};
+		if (feed.buffer && feed.factory) return feed;
+	}
+	return local_feed();
+}
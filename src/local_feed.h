@@ -0,0 +1,36 @@
+#ifndef LOCAL_FEED_H
+#define LOCAL_FEED_H
+
+#include "forward.h"
+#include <string>
+
+namespace lsl {
+
+/**
+ * The send buffer and sample factory of an outlet in this process.
+ *
+ * Inlets of the same process (see data_receiver::set_in_process()) consume the outlet's samples
+ * straight from its send buffer instead of through a loopback TCP connection.
+ */
+struct local_feed {
+	send_buffer_p buffer;
+	factory_p factory;
+
+	/**
+	 * Make an outlet's feed available under the UID of its stream.
+	 *
+	 * Several outlets can publish the same stream (see the keep_identity parameter of
+	 * stream_outlet_impl); the one that was added first is found until it's removed.
+	 */
+	static void add(const std::string &uid, const send_buffer_p &buffer, const factory_p &factory);
+
+	/// Remove the feed of an outlet (identified by its send buffer) that's going away.
+	static void remove(const std::string &uid, const send_buffer *buffer);
+
+	/// Find the feed of a stream; the buffer is empty if the stream's outlet isn't in this process.
+	static local_feed find(const std::string &uid);
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,79 @@
+#include "lock_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace lsl;
+
+#ifdef LSL_LOCK_STATS
+namespace {
+
+/// the most names that are counted separately, the others share the last counters
+const int max_names = 32;
+
+lock_counters counters[max_names];
+/// the number of used counters, only grows (protected by registry_mut() for writing)
+std::atomic<int> used_counters{0};
+
+std::mutex &registry_mut() {
+	static std::mutex mut;
+	return mut;
+}
+} // namespace
+
+lock_counters &lock_counters::get(const char *name) {
+	std::lock_guard<std::mutex> lock(registry_mut());
+	const int used = used_counters.load(std::memory_order_relaxed);
+	for (int i = 0; i < used; ++i)
+		if (!std::strcmp(counters[i].name, name)) return counters[i];
+	if (used == max_names) return counters[max_names - 1];
+	counters[used].name = name;
+	used_counters.store(used + 1, std::memory_order_release);
+	return counters[used];
+}
+
+void lock_counters::record_wait(uint64_t ns) {
+	acquisitions.fetch_add(1, std::memory_order_relaxed);
+	contended.fetch_add(1, std::memory_order_relaxed);
+	wait_ns.fetch_add(ns, std::memory_order_relaxed);
+	int bucket = 0;
+	for (uint64_t us = ns / 1000; us && bucket < buckets - 1; us >>= 1) ++bucket;
+	wait_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void named_mutex::lock() {
+	if (try_lock()) return;
+	// only the contended acquisitions are timed, so the uncontended ones stay cheap
+	const auto start = std::chrono::steady_clock::now();
+	mut_.lock();
+	const auto waited = std::chrono::steady_clock::now() - start;
+	counters_.record_wait(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count()));
+}
+#endif
+
+extern "C" {
+
+LIBLSL_C_API int32_t lsl_get_lock_stats(lsl_lock_stats *stats, int32_t max_locks) {
+	if (!stats || max_locks < 0) return lsl_argument_error;
+#ifdef LSL_LOCK_STATS
+	const int n = std::min<int>(used_counters.load(std::memory_order_acquire), max_locks);
+	for (int i = 0; i < n; ++i) {
+		const lock_counters &c = counters[i];
+		lsl_lock_stats &out = stats[i];
+		std::strncpy(out.name, c.name, sizeof(out.name) - 1);
+		out.name[sizeof(out.name) - 1] = 0;
+		out.acquisitions = c.acquisitions.load(std::memory_order_relaxed);
+		out.contended = c.contended.load(std::memory_order_relaxed);
+		out.wait_seconds = c.wait_ns.load(std::memory_order_relaxed) / 1e9;
+		for (int b = 0; b < LSL_LOCK_WAIT_BUCKETS; ++b)
+			out.wait_histogram[b] = c.wait_histogram[b].load(std::memory_order_relaxed);
+	}
+	return n;
+#else
+	strncpy(const_cast<char *>(lsl_last_error()), "liblsl was built without lock statistics",
+		LAST_ERROR_SIZE - 1);
+	return lsl_internal_error;
+#endif
+}
+}
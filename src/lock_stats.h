@@ -0,0 +1,78 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include "common.h"
+#include <condition_variable>
+#include <mutex>
+
+#ifdef LSL_LOCK_STATS
+#include <atomic>
+#include <cstdint>
+#endif
+
+/**
+ * @file lock_stats.h Mutexes that count their acquisitions.
+ *
+ * If liblsl is built with the CMake option LSL_LOCK_STATS, a named_mutex counts how often it's
+ * acquired, how often it's already held by another thread and how long the waits for it took
+ * (see lsl_get_lock_stats()); the mutexes with the same name share their counters. Otherwise,
+ * it's a plain std::mutex.
+ */
+
+namespace lsl {
+
+#ifdef LSL_LOCK_STATS
+/// The counters of the mutexes with a name.
+struct lock_counters {
+	/// The number of buckets in the histogram of the waits.
+	static constexpr int buckets = LSL_LOCK_WAIT_BUCKETS;
+	/// The name, a string literal.
+	const char *name{nullptr};
+	std::atomic<uint64_t> acquisitions{0}, contended{0}, wait_ns{0};
+	/// wait_histogram[i] counts the waits shorter than 2^i microseconds (the last one the rest).
+	std::atomic<uint64_t> wait_histogram[buckets]{};
+
+	/// Count a contended acquisition that waited for wait_ns nanoseconds.
+	void record_wait(uint64_t ns);
+
+	/// The counters for a name (the same ones for every call with an equal name).
+	static lock_counters &get(const char *name);
+};
+
+/// A mutex that counts its acquisitions and waits.
+class named_mutex {
+public:
+	/// @param name The name the acquisitions are counted under, a string literal.
+	explicit named_mutex(const char *name) : counters_(lock_counters::get(name)) {}
+	named_mutex(const named_mutex &) = delete;
+	named_mutex &operator=(const named_mutex &) = delete;
+
+	void lock();
+	bool try_lock() {
+		if (!mut_.try_lock()) return false;
+		counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	void unlock() { mut_.unlock(); }
+
+private:
+	std::mutex mut_;
+	lock_counters &counters_;
+};
+
+/// The condition variable and lock type for waiting with a named_mutex.
+using named_condition_variable = std::condition_variable_any;
+using named_unique_lock = std::unique_lock<named_mutex>;
+#else
+class named_mutex : public std::mutex {
+public:
+	explicit named_mutex(const char * /*name*/) noexcept {}
+};
+
+using named_condition_variable = std::condition_variable;
+using named_unique_lock = std::unique_lock<std::mutex>;
+#endif
+
+} // namespace lsl
+
+#endif
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "common.h"
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 
 /// Helper for LSL_STORE_EXCEPTION_IN
 #define LSLCATCHANDSTORE(ecvar, Exception, code)                                                   \
@@ -77,6 +79,42 @@
 	LSLCATCHANDRETURN(std::exception, lsl_internal_error)                                          \
 	return lsl_no_error
 
+/**
+ * Call `f` with a null pointer of the C type of a strided buffer's element type, e.g.
+ * `f((float *)nullptr)` for cft_float32.
+ * @throws std::invalid_argument for element types without a C type (string, int24, float16).
+ */
+template <class F>
+auto with_element_type(lsl_channel_format_t type, F &&f) -> decltype(f((float *)nullptr)) {
+	switch (type) {
+	case cft_float32: return f((float *)nullptr);
+	case cft_double64: return f((double *)nullptr);
+	case cft_int8: return f((char *)nullptr);
+	case cft_int16: return f((int16_t *)nullptr);
+	case cft_int32: return f((int32_t *)nullptr);
+	case cft_int64: return f((int64_t *)nullptr);
+	default: throw std::invalid_argument("Unsupported element type of a strided buffer.");
+	}
+}
+
+/**
+ * Copy a structure that starts with its size (`uint32_t struct_size`, e.g. lsl_outlet_stats) to
+ * a caller that may know an older (smaller) or newer (larger) version of it.
+ *
+ * Only the bytes both versions have are copied, and the caller's struct_size is set to their
+ * number. The caller's struct_size has to be checked before, see has_sized_struct().
+ */
+template <class T> void copy_sized_struct(T &src, T *dst) {
+	src.struct_size = std::min<uint32_t>(dst->struct_size, sizeof(T));
+	memcpy(dst, &src, src.struct_size);
+}
+
+/// Whether a caller's structure that starts with its size has room for more than the size (so
+/// it's probably been set).
+template <class T> bool has_sized_struct(const T *dst) {
+	return dst && dst->struct_size > sizeof(dst->struct_size);
+}
+
 /// Try to create a new T object and return a pointer to it or `nullptr` if an exception occured.
 template <class Type, typename... T> Type *create_object_noexcept(T &&...args) noexcept {
 	try {
@@ -1,5 +1,13 @@
+#include "inlet_set.h"
 #include "lsl_c_api_helpers.hpp"
+#include "recording.h"
+#include "sample.h"
 #include "stream_inlet_impl.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include "api_types.hpp"
@@ -15,6 +23,16 @@ LIBLSL_C_API lsl_inlet lsl_create_inlet(
 		max_chunklen, recover != 0);
 }
 
+LIBLSL_C_API lsl_inlet lsl_create_inlet_subset(lsl_streaminfo info, int32_t max_buflen,
+	int32_t max_chunklen, int32_t recover, const uint32_t *channels, uint32_t num_channels,
+	uint32_t decimation) {
+	if (!decimation || (num_channels && !channels)) return nullptr;
+	const double srate = info->nominal_srate() / decimation;
+	return create_object_noexcept<stream_inlet_impl>(*info,
+		(srate ? (int)(srate * max_buflen) : max_buflen * 100) + 1, max_chunklen, recover != 0,
+		std::vector<uint32_t>(channels, channels + num_channels), decimation);
+}
+
 LIBLSL_C_API void lsl_destroy_inlet(lsl_inlet in) {
 	try {
 		delete in;
@@ -23,7 +41,7 @@ LIBLSL_C_API void lsl_destroy_inlet(lsl_inlet in) {
 
 LIBLSL_C_API lsl_streaminfo lsl_get_fullinfo(lsl_inlet in, double timeout, int32_t *ec) {
 	try {
-		return new stream_info_impl(in->info(timeout));
+		return new stream_info_impl(*in->info(timeout));
 	}
 	LSL_STORE_EXCEPTION_IN(ec)
 	return nullptr;
@@ -36,6 +54,28 @@ LIBLSL_C_API void lsl_open_stream(lsl_inlet in, double timeout, int32_t *ec) {
 	} LSL_STORE_EXCEPTION_IN(ec)
 }
 
+LIBLSL_C_API uint32_t lsl_open_streams(
+	lsl_inlet *inlets, uint32_t count, double timeout, int32_t *ec) {
+	// start all data threads first, so their connects and handshakes overlap
+	for (uint32_t k = 0; k < count; ++k) {
+		try {
+			inlets[k]->begin_open_stream();
+		} catch (std::exception &e) { LOG_F(WARNING, "Couldn't open an inlet: %s", e.what()); }
+	}
+	const double deadline = timeout >= LSL_FOREVER ? LSL_FOREVER : lsl_clock() + timeout;
+	uint32_t opened = 0;
+	for (uint32_t k = 0; k < count; ++k) {
+		int32_t result = lsl_no_error;
+		try {
+			inlets[k]->open_stream(
+				deadline >= LSL_FOREVER ? LSL_FOREVER : std::max(0.0, deadline - lsl_clock()));
+			++opened;
+		} LSL_STORE_EXCEPTION_IN(&result)
+		if (ec) ec[k] = result;
+	}
+	return opened;
+}
+
 LIBLSL_C_API void lsl_close_stream(lsl_inlet in) {
 	try {
 		in->close_stream();
@@ -60,6 +100,17 @@ LIBLSL_C_API double lsl_time_correction_ex(
 	return 0.0;
 }
 
+LIBLSL_C_API double lsl_latest_time_correction(
+	lsl_inlet in, double *remote_time, double *uncertainty, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		double correction;
+		if (in->latest_time_correction(correction, remote_time, uncertainty)) return correction;
+		if (ec) *ec = lsl_timeout_error;
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0.0;
+}
+
 LIBLSL_C_API int32_t lsl_set_postprocessing(lsl_inlet in, uint32_t flags) {
 	try {
 		in->set_postprocessing(flags);
@@ -156,11 +207,7 @@ LIBLSL_C_API double lsl_pull_sample_buf(lsl_inlet in, char **buffer, uint32_t *b
 
 LIBLSL_C_API double lsl_pull_sample_v(
 	lsl_inlet in, void *buffer, int32_t buffer_bytes, double timeout, int32_t *ec) {
-	if (ec) *ec = lsl_no_error;
-	try {
-		return in->pull_numeric_raw(buffer, buffer_bytes, timeout);
-	} LSL_STORE_EXCEPTION_IN(ec)
-	return 0.0;
+	return in->pull_numeric_raw_noexcept(buffer, buffer_bytes, timeout, (lsl_error_code_t *)ec);
 }
 
 LIBLSL_C_API unsigned long lsl_pull_chunk_f(lsl_inlet in, float *data_buffer,
@@ -205,6 +252,48 @@ LIBLSL_C_API unsigned long lsl_pull_chunk_c(lsl_inlet in, char *data_buffer,
 		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
 }
 
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_f(lsl_inlet in, float *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_d(lsl_inlet in, double *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_l(lsl_inlet in, int64_t *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_i(lsl_inlet in, int32_t *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_s(lsl_inlet in, int16_t *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_planar_c(lsl_inlet in, char *data_buffer,
+	double *timestamp_buffer, unsigned long data_buffer_elements,
+	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
+	return in->pull_chunk_planar_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+		timestamp_buffer_elements, timeout, (lsl_error_code_t *)ec);
+}
+
 LIBLSL_C_API unsigned long lsl_pull_chunk_str(lsl_inlet in, char **data_buffer,
 	double *timestamp_buffer, unsigned long data_buffer_elements,
 	unsigned long timestamp_buffer_elements, double timeout, int32_t *ec) {
@@ -262,12 +351,335 @@ LIBLSL_C_API unsigned long lsl_pull_chunk_buf(lsl_inlet in, char **data_buffer,
 	return 0;
 }
 
+LIBLSL_C_API lsl_sample_view lsl_borrow_chunk(
+	lsl_inlet in, uint32_t max_samples, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		std::unique_ptr<lsl::sample_view> view(new lsl::sample_view());
+		in->borrow_chunk(*view, max_samples, timeout);
+		return view.release();
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return nullptr;
+}
+
+LIBLSL_C_API uint32_t lsl_view_samples(lsl_sample_view view) {
+	return static_cast<uint32_t>(view->samples.size());
+}
+
+LIBLSL_C_API const double *lsl_view_timestamps(lsl_sample_view view) {
+	return view->timestamps.data();
+}
+
+LIBLSL_C_API const void *lsl_view_data(lsl_sample_view view, uint32_t index) {
+	return index < view->samples.size() ? view->samples[index]->raw_data() : nullptr;
+}
+
+LIBLSL_C_API void lsl_return_chunk(lsl_sample_view view) { delete view; }
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_strided(lsl_inlet in, void *data,
+	lsl_channel_format_t element_type, int64_t sample_stride, int64_t channel_stride,
+	double *timestamp_buffer, unsigned long max_samples, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		return with_element_type(element_type, [&](auto *type) {
+			return in->pull_chunk_strided<std::remove_pointer_t<decltype(type)>>(
+				static_cast<char *>(data), static_cast<std::ptrdiff_t>(sample_stride),
+				static_cast<std::ptrdiff_t>(channel_stride), timestamp_buffer,
+				static_cast<uint32_t>(std::min<unsigned long>(max_samples, UINT32_MAX)),
+				timeout);
+		});
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0;
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunk_seq(lsl_inlet in, void *data_buffer,
+	lsl_channel_format_t element_type, double *timestamp_buffer, uint64_t *seq_buffer,
+	unsigned long max_samples, lsl_chunk_gaps *gaps, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		return with_element_type(element_type, [&](auto *type) {
+			using T = std::remove_pointer_t<decltype(type)>;
+			return in->pull_chunk_seq<T>(static_cast<T *>(data_buffer), timestamp_buffer,
+				seq_buffer, static_cast<uint32_t>(std::min<unsigned long>(max_samples, UINT32_MAX)),
+				gaps, timeout);
+		});
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0;
+}
+
+LIBLSL_C_API double lsl_pull_sample_sparse(lsl_inlet in, uint32_t *indices, void *values,
+	lsl_channel_format_t element_type, uint32_t max_count, uint32_t *count, double timeout,
+	int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	if (count) *count = 0;
+	try {
+		return with_element_type(element_type, [&](auto *type) {
+			using T = std::remove_pointer_t<decltype(type)>;
+			uint32_t n = 0;
+			const double ts =
+				in->pull_sample_sparse<T>(indices, static_cast<T *>(values), max_count, n, timeout);
+			if (count) *count = n;
+			return ts;
+		});
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0.0;
+}
+
+LIBLSL_C_API uint32_t lsl_pull_chunk_arrow(lsl_inlet in, struct ArrowArray *array,
+	struct ArrowSchema *schema, uint32_t max_samples, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		return in->pull_chunk_arrow(array, schema, max_samples, timeout);
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0;
+}
+
+LIBLSL_C_API int32_t lsl_async_wait_for_samples(
+	lsl_inlet in, uint32_t min_samples, lsl_samples_callback callback, void *user_data) {
+	try {
+		in->async_wait_for_samples(min_samples, [in, callback, user_data](bool lost) {
+			callback(in, lost ? lsl_lost_error : lsl_no_error, user_data);
+		});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_set_chunk_callback(
+	lsl_inlet in, lsl_chunk_callback callback, void *user_data) {
+	try {
+		if (!callback)
+			in->set_chunk_callback(stream_inlet_impl::chunk_callback());
+		else
+			in->set_chunk_callback(
+				[in, callback, user_data](sample_view &view) { callback(in, &view, user_data); });
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_set_raw_chunk_callback(
+	lsl_inlet in, lsl_raw_chunk_callback callback, void *user_data) {
+	try {
+		if (!callback)
+			in->set_raw_chunk_callback(stream_inlet_impl::raw_chunk_callback());
+		else
+			in->set_raw_chunk_callback([in, callback, user_data](const lsl_raw_chunk &chunk) {
+				callback(in, &chunk, user_data);
+			});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_set_target_buffer(lsl_inlet in, void *data,
+	lsl_channel_format_t element_type, double *timestamps, uint32_t capacity,
+	lsl_target_callback callback, void *user_data) {
+	try {
+		if (!data) {
+			in->set_target_buffer<float>(nullptr, nullptr, 0, target_buffer::callback());
+			return lsl_no_error;
+		}
+		if (!callback) return lsl_argument_error;
+		target_buffer::callback on_written = [in, callback, user_data](
+												 uint64_t first, uint32_t count) {
+			callback(in, first, count, user_data);
+		};
+		with_element_type(element_type, [&](auto *type) {
+			in->set_target_buffer(
+				static_cast<decltype(type)>(data), timestamps, capacity, std::move(on_written));
+		});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_release_target_samples(lsl_inlet in, uint32_t count) {
+	try {
+		in->release_target_samples(count);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API uint32_t lsl_set_window_buffer(
+	lsl_inlet in, lsl_channel_format_t element_type, uint32_t min_capacity, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		return with_element_type(element_type, [&](auto *type) {
+			return in->set_window_buffer<std::remove_pointer_t<decltype(type)>>(min_capacity);
+		});
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0;
+}
+
+LIBLSL_C_API lsl_window lsl_borrow_window(
+	lsl_inlet in, uint32_t num_samples, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	lsl_window result{nullptr, nullptr, 0, 0};
+	try {
+		const auto window = in->borrow_window(num_samples, timeout);
+		result = lsl_window{window.data, window.timestamps, window.count, window.first};
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return result;
+}
+
+LIBLSL_C_API int32_t lsl_release_window(lsl_inlet in) {
+	try {
+		in->release_window();
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API lsl_inlet_set lsl_create_inlet_set() { return create_object_noexcept<inlet_set>(); }
+
+LIBLSL_C_API void lsl_destroy_inlet_set(lsl_inlet_set set) {
+	try {
+		delete set;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_inlet_set_add(lsl_inlet_set set, lsl_inlet in) {
+	try {
+		set->add(*in);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API void lsl_inlet_set_remove(lsl_inlet_set set, lsl_inlet in) {
+	try {
+		set->remove(*in);
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API uint32_t lsl_inlet_set_wait(lsl_inlet_set set, uint32_t min_samples,
+	lsl_inlet *ready_buffer, uint32_t ready_buffer_elements, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		std::vector<stream_inlet_impl *> ready;
+		std::size_t n = std::min<std::size_t>(
+			set->wait(ready, min_samples, timeout), ready_buffer_elements);
+		std::copy_n(ready.begin(), n, ready_buffer);
+		return static_cast<uint32_t>(n);
+	} LSL_STORE_EXCEPTION_IN(ec)
+	return 0;
+}
+
+} // extern "C"
+
+/// Pull the available data of several inlets, see lsl_pull_chunks_f().
+template <typename T>
+static unsigned long pull_chunks(const lsl_inlet *inlets, uint32_t count, T *const *data_buffers,
+	double *const *timestamp_buffers, const unsigned long *data_buffer_elements,
+	unsigned long *samples_written, int32_t *ec) {
+	unsigned long total = 0;
+	for (uint32_t k = 0; k < count; ++k) {
+		lsl_error_code_t inlet_ec = lsl_argument_error;
+		samples_written[k] = 0;
+		if (inlets[k]) {
+			const uint32_t channels = inlets[k]->channel_count();
+			double *timestamps = timestamp_buffers ? timestamp_buffers[k] : nullptr;
+			samples_written[k] = inlets[k]->pull_chunk_multiplexed_noexcept(data_buffers[k],
+									 timestamps, data_buffer_elements[k],
+									 timestamps ? data_buffer_elements[k] / channels : 0, 0.0,
+									 &inlet_ec) /
+								 channels;
+			total += samples_written[k];
+		}
+		if (ec) ec[k] = inlet_ec;
+	}
+	return total;
+}
+
+extern "C" {
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_f(const lsl_inlet *inlets, uint32_t count,
+	float *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_d(const lsl_inlet *inlets, uint32_t count,
+	double *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_l(const lsl_inlet *inlets, uint32_t count,
+	int64_t *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_i(const lsl_inlet *inlets, uint32_t count,
+	int32_t *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_s(const lsl_inlet *inlets, uint32_t count,
+	int16_t *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API unsigned long lsl_pull_chunks_c(const lsl_inlet *inlets, uint32_t count,
+	char *const *data_buffers, double *const *timestamp_buffers,
+	const unsigned long *data_buffer_elements, unsigned long *samples_written, int32_t *ec) {
+	return pull_chunks(inlets, count, data_buffers, timestamp_buffers, data_buffer_elements,
+		samples_written, ec);
+}
+
+LIBLSL_C_API lsl_recording lsl_create_recording(const char *filename) {
+	if (!filename) return nullptr;
+	return create_object_noexcept<recording>(filename);
+}
+
+LIBLSL_C_API void lsl_destroy_recording(lsl_recording rec) {
+	try {
+		delete rec;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_recording_add(lsl_recording rec, lsl_inlet in, double timeout) {
+	try {
+		rec->add(*in, timeout);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API void lsl_recording_remove(lsl_recording rec, lsl_inlet in) {
+	try {
+		rec->remove(*in);
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
 LIBLSL_C_API uint32_t lsl_samples_available(lsl_inlet in) {
 	try {
 		return (uint32_t)in->samples_available();
 	} catch (std::exception &) { return 0; }
 }
 
+LIBLSL_C_API int32_t lsl_get_inlet_stats(lsl_inlet in, lsl_inlet_stats *stats) {
+	if (!has_sized_struct(stats)) return lsl_argument_error;
+	try {
+		lsl_inlet_stats result{};
+		in->get_stats(result);
+		copy_sized_struct(result, stats);
+		return lsl_no_error;
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error in lsl_get_inlet_stats: %s", e.what());
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_track_latency(lsl_inlet in, int32_t enabled) {
+	try {
+		in->track_latency(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
 LIBLSL_C_API uint32_t lsl_inlet_flush(lsl_inlet in) {
 	return in->flush();
 }
@@ -278,6 +690,163 @@ LIBLSL_C_API uint32_t lsl_was_clock_reset(lsl_inlet in) {
 	} catch (std::exception &) { return 0; }
 }
 
+LIBLSL_C_API int32_t lsl_set_pull_spin_time(lsl_inlet in, double seconds) {
+	if (!(seconds >= 0.0)) return lsl_argument_error;
+	try {
+		in->pull_spin_time(seconds);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_pull_min_samples(lsl_inlet in, uint32_t min_samples) {
+	try {
+		in->pull_min_samples(min_samples);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_socket_options(lsl_inlet in, int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us) {
+	try {
+		in->set_socket_options(send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_multicast(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_multicast(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_datagrams(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_datagrams(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_in_process(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_in_process(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_bundling(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_bundling(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_shared_memory(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_shared_memory(enabled != 0);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_resampling(
+	lsl_inlet in, uint32_t up, uint32_t down, int32_t server_side) {
+	try {
+		in->set_resampling(up, down, server_side != 0);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_value_filter(lsl_inlet in, const char *const *values,
+	uint32_t num_values, const char *const *prefixes, uint32_t num_prefixes, const double *ranges,
+	uint32_t num_ranges) {
+	try {
+		std::vector<std::pair<double, double>> range_pairs;
+		for (uint32_t k = 0; k < num_ranges; ++k)
+			range_pairs.emplace_back(ranges[2 * k], ranges[2 * k + 1]);
+		in->set_value_filter(lsl::value_filter(std::vector<std::string>(values, values + num_values),
+			std::vector<std::string>(prefixes, prefixes + num_prefixes), std::move(range_pairs)));
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_calibration(
+	lsl_inlet in, const double *gains, const double *offsets) {
+	try {
+		const uint32_t channels = in->channel_count();
+		std::vector<double> gain_values, offset_values;
+		if (gains) gain_values.assign(gains, gains + channels);
+		if (offsets) offset_values.assign(offsets, offsets + channels);
+		in->set_calibration(gain_values, offset_values);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_calibration_from_desc(lsl_inlet in, double timeout) {
+	try {
+		in->set_calibration_from_desc(timeout);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_request_history(lsl_inlet in, double seconds) {
+	if (!(seconds >= 0.0)) return lsl_argument_error;
+	try {
+		in->request_history(seconds);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_overflow_policy(
+	lsl_inlet in, lsl_overflow_policy_t policy, double parameter) {
+	try {
+		in->set_overflow_policy(policy, parameter);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_priority(lsl_inlet in, lsl_transfer_priority_t priority) {
+	try {
+		in->set_priority(priority);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_max_bandwidth(lsl_inlet in, double bytes_per_second) {
+	try {
+		in->set_max_bandwidth(bytes_per_second);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_buffering(
+	lsl_inlet in, int32_t max_buflen, int32_t max_chunklen) {
+	try {
+		in->set_buffering(max_buflen, max_chunklen);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_inlet_failover(lsl_inlet in, int32_t enabled) {
+	try {
+		in->set_failover(enabled != 0);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
 LIBLSL_C_API int32_t lsl_smoothing_halftime(lsl_inlet in, float value) {
 	try {
 		in->smoothing_halftime(value);
@@ -1,6 +1,62 @@
+#include "host_daemon.h"
 #include "lsl_c_api_helpers.hpp"
+#include "outlet_group.h"
+#include "relay.h"
+#include "replay.h"
 #include "stream_outlet_impl.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <atomic>
+#include <list>
 #include <loguru.hpp>
+#include <memory>
+#include <mutex>
+
+namespace {
+/**
+ * The threads that tear down outlets in the background (see lsl_destroy_outlet_async()).
+ *
+ * They are joined when the process exits, so they don't run on while the library is unloaded.
+ */
+class teardown_threads {
+public:
+	static teardown_threads &instance() {
+		static teardown_threads threads;
+		return threads;
+	}
+
+	/// Tear down an outlet (after its begin_shutdown()) on a thread of its own.
+	void destroy(lsl::stream_outlet_impl *out) {
+		auto done = std::make_shared<std::atomic<bool>>(false);
+		lsl::managed_thread thread(lsl_thread_io, "outlet_teardown", [out, done]() {
+			try {
+				delete out;
+			} catch (std::exception &e) {
+				LOG_F(WARNING, "Unexpected error during deletion of stream outlet: %s", e.what());
+			}
+			*done = true;
+		});
+		std::lock_guard<std::mutex> lock(mut_);
+		// join the threads that are done, so the list doesn't grow
+		for (auto it = threads_.begin(); it != threads_.end();)
+			if (*it->second) {
+				it->first.join();
+				it = threads_.erase(it);
+			} else
+				++it;
+		threads_.emplace_back(std::move(thread), std::move(done));
+	}
+
+	~teardown_threads() {
+		std::lock_guard<std::mutex> lock(mut_);
+		for (auto &thread : threads_) thread.first.join();
+	}
+
+private:
+	std::mutex mut_;
+	std::list<std::pair<lsl::managed_thread, std::shared_ptr<std::atomic<bool>>>> threads_;
+};
+} // namespace
 
 extern "C" {
 #include "api_types.hpp"
@@ -26,6 +82,27 @@ LIBLSL_C_API void lsl_destroy_outlet(lsl_outlet out) {
 	}
 }
 
+LIBLSL_C_API void lsl_destroy_outlets(lsl_outlet *outlets, int32_t count) {
+	try {
+		for (int32_t k = 0; k < count; ++k)
+			if (outlets[k]) outlets[k]->begin_shutdown();
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error during shutdown of stream outlets: %s", e.what());
+	}
+	for (int32_t k = 0; k < count; ++k) lsl_destroy_outlet(outlets[k]);
+}
+
+LIBLSL_C_API void lsl_destroy_outlet_async(lsl_outlet out) {
+	if (!out) return;
+	try {
+		out->begin_shutdown();
+		teardown_threads::instance().destroy(out);
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Couldn't destroy the stream outlet in the background: %s", e.what());
+		lsl_destroy_outlet(out);
+	}
+}
+
 LIBLSL_C_API int32_t lsl_push_sample_f(lsl_outlet out, const float *data) {
 	return out->push_sample_noexcept(data);
 }
@@ -130,15 +207,10 @@ LIBLSL_C_API int32_t lsl_push_sample_strt(lsl_outlet out, const char **data, dou
 LIBLSL_C_API int32_t lsl_push_sample_strtp(
 	lsl_outlet out, const char **data, double timestamp, int32_t pushthrough) {
 	try {
-		stream_outlet_impl *outimpl = out;
-		std::vector<std::string> tmp;
-		for (uint32_t k = 0; k < (uint32_t)outimpl->info().channel_count(); k++)
-			tmp.emplace_back(data[k]);
-		return outimpl->push_sample_noexcept(&tmp[0], timestamp, pushthrough != 0);
-	} catch (std::exception &e) {
-		LOG_F(WARNING, "Unexpected error during push_sample: %s", e.what());
-		return lsl_internal_error;
+		out->push_buffers(data, nullptr, out->info().channel_count(), nullptr, timestamp,
+			pushthrough != 0);
 	}
+	LSL_RETURN_CAUGHT_EC;
 }
 
 LIBLSL_C_API int32_t lsl_push_sample_buf(
@@ -154,15 +226,10 @@ LIBLSL_C_API int32_t lsl_push_sample_buft(
 LIBLSL_C_API int32_t lsl_push_sample_buftp(lsl_outlet out, const char **data,
 	const uint32_t *lengths, double timestamp, int32_t pushthrough) {
 	try {
-		stream_outlet_impl *outimpl = out;
-		std::vector<std::string> tmp;
-		for (uint32_t k = 0; k < (uint32_t)outimpl->info().channel_count(); k++)
-			tmp.emplace_back(data[k], lengths[k]);
-		return outimpl->push_sample_noexcept(&tmp[0], timestamp, pushthrough);
-	} catch (std::exception &e) {
-		LOG_F(WARNING, "Unexpected error during push_sample: %s", e.what());
-		return lsl_internal_error;
+		out->push_buffers(data, lengths, out->info().channel_count(), nullptr, timestamp,
+			pushthrough != 0);
 	}
+	LSL_RETURN_CAUGHT_EC;
 }
 
 LIBLSL_C_API int32_t lsl_push_chunk_f(
@@ -328,9 +395,7 @@ LIBLSL_C_API int32_t lsl_push_chunk_strt(
 LIBLSL_C_API int32_t lsl_push_chunk_strtp(lsl_outlet out, const char **data,
 	unsigned long data_elements, double timestamp, int32_t pushthrough) {
 	try {
-		std::vector<std::string> tmp;
-		for (unsigned long k = 0; k < data_elements; k++) tmp.emplace_back(data[k]);
-		if (data_elements) out->push_chunk_multiplexed(&tmp[0], tmp.size(), timestamp, pushthrough);
+		out->push_buffers(data, nullptr, data_elements, nullptr, timestamp, pushthrough != 0);
 	}
 	LSL_RETURN_CAUGHT_EC;
 }
@@ -343,11 +408,9 @@ LIBLSL_C_API int32_t lsl_push_chunk_strtn(
 LIBLSL_C_API int32_t lsl_push_chunk_strtnp(lsl_outlet out, const char **data,
 	unsigned long data_elements, const double *timestamps, int32_t pushthrough) {
 	try {
-		if (data_elements) {
-			std::vector<std::string> tmp;
-			for (unsigned long k = 0; k < data_elements; k++) tmp.emplace_back(data[k]);
-			out->push_chunk_multiplexed_noexcept(&tmp[0], timestamps, data_elements, pushthrough);
-		}
+		if (!timestamps)
+			throw std::invalid_argument("The timestamp buffer pointer must not be NULL.");
+		out->push_buffers(data, nullptr, data_elements, timestamps, 0.0, pushthrough != 0);
 	}
 	LSL_RETURN_CAUGHT_EC;
 }
@@ -365,9 +428,7 @@ LIBLSL_C_API int32_t lsl_push_chunk_buft(lsl_outlet out, const char **data, cons
 LIBLSL_C_API int32_t lsl_push_chunk_buftp(lsl_outlet out, const char **data,
 	const uint32_t *lengths, unsigned long data_elements, double timestamp, int32_t pushthrough) {
 	try {
-		std::vector<std::string> tmp;
-		for (unsigned long k = 0; k < data_elements; k++) tmp.emplace_back(data[k], lengths[k]);
-		if (data_elements) out->push_chunk_multiplexed(&tmp[0], tmp.size(), timestamp, pushthrough);
+		out->push_buffers(data, lengths, data_elements, nullptr, timestamp, pushthrough != 0);
 	}
 	LSL_RETURN_CAUGHT_EC;
 }
@@ -381,12 +442,93 @@ LIBLSL_C_API int32_t lsl_push_chunk_buftnp(lsl_outlet out, const char **data,
 	const uint32_t *lengths, unsigned long data_elements, const double *timestamps,
 	int32_t pushthrough) {
 	try {
-		if (data_elements) {
-			std::vector<std::string> tmp;
-			for (unsigned long k = 0; k < data_elements; k++) tmp.emplace_back(data[k], lengths[k]);
-			out->push_chunk_multiplexed(
-				&tmp[0], timestamps, (std::size_t)data_elements, pushthrough);
-		}
+		if (!timestamps)
+			throw std::invalid_argument("The timestamp buffer pointer must not be NULL.");
+		out->push_buffers(data, lengths, data_elements, timestamps, 0.0, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_f(lsl_outlet out, const float *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_d(lsl_outlet out, const double *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_l(lsl_outlet out, const int64_t *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_i(lsl_outlet out, const int32_t *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_s(lsl_outlet out, const int16_t *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_planar_c(lsl_outlet out, const char *const *channels,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_planar(channels, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_strided(lsl_outlet out, const void *data,
+	lsl_channel_format_t element_type, int64_t sample_stride, int64_t channel_stride,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		with_element_type(element_type, [&](auto *type) {
+			out->push_chunk_strided<std::remove_pointer_t<decltype(type)>>(
+				static_cast<const char *>(data), static_cast<std::ptrdiff_t>(sample_stride),
+				static_cast<std::ptrdiff_t>(channel_stride), num_samples, timestamps, timestamp,
+				pushthrough != 0);
+		});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_chunk_raw(lsl_outlet out, const void *data,
+	unsigned long num_bytes, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		out->push_chunk_raw(
+			static_cast<const char *>(data), num_bytes, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_sample_sparse(lsl_outlet out, const uint32_t *indices,
+	const void *values, lsl_channel_format_t element_type, uint32_t count, double timestamp,
+	int32_t pushthrough) {
+	try {
+		with_element_type(element_type, [&](auto *type) {
+			using T = std::remove_pointer_t<decltype(type)>;
+			out->push_sample_sparse<T>(
+				indices, static_cast<const T *>(values), count, timestamp, pushthrough != 0);
+		});
 	}
 	LSL_RETURN_CAUGHT_EC;
 }
@@ -409,7 +551,279 @@ LIBLSL_C_API int32_t lsl_wait_for_consumers(lsl_outlet out, double timeout) {
 	}
 }
 
+LIBLSL_C_API int32_t lsl_set_consumers_callback(
+	lsl_outlet out, lsl_consumers_callback callback, void *user_data) {
+	try {
+		if (!callback)
+			out->set_consumers_callback(nullptr);
+		else
+			out->set_consumers_callback([out, callback, user_data](std::size_t consumers) {
+				callback(out, static_cast<int32_t>(consumers), user_data);
+			});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_wait_for_ready(lsl_outlet out, double timeout) {
+	try {
+		return out->wait_for_ready(timeout);
+	} catch (std::exception &e) {
+		// the outlet can't be assumed to be discoverable
+		LOG_F(WARNING, "Unexpected error in wait_for_ready: %s", e.what());
+		return 0;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_outlet_history(lsl_outlet out, double seconds, int32_t max_samples) {
+	try {
+		out->set_history(seconds, max_samples);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_outlet_socket_options(lsl_outlet out, int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us) {
+	try {
+		out->set_socket_options(send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_outlet_multicast(lsl_outlet out, int32_t enabled) {
+	try {
+		out->set_multicast(enabled != 0);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_set_outlet_chunk_size(lsl_outlet out, int32_t chunk_size) {
+	if (chunk_size < 0) return lsl_argument_error;
+	try {
+		out->set_chunk_size(chunk_size);
+		return lsl_no_error;
+	} catch (std::exception &) { return lsl_internal_error; }
+}
+
+LIBLSL_C_API int32_t lsl_set_outlet_async_push(lsl_outlet out, int32_t buffer_bytes) {
+	if (buffer_bytes < 0) return lsl_argument_error;
+	try {
+		out->set_async_push(static_cast<std::size_t>(buffer_bytes));
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_update_desc(lsl_outlet out, lsl_streaminfo info) {
+	try {
+		out->update_desc(*info);
+		return lsl_no_error;
+	} catch (std::invalid_argument &) { return lsl_argument_error; } catch (std::exception &) {
+		return lsl_internal_error;
+	}
+}
+
+LIBLSL_C_API uint64_t lsl_dropped_samples(lsl_outlet out) {
+	try {
+		return out->dropped_samples();
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error in dropped_samples: %s", e.what());
+		return 0;
+	}
+}
+
+LIBLSL_C_API int32_t lsl_get_outlet_stats(lsl_outlet out, lsl_outlet_stats *stats) {
+	if (!has_sized_struct(stats)) return lsl_argument_error;
+	try {
+		lsl_outlet_stats result{};
+		out->get_stats(result);
+		copy_sized_struct(result, stats);
+		return lsl_no_error;
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error in lsl_get_outlet_stats: %s", e.what());
+		return lsl_internal_error;
+	}
+}
+
 LIBLSL_C_API lsl_streaminfo lsl_get_info(lsl_outlet out) {
 	return create_object_noexcept<stream_info_impl>(out->info());
 }
+
+LIBLSL_C_API lsl_outlet_group lsl_create_outlet_group(const char *name,
+	const lsl_streaminfo *members, int32_t count, int32_t chunk_size, int32_t max_buffered) {
+	if (!name) return nullptr;
+	// the group throws if there are no members or one of them is NULL
+	std::vector<const stream_info_impl *> infos;
+	if (members && count > 0) infos.assign(members, members + count);
+	const bool valid =
+		!infos.empty() && std::find(infos.begin(), infos.end(), nullptr) == infos.end();
+	double buftime = valid ? infos[0]->nominal_srate() : 0.0;
+	if (buftime <= 0) buftime = 100;
+	return create_object_noexcept<outlet_group>(
+		name, infos, chunk_size, static_cast<int>(buftime * max_buffered));
+}
+
+LIBLSL_C_API void lsl_destroy_outlet_group(lsl_outlet_group group) {
+	try {
+		delete group;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API lsl_outlet lsl_outlet_group_outlet(lsl_outlet_group group) {
+	return &group->outlet();
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_f(lsl_outlet_group group, const float *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_d(lsl_outlet_group group, const double *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_l(lsl_outlet_group group, const int64_t *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_i(lsl_outlet_group group, const int32_t *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_s(lsl_outlet_group group, const int16_t *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_push_group_chunk_c(lsl_outlet_group group, const char *const *members,
+	unsigned long num_samples, const double *timestamps, double timestamp, int32_t pushthrough) {
+	try {
+		group->push_chunk(members, num_samples, timestamps, timestamp, pushthrough != 0);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API lsl_replay lsl_create_replay(const char *filename, double speed) {
+	if (!filename) return nullptr;
+	return create_object_noexcept<replay>(filename, speed);
+}
+
+LIBLSL_C_API void lsl_destroy_replay(lsl_replay r) {
+	try {
+		delete r;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_replay_stream_count(lsl_replay r) {
+	return static_cast<int32_t>(r->num_streams());
+}
+
+LIBLSL_C_API lsl_streaminfo lsl_replay_get_info(lsl_replay r, int32_t index) {
+	if (index < 0 || static_cast<std::size_t>(index) >= r->num_streams()) return nullptr;
+	return create_object_noexcept<stream_info_impl>(r->info(index));
+}
+
+LIBLSL_C_API void lsl_replay_start(lsl_replay r) {
+	try {
+		r->start();
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_replay_wait(lsl_replay r, double timeout) {
+	try {
+		return r->wait(timeout) ? 1 : 0;
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+		return 0;
+	}
+}
+
+LIBLSL_C_API lsl_relay lsl_create_relay() { return create_object_noexcept<relay>(); }
+
+LIBLSL_C_API void lsl_destroy_relay(lsl_relay r) {
+	try {
+		delete r;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_relay_add(lsl_relay r, lsl_streaminfo info, double timeout) {
+	if (!info) return lsl_argument_error;
+	try {
+		r->add(*info, timeout);
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_relay_stream_count(lsl_relay r) {
+	try {
+		return static_cast<int32_t>(r->num_streams());
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+		return 0;
+	}
+}
+
+LIBLSL_C_API lsl_streaminfo lsl_relay_get_info(lsl_relay r, int32_t index) {
+	try {
+		const auto infos = r->infos();
+		if (index < 0 || static_cast<std::size_t>(index) >= infos.size()) return nullptr;
+		return new stream_info_impl(infos[index]);
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+		return nullptr;
+	}
+}
+
+LIBLSL_C_API lsl_host_daemon lsl_create_host_daemon(const char *path) {
+	if (!path) return nullptr;
+	return create_object_noexcept<host_daemon>(std::string(path));
+}
+
+LIBLSL_C_API void lsl_destroy_host_daemon(lsl_host_daemon d) {
+	try {
+		delete d;
+	} catch (std::exception &e) { LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what()); }
+}
+
+LIBLSL_C_API int32_t lsl_host_daemon_stream_count(lsl_host_daemon d) {
+	try {
+		return static_cast<int32_t>(d->num_streams());
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+		return 0;
+	}
+}
+
+LIBLSL_C_API lsl_streaminfo lsl_host_daemon_get_info(lsl_host_daemon d, int32_t index) {
+	try {
+		const auto infos = d->infos();
+		if (index < 0 || static_cast<std::size_t>(index) >= infos.size()) return nullptr;
+		return new stream_info_impl(infos[index]);
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+		return nullptr;
+	}
+}
 }
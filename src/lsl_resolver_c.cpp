@@ -1,4 +1,5 @@
 #include "api_config.h"
+#include "discovery_stats.h"
 #include "lsl_c_api_helpers.hpp"
 #include "resolver_impl.h"
 #include <loguru.hpp>
@@ -35,6 +36,35 @@ LIBLSL_C_API int32_t lsl_resolver_results(
 	LSL_RETURN_CAUGHT_EC;
 }
 
+LIBLSL_C_API int32_t lsl_resolver_results_since(lsl_continuous_resolver res, uint64_t *version,
+	lsl_streaminfo *buffer, int32_t *appeared, uint32_t buffer_elements) {
+	if (!version) return lsl_argument_error;
+	try {
+		auto changes = res->results_since(*version, buffer_elements);
+		for (uint32_t k = 0; k < changes.size(); k++) {
+			buffer[k] = new stream_info_impl(changes[k].first);
+			appeared[k] = changes[k].second;
+		}
+		return static_cast<int32_t>(changes.size());
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
+LIBLSL_C_API int32_t lsl_set_resolver_callback(
+	lsl_continuous_resolver res, lsl_resolver_callback callback, void *user_data) {
+	try {
+		if (!callback)
+			res->set_callback(nullptr);
+		else
+			res->set_callback(
+				[res, callback, user_data](const stream_info_impl &info, bool appeared) {
+					stream_info_impl copy(info);
+					callback(res, &copy, appeared, user_data);
+				});
+	}
+	LSL_RETURN_CAUGHT_EC;
+}
+
 LIBLSL_C_API void lsl_destroy_continuous_resolver(lsl_continuous_resolver res) {
 	try {
 		delete res;
@@ -85,4 +115,23 @@ LIBLSL_C_API int32_t lsl_resolve_bypred(lsl_streaminfo *buffer, uint32_t buffer_
 	}
 	LSL_RETURN_CAUGHT_EC;
 }
+
+LIBLSL_C_API lsl_streaminfo lsl_resolve_address(
+	const char *host, int32_t port, const char *uid, double timeout, int32_t *ec) {
+	if (ec) *ec = lsl_no_error;
+	try {
+		if (!host || port <= 0 || port > 65535)
+			throw std::invalid_argument("Invalid host or port.");
+		return new stream_info_impl(resolver_impl::resolve_address(
+			host, static_cast<uint16_t>(port), uid ? uid : "", timeout));
+	}
+	LSL_STORE_EXCEPTION_IN(ec)
+	return nullptr;
+}
+
+LIBLSL_C_API int32_t lsl_get_discovery_stats(lsl_discovery_stats *stats) {
+	if (!stats) return lsl_argument_error;
+	discovery_stats::get().fill(*stats);
+	return lsl_no_error;
+}
 }
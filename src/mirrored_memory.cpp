@@ -0,0 +1,122 @@
+#include "mirrored_memory.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace lsl;
+
+#ifdef _WIN32
+
+std::size_t mirrored_memory::granularity() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+mirrored_memory::mirrored_memory(std::size_t bytes) : size_(bytes) {
+	const auto size64 = static_cast<uint64_t>(bytes);
+	mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+	if (!mapping_)
+		throw std::runtime_error(
+			"Could not create a file mapping: error " + std::to_string(GetLastError()));
+	// find a free range for both views; another thread may take it in between, so try again
+	for (int attempt = 0; attempt < 16 && !data_; ++attempt) {
+		void *range = VirtualAlloc(nullptr, 2 * bytes, MEM_RESERVE, PAGE_NOACCESS);
+		if (!range) break;
+		VirtualFree(range, 0, MEM_RELEASE);
+		void *first = MapViewOfFileEx(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes, range);
+		void *second = first ? MapViewOfFileEx(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes,
+								   static_cast<char *>(range) + bytes)
+							 : nullptr;
+		if (second)
+			data_ = static_cast<char *>(first);
+		else if (first)
+			UnmapViewOfFile(first);
+	}
+	if (!data_) {
+		CloseHandle(mapping_);
+		throw std::runtime_error("Could not map a block of memory twice.");
+	}
+}
+
+mirrored_memory::~mirrored_memory() {
+	UnmapViewOfFile(data_ + size_);
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping_);
+}
+
+#else
+
+/// Create an anonymous file of the given size that's only reachable through its descriptor.
+static int anonymous_file(std::size_t bytes) {
+	int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = static_cast<int>(syscall(SYS_memfd_create, "lsl_ring", 0));
+#elif !defined(__linux__)
+	static std::atomic<unsigned> counter{0};
+	for (int attempt = 0; attempt < 16 && fd < 0; ++attempt) {
+		const std::string name = "/lsl_ring_" + std::to_string(getpid()) + '_' +
+								 std::to_string(counter.fetch_add(1));
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0)
+			shm_unlink(name.c_str());
+		else if (errno != EEXIST)
+			break;
+	}
+#endif
+	if (fd < 0)
+		throw std::runtime_error(
+			std::string("Could not create a shared memory object: ") + std::strerror(errno));
+	if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+		const int err = errno;
+		close(fd);
+		throw std::runtime_error(
+			std::string("Could not resize a shared memory object: ") + std::strerror(err));
+	}
+	return fd;
+}
+
+std::size_t mirrored_memory::granularity() {
+	return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+mirrored_memory::mirrored_memory(std::size_t bytes) : size_(bytes) {
+	const int fd = anonymous_file(bytes);
+	// reserve a range for both mappings, then replace its halves by the file
+	void *range = mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	char *base = static_cast<char *>(range);
+	const bool mapped = range != MAP_FAILED &&
+						mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+							0) != MAP_FAILED &&
+						mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+							fd, 0) != MAP_FAILED;
+	const int err = errno;
+	// the mappings keep the file alive
+	close(fd);
+	if (!mapped) {
+		if (range != MAP_FAILED) munmap(range, 2 * bytes);
+		throw std::runtime_error(
+			std::string("Could not map a block of memory twice: ") + std::strerror(err));
+	}
+	data_ = base;
+}
+
+mirrored_memory::~mirrored_memory() { munmap(data_, 2 * size_); }
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MIRRORED_MEMORY_H
+#define MIRRORED_MEMORY_H
+
+#include <cstddef>
+
+namespace lsl {
+
+/**
+ * A block of memory that's mapped twice back to back, so byte `size() + k` is byte `k`.
+ *
+ * A ring buffer in such a block needs no wrap-around handling: any range of up to size() bytes
+ * that starts in the first mapping is contiguous, even if it crosses the end of the ring.
+ */
+class mirrored_memory {
+public:
+	/**
+	 * Map a block of the given size twice.
+	 * @param bytes The size of the block, a multiple of granularity().
+	 * @throws std::runtime_error if the memory couldn't be mapped.
+	 */
+	explicit mirrored_memory(std::size_t bytes);
+	~mirrored_memory();
+	mirrored_memory(const mirrored_memory &) = delete;
+	mirrored_memory &operator=(const mirrored_memory &) = delete;
+
+	/// The start of the first mapping, followed by the second one.
+	char *data() const { return data_; }
+
+	/// The size of the block (each mapping).
+	std::size_t size() const { return size_; }
+
+	/// The unit of the sizes of blocks (the page size or, on Windows, the allocation granularity).
+	static std::size_t granularity();
+
+private:
+	char *data_{nullptr};
+	std::size_t size_;
+#ifdef _WIN32
+	/// the file mapping (a HANDLE) both views are mapped from
+	void *mapping_{nullptr};
+#endif
+};
+
+} // namespace lsl
+
+#endif
@@ -1,5 +1,11 @@
 #include "netinterfaces.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <cstring>
 #include <loguru.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 
 using asio::ip::address_v4;
 
@@ -19,7 +25,7 @@ asio::ip::address_v6 sinaddr_to_asio(sockaddr_in6 *addr) {
 typedef IP_ADAPTER_UNICAST_ADDRESS_LH Addr;
 typedef IP_ADAPTER_ADDRESSES *AddrList;
 
-std::vector<lsl::netif> lsl::get_local_interfaces() {
+static std::vector<lsl::netif> enumerate_interfaces() {
 	// It's a windows machine, we assume it has 512KB free memory
 	DWORD outBufLen = 1 << 19;
 	AddrList ifaddrs = (AddrList) new char[outBufLen];
@@ -33,7 +39,7 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 	if (res == NO_ERROR) {
 		for (AddrList addr = ifaddrs; addr != 0; addr = addr->Next) {
 			// Interface isn't up or doesn't support multicast? Skip it.
-			LOG_F(INFO, "netif '%s' (status: %d, multicast: %d", addr->AdapterName,
+			LOG_F(1, "netif '%s' (status: %d, multicast: %d", addr->AdapterName,
 				addr->OperStatus, !addr->NoMulticast);
 			if (addr->OperStatus != IfOperStatusUp) continue;
 			if (addr->NoMulticast) continue;
@@ -56,7 +62,7 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 			}
 
 			if (addr->Ipv6Enabled) {
-				LOG_F(INFO, "\tIPv6 ifindex %d", if_.ifindex);
+				LOG_F(1, "\tIPv6 ifindex %d", if_.ifindex);
 				for (Addr *uaddr = addr->FirstUnicastAddress; uaddr != 0; uaddr = uaddr->Next) {
 					if (uaddr->Address.lpSockaddr->sa_family != AF_INET6) continue;
 
@@ -77,7 +83,7 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 #include <ifaddrs.h>
 #include <net/if.h>
 
-std::vector<lsl::netif> lsl::get_local_interfaces() {
+static std::vector<lsl::netif> enumerate_interfaces() {
 	std::vector<lsl::netif> res;
 	ifaddrs *ifs;
 	if (getifaddrs(&ifs)) {
@@ -87,7 +93,7 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 	for (auto *addr = ifs; addr != nullptr; addr = addr->ifa_next) {
 		// No address? Skip.
 		if (addr->ifa_addr == nullptr) continue;
-		LOG_F(INFO, "netif '%s' (status: %d, multicast: %d, broadcast: %d)", addr->ifa_name,
+		LOG_F(1, "netif '%s' (status: %d, multicast: %d, broadcast: %d)", addr->ifa_name,
 			addr->ifa_flags & IFF_MULTICAST, addr->ifa_flags & IFF_UP,
 			addr->ifa_flags & IFF_BROADCAST);
 		// Interface doesn't support multicast? Skip.
@@ -100,10 +106,10 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 		if (addr->ifa_addr->sa_family == AF_INET) {
 			if_.addr = asio::ip::make_address_v4(
 				ntohl(reinterpret_cast<sockaddr_in *>(addr->ifa_addr)->sin_addr.s_addr));
-			LOG_F(INFO, "\tIPv4 addr: %x", if_.addr.to_v4().to_uint());
+			LOG_F(1, "\tIPv4 addr: %x", if_.addr.to_v4().to_uint());
 		} else if (addr->ifa_addr->sa_family == AF_INET6) {
 			if_.addr = sinaddr_to_asio(reinterpret_cast<sockaddr_in6 *>(addr->ifa_addr));
-			LOG_F(INFO, "\tIPv6 addr: %s", if_.addr.to_string().c_str());
+			LOG_F(1, "\tIPv6 addr: %s", if_.addr.to_string().c_str());
 		} else
 			continue;
 
@@ -115,8 +121,199 @@ std::vector<lsl::netif> lsl::get_local_interfaces() {
 }
 #else
 
-std::vector<lsl::netif> get_interface_addresses() {
+static std::vector<lsl::netif> enumerate_interfaces() {
 	LOG_F(WARNING, "No implementation to enumerate network interfaces found.");
 	return std::vector<lsl::netif>();
 }
 #endif
+
+namespace {
+
+class interface_monitor;
+
+/// The cached interfaces and the listeners for their changes.
+struct interface_registry {
+	std::mutex mut;
+	/// the interfaces as of the last change (only kept up to date while they're monitored)
+	std::vector<lsl::netif> interfaces;
+	std::map<int, lsl::interface_listener> listeners;
+	int next_id{0};
+	/// watches the interfaces while there are listeners
+	std::unique_ptr<interface_monitor> monitor;
+
+	static interface_registry &instance() {
+		static interface_registry registry;
+		return registry;
+	}
+};
+
+bool same_interface(const lsl::netif &a, const lsl::netif &b) {
+	return a.ifindex == b.ifindex && a.addr == b.addr;
+}
+
+/// Enumerate the interfaces again and tell the listeners what changed.
+void refresh_interfaces() {
+	std::vector<lsl::netif> current = enumerate_interfaces();
+	interface_registry &registry = interface_registry::instance();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	if (!registry.monitor) return;
+	std::vector<lsl::netif> added, removed;
+	const auto missing_in = [](const std::vector<lsl::netif> &list, std::vector<lsl::netif> &out) {
+		return [&list, &out](const lsl::netif &netif) {
+			if (std::none_of(list.begin(), list.end(),
+					[&netif](const lsl::netif &other) { return same_interface(netif, other); }))
+				out.push_back(netif);
+		};
+	};
+	std::for_each(current.begin(), current.end(), missing_in(registry.interfaces, added));
+	std::for_each(
+		registry.interfaces.begin(), registry.interfaces.end(), missing_in(current, removed));
+	registry.interfaces = std::move(current);
+	if (added.empty() && removed.empty()) return;
+	LOG_F(INFO, "The network interfaces changed: %d addresses added, %d removed",
+		static_cast<int>(added.size()), static_cast<int>(removed.size()));
+	// the mutex is held, so the listeners aren't called anymore once they're removed
+	for (const auto &listener : registry.listeners) listener.second(added, removed);
+}
+
+} // namespace
+
+#if defined(_WIN32)
+namespace {
+
+/// Calls refresh_interfaces() when Windows reports a change of an interface or an address.
+class interface_monitor {
+public:
+	interface_monitor() {
+		if (NotifyIpInterfaceChange(AF_UNSPEC, &on_interface_change, nullptr, FALSE,
+				&interface_handle_) != NO_ERROR)
+			interface_handle_ = nullptr;
+		if (NotifyUnicastIpAddressChange(AF_UNSPEC, &on_address_change, nullptr, FALSE,
+				&address_handle_) != NO_ERROR)
+			address_handle_ = nullptr;
+		if (!interface_handle_ || !address_handle_)
+			LOG_F(WARNING, "Can't watch the network interfaces for changes");
+	}
+
+	~interface_monitor() {
+		// waits for running callbacks
+		if (interface_handle_) CancelMibChangeNotify2(interface_handle_);
+		if (address_handle_) CancelMibChangeNotify2(address_handle_);
+	}
+
+private:
+	static VOID NETIOAPI_API_ on_interface_change(
+		PVOID, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE) {
+		refresh_interfaces();
+	}
+	static VOID NETIOAPI_API_ on_address_change(
+		PVOID, PMIB_UNICASTIPADDRESS_ROW, MIB_NOTIFICATION_TYPE) {
+		refresh_interfaces();
+	}
+
+	HANDLE interface_handle_{nullptr}, address_handle_{nullptr};
+};
+
+} // namespace
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/// Calls refresh_interfaces() when the kernel reports a change of a link or an address.
+class interface_monitor {
+public:
+	interface_monitor() {
+		sockaddr_nl addr{};
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+		netlink_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+		if (netlink_ < 0 || bind(netlink_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+			pipe2(stop_, O_CLOEXEC)) {
+			LOG_F(WARNING, "Can't watch the network interfaces for changes: %s", strerror(errno));
+			return;
+		}
+		thread_ = lsl::managed_thread(lsl_thread_io, "netmon", &interface_monitor::run, this);
+	}
+
+	~interface_monitor() {
+		if (thread_.joinable()) {
+			const char stop = 0;
+			if (write(stop_[1], &stop, 1) == 1)
+				thread_.join();
+			else
+				thread_.detach();
+		}
+		for (int fd : {netlink_, stop_[0], stop_[1]})
+			if (fd >= 0) close(fd);
+	}
+
+private:
+	void run() {
+		pollfd fds[2] = {{netlink_, POLLIN, 0}, {stop_[0], POLLIN, 0}};
+		char buffer[8192];
+		while (true) {
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR) continue;
+				LOG_F(WARNING, "Stopped watching the network interfaces: %s", strerror(errno));
+				return;
+			}
+			if (fds[1].revents) return;
+			// the messages aren't parsed, the interfaces are simply enumerated again once all
+			// messages of a burst were read
+			while (recv(netlink_, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {}
+			refresh_interfaces();
+		}
+	}
+
+	int netlink_{-1};
+	int stop_[2]{-1, -1};
+	lsl::managed_thread thread_;
+};
+
+} // namespace
+#else
+namespace {
+
+/// Changes aren't reported on this platform.
+class interface_monitor {};
+
+} // namespace
+#endif
+
+std::vector<lsl::netif> lsl::get_local_interfaces() {
+	interface_registry &registry = interface_registry::instance();
+	{
+		std::lock_guard<std::mutex> lock(registry.mut);
+		if (registry.monitor) return registry.interfaces;
+	}
+	return enumerate_interfaces();
+}
+
+int lsl::add_interface_listener(interface_listener listener) {
+	interface_registry &registry = interface_registry::instance();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	if (!registry.monitor) {
+		registry.interfaces = enumerate_interfaces();
+		registry.monitor.reset(new interface_monitor());
+	}
+	registry.listeners[registry.next_id] = std::move(listener);
+	return registry.next_id++;
+}
+
+void lsl::remove_interface_listener(int id) {
+	interface_registry &registry = interface_registry::instance();
+	std::unique_ptr<interface_monitor> monitor;
+	{
+		std::lock_guard<std::mutex> lock(registry.mut);
+		registry.listeners.erase(id);
+		if (registry.listeners.empty()) monitor = std::move(registry.monitor);
+	}
+	// the monitor thread might be waiting for the mutex
+	monitor.reset();
+}
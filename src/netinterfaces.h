@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <boost/asio/ip/address.hpp>
@@ -15,6 +16,25 @@ public:
 	std::string name;
 };
 
-/// Enumerate all local interface addresses (IPv6 index, IPv4 address)-pairs
+/// Enumerate all local interface addresses (IPv6 index, IPv4 address)-pairs.
+/// While interface listeners are registered, the cached list is returned.
 std::vector<netif> get_local_interfaces();
+
+/// Called with the interface addresses that were added and removed.
+using interface_listener =
+	std::function<void(const std::vector<netif> &added, const std::vector<netif> &removed)>;
+
+/**
+ * Register a listener for changes of the local interfaces.
+ *
+ * The interfaces are watched (via netlink on Linux and IP Helper notifications on Windows, other
+ * platforms report no changes) as long as any listeners are registered. The listeners are called
+ * from the watching thread, so they should return quickly.
+ * @return An id for remove_interface_listener().
+ */
+int add_interface_listener(interface_listener listener);
+
+/// Remove a listener. It's not called anymore once this returns, so it mustn't be called from a
+/// listener.
+void remove_interface_listener(int id);
 } // namespace lsl
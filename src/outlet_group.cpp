@@ -0,0 +1,92 @@
+#include "outlet_group.h"
+#include "stream_info_impl.h"
+#include "stream_outlet_impl.h"
+#include <algorithm>
+#include <pugixml.hpp>
+#include <stdexcept>
+
+using namespace lsl;
+
+outlet_group::outlet_group(const std::string &name,
+	const std::vector<const stream_info_impl *> &members, int32_t chunk_size, int32_t max_capacity)
+	: outlet_(new stream_outlet_impl(group_info(name, members), chunk_size, max_capacity)) {
+	for (const auto *member : members) channels_.push_back(member->channel_count());
+	total_channels_ = outlet_->info().channel_count();
+}
+
+outlet_group::~outlet_group() = default;
+
+stream_info_impl outlet_group::group_info(
+	const std::string &name, const std::vector<const stream_info_impl *> &members) {
+	const char *channel_format_strings[] = {"undefined", "float32", "double64", "string",
+		"int32", "int16", "int8", "int64", "int24", "float16"};
+	if (members.empty()) throw std::invalid_argument("An outlet group needs at least one member.");
+	if (std::find(members.begin(), members.end(), nullptr) != members.end())
+		throw std::invalid_argument("The member stream infos must not be NULL.");
+	int channels = 0;
+	lsl_channel_format_t format = members.front()->channel_format();
+	std::string source_id;
+	bool all_sourced = true;
+	for (const auto *member : members) {
+		if (member->channel_format() == cft_string || member->channel_format() == cft_undefined)
+			throw std::invalid_argument("Only numeric streams can be grouped.");
+		if (member->nominal_srate() != members.front()->nominal_srate())
+			throw std::invalid_argument("The members of a group need the same sampling rate.");
+		if (member->channel_format() != format) format = cft_double64;
+		channels += member->channel_count();
+		all_sourced = all_sourced && !member->source_id().empty();
+		source_id += (source_id.empty() ? "" : "+") + member->source_id();
+	}
+	// the group can only be recovered if all of its members can
+	stream_info_impl info(name, "Group", channels, members.front()->nominal_srate(), format,
+		all_sourced ? source_id : std::string());
+	pugi::xml_node streams = info.desc().append_child("streams");
+	int offset = 0;
+	for (const auto *member : members) {
+		pugi::xml_node stream = streams.append_child("stream");
+		stream.append_child("name").text().set(member->name().c_str());
+		stream.append_child("type").text().set(member->type().c_str());
+		stream.append_child("channel_count").text().set(member->channel_count());
+		stream.append_child("channel_format")
+			.text()
+			.set(channel_format_strings[member->channel_format()]);
+		stream.append_child("source_id").text().set(member->source_id().c_str());
+		stream.append_child("offset").text().set(offset);
+		stream.append_copy(member->desc());
+		offset += member->channel_count();
+	}
+	return info;
+}
+
+template <class T>
+void outlet_group::push_chunk(const T *const *members, std::size_t num_samples,
+	const double *timestamps, double timestamp, bool pushthrough) {
+	if (!num_samples) return;
+	if (!members) throw std::invalid_argument("The member pointers must not be NULL.");
+	for (std::size_t m = 0; m < channels_.size(); m++)
+		if (!members[m]) throw std::invalid_argument("The member pointers must not be NULL.");
+	// the group's samples, reused by each thread
+	static thread_local std::vector<T> buffer;
+	buffer.resize(num_samples * total_channels_);
+	T *out = buffer.data();
+	for (std::size_t k = 0; k < num_samples; k++)
+		for (std::size_t m = 0; m < channels_.size(); m++)
+			out = std::copy_n(members[m] + k * channels_[m], channels_[m], out);
+	if (timestamps)
+		outlet_->push_chunk_multiplexed(buffer.data(), timestamps, buffer.size(), pushthrough);
+	else
+		outlet_->push_chunk_multiplexed(buffer.data(), buffer.size(), timestamp, pushthrough);
+}
+
+template void outlet_group::push_chunk<char>(
+	const char *const *, std::size_t, const double *, double, bool);
+template void outlet_group::push_chunk<int16_t>(
+	const int16_t *const *, std::size_t, const double *, double, bool);
+template void outlet_group::push_chunk<int32_t>(
+	const int32_t *const *, std::size_t, const double *, double, bool);
+template void outlet_group::push_chunk<int64_t>(
+	const int64_t *const *, std::size_t, const double *, double, bool);
+template void outlet_group::push_chunk<float>(
+	const float *const *, std::size_t, const double *, double, bool);
+template void outlet_group::push_chunk<double>(
+	const double *const *, std::size_t, const double *, double, bool);
@@ -0,0 +1,83 @@
+#ifndef OUTLET_GROUP_H
+#define OUTLET_GROUP_H
+
+#include "common.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lsl {
+class stream_info_impl;
+class stream_outlet_impl;
+
+/**
+ * An outlet for several streams that come from one device (and one clock), e.g. the EEG,
+ * accelerometer and trigger channels of an amplifier.
+ *
+ * The members are published as a single stream whose samples hold the channels of all members
+ * back to back, so each sample of the group carries the values of all members with one time
+ * stamp, and subscribers get them aligned over one connection instead of re-aligning several
+ * streams. The layout is described in the group's stream info:
+ *
+ *     <desc><streams><stream>
+ *       <name/><type/><channel_count/><channel_format/><source_id/>
+ *       <offset/> (the index of the member's first channel in the group's samples)
+ *       <desc/> (a copy of the member's description)
+ *     </stream>...</streams></desc>
+ *
+ * All members need the same nominal sampling rate and a numeric channel format. The group's
+ * format is the members' format if they agree and double otherwise.
+ */
+class outlet_group {
+public:
+	/**
+	 * Create the group's outlet.
+	 * @param name The name of the group's stream.
+	 * @param members The stream infos of the members.
+	 * @param chunk_size, max_capacity See stream_outlet_impl.
+	 * @throws std::invalid_argument if there are no members or they can't be grouped.
+	 */
+	outlet_group(const std::string &name, const std::vector<const stream_info_impl *> &members,
+		int32_t chunk_size = 0, int32_t max_capacity = 512000);
+
+	~outlet_group();
+
+	outlet_group(const outlet_group &) = delete;
+	outlet_group &operator=(const outlet_group &) = delete;
+
+	/// Build the stream info of a group, see outlet_group().
+	static stream_info_impl group_info(
+		const std::string &name, const std::vector<const stream_info_impl *> &members);
+
+	/// The outlet of the group's stream (owned by the group).
+	stream_outlet_impl &outlet() { return *outlet_; }
+
+	/// The number of members.
+	std::size_t member_count() const { return channels_.size(); }
+
+	/**
+	 * Push a chunk of samples of all members.
+	 *
+	 * The channels of the members are interleaved into the group's samples, which are then pushed
+	 * like with stream_outlet_impl::push_chunk_multiplexed().
+	 * @param members One pointer per member to its multiplexed values of num_samples samples.
+	 * @param timestamps One time stamp per sample, or nullptr to use `timestamp` (or the current
+	 * time if it's 0) for the most recent sample.
+	 */
+	template <class T>
+	void push_chunk(const T *const *members, std::size_t num_samples, const double *timestamps,
+		double timestamp, bool pushthrough);
+
+private:
+	std::unique_ptr<stream_outlet_impl> outlet_;
+	/// the channel count of each member
+	std::vector<uint32_t> channels_;
+	/// the channel count of the group
+	uint32_t total_channels_{0};
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,414 @@
+#include "rdma_transport.h"
+#include "common.h"
+#include "consumer_queue.h"
+#include "datagram_sender.h"
+#include "sample.h"
+#include "send_buffer.h"
+#include "stream_info_impl.h"
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <loguru.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef LSL_RDMA
+#include <cerrno>
+#include <cmath>
+#include <infiniband/verbs.h>
+#include <poll.h>
+#include <random>
+#endif
+
+using namespace lsl;
+
+std::string rdma_address::to_string() const {
+	std::ostringstream os;
+	os << lid << ' ' << gid << ' ' << qpn << ' ' << psn << ' ' << addr << ' ' << rkey << ' '
+	   << slots << ' ' << slot_bytes;
+	return os.str();
+}
+
+rdma_address rdma_address::parse(const std::string &str) {
+	rdma_address result;
+	std::istringstream is(str);
+	if (!(is >> result.lid >> result.gid >> result.qpn >> result.psn >> result.addr >>
+			result.rkey >> result.slots >> result.slot_bytes) ||
+		result.gid.size() != 32 ||
+		result.gid.find_first_not_of("0123456789abcdef") != std::string::npos)
+		throw std::invalid_argument("Malformed RDMA address: " + str);
+	return result;
+}
+
+#ifdef LSL_RDMA
+
+static void check(int err, const char *what) {
+	if (err) throw std::runtime_error(std::string(what) + " failed: " + strerror(err));
+}
+
+template <typename T> static T *check(T *ptr, const char *what) {
+	if (!ptr) throw std::runtime_error(std::string(what) + " failed: " + strerror(errno));
+	return ptr;
+}
+
+bool lsl::rdma_available() {
+	static const bool available = []() {
+		int num_devices = 0;
+		ibv_device **devices = ibv_get_device_list(&num_devices);
+		if (devices) ibv_free_device_list(devices);
+		return num_devices > 0;
+	}();
+	return available;
+}
+
+struct rdma_endpoint::impl {
+	/// the port of the device that's used
+	static const uint8_t port = 1;
+
+	ibv_context *ctx{nullptr};
+	ibv_pd *pd{nullptr};
+	ibv_comp_channel *channel{nullptr};
+	ibv_cq *cq{nullptr};
+	ibv_qp *qp{nullptr};
+	ibv_mr *mr{nullptr};
+	std::unique_ptr<char[]> ring;
+	ibv_port_attr port_attr{};
+	rdma_address local, remote;
+	/// the number of writes posted so far, and of those that didn't complete yet
+	uint64_t sent{0};
+	uint32_t in_flight{0};
+
+	~impl() {
+		if (qp) ibv_destroy_qp(qp);
+		if (mr) ibv_dereg_mr(mr);
+		if (cq) ibv_destroy_cq(cq);
+		if (channel) ibv_destroy_comp_channel(channel);
+		if (pd) ibv_dealloc_pd(pd);
+		if (ctx) ibv_close_device(ctx);
+	}
+
+	/// Wait for the next completion; false if there was none within the timeout.
+	bool wait(ibv_wc &wc, double timeout) {
+		const double deadline = lsl_clock() + timeout;
+		while (true) {
+			int n = ibv_poll_cq(cq, 1, &wc);
+			if (n == 0) {
+				// arm the notification, then check again for completions that came in before
+				check(ibv_req_notify_cq(cq, 0), "ibv_req_notify_cq");
+				n = ibv_poll_cq(cq, 1, &wc);
+			}
+			if (n < 0) throw std::runtime_error("ibv_poll_cq failed.");
+			if (n > 0) {
+				if (wc.status != IBV_WC_SUCCESS)
+					throw std::runtime_error(
+						std::string("An RDMA transfer failed: ") + ibv_wc_status_str(wc.status));
+				return true;
+			}
+			const double remaining = deadline - lsl_clock();
+			if (remaining <= 0.0) return false;
+			pollfd pfd{channel->fd, POLLIN, 0};
+			const int ready = ::poll(&pfd, 1, static_cast<int>(std::ceil(remaining * 1000)));
+			if (ready < 0 && errno != EINTR) check(errno, "poll");
+			if (ready <= 0) continue;
+			ibv_cq *event_cq = nullptr;
+			void *event_ctx = nullptr;
+			if (ibv_get_cq_event(channel, &event_cq, &event_ctx)) check(errno, "ibv_get_cq_event");
+			ibv_ack_cq_events(event_cq, 1);
+		}
+	}
+
+	void post_receive() {
+		// the writes with immediate data only consume the receive, so it needs no buffer
+		ibv_recv_wr wr{}, *bad = nullptr;
+		check(ibv_post_recv(qp, &wr, &bad), "ibv_post_recv");
+	}
+};
+
+rdma_endpoint::rdma_endpoint(uint32_t slots, uint32_t slot_bytes) : impl_(new impl()) {
+	impl &d = *impl_;
+	int num_devices = 0;
+	ibv_device **devices = ibv_get_device_list(&num_devices);
+	if (!devices || !num_devices) {
+		if (devices) ibv_free_device_list(devices);
+		throw std::runtime_error("No RDMA device found.");
+	}
+	d.ctx = ibv_open_device(devices[0]);
+	ibv_free_device_list(devices);
+	check(d.ctx, "ibv_open_device");
+	check(ibv_query_port(d.ctx, impl::port, &d.port_attr), "ibv_query_port");
+	ibv_gid gid;
+	check(ibv_query_gid(d.ctx, impl::port, 0, &gid), "ibv_query_gid");
+
+	d.pd = check(ibv_alloc_pd(d.ctx), "ibv_alloc_pd");
+	d.channel = check(ibv_create_comp_channel(d.ctx), "ibv_create_comp_channel");
+	d.cq = check(
+		ibv_create_cq(d.ctx, static_cast<int>(slots), nullptr, d.channel, 0), "ibv_create_cq");
+	const std::size_t ring_bytes = static_cast<std::size_t>(slots) * slot_bytes;
+	d.ring.reset(new char[ring_bytes]);
+	d.mr = check(ibv_reg_mr(d.pd, d.ring.get(), ring_bytes,
+					 IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE),
+		"ibv_reg_mr");
+
+	ibv_qp_init_attr init{};
+	init.send_cq = init.recv_cq = d.cq;
+	init.qp_type = IBV_QPT_RC;
+	init.cap.max_send_wr = init.cap.max_recv_wr = slots;
+	init.cap.max_send_sge = init.cap.max_recv_sge = 1;
+	d.qp = check(ibv_create_qp(d.pd, &init), "ibv_create_qp");
+	ibv_qp_attr attr{};
+	attr.qp_state = IBV_QPS_INIT;
+	attr.pkey_index = 0;
+	attr.port_num = impl::port;
+	attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE;
+	check(ibv_modify_qp(
+			  d.qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS),
+		"ibv_modify_qp(INIT)");
+
+	d.local.lid = d.port_attr.lid;
+	static const char hex[] = "0123456789abcdef";
+	for (uint8_t byte : gid.raw) {
+		d.local.gid += hex[byte >> 4];
+		d.local.gid += hex[byte & 15];
+	}
+	d.local.qpn = d.qp->qp_num;
+	d.local.psn = std::random_device()() & 0xffffff;
+	d.local.addr = reinterpret_cast<uintptr_t>(d.ring.get());
+	d.local.rkey = d.mr->rkey;
+	d.local.slots = slots;
+	d.local.slot_bytes = slot_bytes;
+}
+
+void rdma_endpoint::connect(const rdma_address &remote) {
+	impl &d = *impl_;
+	d.remote = remote;
+	ibv_qp_attr attr{};
+	attr.qp_state = IBV_QPS_RTR;
+	attr.path_mtu = d.port_attr.active_mtu;
+	attr.dest_qp_num = remote.qpn;
+	attr.rq_psn = remote.psn;
+	attr.max_dest_rd_atomic = 1;
+	// 0.64 ms until a write that found no posted receive is retried
+	attr.min_rnr_timer = 12;
+	attr.ah_attr.dlid = remote.lid;
+	attr.ah_attr.port_num = impl::port;
+	if (d.port_attr.link_layer == IBV_LINK_LAYER_ETHERNET || !remote.lid) {
+		// RoCE (and routed InfiniBand) addresses the other port by its GID
+		attr.ah_attr.is_global = 1;
+		for (std::size_t i = 0; i < sizeof(attr.ah_attr.grh.dgid.raw); ++i)
+			attr.ah_attr.grh.dgid.raw[i] =
+				static_cast<uint8_t>(std::stoul(remote.gid.substr(2 * i, 2), nullptr, 16));
+		attr.ah_attr.grh.sgid_index = 0;
+		attr.ah_attr.grh.hop_limit = 64;
+	}
+	check(ibv_modify_qp(d.qp, &attr,
+			  IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+				  IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER),
+		"ibv_modify_qp(RTR)");
+	attr = ibv_qp_attr{};
+	attr.qp_state = IBV_QPS_RTS;
+	// the writes are acknowledged within 0.5 s (the inlet connects a bit after the outlet) and
+	// retried indefinitely while the inlet has no receives posted
+	attr.timeout = 17;
+	attr.retry_cnt = 7;
+	attr.rnr_retry = 7;
+	attr.sq_psn = d.local.psn;
+	attr.max_rd_atomic = 1;
+	check(ibv_modify_qp(d.qp, &attr,
+			  IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+				  IBV_QP_MAX_QP_RD_ATOMIC),
+		"ibv_modify_qp(RTS)");
+}
+
+void rdma_endpoint::post_receives() {
+	for (uint32_t k = 0; k < credits(); ++k) impl_->post_receive();
+}
+
+std::size_t rdma_endpoint::receive(asio::streambuf &dst, double timeout) {
+	impl &d = *impl_;
+	ibv_wc wc;
+	if (!d.wait(wc, timeout)) return 0;
+	const uint32_t slot = lslboost::endian::big_to_native(wc.imm_data);
+	if (wc.opcode != IBV_WC_RECV_RDMA_WITH_IMM || slot >= d.local.slots ||
+		wc.byte_len > d.local.slot_bytes)
+		throw std::runtime_error("Received an unexpected RDMA completion.");
+	memcpy(dst.prepare(wc.byte_len).data(), d.ring.get() + slot * d.local.slot_bytes,
+		wc.byte_len);
+	dst.commit(wc.byte_len);
+	// the slot can be written again
+	d.post_receive();
+	return wc.byte_len;
+}
+
+char *rdma_endpoint::send_slot(double timeout) {
+	impl &d = *impl_;
+	// the completions arrive in order, so the oldest write in flight used the next slot; and a
+	// write that completed consumed a receive the inlet posted after decoding the slot that's
+	// overwritten now
+	while (d.in_flight == d.remote.slots / 2) {
+		ibv_wc wc;
+		if (!d.wait(wc, timeout)) return nullptr;
+		--d.in_flight;
+	}
+	return d.ring.get() + (d.sent % d.local.slots) * d.local.slot_bytes;
+}
+
+void rdma_endpoint::post_send(std::size_t len) {
+	impl &d = *impl_;
+	const uint32_t slot = static_cast<uint32_t>(d.sent % d.local.slots),
+				   remote_slot = static_cast<uint32_t>(d.sent % d.remote.slots);
+	ibv_sge sge{};
+	sge.addr = reinterpret_cast<uintptr_t>(d.ring.get() + slot * d.local.slot_bytes);
+	sge.length = static_cast<uint32_t>(len);
+	sge.lkey = d.mr->lkey;
+	ibv_send_wr wr{}, *bad = nullptr;
+	wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+	wr.sg_list = &sge;
+	wr.num_sge = 1;
+	wr.send_flags = IBV_SEND_SIGNALED;
+	wr.imm_data = lslboost::endian::native_to_big(remote_slot);
+	wr.wr.rdma.remote_addr =
+		d.remote.addr + static_cast<uint64_t>(remote_slot) * d.remote.slot_bytes;
+	wr.wr.rdma.rkey = d.remote.rkey;
+	check(ibv_post_send(d.qp, &wr, &bad), "ibv_post_send");
+	++d.sent;
+	++d.in_flight;
+}
+
+#else
+
+bool lsl::rdma_available() { return false; }
+
+struct rdma_endpoint::impl {
+	rdma_address local;
+};
+
+[[noreturn]] static void unsupported() {
+	throw std::runtime_error("liblsl was built without RDMA support (see LSL_RDMA).");
+}
+
+rdma_endpoint::rdma_endpoint(uint32_t /*slots*/, uint32_t /*slot_bytes*/) { unsupported(); }
+void rdma_endpoint::connect(const rdma_address & /*remote*/) { unsupported(); }
+void rdma_endpoint::post_receives() { unsupported(); }
+std::size_t rdma_endpoint::receive(asio::streambuf & /*dst*/, double /*timeout*/) {
+	unsupported();
+}
+char *rdma_endpoint::send_slot(double /*timeout*/) { unsupported(); }
+void rdma_endpoint::post_send(std::size_t /*len*/) { unsupported(); }
+
+#endif
+
+rdma_endpoint::~rdma_endpoint() = default;
+
+const rdma_address &rdma_endpoint::local() const { return impl_->local; }
+
+uint32_t rdma_endpoint::credits() const { return impl_->local.slots / 2; }
+
+/// Serializes the samples right into an endpoint's slot, after the slot header.
+class rdma_sender::slot_buf : public std::streambuf {
+public:
+	void reset(char *slot, std::size_t bytes) {
+		slot_ = slot;
+		setp(slot + datagram_sender::header_bytes, slot + bytes);
+	}
+	char *slot() const { return slot_; }
+	std::size_t size() const { return static_cast<std::size_t>(pptr() - slot_); }
+
+private:
+	char *slot_{nullptr};
+};
+
+template <typename T> static void put(std::streambuf &sb, T value) {
+	lslboost::endian::native_to_little_inplace(value);
+	sb.sputn(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// The number of slots of an inlet's ring, after checking that the slots are usable.
+static uint32_t checked_slots(const rdma_address &remote) {
+	if (remote.slots < 2 || remote.slots > 1024 || remote.slot_bytes > (1 << 24))
+		throw std::invalid_argument("The inlet's RDMA ring is too small or too large.");
+	return remote.slots;
+}
+
+rdma_sender::rdma_sender(stream_info_impl_p info, send_buffer_p send_buffer,
+	const rdma_address &remote, int max_buffered)
+	: info_(std::move(info)), send_buffer_(std::move(send_buffer)),
+	  endpoint_(checked_slots(remote), remote.slot_bytes),
+	  key_(std::hash<std::string>()(info_->uid())), slot_(new slot_buf()) {
+	if (info_->channel_format() == cft_string)
+		throw std::invalid_argument("String samples can't be sent by RDMA.");
+	// sequence number, tag, time stamp and values
+	const std::size_t sample_bytes = sizeof(uint64_t) + 1 + sizeof(double) +
+									 format_sizes[info_->channel_format()] * info_->channel_count();
+	if (datagram_sender::header_bytes + sample_bytes > remote.slot_bytes)
+		throw std::invalid_argument("The samples are too large for the inlet's RDMA slots.");
+	samples_per_slot_ = std::min<std::size_t>(
+		(remote.slot_bytes - datagram_sender::header_bytes) / sample_bytes,
+		std::numeric_limits<uint16_t>::max());
+	scratch_.reset(new char[format_sizes[info_->channel_format()] * info_->channel_count()]);
+	endpoint_.connect(remote);
+	queue_ = send_buffer_->new_consumer(max_buffered);
+	thread_ = managed_thread(lsl_thread_transfer, "R_" + info_->name().substr(0, 12),
+		&rdma_sender::sender_thread, this);
+}
+
+rdma_sender::~rdma_sender() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+	}
+	// wake up the thread if it's waiting for a sample
+	queue_->push_sample(sample_p());
+	thread_.join();
+}
+
+bool rdma_sender::next_slot() {
+	for (double waited = 0.0;; waited += heartbeat_interval) {
+		if (char *slot = endpoint_.send_slot(heartbeat_interval)) {
+			slot_->reset(slot, endpoint_.local().slot_bytes);
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			if (stop_) return false;
+		}
+		if (waited >= write_timeout) throw std::runtime_error("The inlet stopped receiving.");
+	}
+}
+
+void rdma_sender::sender_thread() {
+	pin_to_numa_node(send_buffer_->numa_node());
+	try {
+		if (!next_slot()) return;
+		while (true) {
+			sample_p samp(queue_->pop_sample(heartbeat_interval));
+			if (samp) {
+				put(*slot_, samp->seq);
+				samp->save_streambuf(*slot_, 110, BOOST_BYTE_ORDER, scratch_.get());
+				last_seq_ = samp->seq;
+				if (++num_samples_ < samples_per_slot_ && !samp->pushthrough) continue;
+			} else {
+				// a heartbeat, or the wakeup sample of the destructor
+				std::lock_guard<std::mutex> lock(mut_);
+				if (stop_) return;
+			}
+			send_slot();
+			if (!next_slot()) return;
+		}
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error while sending the samples of %s by RDMA: %s",
+			info_->name().c_str(), e.what());
+	}
+}
+
+void rdma_sender::send_slot() {
+	char *header = slot_->slot();
+	const uint64_t key = lslboost::endian::native_to_little(key_),
+				   last_seq = lslboost::endian::native_to_little(last_seq_);
+	const uint16_t count = lslboost::endian::native_to_little(num_samples_);
+	memcpy(header, &key, sizeof(key));
+	memcpy(header + sizeof(key), &last_seq, sizeof(last_seq));
+	memcpy(header + 2 * sizeof(uint64_t), &count, sizeof(count));
+	endpoint_.post_send(slot_->size());
+	num_samples_ = 0;
+}
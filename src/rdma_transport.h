@@ -0,0 +1,169 @@
+#ifndef RDMA_TRANSPORT_H
+#define RDMA_TRANSPORT_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <boost/asio/streambuf.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lsl {
+
+/// Whether liblsl was built with RDMA support (the CMake option LSL_RDMA) and the host has an
+/// RDMA device (InfiniBand or RoCE).
+bool rdma_available();
+
+/// The address of a queue pair and its registered memory, exchanged over the data connection.
+struct rdma_address {
+	uint16_t lid{0};
+	/// the port's GID (as 32 hex digits), needed for RoCE and routed InfiniBand
+	std::string gid;
+	uint32_t qpn{0}, psn{0};
+	/// the registered ring an inlet receives the samples in, and the number and size of its slots
+	uint64_t addr{0};
+	uint32_t rkey{0}, slots{0}, slot_bytes{0};
+
+	std::string to_string() const;
+	/// @throws std::invalid_argument if the address is malformed.
+	static rdma_address parse(const std::string &str);
+};
+
+/**
+ * A reliable connected queue pair on the host's first RDMA device with a registered ring of
+ * equally sized slots.
+ *
+ * An outlet serializes the samples right into its slots and RDMA-writes them (with the slot's
+ * size as the write's length and the target slot as its immediate data) into the slots of the
+ * inlet's ring, so the samples bypass the kernel's TCP stack on both hosts. Each write consumes
+ * one of the inlet's posted receives, which the inlet only posts again once it decoded a slot, so
+ * the posted receives are the outlet's credits: once they're used up, the device retries the
+ * writes (receiver not ready) until the inlet catches up.
+ *
+ * A write that's retried may already have placed its first packets in the inlet's slot, so the
+ * inlet only posts receives for half of its ring (see credits()) and the outlet keeps at most as
+ * many writes in flight. A write is then only posted once the slot it overwrites was decoded.
+ *
+ * Without RDMA support, the constructor throws.
+ */
+class rdma_endpoint {
+public:
+	/**
+	 * Open the device, create the queue pair and register the ring.
+	 * @throws std::runtime_error if there's no RDMA device or the resources can't be allocated.
+	 */
+	rdma_endpoint(uint32_t slots, uint32_t slot_bytes);
+	~rdma_endpoint();
+
+	rdma_endpoint(const rdma_endpoint &) = delete;
+	rdma_endpoint &operator=(const rdma_endpoint &) = delete;
+
+	/// The address the other party connects to.
+	const rdma_address &local() const;
+
+	/// Connect the queue pair to the other party's.
+	void connect(const rdma_address &remote);
+
+	/// The number of writes that may be in flight, and of receives an inlet posts (half the ring).
+	uint32_t credits() const;
+
+	/// Post a receive for each credit (for inlets, before connecting).
+	void post_receives();
+
+	/**
+	 * Wait for the next slot the other party wrote and append it to a buffer.
+	 * @return The size of the slot, 0 if there was none within the timeout.
+	 * @throws std::runtime_error if the connection failed.
+	 */
+	std::size_t receive(asio::streambuf &dst, double timeout);
+
+	/**
+	 * The slot the next write is sent from, once it's no longer in flight.
+	 * @return nullptr if it's still in flight after the timeout.
+	 * @throws std::runtime_error if a previous write failed.
+	 */
+	char *send_slot(double timeout);
+
+	/// Write the first bytes of the slot returned by send_slot() to the other party's next slot.
+	void post_send(std::size_t len);
+
+private:
+	struct impl;
+	std::unique_ptr<impl> impl_;
+};
+
+/**
+ * Sends the samples of an outlet to one inlet by RDMA writes (see rdma_endpoint).
+ *
+ * Each slot has the layout of a datagram (see datagram_sender): the stream's key, the last
+ * sequence number sent so far and the number of samples, followed by the samples with their
+ * sequence numbers. While the outlet doesn't push anything, empty slots are sent as heartbeats.
+ */
+class rdma_sender {
+public:
+	/// the number of slots of the inlets' rings, and the size of a slot
+	static const uint32_t ring_slots = 32;
+	static const uint32_t slot_bytes = 64 * 1024;
+	/// the interval of the heartbeats (in seconds)
+	static constexpr double heartbeat_interval = 0.5;
+	/// how long a write may wait for the inlet before the sending fails (in seconds)
+	static constexpr double write_timeout = 5.0;
+
+	/**
+	 * Connect to an inlet's endpoint and start sending the samples pushed from now on.
+	 * @param max_buffered The maximum number of samples that are buffered while the sending is
+	 * behind (0 for the outlet's default).
+	 * @throws std::invalid_argument if the samples can't be sent this way (string samples, or
+	 * samples that don't fit into the inlet's slots).
+	 * @throws std::runtime_error if there's no RDMA device.
+	 */
+	rdma_sender(stream_info_impl_p info, send_buffer_p send_buffer, const rdma_address &remote,
+		int max_buffered = 0);
+
+	/// Destructor. Stops the sending thread.
+	~rdma_sender();
+
+	rdma_sender(const rdma_sender &) = delete;
+	rdma_sender &operator=(const rdma_sender &) = delete;
+
+	/// The address the inlet connects its endpoint to.
+	const rdma_address &local() const { return endpoint_.local(); }
+
+	/// The key that identifies the stream's slots.
+	uint64_t key() const { return key_; }
+
+private:
+	/// The sending thread.
+	void sender_thread();
+
+	/// Send the samples collected so far (or a heartbeat if there are none).
+	void send_slot();
+
+	/// Wait until the next slot can be filled; false if the sender is stopping.
+	bool next_slot();
+
+	stream_info_impl_p info_;
+	send_buffer_p send_buffer_;
+	rdma_endpoint endpoint_;
+	const uint64_t key_;
+	std::size_t samples_per_slot_{1};
+	std::shared_ptr<class consumer_queue> queue_;
+
+	// used by the sending thread
+	/// the slot being filled, the number of samples in it and the last sequence number
+	class slot_buf;
+	std::unique_ptr<slot_buf> slot_;
+	uint16_t num_samples_{0};
+	uint64_t last_seq_{0};
+	/// scratchpad memory for sample::save_streambuf()
+	std::unique_ptr<char[]> scratch_;
+
+	std::mutex mut_;
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
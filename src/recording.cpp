@@ -0,0 +1,283 @@
+#include "recording.h"
+#include "sample.h"
+#include "stream_info_impl.h"
+#include "stream_inlet_impl.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <loguru.hpp>
+#include <sstream>
+#include <stdexcept>
+
+using namespace lsl;
+
+namespace {
+
+/// the chunk tags of the XDF format
+enum xdf_tag : uint16_t {
+	tag_file_header = 1,
+	tag_stream_header = 2,
+	tag_samples = 3,
+	tag_clock_offset = 4,
+	tag_boundary = 5,
+	tag_stream_footer = 6
+};
+
+/// how often the pending samples are written
+const std::chrono::milliseconds flush_interval(500);
+/// the I/O thread is woken up early once this many samples are pending
+const std::size_t wakeup_samples = 65536;
+/// the write buffer is written early once it holds this many bytes
+const std::size_t max_buffered_bytes = 4 << 20;
+/// how often boundary chunks are written, in seconds
+const double boundary_interval = 10.0;
+
+const unsigned char boundary_uuid[] = {0x43, 0xA5, 0x46, 0xDC, 0xCB, 0xF5, 0x41, 0x0F, 0xB3, 0x0E,
+	0xD5, 0x46, 0x73, 0x83, 0xCB, 0xE4};
+
+/// Append a value in little endian byte order (as all values in XDF files).
+template <typename T> void put(std::vector<char> &out, T value) {
+	if (lslboost::endian::order::native == lslboost::endian::order::big)
+		endian_reverse_inplace(value);
+	const char *bytes = reinterpret_cast<const char *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void put_bytes(std::vector<char> &out, const void *data, std::size_t len) {
+	const char *bytes = static_cast<const char *>(data);
+	out.insert(out.end(), bytes, bytes + len);
+}
+
+/// Append a length with as few length bytes as possible ("NumLengthBytes" followed by the length).
+void put_length(std::vector<char> &out, std::size_t len) {
+	if (len <= UINT8_MAX) {
+		put<uint8_t>(out, 1);
+		put(out, static_cast<uint8_t>(len));
+	} else if (len <= UINT32_MAX) {
+		put<uint8_t>(out, 4);
+		put(out, static_cast<uint32_t>(len));
+	} else {
+		put<uint8_t>(out, 8);
+		put(out, static_cast<uint64_t>(len));
+	}
+}
+
+/// Append a sample: its time stamp and channel data.
+void put_sample(std::vector<char> &out, const sample &s) {
+	put<uint8_t>(out, 8);
+	put(out, s.timestamp);
+	if (s.format() == cft_string) {
+		const std::string *str = s.string_data();
+		for (uint32_t k = 0; k < s.num_channels(); ++k) {
+			put_length(out, str[k].size());
+			put_bytes(out, str[k].data(), str[k].size());
+		}
+	} else if (s.format() == cft_int24) {
+		// XDF has no 24 bit integers, so they are widened
+		const auto *values = reinterpret_cast<const detail::int24 *>(s.raw_data());
+		for (uint32_t k = 0; k < s.num_channels(); ++k) put<int32_t>(out, values[k]);
+	} else if (s.format() == cft_float16) {
+		// ...and so are half precision values
+		const auto *values = reinterpret_cast<const detail::float16 *>(s.raw_data());
+		for (uint32_t k = 0; k < s.num_channels(); ++k) put<float>(out, values[k]);
+	} else {
+		const std::size_t start = out.size();
+		put_bytes(out, s.raw_data(), s.datasize());
+		if (lslboost::endian::order::native == lslboost::endian::order::big)
+			s.convert_endian(&out[start]);
+	}
+}
+
+std::string format_double(double value) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.17g", value);
+	return buf;
+}
+
+} // namespace
+
+recording::recording(const std::string &filename) : file_(fopen(filename.c_str(), "wb")) {
+	if (!file_)
+		throw std::runtime_error(
+			"Could not create the recording " + filename + ": " + std::strerror(errno));
+	// the chunks are collected in buffer_, so the file itself needn't be buffered
+	setvbuf(file_, nullptr, _IONBF, 0);
+	buffer_.reserve(max_buffered_bytes + (1 << 20));
+
+	char datetime[32];
+	const std::time_t now = std::time(nullptr);
+	std::strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+	const std::string header = std::string("<?xml version=\"1.0\"?><info><version>1.0</version>") +
+							   "<datetime>" + datetime + "</datetime></info>";
+	put_bytes(buffer_, "XDF:", 4);
+	append_chunk(tag_file_header, std::vector<char>(header.begin(), header.end()));
+	flush_buffer();
+
+	io_thread_ = managed_thread(lsl_thread_data, "X_recording", &recording::io_thread, this);
+}
+
+recording::~recording() {
+	{
+		std::lock_guard<std::mutex> lock(pending_mut_);
+		stop_ = true;
+	}
+	wakeup_.notify_all();
+	io_thread_.join();
+	try {
+		std::lock_guard<std::mutex> io_lock(io_mut_);
+		for (auto *s : streams_) {
+			s->inlet->set_sample_callback(data_receiver::sample_callback());
+			write_pending(*s);
+			write_footer(*s);
+			delete s;
+		}
+		streams_.clear();
+		flush_buffer();
+	} catch (std::exception &e) { LOG_F(ERROR, "Error while closing a recording: %s", e.what()); }
+	fclose(file_);
+}
+
+void recording::add(stream_inlet_impl &inlet, double timeout) {
+	std::string xml = inlet.info(timeout)->to_fullinfo_message();
+	// XDF has no int24 and float16 channels, so their samples are widened (see put_sample())
+	const char *widened[][2] = {{"int24", "int32"}, {"float16", "float32"}};
+	for (const auto &format : widened) {
+		const std::string prefix = "<channel_format>", tag = prefix + format[0] + '<';
+		const auto pos = xml.find(tag);
+		if (pos != std::string::npos)
+			xml.replace(pos + prefix.size(), strlen(format[0]), format[1]);
+	}
+
+	std::lock_guard<std::mutex> io_lock(io_mut_);
+	for (auto *s : streams_)
+		if (s->inlet == &inlet)
+			throw std::invalid_argument("The inlet is already a member of the recording.");
+	auto *s = new stream();
+	s->inlet = &inlet;
+	s->id = ++last_id_;
+	content_.clear();
+	put(content_, s->id);
+	put_bytes(content_, xml.data(), xml.size());
+	append_chunk(tag_stream_header, content_);
+	{
+		std::lock_guard<std::mutex> lock(pending_mut_);
+		streams_.push_back(s);
+	}
+	inlet.set_sample_callback([this, s](const sample_p *samples, std::size_t n) {
+		std::lock_guard<std::mutex> lock(pending_mut_);
+		s->pending.insert(s->pending.end(), samples, samples + n);
+		num_pending_ += n;
+		if (num_pending_ >= wakeup_samples) wakeup_.notify_one();
+	});
+}
+
+void recording::remove(stream_inlet_impl &inlet) {
+	std::lock_guard<std::mutex> io_lock(io_mut_);
+	auto it = std::find_if(
+		streams_.begin(), streams_.end(), [&](stream *s) { return s->inlet == &inlet; });
+	if (it == streams_.end()) return;
+	stream *s = *it;
+	// afterwards, the inlet's data thread won't add any samples
+	inlet.set_sample_callback(data_receiver::sample_callback());
+	write_pending(*s);
+	write_footer(*s);
+	flush_buffer();
+	{
+		std::lock_guard<std::mutex> lock(pending_mut_);
+		streams_.erase(it);
+	}
+	delete s;
+}
+
+void recording::io_thread() {
+	double last_boundary = lsl_clock();
+	std::unique_lock<std::mutex> lock(pending_mut_);
+	while (!stop_) {
+		wakeup_.wait_for(
+			lock, flush_interval, [this]() { return stop_ || num_pending_ >= wakeup_samples; });
+		if (stop_) break;
+		lock.unlock();
+		try {
+			std::lock_guard<std::mutex> io_lock(io_mut_);
+			for (auto *s : streams_) write_pending(*s);
+			if (lsl_clock() - last_boundary >= boundary_interval) {
+				append_chunk(tag_boundary,
+					std::vector<char>(std::begin(boundary_uuid), std::end(boundary_uuid)));
+				last_boundary = lsl_clock();
+			}
+			flush_buffer();
+		} catch (std::exception &e) { LOG_F(ERROR, "Error while recording: %s", e.what()); }
+		lock.lock();
+	}
+}
+
+void recording::write_pending(stream &s) {
+	{
+		std::lock_guard<std::mutex> lock(pending_mut_);
+		// swap the buffers, so both keep their capacity
+		s.pending.swap(batch_);
+		num_pending_ -= batch_.size();
+	}
+	if (!batch_.empty()) {
+		content_.clear();
+		put(content_, s.id);
+		put<uint8_t>(content_, 4);
+		put(content_, static_cast<uint32_t>(batch_.size()));
+		for (const auto &sample : batch_) put_sample(content_, *sample);
+		if (!s.sample_count) s.first_timestamp = batch_.front()->timestamp;
+		s.last_timestamp = batch_.back()->timestamp;
+		s.sample_count += batch_.size();
+		append_chunk(tag_samples, content_);
+		batch_.clear();
+	}
+
+	double offset, remote_time;
+	try {
+		if (s.inlet->latest_time_correction(offset, &remote_time, nullptr) &&
+			(s.offsets.empty() || s.offsets.back().first != remote_time)) {
+			content_.clear();
+			put(content_, s.id);
+			put(content_, remote_time);
+			put(content_, offset);
+			append_chunk(tag_clock_offset, content_);
+			s.offsets.emplace_back(remote_time, offset);
+		}
+	} catch (lost_error &) {
+		// the samples received before are still recorded
+	}
+}
+
+void recording::write_footer(stream &s) {
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\"?><info><first_timestamp>" << format_double(s.first_timestamp)
+		<< "</first_timestamp><last_timestamp>" << format_double(s.last_timestamp)
+		<< "</last_timestamp><sample_count>" << s.sample_count << "</sample_count><clock_offsets>";
+	for (const auto &offset : s.offsets)
+		xml << "<offset><time>" << format_double(offset.first) << "</time><value>"
+			<< format_double(offset.second) << "</value></offset>";
+	xml << "</clock_offsets></info>";
+	const std::string footer = xml.str();
+	content_.clear();
+	put(content_, s.id);
+	put_bytes(content_, footer.data(), footer.size());
+	append_chunk(tag_stream_footer, content_);
+}
+
+void recording::append_chunk(uint16_t tag, const std::vector<char> &content) {
+	put<uint8_t>(buffer_, 8);
+	put(buffer_, static_cast<uint64_t>(sizeof(tag) + content.size()));
+	put(buffer_, tag);
+	put_bytes(buffer_, content.data(), content.size());
+	if (buffer_.size() >= max_buffered_bytes) flush_buffer();
+}
+
+void recording::flush_buffer() {
+	if (buffer_.empty()) return;
+	if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+		LOG_F(ERROR, "Could not write %zu bytes to a recording: %s", buffer_.size(),
+			std::strerror(errno));
+	buffer_.clear();
+}
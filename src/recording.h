@@ -0,0 +1,115 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lsl {
+class stream_inlet_impl;
+
+/**
+ * Records the samples of inlets into an XDF file (https://github.com/sccn/xdf).
+ *
+ * The samples are taken over from the inlets' data threads as they are decoded (so they are
+ * neither queued nor copied into user buffers) and serialized by a dedicated I/O thread, which
+ * writes large blocks every flush interval. The I/O thread also writes the inlets' clock offsets
+ * whenever the time synchronization has a new estimate, and a boundary chunk every few seconds
+ * so readers can recover from a damaged file. The stream footers are written when an inlet is
+ * removed or the recording is destroyed.
+ *
+ * An inlet can only be recorded by one recording at a time, its samples can't be pulled while
+ * it's recorded, and it has to be removed before it's destroyed.
+ */
+class recording {
+public:
+	/**
+	 * Create the file and start the I/O thread.
+	 * @throws std::runtime_error if the file can't be created.
+	 */
+	explicit recording(const std::string &filename);
+
+	/// Destructor. Removes all inlets and closes the file.
+	~recording();
+
+	recording(const recording &) = delete;
+	recording &operator=(const recording &) = delete;
+
+	/**
+	 * Start recording an inlet.
+	 *
+	 * The stream header is written from the inlet's full stream info.
+	 * @param timeout How long to wait for the stream info.
+	 * @throws std::invalid_argument if the inlet is already recorded, timeout_error if the stream
+	 * info wasn't received in time.
+	 */
+	void add(stream_inlet_impl &inlet, double timeout);
+
+	/// Stop recording an inlet and write its stream footer. Does nothing if it isn't recorded.
+	void remove(stream_inlet_impl &inlet);
+
+private:
+	/// A recorded stream.
+	struct stream {
+		stream_inlet_impl *inlet;
+		uint32_t id;
+		/// samples received by the data thread, not written yet (protected by pending_mut_)
+		std::vector<sample_p> pending;
+		/// the following are only accessed by the writing thread
+		uint64_t sample_count{0};
+		double first_timestamp{0.0}, last_timestamp{0.0};
+		/// the clock offsets written so far, as (collection time, offset) pairs
+		std::vector<std::pair<double, double>> offsets;
+	};
+
+	/// The I/O thread: write the pending samples every flush interval.
+	void io_thread();
+
+	/// Write a stream's pending samples and a new clock offset, if any; io_mut_ must be held.
+	void write_pending(stream &s);
+
+	/// Write a stream's footer; io_mut_ must be held.
+	void write_footer(stream &s);
+
+	/// Append a chunk to the write buffer; io_mut_ must be held.
+	void append_chunk(uint16_t tag, const std::vector<char> &content);
+
+	/// Write the write buffer to the file; io_mut_ must be held.
+	void flush_buffer();
+
+	/// the file
+	FILE *file_;
+	/// the data to be written to the file
+	std::vector<char> buffer_;
+	/// reused for the contents of the chunks
+	std::vector<char> content_;
+	/// reused for the samples that are being written
+	std::vector<sample_p> batch_;
+	/// serializes the writing to the file (by the I/O thread, remove() and the destructor)
+	std::mutex io_mut_;
+
+	/// the recorded streams (protected by io_mut_ and pending_mut_, so any of them can be held
+	/// to read the list)
+	std::vector<stream *> streams_;
+	/// the last stream id that was assigned
+	uint32_t last_id_{0};
+	/// protects the pending samples of the streams
+	std::mutex pending_mut_;
+	/// the number of pending samples of all streams
+	std::size_t num_pending_{0};
+
+	/// wakes up the I/O thread early when lots of samples are pending, or to stop it
+	std::condition_variable wakeup_;
+	bool stop_{false};
+	managed_thread io_thread_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,130 @@
+#include "relay.h"
+#include "common.h"
+#include "sample.h"
+#include "stream_info_impl.h"
+#include "stream_inlet_impl.h"
+#include "stream_outlet_impl.h"
+#include <algorithm>
+#include <atomic>
+#include <loguru.hpp>
+#include <numeric>
+#include <stdexcept>
+
+using namespace lsl;
+
+struct relay::stream {
+	std::unique_ptr<stream_inlet_impl> inlet;
+	std::unique_ptr<stream_outlet_impl> outlet;
+	/// the offset of the source's clock to the relay's (used by the inlet's data thread)
+	double clock_offset{0.0};
+	/// reused by the inlet's data thread
+	std::vector<sample_p> batch;
+	std::vector<uint32_t> channels;
+	/// set by the inlet's data thread once the source is gone
+	std::atomic<bool> lost{false};
+};
+
+relay::relay() = default;
+
+relay::~relay() {
+	std::lock_guard<std::mutex> lock(mut_);
+	for (auto &s : streams_) close(*s);
+}
+
+void relay::add(const stream_info_impl &upstream, double timeout) {
+	auto relayed = [this](const std::string &uid) {
+		return std::any_of(streams_.begin(), streams_.end(),
+			[&uid](const std::unique_ptr<stream> &s) { return s->outlet->info().uid() == uid; });
+	};
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		prune();
+		if (relayed(upstream.uid()))
+			throw std::invalid_argument("The stream " + upstream.name() + " is relayed already.");
+	}
+	std::unique_ptr<stream> s(new stream());
+	// the relayed stream ends with its source, so the inlet doesn't recover (possibly onto the
+	// relay's own outlet, which has the same UID)
+	s->inlet.reset(new stream_inlet_impl(upstream, 360, 0, false));
+	const stream_info_impl_p full = s->inlet->info(timeout);
+	s->clock_offset = s->inlet->time_correction(timeout);
+	s->outlet.reset(new stream_outlet_impl(*full, 0, 512000, true));
+	s->channels.resize(full->channel_count());
+	std::iota(s->channels.begin(), s->channels.end(), 0);
+	stream *raw = s.get();
+	s->inlet->set_sample_callback(
+		[raw](const sample_p *samples, std::size_t n) { forward(*raw, samples, n); });
+
+	std::lock_guard<std::mutex> lock(mut_);
+	if (relayed(upstream.uid())) {
+		// added by another thread in the meantime
+		close(*s);
+		throw std::invalid_argument("The stream " + upstream.name() + " is relayed already.");
+	}
+	streams_.push_back(std::move(s));
+}
+
+std::size_t relay::num_streams() {
+	std::lock_guard<std::mutex> lock(mut_);
+	prune();
+	return streams_.size();
+}
+
+std::vector<stream_info_impl> relay::infos() {
+	std::lock_guard<std::mutex> lock(mut_);
+	prune();
+	std::vector<stream_info_impl> result;
+	for (const auto &s : streams_) result.push_back(s->outlet->info());
+	return result;
+}
+
+void relay::forward(stream &s, const sample_p *samples, std::size_t n) {
+	if (!n) {
+		// the source is gone
+		s.lost = true;
+		return;
+	}
+	try {
+		double offset;
+		if (s.inlet->latest_time_correction(offset, nullptr, nullptr)) s.clock_offset = offset;
+	} catch (std::exception &) {
+		// keep the last offset
+	}
+	const factory_p &fac = s.outlet->sample_factory();
+	for (std::size_t k = 0; k < n; ++k) {
+		const sample &src = *samples[k];
+		sample_p copy(fac->new_sample(src.timestamp + s.clock_offset, false));
+		if (src.format() == cft_string)
+			copy->assign_channels(src, s.channels.data());
+		else
+			copy->assign_untyped(src.raw_data());
+		s.batch.push_back(std::move(copy));
+	}
+	// the chunks are passed on as they arrive
+	s.batch.back()->pushthrough = true;
+	s.outlet->push_samples(s.batch.data(), s.batch.size());
+	s.batch.clear();
+}
+
+void relay::close(stream &s) {
+	try {
+		// waits for a running forward()
+		s.inlet->set_sample_callback(data_receiver::sample_callback());
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error while closing a relayed stream: %s", e.what());
+	}
+	s.outlet.reset();
+	s.inlet.reset();
+}
+
+void relay::prune() {
+	for (auto &s : streams_)
+		if (s->lost) {
+			LOG_F(INFO, "The source of the relayed stream %s is gone",
+				s->outlet->info().name().c_str());
+			close(*s);
+		}
+	streams_.erase(std::remove_if(streams_.begin(), streams_.end(),
+					   [](const std::unique_ptr<stream> &s) { return !s->outlet; }),
+		streams_.end());
+}
@@ -0,0 +1,73 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include "forward.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lsl {
+class stream_info_impl;
+class stream_inlet_impl;
+class stream_outlet_impl;
+
+/**
+ * Re-publishes the streams of other outlets, so their subscribers don't load the source machine.
+ *
+ * Each stream is received by a single inlet and re-published by an outlet with the same metadata
+ * and the same UID, session id and creation time (see stream_outlet_impl), so the source serves
+ * one connection per stream no matter how many inlets connect to the relay. The received samples
+ * are handed over from the inlet's data thread (see data_receiver::set_sample_callback()) and
+ * pushed into the outlet's send buffer as they are, without going through user buffers or type
+ * conversions. Their time stamps are converted to the relay's clock, so the relay's time service
+ * corrects them for its subscribers.
+ *
+ * A relayed stream ends with its source: once the source outlet is gone, the relay's outlet is
+ * destroyed as well (so its subscribers recover onto the next instance of the stream) and the
+ * stream can be added again.
+ */
+class relay {
+public:
+	relay();
+
+	/// Destructor. Stops relaying and destroys the outlets.
+	~relay();
+
+	relay(const relay &) = delete;
+	relay &operator=(const relay &) = delete;
+
+	/**
+	 * Start relaying a stream.
+	 * @param upstream The info of the source outlet, e.g. from a resolver.
+	 * @param timeout How long to wait for the source's full stream info and clock offset.
+	 * @throws std::invalid_argument if the stream is relayed already (or is one of the relay's
+	 * outlets), timeout_error if the source didn't answer in time, lost_error if it's gone.
+	 */
+	void add(const stream_info_impl &upstream, double timeout);
+
+	/// The number of relayed streams, not counting those whose source is gone.
+	std::size_t num_streams();
+
+	/// The stream infos of the relay's outlets.
+	std::vector<stream_info_impl> infos();
+
+private:
+	/// A relayed stream: the inlet and the outlet.
+	struct stream;
+
+	/// Forward samples received by the inlet of a stream (called from its data thread).
+	static void forward(stream &s, const sample_p *samples, std::size_t n);
+
+	/// Stop relaying a stream and destroy its outlet.
+	static void close(stream &s);
+
+	/// Remove the streams whose source is gone; mut_ must be held.
+	void prune();
+
+	std::mutex mut_;
+	std::vector<std::unique_ptr<stream>> streams_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,326 @@
+#include "replay.h"
+#include "common.h"
+#include "sample.h"
+#include "stream_info_impl.h"
+#include "stream_outlet_impl.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <loguru.hpp>
+#include <pugixml.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace lsl;
+
+namespace {
+
+/// the chunk tags of the XDF format that are played back
+enum xdf_tag : uint16_t { tag_stream_header = 2, tag_samples = 3, tag_clock_offset = 4 };
+
+/// the maximum number of samples pushed at once
+const std::size_t max_batch = 4096;
+/// the playback thread sleeps at least this long (in seconds) so the samples of all streams that
+/// fall due in the meantime are pushed together
+const double min_sleep = 0.001;
+
+/// Map a file into memory (read-only), return nullptr on errors.
+const char *map_file(const std::string &filename, std::size_t &size) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+	const char *data = nullptr;
+	LARGE_INTEGER len;
+	if (GetFileSizeEx(file, &len) && len.QuadPart > 0) {
+		size = static_cast<std::size_t>(len.QuadPart);
+		// the view keeps the mapping alive after its handle is closed
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) {
+			data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+	return data;
+#else
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+	void *data = MAP_FAILED;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		size = static_cast<std::size_t>(st.st_size);
+		data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) madvise(data, size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+	return data != MAP_FAILED ? static_cast<const char *>(data) : nullptr;
+#endif
+}
+
+void unmap_file(const char *data, std::size_t size) {
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<char *>(data), size);
+#endif
+}
+
+/// Reads little endian values (as all values in XDF files) from a range of the mapped file.
+struct reader {
+	const char *pos, *end;
+
+	uint64_t left() const { return static_cast<uint64_t>(end - pos); }
+
+	/// Skip n bytes, return the position of the first one.
+	const char *skip(uint64_t n) {
+		if (n > left()) throw std::runtime_error("The file is truncated.");
+		const char *p = pos;
+		pos += n;
+		return p;
+	}
+
+	template <typename T> T get() {
+		T value;
+		memcpy(&value, skip(sizeof(T)), sizeof(T));
+		if (lslboost::endian::order::native == lslboost::endian::order::big)
+			endian_reverse_inplace(value);
+		return value;
+	}
+
+	/// Read a length field ("NumLengthBytes" followed by the length).
+	uint64_t length() {
+		switch (get<uint8_t>()) {
+		case 1: return get<uint8_t>();
+		case 4: return get<uint32_t>();
+		case 8: return get<uint64_t>();
+		default: throw std::runtime_error("Invalid length field.");
+		}
+	}
+};
+
+/**
+ * Add the fields that describe the original outlet to a stream header if they're missing (they
+ * are optional in XDF files, and the outlets assign new values anyway).
+ */
+std::string complete_header(const char *begin, const char *end) {
+	pugi::xml_document doc;
+	doc.load_buffer(begin, static_cast<std::size_t>(end - begin));
+	pugi::xml_node info = doc.child("info");
+	const char *defaults[][2] = {{"version", "1.1"}, {"created_at", "0"}, {"uid", "replay"}};
+	for (const auto &field : defaults)
+		if (info && !*info.child_value(field[0])) {
+			info.remove_child(field[0]);
+			info.append_child(field[0]).text().set(field[1]);
+		}
+	std::ostringstream xml;
+	doc.save(xml, "", pugi::format_raw);
+	return xml.str();
+}
+
+} // namespace
+
+replay::replay(const std::string &filename, double speed) : speed_(speed) {
+	if (!(speed > 0.0)) throw std::invalid_argument("The playback speed has to be positive.");
+	data_ = map_file(filename, size_);
+	if (!data_)
+		throw std::runtime_error(
+			"Could not map the file " + filename + ": " + std::strerror(errno));
+	try {
+		reader file{data_, data_ + size_};
+		if (size_ < 4 || memcmp(file.skip(4), "XDF:", 4) != 0)
+			throw std::runtime_error(filename + " is not an XDF file.");
+		while (file.left()) {
+			reader content{nullptr, nullptr};
+			try {
+				const uint64_t len = file.length();
+				if (len < sizeof(uint16_t)) throw std::runtime_error("Invalid chunk length.");
+				content.pos = file.skip(len);
+				content.end = file.pos;
+			} catch (std::runtime_error &) {
+				// e.g. the recording process crashed
+				LOG_F(WARNING, "%s is truncated, only the complete chunks are played back",
+					filename.c_str());
+				break;
+			}
+			const uint16_t tag = content.get<uint16_t>();
+			if (tag == tag_stream_header) {
+				std::unique_ptr<stream> s(new stream());
+				s->id = content.get<uint32_t>();
+				stream_info_impl info;
+				info.from_fullinfo_message(complete_header(content.pos, content.end));
+				if (!info.channel_count())
+					throw std::runtime_error(
+						filename + " has an invalid stream header: " + info.name());
+				if (info.nominal_srate() != IRREGULAR_RATE)
+					s->sample_interval = 1.0 / info.nominal_srate();
+				s->outlet.reset(new stream_outlet_impl(info));
+				streams_.push_back(std::move(s));
+			} else if (tag == tag_samples || tag == tag_clock_offset) {
+				const uint32_t id = content.get<uint32_t>();
+				auto it = std::find_if(streams_.begin(), streams_.end(),
+					[id](const std::unique_ptr<stream> &s) { return s->id == id; });
+				if (it == streams_.end()) continue;
+				if (tag == tag_samples) {
+					const uint64_t count = content.length();
+					(*it)->chunks.push_back(chunk{content.pos, content.end, count});
+				} else {
+					const double time = content.get<double>();
+					(*it)->offsets.emplace_back(time, content.get<double>());
+				}
+			}
+		}
+	} catch (...) {
+		streams_.clear();
+		unmap_file(data_, size_);
+		throw;
+	}
+
+	bool any = false;
+	for (auto &s : streams_) {
+		advance(*s);
+		if (!s->has_next) continue;
+		first_time_ = any ? std::min(first_time_, s->next_time) : s->next_time;
+		any = true;
+	}
+}
+
+replay::~replay() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+	}
+	wakeup_.notify_all();
+	if (player_.joinable()) player_.join();
+	streams_.clear();
+	unmap_file(data_, size_);
+}
+
+const stream_info_impl &replay::info(std::size_t index) const {
+	return streams_.at(index)->outlet->info();
+}
+
+void replay::start() {
+	std::lock_guard<std::mutex> lock(mut_);
+	if (player_.joinable() || stop_) return;
+	start_time_ = lsl_clock();
+	player_ = managed_thread(lsl_thread_transfer, "R_replay", &replay::player, this);
+}
+
+bool replay::wait(double timeout) {
+	std::unique_lock<std::mutex> lock(mut_);
+	const auto done = [this]() { return done_; };
+	if (timeout < FOREVER)
+		return done_cv_.wait_for(lock, std::chrono::duration<double>(timeout), done);
+	done_cv_.wait(lock, done);
+	return true;
+}
+
+void replay::advance(stream &s) {
+	while (!s.left) {
+		if (s.next_chunk == s.chunks.size()) {
+			s.has_next = false;
+			return;
+		}
+		const chunk &c = s.chunks[s.next_chunk++];
+		s.pos = c.begin;
+		s.end = c.end;
+		s.left = c.count;
+	}
+	reader r{s.pos, s.end};
+	if (r.get<uint8_t>() == sizeof(double))
+		s.next_timestamp = r.get<double>();
+	else
+		s.next_timestamp += s.sample_interval;
+	s.pos = r.pos;
+	while (s.offset_index + 1 < s.offsets.size() &&
+		   s.offsets[s.offset_index + 1].first <= s.next_timestamp)
+		++s.offset_index;
+	s.next_time =
+		s.next_timestamp + (s.offsets.empty() ? 0.0 : s.offsets[s.offset_index].second);
+	s.has_next = true;
+}
+
+sample_p replay::decode(stream &s, double timestamp) {
+	sample_p smp(s.outlet->sample_factory()->new_sample(timestamp, false));
+	reader r{s.pos, s.end};
+	if (smp->format() == cft_string) {
+		strings_.resize(smp->num_channels());
+		for (auto &str : strings_) {
+			const uint64_t len = r.length();
+			str.assign(r.skip(len), static_cast<std::size_t>(len));
+		}
+		smp->assign_moved(strings_.data());
+	} else {
+		const char *values = r.skip(smp->datasize());
+		if (lslboost::endian::order::native == lslboost::endian::order::big) {
+			payload_.assign(values, values + smp->datasize());
+			smp->convert_endian(payload_.data());
+			values = payload_.data();
+		}
+		// copy the values straight from the mapped file
+		smp->assign_untyped(values);
+	}
+	s.pos = r.pos;
+	--s.left;
+	advance(s);
+	return smp;
+}
+
+void replay::player() {
+	std::unique_lock<std::mutex> lock(mut_);
+	while (!stop_) {
+		lock.unlock();
+		// the (recorded) time up to which the samples are due
+		const double due = first_time_ + (lsl_clock() - start_time_) * speed_;
+		bool remaining = false;
+		double next = 0.0;
+		for (auto &s : streams_) {
+			try {
+				while (s->has_next && s->next_time <= due) {
+					const double timestamp = start_time_ + (s->next_time - first_time_) / speed_;
+					batch_.push_back(decode(*s, timestamp));
+					if (batch_.size() == max_batch || !s->has_next || s->next_time > due) {
+						batch_.back()->pushthrough = true;
+						s->outlet->push_samples(batch_.data(), batch_.size());
+						batch_.clear();
+					}
+				}
+			} catch (std::exception &e) {
+				LOG_F(ERROR, "Stopping the playback of stream %u: %s", s->id, e.what());
+				s->has_next = false;
+				if (!batch_.empty()) {
+					batch_.back()->pushthrough = true;
+					s->outlet->push_samples(batch_.data(), batch_.size());
+					batch_.clear();
+				}
+			}
+			if (!s->has_next) continue;
+			next = remaining ? std::min(next, s->next_time) : s->next_time;
+			remaining = true;
+		}
+		lock.lock();
+		if (!remaining) {
+			done_ = true;
+			done_cv_.notify_all();
+			return;
+		}
+		if (next > due)
+			wakeup_.wait_for(lock,
+				std::chrono::duration<double>(std::max(
+					start_time_ + (next - first_time_) / speed_ - lsl_clock(), min_sleep)));
+	}
+}
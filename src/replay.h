@@ -0,0 +1,124 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lsl {
+class stream_info_impl;
+class stream_outlet_impl;
+
+/**
+ * Plays back the streams of an XDF file (e.g. one written by a recording) through outlets.
+ *
+ * The file is memory-mapped and the samples are decoded from the mapping straight into samples
+ * of the outlets' factories, which are pushed into their send buffers in chunks once they're due,
+ * so no push calls or intermediate buffers are involved.
+ *
+ * The original timing (after applying the recorded clock offsets) is kept, optionally sped up.
+ * The samples get new time stamps on the local clock, so the playback looks like live streams.
+ */
+class replay {
+public:
+	/**
+	 * Map the file and create an outlet for each of its streams.
+	 * @param speed The playback speed relative to the original timing, e.g. 10 to play it back
+	 * ten times faster.
+	 * @throws std::runtime_error if the file can't be mapped or isn't an XDF file,
+	 * std::invalid_argument if the speed isn't positive.
+	 */
+	replay(const std::string &filename, double speed);
+
+	/// Destructor. Stops the playback and destroys the outlets.
+	~replay();
+
+	replay(const replay &) = delete;
+	replay &operator=(const replay &) = delete;
+
+	/// The number of streams (and outlets).
+	std::size_t num_streams() const { return streams_.size(); }
+
+	/// The stream info of an outlet.
+	const stream_info_impl &info(std::size_t index) const;
+
+	/// Start the playback, does nothing if it was started already.
+	void start();
+
+	/**
+	 * Wait until all samples were pushed.
+	 * @return false if the timeout expired before.
+	 */
+	bool wait(double timeout);
+
+private:
+	/// A Samples chunk: the data after the sample count, and the sample count.
+	struct chunk {
+		const char *begin, *end;
+		uint64_t count;
+	};
+
+	/// A stream of the file and its playback position.
+	struct stream {
+		uint32_t id;
+		std::unique_ptr<stream_outlet_impl> outlet;
+		/// the interval of the deduced time stamps (0 for irregular streams)
+		double sample_interval{0.0};
+		std::vector<chunk> chunks;
+		/// the recorded clock offsets, as (collection time, offset) pairs
+		std::vector<std::pair<double, double>> offsets;
+
+		/// the next chunk to be played back
+		std::size_t next_chunk{0};
+		/// the position of the next sample's data, the end of its chunk and the samples left in it
+		const char *pos{nullptr}, *end{nullptr};
+		uint64_t left{0};
+		/// whether there's another sample, its recorded time stamp and its time stamp with the
+		/// clock offset applied
+		bool has_next{false};
+		double next_timestamp{0.0}, next_time{0.0};
+		/// the index of the clock offset in effect
+		std::size_t offset_index{0};
+	};
+
+	/// Read the time stamp of the stream's next sample.
+	static void advance(stream &s);
+
+	/// Decode the stream's next sample into a new sample with the given time stamp.
+	sample_p decode(stream &s, double timestamp);
+
+	/// The playback thread.
+	void player();
+
+	/// the mapped file
+	const char *data_{nullptr};
+	std::size_t size_{0};
+	const double speed_;
+	std::vector<std::unique_ptr<stream>> streams_;
+	/// the earliest (offset-corrected) time stamp in the file
+	double first_time_{0.0};
+	/// the local time the playback started at
+	double start_time_{0.0};
+	/// reused by the playback thread
+	std::vector<sample_p> batch_;
+	std::vector<std::string> strings_;
+	std::vector<char> payload_;
+
+	/// protects the following fields
+	std::mutex mut_;
+	/// wakes up the playback thread to stop it, and waiting threads once it's done
+	std::condition_variable wakeup_, done_cv_;
+	bool stop_{false}, done_{false};
+	managed_thread player_;
+};
+
+} // namespace lsl
+
+#endif
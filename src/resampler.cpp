@@ -0,0 +1,155 @@
+#include "resampler.h"
+#include "sample.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LSL_RESAMPLER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LSL_RESAMPLER_NEON
+#endif
+
+using namespace lsl;
+
+namespace {
+/// The zero crossings of the sinc on each side of the filter's center.
+const uint32_t zero_crossings = 8;
+
+uint32_t common_divisor(uint32_t a, uint32_t b) {
+	while (b) {
+		const uint32_t r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/// The dot product of n floats
+inline float dot(const float *a, const float *b, uint32_t n) {
+	uint32_t k = 0;
+	float sum = 0.0f;
+#if defined(LSL_RESAMPLER_SSE2)
+	__m128 acc = _mm_setzero_ps();
+	for (; k + 4 <= n; k += 4)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LSL_RESAMPLER_NEON)
+	float32x4_t acc = vdupq_n_f32(0.0f);
+	for (; k + 4 <= n; k += 4) acc = vmlaq_f32(acc, vld1q_f32(a + k), vld1q_f32(b + k));
+	float lanes[4];
+	vst1q_f32(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+	for (; k < n; ++k) sum += a[k] * b[k];
+	return sum;
+}
+
+/// Round a filtered value and clamp it to the range of an integer format.
+double saturate(lsl_channel_format_t format, double value) {
+	double lo, hi;
+	switch (format) {
+	case cft_int8: lo = -128.0, hi = 127.0; break;
+	case cft_int16: lo = -32768.0, hi = 32767.0; break;
+	case cft_int24: lo = -8388608.0, hi = 8388607.0; break;
+	case cft_int32: lo = -2147483648.0, hi = 2147483647.0; break;
+	// the largest doubles that still fit
+	case cft_int64: lo = -9223372036854775808.0, hi = 9223372036854774784.0; break;
+	default: return value;
+	}
+	return std::min(std::max(std::round(value), lo), hi);
+}
+} // namespace
+
+void resampler::validate(lsl_channel_format_t format, double srate, uint32_t up, uint32_t down) {
+	if (format == cft_string) throw std::invalid_argument("String streams can't be resampled.");
+	if (srate == IRREGULAR_RATE)
+		throw std::invalid_argument("Streams with an irregular rate can't be resampled.");
+	if (!up || !down) throw std::invalid_argument("The resampling factors must be at least 1.");
+	const uint32_t divisor = common_divisor(up, down);
+	if (up / divisor > max_factor || down / divisor > max_factor)
+		throw std::invalid_argument("The resampling factors may be at most " +
+									std::to_string(max_factor) + " (after reducing them).");
+}
+
+resampler::resampler(factory_p factory, double srate, uint32_t up, uint32_t down)
+	: factory_(std::move(factory)), srate_(srate), up_(up), down_(down),
+	  channels_(factory_->num_channels()), values_(channels_) {
+	validate(factory_->format(), srate, up, down);
+	const uint32_t divisor = common_divisor(up_, down_);
+	up_ /= divisor;
+	down_ /= divisor;
+
+	// the prototype filter at the upsampled rate, cut off at the lower Nyquist frequency
+	const uint32_t factor = std::max(up_, down_);
+	const uint32_t length = 2 * zero_crossings * factor + 1;
+	const double center = (length - 1) / 2.0, cutoff = 0.5 / factor, pi = 3.14159265358979323846;
+	taps_ = (length + up_ - 1) / up_;
+	std::vector<double> prototype(static_cast<std::size_t>(taps_) * up_, 0.0);
+	for (uint32_t i = 0; i < length; ++i) {
+		const double x = 2.0 * cutoff * (i - center),
+					 sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x),
+					 window = 0.42 - 0.5 * std::cos(2.0 * pi * i / (length - 1)) +
+							  0.08 * std::cos(4.0 * pi * i / (length - 1));
+		prototype[i] = sinc * window;
+	}
+	delay_ = center / up_;
+
+	// split it into the phases, each normalized to a unity gain at DC
+	coeffs_.resize(static_cast<std::size_t>(taps_) * up_);
+	for (uint32_t phase = 0; phase < up_; ++phase) {
+		double gain = 0.0;
+		for (uint32_t j = 0; j < taps_; ++j) gain += prototype[phase + j * up_];
+		for (uint32_t j = 0; j < taps_; ++j)
+			coeffs_[phase * taps_ + (taps_ - 1 - j)] =
+				static_cast<float>(prototype[phase + j * up_] / gain);
+	}
+	history_.resize(static_cast<std::size_t>(channels_) * 2 * taps_);
+	offsets_.resize(channels_);
+}
+
+void resampler::process(const sample_p *in, std::size_t n, std::vector<sample_p> &out) {
+	for (std::size_t k = 0; k < n; ++k) {
+		sample &s = *in[k];
+		s.retrieve_typed(values_.data());
+		if (!primed_) {
+			// start from the first sample's values instead of a step from zero; the histories
+			// hold the differences to them, so large offsets don't cost single-precision digits
+			std::copy(values_.begin(), values_.end(), offsets_.begin());
+			primed_ = true;
+		}
+		for (uint32_t c = 0; c < channels_; ++c) {
+			float *h = &history_[static_cast<std::size_t>(c) * 2 * taps_];
+			h[pos_] = h[pos_ + taps_] = static_cast<float>(values_[c] - offsets_[c]);
+		}
+		pos_ = (pos_ + 1) % taps_;
+		const std::size_t produced = out.size();
+		for (; phase_ < up_; phase_ += down_) produce(phase_, s, out);
+		phase_ -= up_;
+		// a chunk boundary moves on to the next produced sample
+		pushthrough_ = pushthrough_ || s.pushthrough;
+		if (out.size() > produced && pushthrough_) {
+			out.back()->pushthrough = true;
+			pushthrough_ = false;
+		}
+	}
+}
+
+void resampler::produce(uint32_t phase, const sample &last, std::vector<sample_p> &out) {
+	const double timestamp =
+		last.timestamp + (static_cast<double>(phase) / up_ - delay_) / srate_;
+	const float *coeffs = &coeffs_[static_cast<std::size_t>(phase) * taps_];
+	for (uint32_t c = 0; c < channels_; ++c)
+		values_[c] = saturate(factory_->format(),
+			offsets_[c] +
+				dot(&history_[static_cast<std::size_t>(c) * 2 * taps_ + pos_], coeffs, taps_));
+	sample_p result(factory_->new_sample(timestamp, false));
+	result->assign_typed(values_.data());
+	result->received = last.received;
+	out.push_back(std::move(result));
+}
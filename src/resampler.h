@@ -0,0 +1,78 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "common.h"
+#include "forward.h"
+#include <cstdint>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A polyphase FIR resampler that converts a regular-rate numeric stream to up/down times its rate.
+ *
+ * The samples are low-pass filtered (a Blackman-windowed sinc with 8 zero crossings per side, cut
+ * off at the lower of the two Nyquist frequencies) so that decimated streams don't alias. Only the
+ * filter phases that produce an output sample are evaluated, with the per-channel histories kept
+ * in planar layout so the dot products run over contiguous values (vectorized with SSE2 / NEON).
+ * The filter runs in single precision, on the differences to the first sample's values.
+ *
+ * The produced samples are time-stamped at their place in the input's time line, corrected for
+ * the filter's delay, and carry the pushthrough flag of the sample that completed them. Integer
+ * formats are rounded and saturated.
+ */
+class resampler {
+public:
+	/**
+	 * @param factory Allocates the produced samples (the format and channels of the input).
+	 * @param srate The nominal rate of the input.
+	 * @param up, down The rate conversion factors (reduced by their common divisor).
+	 * @throws std::invalid_argument for string or irregular-rate streams, or if a factor is 0 or
+	 * more than max_factor (after the reduction).
+	 */
+	resampler(factory_p factory, double srate, uint32_t up, uint32_t down);
+
+	/// The largest factor (after the reduction), which limits the size of the filter.
+	static const uint32_t max_factor = 1024;
+
+	/// Check the parameters without creating a resampler, see resampler().
+	static void validate(lsl_channel_format_t format, double srate, uint32_t up, uint32_t down);
+
+	/// Filter a number of (time-stamped) input samples and append the produced samples to out.
+	void process(const sample_p *in, std::size_t n, std::vector<sample_p> &out);
+
+	/// The rate of the produced samples.
+	double output_srate() const { return srate_ * up_ / down_; }
+
+private:
+	/// Compute one output sample of the given filter phase from the history.
+	void produce(uint32_t phase, const sample &last, std::vector<sample_p> &out);
+
+	factory_p factory_;
+	const double srate_;
+	uint32_t up_, down_;
+	const uint32_t channels_;
+	/// the taps per phase (the length of the histories)
+	uint32_t taps_{0};
+	/// the filter's delay, in input samples
+	double delay_{0.0};
+	/// the coefficients of each phase, in the order of the history (oldest first)
+	std::vector<float> coeffs_;
+	/// per channel, the last taps_ inputs twice in a row, so the newest taps_ are contiguous
+	std::vector<float> history_;
+	/// per channel, the value of the first input, which the histories are relative to
+	std::vector<double> offsets_;
+	/// the position of the oldest value in each history
+	uint32_t pos_{0};
+	/// the phase of the next output sample relative to the next input sample
+	uint32_t phase_{0};
+	bool primed_{false};
+	/// whether an input that completed a chunk didn't produce a sample yet
+	bool pushthrough_{false};
+	/// the values of an input / produced sample
+	std::vector<double> values_;
+};
+
+} // namespace lsl
+
+#endif
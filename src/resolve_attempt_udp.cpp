@@ -1,19 +1,56 @@
 #include "resolve_attempt_udp.h"
 #include "api_config.h"
+#include "discovery_stats.h"
 #include "resolver_impl.h"
 #include "socket_utils.h"
 #include <boost/asio/ip/multicast.hpp>
+#include <algorithm>
+#include <chrono>
 #include <loguru.hpp>
+#include <mutex>
 #include <sstream>
 
 using namespace lsl;
 
+/// the number of queries that are sent back-to-back before pausing for query_batch_pause
+const std::size_t query_batch_size = 32;
+const auto query_batch_pause = std::chrono::milliseconds(1);
+
+/// the endpoints streams responded from, with the number of the last response
+static std::map<udp::endpoint, uint64_t> responded_endpoints;
+/// the number of responses so far
+static uint64_t responses_seen = 0;
+static std::mutex responded_mut;
+
+bool lsl::ever_responded(const udp::endpoint &endpoint) {
+	std::lock_guard<std::mutex> lock(responded_mut);
+	return responded_endpoints.count(endpoint) != 0;
+}
+
+void lsl::remember_responder(const udp::endpoint &endpoint) {
+	std::lock_guard<std::mutex> lock(responded_mut);
+	responded_endpoints[endpoint] = ++responses_seen;
+	if (responded_endpoints.size() <= max_remembered_responders) return;
+	// the endpoint that stayed silent the longest is most likely gone
+	responded_endpoints.erase(std::min_element(responded_endpoints.begin(),
+		responded_endpoints.end(),
+		[](const std::pair<const udp::endpoint, uint64_t> &a,
+			const std::pair<const udp::endpoint, uint64_t> &b) { return a.second < b.second; }));
+}
+
 resolve_attempt_udp::resolve_attempt_udp(asio::io_context &io, const udp &protocol,
 	const std::vector<udp::endpoint> &targets, const std::string &query, result_container &results,
-	std::mutex &results_mut, double cancel_after, cancellable_registry *registry)
-	: io_(io), results_(results), results_mut_(results_mut), cancel_after_(cancel_after),
+	std::mutex &results_mut, double cancel_after, cancellable_registry *registry,
+	result_hook on_added)
+	: io_(io), results_(results), results_mut_(results_mut), on_added_(std::move(on_added)),
+	  cancel_after_(cancel_after),
 	  cancelled_(false), targets_(targets), query_(query), unicast_socket_(io),
-	  broadcast_socket_(io), multicast_socket_(io), recv_socket_(io), cancel_timer_(io) {
+	  broadcast_socket_(io), multicast_socket_(io), pace_timer_(io), recv_socket_(io),
+	  cancel_timer_(io) {
+	// the queries to the other protocol's endpoints are sent by that protocol's attempt
+	targets_.erase(std::remove_if(targets_.begin(), targets_.end(),
+					   [&protocol](const udp::endpoint &ep) { return ep.protocol() != protocol; }),
+		targets_.end());
 	// open the sockets that we might need
 	recv_socket_.open(protocol);
 	try {
@@ -46,7 +83,8 @@ resolve_attempt_udp::resolve_attempt_udp(asio::io_context &io, const udp &protoc
 	os.precision(16);
 	os << "LSL:shortinfo\r\n";
 	os << query_ << "\r\n";
-	os << recv_socket_.local_endpoint().port() << " " << query_id_ << "\r\n";
+	// ask for the binary short-info; older servers ignore this and reply with xml
+	os << recv_socket_.local_endpoint().port() << " " << query_id_ << " binary\r\n";
 	query_msg_ = os.str();
 
 	DLOG_F(2, "Waiting for query results (port %d) for %s", recv_socket_.local_endpoint().port(),
@@ -61,13 +99,49 @@ resolve_attempt_udp::~resolve_attempt_udp() {
 	unregister_from_all();
 }
 
+bool lsl::store_result(
+	result_container &results, const stream_info_impl &info, const asio::ip::address &sender) {
+	const std::string &uid = info.uid();
+	const bool added = results.find(uid) == results.end();
+	if (added)
+		results[uid] = std::make_pair(info, lsl_clock()); // insert new result
+	else
+		results[uid].second = lsl_clock(); // update only the receive time
+	// ... also update the address associated with the result (but don't override the address of
+	// an earlier record for this stream since this would be the faster route)
+	if (sender.is_v4()) {
+		if (results[uid].first.v4address().empty())
+			results[uid].first.v4address(sender.to_string());
+	} else {
+		if (results[uid].first.v6address().empty())
+			results[uid].first.v6address(sender.to_string());
+	}
+	return added;
+}
+
+bool lsl::refresh_result(
+	result_container &results, const std::string &shortinfo, const asio::ip::address &sender) {
+	const auto begin = shortinfo.find("<uid>");
+	if (begin == std::string::npos) return false;
+	const auto end = shortinfo.find("</uid>", begin);
+	if (end == std::string::npos) return false;
+	auto result = results.find(trim(shortinfo.substr(begin + 5, end - begin - 5)));
+	if (result == results.end()) return false;
+	const stream_info_impl &info = result->second.first;
+	if ((sender.is_v4() ? info.v4address() : info.v6address()).empty()) return false;
+	result->second.second = lsl_clock();
+	return true;
+}
+
 // === externally-triggered asynchronous commands ===
 
 void resolve_attempt_udp::begin() {
 	// initiate the result gathering chain
 	receive_next_result();
-	// initiate the send chain
-	send_next_query(targets_.begin());
+	// initiate the send chain (on the IO thread, which also closes the sockets on a cancel)
+	post(io_, [shared_this = shared_from_this()]() {
+		shared_this->send_next_query(shared_this->targets_.begin());
+	});
 
 	// also initiate the cancel event, if desired
 	if (cancel_after_ != FOREVER) {
@@ -86,82 +160,130 @@ void resolve_attempt_udp::cancel() {
 // === receive loop ===
 
 void resolve_attempt_udp::receive_next_result() {
-	recv_socket_.async_receive_from(asio::buffer(resultbuf_), remote_endpoint_,
-		[shared_this = shared_from_this()](
-			err_t err, size_t len) { shared_this->handle_receive_outcome(err, len); });
+	if (datagram_batches_supported()) {
+		recv_socket_.async_wait(
+			udp::socket::wait_read, [shared_this = shared_from_this()](err_t err) {
+				if (err) return shared_this->handle_receive_outcome(err, 0);
+				lslboost::system::error_code ec;
+				const std::size_t count =
+					receive_batch(shared_this->recv_socket_, shared_this->batch_, false, ec);
+				if (ec == asio::error::would_block) return shared_this->receive_next_result();
+				shared_this->handle_receive_outcome(ec, count);
+			});
+		return;
+	}
+	received_datagram &result = batch_.front();
+	recv_socket_.async_receive_from(asio::buffer(result.buffer), result.sender,
+		[shared_this = shared_from_this()](err_t err, size_t len) {
+			shared_this->batch_.front().size = len;
+			shared_this->handle_receive_outcome(err, 1);
+		});
 }
 
-void resolve_attempt_udp::handle_receive_outcome(err_t err, std::size_t len) {
+void resolve_attempt_udp::handle_receive_outcome(err_t err, std::size_t count) {
 	if (cancelled_ || err == asio::error::operation_aborted || err == asio::error::not_connected ||
-		err == asio::error::not_socket)
+		err == asio::error::not_socket || err == asio::error::bad_descriptor)
 		return;
 
-	if (!err) {
-		try {
-			// first parse & check the query id
-			std::istringstream is(std::string(resultbuf_, len));
-			std::string returned_id;
-			getline(is, returned_id);
-			returned_id = trim(returned_id);
-			if (returned_id == query_id_) {
-				// parse the rest of the query into a stream_info
-				stream_info_impl info;
-				std::ostringstream os;
-				os << is.rdbuf();
-				info.from_shortinfo_message(os.str());
-				std::string uid = info.uid();
-				{
-					// update the results
-					std::lock_guard<std::mutex> lock(results_mut_);
-					if (results_.find(uid) == results_.end())
-						results_[uid] = std::make_pair(info, lsl_clock()); // insert new result
-					else
-						results_[uid].second = lsl_clock(); // update only the receive time
-					// ... also update the address associated with the result (but don't
-					// override the address of an earlier record for this stream since this
-					// would be the faster route)
-					if (remote_endpoint_.address().is_v4()) {
-						if (results_[uid].first.v4address().empty())
-							results_[uid].first.v4address(remote_endpoint_.address().to_string());
-					} else {
-						if (results_[uid].first.v6address().empty())
-							results_[uid].first.v6address(remote_endpoint_.address().to_string());
-					}
-				}
-			}
-		} catch (std::exception &e) {
-			LOG_F(WARNING, "resolve_attempt_udp: hiccup while processing the received data: %s",
-				e.what());
-		}
-	}
+	if (!err)
+		for (std::size_t k = 0; k < count; ++k) handle_result(batch_[k]);
 	// ask for the next result
 	receive_next_result();
 }
 
+void resolve_attempt_udp::handle_result(const received_datagram &result) {
+	if (result.truncated) {
+		LOG_F(WARNING, "resolve_attempt_udp: dropped an oversized result from %s",
+			result.sender.address().to_string().c_str());
+		return;
+	}
+	try {
+		// first parse & check the query id
+		std::istringstream is(std::string(result.buffer.data(), result.size));
+		std::string returned_id;
+		getline(is, returned_id);
+		returned_id = trim(returned_id);
+		if (returned_id != query_id_) return;
+		discovery_stats::add(discovery_stats::get().replies_received);
+		remember_responder(result.sender);
+		std::ostringstream os;
+		os << is.rdbuf();
+		const std::string shortinfo = os.str();
+		const asio::ip::address sender = result.sender.address();
+		{
+			// e.g. the same stream's reply to the query on the other IP stack
+			std::lock_guard<std::mutex> lock(results_mut_);
+			if (refresh_result(results_, shortinfo, sender)) return;
+		}
+		// parse the rest of the query into a stream_info
+		stream_info_impl info;
+		info.from_shortinfo_message(shortinfo);
+		// update the results
+		bool added;
+		{
+			std::lock_guard<std::mutex> lock(results_mut_);
+			added = store_result(results_, info, sender);
+		}
+		if (added && on_added_) on_added_(info.uid());
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "resolve_attempt_udp: hiccup while processing the received data: %s",
+			e.what());
+	}
+}
+
 
 // === send loop ===
 
+udp::socket &resolve_attempt_udp::socket_for(const udp::endpoint &target) {
+	if (target.address() == asio::ip::address_v4::broadcast()) return broadcast_socket_;
+	return target.address().is_multicast() ? multicast_socket_ : unicast_socket_;
+}
+
 void resolve_attempt_udp::send_next_query(endpoint_list::const_iterator next) {
 	if (next == targets_.end() || cancelled_) return;
 
-	udp::endpoint ep(*next++);
-	// endpoint matches our active protocol?
-	if (ep.protocol() == recv_socket_.local_endpoint().protocol()) {
-		// select socket to use
-		udp::socket &sock =
-			(ep.address() == asio::ip::address_v4::broadcast())
-				? broadcast_socket_
-				: (ep.address().is_multicast() ? multicast_socket_ : unicast_socket_);
-		// and send the query over it
-		sock.async_send_to(asio::buffer(query_msg_), ep,
-			[shared_this = shared_from_this(), next](err_t err, size_t /*unused*/) {
-				if (!shared_this->cancelled_ && err != asio::error::operation_aborted &&
-					err != asio::error::not_connected && err != asio::error::not_socket)
-					shared_this->send_next_query(next);
+	// pause between batches, so e.g. a sweep over many known peers' ports doesn't flood the
+	// network (and the peers' receive buffers) all at once
+	if (batch_sent_ == query_batch_size) {
+		batch_sent_ = 0;
+		pace_timer_.expires_after(query_batch_pause);
+		pace_timer_.async_wait([shared_this = shared_from_this(), next](err_t err) {
+			if (!err) shared_this->send_next_query(next);
+		});
+		return;
+	}
+
+	// the queries to the following endpoints that go over the same socket are sent at once
+	udp::socket &sock = socket_for(*next);
+	outgoing_.clear();
+	for (auto ep = next; ep != targets_.end() &&
+						 batch_sent_ + outgoing_.size() < query_batch_size &&
+						 &socket_for(*ep) == &sock;
+		 ++ep)
+		outgoing_.push_back(outgoing_datagram{*ep, asio::buffer(query_msg_)});
+	lslboost::system::error_code ec;
+	const std::size_t sent = send_batch(sock, outgoing_.data(), outgoing_.size(), ec);
+	discovery_stats::add(discovery_stats::get().queries_sent, sent);
+	batch_sent_ += sent;
+	next += sent;
+	if (ec == asio::error::would_block) {
+		// the send buffer is full, so continue once there's room again
+		sock.async_wait(
+			udp::socket::wait_write, [shared_this = shared_from_this(), next](err_t err) {
+				if (!err) shared_this->send_next_query(next);
 			});
-	} else
-		// otherwise just go directly to the next query
-		send_next_query(next);
+		return;
+	}
+	if (ec == asio::error::operation_aborted || ec == asio::error::not_connected ||
+		ec == asio::error::not_socket || ec == asio::error::bad_descriptor)
+		return;
+	// e.g. an unreachable network: skip that endpoint
+	if (ec) {
+		++next;
+		++batch_sent_;
+	}
+	// let the receive handlers run between the batches
+	post(io_, [shared_this = shared_from_this(), next]() { shared_this->send_next_query(next); });
 }
 
 void resolve_attempt_udp::do_cancel() {
@@ -172,6 +294,7 @@ void resolve_attempt_udp::do_cancel() {
 		if (broadcast_socket_.is_open()) broadcast_socket_.close();
 		if (recv_socket_.is_open()) recv_socket_.close();
 		cancel_timer_.cancel();
+		pace_timer_.cancel();
 	} catch (std::exception &e) {
 		LOG_F(WARNING,
 			"Unexpected error while trying to cancel operations of resolve_attempt_udp: %s",
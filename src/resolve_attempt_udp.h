@@ -3,9 +3,11 @@
 
 #include "cancellation.h"
 #include "forward.h"
+#include "socket_utils.h"
 #include "stream_info_impl.h"
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <functional>
 #include <map>
 
 using asio::ip::udp;
@@ -16,6 +18,43 @@ namespace lsl {
 /// A container for resolve results (map from stream instance UID onto (stream_info,receive-time)).
 typedef std::map<std::string, std::pair<stream_info_impl, double>> result_container;
 
+/// Called with the UID of a stream that was added to or removed from the results (after the mutex
+/// protecting them was released).
+using result_hook = std::function<void(const std::string &uid)>;
+
+/**
+ * Add a stream that responded to a query (or announced itself) to the results, or update the time
+ * it was last seen. The mutex protecting the results has to be held.
+ * @param sender The address the stream's response was sent from.
+ * @return Whether the stream is new to the results.
+ */
+bool store_result(
+	result_container &results, const stream_info_impl &info, const asio::ip::address &sender);
+
+/**
+ * Update the time a stream was last seen if it's in the results already and its address for the
+ * sender's protocol is known, without parsing the whole shortinfo message, so the duplicate
+ * replies of a stream (e.g. to the IPv4 and IPv6 queries, or to several query waves) are cheap.
+ * The mutex protecting the results has to be held.
+ * @return Whether the stream was known, otherwise the message has to be parsed and stored.
+ */
+bool refresh_result(
+	result_container &results, const std::string &shortinfo, const asio::ip::address &sender);
+
+/// Whether a stream ever responded to a query from this endpoint (in this process).
+bool ever_responded(const udp::endpoint &endpoint);
+
+/// The maximum number of endpoints ever_responded() remembers.
+const std::size_t max_remembered_responders = 4096;
+
+/**
+ * Remember that a stream responded from an endpoint (see ever_responded()).
+ *
+ * Once more than max_remembered_responders endpoints are known, the one whose last response is
+ * the oldest is forgotten.
+ */
+void remember_responder(const udp::endpoint &endpoint);
+
 /**
  * An asynchronous resolve attempt for a single query targeted at a set of endpoints, via UDP.
  *
@@ -23,6 +62,9 @@ typedef std::map<std::string, std::pair<stream_info_impl, double>> result_contai
  * sequence of query packet sends (one for each endpoint in the list) and a sequence of result
  * packet receives. The operation will wait for return packets until either a particular timeout has
  * been reached or until it is cancelled via the cancel() method.
+ *
+ * Where supported (Linux), the queries to consecutive endpoints and the replies that queued up are
+ * sent and received in batches, with one system call for each.
  */
 class resolve_attempt_udp : public cancellable_obj,
 							public std::enable_shared_from_this<resolve_attempt_udp> {
@@ -47,11 +89,12 @@ public:
 	 * i.e. the receives are ended.
 	 * @param registry A registry where the attempt can register itself as active so it can be
 	 * cancelled during shutdown.
+	 * @param on_added Called when a new stream was added to the results.
 	 */
 	resolve_attempt_udp(asio::io_context &io, const udp &protocol,
 		const std::vector<udp::endpoint> &targets, const std::string &query,
 		result_container &results, std::mutex &results_mut, double cancel_after = 5.0,
-		cancellable_registry *registry = nullptr);
+		cancellable_registry *registry = nullptr, result_hook on_added = nullptr);
 
 	/// Destructor
 	~resolve_attempt_udp();
@@ -72,11 +115,17 @@ private:
 	/// This function asks to receive the next result packet.
 	void receive_next_result();
 
-	/// Thos function starts an async send operation for the given current endpoint.
+	/// Send the queries from the given endpoint on (in batches, pausing between them).
 	void send_next_query(endpoint_list::const_iterator next);
 
-	/// Handler that gets called when a receive has completed.
-	void handle_receive_outcome(err_t err, std::size_t len);
+	/// The socket the query to an endpoint is sent over.
+	udp::socket &socket_for(const udp::endpoint &target);
+
+	/// Handler that gets called when a receive of `count` results has completed.
+	void handle_receive_outcome(err_t err, std::size_t count);
+
+	/// Process a received result.
+	void handle_result(const received_datagram &result);
 
 	// === cancellation ===
 
@@ -91,13 +140,15 @@ private:
 	result_container &results_;
 	/// shared mutex that protects the results
 	std::mutex &results_mut_;
+	/// called when a new stream was added to the results
+	result_hook on_added_;
 
 	// constant over the lifetime of this attempt
 	/// the timeout for giving up
 	double cancel_after_;
 	/// whether the operation has been cancelled
 	bool cancelled_;
-	/// list of endpoints that should receive the query
+	/// list of endpoints (of the attempt's protocol) that should receive the query
 	std::vector<udp::endpoint> targets_;
 	/// the query string
 	std::string query_;
@@ -107,10 +158,10 @@ private:
 	std::string query_id_;
 
 	// data maintained/modified across handler invocations
-	/// the endpoint from which we received the last result
-	udp::endpoint remote_endpoint_;
-	/// holds a single result received from the net
-	char resultbuf_[65536];
+	/// the slots the results are received into
+	std::vector<received_datagram> batch_{make_datagram_batch()};
+	/// the queries of the batch that's being sent
+	std::vector<outgoing_datagram> outgoing_;
 
 	// IO objects
 	/// socket to send data over (for unicasts)
@@ -119,6 +170,10 @@ private:
 	udp::socket broadcast_socket_;
 	/// socket to send data over (for multicasts)
 	udp::socket multicast_socket_;
+	/// the number of queries sent in the current batch (they're sent in batches to pace them)
+	std::size_t batch_sent_{0};
+	/// waits between two batches of queries
+	asio::steady_timer pace_timer_;
 	/// socket to receive replies (always unicast)
 	udp::socket recv_socket_;
 	/// timer to schedule the cancel action
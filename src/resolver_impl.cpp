@@ -1,10 +1,20 @@
 #include "resolver_impl.h"
+#include "announce_listener.h"
 #include "api_config.h"
+#include "discovery_cache.h"
 #include "resolve_attempt_udp.h"
 #include "socket_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/connect.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
 #include <loguru.hpp>
 #include <memory>
+#include <stdexcept>
 #include <thread>
 
 
@@ -14,8 +24,9 @@ using namespace lsl;
 
 resolver_impl::resolver_impl()
 	: cfg_(api_config::get_instance()), cancelled_(false), expired_(false), forget_after_(FOREVER),
-	  fast_mode_(true), io_(std::make_shared<asio::io_context>()), resolve_timeout_expired_(*io_),
-	  wave_timer_(*io_), unicast_timer_(*io_) {
+	  fast_mode_(true), results_(std::make_shared<resolve_results>()),
+	  io_(std::make_shared<asio::io_context>()), resolve_timeout_expired_(*io_),
+	  wave_timer_(*io_), unicast_timer_(*io_), expiry_timer_(*io_) {
 	// parse the multicast addresses into endpoints and store them
 	uint16_t mcast_port = cfg_->multicast_port();
 	for (const auto &mcast_addr : cfg_->multicast_addresses()) {
@@ -82,15 +93,35 @@ resolver_impl *resolver_impl::create_resolver(
 
 // === resolve functions ===
 
-std::vector<stream_info_impl> resolver_impl::resolve_oneshot(
-	const std::string &query, int minimum, double timeout, double minimum_time) {
+/// Get the results of the running one-shot resolves of a query, or start new ones.
+static std::shared_ptr<resolve_results> join_running_resolves(const std::string &query) {
+	static std::mutex running_mut;
+	static std::map<std::string, std::weak_ptr<resolve_results>> running;
+	std::lock_guard<std::mutex> lock(running_mut);
+	for (auto it = running.begin(); it != running.end();)
+		if (it->second.expired())
+			it = running.erase(it);
+		else
+			++it;
+	auto &entry = running[query];
+	auto results = entry.lock();
+	if (!results) entry = results = std::make_shared<resolve_results>();
+	return results;
+}
+
+std::vector<stream_info_impl> resolver_impl::resolve_oneshot(const std::string &query,
+	int minimum, double timeout, double minimum_time, bool use_cache) {
 	check_query(query);
+	if (discovery_cache *cache = use_cache ? discovery_cache::get() : nullptr) {
+		std::vector<stream_info_impl> cached;
+		if (cache->lookup(query, minimum, timeout, minimum_time, cached)) return cached;
+	}
 	// reset the IO service & set up the query parameters
 	io_->restart();
 	query_ = query;
 	minimum_ = minimum;
 	wait_until_ = lsl_clock() + minimum_time;
-	results_.clear();
+	results_ = join_running_resolves(query);
 	forget_after_ = FOREVER;
 	fast_mode_ = true;
 	expired_ = false;
@@ -112,10 +143,81 @@ std::vector<stream_info_impl> resolver_impl::resolve_oneshot(
 		io_->run();
 		// collect output
 		std::vector<stream_info_impl> output;
-		for (auto &result : results_) output.push_back(result.second.first);
+		{
+			std::lock_guard<std::mutex> lock(results_->mut);
+			for (auto &result : results_->results) output.push_back(result.second.first);
+		}
+		// leave the shared results, so later resolves start afresh
+		results_ = std::make_shared<resolve_results>();
 		return output;
-	} else
+	} else {
+		results_ = std::make_shared<resolve_results>();
 		return std::vector<stream_info_impl>();
+	}
+}
+
+stream_info_impl resolver_impl::resolve_address(
+	const std::string &host, uint16_t port, const std::string &uid, double timeout) {
+	// the same request a resolver sends to an outlet's TCP port; the outlet only replies if the
+	// query matches
+	const std::string request =
+		"LSL:shortinfo\r\n" +
+		(uid.empty() ? build_query() : build_query("uid", uid.c_str())) + "\r\n";
+	asio::io_context io;
+	tcp::resolver resolver(io);
+	tcp::socket sock(io);
+	asio::streambuf reply;
+	lslboost::system::error_code result;
+	bool done = false;
+	resolver.async_resolve(host, std::to_string(port),
+		[&](err_t err, const tcp::resolver::results_type &endpoints) {
+			if (err) {
+				result = err;
+				done = true;
+				return;
+			}
+			asio::async_connect(sock, endpoints, [&](err_t err, const tcp::endpoint &) {
+				if (err) {
+					result = err;
+					done = true;
+					return;
+				}
+				asio::async_write(sock, asio::buffer(request), [&](err_t err, std::size_t) {
+					if (err) {
+						result = err;
+						done = true;
+						return;
+					}
+					// the outlet closes the connection after the reply
+					asio::async_read(sock, reply, [&](err_t err, std::size_t) {
+						if (err != asio::error::eof) result = err;
+						done = true;
+					});
+				});
+			});
+		});
+	if (timeout >= FOREVER)
+		io.run();
+	else
+		io.run_for(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(timeout)));
+	const std::string address = host + ':' + std::to_string(port);
+	if (!done) throw timeout_error("The outlet at " + address + " didn't reply in time.");
+	if (result)
+		throw lost_error("Couldn't get the stream info from " + address + ": " + result.message());
+	if (!reply.size())
+		throw lost_error("There's no " + (uid.empty() ? std::string("stream") : "stream " + uid) +
+						 " of this session at " + address + '.');
+	stream_info_impl info;
+	info.from_shortinfo_message(
+		std::string(asio::buffers_begin(reply.data()), asio::buffers_end(reply.data())));
+	// the outlet doesn't know its addresses, the connection tells us one
+	const asio::ip::address remote = sock.remote_endpoint().address();
+	if (remote.is_v4())
+		info.v4address(remote.to_string());
+	else
+		info.v6address(remote.to_string());
+	return info;
 }
 
 void resolver_impl::resolve_continuous(const std::string &query, double forget_after) {
@@ -125,39 +227,178 @@ void resolver_impl::resolve_continuous(const std::string &query, double forget_a
 	query_ = query;
 	minimum_ = 0;
 	wait_until_ = 0;
-	results_.clear();
+	results_ = std::make_shared<resolve_results>();
 	forget_after_ = forget_after;
 	fast_mode_ = false;
 	expired_ = false;
+	// listen for the announcements of outlets
+	if (cfg_->announce_interval() > 0) listen_for_announcements();
 	// start a wave of resolve packets
 	next_resolve_wave();
+	// prune the results as they expire, so their disappearance is reported in time
+	expire_results();
 	// spawn a thread that runs the IO operations
-	background_io_ = std::make_shared<std::thread>([shared_io = io_]() { shared_io->run(); });
+	background_io_ = std::make_shared<managed_thread>(
+		lsl_thread_io, "resolver", [shared_io = io_]() { shared_io->run(); });
 }
 
 std::vector<stream_info_impl> resolver_impl::results(uint32_t max_results) {
 	std::vector<stream_info_impl> output;
-	std::lock_guard<std::mutex> lock(results_mut_);
-	double expired_before = lsl_clock() - forget_after_;
-
-	for (auto it = results_.begin(); it != results_.end();) {
-		if (it->second.second < expired_before)
-			it = results_.erase(it);
-		else {
-			if (output.size() < max_results) output.push_back(it->second.first);
-			it++;
+	std::vector<std::string> expired;
+	{
+		std::lock_guard<std::mutex> lock(results_->mut);
+		double expired_before = lsl_clock() - forget_after_;
+
+		for (auto it = results_->results.begin(); it != results_->results.end();) {
+			if (it->second.second < expired_before) {
+				expired.push_back(it->first);
+				it = results_->results.erase(it);
+			} else {
+				if (output.size() < max_results) output.push_back(it->second.first);
+				it++;
+			}
 		}
 	}
+	for (const auto &uid : expired) report(uid);
 	return output;
 }
 
+void resolver_impl::forget(const std::string &uid) {
+	{
+		std::lock_guard<std::mutex> lock(results_->mut);
+		results_->results.erase(uid);
+	}
+	report(uid);
+}
+
+// === result callback ===
+
+void resolver_impl::set_callback(resolver_callback callback) {
+	std::lock_guard<std::recursive_mutex> lock(changes_mut_);
+	callback_ = std::move(callback);
+	if (!callback_) return;
+	// copied, since the callback may change the tracked streams (e.g. by forgetting one)
+	std::vector<stream_info_impl> present;
+	for (const auto &tracked : tracked_)
+		if (tracked.second.present) present.push_back(tracked.second.info);
+	for (const auto &info : present) {
+		try {
+			callback_(info, true);
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Error in the resolver callback: %s", e.what());
+		}
+	}
+}
+
+std::vector<std::pair<stream_info_impl, bool>> resolver_impl::results_since(
+	uint64_t &version, uint32_t max_changes) {
+	std::lock_guard<std::recursive_mutex> lock(changes_mut_);
+	if (version && version < forgotten_version_)
+		throw std::range_error("The streams that disappeared since this version were forgotten.");
+	std::vector<std::pair<stream_info_impl, bool>> output;
+	// a caller that starts afresh doesn't need to know which streams are gone already
+	const bool afresh = version == 0;
+	for (auto it = changes_.upper_bound(version);
+		 it != changes_.end() && output.size() < max_changes; ++it) {
+		const tracked_stream &tracked = tracked_.at(it->second);
+		if (!afresh || tracked.present) output.emplace_back(tracked.info, tracked.present);
+		version = it->first;
+	}
+	return output;
+}
+
+result_hook resolver_impl::change_hook() {
+	if (fast_mode_) return nullptr;
+	return [this](const std::string &uid) { report(uid); };
+}
+
+void resolver_impl::report(const std::string &uid) {
+	// the results may have changed again by the time a change is reported, so the difference
+	// between the results and the last recorded change is recorded
+	std::lock_guard<std::recursive_mutex> lock(changes_mut_);
+	auto tracked = tracked_.find(uid);
+	const bool was_present = tracked != tracked_.end() && tracked->second.present;
+	bool present;
+	stream_info_impl info;
+	{
+		std::lock_guard<std::mutex> results_lock(results_->mut);
+		auto result = results_->results.find(uid);
+		present = result != results_->results.end();
+		if (present && !was_present) info = result->second.first;
+	}
+	if (present == was_present) return;
+	if (tracked == tracked_.end())
+		tracked = tracked_.emplace(uid, tracked_stream{info, 0, true}).first;
+	else {
+		changes_.erase(tracked->second.version);
+		if (present) {
+			tracked->second.info = info;
+			--disappeared_;
+		} else
+			info = tracked->second.info;
+	}
+	tracked->second.present = present;
+	tracked->second.version = ++version_;
+	changes_.emplace(version_, uid);
+	if (!present && ++disappeared_ > max_forgotten_streams) {
+		// forget the oldest disappearance
+		for (auto it = changes_.begin(); it != changes_.end(); ++it) {
+			auto oldest = tracked_.find(it->second);
+			if (oldest->second.present) continue;
+			forgotten_version_ = it->first;
+			tracked_.erase(oldest);
+			changes_.erase(it);
+			--disappeared_;
+			break;
+		}
+	}
+	if (!callback_) return;
+	try {
+		callback_(info, present);
+	} catch (std::exception &e) { LOG_F(ERROR, "Error in the resolver callback: %s", e.what()); }
+}
+
+void resolver_impl::expire_results() {
+	if (expired_) return;
+	std::vector<std::string> expired;
+	const double now = lsl_clock();
+	// check again after forget_after_ if there are no results (newer ones expire later)
+	double next_expiry = now + forget_after_;
+	{
+		std::lock_guard<std::mutex> lock(results_->mut);
+		for (auto it = results_->results.begin(); it != results_->results.end();) {
+			const double expiry = it->second.second + forget_after_;
+			if (expiry < now) {
+				expired.push_back(it->first);
+				it = results_->results.erase(it);
+			} else {
+				next_expiry = std::min(next_expiry, expiry);
+				++it;
+			}
+		}
+	}
+	for (const auto &uid : expired) report(uid);
+	// a few ms late, so the next result has expired; at most hourly (for huge forget_after_)
+	expiry_timer_.expires_after(timeout_sec(std::min(next_expiry - now + 0.005, 3600.)));
+	expiry_timer_.async_wait([this](err_t err) {
+		if (err != asio::error::operation_aborted) expire_results();
+	});
+}
+
 // === timer-driven async handlers ===
 
 void resolver_impl::next_resolve_wave() {
 	std::size_t num_results = 0;
+	bool send_wave = true;
 	{
-		std::lock_guard<std::mutex> lock(results_mut_);
-		num_results = results_.size();
+		std::lock_guard<std::mutex> lock(results_->mut);
+		num_results = results_->results.size();
+		// another resolve of the same query has just sent a wave, we get its results, too
+		const double now = lsl_clock();
+		if (fast_mode_ && now - results_->last_wave < cfg_->multicast_min_rtt())
+			send_wave = false;
+		else
+			results_->last_wave = now;
 	}
 	if (cancelled_ || expired_ ||
 		(minimum_ && (num_results >= (std::size_t)minimum_) && lsl_clock() >= wait_until_)) {
@@ -165,11 +406,11 @@ void resolver_impl::next_resolve_wave() {
 		cancel_ongoing_resolve();
 	} else {
 		// start a new multicast wave
-		udp_multicast_burst();
+		if (send_wave) udp_multicast_burst();
 
 		auto wave_timer_timeout =
-			(fast_mode_ ? 0 : cfg_->continuous_resolve_interval()) + cfg_->multicast_min_rtt();
-		if (!ucast_endpoints_.empty()) {
+			(fast_mode_ ? 0 : continuous_wave_interval()) + cfg_->multicast_min_rtt();
+		if (send_wave && !ucast_endpoints_.empty()) {
 			// we have known peer addresses: we spawn a unicast wave
 			unicast_timer_.expires_after(timeout_sec(cfg_->multicast_min_rtt()));
 			unicast_timer_.async_wait([this](err_t ec) { this->udp_unicast_burst(ec); });
@@ -189,7 +430,7 @@ void resolver_impl::udp_multicast_burst() {
 	for (auto protocol: udp_protocols_) {
 		try {
 			std::make_shared<resolve_attempt_udp>(*io_, protocol, mcast_endpoints_, query_,
-				results_, results_mut_, cfg_->multicast_max_rtt(), this)
+				results_->results, results_->mut, cfg_->multicast_max_rtt(), this, change_hook())
 				->begin();
 		} catch (std::exception &e) {
 			if (++failures == udp_protocols_.size())
@@ -201,15 +442,66 @@ void resolver_impl::udp_multicast_burst() {
 	}
 }
 
+double resolver_impl::continuous_wave_interval() const {
+	// announced streams refresh their results themselves, so the query waves are only needed to
+	// find streams that aren't announced (e.g. of older liblsl versions) in time
+	const double interval = cfg_->continuous_resolve_interval(),
+				 announce_interval = cfg_->announce_interval();
+	if (announce_interval > interval && 2 * (announce_interval + cfg_->multicast_min_rtt()) <
+											 forget_after_)
+		return announce_interval;
+	return interval;
+}
+
+void resolver_impl::listen_for_announcements() {
+	for (const auto &group : mcast_endpoints_) {
+		if (std::find(udp_protocols_.begin(), udp_protocols_.end(), group.protocol()) ==
+			udp_protocols_.end())
+			continue;
+		try {
+			std::make_shared<announce_listener>(
+				*io_, group, query_, results_->results, results_->mut, this, change_hook())
+				->begin();
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "Could not listen for stream announcements on %s: %s",
+				group.address().to_string().c_str(), e.what());
+		}
+	}
+}
+
+/// the number of ports per known peer that are queried in addition to those that ever responded
+const int unicast_probe_free_ports = 2;
+
+std::vector<udp::endpoint> resolver_impl::unicast_targets() {
+	// the last time any resolver in this process queried all ports
+	static std::atomic<double> last_sweep{-FOREVER};
+	const double now = lsl_clock(), sweep_interval = cfg_->unicast_sweep_interval();
+	double last = last_sweep;
+	if (now - last >= sweep_interval && last_sweep.compare_exchange_strong(last, now))
+		return ucast_endpoints_;
+
+	// the endpoints are grouped by peer, in ascending port order; outlets bind the lowest free
+	// port, so new ones are most likely found right above the ports that are in use
+	std::vector<udp::endpoint> targets;
+	int free_ports = 0;
+	for (std::size_t k = 0; k < ucast_endpoints_.size(); ++k) {
+		const auto &ep = ucast_endpoints_[k];
+		if (k == 0 || ep.address() != ucast_endpoints_[k - 1].address()) free_ports = 0;
+		if (ever_responded(ep) || free_ports++ < unicast_probe_free_ports) targets.push_back(ep);
+	}
+	return targets;
+}
+
 void resolver_impl::udp_unicast_burst(err_t err) {
 	if (err == asio::error::operation_aborted) return;
 
+	const std::vector<udp::endpoint> targets = unicast_targets();
 	int failures = 0;
 	// start one per IP stack under consideration
 	for (auto protocol: udp_protocols_) {
 		try {
-			std::make_shared<resolve_attempt_udp>(*io_, protocol, ucast_endpoints_, query_,
-				results_, results_mut_, cfg_->unicast_max_rtt(), this)
+			std::make_shared<resolve_attempt_udp>(*io_, protocol, targets, query_,
+				results_->results, results_->mut, cfg_->unicast_max_rtt(), this, change_hook())
 				->begin();
 		} catch (std::exception &e) {
 			if (++failures == udp_protocols_.size())
@@ -234,6 +526,7 @@ void resolver_impl::cancel_ongoing_resolve() {
 	// timer fires: cancel the next wave schedule
 	post(*io_, [this]() { wave_timer_.cancel(); });
 	post(*io_, [this]() { unicast_timer_.cancel(); });
+	post(*io_, [this]() { expiry_timer_.cancel(); });
 	// and cancel the timeout, too
 	post(*io_, [this]() { resolve_timeout_expired_.cancel(); });
 	// cancel all currently active resolve attempts
@@ -5,9 +5,12 @@
 #include "common.h"
 #include "forward.h"
 #include "stream_info_impl.h"
+#include "thread_policy.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -21,6 +24,18 @@ class api_config;
 /// A container for resolve results (map from stream instance UID onto (stream_info,receive-time)).
 typedef std::map<std::string, std::pair<stream_info_impl, double>> result_container;
 
+/// Called with the UID of a stream that was added to or removed from the results.
+using result_hook = std::function<void(const std::string &uid)>;
+
+/// The results of a resolve, shared by all one-shot resolves of the same query that run at once.
+struct resolve_results {
+	result_container results;
+	/// protects the results and last_wave
+	std::mutex mut;
+	/// when the last query wave was sent by any of the resolves
+	double last_wave{-FOREVER};
+};
+
 /**
  * A stream resolver object.
  *
@@ -37,6 +52,10 @@ typedef std::map<std::string, std::pair<stream_info_impl, double>> result_contai
  */
 class resolver_impl : public cancellable_registry {
 public:
+	/// Called with a stream's info when it appeared in (true) or disappeared from (false) the
+	/// results of a continuous resolve.
+	using resolver_callback = std::function<void(const stream_info_impl &info, bool appeared)>;
+
 	/**
 	 * Instantiate a new resolver and configure timing parameters.
 	 *
@@ -90,9 +109,29 @@ public:
 	 * produce the desired number of results).
 	 * @param minimum_time Search for matching streams for at least this much time (e.g., if
 	 * multiple streams may be present).
+	 * @param use_cache Return the streams in the discovery cache (if enabled) if they satisfy the
+	 * query without searching the network.
+	 *
+	 * If other threads resolve the same query at the same time, the resolves share their query
+	 * waves and results.
 	 */
 	std::vector<stream_info_impl> resolve_oneshot(const std::string &query, int minimum = 0,
-		double timeout = FOREVER, double minimum_time = 0.0);
+		double timeout = FOREVER, double minimum_time = 0.0, bool use_cache = true);
+
+	/**
+	 * Get the info of a stream directly from the outlet at a known address, without a query on
+	 * the network (e.g. in a fixed topology).
+	 *
+	 * @param host The host name or IP address of the outlet's computer.
+	 * @param port The outlet's TCP (data) port.
+	 * @param uid The UID of the expected stream, so a different outlet that took over the port
+	 * isn't mistaken for it (empty for any stream of our session on that port).
+	 * @param timeout The time to wait for the outlet's reply.
+	 * @throws lost_error if there's no matching stream at the address.
+	 * @throws timeout_error if the outlet didn't reply in time.
+	 */
+	static stream_info_impl resolve_address(
+		const std::string &host, uint16_t port, const std::string &uid, double timeout);
 
 	/**
 	 * Starts a background thread that resolves a query string and periodically updates the list of
@@ -111,6 +150,39 @@ public:
 	/// Get the current set of results (e.g., during continuous operation).
 	std::vector<stream_info_impl> results(uint32_t max_results = 4294967295);
 
+	/// Remove a stream from the current results, e.g. because it's known to be gone.
+	void forget(const std::string &uid);
+
+	/**
+	 * Call a function whenever a stream appears in or disappears from the results (continuous
+	 * operation only), so they don't have to be polled with results().
+	 *
+	 * A stream appears as soon as its first reply or announcement arrives and disappears when its
+	 * outlet says goodbye, forget() is called or it hasn't been seen for forget_after seconds.
+	 * The function is called right away for the current results and then mostly from the
+	 * resolver's thread; the calls don't overlap and alternate for each stream. It may call
+	 * results() and forget(), but not set_callback(). Once this returns, the previous function
+	 * isn't called anymore; an empty function removes it.
+	 */
+	void set_callback(resolver_callback callback);
+
+	/**
+	 * Get the streams that appeared in (true) or disappeared from (false) the results since a
+	 * version of them (continuous operation only), oldest change first, so polling a large
+	 * network only copies what changed.
+	 *
+	 * @param version The version the caller knows, 0 for none (then only the present streams are
+	 * returned); updated to the version after the returned changes.
+	 * @param max_changes Return at most this many changes; the rest is returned by the next call.
+	 * @throws std::range_error if the disappearances since the version were already forgotten
+	 * (see max_forgotten_streams); the caller has to start over with version 0.
+	 */
+	std::vector<std::pair<stream_info_impl, bool>> results_since(
+		uint64_t &version, uint32_t max_changes = 4294967295);
+
+	/// How many disappeared streams are remembered for results_since().
+	static const std::size_t max_forgotten_streams = 1024;
+
 	/**
 	 * Tear down any ongoing operations and render the resolver unusable.
 	 *
@@ -129,9 +201,31 @@ private:
 	/// Start a new resolver attempt on the known peers.
 	void udp_unicast_burst(err_t err);
 
+	/// The known peers' endpoints the next unicast wave is sent to (see
+	/// api_config::unicast_sweep_interval()).
+	std::vector<udp::endpoint> unicast_targets();
+
 	/// Cancel the currently ongoing resolve, if any.
 	void cancel_ongoing_resolve();
 
+	/// Start listening for the outlets' announcements (continuous operation only).
+	void listen_for_announcements();
+
+	/// The time between the query waves of a continuous resolve (in addition to the RTT).
+	double continuous_wave_interval() const;
+
+	/// The hook the resolve attempts and announcement listeners call when they changed the
+	/// results (continuous operation only).
+	result_hook change_hook();
+
+	/// Record if a stream appeared in or disappeared from the results since its last change and
+	/// tell the callback.
+	void report(const std::string &uid);
+
+	/// Remove the streams that weren't seen for forget_after_ seconds from the results and
+	/// schedule the next check for when the next one expires (continuous operation only).
+	void expire_results();
+
 
 	// constants (mostly config-deduced)
 	/// pointer to our configuration object
@@ -163,22 +257,45 @@ private:
 	double wait_until_{0};
 	/// whether this is a fast resolve: determines the rate at which the query is repeated
 	bool fast_mode_;
-	/// results are stored here
-	result_container results_;
-	/// a mutex that protects the results map
-	std::mutex results_mut_;
+	/// results are stored here; one-shot resolves of the same query that run at the same time
+	/// (e.g. in different threads) share their results and only one of them sends query waves
+	std::shared_ptr<resolve_results> results_;
 
 	// io objects
 	/// our IO service
 	io_context_p io_;
 	/// a thread that runs background IO if we are performing a resolve_continuous
-	std::shared_ptr<std::thread> background_io_;
+	std::shared_ptr<managed_thread> background_io_;
 	/// the overall timeout for a query
 	asio::steady_timer resolve_timeout_expired_;
 	/// a timer that fires when a new wave should be scheduled
 	asio::steady_timer wave_timer_;
 	/// a timer that fires when the unicast wave should be scheduled
 	asio::steady_timer unicast_timer_;
+	/// a timer that fires when the next result expires
+	asio::steady_timer expiry_timer_;
+
+	// the changes of the results (continuous operation only)
+	/// a stream's last known info and its last change
+	struct tracked_stream {
+		stream_info_impl info;
+		/// the version of the results the change happened in
+		uint64_t version;
+		bool present;
+	};
+	/// protects the callback and the changes; held while the callback is called
+	std::recursive_mutex changes_mut_;
+	resolver_callback callback_;
+	/// the present and the recently disappeared streams by their UID
+	std::map<std::string, tracked_stream> tracked_;
+	/// the UIDs of the tracked streams by the version of their last change
+	std::map<uint64_t, std::string> changes_;
+	/// the version of the last change
+	uint64_t version_{0};
+	/// the version of the last disappearance that was forgotten
+	uint64_t forgotten_version_{0};
+	/// the number of tracked streams that disappeared
+	std::size_t disappeared_{0};
 };
 
 } // namespace lsl
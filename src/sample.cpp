@@ -1,7 +1,26 @@
 #define BOOST_MATH_DISABLE_STD_FPCLASSIFY
 #include "sample.h"
+#include "alloc_guard.h"
+#include "api_config.h"
+#ifndef LSL_NO_PROTOCOL_100
 #include "portable_archive/portable_iarchive.hpp"
 #include "portable_archive/portable_oarchive.hpp"
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <loguru.hpp>
+#include <map>
+#include <memory>
+#include <new>
+#include <type_traits>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 using namespace lsl;
 
@@ -10,111 +29,140 @@ using namespace lsl;
 #endif
 
 sample::~sample() noexcept{
-	if (format_ != cft_string) return;
-	for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; ++p)
+	if (format() != cft_string) return;
+	for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; ++p)
 		p->~basic_string<char>();
 }
 
-void sample::operator delete(void *x) noexcept {
-	if(x == nullptr) return;
-
-	lsl::factory *factory = reinterpret_cast<sample *>(x)->factory_;
-
-	// delete the underlying memory only if it wasn't allocated in the factory's storage area
-	if (x < factory->storage_ || x >= factory->storage_ + factory->storage_size_)
-		delete[](char *) x;
-}
-
 bool sample::operator==(const sample &rhs) const noexcept {
-	if ((timestamp != rhs.timestamp) || (format_ != rhs.format_) ||
-		(num_channels_ != rhs.num_channels_))
+	if ((timestamp != rhs.timestamp) || (format() != rhs.format()) ||
+		(num_channels() != rhs.num_channels()))
 		return false;
-	if (format_ != cft_string)
+	if (format() != cft_string)
 		return memcmp(&(rhs.data_), &data_, datasize()) == 0;
 	else {
 		std::string *data = (std::string *)&data_;
 		std::string *rhsdata = (std::string *)&(rhs.data_);
-		for (std::size_t k = 0; k < num_channels_; k++)
+		for (std::size_t k = 0; k < num_channels(); k++)
 			if (data[k] != rhsdata[k]) return false;
 		return true;
 	}
 }
 
 sample &sample::assign_typed(const std::string *s) {
-	switch (format_) {
+	switch (format()) {
 	case cft_string:
-		for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; *p++ = *s++)
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; *p++ = *s++)
 			;
 		break;
 	case cft_float32:
-		for (float *p = (float *)&data_, *e = p + num_channels_; p < e;
+		for (float *p = (float *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<float>(*s++))
 			;
 		break;
 	case cft_double64:
-		for (double *p = (double *)&data_, *e = p + num_channels_; p < e;
+		for (double *p = (double *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<double>(*s++))
 			;
 		break;
 	case cft_int8:
-		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels_; p < e;
+		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<int8_t>(*s++))
 			;
 		break;
 	case cft_int16:
-		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels_; p < e;
+		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<int16_t>(*s++))
 			;
 		break;
 	case cft_int32:
-		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels_; p < e;
+		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<int32_t>(*s++))
 			;
 		break;
 #ifndef BOOST_NO_INT64_T
 	case cft_int64:
-		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels_; p < e;
+		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels(); p < e;
 			 *p++ = from_string<int64_t>(*s++))
 			;
 		break;
 #endif
+	case cft_int24: detail::convert_values((detail::int24 *)&data_, s, num_channels()); break;
+	case cft_float16: detail::convert_values((detail::float16 *)&data_, s, num_channels()); break;
 	default: throw std::invalid_argument("Unsupported channel format.");
 	}
 	return *this;
 }
 
+sample &sample::assign_moved(std::string *s) {
+	if (format() != cft_string) return assign_typed(static_cast<const std::string *>(s));
+	for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; ++p, ++s)
+		p->swap(*s);
+	return *this;
+}
+
+sample &sample::assign_buffers(const char *const *data, const uint32_t *lengths) {
+	if (format() != cft_string)
+		throw std::invalid_argument("Cannot assign buffers to a numeric sample.");
+	std::string *p = (std::string *)&data_;
+	for (uint32_t k = 0; k < num_channels(); ++k)
+		p[k].assign(data[k], lengths ? lengths[k] : strlen(data[k]));
+	return *this;
+}
+
+sample &sample::assign_channels(const sample &src, const uint32_t *channels) {
+	if (format() != src.format())
+		throw std::invalid_argument("Cannot assign channels of a sample with a different format.");
+	if (format() == cft_string) {
+		const auto *s = reinterpret_cast<const std::string *>(&src.data_);
+		auto *d = reinterpret_cast<std::string *>(&data_);
+		for (uint32_t k = 0; k < num_channels(); ++k) d[k] = s[channels[k]];
+	} else {
+		const std::size_t bytes = format_sizes[format()];
+		for (uint32_t k = 0; k < num_channels(); ++k)
+			memcpy(&data_ + k * bytes, &src.data_ + channels[k] * bytes, bytes);
+	}
+	return *this;
+}
+
 sample &sample::retrieve_typed(std::string *d) {
-	switch (format_) {
+	switch (format()) {
 	case cft_string:
-		for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; *d++ = *p++)
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; *d++ = *p++)
 			;
 		break;
 	case cft_float32:
-		for (float *p = (float *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (float *p = (float *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 	case cft_double64:
-		for (double *p = (double *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (double *p = (double *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 	case cft_int8:
-		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 	case cft_int16:
-		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 	case cft_int32:
-		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 #ifndef BOOST_NO_INT64_T
 	case cft_int64:
-		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels_; p < e; *d++ = to_string(*p++))
+		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels(); p < e; *d++ = to_string(*p++))
 			;
 		break;
 #endif
+	case cft_int24:
+		detail::convert_values(d, (const detail::int24 *)&data_, num_channels());
+		break;
+	case cft_float16:
+		detail::convert_values(d, (const detail::float16 *)&data_, num_channels());
+		break;
 	default: throw std::invalid_argument("Unsupported channel format.");
 	}
 	return *this;
@@ -146,18 +194,162 @@ template <typename T> void save_value(std::streambuf &sb, T v, int use_byte_orde
 	save_raw(sb, &v, sizeof(T));
 }
 
-void sample::save_streambuf(
-	std::streambuf &sb, int /*protocol_version*/, int use_byte_order, void *scratchpad) const {
-	// write sample header
+/// Numeric samples up to this size are (de)serialized as a single block via a stack buffer
+const std::size_t max_block_bytes = 256;
+/// The size of a sample header with a transmitted time stamp (tag + timestamp)
+const std::size_t max_header_bytes = sizeof(uint8_t) + sizeof(double);
+/// String samples up to this size (including the length prefixes) are serialized as one block
+const std::size_t max_string_block_bytes = 1024;
+
+/// Write the header of a sample into a block, return its size
+std::size_t put_header(char *block, double timestamp, int use_byte_order) {
 	if (timestamp == DEDUCED_TIMESTAMP) {
+		block[0] = TAG_DEDUCED_TIMESTAMP;
+		return 1;
+	}
+	block[0] = TAG_TRANSMITTED_TIMESTAMP;
+	if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(timestamp);
+	memcpy(block + 1, &timestamp, sizeof(timestamp));
+	return max_header_bytes;
+}
+
+void sample::save_streambuf_header(std::streambuf &sb, int use_byte_order, bool deduced) const {
+	// write sample header
+	if (deduced || timestamp == DEDUCED_TIMESTAMP) {
 		save_value(sb, TAG_DEDUCED_TIMESTAMP, use_byte_order);
 	} else {
 		save_value(sb, TAG_TRANSMITTED_TIMESTAMP, use_byte_order);
 		save_value(sb, timestamp, use_byte_order);
 	}
+}
+
+void sample::save_streambuf_values(std::streambuf &sb, int use_byte_order, void *scratchpad) const {
+	if (format() == cft_string)
+		throw std::invalid_argument("Only the values of numeric samples can be framed.");
+	if (use_byte_order == BOOST_BYTE_ORDER || format_sizes[format()] == 1)
+		save_raw(sb, &data_, datasize());
+	else {
+		memcpy(scratchpad, &data_, datasize());
+		convert_endian(scratchpad);
+		save_raw(sb, scratchpad, datasize());
+	}
+}
+
+void sample::save_streambuf_changed(std::streambuf &sb, int use_byte_order, void *prev) const {
+	if (format() == cft_string)
+		throw std::invalid_argument("Only the values of numeric samples can be framed.");
+	const std::size_t value_size = format_sizes[format()], n = num_channels();
+	const char *cur = &data_;
+	char *last = static_cast<char *>(prev);
+	const auto changed = [=](std::size_t k) {
+		return memcmp(cur + k * value_size, last + k * value_size, value_size) != 0;
+	};
+	const auto put_varint = [&sb](std::size_t value) {
+		for (; value >= 0x80; value >>= 7) sb.sputc(static_cast<char>((value & 0x7f) | 0x80));
+		sb.sputc(static_cast<char>(value));
+	};
+	const auto varint_bytes = [](std::size_t value) {
+		std::size_t bytes = 1;
+		for (; value >= 0x80; value >>= 7) ++bytes;
+		return bytes;
+	};
+	// the size of the index list (the count and the gaps between the changed channels)
+	std::size_t num_changed = 0, list_bytes = 0;
+	for (std::size_t k = 0, next = 0; k < n; ++k)
+		if (changed(k)) {
+			list_bytes += varint_bytes(k - next);
+			next = k + 1;
+			++num_changed;
+		}
+	list_bytes += varint_bytes(num_changed + 1);
+	if (list_bytes < 1 + (n + 7) / 8) {
+		put_varint(num_changed + 1);
+		for (std::size_t k = 0, next = 0; k < n; ++k)
+			if (changed(k)) {
+				put_varint(k - next);
+				next = k + 1;
+			}
+	} else {
+		// the mask, with channel k in bit k % 8 of byte k / 8
+		put_varint(0);
+		for (std::size_t c = 0; c < n; c += 8) {
+			uint8_t byte = 0;
+			for (std::size_t k = c; k < std::min(n, c + 8); ++k)
+				if (changed(k)) byte |= static_cast<uint8_t>(1 << (k - c));
+			save_raw(sb, &byte, 1);
+		}
+	}
+	// the changed values, written in runs
+	const bool swap = use_byte_order != BOOST_BYTE_ORDER && value_size > 1;
+	for (std::size_t k = 0; k < n;) {
+		if (!changed(k)) {
+			++k;
+			continue;
+		}
+		std::size_t end = k + 1;
+		while (end < n && changed(end)) ++end;
+		if (!swap)
+			save_raw(sb, cur + k * value_size, (end - k) * value_size);
+		else
+			for (std::size_t j = k; j < end; ++j) {
+				char value[sizeof(double)];
+				memcpy(value, cur + j * value_size, value_size);
+				endian_reverse_inplace_n(value, value_size, 1);
+				save_raw(sb, value, value_size);
+			}
+		k = end;
+	}
+	memcpy(last, cur, datasize());
+}
+
+void sample::save_streambuf(std::streambuf &sb, int /*protocol_version*/, int use_byte_order,
+	void *scratchpad, bool deduced) const {
+	const std::size_t data_bytes = datasize();
+	const double ts = deduced ? DEDUCED_TIMESTAMP : timestamp;
+	if (format() != cft_string && data_bytes <= max_block_bytes) {
+		// fast path: assemble header and data in one block and write it with a single call
+		char block[max_header_bytes + max_block_bytes];
+		const std::size_t pos = put_header(block, ts, use_byte_order);
+		memcpy(block + pos, &data_, data_bytes);
+		if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format()] > 1)
+			endian_reverse_inplace_n(block + pos, format_sizes[format()], num_channels());
+		save_raw(sb, block, pos + data_bytes);
+		return;
+	}
+	if (format() == cft_string) {
+		// fast path for short strings (e.g. markers): assemble the header, the length prefixes
+		// and the contents in one block, so serializing doesn't allocate or make a call per value
+		const auto *strings = (const std::string *)&data_;
+		std::size_t string_bytes = 0;
+		for (uint32_t k = 0; k < num_channels() && string_bytes <= max_string_block_bytes; ++k)
+			string_bytes += (strings[k].size() <= 0xFF ? 2 : 1 + sizeof(uint32_t)) +
+							strings[k].size();
+		if (string_bytes <= max_string_block_bytes) {
+			char block[max_header_bytes + max_string_block_bytes];
+			std::size_t pos = put_header(block, ts, use_byte_order);
+			for (uint32_t k = 0; k < num_channels(); ++k) {
+				const std::string &str = strings[k];
+				if (str.size() <= 0xFF) {
+					block[pos++] = sizeof(uint8_t);
+					block[pos++] = static_cast<char>(str.size());
+				} else {
+					block[pos++] = sizeof(uint32_t);
+					auto len = static_cast<uint32_t>(str.size());
+					if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(len);
+					memcpy(block + pos, &len, sizeof(len));
+					pos += sizeof(len);
+				}
+				memcpy(block + pos, str.data(), str.size());
+				pos += str.size();
+			}
+			save_raw(sb, block, pos);
+			return;
+		}
+	}
+	save_streambuf_header(sb, use_byte_order, deduced);
 	// write channel data
-	if (format_ == cft_string) {
-		for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; p++) {
+	if (format() == cft_string) {
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; p++) {
 			// write string length as variable-length integer
 			if (p->size() <= 0xFF) {
 				save_value(sb, (uint8_t)sizeof(uint8_t), use_byte_order);
@@ -181,7 +373,7 @@ void sample::save_streambuf(
 		}
 	} else {
 		// write numeric data in binary
-		if (use_byte_order == BOOST_BYTE_ORDER || format_sizes[format_] == 1) {
+		if (use_byte_order == BOOST_BYTE_ORDER || format_sizes[format()] == 1) {
 			save_raw(sb, &data_, datasize());
 		} else {
 			memcpy(scratchpad, &data_, datasize());
@@ -194,16 +386,30 @@ void sample::save_streambuf(
 void sample::load_streambuf(
 	std::streambuf &sb, int /*unused*/, int use_byte_order, bool suppress_subnormals) {
 	// read sample header
-	if (load_value<uint8_t>(sb, use_byte_order) == TAG_DEDUCED_TIMESTAMP)
+	const auto tag = sb.sbumpc();
+	if (tag == std::streambuf::traits_type::eof()) throw std::runtime_error("Input stream error.");
+	const std::size_t data_bytes = datasize();
+	if (tag == TAG_DEDUCED_TIMESTAMP)
 		// deduce the timestamp
 		timestamp = DEDUCED_TIMESTAMP;
-	else
+	else if (format() != cft_string && data_bytes <= max_block_bytes) {
+		// fast path: read the time stamp and the channel data with a single call
+		char block[sizeof(double) + max_block_bytes];
+		load_raw(sb, block, sizeof(double) + data_bytes);
+		memcpy(&timestamp, block, sizeof(double));
+		if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(timestamp);
+		memcpy(&data_, block + sizeof(double), data_bytes);
+		if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format()] > 1)
+			convert_endian(&data_);
+		if (suppress_subnormals && format_float[format()]) suppress_subnormal_values();
+		return;
+	} else
 		// read the time stamp
 		timestamp = load_value<double>(sb, use_byte_order);
 
 	// read channel data
-	if (format_ == cft_string) {
-		for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; p++) {
+	if (format() == cft_string) {
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; p++) {
 			// read string length as variable-length integer
 			std::size_t len = 0;
 			auto lenbytes = load_value<uint8_t>(sb, use_byte_order);
@@ -226,56 +432,348 @@ void sample::load_streambuf(
 		}
 	} else {
 		// read numeric channel data
-		load_raw(sb, &data_, datasize());
-		if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format_] > 1) convert_endian(&data_);
-		if (suppress_subnormals && format_float[format_]) {
-			if (format_ == cft_float32) {
-				for (uint32_t *p = (uint32_t *)&data_, *e = p + num_channels_; p < e; p++)
-					if (*p && ((*p & UINT32_C(0x7fffffff)) <= UINT32_C(0x007fffff)))
-						*p &= UINT32_C(0x80000000);
-			} else {
+		load_raw(sb, &data_, data_bytes);
+		if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format()] > 1)
+			convert_endian(&data_);
+		if (suppress_subnormals && format_float[format()]) suppress_subnormal_values();
+	}
+}
+
+void sample::suppress_subnormal_values() { suppress_subnormals(&data_, format(), num_channels()); }
+
+void sample::suppress_subnormals(void *data, lsl_channel_format_t fmt, std::size_t count) {
+	if (fmt == cft_float32) {
+		for (uint32_t *p = (uint32_t *)data, *e = p + count; p < e; p++)
+			if (*p && ((*p & UINT32_C(0x7fffffff)) <= UINT32_C(0x007fffff)))
+				*p &= UINT32_C(0x80000000);
+	} else if (fmt == cft_float16) {
+		for (uint16_t *p = (uint16_t *)data, *e = p + count; p < e; p++)
+			if (*p && ((*p & 0x7fff) <= 0x03ff)) *p &= 0x8000;
+	} else if (fmt == cft_double64) {
 #ifndef BOOST_NO_INT64_T
-				for (uint64_t *p = (uint64_t *)&data_, *e = p + num_channels_; p < e; p++)
-					if (*p && ((*p & UINT64_C(0x7fffffffffffffff)) <= UINT64_C(0x000fffffffffffff)))
-						*p &= UINT64_C(0x8000000000000000);
+		for (uint64_t *p = (uint64_t *)data, *e = p + count; p < e; p++)
+			if (*p && ((*p & UINT64_C(0x7fffffffffffffff)) <= UINT64_C(0x000fffffffffffff)))
+				*p &= UINT64_C(0x8000000000000000);
 #endif
-			}
+	}
+}
+
+/// Write the delta-encoded channel values, see sample::save_streambuf_delta()
+template <typename U>
+void save_delta(std::streambuf &sb, const void *data, void *prev, uint32_t n, bool is_float) {
+	const U *cur = reinterpret_cast<const U *>(data);
+	U *last = reinterpret_cast<U *>(prev);
+	for (uint32_t k = 0; k < n; ++k) {
+		U v;
+		if (is_float)
+			v = cur[k] ^ last[k];
+		else {
+			// zigzag-encode the difference so that small negative values need few bytes
+			const U d = static_cast<U>(cur[k] - last[k]);
+			v = static_cast<U>((d << 1) ^ (0 - (d >> (sizeof(U) * 8 - 1))));
+		}
+		last[k] = cur[k];
+		// write 7 bits per byte, the high bit signals that more bytes follow
+		do {
+			auto byte = static_cast<uint8_t>(v & 0x7f);
+			if (v >>= 7) byte |= 0x80;
+			if (sb.sputc(static_cast<char>(byte)) == std::streambuf::traits_type::eof())
+				throw std::runtime_error("Output stream error.");
+		} while (v);
+	}
+}
+
+/// Read the delta-encoded channel values, see sample::save_streambuf_delta()
+template <typename U>
+void load_delta(std::streambuf &sb, void *data, void *prev, uint32_t n, bool is_float) {
+	U *cur = reinterpret_cast<U *>(data), *last = reinterpret_cast<U *>(prev);
+	for (uint32_t k = 0; k < n; ++k) {
+		U v = 0;
+		for (unsigned shift = 0;; shift += 7) {
+			const auto c = sb.sbumpc();
+			if (c == std::streambuf::traits_type::eof())
+				throw std::runtime_error("Input stream error.");
+			if (shift >= sizeof(U) * 8)
+				throw std::runtime_error("Stream contents corrupted (invalid varlen int).");
+			v = static_cast<U>(v | static_cast<U>(static_cast<U>(c & 0x7f) << shift));
+			if (!(c & 0x80)) break;
+		}
+		if (is_float)
+			cur[k] = v ^ last[k];
+		else
+			cur[k] = static_cast<U>(last[k] + static_cast<U>((v >> 1) ^ (0 - (v & 1))));
+		last[k] = cur[k];
+	}
+}
+
+void sample::save_streambuf_delta(
+	std::streambuf &sb, int use_byte_order, void *prev, bool deduced) const {
+	if (format() == cft_string)
+		throw std::invalid_argument("Delta encoding is only supported for numeric samples.");
+	save_streambuf_header(sb, use_byte_order, deduced);
+	const bool is_float = format_float[format()];
+	switch (format_sizes[format()]) {
+	case 1: save_delta<uint8_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 2: save_delta<uint16_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 4: save_delta<uint32_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 8: save_delta<uint64_t>(sb, &data_, prev, num_channels(), is_float); break;
+	default: throw std::invalid_argument("Delta encoding is only supported for numeric samples.");
+	}
+}
+
+void sample::load_streambuf_delta(
+	std::streambuf &sb, int use_byte_order, bool suppress_subnormals, void *prev) {
+	if (format() == cft_string)
+		throw std::invalid_argument("Delta encoding is only supported for numeric samples.");
+	// read sample header
+	if (load_value<uint8_t>(sb, use_byte_order) == TAG_DEDUCED_TIMESTAMP)
+		timestamp = DEDUCED_TIMESTAMP;
+	else
+		timestamp = load_value<double>(sb, use_byte_order);
+	const bool is_float = format_float[format()];
+	switch (format_sizes[format()]) {
+	case 1: load_delta<uint8_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 2: load_delta<uint16_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 4: load_delta<uint32_t>(sb, &data_, prev, num_channels(), is_float); break;
+	case 8: load_delta<uint64_t>(sb, &data_, prev, num_channels(), is_float); break;
+	default: throw std::invalid_argument("Delta encoding is only supported for numeric samples.");
+	}
+	if (suppress_subnormals && is_float) suppress_subnormal_values();
+}
+
+/// Write an integer in the format of the portable archive (see eos::portable_oarchive): a single
+/// zero byte for 0, otherwise the number of bytes that hold the value (negated for negative
+/// values) followed by these bytes in little endian order. Returns the end of the written bytes.
+template <typename T> char *put_portable(char *out, T value) {
+	using U = typename std::make_unsigned<T>::type;
+	if (!value) {
+		*out++ = 0;
+		return out;
+	}
+	signed char size = 1;
+	if (sizeof(T) > 1) {
+		T temp = value;
+		size = 0;
+		do {
+			temp = static_cast<T>(temp >> 8);
+			++size;
+		} while (temp != 0 && temp != static_cast<T>(-1));
+	}
+	*out++ = static_cast<char>(value > 0 ? size : -size);
+	const auto bits = static_cast<U>(value);
+	for (signed char k = 0; k < size; ++k) *out++ = static_cast<char>(bits >> (8 * k));
+	return out;
+}
+
+/// Read an integer written by put_portable().
+template <typename T> T get_portable(std::streambuf &sb) {
+	using U = typename std::make_unsigned<T>::type;
+	auto c = sb.sbumpc();
+	if (c == std::streambuf::traits_type::eof()) throw std::runtime_error("Input stream error.");
+	const int size = static_cast<signed char>(c);
+	if (!size) return 0;
+	const int len = std::abs(size);
+	if ((size < 0 && std::is_unsigned<T>::value) || len > static_cast<int>(sizeof(T)))
+		throw std::runtime_error("Stream contents corrupted (invalid integer size).");
+	// negative values are sign-extended
+	U bits = size < 0 ? static_cast<U>(~U(0)) : U(0);
+	for (int k = 0; k < len; ++k) {
+		if ((c = sb.sbumpc()) == std::streambuf::traits_type::eof())
+			throw std::runtime_error("Input stream error.");
+		bits = static_cast<U>(bits & ~static_cast<U>(U(0xff) << (8 * k)));
+		bits = static_cast<U>(bits | static_cast<U>(static_cast<U>(c & 0xff) << (8 * k)));
+	}
+	return static_cast<T>(bits);
+}
+
+/// The integer that the portable archive writes for a value: the value itself for integers, the
+/// bit pattern for floating point numbers (with a canonical pattern for NaNs).
+template <typename T> T portable_value(T value) { return value; }
+
+template <typename U, typename F> U portable_float_bits(F value) {
+	U bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const U magnitude_mask = static_cast<U>(~U(0)) >> 1;
+	const U significand_mask = (U(1) << (std::numeric_limits<F>::digits - 1)) - 1;
+	// NaN: all exponent bits and some significand bits set
+	if ((bits & magnitude_mask) > (magnitude_mask & ~significand_mask)) bits = magnitude_mask;
+	return bits;
+}
+uint32_t portable_value(float value) { return portable_float_bits<uint32_t>(value); }
+uint64_t portable_value(double value) { return portable_float_bits<uint64_t>(value); }
+
+/// Read a floating point value from its bit pattern
+template <typename F, typename U> F float_from_bits(U bits) {
+	F value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/// Collects the values of a sample in a stack buffer so they're written with few calls
+class portable_writer {
+public:
+	explicit portable_writer(std::streambuf &sb) : sb_(sb) {}
+
+	template <typename T> void put(T value) {
+		if (pos_ + 1 + sizeof(T) > sizeof(block_)) flush();
+		pos_ = static_cast<std::size_t>(put_portable(block_ + pos_, value) - block_);
+	}
+
+	void put_raw(const char *data, std::size_t size) {
+		flush();
+		save_raw(sb_, data, size);
+	}
+
+	void flush() {
+		if (pos_) save_raw(sb_, block_, pos_);
+		pos_ = 0;
+	}
+
+private:
+	std::streambuf &sb_;
+	char block_[max_block_bytes];
+	std::size_t pos_{0};
+};
+
+template <typename T>
+void save_portable_values(portable_writer &out, const char *data, uint32_t n) {
+	for (const T *p = reinterpret_cast<const T *>(data), *e = p + n; p < e; ++p)
+		out.put(portable_value(*p));
+}
+
+template <typename T> void load_portable_values(std::streambuf &sb, char *data, uint32_t n) {
+	for (T *p = reinterpret_cast<T *>(data), *e = p + n; p < e; ++p) *p = get_portable<T>(sb);
+}
+
+// the portable archive has no 24 bit integers, so they are written as 32 bit ones
+template <>
+void save_portable_values<detail::int24>(portable_writer &out, const char *data, uint32_t n) {
+	for (const auto *p = reinterpret_cast<const detail::int24 *>(data), *e = p + n; p < e; ++p)
+		out.put(portable_value(static_cast<int32_t>(*p)));
+}
+
+template <> void load_portable_values<detail::int24>(std::streambuf &sb, char *data, uint32_t n) {
+	for (auto *p = reinterpret_cast<detail::int24 *>(data), *e = p + n; p < e; ++p)
+		*p = get_portable<int32_t>(sb);
+}
+
+// half precision values are written as their bit patterns, like the other floating point values
+template <>
+void save_portable_values<detail::float16>(portable_writer &out, const char *data, uint32_t n) {
+	save_portable_values<uint16_t>(out, data, n);
+}
+
+template <>
+void load_portable_values<detail::float16>(std::streambuf &sb, char *data, uint32_t n) {
+	load_portable_values<uint16_t>(sb, data, n);
+}
+
+void sample::save_portable(std::streambuf &sb, bool deduced) const {
+	portable_writer out(sb);
+	if (deduced || timestamp == DEDUCED_TIMESTAMP)
+		out.put(TAG_DEDUCED_TIMESTAMP);
+	else {
+		out.put(TAG_TRANSMITTED_TIMESTAMP);
+		out.put(portable_value(timestamp));
+	}
+	switch (format()) {
+	case cft_float32: save_portable_values<float>(out, &data_, num_channels()); break;
+	case cft_double64: save_portable_values<double>(out, &data_, num_channels()); break;
+	case cft_string:
+		for (const std::string *p = string_data(), *e = p + num_channels(); p < e; ++p) {
+			out.put(p->size());
+			if (!p->empty()) out.put_raw(p->data(), p->size());
+		}
+		break;
+	case cft_int8: save_portable_values<int8_t>(out, &data_, num_channels()); break;
+	case cft_int16: save_portable_values<int16_t>(out, &data_, num_channels()); break;
+	case cft_int32: save_portable_values<int32_t>(out, &data_, num_channels()); break;
+#ifndef BOOST_NO_INT64_T
+	case cft_int64: save_portable_values<int64_t>(out, &data_, num_channels()); break;
+#endif
+	case cft_int24: save_portable_values<detail::int24>(out, &data_, num_channels()); break;
+	case cft_float16: save_portable_values<detail::float16>(out, &data_, num_channels()); break;
+	default: throw std::runtime_error("Unsupported channel format.");
+	}
+	out.flush();
+}
+
+void sample::load_portable(std::streambuf &sb) {
+	if (get_portable<char>(sb) == TAG_DEDUCED_TIMESTAMP)
+		timestamp = DEDUCED_TIMESTAMP;
+	else
+		timestamp = float_from_bits<double>(get_portable<uint64_t>(sb));
+	switch (format()) {
+	case cft_float32:
+		for (float *p = (float *)&data_, *e = p + num_channels(); p < e; ++p)
+			*p = float_from_bits<float>(get_portable<uint32_t>(sb));
+		break;
+	case cft_double64:
+		for (double *p = (double *)&data_, *e = p + num_channels(); p < e; ++p)
+			*p = float_from_bits<double>(get_portable<uint64_t>(sb));
+		break;
+	case cft_string:
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; ++p) {
+			p->resize(get_portable<std::size_t>(sb));
+			if (!p->empty()) load_raw(sb, &(*p)[0], p->size());
 		}
+		break;
+	case cft_int8: load_portable_values<int8_t>(sb, &data_, num_channels()); break;
+	case cft_int16: load_portable_values<int16_t>(sb, &data_, num_channels()); break;
+	case cft_int32: load_portable_values<int32_t>(sb, &data_, num_channels()); break;
+#ifndef BOOST_NO_INT64_T
+	case cft_int64: load_portable_values<int64_t>(sb, &data_, num_channels()); break;
+#endif
+	case cft_int24: load_portable_values<detail::int24>(sb, &data_, num_channels()); break;
+	case cft_float16: load_portable_values<detail::float16>(sb, &data_, num_channels()); break;
+	default: throw std::runtime_error("Unsupported channel format.");
 	}
 }
 
+#ifndef LSL_NO_PROTOCOL_100
 template <class Archive> void sample::serialize_channels(Archive &ar, const uint32_t /*unused*/) {
-	switch (format_) {
+	switch (format()) {
 	case cft_float32:
-		for (float *p = (float *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (float *p = (float *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 	case cft_double64:
-		for (double *p = (double *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (double *p = (double *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 	case cft_string:
-		for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 	case cft_int8:
-		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (int8_t *p = (int8_t *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 	case cft_int16:
-		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (int16_t *p = (int16_t *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 	case cft_int32:
-		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (int32_t *p = (int32_t *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 #ifndef BOOST_NO_INT64_T
 	case cft_int64:
-		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels_; p < e; ar & *p++)
+		for (int64_t *p = (int64_t *)&data_, *e = p + num_channels(); p < e; ar & *p++)
 			;
 		break;
 #endif
+	case cft_int24:
+		for (auto *p = (detail::int24 *)&data_, *e = p + num_channels(); p < e; ++p) {
+			int32_t value = *p;
+			ar &value;
+			*p = value;
+		}
+		break;
+	case cft_float16:
+		for (auto *p = (detail::float16 *)&data_, *e = p + num_channels(); p < e; ar & p++->bits)
+			;
+		break;
 	default: throw std::runtime_error("Unsupported channel format.");
 	}
 }
@@ -305,6 +803,7 @@ void sample::load(eos::portable_iarchive &ar, const uint32_t archive_version) {
 	// read channel data
 	serialize_channels(ar, archive_version);
 }
+#endif
 
 template <typename T> void test_pattern(T *data, uint32_t num_channels, int offset) {
 	for (std::size_t k = 0; k < num_channels; k++) {
@@ -319,105 +818,276 @@ sample &sample::assign_test_pattern(int offset) {
 	pushthrough = true;
 	timestamp = 123456.789;
 
-	switch (format_) {
+	switch (format()) {
 	case cft_float32:
-		test_pattern(reinterpret_cast<float *>(&data_), num_channels_, offset + 0);
+		test_pattern(reinterpret_cast<float *>(&data_), num_channels(), offset + 0);
 		break;
 	case cft_double64:
-		test_pattern(reinterpret_cast<double *>(&data_), num_channels_, offset + 16777217);
+		test_pattern(reinterpret_cast<double *>(&data_), num_channels(), offset + 16777217);
 		break;
 	case cft_string: {
 		std::string *data = (std::string *)&data_;
-		for (int32_t k = 0u; k < (int) num_channels_; k++)
+		for (int32_t k = 0u; k < (int) num_channels(); k++)
 			data[k] = to_string((k + 10) * (k % 2 == 0 ? 1 : -1));
 		break;
 	}
 	case cft_int32:
-		test_pattern(reinterpret_cast<int32_t *>(&data_), num_channels_, offset + 65537);
+		test_pattern(reinterpret_cast<int32_t *>(&data_), num_channels(), offset + 65537);
 		break;
 	case cft_int16:
-		test_pattern(reinterpret_cast<int16_t *>(&data_), num_channels_, offset + 257);
+		test_pattern(reinterpret_cast<int16_t *>(&data_), num_channels(), offset + 257);
 		break;
 	case cft_int8:
-		test_pattern(reinterpret_cast<int8_t *>(&data_), num_channels_, offset + 1);
+		test_pattern(reinterpret_cast<int8_t *>(&data_), num_channels(), offset + 1);
 		break;
 #ifndef BOOST_NO_INT64_T
 	case cft_int64: {
 		int64_t *data = (int64_t *)&data_;
 		int64_t offset64 = 2147483649ll + offset;
-		for (uint32_t k = 0; k < num_channels_; k++) {
+		for (uint32_t k = 0; k < num_channels(); k++) {
 			data[k] = (k + offset64);
 			if (k % 2 == 1) data[k] = -data[k];
 		}
 		break;
 	}
 #endif
+	case cft_int24: {
+		auto *data = (detail::int24 *)&data_;
+		for (uint32_t k = 0; k < num_channels(); k++) {
+			const auto val = static_cast<int32_t>((k + offset + 65537) % 0x7fffff);
+			data[k] = (k % 2 == 0) ? val : -val;
+		}
+		break;
+	}
+	case cft_float16: {
+		// the test values are exact up to 2048
+		auto *data = (detail::float16 *)&data_;
+		for (uint32_t k = 0; k < num_channels(); k++) {
+			const auto val = static_cast<float>((k + offset) % 2048);
+			data[k] = (k % 2 == 0) ? val : -val;
+		}
+		break;
+	}
 	default: throw std::invalid_argument("Unsupported channel format used to construct a sample.");
 	}
 
 	return *this;
 }
 
+/// Slabs backed by huge pages are aligned to and sized in multiples of this
+const std::size_t huge_page_bytes = 2 << 20;
+
+/// The bytes of a sample before its payload
+const uint32_t header_bytes = static_cast<uint32_t>(sizeof(sample) - alignof(sample));
+
+/// Allocate the memory for a slab with an alignment (a power of two, at least the size of a
+/// pointer), asking for transparent huge pages if requested
+static char *allocate_slab(std::size_t bytes, std::size_t alignment, bool huge_pages) {
+	void *mem = nullptr;
+#ifdef _WIN32
+	(void)huge_pages;
+	if (!(mem = _aligned_malloc(bytes, alignment))) throw std::bad_alloc();
+#else
+#ifdef __linux__
+	if (huge_pages) alignment = huge_page_bytes;
+#else
+	(void)huge_pages;
+#endif
+	if (posix_memalign(&mem, alignment, bytes) != 0) throw std::bad_alloc();
+#ifdef __linux__
+	// only a hint, the kernel may ignore it (e.g. if THP are disabled)
+	if (huge_pages) madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+#endif
+	return static_cast<char *>(mem);
+}
+
+/// Free a slab from allocate_slab()
+static void free_slab(char *data) {
+#ifdef _WIN32
+	_aligned_free(data);
+#else
+	std::free(data);
+#endif
+}
+
 factory::factory(lsl_channel_format_t fmt, uint32_t num_chans, uint32_t num_reserve)
-	: fmt_(fmt), num_chans_(num_chans),
-	  sample_size_(
-		  ensure_multiple(sizeof(sample) - sizeof(char) + format_sizes[fmt] * num_chans, 16)),
-	  storage_size_(sample_size_ * std::max(1u, num_reserve)),
-	  storage_(new char[storage_size_ + sample_size_]), // +1 sample for the sentinel
-	  sentinel_(new(reinterpret_cast<sample*>(storage_ + storage_size_)) sample(fmt, num_chans, this)),
-	  head_(sentinel_), tail_(sentinel_)
-	  {
-	// pre-construct an array of samples in the storage area and chain into a freelist
-	sample *s = nullptr;
-	for (char *p = storage_, *e = p + storage_size_; p < e;) {
-		s = new (reinterpret_cast<sample *>(p)) sample(fmt, num_chans, this);
-		s->next_ = (sample *)(p += sample_size_);
+	: fmt_(fmt), num_chans_(num_chans), kernels_(fmt),
+	  alignment_(static_cast<uint32_t>(api_config::get_instance()->sample_alignment())),
+	  // data_ is the last member, so the payload starts in the sample's last alignment unit
+	  // (header_bytes); the header and the payload are each padded to the alignment, so with the
+	  // default alignment the samples are packed as tightly as possible to keep the per-sample
+	  // overhead of streams with few channels small, and with the cache line size as alignment
+	  // no two samples' payloads share a cache line
+	  sample_size_(std::max(ensure_multiple(static_cast<uint32_t>(sizeof(sample)), alignment_),
+		  ensure_multiple(header_bytes, alignment_) +
+			  ensure_multiple(format_sizes[fmt] * num_chans, alignment_))),
+	  slab_offset_((alignment_ - header_bytes % alignment_) % alignment_),
+	  slab_samples_(std::max<uint32_t>(
+		  16, static_cast<uint32_t>(
+				  std::max(api_config::get_instance()->sample_slab_bytes(), 0) / sample_size_))),
+	  huge_pages_(api_config::get_instance()->sample_slab_huge_pages()) {
+	// +1 sample per shard for the sentinels
+	const slab &first = add_slab(std::max(1u, num_reserve) + num_shards);
+	for (unsigned i = 0; i < num_shards; ++i) {
+		freelist &fl = shards_[i];
+		fl.sentinel_ = sample_at(first, i);
+		fl.sentinel_->next_ = nullptr;
+		fl.head_ = fl.tail_ = fl.sentinel_;
 	}
-	s->next_ = nullptr;
-	head_.store(s);
-	sentinel_->next_ = (sample *)storage_;
+	// distribute the remaining samples over the freelists
+	for (uint32_t k = num_shards; k < first.num_samples; ++k)
+		push_freelist(shards_[k % num_shards], sample_at(first, k));
+}
+
+const factory::slab &factory::add_slab(uint32_t num_samples) {
+	std::size_t bytes = slab_offset_ + std::size_t(num_samples) * sample_size_;
+	if (huge_pages_) {
+		bytes = (bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes;
+		num_samples = static_cast<uint32_t>((bytes - slab_offset_) / sample_size_);
+	}
+	slabs_.reserve(slabs_.size() + 1);
+	slab s{allocate_slab(bytes, std::max<std::size_t>(alignment_, sizeof(void *)), huge_pages_),
+		num_samples, bytes};
+	// before the samples are constructed, so the pages are allocated on the node
+	bind_memory_to_node(s.data, bytes, numa_node_);
+	for (uint32_t k = 0; k < num_samples; ++k)
+		new (sample_at(s, k)) sample(fmt_, num_chans_, this);
+	lock_memory(s.data, bytes);
+	slabs_.push_back(s);
+	return slabs_.back();
+}
+
+void factory::set_numa_node(int node) {
+	std::lock_guard<std::mutex> lock(slab_mut_);
+	numa_node_ = node;
+	for (const auto &s : slabs_) bind_memory_to_node(s.data, s.bytes, node);
+}
+
+sample *factory::grow() {
+	std::lock_guard<std::mutex> lock(slab_mut_);
+	const slab &s = add_slab(slab_samples_);
+	overflows_++;
+	LOG_F(1, "Sample pool exhausted, added slab #%u with %u samples", overflows_, s.num_samples);
+	if (report_growth_.load(std::memory_order_relaxed)) report_allocation("sample pool");
+	// keep the first sample for the caller and make the others available to everyone
+	freelist &fl = shards_[shard_index()];
+	for (uint32_t k = 1; k < s.num_samples; ++k)
+		push_freelist(fl, sample_at(s, k));
+	return sample_at(s, 0);
+}
+
+factory::statistics factory::stats() {
+	std::lock_guard<std::mutex> lock(slab_mut_);
+	statistics result{static_cast<uint32_t>(slabs_.size()), 0, overflows_};
+	for (const auto &s : slabs_) result.samples += s.num_samples;
+	return result;
+}
+
+unsigned factory::shard_index() {
+	static std::atomic<unsigned> next_shard{0};
+	static thread_local const unsigned shard = next_shard++ % num_shards;
+	return shard;
+}
+
+/// Reset the fields of a sample that's handed out again.
+static sample_p prepare_sample(sample *s, double timestamp, bool pushthrough) {
+	s->timestamp = timestamp;
+	s->pushthrough = pushthrough;
+	s->seq = 0;
+	s->received = 0.0;
+	return sample_p(s);
 }
 
 sample_p factory::new_sample(double timestamp, bool pushthrough) {
-	sample *result = pop_freelist();
-	if (!result)
-		result = new (new char[sample_size_]) sample(fmt_, num_chans_, this);
-	result->timestamp = timestamp;
-	result->pushthrough = pushthrough;
-	return sample_p(result);
+	sample *result = nullptr;
+	// try the calling thread's preferred freelist first and skip freelists in use by others
+	for (unsigned i = 0, first = shard_index(); i < num_shards && !result; ++i) {
+		freelist &fl = shards_[(first + i) % num_shards];
+		if (fl.popping_.exchange(true, std::memory_order_acquire)) continue;
+		result = pop_freelist(fl);
+		fl.popping_.store(false, std::memory_order_release);
+	}
+	if (!result) result = grow();
+	return prepare_sample(result, timestamp, pushthrough);
 }
 
-sample *factory::pop_freelist() {
-	sample *tail = tail_, *next = tail->next_;
-	if (tail == sentinel_) {
+void factory::new_samples(sample_p *out, std::size_t n) {
+	std::size_t got = 0;
+	while (got < n) {
+		// take as many samples as possible from each freelist, as in new_sample()
+		for (unsigned i = 0, first = shard_index(); i < num_shards && got < n; ++i) {
+			freelist &fl = shards_[(first + i) % num_shards];
+			if (fl.popping_.exchange(true, std::memory_order_acquire)) continue;
+			for (sample *s; got < n && (s = pop_freelist(fl));)
+				out[got++] = prepare_sample(s, 0.0, false);
+			fl.popping_.store(false, std::memory_order_release);
+		}
+		// the new slab's other samples are taken in the next round
+		if (got < n) out[got++] = prepare_sample(grow(), 0.0, false);
+	}
+}
+
+sample *factory::pop_freelist(freelist &fl) {
+	sample *tail = fl.tail_, *next = tail->next_;
+	if (tail == fl.sentinel_) {
 		if (!next) return nullptr;
-		tail_ = next;
+		fl.tail_ = next;
 		tail = next;
 		next = next->next_;
 	}
 	if (next) {
-		tail_ = next;
+		fl.tail_ = next;
 		return tail;
 	}
-	sample *head = head_.load();
+	sample *head = fl.head_.load();
 	if (tail != head) return nullptr;
-	reclaim_sample(sentinel_);
+	push_freelist(fl, fl.sentinel_);
 	next = tail->next_;
 	if (next) {
-		tail_ = next;
+		fl.tail_ = next;
 		return tail;
 	}
 	return nullptr;
 }
 
 factory::~factory() {
-	if (sample *cur = head_)
-		for (sample *next = cur->next_; next; cur = next, next = next->next_) delete cur;
-	delete[] storage_;
+	// all samples have been returned by now, so each slot holds an unused sample
+	for (const auto &s : slabs_) {
+		for (uint32_t k = 0; k < s.num_samples; ++k)
+			sample_at(s, k)->~sample();
+		unlock_memory(s.data, s.bytes);
+		free_slab(s.data);
+	}
 }
 
-void factory::reclaim_sample(sample *s) {
+void factory::push_freelist(freelist &fl, sample *s) {
 	s->next_ = nullptr;
-	sample *prev = head_.exchange(s);
+	sample *prev = fl.head_.exchange(s);
 	prev->next_ = s;
 }
+
+factory_p factory::shared(lsl_channel_format_t fmt, uint32_t num_chans, uint32_t num_reserve) {
+	static std::mutex mut;
+	static std::map<std::pair<lsl_channel_format_t, uint32_t>, std::weak_ptr<factory>> factories;
+	std::lock_guard<std::mutex> lock(mut);
+	std::weak_ptr<factory> &entry = factories[std::make_pair(fmt, num_chans)];
+	factory_p result = entry.lock();
+	if (!result) {
+		result = std::make_shared<factory>(fmt, num_chans, num_reserve);
+		entry = result;
+		// forget the pools of formats that aren't used anymore
+		for (auto it = factories.begin(); it != factories.end();)
+			it = it->second.expired() ? factories.erase(it) : std::next(it);
+	}
+	return result;
+}
+
+factory_p factory::for_stream(
+	lsl_channel_format_t fmt, uint32_t num_chans, uint32_t num_reserve, bool own) {
+	if (own || !api_config::get_instance()->shared_sample_pools())
+		return std::make_shared<factory>(fmt, num_chans, num_reserve);
+	return shared(fmt, num_chans, num_reserve);
+}
+
+void factory::reclaim_sample(sample *s) { push_freelist(shards_[shard_index()], s); }
@@ -3,14 +3,24 @@
 #include "common.h"
 #include "forward.h"
 #include "util/cast.hpp"
+#include "util/endian.hpp"
+#include "util/float16.hpp"
 #include <atomic>
 #include <boost/endian/conversion.hpp>
+#ifndef LSL_NO_PROTOCOL_100
 #include <boost/serialization/split_member.hpp>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iosfwd>
 #include <limits>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <vector>
 
 const int BOOST_BYTE_ORDER =
 	lslboost::endian::order::native == lslboost::endian::order::little ? 4321 : 1234;
@@ -36,15 +46,211 @@ const uint8_t TAG_TRANSMITTED_TIMESTAMP = 2;
 
 /// channel format properties
 const uint8_t format_sizes[] = {0, sizeof(float), sizeof(double), sizeof(std::string), sizeof(int32_t),
-	sizeof(int16_t), sizeof(int8_t), 8};
+	sizeof(int16_t), sizeof(int8_t), 8, 3, 2};
+// the half precision values are converted in software (or with conversion instructions), so they
+// are IEEE 754 values and their subnormals don't depend on the CPU
 const bool format_ieee754[] = {false, std::numeric_limits<float>::is_iec559,
-	std::numeric_limits<double>::is_iec559, false, false, false, false, false};
+	std::numeric_limits<double>::is_iec559, false, false, false, false, false, false, true};
 const bool format_subnormal[] = {false,
 	std::numeric_limits<float>::has_denorm != std::denorm_absent,
 	std::numeric_limits<double>::has_denorm != std::denorm_absent, false, false, false, false,
-	false};
-const bool format_integral[] = {false, false, false, false, true, true, true, true};
-const bool format_float[] = {false, true, true, false, false, false, false, false};
+	false, false, false};
+const bool format_integral[] = {false, false, false, false, true, true, true, true, true, false};
+const bool format_float[] = {false, true, true, false, false, false, false, false, false, true};
+
+namespace detail {
+/**
+ * A value of the cft_int24 format: a 24-bit integer packed into 3 bytes in the native byte order.
+ * It converts to and from int32_t; larger values are truncated to their lower 24 bits.
+ */
+struct int24 {
+	int24() = default;
+	int24(int32_t value) {
+		const auto u = static_cast<uint32_t>(value);
+		for (int k = 0; k < 3; ++k) bytes[byte_index(k)] = static_cast<uint8_t>(u >> (8 * k));
+	}
+	operator int32_t() const {
+		const uint32_t u = static_cast<uint32_t>(bytes[byte_index(0)]) |
+						   static_cast<uint32_t>(bytes[byte_index(1)]) << 8 |
+						   static_cast<uint32_t>(bytes[byte_index(2)]) << 16;
+		// sign-extend the 24th bit
+		return static_cast<int32_t>(u ^ 0x800000u) - 0x800000;
+	}
+
+	/// the bytes from the least to the most significant one
+	static constexpr int byte_index(int k) {
+		return lslboost::endian::order::native == lslboost::endian::order::little ? k : 2 - k;
+	}
+
+	uint8_t bytes[3];
+};
+static_assert(sizeof(int24) == 3, "int24 has to be packed");
+
+/// A value of the cft_float16 format: an IEEE 754 half precision number.
+struct float16 {
+	float16() = default;
+	float16(float value) : bits(float_to_half(value)) {}
+	operator float() const { return half_to_float(bits); }
+
+	uint16_t bits;
+};
+static_assert(sizeof(float16) == 2, "float16 has to be packed");
+
+
+/// Convert n numeric values, copying the bytes if both types have the same representation.
+template <class To, class From> void convert_values(To *dst, const From *src, std::size_t n) {
+	if (sizeof(To) == sizeof(From) && std::is_integral<To>::value == std::is_integral<From>::value)
+		memcpy(dst, src, n * sizeof(To));
+	else
+		for (std::size_t k = 0; k < n; ++k) dst[k] = static_cast<To>(src[k]);
+}
+template <class From> void convert_values(std::string *dst, const From *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = to_string(src[k]);
+}
+template <class To> void convert_values(To *dst, const std::string *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = from_string<To>(src[k]);
+}
+inline void convert_values(std::string *dst, const std::string *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = src[k];
+}
+inline void convert_values(std::string *dst, const int24 *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = to_string(static_cast<int32_t>(src[k]));
+}
+inline void convert_values(int24 *dst, const std::string *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = from_string<int32_t>(src[k]);
+}
+inline void convert_values(float16 *dst, const float *src, std::size_t n) {
+	float_to_half_n(reinterpret_cast<uint16_t *>(dst), src, n);
+}
+inline void convert_values(float *dst, const float16 *src, std::size_t n) {
+	half_to_float_n(dst, reinterpret_cast<const uint16_t *>(src), n);
+}
+inline void convert_values(std::string *dst, const float16 *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = to_string(static_cast<float>(src[k]));
+}
+inline void convert_values(float16 *dst, const std::string *src, std::size_t n) {
+	for (std::size_t k = 0; k < n; ++k) dst[k] = from_string<float>(src[k]);
+}
+
+template <class T, class F> void assign_values(void *dst, const T *src, std::size_t n) {
+	convert_values(static_cast<F *>(dst), src, n);
+}
+template <class T, class F> void retrieve_values(T *dst, const void *src, std::size_t n) {
+	convert_values(dst, static_cast<const F *>(src), n);
+}
+template <class T> void assign_unsupported(void *, const T *, std::size_t) {
+	throw std::invalid_argument("Unsupported channel format.");
+}
+template <class T> void retrieve_unsupported(T *, const void *, std::size_t) {
+	throw std::invalid_argument("Unsupported channel format.");
+}
+template <class T, class F>
+void retrieve_scaled_values(
+	T *dst, const void *src, std::size_t n, const T *gains, const T *offsets) {
+	const F *values = static_cast<const F *>(src);
+	for (std::size_t k = 0; k < n; ++k)
+		dst[k] = static_cast<T>(values[k]) * gains[k] + offsets[k];
+}
+template <class T>
+void retrieve_scaled_unsupported(T *, const void *, std::size_t, const T *, const T *) {
+	throw std::invalid_argument("Unsupported channel format.");
+}
+} // namespace detail
+
+/**
+ * The conversion kernels between values of the user type T and the channel data of some format.
+ *
+ * They are selected once per stream so that the per-sample code doesn't have to dispatch on the
+ * channel format.
+ */
+template <class T> struct typed_kernels {
+	/// Convert n values from a user buffer into the channel data.
+	using assign_fn = void (*)(void *dst, const T *src, std::size_t n);
+	/// Convert n values from the channel data into a user buffer.
+	using retrieve_fn = void (*)(T *dst, const void *src, std::size_t n);
+
+	assign_fn assign;
+	retrieve_fn retrieve;
+
+	/// Select the kernels for a channel format (unsupported formats get kernels that throw).
+	static typed_kernels select(lsl_channel_format_t fmt) {
+		switch (fmt) {
+		case cft_float32:
+			return {&detail::assign_values<T, float>, &detail::retrieve_values<T, float>};
+		case cft_double64:
+			return {&detail::assign_values<T, double>, &detail::retrieve_values<T, double>};
+		case cft_string:
+			return {&detail::assign_values<T, std::string>,
+				&detail::retrieve_values<T, std::string>};
+		case cft_int8:
+			return {&detail::assign_values<T, int8_t>, &detail::retrieve_values<T, int8_t>};
+		case cft_int16:
+			return {&detail::assign_values<T, int16_t>, &detail::retrieve_values<T, int16_t>};
+		case cft_int32:
+			return {&detail::assign_values<T, int32_t>, &detail::retrieve_values<T, int32_t>};
+#ifndef BOOST_NO_INT64_T
+		case cft_int64:
+			return {&detail::assign_values<T, int64_t>, &detail::retrieve_values<T, int64_t>};
+#endif
+		case cft_int24:
+			return {&detail::assign_values<T, detail::int24>,
+				&detail::retrieve_values<T, detail::int24>};
+		case cft_float16:
+			return {&detail::assign_values<T, detail::float16>,
+				&detail::retrieve_values<T, detail::float16>};
+		default: return {&detail::assign_unsupported<T>, &detail::retrieve_unsupported<T>};
+		}
+	}
+};
+
+/**
+ * The kernel that converts the channel data of some format to the floating-point type T and
+ * calibrates the values in the same pass, so a pull needs no second pass over the converted data.
+ */
+template <class T> struct scaled_kernel {
+	/// Convert n values from the channel data into a user buffer as
+	/// `value * gains[k] + offsets[k]`.
+	using retrieve_fn = void (*)(
+		T *dst, const void *src, std::size_t n, const T *gains, const T *offsets);
+
+	/// Select the kernel for a channel format (unsupported formats get a kernel that throws).
+	static retrieve_fn select(lsl_channel_format_t fmt) {
+		switch (fmt) {
+		case cft_float32: return &detail::retrieve_scaled_values<T, float>;
+		case cft_double64: return &detail::retrieve_scaled_values<T, double>;
+		case cft_int8: return &detail::retrieve_scaled_values<T, int8_t>;
+		case cft_int16: return &detail::retrieve_scaled_values<T, int16_t>;
+		case cft_int32: return &detail::retrieve_scaled_values<T, int32_t>;
+#ifndef BOOST_NO_INT64_T
+		case cft_int64: return &detail::retrieve_scaled_values<T, int64_t>;
+#endif
+		case cft_int24: return &detail::retrieve_scaled_values<T, detail::int24>;
+		case cft_float16: return &detail::retrieve_scaled_values<T, detail::float16>;
+		default: return &detail::retrieve_scaled_unsupported<T>;
+		}
+	}
+};
+
+/// The conversion kernels of a channel format for all supported user types.
+class format_kernels {
+public:
+	explicit format_kernels(lsl_channel_format_t fmt)
+		: kernels_(typed_kernels<char>::select(fmt), typed_kernels<int16_t>::select(fmt),
+			  typed_kernels<int32_t>::select(fmt), typed_kernels<int64_t>::select(fmt),
+			  typed_kernels<float>::select(fmt), typed_kernels<double>::select(fmt),
+			  typed_kernels<std::string>::select(fmt)) {}
+
+	/// Get the kernels for the user type T.
+	template <class T> const typed_kernels<T> &get() const {
+		return std::get<typed_kernels<T>>(kernels_);
+	}
+
+private:
+	std::tuple<typed_kernels<char>, typed_kernels<int16_t>, typed_kernels<int32_t>,
+		typed_kernels<int64_t>, typed_kernels<float>, typed_kernels<double>,
+		typed_kernels<std::string>>
+		kernels_;
+};
 
 /// A factory to create samples of a given format/size. Must outlive all of its created samples.
 class factory {
@@ -60,39 +266,165 @@ public:
 	/// Destroy the factory and delete all of its samples.
 	~factory();
 
+	/**
+	 * Get the process-wide factory for a channel format and count, creating it if there's none.
+	 *
+	 * All inlets and outlets of streams with the same format can share one pool this way; it
+	 * lives as long as any of them holds it. Each thread takes and returns the samples from
+	 * its own freelist shard, so the streams' threads rarely contend.
+	 * @param num_reserve nr of samples to pre-allocate if the factory is created
+	 */
+	static std::shared_ptr<factory> shared(
+		lsl_channel_format_t fmt, uint32_t num_chans, uint32_t num_reserve);
+
+	/**
+	 * Get the sample pool for a stream: the shared one (see api_config::shared_sample_pools())
+	 * unless the stream needs its own, e.g. to reserve all of its samples up front.
+	 */
+	static std::shared_ptr<factory> for_stream(
+		lsl_channel_format_t fmt, uint32_t num_chans, uint32_t num_reserve, bool own);
+
 	/// Create a new sample with a given timestamp and pushthrough flag.
-	/// Only one thread may call this function for a given factory object.
+	/// May be called from several threads at once.
 	sample_p new_sample(double timestamp, bool pushthrough);
 
+	/**
+	 * Create n new samples (with a time stamp of 0 and no pushthrough flag) at once.
+	 *
+	 * Each freelist is only acquired once for all of them. May be called from several threads at
+	 * once, like new_sample().
+	 */
+	void new_samples(sample_p *out, std::size_t n);
+
 	/// Reclaim a sample that's no longer used.
 	void reclaim_sample(sample *s);
 
+	/// Allocation statistics of a factory.
+	struct statistics {
+		/// number of slabs, including the initial one
+		uint32_t slabs;
+		/// number of samples in all slabs
+		uint32_t samples;
+		/// number of times the pool was exhausted and had to grow by a slab
+		uint32_t overflows;
+	};
+
+	/// Get the current allocation statistics.
+	statistics stats();
+
+	/// The memory a sample occupies, in bytes.
+	uint32_t sample_size() const { return sample_size_; }
+
+	/// The alignment of the samples' payloads, in bytes (see api_config::sample_alignment()).
+	uint32_t alignment() const { return alignment_; }
+
+	/// The memory held by the slabs, in bytes (without the contents of long strings).
+	uint64_t memory_bytes() { return static_cast<uint64_t>(stats().samples) * sample_size_; }
+
+	/// The channel format and count of the samples.
+	lsl_channel_format_t format() const { return fmt_; }
+	uint32_t num_channels() const { return num_chans_; }
+
+	/// The conversion kernels between the user type T and the samples' channel format.
+	template <class T> const typed_kernels<T> &kernels() const { return kernels_.get<T>(); }
+
+	/// Move the slabs to a NUMA node and allocate later slabs there (see bind_memory_to_node()).
+	void set_numa_node(int node);
+
+	/// Report each slab that's added from now on as an allocation of the data path, for the
+	/// no-allocation mode (see report_allocation()).
+	void report_growth() { report_growth_ = true; }
+
 private:
 	/// ensure that a given value is a multiple of some base, round up if necessary
 	static uint32_t ensure_multiple(uint32_t v, unsigned base) {
 		return (v % base) ? v - (v % base) + base : v;
 	}
 
-	/// Pop a sample from the freelist (multi-producer/single-consumer queue by Dmitry Vjukov)
-	sample *pop_freelist();
+	/**
+	 * A freelist of samples (multi-producer/single-consumer queue by Dmitry Vjukov).
+	 *
+	 * Samples are reclaimed into the freelist of the reclaiming thread's shard, so consumers on
+	 * different threads don't contend for the same head_. The single consumer side is guarded
+	 * by a try-lock; new_sample() skips shards that are busy.
+	 */
+	struct freelist {
+		/// head of the freelist
+		std::atomic<sample *> head_{nullptr};
+		char pad_head_[CACHELINE_BYTES - sizeof(std::atomic<sample *>)];
+		/// tail of the freelist, only accessed by the thread that holds popping_
+		sample *tail_{nullptr};
+		/// a sentinel element for the freelist
+		sample *sentinel_{nullptr};
+		/// whether a thread is currently popping from this freelist
+		std::atomic<bool> popping_{false};
+		char pad_tail_[CACHELINE_BYTES - 2 * sizeof(sample *) - sizeof(std::atomic<bool>)];
+	};
+
+	/// number of freelist shards
+	static constexpr unsigned num_shards = 4;
+
+	/// The freelist shard to be used by the calling thread
+	static unsigned shard_index();
+
+	/// Pop a sample from a freelist; the caller must own the freelist's popping_ flag
+	sample *pop_freelist(freelist &fl);
+
+	/// Push a sample onto a freelist
+	static void push_freelist(freelist &fl, sample *s);
+
+	/// A slab of storage for pre-constructed samples
+	struct slab {
+		char *data;
+		uint32_t num_samples;
+		std::size_t bytes;
+	};
+
+	/// The k-th sample in a slab.
+	sample *sample_at(const slab &s, uint32_t k) const {
+		return reinterpret_cast<sample *>(s.data + slab_offset_ + std::size_t(k) * sample_size_);
+	}
+
+	/**
+	 * Allocate a slab for at least num_samples samples and construct the samples in it.
+	 *
+	 * The caller must hold slab_mut_ (unless called from the constructor).
+	 * @return The new slab; huge-page backed slabs might hold more samples than requested.
+	 */
+	const slab &add_slab(uint32_t num_samples);
+
+	/// Add a slab when the pool is exhausted and return one of its samples.
+	sample *grow();
 
 	friend class sample;
 	/// the channel format to construct samples with
 	const lsl_channel_format_t fmt_;
 	/// the number of channels to construct samples with
 	const uint32_t num_chans_;
-	/// size of a sample, in bytes
+	/// the conversion kernels for the channel format
+	const format_kernels kernels_;
+	/// alignment of the payloads, in bytes
+	const uint32_t alignment_;
+	/// size of a sample (a multiple of the alignment), in bytes
 	const uint32_t sample_size_;
-	/// size of the allocated storage, in bytes
-	const uint32_t storage_size_;
-	/// a slab of storage for pre-allocated samples
-	char *const storage_;
-	/// a sentinel element for our freelist
-	sample *sentinel_;
-	/// head of the freelist
-	std::atomic<sample *> head_;
-	/// tail of the freelist
-	sample *tail_;
+	/// offset of the first sample in a slab, so its payload (and thus all others) is aligned
+	const uint32_t slab_offset_;
+	/// number of samples in each additional slab
+	const uint32_t slab_samples_;
+	/// whether slabs should be backed by huge pages
+	const bool huge_pages_;
+	/// protects slabs_, overflows_ and numa_node_
+	std::mutex slab_mut_;
+	/// all slabs, the first one holds the pre-allocated samples and the freelist sentinels
+	std::vector<slab> slabs_;
+	/// number of additional slabs that were allocated because the pool was exhausted
+	uint32_t overflows_{0};
+	/// the NUMA node of the slabs, -1 for the default placement
+	int numa_node_{-1};
+	/// whether added slabs are reported, see report_growth()
+	std::atomic<bool> report_growth_{false};
+	/// the freelists of unused samples
+	freelist shards_[num_shards];
 };
 
 /**
@@ -105,81 +437,88 @@ public:
 	friend class factory;
 	/// time-stamp of the sample
 	double timestamp{0.0};
+	/// the sequence number assigned by the outlet's send buffer (0 if none)
+	uint64_t seq{0};
+	/// the local time an inlet received the sample (0 unless the inlet tracks latencies)
+	double received{0.0};
 	/// whether the sample shall be buffered or pushed through
 	bool pushthrough{false};
 
 private:
-	/// the channel format
-	const lsl_channel_format_t format_;
-	/// number of channels
-	const uint32_t num_channels_;
+	// the channel format and count are the same for all samples of a factory, so they are
+	// looked up there to keep the header at 48 bytes
 	/// reference count used by sample_p
 	std::atomic<int> refcount_;
 	/// linked list of samples, for use in a freelist
 	std::atomic<sample *> next_;
-	/// the factory used to reclaim this sample, if any
+	/// the factory that created and reclaims this sample
 	factory *factory_;
-	/// the data payload begins here
+	/// the data payload begins here, aligned to the factory's payload alignment
 	alignas(8) char data_{0};
 
 public:
 	// === Construction ===
 
-	/// Destructor for a sample.
+	/// Destructor for a sample. The memory is owned by the factory's slabs.
 	~sample() noexcept;
 
-	/// Delete a sample.
-	void operator delete(void *x) noexcept;
-
 	/// Test for equality with another sample.
 	bool operator==(const sample &rhs) const noexcept;
 	bool operator!=(const sample &rhs) const noexcept { return !(*this == rhs); }
 
-	std::size_t datasize() const { return format_sizes[format_] * static_cast<std::size_t>(num_channels_); }
+	std::size_t datasize() const {
+		return format_sizes[format()] * static_cast<std::size_t>(num_channels());
+	}
 
 	// === type-safe accessors ===
 
 	/// Assign an array of numeric values (with type conversions).
 	template <class T> sample &assign_typed(const T *s) {
-		if ((sizeof(T) == format_sizes[format_]) &&
-			((std::is_integral<T>::value && format_integral[format_]) ||
-				(std::is_floating_point<T>::value && format_float[format_]))) {
+		if ((sizeof(T) == format_sizes[format()]) &&
+			((std::is_integral<T>::value && format_integral[format()]) ||
+				(std::is_floating_point<T>::value && format_float[format()]))) {
 			memcpy(&data_, s, datasize());
 		} else {
-			switch (format_) {
+			switch (format()) {
 			case cft_float32:
-				for (float *p = (float *)&data_, *e = p + num_channels_; p < e; *p++ = (float)*s++)
+				for (float *p = (float *)&data_, *e = p + num_channels(); p < e; *p++ = (float)*s++)
 					;
 				break;
 			case cft_double64:
-				for (double *p = (double *)&data_, *e = p + num_channels_; p < e;
+				for (double *p = (double *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = (double)*s++)
 					;
 				break;
 			case cft_int8:
-				for (int8_t *p = (int8_t *)&data_, *e = p + num_channels_; p < e;
+				for (int8_t *p = (int8_t *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = (int8_t)*s++)
 					;
 				break;
 			case cft_int16:
-				for (int16_t *p = (int16_t *)&data_, *e = p + num_channels_; p < e;
+				for (int16_t *p = (int16_t *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = (int16_t)*s++)
 					;
 				break;
 			case cft_int32:
-				for (int32_t *p = (int32_t *)&data_, *e = p + num_channels_; p < e;
+				for (int32_t *p = (int32_t *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = (int32_t)*s++)
 					;
 				break;
 #ifndef BOOST_NO_INT64_T
 			case cft_int64:
-				for (int64_t *p = (int64_t *)&data_, *e = p + num_channels_; p < e;
+				for (int64_t *p = (int64_t *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = (int64_t)*s++)
 					;
 				break;
 #endif
+			case cft_int24:
+				detail::convert_values((detail::int24 *)&data_, s, num_channels());
+				break;
+			case cft_float16:
+				detail::convert_values((detail::float16 *)&data_, s, num_channels());
+				break;
 			case cft_string:
-				for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e;
+				for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e;
 					 *p++ = to_string(*s++))
 					;
 				break;
@@ -191,40 +530,46 @@ public:
 
 	/// Retrieve an array of numeric values (with type conversions).
 	template <class T> sample &retrieve_typed(T *d) {
-		if ((sizeof(T) == format_sizes[format_]) &&
-			((std::is_integral<T>::value && format_integral[format_]) ||
-				(std::is_floating_point<T>::value && format_float[format_]))) {
+		if ((sizeof(T) == format_sizes[format()]) &&
+			((std::is_integral<T>::value && format_integral[format()]) ||
+				(std::is_floating_point<T>::value && format_float[format()]))) {
 			memcpy(d, &data_, datasize());
 		} else {
-			switch (format_) {
+			switch (format()) {
 			case cft_float32:
-				for (float *p = (float *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (float *p = (float *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 			case cft_double64:
-				for (double *p = (double *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (double *p = (double *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 			case cft_int8:
-				for (int8_t *p = (int8_t *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (int8_t *p = (int8_t *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 			case cft_int16:
-				for (int16_t *p = (int16_t *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (int16_t *p = (int16_t *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 			case cft_int32:
-				for (int32_t *p = (int32_t *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (int32_t *p = (int32_t *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 #ifndef BOOST_NO_INT64_T
 			case cft_int64:
-				for (int64_t *p = (int64_t *)&data_, *e = p + num_channels_; p < e; *d++ = (T)*p++)
+				for (int64_t *p = (int64_t *)&data_, *e = p + num_channels(); p < e; *d++ = (T)*p++)
 					;
 				break;
 #endif
+			case cft_int24:
+				detail::convert_values(d, (const detail::int24 *)&data_, num_channels());
+				break;
+			case cft_float16:
+				detail::convert_values(d, (const detail::float16 *)&data_, num_channels());
+				break;
 			case cft_string:
-				for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e;
+				for (std::string *p = (std::string *)&data_, *e = p + num_channels(); p < e;
 					 *d++ = from_string<T>(*p++))
 					;
 				break;
@@ -234,17 +579,139 @@ public:
 		return *this;
 	}
 
+	/// Assign an array of values to the sample with a preselected conversion kernel.
+	template <class T>
+	sample &assign_typed(const T *s, typename typed_kernels<T>::assign_fn kernel) {
+		kernel(&data_, s, num_channels());
+		return *this;
+	}
+
+	/// Retrieve an array of values with a preselected conversion kernel.
+	template <class T> sample &retrieve_typed(T *d, typename typed_kernels<T>::retrieve_fn kernel) {
+		kernel(d, &data_, num_channels());
+		return *this;
+	}
+
+	/// Retrieve an array of calibrated values with a preselected kernel (see scaled_kernel).
+	template <class T>
+	sample &retrieve_scaled(T *d, typename scaled_kernel<T>::retrieve_fn kernel, const T *gains,
+		const T *offsets) {
+		kernel(d, &data_, num_channels(), gains, offsets);
+		return *this;
+	}
+
+	/**
+	 * Assign the values of a sparse numeric sample: the channels at the given indices (in any
+	 * order) get the values, converted with a preselected kernel, and all others are zero.
+	 * @throws std::range_error if an index isn't a channel of the sample.
+	 */
+	template <class T>
+	sample &assign_sparse(const uint32_t *indices, const T *values, std::size_t count,
+		typename typed_kernels<T>::assign_fn kernel) {
+		if (format() == cft_string)
+			throw std::invalid_argument("Only numeric samples can be sparse.");
+		const std::size_t value_size = format_sizes[format()];
+		for (std::size_t k = 0; k < count; ++k)
+			if (indices[k] >= num_channels())
+				throw std::range_error("A channel index of a sparse sample is out of range.");
+		memset(&data_, 0, datasize());
+		for (std::size_t k = 0; k < count; ++k)
+			kernel(&data_ + indices[k] * value_size, values + k, 1);
+		return *this;
+	}
+
+	/**
+	 * Retrieve the nonzero channels of a numeric sample as index/value pairs in channel order,
+	 * with a preselected conversion kernel.
+	 * @return The number of nonzero channels; only the first max_count are retrieved.
+	 */
+	template <class T>
+	std::size_t retrieve_sparse(uint32_t *indices, T *values, std::size_t max_count,
+		typename typed_kernels<T>::retrieve_fn kernel) const {
+		if (format() == cft_string)
+			throw std::invalid_argument("Only numeric samples can be sparse.");
+		const std::size_t value_size = format_sizes[format()];
+		std::size_t count = 0;
+		for (uint32_t c = 0; c < num_channels(); ++c) {
+			const char *value = &data_ + c * value_size;
+			if (is_zero(value)) continue;
+			if (count < max_count) {
+				indices[count] = c;
+				kernel(values + count, value, 1);
+			}
+			++count;
+		}
+		return count;
+	}
+
+	/**
+	 * Assign the values of a strided array of a numeric type with a preselected conversion kernel.
+	 *
+	 * The value of channel c is read from `s + c * stride` (in bytes), which doesn't need to be
+	 * aligned. Unless the values are contiguous and aligned, they are gathered into `scratch`
+	 * (room for num_channels() values) first.
+	 */
+	template <class T>
+	sample &assign_strided(const char *s, std::ptrdiff_t stride, T *scratch,
+		typename typed_kernels<T>::assign_fn kernel) {
+		if (stride == static_cast<std::ptrdiff_t>(sizeof(T)) &&
+			reinterpret_cast<std::uintptr_t>(s) % alignof(T) == 0)
+			return assign_typed(reinterpret_cast<const T *>(s), kernel);
+		for (uint32_t c = 0, n = num_channels(); c < n; ++c)
+			memcpy(scratch + c, s + c * stride, sizeof(T));
+		return assign_typed(scratch, kernel);
+	}
+
+	/// Retrieve the values into a strided array, the counterpart of assign_strided().
+	template <class T>
+	sample &retrieve_strided(char *d, std::ptrdiff_t stride, T *scratch,
+		typename typed_kernels<T>::retrieve_fn kernel) {
+		if (stride == static_cast<std::ptrdiff_t>(sizeof(T)) &&
+			reinterpret_cast<std::uintptr_t>(d) % alignof(T) == 0)
+			return retrieve_typed(reinterpret_cast<T *>(d), kernel);
+		retrieve_typed(scratch, kernel);
+		for (uint32_t c = 0, n = num_channels(); c < n; ++c)
+			memcpy(d + c * stride, scratch + c, sizeof(T));
+		return *this;
+	}
+
 	/// Assign an array of string values to the sample.
 	sample &assign_typed(const std::string *s);
 
 	/// Retrieve an array of string values from the sample.
 	sample &retrieve_typed(std::string *d);
 
+	/**
+	 * Move an array of string values into the sample.
+	 *
+	 * The strings of a string-formatted sample are swapped with the values, so their contents
+	 * aren't copied and the values are left holding the sample's previous strings (so callers can
+	 * reuse their capacity). Other formats convert the values as assign_typed() does.
+	 */
+	sample &assign_moved(std::string *s);
+
+	/**
+	 * Assign the channels of a string-formatted sample from character buffers.
+	 *
+	 * The bytes are copied straight into the channel strings, which keep their capacity while
+	 * the sample is recycled by its factory, so no memory is allocated once a sample has held
+	 * strings of similar lengths.
+	 * @param lengths The length of each buffer, or nullptr if they are zero-terminated.
+	 */
+	sample &assign_buffers(const char *const *data, const uint32_t *lengths);
+
+	/**
+	 * Assign a subset of another sample's channels (of the same format) to this sample.
+	 * @param src The sample to copy the channel values from.
+	 * @param channels The indices of the channels in src, one for each channel of this sample.
+	 */
+	sample &assign_channels(const sample &src, const uint32_t *channels);
+
 	// === untyped accessors ===
 
 	/// Assign numeric data to the sample.
 	sample &assign_untyped(const void *newdata) {
-		if (format_ != cft_string)
+		if (format() != cft_string)
 			memcpy(&data_, newdata, datasize());
 		else
 			throw std::invalid_argument("Cannot assign untyped data to a string-formatted sample.");
@@ -253,7 +720,7 @@ public:
 
 	/// Retrieve numeric data from the sample.
 	sample &retrieve_untyped(void *newdata) {
-		if (format_ != cft_string)
+		if (format() != cft_string)
 			memcpy(newdata, &data_, datasize());
 		else
 			throw std::invalid_argument(
@@ -263,9 +730,60 @@ public:
 
 	// === serialization functions ===
 
-	/// Serialize a sample to a stream buffer (protocol 1.10).
+	/**
+	 * Serialize a sample to a stream buffer (protocol 1.10).
+	 * @param deduced Whether the time stamp is sent as deduced instead of the sample's (see
+	 * timestamp_deduction), here and in the other serialization functions.
+	 */
 	void save_streambuf(std::streambuf &sb, int protocol_version, int use_byte_order,
-		void *scratchpad = nullptr) const;
+		void *scratchpad = nullptr, bool deduced = false) const;
+
+	/// Serialize only the sample header (tag and timestamp) to a stream buffer (protocol 1.10).
+	void save_streambuf_header(std::streambuf &sb, int use_byte_order, bool deduced = false) const;
+
+	/// Serialize only the channel values of a numeric sample, e.g. into a frame (see
+	/// frame_flags).
+	void save_streambuf_values(std::streambuf &sb, int use_byte_order, void *scratchpad) const;
+
+	/**
+	 * Serialize the channel values of a numeric sample into a frame with the changed-channels
+	 * encoding (see frame_changed_channels): a bitmask or index list (whichever is smaller) of the
+	 * channels whose values differ from the previously sent sample's, followed by only these
+	 * values.
+	 * @param prev The channel data of the previously sent sample (datasize() bytes, initially 0).
+	 * It's updated to hold this sample's data.
+	 */
+	void save_streambuf_changed(std::streambuf &sb, int use_byte_order, void *prev) const;
+
+	/// Replace the subnormal values in an array of float32 or double64 values by (signed) zeros.
+	static void suppress_subnormals(void *data, lsl_channel_format_t fmt, std::size_t count);
+
+	/**
+	 * Serialize a numeric sample with delta value encoding (protocol 1.10).
+	 *
+	 * Each channel value is sent as a variable-length integer that holds the difference (integer
+	 * formats) or the XOR of the bit patterns (floating point formats) to the previous value.
+	 * @param prev The channel data of the previously sent sample (datasize() bytes, initially 0).
+	 * It's updated to hold this sample's data.
+	 */
+	void save_streambuf_delta(
+		std::streambuf &sb, int use_byte_order, void *prev, bool deduced = false) const;
+
+	/// Deserialize a numeric sample with delta value encoding (see save_streambuf_delta()).
+	void load_streambuf_delta(
+		std::streambuf &sb, int use_byte_order, bool suppress_subnormals, void *prev);
+
+	/// Pointer to the raw (native byte order) channel data of a numeric sample.
+	const char *raw_data() const { return &data_; }
+
+	/// The channel strings of a string-formatted sample.
+	const std::string *string_data() const { return reinterpret_cast<const std::string *>(&data_); }
+
+	/// The channel format of the sample.
+	lsl_channel_format_t format() const { return factory_->fmt_; }
+
+	/// The number of channels of the sample.
+	uint32_t num_channels() const { return factory_->num_chans_; }
 
 	/// Deserialize a sample from a stream buffer (protocol 1.10).
 	void load_streambuf(
@@ -273,54 +791,71 @@ public:
 
 	/// Convert the endianness of channel data in-place.
 	void convert_endian(void *data) const {
-		switch (format_sizes[format_]) {
-		case 1: break;
-		case sizeof(int16_t):
-			for (int16_t *p = (int16_t *)data, *e = p + num_channels_; p < e;
-				 endian_reverse_inplace(*p++))
-				;
-			break;
-		case sizeof(int32_t):
-			for (int32_t *p = (int32_t *)data, *e = p + num_channels_; p < e;
-				 endian_reverse_inplace(*p++))
-				;
-			break;
-#ifndef BOOST_NO_INT64_T
-		case sizeof(int64_t):
-			for (int64_t *p = (int64_t *)data, *e = p + num_channels_; p < e;
-				 endian_reverse_inplace(*p++))
-				;
-			break;
-#else
-		case sizeof(double):
-			for (double *p = (double *)data, *e = p + num_channels_; p < e;
-				 endian_reverse_inplace(*p++))
-				;
-			break;
-#endif
-		default: throw std::runtime_error("Unsupported channel format for endian conversion.");
-		}
+		endian_reverse_inplace_n(data, format_sizes[format()], num_channels());
 	}
+#ifndef LSL_NO_PROTOCOL_100
 	/// Serialize a sample into a portable archive (protocol 1.00).
 	void save(eos::portable_oarchive &ar, const uint32_t archive_version) const;
 
 	/// Deserialize a sample from a portable archive (protocol 1.00).
 	void load(eos::portable_iarchive &ar, const uint32_t archive_version);
+#endif
+
+	/**
+	 * Serialize a sample in the protocol 1.00 format without going through the archive.
+	 *
+	 * The output is byte-identical to what save() writes into a portable archive after the first
+	 * sample (the archive writes a class header before that one), so the archive is only needed
+	 * for the connection header and the test patterns.
+	 */
+	void save_portable(std::streambuf &sb, bool deduced = false) const;
 
+	/// Deserialize a sample written by save_portable() or by save() after the first sample.
+	void load_portable(std::streambuf &sb);
+
+#ifndef LSL_NO_PROTOCOL_100
 	/// Serialize (read/write) the channel data.
 	template <class Archive> void serialize_channels(Archive &ar, const uint32_t archive_version);
 
 	BOOST_SERIALIZATION_SPLIT_MEMBER()
+#endif
 
 	/// Assign a test pattern to the sample (for protocol validation)
 	sample &assign_test_pattern(int offset = 1);
 
+	/**
+	 * Add n references at once, e.g. for the consumer queues a sample is pushed to.
+	 *
+	 * Each one has to be adopted by a sample_p (constructed with add_ref = false), so a sample
+	 * that's fanned out to many queues costs a single atomic increment instead of one per queue.
+	 */
+	void add_refs(int n) { refcount_.fetch_add(n, std::memory_order_relaxed); }
+
 private:
+	/// Replace subnormal floating point values in the channel data by (signed) zeros.
+	void suppress_subnormal_values();
+
+	/// Whether a numeric channel value is zero (so -0.0 is, too).
+	bool is_zero(const char *value) const {
+		static const char zero[sizeof(double)] = {0};
+		if (format() == cft_float32) {
+			float v;
+			memcpy(&v, value, sizeof(v));
+			return v == 0.f;
+		}
+		if (format() == cft_double64) {
+			double v;
+			memcpy(&v, value, sizeof(v));
+			return v == 0.0;
+		}
+		return !memcmp(value, zero, format_sizes[format()]);
+	}
+
 	/// Construct a new sample for a given channel format/count combination.
 	sample(lsl_channel_format_t fmt, uint32_t num_channels, factory *fact)
-		: format_(fmt), num_channels_(num_channels), refcount_(0), next_(nullptr), factory_(fact) {
-		if (format_ == cft_string)
-			for (std::string *p = (std::string *)&data_, *e = p + num_channels_; p < e;
+		: refcount_(0), next_(nullptr), factory_(fact) {
+		if (fmt == cft_string)
+			for (std::string *p = (std::string *)&data_, *e = p + num_channels; p < e;
 				 new (p++) std::string())
 				;
 	}
@@ -0,0 +1,265 @@
+#include "sample_frame.h"
+#include "sample.h"
+#include <boost/endian/conversion.hpp>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace lsl;
+
+template <typename T> static void put(std::vector<char> &out, const T &value) {
+	const char *bytes = reinterpret_cast<const char *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/// Append a LEB128 varint.
+static void put_varint(std::vector<char> &out, uint64_t value) {
+	for (; value >= 0x80; value >>= 7) out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+	out.push_back(static_cast<char>(value));
+}
+
+/// Read a LEB128 varint.
+static uint64_t get_varint(const char *&pos, const char *end) {
+	uint64_t value = 0;
+	for (int shift = 0; pos != end && shift < 64; shift += 7) {
+		const auto byte = static_cast<uint8_t>(*pos++);
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return value;
+	}
+	throw std::runtime_error("Received a malformed sample frame.");
+}
+
+static uint64_t zigzag(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * Decode the values of a frame with the changed-channels encoding (see frame_changed_channels).
+ * @param prev The previous sample's values, updated to the last sample's.
+ * @param out Receives the values of all samples, back to back in the feed's byte order.
+ * @return The size of the encoded values at the start of the body.
+ */
+static uint64_t decode_changed(const char *body, uint32_t bytes, uint32_t count,
+	std::size_t value_size, uint32_t num_channels, char *prev, char *out) {
+	const std::size_t mask_bytes = (num_channels + 7) / 8, sample_bytes = value_size * num_channels;
+	const char *pos = body, *end = body + bytes;
+	std::vector<uint32_t> changed;
+	changed.reserve(num_channels);
+	for (uint32_t k = 0; k < count; ++k) {
+		// the changed channels, as a mask (0) or the number of indices + 1 and their gaps
+		changed.clear();
+		const uint64_t num_indices = get_varint(pos, end);
+		if (!num_indices) {
+			if (static_cast<std::size_t>(end - pos) < mask_bytes)
+				throw std::runtime_error("Received a malformed sample frame.");
+			const auto *mask = reinterpret_cast<const uint8_t *>(pos);
+			pos += mask_bytes;
+			for (uint32_t c = 0; c < num_channels; ++c)
+				if (mask[c / 8] & (1 << (c % 8))) changed.push_back(c);
+		} else {
+			if (num_indices - 1 > num_channels)
+				throw std::runtime_error("Received a malformed sample frame.");
+			for (uint64_t i = 1, next = 0; i < num_indices; ++i) {
+				next += get_varint(pos, end);
+				if (next >= num_channels)
+					throw std::runtime_error("Received a malformed sample frame.");
+				changed.push_back(static_cast<uint32_t>(next++));
+			}
+		}
+		if (static_cast<std::size_t>(end - pos) < changed.size() * value_size)
+			throw std::runtime_error("Received a malformed sample frame.");
+		for (uint32_t c : changed) {
+			memcpy(prev + c * value_size, pos, value_size);
+			pos += value_size;
+		}
+		memcpy(out + k * sample_bytes, prev, sample_bytes);
+	}
+	return static_cast<uint64_t>(pos - body);
+}
+
+void frame_builder::finish(std::size_t value_bytes, int use_byte_order, timestamp_deltas *deltas,
+	bool changed_channels) {
+	trailer_.clear();
+	uint8_t flags = changed_channels ? frame_changed_channels : 0;
+	// the deltas need a previous sample to resolve deduced time stamps at the start of the frame
+	const bool encode_deltas = deltas && explicit_timestamps_ && deltas->has_last;
+	if (deltas) {
+		const double interval = deltas->srate != IRREGULAR_RATE ? 1.0 / deltas->srate : 0.0;
+		double last = deltas->last_timestamp;
+		for (double &timestamp : timestamps_) {
+			const double resolved = timestamp == DEDUCED_TIMESTAMP ? last + interval : timestamp;
+			if (encode_deltas) timestamp = resolved;
+			last = resolved;
+		}
+		deltas->last_timestamp = last;
+		deltas->has_last = deltas->has_last || explicit_timestamps_;
+	}
+	if (encode_deltas) {
+		flags |= frame_timestamp_deltas;
+		double first = timestamps_.front();
+		if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(first);
+		put(trailer_, first);
+		const int64_t period =
+			deltas->srate != IRREGULAR_RATE ? std::llround(1e9 / deltas->srate) : 0;
+		put_varint(trailer_, static_cast<uint64_t>(period));
+		int64_t prev = 0;
+		for (std::size_t k = 1; k < timestamps_.size(); ++k) {
+			const int64_t offset = std::llround((timestamps_[k] - timestamps_.front()) * 1e9);
+			put_varint(trailer_, zigzag(offset - prev - period));
+			prev = offset;
+		}
+	} else if (explicit_timestamps_) {
+		flags |= frame_timestamps;
+		for (double timestamp : timestamps_) {
+			if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(timestamp);
+			put(trailer_, timestamp);
+		}
+	}
+	// the sequence numbers are sent for all samples or none
+	if (!seqs_.empty()) {
+		flags |= frame_sequence_numbers;
+		for (uint64_t seq : seqs_) put(trailer_, lslboost::endian::native_to_little(seq));
+	}
+	const uint32_t count = lslboost::endian::native_to_little(static_cast<uint32_t>(size())),
+				   bytes = lslboost::endian::native_to_little(
+					   static_cast<uint32_t>(value_bytes + trailer_.size()));
+	memcpy(header_, &count, sizeof(count));
+	memcpy(header_ + sizeof(count), &bytes, sizeof(bytes));
+	header_[2 * sizeof(uint32_t)] = static_cast<char>(flags);
+}
+
+std::string lsl::control_frame(control_message type, const std::string &message) {
+	const uint32_t count = 0,
+				   bytes = lslboost::endian::native_to_little(
+					   static_cast<uint32_t>(message.size() + 1));
+	std::string frame(frame_header_bytes, '\0');
+	memcpy(&frame[0], &count, sizeof(count));
+	memcpy(&frame[sizeof(count)], &bytes, sizeof(bytes));
+	frame[2 * sizeof(uint32_t)] = static_cast<char>(frame_control);
+	frame += static_cast<char>(type);
+	return frame += message;
+}
+
+uint8_t lsl::read_frame_view(std::streambuf &sb, lsl_channel_format_t fmt, uint32_t num_channels,
+	int use_byte_order, bool suppress_subnormals, std::vector<char> &body, frame_view &out,
+	void *prev) {
+	char header[frame_header_bytes];
+	if (sb.sgetn(header, sizeof(header)) != static_cast<std::streamsize>(sizeof(header)))
+		throw std::runtime_error("Input stream error.");
+	uint32_t count, bytes;
+	memcpy(&count, header, sizeof(count));
+	memcpy(&bytes, header + sizeof(count), sizeof(bytes));
+	lslboost::endian::little_to_native_inplace(count);
+	lslboost::endian::little_to_native_inplace(bytes);
+	const auto flags = static_cast<uint8_t>(header[2 * sizeof(uint32_t)]);
+	out.count = 0;
+	out.values = nullptr;
+	out.value_bytes = 0;
+	out.timestamps.clear();
+	out.seqs.clear();
+	if (flags & frame_control) {
+		// the message type and the message, the next sample frame continues the samples
+		if (count || !bytes || bytes > max_frame_bytes)
+			throw std::runtime_error("Received a malformed control frame.");
+		body.resize(bytes);
+		if (sb.sgetn(body.data(), bytes) != static_cast<std::streamsize>(bytes))
+			throw std::runtime_error("Input stream error.");
+		const auto type = static_cast<uint8_t>(body[0]);
+		if (!type) throw std::runtime_error("Received a malformed control frame.");
+		body.erase(body.begin());
+		return type;
+	}
+	const std::size_t value_size = format_sizes[fmt], sample_bytes = value_size * num_channels;
+	const bool changed = (flags & frame_changed_channels) != 0;
+	const uint64_t decoded_bytes = static_cast<uint64_t>(count) * sample_bytes;
+	if (bytes > max_frame_bytes || (changed && (!prev || decoded_bytes > max_frame_bytes)))
+		throw std::runtime_error("Received a malformed sample frame.");
+	// the changed values are decoded behind the body
+	body.resize(bytes + (changed ? decoded_bytes : 0));
+	if (bytes && sb.sgetn(body.data(), bytes) != static_cast<std::streamsize>(bytes))
+		throw std::runtime_error("Input stream error.");
+	char *values = body.data();
+	uint64_t value_bytes = decoded_bytes;
+	if (changed) {
+		value_bytes = decode_changed(body.data(), bytes, count, value_size, num_channels,
+			static_cast<char *>(prev), body.data() + bytes);
+		values = body.data() + bytes;
+	}
+	// the sizes of the other parts of the body, the delta encoded time stamps take the rest
+	const uint64_t seq_bytes = flags & frame_sequence_numbers ? count * sizeof(uint64_t) : 0;
+	uint64_t timestamp_bytes = flags & frame_timestamps ? count * sizeof(double) : 0;
+	if ((flags & frame_timestamp_deltas) && bytes >= value_bytes + seq_bytes)
+		timestamp_bytes = bytes - value_bytes - seq_bytes;
+	if (bytes != value_bytes + timestamp_bytes + seq_bytes ||
+		((flags & frame_timestamp_deltas) &&
+			((flags & frame_timestamps) || !count || timestamp_bytes < sizeof(double))))
+		throw std::runtime_error("Received a malformed sample frame.");
+
+	// convert the values (and time stamps) of all samples at once
+	const std::size_t num_values = static_cast<std::size_t>(count) * num_channels;
+	if (use_byte_order != BOOST_BYTE_ORDER && value_size > 1)
+		endian_reverse_inplace_n(values, value_size, num_values);
+	if (suppress_subnormals) sample::suppress_subnormals(values, fmt, num_values);
+	char *timestamps = body.data() + value_bytes;
+	if ((flags & frame_timestamps) && use_byte_order != BOOST_BYTE_ORDER)
+		endian_reverse_inplace_n(timestamps, sizeof(double), count);
+	const char *seqs = timestamps + timestamp_bytes;
+	// the delta encoding: the first time stamp, the predicted interval and the deviations from it
+	double first = 0.0;
+	int64_t period = 0, offset = 0;
+	const char *delta = timestamps + sizeof(double);
+	if (flags & frame_timestamp_deltas) {
+		memcpy(&first, timestamps, sizeof(first));
+		if (use_byte_order != BOOST_BYTE_ORDER) endian_reverse_inplace(first);
+		period = static_cast<int64_t>(get_varint(delta, seqs));
+	}
+
+	// (the time stamps and sequence numbers aren't necessarily aligned in the body)
+	out.timestamps.resize(count, DEDUCED_TIMESTAMP);
+	if (flags & frame_timestamps)
+		memcpy(out.timestamps.data(), timestamps, count * sizeof(double));
+	if (flags & frame_timestamp_deltas) {
+		for (uint32_t k = 0; k < count; ++k) {
+			if (k) offset += period + unzigzag(get_varint(delta, seqs));
+			out.timestamps[k] = first + static_cast<double>(offset) * 1e-9;
+		}
+		if (delta != seqs) throw std::runtime_error("Received a malformed sample frame.");
+	}
+	out.seqs.resize(count, 0);
+	if (flags & frame_sequence_numbers) {
+		memcpy(out.seqs.data(), seqs, count * sizeof(uint64_t));
+		for (auto &seq : out.seqs) lslboost::endian::little_to_native_inplace(seq);
+	}
+	out.count = count;
+	out.values = values;
+	out.value_bytes = value_bytes;
+	return 0;
+}
+
+uint8_t lsl::read_frame(std::streambuf &sb, factory &fac, lsl_channel_format_t fmt,
+	uint32_t num_channels, int use_byte_order, bool suppress_subnormals, std::vector<char> &body,
+	std::vector<sample_p> &out, void *prev) {
+	thread_local frame_view frame;
+	const uint8_t control =
+		read_frame_view(sb, fmt, num_channels, use_byte_order, suppress_subnormals, body, frame,
+			prev);
+	if (control) return control;
+	append_frame_samples(frame, fac, fmt, num_channels, out);
+	return 0;
+}
+
+void lsl::append_frame_samples(const frame_view &frame, factory &fac, lsl_channel_format_t fmt,
+	uint32_t num_channels, std::vector<sample_p> &out) {
+	const std::size_t sample_bytes = format_sizes[fmt] * num_channels;
+	out.reserve(out.size() + frame.count);
+	for (uint32_t k = 0; k < frame.count; ++k) {
+		sample_p samp(fac.new_sample(frame.timestamps[k], false));
+		samp->assign_untyped(frame.values + k * sample_bytes);
+		samp->seq = frame.seqs[k];
+		out.push_back(std::move(samp));
+	}
+}
@@ -0,0 +1,195 @@
+#ifndef SAMPLE_FRAME_H
+#define SAMPLE_FRAME_H
+
+#include "common.h"
+#include "forward.h"
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * The flags in the header of a sample frame.
+ *
+ * With the "Sample-Framing: chunks" feed option (protocol 1.10, numeric formats only), each chunk
+ * is sent as a frame instead of a sequence of tagged samples: a header with the number of
+ * samples (uint32), the size of the body (uint32) and these flags (uint8), all little endian,
+ * followed by the body. The body holds the channel values of all samples back to back (in the
+ * negotiated byte order), then the time stamps as doubles (in the same byte order,
+ * DEDUCED_TIMESTAMP for deduced ones) unless all of them are deduced, then the sequence numbers
+ * (little endian uint64) if they are sent. So the receiver reads a frame with two calls and
+ * converts the values of all its samples at once.
+ *
+ * With the "Timestamp-Encoding: ns-delta" feed option, the time stamps are sent as the first one
+ * (a double), the predicted interval in nanoseconds (the nominal sampling period, 0 for irregular
+ * streams) and, for each further sample, the deviation of its interval from the predicted one in
+ * nanoseconds, all as zigzag LEB128 varints. So regular streams need about one byte per sample
+ * and the receiver gets explicit time stamps, rounded to the nanosecond.
+ *
+ * With the "Value-Encoding: changed-channels" feed option, the values of each sample are sent as
+ * the channels whose values changed since the previous sample of the feed, followed by only these
+ * values, so channels that rarely change (e.g. trigger or status channels) take one bit per
+ * sample. The channels are given by a LEB128 varint: 0 for a bitmask (channel k in bit k % 8 of
+ * byte k / 8), otherwise the number of changed channels + 1, followed by their indices as varint
+ * gaps (the number of unchanged channels since the previous changed one), whichever is smaller.
+ * So sparse samples of streams with many channels (e.g. event streams where only a few channels
+ * are nonzero) only take a few bytes.
+ *
+ * With the "Metadata-Updates: 1" feed option, the outlet sends control frames in between the
+ * sample frames: their sample count is 0 and their body is the message type (uint8, see
+ * control_message) followed by the message.
+ *
+ * With the "End-Of-Stream: 1" feed option, the outlet sends a control frame before it closes the
+ * connection because it's being destroyed, so the inlet can start recovering the stream right
+ * away. With the "Heartbeat-Interval: <seconds>" feed option, it also sends a control frame at
+ * this interval (the one it agreed to is in the response), so an inlet notices a broken
+ * connection within a few intervals even if the stream is idle.
+ */
+enum frame_flags : uint8_t {
+	/// the body holds the samples' time stamps; otherwise, all of them are deduced
+	frame_timestamps = 1,
+	/// the body holds the samples' sequence numbers
+	frame_sequence_numbers = 2,
+	/// the body holds the samples' time stamps as nanosecond deltas
+	frame_timestamp_deltas = 4,
+	/// the body holds only the changed values of each sample, after a bitmask of the channels
+	frame_changed_channels = 8,
+	/// the frame holds a control message instead of samples
+	frame_control = 16,
+};
+
+/// The types of the control messages in control frames (see frame_control).
+enum control_message : uint8_t {
+	/// a patch of the stream info's description, see stream_info_impl::desc_patch()
+	control_metadata_patch = 1,
+	/// the outlet ends the stream, the connection is closed after this (no message)
+	control_end_of_stream = 2,
+	/// the connection is alive, sent every heartbeat interval (no message)
+	control_heartbeat = 3,
+};
+
+/// An inlet that hasn't received anything for this many heartbeat intervals treats its
+/// connection as broken.
+const int heartbeat_misses = 3;
+
+/// the shortest heartbeat interval (in seconds) an outlet agrees to
+const double min_heartbeat_interval = 0.05;
+
+/// the size of a frame header
+const std::size_t frame_header_bytes = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+
+/// the largest frame body a receiver accepts
+const uint32_t max_frame_bytes = 256u << 20;
+
+/// The state of a feed's time stamp delta encoding (see frame_timestamp_deltas).
+struct timestamp_deltas {
+	/// the nominal sampling rate, to predict the intervals and to deduce time stamps
+	double srate;
+	/// the time stamp of the previous sample, once there is one
+	double last_timestamp{0.0};
+	bool has_last{false};
+};
+
+/**
+ * Collects the time stamps and sequence numbers of a frame's samples while their values are
+ * serialized (or referenced, see client_session::zerocopy_), and builds the frame's header and
+ * the part of the body after the values once the frame is complete.
+ */
+class frame_builder {
+public:
+	/// Add a sample's time stamp and its sequence number (0 if they aren't sent).
+	void add(double timestamp, uint64_t seq) {
+		timestamps_.push_back(timestamp);
+		if (seq) seqs_.push_back(seq);
+		if (timestamp != DEDUCED_TIMESTAMP) explicit_timestamps_ = true;
+	}
+
+	/// The number of samples in the frame.
+	std::size_t size() const { return timestamps_.size(); }
+
+	/**
+	 * Build the header and the trailer (the time stamps and sequence numbers).
+	 * @param value_bytes The size of the values of all samples.
+	 * @param use_byte_order The byte order of the time stamps.
+	 * @param deltas The feed's delta encoding state if the time stamps are sent as deltas. The
+	 * deduced time stamps are resolved (as the receiver would) unless all of them are deduced.
+	 * @param changed_channels Whether the values were written by sample::save_streambuf_changed().
+	 */
+	void finish(std::size_t value_bytes, int use_byte_order, timestamp_deltas *deltas = nullptr,
+		bool changed_channels = false);
+
+	/// The frame header, valid after finish().
+	const char *header() const { return header_; }
+
+	/// The end of the frame body, valid after finish().
+	const std::vector<char> &trailer() const { return trailer_; }
+
+	/// Start a new frame.
+	void clear() {
+		timestamps_.clear();
+		seqs_.clear();
+		trailer_.clear();
+		explicit_timestamps_ = false;
+	}
+
+private:
+	std::vector<double> timestamps_;
+	std::vector<uint64_t> seqs_;
+	/// whether any time stamp isn't deduced
+	bool explicit_timestamps_{false};
+	char header_[frame_header_bytes];
+	std::vector<char> trailer_;
+};
+
+/// Build a control frame (see frame_control) with a message of the given type.
+std::string control_frame(control_message type, const std::string &message);
+
+/// The samples of a frame as read by read_frame_view().
+struct frame_view {
+	/// the number of samples
+	uint32_t count{0};
+	/// the channel values of all samples back to back in the machine's byte order, pointing into
+	/// the frame body
+	char *values{nullptr};
+	/// the size of the values
+	uint64_t value_bytes{0};
+	/// the samples' time stamps, DEDUCED_TIMESTAMP for deduced ones
+	std::vector<double> timestamps;
+	/// the samples' sequence numbers, 0 if they aren't sent
+	std::vector<uint64_t> seqs;
+};
+
+/**
+ * Read a frame without allocating samples for it, so its values can be passed on as a block.
+ *
+ * The parameters and the return value are the same as read_frame()'s. The view is valid until the
+ * body is modified.
+ */
+uint8_t read_frame_view(std::streambuf &sb, lsl_channel_format_t fmt, uint32_t num_channels,
+	int use_byte_order, bool suppress_subnormals, std::vector<char> &body, frame_view &out,
+	void *prev = nullptr);
+
+/**
+ * Read a frame and append its samples to a vector.
+ * @param fac The factory to allocate the samples from, for the given format and channel count.
+ * @param body A buffer for the frame body, reused across calls.
+ * @param prev For the changed-channels encoding, the feed's previously received channel values
+ * (in the feed's byte order, initially 0), which are updated; nullptr if it wasn't negotiated.
+ * @return The type of the message if the frame is a control frame (the message is left in body),
+ * otherwise 0.
+ * @throws std::runtime_error if the stream ended or the frame is malformed.
+ */
+uint8_t read_frame(std::streambuf &sb, factory &fac, lsl_channel_format_t fmt,
+	uint32_t num_channels, int use_byte_order, bool suppress_subnormals, std::vector<char> &body,
+	std::vector<sample_p> &out, void *prev = nullptr);
+
+/// Allocate the samples of a frame read by read_frame_view() and append them to a vector.
+void append_frame_samples(const frame_view &frame, factory &fac, lsl_channel_format_t fmt,
+	uint32_t num_channels, std::vector<sample_p> &out);
+
+} // namespace lsl
+
+#endif
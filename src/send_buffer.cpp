@@ -1,13 +1,76 @@
 #include "send_buffer.h"
+#include "api_config.h"
 #include "consumer_queue.h"
+#include "sample.h"
+#include "tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <loguru.hpp>
 #include <memory>
 
 using namespace lsl;
 
-std::shared_ptr<consumer_queue> send_buffer::new_consumer(int max_buffered) {
+/// the memory reserved by the consumer queues of all send buffers in the process
+static std::atomic<std::size_t> global_reserved_bytes{0};
+
+std::shared_ptr<consumer_queue> send_buffer::new_consumer(int max_buffered, uint64_t replay_from,
+	double replay_seconds, lsl_transfer_priority_t priority) {
+	if (!replay_from && replay_seconds > 0.0) {
+		// samples pushed after this are queued for the consumer anyway
+		const double since = lsl_clock() - replay_seconds;
+		std::lock_guard<std::mutex> lock(push_mut_);
+		auto it = std::find_if(history_.begin(), history_.end(),
+			[since](const history_entry &e) { return e.pushed >= since; });
+		replay_from = it != history_.end() ? it->sample->seq : next_seq_;
+	}
 	max_buffered = max_buffered ? std::min(max_buffered, max_capacity_) : max_capacity_;
-	return std::make_shared<consumer_queue>(max_buffered, shared_from_this());
+	const std::size_t capacity = reserve_capacity(static_cast<std::size_t>(max_buffered));
+	try {
+		std::unique_ptr<spill_file> spill;
+		if (spill_factory_) {
+			const std::string prefix = spill_directory_ + "/lsl_spill_" + trace_uid_ + '_' +
+									   std::to_string(++spill_files_);
+			spill.reset(new spill_file(spill_factory_, prefix, spill_max_bytes_));
+		}
+		return std::make_shared<consumer_queue>(
+			capacity, shared_from_this(), replay_from, std::move(spill), priority,
+			preallocate_queues_);
+	} catch (...) {
+		std::lock_guard<named_mutex> lock(consumers_mut_);
+		release_capacity(capacity);
+		throw;
+	}
+}
+
+std::size_t send_buffer::reserve_capacity(std::size_t max_buffered) {
+	std::size_t capacity = std::max<std::size_t>(max_buffered, consumer_queue::min_capacity);
+	if (!sample_bytes_) return capacity;
+	std::lock_guard<named_mutex> lock(consumers_mut_);
+	if (max_bytes_)
+		capacity = std::min(capacity,
+			(max_bytes_ - std::min(reserved_bytes_, max_bytes_)) / sample_bytes_);
+	const std::size_t global_max = api_config::get_instance()->outlet_buffers_total_max_bytes();
+	std::size_t reserved = global_reserved_bytes.load(), wanted;
+	do {
+		wanted = capacity;
+		if (global_max)
+			wanted = std::min(
+				wanted, (global_max - std::min(reserved, global_max)) / sample_bytes_);
+		wanted = std::max<std::size_t>(wanted, consumer_queue::min_capacity);
+	} while (!global_reserved_bytes.compare_exchange_weak(
+		reserved, reserved + wanted * sample_bytes_));
+	if (wanted < max_buffered)
+		LOG_F(WARNING, "Memory budget exhausted, buffering only %zu instead of %zu samples", wanted,
+			max_buffered);
+	reserved_bytes_ += wanted * sample_bytes_;
+	return wanted;
+}
+
+void send_buffer::release_capacity(std::size_t capacity) {
+	if (!sample_bytes_) return;
+	reserved_bytes_ -= capacity * sample_bytes_;
+	global_reserved_bytes -= capacity * sample_bytes_;
 }
 
 
@@ -16,44 +79,248 @@ std::shared_ptr<consumer_queue> send_buffer::new_consumer(int max_buffered) {
  * Will subsequently be seen by all consumers.
  */
 void send_buffer::push_sample(const sample_p &s) {
-	std::lock_guard<std::mutex> lock(consumers_mut_);
-	for (auto &consumer : consumers_) consumer->push_sample(s);
+	std::unique_lock<std::mutex> lock(push_mut_);
+	wait_for_room(lock, 1);
+	record(s, keeps_history() ? lsl_clock() : 0.0);
+	const consumer_set &consumers = *consumers_.load(std::memory_order_acquire);
+	// one atomic increment for all consumers instead of one per consumer
+	if (!consumers.empty()) s->add_refs(static_cast<int>(consumers.size()));
+	for (auto *consumer : consumers) consumer->push_samples_adopting(&s, 1);
+	LSL_TRACE("queued", trace_uid_, s->seq);
+}
+
+void send_buffer::push_samples(const sample_p *s, std::size_t n) {
+	std::unique_lock<std::mutex> lock(push_mut_);
+	wait_for_room(lock, n);
+	const double now = keeps_history() ? lsl_clock() : 0.0;
+	for (std::size_t k = 0; k < n; ++k) record(s[k], now);
+	const consumer_set &consumers = *consumers_.load(std::memory_order_acquire);
+	if (!consumers.empty())
+		for (std::size_t k = 0; k < n; ++k) s[k]->add_refs(static_cast<int>(consumers.size()));
+	for (auto *consumer : consumers) consumer->push_samples_adopting(s, n);
+	for (std::size_t k = 0; k < n; ++k) LSL_TRACE("queued", trace_uid_, s[k]->seq);
+}
+
+void send_buffer::wait_for_room(std::unique_lock<std::mutex> &lock, std::size_t n) {
+	std::chrono::steady_clock::time_point deadline;
+	for (bool waiting = false;; waiting = true) {
+		int64_t wait_ns = 0;
+		for (auto *consumer : *consumers_.load(std::memory_order_acquire))
+			wait_ns = std::max(wait_ns, consumer->room_wait_ns(n));
+		if (!wait_ns) return;
+		const auto now = std::chrono::steady_clock::now();
+		if (!waiting)
+			deadline = now + std::chrono::nanoseconds(wait_ns);
+		else if (now >= deadline)
+			return;
+		// the consumers don't signal the producer, so we poll; the other producers, the IO
+		// threads and (un)registering consumers go ahead in the meantime
+		lock.unlock();
+		sleep_precise(50e-6);
+		lock.lock();
+	}
+}
+
+void send_buffer::enable_deduced_timestamps(uint32_t max, double tolerance, double interval) {
+	std::lock_guard<std::mutex> lock(push_mut_);
+	deduced_max_ = max;
+	deduced_tolerance_ = tolerance;
+	sample_interval_ = interval;
+}
+
+timestamp_deduction send_buffer::new_timestamp_deduction() {
+	std::lock_guard<std::mutex> lock(push_mut_);
+	return {deduced_max_, deduced_tolerance_, sample_interval_};
+}
+
+void send_buffer::record(const sample_p &s, double now) {
+	s->seq = next_seq_++;
+	if (deduced_max_) {
+		// a consumer that doesn't get the previous sample has to send this time stamp
+		if (s->timestamp == DEDUCED_TIMESTAMP) s->timestamp = last_timestamp_ + sample_interval_;
+		last_timestamp_ = s->timestamp;
+	}
+	if (!keeps_history()) return;
+	history_.push_back(history_entry{now, s});
+	trim_history(now);
+}
+
+void send_buffer::trim_history(double now) {
+	if (history_length_)
+		while (history_.size() > history_length_) history_.pop_front();
+	if (history_seconds_ > 0.0)
+		while (!history_.empty() && history_.front().pushed < now - history_seconds_)
+			history_.pop_front();
+}
+
+void send_buffer::enable_spill(
+	factory_p factory, const std::string &directory, uint64_t max_bytes) {
+	spill_factory_ = std::move(factory);
+	spill_directory_ = directory;
+	spill_max_bytes_ = max_bytes;
+}
+
+bool send_buffer::has_history() {
+	std::lock_guard<std::mutex> lock(push_mut_);
+	return keeps_history();
 }
 
+uint64_t send_buffer::last_seq() {
+	std::lock_guard<std::mutex> lock(push_mut_);
+	return next_seq_ - 1;
+}
+
+std::vector<sample_p> send_buffer::history_range(uint64_t first, uint64_t last) {
+	std::vector<sample_p> result;
+	std::lock_guard<std::mutex> lock(push_mut_);
+	if (history_.empty() || first > last || last < history_.front().sample->seq) return result;
+	// the history holds consecutive sequence numbers
+	const uint64_t oldest = history_.front().sample->seq;
+	const uint64_t begin = std::max(first, oldest) - oldest,
+				   end = std::min<uint64_t>(last - oldest + 1, history_.size());
+	if (begin >= end) return result;
+	result.reserve(static_cast<std::size_t>(end - begin));
+	for (uint64_t k = begin; k < end; ++k)
+		result.push_back(history_[static_cast<std::size_t>(k)].sample);
+	return result;
+}
+
+void send_buffer::set_history(std::size_t length, double seconds) {
+	std::lock_guard<named_mutex> consumers_lock(consumers_mut_);
+	std::lock_guard<std::mutex> lock(push_mut_);
+	history_length_ = length;
+	history_seconds_ = std::max(seconds, 0.0);
+	if (keeps_history())
+		trim_history(lsl_clock());
+	else
+		history_.clear();
+	update_idle();
+}
+
+
+void send_buffer::publish_consumers(
+	std::unique_ptr<const consumer_set> consumers, bool holds_push_mut) {
+	std::unique_ptr<const consumer_set> previous(std::move(consumers_owner_));
+	consumers_owner_ = std::move(consumers);
+	consumers_.store(consumers_owner_.get(), std::memory_order_release);
+	// a push that loaded the previous snapshot holds push_mut_ until it's done with it
+	std::unique_lock<std::mutex> wait_for_push(push_mut_, std::defer_lock);
+	if (!holds_push_mut) wait_for_push.lock();
+	update_idle();
+}
 
 /// Registered a new consumer.
-void send_buffer::register_consumer(consumer_queue *q) {
+void send_buffer::register_consumer(consumer_queue *q, uint64_t replay_from) {
 	{
-		std::lock_guard<std::mutex> lock(consumers_mut_);
-		if (std::find(consumers_.begin(), consumers_.end(), q) != consumers_.end())
+		std::lock_guard<named_mutex> lock(consumers_mut_);
+		const consumer_set &current = *consumers_owner_;
+		if (std::find(current.begin(), current.end(), q) != current.end()) {
 			LOG_F(WARNING, "Duplicate consumer queue in send buffer");
-		else
-			consumers_.push_back(q);
+			return;
+		}
+		// the queues are ordered by their priority, so the pushes reach the urgent ones first
+		std::unique_ptr<consumer_set> consumers(new consumer_set(current));
+		const auto lower = [q](const consumer_queue *c) { return c->priority() < q->priority(); };
+		consumers->insert(std::find_if(consumers->begin(), consumers->end(), lower), q);
+		// the replayed samples are queued under the same lock as new samples are pushed, so the
+		// consumer doesn't miss any sample or get one twice
+		std::unique_lock<std::mutex> push_lock(push_mut_, std::defer_lock);
+		if (replay_from) push_lock.lock();
+		if (replay_from && !history_.empty()) {
+			const uint64_t first = history_.front().sample->seq;
+			if (replay_from < first)
+				LOG_F(WARNING, "%llu samples were pushed during the outage that aren't in the "
+							   "history anymore",
+					static_cast<unsigned long long>(first - replay_from));
+			const auto skip = std::min<uint64_t>(replay_from - std::min(replay_from, first),
+				history_.size());
+			for (auto it = history_.begin() + static_cast<std::ptrdiff_t>(skip);
+				 it != history_.end(); ++it)
+				q->push_sample(it->sample);
+		}
+		publish_consumers(std::move(consumers), push_lock.owns_lock());
 	}
 	some_registered_.notify_all();
+	notify_consumers();
 }
 
 /// Unregister a previously registered consumer.
 void send_buffer::unregister_consumer(consumer_queue *q) {
-	std::lock_guard<std::mutex> lock(consumers_mut_);
-	auto pos = std::find(consumers_.begin(), consumers_.end(), q);
-	if (pos == consumers_.end()) LOG_F(ERROR, "Trying to remove consumer queue not in send buffer");
+	{
+		std::lock_guard<named_mutex> lock(consumers_mut_);
+		std::unique_ptr<consumer_set> consumers(new consumer_set(*consumers_owner_));
+		auto pos = std::find(consumers->begin(), consumers->end(), q);
+		if (pos == consumers->end()) {
+			LOG_F(ERROR, "Trying to remove consumer queue not in send buffer");
+			return;
+		}
+
+		// the others keep their (priority) order
+		consumers->erase(pos);
+		// the queue is destroyed once we return, so no push may still be using it
+		publish_consumers(std::move(consumers), false);
+		dropped_ += q->dropped();
+		release_capacity(q->capacity());
+	}
+	notify_consumers();
+}
 
-	// Put the element to be removed at the end (if it isn't there already) and
-	// remove the last element
-	if (*pos != consumers_.back()) std::swap(*pos, consumers_.back());
-	consumers_.pop_back();
+void send_buffer::set_consumers_callback(consumers_callback callback) {
+	{
+		std::lock_guard<std::mutex> lock(callback_mut_);
+		consumers_callback_ = std::move(callback);
+	}
+	notify_consumers();
+}
+
+void send_buffer::notify_consumers() {
+	// the count is read while holding callback_mut_, so the calls report the counts in order
+	std::lock_guard<std::mutex> lock(callback_mut_);
+	if (!consumers_callback_) return;
+	std::size_t count;
+	{
+		std::lock_guard<named_mutex> consumers_lock(consumers_mut_);
+		count = consumers_owner_->size();
+	}
+	try {
+		consumers_callback_(count);
+	} catch (std::exception &e) { LOG_F(ERROR, "Error in the consumers callback: %s", e.what()); }
+}
+
+uint64_t send_buffer::dropped_samples() {
+	std::lock_guard<named_mutex> lock(consumers_mut_);
+	uint64_t result = dropped_;
+	for (auto *consumer : *consumers_owner_) result += consumer->dropped();
+	return result;
+}
+
+send_buffer::usage_stats send_buffer::usage() {
+	std::lock_guard<named_mutex> lock(consumers_mut_);
+	uint64_t pushed;
+	std::size_t history_bytes;
+	{
+		std::lock_guard<std::mutex> push_lock(push_mut_);
+		pushed = next_seq_ - 1 + skipped_.load(std::memory_order_relaxed);
+		history_bytes = history_.size() * sizeof(history_entry);
+	}
+	usage_stats result{pushed, dropped_, consumers_owner_->size(), 0, history_bytes};
+	for (auto *consumer : *consumers_owner_) {
+		result.dropped += consumer->dropped();
+		result.max_queued = std::max(result.max_queued, consumer->read_available());
+		result.queue_bytes += consumer->memory_bytes();
+	}
+	return result;
 }
 
 /// Check whether there currently are consumers.
 bool send_buffer::have_consumers() {
-	std::lock_guard<std::mutex> lock(consumers_mut_);
+	std::lock_guard<named_mutex> lock(consumers_mut_);
 	return some_registered();
 }
 
 /// Wait until some consumers are present.
 bool send_buffer::wait_for_consumers(double timeout) {
-	std::unique_lock<std::mutex> lock(consumers_mut_);
+	named_unique_lock lock(consumers_mut_);
 	return some_registered_.wait_for(
 		lock, std::chrono::duration<double>(timeout), [this]() { return some_registered(); });
 }
@@ -3,9 +3,15 @@
 
 #include "common.h"
 #include "forward.h"
+#include "lock_stats.h"
+#include "timestamp_deduction.h"
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 namespace lsl {
@@ -18,6 +24,10 @@ namespace lsl {
  * producer-consumer queues (each of which can have its own capacity preferences).
  * The ownership of the send_buffer is shared between the consumer_queues and the owner of the
  * send_buffer.
+ *
+ * The registered consumers are an immutable snapshot that's replaced when a consumer registers or
+ * unregisters, so pushing samples doesn't lock the registry and (un)registering consumers, e.g.
+ * reconnecting inlets, doesn't stall the producer for longer than it takes to finish a push.
  */
 class send_buffer : public std::enable_shared_from_this<send_buffer> {
 	using consumer_set = std::vector<class consumer_queue *>;
@@ -27,8 +37,22 @@ public:
 	 * Create a new send buffer.
 	 * @param max_capacity Hard upper bound on queue capacity beyond which the oldest samples will
 	 * be dropped.
+	 * @param sample_bytes The memory a buffered sample occupies, used to enforce the byte budgets
+	 * (0 to only limit the queues in samples).
+	 * @param max_bytes The maximum total memory all consumer queues of this buffer may hold
+	 * (0 for no limit). The process-wide budget (api_config::outlet_buffers_total_max_bytes())
+	 * applies in addition to it.
+	 * @param history_length The number of recently pushed samples that are kept so they can be
+	 * replayed to new consumers (see new_consumer()), 0 for no limit.
+	 * @param history_seconds How long pushed samples are kept in the history, 0 for no limit.
+	 * If both limits are 0, no history is kept.
 	 */
-	send_buffer(int max_capacity) : max_capacity_(max_capacity) {}
+	send_buffer(int max_capacity, std::size_t sample_bytes = 0, std::size_t max_bytes = 0,
+		std::size_t history_length = 0, double history_seconds = 0.0)
+		: max_capacity_(max_capacity), sample_bytes_(sample_bytes), max_bytes_(max_bytes),
+		  history_length_(history_length), history_seconds_(history_seconds),
+		  consumers_owner_(new consumer_set()), consumers_(consumers_owner_.get()),
+		  idle_(!keeps_history()) {}
 
 	/**
 	 * Add a new consumer queue to the buffer.
@@ -37,39 +61,245 @@ public:
 	 * buffer capacity is overrun). The consumer is automatically removed upon destruction.
 	 * @param max_buffered If non-zero, the queue size for this consumer will be constrained to be
 	 * no larger than this value. Note that the actual queue size will never exceed the max_capacity
-	 * of the send_buffer (so this is a global limit).
+	 * of the send_buffer (so this is a global limit), and it is reduced further so the memory
+	 * held by the queue fits into the remaining byte budgets.
+	 * @param replay_from If non-zero, the samples in the history with this or a later sequence
+	 * number are queued for the consumer before any newly pushed samples.
+	 * @param replay_seconds If replay_from is zero, the samples in the history that were pushed
+	 * during the last replay_seconds seconds are queued instead.
+	 * @param priority The consumer's priority class (see consumer_queue::priority()).
 	 * @return Shared pointer to the newly created consumer.
 	 */
-	std::shared_ptr<consumer_queue> new_consumer(int max_buffered = 0);
+	std::shared_ptr<consumer_queue> new_consumer(int max_buffered = 0, uint64_t replay_from = 0,
+		double replay_seconds = 0.0, lsl_transfer_priority_t priority = prio_normal);
+
+	/// Whether recently pushed samples are kept to be replayed to new consumers.
+	bool has_history();
+
+	/**
+	 * Get the samples in the history with the sequence numbers first to last (inclusive), e.g.
+	 * to repair lost datagrams (see datagram_sender).
+	 *
+	 * Samples that aren't in the history (anymore) are missing from the result.
+	 */
+	std::vector<sample_p> history_range(uint64_t first, uint64_t last);
+
+	/// The sequence number of the last pushed sample (0 if none was pushed yet).
+	uint64_t last_seq();
 
-	/// Push a sample onto the send buffer that will subsequently be received by all consumers.
+	/// Change the limits of the history (see send_buffer()).
+	void set_history(std::size_t length, double seconds);
+
+	/**
+	 * Push a sample onto the send buffer that will subsequently be received by all consumers.
+	 *
+	 * The sample is assigned the next sequence number (starting at 1).
+	 */
 	void push_sample(const sample_p &s);
 
+	/// Push n samples onto the send buffer, locking each consumer queue only once.
+	void push_samples(const sample_p *s, std::size_t n);
+
+	/**
+	 * Let the consumers omit the time stamps their receivers can deduce (see
+	 * timestamp_deduction()).
+	 *
+	 * The pushed samples keep their time stamps, and those pushed as DEDUCED_TIMESTAMP get the
+	 * previous sample's time stamp plus the interval while they are numbered, so each consumer
+	 * can send any of them explicitly.
+	 */
+	void enable_deduced_timestamps(uint32_t max, double tolerance, double interval);
+
+	/**
+	 * A new deduction state for a consumer, which sends all time stamps unless
+	 * enable_deduced_timestamps() was called.
+	 *
+	 * A time stamp that's within tolerance of the previous one (as reconstructed by the
+	 * consumer's receiver) plus the sampling interval is omitted, for at most max consecutive
+	 * samples.
+	 */
+	timestamp_deduction new_timestamp_deduction();
+
+	/**
+	 * Whether pushed samples would go nowhere, i.e. there's no consumer and no history is kept.
+	 *
+	 * This is a single relaxed load, so pushers can skip preparing the samples; a push that
+	 * races with the registration of a consumer may see the buffer as idle, as if it had happened
+	 * just before.
+	 */
+	bool idle() const { return idle_.load(std::memory_order_relaxed); }
+
+	/// Count n samples that were skipped because the buffer was idle (as pushed, see usage()).
+	void count_skipped(std::size_t n) { skipped_.fetch_add(n, std::memory_order_relaxed); }
+
 	/// Wait until some consumers are present.
 	bool wait_for_consumers(double timeout = FOREVER);
 
 	/// Check whether any consumer is currently registered.
 	bool have_consumers();
 
+	/// A function that's told the number of consumers, see set_consumers_callback().
+	using consumers_callback = std::function<void(std::size_t)>;
+
+	/**
+	 * Call a function with the number of consumers whenever a consumer registers or unregisters.
+	 *
+	 * The function is called right away with the current number and afterwards from the thread
+	 * that (un)registered the consumer, e.g. a network thread, so it should return quickly and
+	 * must not set another function. The calls are serialized, and the last call always reports
+	 * the current number (a number may be reported twice in a row). Pass an empty function to
+	 * remove it; once this returns, the previous function won't be called anymore.
+	 */
+	void set_consumers_callback(consumers_callback callback);
+
+	/// The number of samples current and past consumers dropped because their queues were full.
+	uint64_t dropped_samples();
+
+	/// A snapshot of the buffer's usage, see usage().
+	struct usage_stats {
+		/// the number of samples pushed so far
+		uint64_t pushed;
+		/// the number of samples dropped by current and past consumers
+		uint64_t dropped;
+		/// the number of current consumers
+		std::size_t consumers;
+		/// the number of samples waiting in the fullest consumer queue
+		std::size_t max_queued;
+		/// the memory of the consumer queues' slots and the history, in bytes
+		std::size_t queue_bytes;
+	};
+
+	/// Get the current usage of the buffer.
+	usage_stats usage();
+
+	/// Set the UID of the stream for the trace events (see tracing.h).
+	void set_trace_uid(const std::string &uid) { trace_uid_ = uid; }
+
+	/// Set the NUMA node the consumer queues created afterwards are placed on (-1 for none).
+	void set_numa_node(int node) { numa_node_ = node; }
+
+	/// The NUMA node of the consumer queues and the threads serving them, or -1.
+	int numa_node() const { return numa_node_; }
+
+	/// Allocate all slots of the consumer queues created afterwards up front (see consumer_queue).
+	void set_preallocate_queues(bool preallocate) { preallocate_queues_ = preallocate; }
+
+	/**
+	 * Let the consumer queues created afterwards spill samples to disk once they are full.
+	 * @param factory The factory of the stream's samples, to read the spilled samples into.
+	 * @param directory The directory of the spill files.
+	 * @param max_bytes The maximum disk space each queue may use.
+	 */
+	void enable_spill(factory_p factory, const std::string &directory, uint64_t max_bytes);
+
 private:
 	friend class consumer_queue;
 
-	/// Registered a new consumer (called by the consumer_queue).
-	void register_consumer(consumer_queue *q);
+	/// Registered a new consumer (called by the consumer_queue) and replay the history to it.
+	void register_consumer(consumer_queue *q, uint64_t replay_from);
 	/// Unregister a previously registered consumer (called by the consumer_queue).
 	void unregister_consumer(consumer_queue *q);
 
 	/// wait_for_consumers is waiting for this
-	bool some_registered() const { return !consumers_.empty(); }
+	bool some_registered() const { return !consumers_.load(std::memory_order_acquire)->empty(); }
+
+	/**
+	 * Replace the snapshot of the consumers; the caller holds consumers_mut_.
+	 *
+	 * Returns once no push uses the previous snapshot anymore, so an unregistered queue can be
+	 * destroyed afterwards. The caller may hold push_mut_, e.g. while replaying the history.
+	 */
+	void publish_consumers(std::unique_ptr<const consumer_set> consumers, bool holds_push_mut);
+
+	/// Limit a queue capacity to the byte budgets and reserve its memory from them.
+	std::size_t reserve_capacity(std::size_t max_buffered);
+	/// Give the memory of a queue back to the byte budgets; the caller holds consumers_mut_.
+	void release_capacity(std::size_t capacity);
+
+	/**
+	 * Wait until the queues that block their producer (see ovf_block) have room for n more
+	 * samples, or until the longest of their timeouts expires.
+	 *
+	 * push_mut_ (held by lock) is released while waiting, so a full queue only holds up the
+	 * pushes, not the other users of the send buffer.
+	 */
+	void wait_for_room(std::unique_lock<std::mutex> &lock, std::size_t n);
+
+	/// Number a pushed sample and add it to the history; the caller holds push_mut_.
+	void record(const sample_p &s, double now);
+
+	/// Drop samples exceeding the history limits; the caller holds push_mut_.
+	void trim_history(double now);
+
+	/// Whether a history is kept; the caller holds push_mut_.
+	bool keeps_history() const { return history_length_ || history_seconds_ > 0.0; }
+
+	/// Report the number of consumers to the consumers callback, if any.
+	void notify_consumers();
+
+	/// Update idle_; the caller holds consumers_mut_ and push_mut_.
+	void update_idle() { idle_.store(consumers_owner_->empty() && !keeps_history()); }
 
 	/// maximum capacity beyond which the oldest samples will be dropped
 	int max_capacity_;
-	/// a set of registered consumer queues
-	consumer_set consumers_;
-	/// mutex to protect the integrity of consumers_
-	std::mutex consumers_mut_;
+	/// the memory a buffered sample occupies
+	const std::size_t sample_bytes_;
+	/// the maximum memory of all consumer queues (0 for no limit)
+	const std::size_t max_bytes_;
+	/// the memory reserved by the current consumer queues, protected by consumers_mut_
+	std::size_t reserved_bytes_{0};
+	/// the number of samples dropped by past consumers, protected by consumers_mut_
+	uint64_t dropped_{0};
+	/// the maximum number of samples in the history, protected by push_mut_
+	std::size_t history_length_;
+	/// the maximum age of the samples in the history, protected by push_mut_
+	double history_seconds_;
+	/// a sample in the history and the time it was pushed
+	struct history_entry {
+		double pushed;
+		sample_p sample;
+	};
+	/// the most recently pushed samples, protected by push_mut_
+	std::deque<history_entry> history_;
+	/// the sequence number of the next pushed sample, protected by push_mut_
+	uint64_t next_seq_{1};
+	/// the time stamp deduction of the consumers (see enable_deduced_timestamps()), protected by
+	/// push_mut_: the maximum number of consecutive deduced time stamps (0 if disabled), the
+	/// tolerance, the sampling interval and the time stamp of the last pushed sample
+	uint32_t deduced_max_{0};
+	double deduced_tolerance_{0.0};
+	double sample_interval_{0.0};
+	double last_timestamp_{0.0};
+	/// the factory to read spilled samples into (if spilling is enabled), the directory of the
+	/// spill files, their size limit and the number of spill files that were created
+	factory_p spill_factory_;
+	std::string spill_directory_;
+	uint64_t spill_max_bytes_{0};
+	std::atomic<uint32_t> spill_files_{0};
+	/// the current snapshot of the registered consumer queues, protected by consumers_mut_
+	std::unique_ptr<const consumer_set> consumers_owner_;
+	/// the snapshot the pushes use (only replaced while holding consumers_mut_)
+	std::atomic<const consumer_set *> consumers_;
+	/// mutex serializing the (un)registration of consumers
+	named_mutex consumers_mut_{"send_buffer_consumers"};
+	/// mutex serializing the pushes (the consumer queues have a single producer) and protecting
+	/// the history
+	std::mutex push_mut_;
+	/// the stream's UID for the trace events
+	std::string trace_uid_;
+	/// the NUMA node of the consumer queues, -1 for the default placement
+	int numa_node_{-1};
+	/// whether the consumer queues allocate all their slots up front
+	bool preallocate_queues_{false};
 	/// condition variable signaling that a consumer has registered
-	std::condition_variable some_registered_;
+	named_condition_variable some_registered_;
+	/// see idle(), updated while holding consumers_mut_
+	std::atomic<bool> idle_;
+	/// the number of samples skipped while the buffer was idle
+	std::atomic<uint64_t> skipped_{0};
+	/// see set_consumers_callback(), protected by callback_mut_, which is held during the calls
+	consumers_callback consumers_callback_;
+	std::mutex callback_mut_;
 };
 } // namespace lsl
 
@@ -0,0 +1,54 @@
+#include "serialization_cache.h"
+#include "sample.h"
+#include <sstream>
+
+using namespace lsl;
+
+void serialization_cache::add_user(int protocol_version, int use_byte_order) {
+	std::lock_guard<std::mutex> lock(mut_);
+	formats_[{protocol_version, use_byte_order}].users++;
+}
+
+void serialization_cache::remove_user(int protocol_version, int use_byte_order) {
+	std::lock_guard<std::mutex> lock(mut_);
+	auto pos = formats_.find({protocol_version, use_byte_order});
+	if (pos != formats_.end() && --pos->second.users <= 0) formats_.erase(pos);
+}
+
+void serialization_cache::save_streambuf(const sample_p &s, std::streambuf &sb,
+	int protocol_version, int use_byte_order, void *scratchpad) {
+	bytes_p cached;
+	bool shared = false;
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		auto pos = formats_.find({protocol_version, use_byte_order});
+		if (pos != formats_.end() && pos->second.users > 1) {
+			shared = true;
+			auto hit = pos->second.bytes.find(s.get());
+			if (hit != pos->second.bytes.end()) cached = hit->second;
+		}
+	}
+	// no other session shares this format, so caching wouldn't pay off
+	if (!shared) return s->save_streambuf(sb, protocol_version, use_byte_order, scratchpad);
+	if (!cached) {
+		// serialize outside the lock; if another session beats us to it we use its copy instead
+		std::stringbuf tmp;
+		s->save_streambuf(tmp, protocol_version, use_byte_order, scratchpad);
+		cached = std::make_shared<const std::string>(tmp.str());
+		std::lock_guard<std::mutex> lock(mut_);
+		auto pos = formats_.find({protocol_version, use_byte_order});
+		if (pos != formats_.end()) {
+			format_cache &fc = pos->second;
+			auto inserted = fc.bytes.emplace(s.get(), cached);
+			if (inserted.second) {
+				fc.order.push_back(s);
+				if (fc.order.size() > max_cached_) {
+					fc.bytes.erase(fc.order.front().get());
+					fc.order.pop_front();
+				}
+			} else
+				cached = inserted.first->second;
+		}
+	}
+	sb.sputn(cached->data(), static_cast<std::streamsize>(cached->size()));
+}
@@ -0,0 +1,70 @@
+#ifndef SERIALIZATION_CACHE_H
+#define SERIALIZATION_CACHE_H
+
+#include "forward.h"
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace lsl {
+
+/**
+ * A cache of serialized samples that is shared by all sessions of a TCP server.
+ *
+ * Samples are serialized once per wire format (protocol version and byte order) and the
+ * serialized bytes are shared by all sessions that use the same format. Formats used by only one
+ * session bypass the cache.
+ * @note Only protocol versions 1.10 and later are supported; the 1.00 archive is stateful.
+ */
+class serialization_cache {
+public:
+	/// Create a new cache that holds at most max_cached serialized samples per wire format.
+	explicit serialization_cache(std::size_t max_cached = 1024) : max_cached_(max_cached) {}
+
+	/// Announce that a session will request samples in the given wire format.
+	void add_user(int protocol_version, int use_byte_order);
+
+	/// Unregister a session previously registered with add_user().
+	void remove_user(int protocol_version, int use_byte_order);
+
+	/**
+	 * Write a serialized sample to a stream buffer, serializing it only if it's not cached yet.
+	 * @param s The sample to serialize.
+	 * @param sb The stream buffer to append the serialized sample to.
+	 * @param protocol_version The data protocol version (at least 110).
+	 * @param use_byte_order The byte order to use.
+	 * @param scratchpad Scratch memory for the endian conversion (see sample::save_streambuf).
+	 */
+	void save_streambuf(const sample_p &s, std::streambuf &sb, int protocol_version,
+		int use_byte_order, void *scratchpad);
+
+private:
+	using bytes_p = std::shared_ptr<const std::string>;
+
+	/// the cached samples for one wire format
+	struct format_cache {
+		/// number of sessions using this format
+		int users{0};
+		/// serialized samples, by sample
+		std::unordered_map<const class sample *, bytes_p> bytes;
+		/// cached samples, oldest first; keeps them from being recycled while cached
+		std::deque<sample_p> order;
+	};
+
+	/// maximum number of cached samples per format
+	const std::size_t max_cached_;
+	/// caches for the wire formats in use, keyed by (protocol version, byte order)
+	std::map<std::pair<int, int>, format_cache> formats_;
+	/// mutex protecting formats_
+	std::mutex mut_;
+};
+
+} // namespace lsl
+
+#endif
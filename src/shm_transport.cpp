@@ -0,0 +1,296 @@
+#include "shm_transport.h"
+#include "common.h"
+#include "consumer_queue.h"
+#include "datagram_sender.h"
+#include "sample.h"
+#include "send_buffer.h"
+#include "stream_info_impl.h"
+#include <algorithm>
+#include <atomic>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <loguru.hpp>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LSL_SHM
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace lsl;
+
+/// The header of a ring, followed by its slots.
+struct shm_ring::header {
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> read;
+	std::atomic<uint32_t> reader_waiting;
+	uint32_t slots, slot_bytes;
+};
+
+/// each slot starts with the number of its bytes (padded, so the rest stays aligned)
+static const std::size_t slot_header_bytes = 8;
+/// how long the writer sleeps while the ring is full
+static const std::chrono::microseconds full_ring_sleep(100);
+/// the writer checks in slices of this length (in seconds) whether it should stop
+static const double stop_poll_interval = 0.1;
+
+#ifdef LSL_SHM
+
+bool lsl::shm_available() { return true; }
+
+static std::string errno_message() { return std::strerror(errno); }
+
+/// Map a shared memory object, closing its descriptor.
+static void *map_shared(int fd, std::size_t bytes) {
+	void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	const std::string msg = errno_message();
+	close(fd);
+	if (mem == MAP_FAILED) throw std::runtime_error("Could not map the ring: " + msg);
+	return mem;
+}
+
+shm_ring::shm_ring(uint32_t slots, uint32_t slot_bytes) {
+	static std::atomic<uint32_t> counter{0};
+	if (!std::atomic<uint64_t>().is_lock_free() || !std::atomic<uint32_t>().is_lock_free())
+		throw std::runtime_error("The rings need lock-free atomics.");
+	if (!slots || slot_bytes <= slot_header_bytes)
+		throw std::invalid_argument("The ring has no room for the samples.");
+	// (in lowercase, since the inlet gets it in a header line)
+	name_ = "/lsl-feed-" + std::to_string(getpid()) + '-' + std::to_string(counter++);
+	const int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0) throw std::runtime_error("Could not create the ring: " + errno_message());
+	bytes_ = sizeof(header) + static_cast<std::size_t>(slots) * slot_bytes;
+	if (ftruncate(fd, static_cast<off_t>(bytes_)) != 0) {
+		const std::string msg = errno_message();
+		close(fd);
+		unlink();
+		throw std::runtime_error("Could not size the ring: " + msg);
+	}
+	try {
+		mem_ = map_shared(fd, bytes_);
+	} catch (std::exception &) {
+		unlink();
+		throw;
+	}
+	// the memory is zeroed, so the counters start at 0
+	head().slots = slots_ = slots;
+	head().slot_bytes = slot_bytes_ = slot_bytes;
+}
+
+shm_ring::shm_ring(const std::string &name) : name_(name) {
+	const int fd = shm_open(name_.c_str(), O_RDWR, 0);
+	if (fd < 0) throw std::runtime_error("Could not open the ring: " + errno_message());
+	// the memory is freed once both sides unmap it
+	unlink();
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(header)) {
+		close(fd);
+		throw std::runtime_error("The ring is malformed.");
+	}
+	bytes_ = static_cast<std::size_t>(st.st_size);
+	mem_ = map_shared(fd, bytes_);
+	slots_ = head().slots;
+	slot_bytes_ = head().slot_bytes;
+	if (!slots_ || slot_bytes_ <= slot_header_bytes ||
+		sizeof(header) + static_cast<std::size_t>(slots_) * slot_bytes_ > bytes_) {
+		munmap(mem_, bytes_);
+		throw std::runtime_error("The ring is malformed.");
+	}
+}
+
+shm_ring::~shm_ring() {
+	munmap(mem_, bytes_);
+	unlink();
+}
+
+void shm_ring::unlink() {
+	if (!name_.empty()) shm_unlink(name_.c_str());
+	name_.clear();
+}
+
+#else
+
+bool lsl::shm_available() { return false; }
+
+[[noreturn]] static void unsupported() {
+	throw std::runtime_error("Shared memory feeds are only supported on POSIX systems.");
+}
+
+shm_ring::shm_ring(uint32_t /*slots*/, uint32_t /*slot_bytes*/) { unsupported(); }
+shm_ring::shm_ring(const std::string & /*name*/) { unsupported(); }
+shm_ring::~shm_ring() = default;
+void shm_ring::unlink() { name_.clear(); }
+
+#endif
+
+shm_ring::header &shm_ring::head() const { return *static_cast<header *>(mem_); }
+
+char *shm_ring::slot(uint64_t index) const {
+	return static_cast<char *>(mem_) + sizeof(header) + (index % slots_) * slot_bytes_;
+}
+
+std::size_t shm_ring::slot_capacity() const { return slot_bytes_ - slot_header_bytes; }
+
+char *shm_ring::write_slot(double timeout) {
+	header &h = head();
+	const uint64_t next = h.written.load(std::memory_order_relaxed);
+	const auto deadline = std::chrono::steady_clock::now() +
+						  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+							  std::chrono::duration<double>(timeout));
+	while (next - h.read.load(std::memory_order_acquire) >= slots_) {
+		if (std::chrono::steady_clock::now() >= deadline) return nullptr;
+		std::this_thread::sleep_for(full_ring_sleep);
+	}
+	return slot(next) + slot_header_bytes;
+}
+
+bool shm_ring::commit(std::size_t len) {
+	header &h = head();
+	const uint64_t next = h.written.load(std::memory_order_relaxed);
+	const auto bytes = static_cast<uint32_t>(len);
+	memcpy(slot(next), &bytes, sizeof(bytes));
+	// sequentially consistent with prepare_wait(), so either the reader sees the slot or we see
+	// that it waits
+	h.written.store(next + 1);
+	return h.reader_waiting.exchange(0) != 0;
+}
+
+const char *shm_ring::read_slot(std::size_t &len) {
+	header &h = head();
+	const uint64_t next = h.read.load(std::memory_order_relaxed);
+	if (h.written.load(std::memory_order_acquire) == next) return nullptr;
+	uint32_t bytes;
+	memcpy(&bytes, slot(next), sizeof(bytes));
+	len = std::min<std::size_t>(bytes, slot_capacity());
+	return slot(next) + slot_header_bytes;
+}
+
+void shm_ring::release() {
+	header &h = head();
+	h.read.store(h.read.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool shm_ring::prepare_wait() {
+	header &h = head();
+	h.reader_waiting.store(1);
+	if (h.written.load() == h.read.load(std::memory_order_relaxed)) return true;
+	h.reader_waiting.store(0, std::memory_order_relaxed);
+	return false;
+}
+
+/// Serializes the samples right into a slot, after the datagram header.
+class shm_sender::slot_buf : public std::streambuf {
+public:
+	void reset(char *slot, std::size_t bytes) {
+		slot_ = slot;
+		setp(slot + datagram_sender::header_bytes, slot + bytes);
+	}
+	char *slot() const { return slot_; }
+	std::size_t size() const { return static_cast<std::size_t>(pptr() - slot_); }
+
+private:
+	char *slot_{nullptr};
+};
+
+template <typename T> static void put(std::streambuf &sb, T value) {
+	lslboost::endian::native_to_little_inplace(value);
+	sb.sputn(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// The size of a sample in a slot: its sequence number, tag, time stamp and values.
+static std::size_t slot_sample_bytes(const stream_info_impl &info) {
+	return sizeof(uint64_t) + 1 + sizeof(double) +
+		   format_sizes[info.channel_format()] * info.channel_count();
+}
+
+/// The size of the ring's slots, after checking that the samples can be sent through them.
+static uint32_t checked_slot_bytes(const stream_info_impl &info) {
+	if (info.channel_format() == cft_string)
+		throw std::invalid_argument("String samples can't be sent through shared memory.");
+	if (slot_header_bytes + datagram_sender::header_bytes + slot_sample_bytes(info) >
+		shm_sender::slot_bytes)
+		throw std::invalid_argument("The samples are too large for the shared memory slots.");
+	return shm_sender::slot_bytes;
+}
+
+shm_sender::shm_sender(stream_info_impl_p info, send_buffer_p send_buffer,
+	std::function<void()> wakeup, int max_buffered)
+	: info_(std::move(info)), send_buffer_(std::move(send_buffer)), wakeup_(std::move(wakeup)),
+	  ring_(ring_slots, checked_slot_bytes(*info_)),
+	  key_(std::hash<std::string>()(info_->uid())), slot_(new slot_buf()) {
+	samples_per_slot_ = std::min<std::size_t>(
+		(ring_.slot_capacity() - datagram_sender::header_bytes) / slot_sample_bytes(*info_),
+		std::numeric_limits<uint16_t>::max());
+	scratch_.reset(new char[format_sizes[info_->channel_format()] * info_->channel_count()]);
+	queue_ = send_buffer_->new_consumer(max_buffered);
+	thread_ = managed_thread(lsl_thread_transfer, "M_" + info_->name().substr(0, 12),
+		&shm_sender::sender_thread, this);
+}
+
+shm_sender::~shm_sender() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+	}
+	// wake up the thread if it's waiting for a sample
+	queue_->push_sample(sample_p());
+	thread_.join();
+}
+
+bool shm_sender::next_slot() {
+	for (double waited = 0.0;; waited += stop_poll_interval) {
+		if (char *slot = ring_.write_slot(stop_poll_interval)) {
+			slot_->reset(slot, ring_.slot_capacity());
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mut_);
+			if (stop_) return false;
+		}
+		if (waited >= write_timeout) throw std::runtime_error("The inlet stopped receiving.");
+	}
+}
+
+void shm_sender::sender_thread() {
+	pin_to_numa_node(send_buffer_->numa_node());
+	try {
+		if (!next_slot()) return;
+		while (true) {
+			sample_p samp(queue_->pop_sample(heartbeat_interval));
+			if (samp) {
+				put(*slot_, samp->seq);
+				samp->save_streambuf(*slot_, 110, BOOST_BYTE_ORDER, scratch_.get());
+				last_seq_ = samp->seq;
+				if (++num_samples_ < samples_per_slot_ && !samp->pushthrough) continue;
+			} else {
+				// a heartbeat, or the wakeup sample of the destructor
+				std::lock_guard<std::mutex> lock(mut_);
+				if (stop_) return;
+			}
+			send_slot();
+			if (!next_slot()) return;
+		}
+	} catch (std::exception &e) {
+		LOG_F(ERROR, "Unexpected error while sending the samples of %s through shared memory: %s",
+			info_->name().c_str(), e.what());
+	}
+}
+
+void shm_sender::send_slot() {
+	char *header = slot_->slot();
+	const uint64_t key = lslboost::endian::native_to_little(key_),
+				   last_seq = lslboost::endian::native_to_little(last_seq_);
+	const uint16_t count = lslboost::endian::native_to_little(num_samples_);
+	memcpy(header, &key, sizeof(key));
+	memcpy(header + sizeof(key), &last_seq, sizeof(last_seq));
+	memcpy(header + 2 * sizeof(uint64_t), &count, sizeof(count));
+	if (ring_.commit(slot_->size())) wakeup_();
+	num_samples_ = 0;
+}
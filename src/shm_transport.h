@@ -0,0 +1,176 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include "forward.h"
+#include "thread_policy.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lsl {
+
+/// Whether the samples can be passed through shared memory on this platform (POSIX only).
+bool shm_available();
+
+/**
+ * A ring of equally sized slots in a named shared memory object, written by one outlet session
+ * (see shm_sender) and read by one inlet in another process on the same host.
+ *
+ * The writer fills the slot at `written` and advances it, the reader decodes the slot at `read`
+ * and advances it, so neither side makes a system call while the other keeps up. A reader that
+ * found the ring empty announces that it's going to wait (see prepare_wait()) and checks again,
+ * so the writer only has to wake it up (over the data connection) if it might be sleeping.
+ *
+ * The outlet creates the ring with a new name only its user can open; the inlet removes the name
+ * once it opened the ring, so the memory is freed when both unmap it.
+ *
+ * Without POSIX shared memory, the constructors throw.
+ */
+class shm_ring {
+public:
+	/**
+	 * Create a ring with a new name (by the outlet).
+	 * @throws std::runtime_error if the shared memory object can't be created.
+	 */
+	shm_ring(uint32_t slots, uint32_t slot_bytes);
+
+	/**
+	 * Map the ring with the given name and remove the name (by the inlet).
+	 * @throws std::runtime_error if there's no such ring or it's malformed.
+	 */
+	explicit shm_ring(const std::string &name);
+
+	~shm_ring();
+
+	shm_ring(const shm_ring &) = delete;
+	shm_ring &operator=(const shm_ring &) = delete;
+
+	/// The name the inlet maps the ring by (empty once it's removed).
+	const std::string &name() const { return name_; }
+
+	/// The number of bytes a slot holds.
+	std::size_t slot_capacity() const;
+
+	/**
+	 * The slot the next write fills, once the reader has decoded it.
+	 * @return nullptr if the reader hasn't decoded it after the timeout.
+	 */
+	char *write_slot(double timeout);
+
+	/**
+	 * Pass the first len bytes of the slot returned by write_slot() to the reader.
+	 * @return Whether the reader waits for a wakeup.
+	 */
+	bool commit(std::size_t len);
+
+	/**
+	 * The next slot that was written and the number of its bytes.
+	 * @return nullptr if there's none.
+	 */
+	const char *read_slot(std::size_t &len);
+
+	/// Hand the slot returned by read_slot() back to the writer.
+	void release();
+
+	/**
+	 * Announce that the reader is going to wait for a wakeup.
+	 * @return false if a slot has been written in the meantime, so there's nothing to wait for.
+	 */
+	bool prepare_wait();
+
+	/// Remove the ring's name, e.g. once the inlet mapped it.
+	void unlink();
+
+private:
+	struct header;
+	header &head() const;
+	char *slot(uint64_t index) const;
+
+	std::string name_;
+	void *mem_{nullptr};
+	std::size_t bytes_{0};
+	/// the number and size of the slots (as the ring was created)
+	uint32_t slots_{0}, slot_bytes_{0};
+};
+
+/**
+ * Sends the samples of an outlet to an inlet in another process on the same host through a
+ * shared memory ring (see shm_ring).
+ *
+ * Each slot has the layout of a datagram (see datagram_sender): the stream's key, the last
+ * sequence number sent so far and the number of samples, followed by the samples with their
+ * sequence numbers. While the outlet doesn't push anything, empty slots are sent as heartbeats.
+ * The inlet is woken up by a byte on the data connection, which carries nothing else once the
+ * feed header has been sent.
+ */
+class shm_sender {
+public:
+	/// the number of slots of a ring, and the size of a slot
+	static const uint32_t ring_slots = 32;
+	static const uint32_t slot_bytes = 64 * 1024;
+	/// the interval of the heartbeats (in seconds)
+	static constexpr double heartbeat_interval = 0.5;
+	/// how long a slot may wait for the inlet before the sending fails (in seconds)
+	static constexpr double write_timeout = 5.0;
+
+	/**
+	 * Create the ring and start sending the samples pushed from now on.
+	 * @param wakeup Wakes up the inlet (by sending a byte over the data connection).
+	 * @param max_buffered The maximum number of samples that are buffered while the sending is
+	 * behind (0 for the outlet's default).
+	 * @throws std::invalid_argument if the samples can't be sent this way (string samples, or
+	 * samples that don't fit into a slot).
+	 * @throws std::runtime_error if the ring can't be created.
+	 */
+	shm_sender(stream_info_impl_p info, send_buffer_p send_buffer, std::function<void()> wakeup,
+		int max_buffered = 0);
+
+	/// Destructor. Stops the sending thread.
+	~shm_sender();
+
+	shm_sender(const shm_sender &) = delete;
+	shm_sender &operator=(const shm_sender &) = delete;
+
+	/// The name the inlet maps the ring by.
+	const std::string &name() const { return ring_.name(); }
+
+	/// The key that identifies the stream's slots.
+	uint64_t key() const { return key_; }
+
+private:
+	/// The sending thread.
+	void sender_thread();
+
+	/// Pass the samples collected so far (or a heartbeat if there are none) to the inlet.
+	void send_slot();
+
+	/// Wait until the next slot can be filled; false if the sender is stopping.
+	bool next_slot();
+
+	stream_info_impl_p info_;
+	send_buffer_p send_buffer_;
+	std::function<void()> wakeup_;
+	shm_ring ring_;
+	const uint64_t key_;
+	std::size_t samples_per_slot_{1};
+	std::shared_ptr<class consumer_queue> queue_;
+
+	// used by the sending thread
+	/// the slot being filled, the number of samples in it and the last sequence number
+	class slot_buf;
+	std::unique_ptr<slot_buf> slot_;
+	uint16_t num_samples_{0};
+	uint64_t last_seq_{0};
+	/// scratchpad memory for sample::save_streambuf()
+	std::unique_ptr<char[]> scratch_;
+
+	std::mutex mut_;
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
@@ -1,26 +1,119 @@
 #include "socket_utils.h"
 #include "api_config.h"
 #include "common.h"
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/ip/multicast.hpp>
 #include <boost/endian/conversion.hpp>
+#include <loguru.hpp>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+lsl::socket_options lsl::socket_options::from_config() {
+	const auto *cfg = api_config::get_instance();
+	socket_options opts;
+	opts.send_buffer_bytes = cfg->socket_send_buffer_bytes();
+	opts.receive_buffer_bytes = cfg->socket_receive_buffer_bytes();
+	opts.no_delay = cfg->tcp_no_delay();
+	opts.busy_poll_us = cfg->socket_busy_poll_us();
+	return opts;
+}
+
+lsl::socket_options lsl::socket_options::updated(int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us) const {
+	socket_options opts(*this);
+	if (send_buffer_bytes >= 0) opts.send_buffer_bytes = send_buffer_bytes;
+	if (receive_buffer_bytes >= 0) opts.receive_buffer_bytes = receive_buffer_bytes;
+	if (no_delay >= 0) opts.no_delay = no_delay != 0;
+	if (busy_poll_us >= 0) opts.busy_poll_us = busy_poll_us;
+	return opts;
+}
+
+void lsl::apply_socket_options(asio::ip::tcp::socket &sock, const socket_options &opts) {
+	lslboost::system::error_code ec;
+	sock.set_option(asio::ip::tcp::no_delay(opts.no_delay), ec);
+	if (ec) LOG_F(WARNING, "Could not set TCP_NODELAY: %s", ec.message().c_str());
+	if (opts.send_buffer_bytes > 0) {
+		sock.set_option(asio::socket_base::send_buffer_size(opts.send_buffer_bytes), ec);
+		if (ec) LOG_F(WARNING, "Could not set the send buffer size: %s", ec.message().c_str());
+	}
+	if (opts.receive_buffer_bytes > 0) {
+		sock.set_option(asio::socket_base::receive_buffer_size(opts.receive_buffer_bytes), ec);
+		if (ec) LOG_F(WARNING, "Could not set the receive buffer size: %s", ec.message().c_str());
+	}
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+	if (opts.busy_poll_us > 0) {
+		sock.set_option(
+			asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>(opts.busy_poll_us), ec);
+		if (ec) LOG_F(WARNING, "Could not enable busy polling: %s", ec.message().c_str());
+	}
+#endif
+}
+
+void lsl::mark_socket_priority(asio::ip::tcp::socket &sock, lsl_transfer_priority_t priority) {
+	if (priority == prio_normal) return;
+	lslboost::system::error_code ec;
+	// DSCP EF (expedited forwarding) or CS1 (lower effort), in the upper six bits of the TOS byte
+	const int tos = priority == prio_latency ? 46 << 2 : 8 << 2;
+	const bool v6 = sock.local_endpoint(ec).address().is_v6();
+#if defined(IPV6_TCLASS)
+	if (v6)
+		sock.set_option(asio::detail::socket_option::integer<IPPROTO_IPV6, IPV6_TCLASS>(tos), ec);
+#endif
+#if defined(IP_TOS)
+	if (!v6) sock.set_option(asio::detail::socket_option::integer<IPPROTO_IP, IP_TOS>(tos), ec);
+#endif
+	if (ec) LOG_F(WARNING, "Could not set the DSCP code point: %s", ec.message().c_str());
+#if defined(__linux__) && defined(SO_PRIORITY)
+	// the highest priority and the bulk band of the default queueing discipline that don't need
+	// CAP_NET_ADMIN
+	const int so_priority = priority == prio_latency ? 6 : 1;
+	sock.set_option(asio::detail::socket_option::integer<SOL_SOCKET, SO_PRIORITY>(so_priority), ec);
+	if (ec) LOG_F(WARNING, "Could not set SO_PRIORITY: %s", ec.message().c_str());
+#endif
+}
 
 double lsl::measure_endian_performance() {
-	const double measure_duration = 0.01;
-	const double t_end = lsl_clock() + measure_duration;
-	uint64_t data = 0x01020304;
-	double k;
-	for (k = 0; ((int)k & 0xFF) != 0 || lsl_clock() < t_end; k++)
-		lslboost::endian::endian_reverse_inplace(data);
-	return k;
+	// measured once: each connection would wait for it otherwise, and the outlet's choice of the
+	// byte order (and so an inlet's validated format agreement) stays the same across reconnects
+	static const double performance = []() {
+		const double measure_duration = 0.01;
+		const double t_end = lsl_clock() + measure_duration;
+		uint64_t data = 0x01020304;
+		double k;
+		for (k = 0; ((int)k & 0xFF) != 0 || lsl_clock() < t_end; k++)
+			lslboost::endian::endian_reverse_inplace(data);
+		return k;
+	}();
+	return performance;
 }
 
 template <typename Socket, typename Protocol>
 uint16_t bind_port_in_range_(Socket &sock, Protocol protocol) {
 	const auto *cfg = lsl::api_config::get_instance();
+	// Where the next search starts (as offset into the port range) for each address family.
+	// Sockets are usually bound one after another, so the ports before it are most likely held
+	// by this process already and the search starts right after the port bound last. Ports that
+	// were released in the meantime are found once the search wraps around.
+	static std::atomic<uint32_t> next_offset[2];
+	std::atomic<uint32_t> &hint = next_offset[protocol == Protocol::v6() ? 1 : 0];
+	const uint32_t range = cfg->port_range(), start = range ? hint % range : 0;
 	lslboost::system::error_code ec;
-	for (uint16_t port = cfg->base_port(), e = port + cfg->port_range(); port < e; port++) {
+	for (uint32_t k = 0; k < range; k++) {
+		const uint32_t offset = (start + k) % range;
+		const auto port = static_cast<uint16_t>(cfg->base_port() + offset);
 		sock.bind(typename Protocol::endpoint(protocol, port), ec);
 		if (ec == lslboost::system::errc::address_in_use) continue;
-		if (!ec) return port;
+		if (!ec) {
+			hint = offset + 1;
+			return port;
+		}
 	}
 	if (cfg->allow_random_ports()) {
 		for (int k = 0; k < 100; ++k) {
@@ -45,10 +138,236 @@ uint16_t lsl::bind_port_in_range(asio::ip::udp::socket &sock, asio::ip::udp prot
 	return port;
 }
 
+void lsl::open_multicast_socket(asio::ip::udp::socket &sock, const asio::ip::address &address,
+	uint16_t port, int ttl, const std::string &listen_address) {
+	namespace ip = asio::ip;
+	bool is_broadcast = address == ip::address_v4::broadcast();
+
+	// set up the endpoint where we listen (note: this is not yet the multicast address)
+	ip::udp::endpoint listen_endpoint;
+	if (listen_address.empty()) {
+		// pick the default endpoint
+		if (address.is_v4())
+			listen_endpoint = ip::udp::endpoint(ip::udp::v4(), port);
+		else
+			listen_endpoint = ip::udp::endpoint(ip::udp::v6(), port);
+	} else {
+		// choose an endpoint explicitly
+		ip::address listen_addr = ip::make_address(listen_address);
+		listen_endpoint = ip::udp::endpoint(listen_addr, (uint16_t)port);
+	}
+
+	// open the socket and make sure that we can reuse the address, and bind it
+	sock.open(listen_endpoint.protocol());
+	sock.set_option(ip::udp::socket::reuse_address(true));
+
+	// set the multicast TTL
+	if (address.is_multicast() && !is_broadcast) sock.set_option(ip::multicast::hops(ttl));
+
+	// bind to the listen endpoint
+	sock.bind(listen_endpoint);
+
+	// join the multicast group, if any
+	if (address.is_multicast() && !is_broadcast) {
+		if (address.is_v4())
+			sock.set_option(
+				ip::multicast::join_group(address.to_v4(), listen_endpoint.address().to_v4()));
+		else
+			sock.set_option(ip::multicast::join_group(address));
+	}
+}
+
+bool lsl::enable_receive_timestamps(asio::ip::udp::socket &sock) {
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+	int enable = 1;
+	return setsockopt(
+			   sock.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+#else
+	(void)sock;
+	return false;
+#endif
+}
+
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+/// The control message space for a SCM_TIMESTAMPNS time stamp.
+union timestamp_control {
+	cmsghdr align;
+	char buf[CMSG_SPACE(sizeof(timespec))];
+};
+
+/// The time a datagram was received (lsl_clock() time) from its control messages, or now if it
+/// has no (usable) time stamp.
+static double kernel_receive_time(msghdr &msg, double now) {
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) continue;
+		// the time stamp is in CLOCK_REALTIME, so its age is subtracted from the lsl_clock() time
+		timespec stamp, realtime;
+		std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+		clock_gettime(CLOCK_REALTIME, &realtime);
+		const double age = static_cast<double>(realtime.tv_sec - stamp.tv_sec) +
+						   static_cast<double>(realtime.tv_nsec - stamp.tv_nsec) * 1e-9;
+		// a time stamp from before a clock adjustment is of no use
+		if (age >= 0.0 && age < 1.0) return now - age;
+	}
+	return now;
+}
+#endif
+
+std::size_t lsl::receive_timestamped(asio::ip::udp::socket &sock, asio::mutable_buffer buffer,
+	asio::ip::udp::endpoint &sender, double &received_at, lslboost::system::error_code &ec) {
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+	iovec iov{buffer.data(), buffer.size()};
+	timestamp_control control;
+	msghdr msg{};
+	msg.msg_name = sender.data();
+	msg.msg_namelen = static_cast<socklen_t>(sender.capacity());
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	const ssize_t len = recvmsg(sock.native_handle(), &msg, MSG_DONTWAIT);
+	received_at = lsl_clock();
+	if (len < 0) {
+		ec.assign(errno, lslboost::system::system_category());
+		return 0;
+	}
+	ec.clear();
+	sender.resize(msg.msg_namelen);
+	received_at = kernel_receive_time(msg, received_at);
+	return static_cast<std::size_t>(len);
+#else
+	received_at = lsl_clock();
+	return sock.receive_from(asio::buffer(buffer), sender, 0, ec);
+#endif
+}
+
+bool lsl::datagram_batches_supported() {
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::vector<lsl::received_datagram> lsl::make_datagram_batch() {
+	std::vector<received_datagram> batch(datagram_batches_supported() ? max_datagram_batch : 1);
+	batch[0].buffer.resize(65536);
+	for (std::size_t k = 1; k < batch.size(); ++k) batch[k].buffer.resize(8192);
+	return batch;
+}
+
+std::size_t lsl::receive_batch(asio::ip::udp::socket &sock, std::vector<received_datagram> &batch,
+	bool timestamps, lslboost::system::error_code &ec) {
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+	const std::size_t n = std::min(batch.size(), max_datagram_batch);
+	iovec iovs[max_datagram_batch];
+	timestamp_control controls[max_datagram_batch];
+	mmsghdr msgs[max_datagram_batch];
+	std::memset(msgs, 0, sizeof(msgs));
+	for (std::size_t k = 0; k < n; ++k) {
+		iovs[k] = iovec{batch[k].buffer.data(), batch[k].buffer.size()};
+		msghdr &msg = msgs[k].msg_hdr;
+		msg.msg_name = batch[k].sender.data();
+		msg.msg_namelen = static_cast<socklen_t>(batch[k].sender.capacity());
+		msg.msg_iov = &iovs[k];
+		msg.msg_iovlen = 1;
+		if (timestamps) {
+			msg.msg_control = controls[k].buf;
+			msg.msg_controllen = sizeof(controls[k].buf);
+		}
+	}
+	const int received =
+		recvmmsg(sock.native_handle(), msgs, static_cast<unsigned>(n), MSG_DONTWAIT, nullptr);
+	const double now = lsl_clock();
+	if (received < 0) {
+		ec.assign(errno, lslboost::system::system_category());
+		return 0;
+	}
+	ec.clear();
+	for (int k = 0; k < received; ++k) {
+		received_datagram &datagram = batch[k];
+		msghdr &msg = msgs[k].msg_hdr;
+		datagram.sender.resize(msg.msg_namelen);
+		datagram.size = msgs[k].msg_len;
+		datagram.truncated = (msg.msg_flags & MSG_TRUNC) != 0;
+		datagram.received_at = timestamps ? kernel_receive_time(msg, now) : now;
+	}
+	return static_cast<std::size_t>(received);
+#else
+	received_datagram &datagram = batch.front();
+	if (timestamps)
+		datagram.size = receive_timestamped(sock, asio::buffer(datagram.buffer), datagram.sender,
+			datagram.received_at, ec);
+	else {
+		datagram.size = sock.receive_from(asio::buffer(datagram.buffer), datagram.sender, 0, ec);
+		datagram.received_at = lsl_clock();
+	}
+	datagram.truncated = false;
+	return ec ? 0 : 1;
+#endif
+}
+
+std::size_t lsl::send_batch(asio::ip::udp::socket &sock, const outgoing_datagram *datagrams,
+	std::size_t count, lslboost::system::error_code &ec) {
+	ec.clear();
+	std::size_t sent = 0;
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+	iovec iovs[max_datagram_batch];
+	mmsghdr msgs[max_datagram_batch];
+	while (sent < count) {
+		const std::size_t n = std::min(count - sent, max_datagram_batch);
+		std::memset(msgs, 0, sizeof(msgs));
+		for (std::size_t k = 0; k < n; ++k) {
+			const outgoing_datagram &datagram = datagrams[sent + k];
+			iovs[k] = iovec{const_cast<void *>(datagram.payload.data()), datagram.payload.size()};
+			msgs[k].msg_hdr.msg_name = const_cast<void *>(
+				static_cast<const void *>(datagram.endpoint.data()));
+			msgs[k].msg_hdr.msg_namelen = static_cast<socklen_t>(datagram.endpoint.size());
+			msgs[k].msg_hdr.msg_iov = &iovs[k];
+			msgs[k].msg_hdr.msg_iovlen = 1;
+		}
+		const int result =
+			sendmmsg(sock.native_handle(), msgs, static_cast<unsigned>(n), MSG_DONTWAIT);
+		// after a partial send, the next call reports the error of the datagram that failed
+		if (result < 0) {
+			ec.assign(errno, lslboost::system::system_category());
+			break;
+		}
+		sent += static_cast<std::size_t>(result);
+	}
+#else
+	for (; sent < count; ++sent) {
+		sock.send_to(asio::buffer(datagrams[sent].payload), datagrams[sent].endpoint, 0, ec);
+		if (ec) break;
+	}
+#endif
+	return sent;
+}
+
 uint16_t lsl::bind_and_listen_to_port_in_range(
 	asio::ip::tcp::acceptor &acc, asio::ip::tcp protocol, int backlog) {
 	uint16_t port = bind_port_in_range_(acc, protocol);
 	if (!port) throw std::runtime_error(all_ports_bound_msg);
 	acc.listen(backlog);
+#if defined(__linux__) && defined(TCP_FASTOPEN)
+	if (lsl::api_config::get_instance()->tcp_fast_open()) {
+		// the queue of connections whose SYN data is pending
+		lslboost::system::error_code ec;
+		acc.set_option(
+			asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>(backlog), ec);
+		if (ec) LOG_F(WARNING, "Could not enable TCP Fast Open: %s", ec.message().c_str());
+	}
+#endif
 	return port;
 }
+
+void lsl::enable_fast_open_connect(asio::ip::tcp::socket &sock) {
+#if defined(__linux__) && defined(TCP_FASTOPEN_CONNECT)
+	lslboost::system::error_code ec;
+	sock.set_option(
+		asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>(true), ec);
+	if (ec) LOG_F(WARNING, "Could not enable TCP Fast Open: %s", ec.message().c_str());
+#else
+	(void)sock;
+#endif
+}
@@ -1,8 +1,12 @@
 #ifndef SOCKET_UTILS_H
 #define SOCKET_UTILS_H
 
+#include "common.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace asio = lslboost::asio;
 
@@ -11,14 +15,146 @@ inline asio::chrono::milliseconds timeout_sec(double timeout_seconds) {
 	return asio::chrono::milliseconds(static_cast<unsigned int>(1000 * timeout_seconds));
 }
 
-/// Bind a socket to a free port in the configured port range or throw an error otherwise.
+/// Tuning options of the data connections' TCP sockets (see api_config for the defaults).
+struct socket_options {
+	/// SO_SNDBUF / SO_RCVBUF in bytes (0 to keep the system default)
+	int32_t send_buffer_bytes{0}, receive_buffer_bytes{0};
+	/// whether Nagle's algorithm is disabled (TCP_NODELAY)
+	bool no_delay{true};
+	/// SO_BUSY_POLL in microseconds (0 to disable, only supported on Linux)
+	int32_t busy_poll_us{0};
+
+	/// The defaults from the configuration file.
+	static socket_options from_config();
+
+	/// A copy with the given fields replaced; negative values keep the current setting.
+	socket_options updated(int32_t send_buffer_bytes, int32_t receive_buffer_bytes,
+		int32_t no_delay, int32_t busy_poll_us) const;
+};
+
+/**
+ * Apply the socket options to an open socket.
+ *
+ * Options the system rejects (e.g. busy polling without the required privileges) are logged and
+ * skipped, since the connection works without them.
+ */
+void apply_socket_options(asio::ip::tcp::socket &sock, const socket_options &opts);
+
+/**
+ * Mark the packets of a connection with its priority class for the network: the DSCP code point
+ * (EF for latency, CS1 for bulk traffic) and, on Linux, SO_PRIORITY for the local queueing
+ * discipline. Normal connections are left unmarked; errors are logged.
+ */
+void mark_socket_priority(asio::ip::tcp::socket &sock, lsl_transfer_priority_t priority);
+
+/**
+ * Send the first data written to an open, unconnected socket in the SYN of its connection if the
+ * server accepted TCP Fast Open connections from this host before (on Linux, see
+ * api_config::tcp_fast_open()). Errors are logged and ignored, the connection is made as usual.
+ */
+void enable_fast_open_connect(asio::ip::tcp::socket &sock);
+
+/**
+ * Bind a socket to a free port in the configured port range or throw an error otherwise.
+ *
+ * The search starts after the port that was bound last for the protocol, so creating many
+ * outlets doesn't try all ports held by the previous ones again.
+ */
 uint16_t bind_port_in_range(asio::ip::udp::socket &sock, asio::ip::udp protocol);
 
-/// Bind and listen to an acceptor on a free port in the configured port range or throw an error.
+/**
+ * Bind and listen to an acceptor on a free port in the configured port range or throw an error.
+ *
+ * The acceptor takes TCP Fast Open connections if api_config::tcp_fast_open() is set.
+ */
 uint16_t bind_and_listen_to_port_in_range(
 	asio::ip::tcp::acceptor &acc, asio::ip::tcp protocol, int backlog);
 
-/// Measure the endian conversion performance of this machine.
+/**
+ * Open a socket, bind it to a multicast (or broadcast) port and join the multicast group, if any.
+ * @param address The multicast or broadcast address.
+ * @param listen_address The local address to listen on (empty for any address).
+ */
+void open_multicast_socket(asio::ip::udp::socket &sock, const asio::ip::address &address,
+	uint16_t port, int ttl, const std::string &listen_address);
+
+/**
+ * Ask the kernel to time stamp the datagrams received by a socket.
+ *
+ * This is only supported on Linux (SO_TIMESTAMPNS) for now.
+ * @return Whether received datagrams will carry a time stamp.
+ */
+bool enable_receive_timestamps(asio::ip::udp::socket &sock);
+
+/**
+ * Receive a datagram that's ready to be read, along with the time it arrived.
+ *
+ * Use this after the socket became readable (e.g., after an async_wait()).
+ * @param[out] received_at The time the kernel received the datagram (converted to lsl_clock()
+ * time) if it's available, the current lsl_clock() otherwise.
+ * @return The size of the datagram or 0 on errors, which are stored in ec.
+ */
+std::size_t receive_timestamped(asio::ip::udp::socket &sock, asio::mutable_buffer buffer,
+	asio::ip::udp::endpoint &sender, double &received_at, lslboost::system::error_code &ec);
+
+/// Whether receive_batch() and send_batch() handle several datagrams per system call (on Linux).
+bool datagram_batches_supported();
+
+/// The most datagrams that are received or sent with one system call.
+const std::size_t max_datagram_batch = 16;
+
+/// A slot of a batch of received datagrams, see receive_batch().
+struct received_datagram {
+	/// the memory the datagram is received into
+	std::vector<char> buffer;
+	/// the size of the datagram
+	std::size_t size{0};
+	/// whether the datagram was larger than the buffer (and cut off)
+	bool truncated{false};
+	asio::ip::udp::endpoint sender;
+	/// the time it arrived (see receive_timestamped())
+	double received_at{0.0};
+};
+
+/**
+ * Allocate the slots for receive_batch().
+ *
+ * The first one holds any datagram (64 KiB), the other ones 8 KiB, which is plenty for the
+ * queries and replies of the discovery and the time synchronization.
+ */
+std::vector<received_datagram> make_datagram_batch();
+
+/**
+ * Receive the datagrams that are ready to be read, one per slot, with a single system call
+ * (recvmmsg) where supported and only one datagram otherwise.
+ *
+ * Use this after the socket became readable (e.g., after an async_wait()).
+ * @param timestamps Whether the kernel time stamps the datagrams (see enable_receive_timestamps()).
+ * @return The number of datagrams (at the front of the batch) or 0 on errors, which are stored in
+ * ec.
+ */
+std::size_t receive_batch(asio::ip::udp::socket &sock, std::vector<received_datagram> &batch,
+	bool timestamps, lslboost::system::error_code &ec);
+
+/// A datagram to send with send_batch(); the payload isn't copied.
+struct outgoing_datagram {
+	asio::ip::udp::endpoint endpoint;
+	asio::const_buffer payload;
+};
+
+/**
+ * Send datagrams with a single system call (sendmmsg) where supported, with one call per datagram
+ * otherwise.
+ *
+ * The send doesn't block where batches are supported, so it stops with a would_block error when
+ * the socket's send buffer is full; wait until the socket is writable and send the rest then.
+ * @return The number of datagrams (from the front) that were sent. If it's fewer than count, the
+ * the error of the next datagram is stored in ec.
+ */
+std::size_t send_batch(asio::ip::udp::socket &sock, const outgoing_datagram *datagrams,
+	std::size_t count, lslboost::system::error_code &ec);
+
+/// Measure the endian conversion performance of this machine (once, later calls return it).
 double measure_endian_performance();
 } // namespace lsl
 
@@ -0,0 +1,185 @@
+#include "spill_file.h"
+#include "sample.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using namespace lsl;
+
+/// the size of the blocks that are written and read
+static const std::size_t block_bytes = 256 << 10;
+/// the maximum size of a segment
+static const uint64_t max_segment_bytes = 64 << 20;
+
+/// the flags in the first byte of a serialized sample
+enum spill_flags : uint8_t { spill_valid = 1, spill_pushthrough = 2 };
+
+spill_file::spill_file(factory_p factory, std::string path_prefix, uint64_t max_bytes)
+	: factory_(std::move(factory)), path_prefix_(std::move(path_prefix)), max_bytes_(max_bytes),
+	  segment_bytes_(std::min(max_segment_bytes, std::max<uint64_t>(max_bytes / 8, block_bytes))) {}
+
+spill_file::~spill_file() {
+	for (auto &seg : segments_) remove_segment(seg);
+}
+
+template <typename T> static void put(std::vector<char> &out, const T &value) {
+	const char *bytes = reinterpret_cast<const char *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+bool spill_file::append(const sample_p &s) {
+	uint64_t size = 1;
+	if (s) {
+		size += sizeof(s->timestamp) + sizeof(s->seq);
+		if (s->format() == cft_string)
+			for (uint32_t k = 0; k < s->num_channels(); ++k)
+				size += sizeof(uint32_t) + s->string_data()[k].size();
+		else
+			size += s->datasize();
+	}
+	if (bytes_ + size > max_bytes_) return false;
+
+	if (start_segment_) {
+		flush_writes();
+		const std::string path = path_prefix_ + '.' + std::to_string(next_segment_++);
+		FILE *file = fopen(path.c_str(), "w+b");
+		if (!file)
+			throw std::runtime_error(
+				"Could not create the spill file " + path + ": " + std::strerror(errno));
+		// the blocks are buffered in write_buf_ and read_buf_
+		setvbuf(file, nullptr, _IONBF, 0);
+		segments_.push_back(segment{path, file, 0});
+		start_segment_ = false;
+	}
+
+	if (!s)
+		put<uint8_t>(write_buf_, 0);
+	else {
+		put<uint8_t>(write_buf_, spill_valid | (s->pushthrough ? spill_pushthrough : 0));
+		put(write_buf_, s->timestamp);
+		put(write_buf_, s->seq);
+		if (s->format() == cft_string)
+			for (uint32_t k = 0; k < s->num_channels(); ++k) {
+				const std::string &str = s->string_data()[k];
+				put(write_buf_, static_cast<uint32_t>(str.size()));
+				write_buf_.insert(write_buf_.end(), str.begin(), str.end());
+			}
+		else
+			write_buf_.insert(write_buf_.end(), s->raw_data(), s->raw_data() + s->datasize());
+	}
+	++count_;
+	bytes_ += size;
+
+	if (segments_.back().size + write_buf_.size() >= segment_bytes_) {
+		flush_writes();
+		start_segment_ = true;
+	} else if (write_buf_.size() >= block_bytes)
+		flush_writes();
+	return true;
+}
+
+sample_p spill_file::read() {
+	uint8_t flags;
+	read_bytes(&flags, 1);
+	uint64_t size = 1;
+	sample_p result;
+	if (flags & spill_valid) {
+		double timestamp;
+		uint64_t seq;
+		read_bytes(&timestamp, sizeof(timestamp));
+		read_bytes(&seq, sizeof(seq));
+		size += sizeof(timestamp) + sizeof(seq);
+		result = factory_->new_sample(timestamp, (flags & spill_pushthrough) != 0);
+		result->seq = seq;
+		if (result->format() == cft_string) {
+			strings_.resize(result->num_channels());
+			for (auto &str : strings_) {
+				uint32_t len;
+				read_bytes(&len, sizeof(len));
+				str.resize(len);
+				if (len) read_bytes(&str[0], len);
+				size += sizeof(len) + len;
+			}
+			result->assign_moved(strings_.data());
+		} else {
+			payload_.resize(result->datasize());
+			read_bytes(payload_.data(), payload_.size());
+			result->assign_untyped(payload_.data());
+			size += payload_.size();
+		}
+	}
+	--count_;
+	bytes_ -= size;
+	if (!count_) clear();
+	return result;
+}
+
+std::size_t spill_file::clear() {
+	for (auto &seg : segments_) remove_segment(seg);
+	segments_.clear();
+	start_segment_ = true;
+	// give the buffers back, the queue might not spill again for a long time
+	std::vector<char>().swap(write_buf_);
+	std::vector<char>().swap(read_buf_);
+	read_pos_ = 0;
+	read_offset_ = 0;
+	const std::size_t discarded = count_;
+	count_ = 0;
+	bytes_ = 0;
+	return discarded;
+}
+
+void spill_file::flush_writes() {
+	if (write_buf_.empty()) return;
+	segment &seg = segments_.back();
+	if (fseek(seg.file, static_cast<long>(seg.size), SEEK_SET) != 0 ||
+		fwrite(write_buf_.data(), 1, write_buf_.size(), seg.file) != write_buf_.size())
+		throw std::runtime_error("Could not write to the spill file " + seg.path + ": " +
+								 std::strerror(errno));
+	seg.size += write_buf_.size();
+	write_buf_.clear();
+}
+
+void spill_file::read_bytes(void *dst, std::size_t n) {
+	char *out = static_cast<char *>(dst);
+	while (n) {
+		if (read_pos_ == read_buf_.size()) refill();
+		const std::size_t k = std::min(n, read_buf_.size() - read_pos_);
+		memcpy(out, &read_buf_[read_pos_], k);
+		read_pos_ += k;
+		out += k;
+		n -= k;
+	}
+}
+
+void spill_file::refill() {
+	while (!segments_.empty()) {
+		segment &seg = segments_.front();
+		// the last segment might still have data in the write buffer
+		if (segments_.size() == 1 && read_offset_ == seg.size) flush_writes();
+		if (read_offset_ < seg.size) {
+			const auto n =
+				static_cast<std::size_t>(std::min<uint64_t>(block_bytes, seg.size - read_offset_));
+			read_buf_.resize(n);
+			if (fseek(seg.file, static_cast<long>(read_offset_), SEEK_SET) != 0 ||
+				fread(read_buf_.data(), 1, n, seg.file) != n)
+				throw std::runtime_error("Could not read from the spill file " + seg.path + ": " +
+										 std::strerror(errno));
+			read_offset_ += n;
+			read_pos_ = 0;
+			return;
+		}
+		if (segments_.size() == 1) break;
+		// all samples of the segment were read
+		remove_segment(seg);
+		segments_.pop_front();
+		read_offset_ = 0;
+	}
+	throw std::runtime_error("The spill file " + path_prefix_ + " is truncated.");
+}
+
+void spill_file::remove_segment(segment &seg) {
+	fclose(seg.file);
+	std::remove(seg.path.c_str());
+}
@@ -0,0 +1,107 @@
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H
+
+#include "forward.h"
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * An append-only FIFO of samples on disk, for consumer queues that overflow (see
+ * consumer_queue).
+ *
+ * The samples are serialized into segment files of a few MiB that are written and read
+ * sequentially in large blocks, so only the two block buffers are held in memory. A segment is
+ * deleted as soon as all of its samples were read, and all of them once the file is empty.
+ * The samples that are read are allocated from the factory of the queue's stream.
+ * @note Not thread-safe, the consumer queue serializes the calls.
+ */
+class spill_file {
+public:
+	/**
+	 * Create a spill file; the segments are only created once samples are appended.
+	 * @param factory The factory the samples are read into.
+	 * @param path_prefix The path of the segment files, without the segment number.
+	 * @param max_bytes The maximum number of bytes the unread samples may occupy.
+	 */
+	spill_file(factory_p factory, std::string path_prefix, uint64_t max_bytes);
+
+	/// Destructor. Deletes the segment files.
+	~spill_file();
+
+	spill_file(const spill_file &) = delete;
+	spill_file &operator=(const spill_file &) = delete;
+
+	/**
+	 * Append a sample (which may be an empty sentinel).
+	 * @return false if max_bytes would be exceeded.
+	 * @throws std::runtime_error if the sample couldn't be written.
+	 */
+	bool append(const sample_p &s);
+
+	/**
+	 * Read the oldest sample, which must exist (see empty()).
+	 * @throws std::runtime_error if the sample couldn't be read.
+	 */
+	sample_p read();
+
+	/// Whether all samples have been read.
+	bool empty() const { return count_ == 0; }
+
+	/// Discard all samples and delete the segment files, return the number of discarded samples.
+	std::size_t clear();
+
+private:
+	/// A segment file.
+	struct segment {
+		std::string path;
+		FILE *file;
+		/// the number of bytes written to the file
+		uint64_t size;
+	};
+
+	/// Write the write buffer to the last segment.
+	void flush_writes();
+
+	/// Read n bytes, refilling the read buffer as needed.
+	void read_bytes(void *dst, std::size_t n);
+
+	/// Refill the read buffer from the first segment, deleting used up segments.
+	void refill();
+
+	/// Close and delete a segment file.
+	static void remove_segment(segment &seg);
+
+	factory_p factory_;
+	const std::string path_prefix_;
+	const uint64_t max_bytes_;
+	/// the size at which a segment is completed and the next one is started
+	const uint64_t segment_bytes_;
+	/// the segments, from the one being read to the one being written
+	std::deque<segment> segments_;
+	/// the number of the next segment
+	uint64_t next_segment_{0};
+	/// whether the next sample is appended to a new segment
+	bool start_segment_{true};
+	/// the data to be appended to the last segment
+	std::vector<char> write_buf_;
+	/// the data read from the first segment, and the position of the next unread byte in it
+	std::vector<char> read_buf_;
+	std::size_t read_pos_{0};
+	/// the offset in the first segment up to which data was read into read_buf_
+	uint64_t read_offset_{0};
+	/// the number and size of the unread samples
+	std::size_t count_{0};
+	uint64_t bytes_{0};
+	/// reused for the channels of string samples that are read
+	std::vector<std::string> strings_;
+	std::vector<char> payload_;
+};
+
+} // namespace lsl
+
+#endif
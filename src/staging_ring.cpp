@@ -0,0 +1,70 @@
+#include "staging_ring.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <loguru.hpp>
+
+using namespace lsl;
+
+/// how long (in seconds) the worker sleeps if it isn't woken up by a record; a record that's
+/// committed while the worker goes to sleep is consumed after this interval
+static const double staging_poll_interval = 0.005;
+
+static std::size_t round_to_granularity(std::size_t bytes) {
+	const std::size_t unit = mirrored_memory::granularity();
+	return std::max<std::size_t>((bytes + unit - 1) / unit, 1) * unit;
+}
+
+staging_ring::staging_ring(std::size_t min_bytes, const std::string &name, consumer consume)
+	: ring_(round_to_granularity(min_bytes)), consume_(std::move(consume)) {
+	thread_ = managed_thread(lsl_thread_transfer, name, &staging_ring::run, this);
+}
+
+staging_ring::~staging_ring() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	thread_.join();
+	drain();
+}
+
+void staging_ring::flush() {
+	const uint64_t target = head_.load(std::memory_order_acquire);
+	std::unique_lock<std::mutex> lock(mut_);
+	cv_.notify_one();
+	drained_.wait(lock, [&]() { return stop_ || tail_.load(std::memory_order_acquire) >= target; });
+}
+
+void staging_ring::run() {
+	std::unique_lock<std::mutex> lock(mut_);
+	while (!stop_) {
+		lock.unlock();
+		drain();
+		lock.lock();
+		drained_.notify_all();
+		idle_.store(true, std::memory_order_seq_cst);
+		// a record committed before idle_ was set doesn't wake us up
+		if (head_.load(std::memory_order_seq_cst) == tail_.load(std::memory_order_relaxed) &&
+			!stop_)
+			cv_.wait_for(lock, std::chrono::duration<double>(staging_poll_interval));
+		idle_.store(false, std::memory_order_relaxed);
+	}
+}
+
+void staging_ring::drain() {
+	uint64_t tail = tail_.load(std::memory_order_relaxed);
+	const uint64_t head = head_.load(std::memory_order_acquire);
+	while (tail != head) {
+		const char *pos = ring_.data() + tail % ring_.size();
+		const auto bytes = static_cast<std::size_t>(*reinterpret_cast<const uint64_t *>(pos));
+		try {
+			consume_(pos + header_bytes, bytes);
+		} catch (std::exception &e) {
+			LOG_F(WARNING, "Error while processing a staged record: %s", e.what());
+		}
+		tail += record_size(bytes);
+		tail_.store(tail, std::memory_order_release);
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include "mirrored_memory.h"
+#include "thread_policy.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace lsl {
+
+/**
+ * A ring of variable-sized records that one thread writes without locks or allocations and a
+ * worker thread of the ring hands to a function, e.g. to move the conversion and distribution
+ * of pushed samples off a driver's callback thread (see stream_outlet_impl::set_async_push()).
+ *
+ * The records are written with reserve() and commit() from one thread at a time. The ring is
+ * mirrored memory, so a record is contiguous even if it wraps around the end of the ring.
+ */
+class staging_ring {
+public:
+	/// Called from the worker with each committed record.
+	using consumer = std::function<void(const char *record, std::size_t bytes)>;
+
+	/**
+	 * Start the worker.
+	 * @param min_bytes The size of the ring, rounded up to mirrored_memory::granularity().
+	 * @param name The name of the worker thread.
+	 */
+	staging_ring(std::size_t min_bytes, const std::string &name, consumer consume);
+
+	/// Consume the remaining records and stop the worker.
+	~staging_ring();
+
+	staging_ring(const staging_ring &) = delete;
+	staging_ring &operator=(const staging_ring &) = delete;
+
+	/**
+	 * Reserve room for a record.
+	 * @return Where to write the record, or nullptr if the ring doesn't have enough room.
+	 */
+	char *reserve(std::size_t bytes) {
+		const std::size_t needed = record_size(bytes);
+		const uint64_t head = head_.load(std::memory_order_relaxed);
+		if (needed > ring_.size() - (head - tail_.load(std::memory_order_acquire)))
+			return nullptr;
+		char *pos = ring_.data() + head % ring_.size();
+		*reinterpret_cast<uint64_t *>(pos) = bytes;
+		return pos + header_bytes;
+	}
+
+	/// Hand the record written after the last reserve() to the worker.
+	void commit() {
+		const uint64_t head = head_.load(std::memory_order_relaxed);
+		const auto bytes = *reinterpret_cast<const uint64_t *>(ring_.data() + head % ring_.size());
+		head_.store(head + record_size(bytes), std::memory_order_seq_cst);
+		// a busy worker doesn't need to be woken up
+		if (idle_.load(std::memory_order_seq_cst)) cv_.notify_one();
+	}
+
+	/// Wait until the worker has consumed the records committed so far.
+	void flush();
+
+	/// The size of the ring in bytes.
+	std::size_t capacity() const { return ring_.size(); }
+
+private:
+	/// the size of the header in front of each record (its size)
+	static constexpr std::size_t header_bytes = sizeof(uint64_t);
+
+	/// the space a record takes in the ring, with its header and padded to the header's alignment
+	static std::size_t record_size(std::size_t bytes) {
+		return header_bytes + (bytes + header_bytes - 1) / header_bytes * header_bytes;
+	}
+
+	/// The worker thread.
+	void run();
+
+	/// Consume the committed records.
+	void drain();
+
+	mirrored_memory ring_;
+	consumer consume_;
+	/// the position after the last committed record and after the last consumed one
+	alignas(64) std::atomic<uint64_t> head_{0};
+	alignas(64) std::atomic<uint64_t> tail_{0};
+	/// whether the worker is about to wait for records
+	std::atomic<bool> idle_{false};
+	std::mutex mut_;
+	/// wakes up the worker when a record is committed or the ring is destroyed
+	std::condition_variable cv_;
+	/// signaled when the worker has consumed records
+	std::condition_variable drained_;
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
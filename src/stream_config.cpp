@@ -0,0 +1,26 @@
+#include "stream_config.h"
+#include "api_config.h"
+
+using namespace lsl;
+
+stream_config::stream_config(const api_config &cfg)
+	: force_default_timestamps(cfg.force_default_timestamps()),
+	  deduced_timestamps_max(cfg.deduced_timestamps_max()),
+	  deduced_timestamps_tolerance(cfg.deduced_timestamps_tolerance()),
+	  use_protocol_version(cfg.use_protocol_version()), async_transfer(cfg.async_transfer()),
+	  park_idle_seconds(cfg.park_idle_seconds()),
+	  chunk_max_latency_us(cfg.chunk_max_latency_us()), chunk_max_bytes(cfg.chunk_max_bytes()),
+	  adaptive_chunking(cfg.adaptive_chunking()),
+	  zerocopy_send_min_bytes(cfg.zerocopy_send_min_bytes()), lock_memory(cfg.lock_memory()),
+	  no_allocation(cfg.no_allocation()), priority_marking(cfg.priority_marking()),
+	  session_max_bytes_per_second(cfg.session_max_bytes_per_second()),
+	  delta_encoding(cfg.delta_encoding()), sample_framing(cfg.sample_framing()),
+	  changed_channel_encoding(cfg.changed_channel_encoding()),
+	  timestamp_deltas(cfg.timestamp_deltas()), gap_detection(cfg.gap_detection()),
+	  heartbeat_interval(cfg.heartbeat_interval()),
+	  foreign_byte_order(cfg.foreign_byte_order()),
+	  inlet_receive_buffer_max_bytes(cfg.inlet_receive_buffer_max_bytes()) {}
+
+std::shared_ptr<const stream_config> stream_config::current() {
+	return std::make_shared<const stream_config>(*api_config::get_instance());
+}
@@ -0,0 +1,61 @@
+#ifndef STREAM_CONFIG_H
+#define STREAM_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace lsl {
+class api_config;
+
+/**
+ * The settings of api_config that a stream reads while it transfers samples, copied once.
+ *
+ * Each outlet and inlet takes a snapshot when it's created and hands it to its servers and
+ * sessions, so the per-sample and per-chunk paths read plain members instead of calling
+ * api_config::get_instance() (and passing its static initialization guard) every time. A stream
+ * can be given a modified copy to override settings for it alone; changes after construction
+ * are pushed explicitly (see stream_outlet_impl::set_config()). See api_config for the meaning
+ * of the settings.
+ */
+struct stream_config {
+	/// Copy the settings of a configuration.
+	explicit stream_config(const api_config &cfg);
+
+	/// A snapshot of the process' configuration.
+	static std::shared_ptr<const stream_config> current();
+
+	// --- outlets ---
+	bool force_default_timestamps;
+	int deduced_timestamps_max;
+	double deduced_timestamps_tolerance;
+
+	// --- the outlets' client sessions ---
+	int use_protocol_version;
+	bool async_transfer;
+	double park_idle_seconds;
+	int32_t chunk_max_latency_us;
+	std::size_t chunk_max_bytes;
+	bool adaptive_chunking;
+	std::size_t zerocopy_send_min_bytes;
+	bool lock_memory;
+	bool no_allocation;
+	bool priority_marking;
+	double session_max_bytes_per_second;
+
+	// --- inlets ---
+	bool delta_encoding;
+	bool sample_framing;
+	bool changed_channel_encoding;
+	bool timestamp_deltas;
+	bool gap_detection;
+	double heartbeat_interval;
+	bool foreign_byte_order;
+	std::size_t inlet_receive_buffer_max_bytes;
+};
+
+using stream_config_p = std::shared_ptr<const stream_config>;
+
+} // namespace lsl
+
+#endif
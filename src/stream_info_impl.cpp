@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <cctype>
+#include <cstring>
 #include <loguru.hpp>
 #include <sstream>
 #include <utility>
@@ -15,9 +17,10 @@ using lsl::to_string;
 
 stream_info_impl::stream_info_impl()
 	: channel_count_(0), nominal_srate_(0), channel_format_(cft_undefined), version_(0),
-	  v4data_port_(0), v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0) {
+	  v4data_port_(0), v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0),
+	  doc_(std::make_shared<info_document>()) {
 	// initialize XML document
-	write_xml(doc_);
+	write_xml(doc_->doc);
 }
 
 stream_info_impl::stream_info_impl(const std::string &name, std::string type, int channel_count,
@@ -26,17 +29,18 @@ stream_info_impl::stream_info_impl(const std::string &name, std::string type, in
 	  nominal_srate_(nominal_srate), channel_format_(channel_format),
 	  source_id_(std::move(source_id)),
 	  version_(api_config::get_instance()->use_protocol_version()), v4data_port_(0),
-	  v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0) {
+	  v4service_port_(0), v6data_port_(0), v6service_port_(0), created_at_(0),
+	  doc_(std::make_shared<info_document>()) {
 	if (name.empty()) throw std::invalid_argument("The name of a stream must be non-empty.");
 	if (channel_count < 0)
 		throw std::invalid_argument("The channel_count of a stream must be nonnegative.");
 	if (nominal_srate < 0)
 		throw std::invalid_argument("The nominal sampling rate of a stream must be nonnegative.");
-	if (channel_format < 0 || channel_format > 7)
+	if (channel_format < 0 || channel_format > cft_float16)
 		throw std::invalid_argument("The stream info was created with an unknown channel format " +
 									to_string(static_cast<int>(channel_format)));
 	// initialize XML document
-	write_xml(doc_);
+	write_xml(doc_->doc);
 }
 
 template <typename T> void append_text_node(xml_node &node, const char *name, const T &value) {
@@ -49,7 +53,8 @@ template <> void append_text_node(xml_node &node, const char *name, const std::s
 
 void stream_info_impl::write_xml(xml_document &doc) {
 	const char *channel_format_strings[] = {
-		"undefined", "float32", "double64", "string", "int32", "int16", "int8", "int64"};
+		"undefined", "float32", "double64", "string", "int32", "int16", "int8", "int64", "int24",
+		"float16"};
 	xml_node info = doc.append_child("info");
 	append_text_node(info, "name", name_);
 	append_text_node(info, "type", type_);
@@ -115,6 +120,10 @@ void stream_info_impl::read_xml(xml_document &doc) {
 			channel_format_ = cft_int8;
 		else if (fmt == "int64")
 			channel_format_ = cft_int64;
+		else if (fmt == "int24")
+			channel_format_ = cft_int24;
+		else if (fmt == "float16")
+			channel_format_ = cft_float16;
 		else
 			throw std::runtime_error("Invalid channel format " + fmt);
 
@@ -138,6 +147,7 @@ void stream_info_impl::read_xml(xml_document &doc) {
 		v6address_ = info.child_value("v6address");
 		get_bounded_child_val(info, "v6data_port", v6data_port_, 0, 65535);
 		get_bounded_child_val(info, "v6service_port", v6service_port_, 0, 65535);
+		touch();
 	} catch (std::exception &e) {
 		// reset the stream info to blank state
 		*this = stream_info_impl();
@@ -147,6 +157,126 @@ void stream_info_impl::read_xml(xml_document &doc) {
 
 // === Protocol Support Operations Implementation ===
 
+/// magic bytes at the start of a binary short-info message
+static const char binary_shortinfo_magic[] = "LSLb";
+static const std::size_t binary_shortinfo_magic_len = sizeof(binary_shortinfo_magic) - 1;
+
+/// append an unsigned integer in little endian byte order
+template <typename T> static void put_le(std::string &out, T val) {
+	for (std::size_t k = 0; k < sizeof(T); ++k) out.push_back(static_cast<char>(val >> (8 * k)));
+}
+
+static void put_double(std::string &out, double val) {
+	uint64_t bits;
+	std::memcpy(&bits, &val, sizeof(bits));
+	put_le(out, bits);
+}
+
+static void put_string(std::string &out, const std::string &val) {
+	if (val.size() > 0xFFFF) throw std::length_error("Short-info field too long: " + val);
+	put_le(out, static_cast<uint16_t>(val.size()));
+	out += val;
+}
+
+/// reads the fields of a binary short-info message in order
+class binary_reader {
+public:
+	explicit binary_reader(const std::string &m) : m_(m), pos_(binary_shortinfo_magic_len) {}
+
+	template <typename T> T get() {
+		need(sizeof(T));
+		T val = 0;
+		for (std::size_t k = 0; k < sizeof(T); ++k)
+			val |= static_cast<T>(static_cast<unsigned char>(m_[pos_++])) << (8 * k);
+		return val;
+	}
+
+	double get_double() {
+		const auto bits = get<uint64_t>();
+		double val;
+		std::memcpy(&val, &bits, sizeof(val));
+		return val;
+	}
+
+	std::string get_string() {
+		const auto len = get<uint16_t>();
+		need(len);
+		pos_ += len;
+		return m_.substr(pos_ - len, len);
+	}
+
+private:
+	void need(std::size_t n) const {
+		if (m_.size() - pos_ < n) throw std::runtime_error("Truncated binary short-info message.");
+	}
+
+	const std::string &m_;
+	std::size_t pos_;
+};
+
+std::string stream_info_impl::to_shortinfo_binary() const {
+	std::string out(binary_shortinfo_magic, binary_shortinfo_magic_len);
+	out.reserve(128 + name_.size() + type_.size() + source_id_.size() + hostname_.size());
+	put_string(out, name_);
+	put_string(out, type_);
+	put_le(out, channel_count_);
+	put_le(out, static_cast<uint8_t>(channel_format_));
+	put_double(out, nominal_srate_);
+	put_string(out, source_id_);
+	put_le(out, static_cast<uint32_t>(version_));
+	put_double(out, created_at_);
+	put_string(out, uid_);
+	put_string(out, session_id_);
+	put_string(out, hostname_);
+	put_string(out, v4address_);
+	put_le(out, v4data_port_);
+	put_le(out, v4service_port_);
+	put_string(out, v6address_);
+	put_le(out, v6data_port_);
+	put_le(out, v6service_port_);
+	return out;
+}
+
+void stream_info_impl::read_binary(const std::string &m) {
+	try {
+		binary_reader in(m);
+		name_ = in.get_string();
+		if (name_.empty())
+			throw std::runtime_error("Received a stream info with empty <name> field.");
+		type_ = in.get_string();
+		channel_count_ = in.get<uint32_t>();
+		const auto fmt = in.get<uint8_t>();
+		if (fmt < cft_float32 || fmt > cft_float16)
+			throw std::runtime_error("Invalid channel format " + to_string(static_cast<int>(fmt)));
+		channel_format_ = static_cast<lsl_channel_format_t>(fmt);
+		nominal_srate_ = in.get_double();
+		if (!(nominal_srate_ >= 0)) throw std::runtime_error("Invalid nominal sampling rate.");
+		source_id_ = in.get_string();
+		version_ = static_cast<int>(in.get<uint32_t>());
+		if (version_ <= 0)
+			throw std::runtime_error("The version of the given stream info is invalid.");
+		created_at_ = in.get_double();
+		uid_ = in.get_string();
+		if (uid_.empty()) throw std::runtime_error("The UID of the given stream info is empty.");
+		session_id_ = in.get_string();
+		hostname_ = in.get_string();
+		v4address_ = in.get_string();
+		v4data_port_ = in.get<uint16_t>();
+		v4service_port_ = in.get<uint16_t>();
+		v6address_ = in.get_string();
+		v6data_port_ = in.get<uint16_t>();
+		v6service_port_ = in.get<uint16_t>();
+		auto doc = std::make_shared<info_document>();
+		write_xml(doc->doc);
+		set_doc(std::move(doc));
+		touch();
+	} catch (std::exception &e) {
+		// reset the stream info to blank state
+		*this = stream_info_impl();
+		name_ = (std::string("(invalid: ") += e.what()) += ')';
+	}
+}
+
 std::string stream_info_impl::to_shortinfo_message() {
 	// make a new document (with an empty <desc> field)
 	xml_document tmp;
@@ -159,43 +289,385 @@ std::string stream_info_impl::to_shortinfo_message() {
 }
 
 void stream_info_impl::from_shortinfo_message(const std::string &m) {
+	if (m.compare(0, binary_shortinfo_magic_len, binary_shortinfo_magic) == 0)
+		return read_binary(m);
 	// load the doc from the message string
-	doc_.load_buffer(m.c_str(), m.size());
+	auto doc = std::make_shared<info_document>();
+	doc->doc.load_buffer(m.c_str(), m.size());
 	// and assign all the struct fields, too...
-	read_xml(doc_);
+	read_xml(doc->doc);
+	set_doc(std::move(doc));
 }
 
 std::string stream_info_impl::to_fullinfo_message() {
+	const auto doc = this->doc();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	parse_lazy_desc(*doc);
 	// write the doc to a stream
 	std::ostringstream os;
-	doc_.save(os);
+	doc->doc.save(os);
 	// and get the string
 	return os.str();
 }
 
-void stream_info_impl::from_fullinfo_message(const std::string &m) {
+std::string stream_info_impl::select_desc_subtrees(
+	const std::string &fullinfo, const std::vector<std::string> &desc_subtrees) {
+	xml_document doc;
+	doc.load_buffer(fullinfo.c_str(), fullinfo.size());
+	xml_node desc = doc.child("info").child("desc");
+	for (xml_node child = desc.first_child(), next; child; child = next) {
+		next = child.next_sibling();
+		if (std::find(desc_subtrees.begin(), desc_subtrees.end(), child.name()) ==
+			desc_subtrees.end())
+			desc.remove_child(child);
+	}
+	std::ostringstream os;
+	doc.save(os);
+	return os.str();
+}
+
+/// find the <desc> element in a full-info message so it can be parsed later
+/// @return false if there's no (non-empty) <desc> element
+static bool find_desc_element(const std::string &m, std::size_t &begin, std::size_t &end) {
+	begin = m.find("<desc");
+	if (begin == std::string::npos || begin + 5 >= m.size() || m[begin + 5] != '>') return false;
+	end = m.rfind("</desc>");
+	if (end == std::string::npos || end < begin) return false;
+	end += 7;
+	return true;
+}
+
+void stream_info_impl::from_fullinfo_message(const std::string &m, bool lazy_desc) {
+	std::size_t desc_begin, desc_end;
+	if (lazy_desc && find_desc_element(m, desc_begin, desc_end)) {
+		// parse only the fields (with an empty <desc>) and keep the <desc> element as text
+		std::string fields(m, 0, desc_begin);
+		fields.append("<desc />").append(m, desc_end, std::string::npos);
+		auto doc = std::make_shared<info_document>();
+		doc->doc.load_buffer(fields.c_str(), fields.size());
+		read_xml(doc->doc);
+		if (!uid_.empty()) doc->lazy_desc.assign(m, desc_begin, desc_end - desc_begin);
+		set_doc(std::move(doc));
+		return;
+	}
 	// load the doc from the message string
-	doc_.load_buffer(m.c_str(), m.size());
+	auto doc = std::make_shared<info_document>();
+	doc->doc.load_buffer(m.c_str(), m.size());
 	// and assign all the struct fields, too...
-	read_xml(doc_);
+	read_xml(doc->doc);
+	set_doc(std::move(doc));
+}
+
+void stream_info_impl::parse_lazy_desc(info_document &doc) const {
+	if (doc.lazy_desc.empty()) return;
+	xml_node info = doc.doc.child("info");
+	info.remove_child("desc");
+	if (!info.append_buffer(doc.lazy_desc.c_str(), doc.lazy_desc.size()) ||
+		!info.child("desc")) {
+		LOG_F(WARNING, "Could not parse the description of stream %s", name_.c_str());
+		info.remove_child("desc");
+		info.append_child("desc");
+	}
+	doc.lazy_desc.clear();
+}
+
+std::shared_ptr<info_document> stream_info_impl::writable_doc() {
+	std::shared_ptr<info_document> doc = this->doc();
+	// besides doc_ and this reference, a copy or a server holds it
+	if (doc.use_count() > 2) {
+		std::lock_guard<std::mutex> lock(doc->mut);
+		auto copy = std::make_shared<info_document>();
+		copy->doc.reset(doc->doc);
+		copy->lazy_desc = doc->lazy_desc;
+		set_doc(copy);
+		return copy;
+	}
+	return doc;
+}
+
+std::shared_ptr<info_document> stream_info_impl::share_doc(
+	const std::shared_ptr<info_document> &doc) {
+	if (!doc->editable) return doc;
+	auto copy = std::make_shared<info_document>();
+	copy->doc.reset(doc->doc);
+	copy->lazy_desc = doc->lazy_desc;
+	return copy;
 }
 
 bool stream_info_impl::matches_query(const std::string &query, bool nocache) {
-	return cached_.matches_query(doc_, query, nocache);
+	const auto doc = this->doc();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	if (query.find("desc") != std::string::npos) parse_lazy_desc(*doc);
+	return doc->queries.matches_query(doc->doc, query, nocache);
+}
+
+bool stream_info_impl::matches_query(const simple_query &query) {
+	const auto doc = this->doc();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	if (query.refers_to("desc")) parse_lazy_desc(*doc);
+	return query.matches(doc->doc.first_child());
+}
+
+void stream_info_impl::touch() {
+	++metadata_version_;
+	doc()->queries.clear();
+}
+
+template <typename Serializer>
+std::shared_ptr<const std::string> stream_info_impl::cached(
+	cached_message &cache, Serializer serialize) {
+	std::lock_guard<std::mutex> lock(message_cache_mut_);
+	// a change while the message is serialized bumps the version again, so it's rebuilt next time
+	const uint64_t version = metadata_version_;
+	if (cache.version != version) {
+		cache.msg = std::make_shared<const std::string>(serialize());
+		cache.version = version;
+	}
+	return cache.msg;
+}
+
+std::shared_ptr<const std::string> stream_info_impl::cached_fullinfo_message() {
+	return cached(fullinfo_cache_, [this]() { return to_fullinfo_message(); });
+}
+
+std::shared_ptr<const std::string> stream_info_impl::cached_shortinfo_message() {
+	return cached(shortinfo_cache_, [this]() { return to_shortinfo_message(); });
+}
+
+std::shared_ptr<const std::string> stream_info_impl::cached_shortinfo_binary() {
+	return cached(binary_cache_, [this]() { return to_shortinfo_binary(); });
+}
+
+std::size_t stream_info_impl::cached_bytes() {
+	std::lock_guard<std::mutex> lock(message_cache_mut_);
+	std::size_t bytes = 0;
+	for (const cached_message *cache : {&fullinfo_cache_, &shortinfo_cache_, &binary_cache_})
+		if (cache->msg) bytes += cache->msg->capacity();
+	return bytes;
+}
+
+void stream_info_impl::replace_desc(const xml_node &desc) {
+	{
+		const auto doc = writable_doc();
+		std::lock_guard<std::mutex> lock(doc->mut);
+		doc->lazy_desc.clear();
+		xml_node info = doc->doc.child("info");
+		info.remove_child("desc");
+		if (desc)
+			info.append_copy(desc);
+		else
+			info.append_child("desc");
+	}
+	touch();
+}
+
+/// The XML of a node, to compare it with another one.
+static std::string node_xml(const xml_node &node) {
+	std::ostringstream os;
+	node.print(os, "", format_raw);
+	return os.str();
+}
+
+/// Whether two elements have the same name and attributes, i.e. only their children differ.
+static bool same_element(const xml_node &a, const xml_node &b) {
+	if (a.type() != node_element || b.type() != node_element || std::strcmp(a.name(), b.name()))
+		return false;
+	xml_attribute x = a.first_attribute(), y = b.first_attribute();
+	for (; x && y; x = x.next_attribute(), y = y.next_attribute())
+		if (std::strcmp(x.name(), y.name()) || std::strcmp(x.value(), y.value())) return false;
+	return !x && !y;
+}
+
+/// Add the changes of the children of `before` to `after` to the patch node, see desc_patch().
+static void diff_children(xml_node patch, const xml_node &before, const xml_node &after) {
+	unsigned children = 0;
+	xml_node old = before.first_child();
+	for (xml_node child = after.first_child(); child; child = child.next_sibling(), ++children) {
+		if (!old || node_xml(old) != node_xml(child)) {
+			// an element with element children (e.g. <channels>) only sends what changed in it
+			if (old && same_element(old, child) && child.find_child([](const xml_node &n) {
+					return n.type() == node_element;
+				})) {
+				xml_node changed = patch.append_child("node");
+				changed.append_attribute("index") = children;
+				diff_children(changed, old, child);
+			} else {
+				xml_node changed = patch.append_child("child");
+				changed.append_attribute("index") = children;
+				changed.append_copy(child);
+			}
+		}
+		if (old) old = old.next_sibling();
+	}
+	patch.append_attribute("children") = children;
+}
+
+std::string stream_info_impl::desc_patch(
+	const xml_node &before, const xml_node &after, uint64_t from, uint64_t to) {
+	xml_document doc;
+	xml_node patch = doc.append_child("patch");
+	patch.append_attribute("from") = std::to_string(from).c_str();
+	patch.append_attribute("to") = std::to_string(to).c_str();
+	diff_children(patch, before, after);
+	std::ostringstream os;
+	doc.save(os, "", format_raw | format_no_declaration);
+	return os.str();
+}
+
+/// Apply the changes of a patch node (see diff_children()) to the children of a node.
+static bool patch_children(xml_node target, const xml_node &patch) {
+	const xml_attribute count = patch.attribute("children");
+	if (!count) return false;
+	const std::size_t n = count.as_uint();
+	std::vector<xml_node> children;
+	for (xml_node child = target.first_child(); child; child = child.next_sibling())
+		children.push_back(child);
+	// the changed children replace the ones at their positions or, beyond the old children,
+	// are appended in order; the changed nodes are patched in turn
+	for (xml_node changed = patch.first_child(); changed; changed = changed.next_sibling()) {
+		const std::size_t k = changed.attribute("index").as_uint();
+		if (!std::strcmp(changed.name(), "node")) {
+			if (k >= n || k >= children.size() || !patch_children(children[k], changed))
+				return false;
+			continue;
+		}
+		if (std::strcmp(changed.name(), "child")) continue;
+		if (k >= n || k > children.size() || !changed.first_child()) return false;
+		if (k == children.size())
+			children.push_back(target.append_copy(changed.first_child()));
+		else {
+			const xml_node replaced = children[k];
+			children[k] = target.insert_copy_before(changed.first_child(), replaced);
+			target.remove_child(replaced);
+		}
+	}
+	if (children.size() < n) return false;
+	for (std::size_t k = n; k < children.size(); ++k) target.remove_child(children[k]);
+	return true;
+}
+
+bool stream_info_impl::apply_desc_patch(const xml_node &patch) {
+	bool applied;
+	{
+		const auto doc = writable_doc();
+		std::lock_guard<std::mutex> lock(doc->mut);
+		parse_lazy_desc(*doc);
+		applied = patch_children(doc->doc.child("info").child("desc"), patch);
+	}
+	touch();
+	return applied;
+}
+
+bool simple_query::parse(const std::string &query) {
+	terms_.clear();
+	const char *p = query.c_str();
+	auto skip_space = [&p]() {
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+	};
+	auto is_name_start = [](char c) { return std::isalpha((unsigned char)c) || c == '_'; };
+	auto is_name_char = [](char c) {
+		return std::isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+	};
+	while (true) {
+		term t;
+		// the path, e.g. desc/channels/channel/label
+		skip_space();
+		do {
+			if (!t.path.empty()) ++p;
+			const char *begin = p;
+			if (!is_name_start(*p)) return false;
+			while (is_name_char(*p)) ++p;
+			t.path.emplace_back(begin, p);
+		} while (*p == '/');
+		// the string literal it's compared with
+		skip_space();
+		if (*p++ != '=') return false;
+		skip_space();
+		const char quote = *p++;
+		if (quote != '\'' && quote != '"') return false;
+		const char *end = std::strchr(p, quote);
+		if (!end) return false;
+		t.value.assign(p, end);
+		p = end + 1;
+		terms_.push_back(std::move(t));
+		skip_space();
+		if (!*p) return true;
+		if (std::strncmp(p, "and", 3) != 0 || is_name_char(p[3])) return false;
+		p += 3;
+	}
+}
+
+/// Append the string-value of an XPath node (i.e. all text it contains) to a string.
+static void append_string_value(const xml_node &node, std::string &out) {
+	for (const xml_node &child : node.children())
+		if (child.type() == node_pcdata || child.type() == node_cdata)
+			out += child.value();
+		else if (child.type() == node_element)
+			append_string_value(child, out);
+}
+
+/// Check if any of the elements at a path below a node has the given string-value.
+static bool path_matches(const xml_node &node, const std::vector<std::string> &path,
+	std::size_t step, const std::string &value) {
+	if (step == path.size()) {
+		// most elements contain just a single text node
+		const xml_node first = node.first_child();
+		if (!first) return value.empty();
+		if (!first.next_sibling() && (first.type() == node_pcdata || first.type() == node_cdata))
+			return value == first.value();
+		std::string text;
+		append_string_value(node, text);
+		return value == text;
+	}
+	for (const xml_node &child : node.children(path[step].c_str()))
+		if (path_matches(child, path, step + 1, value)) return true;
+	return false;
+}
+
+bool simple_query::matches(const xml_node &info) const {
+	for (const auto &t : terms_)
+		if (!path_matches(info, t.path, 0, t.value)) return false;
+	return true;
+}
+
+const std::string *simple_query::value_of(const char *field) const {
+	for (const auto &t : terms_)
+		if (t.path.size() == 1 && t.path[0] == field) return &t.value;
+	return nullptr;
+}
+
+bool simple_query::refers_to(const char *element) const {
+	for (const auto &t : terms_)
+		if (t.path[0] == element) return true;
+	return false;
+}
+
+void query_cache::clear() {
+	std::lock_guard<named_mutex> lock(cache_mut_);
+	index_.clear();
+	entries_.clear();
+}
+
+std::size_t query_cache::size() {
+	std::lock_guard<named_mutex> lock(cache_mut_);
+	return entries_.size();
 }
 
 bool query_cache::matches_query(const xml_document &doc, const std::string &query, bool nocache) {
 	if (query.empty()) return true;
-	std::lock_guard<std::mutex> lock(cache_mut_);
-
-	decltype(cache)::iterator it;
-	if (!nocache && (it = cache.find(query)) != cache.end()) {
-		// the sign bit encodes if the query matches or not
-		bool matches = it->second > 0;
-		// update the last-use time stamp
-		it->second = ++query_cache_age * (matches ? 1 : -1);
-		// return cached match
-		return matches;
+	// simple queries are cheaper to match than to look up in the cache
+	simple_query simple;
+	if (simple.parse(query)) return simple.matches(doc.first_child());
+	const key lookup{std::hash<std::string>()(query), &query};
+	std::lock_guard<named_mutex> lock(cache_mut_);
+
+	if (!nocache) {
+		auto it = index_.find(lookup);
+		if (it != index_.end()) {
+			// move the entry to the front (the iterators stay valid)
+			entries_.splice(entries_.begin(), entries_, it->second);
+			return it->second->matches;
+		}
 	}
 
 	// not found in cache
@@ -206,24 +678,14 @@ bool query_cache::matches_query(const xml_document &doc, const std::string &quer
 		auto max_cached = (std::size_t)api_config::get_instance()->max_cached_queries();
 		if (nocache || max_cached == 0) return matched;
 
-		cache.insert(std::make_pair(query, ++query_cache_age * (matched ? 1 : -1)));
-
-		// remove n/2 oldest results to make room for new entries
-		if (cache.size() > max_cached) {
-			// Find out the median cache entry age
-			std::vector<int> agevec;
-			agevec.reserve(cache.size());
-			for (auto &val : cache) agevec.push_back(std::abs(val.second));
-			auto middle = agevec.begin() + max_cached / 2;
-			std::nth_element(agevec.begin(), middle, agevec.end());
-			auto oldest_to_keep = *middle;
-
-			// Remove all elements older than the median age
-			for (auto it = cache.begin(); it != cache.end();)
-				if (abs(it->second) <= oldest_to_keep)
-					it = cache.erase(it);
-				else
-					++it;
+		entries_.push_front(entry{query, lookup.hash, matched});
+		index_.emplace(key{lookup.hash, &entries_.front().query}, entries_.begin());
+
+		// evict the least recently used result
+		if (entries_.size() > max_cached) {
+			const entry &oldest = entries_.back();
+			index_.erase(key{oldest.hash, &oldest.query});
+			entries_.pop_back();
 		}
 		return matched;
 	} catch (std::exception &e) {
@@ -234,26 +696,45 @@ bool query_cache::matches_query(const xml_document &doc, const std::string &quer
 
 int stream_info_impl::channel_bytes() const {
 	const int channel_format_sizes[] = {0, sizeof(float), sizeof(double), sizeof(std::string),
-		sizeof(int32_t), sizeof(int16_t), sizeof(int8_t), 8};
+		sizeof(int32_t), sizeof(int16_t), sizeof(int8_t), 8, 3, 2};
 	return channel_format_sizes[channel_format_];
 }
 
-xml_node stream_info_impl::desc() { return doc_.child("info").child("desc"); }
-xml_node stream_info_impl::desc() const { return doc_.child("info").child("desc"); }
+xml_node stream_info_impl::desc() {
+	// the description can be edited through the returned node
+	const auto doc = writable_doc();
+	touch();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	parse_lazy_desc(*doc);
+	doc->editable = true;
+	return doc->doc.child("info").child("desc");
+}
+
+xml_node stream_info_impl::desc() const {
+	const auto doc = this->doc();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	parse_lazy_desc(*doc);
+	return doc->doc.child("info").child("desc");
+}
 
 void stream_info_impl::version(int v) {
 	version_ = v;
-	doc_.child("info").child("version").first_child().set_value(to_string(version_ / 100.).c_str());
+	writable_doc()->doc.child("info").child("version").text().set(
+		to_string(version_ / 100.).c_str());
+	touch();
 }
 
 void stream_info_impl::created_at(double v) {
 	created_at_ = v;
-	doc_.child("info").child("created_at").first_child().set_value(to_string(created_at_).c_str());
+	writable_doc()->doc.child("info").child("created_at").text().set(
+		to_string(created_at_).c_str());
+	touch();
 }
 
 void stream_info_impl::uid(const std::string &v) {
 	uid_ = v;
-	doc_.child("info").child("uid").first_child().set_value(uid_.c_str());
+	writable_doc()->doc.child("info").child("uid").text().set(uid_.c_str());
+	touch();
 }
 
 const std::string& stream_info_impl::reset_uid()
@@ -264,42 +745,58 @@ const std::string& stream_info_impl::reset_uid()
 
 void stream_info_impl::session_id(const std::string &v) {
 	session_id_ = v;
-	doc_.child("info").child("session_id").first_child().set_value(session_id_.c_str());
+	writable_doc()->doc.child("info").child("session_id").text().set(session_id_.c_str());
+	touch();
+}
+
+void stream_info_impl::channel_count(uint32_t v) {
+	channel_count_ = v;
+	writable_doc()->doc.child("info").child("channel_count").text().set(to_string(v).c_str());
+	touch();
 }
 
 void stream_info_impl::hostname(const std::string &v) {
 	hostname_ = v;
-	doc_.child("info").child("hostname").first_child().set_value(hostname_.c_str());
+	writable_doc()->doc.child("info").child("hostname").text().set(hostname_.c_str());
+	touch();
 }
 
 void stream_info_impl::v4address(const std::string &v) {
 	v4address_ = v;
-	doc_.child("info").child("v4address").first_child().set_value(v4address_.c_str());
+	writable_doc()->doc.child("info").child("v4address").text().set(v4address_.c_str());
+	touch();
 }
 
 void stream_info_impl::v4data_port(uint16_t v) {
 	v4data_port_ = v;
-	doc_.child("info").child("v4data_port").first_child().text().set(v4data_port_);
+	writable_doc()->doc.child("info").child("v4data_port").first_child().text().set(v4data_port_);
+	touch();
 }
 
 void stream_info_impl::v4service_port(uint16_t v) {
 	v4service_port_ = v;
-	doc_.child("info").child("v4service_port").first_child().text().set(v4service_port_);
+	writable_doc()->doc.child("info").child("v4service_port").first_child().text().set(
+		v4service_port_);
+	touch();
 }
 
 void stream_info_impl::v6address(const std::string &v) {
 	v6address_ = v;
-	doc_.child("info").child("v6address").first_child().set_value(v6address_.c_str());
+	writable_doc()->doc.child("info").child("v6address").text().set(v6address_.c_str());
+	touch();
 }
 
 void stream_info_impl::v6data_port(uint16_t v) {
 	v6data_port_ = v;
-	doc_.child("info").child("v6data_port").first_child().text().set(v6data_port_);
+	writable_doc()->doc.child("info").child("v6data_port").first_child().text().set(v6data_port_);
+	touch();
 }
 
 void stream_info_impl::v6service_port(uint16_t v) {
 	v6service_port_ = v;
-	doc_.child("info").child("v6service_port").first_child().text().set(v6service_port_);
+	writable_doc()->doc.child("info").child("v6service_port").first_child().text().set(
+		v6service_port_);
+	touch();
 }
 
 stream_info_impl &stream_info_impl::operator=(stream_info_impl const &rhs) {
@@ -321,7 +818,13 @@ stream_info_impl &stream_info_impl::operator=(stream_info_impl const &rhs) {
 	created_at_ = rhs.created_at_;
 	session_id_ = rhs.session_id_;
 	hostname_ = rhs.hostname_;
-	doc_.reset(rhs.doc_);
+	{
+		const auto doc = rhs.doc();
+		std::lock_guard<std::mutex> lock(doc->mut);
+		set_doc(share_doc(doc));
+	}
+	// the shared document's cached query results are still valid
+	++metadata_version_;
 	return *this;
 }
 
@@ -333,7 +836,9 @@ stream_info_impl::stream_info_impl(const stream_info_impl &rhs)
 	  v6address_(rhs.v6address_), v6data_port_(rhs.v6data_port_),
 	  v6service_port_(rhs.v6service_port_), uid_(rhs.uid_), created_at_(rhs.created_at_),
 	  session_id_(rhs.session_id_), hostname_(rhs.hostname_) {
-	doc_.reset(rhs.doc_);
+	const auto doc = rhs.doc();
+	std::lock_guard<std::mutex> lock(doc->mut);
+	doc_ = share_doc(doc);
 }
 
 } // namespace lsl
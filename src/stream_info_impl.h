@@ -2,20 +2,104 @@
 #define STREAM_INFO_IMPL_H
 
 #include "common.h"
+#include "lock_stats.h"
+#include <atomic>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <pugixml.hpp>
 #include <unordered_map>
+#include <vector>
 
 namespace lsl {
 
-/// LRU cache for queries
+/**
+ * A query that only compares fields with string literals, e.g. `name='BioSemi' and type="EEG"`
+ * or `desc/manufacturer='X'`, as used by most resolves.
+ *
+ * It's matched by walking the XML doc directly, which is much cheaper than compiling an XPath
+ * query; its results are the same as those of the equivalent XPath query.
+ */
+class simple_query {
+public:
+	/// Parse a query. @return False if it's not a simple query (i.e. XPath has to be used).
+	bool parse(const std::string &query);
+
+	/// Check if the query matches an info element.
+	bool matches(const pugi::xml_node &info) const;
+
+	/// The value a top-level field (e.g. `name`) is compared with, nullptr if there's no such term.
+	const std::string *value_of(const char *field) const;
+
+	/// Whether a term's path starts with an element (e.g. `desc`).
+	bool refers_to(const char *element) const;
+
+private:
+	/// a comparison `path='value'`
+	struct term {
+		std::vector<std::string> path;
+		std::string value;
+	};
+	std::vector<term> terms_;
+};
+
+/**
+ * LRU cache for the results of (XPath) queries.
+ *
+ * The entries are kept in a list ordered by their last use, so looking up, inserting and
+ * evicting an entry takes constant time. The index refers to the queries in the list nodes and
+ * is keyed by their precomputed hash, so each lookup hashes the query once.
+ */
 class query_cache {
-	std::unordered_map<std::string, int> cache;
-	int query_cache_age{0};
-	std::mutex cache_mut_;
+	struct entry {
+		std::string query;
+		std::size_t hash;
+		bool matches;
+	};
+	/// an index key: the hash and the query of an entry (or of the query that's looked up)
+	struct key {
+		std::size_t hash;
+		const std::string *query;
+		bool operator==(const key &other) const {
+			return hash == other.hash && *query == *other.query;
+		}
+	};
+	struct key_hash {
+		std::size_t operator()(const key &k) const { return k.hash; }
+	};
+	/// the entries, the most recently used first
+	std::list<entry> entries_;
+	std::unordered_map<key, std::list<entry>::iterator, key_hash> index_;
+	named_mutex cache_mut_{"query_cache"};
 
 public:
 	bool matches_query(const pugi::xml_document &doc, const std::string &query, bool nocache);
+
+	/// Forget all cached results, e.g. because the document changed.
+	void clear();
+
+	/// The number of cached results.
+	std::size_t size();
+};
+
+/**
+ * The XML representation of a stream info.
+ *
+ * Copies of a stream info share it (so e.g. resolver results are copied without copying their
+ * documents) until one of them changes it, which gives that one its own copy first. Once the
+ * editable desc() was handed out, the document can be changed through it at any time, so copies
+ * get their own documents right away.
+ */
+struct info_document {
+	pugi::xml_document doc;
+	/// the not-yet-parsed <desc> element of a lazily read full-info message
+	std::string lazy_desc;
+	/// protects lazy_desc and the <desc> element while it's parsed, replaced or read by servers
+	std::mutex mut;
+	/// cached query results
+	query_cache queries;
+	/// whether the editable desc() was handed out
+	bool editable{false};
 };
 
 /**
@@ -49,10 +133,10 @@ public:
 	stream_info_impl(const std::string &name, std::string type, int channel_count,
 		double nominal_srate, lsl_channel_format_t channel_format, std::string source_id);
 
-	/// Copy constructor. Needs special handling because xml_document is non-copyable.
+	/// Copy constructor. Shares the XML document, see info_document.
 	stream_info_impl(const stream_info_impl &rhs);
 
-	/// Assignment operator. Needs extra handling because xml_document is non-copyable.
+	/// Assignment operator. Shares the XML document, see info_document.
 	stream_info_impl &operator=(const stream_info_impl &rhs);
 
 	// === Protocol Support Operations ===
@@ -67,7 +151,16 @@ public:
 	std::string to_shortinfo_message();
 
 	/**
-	 * Initialize a stream_info from a short-info message.
+	 * Get the short-info message in a compact binary encoding.
+	 *
+	 * It holds the same fields as the xml message (each string prefixed with its length), but it
+	 * can be decoded without parsing xml. Resolvers ask for it in their queries; older versions
+	 * of liblsl don't, so they get the xml message.
+	 */
+	std::string to_shortinfo_binary() const;
+
+	/**
+	 * Initialize a stream_info from a short-info message (xml or binary).
 	 *
 	 * This functions resets all fields of the stream_info accoridng to the message. The .desc()
 	 * field will be empty.
@@ -81,12 +174,23 @@ public:
 	 */
 	std::string to_fullinfo_message();
 
+	/**
+	 * Get a full-info message that only holds the given children of the <desc> element.
+	 *
+	 * @param fullinfo A full-info message as returned by to_fullinfo_message().
+	 * @param desc_subtrees The names of the <desc> children to keep.
+	 */
+	static std::string select_desc_subtrees(
+		const std::string &fullinfo, const std::vector<std::string> &desc_subtrees);
+
 	/**
 	 * Initialize a stream_info from a full-info message.
 	 *
 	 * This functions resets all fields of the stream_info accoridng to the message.
+	 * @param lazy_desc If true, only the fields are parsed right away; the <desc> element is kept
+	 * as text and parsed when it's first accessed.
 	 */
-	void from_fullinfo_message(const std::string &m);
+	void from_fullinfo_message(const std::string &m, bool lazy_desc = false);
 
 	/**
 	 * Test whether this stream info matches the given query string.
@@ -96,6 +200,57 @@ public:
 	 */
 	bool matches_query(const std::string &query, bool nocache = false);
 
+	/// Test whether this stream info matches a parsed simple query, e.g. the same query for many
+	/// streams.
+	bool matches_query(const simple_query &query);
+
+	/**
+	 * Get the version of the stream's metadata.
+	 *
+	 * It is incremented whenever a field or the description changes (or may have changed, i.e.,
+	 * whenever the editable desc() is handed out).
+	 */
+	uint64_t metadata_version() const { return metadata_version_; }
+
+	/**
+	 * Get a shared copy of the full-info message.
+	 *
+	 * The message is only serialized again if the metadata changed since the last call, so
+	 * servers can call this for every request.
+	 */
+	std::shared_ptr<const std::string> cached_fullinfo_message();
+
+	/// Get a shared copy of the short-info message, see cached_fullinfo_message().
+	std::shared_ptr<const std::string> cached_shortinfo_message();
+
+	/// Get a shared copy of the binary short-info message, see cached_fullinfo_message().
+	std::shared_ptr<const std::string> cached_shortinfo_binary();
+
+	/// The memory of the cached messages, in bytes.
+	std::size_t cached_bytes();
+
+	/// Replace the description with a copy of another stream's description.
+	void replace_desc(const pugi::xml_node &desc);
+
+	/**
+	 * Build a patch that turns the description `before` into `after`, for the inlets that have
+	 * the info of metadata version `from` (see apply_desc_patch()).
+	 *
+	 * The patch is a `<patch from="" to="" children="">` element with the number of children of
+	 * `after` and, in `<child index="">` elements, those of its children that differ from the
+	 * ones at the same position in `before`. A changed element that has the same name and
+	 * attributes and element children (e.g. `<channels>`) is diffed the same way in a
+	 * `<node index="" children="">` element instead, so changing one channel only sends it.
+	 */
+	static std::string desc_patch(const pugi::xml_node &before, const pugi::xml_node &after,
+		uint64_t from, uint64_t to);
+
+	/**
+	 * Apply a patch built by desc_patch() to the description.
+	 * @return false if the patch is malformed, the description is only partly changed then.
+	 */
+	bool apply_desc_patch(const pugi::xml_node &patch);
+
 
 	//
 	// === Data Information Getters ===
@@ -109,6 +264,7 @@ public:
 
 	/// Get the number of channels of a stream.
 	uint32_t channel_count() const { return channel_count_; }
+	void channel_count(uint32_t v);
 
 	/// Get the sampling rate of a stream (in Hz) as advertised by the device.
 	double nominal_srate() const { return nominal_srate_; }
@@ -226,6 +382,38 @@ protected:
 	/// Read the class fields from an XML DOM structure.
 	void read_xml(pugi::xml_document &doc);
 
+	/// Read the class fields from a binary short-info message and rebuild the XML document.
+	void read_binary(const std::string &m);
+
+	/// Parse the <desc> element if it was kept as text by a lazy from_fullinfo_message().
+	/// The caller has to hold the document's mutex.
+	void parse_lazy_desc(info_document &doc) const;
+
+	/// The current XML document; servers read it while the outlet replaces it.
+	std::shared_ptr<info_document> doc() const { return std::atomic_load(&doc_); }
+
+	/// Replace the XML document.
+	void set_doc(std::shared_ptr<info_document> doc) { std::atomic_store(&doc_, std::move(doc)); }
+
+	/// Get the XML document to change it, after copying it if it's shared with other copies.
+	std::shared_ptr<info_document> writable_doc();
+
+	/// Get a document to share with a copy (the caller has to hold the document's mutex).
+	static std::shared_ptr<info_document> share_doc(const std::shared_ptr<info_document> &doc);
+
+	/// Mark the metadata as changed.
+	void touch();
+
+	/// A serialized message and the metadata version it was created from.
+	struct cached_message {
+		uint64_t version{0};
+		std::shared_ptr<const std::string> msg;
+	};
+
+	/// Get a cached message, serialized again with the given function if it's outdated.
+	template <typename Serializer>
+	std::shared_ptr<const std::string> cached(cached_message &cache, Serializer serialize);
+
 private:
 	// data information
 	std::string name_;
@@ -246,10 +434,15 @@ private:
 	double created_at_;
 	std::string session_id_;
 	std::string hostname_;
-	// XML representation
-	pugi::xml_document doc_;
-	// cached query results
-	query_cache cached_;
+	// XML representation, never null; after the constructors, only accessed through doc() and
+	// set_doc()
+	std::shared_ptr<info_document> doc_;
+	// incremented whenever the metadata changes
+	std::atomic<uint64_t> metadata_version_{1};
+	// serialized messages for servers
+	cached_message fullinfo_cache_, shortinfo_cache_, binary_cache_;
+	// protects the cached messages
+	std::mutex message_cache_mut_;
 };
 
 
@@ -1,12 +1,17 @@
 #ifndef STREAM_INLET_IMPL_H
 #define STREAM_INLET_IMPL_H
 
+#include "arrow_export.h"
+#include "calibration.h"
 #include "common.h"
 #include "data_receiver.h"
 #include "info_receiver.h"
+#include "target_buffer.h"
 #include "inlet_connection.h"
 #include "time_postprocessor.h"
 #include "time_receiver.h"
+#include "window_buffer.h"
+#include <boost/endian/conversion.hpp>
 #include <loguru.hpp>
 
 namespace lsl {
@@ -36,15 +41,40 @@ public:
 	 * In all other cases (recover is false or the stream is not recoverable) a lsl::lost_error
 	 * is thrown where indicated if the stream's source is lost (e.g. due to an app or computer
 	 * crash).
+	 * @param channels Optionally the indices of the channels to receive (empty for all channels).
+	 * Only these channels are sent by the outlet, and the samples pulled from the inlet have only
+	 * these channels (in this order).
+	 * @param decimation Optionally receive only every decimation-th sample (e.g. a preview of a
+	 * high-rate stream).
+	 * @param config The settings of the stream, by default a snapshot of the configuration file's.
 	 */
 	stream_inlet_impl(const stream_info_impl &info, int32_t max_buflen = 360,
-		int32_t max_chunklen = 0, bool recover = true)
-		: conn_(info, recover), info_receiver_(conn_), time_receiver_(conn_),
-		  data_receiver_(conn_, max_buflen, max_chunklen),
-		  postprocessor_([this]() { return time_receiver_.time_correction(5); },
-			  [this]() { return conn_.current_srate(); },
+		int32_t max_chunklen = 0, bool recover = true,
+		std::vector<uint32_t> channels = std::vector<uint32_t>(), uint32_t decimation = 1,
+		stream_config_p config = nullptr)
+		: conn_(info, recover, std::move(channels), decimation), info_receiver_(conn_),
+		  time_receiver_(conn_), data_receiver_(conn_, max_buflen, max_chunklen, std::move(config)),
+		  postprocessor_([this]() { return time_receiver_.time_correction_model(5); },
+			  [this]() {
+				  return conn_.current_srate() / conn_.decimation() *
+						 data_receiver_.resampling_ratio();
+			  },
 			  [this]() { return time_receiver_.was_reset(); }) {
 		ensure_lsl_initialized();
+		postprocessor_.set_gap_source([this]() {
+			// the receive thread sees the samples before they can be dropped from the queue;
+			// pulled samples only skip the gaps before them, not those of newer samples
+			return receive_thread_processing_
+					   ? data_receiver_.samples_missing()
+					   : data_receiver_.missing_pulled() + data_receiver_.dropped_pulled();
+		});
+		data_receiver_.set_time_correction_source([this](double &correction) {
+			try {
+				return time_receiver_.latest_time_correction(correction, nullptr, nullptr);
+			} catch (lost_error &) { return false; }
+		});
+		data_receiver_.set_metadata_handler(
+			[this](const std::string &patch) { info_receiver_.apply_patch(patch); });
 		conn_.engage();
 	}
 
@@ -141,7 +171,10 @@ public:
 		if (!ec) ec = &dummy;
 		*ec = lsl_no_error;
 		try {
-			return postprocess(data_receiver_.pull_sample_typed(buffer, buffer_elements, timeout));
+			// a timeout or a lost stream is returned rather than thrown by the data receiver
+			double timestamp;
+			*ec = data_receiver_.try_pull_sample_typed(buffer, buffer_elements, timeout, timestamp);
+			return *ec ? 0.0 : postprocess(timestamp);
 		} catch (timeout_error &) { *ec = lsl_timeout_error; } catch (lost_error &) {
 			*ec = lsl_lost_error;
 		} catch (std::invalid_argument &) { *ec = lsl_argument_error; } catch (std::range_error &) {
@@ -172,6 +205,25 @@ public:
 		return postprocess(data_receiver_.pull_sample_untyped(sample, buffer_bytes, timeout));
 	}
 
+	/// Pull a sample like pull_numeric_raw(), but return the error code instead of throwing it.
+	double pull_numeric_raw_noexcept(void *sample, int32_t buffer_bytes, double timeout = FOREVER,
+		lsl_error_code_t *ec = nullptr) noexcept {
+		lsl_error_code_t dummy;
+		if (!ec) ec = &dummy;
+		*ec = lsl_no_error;
+		try {
+			double timestamp;
+			*ec = data_receiver_.try_pull_sample_untyped(sample, buffer_bytes, timeout, timestamp);
+			return *ec ? 0.0 : postprocess(timestamp);
+		} catch (timeout_error &) { *ec = lsl_timeout_error; } catch (lost_error &) {
+			*ec = lsl_lost_error;
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+			*ec = lsl_internal_error;
+		}
+		return 0.0;
+	}
+
 	/**
 	 * Pull a chunk of data from the inlet.
 	 *
@@ -193,44 +245,375 @@ public:
 	uint32_t pull_chunk_multiplexed(T *data_buffer, double *timestamp_buffer,
 		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
 		double timeout = 0.0) {
-		std::size_t samples_written = 0, num_chans = info().channel_count(),
-					max_samples = data_buffer_elements / num_chans;
-		if (data_buffer_elements % num_chans != 0)
-			throw std::runtime_error(
-				"The number of buffer elements must be a multiple of the stream's channel count.");
-		if (timestamp_buffer && max_samples != timestamp_buffer_elements)
-			throw std::runtime_error(
-				"The timestamp buffer must hold the same number of samples as the data buffer.");
-		double end_time = timeout ? lsl_clock() + timeout : 0.0;
-		for (samples_written = 0; samples_written < max_samples; samples_written++) {
-			if (double ts = pull_sample(&data_buffer[samples_written * num_chans], (int) num_chans,
-					timeout ? end_time - lsl_clock() : 0.0)) {
-				if (timestamp_buffer) timestamp_buffer[samples_written] = ts;
-			} else
-				break;
-		}
-		return static_cast<uint32_t>(samples_written * num_chans);
+		return pull_chunk(data_buffer, timestamp_buffer, data_buffer_elements,
+			timestamp_buffer_elements, timeout, false);
+	}
+
+	/**
+	 * Pull a chunk of data from the inlet in channel-major (planar) order.
+	 *
+	 * The data buffer holds one array of data_buffer_elements / channel_count values per channel,
+	 * e.g. for filters that process each channel separately. Otherwise the parameters and the
+	 * return value are the same as for pull_chunk_multiplexed(); when fewer samples are
+	 * available, the end of each channel's array isn't written.
+	 */
+	template <class T>
+	uint32_t pull_chunk_planar(T *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0) {
+		return pull_chunk(data_buffer, timestamp_buffer, data_buffer_elements,
+			timestamp_buffer_elements, timeout, true);
 	}
 
+	/// The number of channels of the stream.
+	uint32_t channel_count() { return conn_.type_info().channel_count(); }
+
 	template <class T>
 	uint32_t pull_chunk_multiplexed_noexcept(T *data_buffer, double *timestamp_buffer,
 		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
 		double timeout = 0.0, lsl_error_code_t *ec = nullptr) noexcept {
-		lsl_error_code_t dummy;
-		if (!ec) ec = &dummy;
-		*ec = lsl_no_error;
-		try {
-			return pull_chunk_multiplexed(data_buffer, timestamp_buffer, data_buffer_elements,
-				timestamp_buffer_elements, timeout);
-		} catch (timeout_error &) { *ec = lsl_timeout_error; } catch (lost_error &) {
-			*ec = lsl_lost_error;
-		} catch (std::invalid_argument &) { *ec = lsl_argument_error; } catch (std::range_error &) {
-			*ec = lsl_argument_error;
-		} catch (std::exception &e) {
-			LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
-			*ec = lsl_internal_error;
+		return pull_chunk_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+			timestamp_buffer_elements, timeout, ec, false);
+	}
+
+	template <class T>
+	uint32_t pull_chunk_planar_noexcept(T *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements,
+		double timeout = 0.0, lsl_error_code_t *ec = nullptr) noexcept {
+		return pull_chunk_noexcept(data_buffer, timestamp_buffer, data_buffer_elements,
+			timestamp_buffer_elements, timeout, ec, true);
+	}
+
+	/**
+	 * Borrow up to max_samples queued samples without copying their channel data.
+	 *
+	 * The samples stay valid until the view is destroyed or reused.
+	 * @param view The view to hold the samples and their post-processed time stamps.
+	 * @param max_samples The maximum number of samples to borrow.
+	 * @param timeout If greater than 0, wait up to this many seconds for max_samples samples.
+	 * @return The number of borrowed samples.
+	 * @throws lost_error (if the stream source has been lost), std::invalid_argument (for
+	 * string-formatted streams).
+	 */
+	uint32_t borrow_chunk(sample_view &view, uint32_t max_samples, double timeout = 0.0) {
+		if (conn_.type_info().channel_format() == cft_string)
+			throw std::invalid_argument("Samples of string-formatted streams can't be borrowed.");
+		uint32_t n = data_receiver_.borrow_samples(view, max_samples, timeout);
+		postprocessor_.process_timestamps(view.timestamps.data(), n);
+		return n;
+	}
+
+	/**
+	 * Pull up to max_samples samples into a strided array of a numeric type, e.g. a numpy or
+	 * MATLAB array in any memory layout.
+	 *
+	 * The value of channel c of the k-th sample is written to `data + k * sample_stride + c *
+	 * channel_stride` (strides in bytes, possibly negative; the values don't need to be
+	 * aligned), converted by the same kernels as pull_chunk_multiplexed().
+	 * @param timestamp_buffer Room for max_samples time stamps, or nullptr.
+	 * @param timeout If greater than 0, wait up to this many seconds for max_samples samples.
+	 * @return The number of samples pulled.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	template <class T>
+	uint32_t pull_chunk_strided(char *data, std::ptrdiff_t sample_stride,
+		std::ptrdiff_t channel_stride, double *timestamp_buffer, uint32_t max_samples,
+		double timeout = 0.0) {
+		if (!data && max_samples) throw std::invalid_argument("The data pointer must not be NULL.");
+		sample_view view;
+		const uint32_t n = data_receiver_.borrow_samples(view, max_samples, timeout);
+		const auto retrieve = view.sample_factory->kernels<T>().retrieve;
+		std::vector<T> scratch(channel_count());
+		for (uint32_t k = 0; k < n; ++k)
+			view.samples[k]->retrieve_strided(data + static_cast<std::ptrdiff_t>(k) * sample_stride,
+				channel_stride, scratch.data(), retrieve);
+		if (timestamp_buffer) {
+			postprocessor_.process_timestamps(view.timestamps.data(), n);
+			std::copy(view.timestamps.begin(), view.timestamps.end(), timestamp_buffer);
+		} else
+			postprocessor_.skip_samples(n);
+		return n;
+	}
+
+	/**
+	 * Pull up to max_samples multiplexed samples of a numeric type with their sequence numbers
+	 * and the number of samples missed since the previous call.
+	 * @param timestamp_buffer Room for max_samples time stamps, or nullptr.
+	 * @param seq_buffer Room for max_samples sequence numbers (0 if unknown), or nullptr.
+	 * @param gaps Receives the samples dropped by the inlet and lost before they arrived, or
+	 * nullptr.
+	 * @param timeout If greater than 0, wait up to this many seconds for max_samples samples.
+	 * @return The number of samples pulled.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	template <class T>
+	uint32_t pull_chunk_seq(T *data, double *timestamp_buffer, uint64_t *seq_buffer,
+		uint32_t max_samples, lsl_chunk_gaps *gaps, double timeout = 0.0) {
+		if (!data && max_samples) throw std::invalid_argument("The data pointer must not be NULL.");
+		sample_view view;
+		const uint32_t n = data_receiver_.borrow_samples(view, max_samples, timeout);
+		if (gaps) {
+			// the gaps up to the last pulled sample, not those of samples still in the buffer
+			std::lock_guard<std::mutex> lock(gaps_mut_);
+			const uint64_t dropped = data_receiver_.dropped_pulled(),
+						   lost = data_receiver_.missing_pulled();
+			gaps->dropped = dropped - gaps_seen_.dropped;
+			gaps->lost = lost - gaps_seen_.lost;
+			gaps_seen_ = {dropped, lost};
 		}
-		return 0;
+		const auto retrieve = view.sample_factory->kernels<T>().retrieve;
+		const uint32_t channels = channel_count();
+		for (uint32_t k = 0; k < n; ++k) {
+			view.samples[k]->retrieve_typed(
+				data + static_cast<std::size_t>(k) * channels, retrieve);
+			if (seq_buffer) seq_buffer[k] = view.samples[k]->seq;
+		}
+		if (timestamp_buffer) {
+			postprocessor_.process_timestamps(view.timestamps.data(), n);
+			std::copy(view.timestamps.begin(), view.timestamps.end(), timestamp_buffer);
+		} else
+			postprocessor_.skip_samples(n);
+		return n;
+	}
+
+	/**
+	 * Pull a sample of a numeric stream in a sparse form: its nonzero channels as index/value
+	 * pairs in channel order (pull_sample() gets the same sample in dense form).
+	 * @param max_count The room for indices and values.
+	 * @param count Receives the number of nonzero channels; if it's more than max_count, only the
+	 * first max_count channels are retrieved.
+	 * @param timeout The timeout of the operation (0 to return immediately).
+	 * @return The capture time of the sample, or 0.0 if no new sample was available.
+	 * @throws lost_error (if the stream source has been lost), std::invalid_argument (for
+	 * string-formatted streams).
+	 */
+	template <class T>
+	double pull_sample_sparse(uint32_t *indices, T *values, uint32_t max_count, uint32_t &count,
+		double timeout = FOREVER) {
+		if (max_count && (!indices || !values))
+			throw std::invalid_argument("The index and value pointers must not be NULL.");
+		// before a sample is taken from the queue, so it's still there for pull_sample()
+		if (conn_.type_info().channel_format() == cft_string)
+			throw std::invalid_argument("Only numeric samples can be sparse.");
+		count = 0;
+		sample_view view;
+		if (!data_receiver_.borrow_samples(view, 1, timeout)) return 0.0;
+		count = static_cast<uint32_t>(view.samples[0]->retrieve_sparse(
+			indices, values, max_count, view.sample_factory->kernels<T>().retrieve));
+		postprocessor_.process_timestamps(view.timestamps.data(), 1);
+		return view.timestamps[0];
+	}
+
+	/**
+	 * Pull up to max_samples samples into an Arrow C Data Interface struct array with a time
+	 * stamp column and one column per channel (see export_arrow_chunk()).
+	 *
+	 * The samples are borrowed from the queue and copied once, straight into the columns.
+	 * @param timeout If greater than 0, wait up to this many seconds for max_samples samples.
+	 * @return The number of samples, i.e. rows of the array.
+	 * @throws lost_error (if the stream source has been lost).
+	 */
+	uint32_t pull_chunk_arrow(
+		ArrowArray *array, ArrowSchema *schema, uint32_t max_samples, double timeout = 0.0) {
+		sample_view view;
+		const uint32_t n = data_receiver_.borrow_samples(view, max_samples, timeout);
+		postprocessor_.process_timestamps(view.timestamps.data(), n);
+		export_arrow_chunk(
+			view, conn_.type_info().channel_format(), channel_count(), array, schema);
+		return n;
+	}
+
+	/**
+	 * Call a function once at least min_samples samples are available for pickup.
+	 *
+	 * The function is called exactly once, either right away or from the inlet's data thread. It
+	 * gets `lost` set to true once the stream has been lost or the inlet is destroyed before the
+	 * samples arrived. Samples delivered to a chunk callback don't count.
+	 */
+	void async_wait_for_samples(std::size_t min_samples, data_receiver::wait_handler handler) {
+		data_receiver_.async_wait(min_samples, std::move(handler));
+	}
+
+	/// A function that receives chunks of samples directly from the inlet's data thread.
+	using chunk_callback = std::function<void(sample_view &)>;
+
+	/**
+	 * Deliver received chunks to a function instead of queueing them for pull calls.
+	 *
+	 * The function is called from the inlet's data thread with a view of the samples and their
+	 * post-processed time stamps, which is only valid during the call. An empty view signals that
+	 * the stream has been lost. Pass an empty function to queue the samples again; once this
+	 * returns, the previous function won't be called anymore.
+	 * @throws std::invalid_argument for string-formatted streams.
+	 */
+	void set_chunk_callback(chunk_callback callback) {
+		if (!callback) {
+			data_receiver_.set_sample_callback(data_receiver::sample_callback());
+			return;
+		}
+		if (conn_.type_info().channel_format() == cft_string)
+			throw std::invalid_argument("Samples of string-formatted streams can't be borrowed.");
+		auto view = std::make_shared<sample_view>();
+		data_receiver_.set_sample_callback(
+			[this, view, callback](const sample_p *samples, std::size_t n) {
+				view->samples.assign(samples, samples + n);
+				view->timestamps.resize(n);
+				for (std::size_t k = 0; k < n; ++k) view->timestamps[k] = samples[k]->timestamp;
+				postprocessor_.process_timestamps(view->timestamps.data(), n);
+				callback(*view);
+				view->samples.clear();
+			});
+	}
+
+	/// A function that receives blocks of samples directly from the inlet's data thread.
+	using raw_chunk_callback = std::function<void(const lsl_raw_chunk &chunk)>;
+
+	/**
+	 * Deliver received chunks to a function as blocks of bytes instead of queueing them for pull
+	 * calls, see data_receiver::set_raw_chunk_callback().
+	 *
+	 * The chunk, with the post-processed time stamps, is only valid during the call. A chunk
+	 * without samples signals that the stream has been lost. Pass an empty function to queue the
+	 * samples again.
+	 * @throws std::invalid_argument for string-formatted streams.
+	 */
+	void set_raw_chunk_callback(raw_chunk_callback callback) {
+		if (!callback) {
+			data_receiver_.set_raw_chunk_callback(data_receiver::raw_chunk_callback());
+			return;
+		}
+		if (conn_.type_info().channel_format() == cft_string)
+			throw std::invalid_argument("String-formatted streams can't be received as bytes.");
+		data_receiver_.set_raw_chunk_callback(
+			[this, callback](const char *values, std::size_t num_bytes, std::size_t n,
+				double *timestamps) {
+				postprocessor_.process_timestamps(timestamps, n);
+				lsl_raw_chunk chunk{};
+				chunk.data = values;
+				chunk.num_bytes = num_bytes;
+				chunk.num_samples = static_cast<uint32_t>(n);
+				chunk.little_endian =
+					lslboost::endian::order::native == lslboost::endian::order::little;
+				chunk.first_timestamp = n ? timestamps[0] : 0.0;
+				chunk.timestamps = timestamps;
+				callback(chunk);
+			});
+	}
+
+	/**
+	 * Write the received samples into a ring buffer of the application instead of queueing them
+	 * for pull calls, see target_buffer.
+	 *
+	 * The samples are converted to T and transposed straight into the ring from the inlet's data
+	 * thread, which then calls on_written for the filled slots. Pass a null data pointer to queue
+	 * the samples again; once this returns, the previous ring isn't written anymore.
+	 * @throws std::invalid_argument for string-formatted streams or an empty ring.
+	 */
+	template <class T>
+	void set_target_buffer(
+		T *data, double *timestamps, uint32_t capacity, target_buffer::callback on_written) {
+		if (!data) {
+			data_receiver_.set_sample_callback(data_receiver::sample_callback());
+			return;
+		}
+		if (conn_.type_info().channel_format() == cft_string)
+			throw std::invalid_argument("Samples of string-formatted streams can't be converted.");
+		auto target = std::make_shared<target_buffer>(data, timestamps, capacity, channel_count(),
+			typed_kernels<T>::select(conn_.type_info().channel_format()).retrieve,
+			std::move(on_written));
+		{
+			std::lock_guard<std::mutex> lock(target_mut_);
+			target_ = target;
+		}
+		std::vector<double> stamps;
+		data_receiver_.set_sample_callback(
+			[this, target, stamps](const sample_p *samples, std::size_t n) mutable {
+				stamps.resize(n);
+				for (std::size_t k = 0; k < n; ++k) stamps[k] = samples[k]->timestamp;
+				postprocessor_.process_timestamps(stamps.data(), n);
+				target->write(samples, stamps.data(), n);
+			});
+	}
+
+	/**
+	 * Give the oldest samples of the ring set with set_target_buffer() back to the inlet.
+	 * @throws std::invalid_argument if there's no ring or it has fewer unreleased samples.
+	 */
+	void release_target_samples(uint32_t count) {
+		std::lock_guard<std::mutex> lock(target_mut_);
+		if (!target_) throw std::invalid_argument("The inlet has no target buffer.");
+		target_->release(count);
+	}
+
+	/**
+	 * Keep the recent samples in a ring of mirrored memory instead of queueing them for pull
+	 * calls, so windows of them can be borrowed as contiguous blocks, see window_buffer.
+	 *
+	 * The samples are converted to T from the inlet's data thread. Pass 0 as capacity to queue
+	 * the samples again.
+	 * @return The capacity of the ring, at least min_capacity.
+	 * @throws std::invalid_argument for string-formatted streams or if a window is borrowed.
+	 */
+	template <class T> uint32_t set_window_buffer(uint32_t min_capacity) {
+		std::shared_ptr<window_buffer> window;
+		if (min_capacity) {
+			if (conn_.type_info().channel_format() == cft_string)
+				throw std::invalid_argument(
+					"Samples of string-formatted streams can't be converted.");
+			window = std::make_shared<window_buffer>(static_cast<T *>(nullptr), min_capacity,
+				channel_count(),
+				typed_kernels<T>::select(conn_.type_info().channel_format()).retrieve);
+		}
+		{
+			std::lock_guard<std::mutex> lock(window_mut_);
+			if (window_ && window_->borrowed())
+				throw std::invalid_argument("The borrowed window hasn't been released.");
+			window_ = window;
+		}
+		if (!window) {
+			data_receiver_.set_sample_callback(data_receiver::sample_callback());
+			return 0;
+		}
+		std::vector<double> stamps;
+		data_receiver_.set_sample_callback(
+			[this, window, stamps](const sample_p *samples, std::size_t n) mutable {
+				stamps.resize(n);
+				for (std::size_t k = 0; k < n; ++k) stamps[k] = samples[k]->timestamp;
+				postprocessor_.process_timestamps(stamps.data(), n);
+				window->write(samples, stamps.data(), n);
+			});
+		return window->capacity();
+	}
+
+	/**
+	 * Borrow the most recent count samples of the ring set with set_window_buffer(), see
+	 * window_buffer::borrow().
+	 * @throws std::invalid_argument if there's no ring, lost_error if the stream has been lost.
+	 */
+	window_buffer::window borrow_window(uint32_t count, double timeout) {
+		std::shared_ptr<window_buffer> window;
+		{
+			std::lock_guard<std::mutex> lock(window_mut_);
+			window = window_;
+		}
+		if (!window) throw std::invalid_argument("The inlet has no window buffer.");
+		return window->borrow(count, timeout);
+	}
+
+	/**
+	 * Give the window borrowed with borrow_window() back.
+	 * @throws std::invalid_argument if no window is borrowed.
+	 */
+	void release_window() {
+		std::lock_guard<std::mutex> lock(window_mut_);
+		if (!window_) throw std::invalid_argument("The inlet has no window buffer.");
+		window_->release();
+	}
+
+	/// Hand the received samples (with unprocessed time stamps) to a function instead of queueing
+	/// them, see data_receiver::set_sample_callback().
+	void set_sample_callback(data_receiver::sample_callback callback) {
+		data_receiver_.set_sample_callback(std::move(callback));
 	}
 
 	/**
@@ -241,7 +624,7 @@ public:
 	 * @throws timeout_error (if the timeout expires), or lost_error (if the stream source has been
 	 * lost).
 	 */
-	const stream_info_impl &info(double timeout = FOREVER) { return info_receiver_.info(timeout); }
+	stream_info_impl_p info(double timeout = FOREVER) { return info_receiver_.info(timeout); }
 
 	/**
 	 * Retrieve an estimated time correction offset for the given stream.
@@ -261,6 +644,11 @@ public:
 		return time_receiver_.time_correction(remote_time, uncertainty, timeout);
 	}
 
+	/// Get the latest time correction estimate without waiting; returns false if there's none yet.
+	bool latest_time_correction(double &offset, double *remote_time, double *uncertainty) {
+		return time_receiver_.latest_time_correction(offset, remote_time, uncertainty);
+	}
+
 	/**
 	 * Set post-processing flags to use.
 	 *
@@ -274,7 +662,16 @@ public:
 	 * processing_options_t together (e.g., proc_clocksync|proc_dejitter); the default is to enable
 	 * all options.
 	 */
-	void set_postprocessing(uint32_t flags = proc_ALL) { postprocessor_.set_options(flags); }
+	void set_postprocessing(uint32_t flags = proc_ALL) {
+		receive_thread_processing_ = (flags & proc_receive_thread) != 0;
+		postprocessor_.set_options(flags);
+		if (flags & proc_receive_thread)
+			data_receiver_.set_timestamp_processor([this](double *values, std::size_t n) {
+				postprocessor_.process_received(values, n);
+			});
+		else
+			data_receiver_.set_timestamp_processor(nullptr);
+	}
 
 	/**
 	 * Open a new data stream.
@@ -288,6 +685,10 @@ public:
 	 */
 	void open_stream(double timeout = FOREVER) { data_receiver_.open_stream(timeout); }
 
+	/// Start opening the data stream without waiting for it, so the handshakes of several inlets
+	/// overlap (see lsl_open_streams()); open_stream() then waits for it.
+	void begin_open_stream() { data_receiver_.begin_open(); }
+
 	/**
 	 * Close the current data stream.
 	 *
@@ -304,6 +705,43 @@ public:
 	 */
 	std::size_t samples_available() { return data_receiver_.samples_available(); }
 
+	/// Record the latencies of the samples, see lsl_track_latency().
+	void track_latency(bool enabled) { data_receiver_.track_latency(enabled); }
+
+	/// Get the transfer statistics, see lsl_get_inlet_stats().
+	void get_stats(lsl_inlet_stats &stats) {
+		data_receiver_.get_stats(stats);
+		stats.time_correction_rtt = time_receiver_.estimate_rtt();
+		stats.memory_network += time_receiver_.buffer_bytes();
+		stats.memory_metadata = info_receiver_.info_bytes();
+		{
+			std::lock_guard<std::mutex> lock(target_mut_);
+			if (target_) stats.samples_dropped += target_->dropped();
+		}
+		{
+			std::lock_guard<std::mutex> lock(window_mut_);
+			if (window_) stats.samples_dropped += window_->dropped();
+		}
+		stats.memory_bytes = stats.memory_samples + stats.memory_queues + stats.memory_network +
+							 stats.memory_metadata;
+	}
+
+	/// Start receiving data in the background without waiting for the connection.
+	void start_stream() { data_receiver_.start_thread(); }
+
+	/// Set a function that is called after arm_notification() once new samples are queued.
+	void set_notification(std::function<void()> callback) {
+		data_receiver_.set_notification(std::move(callback));
+	}
+
+	/// Request a notification unless at least min_samples samples are available already.
+	bool arm_notification(std::size_t min_samples) {
+		return data_receiver_.arm_notification(min_samples);
+	}
+
+	/// Whether the stream's source has been lost irrecoverably.
+	bool lost() const { return conn_.lost(); }
+
 	/// Flush the queue, return the number of dropped samples
 	uint32_t flush() {
 		int nskipped = data_receiver_.flush();
@@ -322,7 +760,197 @@ public:
 	/// Override the half-time (forget factor) of the time-stamp smoothing.
 	void smoothing_halftime(float value) { postprocessor_.smoothing_halftime(value); }
 
+	/// Set how long pull calls spin waiting for samples before blocking.
+	void pull_spin_time(double seconds) { data_receiver_.set_spin_time(seconds); }
+
+	/// Let blocking chunk pulls return once min_samples samples are available.
+	void pull_min_samples(uint32_t min_samples) {
+		data_receiver_.set_pull_min_samples(min_samples);
+	}
+
+	/// Request the samples the outlet pushed in the last seconds when the stream is opened.
+	void request_history(double seconds) { data_receiver_.request_history(seconds); }
+
+	/// Set the options of the data connection's socket, see lsl_set_inlet_socket_options().
+	void set_socket_options(int32_t send_buffer_bytes, int32_t receive_buffer_bytes,
+		int32_t no_delay, int32_t busy_poll_us) {
+		data_receiver_.set_socket_options(
+			send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us);
+	}
+
+	/// Ask the outlet to multicast the samples, see lsl_set_inlet_multicast().
+	void set_multicast(bool enabled) { data_receiver_.set_multicast(enabled); }
+
+	/// Ask the outlet to send the samples as datagrams, see lsl_set_inlet_datagrams().
+	void set_datagrams(bool enabled) { data_receiver_.set_datagrams(enabled); }
+
+	/// Take the samples of an outlet in this process from its send buffer, see
+	/// lsl_set_inlet_in_process().
+	void set_in_process(bool enabled) { data_receiver_.set_in_process(enabled); }
+
+	/// Share a connection with the other streams of the outlet's process, see
+	/// lsl_set_inlet_bundling().
+	void set_bundling(bool enabled) { data_receiver_.set_bundling(enabled); }
+
+	/// Receive the samples of an outlet on this host through shared memory, see
+	/// lsl_set_inlet_shared_memory().
+	void set_shared_memory(bool enabled) { data_receiver_.set_shared_memory(enabled); }
+
+	/// Resample the stream to up/down times its rate, see lsl_set_inlet_resampling().
+	void set_resampling(uint32_t up, uint32_t down, bool server_side) {
+		data_receiver_.set_resampling(up, down, server_side);
+	}
+
+	/// Receive only the samples that match a filter, see lsl_set_inlet_value_filter().
+	void set_value_filter(value_filter filter) {
+		data_receiver_.set_value_filter(std::move(filter));
+	}
+
+	/**
+	 * Calibrate the channel values of pulls into float and double buffers, see
+	 * lsl_set_inlet_calibration(); without gains and offsets, the values aren't calibrated.
+	 * @throws std::invalid_argument for string streams or if a number of values doesn't match
+	 * the channel count.
+	 */
+	void set_calibration(const std::vector<double> &gains, const std::vector<double> &offsets) {
+		std::shared_ptr<const calibration> calib;
+		if (!gains.empty() || !offsets.empty())
+			calib = std::make_shared<calibration>(
+				conn_.type_info().channel_format(), channel_count(), gains, offsets);
+		data_receiver_.set_calibration(std::move(calib));
+	}
+
+	/**
+	 * Calibrate the pulls with the gains and offsets in the stream's description, see
+	 * lsl_set_inlet_calibration_from_desc().
+	 * @throws timeout_error if the description couldn't be retrieved within the timeout.
+	 */
+	void set_calibration_from_desc(double timeout) {
+		data_receiver_.set_calibration(std::make_shared<calibration>(
+			calibration::from_desc(*info(timeout), conn_.channel_subset())));
+	}
+
+	/**
+	 * Choose what the outlet does when this inlet's buffer is full.
+	 *
+	 * Takes effect when the stream is (re-)opened.
+	 * @throws std::invalid_argument for unknown policies or invalid parameters.
+	 */
+	void set_overflow_policy(lsl_overflow_policy_t policy, double parameter) {
+		if (policy < ovf_drop_oldest || policy > ovf_latest)
+			throw std::invalid_argument("Unknown overflow policy.");
+		if (policy == ovf_block && !(parameter > 0.0))
+			throw std::invalid_argument("The blocking timeout must be greater than zero.");
+		if (policy == ovf_decimate && !(parameter >= 2.0))
+			throw std::invalid_argument("The decimation factor must be at least 2.");
+		data_receiver_.set_overflow_policy(policy, parameter);
+	}
+
+	/**
+	 * Set how urgently the outlet serves this inlet's connection.
+	 *
+	 * Takes effect when the stream is (re-)opened.
+	 * @throws std::invalid_argument for unknown priority classes.
+	 */
+	void set_priority(lsl_transfer_priority_t priority) {
+		if (priority < prio_bulk || priority > prio_latency)
+			throw std::invalid_argument("Unknown priority class.");
+		data_receiver_.set_priority(priority);
+	}
+
+	/**
+	 * Change the buffer length and the chunk size requested from the outlet while the stream is
+	 * open, see lsl_set_inlet_buffering().
+	 * @param max_buflen The maximum amount of data to buffer, in the units of lsl_create_inlet().
+	 * @param max_chunklen The maximum chunk size in samples, 0 for the outlet's chunk sizes.
+	 * @throws std::invalid_argument for negative values.
+	 */
+	void set_buffering(int32_t max_buflen, int32_t max_chunklen) {
+		if (max_buflen < 0 || max_chunklen < 0)
+			throw std::invalid_argument("The buffering parameters must not be negative.");
+		const double srate = conn_.type_info().nominal_srate() / conn_.decimation();
+		data_receiver_.set_buffering(
+			(srate ? (int)(srate * max_buflen) : max_buflen * 100) + 1, max_chunklen);
+	}
+
+	/**
+	 * Ask the outlet to limit the bandwidth of this inlet's connection (0 for no limit).
+	 *
+	 * Takes effect when the stream is (re-)opened.
+	 * @throws std::invalid_argument for negative limits.
+	 */
+	void set_max_bandwidth(double bytes_per_second) {
+		if (!(bytes_per_second >= 0.0))
+			throw std::invalid_argument("The bandwidth limit must not be negative.");
+		data_receiver_.set_max_bandwidth(bytes_per_second);
+	}
+
+	/**
+	 * Fail over to another stream with the same source_id if the current one breaks down.
+	 * @throws std::invalid_argument if the stream can't be recovered.
+	 */
+	void set_failover(bool enabled) { conn_.set_failover(enabled); }
+
 private:
+	/// Pull a chunk in multiplexed or planar order, see pull_chunk_multiplexed().
+	template <class T>
+	uint32_t pull_chunk(T *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements, double timeout,
+		bool planar) {
+		uint32_t elements_written;
+		data_receiver::throw_pull_error(try_pull_chunk(data_buffer, timestamp_buffer,
+			data_buffer_elements, timestamp_buffer_elements, timeout, planar, elements_written));
+		return elements_written;
+	}
+
+	/// Pull a chunk like pull_chunk(), but return a lost stream as lsl_lost_error.
+	/// @throws std::runtime_error if the buffers don't fit the stream.
+	template <class T>
+	lsl_error_code_t try_pull_chunk(T *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements, double timeout,
+		bool planar, uint32_t &elements_written) {
+		std::size_t num_chans = conn_.type_info().channel_count(),
+					max_samples = data_buffer_elements / num_chans;
+		if (data_buffer_elements % num_chans != 0)
+			throw std::runtime_error(
+				"The number of buffer elements must be a multiple of the stream's channel count.");
+		if (timestamp_buffer && max_samples != timestamp_buffer_elements)
+			throw std::runtime_error(
+				"The timestamp buffer must hold the same number of samples as the data buffer.");
+		uint32_t samples_written;
+		const lsl_error_code_t ec = data_receiver_.try_pull_chunk_typed(data_buffer,
+			timestamp_buffer, static_cast<uint32_t>(max_samples), timeout, planar, samples_written);
+		if (timestamp_buffer)
+			postprocessor_.process_timestamps(timestamp_buffer, samples_written);
+		else
+			postprocessor_.skip_samples(samples_written);
+		elements_written = static_cast<uint32_t>(samples_written * num_chans);
+		return ec;
+	}
+
+	template <class T>
+	uint32_t pull_chunk_noexcept(T *data_buffer, double *timestamp_buffer,
+		std::size_t data_buffer_elements, std::size_t timestamp_buffer_elements, double timeout,
+		lsl_error_code_t *ec, bool planar) noexcept {
+		lsl_error_code_t dummy;
+		if (!ec) ec = &dummy;
+		*ec = lsl_no_error;
+		try {
+			uint32_t elements_written;
+			*ec = try_pull_chunk(data_buffer, timestamp_buffer, data_buffer_elements,
+				timestamp_buffer_elements, timeout, planar, elements_written);
+			return elements_written;
+		} catch (timeout_error &) { *ec = lsl_timeout_error; } catch (lost_error &) {
+			*ec = lsl_lost_error;
+		} catch (std::invalid_argument &) { *ec = lsl_argument_error; } catch (std::range_error &) {
+			*ec = lsl_argument_error;
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unexpected error in %s: %s", __func__, e.what());
+			*ec = lsl_internal_error;
+		}
+		return 0;
+	}
+
 	/// post-process a time stamp
 	double postprocess(double stamp) {
 		return stamp ? postprocessor_.process_timestamp(stamp) : stamp;
@@ -338,6 +966,23 @@ private:
 
 	/// class for post-processing time stamps
 	time_postprocessor postprocessor_;
+	/// whether the time stamps are post-processed on the receive thread (proc_receive_thread)
+	std::atomic<bool> receive_thread_processing_{false};
+
+	/// the last ring set with set_target_buffer(), kept for releasing its samples
+	std::shared_ptr<target_buffer> target_;
+	/// protects target_
+	std::mutex target_mut_;
+
+	/// the ring set with set_window_buffer(), if any
+	std::shared_ptr<window_buffer> window_;
+	/// protects window_
+	std::mutex window_mut_;
+
+	/// the missed samples reported by pull_chunk_seq() so far
+	lsl_chunk_gaps gaps_seen_{0, 0};
+	/// protects gaps_seen_
+	std::mutex gaps_mut_;
 };
 
 } // namespace lsl
@@ -1,164 +1,563 @@
 #include "stream_outlet_impl.h"
 #include "api_config.h"
+#include "datagram_sender.h"
+#include "discovery_cache.h"
+#include "host_daemon.h"
+#include "io_context_pool.h"
+#include "local_feed.h"
 #include "sample.h"
+#include "sample_frame.h"
 #include "send_buffer.h"
+#include "staging_ring.h"
 #include "tcp_server.h"
+#include "thread_policy.h"
+#include "tracing.h"
 #include "udp_server.h"
 #include <algorithm>
+#include <boost/asio/ip/host_name.hpp>
+#include <cmath>
+#include <cstring>
 #include <memory>
+#include <numeric>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 namespace lsl {
 
-stream_outlet_impl::stream_outlet_impl(
-	const stream_info_impl &info, int32_t chunk_size, int32_t max_capacity)
-	: sample_factory_(std::make_shared<factory>(info.channel_format(), info.channel_count(),
+/// the number of samples that push_chunk_planar() gathers at once
+const std::size_t planar_block_samples = 16;
+
+stream_outlet_impl::stream_outlet_impl(const stream_info_impl &info, int32_t chunk_size,
+	int32_t max_capacity, bool keep_identity, stream_config_p config)
+	: config_(config ? std::move(config) : stream_config::current()),
+	  sample_factory_(factory::for_stream(info.channel_format(), info.channel_count(),
 		  static_cast<uint32_t>(
-			  info.nominal_srate()
+			  // the pool holds the most samples the send buffer may queue
+			  config_->no_allocation ? std::max(max_capacity, 1)
+			  : info.nominal_srate()
 				  ? info.nominal_srate() * api_config::get_instance()->outlet_buffer_reserve_ms() /
 						1000
-				  : api_config::get_instance()->outlet_buffer_reserve_samples()))),
-	  chunk_size_(chunk_size), info_(std::make_shared<stream_info_impl>(info)),
-	  send_buffer_(std::make_shared<send_buffer>(max_capacity)) {
+				  : api_config::get_instance()->outlet_buffer_reserve_samples()),
+		  config_->no_allocation || api_config::get_instance()->numa_aware())),
+	  chunk_size_(chunk_size),
+	  force_default_timestamps_(config_->force_default_timestamps),
+	  info_(std::make_shared<stream_info_impl>(info)),
+	  send_buffer_(std::make_shared<send_buffer>(max_capacity, sample_factory_->sample_size(),
+		  api_config::get_instance()->outlet_buffer_max_bytes(),
+		  api_config::get_instance()->outlet_history_length(),
+		  api_config::get_instance()->outlet_history_seconds())),
+	  io_pool_(config_->park_idle_seconds > 0.0 ? io_context_pool::parking_pool()
+												: io_context_pool::outlet_pool()),
+	  io_thread_count_(std::make_shared<io_thread_count>()) {
 	ensure_lsl_initialized();
 	const api_config *cfg = api_config::get_instance();
+	if (info.nominal_srate() != IRREGULAR_RATE && config_->deduced_timestamps_max > 0)
+		send_buffer_->enable_deduced_timestamps(
+			static_cast<uint32_t>(config_->deduced_timestamps_max),
+			config_->deduced_timestamps_tolerance, 1.0 / info.nominal_srate());
+	if (config_->no_allocation) {
+		sample_factory_->report_growth();
+		send_buffer_->set_preallocate_queues(true);
+		if (info.channel_format() == cft_string)
+			LOG_F(WARNING, "%s: The strings of string streams are allocated when they're pushed",
+				info.name().c_str());
+	}
+	if (cfg->numa_aware()) {
+		const int node = current_numa_node();
+		sample_factory_->set_numa_node(node);
+		send_buffer_->set_numa_node(node);
+	}
+
+	if (!keep_identity && !cfg->host_daemon().empty() && info.channel_format() != cft_string) try {
+			// the daemon publishes the identity the tcp_servers would assign
+			info_->session_id(cfg->session_id());
+			info_->reset_uid();
+			info_->created_at(lsl_clock());
+			info_->hostname(asio::ip::host_name());
+			host_link_.reset(new host_link(cfg->host_daemon(), *info_, send_buffer_));
+		} catch (std::exception &e) {
+			LOG_F(INFO, "%s is served by its process: %s", info_->name().c_str(), e.what());
+		}
 
-	// instantiate IPv4 and/or IPv6 stacks (depending on settings)
-	if (cfg->allow_ipv4()) try {
+	// instantiate IPv4 and/or IPv6 stacks (depending on settings), their multicast responders
+	// are set up once the stream info is complete
+	std::vector<std::pair<udp, io_context_p>> stacks;
+	if (host_link_) {
+		// the daemon serves the stream
+	} else if (cfg->allow_ipv4()) try {
 			instantiate_stack(tcp::v4(), udp::v4());
+			stacks.emplace_back(udp::v4(), ios_.back());
 		} catch (std::exception &e) {
 			LOG_F(WARNING, "Could not instantiate IPv4 stack: %s", e.what());
 		}
-	if (cfg->allow_ipv6()) try {
+	if (!host_link_ && cfg->allow_ipv6()) try {
 			instantiate_stack(tcp::v6(), udp::v6());
+			stacks.emplace_back(udp::v6(), ios_.back());
 		} catch (std::exception &e) {
 			LOG_F(WARNING, "Could not instantiate IPv6 stack: %s", e.what());
 		}
 
 	// fail if both stacks failed to instantiate
-	if (tcp_servers_.empty() || udp_servers_.empty())
+	if (!host_link_ && (tcp_servers_.empty() || udp_servers_.empty()))
 		throw std::runtime_error("Neither the IPv4 nor the IPv6 stack could be instantiated.");
 
+	// the tcp_servers have assigned a new identity
+	if (keep_identity) {
+		info_->uid(info.uid());
+		info_->session_id(info.session_id());
+		info_->created_at(info.created_at());
+	}
+	// the UID is final now (see tcp_server)
+	send_buffer_->set_trace_uid(info_->uid());
+	local_feed::add(info_->uid(), send_buffer_, sample_factory_);
+	if (!cfg->outlet_spill_directory().empty())
+		send_buffer_->enable_spill(
+			sample_factory_, cfg->outlet_spill_directory(), cfg->outlet_spill_max_bytes());
+
+	if (!host_link_ && cfg->multicast_data()) try {
+			set_multicast(true);
+		} catch (std::exception &e) {
+			LOG_F(INFO, "%s is not multicast: %s", info_->name().c_str(), e.what());
+		}
+
 	// get the async request chains set up
 	for (auto &tcp_server : tcp_servers_) tcp_server->begin_serving();
 	for (auto &udp_server : udp_servers_) udp_server->begin_serving();
-	for (auto &responder : responders_) responder->begin_serving();
+	for (const auto &stack : stacks) {
+		if (!cfg->background_discovery_setup()) {
+			setup_responders(stack.first, *stack.second);
+			continue;
+		}
+		// binding the sockets and joining the multicast groups takes a while with many
+		// interfaces, so the IO thread does it (the destructor waits for it)
+		{
+			std::lock_guard<std::mutex> lock(responders_mut_);
+			++pending_setups_;
+		}
+		const udp protocol = stack.first;
+		asio::post(*stack.second, [this, protocol, io = stack.second]() {
+			setup_responders(protocol, *io);
+			{
+				std::lock_guard<std::mutex> lock(responders_mut_);
+				--pending_setups_;
+			}
+			responders_ready_.notify_all();
+		});
+	}
+
+	// the shared IO threads are already running
+	if (io_pool_) return;
 
-	// and start the IO threads to handle them
+	// otherwise, start the IO threads to handle them
 	const std::string name{"IO_" + this->info().name().substr(0, 11)};
-	for (const auto &io : ios_)
-		io_threads_.emplace_back(std::make_shared<std::thread>([io, name]() {
-			loguru::set_thread_name(name.c_str());
-			while (true) {
-				try {
-					io->run();
-					return;
-				} catch (std::exception &e) {
-					LOG_F(ERROR, "Error during io_context processing: %s", e.what());
+	const int node = send_buffer_->numa_node();
+	for (const auto &io : ios_) {
+		{
+			std::lock_guard<std::mutex> lock(io_thread_count_->mut);
+			++io_thread_count_->running;
+		}
+		auto count = io_thread_count_;
+		auto cpu = io_cpu_;
+		io_threads_.emplace_back(
+			std::make_shared<managed_thread>(lsl_thread_io, name, [io, node, count, cpu]() {
+				pin_to_numa_node(node);
+				{
+					const cpu_account::scope cpu_scope = cpu->attach();
+					while (true) {
+						try {
+							io->run();
+							break;
+						} catch (std::exception &e) {
+							LOG_F(ERROR, "Error during io_context processing: %s", e.what());
+						}
+					}
 				}
-			}
-		}));
+				std::lock_guard<std::mutex> lock(count->mut);
+				if (--count->running == 0) count->exited.notify_all();
+			}));
+	}
 }
 
 void stream_outlet_impl::instantiate_stack(tcp tcp_protocol, udp udp_protocol) {
 	// get api_config
 	const api_config *cfg = api_config::get_instance();
 	std::string listen_address = cfg->listen_address();
-	int multicast_ttl = cfg->multicast_ttl();
-	uint16_t multicast_port = cfg->multicast_port();
 	LOG_F(2, "%s: Trying to listen at address '%s'", info().name().c_str(), listen_address.c_str());
 	// create TCP data server
-	ios_.push_back(std::make_shared<asio::io_context>());
+	ios_.push_back(io_pool_ ? io_pool_->next() : std::make_shared<asio::io_context>());
 	tcp_servers_.push_back(std::make_shared<tcp_server>(
-		info_, ios_.back(), send_buffer_, sample_factory_, tcp_protocol, chunk_size_));
+		info_, ios_.back(), send_buffer_, sample_factory_, tcp_protocol, chunk_size_, config_));
 	// create UDP time server
-	ios_.push_back(std::make_shared<asio::io_context>());
+	ios_.push_back(io_pool_ ? io_pool_->next() : std::make_shared<asio::io_context>());
 	udp_servers_.push_back(std::make_shared<udp_server>(info_, *ios_.back(), udp_protocol));
-	// create UDP multicast responders
+}
+
+void stream_outlet_impl::setup_responders(udp protocol, asio::io_context &io) {
+	const api_config *cfg = api_config::get_instance();
+	std::vector<udp_server_p> responders;
 	for (const auto &mcastaddr : cfg->multicast_addresses()) {
 		try {
 			// use only addresses for the protocol that we're supposed to use here
 			auto address = asio::ip::make_address(mcastaddr);
-			if (udp_protocol == udp::v4() ? address.is_v4() : address.is_v6())
-				responders_.push_back(std::make_shared<udp_server>(
-					info_, *ios_.back(), mcastaddr, multicast_port, multicast_ttl, listen_address));
+			if (protocol == udp::v4() ? address.is_v4() : address.is_v6())
+				responders.push_back(std::make_shared<udp_server>(info_, io, mcastaddr,
+					cfg->multicast_port(), cfg->multicast_ttl(), cfg->listen_address()));
 		} catch (std::exception &e) {
 			LOG_F(WARNING, "Couldn't create multicast responder for %s (%s)", mcastaddr.c_str(),
 				e.what());
 		}
 	}
+	for (auto &responder : responders) responder->begin_serving();
+	std::lock_guard<std::mutex> lock(responders_mut_);
+	responders_.insert(responders_.end(), responders.begin(), responders.end());
 }
 
 stream_outlet_impl::~stream_outlet_impl() {
 	try {
-		// cancel all request chains
-		for (auto &tcp_server : tcp_servers_) tcp_server->end_serving();
-		for (auto &udp_server : udp_servers_) udp_server->end_serving();
-		for (auto &responder : responders_) responder->end_serving();
+		// the staged samples are still pushed
+		staging_.reset();
+		// the sessions unregister their consumers while shutting down, possibly after the
+		// callback's owner is gone
+		send_buffer_->set_consumers_callback(nullptr);
+		begin_shutdown();
 
-		// In theory, an io context should end quickly, but in practice it
-		// might take a while. So we
-		// 1. ask them to stop after they've finished their current task
-		// 2. wait a bit
-		// 3. stop the io contexts from our thread. Not ideal, but better than
-		// 4. waiting a bit and
-		// 5. detaching thread, i.e. letting it hang and continue tearing down
-		//    the outlet
-		for (auto &ios : ios_) asio::post(*ios, [ios]() { ios->stop(); });
+		// the shared io contexts keep running, so we only wait until the sockets are closed
+		if (io_pool_) {
+			for (auto &ios : ios_)
+				if (!io_context_pool::drain(*ios, 2.0))
+					LOG_F(WARNING, "Timed out waiting for %s's sockets to close",
+						this->info().name().c_str());
+			return;
+		}
+
+		// In theory, an io context should end quickly, but in practice it might take a while.
+		// So we wait a bit for the IO threads to finish their current tasks, then stop the io
+		// contexts from our thread (not ideal, but better than hanging) and, as a last resort,
+		// detach the threads and continue tearing down the outlet
 		const char *name = this->info().name().c_str();
-		for (int try_nr = 0; try_nr <= 100; ++try_nr) {
-			switch (try_nr) {
-			case 0: DLOG_F(INFO, "Trying to join IO threads for %s", name); break;
-			case 20: LOG_F(INFO, "Waiting for %s's IO threads to end", name); break;
-			case 80:
+		std::unique_lock<std::mutex> lock(io_thread_count_->mut);
+		const auto wait = [this, &lock](double seconds) {
+			return io_thread_count_->exited.wait_for(lock, std::chrono::duration<double>(seconds),
+				[this]() { return io_thread_count_->running == 0; });
+		};
+		DLOG_F(INFO, "Trying to join IO threads for %s", name);
+		if (!wait(0.5)) {
+			LOG_F(INFO, "Waiting for %s's IO threads to end", name);
+			if (!wait(1.5)) {
 				LOG_F(WARNING, "Stopping io_contexts for %s", name);
-				for (std::size_t k = 0; k < io_threads_.size(); k++) {
-					if (!io_threads_[k]->joinable()) {
-						LOG_F(ERROR, "Tearing down stream_outlet of %s's thread #%lu", name, k);
-						ios_[k]->stop();
-					}
+				for (auto &ios : ios_) ios->stop();
+				if (!wait(0.5)) {
+					LOG_F(ERROR, "Detaching io_threads for %s", name);
+					for (auto &thread : io_threads_) thread->detach();
+					return;
 				}
-				break;
-			case 100:
-				LOG_F(ERROR, "Detaching io_threads for %s", name);
-				for (auto &thread : io_threads_) thread->detach();
-				return;
-			}
-
-			std::this_thread::sleep_for(std::chrono::milliseconds(25));
-			if (std::all_of(io_threads_.begin(), io_threads_.end(),
-					[](const thread_p &thread) { return thread->joinable(); })) {
-				for (auto &thread : io_threads_) thread->join();
-				DLOG_F(INFO, "All of %s's IO threads were joined succesfully", name);
-				break;
 			}
 		}
+		lock.unlock();
+		for (auto &thread : io_threads_) thread->join();
+		DLOG_F(INFO, "All of %s's IO threads were joined succesfully", name);
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Unexpected error during destruction of a stream outlet: %s", e.what());
 	} catch (...) { LOG_F(ERROR, "Severe error during stream outlet shutdown."); }
 }
 
+void stream_outlet_impl::begin_shutdown() {
+	if (shutting_down_) return;
+	shutting_down_ = true;
+	discovery_cache::forget(info_->uid());
+	local_feed::remove(info_->uid(), send_buffer_.get());
+	// ends the stream at the host daemon
+	host_link_.reset();
+	// cancel all request chains
+	for (auto &tcp_server : tcp_servers_) tcp_server->end_serving();
+	for (auto &udp_server : udp_servers_) udp_server->end_serving();
+	{
+		// the responders might still be set up in the background
+		std::unique_lock<std::mutex> lock(responders_mut_);
+		responders_ready_.wait(lock, [this]() { return pending_setups_ == 0; });
+		for (auto &responder : responders_) responder->end_serving();
+	}
+	// ask the IO threads to end after they've finished their current tasks
+	if (!io_pool_)
+		for (auto &ios : ios_) asio::post(*ios, [ios]() { ios->stop(); });
+}
+
 void stream_outlet_impl::push_numeric_raw(const void *data, double timestamp, bool pushthrough) {
-	if (lsl::api_config::get_instance()->force_default_timestamps()) timestamp = 0.0;
+	if (try_stage(data, cft_undefined,
+			format_sizes[info_->channel_format()] * info_->channel_count(), 1, nullptr, timestamp,
+			pushthrough))
+		return;
+	if (skip_push(1)) return;
+	LSL_TRACE_BEGIN("push_sample", info_->uid(), 0);
+	if (force_default_timestamps_) timestamp = 0.0;
 	sample_p smp(
 		sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
 	smp->assign_untyped(data);
 	send_buffer_->push_sample(smp);
+	LSL_TRACE_END("push_sample", info_->uid(), smp->seq);
+}
+
+void stream_outlet_impl::push_samples(const sample_p *samples, std::size_t n) {
+	flush_staged();
+	if (!n || skip_push(n)) return;
+	// the send buffer numbers the samples, so a sample that's been numbered before (e.g. pushed
+	// into another outlet whose sessions may still be sending it) is copied instead of renumbered
+	std::size_t first = 0;
+	while (first < n && !samples[first]->seq) ++first;
+	if (first == n) return send_buffer_->push_samples(samples, n);
+	std::vector<sample_p> own(samples, samples + n);
+	std::vector<uint32_t> all_channels(info_->channel_count());
+	std::iota(all_channels.begin(), all_channels.end(), 0);
+	for (std::size_t k = first; k < n; ++k) {
+		if (!own[k]->seq) continue;
+		sample_p copy(sample_factory_->new_sample(own[k]->timestamp, own[k]->pushthrough));
+		copy->assign_channels(*own[k], all_channels.data());
+		own[k] = std::move(copy);
+	}
+	send_buffer_->push_samples(own.data(), n);
+}
+
+bool stream_outlet_impl::skip_push(std::size_t n) {
+	// without consumers or a history, the sample's allocation, time stamp and conversion would
+	// be thrown away
+	if (!send_buffer_->idle()) return false;
+	send_buffer_->count_skipped(n);
+	return true;
+}
+
+bool stream_outlet_impl::have_consumers() {
+	return host_link_ ? host_link_->have_consumers() : send_buffer_->have_consumers();
 }
 
-bool stream_outlet_impl::have_consumers() { return send_buffer_->have_consumers(); }
+void stream_outlet_impl::set_consumers_callback(std::function<void(std::size_t)> callback) {
+	send_buffer_->set_consumers_callback(std::move(callback));
+}
 
 bool stream_outlet_impl::wait_for_consumers(double timeout) {
+	if (host_link_) return host_link_->wait_for_consumers(timeout);
 	return send_buffer_->wait_for_consumers(timeout);
 }
 
+bool stream_outlet_impl::wait_for_ready(double timeout) {
+	std::unique_lock<std::mutex> lock(responders_mut_);
+	return responders_ready_.wait_for(lock, std::chrono::duration<double>(timeout),
+		[this]() { return pending_setups_ == 0; });
+}
+
+uint64_t stream_outlet_impl::dropped_samples() { return send_buffer_->dropped_samples(); }
+
+uint64_t stream_outlet_impl::zerocopy_chunks() {
+	uint64_t chunks = 0;
+	for (const auto &server : tcp_servers_) chunks += server->zerocopy_chunks();
+	return chunks;
+}
+
+void stream_outlet_impl::get_stats(lsl_outlet_stats &stats) {
+	const send_buffer::usage_stats usage = send_buffer_->usage();
+	stats.samples_pushed = usage.pushed;
+	stats.samples_dropped = usage.dropped + staging_dropped_.load(std::memory_order_relaxed);
+	stats.consumers = static_cast<uint32_t>(usage.consumers);
+	stats.max_queued = static_cast<uint32_t>(usage.max_queued);
+	stats.samples_sent = stats.bytes_sent = stats.chunks_sent = 0;
+	stats.memory_network = 0;
+	stats.throttled_seconds = 0.0;
+	// the threads of the shared IO thread pool work for all outlets, so they're not counted
+	stats.cpu_seconds = io_cpu_->seconds();
+	for (const auto &server : tcp_servers_) {
+		stats.throttled_seconds += server->throttled_seconds();
+		stats.cpu_seconds += server->cpu_seconds();
+		stats.samples_sent += server->samples_sent();
+		stats.bytes_sent += server->bytes_sent();
+		stats.chunks_sent += server->chunks_sent();
+		stats.memory_network += server->feed_buffer_bytes();
+	}
+	// each UDP server has a receive buffer (the shared servers' ones belong to no outlet)
+	{
+		std::lock_guard<std::mutex> lock(responders_mut_);
+		for (const auto *servers : {&udp_servers_, &responders_})
+			for (const auto &server : *servers) stats.memory_network += server->memory_bytes();
+	}
+	stats.memory_samples = sample_factory_->memory_bytes();
+	stats.memory_queues = usage.queue_bytes;
+	stats.memory_metadata = info_->cached_bytes();
+	stats.memory_bytes = stats.memory_samples + stats.memory_queues + stats.memory_network +
+						 stats.memory_metadata;
+}
+
+void stream_outlet_impl::set_history(double seconds, int32_t max_samples) {
+	if (seconds < 0.0 || max_samples < 0)
+		throw std::invalid_argument("The history limits must not be negative.");
+	send_buffer_->set_history(static_cast<std::size_t>(max_samples), seconds);
+}
+
+void stream_outlet_impl::set_socket_options(int32_t send_buffer_bytes,
+	int32_t receive_buffer_bytes, int32_t no_delay, int32_t busy_poll_us) {
+	for (auto &server : tcp_servers_)
+		server->set_socket_options(server->get_socket_options().updated(
+			send_buffer_bytes, receive_buffer_bytes, no_delay, busy_poll_us));
+}
+
+void stream_outlet_impl::set_multicast(bool enabled) {
+	datagram_sender_p sender;
+	if (enabled) {
+		for (auto &server : tcp_servers_)
+			if ((sender = server->get_multicast_sender())) return;
+		if (!info_->v4data_port())
+			throw std::invalid_argument("Multicasting requires the IPv4 stack.");
+		sender = std::make_shared<datagram_sender>(info_, send_buffer_);
+	}
+	for (auto &server : tcp_servers_) server->set_multicast_sender(sender);
+}
+
+void stream_outlet_impl::set_chunk_size(int32_t chunk_size) {
+	chunk_size_ = chunk_size;
+	for (auto &server : tcp_servers_) server->set_chunk_size(chunk_size);
+}
+
+void stream_outlet_impl::set_config(stream_config_p config) {
+	config_ = std::move(config);
+	for (auto &server : tcp_servers_) server->set_config(config_);
+}
+
+std::size_t stream_outlet_impl::update_desc(const stream_info_impl &info) {
+	std::lock_guard<std::mutex> lock(desc_mut_);
+	pugi::xml_document before;
+	before.append_copy(static_cast<const stream_info_impl &>(*info_).desc());
+	const uint64_t from = info_->metadata_version();
+	info_->replace_desc(info.desc());
+	const uint64_t to = info_->metadata_version();
+	// the inlets only apply a patch to the version they have, so if the info changed in the
+	// meantime they fetch it again once they revalidate it
+	if (to != from + 1) return 0;
+	const auto frame = std::make_shared<const std::string>(control_frame(control_metadata_patch,
+		stream_info_impl::desc_patch(before.first_child(), info.desc(), from, to)));
+	std::size_t sent = 0;
+	for (auto &srv : tcp_servers_) sent += srv->send_control(frame);
+	return sent;
+}
+
+/// The header of a push in the staging ring (see set_async_push()), followed by the time stamps
+/// (if there's one per sample) and the values.
+struct staged_push {
+	uint32_t num_samples;
+	/// the format of the values, cft_undefined for values in the stream's format
+	uint8_t format;
+	uint8_t pushthrough;
+	uint8_t has_timestamps;
+	/// the time stamp of the first sample if there's none per sample
+	double timestamp;
+};
+
+static lsl_channel_format_t format_of(const float *) { return cft_float32; }
+static lsl_channel_format_t format_of(const double *) { return cft_double64; }
+static lsl_channel_format_t format_of(const int64_t *) { return cft_int64; }
+static lsl_channel_format_t format_of(const int32_t *) { return cft_int32; }
+static lsl_channel_format_t format_of(const int16_t *) { return cft_int16; }
+static lsl_channel_format_t format_of(const char *) { return cft_int8; }
+
+void stream_outlet_impl::set_async_push(std::size_t buffer_bytes) {
+	if (buffer_bytes && info_->channel_format() == cft_string)
+		throw std::invalid_argument(
+			"The samples of string streams can't be pushed asynchronously.");
+	// the staged samples are pushed before the ring is replaced
+	staging_.reset();
+	if (buffer_bytes)
+		staging_.reset(new staging_ring(buffer_bytes, "P_" + info_->name().substr(0, 12),
+			[this](const char *record, std::size_t) { push_staged(record); }));
+}
+
+void stream_outlet_impl::flush_staged() {
+	if (staging_) staging_->flush();
+}
+
+template <class T>
+bool stream_outlet_impl::try_stage(const T *data, std::size_t num_samples,
+	const double *timestamps, double timestamp, bool pushthrough) {
+	return try_stage(static_cast<const void *>(data), format_of(data),
+		num_samples * info_->channel_count() * sizeof(T), num_samples, timestamps, timestamp,
+		pushthrough);
+}
+
+bool stream_outlet_impl::try_stage(const void *data, lsl_channel_format_t format,
+	std::size_t value_bytes, std::size_t num_samples, const double *timestamps, double timestamp,
+	bool pushthrough) {
+	if (!staging_) return false;
+	// the samples aren't even copied if nobody would get them
+	if (skip_push(num_samples)) return true;
+	// forced default time stamps are taken now, for each sample, as if it was pushed right away
+	const bool forced = force_default_timestamps_;
+	const std::size_t stamp_bytes = timestamps || forced ? num_samples * sizeof(double) : 0;
+	char *pos = staging_->reserve(sizeof(staged_push) + stamp_bytes + value_bytes);
+	if (!pos) {
+		staging_dropped_.fetch_add(num_samples, std::memory_order_relaxed);
+		return true;
+	}
+	staged_push push;
+	push.num_samples = static_cast<uint32_t>(num_samples);
+	push.format = static_cast<uint8_t>(format);
+	push.pushthrough = pushthrough;
+	push.has_timestamps = stamp_bytes != 0;
+	// the samples were captured when they were pushed, not when they're processed
+	push.timestamp = (timestamps || timestamp != 0.0) && !forced ? timestamp : lsl_clock();
+	memcpy(pos, &push, sizeof(push));
+	if (forced)
+		for (std::size_t k = 0; k < num_samples; ++k)
+			memcpy(pos + sizeof(push) + k * sizeof(double), &push.timestamp, sizeof(double));
+	else if (timestamps)
+		memcpy(pos + sizeof(push), timestamps, stamp_bytes);
+	memcpy(pos + sizeof(push) + stamp_bytes, data, value_bytes);
+	staging_->commit();
+	return true;
+}
+
+void stream_outlet_impl::push_staged(const char *record) {
+	staged_push push;
+	memcpy(&push, record, sizeof(push));
+	const char *values = record + sizeof(push);
+	const double *timestamps = nullptr;
+	// the records are aligned to 8 bytes, so are the time stamps and the values
+	if (push.has_timestamps) {
+		timestamps = reinterpret_cast<const double *>(values);
+		values += push.num_samples * sizeof(double);
+	}
+	const std::size_t num_chans = info_->channel_count();
+	const bool pushthrough = push.pushthrough != 0;
+	const auto typed = [&](auto *type) {
+		using T = std::remove_pointer_t<decltype(type)>;
+		const T *data = reinterpret_cast<const T *>(values);
+		const auto assign = sample_factory_->kernels<T>().assign;
+		enqueue_samples(
+			push.num_samples, timestamps, push.timestamp, pushthrough,
+			[&](sample &s, std::size_t k) { s.assign_typed(&data[k * num_chans], assign); }, true);
+	};
+	switch (push.format) {
+	case cft_float32: typed(static_cast<float *>(nullptr)); break;
+	case cft_double64: typed(static_cast<double *>(nullptr)); break;
+	case cft_int64: typed(static_cast<int64_t *>(nullptr)); break;
+	case cft_int32: typed(static_cast<int32_t *>(nullptr)); break;
+	case cft_int16: typed(static_cast<int16_t *>(nullptr)); break;
+	case cft_int8: typed(static_cast<char *>(nullptr)); break;
+	default: {
+		const std::size_t sample_bytes = format_sizes[info_->channel_format()] * num_chans;
+		enqueue_samples(
+			push.num_samples, timestamps, push.timestamp, pushthrough,
+			[&](sample &s, std::size_t k) { s.assign_untyped(values + k * sample_bytes); }, true);
+	}
+	}
+}
+
 template <class T>
 void stream_outlet_impl::enqueue(const T *data, double timestamp, bool pushthrough) {
-	if (lsl::api_config::get_instance()->force_default_timestamps()) timestamp = 0.0;
+	if (try_stage(data, 1, nullptr, timestamp, pushthrough)) return;
+	if (skip_push(1)) return;
+	LSL_TRACE_BEGIN("push_sample", info_->uid(), 0);
+	if (force_default_timestamps_) timestamp = 0.0;
 	sample_p smp(
 		sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
-	smp->assign_typed(data);
+	smp->assign_typed(data, sample_factory_->kernels<T>().assign);
 	send_buffer_->push_sample(smp);
+	LSL_TRACE_END("push_sample", info_->uid(), smp->seq);
 }
 
 template void stream_outlet_impl::enqueue<char>(const char *data, double, bool);
@@ -169,4 +568,246 @@ template void stream_outlet_impl::enqueue<float>(const float *data, double, bool
 template void stream_outlet_impl::enqueue<double>(const double *data, double, bool);
 template void stream_outlet_impl::enqueue<std::string>(const std::string *data, double, bool);
 
+void stream_outlet_impl::enqueue_moved(std::string *data, double timestamp, bool pushthrough) {
+	flush_staged();
+	if (skip_push(1)) return;
+	LSL_TRACE_BEGIN("push_sample", info_->uid(), 0);
+	if (force_default_timestamps_) timestamp = 0.0;
+	sample_p smp(
+		sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
+	smp->assign_moved(data);
+	send_buffer_->push_sample(smp);
+	LSL_TRACE_END("push_sample", info_->uid(), smp->seq);
+}
+
+template <class F>
+void stream_outlet_impl::enqueue_samples(std::size_t num_samples, const double *timestamps,
+	double timestamp, bool pushthrough, F &&fill, bool staged) {
+	if (!num_samples || skip_push(num_samples)) return;
+	LSL_TRACE_BEGIN("push_chunk", info_->uid(), 0);
+	// the chunk is kept per thread, so repeated pushes (e.g. of markers) don't allocate
+	static thread_local std::vector<sample_p> chunk;
+	if (chunk.size() < num_samples) chunk.resize(num_samples);
+	sample_p *samples = chunk.data();
+	// the samples go back to the factory once they're sent (or if filling them failed)
+	struct release_samples {
+		sample_p *samples;
+		std::size_t n;
+		~release_samples() {
+			for (std::size_t k = 0; k < n; k++) samples[k].reset();
+		}
+	} release{samples, num_samples};
+	// all samples are allocated at once
+	sample_factory_->new_samples(samples, num_samples);
+	// the clock is read at most once per chunk
+	double now = 0.0;
+	for (std::size_t k = 0; k < num_samples; k++) {
+		double ts = timestamps ? timestamps[k] : (k == 0 ? timestamp : DEDUCED_TIMESTAMP);
+		if (force_default_timestamps_ && !staged) ts = 0.0;
+		if (ts == 0.0) ts = now != 0.0 ? now : (now = lsl_clock());
+		samples[k]->timestamp = ts;
+		fill(*samples[k], k);
+	}
+	samples[num_samples - 1]->pushthrough = pushthrough;
+	send_buffer_->push_samples(samples, num_samples);
+	LSL_TRACE_END("push_chunk", info_->uid(), samples[num_samples - 1]->seq);
+}
+
+template <class T>
+void stream_outlet_impl::enqueue_chunk(const T *data, std::size_t num_samples,
+	const double *timestamps, double timestamp, bool pushthrough) {
+	if (try_stage(data, num_samples, timestamps, timestamp, pushthrough)) return;
+	const std::size_t num_chans = info_->channel_count();
+	const auto assign = sample_factory_->kernels<T>().assign;
+	enqueue_samples(num_samples, timestamps, timestamp, pushthrough,
+		[&](sample &s, std::size_t k) { s.assign_typed(&data[k * num_chans], assign); });
+}
+
+template <class T>
+void stream_outlet_impl::push_chunk_planar(const T *const *channels, std::size_t num_samples,
+	const double *timestamps, double timestamp, bool pushthrough) {
+	if (!num_samples) return;
+	const std::size_t num_chans = info_->channel_count();
+	if (!channels) throw std::invalid_argument("The channel pointers must not be NULL.");
+	for (std::size_t c = 0; c < num_chans; c++)
+		if (!channels[c]) throw std::invalid_argument("The channel pointers must not be NULL.");
+	flush_staged();
+	if (skip_push(num_samples)) return;
+	if (!timestamps) {
+		if (timestamp == 0.0) timestamp = lsl_clock();
+		if (info_->nominal_srate() != IRREGULAR_RATE)
+			timestamp = timestamp - (num_samples - 1) / info_->nominal_srate();
+	}
+	const auto assign = sample_factory_->kernels<T>().assign;
+	std::vector<T> block(std::min(num_samples, planar_block_samples) * num_chans);
+	// the samples are filled in order, so each block is gathered when its first sample is due
+	enqueue_samples(num_samples, timestamps, timestamp, pushthrough, [&](sample &s, std::size_t k) {
+		const std::size_t row = k % planar_block_samples;
+		if (row == 0) {
+			const std::size_t rows = std::min(planar_block_samples, num_samples - k);
+			for (std::size_t c = 0; c < num_chans; c++)
+				for (std::size_t r = 0; r < rows; r++)
+					block[r * num_chans + c] = channels[c][k + r];
+		}
+		s.assign_typed(&block[row * num_chans], assign);
+	});
+}
+
+template void stream_outlet_impl::push_chunk_planar<char>(
+	const char *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<int16_t>(
+	const int16_t *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<int32_t>(
+	const int32_t *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<int64_t>(
+	const int64_t *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<float>(
+	const float *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<double>(
+	const double *const *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_planar<std::string>(
+	const std::string *const *, std::size_t, const double *, double, bool);
+
+template <class T>
+void stream_outlet_impl::push_chunk_strided(const char *data, std::ptrdiff_t sample_stride,
+	std::ptrdiff_t channel_stride, std::size_t num_samples, const double *timestamps,
+	double timestamp, bool pushthrough) {
+	if (!num_samples) return;
+	if (!data) throw std::invalid_argument("The data pointer must not be NULL.");
+	flush_staged();
+	if (skip_push(num_samples)) return;
+	if (!timestamps) {
+		if (timestamp == 0.0) timestamp = lsl_clock();
+		if (info_->nominal_srate() != IRREGULAR_RATE)
+			timestamp = timestamp - (num_samples - 1) / info_->nominal_srate();
+	}
+	const auto assign = sample_factory_->kernels<T>().assign;
+	std::vector<T> scratch(info_->channel_count());
+	enqueue_samples(num_samples, timestamps, timestamp, pushthrough, [&](sample &s, std::size_t k) {
+		s.assign_strided(data + static_cast<std::ptrdiff_t>(k) * sample_stride, channel_stride,
+			scratch.data(), assign);
+	});
+}
+
+template void stream_outlet_impl::push_chunk_strided<char>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_strided<int16_t>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_strided<int32_t>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_strided<int64_t>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_strided<float>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::push_chunk_strided<double>(
+	const char *, std::ptrdiff_t, std::ptrdiff_t, std::size_t, const double *, double, bool);
+
+void stream_outlet_impl::push_chunk_raw(const char *data, std::size_t num_bytes,
+	const double *timestamps, double timestamp, bool pushthrough) {
+	const lsl_channel_format_t fmt = info_->channel_format();
+	if (fmt == cft_string)
+		throw std::invalid_argument("Raw chunks can only be pushed into numeric streams.");
+	const std::size_t sample_bytes = format_sizes[fmt] * info_->channel_count();
+	if (!sample_bytes || num_bytes % sample_bytes)
+		throw std::invalid_argument(
+			"The size of a raw chunk must be a multiple of the sample size.");
+	const std::size_t num_samples = num_bytes / sample_bytes;
+	if (!num_samples) return;
+	if (!data) throw std::invalid_argument("The data pointer must not be NULL.");
+	flush_staged();
+	if (skip_push(num_samples)) return;
+	if (!timestamps) {
+		if (timestamp == 0.0) timestamp = lsl_clock();
+		if (info_->nominal_srate() != IRREGULAR_RATE)
+			timestamp = timestamp - (num_samples - 1) / info_->nominal_srate();
+	}
+	if (lslboost::endian::order::native == lslboost::endian::order::little ||
+		format_sizes[fmt] == 1)
+		enqueue_samples(num_samples, timestamps, timestamp, pushthrough,
+			[&](sample &s, std::size_t k) { s.assign_untyped(data + k * sample_bytes); });
+	else {
+		// the wire layout is little endian
+		std::vector<char> scratch(sample_bytes);
+		enqueue_samples(
+			num_samples, timestamps, timestamp, pushthrough, [&](sample &s, std::size_t k) {
+				memcpy(scratch.data(), data + k * sample_bytes, sample_bytes);
+				endian_reverse_inplace_n(scratch.data(), format_sizes[fmt], info_->channel_count());
+				s.assign_untyped(scratch.data());
+			});
+	}
+}
+
+template <class T>
+void stream_outlet_impl::push_sample_sparse(const uint32_t *indices, const T *values,
+	std::size_t count, double timestamp, bool pushthrough) {
+	if (count && (!indices || !values))
+		throw std::invalid_argument("The index and value pointers must not be NULL.");
+	flush_staged();
+	if (skip_push(1)) return;
+	LSL_TRACE_BEGIN("push_sample", info_->uid(), 0);
+	if (force_default_timestamps_) timestamp = 0.0;
+	sample_p smp(
+		sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
+	smp->assign_sparse(indices, values, count, sample_factory_->kernels<T>().assign);
+	send_buffer_->push_sample(smp);
+	LSL_TRACE_END("push_sample", info_->uid(), smp->seq);
+}
+
+template void stream_outlet_impl::push_sample_sparse<char>(
+	const uint32_t *, const char *, std::size_t, double, bool);
+template void stream_outlet_impl::push_sample_sparse<int16_t>(
+	const uint32_t *, const int16_t *, std::size_t, double, bool);
+template void stream_outlet_impl::push_sample_sparse<int32_t>(
+	const uint32_t *, const int32_t *, std::size_t, double, bool);
+template void stream_outlet_impl::push_sample_sparse<int64_t>(
+	const uint32_t *, const int64_t *, std::size_t, double, bool);
+template void stream_outlet_impl::push_sample_sparse<float>(
+	const uint32_t *, const float *, std::size_t, double, bool);
+template void stream_outlet_impl::push_sample_sparse<double>(
+	const uint32_t *, const double *, std::size_t, double, bool);
+
+void stream_outlet_impl::push_buffers(const char *const *data, const uint32_t *lengths,
+	std::size_t num_values, const double *timestamps, double timestamp, bool pushthrough) {
+	const std::size_t num_chans = info_->channel_count(), num_samples = num_values / num_chans;
+	if (num_values % num_chans != 0)
+		throw std::invalid_argument("The number of buffer elements to send is not a multiple of "
+									"the stream's channel count.");
+	if (!num_samples) return;
+	if (!data) throw std::invalid_argument("The data buffer pointer must not be NULL.");
+	if (skip_push(num_samples)) return;
+	if (!timestamps) {
+		if (timestamp == 0.0) timestamp = lsl_clock();
+		if (info_->nominal_srate() != IRREGULAR_RATE)
+			timestamp = timestamp - (num_samples - 1) / info_->nominal_srate();
+	}
+	if (info_->channel_format() != cft_string) {
+		// the values have to be parsed from strings anyway; the strings are kept per thread so
+		// their buffers are reused
+		static thread_local std::vector<std::string> tmp;
+		if (tmp.size() < num_values) tmp.resize(num_values);
+		for (std::size_t k = 0; k < num_values; k++)
+			tmp[k].assign(data[k], lengths ? lengths[k] : strlen(data[k]));
+		enqueue_chunk(tmp.data(), num_samples, timestamps, timestamp, pushthrough);
+		return;
+	}
+	enqueue_samples(num_samples, timestamps, timestamp, pushthrough, [&](sample &s, std::size_t k) {
+		s.assign_buffers(&data[k * num_chans], lengths ? &lengths[k * num_chans] : nullptr);
+	});
+}
+
+template void stream_outlet_impl::enqueue_chunk<char>(
+	const char *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<int16_t>(
+	const int16_t *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<int32_t>(
+	const int32_t *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<int64_t>(
+	const int64_t *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<float>(
+	const float *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<double>(
+	const double *, std::size_t, const double *, double, bool);
+template void stream_outlet_impl::enqueue_chunk<std::string>(
+	const std::string *, std::size_t, const double *, double, bool);
+
 } // namespace lsl
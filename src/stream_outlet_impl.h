@@ -2,9 +2,17 @@
 #define STREAM_OUTLET_IMPL_H
 
 #include "common.h"
+#include "cpu_account.h"
 #include "forward.h"
+#include "stream_config.h"
 #include "stream_info_impl.h"
+#include "thread_policy.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <loguru.hpp>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 using asio::ip::tcp;
@@ -13,7 +21,7 @@ using asio::ip::udp;
 namespace lsl {
 
 /// pointer to a thread
-using thread_p = std::shared_ptr<std::thread>;
+using thread_p = std::shared_ptr<managed_thread>;
 
 /**
  * A stream outlet.
@@ -22,7 +30,8 @@ using thread_p = std::shared_ptr<std::thread>;
 class stream_outlet_impl {
 public:
 	/**
-	 * Establish a new stream outlet. This makes the stream discoverable.
+	 * Establish a new stream outlet. This makes the stream discoverable (once the multicast
+	 * responders are set up, see wait_for_ready()).
 	 * @param info The stream information to use for creating this stream stays constant over the
 	 * lifetime of the outlet.
 	 * @param chunk_size The preferred chunk size, in samples, at which data shall be transmitted
@@ -31,9 +40,16 @@ public:
 	 * @param max_capacity The maximum number of samples buffered for unresponsive receivers. If
 	 * more samples get pushed, the oldest will be dropped. The default is sufficient to hold a bit
 	 * more than 15 minutes of data at 512Hz, while consuming not more than ca. 512MB of RAM.
+	 * @param keep_identity Publish the stream under the UID, session id and creation time of the
+	 * given info instead of new ones, e.g. to re-publish another outlet's stream (see relay).
+	 * @param config The settings of the stream, by default a snapshot of the configuration file's.
+	 *
+	 * If a host daemon is configured, the stream is published through it (see host_link) instead
+	 * of being served by the outlet, unless that fails or it's a string stream.
 	 */
-	stream_outlet_impl(
-		const stream_info_impl &info, int32_t chunk_size = 0, int32_t max_capacity = 512000);
+	stream_outlet_impl(const stream_info_impl &info, int32_t chunk_size = 0,
+		int32_t max_capacity = 512000, bool keep_identity = false,
+		stream_config_p config = nullptr);
 
 	/**
 	 * Destructor.
@@ -44,6 +60,15 @@ public:
 
 	stream_outlet_impl(const stream_outlet_impl &) = delete;
 
+	/**
+	 * Start tearing down the outlet without waiting for its threads: the stream is no longer
+	 * discoverable and the inlets stop receiving data.
+	 *
+	 * The destructor finishes the teardown, so many outlets can be torn down in parallel by
+	 * calling this for each before destroying them.
+	 */
+	void begin_shutdown();
+
 
 	//
 	// === Pushing a sample into the outlet. ===
@@ -96,6 +121,25 @@ public:
 		enqueue(&data[0], timestamp, pushthrough);
 	}
 
+	/**
+	 * Push a vector of strings as a sample, moving them into the sample instead of copying them.
+	 *
+	 * See sample::assign_moved(): the vector's strings are left in a valid but unspecified state
+	 * (typically the storage of a recycled sample), so a vector that's refilled for each sample
+	 * doesn't allocate either.
+	 */
+	void push_sample(
+		std::vector<std::string> &&data, double timestamp = 0.0, bool pushthrough = true) {
+		check_numchan((int32_t)data.size());
+		enqueue_moved(&data[0], timestamp, pushthrough);
+	}
+
+	/// Push the value of a single-channel stream (e.g. a marker), moving it into the sample.
+	void push_sample(std::string &&value, double timestamp = 0.0, bool pushthrough = true) {
+		check_numchan(1);
+		enqueue_moved(&value, timestamp, pushthrough);
+	}
+
 	/**
 	 * Push a pointer to some values as a sample into the outlet.
 	 *
@@ -162,6 +206,32 @@ public:
 	 */
 	void push_numeric_raw(const void *data, double timestamp = 0.0, bool pushthrough = true);
 
+	/**
+	 * Push samples that were allocated from sample_factory() as they are.
+	 *
+	 * Their time stamps and pushthrough flags are used unchanged; this is meant for sources that
+	 * fill samples directly, e.g. the playback of recordings (see replay). Samples that already
+	 * carry a sequence number (e.g. because they were pushed into another outlet) are copied, so
+	 * the sessions of the other outlet keep sending the sequence numbers they were given.
+	 */
+	void push_samples(const sample_p *samples, std::size_t n);
+
+	/**
+	 * Push a chunk of multiplexed samples whose values are given as character buffers.
+	 *
+	 * The values are copied into the samples of string-formatted streams without constructing
+	 * temporary strings (see sample::assign_buffers()), other formats parse them.
+	 * @param lengths The length of each buffer, or nullptr if they are zero-terminated.
+	 * @param num_values The number of buffers. Must be a multiple of the channel count.
+	 * @param timestamps One time stamp per sample, or nullptr to use `timestamp` (or the current
+	 * time if it's 0) for the most recent sample, as in push_chunk_multiplexed().
+	 */
+	void push_buffers(const char *const *data, const uint32_t *lengths, std::size_t num_values,
+		const double *timestamps, double timestamp, bool pushthrough);
+
+	/// The factory of the outlet's samples, see push_samples().
+	const factory_p &sample_factory() const { return sample_factory_; }
+
 	//
 	// === Pushing an chunk of samples into the outlet ===
 	//
@@ -194,9 +264,8 @@ public:
 		if (!data_buffer) throw std::runtime_error("The data buffer pointer must not be NULL.");
 		if (!timestamp_buffer)
 			throw std::runtime_error("The timestamp buffer pointer must not be NULL.");
-		for (std::size_t k = 0; k < num_samples; k++)
-			enqueue(&data_buffer[k * num_chans], timestamp_buffer[k],
-				pushthrough && k == num_samples - 1);
+		if (num_samples > 0)
+			enqueue_chunk(data_buffer, num_samples, timestamp_buffer, 0.0, pushthrough);
 	}
 
 	template <class T>
@@ -248,10 +317,7 @@ public:
 			if (timestamp == 0.0) timestamp = lsl_clock();
 			if (info().nominal_srate() != IRREGULAR_RATE)
 				timestamp = timestamp - (num_samples - 1) / info().nominal_srate();
-			push_sample(buffer, timestamp, pushthrough && (num_samples == 1));
-			for (std::size_t k = 1; k < num_samples; k++)
-				push_sample(&buffer[k * num_chans], DEDUCED_TIMESTAMP,
-					pushthrough && (k == num_samples - 1));
+			enqueue_chunk(buffer, num_samples, nullptr, timestamp, pushthrough);
 		}
 	}
 
@@ -273,6 +339,59 @@ public:
 		}
 	}
 
+	/**
+	 * Push a chunk of samples from one array per channel (channel-major order).
+	 *
+	 * The samples are built in blocks: the values of a few samples are gathered from the channel
+	 * arrays into a small multiplexed block, which is then assigned sample by sample.
+	 * @param channels channel_count pointers to arrays of num_samples values.
+	 * @param timestamps One time stamp per sample, or nullptr to use `timestamp` (or the current
+	 * time if it's 0) for the most recent sample, as in push_chunk_multiplexed().
+	 */
+	template <class T>
+	void push_chunk_planar(const T *const *channels, std::size_t num_samples,
+		const double *timestamps, double timestamp, bool pushthrough);
+
+	/**
+	 * Push a chunk of samples from a strided array of a numeric type, e.g. a numpy or MATLAB
+	 * array in any memory layout.
+	 *
+	 * The value of channel c of sample k is read from `data + k * sample_stride + c *
+	 * channel_stride` (strides in bytes, possibly negative; the values don't need to be
+	 * aligned) and converted by the stream's conversion kernels. Otherwise the same as
+	 * push_chunk_planar().
+	 */
+	template <class T>
+	void push_chunk_strided(const char *data, std::ptrdiff_t sample_stride,
+		std::ptrdiff_t channel_stride, std::size_t num_samples, const double *timestamps,
+		double timestamp, bool pushthrough);
+
+	/**
+	 * Push a chunk of samples of a numeric stream from a block that's laid out as on the wire:
+	 * the samples back to back, each with its channel values in the stream's format (little
+	 * endian).
+	 *
+	 * Only the size of the block is validated; the values are copied into the samples as they are
+	 * (with one copy per sample), so they aren't converted or checked. Otherwise the same as
+	 * push_chunk_planar().
+	 * @throws std::invalid_argument for a string stream or if the size isn't a multiple of the
+	 * sample size.
+	 */
+	void push_chunk_raw(const char *data, std::size_t num_bytes, const double *timestamps,
+		double timestamp, bool pushthrough);
+
+	/**
+	 * Push a sparse sample of a numeric stream, e.g. an event of a stream with many channels:
+	 * the channels at the given indices get the values, all others are zero.
+	 *
+	 * With the changed-channels value encoding (see frame_flags), such samples only take the
+	 * indices and values on the wire.
+	 * @throws std::range_error if an index isn't a channel of the stream.
+	 */
+	template <class T>
+	void push_sample_sparse(const uint32_t *indices, const T *values, std::size_t count,
+		double timestamp = 0.0, bool pushthrough = true);
+
 	// === Misc Features ===
 
 	/**
@@ -288,13 +407,147 @@ public:
 	/// Wait until some consumer shows up.
 	bool wait_for_consumers(double timeout = FOREVER);
 
+	/// Call a function with the number of consumers whenever it changes, see
+	/// send_buffer::set_consumers_callback().
+	void set_consumers_callback(std::function<void(std::size_t)> callback);
+
+	/**
+	 * Wait until the stream is discoverable, i.e., its multicast responders are set up.
+	 * @return False if the timeout expired before.
+	 */
+	bool wait_for_ready(double timeout = FOREVER);
+
+	/// The number of samples dropped for consumers that didn't keep up.
+	uint64_t dropped_samples();
+
+	/// The number of chunks sent with MSG_ZEROCOPY that the kernel hasn't released yet.
+	uint64_t zerocopy_chunks();
+
+	/// Get the transfer statistics, see lsl_get_outlet_stats().
+	void get_stats(lsl_outlet_stats &stats);
+
+	/**
+	 * Keep the recently pushed samples so inlets can request them when they connect.
+	 * @param seconds How long samples are kept, 0 for no limit.
+	 * @param max_samples The maximum number of samples that are kept, 0 for no limit.
+	 * If both are 0, the history is disabled.
+	 */
+	void set_history(double seconds, int32_t max_samples);
+
+	/**
+	 * Set the socket options of the connections to inlets that connect from now on.
+	 *
+	 * Negative values keep the current setting, see lsl_set_outlet_socket_options().
+	 */
+	void set_socket_options(int32_t send_buffer_bytes, int32_t receive_buffer_bytes,
+		int32_t no_delay, int32_t busy_poll_us);
+
+	/**
+	 * Multicast the samples to the inlets that connect from now on and ask for it, see
+	 * lsl_set_outlet_multicast().
+	 * @throws std::invalid_argument if the stream's samples can't be multicast.
+	 */
+	void set_multicast(bool enabled);
+
+	/**
+	 * Change the preferred chunk size of the constructor, for the connected inlets from their
+	 * next sample on, too (see lsl_set_outlet_chunk_size()).
+	 */
+	void set_chunk_size(int32_t chunk_size);
+
+	/// The settings the outlet was created with.
+	const stream_config &config() const { return *config_; }
+
+	/**
+	 * Serve the inlets that connect from now on with other settings; the running sessions keep
+	 * theirs, and the time stamp settings stay those of construction.
+	 */
+	void set_config(stream_config_p config);
+
+	/**
+	 * Replace the extended description of the stream with the one of another stream info.
+	 *
+	 * The servers serialize the info again for the next requests, so inlets that revalidate their
+	 * info receive the new description. The connected inlets that accept metadata updates get a
+	 * patch with the changed children of the description right away (see
+	 * stream_info_impl::desc_patch()).
+	 * @return The number of inlets the patch was sent to.
+	 */
+	std::size_t update_desc(const stream_info_impl &info);
+
+	/**
+	 * Hand the pushed samples to a worker thread through a staging ring instead of converting and
+	 * distributing them in the push call, e.g. for a driver's callback thread that has to return
+	 * right away (see lsl_set_outlet_async_push()).
+	 *
+	 * The samples of push_sample(), push_chunk_multiplexed() and push_numeric_raw() are copied
+	 * into the ring as they are (with the current time if they have no time stamp); samples that
+	 * don't fit are dropped. The other pushes wait until the staged samples are pushed. Must not
+	 * be called while samples are pushed.
+	 * @param buffer_bytes The size of the ring, 0 to push synchronously again (once the staged
+	 * samples are pushed).
+	 * @throws std::invalid_argument for string streams.
+	 */
+	void set_async_push(std::size_t buffer_bytes);
+
 private:
 	/// Instantiate a new server stack.
 	void instantiate_stack(tcp tcp_protocol, udp udp_protocol);
 
+	/// Create the multicast responders of a stack and start serving them.
+	void setup_responders(udp protocol, asio::io_context &io);
+
+	/// Whether a push of n samples can return right away because nobody would get them (they're
+	/// counted as pushed nonetheless).
+	bool skip_push(std::size_t n);
+
+	/**
+	 * Copy a push into the staging ring if pushes are asynchronous (see set_async_push()).
+	 *
+	 * Pushes that can't be staged (string values) wait until the staged ones are pushed instead.
+	 * @param timestamps One time stamp per sample, or nullptr to use `timestamp` (or the current
+	 * time if it's 0) for the first sample, as in enqueue_chunk().
+	 * @return Whether the push was staged (or dropped because the ring is full).
+	 */
+	template <class T>
+	bool try_stage(const T *data, std::size_t num_samples, const double *timestamps,
+		double timestamp, bool pushthrough);
+	bool try_stage(const std::string *, std::size_t, const double *, double, bool) {
+		flush_staged();
+		return false;
+	}
+	bool try_stage(const void *data, lsl_channel_format_t format, std::size_t value_bytes,
+		std::size_t num_samples, const double *timestamps, double timestamp, bool pushthrough);
+
+	/// Push a record of the staging ring (from its worker).
+	void push_staged(const char *record);
+
+	/// Wait until the staged samples are pushed, before a push that isn't staged.
+	void flush_staged();
+
 	/// Allocate and enqueue a new sample into the send buffer.
 	template <class T> void enqueue(const T *data, double timestamp, bool pushthrough);
 
+	/// Allocate and enqueue a new sample, moving the string values into it.
+	void enqueue_moved(std::string *data, double timestamp, bool pushthrough);
+
+	/**
+	 * Allocate a chunk of samples and enqueue them into the send buffer in one go.
+	 * @param data The multiplexed data for num_samples samples.
+	 * @param timestamps One time stamp per sample, or nullptr to use `timestamp` for the first
+	 * sample and deduce the time stamps of all following samples.
+	 * @param pushthrough Whether the last sample of the chunk should be pushed through.
+	 */
+	template <class T>
+	void enqueue_chunk(const T *data, std::size_t num_samples, const double *timestamps,
+		double timestamp, bool pushthrough);
+
+	/// Allocate a chunk of samples like enqueue_chunk(), assigning the values with fill(sample, k).
+	/// The time stamps of staged pushes (see try_stage()) are final already.
+	template <class F>
+	void enqueue_samples(std::size_t num_samples, const double *timestamps, double timestamp,
+		bool pushthrough, F &&fill, bool staged = false);
+
 	/**
 	 * Check whether some given number of channels matches the stream's channel_count.
 	 * Throws an error if not.
@@ -305,14 +558,28 @@ private:
 								   "stream's number of channels.");
 	}
 
+	/// the stream's settings
+	stream_config_p config_;
 	/// a factory for samples of appropriate type
 	factory_p sample_factory_;
 	/// the preferred chunk size
 	int32_t chunk_size_;
+	/// whether the pushed time stamps are replaced by the current time (from the config)
+	bool force_default_timestamps_;
 	/// stream_info shared between the various server instances
 	stream_info_impl_p info_;
+	/// serializes the description updates, so each patch applies to the previous version
+	std::mutex desc_mut_;
 	/// the single-producer, multiple-receiver send buffer
 	send_buffer_p send_buffer_;
+	/// the ring of the asynchronous pushes, if enabled (see set_async_push())
+	std::unique_ptr<class staging_ring> staging_;
+	/// the number of samples dropped because the staging ring was full
+	std::atomic<uint64_t> staging_dropped_{0};
+	/// the connection to the host daemon, if it publishes the stream (destroyed before the buffer)
+	std::unique_ptr<class host_link> host_link_;
+	/// the process-wide IO thread pool, if the outlet doesn't run its own IO threads
+	std::shared_ptr<class io_context_pool> io_pool_;
 	/// the IO service objects (two per stack: one for UDP and one for TCP)
 	std::vector<io_context_p> ios_;
 
@@ -323,8 +590,26 @@ private:
 	/// UDP multicast responders for service discovery (time features disabled);
 	/// also using only the allowed IP stacks
 	std::vector<udp_server_p> responders_;
-	/// threads that handle the I/O operations (two per stack: one for UDP and one for TCP)
+	/// protects responders_ and pending_setups_
+	std::mutex responders_mut_;
+	/// signaled when a stack's responders are set up
+	std::condition_variable responders_ready_;
+	/// the number of stacks whose responders are still being set up in the background
+	int pending_setups_{0};
+	/// threads that handle the I/O operations (two per stack: one for UDP and one for TCP), unless
+	/// the shared IO thread pool is used
 	std::vector<thread_p> io_threads_;
+	/// the number of running IO threads, shared with them (they might be detached)
+	struct io_thread_count {
+		std::mutex mut;
+		std::condition_variable exited;
+		std::size_t running{0};
+	};
+	std::shared_ptr<io_thread_count> io_thread_count_;
+	/// the CPU time of the outlet's own IO threads
+	cpu_account_p io_cpu_{std::make_shared<cpu_account>()};
+	/// whether begin_shutdown() was called
+	bool shutting_down_{false};
 };
 
 } // namespace lsl
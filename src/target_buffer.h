@@ -0,0 +1,110 @@
+#ifndef TARGET_BUFFER_H
+#define TARGET_BUFFER_H
+
+#include "sample.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A ring buffer of the application (e.g. pinned memory for GPU transfers) that an inlet writes
+ * the received samples into, in channel-major (planar) order.
+ *
+ * The k-th sample since the registration goes into slot `k % capacity`: the value of channel c
+ * to `data[c * capacity + slot]`, the time stamp to `timestamps[slot]`. The data thread writes
+ * the samples and reports each contiguous range of slots it filled; the application gives the
+ * slots back with release() once it has consumed them. Samples that arrive while the ring is
+ * full are dropped.
+ */
+class target_buffer {
+public:
+	/// Called with the index of the first written sample (counted since the registration) and
+	/// the number of samples, which are contiguous in the ring; 0 samples signal a lost stream.
+	using callback = std::function<void(uint64_t first, uint32_t count)>;
+
+	/// @param retrieve The kernel that converts the channel data to T.
+	template <class T>
+	target_buffer(T *data, double *timestamps, uint32_t capacity, uint32_t channels,
+		typename typed_kernels<T>::retrieve_fn retrieve, callback on_written)
+		: timestamps_(timestamps), capacity_(capacity), on_written_(std::move(on_written)) {
+		if (!data || !capacity) throw std::invalid_argument("The target buffer must not be empty.");
+		// the samples are retrieved into a block that's transposed into the ring once it's full
+		store_ = [data, capacity, channels, retrieve,
+					 block = std::vector<T>(block_samples * channels)](
+					 const sample_p *samples, std::size_t n, uint32_t slot) mutable {
+			for (std::size_t done = 0; done < n;) {
+				const std::size_t rows = std::min(n - done, block_samples);
+				for (std::size_t r = 0; r < rows; ++r)
+					samples[done + r]->retrieve_typed(block.data() + r * channels, retrieve);
+				for (uint32_t c = 0; c < channels; ++c) {
+					T *dst = data + static_cast<std::size_t>(c) * capacity + slot + done;
+					for (std::size_t r = 0; r < rows; ++r) dst[r] = block[r * channels + c];
+				}
+				done += rows;
+			}
+		};
+	}
+
+	/// Write the received samples and their post-processed time stamps (from the data thread).
+	void write(const sample_p *samples, const double *timestamps, std::size_t n) {
+		if (!n) {
+			on_written_(written_, 0);
+			return;
+		}
+		const uint64_t free =
+			capacity_ - (written_ - released_.load(std::memory_order_acquire));
+		if (n > free) {
+			dropped_.fetch_add(n - free, std::memory_order_relaxed);
+			n = static_cast<std::size_t>(free);
+		}
+		while (n) {
+			// a range that wraps around is written (and reported) in two parts
+			const auto slot = static_cast<uint32_t>(written_ % capacity_);
+			const auto count = static_cast<uint32_t>(std::min<std::size_t>(n, capacity_ - slot));
+			store_(samples, count, slot);
+			if (timestamps_) std::copy(timestamps, timestamps + count, timestamps_ + slot);
+			const uint64_t first = written_;
+			written_ += count;
+			on_written_(first, count);
+			samples += count;
+			timestamps += count;
+			n -= count;
+		}
+	}
+
+	/**
+	 * Give the oldest written slots back, so new samples can be written into them.
+	 * @throws std::invalid_argument if more samples are released than were written.
+	 */
+	void release(uint32_t count) {
+		// only the data thread writes written_, so the check can't become stale in between
+		if (released_.load(std::memory_order_relaxed) + count > written_.load())
+			throw std::invalid_argument("More samples were released than have been written.");
+		released_.fetch_add(count, std::memory_order_release);
+	}
+
+	/// The number of samples that were dropped because the ring was full.
+	uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+	/// the number of samples that are converted and transposed at once
+	static constexpr std::size_t block_samples = 16;
+
+	/// write n samples to the slots starting at slot (without wrapping around)
+	std::function<void(const sample_p *, std::size_t, uint32_t)> store_;
+	double *timestamps_;
+	const uint32_t capacity_;
+	callback on_written_;
+	/// the number of samples written and released so far
+	std::atomic<uint64_t> written_{0}, released_{0};
+	std::atomic<uint64_t> dropped_{0};
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,197 @@
+#include "task_pool.h"
+#include "api_config.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <loguru.hpp>
+#include <mutex>
+#include <thread>
+
+using namespace lsl;
+
+/// the number of tasks a thread runs of a strand before it's the next strand's turn
+static const std::size_t tasks_per_turn = 16;
+
+/// the pool and the index of the thread that's running, if it's one of a pool's threads
+static thread_local const void *current_pool = nullptr;
+static thread_local std::size_t current_index = 0;
+
+class task_pool::strand {
+public:
+	std::mutex mut;
+	/// notified when a task has started or finished
+	std::condition_variable cv;
+	std::deque<std::function<void()>> tasks;
+	/// whether the strand is in a deque or running
+	bool scheduled{false};
+	/// the thread that's running the strand's tasks, if any
+	std::thread::id runner;
+	/// the number of posted and of finished (or dropped) tasks
+	uint64_t posted{0}, finished{0};
+};
+
+struct task_pool::core {
+	struct worker {
+		std::mutex mut;
+		/// the strands with tasks, the thread takes them from the front and thieves from the end
+		std::deque<strand_p> strands;
+	};
+
+	explicit core(std::size_t size) {
+		for (std::size_t k = 0; k < size; ++k) workers.emplace_back(new worker());
+	}
+
+	/// The body of a thread; it holds the core until it exits.
+	static void run(const std::shared_ptr<core> &self, std::size_t index);
+
+	/// Queue a strand that has tasks at the deque of a thread.
+	void schedule(strand_p s, std::size_t index);
+
+	/// Take a strand from a thread's own deque or steal one, nullptr once the pool stops.
+	strand_p take(std::size_t index);
+
+	std::vector<std::unique_ptr<worker>> workers;
+	/// protects queued and stop
+	std::mutex idle_mut;
+	/// notified when a strand is queued or the pool stops
+	std::condition_variable idle_cv;
+	/// the number of strands in all deques that no thread has claimed yet
+	std::size_t queued{0};
+	bool stop{false};
+	/// the deque of the thread to queue strands at that are posted to from outside the pool
+	std::atomic<std::size_t> next{0};
+};
+
+task_pool::task_pool(std::size_t size, const std::string &name)
+	: core_(std::make_shared<core>(std::max<std::size_t>(size, 1))) {
+	for (std::size_t k = 0; k < core_->workers.size(); ++k)
+		threads_.emplace_back(lsl_thread_data, name + std::to_string(k), &core::run, core_, k);
+	LOG_F(INFO, "Started %lu shared decode threads", static_cast<unsigned long>(threads_.size()));
+}
+
+task_pool::~task_pool() {
+	{
+		std::lock_guard<std::mutex> lock(core_->idle_mut);
+		core_->stop = true;
+	}
+	core_->idle_cv.notify_all();
+	for (auto &thread : threads_) {
+		// the last user may have been destroyed from within one of the pool's threads, which
+		// exits with its reference to the core once the task returned
+		if (thread.get_id() == std::this_thread::get_id())
+			thread.detach();
+		else
+			thread.join();
+	}
+}
+
+std::shared_ptr<task_pool> task_pool::inlet_pool() {
+	const int num_threads = api_config::get_instance()->inlet_decode_threads();
+	if (num_threads <= 0) return nullptr;
+
+	static std::mutex pool_mut;
+	static std::weak_ptr<task_pool> pool;
+	std::lock_guard<std::mutex> lock(pool_mut);
+	auto result = pool.lock();
+	if (!result) {
+		result = std::make_shared<task_pool>(static_cast<std::size_t>(num_threads), "DEC_");
+		pool = result;
+	}
+	return result;
+}
+
+task_pool::strand_p task_pool::make_strand() { return std::make_shared<strand>(); }
+
+void task_pool::post(const strand_p &s, std::function<void()> task) {
+	std::unique_lock<std::mutex> lock(s->mut);
+	if (s->runner != std::this_thread::get_id())
+		s->cv.wait(lock, [&s]() { return s->tasks.size() < max_pending; });
+	s->tasks.push_back(std::move(task));
+	++s->posted;
+	if (s->scheduled) return;
+	s->scheduled = true;
+	lock.unlock();
+	core_->schedule(s, current_pool == core_.get() ? current_index
+												   : core_->next++ % core_->workers.size());
+}
+
+void task_pool::cancel(const strand_p &s) {
+	std::unique_lock<std::mutex> lock(s->mut);
+	s->finished += s->tasks.size();
+	s->tasks.clear();
+	s->cv.notify_all();
+	if (s->runner == std::this_thread::get_id()) return;
+	s->cv.wait(lock, [&s]() { return s->runner == std::thread::id(); });
+}
+
+void task_pool::wait(const strand_p &s) {
+	std::unique_lock<std::mutex> lock(s->mut);
+	if (s->runner == std::this_thread::get_id()) return;
+	const uint64_t target = s->posted;
+	s->cv.wait(lock, [&s, target]() { return s->finished >= target; });
+}
+
+void task_pool::core::schedule(strand_p s, std::size_t index) {
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->mut);
+		workers[index]->strands.push_back(std::move(s));
+	}
+	{
+		std::lock_guard<std::mutex> lock(idle_mut);
+		++queued;
+	}
+	idle_cv.notify_one();
+}
+
+task_pool::strand_p task_pool::core::take(std::size_t index) {
+	{
+		std::unique_lock<std::mutex> lock(idle_mut);
+		idle_cv.wait(lock, [this]() { return stop || queued > 0; });
+		if (stop) return nullptr;
+		// claim one of the queued strands, so it's in one of the deques until it's taken
+		--queued;
+	}
+	for (std::size_t k = 0;; ++k) {
+		auto &w = *workers[(index + k) % workers.size()];
+		std::lock_guard<std::mutex> lock(w.mut);
+		if (w.strands.empty()) continue;
+		strand_p s;
+		if (k % workers.size() == 0) {
+			s = std::move(w.strands.front());
+			w.strands.pop_front();
+		} else {
+			s = std::move(w.strands.back());
+			w.strands.pop_back();
+		}
+		return s;
+	}
+}
+
+void task_pool::core::run(const std::shared_ptr<core> &self, std::size_t index) {
+	current_pool = self.get();
+	current_index = index;
+	while (strand_p s = self->take(index)) {
+		std::unique_lock<std::mutex> lock(s->mut);
+		s->runner = std::this_thread::get_id();
+		for (std::size_t n = 0; n < tasks_per_turn && !s->tasks.empty(); ++n) {
+			auto task = std::move(s->tasks.front());
+			s->tasks.pop_front();
+			s->cv.notify_all();
+			lock.unlock();
+			try {
+				task();
+			} catch (std::exception &e) {
+				LOG_F(ERROR, "Unexpected error in a pooled task: %s", e.what());
+			}
+			lock.lock();
+			++s->finished;
+		}
+		s->runner = std::thread::id();
+		s->scheduled = !s->tasks.empty();
+		s->cv.notify_all();
+		const bool again = s->scheduled;
+		lock.unlock();
+		// the other strands of this thread get their turn first
+		if (again) self->schedule(std::move(s), index);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include "thread_policy.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A fixed number of threads that run the tasks of many strands, so the work of many streams is
+ * spread across cores while the tasks of each stream run one at a time and in order.
+ *
+ * Each thread has a deque of the strands that have tasks to run. A thread runs a few tasks of the
+ * strand at the front of its deque and puts it back at the end if it has more. Once its deque is
+ * empty, it steals a strand from the end of another thread's deque, so a few busy streams don't
+ * leave the other threads idle. A strand is in at most one deque (or running) at a time.
+ */
+class task_pool {
+public:
+	/// A sequence of tasks that run one after another, in the order they were posted.
+	class strand;
+	using strand_p = std::shared_ptr<strand>;
+
+	/**
+	 * Start a pool of threads.
+	 * @param size The number of threads.
+	 * @param name The name of the threads (for logging purposes).
+	 */
+	task_pool(std::size_t size, const std::string &name);
+
+	/// Stop and join the threads, the tasks that haven't started are dropped.
+	~task_pool();
+
+	task_pool(const task_pool &) = delete;
+	task_pool &operator=(const task_pool &) = delete;
+
+	/**
+	 * Get the pool shared by all inlets in the process to decode and deliver the samples of
+	 * bundled connections.
+	 *
+	 * The pool is created on first use with the number of threads configured in
+	 * api_config::inlet_decode_threads(). Returns an empty pointer if the connections' threads
+	 * should do that themselves.
+	 */
+	static std::shared_ptr<task_pool> inlet_pool();
+
+	/// Create a strand to post tasks to.
+	strand_p make_strand();
+
+	/**
+	 * Post a task to a strand.
+	 *
+	 * Waits while max_pending tasks of the strand haven't started yet, so a producer that's faster
+	 * than the pool is slowed down instead of queueing ever more data (unless called from a task
+	 * of the strand). Exceptions thrown by the task are logged.
+	 */
+	void post(const strand_p &s, std::function<void()> task);
+
+	/**
+	 * Drop the tasks of a strand that haven't started yet and wait for the running one to finish
+	 * (unless called from it).
+	 */
+	void cancel(const strand_p &s);
+
+	/// Wait until the tasks posted to a strand before have finished (unless called from one).
+	void wait(const strand_p &s);
+
+	/// The number of threads in the pool.
+	std::size_t size() const { return threads_.size(); }
+
+	/// the number of tasks of a strand that may wait to be run before post() blocks
+	static const std::size_t max_pending = 256;
+
+private:
+	/**
+	 * The deques of the threads and what they wait for. Each thread keeps it alive until its loop
+	 * exits, so a thread that destroyed the pool (e.g. a task released its last user) finishes
+	 * its turn without the pool.
+	 */
+	struct core;
+
+	std::shared_ptr<core> core_;
+	std::vector<managed_thread> threads_;
+};
+
+} // namespace lsl
+
+#endif
@@ -1,22 +1,54 @@
 #include "tcp_server.h"
+#include "alloc_guard.h"
 #include "api_config.h"
+#include "async_log.h"
+#include "bundle.h"
 #include "consumer_queue.h"
+#include "datagram_sender.h"
+#include "io_context_pool.h"
+#include "rdma_transport.h"
+#include "resampler.h"
 #include "sample.h"
+#include "sample_frame.h"
 #include "send_buffer.h"
+#include "shm_transport.h"
 #include "socket_utils.h"
 #include "stream_info_impl.h"
+#include "thread_policy.h"
+#include "timestamp_deduction.h"
+#include "token_bucket.h"
+#include "tracing.h"
 #include "util/cast.hpp"
+#include "value_filter.h"
+#include <algorithm>
+#include <chrono>
+#include <boost/asio/buffers_iterator.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/streambuf.hpp>
 #include <boost/asio/write.hpp>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
 #include <loguru.hpp>
 #include <memory>
+#include <sstream>
 #include <thread>
 #include <utility>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define LSL_KERNEL_ZEROCOPY
+#endif
+#endif
+
 #ifdef _MSC_VER
 // (inefficiently converting int to bool in portable_oarchive instantiation...)
 #pragma warning(disable : 4800)
@@ -25,10 +57,36 @@
 // a convention that applies when including portable_oarchive.h in multiple .cpp files.
 // otherwise, the templates are instantiated in this file and sample.cpp which leads
 // to errors like "multiple definition of `typeinfo name"
+#ifndef LSL_NO_PROTOCOL_100
 #define NO_EXPLICIT_TEMPLATE_INSTANTIATION
 #include "portable_archive/portable_oarchive.hpp"
+#endif
 
 namespace lsl {
+/// samples with smaller payloads are copied into the feed buffer, since sending them from the
+/// sample memory would need more system calls than the memcpy() saves
+const std::size_t min_zerocopy_bytes = 1024;
+
+/// the largest chunk (in samples) of the adaptive chunking
+const uint32_t max_adaptive_chunk_samples = 4096;
+
+/// the limits for the preallocated feed buffers (see api_config::lock_memory())
+const std::size_t min_feed_reserve_bytes = 64 << 10, max_feed_reserve_bytes = 64 << 20;
+
+/// the buffers of the data feeds: with api_config::lock_memory(), their memory stays locked when
+/// it moves as they grow
+using feed_buffer = asio::basic_streambuf<locked_allocator<char>>;
+
+/// how long (in seconds) end_serving() waits for the end-of-stream frames to be sent
+const double goodbye_timeout = 0.5;
+
+/// the rate limit shared by all connections of this host that leave it (see
+/// api_config::host_max_bytes_per_second())
+static token_bucket &host_shaper() {
+	static token_bucket shaper(api_config::get_instance()->host_max_bytes_per_second());
+	return shaper;
+}
+
 /**
  * Active session with a TCP client.
  *
@@ -60,7 +118,12 @@ public:
 	/// Instantiate a new session & its socket.
 	client_session(const tcp_server_p &serv)
 		: io_(serv->io_), serv_(serv), sock_(std::make_shared<tcp::socket>(*serv->io_)),
-		  requeststream_(&requestbuf_) {}
+		  chunk_timer_(*io_), heartbeat_timer_(*io_), requeststream_(&requestbuf_) {}
+
+	/// Instantiate a session for a connection that was accepted by a shared_acceptor.
+	client_session(const tcp_server_p &serv, io_context_p io, tcp_socket_p sock)
+		: io_(std::move(io)), serv_(serv), sock_(std::move(sock)), chunk_timer_(*io_),
+		  heartbeat_timer_(*io_), requeststream_(&requestbuf_) {}
 
 	/// Destructor. Unregisters the session from the server.
 	~client_session();
@@ -68,8 +131,26 @@ public:
 	/// Get the socket of this session.
 	tcp_socket_p socket() { return sock_; }
 
-	/// Begin processing this session (i.e., data transmission over the socket).
-	void begin_processing();
+	/**
+	 * Begin processing this session (i.e., data transmission over the socket).
+	 * @param received The start of the request if it has been read from the socket already.
+	 */
+	void begin_processing(const std::string &received = std::string());
+
+	/**
+	 * Send a control frame before the next chunk (or right away if no samples are pending).
+	 * @return The number of control frames queued so far, see wait_controls_sent().
+	 */
+	uint64_t queue_control(std::shared_ptr<const std::string> frame);
+
+	/// Wait until the first count control frames have been sent, at most timeout seconds.
+	bool wait_controls_sent(uint64_t count, double timeout);
+
+	/// Whether the client accepts control frames with metadata patches.
+	bool metadata_updates() const { return metadata_updates_; }
+
+	/// Whether the client wants a control frame once the stream ends.
+	bool end_of_stream() const { return end_of_stream_; }
 
 private:
 	/// Handler that gets called when the reading of the 1st line (command line) of the inbound
@@ -88,12 +169,182 @@ private:
 	/// Handler that gets called sending the feedheader has completed.
 	void handle_send_feedheader_outcome(err_t err, std::size_t n);
 
+	/// Read the next request of a client that receives the samples as datagrams.
+	void read_repair_request();
+
+	/// Whether the client is on this host (so it can read the samples from shared memory).
+	bool same_host() const;
+
+	/// Send the samples a datagram client asked for (`LSL:repair [first] [last]`) from the
+	/// history: their number (little endian uint64), followed by the samples that are still in the
+	/// history (each preceded by its sequence number).
+	void handle_repair_request(err_t err);
+
+	/// Read the next request of a client that may change its buffering parameters.
+	void read_reconfiguration();
+
+	/// Apply new buffering parameters of the client (`LSL:reconfigure [max_buflen]
+	/// [max_chunklen]`) to its queue and the chunking, from the next sample on.
+	void handle_reconfiguration(err_t err);
+
+	/// Read the next time probe of a client that synchronizes its clock over TCP.
+	void read_time_probe();
+
+	/// Answer a time probe (`[wave id] [t0]`) like the UDP server does, with t1 and t2 (the times
+	/// the probe was received and the reply sent) following the probe's fields on a line.
+	void handle_time_probe(err_t err);
+
 	/// Transfers samples from the server's send buffer into the async send queues of IO threads
 	void transfer_samples_thread(std::shared_ptr<client_session> sess);
 
 	/// Handler that gets called when a sample transfer has been completed.
 	void handle_chunk_transfer_outcome(err_t err, std::size_t len);
 
+	/// Serialize queued samples from an IO thread until a chunk is complete and send it off.
+	/// Used instead of transfer_samples_thread() if api_config::async_transfer() is set.
+	void transfer_samples_async();
+
+	/// Let the queue resume transfer_samples_async() in the IO thread once samples are pushed.
+	void set_push_notification();
+
+	/// Let the IO thread drive the transfers from now on (see api_config::park_idle_seconds()),
+	/// called by the transfer thread, which ends then.
+	void park_transfer();
+
+	/// Send the chunk in the send buffer from an IO thread (once the rate limits allow it) and
+	/// continue serializing once it has been sent.
+	void send_chunk_async();
+
+	/// The bytes of the chunk in the send buffer, without the frame's header and trailer.
+	std::size_t send_chunk_bytes() const {
+		std::size_t bytes = sendbuf_->size();
+		for (const auto &payload : sendpayloads_->samples) bytes += payload.second->datasize();
+		return bytes;
+	}
+
+	/// Take a chunk of the given size from the rate limits (the session's and the host's) and
+	/// return how long (in seconds) to wait before sending it.
+	double shaping_delay(std::size_t bytes);
+
+	/// Apply the channel subset, decimation, value filter, resampling and chunk size override to
+	/// the sample and serialize it (or the samples the resampler produced) into the fill buffer.
+	/// @return Whether the chunk serialized so far should be sent off.
+	bool serialize_sample(sample_p samp);
+
+	/// Serialize a sample as it is sent to the client into the fill buffer, see serialize_sample().
+	bool serialize_wire_sample(sample_p samp);
+
+	/// Whether a sample that isn't sent (decimated, filtered out, or consumed by the resampler)
+	/// should still complete the chunk that's been serialized so far.
+	bool skipped_sample_completes_chunk(const sample &samp) const {
+		if (chunk_max_latency_.count()) return chunk_due();
+		if (adaptive_chunking_) return false;
+		return samp.pushthrough && !chunk_granularity_.load(std::memory_order_relaxed) &&
+			   !serv_->chunk_size_.load(std::memory_order_relaxed) && chunk_bytes() > 0;
+	}
+
+	/// The size of the chunk serialized so far, including the payloads sent without copying.
+	std::size_t chunk_bytes() const {
+		const auto &payloads = fillpayloads_->samples;
+		return fillbuf_->size() +
+			   (payloads.empty() ? 0 : payloads.size() * payloads.front().second->datasize());
+	}
+
+	/// Whether the max-latency chunking policy (see api_config::chunk_max_latency_us()) requires
+	/// the chunk serialized so far to be sent now. Once the deadline has passed, the samples that
+	/// are already queued are still added (for up to another chunk_max_latency_).
+	bool chunk_due() const {
+		const std::size_t bytes = chunk_bytes();
+		if (!chunk_max_latency_.count() || !bytes) return false;
+		if (chunk_max_bytes_ && bytes >= chunk_max_bytes_) return true;
+		const auto now = std::chrono::steady_clock::now();
+		return now >= chunk_deadline_ &&
+			   (!queue_->read_available() || now >= chunk_deadline_ + chunk_max_latency_);
+	}
+
+	/// How long (in seconds) the transfer thread can wait for the next sample.
+	double chunk_wait_time() const;
+
+	/// Preallocate and lock the feed buffers for the largest chunk the session expects.
+	void reserve_feed_buffers();
+
+	/// Update the server's count of the feed buffers' memory (while no chunk is in flight).
+	void account_feed_buffers();
+
+	/**
+	 * Adaptive chunking (see api_config::adaptive_chunking()): called when the queue ran dry.
+	 * @return Whether there's a partial chunk that should be sent now. The link is idle then, so
+	 * the chunk size shrinks.
+	 */
+	bool flush_idle_chunk() {
+		if (!adaptive_chunking_ || !chunk_bytes()) return false;
+		adaptive_chunk_samples_ = std::max<uint32_t>(adaptive_chunk_samples_ / 2, 1);
+		return true;
+	}
+
+	/// Adaptive chunking: this many samples arrived while the previous chunk was being sent, so
+	/// the chunks grow to (at least) this size.
+	void grow_chunk(std::size_t samples) {
+		adaptive_chunk_samples_ = static_cast<uint32_t>(std::min<std::size_t>(
+			std::max<std::size_t>(adaptive_chunk_samples_, samples), max_adaptive_chunk_samples));
+	}
+
+	/// The number of channels of the samples sent to the client.
+	uint32_t wire_channels() const {
+		return channels_.empty() ? serv_->info_->channel_count()
+								 : static_cast<uint32_t>(channels_.size());
+	}
+
+	/// Send the contents of the send buffer (and its payloads, if any) with a single write.
+	template <typename Handler> void write_chunk(Handler &&handler);
+
+	/// Whether control frames wait to be sent (see queue_control()).
+	bool control_pending() const { return control_pending_.load(std::memory_order_acquire); }
+
+	/// Count the control frames of a chunk that has been sent.
+	void controls_sent(std::size_t n);
+
+	/// Queue a heartbeat frame after the heartbeat interval, and so on.
+	void schedule_heartbeat();
+
+#ifdef LSL_KERNEL_ZEROCOPY
+	/// A chunk sent with MSG_ZEROCOPY and the memory it references, which has to stay untouched
+	/// until the kernel reports that it's done with it.
+	struct zerocopy_chunk {
+		/// a copy of the sample headers, since the send buffer is refilled right away
+		std::vector<char> headers;
+		std::vector<sample_p> samples;
+		/// the remaining buffer sequence to be sent
+		std::vector<asio::const_buffer> gather;
+		/// the id of the chunk's first send call, the number of its calls and of their completions
+		uint32_t first_send{0}, sends{0}, completed{0};
+		/// whether the chunk is still being sent (so more calls may follow)
+		bool sending{true};
+	};
+
+	/// Send (the rest of) a chunk with MSG_ZEROCOPY; the handler is called once all of it has been
+	/// handed to the kernel.
+	template <typename Handler>
+	void write_zerocopy(std::shared_ptr<zerocopy_chunk> chunk, std::size_t sent, Handler &&handler);
+
+	/// Release the chunks whose sends the kernel has reported as completed (zerocopy_mut_ held).
+	void reap_zerocopy_completions();
+
+	/// Reap the completions after a delay, and again (with longer delays) until all chunks are
+	/// released, so an idle stream doesn't hold on to its last chunks.
+	void schedule_zerocopy_reap(double delay);
+
+	/// whether chunks are sent with MSG_ZEROCOPY (if they're larger than the threshold)
+	std::atomic<bool> kernel_zerocopy_{false};
+	/// the id of the next MSG_ZEROCOPY send call (the kernel counts them the same way)
+	uint32_t zerocopy_sends_{0};
+	/// the chunks the kernel may still read from, protected by zerocopy_mut_
+	std::deque<std::shared_ptr<zerocopy_chunk>> zerocopy_pending_;
+	std::mutex zerocopy_mut_;
+	/// the timer of schedule_zerocopy_reap() (created along with kernel_zerocopy_)
+	std::unique_ptr<asio::steady_timer> zerocopy_timer_;
+#endif
+
 	/// whether we have registered ourselves at the server as active (so we need to unregister
 	/// ourselves at destruction)
 	bool registered_{false};
@@ -108,15 +359,164 @@ private:
 	/// outstanding handler is present
 	work_p work_;
 
+	/// Wait until the chunk that's currently in flight (if any) has been sent.
+	/// @return false if the transfer failed
+	bool wait_for_transfer_completion();
+
 	// data used by the transfer thread (and some other handlers)
-	/// this buffer holds the data feed generated by us
-	asio::streambuf feedbuf_;
+	/// this buffer holds the data feed generated by us (locked in memory with
+	/// api_config::lock_memory(), also after it grew)
+	feed_buffer feedbuf_;
+	/// second feed buffer so one chunk can be serialized while the previous one is being sent
+	feed_buffer backbuf_;
+	/// the buffer the transfer thread currently serializes samples into
+	feed_buffer *fillbuf_{&feedbuf_};
+	/// the buffer that is currently (or was last) being sent
+	feed_buffer *sendbuf_{&feedbuf_};
+	/// sample payloads that are sent straight from the samples' memory (see zerocopy_)
+	struct payload_list {
+		/// the samples and the offsets into the feed buffer where their payloads belong
+		std::vector<std::pair<std::size_t, sample_p>> samples;
+		/// the buffer sequence for the gather write
+		std::vector<asio::const_buffer> gather;
+		/// the time stamps and sequence numbers of the chunk if it's sent as a frame (see framed_)
+		frame_builder frame;
+		/// the control frames sent before the chunk
+		std::vector<std::shared_ptr<const std::string>> controls;
+
+		/// Release the payloads once the chunk has been sent.
+		void clear() {
+			samples.clear();
+			frame.clear();
+			controls.clear();
+		}
+	};
+	/// payloads belonging to feedbuf_ and backbuf_, swapped along with fillbuf_ / sendbuf_
+	payload_list feedpayloads_, backpayloads_;
+	payload_list *fillpayloads_{&feedpayloads_}, *sendpayloads_{&feedpayloads_};
+	/// whether sample payloads are sent without copying them into the feed buffer
+	bool zerocopy_{false};
+	/// whether the channel values are delta encoded (see sample::save_streambuf_delta())
+	bool delta_encoding_{false};
+	/// whether each sample is preceded by its sequence number (little endian uint64)
+	bool sequence_numbers_{false};
+	/// whether the client wants the sequence numbers even if the stream can't be resumed
+	bool gap_detection_{false};
+	/// whether the chunks are sent as frames (see frame_flags)
+	bool framed_{false};
+	/// whether the frames only hold the changed channel values (see frame_changed_channels)
+	bool changed_channels_{false};
+	/// whether the client accepts control frames with metadata patches (see frame_control)
+	bool metadata_updates_{false};
+	/// whether the client wants a control frame once the stream ends (see control_end_of_stream)
+	bool end_of_stream_{false};
+	/// the interval of the heartbeat frames in seconds, 0 if none are sent (see control_heartbeat)
+	double heartbeat_interval_{0.0};
+	/// the control frames waiting for the next chunk, protected by control_mut_, and whether
+	/// there are any
+	std::vector<std::shared_ptr<const std::string>> controls_;
+	std::mutex control_mut_;
+	std::atomic<bool> control_pending_{false};
+	/// the number of control frames queued and sent so far, protected by control_mut_
+	uint64_t controls_queued_{0}, controls_sent_{0};
+	/// signals that control frames have been sent
+	std::condition_variable controls_sent_cond_;
+	/// whether the test patterns are omitted because the inlet validated the format agreement
+	bool skip_test_patterns_{false};
+	/// whether the frames' time stamps are sent as nanosecond deltas, and their encoding state
+	bool timestamp_deltas_{false};
+	timestamp_deltas delta_state_{IRREGULAR_RATE};
+	/// the max-latency chunking policy (0 if disabled) and its size limit (0 for none)
+	std::chrono::microseconds chunk_max_latency_{0};
+	std::size_t chunk_max_bytes_{0};
+	/// when the first sample of the chunk in the fill buffer has waited long enough
+	std::chrono::steady_clock::time_point chunk_deadline_;
+	/// wakes up transfer_samples_async() at the chunk deadline
+	asio::steady_timer chunk_timer_;
+	/// the timer of the heartbeat frames
+	asio::steady_timer heartbeat_timer_;
+	/// whether the chunk size adapts to the throughput of the connection, the current chunk size
+	/// (in samples) and the number of samples in the fill buffer
+	bool adaptive_chunking_{false};
+	uint32_t adaptive_chunk_samples_{1}, chunk_samples_{0};
+	/// the feed buffers' memory that's counted by the server
+	uint64_t accounted_feed_bytes_{0};
+	/// the feed buffers' memory after reserve_feed_buffers(), growing beyond it is reported
+	uint64_t reserved_feed_bytes_{0};
+	/// whether the client asked to receive the samples by multicast
+	bool multicast_requested_{false};
+	/// the UDP port the client wants to receive the samples on without repairs (0 for none)
+	uint16_t datagram_port_{0};
+	/// the sender if the client receives the samples as datagrams, and whether it's the client's
+	/// own (instead of the server's multicast sender)
+	datagram_sender_p datagrams_;
+	bool unicast_datagrams_{false};
+	/// the sequence number of the last sample pushed before the multicast subscription: the
+	/// client needs the samples after it (and requests those that don't arrive)
+	uint64_t multicast_start_{0};
+	/// the endpoint the client wants the samples to be RDMA-written to (empty for none), and the
+	/// sender if they are
+	std::string rdma_endpoint_;
+	std::unique_ptr<rdma_sender> rdma_;
+	/// whether the client wants the samples through shared memory (if it's on this host), and the
+	/// sender if they are
+	bool shared_memory_requested_{false};
+	std::unique_ptr<shm_sender> shm_;
+	/// the sequence number of the first sample the client wants to receive (0 for new samples only)
+	uint64_t resume_from_{0};
+	/// how many seconds of the history the client wants to receive (if not resuming)
+	double history_seconds_{0.0};
+	/// what to do if the client's queue is full, and the policy's parameter
+	lsl_overflow_policy_t overflow_policy_{ovf_drop_oldest};
+	double overflow_parameter_{0.0};
+	/// how urgently the client is served: its queue gets new samples before the ones of lower
+	/// priority classes, and bulk sessions wait behind the others after each chunk
+	lsl_transfer_priority_t priority_{prio_normal};
+	/// the bandwidth the client asked to be limited to (bytes per second, 0 for no limit)
+	double max_bytes_per_second_{0.0};
+	/// the session's rate limit, and whether the host's limit applies to it, too
+	token_bucket shaper_;
+	bool host_shaping_{false};
+	/// the previously sent channel values, for the delta encoding
+	std::vector<char> delta_prev_;
+	/// the source channels sent to the client (empty for all channels, and all channels if only
+	/// the decimation is requested)
+	std::vector<uint32_t> channels_;
+	/// whether the client requested a channel subset
+	bool channel_subset_{false};
+	/// only every decimation_-th sample is sent
+	uint32_t decimation_{1};
+	/// the number of samples taken from the queue, to decimate them
+	uint32_t decimated_{0};
+	/// the time stamp of the previous sample, to resolve deduced time stamps of decimated samples
+	double last_timestamp_{0.0};
+	/// decides which time stamps the client can deduce
+	timestamp_deduction deduction_;
+	/// the rate conversion requested by the client, and the resampler that does it (if we can)
+	uint32_t resampling_up_{1}, resampling_down_{1};
+	std::unique_ptr<resampler> resampler_;
+	/// the samples produced by the resampler
+	std::vector<sample_p> resampled_;
+	/// only the samples whose first sent channel matches are sent (see value_filter)
+	value_filter filter_;
+	/// allocates the samples with the client's channels
+	factory_p subset_factory_;
+	/// the sequence numbers of the last sample serialized and of the chunk in flight (tracing)
+	uint64_t chunk_seq_{0}, sent_seq_{0};
 	/// this buffer holds the request as received from the client (incrementally filled)
 	asio::streambuf requestbuf_;
+#ifndef LSL_NO_PROTOCOL_100
 	/// output archive (wrapped around the feed buffer)
 	std::unique_ptr<class eos::portable_oarchive> outarch_;
+#endif
 	/// this is a stream on top of the request buffer for convenient parsing
 	std::istream requeststream_;
+	/// the queue of samples to be sent to the client
+	std::shared_ptr<consumer_queue> queue_;
+	/// the sequence # is merely used to determine chunk boundaries (no need for int64)
+	uint32_t seqn_{0};
+	/// keeps the session alive while transfer_samples_async() waits for a push notification
+	std::shared_ptr<client_session> notify_keepalive_;
 	/// scratchpad memory (e.g., for endianness conversion)
 	char *scratch_{nullptr};
 	/// protocol version to use for transmission
@@ -124,34 +524,197 @@ private:
 	/// byte order to use (0=portable, 1234=little endian, 4321=big endian, 2134=PDP endian,
 	/// unsupported)
 	int use_byte_order_{BOOST_BYTE_ORDER};
-	/// our chunk granularity
-	int chunk_granularity_{0};
-	/// maximum number of samples buffered
-	int max_buffered_{0};
+	/// the stream's settings, as of the session's start
+	stream_config_p config_;
+	/// whether we registered our wire format at the server's serialization cache
+	bool cache_user_{false};
+	/// our chunk granularity (may be changed by the client while the samples are transferred)
+	std::atomic<int> chunk_granularity_{0};
+	/// maximum number of samples buffered (may be changed by the client, see chunk_granularity_)
+	std::atomic<int> max_buffered_{0};
+	/// whether the client may change the buffering parameters while the samples are transferred
+	bool live_reconfiguration_{false};
 
 	// data exchanged between the transfer completion handler and the transfer thread
 	/// whether the current transfer has finished (possibly with an error)
-	bool transfer_completed_;
+	bool transfer_completed_{true};
 	/// the outcome of the last chunk transfer
 	error_code transfer_error_;
 	/// the amount of bytes transferred
-	std::size_t transfer_amount_;
+	std::size_t transfer_amount_{0};
 	/// a mutex that protects the completion data
 	std::mutex completion_mut_;
 	/// a condition variable that signals completion
 	std::condition_variable completion_cond_;
 };
 
+/**
+ * A TCP acceptor that is shared by all tcp_servers of the process (per protocol).
+ *
+ * It reads the start of each request to find the requested stream: its UID is part of the
+ * `LSL:streamfeed/` and `LSL:bundle/` request lines and of the metadata tag in `LSL:fullinfo`
+ * requests, and `LSL:shortinfo` requests go to the first stream that matches the query. Requests
+ * without a UID can only be handed on if there's a single server. The connection is then
+ * processed by a client_session of that server, but in the acceptor's io_context.
+ */
+class shared_acceptor : public std::enable_shared_from_this<shared_acceptor> {
+public:
+	shared_acceptor(std::shared_ptr<io_context_pool> pool, tcp protocol)
+		: pool_(std::move(pool)), io_(pool_->next()), acceptor_(*io_) {
+		acceptor_.open(protocol);
+		port_ = bind_and_listen_to_port_in_range(acceptor_, protocol, 64);
+		LOG_F(INFO, "Started the shared TCP server on IPv%d port %d", protocol == tcp::v4() ? 4 : 6,
+			port_);
+	}
+
+	/// Get the shared acceptor for a protocol, creating it if it isn't in use.
+	static std::shared_ptr<shared_acceptor> acquire(tcp protocol) {
+		std::lock_guard<std::mutex> lock(registry_mut());
+		auto &entry = registry(protocol);
+		auto result = entry.lock();
+		if (!result) {
+			auto pool = io_context_pool::outlet_pool();
+			if (!pool) pool = std::make_shared<io_context_pool>(1, "IOS_");
+			result = std::make_shared<shared_acceptor>(std::move(pool), protocol);
+			result->accept_next();
+			entry = result;
+		}
+		result->users_++;
+		result->protocol_v6_ = protocol == tcp::v6();
+		return result;
+	}
+
+	/// Release an acceptor returned by acquire(); the last user closes it.
+	static void release(const std::shared_ptr<shared_acceptor> &acc) {
+		std::lock_guard<std::mutex> lock(registry_mut());
+		if (--acc->users_) return;
+		auto &entry = registry(acc->protocol_v6_ ? tcp::v6() : tcp::v4());
+		if (entry.lock() == acc) entry.reset();
+		post(*acc->io_, [acc]() {
+			error_code ec;
+			acc->acceptor_.close(ec);
+		});
+	}
+
+	uint16_t port() const { return port_; }
+
+	/// Hand the connections for a server's stream to it from now on.
+	void add(const tcp_server_p &server) {
+		std::lock_guard<std::mutex> lock(servers_mut_);
+		servers_.push_back(server);
+	}
+
+	/// Stop handing connections to a server.
+	void remove(const tcp_server *server) {
+		std::lock_guard<std::mutex> lock(servers_mut_);
+		servers_.erase(std::remove_if(servers_.begin(), servers_.end(),
+						   [server](const std::weak_ptr<tcp_server> &s) {
+							   auto locked = s.lock();
+							   return !locked || locked.get() == server;
+						   }),
+			servers_.end());
+	}
+
+private:
+	/// requests that are longer than this without containing the needed lines are dropped
+	static const std::size_t max_request_bytes = 16384;
+
+	static std::mutex &registry_mut() {
+		static std::mutex mut;
+		return mut;
+	}
+
+	static std::weak_ptr<shared_acceptor> &registry(tcp protocol) {
+		static std::weak_ptr<shared_acceptor> acceptors[2];
+		return acceptors[protocol == tcp::v6() ? 1 : 0];
+	}
+
+	void accept_next() {
+		auto sock = std::make_shared<tcp::socket>(*io_);
+		acceptor_.async_accept(*sock, [shared_this = shared_from_this(), sock](err_t err) {
+			if (err == asio::error::operation_aborted || !shared_this->acceptor_.is_open()) return;
+			if (!err) shared_this->read_request(sock, std::make_shared<asio::streambuf>());
+			shared_this->accept_next();
+		});
+	}
+
+	/// Read until the request line (and the query line of a shortinfo request) are complete.
+	void read_request(tcp_socket_p sock, std::shared_ptr<asio::streambuf> buf) {
+		sock->async_read_some(buf->prepare(1024),
+			[shared_this = shared_from_this(), sock, buf](err_t err, std::size_t len) {
+				if (err) return;
+				buf->commit(len);
+				std::string data(asio::buffers_begin(buf->data()), asio::buffers_end(buf->data()));
+				const auto eol = data.find("\r\n");
+				if (eol != std::string::npos &&
+					(trim(data.substr(0, eol)) != "LSL:shortinfo" ||
+						data.find("\r\n", eol + 2) != std::string::npos))
+					shared_this->dispatch(sock, data, eol);
+				else if (data.size() < max_request_bytes)
+					shared_this->read_request(sock, buf);
+			});
+	}
+
+	/// Find the server for a request and let it process the connection.
+	void dispatch(const tcp_socket_p &sock, const std::string &data, std::size_t eol) {
+		const std::string method = trim(data.substr(0, eol));
+		std::string uid, query;
+		if (method.compare(0, 15, "LSL:streamfeed/") == 0 ||
+			method.compare(0, 11, "LSL:bundle/") == 0) {
+			const auto parts = splitandtrim(method, ' ', true);
+			if (parts.size() > 1) uid = parts[1];
+		} else if (method.compare(0, 13, "LSL:fullinfo ") == 0) {
+			for (const auto &param : splitandtrim(method.substr(13), ' ', false))
+				if (param[0] == '@') uid = param.substr(1, param.find(':') - 1);
+		} else if (method == "LSL:shortinfo")
+			query = trim(data.substr(eol + 2, data.find("\r\n", eol + 2) - eol - 2));
+
+		std::vector<tcp_server_p> servers;
+		{
+			std::lock_guard<std::mutex> lock(servers_mut_);
+			for (const auto &server : servers_)
+				if (auto locked = server.lock()) servers.push_back(std::move(locked));
+		}
+		for (const auto &server : servers) {
+			if (!uid.empty() ? server->info_->uid() == uid
+							 : method == "LSL:shortinfo" ? server->info_->matches_query(query)
+														 : servers.size() == 1) {
+				std::make_shared<client_session>(server, io_, sock)->begin_processing(data);
+				return;
+			}
+		}
+		DLOG_F(INFO, "No stream for the request '%s' on the shared port", method.c_str());
+	}
+
+	std::shared_ptr<io_context_pool> pool_;
+	io_context_p io_;
+	tcp::acceptor acceptor_;
+	uint16_t port_{0};
+	bool protocol_v6_{false};
+	/// the number of tcp_servers that acquired the acceptor (protected by registry_mut())
+	int users_{0};
+	/// the servers to hand connections to
+	std::vector<std::weak_ptr<tcp_server>> servers_;
+	std::mutex servers_mut_;
+};
+
 tcp_server::tcp_server(stream_info_impl_p info, io_context_p io, send_buffer_p sendbuf,
-	factory_p factory, tcp protocol, int chunk_size)
+	factory_p factory, tcp protocol, int chunk_size, stream_config_p config)
 	: chunk_size_(chunk_size), shutdown_(false), info_(std::move(info)), io_(std::move(io)),
-	  factory_(std::move(factory)), send_buffer_(std::move(sendbuf)),
+	  factory_(std::move(factory)), send_buffer_(std::move(sendbuf)), config_(std::move(config)),
 	  acceptor_(std::make_shared<tcp::acceptor>(*io_)) {
-	// open the server connection
-	acceptor_->open(protocol);
+	uint16_t port;
+	if (api_config::get_instance()->shared_sockets()) {
+		// use the process-wide acceptor
+		shared_ = shared_acceptor::acquire(protocol);
+		port = shared_->port();
+	} else {
+		// open the server connection
+		acceptor_->open(protocol);
 
-	// bind to and listen on a free port
-	uint16_t port = bind_and_listen_to_port_in_range(*acceptor_, protocol, 10);
+		// bind to and listen on a free port
+		port = bind_and_listen_to_port_in_range(*acceptor_, protocol, 10);
+	}
 
 	// and assign connection-dependent fields
 	// (note: this may be assigned multiple times by multiple TCPs during setup but does not matter)
@@ -167,22 +730,40 @@ tcp_server::tcp_server(stream_info_impl_p info, io_context_p io, send_buffer_p s
 		protocol == tcp::v4() ? 4 : 6, port);
 }
 
+tcp_server::~tcp_server() {
+	if (shared_) shared_acceptor::release(shared_);
+}
+
 
 // === externally issued asynchronous commands ===
 
 void tcp_server::begin_serving() {
-	// pre-generate the info's messages
-	shortinfo_msg_ = info_->to_shortinfo_message();
-	fullinfo_msg_ = info_->to_fullinfo_message();
+	// pre-generate the info's messages; they're only serialized again if the metadata changes
+	info_->cached_shortinfo_message();
+	info_->cached_fullinfo_message();
 	// start accepting connections
-	accept_next_connection();
+	if (shared_)
+		shared_->add(shared_from_this());
+	else
+		accept_next_connection();
 }
 
 void tcp_server::end_serving() {
+	// tell the clients that want to know that the stream ends before their connections go away
+	const auto goodbye =
+		std::make_shared<const std::string>(control_frame(control_end_of_stream, {}));
+	std::vector<std::pair<std::shared_ptr<client_session>, uint64_t>> goodbyes;
+	for (auto &sess : control_sessions())
+		if (sess->end_of_stream()) goodbyes.emplace_back(sess, sess->queue_control(goodbye));
+	const double deadline = lsl_clock() + goodbye_timeout;
+	for (const auto &sent : goodbyes)
+		sent.first->wait_controls_sent(sent.second, std::max(deadline - lsl_clock(), 0.0));
+	goodbyes.clear();
 	// the shutdown flag informs the transfer thread that we're shutting down
 	shutdown_ = true;
 	// issue closure of the server socket; this will result in a cancellation of the associated IO
 	// operations
+	if (shared_) shared_->remove(this);
 	post(*io_, [shared_acceptor = acceptor_]() { shared_acceptor->close(); });
 	// issue closure of all active client session sockets; cancels the related outstanding IO jobs
 	close_inflight_sockets();
@@ -191,6 +772,30 @@ void tcp_server::end_serving() {
 	send_buffer_->push_sample(factory_->new_sample(lsl_clock(), true));
 }
 
+std::vector<std::shared_ptr<client_session>> tcp_server::control_sessions() {
+	std::vector<std::shared_ptr<client_session>> sessions;
+	std::lock_guard<std::mutex> lock(control_mut_);
+	// forget the sessions that have ended
+	control_sessions_.erase(std::remove_if(control_sessions_.begin(), control_sessions_.end(),
+								[](const std::weak_ptr<client_session> &sess) {
+									return sess.expired();
+								}),
+		control_sessions_.end());
+	for (const auto &sess : control_sessions_)
+		if (auto locked = sess.lock()) sessions.push_back(std::move(locked));
+	return sessions;
+}
+
+std::size_t tcp_server::send_control(const std::shared_ptr<const std::string> &frame) {
+	std::size_t sent = 0;
+	for (const auto &sess : control_sessions())
+		if (sess->metadata_updates()) {
+			sess->queue_control(frame);
+			++sent;
+		}
+	return sent;
+}
+
 // === accept loop ===
 
 void tcp_server::accept_next_connection() {
@@ -232,7 +837,7 @@ void tcp_server::unregister_inflight_socket(const tcp_socket_p &sock) {
 void tcp_server::close_inflight_sockets() {
 	std::lock_guard<std::recursive_mutex> lock(inflight_mut_);
 	for (const auto &sock : inflight_)
-		post(*io_, [sock]() {
+		post(sock->get_executor(), [sock]() {
 			try {
 				if (sock->is_open()) {
 					try {
@@ -253,19 +858,33 @@ void tcp_server::close_inflight_sockets() {
 client_session::~client_session() {
 	try {
 		if (registered_) serv_->unregister_inflight_socket(sock_);
+		if (datagrams_) datagrams_->unsubscribe();
+		if (cache_user_)
+			serv_->serialization_cache_.remove_user(data_protocol_version_, use_byte_order_);
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Unexpected error in client_session destructor: %s", e.what());
 	} catch (...) { LOG_F(ERROR, "Severe error during client session shutdown."); }
+	serv_->feed_buffer_bytes_.fetch_sub(accounted_feed_bytes_, std::memory_order_relaxed);
+#ifdef LSL_KERNEL_ZEROCOPY
+	serv_->zerocopy_chunks_.fetch_sub(zerocopy_pending_.size(), std::memory_order_relaxed);
+#endif
 	delete[] scratch_;
 }
 
-void client_session::begin_processing() {
+void client_session::begin_processing(const std::string &received) {
 	try {
-		sock_->set_option(asio::ip::tcp::no_delay(true));
+		config_ = serv_->get_config();
+		apply_socket_options(*sock_, serv_->get_socket_options());
 		// register this socket as "in-flight" with the server (so that any subsequent ops on it can
 		// be aborted if necessary)
 		serv_->register_inflight_socket(sock_);
 		registered_ = true;
+		if (!received.empty()) {
+			// the request line has been read already
+			std::ostream(&requestbuf_) << received;
+			handle_read_command_outcome(error_code());
+			return;
+		}
 		// read the request line
 		async_read_until(*sock_, requestbuf_, "\r\n",
 			[shared_this = shared_from_this()](
@@ -275,6 +894,31 @@ void client_session::begin_processing() {
 	}
 }
 
+/// build the reply to an `LSL:fullinfo` request with parameters
+static std::string fullinfo_reply(stream_info_impl &info, const std::vector<std::string> &params) {
+	std::vector<std::string> desc_subtrees;
+	bool tagged = false;
+	std::string known_tag;
+	for (const auto &param : params)
+		if (param[0] == '@') {
+			tagged = true;
+			known_tag = param.substr(1);
+		} else
+			desc_subtrees.push_back(param);
+
+	// the tag is taken before the message, so the message is at least as new as the tag
+	const std::string tag = info.uid() + ':' + std::to_string(info.metadata_version());
+	auto fullinfo = info.cached_fullinfo_message();
+	std::string reply;
+	if (tagged) {
+		reply = "LSL:infotag " + tag + "\r\n";
+		if (known_tag == tag) return reply;
+	}
+	return reply += desc_subtrees.empty()
+						? *fullinfo
+						: stream_info_impl::select_desc_subtrees(*fullinfo, desc_subtrees);
+}
+
 void client_session::handle_read_command_outcome(err_t read_err) {
 	try {
 		if (read_err) return;
@@ -289,10 +933,18 @@ void client_session::handle_read_command_outcome(err_t read_err) {
 					shared_this->handle_read_query_outcome(err);
 				});
 		else if (method == "LSL:fullinfo")
+		{
 			// fullinfo request: reply right away
-			async_write(*sock_, asio::buffer(serv_->fullinfo_msg_),
-				[shared_this = shared_from_this()](err_t /*unused*/, std::size_t /*unused*/) {});
-		else if (method == "LSL:streamfeed")
+			auto msg = serv_->info_->cached_fullinfo_message();
+			async_write(*sock_, asio::buffer(*msg),
+				[shared_this = shared_from_this(), msg](err_t, std::size_t /*unused*/) {});
+		} else if (method.compare(0, 13, "LSL:fullinfo ") == 0) {
+			// fullinfo request with a metadata tag and / or for some of the <desc> children only
+			auto msg = std::make_shared<const std::string>(
+				fullinfo_reply(*serv_->info_, splitandtrim(method.substr(13), ' ', false)));
+			async_write(*sock_, asio::buffer(*msg),
+				[shared_this = shared_from_this(), msg](err_t, std::size_t /*unused*/) {});
+		} else if (method == "LSL:streamfeed")
 			// streamfeed request (1.00): read feed parameters
 			async_read_until(*sock_, requestbuf_, "\r\n",
 				[shared_this = shared_from_this()](err_t err, std::size_t /*unused*/) {
@@ -308,6 +960,15 @@ void client_session::handle_read_command_outcome(err_t read_err) {
 					err_t err, std::size_t /*unused*/) {
 					shared_this->handle_read_feedparams(request_protocol_version, request_uid, err);
 				});
+		} else if (method == "LSL:timedata")
+			// time synchronization over TCP: answer the probes until the client disconnects
+			read_time_probe();
+		else if (method.compare(0, 11, "LSL:bundle/") == 0) {
+			// bundled connection: it serves all streams of this process (see bundle_message), so
+			// it's handed off and this server doesn't close it
+			serv_->unregister_inflight_socket(sock_);
+			registered_ = false;
+			serve_bundle(io_, sock_, requestbuf_);
 		}
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Unexpected error while parsing a client command: %s", e.what());
@@ -323,8 +984,9 @@ void client_session::handle_read_query_outcome(err_t err) {
 		query = trim(query);
 		if (serv_->info_->matches_query(query)) {
 			// matches: reply (otherwise just close the stream)
-			async_write(*sock_, asio::buffer(serv_->shortinfo_msg_),
-				[shared_this = shared_from_this() /*unused*/](err_t, std::size_t /*unused*/) {
+			auto msg = serv_->info_->cached_shortinfo_message();
+			async_write(*sock_, asio::buffer(*msg),
+				[shared_this = shared_from_this(), msg](err_t, std::size_t /*unused*/) {
 					/* keep the client_session alive until the shortinfo is sent completely*/
 				});
 		} else {
@@ -351,19 +1013,27 @@ void client_session::handle_read_feedparams(
 
 		// check request validity
 		if (request_protocol_version / 100 >
-			api_config::get_instance()->use_protocol_version() / 100) {
+			config_->use_protocol_version / 100) {
 			send_status_message("LSL/" +
-								std::to_string(api_config::get_instance()->use_protocol_version()) +
+								std::to_string(config_->use_protocol_version) +
 								" 505 Version not supported");
 			DLOG_F(WARNING, "%p Got a request for a too new protocol version", this);
 			return;
 		}
 		if (!request_uid.empty() && request_uid != serv_->info_->uid()) {
 			send_status_message("LSL/" +
-								to_string(api_config::get_instance()->use_protocol_version()) +
+								to_string(config_->use_protocol_version) +
 								" 404 Not found");
 			return;
 		}
+#ifdef LSL_NO_PROTOCOL_100
+		// this build can't send the portable archives of protocol 1.00
+		if (request_protocol_version < 110) {
+			send_status_message("LSL/" + to_string(config_->use_protocol_version) +
+								" 505 Version not supported");
+			return;
+		}
+#endif
 
 		if (request_protocol_version >= 110) {
 			int client_byte_order = 1234;		  // assume little endian
@@ -404,7 +1074,58 @@ void client_session::handle_read_feedparams(
 					if (type == "value-size") client_value_size = std::stoi(rest);
 					if (type == "max-buffer-length") max_buffered_ = std::stoi(rest);
 					if (type == "max-chunk-length") chunk_granularity_ = std::stoi(rest);
+					if (type == "live-reconfiguration")
+						live_reconfiguration_ = from_string<bool>(rest);
 					if (type == "protocol-version") client_protocol_version = std::stoi(rest);
+					if (type == "value-encoding") {
+						delta_encoding_ = (rest == "delta");
+						changed_channels_ = (rest == "changed-channels");
+					}
+					if (type == "sample-framing") framed_ = (rest == "chunks");
+					if (type == "metadata-updates") metadata_updates_ = from_string<bool>(rest);
+					if (type == "end-of-stream") end_of_stream_ = from_string<bool>(rest);
+					if (type == "heartbeat-interval")
+						heartbeat_interval_ = from_string<double>(rest);
+					if (type == "timestamp-encoding") timestamp_deltas_ = (rest == "ns-delta");
+					if (type == "sequence-numbers") sequence_numbers_ = from_string<bool>(rest);
+					if (type == "gap-detection") gap_detection_ = from_string<bool>(rest);
+					if (type == "skip-test-patterns")
+						skip_test_patterns_ = from_string<bool>(rest);
+					if (type == "resume-from") resume_from_ = std::stoull(rest);
+					if (type == "history-seconds") history_seconds_ = std::stod(rest);
+					if (type == "overflow-policy")
+						overflow_policy_ = consumer_queue::parse_overflow_policy(rest);
+					if (type == "overflow-parameter") overflow_parameter_ = std::stod(rest);
+					if (type == "priority") priority_ = consumer_queue::parse_priority(rest);
+					if (type == "max-bytes-per-second")
+						max_bytes_per_second_ = std::max(std::stod(rest), 0.0);
+					if (type == "channel-subset") {
+						std::istringstream list(rest);
+						for (std::string index; std::getline(list, index, ',');)
+							channels_.push_back(static_cast<uint32_t>(std::stoul(index)));
+					}
+					if (type == "decimation") decimation_ = static_cast<uint32_t>(std::stoul(rest));
+					if (type == "value-filter") {
+						try {
+							filter_ = value_filter::parse(rest);
+						} catch (std::exception &e) {
+							LOG_F(WARNING, "%p Ignoring the malformed value filter: %s", this,
+								e.what());
+						}
+					}
+					if (type == "resampling") {
+						std::istringstream factors(rest);
+						char slash;
+						if (!(factors >> resampling_up_ >> slash >> resampling_down_) ||
+							slash != '/')
+							resampling_up_ = resampling_down_ = 1;
+					}
+					if (type == "multicast-data") multicast_requested_ = from_string<bool>(rest);
+					if (type == "rdma-endpoint") rdma_endpoint_ = rest;
+					if (type == "shared-memory")
+						shared_memory_requested_ = from_string<bool>(rest);
+					if (type == "datagram-port")
+						datagram_port_ = static_cast<uint16_t>(std::stoul(rest));
 				} else {
 					DLOG_F(WARNING, "%p Request line '%s' contained no key-value pair", this,
 						hdrline.c_str());
@@ -415,7 +1136,7 @@ void client_session::handle_read_feedparams(
 			bool client_suppress_subnormals = false;
 			// use least common denominator data protocol version
 			data_protocol_version_ = std::min(
-				api_config::get_instance()->use_protocol_version(), client_protocol_version);
+				config_->use_protocol_version, client_protocol_version);
 			// downgrade to 1.00 (portable binary format) if an unsupported binary conversion is
 			// involved
 			if (serv_->info_->channel_bytes() != client_value_size) data_protocol_version_ = 100;
@@ -423,6 +1144,14 @@ void client_session::handle_read_feedparams(
 				(format == cft_float32 && !format_ieee754[cft_float32]) ||
 				!client_has_ieee754_floats)
 				data_protocol_version_ = 100;
+#ifdef LSL_NO_PROTOCOL_100
+			if (data_protocol_version_ < 110) {
+				send_status_message("LSL/" + to_string(config_->use_protocol_version) +
+									" 505 Version not supported");
+				DLOG_F(WARNING, "%p The client needs the unsupported protocol 1.00", this);
+				return;
+			}
+#endif
 			if (data_protocol_version_ >= 110) {
 				// decide on the byte order if conflicting
 				if (BOOST_BYTE_ORDER != client_byte_order) {
@@ -443,43 +1172,217 @@ void client_session::handle_read_feedparams(
 				client_suppress_subnormals =
 					(format_subnormal[format] && !client_supports_subnormals);
 			}
+			// delta encoding is only available for numeric formats
+			// the delta encoding works on whole words, so not on the packed 24 bit values
+			delta_encoding_ = delta_encoding_ && data_protocol_version_ >= 110 &&
+							  format != cft_string && format != cft_int24;
+			// sequence numbers are only worth their overhead if we can resume streams or the
+			// client wants to detect the samples it missed
+			const bool history = serv_->send_buffer_->has_history();
+			sequence_numbers_ = sequence_numbers_ && data_protocol_version_ >= 110 &&
+								(history || gap_detection_);
+			if (!sequence_numbers_ || !history) resume_from_ = 0;
+			// the client picks the channels and samples itself if we can't do it
+			for (uint32_t channel : channels_)
+				if (channel >= serv_->info_->channel_count()) {
+					LOG_F(WARNING, "%p Ignoring channel subset with out-of-range index %u", this,
+						channel);
+					channels_.clear();
+					break;
+				}
+			channel_subset_ = !channels_.empty();
+			if (!decimation_) decimation_ = 1;
+			// the client resamples the stream itself if we can't do it
+			bool resampling = resampling_up_ != resampling_down_ && decimation_ <= 1;
+			if (resampling) {
+				try {
+					resampler::validate(
+						format, serv_->info_->nominal_srate(), resampling_up_, resampling_down_);
+					// the resampled samples can't be resumed or repaired by their sequence number
+					sequence_numbers_ = false;
+					resume_from_ = 0;
+				} catch (std::invalid_argument &e) {
+					LOG_F(INFO, "%p Not resampling the stream: %s", this, e.what());
+					resampling = false;
+				}
+			}
+			if (!resampling) resampling_up_ = resampling_down_ = 1;
+			// likewise for the value filter
+			if (!filter_.empty()) {
+				try {
+					filter_.validate(format);
+				} catch (std::invalid_argument &e) {
+					LOG_F(INFO, "%p Not filtering the stream: %s", this, e.what());
+					filter_ = value_filter();
+				}
+			}
+			if (!channel_subset_ && (decimation_ > 1 || resampling || !filter_.empty()))
+				for (uint32_t k = 0; k < serv_->info_->channel_count(); ++k) channels_.push_back(k);
+			// clients that take the samples as they are receive them as datagrams (just for them,
+			// or by multicast with lost ones repaired from the history), in our byte order
+			if (data_protocol_version_ >= 110 && channels_.empty() && history_seconds_ <= 0.0 &&
+				client_byte_order != 2134) {
+				if (shared_memory_requested_ && same_host()) {
+					try {
+						// the client is woken up by a byte on this connection
+						shm_.reset(new shm_sender(serv_->info_, serv_->send_buffer_,
+							[sock = sock_]() {
+								const char wakeup = 0;
+								error_code ec;
+								sock->send(asio::buffer(&wakeup, 1), 0, ec);
+							},
+							max_buffered_));
+					} catch (std::exception &e) {
+						LOG_F(INFO, "%p Sending the samples over TCP instead of shared memory: %s",
+							this, e.what());
+					}
+				} else if (!rdma_endpoint_.empty()) {
+					try {
+						rdma_.reset(new rdma_sender(serv_->info_, serv_->send_buffer_,
+							rdma_address::parse(rdma_endpoint_), max_buffered_));
+					} catch (std::exception &e) {
+						LOG_F(INFO, "%p Sending the samples over TCP instead of RDMA: %s", this,
+							e.what());
+					}
+				} else if (datagram_port_) {
+					try {
+						datagrams_ = std::make_shared<datagram_sender>(serv_->info_,
+							serv_->send_buffer_,
+							asio::ip::udp::endpoint(
+								sock_->remote_endpoint().address(), datagram_port_));
+						datagrams_->subscribe(max_buffered_);
+						unicast_datagrams_ = true;
+					} catch (std::exception &e) {
+						LOG_F(INFO, "%p Sending the samples over TCP instead of datagrams: %s",
+							this, e.what());
+					}
+				} else if (multicast_requested_ && sequence_numbers_) {
+					datagrams_ = serv_->get_multicast_sender();
+					if (datagrams_) {
+						// the samples pushed from now on are multicast
+						datagrams_->subscribe();
+						multicast_start_ = serv_->send_buffer_->last_seq();
+					}
+				}
+				if (datagrams_ || rdma_ || shm_) {
+					use_byte_order_ = BOOST_BYTE_ORDER;
+					delta_encoding_ = false;
+				}
+			}
+			// framing is only available for numeric formats, and the delta encoding is denser
+			framed_ = framed_ && data_protocol_version_ >= 110 && format != cft_string &&
+					  !delta_encoding_ && !datagrams_ && !rdma_ && !shm_;
+			timestamp_deltas_ = timestamp_deltas_ && framed_;
+			changed_channels_ = changed_channels_ && framed_;
+			metadata_updates_ = metadata_updates_ && framed_;
+			end_of_stream_ = end_of_stream_ && framed_;
+			heartbeat_interval_ = framed_ && heartbeat_interval_ > 0.0
+									  ? std::max(heartbeat_interval_, min_heartbeat_interval)
+									  : 0.0;
+			skip_test_patterns_ = skip_test_patterns_ && data_protocol_version_ >= 110;
+			// the datagram feeds use the connection for their repair requests
+			live_reconfiguration_ = live_reconfiguration_ && data_protocol_version_ >= 110 &&
+									!datagrams_ && !rdma_ && !shm_;
+			delta_state_.srate = serv_->info_->nominal_srate();
 
 			// send the response
 			std::ostream response_stream(&feedbuf_);
-			response_stream << "LSL/" << api_config::get_instance()->use_protocol_version()
+			response_stream << "LSL/" << config_->use_protocol_version
 							<< " 200 OK\r\n";
 			response_stream << "UID: " << serv_->info_->uid() << "\r\n";
 			response_stream << "Byte-Order: " << use_byte_order_ << "\r\n";
 			response_stream << "Suppress-Subnormals: " << client_suppress_subnormals << "\r\n";
 			response_stream << "Data-Protocol-Version: " << data_protocol_version_ << "\r\n";
+			if (delta_encoding_) response_stream << "Value-Encoding: delta\r\n";
+			if (changed_channels_) response_stream << "Value-Encoding: changed-channels\r\n";
+			if (framed_) response_stream << "Sample-Framing: chunks\r\n";
+			if (timestamp_deltas_) response_stream << "Timestamp-Encoding: ns-delta\r\n";
+			if (metadata_updates_) response_stream << "Metadata-Updates: 1\r\n";
+			if (end_of_stream_) response_stream << "End-Of-Stream: 1\r\n";
+			if (heartbeat_interval_ > 0.0)
+				response_stream << "Heartbeat-Interval: " << heartbeat_interval_ << "\r\n";
+			if (sequence_numbers_) response_stream << "Sequence-Numbers: 1\r\n";
+			if (skip_test_patterns_) response_stream << "Skip-Test-Patterns: 1\r\n";
+			if (live_reconfiguration_) response_stream << "Live-Reconfiguration: 1\r\n";
+			if (overflow_policy_ != ovf_drop_oldest)
+				response_stream << "Overflow-Policy: "
+								<< consumer_queue::overflow_policy_name(overflow_policy_) << "\r\n";
+			if (priority_ != prio_normal)
+				response_stream << "Priority: " << consumer_queue::priority_name(priority_)
+								<< "\r\n";
+			if (max_bytes_per_second_ > 0.0)
+				response_stream << "Max-Bytes-Per-Second: " << max_bytes_per_second_ << "\r\n";
+			if (channel_subset_) response_stream << "Channel-Subset: 1\r\n";
+			if (decimation_ > 1) response_stream << "Decimation: " << decimation_ << "\r\n";
+			if (!filter_.empty()) response_stream << "Value-Filter: 1\r\n";
+			if (resampling)
+				response_stream << "Resampling: " << resampling_up_ << "/" << resampling_down_
+								<< "\r\n";
+			if (shm_)
+				response_stream << "Shared-Memory-Data: " << shm_->key() << " " << shm_->name()
+								<< "\r\n";
+			else if (rdma_)
+				response_stream << "RDMA-Data: " << rdma_->key() << " "
+								<< rdma_->local().to_string() << "\r\n";
+			else if (unicast_datagrams_)
+				response_stream << "Datagram-Data: " << datagrams_->key() << "\r\n";
+			else if (datagrams_)
+				response_stream << "Multicast-Data: " << datagrams_->group().address().to_string()
+								<< " " << datagrams_->group().port() << " " << datagrams_->key()
+								<< " " << multicast_start_ << "\r\n";
 			response_stream << "\r\n" << std::flush;
 		} else {
 			// read feed parameters
-			requeststream_ >> max_buffered_ >> chunk_granularity_;
+			int max_buffered = 0, chunk_granularity = 0;
+			requeststream_ >> max_buffered >> chunk_granularity;
+			max_buffered_ = max_buffered;
+			chunk_granularity_ = chunk_granularity;
 		}
 
 		// --- validation ---
+#ifndef LSL_NO_PROTOCOL_100
 		if (data_protocol_version_ == 100) {
 			// create a portable output archive to write to
 			outarch_.reset(new eos::portable_oarchive(feedbuf_));
 			// serialize the shortinfo message into an archive
-			*outarch_ << serv_->shortinfo_msg_;
-		} else {
+			*outarch_ << *serv_->info_->cached_shortinfo_message();
+		} else
+#endif
+		{
 			// allocate scratchpad memory for endian conversion, etc.
 			scratch_ = new char[format_sizes[serv_->info_->channel_format()] *
 								serv_->info_->channel_count()];
 		}
 
-		// send test pattern samples
-		lsl::factory fac(serv_->info_->channel_format(), serv_->info_->channel_count(), 4);
+		// send test pattern samples, unless the inlet validated them on an earlier connection
+		if (!skip_test_patterns_) {
+			lsl::factory fac(serv_->info_->channel_format(), wire_channels(), 4);
+			for (int test_pattern : {4, 2}) {
+				lsl::sample_p temp(fac.new_sample(0.0, false));
+				temp->assign_test_pattern(test_pattern);
+#ifndef LSL_NO_PROTOCOL_100
+				if (data_protocol_version_ < 110)
+					*outarch_ << *temp;
+				else
+#endif
+					temp->save_streambuf(
+						feedbuf_, data_protocol_version_, use_byte_order_, scratch_);
+			}
+		}
 
-		for (int test_pattern : {4, 2}) {
-			lsl::sample_p temp(fac.new_sample(0.0, false));
-			temp->assign_test_pattern(test_pattern);
-			if (data_protocol_version_ >= 110)
-				temp->save_streambuf(feedbuf_, data_protocol_version_, use_byte_order_, scratch_);
-			else
-				*outarch_ << *temp;
+		// make a new consumer queue, so the samples pushed once the client sees the feed header
+		// aren't missed
+		if (!datagrams_ && !rdma_ && !shm_ && max_buffered_ > 0) {
+			queue_ = serv_->send_buffer_->new_consumer(
+				consumer_queue::policy_capacity(overflow_policy_, max_buffered_), resume_from_,
+				history_seconds_, priority_);
+			deduction_ = serv_->send_buffer_->new_timestamp_deduction();
+			// control frames queued from now on are sent with the first chunk, so an update
+			// right after the consumer shows up (see wait_for_consumers()) isn't missed
+			if (metadata_updates_ || end_of_stream_) {
+				std::lock_guard<std::mutex> lock(serv_->control_mut_);
+				serv_->control_sessions_.push_back(shared_from_this());
+			}
 		}
 
 		// send off the newly created feedheader
@@ -499,69 +1402,717 @@ void client_session::handle_send_feedheader_outcome(err_t err, std::size_t n) {
 
 		feedbuf_.consume(n);
 		// register outstanding work at the server (will be unregistered at session destruction)
-		work_ = std::make_shared<work_p::element_type>(serv_->io_->get_executor());
-		// spawn a sample transfer thread
-		std::thread(&client_session::transfer_samples_thread, this, shared_from_this()).detach();
+		work_ = std::make_shared<work_p::element_type>(io_->get_executor());
+		if (datagrams_ || rdma_ || shm_) {
+			// the connection only carries the repaired samples or wakeups (and keeps the session
+			// alive)
+			read_repair_request();
+			return;
+		}
+		if (!queue_) return;
+		if (config_->priority_marking) mark_socket_priority(*sock_, priority_);
+		{
+			// the configured limits only apply to connections that leave the host
+			error_code ec;
+			const bool remote = !sock_->remote_endpoint(ec).address().is_loopback();
+			double rate = remote ? config_->session_max_bytes_per_second : 0.0;
+			if (max_bytes_per_second_ > 0.0)
+				rate = rate > 0.0 ? std::min(rate, max_bytes_per_second_) : max_bytes_per_second_;
+			shaper_.set_rate(rate);
+			host_shaping_ = remote && host_shaper().rate() > 0.0;
+		}
+		queue_->set_overflow_policy(overflow_policy_, overflow_parameter_);
+		chunk_max_latency_ =
+			std::chrono::microseconds(config_->chunk_max_latency_us);
+		chunk_max_bytes_ = config_->chunk_max_bytes;
+		adaptive_chunking_ = config_->adaptive_chunking &&
+							 !chunk_max_latency_.count() && !chunk_granularity_.load();
+		// large native-endian numeric samples are sent directly from the sample memory instead of
+		// being copied into the feed buffer
+		const auto fmt = serv_->info_->channel_format();
+		zerocopy_ = data_protocol_version_ >= 110 && fmt != cft_string && !delta_encoding_ &&
+					!changed_channels_ &&
+					(use_byte_order_ == BOOST_BYTE_ORDER || format_sizes[fmt] == 1) &&
+					format_sizes[fmt] * wire_channels() >= min_zerocopy_bytes;
+#ifdef LSL_KERNEL_ZEROCOPY
+		// optionally, the kernel reads these payloads straight from the sample memory, too
+		if (zerocopy_ && config_->zerocopy_send_min_bytes) {
+			const int one = 1;
+			kernel_zerocopy_ =
+				setsockopt(sock_->native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+			if (kernel_zerocopy_)
+				zerocopy_timer_.reset(new asio::steady_timer(*io_));
+			else
+				LOG_F(INFO, "MSG_ZEROCOPY sends are not supported: %s", std::strerror(errno));
+		}
+#endif
+		// the samples with the client's channels are only serialized for this session
+		if (!channels_.empty())
+			subset_factory_ = factory::for_stream(fmt, wire_channels(), 16, false);
+		if (resampling_up_ != resampling_down_)
+			resampler_.reset(new resampler(subset_factory_, serv_->info_->nominal_srate(),
+				resampling_up_, resampling_down_));
+		if (delta_encoding_ || changed_channels_)
+			delta_prev_.assign(format_sizes[fmt] * wire_channels(), 0);
+		else if (data_protocol_version_ >= 110 && !zerocopy_ && !subset_factory_ && !framed_) {
+			serv_->serialization_cache_.add_user(data_protocol_version_, use_byte_order_);
+			cache_user_ = true;
+		}
+		if (config_->lock_memory || config_->no_allocation) reserve_feed_buffers();
+		if (heartbeat_interval_ > 0.0) schedule_heartbeat();
+		if (config_->async_transfer) {
+			set_push_notification();
+			transfer_samples_async();
+		} else {
+			// spawn a sample transfer thread
+			managed_thread(lsl_thread_transfer, "S_" + serv_->info_->name().substr(0, 12),
+				&client_session::transfer_samples_thread, this, shared_from_this())
+				.detach();
+		}
+		if (live_reconfiguration_) read_reconfiguration();
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Unexpected error while handling the feedheader send outcome: %s", e.what());
 	}
 }
 
+bool client_session::same_host() const {
+	error_code ec;
+	const auto remote = sock_->remote_endpoint(ec).address();
+	if (ec) return false;
+	return remote.is_loopback() || remote == sock_->local_endpoint(ec).address();
+}
+
+void client_session::read_repair_request() {
+	async_read_until(*sock_, requestbuf_, "\r\n",
+		[shared_this = shared_from_this()](
+			err_t err, size_t /*unused*/) { shared_this->handle_repair_request(err); });
+}
+
+void client_session::handle_repair_request(err_t err) {
+	try {
+		// the client disconnected
+		if (err) return;
+		std::string method;
+		uint64_t first = 0, last = 0;
+		requeststream_ >> method >> first >> last;
+		requeststream_.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		if (method != "LSL:repair" || !requeststream_) {
+			LOG_F(WARNING, "%p Got an invalid repair request", this);
+			return;
+		}
+		const auto samples = serv_->send_buffer_->history_range(first, last);
+		const uint64_t count = lslboost::endian::native_to_little<uint64_t>(samples.size());
+		feedbuf_.sputn(reinterpret_cast<const char *>(&count), sizeof(count));
+		for (const auto &samp : samples) {
+			const uint64_t seq = lslboost::endian::native_to_little(samp->seq);
+			feedbuf_.sputn(reinterpret_cast<const char *>(&seq), sizeof(seq));
+			samp->save_streambuf(feedbuf_, data_protocol_version_, use_byte_order_, scratch_);
+		}
+		serv_->samples_sent_.fetch_add(samples.size(), std::memory_order_relaxed);
+		async_write(*sock_, feedbuf_.data(),
+			[shared_this = shared_from_this()](err_t err, size_t len) {
+				if (err) return;
+				shared_this->serv_->count_chunk(len);
+				shared_this->feedbuf_.consume(len);
+				shared_this->read_repair_request();
+			});
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error while handling a repair request: %s", e.what());
+	}
+}
+
+void client_session::read_reconfiguration() {
+	async_read_until(*sock_, requestbuf_, "\r\n",
+		[shared_this = shared_from_this()](
+			err_t err, size_t /*unused*/) { shared_this->handle_reconfiguration(err); });
+}
+
+void client_session::handle_reconfiguration(err_t err) {
+	try {
+		// the client disconnected
+		if (err) return;
+		std::string method;
+		int max_buffered = -1, chunk_granularity = -1;
+		requeststream_ >> method >> max_buffered >> chunk_granularity;
+		requeststream_.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		if (method != "LSL:reconfigure" || !requeststream_ || max_buffered <= 0 ||
+			chunk_granularity < 0) {
+			LOG_F(WARNING, "%p Got an invalid reconfiguration request", this);
+			return;
+		}
+		// the transfer picks up the chunk size with the next sample, and the queue drops the
+		// samples beyond its new length right away
+		chunk_granularity_ = chunk_granularity;
+		max_buffered_ = max_buffered;
+		queue_->set_capacity_limit(static_cast<std::size_t>(
+			consumer_queue::policy_capacity(overflow_policy_, max_buffered)));
+		DLOG_F(INFO, "%p Reconfigured the feed: max buffer length %d, max chunk length %d", this,
+			max_buffered, chunk_granularity);
+		read_reconfiguration();
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error while handling a reconfiguration request: %s", e.what());
+	}
+}
+
+void client_session::read_time_probe() {
+	async_read_until(*sock_, requestbuf_, "\r\n",
+		[shared_this = shared_from_this()](
+			err_t err, size_t /*unused*/) { shared_this->handle_time_probe(err); });
+}
+
+void client_session::handle_time_probe(err_t err) {
+	try {
+		// the client disconnected
+		if (err) return;
+		const double t1 = lsl_clock();
+		int wave_id = 0;
+		double t0 = 0.0;
+		requeststream_ >> wave_id >> t0;
+		requeststream_.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		if (!requeststream_) {
+			LOG_F(WARNING, "%p Got an invalid time probe", this);
+			return;
+		}
+		std::ostringstream reply;
+		reply.precision(16);
+		reply << wave_id << ' ' << t0 << ' ' << t1 << ' ' << lsl_clock() << "\r\n";
+		auto msg = std::make_shared<std::string>(reply.str());
+		async_write(*sock_, asio::buffer(*msg),
+			[shared_this = shared_from_this(), msg](err_t err, size_t /*unused*/) {
+				if (!err) shared_this->read_time_probe();
+			});
+	} catch (std::exception &e) {
+		LOG_F(WARNING, "Unexpected error while handling a time probe: %s", e.what());
+	}
+}
+
+bool client_session::serialize_sample(sample_p samp) {
+	if (subset_factory_) {
+		double timestamp = samp->timestamp;
+		if (decimation_ > 1 || resampler_ || !filter_.empty()) {
+			// the client can't deduce the time stamps of decimated (or resampled / filtered)
+			// samples, so they are sent
+			if (timestamp == DEDUCED_TIMESTAMP) {
+				timestamp = last_timestamp_;
+				if (serv_->info_->nominal_srate() != IRREGULAR_RATE)
+					timestamp += 1.0 / serv_->info_->nominal_srate();
+			}
+			last_timestamp_ = timestamp;
+			// a skipped sample can still complete the chunk that's been serialized so far
+			if (decimated_++ % decimation_ != 0) return skipped_sample_completes_chunk(*samp);
+			if (!filter_.matches(*samp, channels_[0])) return skipped_sample_completes_chunk(*samp);
+		}
+		sample_p subset(subset_factory_->new_sample(timestamp, samp->pushthrough));
+		subset->assign_channels(*samp, channels_.data());
+		subset->seq = samp->seq;
+		samp = std::move(subset);
+	}
+	if (resampler_) {
+		resampler_->process(&samp, 1, resampled_);
+		if (resampled_.empty()) return skipped_sample_completes_chunk(*samp);
+		bool send = false;
+		for (sample_p &produced : resampled_)
+			send = serialize_wire_sample(std::move(produced)) || send;
+		resampled_.clear();
+		return send;
+	}
+	return serialize_wire_sample(std::move(samp));
+}
+
+bool client_session::serialize_wire_sample(sample_p samp) {
+	// optionally override the pushthrough flag by the chunk size of the receiver (if set) or of
+	// the sender (if set)
+	if (const int granularity = chunk_granularity_.load(std::memory_order_relaxed))
+		samp->pushthrough = (((++seqn_) % (uint32_t)granularity) == 0);
+	else if (const int chunk_size = serv_->chunk_size_.load(std::memory_order_relaxed))
+		samp->pushthrough = (((++seqn_) % (uint32_t)chunk_size) == 0);
+	if (!chunk_bytes()) {
+		if (chunk_max_latency_.count())
+			chunk_deadline_ = std::chrono::steady_clock::now() + chunk_max_latency_;
+		chunk_samples_ = 0;
+	}
+	++chunk_samples_;
+	// the client's first sample and those after a gap (e.g. dropped or decimated samples) have
+	// their time stamps sent, since the client can't deduce them
+	const double timestamp = deduction_.wire_timestamp(samp->timestamp, samp->seq);
+	const bool deduced = timestamp != samp->timestamp;
+	if (framed_)
+		// the time stamps and sequence numbers follow the chunk's values
+		fillpayloads_->frame.add(timestamp, sequence_numbers_ ? samp->seq : 0);
+	else if (sequence_numbers_) {
+		const uint64_t seq = lslboost::endian::native_to_little(samp->seq);
+		fillbuf_->sputn(reinterpret_cast<const char *>(&seq), sizeof(seq));
+	}
+	serv_->samples_sent_.fetch_add(1, std::memory_order_relaxed);
+	chunk_seq_ = samp->seq;
+	// serialize the sample into the stream
+	if (framed_) {
+		if (zerocopy_)
+			fillpayloads_->samples.emplace_back(fillbuf_->size(), samp);
+		else if (changed_channels_)
+			samp->save_streambuf_changed(*fillbuf_, use_byte_order_, delta_prev_.data());
+		else
+			samp->save_streambuf_values(*fillbuf_, use_byte_order_, scratch_);
+	} else if (delta_encoding_)
+		samp->save_streambuf_delta(*fillbuf_, use_byte_order_, delta_prev_.data(), deduced);
+	else if (zerocopy_) {
+		samp->save_streambuf_header(*fillbuf_, use_byte_order_, deduced);
+		fillpayloads_->samples.emplace_back(fillbuf_->size(), samp);
+	} else if (data_protocol_version_ < 110)
+		samp->save_portable(*fillbuf_, deduced);
+	else if (deduced)
+		// the other clients may get this sample's time stamp, so it's not taken from the cache
+		samp->save_streambuf(*fillbuf_, data_protocol_version_, use_byte_order_, scratch_, true);
+	else
+		serv_->serialization_cache_.save_streambuf(
+			samp, *fillbuf_, data_protocol_version_, use_byte_order_, scratch_);
+	// with the max-latency policy, the chunk ends when it's due (or was requested by the client)
+	if (chunk_max_latency_.count())
+		return (chunk_granularity_.load(std::memory_order_relaxed) && samp->pushthrough) ||
+			   chunk_due();
+	// the adaptive chunking sends partial chunks once the queue runs dry
+	if (adaptive_chunking_) return samp->pushthrough && chunk_samples_ >= adaptive_chunk_samples_;
+	return samp->pushthrough;
+}
+
+double client_session::chunk_wait_time() const {
+	if (!chunk_bytes()) return FOREVER;
+	// check right away if a partial chunk of the adaptive chunking should be sent
+	if (adaptive_chunking_) return 0.0;
+	if (!chunk_max_latency_.count()) return FOREVER;
+	return std::max(std::chrono::duration<double>(
+						chunk_deadline_ - std::chrono::steady_clock::now()).count(), 0.0);
+}
+
+void client_session::reserve_feed_buffers() {
+	const auto fmt = serv_->info_->channel_format();
+	const int granularity = chunk_granularity_.load(), chunk_size = serv_->chunk_size_.load();
+	const std::size_t chunk_samples = granularity ? granularity
+									  : chunk_size ? chunk_size
+									  : adaptive_chunking_ ? max_adaptive_chunk_samples
+														   : 1;
+	// sequence number, tag, time stamp and values (with a guess for the string lengths)
+	const std::size_t sample_bytes = sizeof(uint64_t) + 1 + sizeof(double) +
+									 wire_channels() * (fmt == cft_string ? 16 : format_sizes[fmt]);
+	std::size_t bytes = chunk_max_latency_.count() && chunk_max_bytes_
+							? chunk_max_bytes_
+							: chunk_samples * sample_bytes;
+	bytes = std::min(std::max(bytes, min_feed_reserve_bytes), max_feed_reserve_bytes);
+	// the async transfer only uses the feed buffer
+	for (feed_buffer *buf : {&feedbuf_, &backbuf_}) {
+		buf->prepare(bytes);
+		if (config_->async_transfer) break;
+	}
+	account_feed_buffers();
+	reserved_feed_bytes_ = accounted_feed_bytes_;
+}
+
+void client_session::account_feed_buffers() {
+	const uint64_t bytes = feedbuf_.capacity() + backbuf_.capacity();
+	if (bytes == accounted_feed_bytes_) return;
+	if (reserved_feed_bytes_ && bytes > reserved_feed_bytes_ && config_->no_allocation) {
+		report_allocation("feed buffer");
+		reserved_feed_bytes_ = bytes;
+	}
+	serv_->feed_buffer_bytes_.fetch_add(bytes - accounted_feed_bytes_, std::memory_order_relaxed);
+	accounted_feed_bytes_ = bytes;
+}
+
 void client_session::transfer_samples_thread(std::shared_ptr<client_session> /*keepalive*/) {
-	if (max_buffered_ <= 0) return;
+	const cpu_account::scope cpu_scope = serv_->cpu_->attach();
+	pin_to_numa_node(serv_->send_buffer_->numa_node());
+	// the feed buffer is sent first, the back buffer is filled in the meantime
+	sendbuf_ = &backbuf_;
+	sendpayloads_ = &backpayloads_;
+	const double park_after = config_->park_idle_seconds;
+	auto last_sample = std::chrono::steady_clock::now();
 	try {
-		// make a new consumer queue
-		auto queue = serv_->send_buffer_->new_consumer(max_buffered_);
-		// the sequence # is merely used to determine chunk boundaries (no need for int64)
-		uint32_t seqn = 0;
 		while (!serv_->shutdown_) {
 			try {
 				// get next sample from the sample queue (blocking)
-				sample_p samp(queue->pop_sample());
+				double wait_time = chunk_wait_time();
+				if (park_after > 0.0) wait_time = std::min(wait_time, park_after);
+				sample_p samp(queue_->pop_sample(wait_time));
 				if (serv_->shutdown_) break;
-				// ignore blank samples (they are basically wakeup notifiers from someone's
-				// end_serving())
-				if (!samp) continue;
-				// optionally override the pushthrough flag by the chunk size of the receiver (if
-				// set) or of the sender (if set)
-				if (chunk_granularity_)
-					samp->pushthrough = (((++seqn) % (uint32_t)chunk_granularity_) == 0);
-				else if (serv_->chunk_size_)
-					samp->pushthrough = (((++seqn) % (uint32_t)serv_->chunk_size_) == 0);
-				// serialize the sample into the stream
-				if (data_protocol_version_ >= 110)
-					samp->save_streambuf(
-						feedbuf_, data_protocol_version_, use_byte_order_, scratch_);
-				else
-					*outarch_ << *samp;
-				// if the sample shall be pushed though...
-				if (samp->pushthrough) {
-					// send off the chunk that we aggregated so far
-					std::unique_lock<std::mutex> lock(completion_mut_);
-					transfer_completed_ = false;
-					async_write(*sock_, feedbuf_.data(),
-						[shared_this = shared_from_this()](err_t err, size_t len) {
-							shared_this->handle_chunk_transfer_outcome(err, len);
-						});
-					// wait for the completion condition
-					completion_cond_.wait(lock, [this]() { return transfer_completed_; });
-					// handle transfer outcome
-					if (!transfer_error_) {
-						feedbuf_.consume(transfer_amount_);
-					} else
-						break;
+				const bool ran_dry = !samp;
+				if (!ran_dry)
+					last_sample = std::chrono::steady_clock::now();
+				else if (park_after > 0.0 && !chunk_bytes() &&
+						 std::chrono::duration<double>(
+							 std::chrono::steady_clock::now() - last_sample)
+								 .count() >= park_after) {
+					park_transfer();
+					return;
+				}
+				// blank samples (basically wakeups from someone's end_serving() or
+				// queue_control(), or the timeout of a time-limited or adaptive chunk) are ignored
+				// except for sending a pending chunk or control frame; otherwise, if the sample
+				// shall be pushed though...
+				if (samp ? serialize_sample(std::move(samp))
+						 : chunk_due() || flush_idle_chunk() || control_pending()) {
+					if (adaptive_chunking_ && !ran_dry) {
+						// while the previous chunk is still being sent, the adaptive chunk keeps
+						// collecting samples, so it grows to what the connection can take
+						{
+							std::lock_guard<std::mutex> lock(completion_mut_);
+							if (!transfer_completed_ && chunk_samples_ < max_adaptive_chunk_samples)
+								continue;
+						}
+						grow_chunk(chunk_samples_);
+					}
+					// a bulk session lets the others' transfer threads go first under contention
+					if (priority_ == prio_bulk) std::this_thread::yield();
+					// wait until the previous chunk has left the other buffer
+					if (!wait_for_transfer_completion()) break;
+					// send off the chunk that we aggregated so far, and continue serializing
+					// into the other buffer while the chunk is in flight
+					std::swap(fillbuf_, sendbuf_);
+					std::swap(fillpayloads_, sendpayloads_);
+					account_feed_buffers();
+					// the samples queue up in the meantime, so the overflow policy decides
+					// what's dropped if the limits can't keep up with the stream
+					for (double delay = shaping_delay(send_chunk_bytes());
+						 delay > 0.0 && !serv_->shutdown_; delay -= 0.1)
+						sleep_precise(std::min(delay, 0.1));
+					{
+						std::lock_guard<std::mutex> lock(completion_mut_);
+						transfer_completed_ = false;
+					}
+					write_chunk([shared_this = shared_from_this()](err_t err, size_t len) {
+						shared_this->handle_chunk_transfer_outcome(err, len);
+					});
 				}
 			} catch (std::exception &e) {
-				LOG_F(WARNING, "Unexpected glitch in transfer_samples_thread: %s", e.what());
+				ALOG_F(WARNING, "Unexpected glitch in transfer_samples_thread: %s", e.what());
+			}
+		}
+	} catch (std::exception &e) {
+		ALOG_F(ERROR, "Unexpected error in transfer_samples_thread: %s, exiting...", e.what());
+	}
+}
+
+void client_session::set_push_notification() {
+	// the queue notifies us (from the pushing thread) once new samples are available; the
+	// keepalive is moved into the handler so the session can't be destroyed in the pushing
+	// thread (which holds the send buffer's lock)
+	queue_->set_notification([this]() {
+		post(*io_, [keepalive = std::move(notify_keepalive_)]() {
+			keepalive->transfer_samples_async();
+		});
+	});
+}
+
+void client_session::park_transfer() {
+	// the IO thread only uses the feed buffer, so the chunk in flight has to be sent first
+	if (!wait_for_transfer_completion()) return;
+	fillbuf_ = sendbuf_ = &feedbuf_;
+	fillpayloads_ = sendpayloads_ = &feedpayloads_;
+	set_push_notification();
+	post(*io_, [shared_this = shared_from_this()]() { shared_this->transfer_samples_async(); });
+}
+
+void client_session::transfer_samples_async() {
+	try {
+		while (!serv_->shutdown_) {
+			sample_p samp(queue_->pop_sample(0.0));
+			const bool ran_dry = !samp;
+			if (ran_dry ? chunk_due() || flush_idle_chunk() || control_pending()
+						: serialize_sample(std::move(samp))) {
+				// send off the chunk (once the rate limits allow it) and continue once it has
+				// been sent; the samples queue up in the meantime
+				const double delay = shaping_delay(send_chunk_bytes());
+				if (delay <= 0.0) {
+					send_chunk_async();
+					return;
+				}
+				chunk_timer_.expires_after(
+					std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+						std::chrono::duration<double>(delay)));
+				chunk_timer_.async_wait([shared_this = shared_from_this()](err_t err) {
+					if (!err) shared_this->send_chunk_async();
+				});
+				return;
 			}
+			if (!ran_dry) continue;
+			if (chunk_max_latency_.count() && chunk_bytes()) {
+				// wait for the chunk's deadline instead of the next push, the samples pushed in
+				// the meantime are serialized then
+				chunk_timer_.expires_at(chunk_deadline_);
+				chunk_timer_.async_wait([shared_this = shared_from_this()](err_t err) {
+					if (!err) shared_this->transfer_samples_async();
+				});
+				return;
+			}
+			// the queue ran dry: wait for the next push without blocking the IO thread
+			notify_keepalive_ = shared_from_this();
+			if (queue_->arm_notification()) return;
+			notify_keepalive_.reset();
 		}
 	} catch (std::exception &e) {
-		LOG_F(ERROR, "Unexpected error in transfer_samples_thread: %s, exiting...", e.what());
+		ALOG_F(ERROR, "Unexpected error in transfer_samples_async: %s, exiting...", e.what());
+	}
+}
+
+void client_session::send_chunk_async() {
+	write_chunk([shared_this = shared_from_this()](err_t err, size_t len) {
+		if (err) return;
+		shared_this->serv_->count_chunk(len);
+		shared_this->controls_sent(shared_this->feedpayloads_.controls.size());
+		LSL_TRACE_ASYNC_END(
+			"write_chunk", shared_this->serv_->info_->uid(), shared_this->sent_seq_);
+		shared_this->feedbuf_.consume(shared_this->feedbuf_.size());
+		shared_this->feedpayloads_.clear();
+		// the samples that queued up while the chunk was being sent
+		if (shared_this->adaptive_chunking_)
+			shared_this->grow_chunk(shared_this->queue_->read_available());
+		// a bulk session continues behind the handlers that are already waiting, e.g. the other
+		// sessions' transfers
+		if (shared_this->priority_ == prio_bulk)
+			post(*shared_this->io_, [shared_this]() { shared_this->transfer_samples_async(); });
+		else
+			shared_this->transfer_samples_async();
+	});
+}
+
+double client_session::shaping_delay(std::size_t bytes) {
+	double delay = shaper_.take(bytes);
+	if (host_shaping_) delay = std::max(delay, host_shaper().take(bytes));
+	if (delay > 0.0)
+		serv_->throttled_ns_.fetch_add(
+			static_cast<uint64_t>(delay * 1e9), std::memory_order_relaxed);
+	return delay;
+}
+
+bool client_session::wait_for_transfer_completion() {
+	std::unique_lock<std::mutex> lock(completion_mut_);
+	completion_cond_.wait(lock, [this]() { return transfer_completed_; });
+	if (transfer_error_) return false;
+	// remove the sent data (if any) from the buffer so it can be refilled
+	if (transfer_amount_) {
+		sendbuf_->consume(sendbuf_->size());
+		sendpayloads_->clear();
+		transfer_amount_ = 0;
+	}
+	return true;
+}
+
+template <typename Handler> void client_session::write_chunk(Handler &&handler) {
+	sent_seq_ = chunk_seq_;
+	LSL_TRACE_ASYNC_BEGIN("write_chunk", serv_->info_->uid(), sent_seq_);
+	const std::size_t chunk_bytes = send_chunk_bytes();
+	auto &controls = sendpayloads_->controls;
+	if (control_pending()) {
+		std::lock_guard<std::mutex> lock(control_mut_);
+		controls.swap(controls_);
+		control_pending_.store(false, std::memory_order_relaxed);
+	}
+	frame_builder &frame = sendpayloads_->frame;
+	// a chunk without samples (sent for its control frames) has no sample frame
+	const bool sample_frame = framed_ && frame.size();
+	if (sample_frame)
+		frame.finish(chunk_bytes, use_byte_order_, timestamp_deltas_ ? &delta_state_ : nullptr,
+			changed_channels_);
+	if (sendpayloads_->samples.empty() && !framed_) {
+		async_write(*sock_, sendbuf_->data(), std::forward<Handler>(handler));
+		return;
 	}
+	// interleave the sample headers in the send buffer with the payloads (and put the frame's
+	// header and trailer around them)
+	const char *headers = static_cast<const char *>(sendbuf_->data().data());
+#ifdef LSL_KERNEL_ZEROCOPY
+	if (kernel_zerocopy_ && chunk_bytes >= config_->zerocopy_send_min_bytes && controls.empty()) {
+		auto chunk = std::make_shared<zerocopy_chunk>();
+		const std::size_t start = framed_ ? frame_header_bytes : 0;
+		if (framed_) chunk->headers.assign(frame.header(), frame.header() + frame_header_bytes);
+		chunk->headers.insert(chunk->headers.end(), headers, headers + sendbuf_->size());
+		if (framed_)
+			chunk->headers.insert(
+				chunk->headers.end(), frame.trailer().begin(), frame.trailer().end());
+		std::size_t offset = 0;
+		for (auto &payload : sendpayloads_->samples) {
+			const std::size_t end = start + payload.first;
+			if (end > offset)
+				chunk->gather.emplace_back(chunk->headers.data() + offset, end - offset);
+			chunk->gather.emplace_back(payload.second->raw_data(), payload.second->datasize());
+			chunk->samples.push_back(std::move(payload.second));
+			offset = end;
+		}
+		if (offset < chunk->headers.size())
+			chunk->gather.emplace_back(
+				chunk->headers.data() + offset, chunk->headers.size() - offset);
+		sendpayloads_->clear();
+		chunk->first_send = zerocopy_sends_;
+		{
+			std::lock_guard<std::mutex> lock(zerocopy_mut_);
+			zerocopy_pending_.push_back(chunk);
+		}
+		serv_->zerocopy_chunks_.fetch_add(1, std::memory_order_relaxed);
+		write_zerocopy(std::move(chunk), 0, std::forward<Handler>(handler));
+		return;
+	}
+#endif
+	auto &gather = sendpayloads_->gather;
+	gather.clear();
+	for (const auto &control : controls) gather.emplace_back(control->data(), control->size());
+	if (sample_frame) gather.emplace_back(frame.header(), frame_header_bytes);
+	std::size_t offset = 0;
+	for (const auto &payload : sendpayloads_->samples) {
+		if (payload.first > offset) gather.emplace_back(headers + offset, payload.first - offset);
+		gather.emplace_back(payload.second->raw_data(), payload.second->datasize());
+		offset = payload.first;
+	}
+	if (offset < sendbuf_->size()) gather.emplace_back(headers + offset, sendbuf_->size() - offset);
+	if (sample_frame && !frame.trailer().empty())
+		gather.emplace_back(frame.trailer().data(), frame.trailer().size());
+	async_write(*sock_, gather, std::forward<Handler>(handler));
+}
+
+#ifdef LSL_KERNEL_ZEROCOPY
+template <typename Handler>
+void client_session::write_zerocopy(
+	std::shared_ptr<zerocopy_chunk> chunk, std::size_t sent, Handler &&handler) {
+	// the handler keeps the session alive
+	sock_->async_send(chunk->gather, MSG_ZEROCOPY,
+		[this, chunk, sent, handler = std::forward<Handler>(handler)](
+			err_t err, std::size_t len) mutable {
+			if (err) {
+				handler(err, sent);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(zerocopy_mut_);
+				++zerocopy_sends_;
+				++chunk->sends;
+			}
+			// skip the buffers that were sent completely
+			auto &gather = chunk->gather;
+			std::size_t skip = len, done = 0;
+			while (done < gather.size() && skip >= gather[done].size())
+				skip -= gather[done++].size();
+			gather.erase(gather.begin(), gather.begin() + static_cast<std::ptrdiff_t>(done));
+			if (!gather.empty()) {
+				gather.front() += skip;
+				write_zerocopy(std::move(chunk), sent + len, std::move(handler));
+				return;
+			}
+			chunk->gather.shrink_to_fit();
+			{
+				std::lock_guard<std::mutex> lock(zerocopy_mut_);
+				chunk->sending = false;
+				reap_zerocopy_completions();
+			}
+			schedule_zerocopy_reap(0.001);
+			handler(err, sent + len);
+		});
+}
+
+void client_session::schedule_zerocopy_reap(double delay) {
+	zerocopy_timer_->expires_after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(delay)));
+	// the timer doesn't keep the session alive
+	zerocopy_timer_->async_wait(
+		[weak_this = std::weak_ptr<client_session>(shared_from_this()), delay](err_t err) {
+			const auto shared_this = weak_this.lock();
+			if (err || !shared_this) return;
+			bool pending;
+			{
+				std::lock_guard<std::mutex> lock(shared_this->zerocopy_mut_);
+				shared_this->reap_zerocopy_completions();
+				pending = !shared_this->zerocopy_pending_.empty();
+			}
+			if (pending) shared_this->schedule_zerocopy_reap(std::min(delay * 2, 0.1));
+		});
+}
+
+void client_session::reap_zerocopy_completions() {
+	const int fd = sock_->native_handle();
+	char control[128];
+	while (true) {
+		msghdr msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+		for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+				!(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+			sock_extended_err err;
+			memcpy(&err, CMSG_DATA(cm), sizeof(err));
+			if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+			// the send calls err.ee_info to err.ee_data have completed (possibly out of order, and
+			// the calls of the chunk that's still being sent possibly before they're counted)
+			for (auto &chunk : zerocopy_pending_) {
+				const uint32_t last = chunk->sending ? std::numeric_limits<uint32_t>::max()
+													 : chunk->first_send + chunk->sends - 1;
+				const uint32_t from = std::max(chunk->first_send, err.ee_info),
+							   to = std::min(last, err.ee_data);
+				if (from <= to) chunk->completed += to - from + 1;
+			}
+			// the kernel copied the data anyway (e.g. for loopback connections), so the
+			// notifications are pure overhead
+			if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) kernel_zerocopy_ = false;
+		}
+	}
+	while (!zerocopy_pending_.empty() && !zerocopy_pending_.front()->sending &&
+		   zerocopy_pending_.front()->completed == zerocopy_pending_.front()->sends) {
+		zerocopy_pending_.pop_front();
+		serv_->zerocopy_chunks_.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+#endif
+
+uint64_t client_session::queue_control(std::shared_ptr<const std::string> frame) {
+	uint64_t queued;
+	{
+		std::lock_guard<std::mutex> lock(control_mut_);
+		controls_.push_back(std::move(frame));
+		control_pending_.store(true, std::memory_order_release);
+		queued = ++controls_queued_;
+	}
+	// the transfer sends it with the next chunk, or right away if it's woken up idle; the wakeup
+	// isn't a sample, so the overflow policy doesn't drop or wait for anything because of it
+	queue_->wake();
+	return queued;
+}
+
+bool client_session::wait_controls_sent(uint64_t count, double timeout) {
+	std::unique_lock<std::mutex> lock(control_mut_);
+	return controls_sent_cond_.wait_for(lock, std::chrono::duration<double>(timeout),
+		[&]() { return controls_sent_ >= count; });
+}
+
+void client_session::controls_sent(std::size_t n) {
+	if (!n) return;
+	{
+		std::lock_guard<std::mutex> lock(control_mut_);
+		controls_sent_ += n;
+	}
+	controls_sent_cond_.notify_all();
+}
+
+void client_session::schedule_heartbeat() {
+	heartbeat_timer_.expires_after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(heartbeat_interval_)));
+	// the timer doesn't keep the session alive
+	heartbeat_timer_.async_wait(
+		[weak_this = std::weak_ptr<client_session>(shared_from_this())](err_t err) {
+			const auto shared_this = weak_this.lock();
+			if (err || !shared_this || shared_this->serv_->shutdown_) return;
+			static const auto heartbeat =
+				std::make_shared<const std::string>(control_frame(control_heartbeat, {}));
+			// a heartbeat that's still waiting (e.g. behind a stalled chunk) does the job
+			if (!shared_this->control_pending()) shared_this->queue_control(heartbeat);
+			shared_this->schedule_heartbeat();
+		});
 }
 
 void client_session::handle_chunk_transfer_outcome(err_t err, std::size_t len) {
 	try {
+		if (!err) {
+			serv_->count_chunk(len);
+			controls_sent(sendpayloads_->controls.size());
+		}
+		LSL_TRACE_ASYNC_END("write_chunk", serv_->info_->uid(), sent_seq_);
 		{
 			std::lock_guard<std::mutex> lock(completion_mut_);
 			// assign the transfer outcome
@@ -572,7 +2123,7 @@ void client_session::handle_chunk_transfer_outcome(err_t err, std::size_t len) {
 		// notify the server thread
 		completion_cond_.notify_all();
 	} catch (std::exception &e) {
-		LOG_F(WARNING,
+		ALOG_F(WARNING,
 			"Catastrophic error in handling the chunk transfer outcome (in tcp_server): %s",
 			e.what());
 	}
@@ -1,11 +1,18 @@
 #ifndef TCP_SERVER_H
 #define TCP_SERVER_H
 
+#include "cpu_account.h"
 #include "forward.h"
+#include "serialization_cache.h"
+#include "socket_utils.h"
+#include "stream_config.h"
+#include <atomic>
 #include <boost/asio/ip/tcp.hpp>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <string>
+#include <vector>
 
 using asio::ip::tcp;
 using lslboost::system::error_code;
@@ -26,9 +33,16 @@ using tcp_acceptor_p = std::shared_ptr<tcp::acceptor>;
  *  - `LSL:streamfeed`: A request to receive streaming data on the connection. The server responds
  * with the shortinfo, two samples filled with a test pattern, followed by samples until the server
  * outlet goes out of existence.
- *  - `LSL:fullinfo`: A request for the stream_info served by this server.
+ *  - `LSL:fullinfo`: A request for the stream_info served by this server. The method can be
+ * followed by the names of the <desc> children to send and by `@` and the metadata tag of the
+ * info the client already has (separated by spaces). With a tag, the reply starts with
+ * `LSL:infotag` and the current tag, and the info itself is only sent if the tag changed.
  *  - `LSL:shortinfo`: A request for the stream_info served by this server if matching the provided
  * query string. The short version of the stream_info (empty `<desc>` element) is returned.
+ *
+ * If api_config::shared_sockets() is set, the server doesn't open a port of its own. Instead,
+ * it registers at an acceptor that is shared by all servers of the process, which hands each
+ * connection to the server of the requested stream.
  */
 class tcp_server : public std::enable_shared_from_this<tcp_server> {
 public:
@@ -46,9 +60,13 @@ public:
 	 * @param protocol The protocol (IPv4 or IPv6) that shall be serviced by this server.
 	 * @param chunk_size The preferred chunk size, in samples. If 0, the pushthrough flag determines
 	 * the effective chunking.
+	 * @param config The settings of the stream for the client sessions.
 	 */
 	tcp_server(stream_info_impl_p info, io_context_p io, send_buffer_p sendbuf, factory_p factory,
-		tcp protocol, int chunk_size);
+		tcp protocol, int chunk_size, stream_config_p config);
+
+	/// Destructor. Releases the shared acceptor, if any.
+	~tcp_server();
 
 	/**
 	 * Begin serving TCP connections.
@@ -62,12 +80,83 @@ public:
 	 * Initiate teardown of IO processes.
 	 *
 	 * The actual teardown will be performed by the IO thread that runs the operations of
-	 * thisserver.
+	 * thisserver. The clients that negotiated it get an end-of-stream frame first (see
+	 * control_end_of_stream), which is waited for briefly.
 	 */
 	void end_serving();
 
+	/**
+	 * Set the options of the sockets of future client sessions (the defaults are taken from the
+	 * configuration file).
+	 */
+	void set_socket_options(const socket_options &opts) {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		socket_options_ = opts;
+	}
+
+	/// The options for a new client session's socket.
+	socket_options get_socket_options() {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		return socket_options_;
+	}
+
+	/// Serve the clients that connect from now on with other settings.
+	void set_config(stream_config_p config) {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		config_ = std::move(config);
+	}
+
+	/// The settings for a new client session.
+	stream_config_p get_config() {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		return config_;
+	}
+
+	/// Multicast the samples to the clients that ask for it from now on (nullptr to stop).
+	void set_multicast_sender(datagram_sender_p sender) {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		multicast_sender_ = std::move(sender);
+	}
+
+	/// The sender that multicasts the samples, if enabled.
+	datagram_sender_p get_multicast_sender() {
+		std::lock_guard<std::mutex> lock(options_mut_);
+		return multicast_sender_;
+	}
+
+	/// Change the preferred chunk size (0 for none), for the connected clients, too.
+	void set_chunk_size(int chunk_size) { chunk_size_ = chunk_size; }
+
+	/// The number of samples serialized for the connected clients so far.
+	uint64_t samples_sent() const { return samples_sent_.load(std::memory_order_relaxed); }
+	/// The number of chunks (i.e. socket writes) sent to the connected clients so far.
+	uint64_t chunks_sent() const { return chunks_sent_.load(std::memory_order_relaxed); }
+	/// The number of bytes of sample data sent to the connected clients so far.
+	uint64_t bytes_sent() const { return bytes_sent_.load(std::memory_order_relaxed); }
+	/// The time (in seconds, summed over the clients) chunks were held back by the rate limits.
+	double throttled_seconds() const {
+		return static_cast<double>(throttled_ns_.load(std::memory_order_relaxed)) * 1e-9;
+	}
+	/// The CPU time (in seconds) of the clients' transfer threads.
+	double cpu_seconds() const { return cpu_->seconds(); }
+	/// The memory of the connected clients' feed buffers, in bytes.
+	uint64_t feed_buffer_bytes() const {
+		return feed_buffer_bytes_.load(std::memory_order_relaxed);
+	}
+	/// The number of chunks sent with MSG_ZEROCOPY whose memory the kernel may still read.
+	uint64_t zerocopy_chunks() const { return zerocopy_chunks_.load(std::memory_order_relaxed); }
+
+	/**
+	 * Send a control frame with a metadata patch (see frame_control) to the connected clients
+	 * that negotiated them (`Metadata-Updates: 1`), after the chunk that is currently serialized
+	 * for them.
+	 * @return The number of clients the frame is sent to.
+	 */
+	std::size_t send_control(const std::shared_ptr<const std::string> &frame);
+
 private:
 	friend class client_session;
+	friend class shared_acceptor;
 	/// Start accepting a new connection.
 	void accept_next_connection();
 
@@ -84,8 +173,14 @@ private:
 	/// Post a close of all in-flight sockets.
 	void close_inflight_sockets();
 
+	/// Count a chunk of len bytes that has been sent to a client.
+	void count_chunk(std::size_t len) {
+		chunks_sent_.fetch_add(1, std::memory_order_relaxed);
+		bytes_sent_.fetch_add(len, std::memory_order_relaxed);
+	}
+
 	// data used by the transfer threads
-	int chunk_size_; // the chunk size to use (or 0)
+	std::atomic<int> chunk_size_; // the chunk size to use (or 0)
 	/// shutdown flag: tells the transfer thread that it should terminate itself asap
 	std::atomic<bool> shutdown_;
 
@@ -95,17 +190,40 @@ private:
 						// the acceptor needs to be destroyed
 	factory_p factory_; // reference to the sample factory (which owns the samples)
 	send_buffer_p send_buffer_; // the send buffer, shared with other TCP's and the outlet
+	/// samples serialized by one session, reused by the others with the same wire format
+	serialization_cache serialization_cache_;
+	/// transfer statistics of all sessions (only counted, so their order doesn't matter)
+	std::atomic<uint64_t> samples_sent_{0}, chunks_sent_{0}, bytes_sent_{0};
+	/// the feed buffers' memory, kept up to date by the sessions
+	std::atomic<uint64_t> feed_buffer_bytes_{0};
+	/// the sessions' chunks that wait for their MSG_ZEROCOPY completions
+	std::atomic<uint64_t> zerocopy_chunks_{0};
+	/// how long the sessions held back chunks to keep their rate limits, in nanoseconds
+	std::atomic<uint64_t> throttled_ns_{0};
+	/// the CPU time of the sessions' transfer threads
+	cpu_account_p cpu_{std::make_shared<cpu_account>()};
+	/// the options of new sessions: their sockets, the multicast sender (if enabled) and the
+	/// stream's settings, protected by options_mut_
+	socket_options socket_options_{socket_options::from_config()};
+	datagram_sender_p multicast_sender_;
+	stream_config_p config_;
+	std::mutex options_mut_;
 
 	// acceptor socket
 	tcp_acceptor_p acceptor_; // our server socket
+	/// the process-wide acceptor that hands us our connections (if the sockets are shared)
+	std::shared_ptr<class shared_acceptor> shared_;
+
+	/// the sessions that accept control frames, protected by control_mut_
+	std::vector<std::weak_ptr<class client_session>> control_sessions_;
+	std::mutex control_mut_;
+
+	/// The sessions that accept control frames and are still alive.
+	std::vector<std::shared_ptr<class client_session>> control_sessions();
 
 	// registry of in-flight client sockets (for cancellation)
 	std::set<tcp_socket_p> inflight_;		 // registry of currently in-flight sockets
 	std::recursive_mutex inflight_mut_;		 // mutex protecting the registry from concurrent access
-
-	// some cached data
-	std::string shortinfo_msg_; // pre-computed short-info server response
-	std::string fullinfo_msg_;	// pre-computed full-info server response
 };
 } // namespace lsl
 
@@ -0,0 +1,275 @@
+#include "thread_policy.h"
+#include "api_config.h"
+#include "lsl_c_api_helpers.hpp"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <loguru.hpp>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace lsl;
+
+namespace {
+
+/// The CPU affinity and priority of the threads with a role.
+struct thread_policy {
+	std::vector<uint32_t> cpus;
+	int32_t priority;
+};
+
+/// The policies of all roles, initialized from the config and updated by set_thread_policy().
+struct policy_table {
+	std::mutex mut;
+	std::vector<thread_policy> policies;
+	/// whether an error has been logged for a role
+	std::unique_ptr<std::atomic<bool>[]> warned;
+	/// the function that starts the threads (or nullptr) and its argument
+	lsl_thread_starter starter{nullptr};
+	void *starter_data{nullptr};
+
+	policy_table() {
+		const api_config *cfg = api_config::get_instance();
+		for (int role = 0; role < cfg->num_thread_roles(); ++role)
+			policies.push_back(thread_policy{cfg->thread_cpus(role), cfg->thread_priority(role)});
+		warned.reset(new std::atomic<bool>[policies.size()]);
+		for (std::size_t k = 0; k < policies.size(); ++k) warned[k] = false;
+	}
+
+	static policy_table &instance() {
+		static policy_table table;
+		return table;
+	}
+};
+
+/// whether the calling thread was started by the library and its role has CPUs configured
+thread_local bool library_thread = false, role_has_cpus = false;
+
+/// Apply a policy to the calling thread, return an error message or an empty string.
+std::string apply_policy(const thread_policy &policy) {
+#ifdef _WIN32
+	if (!policy.cpus.empty()) {
+		DWORD_PTR mask = 0;
+		for (uint32_t cpu : policy.cpus)
+			if (cpu < sizeof(mask) * 8) mask |= DWORD_PTR(1) << cpu;
+		if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask))
+			return "could not set the CPU affinity (error " + std::to_string(GetLastError()) + ")";
+	}
+	if (policy.priority > 0 &&
+		!SetThreadPriority(GetCurrentThread(), policy.priority > 50 ? THREAD_PRIORITY_TIME_CRITICAL
+																	: THREAD_PRIORITY_HIGHEST))
+		return "could not set the priority (error " + std::to_string(GetLastError()) + ")";
+#else
+#ifdef __linux__
+	if (!policy.cpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (uint32_t cpu : policy.cpus)
+			if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+			return std::string("could not set the CPU affinity: ") + std::strerror(err);
+	}
+#else
+	if (!policy.cpus.empty()) return "CPU affinities are not supported on this platform";
+#endif
+	if (policy.priority > 0) {
+		sched_param param{};
+		param.sched_priority = policy.priority;
+		if (int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+			return std::string("could not set the real-time priority: ") + std::strerror(err);
+	}
+#endif
+	return std::string();
+}
+
+} // namespace
+
+/// The state of a thread run by the thread starter.
+struct managed_thread::task {
+	std::function<void()> body;
+	std::mutex mut;
+	std::condition_variable done_cv;
+	bool done{false};
+	std::thread::id id;
+
+	/// The thread body passed to the thread starter, with a pointer to a std::shared_ptr<task>.
+	static void run(void *arg) {
+		const std::shared_ptr<task> self(std::move(*static_cast<std::shared_ptr<task> *>(arg)));
+		delete static_cast<std::shared_ptr<task> *>(arg);
+		{
+			std::lock_guard<std::mutex> lock(self->mut);
+			self->id = std::this_thread::get_id();
+		}
+		// exceptions mustn't propagate into the application's thread pool
+		try {
+			self->body();
+		} catch (std::exception &e) {
+			LOG_F(ERROR, "Unhandled exception in a liblsl thread: %s", e.what());
+		} catch (...) { LOG_F(ERROR, "Unhandled exception in a liblsl thread."); }
+		// release the objects bound to the body (e.g. the session of a transfer thread) now
+		self->body = nullptr;
+		std::lock_guard<std::mutex> lock(self->mut);
+		self->done = true;
+		self->done_cv.notify_all();
+	}
+};
+
+managed_thread &managed_thread::operator=(managed_thread &&other) noexcept {
+	if (joinable()) std::terminate();
+	thread_ = std::move(other.thread_);
+	task_ = std::move(other.task_);
+	return *this;
+}
+
+managed_thread::~managed_thread() {
+	if (task_) std::terminate();
+}
+
+std::thread::id managed_thread::get_id() const noexcept {
+	if (!task_) return thread_.get_id();
+	std::lock_guard<std::mutex> lock(task_->mut);
+	return task_->id;
+}
+
+void managed_thread::join() {
+	if (thread_.joinable()) return thread_.join();
+	if (!task_) throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+	if (get_id() == std::this_thread::get_id())
+		throw std::system_error(std::make_error_code(std::errc::resource_deadlock_would_occur));
+	std::unique_lock<std::mutex> lock(task_->mut);
+	task_->done_cv.wait(lock, [this]() { return task_->done; });
+	lock.unlock();
+	task_.reset();
+}
+
+void managed_thread::detach() {
+	if (thread_.joinable()) return thread_.detach();
+	if (!task_) throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+	task_.reset();
+}
+
+void managed_thread::start(
+	lsl_thread_role_t role, const std::string &name, std::function<void()> body) {
+	lsl_thread_starter starter;
+	void *starter_data;
+	{
+		policy_table &table = policy_table::instance();
+		std::lock_guard<std::mutex> lock(table.mut);
+		starter = table.starter;
+		starter_data = table.starter_data;
+	}
+	if (starter) {
+		auto state = std::make_shared<task>();
+		state->body = std::move(body);
+		auto *arg = new std::shared_ptr<task>(state);
+		if (starter(role, name.c_str(), &task::run, arg, starter_data) == 0) {
+			task_ = std::move(state);
+			return;
+		}
+		delete arg;
+		body = std::move(state->body);
+	}
+	thread_ = std::thread([role, name, body]() {
+		init_thread(role, name);
+		body();
+	});
+}
+
+void lsl::init_thread(lsl_thread_role_t role, const std::string &name) {
+	loguru::set_thread_name(name.c_str());
+	policy_table &table = policy_table::instance();
+	thread_policy policy;
+	{
+		std::lock_guard<std::mutex> lock(table.mut);
+		policy = table.policies.at(role);
+	}
+	library_thread = true;
+	role_has_cpus = !policy.cpus.empty();
+	if (policy.cpus.empty() && !policy.priority) return;
+	const std::string error = apply_policy(policy);
+	if (!error.empty() && !table.warned[role].exchange(true))
+		LOG_F(WARNING, "Thread %s: %s", name.c_str(), error.c_str());
+}
+
+void lsl::pin_to_numa_node(int node) {
+	if (node < 0 || !library_thread || role_has_cpus) return;
+	std::string error;
+#ifdef _WIN32
+	GROUP_AFFINITY affinity;
+	if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) ||
+		!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+		error = "error " + std::to_string(GetLastError());
+#else
+	// e.g. "0-7,16-23"
+	std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	thread_policy policy{{}, 0};
+	for (std::string range; std::getline(cpulist, range, ',');) {
+		const auto dash = range.find('-');
+		try {
+			const auto first = std::stoul(range.substr(0, dash));
+			const auto last =
+				dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+			for (auto cpu = first; cpu <= last; ++cpu) policy.cpus.push_back(uint32_t(cpu));
+		} catch (std::exception &) { break; }
+	}
+	error = policy.cpus.empty() ? "the node's CPUs are unknown" : apply_policy(policy);
+#endif
+	if (error.empty()) return;
+	static std::once_flag warned;
+	std::call_once(warned, [node, &error]() {
+		LOG_F(WARNING, "Could not pin a thread to NUMA node %d: %s", node, error.c_str());
+	});
+}
+
+void lsl::set_thread_policy(lsl_thread_role_t role, std::vector<uint32_t> cpus, int32_t priority) {
+	policy_table &table = policy_table::instance();
+	if (role < 0 || static_cast<std::size_t>(role) >= table.policies.size())
+		throw std::invalid_argument("Invalid thread role.");
+	if (priority < 0 || priority > 99)
+		throw std::invalid_argument("The thread priority has to be between 0 and 99.");
+	std::lock_guard<std::mutex> lock(table.mut);
+	table.policies[role] = thread_policy{std::move(cpus), priority};
+	table.warned[role] = false;
+}
+
+void lsl::set_thread_starter(lsl_thread_starter starter, void *user_data) {
+	policy_table &table = policy_table::instance();
+	std::lock_guard<std::mutex> lock(table.mut);
+	table.starter = starter;
+	table.starter_data = starter ? user_data : nullptr;
+}
+
+extern "C" {
+
+LIBLSL_C_API int32_t lsl_set_thread_policy(
+	lsl_thread_role_t role, const uint32_t *cpus, uint32_t num_cpus, int32_t priority) {
+	if (num_cpus && !cpus) return lsl_argument_error;
+	try {
+		set_thread_policy(role, std::vector<uint32_t>(cpus, cpus + num_cpus), priority);
+		return lsl_no_error;
+	}
+	LSLCATCHANDRETURN(std::invalid_argument, lsl_argument_error)
+	LSLCATCHANDRETURN(std::exception, lsl_internal_error)
+}
+
+LIBLSL_C_API int32_t lsl_set_thread_starter(lsl_thread_starter starter, void *user_data) {
+	try {
+		set_thread_starter(starter, user_data);
+		return lsl_no_error;
+	}
+	LSLCATCHANDRETURN(std::exception, lsl_internal_error)
+}
+}
@@ -0,0 +1,80 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include "common.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * Set the name of the calling liblsl thread (for the log and traces) and apply the CPU affinity
+ * and priority of its role (see lsl_set_thread_policy()).
+ *
+ * Called at the start of each thread the library starts. Errors are logged once per role.
+ */
+void init_thread(lsl_thread_role_t role, const std::string &name);
+
+/**
+ * Set the policy of a role for the threads started afterwards.
+ * @throws std::invalid_argument for an invalid role or priority.
+ */
+void set_thread_policy(lsl_thread_role_t role, std::vector<uint32_t> cpus, int32_t priority);
+
+/**
+ * Restrict the calling liblsl thread to the CPUs of a NUMA node (see api_config::numa_aware()).
+ *
+ * Does nothing for node -1, for threads started by the application's thread starter and for
+ * threads whose role has CPUs configured.
+ */
+void pin_to_numa_node(int node);
+
+/// Set the function that starts the library's threads (see lsl_set_thread_starter()).
+void set_thread_starter(lsl_thread_starter starter, void *user_data);
+
+/**
+ * A thread of the library, with the interface of std::thread.
+ *
+ * It's started by the thread starter set by the application if there's one and it accepts the
+ * thread, otherwise it's a std::thread that calls init_thread() before the thread function.
+ */
+class managed_thread {
+public:
+	managed_thread() = default;
+
+	/// Start a thread that calls f(args...).
+	template <typename F, typename... Args>
+	managed_thread(lsl_thread_role_t role, const std::string &name, F &&f, Args &&...args) {
+		start(role, name, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+	}
+
+	managed_thread(managed_thread &&other) noexcept = default;
+	managed_thread &operator=(managed_thread &&other) noexcept;
+	/// Calls std::terminate() if the thread is still joinable, like std::thread.
+	~managed_thread();
+
+	bool joinable() const noexcept { return thread_.joinable() || task_; }
+	/// The id of the thread, or a default constructed id if a thread starter hasn't run it yet.
+	std::thread::id get_id() const noexcept;
+	void join();
+	void detach();
+
+private:
+	struct task;
+
+	void start(lsl_thread_role_t role, const std::string &name, std::function<void()> body);
+
+	/// the thread if it was started by the library
+	std::thread thread_;
+	/// the state of the thread if it was started by the thread starter
+	std::shared_ptr<task> task_;
+};
+
+} // namespace lsl
+
+#endif
@@ -14,26 +14,39 @@
 using namespace lsl;
 
 /// how many samples have to be seen between clocksyncs?
-const uint8_t samples_between_clocksyncs = 50;
+const uint32_t samples_between_clocksyncs = 50;
 
-time_postprocessor::time_postprocessor(postproc_callback_t query_correction,
+time_postprocessor::time_postprocessor(model_callback_t query_correction,
 	postproc_callback_t query_srate, reset_callback_t query_reset)
 	: samples_since_last_clocksync(samples_between_clocksyncs),
 	  query_srate_(std::move(query_srate)), options_(proc_none),
 	  halftime_(api_config::get_instance()->smoothing_halftime()),
 	  query_correction_(std::move(query_correction)), query_reset_(std::move(query_reset)),
-	  next_query_time_(0.0), last_offset_(0.0), last_value_(std::numeric_limits<double>::lowest()) {
-}
+	  next_query_time_(0.0), last_value_(std::numeric_limits<double>::lowest()) {}
+
+time_postprocessor::time_postprocessor(postproc_callback_t query_correction,
+	postproc_callback_t query_srate, reset_callback_t query_reset)
+	: time_postprocessor(
+		  [query_correction = std::move(query_correction)]() {
+			  clock_model model;
+			  model.offset = query_correction();
+			  return model;
+		  },
+		  std::move(query_srate), std::move(query_reset)) {}
 
 void time_postprocessor::set_options(uint32_t options)
 {
+	// the receive thread may be processing time stamps right now
+	std::unique_lock<named_mutex> lock(processing_mut_, std::defer_lock);
+	if ((options_ | options) & proc_receive_thread) lock.lock();
+
 	// bitmask which options actually changed (XOR)
 	auto changed = options_ ^ options;
 
 	// dejitter option changed? -> Reset it
 	// in case it got enabled, it'll be initialized with the correct t0 when
-	// the next sample comes in
-	if(changed & proc_dejitter)
+	// the next sample comes in (the same if the samples are counted on another thread)
+	if(changed & (proc_dejitter | proc_receive_thread))
 		dejitter = postproc_dejitterer();
 
 	if(changed & proc_monotonize)
@@ -43,45 +56,83 @@ void time_postprocessor::set_options(uint32_t options)
 }
 
 double time_postprocessor::process_timestamp(double value) {
+	if (options_ & proc_receive_thread) return value;
 	if (options_ & proc_threadsafe) {
-		std::lock_guard<std::mutex> lock(processing_mut_);
+		std::lock_guard<named_mutex> lock(processing_mut_);
 		return process_internal(value);
 	} else
 		return process_internal(value);
 }
 
+void time_postprocessor::process_timestamps(double *values, std::size_t n) {
+	if (options_ == proc_none || options_ & proc_receive_thread || n == 0) return;
+	std::unique_lock<named_mutex> lock(processing_mut_, std::defer_lock);
+	if (options_ & proc_threadsafe) lock.lock();
+	process_chunk(values, n);
+}
+
+void time_postprocessor::process_received(double *values, std::size_t n) {
+	// the receive thread processes the samples concurrently to the pull calls' set_options()
+	std::lock_guard<named_mutex> lock(processing_mut_);
+	if (options_ & proc_receive_thread && n) process_chunk(values, n);
+}
+
+void time_postprocessor::process_chunk(double *values, std::size_t n) {
+	// each stage only depends on its own state, so the chunk is processed one stage at a time
+	if (options_ & proc_clocksync) {
+		// the clock model is queried at most once per chunk and evaluated for each time stamp
+		update_clock_offset(static_cast<uint32_t>(n));
+		const clock_model model = last_model_;
+		for (std::size_t k = 0; k < n; ++k) values[k] += model.at(values[k]);
+	}
+
+	if (options_ & proc_dejitter) {
+		skip_gaps();
+		if (!dejitter.is_initialized())
+			dejitter = postproc_dejitterer(values[0], query_srate_(), halftime_);
+		dejitter.dejitter(values, n);
+	}
+
+	if (options_ & proc_monotonize) {
+		double last = last_value_;
+		for (std::size_t k = 0; k < n; ++k)
+			if (values[k] < last)
+				values[k] = last;
+			else
+				last = values[k];
+		last_value_ = last;
+	}
+}
+
 void time_postprocessor::skip_samples(uint32_t skipped_samples) {
+	// the receive thread has accounted for all samples already
+	if (options_ & proc_receive_thread) return;
 	if (options_ & proc_dejitter && dejitter.smoothing_applicable())
 		dejitter.samples_since_t0_ += skipped_samples;
 }
 
+void time_postprocessor::skip_gaps() {
+	if (!query_gaps_) return;
+	// gaps before the first sample don't matter, the dejitterer starts counting with it
+	const uint64_t gaps = query_gaps_();
+	if (gaps > gaps_seen_ && dejitter.smoothing_applicable())
+		dejitter.samples_since_t0_ += static_cast<uint_fast32_t>(gaps - gaps_seen_);
+	gaps_seen_ = gaps;
+}
+
 double time_postprocessor::process_internal(double value) {
 	// --- clock synchronization ---
 	if (options_ & proc_clocksync) {
-		// update last correction value if needed (we do this every 50 samples and at most twice per
-		// second)
-		if (++samples_since_last_clocksync > samples_between_clocksyncs &&
-			lsl_clock() > next_query_time_) {
-			last_offset_ = query_correction_();
-			samples_since_last_clocksync = 0;
-			if (query_reset_()) {
-				// reset state to unitialized
-				last_offset_ = query_correction_();
-				last_value_ = std::numeric_limits<double>::lowest();
-				// reset the dejitterer to an uninitialized state so it's
-				// initialized on the next use
-				dejitter = postproc_dejitterer();
-			}
-			next_query_time_ = lsl_clock() + 0.5;
-		}
-		// perform clock synchronization; this is done by adding the last-measured clock offset
-		// value (typically this is used to map the value from the sender's clock to our local
+		update_clock_offset(1);
+		// perform clock synchronization; this is done by adding the clock offset at the time
+		// stamp (typically this is used to map the value from the sender's clock to our local
 		// clock)
-		value += last_offset_;
+		value += last_model_.at(value);
 	}
 
 	// --- jitter removal ---
 	if (options_ & proc_dejitter) {
+		skip_gaps();
 		// initialize the smoothing state if not yet done so
 		if (!dejitter.is_initialized()) {
 			double srate = query_srate_();
@@ -100,6 +151,26 @@ double time_postprocessor::process_internal(double value) {
 	return value;
 }
 
+void time_postprocessor::update_clock_offset(uint32_t n) {
+	// update last correction value if needed (we do this every 50 samples and at most twice per
+	// second)
+	samples_since_last_clocksync += n;
+	if (samples_since_last_clocksync > samples_between_clocksyncs &&
+		lsl_clock() > next_query_time_) {
+		last_model_ = query_correction_();
+		samples_since_last_clocksync = 0;
+		if (query_reset_()) {
+			// reset state to unitialized
+			last_model_ = query_correction_();
+			last_value_ = std::numeric_limits<double>::lowest();
+			// reset the dejitterer to an uninitialized state so it's
+			// initialized on the next use
+			dejitter = postproc_dejitterer();
+		}
+		next_query_time_ = lsl_clock() + 0.5;
+	}
+}
+
 postproc_dejitterer::postproc_dejitterer(double t0, double srate, double halftime)
 	: t0_(static_cast<uint_fast32_t>(t0)) {
 	if (srate > 0) {
@@ -129,6 +200,32 @@ double postproc_dejitterer::dejitter(double t) noexcept {
 	return w0_ + u1 * w1_ + t0_;			 // t = float(w.T * u) + t0
 }
 
+void postproc_dejitterer::dejitter(double *ts, std::size_t n) noexcept {
+	if (!smoothing_applicable()) return;
+	// work on local copies so the state stays in registers for the whole chunk
+	double w0 = w0_, w1 = w1_, P00 = P00_, P01 = P01_, P11 = P11_;
+	const double lam = lam_, il = 1 / lam_, t0 = static_cast<double>(t0_);
+	uint_fast32_t samples_since_t0 = samples_since_t0_;
+	for (std::size_t k = 0; k < n; ++k) {
+		// same RLS update as in dejitter(double)
+		const double t = ts[k] - t0, u1 = static_cast<double>(samples_since_t0++),
+					 pi0 = P00 + u1 * P01, pi1 = P01 + u1 * P11, al = t - (w0 + u1 * w1),
+					 g_inv = 1 / (lam + pi0 + pi1 * u1);
+		P00 = il * (P00 - pi0 * pi0 * g_inv);
+		P01 = il * (P01 - pi0 * pi1 * g_inv);
+		P11 = il * (P11 - pi1 * pi1 * g_inv);
+		w0 += al * (P00 + P01 * u1);
+		w1 += al * (P01 + P11 * u1);
+		ts[k] = w0 + u1 * w1 + t0;
+	}
+	w0_ = w0;
+	w1_ = w1;
+	P00_ = P00;
+	P01_ = P01;
+	P11_ = P11;
+	samples_since_t0_ = samples_since_t0;
+}
+
 void postproc_dejitterer::skip_samples(uint_fast32_t skipped_samples) noexcept {
 	samples_since_t0_ += skipped_samples;
 }
@@ -1,7 +1,10 @@
 #ifndef TIME_POSTPROCESSOR_H
 #define TIME_POSTPROCESSOR_H
 
+#include "clock_model.h"
 #include "common.h"
+#include "lock_stats.h"
+#include <atomic>
 #include <functional>
 #include <mutex>
 
@@ -10,6 +13,10 @@ namespace lsl {
 /// A callback function that allows the post-processor to query state from other objects if needed
 using postproc_callback_t = std::function<double()>;
 using reset_callback_t = std::function<bool()>;
+/// A callback function that returns the current model of the time correction
+using model_callback_t = std::function<clock_model()>;
+/// A callback function that returns the number of samples missed so far
+using gap_callback_t = std::function<uint64_t()>;
 
 /// Dejitter / smooth timestamps with a first order recursive least squares filter (RLS).
 struct postproc_dejitterer {
@@ -30,6 +37,9 @@ struct postproc_dejitterer {
 	/// dejitter a timestamp and update RLS parameters
 	double dejitter(double t) noexcept;
 
+	/// dejitter n timestamps in place, keeping the RLS state in registers for the whole chunk
+	void dejitter(double *ts, std::size_t n) noexcept;
+
 	/// adjust RLS parameters to account for samples not seen
 	void skip_samples(uint_fast32_t skipped_samples) noexcept;
 	bool is_initialized() const noexcept { return t0_ != 0; }
@@ -40,6 +50,10 @@ struct postproc_dejitterer {
 class time_postprocessor {
 public:
 	/// Construct a new time post-processor given some callback functions.
+	time_postprocessor(model_callback_t query_correction, postproc_callback_t query_srate,
+		reset_callback_t query_reset);
+
+	/// Construct a new time post-processor with a callback for a constant time-correction offset.
 	time_postprocessor(postproc_callback_t query_correction, postproc_callback_t query_srate,
 		reset_callback_t query_reset);
 
@@ -58,45 +72,73 @@ public:
 	/// Post-process the given time stamp and return the new time-stamp.
 	double process_timestamp(double value);
 
+	/// Post-process n time stamps in place, taking the lock (if any) only once.
+	void process_timestamps(double *values, std::size_t n);
+
+	/**
+	 * Post-process the time stamps of n received samples in place if they're processed on the
+	 * receive thread (proc_receive_thread); process_timestamp(s)() then leave them as they are.
+	 */
+	void process_received(double *values, std::size_t n);
+
 	/// Override the half-time (forget factor) of the time-stamp smoothing.
 	void smoothing_halftime(float value) { halftime_ = value; }
 
 	/// Inform the post processor some samples were skipped
 	void skip_samples(uint32_t skipped_samples);
 
+	/**
+	 * Set a function that returns how many samples were missed so far (e.g. dropped on overflow
+	 * or lost in transit), so the dejittering skips them before processing the next samples.
+	 */
+	void set_gap_source(gap_callback_t query_gaps) { query_gaps_ = std::move(query_gaps); }
+
 private:
 	/// Internal function to process a time stamp.
 	double process_internal(double value);
 
+	/// Internal function to process n time stamps in place.
+	void process_chunk(double *values, std::size_t n);
+
+	/// Account for n new samples and query a new clock offset if due.
+	void update_clock_offset(uint32_t n);
+
+	/// Skip the samples that were missed since the last call in the dejittering.
+	void skip_gaps();
+
 	/// number of samples seen since last clocksync
-	uint8_t samples_since_last_clocksync;
+	uint32_t samples_since_last_clocksync;
 
 	// configuration parameters
 	/// a callback function that returns the current nominal sampling rate
 	postproc_callback_t query_srate_;
 	/// current processing options
-	uint32_t options_;
+	std::atomic<uint32_t> options_;
 	/// smoothing half-time
 	float halftime_;
 
 	// handling of time corrections
-	/// a callback function that returns the current time-correction offset
-	postproc_callback_t query_correction_;
+	/// a callback function that returns the current time-correction model
+	model_callback_t query_correction_;
 	/// a callback function that returns whether the clock was reset
 	reset_callback_t query_reset_;
 	/// the next time when we query the time-correction offset
 	double next_query_time_;
-	/// last queried correction offset
-	double last_offset_;
+	/// last queried time-correction model, evaluated for each time stamp
+	clock_model last_model_;
 
 	postproc_dejitterer dejitter;
+	/// a callback function that returns the number of missed samples (if set)
+	gap_callback_t query_gaps_;
+	/// the missed samples already skipped by the dejittering
+	uint64_t gaps_seen_{0};
 
 	// runtime parameters for monotonize
 	/// last observed time-stamp value, to force monotonically increasing stamps
 	double last_value_;
 
 	/// a mutex that protects the runtime data structures
-	std::mutex processing_mut_;
+	named_mutex processing_mut_{"time_postprocessor"};
 };
 
 
@@ -1,9 +1,18 @@
 #include "time_receiver.h"
 #include "api_config.h"
 #include "inlet_connection.h"
+#include "io_context_pool.h"
 #include "socket_utils.h"
+#include "thread_policy.h"
+#include <algorithm>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <cmath>
 #include <limits>
 #include <loguru.hpp>
+#include <map>
 #include <sstream>
 
 /// internally used constant to represent an unassigned time offset
@@ -11,23 +20,78 @@ const double NOT_ASSIGNED = std::numeric_limits<double>::max();
 
 using namespace lsl;
 
+/// a probe whose offset is further than this (in seconds) off the clock model resets the model
+const double max_model_deviation = 1.0;
+
+/**
+ * The time receivers of inlets whose outlets are on the same host.
+ *
+ * The members are protected by the mutex; the leader takes the mutex of each member while it
+ * publishes an estimate, so a member that left the group gets none.
+ */
+struct lsl::time_sync_group {
+	explicit time_sync_group(double drift_halftime) : drift(drift_halftime) {}
+
+	/// Get the group for a host, creating it if it's not in use.
+	static std::shared_ptr<time_sync_group> get(const std::string &key, double drift_halftime) {
+		static std::mutex registry_mut;
+		static std::map<std::string, std::weak_ptr<time_sync_group>> registry;
+		std::lock_guard<std::mutex> lock(registry_mut);
+		for (auto it = registry.begin(); it != registry.end();)
+			it = it->second.expired() ? registry.erase(it) : std::next(it);
+		auto &entry = registry[key];
+		auto result = entry.lock();
+		if (!result) entry = result = std::make_shared<time_sync_group>(drift_halftime);
+		return result;
+	}
+
+	std::mutex mut;
+	std::vector<time_receiver *> members;
+	/// the member that sends the time probes (nullptr if none does at the moment)
+	time_receiver *leader{nullptr};
+	/// the clock model, which outlives the leaders
+	clock_drift_estimator drift;
+	/// the latest estimate, for members that join
+	double offset{NOT_ASSIGNED}, remote_time{NOT_ASSIGNED}, uncertainty{NOT_ASSIGNED};
+};
+
 time_receiver::time_receiver(inlet_connection &conn)
-	: conn_(conn), was_reset_(false), timeoffset_(std::numeric_limits<double>::max()),
-	  remote_time_(std::numeric_limits<double>::max()),
-	  uncertainty_(std::numeric_limits<double>::max()), cfg_(api_config::get_instance()),
-	  time_sock_(time_io_), next_estimate_(time_io_), aggregate_results_(time_io_),
-	  next_packet_(time_io_) {
+	: conn_(conn), was_reset_(false), timeoffset_(NOT_ASSIGNED), remote_time_(NOT_ASSIGNED),
+	  uncertainty_(NOT_ASSIGNED), model_offset_(NOT_ASSIGNED), model_drift_(0.0), model_t0_(0.0),
+	  cfg_(api_config::get_instance()),
+	  io_pool_(io_context_pool::inlet_pool()),
+	  time_io_(io_pool_ ? io_pool_->next() : std::make_shared<asio::io_context>()),
+	  time_sock_(*time_io_), tcp_(cfg_->tcp_time_sync()), tcp_sock_(*time_io_),
+	  next_estimate_(*time_io_), aggregate_results_(*time_io_), next_packet_(*time_io_) {
 	conn_.register_onlost(this, &timeoffset_upd_);
 	conn_.register_onrecover(this, [this]() { reset_timeoffset_on_recovery(); });
-	time_sock_.open(conn_.udp_protocol());
+	if (!tcp_) {
+		time_sock_.open(conn_.udp_protocol());
+		kernel_timestamps_ = cfg_->kernel_timestamps() && enable_receive_timestamps(time_sock_);
+	}
 }
 
 time_receiver::~time_receiver() {
 	try {
 		conn_.unregister_onrecover(this);
 		conn_.unregister_onlost(this);
-		time_io_.stop();
-		if (time_thread_.joinable()) time_thread_.join();
+		leave_time_sync();
+		if (io_pool_) {
+			// cancel our operations in the shared io_context and wait until their handlers ran
+			if (!io_context_pool::drain(*time_io_, 5.0, [this]() {
+					error_code ec;
+					next_estimate_.cancel();
+					aggregate_results_.cancel();
+					next_packet_.cancel();
+					time_sock_.close(ec);
+					tcp_sock_.close(ec);
+				}))
+				LOG_F(ERROR, "Timed out waiting for the time receiver's operations to cancel");
+			if (pool_started_) conn_.release_watchdog();
+		} else {
+			time_io_->stop();
+			if (time_thread_.joinable()) time_thread_.join();
+		}
 	} catch (std::exception &e) {
 		LOG_F(ERROR, "Unexpected error during destruction of a time_receiver: %s", e.what());
 	} catch (...) { LOG_F(ERROR, "Severe error during time receiver shutdown."); }
@@ -42,13 +106,14 @@ double time_receiver::time_correction(double timeout) {
 }
 
 double time_receiver::time_correction(double *remote_time, double *uncertainty, double timeout) {
-	std::unique_lock<std::mutex> lock(timeoffset_mut_);
-	auto timeoffset_available = [this]() {
-		return (timeoffset_ != std::numeric_limits<double>::max()) || conn_.lost();
-	};
-	if (!timeoffset_available()) {
-		// start thread if not yet running
-		if (!time_thread_.joinable()) time_thread_ = std::thread(&time_receiver::time_thread, this);
+	double offset;
+	// once there's an estimate, this doesn't take the lock
+	if (!latest_time_correction(offset, remote_time, uncertainty)) {
+		std::unique_lock<std::mutex> lock(timeoffset_mut_);
+		auto timeoffset_available = [&]() {
+			return read_estimate(offset, *remote_time, *uncertainty) || conn_.lost();
+		};
+		ensure_started();
 		// wait until the timeoffset becomes available (or we time out)
 		if (timeout >= FOREVER)
 			timeoffset_upd_.wait(lock, timeoffset_available);
@@ -59,23 +124,110 @@ double time_receiver::time_correction(double *remote_time, double *uncertainty,
 	if (conn_.lost())
 		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
 						 "re-resolve the source and re-create the inlet.");
-	*remote_time = remote_time_;
-	*uncertainty = uncertainty_;
-	return timeoffset_;
+	return offset;
+}
+
+bool time_receiver::latest_time_correction(
+	double &offset, double *remote_time, double *uncertainty) {
+	if (conn_.lost())
+		throw lost_error("The stream read by this inlet has been lost. To recover, you need to "
+						 "re-resolve the source and re-create the inlet.");
+	double remote, rtt;
+	if (read_estimate(offset, remote, rtt)) {
+		if (remote_time) *remote_time = remote;
+		if (uncertainty) *uncertainty = rtt;
+		return true;
+	}
+	// start the estimation unless someone else is busy with it
+	std::unique_lock<std::mutex> lock(timeoffset_mut_, std::try_to_lock);
+	if (lock) ensure_started();
+	return false;
+}
+
+clock_model time_receiver::time_correction_model(double timeout) {
+	clock_model result;
+	result.offset = time_correction(timeout);
+	while (true) {
+		const uint32_t seq = estimate_seq_.load(std::memory_order_acquire);
+		if (seq & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		const double offset = model_offset_.load(std::memory_order_relaxed);
+		const double drift = model_drift_.load(std::memory_order_relaxed);
+		const double t0 = model_t0_.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (estimate_seq_.load(std::memory_order_relaxed) != seq) continue;
+		if (offset != NOT_ASSIGNED) {
+			result.offset = offset;
+			result.drift = drift;
+			result.t0 = t0;
+		}
+		return result;
+	}
+}
+
+bool time_receiver::was_reset() { return was_reset_.exchange(false); }
+
+void time_receiver::publish_estimate(double offset, double remote_time, double uncertainty) {
+	const uint32_t seq = estimate_seq_.load(std::memory_order_relaxed);
+	estimate_seq_.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	timeoffset_.store(offset, std::memory_order_relaxed);
+	remote_time_.store(remote_time, std::memory_order_relaxed);
+	uncertainty_.store(uncertainty, std::memory_order_relaxed);
+	estimate_seq_.store(seq + 2, std::memory_order_release);
+}
+
+void time_receiver::publish_model(const clock_model &model) {
+	const uint32_t seq = estimate_seq_.load(std::memory_order_relaxed);
+	estimate_seq_.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	model_offset_.store(model.offset, std::memory_order_relaxed);
+	model_drift_.store(model.drift, std::memory_order_relaxed);
+	model_t0_.store(model.t0, std::memory_order_relaxed);
+	estimate_seq_.store(seq + 2, std::memory_order_release);
 }
 
-bool time_receiver::was_reset() {
-	std::unique_lock<std::mutex> lock(timeoffset_mut_);
-	bool result = was_reset_;
-	was_reset_ = false;
-	return result;
+bool time_receiver::read_estimate(double &offset, double &remote_time, double &uncertainty) const {
+	while (true) {
+		const uint32_t seq = estimate_seq_.load(std::memory_order_acquire);
+		if (seq & 1) {
+			// the writer only stores three values, so this is over in an instant
+			std::this_thread::yield();
+			continue;
+		}
+		offset = timeoffset_.load(std::memory_order_relaxed);
+		remote_time = remote_time_.load(std::memory_order_relaxed);
+		uncertainty = uncertainty_.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (estimate_seq_.load(std::memory_order_relaxed) == seq) return offset != NOT_ASSIGNED;
+	}
 }
 
 // === internal processing ===
 
+void time_receiver::ensure_started() {
+	if (!io_pool_) {
+		// start thread if not yet running
+		if (!time_thread_.joinable())
+			time_thread_ = managed_thread(lsl_thread_time,
+				"T_" + conn_.type_info().name().substr(0, 12), &time_receiver::time_thread, this);
+	} else if (!pool_started_) {
+		pool_started_ = true;
+		conn_.acquire_watchdog();
+		asio::post(*time_io_, [this]() {
+			try {
+				start_time_estimation();
+			} catch (std::exception &e) {
+				LOG_F(WARNING, "Failed to start the time estimation: %s", e.what());
+			}
+		});
+	}
+}
+
 void time_receiver::time_thread() {
 	conn_.acquire_watchdog();
-	loguru::set_thread_name((std::string("T_") += conn_.type_info().name()).c_str());
 	DLOG_F(2, "Started time receiver thread");
 	try {
 		// start an async time estimation
@@ -83,7 +235,7 @@ void time_receiver::time_thread() {
 		// start the IO object (will keep running until cancelled)
 		while (true) {
 			try {
-				time_io_.run();
+				time_io_->run();
 				break;
 			} catch (std::exception &e) {
 				LOG_F(WARNING, "Hiccup during time_thread io_context processing: %s", e.what());
@@ -96,6 +248,22 @@ void time_receiver::time_thread() {
 }
 
 void time_receiver::start_time_estimation() {
+	// schedule the next estimation step
+	next_estimate_.expires_after(timeout_sec(cfg_->time_update_interval()));
+	next_estimate_.async_wait([this](err_t err) {
+		if (err != asio::error::operation_aborted) start_time_estimation();
+	});
+	// another member of the group might be probing the host already
+	if (!lead_time_sync()) return;
+	// the probes go over a TCP connection, which is (re-)established first
+	if (tcp_ && !tcp_connected_) {
+		if (!tcp_sock_.is_open()) connect_tcp();
+		return;
+	}
+	start_wave();
+}
+
+void time_receiver::start_wave() {
 	// clear the estimates buffer
 	estimates_.clear();
 	estimate_times_.clear();
@@ -104,29 +272,151 @@ void time_receiver::start_time_estimation() {
 	current_wave_id_ = std::rand();
 	// start the packet exchange chains
 	send_next_packet(1);
-	receive_next_packet();
+	if (!tcp_ && !receiving_) {
+		receiving_ = true;
+		receive_next_packet();
+	}
 	// schedule the aggregation of results (by the time when all replies should have been received)
 	aggregate_results_.expires_after(timeout_sec(
 		cfg_->time_probe_max_rtt() + cfg_->time_probe_interval() * cfg_->time_probe_count()));
 	aggregate_results_.async_wait([this](err_t err) { result_aggregation_scheduled(err); });
-	// schedule the next estimation step
-	next_estimate_.expires_after(timeout_sec(cfg_->time_update_interval()));
-	next_estimate_.async_wait([this](err_t err) {
-		if (err != asio::error::operation_aborted) start_time_estimation();
+}
+
+void time_receiver::connect_tcp() {
+	tcp_sock_.async_connect(conn_.get_tcp_endpoint(), [this](err_t err) {
+		if (err == asio::error::operation_aborted) return;
+		if (!err) {
+			error_code ec;
+			tcp_sock_.set_option(asio::ip::tcp::no_delay(true), ec);
+			// the probes are sent right away (see send_tcp()), not queued behind each other
+			tcp_sock_.non_blocking(true, ec);
+			tcp_replies_.consume(tcp_replies_.size());
+			if (send_tcp("LSL:timedata\r\n")) {
+				tcp_connected_ = true;
+				receive_next_packet();
+				start_wave();
+				return;
+			}
+		}
+		LOG_F(WARNING, "Could not connect to the outlet for the time synchronization: %s",
+			err.message().c_str());
+		// the next estimation tries again
+		close_tcp();
 	});
 }
 
+bool time_receiver::send_tcp(const std::string &msg) {
+	error_code ec;
+	const std::size_t sent = tcp_sock_.send(asio::buffer(msg), 0, ec);
+	if (!ec && sent == msg.size()) return true;
+	// the outlet doesn't keep up (or is gone), and a partial probe would garble the connection
+	close_tcp();
+	return false;
+}
+
+void time_receiver::close_tcp() {
+	error_code ec;
+	tcp_sock_.close(ec);
+	tcp_connected_ = false;
+}
+
+std::string time_receiver::host_key() {
+	// outlets on this computer are reached via a loopback or one of its own addresses
+	const auto address = conn_.get_udp_endpoint().address();
+	const std::string hostname = conn_.current_hostname();
+	if (address.is_loopback() || hostname == asio::ip::host_name()) return hostname + " local";
+	return hostname + ' ' + address.to_string();
+}
+
+bool time_receiver::lead_time_sync() {
+	if (conn_.lost()) {
+		// the host might be gone, so someone else should take over
+		leave_time_sync();
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(group_mut_);
+	if (!group_) {
+		const double halftime = cfg_->time_drift_halftime();
+		if (cfg_->shared_time_sync())
+			group_ = time_sync_group::get(host_key(), halftime);
+		else
+			group_ = std::make_shared<time_sync_group>(halftime);
+		std::lock_guard<std::mutex> group_lock(group_->mut);
+		group_->members.push_back(this);
+		// take over what the group knows already
+		if (group_->offset != NOT_ASSIGNED) {
+			{
+				std::lock_guard<std::mutex> own_lock(timeoffset_mut_);
+				publish_estimate(group_->offset, group_->remote_time, group_->uncertainty);
+				if (!group_->drift.empty()) publish_model(group_->drift.model());
+			}
+			timeoffset_upd_.notify_all();
+		}
+	}
+	std::lock_guard<std::mutex> group_lock(group_->mut);
+	if (!group_->leader) group_->leader = this;
+	return group_->leader == this;
+}
+
+void time_receiver::leave_time_sync() {
+	std::lock_guard<std::mutex> lock(group_mut_);
+	if (!group_) return;
+	{
+		std::lock_guard<std::mutex> group_lock(group_->mut);
+		auto &members = group_->members;
+		members.erase(std::remove(members.begin(), members.end(), this), members.end());
+		if (group_->leader == this) group_->leader = nullptr;
+	}
+	group_.reset();
+}
+
+void time_receiver::share_estimate(double offset, double remote_time, double uncertainty) {
+	std::lock_guard<std::mutex> lock(group_mut_);
+	if (!group_) return;
+	std::lock_guard<std::mutex> group_lock(group_->mut);
+	group_->offset = offset;
+	group_->remote_time = remote_time;
+	group_->uncertainty = uncertainty;
+	for (auto *member : group_->members) {
+		{
+			std::lock_guard<std::mutex> member_lock(member->timeoffset_mut_);
+			member->publish_estimate(offset, remote_time, uncertainty);
+		}
+		member->timeoffset_upd_.notify_all();
+	}
+}
+
+void time_receiver::share_probe(double remote_time, double offset, double rtt) {
+	std::lock_guard<std::mutex> lock(group_mut_);
+	if (!group_) return;
+	std::lock_guard<std::mutex> group_lock(group_->mut);
+	auto &drift = group_->drift;
+	// a jump of the remote clock (e.g., after a restart) invalidates the model
+	if (!drift.empty() && std::fabs(drift.model().at(remote_time) - offset) > max_model_deviation)
+		drift.reset();
+	drift.add(remote_time, offset, rtt);
+	const clock_model model = drift.model();
+	for (auto *member : group_->members) {
+		std::lock_guard<std::mutex> member_lock(member->timeoffset_mut_);
+		member->publish_model(model);
+	}
+}
+
 void time_receiver::send_next_packet(int packet_num) {
 	try {
 		// form the request & send it
 		std::ostringstream request;
 		request.precision(16);
-		request << "LSL:timedata\r\n" << current_wave_id_ << " " << lsl_clock() << "\r\n";
-		auto msg_buffer = std::make_shared<std::string>(request.str());
-		time_sock_.async_send_to(asio::buffer(*msg_buffer), conn_.get_udp_endpoint(),
-			[msg_buffer](err_t /*unused*/, std::size_t /*unused*/) {
-				/* Do nothing, but keep the msg_buffer alive until async_send is completed */
-			});
+		request << current_wave_id_ << " " << lsl_clock() << "\r\n";
+		if (tcp_) {
+			if (tcp_connected_) send_tcp(request.str());
+		} else {
+			auto msg_buffer = std::make_shared<std::string>("LSL:timedata\r\n" + request.str());
+			time_sock_.async_send_to(asio::buffer(*msg_buffer), conn_.get_udp_endpoint(),
+				[msg_buffer](err_t /*unused*/, std::size_t /*unused*/) {
+					/* Do nothing, but keep the msg_buffer alive until async_send is completed */
+				});
+		}
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Error trying to send a time packet: %s", e.what());
 	}
@@ -140,38 +430,72 @@ void time_receiver::send_next_packet(int packet_num) {
 }
 
 void time_receiver::receive_next_packet() {
+	if (tcp_) {
+		asio::async_read_until(tcp_sock_, tcp_replies_, "\r\n", [this](err_t err, std::size_t len) {
+			if (err) {
+				// the outlet closed the connection, the next estimation establishes a new one
+				if (err != asio::error::operation_aborted) close_tcp();
+				return;
+			}
+			const double t3 = lsl_clock();
+			const auto begin = asio::buffers_begin(tcp_replies_.data());
+			const std::string reply(begin, begin + len);
+			tcp_replies_.consume(len);
+			try {
+				process_reply(reply, t3);
+			} catch (std::exception &e) {
+				LOG_F(WARNING, "Error while processing a time estimation reply: %s", e.what());
+			}
+			receive_next_packet();
+		});
+		return;
+	}
+	if (kernel_timestamps_) {
+		time_sock_.async_wait(udp::socket::wait_read, [this](err_t err) {
+			if (err) return handle_receive_outcome(err, 0);
+			error_code ec;
+			const std::size_t len = receive_timestamped(
+				time_sock_, asio::buffer(recv_buffer_), remote_endpoint_, received_at_, ec);
+			if (ec == asio::error::would_block) return receive_next_packet();
+			handle_receive_outcome(ec, len);
+		});
+		return;
+	}
 	time_sock_.async_receive_from(asio::buffer(recv_buffer_), remote_endpoint_,
 		[this](err_t err, std::size_t len) { handle_receive_outcome(err, len); });
 }
 
 void time_receiver::handle_receive_outcome(error_code err, std::size_t len) {
 	try {
-		if (!err) {
-			// parse the buffer contents
-			std::istringstream is(std::string(recv_buffer_, len));
-			int wave_id;
-			is >> wave_id;
-			if (wave_id == current_wave_id_) {
-				double t0, t1, t2, t3 = lsl_clock();
-				is >> t0 >> t1 >> t2;
-				// calculate RTT and offset
-				double rtt =
-					(t3 - t0) - (t2 - t1); // round trip time (time passed here - time passed there)
-				double offset =
-					((t1 - t0) + (t2 - t3)) /
-					2; // averaged clock offset (other clock - my clock) with rtt bias averaged out
-				// store it
-				estimates_.push_back(std::make_pair(rtt, offset));
-				estimate_times_.push_back(
-					std::make_pair((t3 + t0) / 2.0, (t2 + t1) / 2.0)); // local_time, remote_time
-			}
-		}
+		if (!err)
+			process_reply(std::string(recv_buffer_, len),
+				kernel_timestamps_ ? received_at_ : lsl_clock());
 	} catch (std::exception &e) {
 		LOG_F(WARNING, "Error while processing a time estimation return packet: %s", e.what());
 	}
 	if (err != asio::error::operation_aborted) receive_next_packet();
 }
 
+void time_receiver::process_reply(const std::string &reply, double t3) {
+	// parse the buffer contents
+	std::istringstream is(reply);
+	int wave_id = -1;
+	is >> wave_id;
+	if (wave_id != current_wave_id_) return;
+	double t0, t1, t2;
+	is >> t0 >> t1 >> t2;
+	// calculate RTT and offset
+	double rtt = (t3 - t0) - (t2 - t1); // round trip time (time passed here - time passed there)
+	double offset = ((t1 - t0) + (t2 - t3)) /
+					2; // averaged clock offset (other clock - my clock) with rtt bias averaged out
+	// store it
+	estimates_.push_back(std::make_pair(rtt, offset));
+	estimate_times_.push_back(
+		std::make_pair((t3 + t0) / 2.0, (t2 + t1) / 2.0)); // local_time, remote_time
+	// every probe refines the clock model
+	if (cfg_->time_drift_halftime() > 0) share_probe((t2 + t1) / 2.0, -offset, rtt);
+}
+
 void time_receiver::result_aggregation_scheduled(error_code err) {
 	if (err) return;
 
@@ -186,22 +510,31 @@ void time_receiver::result_aggregation_scheduled(error_code err) {
 				best_remote_time = estimate_times_[k].second;
 			}
 		}
-		// and notify that the result is available
-		{
-			std::lock_guard<std::mutex> lock(timeoffset_mut_);
-			uncertainty_ = best_rtt;
-			timeoffset_ = -best_offset;
-			remote_time_ = best_remote_time;
+		// and notify the group that the result is available
+		share_estimate(-best_offset, best_remote_time, best_rtt);
+	} else {
+		// the host doesn't answer us, let another member of the group try
+		std::lock_guard<std::mutex> lock(group_mut_);
+		if (group_) {
+			std::lock_guard<std::mutex> group_lock(group_->mut);
+			if (group_->leader == this) group_->leader = nullptr;
 		}
-		timeoffset_upd_.notify_all();
 	}
 }
 
 void time_receiver::reset_timeoffset_on_recovery() {
+	// the stream may have moved to another host, so the group is chosen again
+	leave_time_sync();
+	// (and the TCP connection established to it)
+	if (tcp_) asio::post(*time_io_, [this]() { close_tcp(); });
 	std::lock_guard<std::mutex> lock(timeoffset_mut_);
-	if (timeoffset_ != NOT_ASSIGNED)
+	if (timeoffset_.load() != NOT_ASSIGNED)
 		// this will only be set to true if the reset may have caused a possible interruption in the
 		// obtained time offsets
 		was_reset_ = true;
-	timeoffset_ = NOT_ASSIGNED;
+	publish_estimate(NOT_ASSIGNED, NOT_ASSIGNED, NOT_ASSIGNED);
+	// the probes of the previous clock don't describe the new one
+	clock_model none;
+	none.offset = NOT_ASSIGNED;
+	publish_model(none);
 }
@@ -1,12 +1,19 @@
 #ifndef TIME_RECEIVER_H
 #define TIME_RECEIVER_H
 
+#include "clock_model.h"
+#include "forward.h"
+#include "thread_policy.h"
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <mutex>
+#include <string>
 #include <thread>
 
 namespace asio = lslboost::asio;
@@ -16,6 +23,7 @@ using lslboost::system::error_code;
 namespace lsl {
 class inlet_connection;
 class api_config;
+class io_context_pool;
 
 /// list of time estimates with error bounds
 typedef std::vector<std::pair<double, double>> estimate_list;
@@ -26,8 +34,18 @@ typedef std::vector<std::pair<double, double>> estimate_list;
  * (time_correction()) waits for the thread to finish.
  * The public function has an optional timeout after which it gives up, while the background thread
  * continues to do its job (so the next public-function call may succeed within the timeout).
+ * Once an estimate is available, reading it never blocks; latest_time_correction() doesn't wait for
+ * the first one either.
  * The background thread terminates only if the time_receiver is destroyed or the underlying
  * connection is lost or shut down.
+ * If [tuning] InletIOThreads is set, the background activities run in a thread pool shared by all
+ * inlets instead.
+ * If [tuning] SharedTimeSync is set, the time receivers of inlets whose outlets are on the same
+ * host form a group, and only one of them (the leader) sends time probes. Its estimates are
+ * published to all members of the group.
+ * The probes are UDP packets to the outlet's service port, or, if [tuning] TCPTimeSync is set,
+ * lines on a TCP connection to its data port (`LSL:timedata`), which only needs that port to be
+ * reachable.
  */
 class time_receiver {
 public:
@@ -52,6 +70,35 @@ public:
 	double time_correction(double timeout = 2);
 	double time_correction(double *remote_time, double *uncertainty, double timeout);
 
+	/**
+	 * Get the latest time correction estimate without waiting for one.
+	 *
+	 * This never blocks, so it can be called on the data path. The estimation is started in the
+	 * background if that hasn't happened yet.
+	 * @param[out] offset The time correction estimate.
+	 * @param[out] remote_time Time of this measurement on the remote computer (optional).
+	 * @param[out] uncertainty Maximum uncertainty of this measurement (optional).
+	 * @return Whether an estimate is available.
+	 * @throws lost_error If the connection has been lost.
+	 */
+	bool latest_time_correction(double &offset, double *remote_time, double *uncertainty);
+
+	/// The round-trip time of the current estimate, 0 if there's none yet (never starts probing).
+	double estimate_rtt() const {
+		double offset, remote_time, rtt;
+		return read_estimate(offset, remote_time, rtt) ? rtt : 0.0;
+	}
+
+	/**
+	 * Retrieve the model of the time correction over the remote time.
+	 *
+	 * The model is updated with every time probe (see api_config::time_drift_halftime()); without
+	 * a model, it's the time_correction() without drift. Like time_correction(), this only waits
+	 * for the first estimate.
+	 * @throws timeout_error If the initial estimate times out.
+	 */
+	clock_model time_correction_model(double timeout = 2);
+
 	/**
 	 * Determine whether the clock was (potentially) reset since the last call to was_reset()
 	 *
@@ -60,13 +107,46 @@ public:
 	 */
 	bool was_reset();
 
+	/// The memory of the receive buffer, in bytes.
+	std::size_t buffer_bytes() const { return sizeof(recv_buffer_); }
+
 private:
 	/// The time reader / updater thread.
 	void time_thread();
 
+	/// Start the time estimation (in its own thread or the shared IO thread pool) if needed.
+	void ensure_started();
+
 	/// Start a new multi-packet exchange for time estimation
 	void start_time_estimation();
 
+	/// Send the probes of a new wave and schedule the aggregation of their results.
+	void start_wave();
+
+	/// Establish the TCP connection for the probes and start the first wave over it.
+	void connect_tcp();
+
+	/// Send a message over the TCP connection; closes it if the message can't be sent at once.
+	bool send_tcp(const std::string &msg);
+
+	/// Close the TCP connection (if any), so the next estimation establishes a new one.
+	void close_tcp();
+
+	/// The key of the time sync group for the stream's current host.
+	std::string host_key();
+
+	/// Join the time sync group if needed; returns whether this receiver leads the group now.
+	bool lead_time_sync();
+
+	/// Leave the time sync group (if any) so that no more estimates are published to us.
+	void leave_time_sync();
+
+	/// Publish an estimate (and the group's clock model) to all members of the group.
+	void share_estimate(double offset, double remote_time, double uncertainty);
+
+	/// Add a probe to the group's clock model and publish the model to all members.
+	void share_probe(double remote_time, double offset, double rtt);
+
 	/// Send the next packet in an exchange
 	void send_next_packet(int packet_num);
 
@@ -76,9 +156,21 @@ private:
 	/// Handler that gets called once reception of a time packet has completed
 	void handle_receive_outcome(error_code err, std::size_t len);
 
+	/// Add the estimate of a reply (`[wave id] [t0] [t1] [t2]`) that was received at t3.
+	void process_reply(const std::string &reply, double t3);
+
 	/// Handlers that gets called once the time estimation results shall be aggregated.
 	void result_aggregation_scheduled(error_code err);
 
+	/// Publish a new estimate to the readers (called with timeoffset_mut_ held).
+	void publish_estimate(double offset, double remote_time, double uncertainty);
+
+	/// Read the latest estimate; returns false if none has been assigned yet.
+	bool read_estimate(double &offset, double &remote_time, double &uncertainty) const;
+
+	/// Publish a new clock model to the readers (called with timeoffset_mut_ held).
+	void publish_model(const clock_model &model);
+
 	/// Ensures that the time-offset is reset when the underlying connection is recovered (e.g.,
 	/// switches to another host)
 	void reset_timeoffset_on_recovery();
@@ -87,17 +179,24 @@ private:
 	inlet_connection &conn_;
 
 	// background reader thread and the data generated by it
-	/// updates time offset
-	std::thread time_thread_;
+	/// updates time offset (unless the shared IO thread pool is used)
+	managed_thread time_thread_;
+	/// whether the time estimation has been started in the shared IO thread pool
+	bool pool_started_{false};
 	/// whether the clock was reset
-	bool was_reset_;
+	std::atomic<bool> was_reset_;
+	/// sequence number of the estimate below; odd while an update is in progress, so readers
+	/// retry instead of waiting for a lock (a seqlock)
+	std::atomic<uint32_t> estimate_seq_{0};
 	/// the current time offset (or NOT_ASSIGNED if not yet assigned)
-	double timeoffset_;
+	std::atomic<double> timeoffset_;
 	/// remote computer time at the specified timeoffset_
-	double remote_time_;
+	std::atomic<double> remote_time_;
 	/// round trip time (a.k.a. uncertainty) at the specficied timeoffset_
-	double uncertainty_;
-	/// mutex to protect the time offset
+	std::atomic<double> uncertainty_;
+	/// the current clock model (model_offset_ is NOT_ASSIGNED if there's none)
+	std::atomic<double> model_offset_, model_drift_, model_t0_;
+	/// mutex to serialize updates of the time offset and to wait for the first one
 	std::mutex timeoffset_mut_;
 	/// condition variable to indicate that an update for the time offset is available
 	std::condition_variable timeoffset_upd_;
@@ -106,12 +205,26 @@ private:
 	// data used internally by the background thread
 	/// the configuration object
 	const api_config *cfg_;
+	/// the process-wide IO thread pool, if the time operations don't run in their own thread
+	std::shared_ptr<io_context_pool> io_pool_;
 	/// an IO service for async time operations
-	asio::io_context time_io_;
+	io_context_p time_io_;
 	/// a buffer to hold inbound packet contents
 	char recv_buffer_[16384]{0};
+	/// whether the kernel time stamps the received packets
+	bool kernel_timestamps_{false};
+	/// the time the current packet was received at (if kernel_timestamps_ is set)
+	double received_at_{0.0};
 	/// the socket through which the time thread communicates
 	udp::socket time_sock_;
+	/// whether the probes go over TCP instead (see api_config::tcp_time_sync())
+	bool tcp_;
+	/// the connection to the outlet's data port the probes go over (if tcp_ is set)
+	asio::ip::tcp::socket tcp_sock_;
+	/// whether tcp_sock_ is connected and the outlet expects probes on it
+	bool tcp_connected_{false};
+	/// the replies received over tcp_sock_
+	asio::streambuf tcp_replies_;
 	/// schedule the next time estimate
 	asio::steady_timer next_estimate_;
 	/// schedules result aggregation
@@ -126,6 +239,12 @@ private:
 	estimate_list estimate_times_;
 	/// an id for the current wave of time packets
 	int current_wave_id_{0};
+	/// whether the packet receive chain is running
+	bool receiving_{false};
+	/// the time sync group this receiver is a member of
+	std::shared_ptr<struct time_sync_group> group_;
+	/// protects group_
+	std::mutex group_mut_;
 };
 } // namespace lsl
 
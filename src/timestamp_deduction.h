@@ -0,0 +1,77 @@
+#ifndef TIMESTAMP_DEDUCTION_H
+#define TIMESTAMP_DEDUCTION_H
+
+#include "common.h"
+#include <cmath>
+#include <cstdint>
+
+namespace lsl {
+
+/**
+ * Decides which time stamps of the samples sent to one receiver can be left to the receiver to
+ * deduce (see DEDUCED_TIMESTAMP), i.e. which are within a tolerance of the previous time stamp
+ * (as the receiver reconstructs it) plus the sampling interval.
+ *
+ * The samples in the send buffer keep their time stamps, since they are shared by all consumers
+ * and a consumer may not get all of them (it joined late, its queue dropped samples, a datagram
+ * was lost). So each consumer decides for itself, in the order its receiver gets the samples,
+ * and sends the time stamp of its first sample and of each sample after a gap in the sequence
+ * numbers.
+ */
+class timestamp_deduction {
+public:
+	/// A deduction that sends all time stamps.
+	timestamp_deduction() = default;
+
+	/**
+	 * @param max The maximum number of consecutive deduced time stamps (0 for none).
+	 * @param tolerance The maximum deviation (in seconds) of a deduced time stamp.
+	 * @param interval The sampling interval (in seconds).
+	 */
+	timestamp_deduction(uint32_t max, double tolerance, double interval)
+		: max_(max), tolerance_(tolerance), interval_(interval) {}
+
+	/// Whether any time stamps are deduced.
+	bool enabled() const { return max_ > 0; }
+
+	/// Send the next time stamp, e.g. at the start of a datagram the receiver may not get.
+	void restart() { has_last_ = false; }
+
+	/**
+	 * The time stamp to send for a sample: its own or DEDUCED_TIMESTAMP.
+	 * @param timestamp The sample's time stamp.
+	 * @param seq The sample's sequence number, 0 if it's not from the send buffer (so the
+	 * receiver may not get the one before it).
+	 */
+	double wire_timestamp(double timestamp, uint64_t seq) {
+		if (!max_ || timestamp == DEDUCED_TIMESTAMP) return timestamp;
+		const double deduced = last_ + interval_;
+		const bool follows = has_last_ && seq && seq == last_seq_ + 1;
+		last_seq_ = seq;
+		if (follows && num_deduced_ < max_ && std::fabs(timestamp - deduced) <= tolerance_) {
+			num_deduced_++;
+			last_ = deduced;
+			return DEDUCED_TIMESTAMP;
+		}
+		num_deduced_ = 0;
+		last_ = timestamp;
+		has_last_ = true;
+		return timestamp;
+	}
+
+private:
+	/// the parameters, see timestamp_deduction()
+	uint32_t max_{0};
+	double tolerance_{0.0};
+	double interval_{0.0};
+	/// the last time stamp as reconstructed by the receiver, whether there is one, the sequence
+	/// number of its sample and the number of consecutive deduced time stamps since the last sent
+	double last_{0.0};
+	bool has_last_{false};
+	uint64_t last_seq_{0};
+	uint32_t num_deduced_{0};
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace lsl {
+
+/**
+ * A token bucket that limits the average rate of a byte stream while allowing short bursts.
+ *
+ * The bucket fills at the rate up to the burst size. Sending takes the bytes from the bucket
+ * right away, even if that drives it into debt, and the sender waits until the debt is paid
+ * back, so chunks larger than the burst size can still be sent. Any number of threads can share
+ * a bucket, e.g. all connections of a host.
+ */
+class token_bucket {
+public:
+	/// How many seconds of the rate can be sent in a burst.
+	static constexpr double burst_seconds = 0.05;
+
+	/// @param bytes_per_second The rate limit, 0 for none.
+	explicit token_bucket(double bytes_per_second = 0.0) { set_rate(bytes_per_second); }
+
+	/// Change the rate limit (0 for none); the bucket starts full.
+	void set_rate(double bytes_per_second) {
+		std::lock_guard<std::mutex> lock(mut_);
+		rate_ = std::max(bytes_per_second, 0.0);
+		tokens_ = rate_ * burst_seconds;
+		last_ = clock::now();
+	}
+
+	/// The rate limit, 0 for none.
+	double rate() const { return rate_; }
+
+	/**
+	 * Take the tokens for a number of bytes.
+	 * @return How long (in seconds) the sender has to wait before sending them to keep the rate,
+	 * 0 if they are within the budget.
+	 */
+	double take(std::size_t bytes) {
+		if (rate_ <= 0.0) return 0.0;
+		std::lock_guard<std::mutex> lock(mut_);
+		const clock::time_point now = clock::now();
+		tokens_ = std::min(tokens_ + std::chrono::duration<double>(now - last_).count() * rate_,
+			rate_ * burst_seconds);
+		last_ = now;
+		tokens_ -= static_cast<double>(bytes);
+		return tokens_ < 0.0 ? -tokens_ / rate_ : 0.0;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	std::mutex mut_;
+	/// the rate (bytes per second), set before the bucket is shared
+	double rate_{0.0};
+	/// the bytes that can be sent right away (negative while the bucket is in debt)
+	double tokens_{0.0};
+	/// when the tokens were last refilled
+	clock::time_point last_;
+};
+
+} // namespace lsl
+
+#endif
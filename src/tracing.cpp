@@ -0,0 +1,192 @@
+#include "tracing.h"
+#include "common.h"
+#include "lsl_c_api_helpers.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <loguru.hpp>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace lsl;
+
+namespace {
+
+/// the longest UID that's recorded (the generated ones have 36 characters)
+const std::size_t max_uid_length = 47;
+
+/// A recorded event.
+struct trace_event {
+	/// the number of the event plus one once it has been written, 0 while it's empty
+	std::atomic<uint64_t> stamp{0};
+	int64_t ns;
+	uint64_t seq;
+	const char *name;
+	uint32_t thread;
+	tracing::phase ph;
+	char uid[max_uid_length + 1];
+};
+
+/// whether events are recorded (fast path, see record())
+std::atomic<bool> enabled_{false};
+/// the number of threads that are currently in record()
+std::atomic<int> writers_{0};
+/// the ring buffer of events and the number of the next event
+std::unique_ptr<trace_event[]> events_;
+std::size_t capacity_ = 0;
+std::atomic<uint64_t> next_event_{0};
+/// serializes start() and stop()
+std::mutex control_mut_;
+
+/// the names of all threads that recorded events, by thread number (starting at 1)
+std::vector<std::string> thread_names_;
+std::mutex thread_names_mut_;
+
+/// The number of the calling thread; the first call registers the thread's name.
+uint32_t thread_number() {
+	thread_local uint32_t number = 0;
+	if (!number) {
+		char name[32] = {0};
+		loguru::get_thread_name(name, sizeof(name), false);
+		std::lock_guard<std::mutex> lock(thread_names_mut_);
+		thread_names_.emplace_back(name);
+		number = static_cast<uint32_t>(thread_names_.size());
+	}
+	return number;
+}
+
+/// Write a string as a JSON string literal.
+void write_json_string(std::ostream &out, const char *str) {
+	out << '"';
+	for (; *str; ++str) {
+		const unsigned char c = static_cast<unsigned char>(*str);
+		if (c == '"' || c == '\\')
+			out << '\\' << *str;
+		else if (c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else
+			out << *str;
+	}
+	out << '"';
+}
+
+} // namespace
+
+bool tracing::enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+void tracing::record(phase ph, const char *name, const std::string &uid, uint64_t seq) {
+	const uint32_t thread = thread_number();
+	const int64_t now = lsl_local_clock_ns();
+	// stop() waits until no thread is here anymore before it touches the buffer
+	writers_.fetch_add(1);
+	if (enabled_.load()) {
+		const uint64_t number = next_event_.fetch_add(1, std::memory_order_relaxed);
+		trace_event &ev = events_[number % capacity_];
+		ev.stamp.store(0, std::memory_order_relaxed);
+		ev.ns = now;
+		ev.seq = seq;
+		ev.name = name;
+		ev.thread = thread;
+		ev.ph = ph;
+		const std::size_t len = std::min(uid.size(), max_uid_length);
+		memcpy(ev.uid, uid.data(), len);
+		ev.uid[len] = 0;
+		ev.stamp.store(number + 1, std::memory_order_release);
+	}
+	writers_.fetch_sub(1);
+}
+
+void tracing::start(std::size_t max_events) {
+	if (!max_events) throw std::invalid_argument("At least one event has to be recorded.");
+	std::lock_guard<std::mutex> lock(control_mut_);
+	if (enabled_) throw std::logic_error("Tracing has already been started.");
+	events_.reset(new trace_event[max_events]);
+	capacity_ = max_events;
+	next_event_ = 0;
+	thread_number(); // so the controlling thread is there in any case
+	enabled_ = true;
+}
+
+std::size_t tracing::stop(const std::string &filename) {
+	std::lock_guard<std::mutex> lock(control_mut_);
+	if (!enabled_) throw std::logic_error("Tracing hasn't been started.");
+	enabled_ = false;
+	while (writers_.load()) std::this_thread::yield();
+	std::unique_ptr<trace_event[]> events(std::move(events_));
+
+	std::vector<const trace_event *> recorded;
+	for (std::size_t i = 0; i < capacity_; ++i)
+		if (events[i].stamp.load(std::memory_order_acquire)) recorded.push_back(&events[i]);
+	std::sort(recorded.begin(), recorded.end(), [](const trace_event *a, const trace_event *b) {
+		return a->stamp.load(std::memory_order_relaxed) < b->stamp.load(std::memory_order_relaxed);
+	});
+
+	std::ofstream out(filename);
+	if (!out) throw std::runtime_error("Could not open the trace file " + filename);
+	out << "{\"traceEvents\":[\n";
+	{
+		std::lock_guard<std::mutex> lock(thread_names_mut_);
+		for (std::size_t i = 0; i < thread_names_.size(); ++i) {
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1
+				<< ",\"args\":{\"name\":";
+			write_json_string(out, thread_names_[i].c_str());
+			out << "}},\n";
+		}
+	}
+	const int64_t t0 = recorded.empty() ? 0 : recorded.front()->ns;
+	char ts[32];
+	for (std::size_t i = 0; i < recorded.size(); ++i) {
+		const trace_event &ev = *recorded[i];
+		snprintf(ts, sizeof(ts), "%.3f", static_cast<double>(ev.ns - t0) / 1e3);
+		out << "{\"name\":";
+		write_json_string(out, ev.name);
+		out << ",\"cat\":\"lsl\",\"ph\":\"" << static_cast<char>(ev.ph) << "\",\"ts\":" << ts
+			<< ",\"pid\":1,\"tid\":" << ev.thread;
+		if (ev.ph == phase::instant) out << ",\"s\":\"t\"";
+		if (ev.ph == phase::async_begin || ev.ph == phase::async_end) {
+			out << ",\"id\":";
+			write_json_string(out, (std::string(ev.uid) + ":" + std::to_string(ev.seq)).c_str());
+		}
+		out << ",\"args\":{\"uid\":";
+		write_json_string(out, ev.uid);
+		out << ",\"seq\":" << ev.seq << "}}" << (i + 1 < recorded.size() ? ",\n" : "\n");
+	}
+	out << "]}\n";
+	if (!out) throw std::runtime_error("Could not write the trace file " + filename);
+	return recorded.size();
+}
+
+extern "C" {
+
+LIBLSL_C_API int32_t lsl_start_tracing(uint32_t max_events) {
+#ifdef LSL_TRACING
+	try {
+		tracing::start(max_events);
+		return lsl_no_error;
+	}
+	LSLCATCHANDRETURN(std::invalid_argument, lsl_argument_error)
+	LSLCATCHANDRETURN(std::exception, lsl_internal_error)
+#else
+	(void)max_events;
+	strncpy(const_cast<char *>(lsl_last_error()), "liblsl was built without tracing support",
+		LAST_ERROR_SIZE - 1);
+	return lsl_internal_error;
+#endif
+}
+
+LIBLSL_C_API int32_t lsl_stop_tracing(const char *filename) {
+	if (!filename) return lsl_argument_error;
+	try {
+		return static_cast<int32_t>(tracing::stop(filename));
+	}
+	LSLCATCHANDRETURN(std::exception, lsl_internal_error)
+}
+}
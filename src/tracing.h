@@ -0,0 +1,70 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @file tracing.h Trace events at the boundaries of the data path.
+ *
+ * If liblsl is built with the CMake option LSL_TRACING, the LSL_TRACE* macros record events with
+ * the stream's UID and the sample's sequence number into a ring buffer while tracing is started
+ * (see lsl_start_tracing()); lsl_stop_tracing() writes them in the Chrome trace event format,
+ * which can be viewed with Perfetto (https://ui.perfetto.dev) or chrome://tracing.
+ * Otherwise, the macros compile to nothing.
+ */
+
+namespace lsl {
+namespace tracing {
+
+/// The kind of an event, as in the Chrome trace event format.
+enum class phase : char {
+	/// an event without a duration
+	instant = 'i',
+	/// the begin and end of a duration on the same thread
+	begin = 'B',
+	end = 'E',
+	/// the begin and end of an operation that may end on another thread (matched by UID and
+	/// sequence number)
+	async_begin = 'b',
+	async_end = 'e'
+};
+
+/// Whether events are currently recorded.
+bool enabled();
+
+/// Record an event; name must be a string literal.
+void record(phase ph, const char *name, const std::string &uid, uint64_t seq);
+
+/// Start recording up to max_events events (the oldest ones are overwritten).
+void start(std::size_t max_events);
+
+/// Stop recording and write the recorded events to a file; returns the number of events written.
+std::size_t stop(const std::string &filename);
+
+} // namespace tracing
+} // namespace lsl
+
+#ifdef LSL_TRACING
+#define LSL_TRACE_EVENT(ph, name, uid, seq)                                                        \
+	do {                                                                                           \
+		if (lsl::tracing::enabled()) lsl::tracing::record(ph, name, uid, seq);                     \
+	} while (0)
+#else
+#define LSL_TRACE_EVENT(ph, name, uid, seq)                                                        \
+	do {                                                                                           \
+	} while (0)
+#endif
+
+/// Record an event without a duration.
+#define LSL_TRACE(name, uid, seq) LSL_TRACE_EVENT(lsl::tracing::phase::instant, name, uid, seq)
+/// Record the begin / end of a duration on the current thread.
+#define LSL_TRACE_BEGIN(name, uid, seq) LSL_TRACE_EVENT(lsl::tracing::phase::begin, name, uid, seq)
+#define LSL_TRACE_END(name, uid, seq) LSL_TRACE_EVENT(lsl::tracing::phase::end, name, uid, seq)
+/// Record the begin / end of an operation that may end on another thread.
+#define LSL_TRACE_ASYNC_BEGIN(name, uid, seq)                                                      \
+	LSL_TRACE_EVENT(lsl::tracing::phase::async_begin, name, uid, seq)
+#define LSL_TRACE_ASYNC_END(name, uid, seq)                                                        \
+	LSL_TRACE_EVENT(lsl::tracing::phase::async_end, name, uid, seq)
+
+#endif
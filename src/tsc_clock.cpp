@@ -0,0 +1,133 @@
+#include "tsc_clock.h"
+#include "api_config.h"
+#include <algorithm>
+#include <chrono>
+#include <loguru.hpp>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LSL_HAVE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace lsl;
+
+/// the interval (in ns) at which the clock is compared with steady_clock
+const double sync_interval_ns = 1e9;
+
+/// if the clock lags behind steady_clock by more than this (in ns), e.g. after a suspend, it jumps
+/// ahead; a clock that's ahead is slowed down by at most this much per synchronization instead,
+/// since it must not go backwards
+const int64_t max_slew_ns = 1000000;
+
+static int64_t steady_ns() {
+	return std::chrono::nanoseconds(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef LSL_HAVE_TSC
+/// whether the TSC runs at a constant rate in all power states (CPUID.80000007H:EDX[8])
+static bool invariant_tsc() {
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0x80000000);
+	if (static_cast<unsigned>(regs[0]) < 0x80000007u) return false;
+	__cpuid(regs, 0x80000007);
+	return (regs[3] & (1 << 8)) != 0;
+#else
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx)) return false;
+	return (edx & (1u << 8)) != 0;
+#endif
+}
+
+static uint64_t read_tsc() { return __rdtsc(); }
+#else
+static uint64_t read_tsc() { return 0; }
+#endif
+
+tsc_clock *tsc_clock::instance() {
+#ifdef LSL_HAVE_TSC
+	// never destroyed, since it may be read until the very end of the process
+	static tsc_clock *clock =
+		api_config::get_instance()->tsc_clock() && invariant_tsc() ? new tsc_clock() : nullptr;
+	return clock;
+#else
+	return nullptr;
+#endif
+}
+
+tsc_clock::tsc_clock() {
+	// measure the counter's rate for a few milliseconds; it's refined by the synchronizations
+	const int64_t steady_start = steady_ns();
+	const uint64_t tsc_start = read_tsc();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	sync_steady_ns_ = steady_ns();
+	sync_tsc_ = read_tsc();
+	const double rate = static_cast<double>(sync_steady_ns_ - steady_start) /
+						static_cast<double>(sync_tsc_ - tsc_start);
+	base_tsc_ = sync_tsc_;
+	base_ns_ = sync_steady_ns_;
+	ns_per_tick_ = rate;
+	next_sync_tsc_ = sync_tsc_ + static_cast<uint64_t>(sync_interval_ns / rate);
+	LOG_F(INFO, "Using the time stamp counter as clock (%.3f GHz)", 1.0 / rate);
+}
+
+int64_t tsc_clock::now_ns() {
+	uint64_t tsc, base_tsc;
+	int64_t base_ns;
+	double rate;
+	while (true) {
+		const uint32_t seq = seq_.load(std::memory_order_acquire);
+		if (seq & 1) continue;
+		// the counter is read along with the anchor, so a reader that was preempted in between
+		// doesn't convert an old counter value with a newer rate
+		tsc = read_tsc();
+		base_tsc = base_tsc_.load(std::memory_order_relaxed);
+		base_ns = base_ns_.load(std::memory_order_relaxed);
+		rate = ns_per_tick_.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq_.load(std::memory_order_relaxed) == seq) break;
+	}
+	// the counter may have been read just before another thread moved the anchor, in which case
+	// the time at the anchor is the earliest the clock can tell without going backwards
+	int64_t ns = base_ns;
+	if (tsc > base_tsc) ns += static_cast<int64_t>(static_cast<double>(tsc - base_tsc) * rate);
+	if (tsc >= next_sync_tsc_.load(std::memory_order_relaxed) &&
+		!syncing_.test_and_set(std::memory_order_acquire)) {
+		if (tsc >= next_sync_tsc_.load(std::memory_order_relaxed)) synchronize(tsc, ns);
+		syncing_.clear(std::memory_order_release);
+	}
+	return ns;
+}
+
+void tsc_clock::synchronize(uint64_t tsc, int64_t ns) {
+	const int64_t steady = steady_ns();
+	if (tsc <= sync_tsc_) return;
+	// the rate since the last synchronization, plus what's needed to catch up until the next one
+	double rate =
+		static_cast<double>(steady - sync_steady_ns_) / static_cast<double>(tsc - sync_tsc_);
+	const int64_t error = steady - ns;
+	int64_t base_ns = ns;
+	if (error > max_slew_ns)
+		base_ns = steady;
+	else
+		rate += static_cast<double>(std::max(error, -max_slew_ns)) / (sync_interval_ns / rate);
+	if (!(rate > 0.0)) return;
+	sync_tsc_ = tsc;
+	sync_steady_ns_ = steady;
+
+	const uint32_t seq = seq_.load(std::memory_order_relaxed);
+	seq_.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	base_tsc_.store(tsc, std::memory_order_relaxed);
+	base_ns_.store(base_ns, std::memory_order_relaxed);
+	ns_per_tick_.store(rate, std::memory_order_relaxed);
+	seq_.store(seq + 2, std::memory_order_release);
+	next_sync_tsc_.store(
+		tsc + static_cast<uint64_t>(sync_interval_ns / rate), std::memory_order_relaxed);
+}
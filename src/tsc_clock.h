@@ -0,0 +1,49 @@
+#ifndef TSC_CLOCK_H
+#define TSC_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace lsl {
+
+/**
+ * A clock based on the CPU's time stamp counter, calibrated against std::chrono::steady_clock.
+ *
+ * Reading the counter is a lot cheaper than a system call (or even the vDSO), so this is used for
+ * lsl_local_clock() if [tuning] TSCClock is set and the CPU has an invariant TSC. The clock has
+ * the same epoch as steady_clock and follows it: about once per second, one of the readers
+ * compares both clocks and adjusts the rate so the difference is gone by the next comparison.
+ * The clock stays continuous during these adjustments.
+ */
+class tsc_clock {
+public:
+	/// The process-wide TSC clock, nullptr if it's not enabled or not supported.
+	static tsc_clock *instance();
+
+	/// The current time in nanoseconds.
+	int64_t now_ns();
+
+private:
+	tsc_clock();
+
+	/// Compare the clock with steady_clock and adjust the rate accordingly.
+	void synchronize(uint64_t tsc, int64_t ns);
+
+	/// The anchor of the conversion, published via a sequence lock (odd while it's updated).
+	std::atomic<uint32_t> seq_{0};
+	std::atomic<uint64_t> base_tsc_{0};
+	std::atomic<int64_t> base_ns_{0};
+	std::atomic<double> ns_per_tick_{0.0};
+
+	/// the counter value after which the next reader synchronizes the clock
+	std::atomic<uint64_t> next_sync_tsc_{0};
+	/// set while a reader synchronizes the clock
+	std::atomic_flag syncing_ = ATOMIC_FLAG_INIT;
+	/// the counter and steady_clock values at the last synchronization (only used while syncing_)
+	uint64_t sync_tsc_{0};
+	int64_t sync_steady_ns_{0};
+};
+
+} // namespace lsl
+
+#endif
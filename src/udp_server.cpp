@@ -1,10 +1,16 @@
 #include "udp_server.h"
+#include "api_config.h"
+#include "discovery_stats.h"
+#include "io_context_pool.h"
 #include "socket_utils.h"
 #include "stream_info_impl.h"
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/post.hpp>
+#include <algorithm>
 #include <loguru.hpp>
+#include <map>
 #include <sstream>
 
 namespace ip = asio::ip;
@@ -13,12 +19,21 @@ namespace lsl {
 
 udp_server::udp_server(const stream_info_impl_p &info, asio::io_context &io, udp protocol)
 	: info_(info), io_(io), socket_(std::make_shared<udp::socket>(io)),
-	  time_services_enabled_(true) {
-	// open the socket for the specified protocol
-	socket_->open(protocol);
+	  time_services_enabled_(true), announce_timer_(io) {
+	uint16_t port;
+	if (api_config::get_instance()->shared_sockets()) {
+		// the process-wide server answers the requests
+		shared_ = acquire_shared(protocol);
+		port = shared_->socket_->local_endpoint().port();
+	} else {
+		// open the socket for the specified protocol
+		socket_->open(protocol);
 
-	// bind to a free port
-	uint16_t port = bind_port_in_range(*socket_, protocol);
+		// bind to a free port
+		port = bind_port_in_range(*socket_, protocol);
+		kernel_timestamps_ = api_config::get_instance()->kernel_timestamps() &&
+							 enable_receive_timestamps(*socket_);
+	}
 
 	// assign the service port field
 	if (protocol == udp::v4())
@@ -32,154 +47,401 @@ udp_server::udp_server(const stream_info_impl_p &info, asio::io_context &io, udp
 udp_server::udp_server(const stream_info_impl_p &info, asio::io_context &io,
 	const std::string &address, uint16_t port, int ttl, const std::string &listen_address)
 	: info_(info), io_(io), socket_(std::make_shared<udp::socket>(io)),
-	  time_services_enabled_(false) {
+	  time_services_enabled_(false),
+	  announce_interval_(api_config::get_instance()->announce_interval()), announce_timer_(io) {
 	ip::address addr = ip::make_address(address);
-	bool is_broadcast = addr == ip::address_v4::broadcast();
-
-	// set up the endpoint where we listen (note: this is not yet the multicast address)
-	udp::endpoint listen_endpoint;
-	if (listen_address.empty()) {
-		// pick the default endpoint
-		if (addr.is_v4())
-			listen_endpoint = udp::endpoint(udp::v4(), port);
-		else
-			listen_endpoint = udp::endpoint(udp::v6(), port);
-	} else {
-		// choose an endpoint explicitly
-		ip::address listen_addr = ip::make_address(listen_address);
-		listen_endpoint = udp::endpoint(listen_addr, (uint16_t)port);
+	if (info_ && !announce_interval_ && api_config::get_instance()->shared_sockets()) {
+		// the process-wide server for the group answers the requests
+		shared_ = acquire_shared(address, port, ttl, listen_address);
+		return;
 	}
+	open_multicast_socket(*socket_, addr, port, ttl, listen_address);
+	announce_endpoint_ = udp::endpoint(addr, port);
+	// the socket is bound to the listen address otherwise
+	if (addr.is_multicast() && listen_address.empty()) group_ = addr;
+	if (announce_interval_ > 0 && addr == ip::address_v4::broadcast())
+		socket_->set_option(asio::socket_base::broadcast(true));
+	LOG_F(2, "%s: Started multicast udp server at %s port %d (addr %p)",
+		info_ ? info_->name().c_str() : "(shared)", address.c_str(), port, (void *)this);
+}
+
+udp_server::udp_server(std::shared_ptr<io_context_pool> pool, const std::string &address,
+	uint16_t port, int ttl, const std::string &listen_address)
+	: udp_server(nullptr, *pool->next(), address, port, ttl, listen_address) {
+	pool_ = std::move(pool);
+	// the outlets that announce themselves have servers of their own
+	announce_interval_ = 0.0;
+}
+
+udp_server::udp_server(std::shared_ptr<io_context_pool> pool, udp protocol)
+	: pool_(std::move(pool)), io_(*pool_->next()), socket_(std::make_shared<udp::socket>(io_)),
+	  time_services_enabled_(true), announce_timer_(io_) {
+	socket_->open(protocol);
+	uint16_t port = bind_port_in_range(*socket_, protocol);
+	kernel_timestamps_ =
+		api_config::get_instance()->kernel_timestamps() && enable_receive_timestamps(*socket_);
+	LOG_F(INFO, "Started the shared udp server on IPv%d port %d", protocol == udp::v4() ? 4 : 6,
+		port);
+}
 
-	// open the socket and make sure that we can reuse the address, and bind it
-	socket_->open(listen_endpoint.protocol());
-	socket_->set_option(udp::socket::reuse_address(true));
+udp_server::~udp_server() {
+	if (shared_) release_shared(shared_);
+}
 
-	// set the multicast TTL
-	if (addr.is_multicast() && !is_broadcast) socket_->set_option(ip::multicast::hops(ttl));
+static std::mutex shared_servers_mut;
+static std::weak_ptr<udp_server> shared_servers[2];
+/// the shared multicast servers by their group, port, TTL and listen address
+static std::map<std::string, std::weak_ptr<udp_server>> shared_responders;
 
-	// bind to the listen endpoint
-	socket_->bind(listen_endpoint);
+std::shared_ptr<io_context_pool> udp_server::shared_pool() {
+	auto pool = io_context_pool::outlet_pool();
+	return pool ? pool : std::make_shared<io_context_pool>(1, "IOS_");
+}
 
-	// join the multicast group, if any
-	if (addr.is_multicast() && !is_broadcast) {
-		if (addr.is_v4())
-			socket_->set_option(
-				ip::multicast::join_group(addr.to_v4(), listen_endpoint.address().to_v4()));
-		else
-			socket_->set_option(ip::multicast::join_group(addr));
+std::shared_ptr<udp_server> udp_server::acquire_shared(udp protocol) {
+	std::lock_guard<std::mutex> lock(shared_servers_mut);
+	auto &entry = shared_servers[protocol == udp::v6() ? 1 : 0];
+	auto result = entry.lock();
+	if (!result) {
+		result.reset(new udp_server(shared_pool(), protocol));
+		result->serve();
+		entry = result;
 	}
-	LOG_F(2, "%s: Started multicast udp server at %s port %d (addr %p)",
-		this->info_->name().c_str(), address.c_str(), port, (void *)this);
+	result->users_++;
+	return result;
+}
+
+std::shared_ptr<udp_server> udp_server::acquire_shared(
+	const std::string &address, uint16_t port, int ttl, const std::string &listen_address) {
+	std::lock_guard<std::mutex> lock(shared_servers_mut);
+	// servers that want a different TTL for their replies can't share a socket
+	auto &entry = shared_responders[address + ' ' + std::to_string(port) + ' ' +
+									std::to_string(ttl) + ' ' + listen_address];
+	auto result = entry.lock();
+	if (!result) {
+		result.reset(new udp_server(shared_pool(), address, port, ttl, listen_address));
+		result->serve();
+		entry = result;
+	}
+	result->users_++;
+	return result;
+}
+
+void udp_server::release_shared(const std::shared_ptr<udp_server> &shared) {
+	std::lock_guard<std::mutex> lock(shared_servers_mut);
+	if (--shared->users_) return;
+	for (auto &entry : shared_servers)
+		if (entry.lock() == shared) entry.reset();
+	for (auto it = shared_responders.begin(); it != shared_responders.end();)
+		it = it->second.lock() == shared ? shared_responders.erase(it) : std::next(it);
+	if (shared->interface_listener_ >= 0) remove_interface_listener(shared->interface_listener_);
+	shared->interface_listener_ = -1;
+	post(shared->io_, [shared]() {
+		lslboost::system::error_code ec;
+		shared->socket_->close(ec);
+	});
 }
 
 // === externally issued asynchronous commands ===
 
 void udp_server::begin_serving() {
-	// pre-calculate the shortinfo message (now that everyone should have initialized their part).
-	shortinfo_msg_ = info_->to_shortinfo_message();
+	// pre-calculate the shortinfo messages (now that everyone should have initialized their part);
+	// they're only serialized again if the stream's metadata changes
+	info_->cached_shortinfo_message();
+	info_->cached_shortinfo_binary();
+	if (shared_) {
+		std::lock_guard<std::mutex> lock(shared_->streams_mut_);
+		shared_->add_stream(info_);
+		return;
+	}
+	serve();
+}
+
+void udp_server::serve() {
+	if (!group_.is_unspecified()) {
+		// the socket joined the group on the default interface only
+		std::weak_ptr<udp_server> weak_this(shared_from_this());
+		asio::io_context *io = &io_;
+		interface_listener_ = add_interface_listener(
+			[weak_this, io](const std::vector<netif> &added, const std::vector<netif> &removed) {
+				post(*io, [weak_this, added, removed]() {
+					auto shared_this = weak_this.lock();
+					if (!shared_this || !shared_this->socket_->is_open()) return;
+					shared_this->update_memberships(removed, false);
+					shared_this->update_memberships(added, true);
+				});
+			});
+		update_memberships(get_local_interfaces(), true);
+	}
 	// start asking for a packet
 	request_next_packet();
+	if (announce_interval_ > 0) announce();
 }
 
 void udp_server::end_serving() {
+	if (shared_) {
+		std::lock_guard<std::mutex> lock(shared_->streams_mut_);
+		shared_->remove_stream(info_);
+		return;
+	}
+	// the io context might go away after this
+	if (interface_listener_ >= 0) remove_interface_listener(interface_listener_);
+	interface_listener_ = -1;
 	// gracefully close the socket; this will eventually lead to the cancellation of the IO
 	// operation(s) tied to its socket
-	auto sock(socket_); // socket shared ptr to be kept alive
-	post(io_, [sock]() {
+	post(io_, [shared_this = shared_from_this()]() {
+		auto &sock = *shared_this->socket_;
 		try {
-			if (sock->is_open()) sock->close();
+			if (shared_this->announce_interval_ > 0 && sock.is_open()) {
+				// tell the listeners right away that the stream is gone
+				shared_this->announce_timer_.cancel();
+				const std::string bye("LSL:announce\r\nbye\r\n" + shared_this->info_->uid());
+				lslboost::system::error_code ec;
+				sock.send_to(asio::buffer(bye), shared_this->announce_endpoint_, 0, ec);
+			}
+			if (sock.is_open()) sock.close();
 		} catch (std::exception &e) { LOG_F(ERROR, "Error during %s: %s", __func__, e.what()); }
 	});
 }
 
+std::size_t udp_server::memory_bytes() const {
+	// the receive buffers are allocated once, so their sizes don't change while they're used
+	std::size_t bytes = sizeof(*this) + batch_.capacity() * sizeof(received_datagram);
+	for (const auto &datagram : batch_) bytes += datagram.buffer.capacity();
+	return bytes;
+}
+
+/// The fields the shared servers index their streams by.
+static const char *const indexed_fields[] = {"name", "type", "source_id"};
+
+static const std::string &indexed_value(const stream_info_impl &info, int field) {
+	return field == 0 ? info.name() : field == 1 ? info.type() : info.source_id();
+}
+
+void udp_server::add_stream(const stream_info_impl_p &info) {
+	streams_.push_back(info);
+	for (int field = 0; field < 3; ++field)
+		index_[field][indexed_value(*info, field)].push_back(info);
+}
+
+void udp_server::remove_stream(const stream_info_impl_p &info) {
+	auto remove = [&info](std::vector<stream_info_impl_p> &streams) {
+		streams.erase(std::remove(streams.begin(), streams.end(), info), streams.end());
+	};
+	remove(streams_);
+	for (int field = 0; field < 3; ++field) {
+		auto bucket = index_[field].find(indexed_value(*info, field));
+		if (bucket == index_[field].end()) continue;
+		remove(bucket->second);
+		if (bucket->second.empty()) index_[field].erase(bucket);
+	}
+}
+
+const std::vector<stream_info_impl_p> &udp_server::candidates(const simple_query *query) const {
+	static const std::vector<stream_info_impl_p> none;
+	const std::vector<stream_info_impl_p> *result = &streams_;
+	if (!query) return *result;
+	// a stream has to have the value of each indexed field the query compares
+	for (int field = 0; field < 3; ++field) {
+		const std::string *value = query->value_of(indexed_fields[field]);
+		if (!value) continue;
+		auto bucket = index_[field].find(*value);
+		if (bucket == index_[field].end()) return none;
+		if (bucket->second.size() < result->size()) result = &bucket->second;
+	}
+	return *result;
+}
+
+void udp_server::announce() {
+	string_p msg(std::make_shared<std::string>(
+		"LSL:announce\r\nhello\r\n" + *info_->cached_shortinfo_message()));
+	socket_->async_send_to(asio::buffer(*msg), announce_endpoint_, [msg](err_t, std::size_t) {});
+	announce_timer_.expires_after(timeout_sec(announce_interval_));
+	announce_timer_.async_wait([shared_this = shared_from_this()](err_t err) {
+		if (!err && shared_this->socket_->is_open()) shared_this->announce();
+	});
+}
+
+void udp_server::update_memberships(const std::vector<netif> &interfaces, bool join) {
+	// an IPv6 interface stays a member as long as it has any address
+	const std::vector<netif> current = join ? std::vector<netif>() : get_local_interfaces();
+	for (const auto &netif : interfaces) {
+		if (netif.addr.is_v4() != group_.is_v4()) continue;
+		if (!join && std::any_of(current.begin(), current.end(), [&](const lsl::netif &other) {
+				return group_.is_v4() ? other.addr == netif.addr : other.ifindex == netif.ifindex;
+			}))
+			continue;
+		// errors are expected, e.g. for the interface that joined the group by default
+		lslboost::system::error_code ec;
+		if (group_.is_v4() && join)
+			socket_->set_option(ip::multicast::join_group(group_.to_v4(), netif.addr.to_v4()), ec);
+		else if (group_.is_v4())
+			socket_->set_option(ip::multicast::leave_group(group_.to_v4(), netif.addr.to_v4()), ec);
+		else if (join)
+			socket_->set_option(ip::multicast::join_group(group_.to_v6(), netif.ifindex), ec);
+		else
+			socket_->set_option(ip::multicast::leave_group(group_.to_v6(), netif.ifindex), ec);
+		if (!ec)
+			LOG_F(1, "%s the multicast group %s on %s", join ? "Joined" : "Left",
+				group_.to_string().c_str(), netif.addr.to_string().c_str());
+	}
+}
+
 // === receive / reply loop ===
 
 void udp_server::request_next_packet() {
 	DLOG_F(5, "udp_server::request_next_packet");
-	socket_->async_receive_from(asio::buffer(buffer_), remote_endpoint_,
-		[shared_this = shared_from_this()](
-			err_t err, std::size_t len) { shared_this->handle_receive_outcome(err, len); });
+	if (kernel_timestamps_ || datagram_batches_supported()) {
+		socket_->async_wait(udp::socket::wait_read, [shared_this = shared_from_this()](err_t err) {
+			if (err) return shared_this->handle_receive_outcome(err, 0);
+			lslboost::system::error_code ec;
+			const std::size_t count = receive_batch(
+				*shared_this->socket_, shared_this->batch_, shared_this->kernel_timestamps_, ec);
+			if (ec == asio::error::would_block) return shared_this->request_next_packet();
+			shared_this->handle_receive_outcome(ec, count);
+		});
+		return;
+	}
+	received_datagram &request = batch_.front();
+	socket_->async_receive_from(asio::buffer(request.buffer), request.sender,
+		[shared_this = shared_from_this()](err_t err, std::size_t len) {
+			received_datagram &request = shared_this->batch_.front();
+			request.size = len;
+			request.received_at = lsl_clock();
+			shared_this->handle_receive_outcome(err, 1);
+		});
 }
 
-void udp_server::process_shortinfo_request(std::istream& request_stream)
-{
+void udp_server::process_shortinfo_request(
+	std::istream &request_stream, const udp::endpoint &sender) {
+	discovery_stats &stats = discovery_stats::get();
+	const int64_t started = lsl_local_clock_ns();
+	discovery_stats::add(stats.requests_received);
 	std::string query;
 	getline(request_stream, query);
 	query = trim(query);
-	// parse return address, port, and query ID
+	// parse return address, port, query ID and the (optional) reply format
 	uint16_t return_port;
 	request_stream >> return_port;
-	std::string query_id;
-	request_stream >> query_id;
-	DLOG_F(2, "%p shortinfo req from %s for %s", (void *)this,
-		remote_endpoint_.address().to_string().c_str(), query.c_str());
-	// check query
-	if (info_->matches_query(query)) {
-		LOG_F(3, "%p query matches, replying to port %d", (void *)this, return_port);
-		// query matches: send back reply
-		udp::endpoint return_endpoint(remote_endpoint_.address(), return_port);
-		string_p replymsg(
-			std::make_shared<std::string>((query_id += "\r\n") += shortinfo_msg_));
-		socket_->async_send_to(asio::buffer(*replymsg), return_endpoint,
-			[shared_this = shared_from_this(), replymsg](err_t err_, std::size_t) {
-				if (err_ != asio::error::operation_aborted && err_ != asio::error::shut_down)
-					shared_this->request_next_packet();
-			});
+	std::string query_id, format;
+	request_stream >> query_id >> format;
+	DLOG_F(2, "%p shortinfo req from %s for %s", (void *)this, sender.address().to_string().c_str(),
+		query.c_str());
+	// the shared server answers for all of the process' streams
+	std::vector<stream_info_impl_p> matching;
+	if (info_) {
+		if (info_->matches_query(query)) matching.push_back(info_);
 	} else {
+		// the query is parsed once for all streams, and looked up in the index if it's simple
+		simple_query simple;
+		const bool is_simple = !query.empty() && simple.parse(query);
+		std::lock_guard<std::mutex> lock(streams_mut_);
+		for (const auto &info : candidates(is_simple ? &simple : nullptr))
+			if (is_simple ? info->matches_query(simple) : info->matches_query(query))
+				matching.push_back(info);
+	}
+	if (matching.empty()) {
 		DLOG_F(2, "%p query didn't match", (void *)this);
-		request_next_packet();
+		discovery_stats::add(stats.request_ns, lsl_local_clock_ns() - started);
+		return;
 	}
+	// query matches: queue the replies
+	LOG_F(3, "%p query matches, replying to port %d", (void *)this, return_port);
+	udp::endpoint return_endpoint(sender.address(), return_port);
+	query_id += "\r\n";
+	for (const auto &info : matching)
+		replies_.emplace_back(return_endpoint,
+			query_id + (format == "binary" ? *info->cached_shortinfo_binary()
+										   : *info->cached_shortinfo_message()));
+	discovery_stats::add(stats.replies_sent, matching.size());
+	discovery_stats::add(stats.request_ns, lsl_local_clock_ns() - started);
 }
 
-void udp_server::process_timedata_request(std::istream &request_stream, double t1) {
+void udp_server::process_timedata_request(
+	std::istream &request_stream, const udp::endpoint &sender, double t1) {
 	int wave_id;
 	request_stream >> wave_id;
 	double t0;
 	request_stream >> t0;
-	// send it off (including the time of packet submission and a shared ptr to the
-	// message content owned by the handler)
+	// queue the reply (including the time of packet submission)
 	std::ostringstream reply;
 	reply.precision(16);
 	reply << ' ' << wave_id << ' ' << t0 << ' ' << t1 << ' ' << lsl_clock();
-	string_p replymsg(std::make_shared<std::string>(reply.str()));
-	socket_->async_send_to(asio::buffer(*replymsg), remote_endpoint_,
-		[shared_this = shared_from_this(), replymsg](err_t err_, std::size_t) {
-			if (err_ != asio::error::operation_aborted && err_ != asio::error::shut_down)
-				shared_this->request_next_packet();
-		});
+	replies_.emplace_back(sender, reply.str());
 }
 
-void udp_server::handle_receive_outcome(err_t err, std::size_t len) {
-	DLOG_F(6, "udp_server::handle_receive_outcome (%lub)", len);
-	if (err) {
-		// non-critical error? Wait for the next packet
-		if (err != asio::error::operation_aborted || err != asio::error::shut_down)
-			request_next_packet();
+void udp_server::process_request(const received_datagram &request) {
+	if (request.truncated) {
+		LOG_F(WARNING, "%p udp_server: dropped an oversized request from %s", (void *)this,
+			request.sender.address().to_string().c_str());
 		return;
 	}
 	try {
-		// remember the time of packet reception for possible later use
-		double t1 = time_services_enabled_ ? lsl_clock() : 0.0;
+		// the time of packet reception for possible later use
+		double t1 = time_services_enabled_ ? request.received_at : 0.0;
 
 		// wrap received packet into a request stream and parse the method from it
-		std::istringstream request_stream(std::string(buffer_, buffer_ + len));
+		std::istringstream request_stream(
+			std::string(request.buffer.data(), request.buffer.data() + request.size));
 		std::string method;
 		getline(request_stream, method);
 		method = trim(method);
-		if (method == "LSL:shortinfo") {
+		if (method == "LSL:shortinfo")
 			// shortinfo request: parse content query string
-			process_shortinfo_request(request_stream);
-			return;
-		} else if (time_services_enabled_ && method == "LSL:timedata") {
+			process_shortinfo_request(request_stream, request.sender);
+		else if (time_services_enabled_ && method == "LSL:timedata")
 			// timedata request: parse time of original transmission
-			process_timedata_request(request_stream, t1);
-			return;
+			process_timedata_request(request_stream, request.sender, t1);
+		else if (method != "LSL:announce") {
+			// (another outlet's announcement is only of interest to resolvers)
+			DLOG_F(INFO, "%p Unknown method '%s' received by udp-server", (void *)this,
+				method.c_str());
 		}
-		DLOG_F(INFO, "%p Unknown method '%s' received by udp-server", (void *)this, method.c_str());
 	} catch (std::exception &e) {
 		LOG_F(
 			WARNING, "%p udp_server: hiccup during request processing: %s", (void *)this, e.what());
 	}
+}
+
+void udp_server::handle_receive_outcome(err_t err, std::size_t count) {
+	DLOG_F(6, "udp_server::handle_receive_outcome (%lu packets)", count);
+	if (err) {
+		// non-critical error? Wait for the next packet
+		if (err != asio::error::operation_aborted && err != asio::error::shut_down &&
+			socket_->is_open())
+			request_next_packet();
+		return;
+	}
+	replies_.clear();
+	for (std::size_t k = 0; k < count; ++k) process_request(batch_[k]);
+	outgoing_.clear();
+	for (const auto &reply : replies_)
+		outgoing_.push_back(outgoing_datagram{reply.first, asio::buffer(reply.second)});
+	send_replies(0);
+}
+
+void udp_server::send_replies(std::size_t first) {
+	while (first < outgoing_.size()) {
+		lslboost::system::error_code ec;
+		first += send_batch(*socket_, &outgoing_[first], outgoing_.size() - first, ec);
+		if (ec == asio::error::would_block) {
+			// the send buffer is full, so continue once there's room again
+			socket_->async_wait(udp::socket::wait_write,
+				[shared_this = shared_from_this(), first](err_t err) {
+					if (!err)
+						shared_this->send_replies(first);
+					else if (err != asio::error::operation_aborted &&
+							 shared_this->socket_->is_open())
+						shared_this->request_next_packet();
+				});
+			return;
+		}
+		if (ec == asio::error::operation_aborted || ec == asio::error::shut_down ||
+			!socket_->is_open())
+			return;
+		// e.g. an unreachable return address: skip that reply
+		if (ec) ++first;
+	}
 	request_next_packet();
 }
 } // namespace lsl
@@ -2,13 +2,23 @@
 #define UDP_SERVER_H
 
 #include "forward.h"
+#include "netinterfaces.h"
+#include "socket_utils.h"
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using asio::ip::udp;
 using err_t = const lslboost::system::error_code &;
 
 namespace lsl {
+class simple_query;
+
 /// shared pointer to a socket
 using udp_socket_p = std::shared_ptr<udp::socket>;
 
@@ -17,10 +27,26 @@ using udp_socket_p = std::shared_ptr<udp::socket>;
  *
  * Understands the following messages:
  *  - `LSL:shortinfo`. This is a request for the stream_info that comes with a query string (and a
- * return address). A packet is returned only if the query matches.
+ * return address). A packet is returned only if the query matches. If the request asks for the
+ * `binary` format, the reply holds the compact binary short-info instead of the xml one.
  *  - `LSL:timedata`. This is a request for time synchronization info that comes with a time stamp
  * (t0). The t0 stamp and two more time stamps (t1 and t2) are returned (similar to the NTP packet
  * exchange).
+ *
+ * In multicast mode, the group is joined on all local interfaces (unless a listen address is
+ * configured), and the memberships follow the changes of the interfaces. It also announces the
+ * stream on its multicast group if api_config::announce_interval() is set: `LSL:announce`
+ * followed by `hello` and the shortinfo message when it starts and periodically, or by `bye` and
+ * the stream's UID when it goes away.
+ *
+ * Where supported (Linux), the requests that queued up are received and the replies to them sent
+ * in batches, so a burst of queries or time probes doesn't cost a system call per packet.
+ *
+ * If api_config::shared_sockets() is set, the unicast servers of all outlets in the process hand
+ * their streams to one server per protocol that answers the requests for all of them. So do the
+ * multicast servers (to one server per group, port and TTL) unless they announce their streams. The
+ * shared servers index their streams by name, type and source id, so a simple query for one of
+ * them (see simple_query) is parsed once and only checked against the streams with that value.
  */
 class udp_server : public std::enable_shared_from_this<udp_server> {
 public:
@@ -45,6 +71,8 @@ public:
 	udp_server(const stream_info_impl_p &info, asio::io_context &io, const std::string &address,
 		uint16_t port, int ttl, const std::string &listen_address);
 
+	/// Destructor. Releases the shared server, if any.
+	~udp_server();
 
 	/// Start serving UDP traffic.
 	/// Call this only after the (shared) info object has been initialized by every involved party.
@@ -53,33 +81,106 @@ public:
 	/// Initiate teardown of UDP traffic.
 	void end_serving();
 
+	/// The memory of the server and its receive buffers, in bytes.
+	std::size_t memory_bytes() const;
+
+	/// The shared server that answers the requests for this server's stream (empty if none).
+	const std::shared_ptr<udp_server> &shared_server() const { return shared_; }
+
 private:
+	/// Create the server that is shared by the unicast servers of all outlets.
+	udp_server(std::shared_ptr<class io_context_pool> pool, udp protocol);
+
+	/// Create the server that is shared by the multicast servers of all outlets for a group.
+	udp_server(std::shared_ptr<class io_context_pool> pool, const std::string &address,
+		uint16_t port, int ttl, const std::string &listen_address);
+
+	/// Get the shared server for a protocol, creating it if it isn't in use.
+	static std::shared_ptr<udp_server> acquire_shared(udp protocol);
+
+	/// Get the shared multicast server for a group, creating it if it isn't in use.
+	static std::shared_ptr<udp_server> acquire_shared(const std::string &address, uint16_t port,
+		int ttl, const std::string &listen_address);
+
+	/// The shared pool the shared servers run in.
+	static std::shared_ptr<class io_context_pool> shared_pool();
+
+	/// Release a server returned by acquire_shared(); the last user closes it.
+	static void release_shared(const std::shared_ptr<udp_server> &shared);
+
+	/// Join the multicast group (if any) and start the receive loop and the announcements.
+	void serve();
+
+	/// Add a stream to the shared server's streams and their index (streams_mut_ has to be held).
+	void add_stream(const stream_info_impl_p &info);
+
+	/// Remove a stream from the shared server (streams_mut_ has to be held).
+	void remove_stream(const stream_info_impl_p &info);
+
+	/// The streams of the shared server that might match a query (streams_mut_ has to be held).
+	const std::vector<stream_info_impl_p> &candidates(const simple_query *query) const;
+
 	/// Initiate next packet request.
 	/// The result of the operation will eventually trigger the handle_receive_outcome() handler.
 	void request_next_packet();
 
-	/// Handler that gets called when a the next packet was received (or the op was cancelled).
-	void handle_receive_outcome(err_t err, std::size_t len);
+	/// Handler that gets called when the next packets were received (or the op was cancelled).
+	void handle_receive_outcome(err_t err, std::size_t count);
+
+	/// Process a received request, queueing the replies (if any) in replies_.
+	void process_request(const received_datagram &request);
 
 	/// Parse and process a LSL::shortinfo request
-	void process_shortinfo_request(std::istream& request_stream);
+	void process_shortinfo_request(std::istream &request_stream, const udp::endpoint &sender);
 
 	/// Parse and process a LSL::timedata request
-	void process_timedata_request(std::istream& request_stream, double t1);
+	void process_timedata_request(
+		std::istream &request_stream, const udp::endpoint &sender, double t1);
+
+	/// Send the queued replies from the given one on, then wait for the next requests.
+	void send_replies(std::size_t first);
+
+	/// Send a hello announcement and schedule the next one.
+	void announce();
+
+	/// Join or leave the multicast group on interfaces of its protocol.
+	void update_memberships(const std::vector<netif> &interfaces, bool join);
 
-	/// stream_info reference
+	/// stream_info reference (empty for the shared server)
 	stream_info_impl_p info_;
+	/// the pool that runs the shared server
+	std::shared_ptr<class io_context_pool> pool_;
 	/// IO service reference
 	asio::io_context &io_;
 	udp_socket_p socket_;
+	/// the shared server that answers the requests for this server's stream
+	std::shared_ptr<udp_server> shared_;
+	/// the streams that the shared server answers requests for
+	std::vector<stream_info_impl_p> streams_;
+	/// the streams_ by their name, type and source id (see candidates())
+	std::unordered_map<std::string, std::vector<stream_info_impl_p>> index_[3];
+	std::mutex streams_mut_;
+	/// the number of servers that acquired the shared server (protected by the registry mutex)
+	int users_{0};
 
-	/// a buffer of data (we're receiving on it)
-	char buffer_[65536]{0};
+	/// the slots the requests are received into
+	std::vector<received_datagram> batch_{make_datagram_batch()};
+	/// the replies to the current batch of requests and their return addresses
+	std::vector<std::pair<udp::endpoint, std::string>> replies_;
+	std::vector<outgoing_datagram> outgoing_;
 	bool time_services_enabled_;
-	/// the endpoint that we're currently talking to)
-	udp::endpoint remote_endpoint_;
-	/// pre-computed server response
-	std::string shortinfo_msg_;
+	/// whether the kernel time stamps the received requests
+	bool kernel_timestamps_{false};
+	/// the interval at which the stream is announced (0 if it isn't)
+	double announce_interval_{0.0};
+	/// the multicast group the announcements are sent to
+	udp::endpoint announce_endpoint_;
+	/// the multicast group that's joined on each interface (unspecified if none)
+	asio::ip::address group_;
+	/// the id of the listener for interface changes (-1 if there's none)
+	int interface_listener_{-1};
+	/// fires when the next announcement is due
+	asio::steady_timer announce_timer_;
 };
 } // namespace lsl
 
@@ -0,0 +1,69 @@
+#include "endian.hpp"
+#include <boost/endian/conversion.hpp>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LSL_ENDIAN_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LSL_ENDIAN_NEON
+#endif
+
+namespace {
+/// Reverse the byte order of the values in a 16 byte block
+template <std::size_t value_size> inline void reverse_block(char *p) {
+#if defined(LSL_ENDIAN_SSE2)
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+	// first reverse the order of the 16 bit words within each value...
+	if (value_size == 4)
+		v = _mm_shufflehi_epi16(
+			_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+	else if (value_size == 8)
+		v = _mm_shufflehi_epi16(
+			_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+	// ...then swap the bytes within each word
+	v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+#elif defined(LSL_ENDIAN_NEON)
+	uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+	v = value_size == 2 ? vrev16q_u8(v) : value_size == 4 ? vrev32q_u8(v) : vrev64q_u8(v);
+	vst1q_u8(reinterpret_cast<uint8_t *>(p), v);
+#else
+	(void)p;
+#endif
+}
+
+template <typename T> void reverse_n(char *p, std::size_t count) {
+	std::size_t k = 0;
+#if defined(LSL_ENDIAN_SSE2) || defined(LSL_ENDIAN_NEON)
+	for (const std::size_t per_block = 16 / sizeof(T); k + per_block <= count; k += per_block)
+		reverse_block<sizeof(T)>(p + k * sizeof(T));
+#endif
+	// scalar remainder; memcpy avoids unaligned accesses
+	for (; k < count; k++) {
+		T val;
+		memcpy(&val, p + k * sizeof(T), sizeof(T));
+		lslboost::endian::endian_reverse_inplace(val);
+		memcpy(p + k * sizeof(T), &val, sizeof(T));
+	}
+}
+} // namespace
+
+void lsl::endian_reverse_inplace_n(void *data, std::size_t value_size, std::size_t count) {
+	char *p = static_cast<char *>(data);
+	switch (value_size) {
+	case 1: break;
+	case sizeof(uint16_t): reverse_n<uint16_t>(p, count); break;
+	case 3:
+		// packed 24 bit values
+		for (char *e = p + 3 * count; p < e; p += 3) std::swap(p[0], p[2]);
+		break;
+	case sizeof(uint32_t): reverse_n<uint32_t>(p, count); break;
+	case sizeof(uint64_t): reverse_n<uint64_t>(p, count); break;
+	default: throw std::runtime_error("Unsupported channel format for endian conversion.");
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+namespace lsl {
+/**
+ * Reverse the byte order of `count` consecutive values of `value_size` (2, 3, 4 or 8) bytes in
+ * place.
+ *
+ * Uses SSE2 or NEON (both are part of the baseline x86-64 / AArch64 instruction sets) for the bulk
+ * of the data and falls back to a scalar loop for the remainder and on other platforms.
+ */
+void endian_reverse_inplace_n(void *data, std::size_t value_size, std::size_t count);
+} // namespace lsl
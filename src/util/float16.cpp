@@ -0,0 +1,78 @@
+#include "float16.hpp"
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#define LSL_FLOAT16_F16C
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define LSL_FLOAT16_NEON
+#endif
+
+uint16_t lsl::float_to_half(float value) {
+	uint32_t x;
+	memcpy(&x, &value, sizeof(x));
+	const auto sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+	x &= 0x7fffffff;
+	// infinity and NaN (keeping it a quiet NaN)
+	if (x >= 0x7f800000) return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+	// values from 65520 on round to infinity
+	if (x >= 0x477ff000) return sign | 0x7c00;
+	if (x < 0x38800000) {
+		// subnormal results (and zero)
+		if (x < 0x33000000) return sign;
+		const uint32_t shift = 126 - (x >> 23), mantissa = (x & 0x7fffff) | 0x800000;
+		uint32_t half = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+		return static_cast<uint16_t>(sign | half);
+	}
+	// rebias the exponent and round the mantissa to nearest even
+	x += 0xc8000fff + ((x >> 13) & 1);
+	return static_cast<uint16_t>(sign | (x >> 13));
+}
+
+float lsl::half_to_float(uint16_t bits) {
+	const uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+	uint32_t exponent = (bits >> 10) & 0x1f, mantissa = bits & 0x3ff, x;
+	if (exponent == 0x1f)
+		x = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent)
+		x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (!mantissa)
+		x = sign;
+	else {
+		// normalize the subnormal value
+		for (exponent = 113; !(mantissa & 0x400); --exponent) mantissa <<= 1;
+		x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	float value;
+	memcpy(&value, &x, sizeof(value));
+	return value;
+}
+
+void lsl::float_to_half_n(uint16_t *dst, const float *src, std::size_t n) {
+	std::size_t k = 0;
+#if defined(LSL_FLOAT16_F16C)
+	for (; k + 8 <= n; k += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + k),
+			_mm256_cvtps_ph(_mm256_loadu_ps(src + k), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(LSL_FLOAT16_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1_u16(dst + k, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + k))));
+#endif
+	for (; k < n; ++k) dst[k] = float_to_half(src[k]);
+}
+
+void lsl::half_to_float_n(float *dst, const uint16_t *src, std::size_t n) {
+	std::size_t k = 0;
+#if defined(LSL_FLOAT16_F16C)
+	for (; k + 8 <= n; k += 8)
+		_mm256_storeu_ps(dst + k,
+			_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k))));
+#elif defined(LSL_FLOAT16_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1q_f32(dst + k, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + k))));
+#endif
+	for (; k < n; ++k) dst[k] = half_to_float(src[k]);
+}
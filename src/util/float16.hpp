@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace lsl {
+/**
+ * Convert n floats to IEEE 754 half precision values (rounding to nearest even).
+ *
+ * Uses F16C (if the compiler targets it) or the FP16 conversions of AArch64 for the bulk of the
+ * data and falls back to float_to_half() for the remainder and on other platforms.
+ */
+void float_to_half_n(uint16_t *dst, const float *src, std::size_t n);
+
+/// Convert n IEEE 754 half precision values to floats, see float_to_half_n().
+void half_to_float_n(float *dst, const uint16_t *src, std::size_t n);
+
+/// Convert a float to an IEEE 754 half precision value (rounding to nearest even).
+uint16_t float_to_half(float value);
+
+/// Convert an IEEE 754 half precision value to a float.
+float half_to_float(uint16_t bits);
+} // namespace lsl
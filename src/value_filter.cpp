@@ -0,0 +1,131 @@
+#include "value_filter.h"
+#include "sample.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace lsl;
+
+namespace {
+template <class T> double value_at(const char *raw, uint32_t channel) {
+	T value;
+	memcpy(&value, raw + channel * sizeof(T), sizeof(T));
+	return static_cast<double>(value);
+}
+
+double numeric_value(const sample &s, uint32_t channel) {
+	const char *raw = s.raw_data();
+	switch (s.format()) {
+	case cft_float32: return value_at<float>(raw, channel);
+	case cft_double64: return value_at<double>(raw, channel);
+	case cft_int8: return value_at<int8_t>(raw, channel);
+	case cft_int16: return value_at<int16_t>(raw, channel);
+	case cft_int24: return value_at<detail::int24>(raw, channel);
+	case cft_int32: return value_at<int32_t>(raw, channel);
+	case cft_int64: return value_at<int64_t>(raw, channel);
+	case cft_float16: return value_at<detail::float16>(raw, channel);
+	default: throw std::invalid_argument("Unsupported channel format.");
+	}
+}
+
+std::string to_hex(const std::string &s) {
+	static const char digits[] = "0123456789abcdef";
+	std::string result;
+	result.reserve(2 * s.size());
+	for (unsigned char c : s) {
+		result.push_back(digits[c >> 4]);
+		result.push_back(digits[c & 0xF]);
+	}
+	return result;
+}
+
+int hex_digit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	throw std::invalid_argument("Malformed value filter.");
+}
+
+std::string from_hex(const std::string &hex) {
+	if (hex.size() % 2) throw std::invalid_argument("Malformed value filter.");
+	std::string result;
+	for (std::size_t k = 0; k < hex.size(); k += 2)
+		result.push_back(static_cast<char>(hex_digit(hex[k]) * 16 + hex_digit(hex[k + 1])));
+	return result;
+}
+} // namespace
+
+value_filter::value_filter(std::vector<std::string> values, std::vector<std::string> prefixes,
+	std::vector<std::pair<double, double>> ranges)
+	: values_(std::move(values)), prefixes_(std::move(prefixes)), ranges_(std::move(ranges)) {
+	std::sort(values_.begin(), values_.end());
+	values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+}
+
+void value_filter::validate(lsl_channel_format_t format) const {
+	if (format == cft_string && !ranges_.empty())
+		throw std::invalid_argument("String streams can only be filtered by values and prefixes.");
+	if (format != cft_string && (!values_.empty() || !prefixes_.empty()))
+		throw std::invalid_argument("Numeric streams can only be filtered by ranges.");
+	for (const auto &range : ranges_)
+		if (!(range.first <= range.second))
+			throw std::invalid_argument("A range's lower bound is above its upper bound.");
+}
+
+bool value_filter::matches(const sample &s, uint32_t channel) const {
+	if (empty()) return true;
+	if (s.format() == cft_string) {
+		const std::string &value = s.string_data()[channel];
+		if (std::binary_search(values_.begin(), values_.end(), value)) return true;
+		return std::any_of(prefixes_.begin(), prefixes_.end(),
+			[&value](const std::string &prefix) {
+				return value.compare(0, prefix.size(), prefix) == 0;
+			});
+	}
+	const double value = numeric_value(s, channel);
+	return std::any_of(ranges_.begin(), ranges_.end(), [value](const std::pair<double, double> &r) {
+		return value >= r.first && value <= r.second;
+	});
+}
+
+std::string value_filter::to_string() const {
+	std::ostringstream text;
+	text.precision(17);
+	const char *separator = "";
+	for (const auto &value : values_) {
+		text << separator << 'v' << to_hex(value);
+		separator = ",";
+	}
+	for (const auto &prefix : prefixes_) {
+		text << separator << 'p' << to_hex(prefix);
+		separator = ",";
+	}
+	for (const auto &range : ranges_) {
+		text << separator << 'r' << range.first << ':' << range.second;
+		separator = ",";
+	}
+	return text.str();
+}
+
+value_filter value_filter::parse(const std::string &text) {
+	std::vector<std::string> values, prefixes;
+	std::vector<std::pair<double, double>> ranges;
+	std::istringstream terms(text);
+	for (std::string term; std::getline(terms, term, ',');) {
+		if (term.empty()) throw std::invalid_argument("Malformed value filter.");
+		const std::string rest = term.substr(1);
+		if (term[0] == 'v')
+			values.push_back(from_hex(rest));
+		else if (term[0] == 'p')
+			prefixes.push_back(from_hex(rest));
+		else if (term[0] == 'r') {
+			const auto colon = rest.find(':');
+			if (colon == std::string::npos) throw std::invalid_argument("Malformed value filter.");
+			ranges.emplace_back(
+				std::stod(rest.substr(0, colon)), std::stod(rest.substr(colon + 1)));
+		} else
+			throw std::invalid_argument("Malformed value filter.");
+	}
+	return value_filter(std::move(values), std::move(prefixes), std::move(ranges));
+}
@@ -0,0 +1,63 @@
+#ifndef VALUE_FILTER_H
+#define VALUE_FILTER_H
+
+#include "common.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lsl {
+class sample;
+
+/**
+ * A predicate on a channel's value, so a consumer of a marker stream only receives the events it
+ * is interested in.
+ *
+ * A sample of a string stream matches if the value equals one of the values or starts with one
+ * of the prefixes, a sample of a numeric stream if the value lies in one of the (inclusive)
+ * ranges. An empty filter matches all samples.
+ *
+ * Outlets that support it apply the filter before serializing the samples (see the
+ * `Value-Filter` feed header and to_string()), otherwise the inlet applies it.
+ */
+class value_filter {
+public:
+	value_filter() = default;
+
+	value_filter(std::vector<std::string> values, std::vector<std::string> prefixes,
+		std::vector<std::pair<double, double>> ranges);
+
+	/// Whether the filter matches all samples.
+	bool empty() const { return values_.empty() && prefixes_.empty() && ranges_.empty(); }
+
+	/// Check if the filter fits a stream's format.
+	/// @throws std::invalid_argument for string terms on a numeric stream or vice versa, or a
+	/// range whose lower bound is above its upper bound.
+	void validate(lsl_channel_format_t format) const;
+
+	/// Whether the value of a channel of a sample matches; the sample must have the format the
+	/// filter was validated for.
+	bool matches(const sample &s, uint32_t channel = 0) const;
+
+	/**
+	 * The filter as the value of a feed header: comma-separated terms of a `v` (value) or `p`
+	 * (prefix) followed by the string's bytes in hex, so the header's case folding keeps them
+	 * intact, or an `r` followed by the bounds (`r[lower]:[upper]`).
+	 */
+	std::string to_string() const;
+
+	/// Parse a filter from to_string().
+	/// @throws std::invalid_argument if the text is malformed.
+	static value_filter parse(const std::string &text);
+
+private:
+	/// sorted, for a binary search
+	std::vector<std::string> values_;
+	std::vector<std::string> prefixes_;
+	std::vector<std::pair<double, double>> ranges_;
+};
+
+} // namespace lsl
+
+#endif
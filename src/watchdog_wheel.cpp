@@ -0,0 +1,105 @@
+#include "watchdog_wheel.h"
+#include "api_config.h"
+#include <algorithm>
+#include <loguru.hpp>
+#include <thread>
+
+using namespace lsl;
+
+/// the number of slots of a wheel
+static const std::size_t num_slots = 8;
+
+watchdog_wheel::watchdog_wheel(double interval)
+	: tick_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		  std::chrono::duration<double>(interval / num_slots))),
+	  slots_(num_slots) {
+	thread_ = managed_thread(lsl_thread_watchdog, "W_wheel", &watchdog_wheel::run, this);
+}
+
+watchdog_wheel::~watchdog_wheel() {
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		stop_ = true;
+	}
+	wakeup_.notify_all();
+	thread_.join();
+}
+
+std::shared_ptr<watchdog_wheel> watchdog_wheel::shared() {
+	static std::mutex wheel_mut;
+	static std::weak_ptr<watchdog_wheel> wheel;
+	std::lock_guard<std::mutex> lock(wheel_mut);
+	auto result = wheel.lock();
+	if (!result) {
+		result = std::make_shared<watchdog_wheel>(
+			api_config::get_instance()->watchdog_check_interval());
+		wheel = result;
+	}
+	return result;
+}
+
+uint64_t watchdog_wheel::add(std::function<void()> check) {
+	std::lock_guard<std::mutex> lock(mut_);
+	const uint64_t id = next_id_++;
+	slots_[id % num_slots].push_back(entry{id, std::move(check)});
+	if (size_++ == 0) wakeup_.notify_all();
+	return id;
+}
+
+void watchdog_wheel::remove(uint64_t id) {
+	std::unique_lock<std::mutex> lock(mut_);
+	// a check that removes itself doesn't wait for itself
+	if (thread_.get_id() != std::this_thread::get_id())
+		finished_.wait(lock, [this, id]() { return running_ != id; });
+	const std::size_t slot = id % num_slots;
+	auto &checks = slots_[slot];
+	auto it = std::find_if(
+		checks.begin(), checks.end(), [id](const entry &e) { return e.id == id; });
+	if (it == checks.end()) return;
+	// the checks after the running one move up
+	const auto index = static_cast<std::size_t>(it - checks.begin());
+	if (running_ && slot == current_ && index <= running_index_) --running_index_;
+	checks.erase(it);
+	--size_;
+}
+
+std::size_t watchdog_wheel::size() {
+	std::lock_guard<std::mutex> lock(mut_);
+	return size_;
+}
+
+void watchdog_wheel::run() {
+	std::unique_lock<std::mutex> lock(mut_);
+	auto next_tick = std::chrono::steady_clock::now();
+	while (!stop_) {
+		if (!size_) {
+			wakeup_.wait(lock, [this]() { return stop_ || size_; });
+			next_tick = std::chrono::steady_clock::now() + tick_;
+			continue;
+		}
+		// skip the empty slots
+		while (slots_[current_].empty()) {
+			current_ = (current_ + 1) % num_slots;
+			next_tick += tick_;
+		}
+		if (wakeup_.wait_until(lock, next_tick, [this]() { return stop_; })) break;
+		auto &checks = slots_[current_];
+		for (running_index_ = 0; running_index_ < checks.size(); ++running_index_) {
+			running_ = checks[running_index_].id;
+			const auto check = checks[running_index_].check;
+			lock.unlock();
+			try {
+				check();
+			} catch (std::exception &e) {
+				LOG_F(ERROR, "Unexpected hiccup in the watchdog: %s", e.what());
+			}
+			lock.lock();
+			running_ = 0;
+			finished_.notify_all();
+		}
+		current_ = (current_ + 1) % num_slots;
+		next_tick += tick_;
+		// don't catch up on ticks that were missed, e.g. because the system was suspended
+		next_tick = std::max(next_tick, std::chrono::steady_clock::now());
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef WATCHDOG_WHEEL_H
+#define WATCHDOG_WHEEL_H
+
+#include "thread_policy.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lsl {
+
+/**
+ * A timer wheel that runs periodic checks (e.g. the watchdogs of all inlet connections) in a
+ * single thread.
+ *
+ * The wheel has a fixed number of slots, each check is hashed into one of them, and one slot is
+ * run per tick, so each check runs once per interval and the thread only wakes up for the slots
+ * that have checks (and sleeps while there are none at all).
+ */
+class watchdog_wheel {
+public:
+	/// Start the thread, with each check being run once per interval (in seconds).
+	explicit watchdog_wheel(double interval);
+
+	/// Stop and join the thread.
+	~watchdog_wheel();
+
+	watchdog_wheel(const watchdog_wheel &) = delete;
+	watchdog_wheel &operator=(const watchdog_wheel &) = delete;
+
+	/**
+	 * Get the wheel shared by all inlet connections in the process.
+	 *
+	 * It's created on first use with an interval of api_config::watchdog_check_interval() and
+	 * goes away (like io_context_pool::inlet_pool()) once the last user is gone.
+	 */
+	static std::shared_ptr<watchdog_wheel> shared();
+
+	/**
+	 * Add a check. It's run in the wheel's thread, so it shouldn't block (or destroy the wheel).
+	 * @return The id to remove it with.
+	 */
+	uint64_t add(std::function<void()> check);
+
+	/// Remove a check, waits for it to finish if it's running.
+	void remove(uint64_t id);
+
+	/// The number of checks.
+	std::size_t size();
+
+private:
+	struct entry {
+		uint64_t id;
+		std::function<void()> check;
+	};
+
+	/// The wheel's thread.
+	void run();
+
+	const std::chrono::steady_clock::duration tick_;
+	/// protects the following fields
+	std::mutex mut_;
+	/// wakes up the thread when a check is added or the wheel is stopped
+	std::condition_variable wakeup_;
+	/// notified when a check has finished
+	std::condition_variable finished_;
+	std::vector<std::vector<entry>> slots_;
+	std::size_t size_{0};
+	uint64_t next_id_{1};
+	/// the slot that is run next (or is running) and the index of the running check in it
+	std::size_t current_{0}, running_index_{0};
+	/// the id of the running check (0 if none)
+	uint64_t running_{0};
+	bool stop_{false};
+	managed_thread thread_;
+};
+
+} // namespace lsl
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef WINDOW_BUFFER_H
+#define WINDOW_BUFFER_H
+
+#include "common.h"
+#include "mirrored_memory.h"
+#include "sample.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace lsl {
+
+/**
+ * The recent history of an inlet's samples in a ring of mirrored memory (see mirrored_memory),
+ * so any window of it can be borrowed as a single contiguous block.
+ *
+ * The k-th sample since the registration goes into slot `k % capacity()`: its channel values,
+ * converted to the element type, to `data + slot * channels`, its time stamp to
+ * `timestamps + slot`. Since both rings are mapped twice, the last n samples always start at
+ * their first slot, even if they wrap around. The data thread overwrites the oldest samples,
+ * except those of a borrowed window: samples that would overwrite it are dropped.
+ */
+class window_buffer {
+public:
+	/// A contiguous window of the most recent samples.
+	struct window {
+		const void *data;
+		const double *timestamps;
+		uint32_t count;
+		/// the index of the first sample, counted since the registration
+		uint64_t first;
+	};
+
+	/**
+	 * The first parameter (e.g. a null pointer) selects the element type T.
+	 * @param min_capacity The number of samples to keep at least; it's rounded up so that both
+	 * rings are a multiple of mirrored_memory::granularity().
+	 * @param retrieve The kernel that converts the channel data to T.
+	 * @throws std::invalid_argument for an empty ring, std::runtime_error if it can't be mapped.
+	 */
+	template <class T>
+	window_buffer(T *, uint32_t min_capacity, uint32_t channels,
+		typename typed_kernels<T>::retrieve_fn retrieve) {
+		if (!min_capacity || !channels)
+			throw std::invalid_argument("The window buffer must not be empty.");
+		const uint64_t unit = capacity_unit(channels * sizeof(T));
+		const uint64_t capacity = (min_capacity + unit - 1) / unit * unit;
+		if (capacity > UINT32_MAX)
+			throw std::invalid_argument("The window buffer is too large.");
+		capacity_ = static_cast<uint32_t>(capacity);
+		data_.reset(new mirrored_memory(std::size_t{capacity_} * channels * sizeof(T)));
+		timestamps_.reset(new mirrored_memory(std::size_t{capacity_} * sizeof(double)));
+		T *data = reinterpret_cast<T *>(data_->data());
+		// a range that wraps around continues in the second mapping
+		store_ = [data, channels, retrieve](const sample_p *samples, std::size_t n, uint32_t slot) {
+			for (std::size_t k = 0; k < n; ++k)
+				samples[k]->retrieve_typed(data + (slot + k) * channels, retrieve);
+		};
+	}
+
+	/// The number of samples the ring holds.
+	uint32_t capacity() const { return capacity_; }
+
+	/// Write the received samples and their post-processed time stamps (from the data thread);
+	/// 0 samples signal a lost stream.
+	void write(const sample_p *samples, const double *timestamps, std::size_t n) {
+		std::lock_guard<std::mutex> lock(mut_);
+		lost_ = !n;
+		if (borrowed_) {
+			const uint64_t free = borrowed_first_ + capacity_ - written_;
+			if (n > free) {
+				dropped_ += n - free;
+				n = static_cast<std::size_t>(free);
+			}
+		} else if (n > capacity_) {
+			// only the newest samples would remain
+			const std::size_t skip = n - capacity_;
+			samples += skip;
+			timestamps += skip;
+			written_ += skip;
+			n = capacity_;
+		}
+		if (n) {
+			const auto slot = static_cast<uint32_t>(written_ % capacity_);
+			store_(samples, n, slot);
+			std::copy(timestamps, timestamps + n,
+				reinterpret_cast<double *>(timestamps_->data()) + slot);
+			written_ += n;
+		}
+		cond_.notify_all();
+	}
+
+	/**
+	 * Borrow the most recent count samples until release().
+	 *
+	 * Waits until at least count samples have been written and, if a window was borrowed
+	 * before, at least one sample is newer than that window.
+	 * @return The window, or an empty one if the timeout expired.
+	 * @throws std::invalid_argument if the window is larger than the ring or the previous one
+	 * hasn't been released, lost_error if the stream has been lost.
+	 */
+	window borrow(uint32_t count, double timeout) {
+		if (!count || count > capacity_)
+			throw std::invalid_argument("The window must hold between 1 and capacity() samples.");
+		std::unique_lock<std::mutex> lock(mut_);
+		if (borrowed_) throw std::invalid_argument("The previous window hasn't been released.");
+		const auto ready = [&]() { return lost_ || (written_ >= count && written_ > last_end_); };
+		if (!cond_.wait_for(lock, std::chrono::duration<double>(timeout), ready))
+			return window{nullptr, nullptr, 0, written_};
+		if (lost_) throw lost_error("The stream read by this inlet has been lost.");
+		const uint64_t first = written_ - count;
+		const auto slot = static_cast<uint32_t>(first % capacity_);
+		borrowed_ = true;
+		borrowed_first_ = first;
+		last_end_ = written_;
+		return window{data_->data() + std::size_t{slot} * (data_->size() / capacity_),
+			reinterpret_cast<const double *>(timestamps_->data()) + slot, count, first};
+	}
+
+	/**
+	 * Let the data thread overwrite the borrowed window again.
+	 * @throws std::invalid_argument if no window is borrowed.
+	 */
+	void release() {
+		std::lock_guard<std::mutex> lock(mut_);
+		if (!borrowed_) throw std::invalid_argument("No window is borrowed.");
+		borrowed_ = false;
+	}
+
+	/// Whether a window is borrowed.
+	bool borrowed() {
+		std::lock_guard<std::mutex> lock(mut_);
+		return borrowed_;
+	}
+
+	/// The number of samples that were dropped because they would have overwritten a window.
+	uint64_t dropped() {
+		std::lock_guard<std::mutex> lock(mut_);
+		return dropped_;
+	}
+
+private:
+	/// the smallest number of samples that fills whole units of mirrored memory in both rings
+	static uint64_t capacity_unit(std::size_t sample_bytes) {
+		const auto gcd = [](uint64_t a, uint64_t b) {
+			while (b) a = std::exchange(b, a % b);
+			return a;
+		};
+		const uint64_t granularity = mirrored_memory::granularity();
+		const uint64_t data_unit = granularity / gcd(granularity, sample_bytes);
+		const uint64_t stamp_unit = granularity / gcd(granularity, sizeof(double));
+		return data_unit / gcd(data_unit, stamp_unit) * stamp_unit;
+	}
+
+	/// write n samples to the slots starting at slot (possibly into the second mapping)
+	std::function<void(const sample_p *, std::size_t, uint32_t)> store_;
+	std::unique_ptr<mirrored_memory> data_, timestamps_;
+	uint32_t capacity_;
+	/// protects the following fields
+	std::mutex mut_;
+	/// signaled when samples were written or the stream was lost
+	std::condition_variable cond_;
+	/// the number of samples written so far
+	uint64_t written_{0};
+	/// the end of the last borrowed window
+	uint64_t last_end_{0};
+	/// the first sample of the borrowed window, if borrowed_
+	uint64_t borrowed_first_{0};
+	bool borrowed_{false};
+	/// whether the last write signaled a lost stream
+	bool lost_{false};
+	uint64_t dropped_{0};
+};
+
+} // namespace lsl
+
+#endif
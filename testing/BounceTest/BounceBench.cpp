@@ -0,0 +1,286 @@
+#include "../../include/lsl_cpp.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * Round-trip latency between two hosts: the initiator (host A) pushes chunks to a request outlet,
+ * the responder (host B) echoes each request stream through a reply outlet, and the initiator
+ * measures the time until the last sample of each chunk came back.
+ *
+ * Start `lsl_bouncebench --respond` on host B, then `lsl_bouncebench` on host A. Every
+ * combination of the swept payload sizes, chunk sizes and transfer priorities is measured with
+ * its own pair of streams and reported with the p50/p99/p99.9/max round-trip times. Transports
+ * that are configured process-wide (e.g. `DatagramData` in the [tuning] section) are compared by
+ * running both ends with different config files (see the LSLAPICFG environment variable).
+ */
+
+namespace {
+
+struct options {
+	bool respond = false, loopback = false, json = false;
+	std::vector<uint32_t> channels{1, 16, 256}, chunks{1, 8, 64};
+	std::vector<std::string> modes{"normal", "latency"};
+	int iterations = 1000, warmup = 20;
+	std::map<lsl_thread_role_t, std::vector<uint32_t>> role_cpus;
+	std::vector<uint32_t> app_cpus;
+	std::string type = "BounceRequest";
+};
+
+const std::map<std::string, lsl::transfer_priority_t> priorities = {
+	{"bulk", lsl::priority_bulk}, {"normal", lsl::priority_normal},
+	{"latency", lsl::priority_latency}};
+
+const std::map<std::string, lsl_thread_role_t> roles = {{"io", lsl_thread_io},
+	{"transfer", lsl_thread_transfer}, {"data", lsl_thread_data}};
+
+void usage() {
+	std::cout
+		<< "Usage: lsl_bouncebench [options]\n"
+		   "  --respond          echo the request streams of the initiators (host B)\n"
+		   "  --loopback         also run the responder in this process\n"
+		   "  --channels LIST    double64 channels per sample to sweep (default 1,16,256)\n"
+		   "  --chunks LIST      samples per pushed chunk to sweep (default 1,8,64)\n"
+		   "  --modes LIST       transfer priorities to sweep: bulk, normal, latency "
+		   "(default normal,latency)\n"
+		   "  --iterations N     round trips per combination (default 1000)\n"
+		   "  --warmup N         round trips before measuring (default 20)\n"
+		   "  --pin ROLE=LIST    run the liblsl threads of a role (io, transfer, data) on "
+		   "these CPUs\n"
+		   "  --app-cpus LIST    run the benchmark's own threads on these CPUs (Linux only)\n"
+		   "  --type TYPE        stream type of the request streams (default BounceRequest)\n"
+		   "  --json             print each result as a line of JSON\n";
+}
+
+std::vector<uint32_t> parse_list(const std::string &list) {
+	std::vector<uint32_t> values;
+	std::istringstream is(list);
+	for (std::string item; std::getline(is, item, ',');)
+		if (!item.empty()) values.push_back(static_cast<uint32_t>(std::stoul(item)));
+	return values;
+}
+
+std::vector<std::string> parse_names(const std::string &list) {
+	std::vector<std::string> names;
+	std::istringstream is(list);
+	for (std::string item; std::getline(is, item, ',');)
+		if (!item.empty()) names.push_back(item);
+	return names;
+}
+
+options parse_options(int argc, char *argv[]) {
+	options opt;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg(argv[i]);
+			if (arg == "--respond" || arg == "--loopback" || arg == "--json") {
+				opt.respond |= arg == "--respond";
+				opt.loopback |= arg == "--loopback";
+				opt.json |= arg == "--json";
+				continue;
+			}
+			if (arg == "--help" || i + 1 == argc) {
+				usage();
+				std::exit(arg == "--help" ? 0 : 1);
+			}
+			const std::string value = argv[++i];
+			if (arg == "--channels")
+				opt.channels = parse_list(value);
+			else if (arg == "--chunks")
+				opt.chunks = parse_list(value);
+			else if (arg == "--modes")
+				opt.modes = parse_names(value);
+			else if (arg == "--iterations")
+				opt.iterations = std::atoi(value.c_str());
+			else if (arg == "--warmup")
+				opt.warmup = std::atoi(value.c_str());
+			else if (arg == "--pin") {
+				const auto eq = value.find('=');
+				opt.role_cpus[roles.at(value.substr(0, eq))] = parse_list(value.substr(eq + 1));
+			} else if (arg == "--app-cpus")
+				opt.app_cpus = parse_list(value);
+			else if (arg == "--type")
+				opt.type = value;
+			else
+				throw std::invalid_argument(arg);
+		}
+		for (const auto &mode : opt.modes) priorities.at(mode);
+	} catch (std::exception &) {
+		usage();
+		std::exit(1);
+	}
+	if (opt.channels.empty() || opt.chunks.empty() || opt.modes.empty() || opt.iterations < 1 ||
+		std::count(opt.channels.begin(), opt.channels.end(), 0u) ||
+		std::count(opt.chunks.begin(), opt.chunks.end(), 0u)) {
+		usage();
+		std::exit(1);
+	}
+	return opt;
+}
+
+/// Pin the calling thread to the CPUs of --app-cpus.
+void pin_app_thread(const options &opt) {
+	if (opt.app_cpus.empty()) return;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (uint32_t cpu : opt.app_cpus)
+		if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		std::cerr << "Could not pin the thread to the --app-cpus." << std::endl;
+#else
+	std::cerr << "--app-cpus is only supported on Linux." << std::endl;
+#endif
+}
+
+std::atomic<bool> stop{false};
+
+/// Echo the samples of a request stream until it's gone.
+void echo(lsl::stream_info request, const options &opt) {
+	pin_app_thread(opt);
+	try {
+		lsl::stream_inlet inlet(request, 360, 0, false);
+		lsl::stream_info full = inlet.info(5.);
+		const std::string mode = full.desc().child_value("priority");
+		if (priorities.count(mode)) inlet.set_priority(priorities.at(mode));
+		lsl::stream_outlet outlet(lsl::stream_info("reply_" + request.source_id(), "BounceReply",
+			request.channel_count(), lsl::IRREGULAR_RATE, lsl::cf_double64,
+			"reply_" + request.source_id()));
+		inlet.open_stream(5.);
+
+		// wait for the first sample, then take whatever else arrived with it
+		const int32_t nchan = request.channel_count();
+		std::vector<double> data(nchan * 1024), timestamps(1024);
+		while (!stop) {
+			timestamps[0] = inlet.pull_sample(data.data(), nchan, .2);
+			if (timestamps[0] == 0.) continue;
+			const std::size_t n = nchan + inlet.pull_chunk_multiplexed(data.data() + nchan,
+											  timestamps.data() + 1, data.size() - nchan,
+											  timestamps.size() - 1, 0.);
+			outlet.push_chunk_multiplexed(data.data(), timestamps.data(), n, true);
+		}
+	} catch (lsl::lost_error &) {
+	} catch (lsl::timeout_error &) {
+		// the request stream is gone (lost streams are reported as timeout_error)
+	} catch (std::exception &e) { std::cerr << "Responder error: " << e.what() << std::endl; }
+}
+
+/// Start an echo thread for each new request stream.
+void respond(const options &opt) {
+	lsl::continuous_resolver resolver("type", opt.type);
+	std::set<std::string> seen;
+	std::list<std::thread> threads;
+	while (!stop) {
+		for (const auto &info : resolver.results())
+			if (seen.insert(info.uid()).second) {
+				std::cerr << "Echoing " << info.name() << '@' << info.hostname() << std::endl;
+				threads.emplace_back(echo, info, std::cref(opt));
+			}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	for (auto &thread : threads) thread.join();
+}
+
+struct result {
+	double p50, p99, p999, max;
+};
+
+/// Measure the round trips of one combination; throws if the replies stop.
+result measure(uint32_t nchan, uint32_t chunk, const std::string &mode, const options &opt) {
+	const std::string id = "bounce_" + std::to_string(nchan) + "x" + std::to_string(chunk) + "_" +
+						   mode + "_" + std::to_string(lsl::local_clock());
+	lsl::stream_info info(id, opt.type, (int32_t)nchan, lsl::IRREGULAR_RATE, lsl::cf_double64, id);
+	info.desc().append_child_value("priority", mode);
+	lsl::stream_outlet outlet(info);
+
+	auto found = lsl::resolve_stream("source_id", "reply_" + id, 1, 10.);
+	if (found.empty()) throw std::runtime_error("no responder answered (is one running?)");
+	lsl::stream_inlet inlet(found[0], 360, 0, false);
+	inlet.set_priority(priorities.at(mode));
+	inlet.open_stream(5.);
+	if (!outlet.wait_for_consumers(5.)) throw std::runtime_error("the responder didn't connect");
+
+	// channel 0 holds the number of the round trip the sample belongs to
+	std::vector<double> request(nchan * chunk, 1.), reply(nchan * 1024);
+	std::vector<double> rtts;
+	rtts.reserve(opt.iterations);
+	for (int i = -opt.warmup; i < opt.iterations; ++i) {
+		for (uint32_t s = 0; s < chunk; ++s) request[s * nchan] = i;
+		const double start = lsl::local_clock();
+		outlet.push_chunk_multiplexed(request, start, true);
+		for (uint32_t got = 0; got < chunk;) {
+			// a chunk pull with a timeout would wait for a full buffer, so wait for one sample
+			if (inlet.pull_sample(reply.data(), (int32_t)nchan, 5.) == 0.)
+				throw std::runtime_error("the replies stopped");
+			const std::size_t n = nchan + inlet.pull_chunk_multiplexed(reply.data() + nchan,
+											  nullptr, reply.size() - nchan, 0, 0.);
+			for (std::size_t s = 0; s < n / nchan; ++s)
+				if (reply[s * nchan] == i) ++got;
+		}
+		if (i >= 0) rtts.push_back(lsl::local_clock() - start);
+	}
+	std::sort(rtts.begin(), rtts.end());
+	const auto quantile = [&](double q) {
+		return rtts[static_cast<std::size_t>(q * (rtts.size() - 1))];
+	};
+	return {quantile(.5), quantile(.99), quantile(.999), rtts.back()};
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const options opt = parse_options(argc, argv);
+	for (const auto &role : opt.role_cpus) lsl::set_thread_policy(role.first, role.second);
+	pin_app_thread(opt);
+
+	if (opt.respond) {
+		respond(opt);
+		return 0;
+	}
+	std::thread responder;
+	if (opt.loopback) responder = std::thread(respond, std::cref(opt));
+
+	if (!opt.json)
+		printf("%8s %6s %8s %10s %10s %10s %10s\n", "channels", "chunk", "mode", "p50 us",
+			"p99 us", "p99.9 us", "max us");
+	int status = 0;
+	for (uint32_t nchan : opt.channels)
+		for (uint32_t chunk : opt.chunks)
+			for (const auto &mode : opt.modes) {
+				try {
+					const result r = measure(nchan, chunk, mode, opt);
+					if (opt.json)
+						printf("{\"channels\":%u,\"chunk\":%u,\"bytes_per_chunk\":%u,"
+							   "\"mode\":\"%s\",\"iterations\":%d,\"rtt_p50\":%g,\"rtt_p99\":%g,"
+							   "\"rtt_p999\":%g,\"rtt_max\":%g}\n",
+							nchan, chunk, nchan * chunk * 8, mode.c_str(), opt.iterations, r.p50,
+							r.p99, r.p999, r.max);
+					else
+						printf("%8u %6u %8s %10.1f %10.1f %10.1f %10.1f\n", nchan, chunk,
+							mode.c_str(), r.p50 * 1e6, r.p99 * 1e6, r.p999 * 1e6, r.max * 1e6);
+					fflush(stdout);
+				} catch (std::exception &e) {
+					std::cerr << nchan << "x" << chunk << " " << mode << ": " << e.what()
+							  << std::endl;
+					status = 1;
+				}
+			}
+
+	stop = true;
+	if (responder.joinable()) responder.join();
+	return status;
+}
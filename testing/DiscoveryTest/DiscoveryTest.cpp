@@ -0,0 +1,226 @@
+#include "../../include/lsl_cpp.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+/**
+ * Discovery benchmark: creates many outlets, in this process or spread over helper processes,
+ * and measures how long one-shot resolves take to the first and to all of them, how many
+ * packets a resolve costs and how much time the outlets spend answering a query.
+ *
+ * E.g. `lsl_discoverytest --outlets 1000 --processes 10` for 10 helpers with 100 outlets each.
+ */
+
+namespace {
+
+struct options {
+	int outlets = 100, processes = 0, waves = 10;
+	double timeout = 5., serve = 0.;
+	std::string name = "DiscoveryTest", type = "DiscoveryTest";
+	bool json = false;
+};
+
+void usage() {
+	std::cout << "Usage: lsl_discoverytest [options]\n"
+				 "  --outlets N     number of outlets to create (default 100)\n"
+				 "  --processes P   spread the outlets over P helper processes (default 0: create "
+				 "them in this process)\n"
+				 "  --waves W       number of measured resolves of the first / all streams "
+				 "(default 10)\n"
+				 "  --timeout SEC   timeout of a resolve (default 5)\n"
+				 "  --name NAME     name prefix of the outlets (default DiscoveryTest)\n"
+				 "  --type TYPE     stream type of the outlets (default DiscoveryTest)\n"
+				 "  --json          print the summary as a line of JSON\n"
+				 "  --serve SEC     [helper] only serve the outlets, for at most SEC seconds\n";
+}
+
+options parse_options(int argc, char *argv[]) {
+	options opt;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--json") {
+			opt.json = true;
+			continue;
+		}
+		if (arg == "--help" || i + 1 == argc) {
+			usage();
+			std::exit(arg == "--help" ? 0 : 1);
+		}
+		const char *value = argv[++i];
+		if (arg == "--outlets")
+			opt.outlets = std::atoi(value);
+		else if (arg == "--processes")
+			opt.processes = std::atoi(value);
+		else if (arg == "--waves")
+			opt.waves = std::atoi(value);
+		else if (arg == "--timeout")
+			opt.timeout = std::atof(value);
+		else if (arg == "--name")
+			opt.name = value;
+		else if (arg == "--type")
+			opt.type = value;
+		else if (arg == "--serve")
+			opt.serve = std::atof(value);
+		else {
+			usage();
+			std::exit(1);
+		}
+	}
+	if (opt.outlets < 1 || opt.processes < 0 || opt.waves < 1 || opt.timeout <= 0.) {
+		usage();
+		std::exit(1);
+	}
+	return opt;
+}
+
+double cpu_seconds() { return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; }
+
+void create_outlets(std::list<lsl::stream_outlet> &outlets, const options &opt, int first, int n) {
+	for (int i = first; i < first + n; ++i) {
+		const std::string name = opt.name + std::to_string(i);
+		outlets.emplace_back(lsl::stream_info(name, opt.type, 1, 100., lsl::cf_float32, name));
+	}
+}
+
+/// Helper mode: serve the outlets until the queries stop (or the time is up) and report the
+/// time spent answering them.
+int serve(const options &opt) {
+	std::list<lsl::stream_outlet> outlets;
+	// the helpers' outlets are numbered after the --name prefix
+	create_outlets(outlets, opt, 0, opt.outlets);
+	printf("ready\n");
+	fflush(stdout);
+	const double start = lsl::local_clock(), idle_timeout = 3.;
+	double last_request = start;
+	uint64_t requests = 0;
+	for (double now = start; now - start < opt.serve && now - last_request < idle_timeout;
+		 now = lsl::local_clock()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		const uint64_t received = lsl::discovery_stats().requests_received;
+		if (received != requests) {
+			requests = received;
+			last_request = lsl::local_clock();
+		}
+	}
+	const lsl_discovery_stats s = lsl::discovery_stats();
+	printf("served %llu %llu %.9f\n", (unsigned long long)s.requests_received,
+		(unsigned long long)s.replies_sent, s.request_seconds);
+	fflush(stdout);
+	return 0;
+}
+
+double percentile(std::vector<double> values, double p) {
+	std::sort(values.begin(), values.end());
+	return values[static_cast<std::size_t>(p * (values.size() - 1) + .5)];
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	options opt = parse_options(argc, argv);
+	if (opt.serve > 0.) return serve(opt);
+
+	std::list<lsl::stream_outlet> outlets;
+	std::vector<FILE *> helpers;
+	if (!opt.processes)
+		create_outlets(outlets, opt, 0, opt.outlets);
+	else {
+		// generous enough for all waves to time out; the helpers stop early once the queries do
+		const double lifetime = 2 * opt.waves * opt.timeout + 30.;
+		for (int p = 0; p < opt.processes; ++p) {
+			const int n = opt.outlets / opt.processes + (p < opt.outlets % opt.processes);
+			const std::string cmd = '"' + std::string(argv[0]) + "\" --serve " +
+									std::to_string(lifetime) + " --outlets " + std::to_string(n) +
+									" --name " + opt.name + std::to_string(p) + "_ --type " +
+									opt.type;
+			if (FILE *helper = popen(cmd.c_str(), "r"))
+				helpers.push_back(helper);
+			else
+				std::cerr << "Couldn't start a helper process." << std::endl;
+		}
+		char line[256];
+		for (FILE *helper : helpers)
+			if (!fgets(line, sizeof(line), helper) || std::string(line) != "ready\n")
+				std::cerr << "A helper process didn't get ready." << std::endl;
+	}
+
+	std::cerr << "Resolving " << opt.outlets << " outlets "
+			  << (opt.processes ? "in " + std::to_string(opt.processes) + " processes"
+								: std::string("in this process"))
+			  << ", " << opt.waves << " times..." << std::endl;
+	std::vector<double> first, all;
+	std::size_t min_found = opt.outlets;
+	const lsl_discovery_stats before = lsl::discovery_stats();
+	const double cpu_start = cpu_seconds();
+	for (int wave = 0; wave < opt.waves; ++wave) {
+		double start = lsl::local_clock();
+		lsl::resolve_stream("type", opt.type, 1, opt.timeout);
+		first.push_back(lsl::local_clock() - start);
+		start = lsl::local_clock();
+		const auto found = lsl::resolve_stream("type", opt.type, opt.outlets, opt.timeout);
+		all.push_back(lsl::local_clock() - start);
+		min_found = std::min(min_found, found.size());
+	}
+	const double cpu = cpu_seconds() - cpu_start;
+	const lsl_discovery_stats after = lsl::discovery_stats();
+
+	// the outlets' side of the traffic: the helpers report it once the queries stopped
+	uint64_t requests = after.requests_received - before.requests_received,
+			 replies_sent = after.replies_sent - before.replies_sent;
+	double request_seconds = after.request_seconds - before.request_seconds;
+	for (FILE *helper : helpers) {
+		char line[256];
+		unsigned long long helper_requests = 0, helper_replies = 0;
+		double helper_seconds = 0.;
+		if (fgets(line, sizeof(line), helper) &&
+			sscanf(line, "served %llu %llu %lf", &helper_requests, &helper_replies,
+				&helper_seconds) == 3) {
+			requests += helper_requests;
+			replies_sent += helper_replies;
+			request_seconds += helper_seconds;
+		} else
+			std::cerr << "A helper process didn't report its statistics." << std::endl;
+		pclose(helper);
+	}
+
+	const double resolves = 2. * opt.waves;
+	const double queries = (after.queries_sent - before.queries_sent) / resolves,
+				 replies = (after.replies_received - before.replies_received) / resolves,
+				 us_per_request = requests ? request_seconds * 1e6 / requests : 0.;
+	if (opt.json)
+		printf("{\"outlets\":%d,\"processes\":%d,\"waves\":%d,\"found\":%d,"
+			   "\"first_p50\":%g,\"first_max\":%g,\"all_p50\":%g,\"all_max\":%g,"
+			   "\"queries_per_resolve\":%.1f,\"replies_per_resolve\":%.1f,"
+			   "\"requests_per_resolve\":%.1f,\"outlet_us_per_request\":%.3f,"
+			   "\"resolver_cpu_ms_per_resolve\":%.3f}\n",
+			opt.outlets, opt.processes, opt.waves, (int)min_found, percentile(first, .5),
+			percentile(first, 1.), percentile(all, .5), percentile(all, 1.), queries, replies,
+			requests / resolves, us_per_request, cpu * 1e3 / resolves);
+	else {
+		printf("found    %d of %d streams (worst wave)\n", (int)min_found, opt.outlets);
+		printf("first    p50 %8.2f ms, max %8.2f ms\n", percentile(first, .5) * 1e3,
+			percentile(first, 1.) * 1e3);
+		printf("all      p50 %8.2f ms, max %8.2f ms\n", percentile(all, .5) * 1e3,
+			percentile(all, 1.) * 1e3);
+		printf("packets  %.1f queries sent, %.1f replies received per resolve\n", queries,
+			replies);
+		printf("outlets  %.1f requests handled, %.1f replies sent per resolve, %.3f us per "
+			   "request\n",
+			requests / resolves, replies_sent / resolves, us_per_request);
+		printf("cpu      %.3f ms per resolve%s\n", cpu * 1e3 / resolves,
+			opt.processes ? " (resolver)" : " (resolver and outlets)");
+	}
+	return 0;
+}
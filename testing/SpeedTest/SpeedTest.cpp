@@ -1,165 +1,238 @@
-#include <stdint.h>
 #include "../../include/lsl_cpp.h"
-#include <boost/chrono.hpp>
-#include <boost/thread.hpp>
-#include <boost/bind.hpp>
-#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <list>
 #include <map>
-#include <time.h>
-#include <stdlib.h>
-using namespace std;
-
-// set to true by the main program when we're ready to quit
-bool stop_inlet = false, stop_outlet = false, start_outlet = false; 
-
-// get the current time
-double now() { return lsl::local_clock(); }
-
-// initialize a sample with data
-template<class T>
-vector<T> init_sample(int numchan) {
-	vector<T> sample(numchan);
-	for (int c=0;c<numchan;c++)
-		sample[c] = 17.3;
-	return sample;
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Load generator: spawns outlets and / or inlets with configurable rates, formats and chunking
+ * and reports the achieved throughput, CPU time per sample, dropped samples and latencies.
+ *
+ * To spread the load over several processes or hosts, start some instances with outlets only
+ * (`--inlets 0`) and others with inlets only (`--outlets 0 --expect <total outlets>`).
+ */
+
+namespace {
+
+struct options {
+	int outlets = 1, inlets = 1, expect = 0, channels = 8, chunk = 10;
+	double rate = 1000., duration = 10.;
+	std::string format = "float32", name = "LoadTest", type = "LoadTest";
+	bool json = false;
+};
+
+const std::map<std::string, lsl::channel_format_t> formats = {{"int8", lsl::cf_int8},
+	{"int16", lsl::cf_int16}, {"int32", lsl::cf_int32}, {"int64", lsl::cf_int64},
+	{"float32", lsl::cf_float32}, {"double64", lsl::cf_double64}, {"string", lsl::cf_string}};
+
+void usage() {
+	std::cout
+		<< "Usage: lsl_speedtest [options]\n"
+		   "  --outlets M     number of outlets to create (default 1)\n"
+		   "  --inlets N      number of inlets to open per found stream (default 1)\n"
+		   "  --expect K      number of streams the inlets wait for (default: --outlets)\n"
+		   "  --rate HZ       nominal sampling rate per outlet, 0 for as fast as possible "
+		   "(default 1000)\n"
+		   "  --channels C    channels per stream (default 8)\n"
+		   "  --format F      int8, int16, int32, int64, float32, double64 or string (default "
+		   "float32)\n"
+		   "  --chunk S       samples per pushed chunk (default 10)\n"
+		   "  --duration SEC  how long to run (default 10)\n"
+		   "  --name NAME     name prefix of the outlets (default LoadTest)\n"
+		   "  --type TYPE     stream type of the outlets and inlets (default LoadTest)\n"
+		   "  --json          print the summary as a line of JSON\n";
 }
 
-// initialize a sample with data
-template<class T>
-void init_sample(int numchan, vector<T> &sample) {
-	sample.resize(numchan);
-	for (int c=0;c<numchan;c++)
-		sample[c] = 17.3f;
-}
-
-// run an outlet
-template<class T>
-void run_outlet(string name, string type, int numchan, lsl::channel_format_t fmt, double srate, int chunk_len, int max_samples) {
-	try {
-		// create a new streaminfo and outlet
-		std::ostringstream uid; uid << name << type << numchan << fmt;
-		lsl::stream_info info(name,type,numchan,srate,fmt,uid.str());
-		lsl::stream_outlet outlet(info);
-		cout << "outlet started." << endl;
-
-		while (!start_outlet)
-			lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
-
-		// initialize data to send
-		vector<T> sample,chunk;
-		init_sample(numchan,sample);
-		init_sample((int)(numchan*(chunk_len*srate/1000*5)),chunk);
-
-		// send in bursts
-		double start_time = lsl::local_clock();
-		for (int target,diff,written=0;written<max_samples && !stop_outlet;written+=diff) {
-			lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(chunk_len));
-			target = (int)floor((lsl::local_clock()-start_time)*srate);
-			int num_elements = std::min((std::size_t)((target-written)*numchan),chunk.size());
-			outlet.push_chunk_multiplexed(&chunk[0],num_elements);
-			diff = num_elements/numchan;
+options parse_options(int argc, char *argv[]) {
+	options opt;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--json") {
+			opt.json = true;
+			continue;
+		}
+		if (arg == "--help" || i + 1 == argc) {
+			usage();
+			std::exit(arg == "--help" ? 0 : 1);
+		}
+		const char *value = argv[++i];
+		if (arg == "--outlets")
+			opt.outlets = std::atoi(value);
+		else if (arg == "--inlets")
+			opt.inlets = std::atoi(value);
+		else if (arg == "--expect")
+			opt.expect = std::atoi(value);
+		else if (arg == "--rate")
+			opt.rate = std::atof(value);
+		else if (arg == "--channels")
+			opt.channels = std::atoi(value);
+		else if (arg == "--format")
+			opt.format = value;
+		else if (arg == "--chunk")
+			opt.chunk = std::atoi(value);
+		else if (arg == "--duration")
+			opt.duration = std::atof(value);
+		else if (arg == "--name")
+			opt.name = value;
+		else if (arg == "--type")
+			opt.type = value;
+		else {
+			usage();
+			std::exit(1);
 		}
-		cout << "outlet finished." << endl;
 	}
-	catch(lslboost::thread_interrupted &) {}
-	catch(std::exception &e) {
-		std::cerr << "ERROR during run_outlet() Stress-test function: " <<	e.what() << std::endl;
+	if (!opt.expect) opt.expect = opt.outlets;
+	if (!formats.count(opt.format) || opt.channels < 1 || opt.chunk < 1) {
+		usage();
+		std::exit(1);
 	}
+	return opt;
 }
 
+std::atomic<bool> stop{false};
+
+template <typename T> T test_value() { return static_cast<T>(17); }
+template <> std::string test_value<std::string>() { return "17.3"; }
 
-// run an inlet for some time (optionally with sporadic interruptions in between)
-template<class T>
-void run_inlet(string type, bool in_chunks, int buffer_len) {
+/// Push chunks at the nominal rate (or as fast as possible) until stopped.
+template <typename T> void run_outlet(lsl::stream_outlet &outlet, const options &opt) {
+	const std::vector<T> chunk(opt.chunk * opt.channels, test_value<T>());
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t pushed = 0; !stop; pushed += opt.chunk) {
+		if (opt.rate > 0.)
+			std::this_thread::sleep_until(
+				start + std::chrono::duration<double>((pushed + opt.chunk) / opt.rate));
+		outlet.push_chunk_multiplexed(chunk.data(), chunk.size(), lsl::local_clock());
+	}
+}
+
+/// Pull chunks until stopped.
+template <typename T> void run_inlet(lsl::stream_inlet &inlet, const options &opt) {
+	std::vector<T> buffer(std::max(opt.chunk, 1024) * opt.channels);
+	while (!stop) inlet.pull_chunk_multiplexed(buffer.data(), nullptr, buffer.size(), 0, .1);
+}
+
+template <typename T> void run(lsl::stream_outlet *outlet, lsl::stream_inlet *inlet,
+	const options &opt) {
 	try {
-		vector<vector<T> > chunk; 
-		vector<T> sample; 
-
-		// resolve by type and create inlet
-		vector<lsl::stream_info> results = lsl::resolve_stream("type",type);
-		lsl::stream_inlet inlet(results[0],buffer_len);
-		cout << "inlet started." << endl;
-		start_outlet = true;
-
-		// variables for data rate testing
-		double starttime = lsl::local_clock(), next_display = starttime+1;
-		double ts, last_ts;
-
-		// run
-		for (int k=0,num_samples=0;!stop_inlet;k++) {
-			lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(10));
-			if (in_chunks) {
-				inlet.pull_chunk(chunk);
-				num_samples += chunk.size();
-			} else {
-				while (ts = inlet.pull_sample(sample,0.0)) {
-					last_ts = ts;
-					num_samples++;
-				}
-			}
-			// display code
-			if (k % 50 == 0) {
-				double now = lsl::local_clock();
-				if (now>next_display) {
-					cout << num_samples/(now-starttime) << " samples/sec" << endl; // " samples/sec; latency = " << 1000*(now-last_ts) << " ms." << endl; // NOTE: testing latency requires that data is sent with a burst length of 0
-					next_display = now+1;
-				}
-			}
-		}
-		cout << "inlet finished." << endl;
-	} 
-	catch(lslboost::thread_interrupted &) {}
-	catch(std::exception &e) {
-		std::cerr << "ERROR during run_inlet() Stress-test function: " <<	e.what() << std::endl;
+		if (outlet) run_outlet<T>(*outlet, opt);
+		if (inlet) run_inlet<T>(*inlet, opt);
+	} catch (std::exception &e) { std::cerr << "Error: " << e.what() << std::endl; }
+}
+
+void run_any(lsl::stream_outlet *outlet, lsl::stream_inlet *inlet, const options &opt) {
+	switch (formats.at(opt.format)) {
+	case lsl::cf_int8: return run<char>(outlet, inlet, opt);
+	case lsl::cf_int16: return run<int16_t>(outlet, inlet, opt);
+	case lsl::cf_int32: return run<int32_t>(outlet, inlet, opt);
+	case lsl::cf_int64: return run<int64_t>(outlet, inlet, opt);
+	case lsl::cf_float32: return run<float>(outlet, inlet, opt);
+	case lsl::cf_double64: return run<double>(outlet, inlet, opt);
+	default: return run<std::string>(outlet, inlet, opt);
 	}
 }
 
-int main(int argc, char* argv[]) {
-	double srate = 500000;
-	int numchans = 1;
-	lsl::channel_format_t format = lsl::cf_int8;
-	int burstlen = 10;
-	int maxsamples = 10000000;
-	int bufferlen = 10;
-	if (argc > 1)
-		srate = lslboost::lexical_cast<double>(argv[1]);
-	if (argc > 2)
-		numchans = lslboost::lexical_cast<int>(argv[2]);
-	if (argc > 3) {
-		std::map<std::string,lsl::channel_format_t> m; m["int8"]=lsl::cf_int8;m["int16"]=lsl::cf_int16;m["int32"]=lsl::cf_int32;m["int64"]=lsl::cf_int64;m["float"]=lsl::cf_float32;m["double"]=lsl::cf_double64;m["float32"]=lsl::cf_float32;m["double64"]=lsl::cf_double64; m["string"]=lsl::cf_string;
-		format = m[argv[3]];
+double cpu_seconds() { return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const options opt = parse_options(argc, argv);
+	const double srate = opt.rate > 0. ? opt.rate : lsl::IRREGULAR_RATE;
+
+	std::list<lsl::stream_outlet> outlets;
+	for (int i = 0; i < opt.outlets; ++i) {
+		const std::string name = opt.name + std::to_string(i);
+		outlets.emplace_back(
+			lsl::stream_info(name, opt.type, opt.channels, srate, formats.at(opt.format), name));
 	}
-	if (argc > 4)
-		burstlen = lslboost::lexical_cast<int>(argv[4]);
-	if (argc > 5)
-		maxsamples = lslboost::lexical_cast<int>(argv[5]);
-	if (argc > 6)
-		bufferlen = lslboost::lexical_cast<int>(argv[6]);
-
-	{
-		// fast serial transmission (1-channel char)
-		lslboost::thread outlet(lslboost::bind(&run_outlet<float>,"FastSerial","Serial",numchans,format,srate,burstlen,maxsamples));
-		lslboost::thread inlet(lslboost::bind(&run_inlet<float>,"Serial",false,bufferlen));
-
-		// typical audio transmission (44KHz, 2-ch, 16-bit, 512-sample chunks)
-		//boost::thread a(boost::bind(&run_outlet<char>,"TypicalAudio","Audio",2,lsl::cf_int16,44100,512,1000000));
-		//boost::thread b(boost::bind(&run_inlet<char>,"Audio",true,10));
-
-		// HD video transmission (30Hz, 2-ch, 16-bit, 512-sample chunks)
-		//boost::thread outlet(boost::bind(&run_outlet<char>,"HDVideo","Video",640*480*3,lsl::cf_int8,10,0,1000000));
-		//boost::thread inlet(boost::bind(&run_inlet<char>,"Video",false,1));
-
-		//boost::thread highchan_outlet_thread(boost::bind(&run_outlet,1000000,"HighChanStream","Video",1920*1080*3,lsl::cf_int8,60,1000000,-1));
-		//boost::thread highchan_inlet_thread(boost::bind(&run_inlet,1000000,"HighChanStream","Video",false,false,false,1000000));
-		//cout << "Press [Enter] to exit: " << endl; cin.get();
-
-		// take'em down
-		outlet.join();
-		stop_inlet = true;
-		inlet.join();
+
+	std::list<lsl::stream_inlet> inlets;
+	std::vector<std::string> inlet_streams;
+	if (opt.inlets > 0 && opt.expect > 0) {
+		auto found = lsl::resolve_stream("type", opt.type, opt.expect, 10.);
+		if ((int)found.size() < opt.expect)
+			std::cerr << "Only found " << found.size() << " of " << opt.expect << " streams."
+					  << std::endl;
+		for (const auto &info : found)
+			for (int i = 0; i < opt.inlets; ++i) {
+				inlets.emplace_back(info, 360, 0, false);
+				inlets.back().open_stream(5.);
+				inlets.back().track_latency();
+				inlet_streams.push_back(info.name() + '@' + info.hostname());
+			}
+	}
+	for (auto &outlet : outlets)
+		if (opt.inlets > 0) outlet.wait_for_consumers(5.);
+
+	std::cerr << "Running " << outlets.size() << " outlets and " << inlets.size()
+			  << " inlets for " << opt.duration << " s..." << std::endl;
+	const double cpu_start = cpu_seconds(), start = lsl::local_clock();
+	std::vector<std::thread> threads;
+	for (auto &outlet : outlets) threads.emplace_back(run_any, &outlet, nullptr, std::cref(opt));
+	for (auto &inlet : inlets) threads.emplace_back(run_any, nullptr, &inlet, std::cref(opt));
+	std::this_thread::sleep_for(std::chrono::duration<double>(opt.duration));
+	const double elapsed = lsl::local_clock() - start;
+
+	// take the statistics before stopping so the rates cover the same period
+	uint64_t pushed = 0, sent = 0, outlet_drops = 0, received = 0, inlet_drops = 0;
+	double worst_p50 = 0, worst_p99 = 0, worst_p999 = 0;
+	for (auto &outlet : outlets) {
+		const lsl_outlet_stats s = outlet.stats();
+		pushed += s.samples_pushed;
+		sent += s.samples_sent;
+		outlet_drops += s.samples_dropped;
+	}
+	std::size_t i = 0;
+	for (auto &inlet : inlets) {
+		const lsl_inlet_stats s = inlet.stats();
+		received += s.samples_received;
+		inlet_drops += s.samples_dropped;
+		worst_p50 = std::max(worst_p50, s.latency_p50);
+		worst_p99 = std::max(worst_p99, s.latency_p99);
+		worst_p999 = std::max(worst_p999, s.latency_p999);
+		if (!opt.json)
+			printf("inlet %-30s %10.0f samples/s, %llu dropped, latency p50 %.3f ms, p99 %.3f ms, "
+				   "p99.9 %.3f ms\n",
+				inlet_streams[i].c_str(), s.samples_received / elapsed,
+				(unsigned long long)s.samples_dropped, s.latency_p50 * 1e3, s.latency_p99 * 1e3,
+				s.latency_p999 * 1e3);
+		++i;
+	}
+	const double cpu = cpu_seconds() - cpu_start;
+	stop = true;
+	for (auto &thread : threads) thread.join();
+
+	const uint64_t handled = pushed + received;
+	const double cpu_us_per_sample = handled ? cpu * 1e6 / handled : 0.;
+	if (opt.json)
+		printf("{\"outlets\":%d,\"inlets\":%d,\"format\":\"%s\",\"channels\":%d,\"chunk\":%d,"
+			   "\"rate\":%g,\"seconds\":%.3f,\"pushed_per_second\":%.1f,\"sent_per_second\":%.1f,"
+			   "\"received_per_second\":%.1f,\"outlet_drops\":%llu,\"inlet_drops\":%llu,"
+			   "\"cpu_us_per_sample\":%.4f,\"latency_p50\":%g,\"latency_p99\":%g,"
+			   "\"latency_p999\":%g}\n",
+			(int)outlets.size(), (int)inlets.size(), opt.format.c_str(), opt.channels, opt.chunk,
+			opt.rate, elapsed, pushed / elapsed, sent / elapsed, received / elapsed,
+			(unsigned long long)outlet_drops, (unsigned long long)inlet_drops, cpu_us_per_sample,
+			worst_p50, worst_p99, worst_p999);
+	else {
+		printf("pushed   %12.0f samples/s (%llu dropped by consumer queues)\n", pushed / elapsed,
+			(unsigned long long)outlet_drops);
+		printf("sent     %12.0f samples/s\n", sent / elapsed);
+		printf("received %12.0f samples/s (%llu dropped by inlet buffers)\n", received / elapsed,
+			(unsigned long long)inlet_drops);
+		printf("cpu      %12.4f us per pushed or received sample\n", cpu_us_per_sample);
+		if (!inlets.empty())
+			printf("latency  worst inlet p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms\n",
+				worst_p50 * 1e3, worst_p99 * 1e3, worst_p999 * 1e3);
 	}
-	cout << "exiting..." << endl;
 	return 0;
 }
-
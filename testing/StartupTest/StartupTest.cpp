@@ -0,0 +1,207 @@
+#include "../../include/lsl_cpp.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/**
+ * Startup and teardown benchmark: measures how long it takes to construct and destroy batches of
+ * outlets, to open inlets to them (resolve, connect and complete the handshake; one after the
+ * other and as a batch, see lsl::open_streams()) and to close them again, so the costs of binding
+ * the ports, joining the multicast groups and starting the threads can be tracked over time.
+ *
+ * Each phase reports the wall-clock and CPU time, the context switches and (on Linux) the number
+ * of read / write system calls and the thread count afterwards. For the complete system call
+ * profile of a phase run e.g. `strace -f -c lsl_startuptest --outlets 100 --inlets 0`.
+ */
+
+namespace {
+
+struct options {
+	std::vector<int> outlets{1, 10, 100, 1000};
+	int inlets = 100;
+	std::string name = "StartupTest", type = "StartupTest";
+	bool json = false;
+};
+
+void usage() {
+	std::cout << "Usage: lsl_startuptest [options]\n"
+				 "  --outlets LIST  batch sizes of outlets to construct and destroy (default "
+				 "1,10,100,1000)\n"
+				 "  --inlets N      number of streams to resolve and open inlets to (default "
+				 "100, 0 to skip)\n"
+				 "  --name NAME     name prefix of the outlets (default StartupTest)\n"
+				 "  --type TYPE     stream type of the outlets (default StartupTest)\n"
+				 "  --json          print each phase as a line of JSON\n";
+}
+
+options parse_options(int argc, char *argv[]) {
+	options opt;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--json") {
+			opt.json = true;
+			continue;
+		}
+		if (arg == "--help" || i + 1 == argc) {
+			usage();
+			std::exit(arg == "--help" ? 0 : 1);
+		}
+		const char *value = argv[++i];
+		if (arg == "--outlets") {
+			opt.outlets.clear();
+			std::istringstream is(value);
+			for (std::string item; std::getline(is, item, ',');)
+				if (std::atoi(item.c_str()) > 0) opt.outlets.push_back(std::atoi(item.c_str()));
+		} else if (arg == "--inlets")
+			opt.inlets = std::atoi(value);
+		else if (arg == "--name")
+			opt.name = value;
+		else if (arg == "--type")
+			opt.type = value;
+		else {
+			usage();
+			std::exit(1);
+		}
+	}
+	if (opt.inlets < 0) {
+		usage();
+		std::exit(1);
+	}
+	return opt;
+}
+
+/// The resource usage of the process at some point.
+struct usage_sample {
+	double wall, cpu;
+	long context_switches = 0;
+	long long syscalls = 0;
+	long threads = 0;
+
+	static usage_sample now() {
+		usage_sample s;
+		s.wall = lsl::local_clock();
+		s.cpu = static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#ifndef _WIN32
+		rusage ru{};
+		if (!getrusage(RUSAGE_SELF, &ru)) s.context_switches = ru.ru_nvcsw + ru.ru_nivcsw;
+#endif
+#ifdef __linux__
+		// syscr / syscw count the read and write calls (incl. send / recv) of all threads
+		std::ifstream io("/proc/self/io");
+		for (std::string key; io >> key;) {
+			long long value = 0;
+			io >> value;
+			if (key == "syscr:" || key == "syscw:") s.syscalls += value;
+		}
+		std::ifstream status("/proc/self/status");
+		for (std::string line; std::getline(status, line);)
+			if (line.compare(0, 8, "Threads:") == 0) s.threads = std::atol(line.c_str() + 8);
+#endif
+		return s;
+	}
+};
+
+/// Print the resource usage of a phase since start.
+void report(const options &opt, const char *phase, int count, const usage_sample &start) {
+	const usage_sample end = usage_sample::now();
+	const double wall = end.wall - start.wall, cpu = end.cpu - start.cpu;
+	const long switches = end.context_switches - start.context_switches;
+	const long long syscalls = end.syscalls - start.syscalls;
+	if (opt.json)
+		printf("{\"phase\":\"%s\",\"count\":%d,\"seconds\":%.6f,\"cpu_seconds\":%.6f,"
+			   "\"context_switches\":%ld,\"rw_syscalls\":%lld,\"threads\":%ld}\n",
+			phase, count, wall, cpu, switches, syscalls, end.threads);
+	else
+		printf("%-18s %6d %10.2f %10.3f %10.2f %10ld %10lld %8ld\n", phase, count, wall * 1e3,
+			count ? wall * 1e3 / count : 0., cpu * 1e3, switches, syscalls, end.threads);
+	fflush(stdout);
+}
+
+void create_outlets(std::list<lsl::stream_outlet> &outlets, const options &opt, int n) {
+	for (int i = 0; i < n; ++i) {
+		const std::string name = opt.name + std::to_string(i);
+		outlets.emplace_back(lsl::stream_info(name, opt.type, 1, 100., lsl::cf_float32, name));
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const options opt = parse_options(argc, argv);
+	// initialize the library (config, clock, multicast setup) before measuring anything
+	lsl::local_clock();
+	lsl::library_info();
+
+	if (!opt.json)
+		printf("%-18s %6s %10s %10s %10s %10s %10s %8s\n", "phase", "count", "total ms", "ms each",
+			"cpu ms", "ctx sw", "rw calls", "threads");
+	int status = 0;
+	for (int n : opt.outlets) {
+		try {
+			std::list<lsl::stream_outlet> outlets;
+			usage_sample start = usage_sample::now();
+			create_outlets(outlets, opt, n);
+			report(opt, "construct outlets", n, start);
+			start = usage_sample::now();
+			outlets.clear();
+			report(opt, "destroy outlets", n, start);
+		} catch (std::exception &e) {
+			std::cerr << "Couldn't create " << n << " outlets: " << e.what() << std::endl;
+			status = 1;
+		}
+	}
+
+	if (opt.inlets > 0) {
+		try {
+			std::list<lsl::stream_outlet> outlets;
+			create_outlets(outlets, opt, opt.inlets);
+
+			usage_sample start = usage_sample::now();
+			const auto found = lsl::resolve_stream("type", opt.type, opt.inlets, 10.);
+			report(opt, "resolve streams", static_cast<int>(found.size()), start);
+			if (static_cast<int>(found.size()) < opt.inlets)
+				std::cerr << "Only found " << found.size() << " of " << opt.inlets << " streams."
+						  << std::endl;
+
+			std::list<lsl::stream_inlet> inlets;
+			start = usage_sample::now();
+			for (const auto &info : found) inlets.emplace_back(info, 360, 0, false);
+			report(opt, "construct inlets", static_cast<int>(inlets.size()), start);
+
+			// open_stream() returns once the handshake with the outlet is done
+			start = usage_sample::now();
+			for (auto &inlet : inlets) inlet.open_stream(10.);
+			report(opt, "open inlets", static_cast<int>(inlets.size()), start);
+
+			start = usage_sample::now();
+			inlets.clear();
+			report(opt, "destroy inlets", static_cast<int>(found.size()), start);
+
+			// the same inlets again, opened at once so their handshakes overlap
+			std::vector<lsl::stream_inlet *> batch;
+			for (const auto &info : found) {
+				inlets.emplace_back(info, 360, 0, false);
+				batch.push_back(&inlets.back());
+			}
+			start = usage_sample::now();
+			const uint32_t opened = lsl::open_streams(batch, 10.);
+			report(opt, "batch open inlets", static_cast<int>(opened), start);
+			inlets.clear();
+		} catch (std::exception &e) {
+			std::cerr << "Couldn't open " << opt.inlets << " inlets: " << e.what() << std::endl;
+			status = 1;
+		}
+	}
+	return status;
+}
@@ -0,0 +1,235 @@
+#include "helper_type.hpp"
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <lsl_cpp.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A matrix of throughput and latency benchmarks for tracking regressions across releases.
+ *
+ * Every combination of the parameters below is measured and written as one JSON object per line
+ * to the file named by the environment variable LSL_BENCH_JSON (default: lsl_bench_matrix.jsonl),
+ * with the library version so the results of several releases can be compared:
+ *
+ *     LSL_BENCH_JSON=results.jsonl testing/lsl_bench_exported "[matrix]"
+ *
+ * Each throughput measurement pushes for LSL_BENCH_SECONDS (default: 0.25) seconds.
+ */
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template <typename T> T bench_value() { return static_cast<T>(17); }
+template <> std::string bench_value<std::string>() { return std::string(20, 'a'); }
+
+double bench_seconds() {
+	const char *env = std::getenv("LSL_BENCH_SECONDS");
+	const double seconds = env ? std::atof(env) : 0.;
+	return seconds > 0. ? seconds : .25;
+}
+
+double elapsed(clock_type::time_point since) {
+	return std::chrono::duration<double>(clock_type::now() - since).count();
+}
+
+/// A benchmark result, written as one line of JSON with the library version.
+class json_record {
+public:
+	explicit json_record(const char *benchmark) {
+		add("benchmark", benchmark);
+		add("lsl_version", lsl::library_version());
+		add("lsl_protocol", lsl::protocol_version());
+		add("lsl_info", lsl::library_info());
+	}
+
+	json_record &add(const char *key, const std::string &value) {
+		return add_raw(key, '"' + value + '"');
+	}
+	json_record &add(const char *key, const char *value) { return add(key, std::string(value)); }
+	json_record &add(const char *key, bool value) { return add_raw(key, value ? "true" : "false"); }
+	json_record &add(const char *key, double value) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.6g", value);
+		return add_raw(key, buf);
+	}
+	template <typename Int> json_record &add(const char *key, Int value) {
+		return add_raw(key, std::to_string(value));
+	}
+
+	/// Append the record to the results file.
+	void write() const {
+		static std::mutex mut;
+		static std::ofstream out;
+		std::lock_guard<std::mutex> lock(mut);
+		if (!out.is_open()) {
+			const char *env = std::getenv("LSL_BENCH_JSON");
+			out.open(env ? env : "lsl_bench_matrix.jsonl", std::ios::app);
+		}
+		out << '{' << fields_ << "}\n" << std::flush;
+	}
+
+private:
+	json_record &add_raw(const char *key, const std::string &value) {
+		if (!fields_.empty()) fields_ += ',';
+		fields_ += '"' + std::string(key) + "\":" + value;
+		return *this;
+	}
+
+	std::string fields_;
+};
+
+/// Pulls chunks in a background thread and counts the received samples.
+template <typename T> class counting_reader {
+public:
+	counting_reader(const lsl::stream_info &info, std::size_t nchan)
+		: inlet_(info, 360, 0, false), nchan_(nchan) {
+		inlet_.open_stream(2.);
+		thread_ = std::thread([this]() {
+			std::vector<T> buf(nchan_ * 1024);
+			while (!stop_) {
+				const auto n =
+					inlet_.pull_chunk_multiplexed(buf.data(), nullptr, buf.size(), 0, .05);
+				received_ += n / nchan_;
+			}
+		});
+	}
+
+	~counting_reader() {
+		stop_ = true;
+		thread_.join();
+	}
+
+	std::size_t received() const { return received_; }
+	void reset() { received_ = 0; }
+
+private:
+	lsl::stream_inlet inlet_;
+	std::size_t nchan_;
+	std::atomic<std::size_t> received_{0};
+	std::atomic<bool> stop_{false};
+	std::thread thread_;
+};
+
+TEMPLATE_TEST_CASE("throughput matrix", "[matrix][throughput]", int16_t, float, double,
+	std::string) {
+	const std::size_t param_nchan[] = {1, 8, 64};
+	const std::size_t param_chunk[] = {1, 32, 512};
+	const std::size_t param_inlets[] = {0, 1, 4};
+	const bool param_pushthrough[] = {false, true};
+	const double seconds = bench_seconds();
+
+	const char *fmt = SampleType<TestType>::fmt_string();
+	const auto cf = static_cast<lsl::channel_format_t>(SampleType<TestType>::chan_fmt);
+
+	for (auto nchan : param_nchan) {
+		const std::string name = std::string("matrix_") + fmt + "_" + std::to_string(nchan);
+		lsl::stream_outlet out(
+			lsl::stream_info(name, "Benchmark", (int)nchan, lsl::IRREGULAR_RATE, cf, name));
+		auto found(lsl::resolve_stream("name", name, 1, 5.));
+		REQUIRE(!found.empty());
+		const std::vector<TestType> data(nchan * 512, bench_value<TestType>());
+
+		std::list<counting_reader<TestType>> readers;
+		for (auto n_inlets : param_inlets) {
+			while (readers.size() < n_inlets) readers.emplace_back(found[0], nchan);
+			if (n_inlets) out.wait_for_consumers(2.);
+			for (auto chunk : param_chunk)
+				for (auto pushthrough : param_pushthrough) {
+					for (auto &reader : readers) reader.reset();
+					std::size_t pushed = 0;
+					const auto start = clock_type::now();
+					do {
+						for (int i = 0; i < 16; ++i)
+							out.push_chunk_multiplexed(data.data(), chunk * nchan, 0., pushthrough);
+						pushed += 16 * chunk;
+					} while (elapsed(start) < seconds);
+					const double push_seconds = elapsed(start);
+
+					// wait until the readers got everything or stop receiving anything
+					std::size_t min_received = 0, last_total = 0;
+					auto last_progress = clock_type::now();
+					while (!readers.empty()) {
+						std::size_t total = 0;
+						min_received = pushed;
+						for (auto &reader : readers) {
+							total += reader.received();
+							min_received = std::min(min_received, reader.received());
+						}
+						if (min_received >= pushed) break;
+						if (total != last_total)
+							last_progress = clock_type::now();
+						else if (elapsed(last_progress) > .5)
+							break;
+						last_total = total;
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+					const double pull_seconds = elapsed(start);
+
+					json_record("throughput")
+						.add("format", fmt)
+						.add("channels", nchan)
+						.add("chunk_size", chunk)
+						.add("inlets", n_inlets)
+						.add("pushthrough", pushthrough)
+						.add("samples_pushed", pushed)
+						.add("push_samples_per_second", pushed / push_seconds)
+						.add("pull_samples_per_second", n_inlets ? min_received / pull_seconds : 0.)
+						.add("samples_dropped", n_inlets ? pushed - min_received : 0)
+						.write();
+				}
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("round trip matrix", "[matrix][latency]", int16_t, float, double, std::string) {
+	const std::size_t param_nchan[] = {1, 8, 64};
+	const std::size_t iterations = 2000;
+
+	const char *fmt = SampleType<TestType>::fmt_string();
+	const auto cf = static_cast<lsl::channel_format_t>(SampleType<TestType>::chan_fmt);
+
+	for (auto nchan : param_nchan) {
+		const std::string name = std::string("roundtrip_") + fmt + "_" + std::to_string(nchan);
+		lsl::stream_outlet out(
+			lsl::stream_info(name, "Benchmark", (int)nchan, lsl::IRREGULAR_RATE, cf, name));
+		auto found(lsl::resolve_stream("name", name, 1, 5.));
+		REQUIRE(!found.empty());
+		lsl::stream_inlet in(found[0]);
+		in.open_stream(2.);
+		out.wait_for_consumers(2.);
+
+		std::vector<TestType> data(nchan, bench_value<TestType>());
+		std::vector<double> round_trips;
+		round_trips.reserve(iterations);
+		for (std::size_t i = 0; i < iterations; ++i) {
+			const auto start = clock_type::now();
+			out.push_sample(data);
+			REQUIRE(in.pull_sample(data.data(), (int32_t)nchan, 5.) != 0.);
+			round_trips.push_back(elapsed(start));
+		}
+		std::sort(round_trips.begin(), round_trips.end());
+		const auto quantile_us = [&](double q) {
+			return round_trips[static_cast<std::size_t>(q * (iterations - 1))] * 1e6;
+		};
+		json_record("round_trip")
+			.add("format", fmt)
+			.add("channels", nchan)
+			.add("iterations", iterations)
+			.add("p50_us", quantile_us(.5))
+			.add("p99_us", quantile_us(.99))
+			.add("max_us", quantile_us(1.))
+			.write();
+	}
+}
+
+} // namespace
@@ -0,0 +1,60 @@
+#include "helpers.h"
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <list>
+#include <lsl_cpp.h>
+#include <string>
+#include <vector>
+
+// The memory the outlets and inlets report for a few stream shapes, e.g. to size the streams of
+// an embedded recorder; inlets buffer max_buflen seconds of samples.
+
+namespace {
+
+void print_memory(const char *what, const std::string &stream, uint64_t total, uint64_t samples,
+	uint64_t queues, uint64_t network, uint64_t metadata) {
+	printf("%-6s %-28s %10.1f KiB: samples %9.1f, queues %8.1f, network %8.1f, metadata %6.1f\n",
+		what, stream.c_str(), total / 1024., samples / 1024., queues / 1024., network / 1024.,
+		metadata / 1024.);
+}
+
+TEST_CASE("memory footprint", "[memory]") {
+	struct shape {
+		int channels;
+		double srate;
+		lsl::channel_format_t format;
+		int inlets, max_buflen;
+	};
+	const shape shapes[] = {{1, lsl::IRREGULAR_RATE, lsl::cf_string, 1, 360},
+		{8, 250., lsl::cf_float32, 1, 360}, {64, 1000., lsl::cf_float32, 1, 360},
+		{64, 1000., lsl::cf_float32, 4, 360}, {64, 1000., lsl::cf_float32, 1, 10},
+		{256, 30000., lsl::cf_int16, 1, 10}};
+	for (const auto &s : shapes) {
+		const std::string name = std::to_string(s.channels) + "ch@" + std::to_string((int)s.srate) +
+								 "Hz x" + std::to_string(s.inlets) + " buf " +
+								 std::to_string(s.max_buflen) + "s";
+		lsl::stream_outlet out(
+			lsl::stream_info("MemoryBench", "bench", s.channels, s.srate, s.format, name));
+		std::list<lsl::stream_inlet> inlets;
+		for (int i = 0; i < s.inlets; ++i) {
+			auto found = lsl::resolve_stream("source_id", name, 1, 5.);
+			REQUIRE(!found.empty());
+			inlets.emplace_back(found[0], s.max_buflen);
+			inlets.back().open_stream(5.);
+			inlets.back().info(5.);
+		}
+		out.wait_for_consumers(5.);
+
+		const lsl_outlet_stats o = out.stats();
+		print_memory("outlet", name, o.memory_bytes, o.memory_samples, o.memory_queues,
+			o.memory_network, o.memory_metadata);
+		const lsl_inlet_stats i = inlets.front().stats();
+		print_memory("inlet", name, i.memory_bytes, i.memory_samples, i.memory_queues,
+			i.memory_network, i.memory_metadata);
+	}
+
+	lsl::stream_outlet out(lsl::stream_info("MemoryBench", "bench", 8, 250., lsl::cf_float32));
+	BENCHMARK("outlet stats") { return out.stats(); };
+}
+
+} // namespace
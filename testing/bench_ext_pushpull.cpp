@@ -47,6 +47,15 @@ TEMPLATE_TEST_CASE("pushpull", "[basic][throughput]", char, double, std::string)
 			BENCHMARK("push_chunk_nchan_" + suffix) {
 				out.push_chunk_multiplexed(data, chunk_size);
 			};
+
+			// the pushes only copy the values, a worker of the outlet distributes them
+			if (cf != lsl::cf_string) {
+				out.set_async_push(16 << 20);
+				BENCHMARK("push_sample_async_nchan_" + suffix) {
+					for (size_t s = 0; s < chunk_size; s++) out.push_sample(data);
+				};
+				out.set_async_push(0);
+			}
 			for (auto &inlet : inlet_list) inlet.flush();
 		}
 	}
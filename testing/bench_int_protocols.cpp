@@ -0,0 +1,148 @@
+#include "api_config.h"
+#include "common.h"
+#include "stream_config.h"
+#include "stream_inlet_impl.h"
+#include "stream_outlet_impl.h"
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Compares the wire protocols head to head: the same samples are streamed over the loopback
+ * interface with each protocol version / encoding, once in the machine's byte order and once
+ * byte-swapped (see api_config::foreign_byte_order()), and the throughput, the CPU time per MB of
+ * sample data and the latency of single samples are printed as one table row per combination:
+ *
+ *     testing/lsl_bench_internal "[protocols]"
+ *
+ * Both ends run in this process, so the CPU time is the sum of the outlet's and the inlet's.
+ * Each throughput measurement pushes for LSL_BENCH_SECONDS (default: 0.25) seconds.
+ */
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double bench_seconds() {
+	const char *env = std::getenv("LSL_BENCH_SECONDS");
+	const double seconds = env ? std::atof(env) : 0.;
+	return seconds > 0. ? seconds : .25;
+}
+
+double elapsed(clock_type::time_point since) {
+	return std::chrono::duration<double>(clock_type::now() - since).count();
+}
+
+double cpu_seconds() { return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; }
+
+struct protocol_mode {
+	const char *name;
+	int protocol_version;
+	bool framing, delta, changed_channels, timestamp_deltas;
+};
+
+TEST_CASE("protocol comparison", "[protocols][throughput][latency]") {
+	const protocol_mode modes[] = {
+#ifndef LSL_NO_PROTOCOL_100
+		{"1.00", 100, false, false, false, false},
+#endif
+		{"1.10", 110, false, false, false, false},
+		{"1.10 framed", 110, true, false, false, false},
+		{"1.10 framed+delta", 110, true, true, false, false},
+		{"1.10 framed+changed", 110, true, false, true, false},
+		{"1.10 framed+ts-delta", 110, true, false, false, true},
+	};
+	const uint32_t nchan = 32, chunk = 32;
+	const std::size_t latency_iterations = 1000;
+	const double seconds = bench_seconds();
+	const std::vector<float> data(nchan * chunk, 17.f);
+
+	std::printf("%-22s %-8s %12s %10s %12s %9s %9s\n", "protocol", "order", "samples/s", "MB/s",
+		"cpu ms/MB", "p50 us", "p99 us");
+	for (const auto &mode : modes)
+		for (bool foreign : {false, true}) {
+			lsl::stream_config config(*lsl::api_config::get_instance());
+			config.use_protocol_version = mode.protocol_version;
+			config.sample_framing = mode.framing;
+			config.delta_encoding = mode.delta;
+			config.changed_channel_encoding = mode.changed_channels;
+			config.timestamp_deltas = mode.timestamp_deltas;
+			config.foreign_byte_order = foreign;
+			const auto config_p = std::make_shared<const lsl::stream_config>(config);
+
+			const std::string name = std::string("protocols_") + mode.name;
+			lsl::stream_outlet_impl outlet(
+				lsl::stream_info_impl(name, "Benchmark", nchan, lsl::IRREGULAR_RATE, cft_float32,
+					name),
+				0, 512000, false, config_p);
+			lsl::stream_info_impl info(outlet.info());
+			info.v4address("127.0.0.1");
+			lsl::stream_inlet_impl inlet(info, 360, 0, false, {}, 1, config_p);
+			inlet.open_stream(2.);
+			REQUIRE(outlet.wait_for_consumers(2.));
+
+			// --- latency: one sample at a time ---
+			std::vector<float> sample(nchan);
+			std::vector<double> latencies;
+			latencies.reserve(latency_iterations);
+			for (std::size_t i = 0; i < latency_iterations; ++i) {
+				const double pushed = lsl::lsl_clock();
+				outlet.push_sample(data.data(), pushed);
+				REQUIRE(inlet.pull_sample(sample.data(), nchan, 5.) != 0.);
+				latencies.push_back(lsl::lsl_clock() - pushed);
+			}
+			std::sort(latencies.begin(), latencies.end());
+			const auto quantile_us = [&](double q) {
+				return latencies[static_cast<std::size_t>(q * (latencies.size() - 1))] * 1e6;
+			};
+
+			// --- throughput: chunks pushed as fast as possible, pulled in another thread ---
+			std::atomic<std::size_t> received{0};
+			std::atomic<bool> stop{false};
+			std::thread reader([&]() {
+				std::vector<float> buf(nchan * 1024);
+				while (!stop) {
+					const auto n =
+						inlet.pull_chunk_multiplexed(buf.data(), nullptr, buf.size(), 0, .05);
+					received += n / nchan;
+				}
+			});
+			std::size_t pushed = 0;
+			const double cpu_start = cpu_seconds();
+			const auto start = clock_type::now();
+			do {
+				for (int i = 0; i < 16; ++i)
+					outlet.push_chunk_multiplexed(data.data(), data.size());
+				pushed += 16 * chunk;
+			} while (elapsed(start) < seconds);
+			// wait until the reader got everything or stops receiving anything
+			std::size_t last = 0;
+			auto last_progress = clock_type::now();
+			while (received < pushed && elapsed(last_progress) < .5) {
+				if (received != last) {
+					last = received;
+					last_progress = clock_type::now();
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			const double transfer_seconds = elapsed(start), cpu = cpu_seconds() - cpu_start;
+			stop = true;
+			reader.join();
+
+			const double mb = received * nchan * sizeof(float) / 1e6;
+			std::printf("%-22s %-8s %12.0f %10.1f %12.2f %9.1f %9.1f\n", mode.name,
+				foreign ? "swapped" : "native", received / transfer_seconds, mb / transfer_seconds,
+				mb > 0 ? cpu * 1e3 / mb : 0., quantile_us(.5), quantile_us(.99));
+			CHECK(received > 0);
+		}
+}
+
+} // namespace
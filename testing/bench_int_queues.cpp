@@ -0,0 +1,101 @@
+#include "consumer_queue.h"
+#include "sample.h"
+#include "send_buffer.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::size_t batch = 1000;
+
+std::vector<lsl::sample_p> make_samples(lsl::factory &fac, std::size_t n) {
+	std::vector<lsl::sample_p> samples;
+	for (std::size_t i = 0; i < n; ++i) samples.push_back(fac.new_sample(i, true));
+	return samples;
+}
+
+TEST_CASE("consumer_queue", "[queue][throughput]") {
+	lsl::factory fac(cft_float32, 8, 1);
+	const auto samples = make_samples(fac, batch);
+
+	lsl::consumer_queue queue(2 * batch);
+	BENCHMARK("push/pop x1000") {
+		for (const auto &s : samples) queue.push_sample(s);
+		for (std::size_t i = 0; i < batch; ++i) queue.pop_sample(0.);
+	};
+
+	BENCHMARK("push_samples, pop_samples(100)") {
+		lsl::sample_p out[100];
+		queue.push_samples(samples.data(), batch);
+		while (queue.pop_samples(out, 100)) {}
+	};
+
+	// a consumer thread pops samples while they're pushed
+	std::atomic<bool> stop{false};
+	std::atomic<std::size_t> popped{0};
+	std::thread consumer([&]() {
+		while (!stop)
+			if (queue.pop_sample(.01)) ++popped;
+	});
+	BENCHMARK("push x1000, concurrent pop") {
+		const std::size_t target = popped + batch;
+		for (const auto &s : samples) queue.push_sample(s);
+		while (popped < target) std::this_thread::yield();
+	};
+	stop = true;
+	consumer.join();
+}
+
+TEST_CASE("send_buffer fan-out", "[queue][throughput]") {
+	lsl::factory fac(cft_float32, 8, 1);
+	const auto samples = make_samples(fac, batch);
+
+	for (int n_consumers : {1, 8, 64}) {
+		auto buffer = std::make_shared<lsl::send_buffer>(2 * batch);
+		std::vector<std::shared_ptr<lsl::consumer_queue>> consumers;
+		for (int i = 0; i < n_consumers; ++i) consumers.push_back(buffer->new_consumer());
+		const std::string suffix = std::to_string(n_consumers) + " consumers";
+
+		BENCHMARK("push_sample x1000, " + suffix) {
+			for (const auto &s : samples) buffer->push_sample(s);
+			for (auto &c : consumers) c->flush();
+		};
+
+		BENCHMARK("push_samples(1000), " + suffix) {
+			buffer->push_samples(samples.data(), batch);
+			for (auto &c : consumers) c->flush();
+		};
+	}
+}
+
+TEST_CASE("factory", "[samples][throughput]") {
+	lsl::factory fac(cft_float32, 8, 16);
+
+	BENCHMARK("new_sample/reclaim x1000") {
+		for (std::size_t i = 0; i < batch; ++i) fac.new_sample(0., true);
+	};
+
+	BENCHMARK("new_sample x1000, reclaim x1000") {
+		return make_samples(fac, batch).size();
+	};
+
+	// the samples are reclaimed by the thread dropping the last reference, as in an outlet
+	lsl::consumer_queue queue(2 * batch);
+	std::atomic<bool> stop{false};
+	std::atomic<std::size_t> reclaimed{0};
+	std::thread reclaimer([&]() {
+		while (!stop)
+			if (queue.pop_sample(.01)) ++reclaimed;
+	});
+	BENCHMARK("new_sample x1000, reclaim in thread") {
+		const std::size_t target = reclaimed + batch;
+		for (std::size_t i = 0; i < batch; ++i) queue.push_sample(fac.new_sample(0., true));
+		while (reclaimed < target) std::this_thread::yield();
+	};
+	stop = true;
+	reclaimer.join();
+}
+
+} // namespace
@@ -0,0 +1,62 @@
+#include "sample.h"
+#include "time_postprocessor.h"
+#include <catch2/catch.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+TEST_CASE("sample serialization", "[samples][throughput]") {
+	const std::pair<lsl_channel_format_t, const char *> formats[] = {{cft_float32, "float32"},
+		{cft_double64, "double64"}, {cft_string, "string"}, {cft_int32, "int32"},
+		{cft_int16, "int16"}, {cft_int8, "int8"}, {cft_int64, "int64"}};
+	const uint32_t nchan = 32;
+
+	for (const auto &format : formats) {
+		lsl::factory fac(format.first, nchan, 1);
+		lsl::sample_p smp = fac.new_sample(17.5, true);
+		smp->assign_test_pattern(2);
+		std::vector<char> scratch(nchan * lsl::format_sizes[format.first]);
+		for (int byte_order : {BOOST_BYTE_ORDER, BOOST_BYTE_ORDER == 1234 ? 4321 : 1234}) {
+			const std::string suffix = std::string(format.second) +
+									   (byte_order == BOOST_BYTE_ORDER ? ", native" : ", swapped");
+			std::stringbuf sb;
+			smp->save_streambuf(sb, 110, byte_order, scratch.data());
+
+			BENCHMARK("save_streambuf " + suffix) {
+				sb.pubseekpos(0, std::ios::out);
+				smp->save_streambuf(sb, 110, byte_order, scratch.data());
+			};
+
+			lsl::sample_p loaded = fac.new_sample(0., false);
+			BENCHMARK("load_streambuf " + suffix) {
+				sb.pubseekpos(0, std::ios::in);
+				loaded->load_streambuf(sb, 110, byte_order, false);
+			};
+		}
+	}
+}
+
+TEST_CASE("dejitter", "[postproc][throughput]") {
+	const std::size_t n = 1000;
+	const double srate = 1000.;
+	std::vector<double> timestamps(n);
+	for (std::size_t i = 0; i < n; ++i) timestamps[i] = 1000. + i / srate + (i % 7) * 1e-5;
+
+	lsl::postproc_dejitterer dejitterer(timestamps[0], srate, 90.);
+	BENCHMARK("dejitter x1000") {
+		double sum = 0;
+		for (double t : timestamps) sum += dejitterer.dejitter(t);
+		return sum;
+	};
+
+	std::vector<double> chunk(n);
+	BENCHMARK("dejitter chunk of 1000") {
+		chunk = timestamps;
+		dejitterer.dejitter(chunk.data(), chunk.size());
+		return chunk.back();
+	};
+}
+
+} // namespace
@@ -4,6 +4,7 @@
 
 TEST_CASE("sleep") {
 	BENCHMARK("sleep1ms") { std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+	BENCHMARK("sleep_precise1ms") { lsl::sleep_precise(0.001); };
 }
 
 TEST_CASE("read system clock"){
@@ -0,0 +1,203 @@
+#include "api_config.h"
+#include "inlet_connection.h"
+#include "stream_info_impl.h"
+#include "stream_outlet_impl.h"
+#include "time_postprocessor.h"
+#include "time_receiver.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// The accuracy of the time synchronization depends on the [tuning] settings (TimeUpdateInterval,
+// TimeProbeCount, TimeProbeInterval, TimeDriftHalftime, SharedTimeSync), so run this with the
+// config file to evaluate, e.g.
+// LSLAPICFG=candidate.cfg testing/lsl_bench_internal "time sync accuracy"
+
+namespace {
+namespace asio = lslboost::asio;
+using asio::ip::udp;
+
+/// how long each scenario runs (in seconds, after the first estimate)
+const double duration = 10.;
+/// the rate of the simulated stream
+const double srate = 100.;
+
+/**
+ * A delay line between inlets and an outlet's UDP server that simulates a remote clock: the time
+ * probes are delayed in both directions by a fixed latency plus an exponentially distributed
+ * jitter, and the outlet's time stamps in the replies are mapped to a clock with an offset and a
+ * drift.
+ */
+class sync_shim {
+public:
+	sync_shim(uint16_t target_port, double offset, double drift, double latency, double jitter)
+		: offset_(offset), drift_(drift), start_(lsl::lsl_clock()), latency_(latency),
+		  jitter_(jitter), inlets_(io_, udp::endpoint(asio::ip::address_v4::loopback(), 0)),
+		  outlet_(io_, udp::endpoint(asio::ip::address_v4::loopback(), 0)),
+		  target_(asio::ip::address_v4::loopback(), target_port) {
+		receive(inlets_, true);
+		receive(outlet_, false);
+		thread_ = std::thread([this]() { io_.run(); });
+	}
+
+	~sync_shim() {
+		io_.stop();
+		thread_.join();
+	}
+
+	/// The port the inlets send their time probes to.
+	uint16_t port() const { return inlets_.local_endpoint().port(); }
+
+	/// The simulated remote clock at a local time.
+	double remote(double t) const { return t + offset_ + drift_ * (t - start_); }
+
+	/// The true time correction (local minus remote time) at a remote time.
+	double correction(double remote_t) const {
+		return (remote_t - offset_ + drift_ * start_) / (1. + drift_) - remote_t;
+	}
+
+	/// The number of time probes sent by the inlets so far.
+	uint64_t probes() const { return probes_; }
+
+private:
+	void receive(udp::socket &sock, bool from_inlet) {
+		sock.async_receive_from(asio::buffer(buffer(from_inlet)), sender(from_inlet),
+			[this, &sock, from_inlet](const lslboost::system::error_code &err, std::size_t len) {
+				if (err) return;
+				handle(from_inlet, std::string(buffer(from_inlet).data(), len));
+				receive(sock, from_inlet);
+			});
+	}
+
+	std::vector<char> &buffer(bool from_inlet) { return from_inlet ? inlet_buf_ : outlet_buf_; }
+	udp::endpoint &sender(bool from_inlet) { return from_inlet ? inlet_sender_ : outlet_sender_; }
+
+	void handle(bool from_inlet, const std::string &packet) {
+		std::istringstream is(packet);
+		if (from_inlet) {
+			// LSL:timedata\r\n[wave id] [t0]\r\n
+			std::string method;
+			int wave_id;
+			std::getline(is, method);
+			if (!(is >> wave_id)) return;
+			waves_[wave_id] = inlet_sender_;
+			++probes_;
+			delayed_send(outlet_, target_, packet);
+			return;
+		}
+		// [wave id] [t0] [t1] [t2], with t1 and t2 taken by the outlet's clock
+		int wave_id;
+		double t0, t1, t2;
+		if (!(is >> wave_id >> t0 >> t1 >> t2) || !waves_.count(wave_id)) return;
+		std::ostringstream reply;
+		reply.precision(16);
+		reply << ' ' << wave_id << ' ' << t0 << ' ' << remote(t1) << ' ' << remote(t2);
+		delayed_send(inlets_, waves_[wave_id], reply.str());
+	}
+
+	void delayed_send(udp::socket &sock, const udp::endpoint &to, const std::string &packet) {
+		const double delay = latency_ + (jitter_ > 0 ? jitter_dist_(rng_) * jitter_ : 0.);
+		auto timer = std::make_shared<asio::steady_timer>(
+			io_, std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					 std::chrono::duration<double>(delay)));
+		auto msg = std::make_shared<std::string>(packet);
+		timer->async_wait([timer, msg, &sock, to](const lslboost::system::error_code &err) {
+			if (!err)
+				sock.async_send_to(asio::buffer(*msg), to,
+					[msg](const lslboost::system::error_code &, std::size_t) {});
+		});
+	}
+
+	const double offset_, drift_, start_, latency_, jitter_;
+	asio::io_context io_;
+	udp::socket inlets_, outlet_;
+	udp::endpoint target_, inlet_sender_, outlet_sender_;
+	std::vector<char> inlet_buf_ = std::vector<char>(65536), outlet_buf_ = inlet_buf_;
+	/// the inlet that sent a wave of probes
+	std::map<int, udp::endpoint> waves_;
+	std::mt19937 rng_;
+	std::exponential_distribution<double> jitter_dist_;
+	std::atomic<uint64_t> probes_{0};
+	std::thread thread_;
+};
+
+struct scenario {
+	const char *name;
+	double offset, drift, latency, jitter;
+	int inlets;
+};
+
+struct error_stats {
+	std::vector<double> abs_errors;
+	void add(double error) { abs_errors.push_back(std::fabs(error)); }
+	double percentile(double p) {
+		std::sort(abs_errors.begin(), abs_errors.end());
+		return abs_errors[static_cast<std::size_t>(p * (abs_errors.size() - 1))];
+	}
+};
+
+TEST_CASE("time sync accuracy", "[timesync]") {
+	const scenario s = GENERATE(values<scenario>({{"loopback", 0., 0., 0., 0., 1},
+		{"offset+drift", 1000., 100e-6, 0., 0., 1},
+		{"offset+drift+jitter", 1000., 100e-6, .002, .003, 1},
+		{"offset+drift+jitter x16", 1000., 100e-6, .002, .003, 16}}));
+	const lsl::api_config *cfg = lsl::api_config::get_instance();
+
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("timesync", "bench", 1, srate, cft_float32, "timesync"));
+	lsl::stream_info_impl info(outlet.info());
+	sync_shim shim(info.v4service_port(), s.offset, s.drift, s.latency, s.jitter);
+	info.v4address("127.0.0.1");
+	info.v4service_port(shim.port());
+
+	std::vector<std::unique_ptr<lsl::inlet_connection>> conns;
+	std::vector<std::unique_ptr<lsl::time_receiver>> receivers;
+	for (int i = 0; i < s.inlets; ++i) {
+		conns.emplace_back(new lsl::inlet_connection(info, false));
+		receivers.emplace_back(new lsl::time_receiver(*conns.back()));
+		conns.back()->engage();
+	}
+	lsl::time_receiver &tr = *receivers.front();
+	lsl::time_postprocessor pp([&tr]() { return tr.time_correction_model(5.); },
+		[]() { return srate; }, [&tr]() { return tr.was_reset(); });
+	pp.set_options(proc_clocksync | proc_dejitter);
+	for (auto &receiver : receivers) receiver->time_correction(5.);
+
+	// a regular stream stamped by the remote clock; every tenth sample, the latest estimate is
+	// applied to the current remote time
+	error_stats correction_errors, timestamp_errors;
+	const uint64_t probes_before = shim.probes();
+	const double start = lsl::lsl_clock();
+	for (int i = 0; i < duration * srate; ++i) {
+		const double t = start + i / srate;
+		std::this_thread::sleep_for(std::chrono::duration<double>(t - lsl::lsl_clock()));
+		timestamp_errors.add(pp.process_timestamp(shim.remote(t)) - t);
+		double offset;
+		if (i % 10 == 0 && tr.latest_time_correction(offset, nullptr, nullptr))
+			correction_errors.add(shim.remote(t) + offset - t);
+	}
+	const double probes_per_second = (shim.probes() - probes_before) / (lsl::lsl_clock() - start);
+	for (auto &conn : conns) conn->disengage();
+	receivers.clear();
+
+	printf("%-24s update every %gs, %d probes: time_correction() error p50 %7.3f ms, p99 "
+		   "%7.3f ms | timestamp error p50 %7.3f ms, p99 %7.3f ms | %5.1f probes/s\n",
+		s.name, cfg->time_update_interval(), cfg->time_probe_count(),
+		correction_errors.percentile(.5) * 1e3, correction_errors.percentile(.99) * 1e3,
+		timestamp_errors.percentile(.5) * 1e3, timestamp_errors.percentile(.99) * 1e3,
+		probes_per_second);
+	CHECK(!correction_errors.abs_errors.empty());
+}
+
+} // namespace
@@ -0,0 +1,40 @@
+#include "latency_histogram.h"
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("latency histogram buckets", "[basic]") {
+	using lsl::latency_histogram;
+	// the buckets are contiguous and ordered
+	for (std::size_t i = 1; i < latency_histogram::num_buckets; ++i) {
+		const uint64_t start = latency_histogram::bucket_start(i);
+		REQUIRE(start > latency_histogram::bucket_start(i - 1));
+		REQUIRE(latency_histogram::bucket(start) == i);
+		REQUIRE(latency_histogram::bucket(start - 1) == i - 1);
+	}
+	CHECK(latency_histogram::bucket(UINT64_MAX) == latency_histogram::num_buckets - 1);
+}
+
+TEST_CASE("latency histogram percentiles", "[basic]") {
+	lsl::latency_histogram hist;
+	CHECK(hist.percentile(0.5) == 0.0);
+	// 1 to 1000 microseconds, recorded concurrently
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([&hist, t]() {
+			for (int i = 1 + t; i <= 1000; i += 4) hist.record(i * 1e-6);
+		});
+	for (auto &thread : threads) thread.join();
+	CHECK(hist.count() == 1000);
+	CHECK(hist.percentile(0.5) == Approx(500e-6).epsilon(0.03));
+	CHECK(hist.percentile(0.99) == Approx(990e-6).epsilon(0.03));
+	CHECK(hist.percentile(0.999) == Approx(999e-6).epsilon(0.03));
+	CHECK(hist.percentile(1.0) == Approx(1000e-6).epsilon(0.03));
+
+	hist.record(-1.0);
+	CHECK(hist.percentile(0.0) == Approx(0.0).margin(1e-9));
+	hist.reset();
+	CHECK(hist.count() == 0);
+	CHECK(hist.percentile(0.5) == 0.0);
+}
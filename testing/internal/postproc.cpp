@@ -76,3 +76,98 @@ TEST_CASE("rls_smoothing", "[basic]") {
 	CHECK(fabs(pp.w0_ - latency) < .1);
 	CHECK(fabs(pp.w1_ - 1 / srate) < 1e-6);
 }
+
+TEST_CASE("postprocessing_chunks", "[basic]") {
+	const int n = 1000;
+	const double srate = 100.;
+	lsl::time_postprocessor single([]() { return -50.; }, [&]() { return srate; },
+		[]() { return false; }),
+		chunked([]() { return -50.; }, [&]() { return srate; }, []() { return false; });
+	single.set_options(proc_ALL);
+	chunked.set_options(proc_ALL);
+
+	std::default_random_engine rng;
+	std::normal_distribution<double> jitter(0, .005);
+	std::vector<double> ts(n);
+	for (int i = 0; i < n; ++i) ts[i] = 5000 + i / srate + jitter(rng);
+
+	// processing a chunk gives the same results as processing the samples one by one
+	std::vector<double> chunk(ts);
+	for (int i = 0; i < n; i += 100) chunked.process_timestamps(&chunk[i], 100);
+	for (int i = 0; i < n; ++i) CHECK(chunk[i] == Approx(single.process_timestamp(ts[i])));
+}
+
+TEST_CASE("postprocessing on the receive thread", "[basic]") {
+	const int n = 1000;
+	const double srate = 100.;
+	uint64_t missed = 0;
+	lsl::time_postprocessor pulled([]() { return -50.; }, [&]() { return srate; },
+		[]() { return false; }),
+		received([]() { return -50.; }, [&]() { return srate; }, []() { return false; });
+	pulled.set_options(proc_ALL);
+	received.set_options(proc_ALL | proc_receive_thread);
+	pulled.set_gap_source([&]() { return missed; });
+	received.set_gap_source([&]() { return missed; });
+
+	std::default_random_engine rng;
+	std::normal_distribution<double> jitter(0, .005);
+	std::vector<double> ts(n);
+	for (int i = 0; i < n; ++i) ts[i] = 5000 + i / srate + jitter(rng);
+
+	// the received samples are processed once, the pull calls leave them as they are
+	std::vector<double> expected(ts), chunk(ts);
+	for (int i = 0; i < n; i += 100) {
+		// every chunk follows 10 missed samples
+		if (i) missed += 10;
+		pulled.process_timestamps(&expected[i], 100);
+		received.process_received(&chunk[i], 100);
+		received.process_timestamps(&chunk[i], 100);
+		received.skip_samples(100);
+		CHECK(received.process_timestamp(chunk[i]) == chunk[i]);
+		pulled.process_received(&expected[i], 100);
+	}
+	for (int i = 0; i < n; ++i) CHECK(chunk[i] == Approx(expected[i]));
+}
+
+TEST_CASE("clock drift estimation", "[basic]") {
+	// the remote clock runs 20 ppm slow and is 100 s behind
+	const double drift = 20e-6, offset = 100.;
+	std::default_random_engine rng;
+	std::uniform_real_distribution<double> rtt(.0002, .002);
+	lsl::clock_drift_estimator est(300.);
+	REQUIRE(est.empty());
+	for (int i = 0; i < 2000; ++i) {
+		const double t = 1000. + i * .5, probe_rtt = rtt(rng);
+		// a probe's error is bounded by its rtt
+		std::uniform_real_distribution<double> error(-probe_rtt / 2, probe_rtt / 2);
+		est.add(t, offset + drift * t + error(rng), probe_rtt);
+	}
+	REQUIRE(!est.empty());
+	const lsl::clock_model model = est.model();
+	CHECK(model.drift == Approx(drift).margin(2e-6));
+	const double now = 1000. + 2000 * .5;
+	CHECK(model.at(now) == Approx(offset + drift * now).margin(1e-4));
+
+	est.reset();
+	CHECK(est.empty());
+	// without enough time covered there's no drift
+	est.add(5000., 1., .001);
+	est.add(5001., 1.001, .001);
+	CHECK(est.model().drift == 0.);
+	CHECK(est.model().at(6000.) == Approx(1.0005));
+}
+
+TEST_CASE("postprocessing with a drift model", "[basic]") {
+	lsl::clock_model model;
+	model.offset = 10.;
+	model.drift = 1e-5;
+	model.t0 = 5000.;
+	lsl::time_postprocessor pp([model]() { return model; }, []() { return 100.; },
+		[]() { return false; });
+	pp.set_options(proc_clocksync);
+	CHECK(pp.process_timestamp(5000.) == Approx(5010.));
+	CHECK(pp.process_timestamp(5100.) == Approx(5110.001));
+	double chunk[] = {5000., 5100.};
+	pp.process_timestamps(chunk, 2);
+	CHECK(chunk[1] - chunk[0] == Approx(100.001));
+}
@@ -1,8 +1,10 @@
 #include "sample.h"
 #include <catch2/catch.hpp>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <type_traits>
+#include <vector>
 
 #define NO_EXPLICIT_TEMPLATE_INSTANTIATION
 #include "portable_archive/portable_iarchive.hpp"
@@ -109,3 +111,52 @@ TEST_CASE("v100 protocol serialization", "[basic][serialization]") {
 }
 
 TEST_CASE("read v100 protocol samples", "[basic][serialization]") {}
+
+/// Serialize samples via the archive and via sample::save_portable() and compare the output
+template <typename T>
+void check_portable(lsl_channel_format_t fmt, const std::vector<T> &values, double timestamp) {
+	const auto n = static_cast<uint32_t>(values.size());
+	lsl::factory fac(fmt, n, 1);
+	lsl::sample_p first(fac.new_sample(0.0, false)), samp(fac.new_sample(timestamp, false));
+	first->assign_test_pattern(1);
+	samp->assign_typed(values.data());
+
+	std::stringbuf archived(std::ios::out);
+	{
+		eos::portable_oarchive outarch(archived);
+		// the first sample is preceded by the class header
+		outarch << *first;
+		archived.str("");
+		outarch << *samp;
+	}
+	std::stringbuf direct(std::ios::in | std::ios::out);
+	samp->save_portable(direct);
+	REQUIRE(direct.str() == archived.str());
+
+	lsl::sample_p in(fac.new_sample(0.0, false));
+	in->load_portable(direct);
+	CHECK(in->timestamp == samp->timestamp);
+	std::vector<T> loaded(n);
+	in->retrieve_typed(loaded.data());
+	for (uint32_t k = 0; k < n; ++k)
+		if (values[k] == values[k]) CHECK(loaded[k] == values[k]);
+		else CHECK(loaded[k] != loaded[k]);
+}
+
+TEST_CASE("v100 fast path is byte-compatible", "[basic][serialization]") {
+	const double inf = std::numeric_limits<double>::infinity(),
+				 nan = std::numeric_limits<double>::quiet_NaN();
+	for (double ts : {17.3, lsl::DEDUCED_TIMESTAMP, 0.0, -inf}) {
+		check_portable<int8_t>(cft_int8, {0, 1, -1, 127, -128}, ts);
+		check_portable<int16_t>(cft_int16, {0, 255, -256, 256, 32767, -32768}, ts);
+		check_portable<int32_t>(cft_int32, {0, 0xabcdef, -1, INT32_MIN, INT32_MAX, 128}, ts);
+		check_portable<int64_t>(cft_int64, {0, -2, INT64_MIN, INT64_MAX, 1LL << 40}, ts);
+		check_portable<float>(cft_float32,
+			{0.f, -0.f, 1.5f, -17.3f, 1e-40f, static_cast<float>(inf), static_cast<float>(-inf),
+				static_cast<float>(nan), -static_cast<float>(nan)},
+			ts);
+		check_portable<double>(cft_double64, {0., -0., 17.3, -1e300, 5e-324, inf, -inf, nan}, ts);
+		check_portable<std::string>(cft_string,
+			{"", "a", std::string("with\x00nulls", 10), std::string(300, 'x')}, ts);
+	}
+}
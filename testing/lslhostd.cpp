@@ -0,0 +1,31 @@
+#include "../include/lsl_cpp.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/**
+ * Publishes the outlets of the processes on this host that set [tuning] HostDaemon to the
+ * daemon's socket path (by default /tmp/lsl-hostd.sock).
+ *
+ * Usage: lslhostd [socket path]
+ */
+int main(int argc, char *argv[]) {
+	const std::string path = argc > 1 ? argv[1] : "/tmp/lsl-hostd.sock";
+	try {
+		lsl::host_daemon daemon(path);
+		std::cout << "Publishing the outlets of the processes that connect to " << path
+				  << ", press Ctrl-C to stop" << std::endl;
+		int32_t published = 0;
+		while (true) {
+			const int32_t n = daemon.size();
+			if (n != published) std::cout << n << " streams published" << std::endl;
+			published = n;
+			std::this_thread::sleep_for(std::chrono::seconds(2));
+		}
+	} catch (std::exception &e) {
+		std::cerr << "Could not start the host daemon: " << e.what() << std::endl;
+		return 1;
+	}
+}
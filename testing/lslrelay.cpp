@@ -0,0 +1,38 @@
+#include "../include/lsl_cpp.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/**
+ * Re-publishes the streams of the lab network (or those matching a query, e.g. "type='EEG'"),
+ * so remote machines can subscribe to the relay instead of the acquisition machine.
+ *
+ * Usage: lslrelay [query]
+ */
+int main(int argc, char *argv[]) {
+	const std::string query = argc > 1 ? argv[1] : "";
+	lsl::relay relay;
+	lsl::continuous_resolver resolver =
+		query.empty() ? lsl::continuous_resolver() : lsl::continuous_resolver(query);
+	std::cout << "Relaying " << (query.empty() ? "all streams" : query) << ", press Ctrl-C to stop"
+			  << std::endl;
+	int32_t relayed = 0;
+	while (true) {
+		for (const auto &info : resolver.results()) {
+			try {
+				relay.add(info);
+				std::cout << "Relaying " << info.name() << " (" << info.uid() << ") from "
+						  << info.hostname() << std::endl;
+			} catch (std::invalid_argument &) {
+				// relayed already, or one of the relay's own outlets
+			} catch (std::exception &e) {
+				std::cerr << "Could not relay " << info.name() << ": " << e.what() << std::endl;
+			}
+		}
+		if (relay.size() < relayed) std::cout << relay.size() << " streams left" << std::endl;
+		relayed = relay.size();
+		std::this_thread::sleep_for(std::chrono::seconds(2));
+	}
+}
@@ -1,9 +1,13 @@
 #include "helper_type.hpp"
 #include "helpers.h"
 #include <catch2/catch.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <lsl_cpp.h>
 #include <thread>
+#include <vector>
 
 TEMPLATE_TEST_CASE(
 	"datatransfer", "[datatransfer][basic]", char, int16_t, int32_t, int64_t, float, double) {
@@ -71,10 +75,45 @@ TEST_CASE("TypeConversion", "[datatransfer][types][basic]") {
 	}
 }
 
+TEST_CASE("int24", "[datatransfer][types][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("int24", "Test", 3, lsl::IRREGULAR_RATE, lsl::cf_int24, "int24"))};
+	CHECK(sp.in_.info().channel_format() == lsl::cf_int24);
+	const int32_t sent[] = {8388607, -8388608, -5};
+	sp.out_.push_sample(sent);
+	int32_t received[3];
+	REQUIRE(sp.in_.pull_sample(received, 3, 2.) != 0.0);
+	CHECK(std::equal(received, received + 3, sent));
+	const double sent_d[] = {1., -2., 3.};
+	sp.out_.push_sample(sent_d);
+	double received_d[3];
+	REQUIRE(sp.in_.pull_sample(received_d, 3, 2.) != 0.0);
+	CHECK(std::equal(received_d, received_d + 3, sent_d));
+}
+
+TEST_CASE("float16", "[datatransfer][types][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("float16", "Test", 3, lsl::IRREGULAR_RATE, lsl::cf_float16, "float16"))};
+	CHECK(sp.in_.info().channel_format() == lsl::cf_float16);
+	const float sent[] = {0.5f, -65504.f, 1.f / 1024};
+	sp.out_.push_sample(sent);
+	float received[3];
+	REQUIRE(sp.in_.pull_sample(received, 3, 2.) != 0.0);
+	CHECK(std::equal(received, received + 3, sent));
+	const int16_t sent_i[] = {1, -2000, 2048};
+	sp.out_.push_sample(sent_i);
+	int16_t received_i[3];
+	REQUIRE(sp.in_.pull_sample(received_i, 3, 2.) != 0.0);
+	CHECK(std::equal(received_i, received_i + 3, sent_i));
+}
+
 TEST_CASE("Flush", "[datatransfer][basic]") {
 	Streampair sp{create_streampair(
 		lsl::stream_info("FlushTest", "flush", 1, 1, lsl::cf_double64, "FlushTest"))};
-	sp.in_.set_postprocessing(lsl::post_dejitter);
+	// the time stamps are dejittered in the pull calls or as the samples arrive
+	const uint32_t flags =
+		GENERATE(lsl::post_dejitter, lsl::post_dejitter | lsl::post_receive_thread);
+	sp.in_.set_postprocessing(flags);
 
 	const int n=20;
 
@@ -102,3 +141,374 @@ TEST_CASE("Flush", "[datatransfer][basic]") {
 	pusher.join();
 	//sp.in_.set_postprocessing(lsl::post_none);
 }
+
+TEST_CASE("pull_chunk", "[datatransfer][basic]") {
+	const int nchan = 3, nsamples = 50;
+	Streampair sp{create_streampair(
+		lsl::stream_info("PullChunk", "chunks", nchan, 100, lsl::cf_int32, "PullChunk"))};
+
+	std::vector<int32_t> sent(nchan * nsamples), received(nchan * nsamples);
+	for (std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<int32_t>(i);
+	std::vector<double> sent_ts(nsamples), received_ts(nsamples);
+	for (int i = 0; i < nsamples; ++i) sent_ts[i] = 1000. + i;
+	sp.out_.push_chunk_multiplexed(sent.data(), sent_ts.data(), sent.size());
+
+	std::size_t pulled = sp.in_.pull_chunk_multiplexed(
+		received.data(), received_ts.data(), received.size(), received_ts.size(), 5.);
+	REQUIRE(pulled == sent.size());
+	CHECK(received == sent);
+	CHECK(received_ts == sent_ts);
+
+	// nothing more is available
+	CHECK(sp.in_.pull_chunk_multiplexed(
+			  received.data(), received_ts.data(), received.size(), received_ts.size(), 0.) == 0);
+}
+
+TEST_CASE("pull_chunk_planar", "[datatransfer][basic]") {
+	// more samples than one transpose block, and fewer than fit into the buffer
+	const int nchan = 5, nsamples = 37, capacity = 40;
+	Streampair sp{create_streampair(
+		lsl::stream_info("PullPlanar", "chunks", nchan, 100, lsl::cf_float32, "PullPlanar"))};
+
+	std::vector<float> sent(nchan * nsamples);
+	for (std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<float>(i);
+	std::vector<double> sent_ts(nsamples);
+	for (int i = 0; i < nsamples; ++i) sent_ts[i] = 1000. + i;
+	sp.out_.push_chunk_multiplexed(sent.data(), sent_ts.data(), sent.size());
+
+	std::vector<float> received(nchan * capacity, -1.f);
+	std::vector<double> received_ts(capacity);
+	std::size_t pulled = 0;
+	for (int tries = 0; pulled < sent.size() && tries < 50; ++tries)
+		pulled = sp.in_.pull_chunk_planar(
+			received.data(), received_ts.data(), received.size(), received_ts.size(), 0.1);
+	REQUIRE(pulled == sent.size());
+	for (int c = 0; c < nchan; ++c) {
+		INFO("channel " << c);
+		for (int k = 0; k < nsamples; ++k) CHECK(received[c * capacity + k] == sent[k * nchan + c]);
+		CHECK(received[c * capacity + nsamples] == -1.f);
+	}
+	CHECK(received_ts[nsamples - 1] == sent_ts.back());
+}
+
+TEST_CASE("push_chunk_planar", "[datatransfer][basic]") {
+	const int nchan = 3, nsamples = 21;
+	Streampair sp{create_streampair(
+		lsl::stream_info("PushPlanar", "chunks", nchan, 100, lsl::cf_int32, "PushPlanar"))};
+
+	std::vector<std::vector<int32_t>> channels(nchan, std::vector<int32_t>(nsamples));
+	for (int c = 0; c < nchan; ++c)
+		for (int k = 0; k < nsamples; ++k) channels[c][k] = k * nchan + c;
+	// the values are converted like those of the other push functions
+	std::vector<const double *> converted;
+	std::vector<std::vector<double>> doubles{{1.0}, {2.0}, {3.0}};
+	for (const auto &channel : doubles) converted.push_back(channel.data());
+	const double last_ts = 1000.;
+	sp.out_.push_chunk_planar(channels, 1000. - 1. / 100);
+	sp.out_.push_chunk_planar(converted.data(), 1, &last_ts);
+	CHECK_THROWS(sp.out_.push_chunk_planar(std::vector<std::vector<int32_t>>(2)));
+
+	std::vector<int32_t> received(nchan * (nsamples + 1));
+	std::vector<double> received_ts(nsamples + 1);
+	std::size_t pulled = 0;
+	for (int tries = 0; pulled < received.size() && tries < 50; ++tries)
+		pulled += sp.in_.pull_chunk_multiplexed(received.data() + pulled,
+			received_ts.data() + pulled / nchan, received.size() - pulled,
+			received_ts.size() - pulled / nchan, 0.1);
+	REQUIRE(pulled == received.size());
+	for (int k = 0; k < nsamples * nchan; ++k) CHECK(received[k] == k);
+	CHECK(received[nsamples * nchan + 2] == 3);
+	CHECK(received_ts[nsamples - 1] == Approx(1000. - 1. / 100));
+	CHECK(received_ts[nsamples] == 1000.);
+}
+
+TEST_CASE("large samples", "[datatransfer][basic]") {
+	// large enough to be sent straight from the sample memory
+	const int nchan = 512, nsamples = 20;
+	Streampair sp{create_streampair(
+		lsl::stream_info("LargeSamples", "chunks", nchan, 100, lsl::cf_float32, "LargeSamples"))};
+
+	std::vector<float> sent(nchan * nsamples), received(nchan * nsamples);
+	for (std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<float>(i);
+	// only the first sample has a transmitted timestamp, the others are deduced
+	sp.out_.push_chunk_multiplexed(sent.data(), sent.size(), 1000.);
+
+	std::vector<double> received_ts(nsamples);
+	REQUIRE(sp.in_.pull_chunk_multiplexed(received.data(), received_ts.data(), received.size(),
+				received_ts.size(), 5.) == sent.size());
+	CHECK(received == sent);
+	// the timestamp refers to the last sample
+	CHECK(received_ts[nsamples - 1] == Approx(1000.));
+	CHECK(received_ts[1] - received_ts[0] == Approx(.01));
+}
+
+TEST_CASE("regular timestamps", "[datatransfer][basic]") {
+	// with [tuning] DeducedTimestampsMax set, most of these time stamps aren't transmitted
+	const int nsamples = 250;
+	Streampair sp{create_streampair(
+		lsl::stream_info("RegularTimestamps", "ts", 1, 100, lsl::cf_int16, "RegularTimestamps"))};
+
+	for (int i = 0; i < nsamples; ++i) {
+		int16_t data = static_cast<int16_t>(i);
+		sp.out_.push_sample(&data, 1000. + i * .01, i == nsamples - 1);
+	}
+	for (int i = 0; i < nsamples; ++i) {
+		INFO(i);
+		int16_t data;
+		// deduced time stamps may deviate from the actual ones by the configured tolerance
+		CHECK(sp.in_.pull_sample(&data, 1, 5.) == Approx(1000. + i * .01).margin(.001).epsilon(0));
+		CHECK(data == i);
+	}
+}
+
+TEST_CASE("borrow_chunk", "[datatransfer][basic]") {
+	const int nchan = 2, nsamples = 30;
+	Streampair sp{create_streampair(
+		lsl::stream_info("BorrowChunk", "chunks", nchan, 100, lsl::cf_int16, "BorrowChunk"))};
+
+	std::vector<int16_t> sent(nchan * nsamples);
+	for (std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<int16_t>(i);
+	std::vector<double> sent_ts(nsamples);
+	for (int i = 0; i < nsamples; ++i) sent_ts[i] = 1000. + i;
+	sp.out_.push_chunk_multiplexed(sent.data(), sent_ts.data(), sent.size());
+
+	int received = 0;
+	while (received < nsamples) {
+		lsl::sample_view view = sp.in_.borrow_chunk(nsamples - received, 5.);
+		REQUIRE(!view.empty());
+		for (std::size_t k = 0; k < view.size(); ++k, ++received) {
+			CHECK(view.timestamp(k) == sent_ts[received]);
+			CHECK(view.data<int16_t>(k)[0] == sent[received * nchan]);
+			CHECK(view.data<int16_t>(k)[1] == sent[received * nchan + 1]);
+		}
+	}
+	CHECK(sp.in_.borrow_chunk(10).empty());
+}
+
+TEST_CASE("strided chunks", "[datatransfer][basic]") {
+	const int nchan = 3, nsamples = 8;
+	Streampair sp{create_streampair(
+		lsl::stream_info("StridedChunk", "chunks", nchan, 100, lsl::cf_int16, "StridedChunk"))};
+
+	// a Fortran-order (channel-major) double matrix
+	std::vector<double> sent(nchan * nsamples);
+	for (int c = 0; c < nchan; ++c)
+		for (int k = 0; k < nsamples; ++k) sent[c * nsamples + k] = 100 * c + k;
+	std::vector<double> sent_ts(nsamples);
+	for (int k = 0; k < nsamples; ++k) sent_ts[k] = 1000. + k;
+	sp.out_.push_chunk_strided(sent.data(), lsl::cf_double64, sizeof(double),
+		nsamples * sizeof(double), nsamples, sent_ts.data());
+
+	// into every other row of a C-order float matrix, with the channels in reverse order
+	const std::ptrdiff_t row = (nchan + 1) * sizeof(float);
+	std::vector<float> received(2 * nsamples * (nchan + 1), -1.f);
+	std::vector<double> received_ts(nsamples);
+	std::size_t n = 0;
+	while (n < nsamples) {
+		char *base = reinterpret_cast<char *>(received.data()) + n * 2 * row;
+		const std::size_t pulled = sp.in_.pull_chunk_strided(base + (nchan - 1) * sizeof(float),
+			lsl::cf_float32, 2 * row, -static_cast<std::ptrdiff_t>(sizeof(float)), nsamples - n,
+			received_ts.data() + n, 5.);
+		REQUIRE(pulled > 0);
+		n += pulled;
+	}
+	for (int k = 0; k < nsamples; ++k) {
+		CHECK(received_ts[k] == sent_ts[k]);
+		for (int c = 0; c < nchan; ++c)
+			CHECK(received[2 * k * (nchan + 1) + (nchan - 1 - c)] == sent[c * nsamples + k]);
+		CHECK(received[2 * k * (nchan + 1) + nchan] == -1.f);
+	}
+	CHECK_THROWS(sp.out_.push_chunk_strided(
+		sent.data(), lsl::cf_string, sizeof(double), nsamples * sizeof(double), nsamples));
+}
+
+TEST_CASE("raw chunks", "[datatransfer][basic]") {
+	const int nchan = 4, nsamples = 16;
+	Streampair sp{create_streampair(
+		lsl::stream_info("RawChunk", "chunks", nchan, 100, lsl::cf_float32, "RawChunk"))};
+
+	// little endian float32 values, as a driver would produce them
+	std::vector<char> block(nsamples * nchan * sizeof(float));
+	for (int k = 0; k < nsamples * nchan; ++k) {
+		const float value = k * .5f;
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		for (int b = 0; b < 4; ++b) block[k * 4 + b] = static_cast<char>(bits >> (8 * b));
+	}
+	sp.out_.push_chunk_raw(block.data(), block.size(), nullptr, 1000. + (nsamples - 1) / 100.);
+
+	std::vector<float> received(nsamples * nchan);
+	std::vector<double> ts(nsamples);
+	std::size_t n = 0;
+	while (n < nsamples) {
+		const std::size_t pulled = sp.in_.pull_chunk_multiplexed(received.data() + n * nchan,
+			ts.data() + n, (nsamples - n) * nchan, nsamples - n, 5.);
+		REQUIRE(pulled > 0);
+		n += pulled / nchan;
+	}
+	for (int k = 0; k < nsamples * nchan; ++k) CHECK(received[k] == k * .5f);
+	// the chunk's time stamp belongs to its last sample, the others are deduced
+	CHECK(ts[0] == Approx(1000.));
+	CHECK(ts[nsamples - 1] == Approx(1000. + (nsamples - 1) / 100.));
+
+	CHECK_THROWS(sp.out_.push_chunk_raw(block.data(), block.size() - 1));
+}
+
+TEST_CASE("chunks with sequence numbers", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("SeqChunk", "chunks", 2, 100, lsl::cf_int16, "SeqChunk"))};
+	for (int16_t k = 0; k < 5; ++k) {
+		const int16_t sent[] = {k, static_cast<int16_t>(-k)};
+		sp.out_.push_sample(sent, 1000. + k);
+	}
+	std::vector<double> data(10);
+	double ts[5];
+	uint64_t seqs[5];
+	lsl_chunk_gaps gaps{1, 1};
+	std::size_t n = 0;
+	while (n < 5) {
+		const std::size_t pulled = sp.in_.pull_chunk_seq(
+			data.data() + 2 * n, lsl::cf_double64, 5 - n, ts + n, seqs + n, &gaps, 5.);
+		REQUIRE(pulled > 0);
+		CHECK(gaps.dropped == 0);
+		CHECK(gaps.lost == 0);
+		n += pulled;
+	}
+	for (int k = 0; k < 5; ++k) {
+		CHECK(data[2 * k] == k);
+		CHECK(data[2 * k + 1] == -k);
+		CHECK(ts[k] == 1000. + k);
+		// without a history, the outlet only sends sequence numbers if the inlet asks for them
+		CHECK(seqs[k] == 0);
+	}
+	CHECK_THROWS(sp.in_.pull_chunk_seq(data.data(), lsl::cf_string, 1));
+}
+
+TEST_CASE("sparse samples", "[datatransfer][basic]") {
+	const int nchan = 200;
+	Streampair sp{create_streampair(lsl::stream_info(
+		"SparseSample", "Markers", nchan, lsl::IRREGULAR_RATE, lsl::cf_float32, "SparseSample"))};
+
+	const uint32_t indices[] = {150, 3, 42};
+	const double values[] = {1.5, -2., 7.};
+	sp.out_.push_sample_sparse(indices, values, lsl::cf_double64, 3, 10.);
+	sp.out_.push_sample_sparse(nullptr, nullptr, lsl::cf_double64, 0, 11.);
+	const int32_t more[] = {9};
+	sp.out_.push_sample_sparse(indices, more, lsl::cf_int32, 1, 12.);
+
+	// the nonzero channels in channel order, or only as many as there's room for
+	uint32_t got_indices[4], count = 0;
+	int16_t got_values[4];
+	CHECK(sp.in_.pull_sample_sparse(got_indices, got_values, lsl::cf_int16, 2, count, 5.) == 10.);
+	CHECK(count == 3);
+	CHECK(got_indices[0] == 3);
+	CHECK(got_values[0] == -2);
+	CHECK(got_indices[1] == 42);
+	CHECK(got_values[1] == 7);
+	CHECK(sp.in_.pull_sample_sparse(got_indices, got_values, lsl::cf_int16, 4, count, 5.) == 11.);
+	CHECK(count == 0);
+	// the same samples in dense form
+	std::vector<float> dense;
+	CHECK(sp.in_.pull_sample(dense, 5.) == 12.);
+	for (int c = 0; c < nchan; ++c) CHECK(dense[c] == (c == 150 ? 9.f : 0.f));
+
+	// negative zeros are zeros, too
+	const float zeros[] = {-0.f, 0.f, 1.f};
+	sp.out_.push_sample_sparse(indices, zeros, lsl::cf_float32, 3, 13.);
+	CHECK(sp.in_.pull_sample_sparse(got_indices, got_values, lsl::cf_int16, 4, count, 5.) == 13.);
+	CHECK(count == 1);
+	CHECK(got_indices[0] == 42);
+
+	const uint32_t bad_index = nchan;
+	CHECK_THROWS(sp.out_.push_sample_sparse(&bad_index, values, lsl::cf_double64, 1));
+	CHECK_THROWS(sp.out_.push_sample_sparse(indices, values, lsl::cf_string, 1));
+
+	// string samples can't be pulled in a sparse form, but they aren't lost by trying
+	Streampair strings{create_streampair(lsl::stream_info(
+		"SparseStrings", "Markers", 1, lsl::IRREGULAR_RATE, lsl::cf_string, "SparseStrings"))};
+	strings.out_.push_sample(std::vector<std::string>{"marker"}, 14.);
+	CHECK_THROWS(
+		strings.in_.pull_sample_sparse(got_indices, got_values, lsl::cf_int16, 4, count, 5.));
+	std::vector<std::string> marker;
+	CHECK(strings.in_.pull_sample(marker, 5.) == 14.);
+	CHECK(marker == std::vector<std::string>{"marker"});
+}
+
+TEST_CASE("pull_chunk_arrow", "[datatransfer][basic]") {
+	const int nchan = 2, nsamples = 10;
+	Streampair sp{create_streampair(
+		lsl::stream_info("ArrowChunk", "chunks", nchan, 100, lsl::cf_float32, "ArrowChunk"))};
+	for (int i = 0; i < nsamples; ++i) {
+		const float data[nchan] = {static_cast<float>(i), -static_cast<float>(i)};
+		sp.out_.push_sample(data, 1000. + i, i == nsamples - 1);
+	}
+
+	ArrowArray array;
+	ArrowSchema schema;
+	REQUIRE(sp.in_.pull_chunk_arrow(&array, &schema, nsamples, 5.) > 0);
+	CHECK(std::string(schema.format) == "+s");
+	REQUIRE(schema.n_children == nchan + 1);
+	CHECK(std::string(schema.children[0]->name) == "timestamp");
+	CHECK(std::string(schema.children[0]->format) == "g");
+	CHECK(std::string(schema.children[2]->name) == "1");
+	CHECK(std::string(schema.children[2]->format) == "f");
+	REQUIRE(array.n_children == nchan + 1);
+	const auto *ts = static_cast<const double *>(array.children[0]->buffers[1]);
+	const auto *ch1 = static_cast<const float *>(array.children[2]->buffers[1]);
+	for (int64_t k = 0; k < array.length; ++k) {
+		CHECK(ts[k] == 1000. + k);
+		CHECK(ch1[k] == -k);
+	}
+	// a moved-out child outlives its parent
+	const int64_t length = array.length;
+	ArrowArray column = *array.children[1];
+	array.children[1]->release = nullptr;
+	array.release(&array);
+	schema.release(&schema);
+	CHECK(array.release == nullptr);
+	CHECK(static_cast<const float *>(column.buffers[1])[length - 1] == length - 1);
+	column.release(&column);
+
+	lsl::stream_info strinfo("ArrowStrings", "chunks", 1, lsl::IRREGULAR_RATE, lsl::cf_string);
+	Streampair strings{create_streampair(strinfo)};
+	const std::string markers[] = {"a", "", "bcd"};
+	for (const auto &marker : markers) strings.out_.push_sample(&marker, 0., true);
+	std::size_t pulled = 0;
+	while (pulled < 3) {
+		REQUIRE(strings.in_.pull_chunk_arrow(&array, &schema, 3, 5.) > 0);
+		CHECK(std::string(schema.children[1]->format) == "u");
+		const auto *offsets = static_cast<const int32_t *>(array.children[1]->buffers[1]);
+		const auto *chars = static_cast<const char *>(array.children[1]->buffers[2]);
+		for (int64_t k = 0; k < array.length; ++k, ++pulled)
+			CHECK(std::string(chars + offsets[k], chars + offsets[k + 1]) == markers[pulled]);
+		array.release(&array);
+		schema.release(&schema);
+	}
+}
+
+TEST_CASE("typed outlet and inlet", "[datatransfer][basic]") {
+	lsl::typed_outlet<int16_t, 3> out("TypedIMU", "imu", 1000, "TypedIMU");
+	auto found = lsl::resolve_stream("name", "TypedIMU", 1, 2.0);
+	REQUIRE(!found.empty());
+	CHECK_THROWS_AS((lsl::typed_inlet<float, 3>(found[0])), std::invalid_argument);
+	CHECK_THROWS_AS((lsl::typed_inlet<int16_t, 4>(found[0])), std::invalid_argument);
+	lsl::typed_inlet<int16_t, 3> in(found[0]);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	out.push_sample({{1, -2, 3}}, 100.0);
+	std::vector<lsl::typed_outlet<int16_t, 3>::sample_type> sent{{{4, 5, 6}}, {{7, 8, 9}}};
+	out.push_chunk(sent, {101.0, 102.0});
+
+	lsl::typed_inlet<int16_t, 3>::sample_type sample;
+	CHECK(in.pull_sample(sample, 2.0) == 100.0);
+	CHECK(sample[1] == -2);
+	std::vector<lsl::typed_inlet<int16_t, 3>::sample_type> chunk;
+	std::vector<double> timestamps;
+	std::size_t pulled = 0;
+	for (int tries = 0; pulled < 2 && tries < 100; ++tries)
+		pulled += in.pull_chunk(chunk, &timestamps, 2 - pulled, 0.1);
+	REQUIRE(pulled == 2);
+	CHECK(chunk.back() == sent.back());
+	CHECK(timestamps.back() == 102.0);
+}
@@ -1,6 +1,13 @@
 #include <catch2/catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <lsl_cpp.h>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -18,6 +25,193 @@ TEST_CASE("resolve multiple streams", "[resolver][basic]") {
 	REQUIRE(resolver.results().size() == n);
 }
 
+TEST_CASE("continuous resolver forgets streams", "[resolver][basic]") {
+	lsl::continuous_resolver resolver("type", "Forget", 2.);
+	auto wait_for = [&resolver](std::size_t n) {
+		for (int k = 0; k < 100 && resolver.results().size() != n; ++k)
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		return resolver.results().size();
+	};
+	{
+		lsl::stream_outlet outlet(lsl::stream_info("forgettest", "Forget"));
+		REQUIRE(wait_for(1) == 1);
+	}
+	REQUIRE(wait_for(0) == 0);
+}
+
+TEST_CASE("continuous resolver callback", "[resolver][basic]") {
+	lsl::continuous_resolver resolver("type", "Callback", 2.);
+	std::mutex mut;
+	std::condition_variable cv;
+	std::vector<std::string> events;
+	resolver.set_callback([&](const lsl::stream_info &info, bool appeared) {
+		std::lock_guard<std::mutex> lock(mut);
+		events.push_back((appeared ? "+" : "-") + info.name());
+		cv.notify_all();
+	});
+	auto wait_for = [&](std::size_t n) {
+		std::unique_lock<std::mutex> lock(mut);
+		cv.wait_for(lock, std::chrono::seconds(5), [&]() { return events.size() >= n; });
+		return events;
+	};
+	{
+		lsl::stream_outlet outlet(lsl::stream_info("callbacktest", "Callback"));
+		REQUIRE(wait_for(1) == std::vector<std::string>{"+callbacktest"});
+		CHECK(resolver.results().size() == 1);
+	}
+	REQUIRE(wait_for(2) == std::vector<std::string>{"+callbacktest", "-callbacktest"});
+	CHECK(resolver.results().empty());
+	resolver.set_callback(nullptr);
+}
+
+TEST_CASE("continuous resolver changes", "[resolver][basic]") {
+	lsl::continuous_resolver resolver("type", "Changes", 2.);
+	uint64_t version = 0;
+	std::vector<std::string> changes;
+	auto wait_for = [&](std::size_t n) {
+		for (int k = 0; k < 100 && changes.size() < n; ++k) {
+			for (const auto &change : resolver.results_since(version))
+				changes.push_back((change.second ? "+" : "-") + change.first.name());
+			if (changes.size() < n) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		return changes.size();
+	};
+	lsl::stream_outlet kept(lsl::stream_info("changestest_kept", "Changes"));
+	{
+		lsl::stream_outlet gone(lsl::stream_info("changestest_gone", "Changes"));
+		REQUIRE(wait_for(2) == 2);
+		CHECK(std::count(changes.begin(), changes.end(), "+changestest_kept") == 1);
+		CHECK(std::count(changes.begin(), changes.end(), "+changestest_gone") == 1);
+	}
+	const uint64_t seen = version;
+	REQUIRE(wait_for(3) == 3);
+	CHECK(changes.back() == "-changestest_gone");
+	CHECK(version > seen);
+	CHECK(resolver.results_since(version).empty());
+
+	// starting afresh only returns the present streams
+	uint64_t fresh = 0;
+	auto present = resolver.results_since(fresh);
+	REQUIRE(present.size() == 1);
+	CHECK(present[0].first.name() == "changestest_kept");
+	CHECK(present[0].second);
+	CHECK(fresh == version);
+}
+
+TEST_CASE("direct connections without discovery", "[resolver][basic]") {
+	lsl::stream_outlet outlet(
+		lsl::stream_info("directtest", "Direct", 1, lsl::IRREGULAR_RATE, lsl::cf_int32, "direct"));
+	auto found = lsl::resolve_stream("name", "directtest", 1, 2.0);
+	REQUIRE(found.size() == 1);
+	const std::string xml = found[0].as_xml(), port_tag = "<v4data_port>";
+	const auto port_pos = xml.find(port_tag);
+	REQUIRE(port_pos != std::string::npos);
+	const auto port = static_cast<uint16_t>(std::stoi(xml.substr(port_pos + port_tag.size())));
+
+	// from the address and the expected UID
+	auto direct = lsl::resolve_address("127.0.0.1", port, found[0].uid());
+	CHECK(direct.uid() == found[0].uid());
+	CHECK(direct.name() == "directtest");
+	CHECK_THROWS_AS(lsl::resolve_address("127.0.0.1", port, "not-the-uid"), lsl::lost_error);
+
+	// and from an info stored in a previous run
+	for (const auto &info : {direct, lsl::stream_info::from_xml(xml)}) {
+		lsl::stream_inlet inlet(info);
+		inlet.open_stream(2.0);
+		REQUIRE(outlet.wait_for_consumers(2.0));
+		int32_t value = 5;
+		outlet.push_sample(&value);
+		value = 0;
+		REQUIRE(inlet.pull_sample(&value, 1, 2.0) != 0.0);
+		CHECK(value == 5);
+	}
+}
+
+TEST_CASE("open inlets in a batch", "[inlet][basic]") {
+	const int n = 4;
+	std::vector<lsl::stream_outlet> outlets;
+	for (int i = 0; i < n; i++)
+		outlets.emplace_back(lsl::stream_info("batchopen_" + std::to_string(i), "BatchOpen", 1,
+			lsl::IRREGULAR_RATE, lsl::cf_int32, "batchopen_" + std::to_string(i)));
+	auto found = lsl::resolve_stream("type", "BatchOpen", n, 2.0);
+	REQUIRE(found.size() == n);
+
+	std::vector<std::unique_ptr<lsl::stream_inlet>> inlets;
+	std::vector<lsl::stream_inlet *> batch;
+	for (const auto &info : found) {
+		inlets.emplace_back(new lsl::stream_inlet(info));
+		batch.push_back(inlets.back().get());
+	}
+	std::vector<int32_t> errors;
+	CHECK(lsl::open_streams(batch, 5.0, &errors) == n);
+	CHECK(errors == std::vector<int32_t>(n, lsl_no_error));
+	for (auto &outlet : outlets) {
+		REQUIRE(outlet.wait_for_consumers(2.0));
+		int32_t value = 7;
+		outlet.push_sample(&value);
+	}
+	for (auto &inlet : inlets) {
+		int32_t value = 0;
+		REQUIRE(inlet->pull_sample(&value, 1, 2.0) != 0.0);
+		CHECK(value == 7);
+	}
+}
+
+TEST_CASE("outlets become discoverable in the background", "[resolver][basic]") {
+	// destroying an outlet right away has to wait for its responders
+	for (int i = 0; i < 5; ++i) lsl::stream_outlet(lsl::stream_info("readytest_tmp", "Ready"));
+
+	lsl::stream_outlet outlet(lsl::stream_info("readytest", "Ready"));
+	REQUIRE(outlet.wait_for_ready(5.));
+	// it's ready indefinitely once it's ready
+	CHECK(outlet.wait_for_ready(0.));
+	CHECK(lsl::resolve_stream("name", "readytest", 1, 2.0).size() == 1);
+}
+
+TEST_CASE("outlets are destroyed in parallel and in the background", "[resolver][basic]") {
+	std::vector<lsl_outlet> outlets;
+	for (int i = 0; i < 10; ++i) {
+		lsl::stream_info info("teardowntest_" + std::to_string(i), "Teardown");
+		outlets.push_back(lsl_create_outlet(info.handle().get(), 0, 360));
+		REQUIRE(outlets.back() != nullptr);
+	}
+	lsl_destroy_outlets(outlets.data(), static_cast<int32_t>(outlets.size()));
+
+	lsl::stream_outlet outlet(lsl::stream_info("teardowntest_async", "Teardown"));
+	REQUIRE(lsl::resolve_stream("name", "teardowntest_async", 1, 2.0).size() == 1);
+	outlet.close_async();
+	CHECK(lsl::resolve_stream("type", "Teardown", 1, 0.5).empty());
+}
+
+TEST_CASE("concurrent identical resolves", "[resolver][basic]") {
+	lsl::stream_outlet outlet(lsl::stream_info("concurrenttest", "Concurrent"));
+	std::atomic<int> found{0};
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i)
+		threads.emplace_back([&found]() {
+			if (!lsl::resolve_stream("type", "Concurrent", 1, 5.0).empty()) found++;
+		});
+	for (auto &thread : threads) thread.join();
+	REQUIRE(found == 8);
+}
+
+// needs [tuning] AnnounceInterval, run by ctest with lslcfgs/announce.cfg
+TEST_CASE("announced streams", "[resolver][.announce]") {
+	// without the announcements, the stream would only be forgotten after a minute
+	lsl::continuous_resolver resolver("type", "Announce", 60.);
+	auto wait_for = [&resolver](std::size_t n) {
+		for (int k = 0; k < 100 && resolver.results().size() != n; ++k)
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		return resolver.results().size();
+	};
+	{
+		lsl::stream_outlet outlet(lsl::stream_info("announcetest", "Announce"));
+		REQUIRE(wait_for(1) == 1);
+	}
+	// the outlet said goodbye
+	REQUIRE(wait_for(0) == 0);
+}
+
 TEST_CASE("resolve from streaminfo", "[resolver][streaminfo][basic]") {
 	lsl::stream_outlet outlet(lsl::stream_info("resolvetest", "from_streaminfo"));
 	lsl::stream_inlet(outlet.info());
@@ -41,5 +235,62 @@ TEST_CASE("fullinfo", "[inlet][fullinfo][basic]") {
 	CHECK(fullinfo.desc().child_value("info") == extinfo);
 }
 
+// needs [tuning] InfoRefreshInterval, run by ctest with lslcfgs/inforefresh.cfg
+TEST_CASE("updated fullinfo", "[inlet][fullinfo][.inforefresh]") {
+	lsl::stream_info info("updatedinfo", "unittest", 1, 1, lsl::cf_int8, "updatedinfo1234");
+	info.desc().append_child_value("revision", "1");
+	lsl::stream_outlet outlet(info);
+	auto found_streams = lsl::resolve_stream("name", info.name(), 1, 2);
+	REQUIRE(!found_streams.empty());
+	lsl::stream_inlet inlet(found_streams[0]);
+	CHECK(inlet.info(2).desc().child_value("revision") == std::string("1"));
+
+	lsl::stream_info update("updatedinfo", "unittest");
+	update.desc().append_child_value("revision", "2");
+	outlet.update_desc(update);
+	CHECK(outlet.info().desc().child_value("revision") == std::string("2"));
+	// the inlet revalidates its info in the background after the refresh interval
+	std::string revision;
+	for (int k = 0; k < 100 && revision != "2"; ++k) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		revision = inlet.info(2).desc().child_value("revision");
+	}
+	CHECK(revision == "2");
+}
+
+TEST_CASE("failover to a standby", "[resolver][basic]") {
+	lsl::stream_info info(
+		"Failover", "failover", 1, lsl::IRREGULAR_RATE, lsl::cf_int32, "Failover");
+	std::unique_ptr<lsl::stream_outlet> primary(new lsl::stream_outlet(info));
+	lsl::stream_outlet standby(info);
+	const std::string primary_uid = primary->info().uid();
+	auto found = lsl::resolve_stream("name", "Failover", 2, 2.0);
+	auto it = std::find_if(found.begin(), found.end(),
+		[&](const lsl::stream_info &i) { return i.uid() == primary_uid; });
+	REQUIRE(it != found.end());
+
+	lsl::stream_inlet unrecoverable(*it, 360, 0, false);
+	CHECK_THROWS(unrecoverable.set_failover());
+	lsl::stream_inlet in(*it);
+	in.set_failover();
+	in.open_stream(2.0);
+	REQUIRE(primary->wait_for_consumers(2.0));
+	int32_t value = 1;
+	primary->push_sample(&value);
+	REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 1);
+
+	// both streams are known by now, so the inlet doesn't wait for a resolve
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	const double start = lsl::local_clock();
+	primary.reset();
+	REQUIRE(standby.wait_for_consumers(5.0));
+	// (a generous bound, so a loaded machine doesn't fail the test)
+	CHECK(lsl::local_clock() - start < 3.0);
+	value = 2;
+	standby.push_sample(&value);
+	REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 2);
+}
 
 } // namespace
@@ -0,0 +1,62 @@
+#include "helpers.h"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <catch2/catch.hpp>
+#include <lsl_exporter.h>
+
+namespace asio = lslboost::asio;
+
+namespace {
+
+/// Send an HTTP GET request to the exporter and return the response.
+std::string http_get(uint16_t port, const std::string &path) {
+	asio::io_context io;
+	asio::ip::tcp::socket sock(io);
+	sock.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+	std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	asio::write(sock, asio::buffer(request));
+	std::string response;
+	lslboost::system::error_code ec;
+	asio::read(sock, asio::dynamic_buffer(response), ec);
+	return response;
+}
+
+TEST_CASE("metrics exporter", "[exporter][basic]") {
+	Streampair sp(create_streampair(
+		lsl::stream_info("exported", "Test\"Type", 1, lsl::IRREGULAR_RATE, lsl::cf_int32, "exp")));
+	lsl::metrics_exporter exporter(0, false, "127.0.0.1");
+	exporter.add(sp.out_);
+	exporter.add(sp.in_);
+
+	int32_t value = 5;
+	for (int i = 0; i < 10; ++i) sp.out_.push_sample(&value);
+	for (int i = 0; i < 10; ++i) sp.in_.pull_sample(&value, 1, 5.);
+
+	const std::string metrics = exporter.render();
+	CHECK(metrics.find("# TYPE lsl_outlet_samples_pushed_total counter\n") != std::string::npos);
+	CHECK(metrics.find("lsl_outlet_samples_pushed_total{name=\"exported\",type=\"Test\\\"Type\","
+					   "source_id=\"exp\"") != std::string::npos);
+	CHECK(metrics.find("lsl_inlet_samples_received_total{name=\"exported\"") != std::string::npos);
+	CHECK(metrics.find("lsl_inlet_latency_seconds") == std::string::npos);
+	CHECK(metrics.find("lsl_discovered_streams") == std::string::npos);
+
+	const std::string response = http_get(exporter.port(), "/metrics");
+	CHECK(response.find("HTTP/1.1 200 OK\r\n") == 0);
+	CHECK(response.find("lsl_outlet_consumers{") != std::string::npos);
+	CHECK(http_get(exporter.port(), "/").find("HTTP/1.1 404") == 0);
+}
+
+TEST_CASE("metrics exporter drops destroyed streams", "[exporter][basic]") {
+	lsl::metrics_exporter exporter(0, false, "127.0.0.1");
+	{
+		lsl::stream_outlet outlet(lsl::stream_info("exporttmp", "Test", 1));
+		exporter.add(outlet);
+		CHECK(exporter.render().find("exporttmp") != std::string::npos);
+	}
+	CHECK(exporter.render().find("exporttmp") == std::string::npos);
+}
+
+} // namespace
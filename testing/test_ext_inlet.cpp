@@ -0,0 +1,856 @@
+#include "helpers.h"
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <lsl_cpp.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEST_CASE("latency tracking", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("LatencyStats", "stats", 1, 100, lsl::cf_int32, "LatencyStats"))};
+	sp.in_.track_latency();
+	// the end-to-end latencies are only recorded once there's a time correction estimate
+	sp.in_.time_correction(5.);
+	for (int i = 0; i < 10; ++i)
+		for (int j = 0; j < 5; ++j) sp.out_.push_sample(&j);
+
+	int32_t value;
+	for (int i = 0; i < 50; ++i) REQUIRE(sp.in_.pull_sample(&value, 1, 5.) != 0.0);
+	lsl_inlet_stats stats = sp.in_.stats();
+	CHECK(stats.residence_count == 50);
+	CHECK(stats.residence_p50 >= 0.0);
+	CHECK(stats.residence_p50 <= stats.residence_p99);
+	CHECK(stats.residence_p99 <= stats.residence_p999);
+	CHECK(stats.latency_count > 0);
+	CHECK(stats.latency_count <= 50);
+	CHECK(stats.latency_p50 <= stats.latency_p99);
+	CHECK(stats.latency_p99 <= stats.latency_p999);
+	CHECK(stats.latency_p999 < 1.0);
+
+	sp.in_.track_latency(false);
+	sp.out_.push_sample(&value);
+	REQUIRE(sp.in_.pull_sample(&value, 1, 5.) != 0.0);
+	CHECK(sp.in_.stats().residence_count == 50);
+}
+
+TEST_CASE("inlet_set", "[datatransfer][basic]") {
+	Streampair sp1{create_streampair(
+		lsl::stream_info("InletSet1", "set", 1, 100, lsl::cf_int32, "InletSet1"))};
+	Streampair sp2{create_streampair(
+		lsl::stream_info("InletSet2", "set", 1, 100, lsl::cf_int32, "InletSet2"))};
+	lsl::inlet_set set;
+	set.add(sp1.in_);
+	set.add(sp2.in_);
+	CHECK_THROWS(set.add(sp1.in_));
+
+	// nothing has been pushed yet
+	CHECK(set.wait(1, 0.).empty());
+
+	int32_t data = 1;
+	for (int i = 0; i < 3; ++i) sp2.out_.push_sample(&data);
+	auto ready = set.wait(1, 5.);
+	REQUIRE(ready.size() == 1);
+	CHECK(ready[0] == &sp2.in_);
+
+	// wait for more samples than are available
+	REQUIRE(set.wait(3, 5.).size() == 1);
+	CHECK(set.wait(5, .2).empty());
+	std::thread pusher([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		for (int i = 0; i < 2; ++i) sp2.out_.push_sample(&data);
+	});
+	ready = set.wait(5, 5.);
+	pusher.join();
+	REQUIRE(ready.size() == 1);
+	CHECK(ready[0] == &sp2.in_);
+	CHECK(sp2.in_.samples_available() == 5);
+
+	set.remove(sp2.in_);
+	sp1.out_.push_sample(&data);
+	ready = set.wait(1, 5.);
+	REQUIRE(ready.size() == 1);
+	CHECK(ready[0] == &sp1.in_);
+}
+
+TEST_CASE("pull chunks of multiple inlets", "[datatransfer][basic]") {
+	Streampair sp1{create_streampair(
+		lsl::stream_info("PullChunks1", "chunks", 2, 100, lsl::cf_float32, "PullChunks1"))};
+	Streampair sp2{create_streampair(
+		lsl::stream_info("PullChunks2", "chunks", 2, 100, lsl::cf_float32, "PullChunks2"))};
+	float sample[2] = {1.f, 2.f};
+	for (int i = 0; i < 3; ++i) sp1.out_.push_sample(sample, 10. + i);
+	for (int i = 0; i < 5; ++i) sp2.out_.push_sample(sample, 20. + i);
+	for (int k = 0; k < 100 && (sp1.in_.samples_available() < 3 || sp2.in_.samples_available() < 5);
+		 ++k)
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	const lsl_inlet inlets[3] = {sp1.in_.handle().get(), sp2.in_.handle().get(), nullptr};
+	std::vector<float> data[3]{std::vector<float>(8), std::vector<float>(8), std::vector<float>(8)};
+	std::vector<double> ts[3]{
+		std::vector<double>(4), std::vector<double>(4), std::vector<double>(4)};
+	float *const data_buffers[3] = {data[0].data(), data[1].data(), data[2].data()};
+	double *const ts_buffers[3] = {ts[0].data(), ts[1].data(), ts[2].data()};
+	const unsigned long elements[3] = {8, 8, 8};
+	unsigned long written[3];
+	int32_t ec[3];
+	CHECK(lsl_pull_chunks_f(inlets, 3, data_buffers, ts_buffers, elements, written, ec) == 7);
+	CHECK(written[0] == 3);
+	CHECK(written[1] == 4);
+	CHECK(written[2] == 0);
+	CHECK(ec[0] == lsl_no_error);
+	CHECK(ec[1] == lsl_no_error);
+	CHECK(ec[2] == lsl_argument_error);
+	CHECK(data[0][4] == 1.f);
+	CHECK(data[1][7] == 2.f);
+	CHECK(ts[0][2] == Approx(12.));
+	CHECK(ts[1][3] == Approx(23.));
+
+	// only the remaining sample, without time stamps
+	CHECK(lsl_pull_chunks_f(inlets, 2, data_buffers, nullptr, elements, written, nullptr) == 1);
+	CHECK(written[0] == 0);
+	CHECK(written[1] == 1);
+}
+
+TEST_CASE("pull chunks into a reusable buffer", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("ChunkBuffer", "chunks", 2, 100, lsl::cf_int32, "ChunkBuffer"))};
+	for (int32_t i = 0; i < 5; ++i) {
+		const int32_t sample[2] = {i, -i};
+		sp.out_.push_sample(sample, 10. + i);
+	}
+
+	lsl::chunk_buffer<int32_t> chunk(2, 4);
+	CHECK(chunk.capacity() == 4);
+	const int32_t *const data = chunk.data();
+	REQUIRE(sp.in_.pull_chunk(chunk, 5.) == 4);
+	CHECK(chunk.size() == 4);
+	CHECK(chunk.sample(3)[0] == 3);
+	CHECK(chunk.sample(3)[1] == -3);
+	CHECK(chunk.timestamp(3) == Approx(13.));
+	// the buffer isn't filled up before the timeout expires
+	REQUIRE(sp.in_.pull_chunk(chunk, .5) == 1);
+	CHECK(chunk.sample(0)[0] == 4);
+	// the memory is reused
+	CHECK(chunk.data() == data);
+	CHECK(sp.in_.pull_chunk(chunk) == 0);
+	CHECK(chunk.empty());
+
+	lsl::chunk_buffer<float> without_timestamps(2, 8, false);
+	CHECK(without_timestamps.timestamps() == nullptr);
+	const int32_t sample[2] = {7, 8};
+	sp.out_.push_sample(sample);
+	REQUIRE(sp.in_.pull_chunk(without_timestamps, 0.2) == 1);
+	CHECK(without_timestamps.sample(0)[1] == 8.f);
+
+	lsl::chunk_buffer<int32_t> mismatched(3, 4);
+	CHECK_THROWS_AS(sp.in_.pull_chunk(mismatched), std::invalid_argument);
+
+	// with a minimum, the pull returns before the buffer is full
+	sp.in_.set_pull_min_samples(2);
+	for (int32_t i = 0; i < 3; ++i) sp.out_.push_sample(sample);
+	lsl::chunk_buffer<int32_t> window(2, 8);
+	const double start = lsl::local_clock();
+	CHECK(sp.in_.pull_chunk(window, 5.) >= 2);
+	CHECK(lsl::local_clock() - start < 2.);
+}
+
+TEST_CASE("merge reader", "[datatransfer][basic]") {
+	Streampair a{create_streampair(
+		lsl::stream_info("MergeA", "merge", 1, 100, lsl::cf_float32, "MergeA"))};
+	Streampair b{create_streampair(
+		lsl::stream_info("MergeB", "merge", 2, 100, lsl::cf_int32, "MergeB"))};
+	// a marker stream without any samples doesn't hold back the others for longer than the delay
+	Streampair markers{create_streampair(lsl::stream_info(
+		"MergeMarkers", "merge", 1, lsl::IRREGULAR_RATE, lsl::cf_double64, "MergeMarkers"))};
+	lsl::merge_reader<double> reader({&a.in_, &b.in_, &markers.in_}, 0.5);
+
+	// the streams' samples interleave, but b's are pushed first
+	const int n = 20;
+	const double base = lsl::local_clock();
+	for (int k = 0; k < n; ++k) {
+		const int32_t values[2] = {k, -k};
+		b.out_.push_sample(values, base + 0.01 * (2 * k + 1));
+	}
+	for (int k = 0; k < n; ++k) a.out_.push_sample(std::vector<float>{float(k)}, base + 0.02 * k);
+
+	lsl::merge_reader<double>::chunk chunk;
+	std::vector<std::size_t> streams;
+	std::vector<double> timestamps;
+	// the samples become due one after another as the delay for the marker stream expires
+	while (timestamps.size() < 2 * n && lsl::local_clock() < base + 5.0) {
+		reader.pull_chunk(chunk, 1.0);
+		for (std::size_t k = 0; k < chunk.size(); ++k) {
+			streams.push_back(chunk.streams[k]);
+			timestamps.push_back(chunk.timestamps[k]);
+			const double *values = chunk.sample(k);
+			const auto i = static_cast<double>(timestamps.size() / 2);
+			if (chunk.streams[k] == 0) CHECK(values[0] == i);
+			else {
+				CHECK(values[0] == i - 1);
+				CHECK(values[1] == 1 - i);
+			}
+		}
+	}
+	REQUIRE(timestamps.size() == 2 * n);
+	CHECK(std::is_sorted(timestamps.begin(), timestamps.end()));
+	for (std::size_t k = 0; k < streams.size(); ++k) CHECK(streams[k] == k % 2);
+}
+
+TEST_CASE("chunk callback", "[datatransfer][basic]") {
+	const int nsamples = 20;
+	Streampair sp{create_streampair(
+		lsl::stream_info("ChunkCallback", "chunks", 1, 100, lsl::cf_int32, "ChunkCallback"))};
+
+	std::mutex mut;
+	std::condition_variable cv;
+	std::vector<int32_t> received;
+	std::vector<double> received_ts;
+	sp.in_.set_chunk_callback([&](const lsl::sample_view &view) {
+		std::lock_guard<std::mutex> lock(mut);
+		for (std::size_t k = 0; k < view.size(); ++k) {
+			received.push_back(view.data<int32_t>(k)[0]);
+			received_ts.push_back(view.timestamp(k));
+		}
+		cv.notify_all();
+	});
+
+	std::vector<int32_t> sent(nsamples);
+	std::vector<double> sent_ts(nsamples);
+	for (int i = 0; i < nsamples; ++i) {
+		sent[i] = i;
+		sent_ts[i] = 1000. + i;
+	}
+	sp.out_.push_chunk_multiplexed(sent.data(), sent_ts.data(), sent.size());
+	{
+		std::unique_lock<std::mutex> lock(mut);
+		REQUIRE(cv.wait_for(lock, std::chrono::seconds(5),
+			[&]() { return received.size() >= static_cast<std::size_t>(nsamples); }));
+		CHECK(received == sent);
+		CHECK(received_ts == sent_ts);
+	}
+	// nothing was queued in the meantime
+	CHECK(sp.in_.samples_available() == 0);
+
+	// without a callback, the samples are queued again
+	sp.in_.set_chunk_callback(nullptr);
+	int32_t data = 42, result = 0;
+	sp.out_.push_sample(&data);
+	CHECK(sp.in_.pull_sample(&result, 1, 5.) != 0.0);
+	CHECK(result == 42);
+}
+
+TEST_CASE("chunk callback removes itself", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(lsl::stream_info(
+		"ChunkCallbackRemoval", "chunks", 1, 100, lsl::cf_int32, "ChunkCallbackRemoval"))};
+
+	std::mutex mut;
+	std::condition_variable cv;
+	int calls = 0;
+	sp.in_.set_chunk_callback([&](const lsl::sample_view &) {
+		// this used to deadlock on the lock that the call was made under
+		sp.in_.set_chunk_callback(nullptr);
+		std::lock_guard<std::mutex> lock(mut);
+		++calls;
+		cv.notify_all();
+	});
+	int32_t data = 1, result = 0;
+	sp.out_.push_sample(&data);
+	{
+		std::unique_lock<std::mutex> lock(mut);
+		REQUIRE(cv.wait_for(lock, std::chrono::seconds(5), [&]() { return calls > 0; }));
+	}
+
+	// the following samples are queued again
+	data = 2;
+	sp.out_.push_sample(&data);
+	CHECK(sp.in_.pull_sample(&result, 1, 5.) != 0.0);
+	CHECK(result == 2);
+	CHECK(calls == 1);
+}
+
+TEST_CASE("raw chunk callback", "[datatransfer][basic]") {
+	const int nchan = 2, nsamples = 20;
+	Streampair sp{create_streampair(
+		lsl::stream_info("RawChunkCallback", "chunks", nchan, 100, lsl::cf_int16, "RawCallback"))};
+
+	const uint16_t one = 1;
+	const bool little_endian = *reinterpret_cast<const char *>(&one) == 1;
+	std::mutex mut;
+	std::condition_variable cv;
+	std::vector<int16_t> received;
+	std::vector<double> received_ts;
+	sp.in_.set_raw_chunk_callback([&](const lsl_raw_chunk &chunk) {
+		std::lock_guard<std::mutex> lock(mut);
+		CHECK(chunk.num_bytes == chunk.num_samples * nchan * sizeof(int16_t));
+		CHECK((chunk.little_endian != 0) == little_endian);
+		if (chunk.num_samples) CHECK(chunk.first_timestamp == chunk.timestamps[0]);
+		const std::size_t n = received.size();
+		received.resize(n + chunk.num_samples * nchan);
+		std::memcpy(received.data() + n, chunk.data, chunk.num_bytes);
+		received_ts.insert(
+			received_ts.end(), chunk.timestamps, chunk.timestamps + chunk.num_samples);
+		cv.notify_all();
+	});
+
+	std::vector<int16_t> sent(nsamples * nchan);
+	for (int k = 0; k < nsamples * nchan; ++k) sent[k] = static_cast<int16_t>(k - 7);
+	// the time stamps of all but the last sample are deduced
+	sp.out_.push_chunk_multiplexed(sent.data(), sent.size(), 1000. + (nsamples - 1) / 100.);
+	{
+		std::unique_lock<std::mutex> lock(mut);
+		REQUIRE(cv.wait_for(lock, std::chrono::seconds(5),
+			[&]() { return received_ts.size() >= static_cast<std::size_t>(nsamples); }));
+		CHECK(received == sent);
+		for (int k = 0; k < nsamples; ++k) CHECK(received_ts[k] == Approx(1000. + k / 100.));
+	}
+	CHECK(sp.in_.samples_available() == 0);
+	// the values were passed on from the received frames, not copied from decoded samples
+	const lsl_inlet_stats stats = sp.in_.stats();
+	CHECK(stats.chunks_passed_through > 0);
+	CHECK(stats.chunks_passed_through == stats.chunks_received);
+
+	// without a callback, the samples are queued again
+	sp.in_.set_raw_chunk_callback(nullptr);
+	const int16_t sample[nchan] = {42, 43};
+	int16_t result[nchan] = {0, 0};
+	sp.out_.push_sample(sample);
+	CHECK(sp.in_.pull_sample(result, nchan, 5.) != 0.0);
+	CHECK(result[1] == 43);
+}
+
+TEST_CASE("target buffer", "[datatransfer][basic]") {
+	const uint32_t capacity = 8;
+	Streampair sp{create_streampair(
+		lsl::stream_info("TargetBuffer", "target", 2, 100, lsl::cf_int16, "TargetBuffer"))};
+
+	// the samples are converted to float, channel after channel
+	std::vector<float> ring(2 * capacity, -1.f);
+	std::vector<double> stamps(capacity);
+	std::mutex mut;
+	std::condition_variable cv;
+	uint64_t written = 0;
+	std::vector<std::pair<uint64_t, uint32_t>> ranges;
+	sp.in_.set_target_buffer(ring.data(), lsl::cf_float32, stamps.data(), capacity,
+		[&](uint64_t first, uint32_t count) {
+			std::lock_guard<std::mutex> lock(mut);
+			CHECK(first == written);
+			written += count;
+			ranges.emplace_back(first, count);
+			cv.notify_all();
+		});
+	const auto push = [&](int16_t first, int n) {
+		std::vector<int16_t> data;
+		std::vector<double> ts;
+		for (int16_t i = first; i < first + n; ++i) {
+			data.push_back(i);
+			data.push_back(static_cast<int16_t>(100 + i));
+			ts.push_back(1000. + i);
+		}
+		sp.out_.push_chunk_multiplexed(data.data(), ts.data(), data.size());
+	};
+	const auto wait_for = [&](uint64_t n) {
+		std::unique_lock<std::mutex> lock(mut);
+		return cv.wait_for(lock, std::chrono::seconds(5), [&]() { return written >= n; });
+	};
+
+	push(0, 6);
+	REQUIRE(wait_for(6));
+	for (uint32_t s = 0; s < 6; ++s) {
+		CHECK(ring[s] == static_cast<float>(s));
+		CHECK(ring[capacity + s] == static_cast<float>(100 + s));
+		CHECK(stamps[s] == 1000. + s);
+	}
+	CHECK(sp.in_.samples_available() == 0);
+
+	// the next samples wrap around, each call's slots are contiguous
+	sp.in_.release_target_samples(6);
+	push(6, 6);
+	REQUIRE(wait_for(12));
+	for (uint32_t k = 6; k < 12; ++k) {
+		CHECK(ring[k % capacity] == static_cast<float>(k));
+		CHECK(ring[capacity + k % capacity] == static_cast<float>(100 + k));
+	}
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		for (const auto &range : ranges) CHECK(range.first % capacity + range.second <= capacity);
+	}
+
+	// only two slots are free, the other samples are dropped
+	push(12, 4);
+	REQUIRE(wait_for(14));
+	for (int i = 0; i < 100 && sp.in_.stats().samples_dropped < 2; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(sp.in_.stats().samples_dropped == 2);
+	CHECK(ring[12 % capacity] == 12.f);
+	CHECK(ring[13 % capacity] == 13.f);
+	CHECK_THROWS(sp.in_.release_target_samples(9));
+	sp.in_.release_target_samples(8);
+
+	// without a target buffer, the samples are queued again
+	sp.in_.set_target_buffer(nullptr, lsl::cf_float32, nullptr, 0, nullptr);
+	int16_t data[2] = {42, 43}, result[2] = {0, 0};
+	sp.out_.push_sample(data);
+	CHECK(sp.in_.pull_sample(result, 2, 5.) != 0.0);
+	CHECK(result[0] == 42);
+}
+
+TEST_CASE("window buffer", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("WindowBuffer", "window", 2, 100, lsl::cf_int16, "WindowBuffer"))};
+	const uint32_t capacity = sp.in_.set_window_buffer(lsl::cf_float32, 100);
+	REQUIRE(capacity >= 100);
+
+	int16_t next = 0;
+	const auto push = [&](uint32_t n) {
+		std::vector<int16_t> data;
+		std::vector<double> ts;
+		for (uint32_t k = 0; k < n; ++k, ++next) {
+			data.push_back(next);
+			data.push_back(static_cast<int16_t>(-next));
+			ts.push_back(1000. + next);
+		}
+		sp.out_.push_chunk_multiplexed(data.data(), ts.data(), data.size());
+	};
+	// borrow the window that ends with the last pushed sample
+	const auto borrow = [&](uint32_t n) {
+		lsl_window window = sp.in_.borrow_window(n, 5.0);
+		while (window.num_samples && window.timestamps[n - 1] != 1000. + next - 1) {
+			sp.in_.release_window();
+			window = sp.in_.borrow_window(n, 5.0);
+		}
+		REQUIRE(window.num_samples == n);
+		return window;
+	};
+	const auto check = [&](const lsl_window &window, int16_t first) {
+		const auto *data = static_cast<const float *>(window.data);
+		for (uint32_t k = 0; k < window.num_samples; ++k) {
+			CHECK(data[2 * k] == static_cast<float>(first + k));
+			CHECK(data[2 * k + 1] == -static_cast<float>(first + k));
+			CHECK(window.timestamps[k] == 1000. + first + k);
+		}
+	};
+	CHECK(sp.in_.borrow_window(10, 0.0).num_samples == 0);
+
+	// the whole ring, which has wrapped around, is a single block
+	push(capacity + capacity / 2);
+	lsl_window window = borrow(capacity);
+	CHECK(window.first == capacity / 2);
+	check(window, static_cast<int16_t>(capacity / 2));
+	CHECK(sp.in_.samples_available() == 0);
+	CHECK_THROWS(sp.in_.borrow_window(10, 0.0));
+
+	// samples that would overwrite the borrowed window are dropped
+	push(10);
+	for (int i = 0; i < 100 && sp.in_.stats().samples_dropped < 10; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(sp.in_.stats().samples_dropped == 10);
+	sp.in_.release_window();
+	CHECK_THROWS(sp.in_.release_window());
+
+	// the next window waits for newer samples
+	push(5);
+	window = borrow(5);
+	check(window, static_cast<int16_t>(next - 5));
+	CHECK(window.first == capacity + capacity / 2);
+	CHECK_THROWS(sp.in_.set_window_buffer(lsl::cf_float32, 0));
+	sp.in_.release_window();
+
+	// without a window buffer, the samples are queued again
+	CHECK(sp.in_.set_window_buffer(lsl::cf_float32, 0) == 0);
+	int16_t data[2] = {42, 43}, result[2] = {0, 0};
+	sp.out_.push_sample(data);
+	CHECK(sp.in_.pull_sample(result, 2, 5.) != 0.0);
+	CHECK(result[0] == 42);
+}
+
+TEST_CASE("async_wait_for_samples", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("AsyncWait", "wait", 1, 100, lsl::cf_int32, "AsyncWait"))};
+
+	std::future<void> ready = sp.in_.async_wait_for_samples(3);
+	CHECK(ready.wait_for(std::chrono::milliseconds(200)) == std::future_status::timeout);
+	int32_t data[3] = {1, 2, 3};
+	sp.out_.push_chunk_multiplexed(data, 3);
+	REQUIRE(ready.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+	ready.get();
+	CHECK(sp.in_.samples_available() == 3);
+
+	// the samples are available already, so the handler is called right away
+	bool called = false, was_lost = true;
+	sp.in_.async_wait_for_samples(2, [&](bool lost) {
+		called = true;
+		was_lost = lost;
+	});
+	CHECK(called);
+	CHECK(!was_lost);
+}
+
+TEST_CASE("overflow policy", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("Overflow", "overflow", 1, 100, lsl::cf_int32, "Overflow"));
+	auto found = lsl::resolve_stream("name", "Overflow", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	CHECK_THROWS(in.set_overflow_policy(lsl::overflow_decimate, 1));
+	CHECK_THROWS(in.set_overflow_policy(lsl::overflow_block, 0));
+	in.set_overflow_policy(lsl::overflow_decimate, 4);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	int32_t sent = 17, received = 0;
+	out.push_sample(&sent);
+	CHECK(in.pull_sample(&received, 1, 2.0) != 0.0);
+	CHECK(received == sent);
+}
+
+TEST_CASE("latest value subscription", "[datatransfer][basic]") {
+	lsl::stream_outlet out(lsl::stream_info("Latest", "overflow", 1, 100, lsl::cf_int32, "Latest"));
+	auto found = lsl::resolve_stream("name", "Latest", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.set_overflow_policy(lsl::overflow_latest);
+	in.open_stream(2.0);
+	REQUIRE(out.wait_for_consumers(2.0));
+
+	for (int32_t i = 0; i < 100; ++i) out.push_sample(&i);
+	// older values may arrive while the newest is on its way, but no backlog piles up
+	int32_t received = -1;
+	for (int i = 0; i < 50 && received != 99; ++i) in.pull_sample(&received, 1, 0.1);
+	CHECK(received == 99);
+	CHECK(in.samples_available() == 0);
+}
+
+TEST_CASE("multicast data", "[datatransfer][multicast]") {
+	lsl::stream_outlet strings(
+		lsl::stream_info("MulticastStr", "multicast", 1, 100, lsl::cf_string, "MulticastStr"));
+	CHECK_THROWS_AS(strings.set_multicast(), std::invalid_argument);
+
+	lsl::stream_outlet out(
+		lsl::stream_info("Multicast", "multicast", 2, 100, lsl::cf_int32, "Multicast"));
+	out.set_history(10.0);
+	out.set_multicast();
+	auto found = lsl::resolve_stream("name", "Multicast", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.set_multicast();
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	// the samples arrive in order and complete, by multicast or (if the network doesn't deliver
+	// the datagrams) over TCP
+	const int32_t n = 100;
+	for (int32_t k = 0; k < n; ++k) {
+		int32_t values[2] = {k, -k};
+		out.push_sample(values);
+	}
+	for (int32_t k = 0; k < n; ++k) {
+		int32_t values[2] = {0, 0};
+		REQUIRE(in.pull_sample(values, 2, 5.0) != 0.0);
+		CHECK(values[0] == k);
+		CHECK(values[1] == -k);
+	}
+}
+
+TEST_CASE("datagram data", "[datatransfer][datagrams]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("Datagrams", "datagrams", 2, 100, lsl::cf_float32, "Datagrams"));
+	auto found = lsl::resolve_stream("name", "Datagrams", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.set_datagrams();
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	// lost datagrams aren't retransmitted, so the samples that arrive are in order and the others
+	// are counted as lost
+	const int n = 100;
+	for (int k = 0; k < n; ++k) {
+		float values[2] = {static_cast<float>(k), 0.5f};
+		out.push_sample(values);
+	}
+	int received = 0;
+	float last = -1.0f, values[2];
+	while (received < n && in.pull_sample(values, 2, 2.0) != 0.0) {
+		CHECK(values[0] > last);
+		CHECK(values[1] == 0.5f);
+		last = values[0];
+		++received;
+	}
+	if (received < n) {
+		// the heartbeat datagrams reveal lost trailing datagrams
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		CHECK(received + in.stats().samples_lost == n);
+	}
+	CHECK(received > 0);
+}
+
+TEST_CASE("in-process data", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("InProcess", "inprocess", 2, 100, lsl::cf_float32, "InProcess"));
+	auto found = lsl::resolve_stream("name", "InProcess", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.set_in_process();
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	const float sample[2] = {1.0f, -1.0f};
+	out.push_sample(sample, 5.0);
+	// all but the first sample get deduced time stamps
+	const std::vector<float> chunk{2.0f, -2.0f, 3.0f, -3.0f, 4.0f, -4.0f};
+	out.push_chunk_multiplexed(chunk, 10.0);
+
+	float values[2];
+	CHECK(in.pull_sample(values, 2, 2.0) == 5.0);
+	CHECK(values[0] == 1.0f);
+	CHECK(values[1] == -1.0f);
+	double last = 0.0;
+	for (int k = 2; k <= 4; ++k) {
+		const double ts = in.pull_sample(values, 2, 2.0);
+		REQUIRE(ts != 0.0);
+		if (k > 2) CHECK(ts == Approx(last + 0.01));
+		last = ts;
+		CHECK(values[0] == static_cast<float>(k));
+		CHECK(values[1] == -static_cast<float>(k));
+	}
+	const lsl_inlet_stats stats = in.stats();
+	CHECK(stats.samples_received == 4);
+	// nothing went through a socket
+	CHECK(stats.bytes_received == 0);
+}
+
+TEST_CASE("bundled data", "[datatransfer][basic]") {
+	lsl::stream_outlet out_a(
+		lsl::stream_info("BundleA", "bundle", 2, 100, lsl::cf_float32, "BundleA"));
+	lsl::stream_outlet out_b(lsl::stream_info("BundleB", "bundle", 3, 0, lsl::cf_int32, "BundleB"));
+	auto found_a = lsl::resolve_stream("name", "BundleA", 1, 2.0),
+		 found_b = lsl::resolve_stream("name", "BundleB", 1, 2.0);
+	REQUIRE(!found_a.empty());
+	REQUIRE(!found_b.empty());
+	lsl::stream_inlet in_a(found_a[0]), in_b(found_b[0]);
+	in_a.set_bundling();
+	in_b.set_bundling();
+	in_a.open_stream(2.0);
+	in_b.open_stream(2.0);
+	out_a.wait_for_consumers(2.0);
+	out_b.wait_for_consumers(2.0);
+
+	const int n = 50;
+	for (int k = 0; k < n; ++k) {
+		const float a[2] = {static_cast<float>(k), -static_cast<float>(k)};
+		const int32_t b[3] = {k, 2 * k, 3 * k};
+		out_a.push_sample(a, 10.0 + k);
+		out_b.push_sample(b, 20.0 + k);
+	}
+	// the streams share a connection, but each inlet only gets the samples of its stream
+	for (int k = 0; k < n; ++k) {
+		float a[2];
+		int32_t b[3];
+		REQUIRE(in_a.pull_sample(a, 2, 2.0) == 10.0 + k);
+		CHECK(a[0] == static_cast<float>(k));
+		CHECK(a[1] == -static_cast<float>(k));
+		REQUIRE(in_b.pull_sample(b, 3, 2.0) == 20.0 + k);
+		CHECK(b[0] == k);
+		CHECK(b[2] == 3 * k);
+	}
+	CHECK(in_a.stats().samples_received == n);
+	CHECK(in_b.stats().samples_received == n);
+	// the outlets' own feeds, which bundling falls back to, didn't send anything
+	CHECK(out_a.stats().samples_sent == 0);
+	CHECK(out_b.stats().samples_sent == 0);
+}
+
+TEST_CASE("resampled data", "[datatransfer][basic]") {
+	const bool server_side = GENERATE(true, false);
+	INFO("server side: " << server_side);
+	lsl::stream_outlet out(
+		lsl::stream_info("Resampled", "resampled", 1, 1000, lsl::cf_float32, "Resampled"));
+	auto found = lsl::resolve_stream("name", "Resampled", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	CHECK_THROWS_AS(in.set_resampling(0, 10), std::invalid_argument);
+	in.set_resampling(1, 10, server_side);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	// a ramp (the time stamp minus 100) with a 250 Hz square wave that's above the resampled
+	// Nyquist frequency, so the filter removes it
+	const int n = 2000;
+	for (int k = 0; k < n; ++k) {
+		const float value = k / 1000.f + ((k % 4) < 2 ? 0.5f : -0.5f);
+		out.push_sample(&value, 100.0 + k / 1000.);
+	}
+	double last = 0.0;
+	for (int k = 0; k < n / 10; ++k) {
+		float value;
+		const double timestamp = in.pull_sample(&value, 1, 2.0);
+		REQUIRE(timestamp != 0.0);
+		if (k) CHECK(timestamp - last == Approx(0.01).margin(1e-6));
+		last = timestamp;
+		// past the filter's start-up
+		if (k >= 20) CHECK(value == Approx(timestamp - 100.0).margin(2e-3));
+	}
+	// only the resampled samples were transmitted if the outlet resampled the stream (otherwise,
+	// the last resampled sample was produced by sample n - 10)
+	if (server_side)
+		CHECK(in.stats().samples_received == n / 10);
+	else
+		CHECK(in.stats().samples_received > n - 10);
+}
+
+TEST_CASE("calibration", "[datatransfer][basic]") {
+	lsl::stream_info info("Calibration", "calibration", 3, 100, lsl::cf_int16, "Calibration");
+	lsl::xml_element channels = info.desc().append_child("channels");
+	channels.append_child("channel").append_child_value("gain", "0.5").append_child_value(
+		"offset", "1");
+	channels.append_child("channel").append_child_value("gain", "2");
+	channels.append_child("channel");
+	Streampair sp{create_streampair(info)};
+	sp.in_.set_calibration({2.0, -1.0, 0.25}, {10.0, 0.0, -1.0});
+	CHECK_THROWS_AS(sp.in_.set_calibration({1.0}), std::invalid_argument);
+
+	const int16_t sent[4][3] = {{1, 2, 4}, {-3, 5, 8}, {100, -7, 0}, {0, 0, 16}};
+	for (const auto &sample : sent) sp.out_.push_sample(sample);
+	std::vector<float> pulled(3);
+	sp.in_.pull_sample(pulled, 2.0);
+	CHECK(pulled == std::vector<float>{12.0f, -2.0f, 0.0f});
+	// planar chunks are calibrated before they're transposed
+	double planar[6], stamps[2];
+	REQUIRE(sp.in_.pull_chunk_planar(planar, stamps, 6, 2, 2.0) == 6);
+	CHECK(std::vector<double>(planar, planar + 6) ==
+		  std::vector<double>{4.0, 210.0, -5.0, 7.0, 1.0, -1.0});
+	// pulls into integer buffers get the raw values
+	std::vector<int16_t> raw(3);
+	sp.in_.pull_sample(raw, 2.0);
+	CHECK(raw == std::vector<int16_t>{0, 0, 16});
+
+	sp.in_.set_calibration_from_desc(2.0);
+	for (const auto &sample : sent) sp.out_.push_sample(sample);
+	std::vector<double> chunk(12);
+	REQUIRE(sp.in_.pull_chunk_multiplexed(chunk.data(), nullptr, 12, 0, 2.0) == 12);
+	CHECK(chunk == std::vector<double>{1.5, 4.0, 4.0, -0.5, 10.0, 8.0, 51.0, -14.0, 0.0, 1.0,
+					   0.0, 16.0});
+
+	// without gains and offsets, the values aren't calibrated anymore
+	sp.in_.set_calibration({});
+	sp.out_.push_sample(sent[1]);
+	sp.in_.pull_sample(pulled, 2.0);
+	CHECK(pulled == std::vector<float>{-3.0f, 5.0f, 8.0f});
+}
+
+TEST_CASE("value filter", "[datatransfer][basic]") {
+	SECTION("string markers") {
+		lsl::stream_outlet out(lsl::stream_info(
+			"FilteredMarkers", "Markers", 1, lsl::IRREGULAR_RATE, lsl::cf_string, "Filtered"));
+		auto found = lsl::resolve_stream("name", "FilteredMarkers", 1, 2.0);
+		REQUIRE(!found.empty());
+		lsl::stream_inlet in(found[0]);
+		CHECK_THROWS_AS(in.set_range_filter({{1, 2}}), std::invalid_argument);
+		in.set_value_filter({"Stim/A"}, {"Resp,"});
+		in.open_stream(2.0);
+		out.wait_for_consumers(2.0);
+
+		for (std::string marker : {"stim/a", "Stim/A", "Other", "Resp,1", "Resp", "Resp,2"})
+			out.push_sample(&marker);
+		std::string marker;
+		for (const char *expected : {"Stim/A", "Resp,1", "Resp,2"}) {
+			REQUIRE(in.pull_sample(&marker, 1, 2.0) != 0.0);
+			CHECK(marker == expected);
+		}
+		CHECK(in.pull_sample(&marker, 1, 0.1) == 0.0);
+		// the outlet only sent the matching samples
+		CHECK(in.stats().samples_received == 3);
+	}
+	SECTION("numeric ranges") {
+		lsl::stream_outlet out(lsl::stream_info(
+			"FilteredCodes", "Markers", 2, lsl::IRREGULAR_RATE, lsl::cf_int32, "FilteredCodes"));
+		auto found = lsl::resolve_stream("name", "FilteredCodes", 1, 2.0);
+		REQUIRE(!found.empty());
+		lsl::stream_inlet in(found[0]);
+		CHECK_THROWS_AS(in.set_value_filter({"10"}), std::invalid_argument);
+		CHECK_THROWS_AS(in.set_range_filter({{2, 1}}), std::invalid_argument);
+		in.set_range_filter({{10, 20}, {-5, -5}});
+		in.open_stream(2.0);
+		out.wait_for_consumers(2.0);
+
+		for (int32_t code : {5, 10, -5, 25, 20, -4}) {
+			const int32_t sample[2] = {code, 2 * code};
+			out.push_sample(sample, 50.0 + code);
+		}
+		int32_t sample[2];
+		for (int32_t expected : {10, -5, 20}) {
+			REQUIRE(in.pull_sample(sample, 2, 2.0) == 50.0 + expected);
+			CHECK(sample[0] == expected);
+			CHECK(sample[1] == 2 * expected);
+		}
+		CHECK(in.pull_sample(sample, 2, 0.1) == 0.0);
+		CHECK(in.stats().samples_received == 3);
+	}
+}
+
+TEST_CASE("pull error codes", "[datatransfer][basic]") {
+	std::unique_ptr<lsl::stream_outlet> out(new lsl::stream_outlet(
+		lsl::stream_info("PullErrors", "errors", 2, lsl::IRREGULAR_RATE, lsl::cf_float32, "Pull")));
+	auto found = lsl::resolve_stream("name", "PullErrors", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0], 360, 0, false);
+	in.open_stream(2.0);
+	out->wait_for_consumers(2.0);
+	const float sent[2] = {1.f, 2.f};
+	out->push_sample(sent, 5.0);
+
+	float received[2];
+	int32_t ec = lsl_no_error;
+	// a buffer that doesn't fit is rejected without dropping the sample
+	CHECK(lsl_pull_sample_f(in.handle().get(), received, 1, 2.0, &ec) == 0.0);
+	CHECK(ec == lsl_argument_error);
+	CHECK(lsl_pull_sample_f(in.handle().get(), received, 2, 2.0, &ec) == 5.0);
+	CHECK(ec == lsl_no_error);
+	CHECK(received[1] == 2.f);
+	// an expired timeout is no error
+	CHECK(lsl_pull_sample_f(in.handle().get(), received, 2, 0.01, &ec) == 0.0);
+	CHECK(ec == lsl_no_error);
+
+	out.reset();
+	for (int k = 0; k < 100 && ec == lsl_no_error; ++k)
+		lsl_pull_sample_f(in.handle().get(), received, 2, 0.1, &ec);
+	CHECK(ec == lsl_lost_error);
+	// and stays lost, for all kinds of pulls
+	CHECK(lsl_pull_chunk_f(in.handle().get(), received, nullptr, 2, 0, 0.0, &ec) == 0);
+	CHECK(ec == lsl_lost_error);
+	CHECK(lsl_pull_sample_v(in.handle().get(), received, sizeof(received), 0.0, &ec) == 0.0);
+	CHECK(ec == lsl_lost_error);
+	CHECK_THROWS(in.pull_sample(received, 2, 0.0));
+}
+
+TEST_CASE("channel subset", "[datatransfer][basic]") {
+	lsl::stream_outlet out(lsl::stream_info("Subset", "subset", 4, 100, lsl::cf_int32, "Subset"));
+	auto found = lsl::resolve_stream("name", "Subset", 1, 2.0);
+	REQUIRE(!found.empty());
+	const uint32_t out_of_range = 4;
+	CHECK(lsl_create_inlet_subset(found[0].handle().get(), 360, 0, 1, &out_of_range, 1, 1) ==
+		  nullptr);
+	lsl::stream_inlet in(found[0], {3, 1}, 2);
+	CHECK(in.get_channel_count() == 2);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	for (int32_t k = 0; k < 6; ++k) {
+		const int32_t sent[] = {k * 10, k * 10 + 1, k * 10 + 2, k * 10 + 3};
+		out.push_sample(sent, 100.0 + k);
+	}
+	std::vector<int32_t> received(2);
+	for (int32_t k = 0; k < 6; k += 2) {
+		CHECK(in.pull_sample(received, 2.0) == 100.0 + k);
+		CHECK(received[0] == k * 10 + 3);
+		CHECK(received[1] == k * 10 + 1);
+	}
+	CHECK(in.pull_sample(received, 0.0) == 0.0);
+}
@@ -0,0 +1,563 @@
+#include "helpers.h"
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <lsl_cpp.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEST_CASE("async push", "[datatransfer][basic]") {
+	const int nchan = 2;
+	Streampair sp{create_streampair(
+		lsl::stream_info("AsyncPush", "push", nchan, 100, lsl::cf_float32, "AsyncPush"))};
+	sp.out_.set_async_push(1 << 16);
+
+	// staged pushes of different types, and a push that waits for them, arrive in order
+	const float first[nchan] = {1.f, -1.f};
+	const double second[nchan] = {2., -2.};
+	const int16_t chunk[2 * nchan] = {3, -3, 4, -4};
+	const double chunk_ts[2] = {1003., 1004.};
+	const float last[nchan] = {5.f, -5.f};
+	sp.out_.push_sample(first, 1001.);
+	sp.out_.push_sample(second, 1002.);
+	sp.out_.push_chunk_multiplexed(chunk, chunk_ts, 2 * nchan);
+	const float planar0[1] = {5.f}, planar1[1] = {-5.f};
+	const float *planar[nchan] = {planar0, planar1};
+	const double planar_ts = 1005.;
+	sp.out_.push_chunk_planar(planar, 1, &planar_ts);
+	const double before = lsl::local_clock();
+	sp.out_.push_sample(last);
+	const double after = lsl::local_clock();
+
+	std::vector<float> received(nchan);
+	for (int k = 1; k <= 6; ++k) {
+		const double ts = sp.in_.pull_sample(received, 5.);
+		CHECK(received[0] == static_cast<float>(std::min(k, 5)));
+		CHECK(received[1] == -static_cast<float>(std::min(k, 5)));
+		// samples without a time stamp get the time of the push
+		if (k < 6)
+			CHECK(ts == Approx(1000. + k));
+		else
+			CHECK((ts >= before && ts <= after));
+	}
+
+	// a chunk that doesn't fit into the ring is dropped
+	sp.out_.set_async_push(1);
+	std::vector<float> large(nchan * 100000, 1.f);
+	sp.out_.push_chunk_multiplexed(large);
+	CHECK(sp.out_.stats().samples_dropped == 100000);
+
+	sp.out_.set_async_push(0);
+	sp.out_.push_sample(first);
+	CHECK(sp.in_.pull_sample(received, 5.) != 0.0);
+	CHECK(received[0] == 1.f);
+
+	lsl::stream_outlet strings(lsl::stream_info("AsyncStrings", "push", 1, 0, lsl::cf_string));
+	CHECK_THROWS(strings.set_async_push(1 << 16));
+}
+
+TEST_CASE("transfer statistics", "[datatransfer][basic]") {
+	const int nchan = 2, nsamples = 30;
+	Streampair sp{create_streampair(
+		lsl::stream_info("TransferStats", "stats", nchan, 100, lsl::cf_int16, "TransferStats"))};
+
+	std::vector<int16_t> sent(nchan * nsamples, 1), received(nchan * nsamples);
+	sp.out_.push_chunk_multiplexed(sent.data(), sent.size());
+	std::size_t n = 0;
+	while (n < received.size()) {
+		auto pulled = sp.in_.pull_chunk_multiplexed(
+			received.data() + n, nullptr, received.size() - n, 0, 5.);
+		REQUIRE(pulled > 0);
+		n += pulled;
+	}
+
+	lsl_outlet_stats out_stats = sp.out_.stats();
+	CHECK(out_stats.samples_pushed == nsamples);
+	CHECK(out_stats.samples_sent == nsamples);
+	CHECK(out_stats.samples_dropped == 0);
+	CHECK(out_stats.consumers == 1);
+	CHECK(out_stats.max_queued == 0);
+	lsl_inlet_stats in_stats = sp.in_.stats();
+	CHECK(in_stats.samples_received == nsamples);
+	CHECK(in_stats.bytes_received > 0);
+	CHECK(in_stats.chunks_received >= 1);
+	CHECK(in_stats.chunks_received <= nsamples);
+	CHECK(in_stats.samples_dropped == 0);
+	CHECK(in_stats.samples_available == 0);
+	CHECK(in_stats.reconnects == 0);
+	// the bytes are counted once the write completed, which may be just after the data arrived
+	for (int i = 0; i < 100 && sp.out_.stats().bytes_sent == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	out_stats = sp.out_.stats();
+	// the inlet also counts the headers and test patterns
+	CHECK(out_stats.bytes_sent > 0);
+	CHECK(out_stats.bytes_sent <= in_stats.bytes_received);
+	CHECK(out_stats.chunks_sent >= 1);
+
+	// the pools hold at least the transferred samples, the connections have buffers
+	CHECK(out_stats.memory_samples >= nsamples * nchan * sizeof(int16_t));
+	CHECK(out_stats.memory_queues > 0);
+	// including the receive buffers of the UDP servers, each one for a datagram of up to 64 KiB
+	CHECK(out_stats.memory_network >= 65536);
+	CHECK(out_stats.memory_bytes == out_stats.memory_samples + out_stats.memory_queues +
+										out_stats.memory_network + out_stats.memory_metadata);
+	CHECK(in_stats.memory_samples >= nsamples * nchan * sizeof(int16_t));
+	CHECK(in_stats.memory_queues > 0);
+	CHECK(in_stats.memory_network > 0);
+	CHECK(in_stats.memory_bytes == in_stats.memory_samples + in_stats.memory_queues +
+									   in_stats.memory_network + in_stats.memory_metadata);
+
+	// the receive thread and the transfer thread did some work
+	CHECK(in_stats.cpu_seconds > 0.0);
+	CHECK(out_stats.cpu_seconds > 0.0);
+	CHECK(sp.in_.stats().cpu_seconds >= in_stats.cpu_seconds);
+	CHECK(out_stats.struct_size == sizeof(lsl_outlet_stats));
+	CHECK(in_stats.struct_size == sizeof(lsl_inlet_stats));
+}
+
+TEST_CASE("versioned transfer statistics", "[datatransfer][basic]") {
+	lsl::stream_outlet out(lsl::stream_info("VersionedStats", "stats", 1, 100, lsl::cf_float32));
+	const float sample = 1.f;
+	for (int i = 0; i < 3; ++i) out.push_sample(&sample);
+
+	// a caller that doesn't set the size gets an error
+	lsl_outlet_stats stats{};
+	CHECK(lsl_get_outlet_stats(out.handle().get(), &stats) == lsl_argument_error);
+
+	// a caller that knows an older, smaller version only gets that much
+	const uint32_t old_size = offsetof(lsl_outlet_stats, samples_sent);
+	std::memset(&stats, 0x5a, sizeof(stats));
+	stats.struct_size = old_size;
+	REQUIRE(lsl_get_outlet_stats(out.handle().get(), &stats) == lsl_no_error);
+	CHECK(stats.struct_size == old_size);
+	CHECK(stats.samples_pushed == 3);
+	const auto *rest = reinterpret_cast<const unsigned char *>(&stats) + old_size;
+	CHECK(std::all_of(
+		rest, rest + sizeof(stats) - old_size, [](unsigned char c) { return c == 0x5a; }));
+
+	// and a newer, larger one gets the size this library knows
+	struct {
+		lsl_inlet_stats stats;
+		uint64_t newer_counter;
+	} larger{};
+	larger.stats.struct_size = sizeof(larger);
+	lsl::stream_inlet in(out.info());
+	REQUIRE(lsl_get_inlet_stats(in.handle().get(), &larger.stats) == lsl_no_error);
+	CHECK(larger.stats.struct_size == sizeof(lsl_inlet_stats));
+	CHECK(larger.newer_counter == 0);
+}
+
+TEST_CASE("pushes without consumers", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("NoConsumers", "stats", 1, 100, lsl::cf_int32, "NoConsumers"));
+	for (int32_t i = 0; i < 10; ++i) out.push_sample(&i);
+	std::vector<int32_t> chunk(5, -1);
+	out.push_chunk_multiplexed(chunk);
+	// the samples go nowhere, but are counted as pushed
+	CHECK(out.stats().samples_pushed == 15);
+
+	auto found = lsl::resolve_stream("name", "NoConsumers", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.open_stream(2);
+	REQUIRE(out.wait_for_consumers(2));
+	// a consumer only gets the samples pushed after it registered
+	const int32_t sent = 42;
+	out.push_sample(&sent);
+	int32_t received = 0;
+	CHECK(in.pull_sample(&received, 1, 5.) != 0.0);
+	CHECK(received == sent);
+	CHECK(out.stats().samples_pushed == 16);
+}
+
+TEST_CASE("consumers callback", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("ConsumersCallback", "stats", 1, 100, lsl::cf_int32, "ConsumersCallback"));
+	std::mutex mut;
+	std::condition_variable changed;
+	std::vector<int32_t> counts;
+	out.set_consumers_callback([&](int32_t n) {
+		std::lock_guard<std::mutex> lock(mut);
+		counts.push_back(n);
+		changed.notify_all();
+	});
+	const auto wait_for = [&](int32_t n, int ms) {
+		std::unique_lock<std::mutex> lock(mut);
+		return changed.wait_for(lock, std::chrono::milliseconds(ms),
+			[&]() { return !counts.empty() && counts.back() == n; });
+	};
+	// the current number is reported right away
+	REQUIRE(counts == std::vector<int32_t>{0});
+
+	auto found = lsl::resolve_stream("name", "ConsumersCallback", 1, 2.0);
+	REQUIRE(!found.empty());
+	{
+		lsl::stream_inlet in(found[0]);
+		in.open_stream(2);
+		CHECK(wait_for(1, 5000));
+	}
+	// the outlet notices the disconnect once it sends the next samples
+	const int32_t sample = 0;
+	for (int i = 0; i < 500 && !wait_for(0, 10); ++i) out.push_sample(&sample);
+	CHECK(wait_for(0, 10));
+
+	out.set_consumers_callback(nullptr);
+	const std::size_t calls = counts.size();
+	lsl::stream_inlet in(found[0]);
+	in.open_stream(2);
+	REQUIRE(out.wait_for_consumers(2));
+	std::lock_guard<std::mutex> lock(mut);
+	CHECK(counts.size() == calls);
+}
+
+TEST_CASE("tracing", "[datatransfer][basic]") {
+	const char *filename = "lsl_test_trace.json";
+	if (lsl_start_tracing(10000) != lsl_no_error) {
+		// built without tracing support
+		CHECK(lsl_stop_tracing(filename) == lsl_internal_error);
+		return;
+	}
+	CHECK(lsl_start_tracing(10000) == lsl_internal_error);
+	{
+		Streampair sp{create_streampair(
+			lsl::stream_info("Tracing", "trace", 1, 100, lsl::cf_int32, "Tracing"))};
+		for (int32_t i = 0; i < 10; ++i) sp.out_.push_sample(&i);
+		int32_t value;
+		for (int i = 0; i < 10; ++i) REQUIRE(sp.in_.pull_sample(&value, 1, 5.) != 0.0);
+	}
+	CHECK(lsl_stop_tracing(filename) > 40);
+	CHECK(lsl_stop_tracing(filename) == lsl_internal_error);
+
+	std::ifstream file(filename);
+	const std::string trace{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	for (const char *event : {"push_sample", "queued", "write_chunk", "decoded", "pull_sample"})
+		CHECK(trace.find(std::string("\"") + event + '"') != std::string::npos);
+	CHECK(trace.find("\"seq\":10}") != std::string::npos);
+	file.close();
+	std::remove(filename);
+}
+
+TEST_CASE("push and pull sessions", "[datatransfer][basic]") {
+	Streampair sp{create_streampair(
+		lsl::stream_info("Sessions", "sessions", 2, 100, lsl::cf_int32, "Sessions"))};
+	{
+		lsl::push_session<int32_t> out(sp.out_, 4);
+		for (int32_t i = 0; i < 6; ++i) {
+			const int32_t sample[2] = {i, -i};
+			out.push_sample(sample, 10. + i);
+		}
+		// the first four samples were pushed as a chunk, the rest are buffered
+		CHECK(out.size() == 2);
+		out.push_sample(std::vector<int32_t>{6, -6}, 16.);
+		CHECK_THROWS_AS(out.push_sample(std::vector<int32_t>{1}), std::invalid_argument);
+		// the rest is pushed when the session ends
+	}
+
+	lsl::pull_session<int32_t> in(sp.in_, 3);
+	std::vector<int32_t> sample;
+	for (int32_t i = 0; i < 7; ++i) {
+		REQUIRE(in.pull_sample(sample, 5.) == Approx(10. + i));
+		CHECK(sample == std::vector<int32_t>{i, -i});
+	}
+	CHECK(in.available() == 0);
+	CHECK(in.pull_sample(sample, 0.1) == 0.0);
+}
+
+TEST_CASE("outlet groups", "[datatransfer][basic]") {
+	lsl::stream_info eeg("GroupEEG", "EEG", 2, 100, lsl::cf_float32, "amp"),
+		triggers("GroupTriggers", "Markers", 1, 100, lsl::cf_int32, "amp-triggers");
+	eeg.desc().append_child("channels").append_child("channel").append_child_value("label", "C3");
+	lsl::stream_info strings("GroupStrings", "Markers", 1, 100, lsl::cf_string);
+	CHECK_THROWS_AS(lsl::outlet_group("BadGroup", {eeg, strings}), std::invalid_argument);
+	lsl::stream_info slower("GroupSlower", "EEG", 1, 50, lsl::cf_float32);
+	CHECK_THROWS_AS(lsl::outlet_group("BadGroup", {eeg, slower}), std::invalid_argument);
+	// every member is checked before it's used
+	for (const auto &infos : {std::vector<lsl_streaminfo>{nullptr, eeg.handle().get()},
+			 std::vector<lsl_streaminfo>{eeg.handle().get(), nullptr}}) {
+		CHECK(lsl_create_outlet_group("BadGroup", infos.data(), 2, 0, 360) == nullptr);
+		CHECK(lsl_last_error() == std::string("The member stream infos must not be NULL."));
+	}
+	CHECK(lsl_create_outlet_group("BadGroup", nullptr, 0, 0, 360) == nullptr);
+
+	lsl::outlet_group group("Group", {eeg, triggers});
+	CHECK(group.info().channel_count() == 3);
+	// the formats differ, so the group's samples are doubles
+	CHECK(group.info().channel_format() == lsl::cf_double64);
+	CHECK(group.info().source_id() == "amp+amp-triggers");
+
+	auto found = lsl::resolve_stream("name", "Group", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.open_stream(2);
+	group.wait_for_consumers(2);
+	lsl::stream_info info = in.info(2);
+	const auto members = lsl::group_members(info);
+	REQUIRE(members.size() == 2);
+	CHECK(members[0].name == "GroupEEG");
+	CHECK(members[0].channel_format == "float32");
+	CHECK(members[0].offset == 0);
+	CHECK(members[1].name == "GroupTriggers");
+	CHECK(members[1].channel_count == 1);
+	CHECK(members[1].offset == 2);
+	CHECK(std::string(info.desc()
+							  .child("streams")
+							  .child("stream")
+							  .child("desc")
+							  .child("channels")
+							  .child("channel")
+							  .child_value("label")) == "C3");
+
+	// two samples of each member, pushed as one chunk with a shared time stamp per sample
+	const float eeg_values[] = {1.f, 2.f, 3.f, 4.f}, trigger_values[] = {5.f, 6.f};
+	const float *chunk[] = {eeg_values, trigger_values};
+	const double timestamps[] = {10., 11.};
+	group.push_chunk(chunk, 2, timestamps);
+	group.push_sample(std::vector<std::vector<float>>{{7.f, 8.f}, {9.f}}, 12.);
+	CHECK_THROWS_AS(group.push_sample(std::vector<std::vector<float>>{{7.f, 8.f}}),
+		std::invalid_argument);
+
+	std::vector<double> sample;
+	REQUIRE(in.pull_sample(sample, 2.) == Approx(10.));
+	CHECK(sample == std::vector<double>{1., 2., 5.});
+	REQUIRE(in.pull_sample(sample, 2.) == Approx(11.));
+	CHECK(sample == std::vector<double>{3., 4., 6.});
+	REQUIRE(in.pull_sample(sample, 2.) == Approx(12.));
+	CHECK(sample == std::vector<double>{7., 8., 9.});
+}
+
+TEST_CASE("live reconfiguration", "[datatransfer][basic]") {
+	const int nsamples = 20;
+	Streampair sp{create_streampair(
+		lsl::stream_info("LiveReconfig", "chunks", 1, 1, lsl::cf_int32, "LiveReconfig"))};
+	CHECK_THROWS(sp.in_.set_buffering(-1));
+	CHECK_THROWS(sp.out_.set_chunk_size(-1));
+
+	int32_t data = 0, result = -1;
+	sp.out_.push_sample(&data);
+	REQUIRE(sp.in_.pull_sample(&result, 1, 5.) != 0.0);
+
+	// the outlet's stats once the chunks it sent so far are counted (after they were written)
+	auto settled_stats = [&]() {
+		lsl_outlet_stats last, now = sp.out_.stats();
+		do {
+			last = now;
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			now = sp.out_.stats();
+		} while (now.chunks_sent != last.chunks_sent);
+		return now;
+	};
+	// the number of chunks a chunk of four samples is sent in
+	std::vector<int32_t> four(4, 7);
+	auto chunks_for_four = [&]() {
+		const uint64_t before = settled_stats().chunks_sent;
+		sp.out_.push_chunk_multiplexed(four.data(), four.size());
+		for (int k = 0; k < 4; ++k) REQUIRE(sp.in_.pull_sample(&result, 1, 5.) != 0.0);
+		return settled_stats().chunks_sent - before;
+	};
+	sp.out_.set_chunk_size(2);
+	CHECK(chunks_for_four() == 2);
+
+	// 5 seconds at 1 Hz: only the newest 6 samples are kept, and each sample is a chunk of its
+	// own at the outlet once it applied the inlet's request
+	sp.in_.set_buffering(5, 1);
+	uint64_t chunks = 0;
+	for (int attempt = 0; attempt < 50 && chunks != 4; ++attempt) chunks = chunks_for_four();
+	REQUIRE(chunks == 4);
+
+	std::vector<int32_t> sent(nsamples), received(nsamples);
+	std::vector<double> sent_ts(nsamples), received_ts(nsamples);
+	for (int i = 0; i < nsamples; ++i) {
+		sent[i] = i + 1;
+		sent_ts[i] = 1000. + i;
+	}
+	const lsl_outlet_stats before = settled_stats();
+	sp.out_.push_chunk_multiplexed(sent.data(), sent_ts.data(), sent.size());
+	// wait until the last sample arrived
+	for (int k = 0; k < 500 && sp.in_.samples_available() < 6; ++k)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	const std::size_t pulled = sp.in_.pull_chunk_multiplexed(
+		received.data(), received_ts.data(), received.size(), received_ts.size(), 0.);
+	REQUIRE(pulled > 0);
+	CHECK(pulled <= 6);
+	CHECK(received[pulled - 1] == nsamples);
+	// the outlet's queue was shrunk, too: the samples it didn't send were dropped there
+	const lsl_outlet_stats after = settled_stats();
+	const uint64_t samples_sent = after.samples_sent - before.samples_sent;
+	CHECK(after.chunks_sent - before.chunks_sent == samples_sent);
+	CHECK(samples_sent + after.samples_dropped - before.samples_dropped == nsamples);
+
+	// the connection is still intact
+	data = 42;
+	sp.out_.push_sample(&data);
+	REQUIRE(sp.in_.pull_sample(&result, 1, 5.) != 0.0);
+	CHECK(result == 42);
+}
+
+TEST_CASE("history", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("History", "history", 1, 100, lsl::cf_int32, "History"));
+	out.set_history(10.0);
+	std::vector<int32_t> data(20);
+	for (int32_t i = 0; i < 20; ++i) data[i] = i;
+	out.push_chunk_multiplexed(data);
+
+	auto found = lsl::resolve_stream("name", "History", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	// a late joiner gets the samples pushed before it connected
+	in.request_history(10.0);
+	in.open_stream(2.0);
+	std::vector<int32_t> received;
+	for (int i = 0; i < 5 && received.size() < data.size(); ++i)
+		in.pull_chunk_multiplexed(received, nullptr, 1.0, true);
+	CHECK(received == data);
+}
+
+TEST_CASE("transfer priorities", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("Priorities", "priority", 1, 100, lsl::cf_int32, "Priorities"));
+	auto found = lsl::resolve_stream("name", "Priorities", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet bulk(found[0]), latency(found[0]);
+	CHECK_THROWS(bulk.set_priority(static_cast<lsl::transfer_priority_t>(7)));
+	bulk.set_priority(lsl::priority_bulk);
+	latency.set_priority(lsl::priority_latency);
+	bulk.open_stream(2.0);
+	latency.open_stream(2.0);
+	for (int i = 0; i < 100 && out.stats().consumers < 2; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	REQUIRE(out.stats().consumers == 2);
+
+	// both classes get all samples
+	std::vector<int32_t> sent(200);
+	for (int32_t i = 0; i < 200; ++i) sent[i] = i;
+	out.push_chunk_multiplexed(sent);
+	for (lsl::stream_inlet *in : {&bulk, &latency}) {
+		std::vector<int32_t> received;
+		for (int i = 0; i < 20 && received.size() < sent.size(); ++i)
+			in->pull_chunk_multiplexed(received, nullptr, 0.5, true);
+		CHECK(received == sent);
+	}
+}
+
+TEST_CASE("bandwidth limit", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("Bandwidth", "bandwidth", 8, 1000, lsl::cf_int32, "Bandwidth"));
+	auto found = lsl::resolve_stream("name", "Bandwidth", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	CHECK_THROWS(in.set_max_bandwidth(-1.));
+	in.set_max_bandwidth(40000.);
+	in.open_stream(2.0);
+	REQUIRE(out.wait_for_consumers(2.0));
+
+	// about 40 KB (32 bytes of values and a few bytes of framing per sample)
+	const int nsamples = 1000;
+	std::vector<int32_t> sent(8 * nsamples, 1);
+	const double start = lsl::local_clock();
+	out.push_chunk_multiplexed(sent);
+	std::vector<int32_t> received;
+	for (int i = 0; i < 100 && received.size() < sent.size(); ++i)
+		in.pull_chunk_multiplexed(received, nullptr, 0.1, true);
+	CHECK(received.size() == sent.size());
+	// about a second at the limit, less the initial burst, so only check that it was held back
+	CHECK(lsl::local_clock() - start > 0.25);
+	CHECK(out.stats().throttled_seconds > 0.0);
+}
+
+TEST_CASE("socket options", "[datatransfer][basic]") {
+	lsl::stream_outlet out(
+		lsl::stream_info("SocketOptions", "socketoptions", 1, 100, lsl::cf_int32, "SocketOpts"));
+	out.set_socket_options(256 << 10, -1, 0);
+	auto found = lsl::resolve_stream("name", "SocketOptions", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.set_socket_options(-1, 256 << 10, 0);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+
+	// the data still flows with Nagle's algorithm enabled on both ends
+	int32_t sent = 42, received = 0;
+	out.push_sample(&sent);
+	CHECK(in.pull_sample(&received, 1, 2.0) != 0.0);
+	CHECK(received == sent);
+}
+
+TEST_CASE("thread policy", "[datatransfer][basic]") {
+	const uint32_t cpu = 0;
+	CHECK(lsl_set_thread_policy(lsl_thread_data, nullptr, 1, 0) == lsl_argument_error);
+	CHECK_THROWS_AS(lsl::set_thread_policy(lsl_thread_data, {cpu}, 100), std::invalid_argument);
+	lsl::set_thread_policy(lsl_thread_data, {cpu});
+
+	lsl::stream_outlet out(lsl::stream_info("Pinned", "pinned", 1, 100, lsl::cf_int32, "Pinned"));
+	auto found = lsl::resolve_stream("name", "Pinned", 1, 2.0);
+	REQUIRE(!found.empty());
+	lsl::stream_inlet in(found[0]);
+	in.open_stream(2.0);
+	out.wait_for_consumers(2.0);
+	const int32_t sent = 17;
+	out.push_sample(&sent);
+	int32_t received = 0;
+	CHECK(in.pull_sample(&received, 1, 2.0) != 0.0);
+	CHECK(received == sent);
+	lsl::set_thread_policy(lsl_thread_data, {});
+}
+
+namespace {
+/// A minimal "thread pool" that runs each accepted liblsl thread on a thread of its own.
+struct test_pool {
+	std::mutex mut;
+	std::vector<std::thread> workers;
+	std::vector<lsl_thread_role_t> roles;
+
+	static int32_t start(lsl_thread_role_t role, const char * /*name*/, lsl_thread_body body,
+		void *arg, void *user_data) {
+		auto *pool = static_cast<test_pool *>(user_data);
+		// let liblsl start the time threads itself
+		if (role == lsl_thread_time) return 1;
+		std::lock_guard<std::mutex> lock(pool->mut);
+		pool->roles.push_back(role);
+		pool->workers.emplace_back(body, arg);
+		return 0;
+	}
+};
+} // namespace
+
+TEST_CASE("thread starter", "[datatransfer][basic]") {
+	test_pool pool;
+	lsl::set_thread_starter(&test_pool::start, &pool);
+	{
+		lsl::stream_outlet out(
+			lsl::stream_info("Pooled", "pooled", 1, 100, lsl::cf_int32, "Pooled"));
+		auto found = lsl::resolve_stream("name", "Pooled", 1, 2.0);
+		REQUIRE(!found.empty());
+		lsl::stream_inlet in(found[0]);
+		in.open_stream(2.0);
+		out.wait_for_consumers(2.0);
+		const int32_t sent = 17;
+		out.push_sample(&sent);
+		int32_t received = 0;
+		CHECK(in.pull_sample(&received, 1, 2.0) != 0.0);
+		CHECK(received == sent);
+		CHECK(in.time_correction(2.0) < 1.0);
+	}
+	lsl::set_thread_starter(nullptr);
+
+	std::lock_guard<std::mutex> lock(pool.mut);
+	const auto started = [&pool](lsl_thread_role_t role) {
+		return std::find(pool.roles.begin(), pool.roles.end(), role) != pool.roles.end();
+	};
+	CHECK(started(lsl_thread_io));
+	CHECK(started(lsl_thread_data));
+	CHECK(!started(lsl_thread_time));
+	// the outlet and inlet waited for their threads, a detached transfer thread ends with its
+	// connection
+	for (auto &worker : pool.workers) worker.join();
+}
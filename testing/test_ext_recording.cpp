@@ -0,0 +1,133 @@
+#include "helpers.h"
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <lsl_cpp.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// A chunk of an XDF file.
+struct xdf_chunk {
+	uint16_t tag;
+	std::string content;
+};
+
+template <typename T> T read_value(const std::string &data, std::size_t &pos) {
+	T value;
+	REQUIRE(pos + sizeof(T) <= data.size());
+	memcpy(&value, data.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+uint64_t read_length(const std::string &data, std::size_t &pos) {
+	switch (read_value<uint8_t>(data, pos)) {
+	case 1: return read_value<uint8_t>(data, pos);
+	case 4: return read_value<uint32_t>(data, pos);
+	case 8: return read_value<uint64_t>(data, pos);
+	default: FAIL("invalid length bytes"); return 0;
+	}
+}
+
+std::vector<xdf_chunk> read_xdf(const std::string &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	std::stringstream ss;
+	ss << file.rdbuf();
+	const std::string data = ss.str();
+	REQUIRE(data.substr(0, 4) == "XDF:");
+	std::vector<xdf_chunk> chunks;
+	for (std::size_t pos = 4; pos < data.size();) {
+		const uint64_t len = read_length(data, pos);
+		REQUIRE(len >= 2);
+		REQUIRE(pos + len <= data.size());
+		xdf_chunk chunk;
+		chunk.tag = read_value<uint16_t>(data, pos);
+		chunk.content = data.substr(pos, len - 2);
+		pos += len - 2;
+		chunks.push_back(chunk);
+	}
+	return chunks;
+}
+
+TEST_CASE("recording", "[recording][basic]") {
+	const std::string filename = "lsl_test_recording.xdf";
+	Streampair numeric(create_streampair(
+		lsl::stream_info("recnum", "Test", 2, 100., lsl::cf_float32, "recnum")));
+	Streampair strings(create_streampair(
+		lsl::stream_info("recstr", "Test", 1, lsl::IRREGULAR_RATE, lsl::cf_string, "recstr")));
+	const int n = 50;
+	{
+		lsl::recording rec(filename);
+		rec.add(numeric.in_);
+		rec.add(strings.in_);
+		CHECK_THROWS(rec.add(numeric.in_));
+		for (int i = 0; i < n; ++i) {
+			const float values[] = {static_cast<float>(i), -static_cast<float>(i)};
+			numeric.out_.push_sample(values, 1000. + i);
+			const std::string str = std::string(i * 10, 'x');
+			strings.out_.push_sample(&str, 2000. + i);
+		}
+		// wait for the samples to arrive before closing the recording
+		for (int tries = 0; tries < 100 && numeric.in_.stats().samples_received < n; ++tries)
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		for (int tries = 0; tries < 100 && strings.in_.stats().samples_received < n; ++tries)
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	// the inlets work as usual after the recording was closed
+	CHECK(numeric.in_.samples_available() == 0);
+
+	std::map<uint16_t, int> tag_counts;
+	std::map<uint32_t, std::string> headers;
+	std::vector<float> numeric_values;
+	std::vector<double> numeric_stamps;
+	std::vector<std::string> string_values;
+	for (const auto &chunk : read_xdf(filename)) {
+		++tag_counts[chunk.tag];
+		std::size_t pos = 0;
+		if (chunk.tag == 1)
+			CHECK(chunk.content.find("<version>1.0</version>") != std::string::npos);
+		if (chunk.tag < 2 || chunk.tag == 5) continue;
+		const uint32_t id = read_value<uint32_t>(chunk.content, pos);
+		if (chunk.tag == 2) headers[id] = chunk.content.substr(pos);
+		if (chunk.tag != 3) continue;
+		const bool is_numeric = headers[id].find("<name>recnum</name>") != std::string::npos;
+		const uint64_t num_samples = read_length(chunk.content, pos);
+		for (uint64_t i = 0; i < num_samples; ++i) {
+			REQUIRE(read_value<uint8_t>(chunk.content, pos) == 8);
+			const double stamp = read_value<double>(chunk.content, pos);
+			if (is_numeric) {
+				numeric_stamps.push_back(stamp);
+				numeric_values.push_back(read_value<float>(chunk.content, pos));
+				numeric_values.push_back(read_value<float>(chunk.content, pos));
+			} else {
+				const uint64_t len = read_length(chunk.content, pos);
+				string_values.push_back(chunk.content.substr(pos, len));
+				pos += len;
+			}
+		}
+		CHECK(pos == chunk.content.size());
+	}
+	std::remove(filename.c_str());
+
+	CHECK(tag_counts[1] == 1);
+	CHECK(tag_counts[2] == 2);
+	CHECK(tag_counts[6] == 2);
+	CHECK(headers.size() == 2);
+	REQUIRE(numeric_stamps.size() == n);
+	REQUIRE(string_values.size() == n);
+	for (int i = 0; i < n; ++i) {
+		CHECK(numeric_stamps[i] == 1000. + i);
+		CHECK(numeric_values[2 * i] == static_cast<float>(i));
+		CHECK(numeric_values[2 * i + 1] == -static_cast<float>(i));
+		CHECK(string_values[i] == std::string(i * 10, 'x'));
+	}
+}
+
+} // namespace
@@ -0,0 +1,56 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <lsl_cpp.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+TEST_CASE("relay", "[relay][basic]") {
+	lsl::stream_info info("relaysrc", "Test", 2, 100., lsl::cf_int16, "relaysrc");
+	info.desc().append_child_value("manufacturer", "LSL");
+	std::unique_ptr<lsl::stream_outlet> out(new lsl::stream_outlet(info));
+	auto found = lsl::resolve_stream("name", "relaysrc", 1, 2.0);
+	REQUIRE(!found.empty());
+
+	lsl::relay relay;
+	relay.add(found[0]);
+	CHECK_THROWS_AS(relay.add(found[0]), std::invalid_argument);
+	REQUIRE(relay.size() == 1);
+	// the relayed stream keeps its identity and metadata, but is served by the relay
+	lsl::stream_info relayed = relay.infos().at(0);
+	CHECK(relayed.uid() == out->info().uid());
+	CHECK(relayed.created_at() == out->info().created_at());
+
+	// a resolve might find the source as well, so the relay is connected to directly
+	std::string xml = relayed.as_xml();
+	const std::string no_address = "<v4address />";
+	REQUIRE(xml.find(no_address) != std::string::npos);
+	xml.replace(xml.find(no_address), no_address.size(), "<v4address>127.0.0.1</v4address>");
+	lsl::stream_inlet in(lsl::stream_info::from_xml(xml));
+	CHECK(in.info(2.0).desc().child_value("manufacturer") == std::string("LSL"));
+	in.open_stream(2.0);
+	// the source only serves the relay
+	CHECK(out->wait_for_consumers(2.0));
+	for (int16_t k = 0; k < 20; ++k) {
+		const int16_t values[2] = {k, static_cast<int16_t>(-k)};
+		out->push_sample(values, 100.0 + k);
+	}
+	for (int16_t k = 0; k < 20; ++k) {
+		int16_t values[2];
+		// both ends share the local clock
+		REQUIRE(in.pull_sample(values, 2, 2.0) == Approx(100.0 + k));
+		CHECK(values[0] == k);
+		CHECK(values[1] == -k);
+	}
+
+	// the relayed stream ends with its source
+	out.reset();
+	for (int attempt = 0; attempt < 50 && relay.size(); ++attempt)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(relay.size() == 0);
+}
+
+} // namespace
@@ -0,0 +1,131 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <lsl_cpp.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename T> void put(std::string &out, T value) {
+	out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void put_chunk(std::string &out, uint16_t tag, const std::string &content) {
+	put<uint8_t>(out, 8);
+	put<uint64_t>(out, sizeof(tag) + content.size());
+	put(out, tag);
+	out += content;
+}
+
+/// A Samples chunk header for count samples of a stream.
+std::string samples_chunk(uint32_t id, uint32_t count) {
+	std::string content;
+	put(content, id);
+	put<uint8_t>(content, 4);
+	put(content, count);
+	return content;
+}
+
+TEST_CASE("replay", "[replay][basic]") {
+	const std::string filename = "lsl_test_replay.xdf";
+	lsl::stream_info numeric("replaynum", "Test", 2, 100., lsl::cf_float32, "replaynum");
+	lsl::stream_info strings("replaystr", "Test", 1, lsl::IRREGULAR_RATE, lsl::cf_string, "rs");
+	{
+		std::string xdf = "XDF:";
+		put_chunk(xdf, 1, "<?xml version=\"1.0\"?><info><version>1.0</version></info>");
+		std::string header;
+		put(header, uint32_t{1});
+		put_chunk(xdf, 2, header + numeric.as_xml());
+		header.clear();
+		put(header, uint32_t{2});
+		put_chunk(xdf, 2, header + strings.as_xml());
+		// the numeric stream's time stamps are 5 s behind the recorder's clock
+		std::string offset;
+		put(offset, uint32_t{1});
+		put(offset, 0.);
+		put(offset, 5.);
+		put_chunk(xdf, 4, offset);
+		// 40 samples at 100 Hz in two chunks, only the first one with a time stamp
+		for (int c = 0; c < 2; ++c) {
+			std::string content = samples_chunk(1, 20);
+			for (int i = c * 20; i < (c + 1) * 20; ++i) {
+				put<uint8_t>(content, i == 0 ? 8 : 0);
+				if (i == 0) put(content, 100.);
+				put(content, static_cast<float>(i));
+				put(content, -static_cast<float>(i));
+			}
+			put_chunk(xdf, 3, content);
+		}
+		// 10 strings every 20 ms, starting with the first numeric sample
+		std::string content = samples_chunk(2, 10);
+		for (int i = 0; i < 10; ++i) {
+			put<uint8_t>(content, 8);
+			put(content, 105. + i * .02);
+			const std::string str(i * 10, 'x');
+			put<uint8_t>(content, 1);
+			put(content, static_cast<uint8_t>(str.size()));
+			content += str;
+		}
+		put_chunk(xdf, 3, content);
+		std::ofstream(filename, std::ios::binary) << xdf;
+	}
+
+	lsl::replay r(filename, 2.);
+	const auto infos = r.infos();
+	REQUIRE(infos.size() == 2);
+	CHECK(infos[0].name() == "replaynum");
+	CHECK(infos[0].channel_count() == 2);
+	CHECK(infos[1].name() == "replaystr");
+	CHECK(infos[1].channel_format() == lsl::cf_string);
+
+	auto found_num = lsl::resolve_stream("name", "replaynum", 1, 5.);
+	auto found_str = lsl::resolve_stream("name", "replaystr", 1, 5.);
+	REQUIRE(!found_num.empty());
+	REQUIRE(!found_str.empty());
+	lsl::stream_inlet in_num(found_num[0]), in_str(found_str[0]);
+	in_num.open_stream(2.);
+	in_str.open_stream(2.);
+	// let the outlets register the consumers
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	const auto start = std::chrono::steady_clock::now();
+	r.start();
+	REQUIRE(r.wait(5.));
+	// 0.39 s of samples at twice the speed
+	const double elapsed =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	CHECK(elapsed >= .18);
+	CHECK(elapsed < 2.);
+
+	double first = 0.;
+	for (int i = 0; i < 40; ++i) {
+		float values[2];
+		const double stamp = in_num.pull_sample(values, 2, 2.);
+		REQUIRE(stamp != 0.);
+		if (i == 0) first = stamp;
+		CHECK(values[0] == static_cast<float>(i));
+		CHECK(values[1] == -static_cast<float>(i));
+		CHECK(stamp - first == Approx(i * .005).margin(1e-6));
+	}
+	for (int i = 0; i < 10; ++i) {
+		std::string str;
+		const double stamp = in_str.pull_sample(&str, 1, 2.);
+		CHECK(str == std::string(i * 10, 'x'));
+		CHECK(stamp - first == Approx(i * .01).margin(1e-6));
+	}
+	std::remove(filename.c_str());
+}
+
+TEST_CASE("replay_errors", "[replay][basic]") {
+	CHECK_THROWS(lsl::replay("lsl_test_replay_missing.xdf"));
+	const std::string filename = "lsl_test_replay_invalid.xdf";
+	std::ofstream(filename, std::ios::binary) << "not an xdf file";
+	CHECK_THROWS(lsl::replay(filename));
+	std::remove(filename.c_str());
+}
+
+} // namespace
@@ -1,5 +1,6 @@
 #include "helpers.h"
 #include <atomic>
+#include <cmath>
 #include <catch2/catch.hpp>
 #include <lsl_cpp.h>
 #include <thread>
@@ -19,6 +20,31 @@ TEST_CASE("simple timesync", "[timesync][basic]") {
 	CHECK(remote_time < lsl::local_clock());
 }
 
+TEST_CASE("latest timesync", "[timesync][basic]") {
+	auto sp = create_streampair(lsl::stream_info("latesttimesync", "Test"));
+	double offset = 0.0, remote_time = 0.0, uncertainty = 0.0;
+	// the first call only starts the estimation
+	auto end = lsl::local_clock() + 5;
+	while (!sp.in_.latest_time_correction(offset, &remote_time, &uncertainty) &&
+		   lsl::local_clock() < end)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(std::abs(offset) * 1000 < 1);
+	CHECK(uncertainty * 1000 < 1);
+	CHECK(remote_time < lsl::local_clock());
+	// and it agrees with the blocking call
+	CHECK(sp.in_.time_correction(5.) == Approx(offset).margin(0.001));
+}
+
+// needs [tuning] SharedTimeSync, run by ctest with lslcfgs/sharedtimesync.cfg
+TEST_CASE("shared timesync", "[timesync][.sharedtimesync]") {
+	// both outlets are on this host, so one inlet's probes are enough for both
+	auto sp1 = create_streampair(lsl::stream_info("sharedtimesync1", "Test"));
+	auto sp2 = create_streampair(lsl::stream_info("sharedtimesync2", "Test"));
+	const double offset1 = sp1.in_.time_correction(5.);
+	const double offset2 = sp2.in_.time_correction(5.);
+	CHECK(offset1 * 1000 < 1);
+	CHECK(offset2 == Approx(offset1).margin(0.001));
+}
 
 TEST_CASE("timeouts", "[pull][basic]") {
 	auto sp = create_streampair(
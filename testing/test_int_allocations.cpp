@@ -0,0 +1,194 @@
+#include "../src/alloc_guard.h"
+#include "../src/api_config.h"
+#include "../src/common.h"
+#include "../src/stream_config.h"
+#include "../src/stream_info_impl.h"
+#include "../src/stream_inlet_impl.h"
+#include "../src/stream_outlet_impl.h"
+#include "../src/thread_policy.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// clazy:excludeall=non-pod-global-static
+
+/// the allocations of the threads that count them
+static std::atomic<uint64_t> allocations{0};
+/// whether this thread's allocations are counted
+static thread_local bool count_allocations = false;
+
+void *operator new(std::size_t size) {
+	if (count_allocations) allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+TEST_CASE("no allocation steady state", "[network][basic]") {
+	const uint32_t channels = 8, chunk = 16;
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.no_allocation = true;
+	const auto config_p = std::make_shared<const lsl::stream_config>(config);
+
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("noalloc", "test", channels, 1000., cft_float32, "noalloc"), 0, 360,
+		false, config_p);
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl inlet(info, 360, 0, true, {}, 1, config_p);
+	inlet.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+
+	std::vector<float> sample(channels, 1.f), data(chunk * channels);
+	std::vector<double> timestamps(chunk);
+	const auto round = [&]() {
+		for (uint32_t i = 0; i < chunk; ++i) outlet.push_sample(sample.data(), 1.0 + i);
+		for (std::size_t pulled = 0; pulled < chunk;)
+			pulled += inlet.pull_chunk_multiplexed(data.data() + pulled * channels,
+						  timestamps.data() + pulled, (chunk - pulled) * channels, chunk - pulled,
+						  1.0) /
+					  channels;
+	};
+	// the first rounds size the pools, buffers and the thread's pull buffers
+	for (int i = 0; i < 20; ++i) round();
+
+	const uint64_t violations = lsl::allocation_violations();
+	count_allocations = true;
+	for (int i = 0; i < 100; ++i) round();
+	count_allocations = false;
+	CHECK(allocations.load() == 0);
+	CHECK(lsl::allocation_violations() == violations);
+}
+
+#ifdef __linux__
+/// The memory (in kB) the process has locked.
+static long locked_kb() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+		if (line.compare(0, 6, "VmLck:") == 0) return std::stol(line.substr(6));
+	return -1;
+}
+
+// needs [tuning] LockMemory, run by ctest with lslcfgs/lockmemory.cfg
+TEST_CASE("nested memory locks", "[memory][.lockmemory]") {
+	REQUIRE(lsl::api_config::get_instance()->lock_memory());
+	const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	const long page_kb = static_cast<long>(page / 1024), before = locked_kb();
+	auto *region = static_cast<char *>(aligned_alloc(page, 3 * page));
+	REQUIRE(region);
+	lsl::lock_memory(region, page + 100);
+	if (locked_kb() == before) {
+		std::free(region);
+		WARN("The memory can't be locked (RLIMIT_MEMLOCK?)");
+		return;
+	}
+	// the second buffer shares the middle page with the first one
+	lsl::lock_memory(region + page + 200, page);
+	CHECK(locked_kb() - before == 3 * page_kb);
+	lsl::unlock_memory(region, page + 100);
+	CHECK(locked_kb() - before == 2 * page_kb);
+	lsl::unlock_memory(region + page + 200, page);
+	CHECK(locked_kb() == before);
+	std::free(region);
+
+	// the memory of a container stays locked when it moves as the container grows
+	{
+		std::vector<char, lsl::locked_allocator<char>> buffer(4 * page);
+		CHECK(locked_kb() - before >= 4 * page_kb);
+		buffer.resize(64 * page);
+		CHECK(locked_kb() - before >= 64 * page_kb);
+		CHECK(locked_kb() - before <= 66 * page_kb);
+	}
+	CHECK(locked_kb() == before);
+}
+#endif
+
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+/// The NUMA node of the page at an address, or -1 if it's unknown.
+static int page_node(const void *addr) {
+	// MPOL_F_NODE | MPOL_F_ADDR from <numaif.h>
+	int node = -1;
+	if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr, 3) != 0) return -1;
+	return node;
+}
+
+/// The CPUs of a NUMA node.
+static std::set<uint32_t> node_cpus(int node) {
+	std::set<uint32_t> cpus;
+	std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	for (std::string range; std::getline(cpulist, range, ',');) {
+		const auto dash = range.find('-');
+		const auto first = std::stoul(range.substr(0, dash));
+		const auto last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+		for (auto cpu = first; cpu <= last; ++cpu) cpus.insert(static_cast<uint32_t>(cpu));
+	}
+	return cpus;
+}
+
+TEST_CASE("numa placement", "[memory][basic]") {
+	const int node = lsl::current_numa_node();
+	if (node < 0 || page_node(&node) < 0) {
+		WARN("The NUMA nodes are unknown");
+		return;
+	}
+
+	// the pages of memory bound to a node are allocated there
+	const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	auto *region = static_cast<char *>(aligned_alloc(page, 4 * page));
+	REQUIRE(region);
+	lsl::bind_memory_to_node(region, 4 * page, node);
+	std::memset(region, 1, 4 * page);
+	for (std::size_t k = 0; k < 4; ++k) CHECK(page_node(region + k * page) == node);
+	std::free(region);
+
+	// a library thread pinned to the node only runs on the node's CPUs
+	const auto cpus = node_cpus(node);
+	REQUIRE(!cpus.empty());
+	std::set<uint32_t> allowed;
+	lsl::managed_thread thread(lsl_thread_transfer, "numa", [node, &allowed]() {
+		lsl::pin_to_numa_node(node);
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) != 0) return;
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			if (CPU_ISSET(cpu, &set)) allowed.insert(cpu);
+	});
+	thread.join();
+	REQUIRE(!allowed.empty());
+	for (uint32_t cpu : allowed) CHECK(cpus.count(cpu));
+}
+
+// needs [tuning] NumaAware, run by ctest with lslcfgs/numa.cfg
+TEST_CASE("numa aware outlets", "[memory][.numa]") {
+	REQUIRE(lsl::api_config::get_instance()->numa_aware());
+	const int node = lsl::current_numa_node();
+	if (node < 0 || page_node(&node) < 0) {
+		WARN("The NUMA nodes are unknown");
+		return;
+	}
+	// the outlet's samples are allocated on the node of the thread that creates it
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("numa", "test", 8, 1000., cft_float32, "numa"), 0, 360);
+	for (int k = 0; k < 100; ++k) {
+		lsl::sample_p samp(outlet.sample_factory()->new_sample(0.0, true));
+		CHECK(page_node(samp.get()) == node);
+	}
+}
+#endif
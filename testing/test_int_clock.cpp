@@ -0,0 +1,54 @@
+#include "../src/tsc_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+int64_t steady_ns() {
+	return std::chrono::nanoseconds(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Raise an atomic maximum to value.
+void raise(std::atomic<int64_t> &max, int64_t value) {
+	int64_t old = max.load();
+	while (old < value && !max.compare_exchange_weak(old, value)) {}
+}
+
+// needs [tuning] TSCClock, run by ctest with lslcfgs/tsc.cfg
+TEST_CASE("tsc clock", "[timesync][.tsc]") {
+	lsl::tsc_clock *clock = lsl::tsc_clock::instance();
+	if (!clock) {
+		WARN("No invariant time stamp counter");
+		return;
+	}
+	// a few synchronizations (about one per second), done by whichever reader comes first
+	const int64_t end = steady_ns() + 3500000000;
+	// the latest time any thread has read, how often a thread read an earlier time after it, and
+	// the largest difference to steady_clock
+	std::atomic<int64_t> latest{0}, backwards{0}, max_deviation{0};
+	std::vector<std::thread> readers;
+	for (int k = 0; k < 4; ++k)
+		readers.emplace_back([&]() {
+			for (int64_t before = steady_ns(); before < end;) {
+				const int64_t earlier = latest.load();
+				const int64_t now = clock->now_ns();
+				const int64_t after = steady_ns();
+				if (now < earlier) backwards++;
+				raise(latest, now);
+				raise(max_deviation, std::max(before - now, now - after));
+				before = after;
+			}
+		});
+	for (auto &reader : readers) reader.join();
+	CHECK(backwards == 0);
+	// the clock follows steady_clock within the slew bound
+	CHECK(max_deviation <= 1000000);
+}
+
+} // namespace
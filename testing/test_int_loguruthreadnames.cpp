@@ -1,5 +1,11 @@
+#include "../src/api_config.h"
+#include "../src/async_log.h"
+#include <chrono>
 #include <loguru.hpp>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <catch2/catch.hpp>
 
@@ -14,3 +20,52 @@ TEST_CASE("loguru_thread_local_storage", "[threading]") {
 	loguru::get_thread_name(name,2,false);
 	REQUIRE(name[0] == '1');
 }
+
+/// the single call site of the async_log test, so its messages share the rate limit
+static void log_async_test(int i) { ALOG_F(WARNING, "async test %d", i); }
+
+TEST_CASE("async_log", "[threading]") {
+	struct collected {
+		std::mutex mut;
+		std::vector<std::string> messages;
+	} logged;
+	loguru::add_callback(
+		"async_log_test",
+		[](void *user_data, const loguru::Message &msg) {
+			auto &c = *static_cast<collected *>(user_data);
+			std::lock_guard<std::mutex> lock(c.mut);
+			if (std::string(msg.message).find("async test") != std::string::npos)
+				c.messages.emplace_back(msg.message);
+		},
+		&logged, loguru::Verbosity_WARNING);
+
+	// a burst from one call site is cut off at the rate limit
+	const auto *cfg = lsl::api_config::get_instance();
+	const int limit = cfg->log_rate_limit(), burst = limit > 0 ? 3 * limit : 30;
+	std::thread([burst]() {
+		loguru::set_thread_name("alogtest");
+		for (int i = 0; i < burst; ++i) log_async_test(i);
+	}).join();
+	lsl::flush_async_log();
+	{
+		std::lock_guard<std::mutex> lock(logged.mut);
+		REQUIRE(!logged.messages.empty());
+		// the messages name the thread that logged them
+		if (cfg->log_async()) CHECK(logged.messages[0].find("[alogtest] async test 0") == 0);
+		// at most two seconds started during the burst
+		if (limit > 0) CHECK(logged.messages.size() <= static_cast<std::size_t>(2 * limit));
+	}
+
+	// the next message after the burst counts the dropped ones
+	if (limit > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+		log_async_test(-1);
+		lsl::flush_async_log();
+	}
+	loguru::remove_callback("async_log_test");
+	std::lock_guard<std::mutex> lock(logged.mut);
+	if (limit > 0) {
+		CHECK(logged.messages.back().find("async test -1 (") != std::string::npos);
+		CHECK(logged.messages.back().find("more dropped)") != std::string::npos);
+	}
+}
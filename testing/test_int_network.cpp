@@ -1,17 +1,62 @@
+#include "../src/api_config.h"
 #include "../src/cancellable_streambuf.h"
+// after cancellable_streambuf.h, which configures asio
+#include "../src/bundle.h"
+#include "../src/discovery_cache.h"
+#include "../src/host_daemon.h"
+#include "../src/io_context_pool.h"
+#include "../src/local_feed.h"
+#include "../src/netinterfaces.h"
+#include "../src/rdma_transport.h"
+#include "../src/resolve_attempt_udp.h"
+#include "../src/resolver_impl.h"
+#include "../src/sample.h"
+#include "../src/sample_frame.h"
+#include "../src/send_buffer.h"
+#include "../src/shm_transport.h"
+#include "../src/socket_utils.h"
+#include "../src/stream_config.h"
+#include "../src/stream_info_impl.h"
+#include "../src/stream_inlet_impl.h"
+#include "../src/stream_outlet_impl.h"
+#include "../src/task_pool.h"
+#include "../src/thread_policy.h"
+#include "../src/token_bucket.h"
+#include "../src/udp_server.h"
+#include "../src/watchdog_wheel.h"
+#include <boost/asio/buffers_iterator.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/ip/v6_only.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/endian/conversion.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <catch2/catch.hpp>
 #include <chrono>
+#include <cmath>
 #include <condition_variable>
+#include <functional>
 #include <future>
+#include <loguru.hpp>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <sstream>
 #include <thread>
 
+#ifndef _WIN32
+#include <boost/asio/local/stream_protocol.hpp>
+#endif
+
 namespace asio = lslboost::asio;
 using namespace asio;
 using err_t = const lslboost::system::error_code &;
@@ -133,6 +178,1352 @@ TEST_CASE("cancel streambuf reads", "[streambuf][network][!mayfail]") {
 		sb_read);
 }
 
+TEST_CASE("streambuf bulk reads", "[streambuf][basic][network]") {
+	asio::io_context io_ctx;
+	lsl::cancellable_streambuf sb_read;
+	sb_read.set_max_receive_buffer(64 << 10);
+	ip::tcp::endpoint ep(ip::address_v4::loopback(), port++);
+	ip::tcp::acceptor remote(io_ctx, ep, true);
+	remote.listen(1);
+	sb_read.connect(ep);
+	ip::tcp::socket sock(remote.accept());
+
+	std::vector<char> sent(1 << 20);
+	for (std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<char>(i * 7 + i / 251);
+	std::thread sender([&]() { asio::write(sock, asio::buffer(sent)); });
+	// small reads go through the (growing) buffer, large ones straight into the target
+	std::vector<char> received(sent.size());
+	std::size_t pos = 0;
+	for (std::size_t len : {1, 100, 5000, 300000, 3, 70000})
+		for (int k = 0; k < 3 && pos + len <= received.size(); ++k, pos += len)
+			REQUIRE(sb_read.sgetn(&received[pos], static_cast<std::streamsize>(len)) ==
+					static_cast<std::streamsize>(len));
+	const auto rest = static_cast<std::streamsize>(received.size() - pos);
+	CHECK(sb_read.sgetn(&received[pos], rest) == rest);
+	sender.join();
+	CHECK(received == sent);
+	CHECK(sb_read.bytes_received() == sent.size());
+}
+
+TEST_CASE("streambuf receive timeout", "[streambuf][basic][network]") {
+	asio::io_context io_ctx;
+	lsl::cancellable_streambuf sb_read;
+	ip::tcp::endpoint ep(ip::address_v4::loopback(), port++);
+	ip::tcp::acceptor remote(io_ctx, ep, true);
+	remote.listen(1);
+	sb_read.connect(ep);
+	ip::tcp::socket sock(remote.accept());
+	sb_read.set_receive_timeout(0.1);
+
+	// the data that arrives in time is read as usual
+	asio::write(sock, asio::buffer("abc", 3));
+	char received[3];
+	REQUIRE(sb_read.sgetn(received, 3) == 3);
+	CHECK(std::string(received, 3) == "abc");
+	// then the read gives up
+	const double start = lsl::lsl_clock();
+	CHECK(sb_read.sgetc() == std::char_traits<char>::eof());
+	CHECK(sb_read.error() == asio::error::timed_out);
+	CHECK(lsl::lsl_clock() - start < 1.0);
+}
+
+TEST_CASE("socket options", "[network][basic]") {
+	io_context io_ctx;
+	ip::tcp::socket sock(io_ctx);
+	sock.open(ip::tcp::v4());
+	lsl::socket_options opts;
+	opts.no_delay = false;
+	opts.receive_buffer_bytes = 128 << 10;
+	lsl::apply_socket_options(sock, opts);
+	ip::tcp::no_delay no_delay;
+	sock.get_option(no_delay);
+	CHECK(!no_delay.value());
+	socket_base::receive_buffer_size rcvbuf;
+	sock.get_option(rcvbuf);
+	// the OS may round the size up (Linux doubles it for its bookkeeping)
+	CHECK(rcvbuf.value() >= opts.receive_buffer_bytes);
+
+	// negative values keep the current settings
+	const auto updated = opts.updated(-1, 0, 1, -1);
+	CHECK(updated.receive_buffer_bytes == 0);
+	CHECK(updated.no_delay);
+	CHECK(updated.send_buffer_bytes == opts.send_buffer_bytes);
+}
+
+TEST_CASE("time probes over TCP", "[network][basic]") {
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("tcptimesync", "test", 1, 100., cft_float32, "tcptimesync"));
+	io_context io_ctx;
+	ip::tcp::socket sock(io_ctx);
+	sock.connect(ip::tcp::endpoint(ip::address_v4::loopback(), outlet.info().v4data_port()));
+	const double t0 = lsl::lsl_clock();
+	std::ostringstream probes;
+	probes.precision(16);
+	probes << "LSL:timedata\r\n42 " << t0 << "\r\n43 " << t0 << "\r\n";
+	lslboost::asio::write(sock, lslboost::asio::buffer(probes.str()));
+
+	// each probe is answered on a line, like over UDP: [wave id] [t0] [t1] [t2]
+	lslboost::asio::streambuf replies;
+	std::istream reply_stream(&replies);
+	for (int wave_id : {42, 43}) {
+		lslboost::asio::read_until(sock, replies, "\r\n");
+		int id;
+		double reply_t0, t1, t2;
+		REQUIRE(reply_stream >> id >> reply_t0 >> t1 >> t2);
+		reply_stream.ignore(2);
+		CHECK(id == wave_id);
+		CHECK(reply_t0 == Approx(t0));
+		CHECK(t1 >= t0);
+		CHECK(t2 >= t1);
+	}
+}
+
+TEST_CASE("stream config overrides", "[network][basic]") {
+	// this outlet replaces the pushed time stamps, unlike the configuration file's default
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.force_default_timestamps = true;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("streamconfig", "test", 1, 100., cft_float32, "streamconfig"), 0,
+		512000, false, std::make_shared<const lsl::stream_config>(config));
+	CHECK(outlet.config().force_default_timestamps);
+	CHECK(outlet.config().use_protocol_version ==
+		  lsl::api_config::get_instance()->use_protocol_version());
+
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	const double before = lsl::lsl_clock();
+	outlet.push_sample(std::vector<float>{1.f}, 5.0);
+	std::vector<float> values(1);
+	CHECK(in.pull_sample(values, 2.0) >= before);
+	CHECK(values[0] == 1.f);
+
+	// asynchronous pushes get the time they were pushed at, not when the worker pushes them
+	outlet.set_async_push(1 << 16);
+	std::vector<double> pushed(100);
+	for (double &t : pushed) {
+		outlet.push_sample(std::vector<float>{2.f}, 5.0);
+		t = lsl::lsl_clock();
+	}
+	for (double t : pushed) {
+		const double ts = in.pull_sample(values, 2.0);
+		CHECK(ts >= before);
+		CHECK(ts <= t);
+	}
+	outlet.set_async_push(0);
+
+	// the sessions of inlets that connect later get the new settings
+	config.chunk_max_bytes = 1024;
+	outlet.set_config(std::make_shared<const lsl::stream_config>(config));
+	CHECK(outlet.config().chunk_max_bytes == 1024);
+}
+
+TEST_CASE("deduced time stamps", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.deduced_timestamps_max = 5;
+	config.deduced_timestamps_tolerance = 0.0005;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("deduced", "test", 1, 100., cft_int32, "deduced"), 0, 512000, false,
+		std::make_shared<const lsl::stream_config>(config));
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	outlet.wait_for_consumers(2.0);
+
+	// slightly jittered time stamps, a jump and a chunk with time stamps of its own
+	const int32_t n = 40;
+	for (int32_t i = 0; i < n; ++i)
+		outlet.push_sample(&i, 1000. + i * .01 + (i % 3 ? .0002 : 0.) + (i >= 20 ? 5. : 0.));
+	std::vector<int32_t> values(n, 0);
+	for (int32_t i = 0; i < n; ++i) values[i] = n + i;
+	std::vector<double> stamps(n);
+	for (int32_t i = 0; i < n; ++i) stamps[i] = 2000. + i * .01;
+	outlet.push_chunk_multiplexed(values.data(), stamps.data(), values.size());
+	for (int32_t i = 0; i < 2 * n; ++i) {
+		int32_t value;
+		const double ts = in.pull_sample(&value, 1, 2.0);
+		REQUIRE(value == i);
+		const double expected = i < n ? 1000. + i * .01 + (i % 3 ? .0002 : 0.) + (i >= 20 ? 5. : 0.)
+									  : 2000. + (i - n) * .01;
+		CHECK(ts == Approx(expected).margin(.0005 + 1e-9).epsilon(0));
+	}
+}
+
+TEST_CASE("deduced time stamps of late inlets", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.deduced_timestamps_max = 20;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("deducedlate", "test", 1, 100., cft_int32, "deducedlate"), 0,
+		512000, false, std::make_shared<const lsl::stream_config>(config));
+	outlet.set_history(10.0, 1000);
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	const auto timestamp = [](int32_t i) { return 1000. + i * .01; };
+	const auto check_pulled = [&](lsl::stream_inlet_impl &in, int32_t first, int32_t last) {
+		for (int32_t i = first; i <= last; ++i) {
+			int32_t value = -1;
+			const double ts = in.pull_sample(&value, 1, 2.0);
+			REQUIRE(value == i);
+			CHECK(ts == Approx(timestamp(i)).margin(1e-6).epsilon(0));
+		}
+	};
+
+	lsl::stream_inlet_impl first(info);
+	first.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+	for (int32_t i = 0; i < 10; ++i) outlet.push_sample(&i, timestamp(i));
+	check_pulled(first, 0, 9);
+
+	// an inlet that joins while another one is connected gets its first time stamp
+	lsl::stream_inlet_impl second(info);
+	second.open_stream(2.0);
+	for (int32_t i = 10; i < 30; ++i) outlet.push_sample(&i, timestamp(i));
+	check_pulled(first, 10, 29);
+	check_pulled(second, 10, 29);
+
+	// and so does one that gets the samples replayed from the history
+	lsl::stream_inlet_impl replayed(info);
+	replayed.request_history(10.0);
+	replayed.open_stream(2.0);
+	check_pulled(replayed, 0, 29);
+}
+
+TEST_CASE("max-latency chunking", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.chunk_max_latency_us = 20000;
+	config.chunk_max_bytes = 0;
+	lsl::stream_outlet_impl outlet(lsl::stream_info_impl("maxlatency", "test", 1,
+									   lsl::IRREGULAR_RATE, cft_int32, "maxlatency"),
+		0, 512000, false, std::make_shared<const lsl::stream_config>(config));
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+	lsl_outlet_stats before{}, after{};
+	outlet.get_stats(before);
+
+	// a lone sample is held back until its deadline, but not longer
+	int32_t value = 0;
+	double start = lsl::lsl_clock();
+	outlet.push_sample(&value);
+	REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+	const double held = lsl::lsl_clock() - start;
+	CHECK(held >= 0.019);
+	CHECK(held < 0.5);
+
+	// samples pushed (with pushthrough) every millisecond are sent in a few chunks
+	const int32_t n = 60;
+	for (int32_t i = 0; i < n; ++i) {
+		outlet.push_sample(&i);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	for (int32_t i = 0; i < n; ++i) {
+		REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+		CHECK(value == i);
+	}
+	outlet.get_stats(after);
+	CHECK(after.samples_sent - before.samples_sent == n + 1);
+	CHECK(after.chunks_sent - before.chunks_sent >= 2);
+	CHECK(after.chunks_sent - before.chunks_sent <= n / 4);
+}
+
+TEST_CASE("adaptive chunking", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.adaptive_chunking = true;
+	config.chunk_max_latency_us = 0;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("adaptive", "test", 8, lsl::IRREGULAR_RATE, cft_int32, "adaptive"),
+		0, 512000, false, std::make_shared<const lsl::stream_config>(config));
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+	lsl_outlet_stats before{}, after{};
+
+	// a burst of samples pushed one by one (with pushthrough) is coalesced into larger chunks
+	std::vector<int32_t> values(8, 0);
+	outlet.get_stats(before);
+	const int32_t n = 20000;
+	for (int32_t i = 0; i < n; ++i) {
+		values[0] = i;
+		outlet.push_sample(values.data());
+	}
+	// (the outlet's queue for the inlet overflows, so not all of them are sent)
+	for (double end = lsl::lsl_clock() + 5.0; lsl::lsl_clock() < end;) {
+		outlet.get_stats(after);
+		if (!after.max_queued) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	const uint64_t burst_samples = after.samples_sent - before.samples_sent,
+				   burst_chunks = after.chunks_sent - before.chunks_sent;
+	CHECK(burst_samples > 0);
+	CHECK(burst_chunks * 2 < burst_samples);
+	in.flush();
+
+	// once the link is idle, each sample is sent on its own right away
+	const int32_t idle = 10;
+	for (int32_t i = 0; i < idle; ++i) {
+		values[0] = i;
+		const double start = lsl::lsl_clock();
+		outlet.push_sample(values.data());
+		REQUIRE(in.pull_sample(values.data(), 8, 2.0) != 0.0);
+		CHECK(values[0] == i);
+		CHECK(lsl::lsl_clock() - start < 0.1);
+	}
+}
+
+namespace {
+/// Runs the transfer threads of the stream "parking" and counts how many of them are running.
+struct parking_threads {
+	std::mutex mut;
+	std::vector<std::thread> threads;
+	std::atomic<int> running{0};
+
+	static int32_t start(lsl_thread_role_t role, const char *name, lsl_thread_body body,
+		void *arg, void *user_data) {
+		if (role != lsl_thread_transfer || std::string(name) != "S_parking") return 1;
+		auto *self = static_cast<parking_threads *>(user_data);
+		std::lock_guard<std::mutex> lock(self->mut);
+		self->running++;
+		self->threads.emplace_back([self, body, arg]() {
+			body(arg);
+			self->running--;
+		});
+		return 0;
+	}
+};
+} // namespace
+
+TEST_CASE("zerocopy sends", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.zerocopy_send_min_bytes = 16384;
+	const uint32_t channels = 512, n = 64;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("zerocopy", "test", channels, 100., cft_float32, "zerocopy"), 0,
+		512000, false, std::make_shared<const lsl::stream_config>(config));
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+
+	// chunks above the threshold (the kernel copies them on loopback, but still reports the
+	// completions), with the samples' memory released once they have been reported
+	std::vector<float> values(channels * n), pulled(channels);
+	for (int chunk = 0; chunk < 3; ++chunk) {
+		for (std::size_t i = 0; i < values.size(); ++i)
+			values[i] = static_cast<float>(chunk * values.size() + i);
+		outlet.push_chunk_multiplexed(values.data(), values.size(), lsl::lsl_clock());
+		for (uint32_t s = 0; s < n; ++s) {
+			REQUIRE(in.pull_sample(pulled, 2.0) != 0.0);
+			CHECK(pulled.front() == values[s * channels]);
+			CHECK(pulled.back() == values[s * channels + channels - 1]);
+		}
+		// the stream is idle now, so no further chunk makes the session reap the completions
+		for (int i = 0; i < 100 && outlet.zerocopy_chunks(); ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		CHECK(outlet.zerocopy_chunks() == 0);
+	}
+}
+
+TEST_CASE("parked idle sessions", "[network][basic]") {
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.park_idle_seconds = 0.2;
+	parking_threads transfers;
+	lsl::set_thread_starter(&parking_threads::start, &transfers);
+	{
+		lsl::stream_outlet_impl outlet(lsl::stream_info_impl("parking", "test", 1,
+										   lsl::IRREGULAR_RATE, cft_float32, "parking"),
+			0, 512000, false, std::make_shared<const lsl::stream_config>(config));
+		lsl::stream_info_impl info(outlet.info());
+		info.v4address("127.0.0.1");
+		lsl::stream_inlet_impl in(info);
+		in.open_stream(2.0);
+
+		std::vector<float> values(1);
+		for (float v = 1.f; v <= 3.f; ++v) {
+			outlet.push_sample(std::vector<float>{v});
+			REQUIRE(in.pull_sample(values, 2.0) != 0.0);
+			CHECK(values[0] == v);
+			// the session's transfer thread parks, and the IO thread sends the next samples
+			std::this_thread::sleep_for(std::chrono::milliseconds(400));
+			CHECK(transfers.running == 0);
+		}
+		for (float v = 4.f; v <= 100.f; ++v) outlet.push_sample(std::vector<float>{v});
+		for (float v = 4.f; v <= 100.f; ++v) {
+			REQUIRE(in.pull_sample(values, 2.0) != 0.0);
+			CHECK(values[0] == v);
+		}
+	}
+	lsl::set_thread_starter(nullptr, nullptr);
+	std::lock_guard<std::mutex> lock(transfers.mut);
+	// the session had a transfer thread before it parked
+	CHECK(transfers.threads.size() == 1);
+	for (auto &thread : transfers.threads) thread.join();
+}
+
+TEST_CASE("metadata patches", "[network][basic]") {
+	lsl::stream_info_impl outinfo("metapatch", "test", 1, lsl::IRREGULAR_RATE, cft_float32,
+		"metapatch");
+	outinfo.desc().append_child("montage").append_child(pugi::node_pcdata).set_value(
+		std::string(10000, 'm').c_str());
+	outinfo.desc().append_child("impedances").append_child(pugi::node_pcdata).set_value("5");
+	lsl::stream_outlet_impl outlet(outinfo, 0, 512000);
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	const auto before = in.info(2.0);
+	const auto info_bytes = [&in]() {
+		lsl_inlet_stats stats{};
+		in.get_stats(stats);
+		return stats.memory_metadata;
+	};
+	const auto fetched = info_bytes();
+	CHECK(before->matches_query("desc/impedances='5'"));
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+
+	// the connected inlet gets the changed child over the data connection
+	lsl::stream_info_impl update(outinfo);
+	update.desc().child("impedances").text().set("12");
+	CHECK(outlet.update_desc(update) == 1);
+	auto after = in.info(2.0);
+	for (int k = 0; k < 100 && !after->matches_query("desc/impedances='12'"); ++k) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		after = in.info(2.0);
+	}
+	CHECK(after->matches_query("desc/impedances='12'"));
+	CHECK(after->desc().child("montage").text().get() == std::string(10000, 'm'));
+	// the info wasn't downloaded again (it would be a byte larger), and the info returned
+	// before stays unchanged
+	CHECK(info_bytes() == fetched);
+	CHECK(before->matches_query("desc/impedances='5'"));
+
+	// the samples still arrive in between
+	outlet.push_sample(std::vector<float>{1.f});
+	std::vector<float> values(1);
+	CHECK(in.pull_sample(values, 2.0) != 0.0);
+	CHECK(values[0] == 1.f);
+}
+
+TEST_CASE("gaps in pulled chunks", "[network][basic]") {
+	const int32_t nsamples = 300;
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("gaps", "test", 1, 100., cft_int32, "gaps"), 0, 512000);
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	// the buffers (of the outlet and the inlet) hold 1s, i.e. 100 samples
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.gap_detection = true;
+	lsl::stream_inlet_impl in(
+		info, 1, 0, true, {}, 1, std::make_shared<const lsl::stream_config>(config));
+	in.open_stream(2.0);
+
+	int32_t value = 0;
+	uint64_t seq = 0;
+	lsl_chunk_gaps gaps{1, 1};
+	outlet.push_sample(std::vector<int32_t>{0}, 1000.);
+	REQUIRE(in.pull_chunk_seq(&value, nullptr, &seq, 1, &gaps, 5.) == 1);
+	CHECK(seq != 0);
+	CHECK(gaps.dropped == 0);
+	CHECK(gaps.lost == 0);
+
+	// the oldest samples are dropped by the outlet or the inlet, the others arrive in order
+	for (int32_t k = 1; k <= nsamples; ++k) outlet.push_sample(std::vector<int32_t>{k}, 1000. + k);
+	std::vector<int32_t> data(nsamples);
+	std::vector<double> ts(nsamples);
+	std::vector<uint64_t> seqs(nsamples);
+	uint64_t pulled = 0, dropped = 0, lost = 0;
+	for (int i = 0; i < 100 && value < nsamples; ++i) {
+		const uint32_t n =
+			in.pull_chunk_seq(data.data(), ts.data(), seqs.data(), nsamples, &gaps, 0.1);
+		for (uint32_t k = 0; k < n; ++k) {
+			CHECK(data[k] > value);
+			CHECK(seqs[k] - seq == static_cast<uint64_t>(data[k] - value));
+			CHECK(ts[k] == 1000. + data[k]);
+			value = data[k];
+			seq = seqs[k];
+		}
+		pulled += n;
+		dropped += gaps.dropped;
+		lost += gaps.lost;
+	}
+	CHECK(value == nsamples);
+	CHECK(pulled < static_cast<uint64_t>(nsamples));
+	CHECK(pulled + dropped + lost == static_cast<uint64_t>(nsamples));
+}
+
+/// Forwards the TCP connections to a local port, so they can be broken off.
+class tcp_proxy {
+public:
+	/// A function that changes the header of the server's responses.
+	using rewriter = std::function<std::string(const std::string &)>;
+
+	explicit tcp_proxy(uint16_t target, rewriter rewrite = nullptr)
+		: acceptor_(io_, ip::tcp::endpoint(ip::address_v4::loopback(), 0)), target_(target),
+		  rewrite_(std::move(rewrite)) {
+		accept();
+		thread_ = std::thread([this]() { io_.run(); });
+	}
+	~tcp_proxy() {
+		io_.stop();
+		thread_.join();
+	}
+	uint16_t port() const { return acceptor_.local_endpoint().port(); }
+
+	/// Don't pass on that one end closed a connection, so the other one only learns it from
+	/// what was sent before.
+	void keep_open() { keep_open_ = true; }
+
+	/// Stop passing on data, but keep the connections open.
+	void mute() { muted_ = true; }
+
+	/// Close the connections that are currently forwarded (new ones are still accepted).
+	void drop() {
+		std::promise<void> dropped;
+		asio::post(io_, [this, &dropped]() {
+			for (auto &sock : sockets_) {
+				lslboost::system::error_code ec;
+				sock->close(ec);
+			}
+			sockets_.clear();
+			dropped.set_value();
+		});
+		dropped.get_future().wait();
+	}
+
+
+private:
+	using socket_p = std::shared_ptr<ip::tcp::socket>;
+
+	void accept() {
+		auto client = std::make_shared<ip::tcp::socket>(io_);
+		acceptor_.async_accept(*client, [this, client](err_t err) {
+			if (err) return;
+			auto server = std::make_shared<ip::tcp::socket>(io_);
+			lslboost::system::error_code ec;
+			server->connect(ip::tcp::endpoint(ip::address_v4::loopback(), target_), ec);
+			if (!ec) {
+				sockets_.push_back(client);
+				sockets_.push_back(server);
+				forward(client, server);
+				if (rewrite_)
+					forward_header(server, client);
+				else
+					forward(server, client);
+			}
+			accept();
+		});
+	}
+
+	void forward(const socket_p &from, const socket_p &to) {
+		auto buf = std::make_shared<std::array<char, 4096>>();
+		from->async_read_some(asio::buffer(*buf), [this, from, to, buf](err_t err, std::size_t n) {
+			if (err) {
+				lslboost::system::error_code ec;
+				if (!keep_open_) to->close(ec);
+				return;
+			}
+			if (muted_) return forward(from, to);
+			asio::async_write(*to, asio::buffer(*buf, n),
+				[this, from, to, buf](err_t err, std::size_t) {
+					if (!err) forward(from, to);
+				});
+		});
+	}
+
+	void forward_header(const socket_p &from, const socket_p &to) {
+		auto buf = std::make_shared<asio::streambuf>();
+		asio::async_read_until(*from, *buf, "\r\n\r\n",
+			[this, from, to, buf](err_t err, std::size_t n) {
+				// the header is passed on changed, the data after it as it is
+				std::string data(asio::buffers_begin(buf->data()), asio::buffers_end(buf->data()));
+				auto out = std::make_shared<std::string>(
+					err ? data : rewrite_(data.substr(0, n)) + data.substr(n));
+				asio::async_write(*to, asio::buffer(*out),
+					[this, from, to, out, closed = bool(err)](err_t err, std::size_t) {
+						if (!err && !closed) return forward(from, to);
+						lslboost::system::error_code ec;
+						to->close(ec);
+					});
+			});
+	}
+
+	io_context io_;
+	ip::tcp::acceptor acceptor_;
+	uint16_t target_;
+	rewriter rewrite_;
+	std::vector<socket_p> sockets_;
+	std::atomic<bool> keep_open_{false}, muted_{false};
+	std::thread thread_;
+};
+
+TEST_CASE("heartbeats and end of stream", "[network][basic]") {
+	auto outlet = std::make_unique<lsl::stream_outlet_impl>(
+		lsl::stream_info_impl(
+			"heartbeats", "test", 1, lsl::IRREGULAR_RATE, cft_float32, "heartbeats"),
+		0, 512000);
+	// the proxy doesn't pass on that the outlet closed the connection
+	tcp_proxy proxy(outlet->info().v4data_port());
+	proxy.keep_open();
+	lsl::stream_info_impl info(outlet->info());
+	info.v4address("127.0.0.1");
+	info.v4data_port(proxy.port());
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.heartbeat_interval = 0.5;
+	lsl::stream_inlet_impl in(
+		info, 360, 0, false, {}, 1, std::make_shared<const lsl::stream_config>(config));
+	in.open_stream(2.0);
+	REQUIRE(outlet->wait_for_consumers(2.0));
+	const auto bytes_received = [&in]() {
+		lsl_inlet_stats stats{};
+		in.get_stats(stats);
+		return stats.bytes_received;
+	};
+
+	// the idle connection stays alive with heartbeats
+	const uint64_t before = bytes_received();
+	std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+	CHECK(bytes_received() >= before + 2 * lsl::frame_header_bytes);
+	outlet->push_sample(std::vector<float>{1.f});
+	std::vector<float> values(1);
+	CHECK(in.pull_sample(values, 2.0) != 0.0);
+	CHECK(values[0] == 1.f);
+
+	// the inlet learns from the end-of-stream frame that the outlet is gone, long before it
+	// would miss the heartbeats
+	outlet.reset();
+	const double start = lsl::lsl_clock();
+	CHECK_THROWS_AS(in.pull_sample(values, 5.0), lsl::lost_error);
+	CHECK(lsl::lsl_clock() - start < 0.75);
+}
+
+TEST_CASE("missed heartbeats", "[network][basic]") {
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("missedbeats", "test", 1, lsl::IRREGULAR_RATE, cft_float32,
+			"missedbeats"),
+		0, 512000);
+	tcp_proxy proxy(outlet.info().v4data_port());
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	info.v4data_port(proxy.port());
+	lsl::stream_config config(*lsl::api_config::get_instance());
+	config.heartbeat_interval = 0.1;
+	lsl::stream_inlet_impl in(
+		info, 360, 0, false, {}, 1, std::make_shared<const lsl::stream_config>(config));
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+	outlet.push_sample(std::vector<float>{1.f});
+	std::vector<float> values(1);
+	REQUIRE(in.pull_sample(values, 2.0) != 0.0);
+
+	// the connection stays open, but nothing arrives anymore
+	proxy.mute();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(outlet.have_consumers());
+	const double start = lsl::lsl_clock();
+	CHECK_THROWS_AS(in.pull_sample(values, 5.0), lsl::lost_error);
+	CHECK(lsl::lsl_clock() - start < 2.0);
+}
+
+TEST_CASE("resume after reconnects", "[network][basic]") {
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("resume", "test", 1, 100., cft_int32, "resume"), 0, 512000);
+	outlet.set_history(10.0, 1000);
+	tcp_proxy proxy(outlet.info().v4data_port());
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	info.v4data_port(proxy.port());
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+
+	int32_t value = -1;
+	for (int32_t i = 0; i < 50; ++i) outlet.push_sample(&i);
+	for (int32_t i = 0; i < 50; ++i) {
+		REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+		CHECK(value == i);
+	}
+	// the samples pushed while the inlet reconnects are replayed from the history
+	proxy.drop();
+	for (int32_t i = 50; i < 150; ++i) outlet.push_sample(&i);
+	for (int32_t i = 50; i < 150; ++i) {
+		REQUIRE(in.pull_sample(&value, 1, 10.0) != 0.0);
+		CHECK(value == i);
+	}
+	lsl_inlet_stats stats{};
+	in.get_stats(stats);
+	CHECK(stats.reconnects == 1);
+	CHECK(stats.samples_dropped == 0);
+
+	// a sample that's pushed into another outlet keeps the sequence number it was sent with
+	lsl::stream_outlet_impl mirror(
+		lsl::stream_info_impl("mirror", "test", 1, 100., cft_int32, "mirror"), 0, 512000);
+	mirror.set_history(10.0, 1000);
+	lsl::sample_p samp(outlet.sample_factory()->new_sample(lsl::lsl_clock(), true));
+	value = 150;
+	samp->assign_untyped(&value);
+	outlet.push_samples(&samp, 1);
+	const uint64_t seq = samp->seq;
+	CHECK(seq == 151);
+	mirror.push_samples(&samp, 1);
+	CHECK(samp->seq == seq);
+	REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 150);
+}
+
+TEST_CASE("gaps behind buffered samples", "[network][basic]") {
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("gapsbehind", "test", 1, 100., cft_int32, "gapsbehind"), 0, 512000);
+	// samples pushed while the inlet reconnects are only partly replayed
+	outlet.set_history(10.0, 5);
+	tcp_proxy proxy(outlet.info().v4data_port());
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	info.v4data_port(proxy.port());
+	lsl::stream_inlet_impl in(info);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+	const auto wait_for = [&in](std::size_t n) {
+		for (int k = 0; k < 200 && in.samples_available() < n; ++k)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return in.samples_available();
+	};
+
+	for (int32_t i = 0; i < 10; ++i) outlet.push_sample(&i);
+	REQUIRE(wait_for(10) == 10);
+	// (the inlet takes longer to reconnect than the samples take to push)
+	proxy.drop();
+	for (int32_t i = 10; i < 30; ++i) outlet.push_sample(&i);
+	REQUIRE(outlet.wait_for_consumers(5.0));
+	REQUIRE(wait_for(15) == 15);
+
+	// the 15 samples lost after the first ten are only reported with the samples after them
+	int32_t values[4], last = -1;
+	uint64_t seqs[4], seq = 0, jumps = 0, lost = 0;
+	lsl_chunk_gaps gaps{0, 0};
+	for (uint32_t pulled = 0; pulled < 15;) {
+		const uint32_t n = in.pull_chunk_seq(values, nullptr, seqs, 4, &gaps, 1.0);
+		REQUIRE(n > 0);
+		for (uint32_t k = 0; k < n; ++k) {
+			if (seq) jumps += seqs[k] - seq - 1;
+			seq = seqs[k];
+			last = values[k];
+		}
+		lost += gaps.lost;
+		CHECK(gaps.dropped == 0);
+		CHECK(lost <= jumps);
+		pulled += n;
+	}
+	CHECK(last == 29);
+	CHECK(jumps == 15);
+	CHECK(lost == 15);
+}
+
+TEST_CASE("relays with the source's identity", "[network][basic]") {
+	auto source = std::make_unique<lsl::stream_outlet_impl>(
+		lsl::stream_info_impl("relayed", "test", 1, 100., cft_int32, "relayed"), 0, 512000);
+	const lsl::stream_info_impl published(source->info());
+	const std::string uid = published.uid();
+	auto relay = std::make_unique<lsl::stream_outlet_impl>(published, 0, 512000, true);
+	REQUIRE(relay->info().uid() == uid);
+	lsl::stream_info_impl info(published);
+	info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(info);
+	in.set_in_process(true);
+	in.open_stream(2.0);
+
+	// the inlets of this process are fed by the outlet that was there first, also after the
+	// other one is gone
+	CHECK(lsl::local_feed::find(uid).factory == source->sample_factory());
+	relay.reset();
+	CHECK(lsl::local_feed::find(uid).factory == source->sample_factory());
+	// give the inlet the chance to find the source gone
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	int32_t value = 5;
+	source->push_sample(&value);
+	value = 0;
+	REQUIRE(in.pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 5);
+	lsl_inlet_stats stats{};
+	in.get_stats(stats);
+	// nothing went through a socket
+	CHECK(stats.bytes_received == 0);
+
+	// and the other way around
+	relay = std::make_unique<lsl::stream_outlet_impl>(published, 0, 512000, true);
+	source.reset();
+	CHECK(lsl::local_feed::find(uid).factory == relay->sample_factory());
+	relay.reset();
+	CHECK(!lsl::local_feed::find(uid).buffer);
+}
+
+TEST_CASE("bundled inlets", "[network][basic]") {
+	lsl::stream_outlet_impl out_a(lsl::stream_info_impl("bundleinleta", "test", 1,
+									  lsl::IRREGULAR_RATE, cft_float32, "bundleinleta"),
+		0, 512000);
+	lsl::stream_outlet_impl out_b(lsl::stream_info_impl("bundleinletb", "test", 1,
+									  lsl::IRREGULAR_RATE, cft_float32, "bundleinletb"),
+		0, 512000);
+	std::vector<std::unique_ptr<lsl::stream_inlet_impl>> inlets;
+	for (auto *outlet : {&out_a, &out_b}) {
+		lsl::stream_info_impl info(outlet->info());
+		info.v4address("127.0.0.1");
+		inlets.emplace_back(new lsl::stream_inlet_impl(info));
+		inlets.back()->set_bundling(true);
+		inlets.back()->open_stream(2.0);
+	}
+	float value = 1.f;
+	out_a.push_sample(&value);
+	value = 2.f;
+	out_b.push_sample(&value);
+	REQUIRE(inlets[0]->pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 1.f);
+	REQUIRE(inlets[1]->pull_sample(&value, 1, 2.0) != 0.0);
+	CHECK(value == 2.f);
+
+	// both streams are served by the one bundled connection to this host, and not by the outlets'
+	// own feeds
+	const auto &info = out_a.info();
+	const ip::tcp::endpoint endpoint(ip::address_v4::loopback(), info.v4data_port());
+	CHECK(lsl::bundle_client::get(info.hostname(), endpoint, info.uid())->size() == 2);
+	for (auto *outlet : {&out_a, &out_b}) {
+		lsl_outlet_stats stats{};
+		outlet->get_stats(stats);
+		CHECK(stats.samples_sent == 0);
+	}
+}
+
+// needs [tuning] InletDecodeThreads, run by ctest with lslcfgs/decodethreads.cfg
+TEST_CASE("bundled inlets decoded by the pool", "[network][.decodethreads]") {
+	const auto pool = lsl::task_pool::inlet_pool();
+	REQUIRE(pool);
+	const int n = 50;
+	std::vector<std::unique_ptr<lsl::stream_outlet_impl>> outlets;
+	std::vector<std::unique_ptr<lsl::stream_inlet_impl>> inlets;
+	std::mutex mut;
+	std::vector<std::vector<float>> received(2);
+	std::set<std::string> threads;
+	for (int k = 0; k < 2; ++k) {
+		const std::string name = "pooledbundle" + std::to_string(k);
+		outlets.emplace_back(new lsl::stream_outlet_impl(
+			lsl::stream_info_impl(name, "test", 1, lsl::IRREGULAR_RATE, cft_float32, name), 0,
+			512000));
+		lsl::stream_info_impl info(outlets.back()->info());
+		info.v4address("127.0.0.1");
+		inlets.emplace_back(new lsl::stream_inlet_impl(info));
+		inlets.back()->set_bundling(true);
+		inlets.back()->set_chunk_callback([&, k](lsl::sample_view &view) {
+			char thread[32];
+			loguru::get_thread_name(thread, sizeof(thread), false);
+			std::lock_guard<std::mutex> lock(mut);
+			threads.insert(thread);
+			for (const auto &smp : view.samples) {
+				float value;
+				smp->retrieve_typed(&value);
+				received[k].push_back(value);
+			}
+		});
+		inlets.back()->open_stream(2.0);
+	}
+	for (int i = 0; i < n; ++i)
+		for (int k = 0; k < 2; ++k) {
+			const float value = static_cast<float>(k * n + i);
+			outlets[k]->push_sample(&value);
+		}
+	for (int attempt = 0; attempt < 100; ++attempt) {
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			if (received[0].size() == n && received[1].size() == n) break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	for (auto &inlet : inlets) inlet->set_chunk_callback(nullptr);
+	std::lock_guard<std::mutex> lock(mut);
+	for (int k = 0; k < 2; ++k) {
+		REQUIRE(received[k].size() == n);
+		for (int i = 0; i < n; ++i) CHECK(received[k][i] == static_cast<float>(k * n + i));
+	}
+	// the frames were decoded and delivered by the pool's threads, not the connection's
+	REQUIRE(!threads.empty());
+	for (const auto &thread : threads) CHECK(thread.compare(0, 4, "DEC_") == 0);
+}
+
+// needs [tuning] InletIOThreads, run by ctest with lslcfgs/inletiothreads.cfg (along with the
+// other network tests)
+TEST_CASE("inlets sharing the IO pool", "[network][.inletiothreads]") {
+	const auto pool = lsl::io_context_pool::inlet_pool();
+	REQUIRE(pool);
+	CHECK(pool->size() == 2);
+	// more inlets than threads, each with its time probes and data
+	const int n = 5;
+	std::vector<std::unique_ptr<lsl::stream_outlet_impl>> outlets;
+	std::vector<std::unique_ptr<lsl::stream_inlet_impl>> inlets;
+	for (int k = 0; k < n; ++k) {
+		const std::string name = "inletpool" + std::to_string(k);
+		outlets.emplace_back(new lsl::stream_outlet_impl(
+			lsl::stream_info_impl(name, "test", 1, 100., cft_float32, name), 0, 512000));
+		lsl::stream_info_impl info(outlets.back()->info());
+		info.v4address("127.0.0.1");
+		inlets.emplace_back(new lsl::stream_inlet_impl(info));
+		inlets.back()->open_stream(2.0);
+		REQUIRE(outlets.back()->wait_for_consumers(2.0));
+	}
+	for (int k = 0; k < n; ++k) {
+		// both ends are on this host, so the offset is about 0
+		double remote_time = 0.0, uncertainty = 0.0;
+		CHECK(std::fabs(inlets[k]->time_correction(&remote_time, &uncertainty, 5.0)) < 0.001);
+		CHECK(uncertainty < 0.001);
+		const float value = static_cast<float>(k);
+		outlets[k]->push_sample(&value, 1000. + k);
+	}
+	for (int k = 0; k < n; ++k) {
+		std::vector<float> received(1);
+		CHECK(inlets[k]->pull_sample(received, 2.0) == 1000. + k);
+		CHECK(received[0] == static_cast<float>(k));
+	}
+	// the pool stays shared by all of them
+	CHECK(lsl::io_context_pool::inlet_pool() == pool);
+}
+
+TEST_CASE("bundled connections outlive the accepting outlet", "[network][basic]") {
+	auto accepting = std::make_unique<lsl::stream_outlet_impl>(
+		lsl::stream_info_impl(
+			"bundleaccept", "test", 1, lsl::IRREGULAR_RATE, cft_float32, "bundleaccept"),
+		0, 512000);
+	lsl::stream_outlet_impl served(
+		lsl::stream_info_impl(
+			"bundleserved", "test", 1, lsl::IRREGULAR_RATE, cft_float32, "bundleserved"),
+		0, 512000);
+	io_context io_ctx;
+	ip::tcp::socket sock(io_ctx);
+	sock.connect(ip::tcp::endpoint(ip::address_v4::loopback(), accepting->info().v4data_port()));
+	const auto add = [&](const std::string &id) {
+		return "add " + id + ' ' + served.info().uid() + " 360 0 0 drop-oldest 0\r\n";
+	};
+	// the malformed requests are ignored, and don't close the connection
+	asio::write(sock, asio::buffer("LSL:bundle/110\r\n" + add("99999999999") + add("-1") +
+								   add("one") + add("1")));
+	asio::streambuf replies;
+	replies.consume(asio::read_until(sock, replies, "\r\n\r\n"));
+	std::istream reply_stream(&replies);
+	// the next reply to an add, after the heartbeats: its id and whether the stream is served
+	const auto next_added = [&]() {
+		while (true) {
+			char header[5];
+			if (replies.size() < sizeof(header))
+				asio::read(sock, replies, asio::transfer_at_least(sizeof(header) - replies.size()));
+			reply_stream.read(header, sizeof(header));
+			if (header[0] == lsl::bundle_heartbeat) continue;
+			REQUIRE(header[0] == lsl::bundle_added);
+			uint32_t id;
+			memcpy(&id, header + 1, sizeof(id));
+			char reply[6];
+			if (replies.size() < sizeof(reply))
+				asio::read(sock, replies, asio::transfer_at_least(sizeof(reply) - replies.size()));
+			reply_stream.read(reply, sizeof(reply));
+			return std::make_pair(lslboost::endian::little_to_native(id), reply[0] != 0);
+		}
+	};
+	CHECK(next_added() == std::make_pair(1u, true));
+
+	// the outlet that accepted the connection doesn't take it along
+	accepting.reset();
+	asio::write(sock, asio::buffer(add("2")));
+	CHECK(next_added() == std::make_pair(2u, true));
+}
+
+/// An outlet that multicasts its samples and an inlet whose multicast feed is redirected to a UDP
+/// port on the loopback interface, so the test decides which datagrams arrive.
+class multicast_redirect {
+public:
+	explicit multicast_redirect(const std::string &name)
+		: outlet(lsl::stream_info_impl(name, "test", 1, 100., cft_int32, name), 0, 512000),
+		  sock_(io_, ip::udp::v4()), port_(free_port()),
+		  key_(std::hash<std::string>()(outlet.info().uid())) {
+		outlet.set_history(10.0, 1000);
+		outlet.set_multicast(true);
+		proxy_.reset(new tcp_proxy(outlet.info().v4data_port(),
+			[this](const std::string &header) { return redirect(header); }));
+		lsl::stream_info_impl info(outlet.info());
+		info.v4address("127.0.0.1");
+		info.v4data_port(proxy_->port());
+		inlet.reset(new lsl::stream_inlet_impl(info));
+		inlet->set_multicast(true);
+	}
+	~multicast_redirect() { inlet.reset(); }
+
+	/// Send the samples first to last in a datagram, with the values pushed for them (seq - 1)
+	/// and the time stamp `datagram_time + seq`.
+	void send(uint64_t first, uint64_t last) {
+		asio::streambuf datagram;
+		put(datagram, key_);
+		put(datagram, last);
+		put(datagram, static_cast<uint16_t>(last - first + 1));
+		for (uint64_t seq = first; seq <= last; ++seq) {
+			const int32_t value = static_cast<int32_t>(seq - 1);
+			lsl::sample_p samp(outlet.sample_factory()->new_sample(datagram_time + seq, false));
+			samp->assign_untyped(&value);
+			put(datagram, seq);
+			samp->save_streambuf(datagram, 110, BOOST_BYTE_ORDER, &scratch_);
+		}
+		sock_.send_to(datagram.data(), ip::udp::endpoint(ip::address_v4::loopback(), port_));
+	}
+
+	lsl::stream_outlet_impl outlet;
+	std::unique_ptr<lsl::stream_inlet_impl> inlet;
+	/// whether the outlet offered the inlet the multicast feed
+	std::atomic<bool> redirected{false};
+	/// the time stamps of the samples sent by send() start after this
+	static constexpr double datagram_time = 1e6;
+
+private:
+	/// Replace the group and port of the multicast feed in a feed header by the test's port.
+	std::string redirect(const std::string &header) {
+		// Multicast-Data: [group] [port] [key] [start]
+		const auto pos = header.find("Multicast-Data: ");
+		if (pos == std::string::npos) return header;
+		const auto end = header.find("\r\n", pos);
+		std::istringstream feed(header.substr(pos + 16, end - pos - 16));
+		std::string group, port, rest;
+		feed >> group >> port;
+		std::getline(feed, rest);
+		redirected = true;
+		return header.substr(0, pos) + "Multicast-Data: 127.0.0.1 " + std::to_string(port_) + rest +
+			   header.substr(end);
+	}
+
+	/// A UDP port that's free (again) on the loopback interface.
+	uint16_t free_port() {
+		ip::udp::socket probe(io_, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+		return probe.local_endpoint().port();
+	}
+
+	template <typename T> static void put(std::streambuf &sb, T value) {
+		lslboost::endian::native_to_little_inplace(value);
+		sb.sputn(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+
+	io_context io_;
+	ip::udp::socket sock_;
+	const uint16_t port_;
+	const uint64_t key_;
+	int32_t scratch_{0};
+	std::unique_ptr<tcp_proxy> proxy_;
+};
+
+TEST_CASE("multicast repairs", "[network][multicast]") {
+	multicast_redirect redirect("mcastrepair");
+	// the samples pushed before the inlet subscribes aren't part of its feed
+	for (int32_t i = 0; i < 5; ++i) redirect.outlet.push_sample(&i);
+	redirect.inlet->open_stream(2.0);
+	REQUIRE(redirect.redirected);
+	for (int32_t i = 5; i < 35; ++i) redirect.outlet.push_sample(&i);
+
+	// the datagrams with the samples 6-7 (the first ones of the feed) and 16-25 are dropped, so
+	// the inlet requests them from the outlet's history
+	redirect.send(8, 15);
+	redirect.send(26, 35);
+	int32_t value = -1;
+	for (int32_t i = 5; i < 35; ++i) {
+		const double timestamp = redirect.inlet->pull_sample(&value, 1, 2.0);
+		REQUIRE(timestamp != 0.0);
+		CHECK(value == i);
+		// the repaired samples have the time stamps they were pushed with
+		const uint64_t seq = i + 1;
+		const bool repaired = seq < 8 || (seq > 15 && seq < 26);
+		CHECK((timestamp == multicast_redirect::datagram_time + seq) == !repaired);
+	}
+	lsl_inlet_stats stats{};
+	redirect.inlet->get_stats(stats);
+	CHECK(stats.samples_lost == 0);
+	CHECK(stats.reconnects == 0);
+}
+
+TEST_CASE("multicast fallback", "[network][multicast]") {
+	multicast_redirect redirect("mcastfallback");
+	redirect.inlet->open_stream(2.0);
+	REQUIRE(redirect.redirected);
+	// no datagram arrives: the inlet receives the samples over TCP from the first one on, although
+	// it never saw a sequence number
+	for (int32_t i = 0; i < 10; ++i) redirect.outlet.push_sample(&i);
+	int32_t value = -1;
+	for (int32_t i = 0; i < 10; ++i) {
+		REQUIRE(redirect.inlet->pull_sample(&value, 1, 10.0) != 0.0);
+		CHECK(value == i);
+	}
+	lsl_inlet_stats stats{};
+	redirect.inlet->get_stats(stats);
+	CHECK(stats.samples_lost == 0);
+}
+
+TEST_CASE("discovery cache", "[network][basic]") {
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("cached", "test", 1, lsl::IRREGULAR_RATE, cft_float32, "cached"), 0,
+		360);
+	lsl::discovery_cache cache(5.0);
+	const std::string query = "name='cached' and source_id='cached'";
+	std::vector<lsl::stream_info_impl> result;
+	// a resolve that searches for at least a second could find more than the cache knows yet
+	CHECK(!cache.lookup(query, 1, 5.0, 1.0, result));
+
+	// afterwards, the cache answers right away
+	bool found = false;
+	for (int k = 0; k < 50 && !found; ++k) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		found = cache.lookup(query, 1, 5.0, 1.0, result);
+	}
+	REQUIRE(found);
+	REQUIRE(result.size() == 1);
+	CHECK(result[0].uid() == outlet.info().uid());
+	const double start = lsl::lsl_clock();
+	for (int k = 0; k < 100; ++k) REQUIRE(cache.lookup(query, 1, 5.0, 1.0, result));
+	CHECK(lsl::lsl_clock() - start < 0.5);
+	// more streams than the cache knows can't be looked up
+	CHECK(!cache.lookup(query, 2, 5.0, 1.0, result));
+}
+
+TEST_CASE("remembered responders", "[network][basic]") {
+	const auto endpoint = [](std::size_t k) {
+		return ip::udp::endpoint(ip::address_v4(static_cast<uint32_t>(0x7f010000 + k)), 16572);
+	};
+	for (std::size_t k = 0; k < lsl::max_remembered_responders; ++k) {
+		lsl::remember_responder(endpoint(k));
+		// the first endpoint keeps responding
+		if (k == lsl::max_remembered_responders / 2) lsl::remember_responder(endpoint(0));
+	}
+	CHECK(lsl::ever_responded(endpoint(1)));
+	// the endpoint that's been silent the longest makes room for a new one
+	lsl::remember_responder(endpoint(lsl::max_remembered_responders));
+	CHECK(lsl::ever_responded(endpoint(0)));
+	CHECK(!lsl::ever_responded(endpoint(1)));
+	CHECK(lsl::ever_responded(endpoint(2)));
+	CHECK(lsl::ever_responded(endpoint(lsl::max_remembered_responders)));
+}
+
+TEST_CASE("token bucket", "[network][basic]") {
+	CHECK(lsl::token_bucket().take(1 << 30) == 0.0);
+
+	// a burst of 50 ms of the rate is sent right away, the rest waits until it's paid back
+	lsl::token_bucket bucket(10000.0);
+	CHECK(bucket.take(500) == 0.0);
+	const double delay = bucket.take(1000);
+	CHECK(delay > 0.09);
+	CHECK(delay <= 0.1);
+	std::this_thread::sleep_for(std::chrono::duration<double>(delay + 0.05));
+	CHECK(bucket.take(100) == 0.0);
+}
+
+TEST_CASE("rdma addresses", "[network][basic]") {
+	lsl::rdma_address address;
+	address.lid = 7;
+	address.gid = "fe800000000000000002c9fffe123456";
+	address.qpn = 0x1234;
+	address.psn = 0xabcdef;
+	address.addr = 0x7f0012345000;
+	address.rkey = 42;
+	address.slots = 32;
+	address.slot_bytes = 65536;
+	const auto parsed = lsl::rdma_address::parse(address.to_string());
+	CHECK(parsed.lid == address.lid);
+	CHECK(parsed.gid == address.gid);
+	CHECK(parsed.qpn == address.qpn);
+	CHECK(parsed.psn == address.psn);
+	CHECK(parsed.addr == address.addr);
+	CHECK(parsed.rkey == address.rkey);
+	CHECK(parsed.slots == address.slots);
+	CHECK(parsed.slot_bytes == address.slot_bytes);
+	CHECK_THROWS_AS(lsl::rdma_address::parse("7 fe80 1 2 3 4 5 6"), std::invalid_argument);
+	CHECK_THROWS_AS(lsl::rdma_address::parse("7"), std::invalid_argument);
+	// without a device, the inlets and outlets stay with TCP
+	if (!lsl::rdma_available()) CHECK_THROWS(lsl::rdma_endpoint(4, 1024));
+}
+
+TEST_CASE("rdma credits", "[network][basic]") {
+	if (!lsl::rdma_available()) {
+		WARN("No RDMA device (e.g. Soft-RoCE on the loopback interface)");
+		return;
+	}
+	lsl::rdma_endpoint inlet(4, 1024), outlet(4, 1024);
+	REQUIRE(inlet.credits() == 2);
+	inlet.post_receives();
+	outlet.connect(inlet.local());
+	inlet.connect(outlet.local());
+	auto send = [&outlet](char value) {
+		char *slot = outlet.send_slot(1.0);
+		if (slot) {
+			*slot = value;
+			outlet.post_send(1);
+		}
+		return slot != nullptr;
+	};
+	// two writes consume the credits, two more wait for the inlet in the device
+	for (char k = 0; k < 4; ++k) REQUIRE(send(k));
+	CHECK(outlet.send_slot(0.2) == nullptr);
+
+	// decoding a slot replenishes a credit
+	asio::streambuf received;
+	REQUIRE(inlet.receive(received, 1.0) == 1);
+	REQUIRE(send(4));
+	CHECK(outlet.send_slot(0.2) == nullptr);
+
+	// none of the waiting writes overwrote a slot before it was decoded
+	for (int k = 0; k < 4; ++k) REQUIRE(inlet.receive(received, 1.0) == 1);
+	CHECK(inlet.receive(received, 0.1) == 0);
+	CHECK(std::vector<char>(asio::buffers_begin(received.data()),
+			  asio::buffers_end(received.data())) == std::vector<char>{0, 1, 2, 3, 4});
+	REQUIRE(send(5));
+}
+
+TEST_CASE("shm rings", "[network][basic]") {
+	if (!lsl::shm_available()) {
+		CHECK_THROWS(lsl::shm_ring(2, 64));
+		WARN("No POSIX shared memory");
+		return;
+	}
+	lsl::shm_ring outlet(2, 64);
+	lsl::shm_ring inlet(outlet.name());
+	// the inlet removed the name, so nobody else can open the ring
+	CHECK(inlet.name().empty());
+	CHECK_THROWS(lsl::shm_ring(outlet.name()));
+	REQUIRE(outlet.slot_capacity() == inlet.slot_capacity());
+
+	std::size_t len = 0;
+	CHECK(inlet.read_slot(len) == nullptr);
+	for (char k = 0; k < 2; ++k) {
+		char *slot = outlet.write_slot(1.0);
+		REQUIRE(slot != nullptr);
+		*slot = k;
+		CHECK_FALSE(outlet.commit(1));
+	}
+	// the full ring waits for the inlet
+	CHECK(outlet.write_slot(0.1) == nullptr);
+	const char *slot = inlet.read_slot(len);
+	REQUIRE(slot != nullptr);
+	CHECK(len == 1);
+	CHECK(*slot == 0);
+	inlet.release();
+	REQUIRE(outlet.write_slot(1.0) != nullptr);
+
+	// there's nothing to wait for while slots are left
+	CHECK_FALSE(inlet.prepare_wait());
+	REQUIRE((slot = inlet.read_slot(len)) != nullptr);
+	CHECK(*slot == 1);
+	inlet.release();
+	// a waiting inlet is woken up by the next slot
+	REQUIRE(inlet.prepare_wait());
+	*outlet.write_slot(1.0) = 2;
+	CHECK(outlet.commit(1));
+	REQUIRE((slot = inlet.read_slot(len)) != nullptr);
+	CHECK(*slot == 2);
+	inlet.release();
+}
+
+TEST_CASE("shared memory feeds", "[network][basic]") {
+	if (!lsl::shm_available()) {
+		WARN("No POSIX shared memory");
+		return;
+	}
+	lsl::stream_outlet_impl outlet(
+		lsl::stream_info_impl("shmfeed", "test", 4, 100., cft_float32, "shmfeed"), 0, 512000);
+	lsl::stream_info_impl info(outlet.info());
+	info.v4address("127.0.0.1");
+	const int n = 5000;
+	lsl::stream_inlet_impl in(info, 2 * n);
+	in.set_shared_memory(true);
+	in.open_stream(2.0);
+	REQUIRE(outlet.wait_for_consumers(2.0));
+
+	// more samples than fit into the ring at once, and samples pushed while the inlet waits
+	std::vector<float> values(4);
+	for (int i = 0; i < n; ++i) {
+		std::fill(values.begin(), values.end(), static_cast<float>(i));
+		outlet.push_sample(values.data(), 1000. + i * .01, i % 100 == 99);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	std::fill(values.begin(), values.end(), static_cast<float>(n));
+	outlet.push_sample(values.data(), 1000. + n * .01);
+	for (int i = 0; i <= n; ++i) {
+		const double ts = in.pull_sample(values, 2.0);
+		REQUIRE(values[3] == static_cast<float>(i));
+		CHECK(ts == Approx(1000. + i * .01).margin(1e-9).epsilon(0));
+	}
+	// none of them went over the data connection
+	lsl_outlet_stats stats;
+	outlet.get_stats(stats);
+	CHECK(stats.samples_sent == 0);
+
+	// string samples can't be passed that way
+	lsl::stream_outlet_impl strings(
+		lsl::stream_info_impl("shmstrings", "test", 1, 0., cft_string, "shmstrings"), 0, 512000);
+	lsl::stream_info_impl string_info(strings.info());
+	string_info.v4address("127.0.0.1");
+	lsl::stream_inlet_impl string_in(string_info);
+	string_in.set_shared_memory(true);
+	string_in.open_stream(2.0);
+	REQUIRE(strings.wait_for_consumers(2.0));
+	const std::string text("over TCP");
+	strings.push_sample(&text);
+	std::string received;
+	string_in.pull_sample(&received, 1, 2.0);
+	CHECK(received == text);
+}
+
+#ifndef _WIN32
+TEST_CASE("host daemon", "[network][basic]") {
+	const std::string path = "/tmp/lsl-test-hostd-" + std::to_string(port++) + ".sock";
+	lsl::host_daemon daemon(path);
+	CHECK_THROWS_AS(lsl::host_daemon(path), std::runtime_error);
+
+	lsl::stream_info_impl info("hostd", "Test", 2, 100., cft_float32, "hostd");
+	info.session_id("default");
+	info.reset_uid();
+	info.created_at(lsl::lsl_clock());
+	info.hostname(asio::ip::host_name());
+	auto factory = std::make_shared<lsl::factory>(cft_float32, 2, 16);
+	auto buffer = std::make_shared<lsl::send_buffer>(1000, factory->sample_size());
+	// a process that doesn't complete its handshake holds up no other
+	asio::io_context io_ctx;
+	asio::local::stream_protocol::socket stalled(io_ctx);
+	stalled.connect(asio::local::stream_protocol::endpoint(path));
+	const double start = lsl::lsl_clock();
+	std::unique_ptr<lsl::host_link> link(new lsl::host_link(path, info, buffer));
+	CHECK(lsl::lsl_clock() - start < 1.0);
+	// the stream is published once
+	CHECK_THROWS_AS(lsl::host_link(path, info, buffer), std::runtime_error);
+	REQUIRE(daemon.num_streams() == 1);
+	lsl::stream_info_impl published = daemon.infos().at(0);
+	CHECK(published.uid() == info.uid());
+	CHECK(published.created_at() == info.created_at());
+
+	published.v4address("127.0.0.1");
+	lsl::stream_inlet_impl in(published);
+	in.open_stream(2.0);
+	for (int k = 0; k < 20; ++k) {
+		const float values[2] = {static_cast<float>(k), static_cast<float>(-k)};
+		lsl::sample_p smp(factory->new_sample(100.0 + k, true));
+		smp->assign_typed(values);
+		buffer->push_sample(smp);
+	}
+	for (int k = 0; k < 20; ++k) {
+		std::vector<float> values(2);
+		REQUIRE(in.pull_sample(values, 2.0) == Approx(100.0 + k));
+		CHECK(values[0] == k);
+		CHECK(values[1] == -k);
+	}
+
+	// the stream ends with the link
+	link.reset();
+	for (int attempt = 0; attempt < 50 && daemon.num_streams(); ++attempt)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(daemon.num_streams() == 0);
+}
+#endif
+
 TEST_CASE("receive v4 packets on v6 socket", "[ipv6][network]") {
 	const uint16_t test_port = port++;
 	asio::io_context io_ctx;
@@ -230,3 +1621,187 @@ TEST_CASE("reuseport", "[network][basic][!mayfail]") {
 		io_ctx.run();
 	}
 }
+
+TEST_CASE("io_context_pool", "[network][basic]") {
+	lsl::io_context_pool pool(2, "pooltest");
+	REQUIRE(pool.size() == 2);
+	auto first = pool.next(), second = pool.next();
+	CHECK(first != second);
+	CHECK(pool.next() == first);
+
+	// handlers posted before drain() have run once it returns
+	std::atomic<int> counter{0};
+	for (int i = 0; i < 10; ++i) asio::post(*first, [&counter]() { counter++; });
+	REQUIRE(lsl::io_context_pool::drain(*first, 5.));
+	CHECK(counter == 10);
+}
+
+TEST_CASE("task_pool", "[network][basic]") {
+	lsl::task_pool pool(4, "tasktest");
+	REQUIRE(pool.size() == 4);
+
+	// the tasks of each strand run in order, the strands in parallel
+	const int nstrands = 8, ntasks = 2000;
+	std::vector<lsl::task_pool::strand_p> strands;
+	std::vector<std::vector<int>> done(nstrands);
+	std::mutex threads_mut;
+	std::set<std::thread::id> threads;
+	for (int s = 0; s < nstrands; ++s) strands.push_back(pool.make_strand());
+	for (int i = 0; i < ntasks; ++i)
+		for (int s = 0; s < nstrands; ++s)
+			pool.post(strands[s], [&, s, i]() {
+				done[s].push_back(i);
+				std::lock_guard<std::mutex> lock(threads_mut);
+				threads.insert(std::this_thread::get_id());
+			});
+	for (const auto &strand : strands) pool.wait(strand);
+	for (const auto &tasks : done) {
+		REQUIRE(tasks.size() == ntasks);
+		CHECK(std::is_sorted(tasks.begin(), tasks.end()));
+	}
+	CHECK(threads.count(std::this_thread::get_id()) == 0);
+
+	// cancelled tasks don't run, the running one has finished once cancel() returns
+	auto strand = pool.make_strand();
+	std::atomic<bool> started{false}, finished{false};
+	std::atomic<int> counter{0};
+	pool.post(strand, [&]() {
+		started = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		finished = true;
+	});
+	for (int i = 0; i < 10; ++i) pool.post(strand, [&counter]() { counter++; });
+	while (!started) std::this_thread::yield();
+	pool.cancel(strand);
+	CHECK(finished);
+	pool.wait(strand);
+	CHECK(counter == 0);
+
+	// a task can post to its own strand, wait for and cancel it without waiting for itself
+	pool.post(strand, [&]() {
+		pool.post(strand, [&counter]() { counter++; });
+		pool.wait(strand);
+	});
+	pool.wait(strand);
+	// the task posted by the first one was posted before it finished
+	pool.wait(strand);
+	CHECK(counter == 1);
+	pool.post(strand, [&]() {
+		pool.post(strand, [&counter]() { counter++; });
+		pool.cancel(strand);
+	});
+	pool.wait(strand);
+	CHECK(counter == 1);
+
+	// the last user can release the pool from within one of its tasks
+	auto owned = std::make_shared<lsl::task_pool>(2, "dtortest");
+	auto last = owned;
+	auto owned_strand = owned->make_strand();
+	std::promise<void> go, released;
+	owned->post(owned_strand, [&]() {
+		go.get_future().wait();
+		last.reset();
+		released.set_value();
+	});
+	owned.reset();
+	go.set_value();
+	CHECK(released.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+}
+
+TEST_CASE("watchdog_wheel", "[network][basic]") {
+	lsl::watchdog_wheel wheel(0.08);
+	std::atomic<int> first{0}, second{0};
+	const auto id = wheel.add([&first]() { first++; });
+	wheel.add([&second]() { second++; });
+	CHECK(wheel.size() == 2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	// each check runs once per interval
+	CHECK(first >= 3);
+	CHECK(first <= 10);
+	CHECK(second >= 3);
+	// a removed check doesn't run anymore once remove() returns
+	wheel.remove(id);
+	CHECK(wheel.size() == 1);
+	const int removed_at = first;
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	CHECK(first == removed_at);
+	CHECK(second >= 5);
+
+	// checks can remove themselves
+	std::atomic<uint64_t> self{0};
+	std::atomic<int> self_runs{0};
+	self = wheel.add([&]() {
+		if (self_runs++ > 0) return;
+		while (!self) std::this_thread::yield();
+		wheel.remove(self);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	CHECK(self_runs == 1);
+	CHECK(wheel.size() == 1);
+}
+
+TEST_CASE("interface listeners", "[network][basic]") {
+	const auto interfaces = lsl::get_local_interfaces();
+	const auto ignore = [](const std::vector<lsl::netif> &, const std::vector<lsl::netif> &) {};
+	// the first listener starts watching the interfaces, the last one stops it
+	for (int i = 0; i < 3; ++i) {
+		const int first = lsl::add_interface_listener(ignore);
+		const int second = lsl::add_interface_listener(ignore);
+		CHECK(first != second);
+		CHECK(lsl::get_local_interfaces().size() == interfaces.size());
+		lsl::remove_interface_listener(first);
+		lsl::remove_interface_listener(second);
+	}
+	CHECK(lsl::get_local_interfaces().size() == interfaces.size());
+}
+
+TEST_CASE("port allocation", "[network][basic]") {
+	asio::io_context io_ctx;
+	std::vector<std::unique_ptr<ip::tcp::acceptor>> acceptors;
+	std::set<uint16_t> ports;
+	for (int i = 0; i < 10; ++i) {
+		acceptors.emplace_back(new ip::tcp::acceptor(io_ctx, ip::tcp::v4()));
+		ports.insert(lsl::bind_and_listen_to_port_in_range(*acceptors.back(), ip::tcp::v4(), 1));
+	}
+	CHECK(ports.size() == acceptors.size());
+}
+
+// needs [ports] SharedSockets, run by ctest with lslcfgs/sharedsockets.cfg
+TEST_CASE("shared responders", "[network][.sharedsockets]") {
+	auto cfg = lsl::api_config::get_instance();
+	REQUIRE(cfg->shared_sockets());
+	// the multicast servers only share a socket if their replies are sent with the same TTL
+	asio::io_context io_ctx;
+	auto info = std::make_shared<lsl::stream_info_impl>(
+		"sharedresponder", "test", 1, lsl::IRREGULAR_RATE, cft_float32, "sharedresponder");
+	const std::string group = "239.255.172.215";
+	lsl::udp_server ttl3a(info, io_ctx, group, cfg->multicast_port(), 3, "");
+	lsl::udp_server ttl3b(info, io_ctx, group, cfg->multicast_port(), 3, "");
+	lsl::udp_server ttl4(info, io_ctx, group, cfg->multicast_port(), 4, "");
+	REQUIRE(ttl3a.shared_server());
+	CHECK(ttl3a.shared_server() == ttl3b.shared_server());
+	CHECK(ttl4.shared_server() != ttl3a.shared_server());
+
+	// the outlets' shared responders answer the queries for all of them
+	std::vector<std::unique_ptr<lsl::stream_outlet_impl>> outlets;
+	for (int i = 0; i < 3; ++i)
+		outlets.emplace_back(new lsl::stream_outlet_impl(
+			lsl::stream_info_impl("sharedsockets" + std::to_string(i), "SharedSockets", 1,
+				lsl::IRREGULAR_RATE, cft_int32, "sharedsockets" + std::to_string(i)),
+			0, 360));
+	lsl::resolver_impl resolver;
+	auto found = resolver.resolve_oneshot("type='SharedSockets'", 3, 5.0);
+	REQUIRE(found.size() == 3);
+	for (auto &result : found) {
+		if (result.name() != "sharedsockets1") continue;
+		result.v4address("127.0.0.1");
+		lsl::stream_inlet_impl inlet(result);
+		inlet.open_stream(2.0);
+		REQUIRE(outlets[1]->wait_for_consumers(2.0));
+		int32_t value = 11;
+		outlets[1]->push_sample(&value);
+		value = 0;
+		REQUIRE(inlet.pull_sample(&value, 1, 2.0) != 0.0);
+		CHECK(value == 11);
+	}
+}
@@ -1,8 +1,21 @@
 #include "../src/consumer_queue.h"
+#include "../src/lock_stats.h"
 #include "../src/sample.h"
+#include "../src/sample_frame.h"
+#include "../src/send_buffer.h"
+#include "../src/serialization_cache.h"
+#include "../src/util/endian.hpp"
+#include "../src/util/float16.hpp"
+#include <algorithm>
 #include <atomic>
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <cmath>
+#include <set>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
 
 TEST_CASE("consumer_queue", "[queue][basic]") {
 	const int size = 10;
@@ -51,3 +64,1217 @@ TEST_CASE("consumer_queue_threaded", "[queue][threads]") {
 	CHECK(pulled == size);
 	pusher.join();
 }
+
+TEST_CASE("consumer_queue_pop_samples", "[queue][basic]") {
+	const int size = 10;
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 4, size);
+	lsl::consumer_queue queue(size);
+	for (int i = 0; i < size; ++i) queue.push_sample(fac.new_sample(i, true));
+
+	lsl::sample_p out[size];
+	// Only the requested number of samples is popped, in the correct order
+	REQUIRE(queue.pop_samples(out, 4) == 4);
+	for (int i = 0; i < 4; ++i) CHECK(static_cast<int>(out[i]->timestamp) == i);
+
+	// Without a timeout, only the available samples are returned
+	REQUIRE(queue.pop_samples(out, size) == size - 4);
+	CHECK(static_cast<int>(out[0]->timestamp) == 4);
+	CHECK(queue.empty());
+
+	// Waiting ends early when a sentinel arrives
+	queue.push_sample(fac.new_sample(20, true));
+	queue.push_sample(lsl::sample_p());
+	REQUIRE(queue.pop_samples(out, size, 5.) == 2);
+	CHECK(!out[1]);
+}
+
+TEST_CASE("consumer_queue_push_samples", "[queue][basic]") {
+	const int size = 10;
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 4, size);
+	lsl::consumer_queue queue(size / 2);
+	std::vector<lsl::sample_p> chunk;
+	for (int i = 0; i < size; ++i) chunk.push_back(fac.new_sample(i, false));
+
+	// Pushing more samples than the capacity keeps only the newest ones
+	queue.push_samples(chunk.data(), chunk.size());
+	CHECK(queue.read_available() == size / 2);
+	CHECK(static_cast<int>(queue.pop_sample()->timestamp) == size / 2);
+}
+
+TEST_CASE("consumer_queue_notification", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 4, 4);
+	lsl::consumer_queue queue(4);
+	int notifications = 0;
+	queue.set_notification([&]() { notifications++; });
+
+	// Nothing happens unless a notification is armed
+	queue.push_sample(fac.new_sample(0., true));
+	CHECK(notifications == 0);
+
+	// Samples are already available, so the notification isn't armed
+	CHECK(!queue.arm_notification());
+	queue.flush();
+
+	// An armed notification is sent once
+	REQUIRE(queue.arm_notification());
+	queue.push_sample(fac.new_sample(1., true));
+	queue.push_sample(fac.new_sample(2., true));
+	CHECK(notifications == 1);
+}
+
+TEST_CASE("consumer_queue_overwrite_threaded", "[queue][threads]") {
+	const int n = 100000;
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	lsl::consumer_queue queue(8);
+	std::atomic<bool> done{false};
+
+	std::thread pusher([&]() {
+		for (int i = 1; i <= n; ++i) queue.push_sample(fac.new_sample(i, false));
+		done = true;
+	});
+
+	// The producer drops the oldest samples, but the consumer must never see them out of order
+	double last = 0;
+	int pulled = 0, out_of_order = 0;
+	while (!done || !queue.empty()) {
+		if (lsl::sample_p s = queue.pop_sample(0.01)) {
+			if (s->timestamp <= last) out_of_order++;
+			last = s->timestamp;
+			pulled++;
+		}
+	}
+	pusher.join();
+	CHECK(out_of_order == 0);
+	CHECK(pulled > 0);
+	CHECK(pulled <= n);
+}
+
+TEST_CASE("serialization_cache", "[samples][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 4, 4);
+	lsl::sample_p smp = fac.new_sample(1., true);
+	smp->assign_test_pattern(4);
+	// byte-swapped so the cached bytes can't simply alias the sample data
+	const int byte_order = BOOST_BYTE_ORDER == 1234 ? 4321 : 1234;
+	std::vector<char> scratch(16);
+	std::stringbuf expected, first, second;
+	smp->save_streambuf(expected, 110, byte_order, scratch.data());
+
+	lsl::serialization_cache cache;
+	cache.add_user(110, byte_order);
+	cache.add_user(110, byte_order);
+	cache.save_streambuf(smp, first, 110, byte_order, scratch.data());
+	// the second session gets the cached copy even if the sample was changed in the meantime
+	smp->assign_test_pattern(2);
+	cache.save_streambuf(smp, second, 110, byte_order, scratch.data());
+	CHECK(first.str() == expected.str());
+	CHECK(second.str() == expected.str());
+
+	// with a single user, the sample is serialized directly
+	cache.remove_user(110, byte_order);
+	std::stringbuf uncached, expected2;
+	smp->save_streambuf(expected2, 110, byte_order, scratch.data());
+	cache.save_streambuf(smp, uncached, 110, byte_order, scratch.data());
+	CHECK(uncached.str() == expected2.str());
+}
+
+TEST_CASE("endian_reverse_inplace_n", "[samples][basic]") {
+	// an odd number of values so that both the vectorized and the scalar code paths are used
+	const std::size_t n = 13;
+	std::vector<uint16_t> v16(n);
+	std::vector<uint32_t> v32(n);
+	std::vector<uint64_t> v64(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		v16[i] = static_cast<uint16_t>(0x0102 + i);
+		v32[i] = static_cast<uint32_t>(0x01020304 + i);
+		v64[i] = UINT64_C(0x0102030405060708) + i;
+	}
+	lsl::endian_reverse_inplace_n(v16.data(), sizeof(uint16_t), n);
+	lsl::endian_reverse_inplace_n(v32.data(), sizeof(uint32_t), n);
+	lsl::endian_reverse_inplace_n(v64.data(), sizeof(uint64_t), n);
+	for (std::size_t i = 0; i < n; ++i) {
+		CHECK(v16[i] == lslboost::endian::endian_reverse(static_cast<uint16_t>(0x0102 + i)));
+		CHECK(v32[i] == lslboost::endian::endian_reverse(static_cast<uint32_t>(0x01020304 + i)));
+		CHECK(v64[i] == lslboost::endian::endian_reverse(UINT64_C(0x0102030405060708) + i));
+	}
+}
+
+TEST_CASE("factory_threaded", "[samples][threads]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 4, 16);
+	const int n = 20000, num_threads = 4;
+	std::atomic<int> errors{0};
+	std::vector<std::thread> threads;
+	// several threads allocate samples concurrently and release them in batches
+	for (int t = 0; t < num_threads; ++t)
+		threads.emplace_back([&, t]() {
+			std::vector<lsl::sample_p> held;
+			for (int i = 0; i < n; ++i) {
+				held.push_back(fac.new_sample(t * n + i, false));
+				int32_t data[4] = {t, i, t, i}, out[4];
+				held.back()->assign_typed(data).retrieve_typed(out);
+				if (out[0] != t || out[1] != i) errors++;
+				if (held.size() == 8) held.clear();
+			}
+		});
+	for (auto &thread : threads) thread.join();
+	CHECK(errors == 0);
+}
+
+TEST_CASE("sample_alignment", "[samples][basic]") {
+	for (uint32_t nchan : {1u, 3u, 17u}) {
+		lsl::factory fac(lsl_channel_format_t::cft_float32, nchan, 4);
+		CHECK(fac.sample_size() % fac.alignment() == 0);
+		// the samples of the first slab and of an additional one have aligned payloads
+		std::vector<lsl::sample_p> held;
+		for (int i = 0; i < 64; ++i) {
+			held.push_back(fac.new_sample(i, false));
+			CHECK(reinterpret_cast<std::uintptr_t>(held.back()->raw_data()) % fac.alignment() == 0);
+			CHECK(held.back()->num_channels() == nchan);
+		}
+		CHECK(fac.stats().slabs > 1);
+	}
+}
+
+TEST_CASE("delta_encoding", "[samples][basic]") {
+	const int byte_order = BOOST_BYTE_ORDER;
+	lsl::factory ifac(lsl_channel_format_t::cft_int16, 3, 4),
+		ffac(lsl_channel_format_t::cft_float32, 3, 4);
+	std::vector<int16_t> iprev_out(3), iprev_in(3);
+	std::vector<float> fprev_out(3), fprev_in(3);
+	std::stringbuf sb;
+	// slowly changing values in both directions, including the extremes of the value range
+	const int16_t ivals[][3] = {{0, -1, 32767}, {5, -3, -32768}, {4, 100, -32767}};
+	const float fvals[][3] = {{0.f, -1.5f, 1e30f}, {0.25f, -1.5f, -1e-30f}, {0.5f, 2.f, 3.f}};
+	for (int i = 0; i < 3; ++i) {
+		ifac.new_sample(i, false)
+			->assign_typed(ivals[i])
+			.save_streambuf_delta(sb, byte_order, iprev_out.data());
+		ffac.new_sample(lsl::DEDUCED_TIMESTAMP, false)
+			->assign_typed(fvals[i])
+			.save_streambuf_delta(sb, byte_order, fprev_out.data());
+	}
+	for (int i = 0; i < 3; ++i) {
+		int16_t iout[3];
+		float fout[3];
+		lsl::sample_p ismp = ifac.new_sample(0., false), fsmp = ffac.new_sample(0., false);
+		ismp->load_streambuf_delta(sb, byte_order, false, iprev_in.data());
+		fsmp->load_streambuf_delta(sb, byte_order, false, fprev_in.data());
+		ismp->retrieve_typed(iout);
+		fsmp->retrieve_typed(fout);
+		CHECK(ismp->timestamp == Approx(i));
+		CHECK(fsmp->timestamp == lsl::DEDUCED_TIMESTAMP);
+		for (int k = 0; k < 3; ++k) {
+			CHECK(iout[k] == ivals[i][k]);
+			CHECK(fout[k] == fvals[i][k]);
+		}
+	}
+	CHECK(sb.in_avail() == 0);
+}
+
+TEST_CASE("streambuf_roundtrip", "[samples][basic]") {
+	const int byte_orders[] = {1234, 4321};
+	// small samples take the single-block path, large ones the generic one
+	for (uint32_t nchan : {3u, 100u}) {
+		lsl::factory fac(lsl_channel_format_t::cft_int32, nchan, 4);
+		for (int byte_order : byte_orders) {
+			INFO(nchan << " channels, byte order " << byte_order);
+			std::vector<char> scratch(nchan * sizeof(int32_t));
+			std::stringbuf sb;
+			lsl::sample_p deduced = fac.new_sample(0., false), stamped = fac.new_sample(0., false);
+			deduced->assign_test_pattern(1).timestamp = lsl::DEDUCED_TIMESTAMP;
+			stamped->assign_test_pattern(2).timestamp = 17.5;
+			deduced->save_streambuf(sb, 110, byte_order, scratch.data());
+			stamped->save_streambuf(sb, 110, byte_order, scratch.data());
+			CHECK(sb.str().size() == 2 + sizeof(double) + 2 * nchan * sizeof(int32_t));
+			// the first value of the deduced sample is stored in the requested byte order
+			int32_t first;
+			memcpy(&first, sb.str().data() + 1, sizeof(first));
+			if (byte_order != BOOST_BYTE_ORDER) lslboost::endian::endian_reverse_inplace(first);
+			int32_t expected[100];
+			deduced->retrieve_typed(expected);
+			CHECK(first == expected[0]);
+
+			lsl::sample_p in1 = fac.new_sample(0., false), in2 = fac.new_sample(0., false);
+			in1->load_streambuf(sb, 110, byte_order, false);
+			in2->load_streambuf(sb, 110, byte_order, false);
+			CHECK(in1->timestamp == lsl::DEDUCED_TIMESTAMP);
+			CHECK(in2->timestamp == 17.5);
+			CHECK(*in1 == *deduced);
+			CHECK(*in2 == *stamped);
+		}
+	}
+}
+
+TEST_CASE("sample_frame_roundtrip", "[samples][basic]") {
+	const uint32_t nchan = 3;
+	lsl::factory fac(lsl_channel_format_t::cft_int16, nchan, 8);
+	for (int byte_order : {1234, 4321}) {
+		for (bool seqs : {false, true}) {
+			INFO("byte order " << byte_order << ", sequence numbers " << seqs);
+			std::vector<lsl::sample_p> sent;
+			lsl::frame_builder frame;
+			std::vector<char> scratch(nchan * sizeof(int16_t));
+			std::stringbuf values;
+			for (int i = 0; i < 4; ++i) {
+				sent.push_back(fac.new_sample(i == 2 ? 3.5 : lsl::DEDUCED_TIMESTAMP, false));
+				sent.back()->assign_test_pattern(i);
+				sent.back()->seq = seqs ? 10 + i : 0;
+				frame.add(sent.back()->timestamp, sent.back()->seq);
+				sent.back()->save_streambuf_values(values, byte_order, scratch.data());
+			}
+			frame.finish(values.str().size(), byte_order);
+			std::stringbuf sb;
+			sb.sputn(frame.header(), lsl::frame_header_bytes);
+			sb.sputn(values.str().data(), static_cast<std::streamsize>(values.str().size()));
+			sb.sputn(frame.trailer().data(), static_cast<std::streamsize>(frame.trailer().size()));
+
+			std::vector<char> body;
+			std::vector<lsl::sample_p> received;
+			lsl::read_frame(sb, fac, cft_int16, nchan, byte_order, false, body, received);
+			CHECK(sb.in_avail() == 0);
+			REQUIRE(received.size() == sent.size());
+			for (std::size_t i = 0; i < sent.size(); ++i) {
+				CHECK(*received[i] == *sent[i]);
+				CHECK(received[i]->timestamp == sent[i]->timestamp);
+				CHECK(received[i]->seq == sent[i]->seq);
+			}
+		}
+	}
+	// the time stamps as nanosecond deltas: the first frame is sent with the doubles, the next
+	// ones (with deduced time stamps resolved) as deltas, keeping all time stamps deduced in frames
+	// without explicit ones
+	lsl::timestamp_deltas deltas{100.0};
+	const double ded = lsl::DEDUCED_TIMESTAMP;
+	const double timestamps[][4] = {{ded, 1000.1, ded, 1000.12},
+		{ded, 1000.1412345678, 1000.1499, ded}, {ded, ded, ded, ded}};
+	const uint8_t expected_flags[] = {lsl::frame_timestamps, lsl::frame_timestamp_deltas, 0};
+	double last = 1000.12;
+	for (int f = 0; f < 3; ++f) {
+		INFO("frame " << f);
+		lsl::frame_builder frame;
+		std::stringbuf values;
+		std::vector<char> scratch(nchan * sizeof(int16_t));
+		for (double ts : timestamps[f]) {
+			frame.add(ts, 0);
+			fac.new_sample(ts, false)->save_streambuf_values(values, 4321, scratch.data());
+		}
+		frame.finish(values.str().size(), 4321, &deltas);
+		CHECK(static_cast<uint8_t>(frame.header()[8]) == expected_flags[f]);
+		std::stringbuf sb;
+		sb.sputn(frame.header(), lsl::frame_header_bytes);
+		sb.sputn(values.str().data(), static_cast<std::streamsize>(values.str().size()));
+		sb.sputn(frame.trailer().data(), static_cast<std::streamsize>(frame.trailer().size()));
+		std::vector<char> body;
+		std::vector<lsl::sample_p> received;
+		lsl::read_frame(sb, fac, cft_int16, nchan, 4321, false, body, received);
+		REQUIRE(received.size() == 4);
+		for (int k = 0; k < 4; ++k) {
+			double expected = timestamps[f][k];
+			if (f == 1) {
+				if (expected == lsl::DEDUCED_TIMESTAMP) expected = last + 0.01;
+				last = expected;
+				CHECK(received[k]->timestamp == Approx(expected).margin(1e-9));
+			} else
+				CHECK(received[k]->timestamp == expected);
+		}
+		// the deltas take far less than a double per time stamp
+		if (f == 1) CHECK(frame.trailer().size() < 2 * sizeof(double) + 3 * 4);
+	}
+	CHECK(deltas.last_timestamp == Approx(1000.1599 + 0.03));
+
+	// the changed channels: the values of the mostly constant channels are sent once, and the
+	// receiver's previous values carry over to the next frame
+	for (int byte_order : {1234, 4321}) {
+		INFO("changed channels, byte order " << byte_order);
+		const int16_t vals[][nchan] = {{1, 7, 0}, {2, 7, 0}, {3, 7, 0}, {3, 7, -1}, {4, 7, -1}};
+		std::vector<int16_t> prev_out(nchan), prev_in(nchan);
+		std::vector<lsl::sample_p> received;
+		std::vector<char> body;
+		std::size_t value_bytes = 0;
+		for (int f = 0; f < 2; ++f) {
+			lsl::frame_builder frame;
+			std::stringbuf values;
+			for (int i = f * 3; i < std::min(5, f * 3 + 3); ++i) {
+				lsl::sample_p smp = fac.new_sample(10.0 + i, false);
+				smp->assign_typed(vals[i]);
+				frame.add(smp->timestamp, 0);
+				smp->save_streambuf_changed(values, byte_order, prev_out.data());
+			}
+			value_bytes += values.str().size();
+			frame.finish(values.str().size(), byte_order, nullptr, true);
+			std::stringbuf sb;
+			sb.sputn(frame.header(), lsl::frame_header_bytes);
+			sb.sputn(values.str().data(), static_cast<std::streamsize>(values.str().size()));
+			sb.sputn(frame.trailer().data(), static_cast<std::streamsize>(frame.trailer().size()));
+			if (f == 0) {
+				// the decoder needs the previous values
+				std::stringbuf copy(sb.str());
+				CHECK_THROWS(lsl::read_frame(copy, fac, cft_int16, nchan, byte_order, false, body,
+					received));
+			}
+			lsl::read_frame(
+				sb, fac, cft_int16, nchan, byte_order, false, body, received, prev_in.data());
+			CHECK(sb.in_avail() == 0);
+		}
+		// a mask form and mask byte per sample, plus the 2+1+1+1+1 changed values
+		CHECK(value_bytes == 2 * 5 + 6 * sizeof(int16_t));
+		REQUIRE(received.size() == 5);
+		for (int i = 0; i < 5; ++i) {
+			int16_t out[nchan];
+			received[i]->retrieve_typed(out);
+			CHECK(received[i]->timestamp == 10.0 + i);
+			for (uint32_t k = 0; k < nchan; ++k) CHECK(out[k] == vals[i][k]);
+		}
+	}
+
+	// the sparse samples of a stream with many channels are sent as index lists
+	for (int byte_order : {1234, 4321}) {
+		INFO("sparse changed channels, byte order " << byte_order);
+		const uint32_t wide = 300;
+		lsl::factory wide_fac(cft_int16, wide, 4);
+		const uint32_t indices[][2] = {{5, 290}, {5, 6}, {0, 0}};
+		const int16_t vals[][2] = {{1, -1}, {0, 2}, {0, 0}};
+		std::vector<int16_t> prev_out(wide), prev_in(wide);
+		lsl::frame_builder frame;
+		std::stringbuf values;
+		std::vector<lsl::sample_p> sent;
+		for (int i = 0; i < 3; ++i) {
+			sent.push_back(wide_fac.new_sample(20.0 + i, false));
+			sent.back()->assign_sparse(indices[i], vals[i], i < 2 ? 2 : 0,
+				lsl::typed_kernels<int16_t>::select(cft_int16).assign);
+			frame.add(sent.back()->timestamp, 0);
+			sent.back()->save_streambuf_changed(values, byte_order, prev_out.data());
+		}
+		// the counts, the index gaps (of which 284 and 283 take two bytes) and the changed values:
+		// channels 5 and 290, then 5, 6 and 290, then 6
+		CHECK(values.str().size() == (1 + 3 + 2 * 2) + (1 + 4 + 3 * 2) + (1 + 1 + 2));
+		frame.finish(values.str().size(), byte_order, nullptr, true);
+		std::stringbuf sb;
+		sb.sputn(frame.header(), lsl::frame_header_bytes);
+		sb.sputn(values.str().data(), static_cast<std::streamsize>(values.str().size()));
+		sb.sputn(frame.trailer().data(), static_cast<std::streamsize>(frame.trailer().size()));
+		std::vector<lsl::sample_p> received;
+		std::vector<char> body;
+		lsl::read_frame(
+			sb, wide_fac, cft_int16, wide, byte_order, false, body, received, prev_in.data());
+		REQUIRE(received.size() == 3);
+		for (int i = 0; i < 3; ++i) CHECK(*received[i] == *sent[i]);
+		uint32_t got[3];
+		int16_t got_vals[3];
+		CHECK(received[1]->retrieve_sparse(got, got_vals, 3,
+				  lsl::typed_kernels<int16_t>::select(cft_int16).retrieve) == 1);
+		CHECK(got[0] == 6);
+		CHECK(got_vals[0] == 2);
+	}
+
+	// a body size that doesn't match the sample count is rejected
+	std::stringbuf bad(std::string("\1\0\0\0\1\0\0\0\0x", 10));
+	std::vector<char> body;
+	std::vector<lsl::sample_p> received;
+	CHECK_THROWS(lsl::read_frame(bad, fac, cft_int16, nchan, 1234, false, body, received));
+}
+
+TEST_CASE("int24", "[samples][basic]") {
+	const uint32_t nchan = 5;
+	lsl::factory fac(cft_int24, nchan, 4);
+	const int32_t values[nchan] = {0, -1, 8388607, -8388608, 0x1234567};
+	lsl::sample_p smp = fac.new_sample(1.5, false);
+	smp->assign_typed(values);
+	CHECK(smp->datasize() == 3 * nchan);
+	int32_t out[nchan];
+	double dout[nchan];
+	std::string sout[nchan];
+	smp->retrieve_typed(out);
+	smp->retrieve_typed(dout, fac.kernels<double>().retrieve);
+	smp->retrieve_typed(sout);
+	// values outside the 24 bit range are truncated
+	const int32_t expected[nchan] = {0, -1, 8388607, -8388608, 0x234567};
+	for (uint32_t k = 0; k < nchan; ++k) {
+		CHECK(out[k] == expected[k]);
+		CHECK(dout[k] == expected[k]);
+		CHECK(sout[k] == std::to_string(expected[k]));
+	}
+
+	for (int byte_order : {1234, 4321}) {
+		std::vector<char> scratch(smp->datasize());
+		std::stringbuf sb;
+		smp->save_streambuf(sb, 110, byte_order, scratch.data());
+		smp->save_portable(sb);
+		lsl::sample_p in = fac.new_sample(0., false), portable = fac.new_sample(0., false);
+		in->load_streambuf(sb, 110, byte_order, false);
+		portable->load_portable(sb);
+		CHECK(*in == *smp);
+		CHECK(*portable == *smp);
+	}
+	lsl::sample_p pattern = fac.new_sample(0., false);
+	pattern->assign_test_pattern(4).retrieve_typed(out);
+	CHECK(out[1] == -65542);
+}
+
+TEST_CASE("float16", "[samples][basic]") {
+	// all half precision values survive the round trip through floats, in bulk and one at a time
+	std::vector<uint16_t> halves(65536), back(65536);
+	std::vector<float> floats(65536);
+	for (std::size_t k = 0; k < halves.size(); ++k) halves[k] = static_cast<uint16_t>(k);
+	lsl::half_to_float_n(floats.data(), halves.data(), halves.size());
+	lsl::float_to_half_n(back.data(), floats.data(), floats.size());
+	for (std::size_t k = 0; k < halves.size(); ++k) {
+		const bool nan = (k & 0x7c00) == 0x7c00 && (k & 0x3ff);
+		CHECK((nan ? floats[k] != floats[k] : floats[k] == lsl::half_to_float(halves[k])));
+		if (!nan) CHECK(back[k] == halves[k]);
+		if (!nan) CHECK(lsl::float_to_half(floats[k]) == halves[k]);
+	}
+	// rounding to nearest even, overflow and underflow
+	CHECK(lsl::half_to_float(lsl::float_to_half(2049.f)) == 2048.f);
+	CHECK(lsl::half_to_float(lsl::float_to_half(2051.f)) == 2052.f);
+	CHECK(lsl::float_to_half(65519.f) == 0x7bff);
+	CHECK(lsl::float_to_half(65520.f) == 0x7c00);
+	CHECK(lsl::float_to_half(-1e10f) == 0xfc00);
+	CHECK(lsl::float_to_half(std::ldexp(1.f, -25)) == 0);
+	CHECK(lsl::float_to_half(std::ldexp(1.5f, -25)) == 1);
+
+	lsl::factory fac(cft_float16, 3, 4);
+	const double values[] = {0.5, -3.25, 1e-5};
+	lsl::sample_p smp = fac.new_sample(1.5, false);
+	smp->assign_typed(values, fac.kernels<double>().assign);
+	CHECK(smp->datasize() == 6);
+	float out[3];
+	smp->retrieve_typed(out);
+	CHECK(out[0] == 0.5f);
+	CHECK(out[1] == -3.25f);
+	CHECK(out[2] == Approx(1e-5).epsilon(0.01));
+	std::string sout[3];
+	smp->retrieve_typed(sout);
+	CHECK(std::stof(sout[1]) == -3.25f);
+	// the subnormal value is suppressed on request
+	std::vector<char> scratch(smp->datasize());
+	std::stringbuf sb;
+	smp->save_streambuf(sb, 110, 1234, scratch.data());
+	smp->save_portable(sb);
+	lsl::sample_p in = fac.new_sample(0., false), portable = fac.new_sample(0., false);
+	in->load_streambuf(sb, 110, 1234, true);
+	portable->load_portable(sb);
+	in->retrieve_typed(out);
+	CHECK(out[1] == -3.25f);
+	CHECK(out[2] == 0.f);
+	CHECK(*portable == *smp);
+}
+
+TEST_CASE("string_streambuf_roundtrip", "[samples][basic]") {
+	// short strings take the single-block path, long ones the generic one
+	const std::string lengths[] = {"", std::string(300, 'x'), std::string(5000, 'y')};
+	for (const std::string &last : lengths)
+		for (int byte_order : {1234, 4321}) {
+			INFO(last.size() << " bytes, byte order " << byte_order);
+			lsl::factory fac(cft_string, 3, 4);
+			const char *values[] = {"marker", "", last.c_str()};
+			const uint32_t value_lengths[] = {3, 0, static_cast<uint32_t>(last.size())};
+			lsl::sample_p stamped = fac.new_sample(17.5, false);
+			stamped->assign_buffers(values, nullptr);
+			lsl::sample_p deduced = fac.new_sample(lsl::DEDUCED_TIMESTAMP, false);
+			deduced->assign_buffers(values, value_lengths);
+			CHECK(deduced->string_data()[0] == "mar");
+
+			std::stringbuf sb;
+			stamped->save_streambuf(sb, 110, byte_order);
+			deduced->save_streambuf(sb, 110, byte_order);
+			lsl::sample_p in1 = fac.new_sample(0., false), in2 = fac.new_sample(0., false);
+			in1->load_streambuf(sb, 110, byte_order, false);
+			in2->load_streambuf(sb, 110, byte_order, false);
+			CHECK(in1->timestamp == 17.5);
+			CHECK(in2->timestamp == lsl::DEDUCED_TIMESTAMP);
+			CHECK(*in1 == *stamped);
+			CHECK(*in2 == *deduced);
+			CHECK(in1->string_data()[2] == last);
+		}
+	lsl::factory numeric(cft_float32, 1, 1);
+	const char *value = "1";
+	CHECK_THROWS_AS(numeric.new_sample(0., false)->assign_buffers(&value, nullptr),
+		std::invalid_argument);
+}
+
+TEST_CASE("assign_moved", "[samples][basic]") {
+	lsl::factory fac(cft_string, 2, 4);
+	const std::string long_value(100, 'z');
+	std::vector<std::string> values{"event", long_value};
+	const char *storage = values[1].data();
+	lsl::sample_p smp = fac.new_sample(0., false);
+	smp->assign_moved(values.data());
+	CHECK(smp->string_data()[0] == "event");
+	CHECK(smp->string_data()[1] == long_value);
+	// the contents were moved, not copied
+	CHECK(smp->string_data()[1].data() == storage);
+
+	lsl::factory numeric(cft_int32, 2, 4);
+	std::vector<std::string> numbers{"1", "-2"};
+	int32_t ints[2];
+	numeric.new_sample(0., false)->assign_moved(numbers.data()).retrieve_typed(ints);
+	CHECK(ints[0] == 1);
+	CHECK(ints[1] == -2);
+}
+
+TEST_CASE("typed_kernels", "[samples][basic]") {
+	const lsl_channel_format_t formats[] = {cft_float32, cft_double64, cft_string, cft_int8,
+		cft_int16, cft_int32, cft_int64};
+	const double values[] = {-3., 0., 1., 100.};
+	for (auto fmt : formats) {
+		INFO(fmt);
+		lsl::factory fac(fmt, 4, 2);
+		lsl::sample_p by_kernel = fac.new_sample(0., false), by_switch = fac.new_sample(0., false);
+		by_kernel->assign_typed(values, fac.kernels<double>().assign);
+		by_switch->assign_typed(values);
+		CHECK(*by_kernel == *by_switch);
+
+		int32_t ints_kernel[4], ints_switch[4];
+		by_kernel->retrieve_typed(ints_kernel, fac.kernels<int32_t>().retrieve);
+		by_switch->retrieve_typed(ints_switch);
+		for (int k = 0; k < 4; ++k) CHECK(ints_kernel[k] == ints_switch[k]);
+		std::string strs[4];
+		by_kernel->retrieve_typed(strs, fac.kernels<std::string>().retrieve);
+		CHECK(lsl::from_string<double>(strs[3]) == 100.);
+	}
+}
+
+TEST_CASE("factory_packing", "[samples][basic]") {
+	// samples are packed tightly, so writing one sample mustn't touch its neighbours
+	for (auto fmt : {cft_int8, cft_int16, cft_double64, cft_string}) {
+		INFO(fmt);
+		lsl::factory fac(fmt, 3, 16);
+		std::vector<lsl::sample_p> samples;
+		for (int i = 0; i < 16; ++i) samples.push_back(fac.new_sample(i, false));
+		for (int i = 0; i < 16; ++i) samples[i]->assign_test_pattern(i);
+		for (int i = 0; i < 16; ++i) {
+			lsl::sample_p expected = fac.new_sample(0., false);
+			expected->assign_test_pattern(i);
+			CHECK(*samples[i] == *expected);
+		}
+	}
+}
+
+TEST_CASE("factory_growth", "[samples][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_string, 2, 4);
+	CHECK(fac.stats().slabs == 1);
+	CHECK(fac.stats().overflows == 0);
+	// hold more samples than the initial slab has room for so the pool has to grow
+	const int n = static_cast<int>(fac.stats().samples) + 50;
+	std::vector<lsl::sample_p> held;
+	for (int i = 0; i < n; ++i) {
+		held.push_back(fac.new_sample(i, false));
+		held.back()->assign_test_pattern(i);
+	}
+	const auto stats = fac.stats();
+	CHECK(stats.overflows >= 1);
+	CHECK(stats.slabs == stats.overflows + 1);
+	CHECK(stats.samples >= static_cast<uint32_t>(n));
+	for (int i = 0; i < n; ++i) {
+		lsl::sample_p expected = fac.new_sample(0., false);
+		expected->assign_test_pattern(i);
+		CHECK(*held[i] == *expected);
+	}
+	// released samples are reused instead of growing further
+	held.clear();
+	for (int i = 0; i < n; ++i) held.push_back(fac.new_sample(i, false));
+	CHECK(fac.stats().overflows == stats.overflows);
+}
+
+TEST_CASE("factory_new_samples", "[samples][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 4);
+	// a sample that is reused has its fields reset
+	fac.new_sample(1., true)->seq = 5;
+	// more samples than the initial slab has room for
+	const std::size_t n = fac.stats().samples + 50;
+	std::vector<lsl::sample_p> batch(n);
+	fac.new_samples(batch.data(), n);
+	CHECK(fac.stats().overflows >= 1);
+	std::set<const lsl::sample *> distinct;
+	for (const auto &s : batch) {
+		REQUIRE(s);
+		distinct.insert(s.get());
+		CHECK(s->timestamp == 0.0);
+		CHECK(!s->pushthrough);
+		CHECK(s->seq == 0);
+	}
+	CHECK(distinct.size() == n);
+	// the samples are reused once they're released
+	const auto overflows = fac.stats().overflows;
+	batch.assign(n, lsl::sample_p());
+	fac.new_samples(batch.data(), n);
+	CHECK(fac.stats().overflows == overflows);
+}
+
+TEST_CASE("factory_shared", "[samples][threads]") {
+	auto a = lsl::factory::shared(lsl_channel_format_t::cft_float32, 8, 16),
+		 b = lsl::factory::shared(lsl_channel_format_t::cft_float32, 8, 1000);
+	// streams with the same format share a pool, others get their own
+	CHECK(a == b);
+	CHECK(a->stats().samples < 1000);
+	CHECK(a != lsl::factory::shared(lsl_channel_format_t::cft_float32, 4, 16));
+	CHECK(a != lsl::factory::shared(lsl_channel_format_t::cft_double64, 8, 16));
+
+	// the threads of several streams take and return samples concurrently
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([&a]() {
+			std::vector<lsl::sample_p> held(64);
+			for (int i = 0; i < 2000; ++i) held[i % held.size()] = a->new_sample(i, false);
+		});
+	for (auto &t : threads) t.join();
+
+	CHECK(a->stats().overflows > 0);
+
+	// the pool is released with its last user, so the next one starts afresh
+	a.reset();
+	b.reset();
+	CHECK(lsl::factory::shared(lsl_channel_format_t::cft_float32, 8, 16)->stats().overflows == 0);
+}
+
+TEST_CASE("send_buffer_budget", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 4);
+	// room for 150 samples of 64 bytes in all consumer queues
+	auto buffer = std::make_shared<lsl::send_buffer>(100, 64, 64 * 150);
+	auto full = buffer->new_consumer(), partial = buffer->new_consumer(),
+		 none = buffer->new_consumer();
+	CHECK(full->capacity() == 100);
+	CHECK(partial->capacity() == 50);
+	// a consumer always gets room for a few samples
+	CHECK(none->capacity() == lsl::consumer_queue::min_capacity);
+
+	for (int i = 0; i < 120; ++i) buffer->push_sample(fac.new_sample(i, false));
+	CHECK(full->dropped() == 20);
+	CHECK(partial->dropped() == 70);
+	CHECK(buffer->dropped_samples() == 20 + 70 + 118);
+
+	// the budget and the drop statistics survive disconnecting consumers
+	partial.reset();
+	none.reset();
+	CHECK(buffer->new_consumer(30)->capacity() == 30);
+	CHECK(buffer->dropped_samples() == 20 + 70 + 118);
+}
+
+TEST_CASE("send_buffer_priorities", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 16);
+	auto buffer = std::make_shared<lsl::send_buffer>(100);
+	std::vector<lsl_transfer_priority_t> woken;
+	std::vector<std::shared_ptr<lsl::consumer_queue>> queues;
+	// the most urgent consumers connect last
+	for (auto priority : {prio_bulk, prio_normal, prio_bulk, prio_latency}) {
+		queues.push_back(buffer->new_consumer(100, 0, 0.0, priority));
+		queues.back()->set_notification([&woken, priority]() { woken.push_back(priority); });
+	}
+	const auto push = [&]() {
+		woken.clear();
+		for (auto &queue : queues) REQUIRE(queue->arm_notification());
+		buffer->push_sample(fac.new_sample(0.0, true));
+		return woken;
+	};
+	// but a push reaches them first
+	CHECK(push() == std::vector<lsl_transfer_priority_t>{
+						prio_latency, prio_normal, prio_bulk, prio_bulk});
+	for (auto &queue : queues) queue->pop_sample(0.0);
+
+	// and a consumer that goes away doesn't change the order of the others
+	queues.erase(queues.begin() + 1);
+	CHECK(push() == std::vector<lsl_transfer_priority_t>{prio_latency, prio_bulk, prio_bulk});
+}
+
+TEST_CASE("send_buffer_deduced_timestamps", "[queue][threads]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 16);
+	auto buffer = std::make_shared<lsl::send_buffer>(4096);
+	buffer->enable_deduced_timestamps(3, 0.0005, 0.01);
+	auto queue = buffer->new_consumer();
+	const auto push = [&](int32_t value, double timestamp) {
+		lsl::sample_p s(fac.new_sample(timestamp, false));
+		s->assign_typed(&value);
+		buffer->push_sample(s);
+	};
+
+	// at most 3 consecutive time stamps are omitted, a jump is always sent
+	for (int32_t i = 0; i < 10; ++i) push(i, 1000. + i * .01 + (i == 6 ? .0003 : 0.));
+	push(10, 2000.);
+	// the samples keep their time stamps, and those pushed as deduced get the deduced ones
+	push(11, lsl::DEDUCED_TIMESTAMP);
+	lsl::timestamp_deduction deduction = buffer->new_timestamp_deduction();
+	const bool deduced[] = {
+		false, true, true, true, false, true, true, true, false, true, false, true};
+	for (bool expected : deduced) {
+		lsl::sample_p s = queue->pop_sample(0.0);
+		REQUIRE(s);
+		INFO(s->seq);
+		double pushed = 1000. + (s->seq - 1) * .01 + (s->seq == 7 ? .0003 : 0.);
+		if (s->seq >= 11) pushed = s->seq == 11 ? 2000. : 2000.01;
+		CHECK(s->timestamp == Approx(pushed).margin(1e-9).epsilon(0));
+		CHECK((deduction.wire_timestamp(s->timestamp, s->seq) == lsl::DEDUCED_TIMESTAMP) ==
+			  expected);
+	}
+
+	// a consumer that joins late, or after a gap, gets the time stamp first
+	auto late = buffer->new_consumer();
+	lsl::timestamp_deduction late_deduction = buffer->new_timestamp_deduction();
+	for (int32_t i = 0; i < 4; ++i) push(12 + i, 2000.02 + i * .01);
+	for (int k = 0; k < 4; ++k) {
+		lsl::sample_p s = late->pop_sample(0.0);
+		REQUIRE(s);
+		if (k == 2) continue;
+		const double ts = late_deduction.wire_timestamp(s->timestamp, s->seq);
+		CHECK((ts == lsl::DEDUCED_TIMESTAMP) == (k == 1));
+	}
+	for (int k = 0; k < 4; ++k) queue->pop_sample(0.0);
+	CHECK(lsl::timestamp_deduction().wire_timestamp(1.0, 1) == 1.0);
+
+	// concurrent pushes are deduced in the order the receivers get them
+	std::atomic<int32_t> next{0};
+	const int32_t per_thread = 1000;
+	std::vector<std::thread> pushers;
+	for (int t = 0; t < 2; ++t)
+		pushers.emplace_back([&]() {
+			for (int k = 0; k < per_thread; ++k) {
+				const int32_t value = next++;
+				push(value, 3000. + value * .01);
+			}
+		});
+	for (auto &t : pushers) t.join();
+	double last = 2000.;
+	for (int k = 0; k < 2 * per_thread; ++k) {
+		lsl::sample_p s = queue->pop_sample(0.0);
+		REQUIRE(s);
+		const double ts = deduction.wire_timestamp(s->timestamp, s->seq);
+		last = ts == lsl::DEDUCED_TIMESTAMP ? last + .01 : ts;
+		int32_t value;
+		s->retrieve_typed(&value);
+		INFO(value);
+		CHECK(last == Approx(3000. + value * .01).margin(.0005 + 1e-9).epsilon(0));
+	}
+}
+
+TEST_CASE("consumer_queue_spin", "[queue][threads]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	lsl::consumer_queue queue(8);
+	queue.set_spin_time(0.05);
+
+	// A timeout shorter than the spin time still expires
+	CHECK(queue.pop_sample(0.001) == nullptr);
+
+	// Samples pushed while the consumer spins are picked up
+	std::thread pusher([&]() {
+		for (int i = 1; i <= 100; ++i) {
+			queue.push_sample(fac.new_sample(i, true));
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+	int pulled = 0;
+	while (pulled < 100 && queue.pop_sample(1.0)) pulled++;
+	pusher.join();
+	CHECK(pulled == 100);
+}
+
+TEST_CASE("consumer_queue_min_samples", "[queue][threads]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 32);
+	lsl::consumer_queue queue(16);
+	lsl::sample_p out[8];
+
+	// Waiting ends once the minimum is reached, the other available samples are popped as well
+	std::thread pusher([&]() {
+		for (int i = 0; i < 6; ++i) {
+			queue.push_sample(fac.new_sample(i, true));
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	});
+	const std::size_t n = queue.pop_samples(out, 8, 5., 4);
+	pusher.join();
+	CHECK(n >= 4);
+	CHECK(n + queue.read_available() == 6);
+	queue.flush();
+
+	// A sentinel wakes up the consumer before the minimum is reached
+	pusher = std::thread([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queue.push_sample(fac.new_sample(1, true));
+		queue.push_sample(lsl::sample_p());
+	});
+	const auto start = std::chrono::steady_clock::now();
+	REQUIRE(queue.pop_samples(out, 8, 5., 4) == 2);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+	CHECK(!out[1]);
+	pusher.join();
+
+	// The timeout still expires with fewer samples
+	queue.push_sample(fac.new_sample(2, true));
+	CHECK(queue.pop_samples(out, 8, 0.05, 4) == 1);
+}
+
+TEST_CASE("send_buffer_registration_threaded", "[queue][threads]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 64);
+	auto buffer = std::make_shared<lsl::send_buffer>(1000, 0, 0, 50);
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> pushed{0};
+	std::thread producer([&]() {
+		while (!done) {
+			buffer->push_sample(fac.new_sample(0.0, false));
+			pushed++;
+		}
+	});
+
+	// consumers come and go (with and without a replay) while samples are pushed
+	for (int i = 0; i < 200; ++i) {
+		const uint64_t recent = pushed > 10 ? pushed - 10 : 1;
+		auto consumer = buffer->new_consumer(1000, i % 2 ? 0 : recent);
+		for (int k = 0; k < 20 && !consumer->empty(); ++k) {
+			// every consumer gets consecutive samples (unless its queue overflowed in between,
+			// e.g. while this thread wasn't scheduled)
+			const uint64_t dropped = consumer->dropped();
+			lsl::sample_p first = consumer->pop_sample(0.0), second = consumer->pop_sample(0.0);
+			if (first && second && consumer->dropped() == dropped)
+				CHECK(second->seq == first->seq + 1);
+		}
+	}
+	done = true;
+	producer.join();
+	CHECK(buffer->usage().consumers == 0);
+	CHECK(buffer->usage().pushed == pushed);
+}
+
+TEST_CASE("send_buffer_history", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int32, 1, 4);
+	auto buffer = std::make_shared<lsl::send_buffer>(100, 0, 0, 10);
+	REQUIRE(buffer->has_history());
+	for (int i = 1; i <= 15; ++i) buffer->push_sample(fac.new_sample(i, false));
+
+	// a resuming consumer gets the samples it missed first
+	auto resumed = buffer->new_consumer(100, 12);
+	buffer->push_sample(fac.new_sample(16, false));
+	for (int i = 12; i <= 16; ++i) {
+		lsl::sample_p s = resumed->pop_sample(0.0);
+		REQUIRE(s);
+		CHECK(s->seq == static_cast<uint64_t>(i));
+		CHECK(s->timestamp == i);
+	}
+	CHECK(resumed->empty());
+
+	// samples that are no longer in the history can't be replayed
+	auto late = buffer->new_consumer(100, 2);
+	CHECK(late->read_available() == 10);
+	CHECK(late->pop_sample(0.0)->seq == 7);
+
+	// new consumers only get new samples, unless they ask for the recently pushed ones
+	CHECK(buffer->new_consumer()->empty());
+	CHECK(buffer->new_consumer(100, 0, 60.0)->read_available() == 10);
+
+	buffer->set_history(0, 0.0);
+	CHECK(!buffer->has_history());
+	CHECK(buffer->new_consumer(100, 0, 60.0)->empty());
+}
+
+TEST_CASE("consumer_queue_overflow_policies", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+
+	SECTION("drop newest") {
+		lsl::consumer_queue queue(4);
+		queue.set_overflow_policy(ovf_drop_newest);
+		for (int i = 0; i < 10; ++i) queue.push_sample(fac.new_sample(i, false));
+		CHECK(queue.dropped() == 6);
+		CHECK(queue.pop_sample(0.0)->timestamp == 0);
+	}
+	SECTION("decimate") {
+		lsl::consumer_queue queue(8);
+		queue.set_overflow_policy(ovf_decimate, 3);
+		for (int i = 0; i < 10; ++i) queue.push_sample(fac.new_sample(i, false));
+		// the first four samples fill half of the queue, then every third sample is kept
+		std::vector<double> timestamps;
+		while (lsl::sample_p s = queue.pop_sample(0.0)) timestamps.push_back(s->timestamp);
+		CHECK(timestamps == std::vector<double>{0, 1, 2, 3, 4, 7});
+	}
+	SECTION("latest") {
+		lsl::consumer_queue queue(8);
+		queue.set_overflow_policy(ovf_latest);
+		for (int i = 0; i < 10; ++i) queue.push_sample(fac.new_sample(i, false));
+		CHECK(queue.dropped() == 9);
+		CHECK(queue.read_available() == 1);
+		CHECK(queue.pop_sample(0.0)->timestamp == 9);
+		CHECK(lsl::consumer_queue::policy_capacity(ovf_latest, 360) <
+			  lsl::consumer_queue::policy_capacity(ovf_drop_oldest, 360));
+	}
+	SECTION("block") {
+		lsl::consumer_queue queue(4);
+		queue.set_overflow_policy(ovf_block, 5.0);
+		for (int i = 0; i < 4; ++i) queue.push_sample(fac.new_sample(i, false));
+		std::thread consumer([&]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			queue.pop_sample();
+		});
+		// waits until the consumer made room, so nothing is dropped
+		queue.push_sample(fac.new_sample(4, false));
+		consumer.join();
+		CHECK(queue.dropped() == 0);
+		CHECK(queue.read_available() == 4);
+
+		// gives up after the timeout
+		queue.set_overflow_policy(ovf_block, 0.01);
+		queue.push_sample(fac.new_sample(5, false));
+		CHECK(queue.dropped() == 1);
+	}
+}
+
+TEST_CASE("consumer_queue_wake", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	for (lsl_overflow_policy_t policy : {ovf_drop_oldest, ovf_latest, ovf_block}) {
+		lsl::consumer_queue queue(policy == ovf_latest ? 2 : 4);
+		queue.set_overflow_policy(policy, 5.0);
+		const int n = policy == ovf_latest ? 1 : 4;
+		for (int i = 0; i < n; ++i) queue.push_sample(fac.new_sample(i, false));
+		// waking up the consumer of a full queue neither drops nor waits for a sample
+		const auto start = std::chrono::steady_clock::now();
+		queue.wake();
+		queue.wake();
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+		CHECK(queue.dropped() == 0);
+		CHECK(queue.read_available() == static_cast<std::size_t>(n));
+		for (int i = 0; i < n; ++i) CHECK(queue.pop_sample(0.0)->timestamp == i);
+		// the wakeups are merged into one
+		CHECK_FALSE(queue.pop_sample(0.0));
+	}
+
+	// a blocked consumer returns early
+	lsl::consumer_queue queue(4);
+	std::thread waker([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queue.wake();
+	});
+	const auto start = std::chrono::steady_clock::now();
+	CHECK_FALSE(queue.pop_sample(5.0));
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+	waker.join();
+	// and a non-blocking one handles it right away instead of waiting for a notification
+	queue.wake();
+	CHECK_FALSE(queue.arm_notification());
+}
+
+TEST_CASE("send_buffer_blocking_consumer", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	auto buffer = std::make_shared<lsl::send_buffer>(4);
+	auto blocking = buffer->new_consumer(4), other = buffer->new_consumer(4);
+	blocking->set_overflow_policy(ovf_block, 5.0);
+	for (int i = 0; i < 4; ++i) buffer->push_sample(fac.new_sample(i, false));
+	std::thread producer([&]() { buffer->push_sample(fac.new_sample(4, false)); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	// the producer waits for room without holding the send buffer's lock, so the other queues
+	// can still be woken up and new consumers can register
+	const auto start = std::chrono::steady_clock::now();
+	other->wake();
+	auto late = buffer->new_consumer(4);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+	CHECK(blocking->pop_sample(0.0)->timestamp == 0);
+	producer.join();
+	CHECK(blocking->dropped() == 0);
+	CHECK(blocking->read_available() == 4);
+	CHECK(late->pop_sample(0.0)->timestamp == 4);
+}
+
+TEST_CASE("consumer_queue_capacity_limit", "[queue][basic]") {
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	lsl::consumer_queue queue(8);
+	for (int i = 0; i < 6; ++i) queue.push_sample(fac.new_sample(i, false));
+
+	// shrinking drops the oldest samples right away
+	queue.set_capacity_limit(4);
+	CHECK(queue.capacity_limit() == 4);
+	CHECK(queue.capacity() == 8);
+	CHECK(queue.dropped() == 2);
+	CHECK(queue.read_available() == 4);
+	// and the producer drops the oldest ones beyond the limit
+	for (int i = 6; i < 10; ++i) queue.push_sample(fac.new_sample(i, false));
+	CHECK(queue.read_available() == 4);
+	CHECK(queue.pop_sample(0.0)->timestamp == 6);
+
+	// the queue can't grow beyond its slots
+	queue.set_capacity_limit(100);
+	CHECK(queue.capacity_limit() == 8);
+	for (int i = 10; i < 20; ++i) queue.push_sample(fac.new_sample(i, false));
+	CHECK(queue.read_available() == 8);
+	CHECK(queue.pop_sample(0.0)->timestamp == 12);
+}
+
+TEST_CASE("consumer_queue_segments", "[queue][basic]") {
+	const std::size_t size = 100000;
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	lsl::consumer_queue queue(size);
+	const std::size_t empty_bytes = queue.memory_bytes();
+	CHECK(empty_bytes < size);
+
+	// a consumer that keeps up only needs a few segments
+	for (int i = 0; i < 300000; ++i) {
+		queue.push_sample(fac.new_sample(i, false));
+		REQUIRE(queue.pop_sample(0.0)->timestamp == i);
+	}
+	const std::size_t keeping_up = queue.memory_bytes();
+	CHECK(keeping_up < size);
+
+	// the segments are allocated as the queue fills up, and the samples come out in order
+	for (int i = 0; i < 250000; ++i) queue.push_sample(fac.new_sample(i, false));
+	CHECK(queue.read_available() == size);
+	CHECK(queue.memory_bytes() > 10 * keeping_up);
+	for (int i = 150000; i < 250000; ++i) REQUIRE(queue.pop_sample(0.0)->timestamp == i);
+	CHECK(queue.empty());
+
+	// and freed again once the occupancy stays low
+	for (int i = 0; i < 300000; ++i) {
+		queue.push_sample(fac.new_sample(i, false));
+		REQUIRE(queue.pop_sample(0.0)->timestamp == i);
+	}
+	CHECK(queue.memory_bytes() == keeping_up);
+
+	// unless all slots were allocated up front
+	lsl::consumer_queue preallocated(size, nullptr, 0, nullptr, prio_normal, true);
+	CHECK(preallocated.memory_bytes() > 10 * keeping_up);
+}
+
+TEST_CASE("consumer_queue_segments_threaded", "[queue][threads]") {
+	const int n = 500000;
+	lsl::factory fac(lsl_channel_format_t::cft_int8, 1, 16);
+	lsl::consumer_queue queue(20000);
+	std::atomic<bool> done{false};
+
+	// the segments are released while two consumers pop in bursts
+	std::thread pusher([&]() {
+		for (int i = 1; i <= n; ++i) queue.push_sample(fac.new_sample(i, false));
+		done = true;
+	});
+	std::atomic<int> pulled{0}, out_of_order{0};
+	auto consume = [&]() {
+		lsl::sample_p samples[64];
+		double last = 0;
+		while (!done || !queue.empty()) {
+			const std::size_t k = queue.pop_samples(samples, 64, 0.01);
+			for (std::size_t j = 0; j < k; ++j) {
+				if (samples[j]->timestamp <= last) out_of_order++;
+				last = samples[j]->timestamp;
+			}
+			pulled += static_cast<int>(k);
+		}
+	};
+	std::thread consumer(consume);
+	consume();
+	pusher.join();
+	consumer.join();
+	CHECK(out_of_order == 0);
+	CHECK(pulled + queue.dropped() == n);
+}
+
+TEST_CASE("consumer_queue_spill", "[queue][basic]") {
+	auto fac = std::make_shared<lsl::factory>(lsl_channel_format_t::cft_int32, 2, 16);
+	auto buffer = std::make_shared<lsl::send_buffer>(8);
+	buffer->enable_spill(fac, ".", 1 << 20);
+	auto queue = buffer->new_consumer();
+	auto push = [&](int i) {
+		const int32_t values[] = {i, -i};
+		lsl::sample_p s(fac->new_sample(i, i % 2 == 0));
+		s->assign_typed(values);
+		buffer->push_sample(s);
+	};
+	auto pop = [&](int i) {
+		lsl::sample_p s = queue->pop_sample(0.0);
+		REQUIRE(s);
+		int32_t values[2];
+		s->retrieve_typed(values);
+		CHECK(s->timestamp == i);
+		CHECK(s->pushthrough == (i % 2 == 0));
+		CHECK(s->seq == static_cast<uint64_t>(i + 1));
+		CHECK(values[0] == i);
+		CHECK(values[1] == -i);
+	};
+
+	SECTION("spilled samples are delivered in order") {
+		for (int i = 0; i < 20000; ++i) push(i);
+		CHECK(queue->dropped() == 0);
+		CHECK(queue->spilled() == 20000 - 8);
+		CHECK(queue->read_available() == 20000);
+		// samples pushed while reading the file are appended to it
+		for (int i = 0; i < 10000; ++i) pop(i);
+		for (int i = 20000; i < 20010; ++i) push(i);
+		for (int i = 10000; i < 20010; ++i) pop(i);
+		CHECK(queue->empty());
+		CHECK(queue->spilled() == 0);
+		// afterwards, the ring buffer is used again
+		push(20010);
+		CHECK(queue->spilled() == 0);
+		pop(20010);
+	}
+	SECTION("the newest samples are dropped once the file is full") {
+		auto small = std::make_shared<lsl::send_buffer>(4);
+		// a spilled sample takes 1 + 8 + 8 + 8 bytes
+		small->enable_spill(fac, ".", 25 * 10);
+		auto q = small->new_consumer();
+		for (int i = 0; i < 20; ++i) small->push_sample(fac->new_sample(i, false));
+		CHECK(q->spilled() == 10);
+		CHECK(q->dropped() == 6);
+		std::vector<double> timestamps;
+		while (lsl::sample_p s = q->pop_sample(0.0)) timestamps.push_back(s->timestamp);
+		CHECK(timestamps.size() == 14);
+		CHECK(timestamps.back() == 13);
+	}
+	SECTION("strings") {
+		auto str_fac = std::make_shared<lsl::factory>(lsl_channel_format_t::cft_string, 2, 4);
+		auto str_buffer = std::make_shared<lsl::send_buffer>(2);
+		str_buffer->enable_spill(str_fac, ".", 1 << 20);
+		auto q = str_buffer->new_consumer();
+		for (int i = 0; i < 10; ++i) {
+			const std::string values[] = {std::to_string(i), std::string(i * 100, 'x')};
+			lsl::sample_p s(str_fac->new_sample(i, false));
+			s->assign_typed(values);
+			str_buffer->push_sample(s);
+		}
+		CHECK(q->spilled() == 8);
+		for (int i = 0; i < 10; ++i) {
+			lsl::sample_p s = q->pop_sample(0.0);
+			REQUIRE(s);
+			std::string values[2];
+			s->retrieve_typed(values);
+			CHECK(values[0] == std::to_string(i));
+			CHECK(values[1] == std::string(i * 100, 'x'));
+		}
+	}
+	SECTION("threaded") {
+		const int n = 200000;
+		std::thread pusher([&]() {
+			for (int i = 0; i < n; ++i) {
+				push(i);
+				if (i % 10000 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+		for (int i = 0; i < n; ++i) {
+			lsl::sample_p s = queue->pop_sample(5.0);
+			REQUIRE(s);
+			REQUIRE(s->timestamp == i);
+		}
+		pusher.join();
+		CHECK(queue->dropped() == 0);
+	}
+}
+
+TEST_CASE("lock statistics", "[queue][basic]") {
+	lsl::named_mutex mut("test_lock");
+	std::vector<lsl_lock_stats> stats(32);
+#ifdef LSL_LOCK_STATS
+	{ std::lock_guard<lsl::named_mutex> lock(mut); }
+	// a second thread has to wait until the mutex is released
+	std::unique_lock<lsl::named_mutex> held(mut);
+	std::thread waiter([&]() { std::lock_guard<lsl::named_mutex> lock(mut); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	held.unlock();
+	waiter.join();
+
+	const int32_t n = lsl_get_lock_stats(stats.data(), static_cast<int32_t>(stats.size()));
+	REQUIRE(n > 0);
+	const auto it = std::find_if(stats.begin(), stats.begin() + n,
+		[](const lsl_lock_stats &s) { return std::string(s.name) == "test_lock"; });
+	REQUIRE(it != stats.begin() + n);
+	CHECK(it->acquisitions == 3);
+	CHECK(it->contended == 1);
+	CHECK(it->wait_seconds > 0.01);
+	// 20 ms fall into the bucket of the waits shorter than 2^15 microseconds
+	CHECK(it->wait_histogram[15] == 1);
+#else
+	{ std::lock_guard<lsl::named_mutex> lock(mut); }
+	CHECK(lsl_get_lock_stats(stats.data(), static_cast<int32_t>(stats.size())) ==
+		  lsl_internal_error);
+#endif
+}
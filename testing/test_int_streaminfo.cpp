@@ -1,9 +1,11 @@
 #include "../src/api_config.h"
 #include "../src/stream_info_impl.h"
+#include <atomic>
 #include <cctype>
 #include <loguru.hpp>
 
 #include <catch2/catch.hpp>
+#include <thread>
 
 template<typename T, const std::size_t N>
 bool contains(const T(&valid)[N], const T target) {
@@ -49,6 +51,40 @@ TEST_CASE("streaminfo matching via XPath", "[basic][streaminfo][xml]") {
 	REQUIRE(info.matches_query("nominal_srate >= 499"));
 	REQUIRE(info.matches_query("count(desc/channels/channel[type='EEG'])>3"));
 
+	REQUIRE(info.matches_query("desc/channels/channel/type='EOG'"));
+	REQUIRE(!info.matches_query("desc/channels/channel/type='ECG'"));
+
+	// simple queries give the same results as XPath
+	info.desc().append_child("manufacturer").append_child(pugi::node_pcdata).set_value("LSL");
+	pugi::xml_document doc;
+	doc.load_string(info.to_fullinfo_message().c_str());
+	for (const char *query :
+		{"name='streamname'", " name = \"streamname\"and type='streamtype' ", "name='other'",
+			"desc/manufacturer='LSL'", "desc/channels/channel/type='EOG' and channel_count='8'",
+			"desc/channels='EEGEEGEEGEEGEOGEOGEOGEOG'", "desc/missing=''", "source_id=''"}) {
+		INFO(query);
+		lsl::simple_query simple;
+		REQUIRE(simple.parse(query));
+		CHECK(simple.matches(doc.first_child()) ==
+			  pugi::xpath_query(query).evaluate_boolean(doc.first_child()));
+	}
+	for (const char *query : {"channel_count > 5", "name='a' or name='b'", "name!='x'",
+			 "desc/channels/channel[type='EEG']='EEG'", "name='a' andtype='b'", "name='unclosed"}) {
+		INFO(query);
+		CHECK(!lsl::simple_query().parse(query));
+	}
+	{
+		// the fields a query compares, e.g. to look the query up in an index of streams
+		lsl::simple_query simple;
+		REQUIRE(simple.parse("type='EEG' and desc/manufacturer='X'"));
+		REQUIRE(simple.value_of("type"));
+		CHECK(*simple.value_of("type") == "EEG");
+		CHECK(!simple.value_of("name"));
+		CHECK(!simple.value_of("manufacturer"));
+		CHECK(simple.refers_to("desc"));
+		CHECK(!simple.refers_to("name"));
+	}
+
 	LOG_F(INFO, "The following warning is harmless and expected");
 	REQUIRE(!info.matches_query("in'va'lid"));
 	REQUIRE(!info.matches_query("name='othername'"));
@@ -85,3 +121,224 @@ TEST_CASE("streaminfo matching via XPath", "[basic][streaminfo][xml]") {
 
 #endif
 }
+
+TEST_CASE("query cache eviction", "[basic][streaminfo][xml]") {
+	const std::size_t max_cached = lsl::api_config::get_instance()->max_cached_queries();
+	REQUIRE(max_cached > 1);
+	pugi::xml_document doc, other;
+	doc.append_child("info").append_child("channel_count").text().set(8);
+	other.append_child("info").append_child("channel_count").text().set(1);
+	const std::string query = "channel_count > 4";
+	const auto filler = [](std::size_t j) { return "channel_count != " + std::to_string(j); };
+
+	lsl::query_cache cache;
+	REQUIRE(cache.matches_query(doc, query, false));
+	for (std::size_t j = 1; j < max_cached; ++j) cache.matches_query(doc, filler(j), false);
+	CHECK(cache.size() == max_cached);
+	// the first query is used again, so the second one is the least recently used
+	CHECK(cache.matches_query(other, query, false));
+	cache.matches_query(doc, filler(max_cached), false);
+	CHECK(cache.size() == max_cached);
+	// the cached results are returned for the other document
+	CHECK(cache.matches_query(other, query, false));
+	// but the evicted one is evaluated again
+	CHECK(!cache.matches_query(other, filler(1), false));
+	CHECK(cache.size() == max_cached);
+	// uncached lookups don't touch the cache
+	CHECK(!cache.matches_query(other, query, true));
+	cache.clear();
+	CHECK(cache.size() == 0);
+	CHECK(!cache.matches_query(other, query, false));
+}
+
+TEST_CASE("binary shortinfo roundtrip", "[basic][streaminfo]") {
+	lsl::stream_info_impl info("BinaryTest", "EEG", 8, 500., cft_int16, "src</id>");
+	info.reset_uid();
+	info.created_at(1234.56789012345);
+	info.hostname("host");
+	info.v4address("127.0.0.1");
+	info.v4data_port(16572);
+	info.v6service_port(16573);
+	info.desc().append_child("channels");
+
+	const std::string binary = info.to_shortinfo_binary();
+	CHECK(binary.size() < info.to_shortinfo_message().size());
+
+	lsl::stream_info_impl decoded;
+	decoded.from_shortinfo_message(binary);
+	CHECK(decoded.name() == info.name());
+	CHECK(decoded.source_id() == info.source_id());
+	CHECK(decoded.uid() == info.uid());
+	CHECK(decoded.created_at() == info.created_at());
+	CHECK(decoded.v6service_port() == 16573);
+	CHECK(decoded.to_shortinfo_message() == info.to_shortinfo_message());
+	CHECK(decoded.matches_query("type='EEG' and channel_count=8"));
+
+	// truncated messages are rejected like malformed xml
+	decoded.from_shortinfo_message(binary.substr(0, binary.size() - 1));
+	CHECK(decoded.name().find("(invalid: ") == 0);
+}
+
+TEST_CASE("lazy fullinfo desc", "[basic][streaminfo][xml]") {
+	lsl::stream_info_impl info("LazyTest", "EEG", 2, 100., cft_float32, "lazysrc");
+	info.reset_uid();
+	info.created_at(42.);
+	auto channels = info.desc().append_child("channels");
+	channels.append_child("channel").append_child("label").text().set("C3");
+	channels.append_child("channel").append_child("label").text().set("C4");
+	info.desc().append_child("acquisition").append_child("manufacturer").text().set("lsl");
+	const std::string fullinfo = info.to_fullinfo_message();
+
+	lsl::stream_info_impl lazy;
+	lazy.from_fullinfo_message(fullinfo, true);
+	CHECK(lazy.name() == "LazyTest");
+	CHECK(lazy.uid() == info.uid());
+	// copies taken before the first access still have the description
+	lsl::stream_info_impl copy(lazy);
+	lsl::stream_info_impl eager;
+	eager.from_fullinfo_message(fullinfo);
+	CHECK(lazy.to_fullinfo_message() == eager.to_fullinfo_message());
+	CHECK(copy.matches_query("desc/acquisition/manufacturer='lsl'"));
+	CHECK(std::string(copy.desc().child("channels").last_child().child_value("label")) == "C4");
+
+	const std::string selected = lsl::stream_info_impl::select_desc_subtrees(
+		fullinfo, std::vector<std::string>{"acquisition"});
+	lsl::stream_info_impl partial;
+	partial.from_fullinfo_message(selected, true);
+	CHECK(partial.uid() == info.uid());
+	CHECK(!partial.desc().child("channels"));
+	CHECK(std::string(partial.desc().child("acquisition").child_value("manufacturer")) == "lsl");
+}
+
+TEST_CASE("versioned message cache", "[basic][streaminfo]") {
+	lsl::stream_info_impl info("CacheTest", "EEG", 1, 10., cft_float32, "cachesrc");
+	info.reset_uid();
+	const auto version = info.metadata_version();
+	const auto fullinfo = info.cached_fullinfo_message();
+	CHECK(info.cached_fullinfo_message() == fullinfo);
+	CHECK(info.metadata_version() == version);
+
+	lsl::stream_info_impl other("CacheTest", "EEG", 1, 10., cft_float32, "cachesrc");
+	other.desc().append_child("revision").append_child(pugi::node_pcdata).set_value("2");
+	info.replace_desc(other.desc());
+	CHECK(info.metadata_version() > version);
+	const auto updated = info.cached_fullinfo_message();
+	CHECK(updated != fullinfo);
+	CHECK(updated->find("<revision>2</revision>") != std::string::npos);
+	CHECK(info.matches_query("desc/revision='2'"));
+	CHECK(*info.cached_shortinfo_message() == info.to_shortinfo_message());
+}
+
+TEST_CASE("descriptions replaced while read", "[basic][streaminfo]") {
+	lsl::stream_info_impl info("RaceTest", "EEG", 1, 10., cft_float32, "racesrc");
+	info.reset_uid();
+	// a resolver result shares the document, so each update replaces it
+	lsl::stream_info_impl resolved(info);
+	std::atomic<bool> done{false};
+	std::thread reader([&]() {
+		while (!done) {
+			pugi::xml_document doc;
+			CHECK(doc.load_string(info.to_fullinfo_message().c_str()));
+			info.matches_query("desc/revision>0", true);
+			lsl::stream_info_impl copy(info);
+		}
+	});
+	for (int k = 1; k <= 500; ++k) {
+		lsl::stream_info_impl other("RaceTest", "EEG", 1, 10., cft_float32, "racesrc");
+		other.desc().append_child("revision").text().set(k);
+		info.replace_desc(other.desc());
+		resolved = info;
+	}
+	done = true;
+	reader.join();
+	CHECK(info.matches_query("desc/revision=500"));
+}
+
+TEST_CASE("shared documents", "[basic][streaminfo][xml]") {
+	lsl::stream_info_impl info("SharedTest", "EEG", 1, 10., cft_float32, "sharedsrc");
+	info.reset_uid();
+	const std::string uid = info.uid();
+	lsl::stream_info_impl resolved;
+	resolved.from_fullinfo_message(info.to_fullinfo_message());
+
+	// a change to a copy doesn't show up in the others
+	lsl::stream_info_impl copy(resolved), assigned;
+	assigned = resolved;
+	copy.uid("changed");
+	CHECK(copy.to_fullinfo_message().find("<uid>changed</uid>") != std::string::npos);
+	CHECK(resolved.to_fullinfo_message().find("<uid>" + uid + "</uid>") != std::string::npos);
+	CHECK(assigned.to_fullinfo_message() == resolved.to_fullinfo_message());
+	assigned.desc().append_child("only_assigned");
+	CHECK(assigned.matches_query("count(desc/only_assigned)=1"));
+	CHECK(resolved.matches_query("count(desc/only_assigned)=0"));
+
+	// neither do edits through a description handed out before the copy was made
+	pugi::xml_node desc = resolved.desc();
+	lsl::stream_info_impl later(resolved);
+	desc.append_child("after_copy");
+	CHECK(resolved.matches_query("count(desc/after_copy)=1"));
+	CHECK(later.matches_query("count(desc/after_copy)=0"));
+}
+
+TEST_CASE("description patches", "[basic][streaminfo][xml]") {
+	lsl::stream_info_impl before("PatchTest", "EEG", 1, 10., cft_float32, "patchsrc");
+	for (const char *name : {"acquisition", "channels", "impedances", "notes"})
+		before.desc().append_child(name).append_child(pugi::node_pcdata).set_value("old");
+	lsl::stream_info_impl after(before);
+	after.desc().child("impedances").text().set("new");
+	after.desc().remove_child("notes");
+	after.desc().append_child("reference").append_child(pugi::node_pcdata).set_value("Cz");
+
+	const std::string patch = lsl::stream_info_impl::desc_patch(
+		static_cast<const lsl::stream_info_impl &>(before).desc(),
+		static_cast<const lsl::stream_info_impl &>(after).desc(), 3, 4);
+	// only the changed children are sent
+	CHECK(patch.find("impedances") != std::string::npos);
+	CHECK(patch.find("acquisition") == std::string::npos);
+	CHECK(patch.find("channels") == std::string::npos);
+	pugi::xml_document doc;
+	REQUIRE(doc.load_string(patch.c_str()));
+	CHECK(doc.child("patch").attribute("from").as_uint() == 3);
+	CHECK(doc.child("patch").attribute("to").as_uint() == 4);
+
+	lsl::stream_info_impl patched(before);
+	REQUIRE(patched.apply_desc_patch(doc.child("patch")));
+	CHECK(patched.to_fullinfo_message() == after.to_fullinfo_message());
+	// the original isn't changed by patching its copy
+	CHECK(before.matches_query("desc/impedances='old'"));
+
+	doc.child("patch").attribute("children").set_value(1);
+	CHECK_FALSE(lsl::stream_info_impl(before).apply_desc_patch(doc.child("patch")));
+
+	// a changed channel only sends that channel, not the others
+	lsl::stream_info_impl channels(before);
+	pugi::xml_node list = channels.desc().child("channels");
+	list.remove_children();
+	for (const char *label : {"C3", "Cz", "C4"})
+		list.append_child("channel").append_child("label").text().set(label);
+	lsl::stream_info_impl relabeled(channels);
+	pugi::xml_node relabel = relabeled.desc().child("channels").first_child().next_sibling();
+	relabel.child("label").text().set("CPz");
+	relabel.append_child("unit").text().set("uV");
+	relabel.parent().append_child("channel").append_child("label").text().set("O1");
+	const std::string channel_patch = lsl::stream_info_impl::desc_patch(
+		static_cast<const lsl::stream_info_impl &>(channels).desc(),
+		static_cast<const lsl::stream_info_impl &>(relabeled).desc(), 4, 5);
+	CHECK(channel_patch.find("CPz") != std::string::npos);
+	CHECK(channel_patch.find("O1") != std::string::npos);
+	CHECK(channel_patch.find("C3") == std::string::npos);
+	CHECK(channel_patch.find("C4") == std::string::npos);
+	REQUIRE(doc.load_string(channel_patch.c_str()));
+	REQUIRE(channels.apply_desc_patch(doc.child("patch")));
+	CHECK(channels.to_fullinfo_message() == relabeled.to_fullinfo_message());
+
+	// and removing channels sends the new count
+	lsl::stream_info_impl fewer(channels);
+	fewer.desc().child("channels").remove_child(fewer.desc().child("channels").last_child());
+	const std::string removal_patch = lsl::stream_info_impl::desc_patch(
+		static_cast<const lsl::stream_info_impl &>(channels).desc(),
+		static_cast<const lsl::stream_info_impl &>(fewer).desc(), 5, 6);
+	REQUIRE(doc.load_string(removal_patch.c_str()));
+	REQUIRE(channels.apply_desc_patch(doc.child("patch")));
+	CHECK(channels.to_fullinfo_message() == fewer.to_fullinfo_message());
+}